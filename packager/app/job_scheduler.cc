@@ -0,0 +1,190 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/app/job_scheduler.h"
+
+#include "packager/base/bind.h"
+#include "packager/base/logging.h"
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/stl_util.h"
+#include "packager/base/strings/string_number_conversions.h"
+#include "packager/base/strings/string_split.h"
+#include "packager/media/base/closure_thread.h"
+#include "packager/media/base/cpu_affinity.h"
+
+namespace edash_packager {
+namespace media {
+
+Job::Job()
+    : priority(0),
+      sequence_number(0),
+      io_priority(kLiveIoPriority),
+      io_bytes_per_second(0) {}
+
+Job::~Job() {}
+
+bool ParseJob(const std::string& line, Job* job, std::string* error) {
+  DCHECK(job);
+  DCHECK(error);
+  std::vector<std::string> tokens;
+  base::SplitStringAlongWhitespace(line, &tokens);
+  if (!tokens.empty())
+    job->id = tokens[0];
+  if (tokens.size() < 4) {
+    *error = "Expecting <job_id> <priority> <mpd_output> <stream_descriptor>.";
+    return false;
+  }
+  if (!base::StringToInt(tokens[1], &job->priority)) {
+    *error = "Invalid priority: " + tokens[1];
+    return false;
+  }
+  if (tokens[2] != "-")
+    job->mpd_output = tokens[2];
+  job->io_priority = kLiveIoPriority;
+  job->io_bytes_per_second = 0;
+  size_t first_stream_descriptor = 3;
+  const std::string kCpuSetPrefix = "cpu_set=";
+  const std::string kIoPriorityPrefix = "io_priority=";
+  const std::string kIoBandwidthPrefix = "io_bandwidth=";
+  const std::string kResourceReportPrefix = "resource_report=";
+  for (; first_stream_descriptor < tokens.size(); ++first_stream_descriptor) {
+    const std::string& token = tokens[first_stream_descriptor];
+    if (token.compare(0, kCpuSetPrefix.size(), kCpuSetPrefix) == 0) {
+      if (!ParseCpuSet(token.substr(kCpuSetPrefix.size()), &job->cpu_set)) {
+        *error = "Invalid CPU set: " + token;
+        return false;
+      }
+    } else if (token.compare(0, kIoPriorityPrefix.size(),
+                             kIoPriorityPrefix) == 0) {
+      if (!IoThrottle::ParseIoPriority(token.substr(kIoPriorityPrefix.size()),
+                                       &job->io_priority)) {
+        *error = "Invalid I/O priority: " + token;
+        return false;
+      }
+    } else if (token.compare(0, kIoBandwidthPrefix.size(),
+                             kIoBandwidthPrefix) == 0) {
+      double megabytes_per_second = 0;
+      if (!base::StringToDouble(token.substr(kIoBandwidthPrefix.size()),
+                                &megabytes_per_second) ||
+          megabytes_per_second < 0) {
+        *error = "Invalid I/O bandwidth: " + token;
+        return false;
+      }
+      job->io_bytes_per_second =
+          static_cast<uint64_t>(megabytes_per_second * 1024 * 1024);
+    } else if (token.compare(0, kResourceReportPrefix.size(),
+                             kResourceReportPrefix) == 0) {
+      job->resource_report_file = token.substr(kResourceReportPrefix.size());
+      if (job->resource_report_file.empty()) {
+        *error = "Invalid resource report file: " + token;
+        return false;
+      }
+    } else {
+      break;
+    }
+  }
+  if (first_stream_descriptor == tokens.size()) {
+    *error = "Expecting a stream descriptor.";
+    return false;
+  }
+  for (size_t i = first_stream_descriptor; i < tokens.size(); ++i) {
+    if (!InsertStreamDescriptor(tokens[i], &job->stream_descriptors)) {
+      *error = "Invalid stream descriptor: " + tokens[i];
+      return false;
+    }
+  }
+  return true;
+}
+
+JobScheduler::JobScheduler(const RunJobCallback& run_job,
+                           const JobDoneCallback& job_done,
+                           size_t max_concurrent_jobs)
+    : run_job_(run_job),
+      job_done_(job_done),
+      closed_(false),
+      job_available_cv_(&lock_) {
+  for (size_t i = 0; i < max_concurrent_jobs; ++i) {
+    runners_.push_back(new ClosureThread(
+        "JobRunner" + base::SizeTToString(i),
+        base::Bind(&JobScheduler::RunJobs, base::Unretained(this))));
+    runners_.back()->Start();
+  }
+}
+
+JobScheduler::~JobScheduler() {
+  Close();
+  STLDeleteElements(&runners_);
+  while (!jobs_.empty()) {
+    delete jobs_.top();
+    jobs_.pop();
+  }
+}
+
+void JobScheduler::AddJob(Job* job) {
+  DCHECK(job);
+  job->cancellation_token = new CancellationToken;
+  base::AutoLock auto_lock(lock_);
+  DCHECK(!closed_);
+  jobs_.push(job);
+  cancellation_tokens_[job->id] = job->cancellation_token;
+  job_available_cv_.Signal();
+}
+
+bool JobScheduler::CancelJob(const std::string& job_id) {
+  base::AutoLock auto_lock(lock_);
+  std::map<std::string, scoped_refptr<CancellationToken> >::iterator it =
+      cancellation_tokens_.find(job_id);
+  if (it == cancellation_tokens_.end())
+    return false;
+  it->second->Cancel();
+  return true;
+}
+
+void JobScheduler::Close() {
+  {
+    base::AutoLock auto_lock(lock_);
+    if (closed_)
+      return;
+    closed_ = true;
+    job_available_cv_.Broadcast();
+  }
+  for (ClosureThread* runner : runners_)
+    runner->Join();
+}
+
+void JobScheduler::RunJobs() {
+  while (true) {
+    scoped_ptr<Job> job;
+    {
+      base::AutoLock auto_lock(lock_);
+      while (jobs_.empty() && !closed_)
+        job_available_cv_.Wait();
+      if (jobs_.empty())
+        return;
+      job.reset(jobs_.top());
+      jobs_.pop();
+    }
+
+    const Status status =
+        job->cancellation_token->IsCancelled()
+            ? Status(error::CANCELLED, "Job cancelled before it started.")
+            : run_job_.Run(*job);
+    {
+      base::AutoLock auto_lock(lock_);
+      std::map<std::string, scoped_refptr<CancellationToken> >::iterator it =
+          cancellation_tokens_.find(job->id);
+      // A later job may have reused the id.
+      if (it != cancellation_tokens_.end() &&
+          it->second.get() == job->cancellation_token.get()) {
+        cancellation_tokens_.erase(it);
+      }
+    }
+    job_done_.Run(job->id, status);
+  }
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,134 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+//
+// Parsing and scheduling of the jobs of the packaging server.
+
+#ifndef APP_JOB_SCHEDULER_H_
+#define APP_JOB_SCHEDULER_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "packager/app/stream_descriptor.h"
+#include "packager/base/callback.h"
+#include "packager/base/memory/ref_counted.h"
+#include "packager/base/synchronization/condition_variable.h"
+#include "packager/base/synchronization/lock.h"
+#include "packager/media/base/cancellation_token.h"
+#include "packager/media/base/io_throttle.h"
+#include "packager/media/base/status.h"
+
+namespace edash_packager {
+namespace media {
+
+class ClosureThread;
+
+/// A packaging job of the server, parsed from a job line by ParseJob().
+struct Job {
+  Job();
+  ~Job();
+
+  std::string id;
+  int priority;
+  /// Order of arrival, to start the jobs of the same priority in order.
+  uint64_t sequence_number;
+  std::string mpd_output;
+  std::vector<int> cpu_set;
+  IoPriority io_priority;
+  uint64_t io_bytes_per_second;
+  std::string resource_report_file;
+  StreamDescriptorList stream_descriptors;
+  /// Set by JobScheduler::AddJob().
+  scoped_refptr<CancellationToken> cancellation_token;
+};
+
+/// Parses a job line:
+///   <job_id> <priority> <mpd_output> [cpu_set=<cpus>]
+///       [io_priority=<io_priority>] [io_bandwidth=<megabytes_per_second>]
+///       [resource_report=<file>] <stream_descriptor> ...
+/// @param line is the job line.
+/// @param job receives the job. Its id is set as soon as it is parsed, so
+///        that the errors can be reported for the job.
+/// @param error receives the error if the line is invalid.
+/// @return true on success, false otherwise.
+bool ParseJob(const std::string& line, Job* job, std::string* error);
+
+/// Runs the queued jobs on a fixed number of threads, highest priority first,
+/// and jobs of the same priority in order of arrival.
+///
+/// Thread Safety: All the methods can be called from any thread, except the
+/// destructor.
+class JobScheduler {
+ public:
+  /// Runs a job and returns its status. Called on the threads of the
+  /// scheduler. The job should stop soon after its cancellation token is
+  /// cancelled.
+  typedef base::Callback<Status(const Job& job)> RunJobCallback;
+  /// Called with the id and the status of each job once it completes, or
+  /// once it is dropped because it was cancelled while queued. Called on the
+  /// threads of the scheduler.
+  typedef base::Callback<void(const std::string& job_id,
+                              const Status& status)> JobDoneCallback;
+
+  /// @param run_job runs the jobs.
+  /// @param job_done receives the results of the jobs.
+  /// @param max_concurrent_jobs is the number of jobs run concurrently.
+  JobScheduler(const RunJobCallback& run_job,
+               const JobDoneCallback& job_done,
+               size_t max_concurrent_jobs);
+  /// Calls Close(), then deletes the jobs which are still queued.
+  ~JobScheduler();
+
+  /// Queue a job.
+  /// @param job is the job, which is owned by the scheduler.
+  void AddJob(Job* job);
+
+  /// Cancel a queued or running job. A queued job is not run, and completes
+  /// with a CANCELLED status.
+  /// @param job_id is the id of the job.
+  /// @return false if there is no such job.
+  bool CancelJob(const std::string& job_id);
+
+  /// Run the jobs which are queued and wait for them to complete. No job can
+  /// be added after.
+  void Close();
+
+ private:
+  struct JobCompareFn {
+    // Lowest priority, then latest, job first, as std::priority_queue pops
+    // the largest element.
+    bool operator()(const Job* a, const Job* b) const {
+      if (a->priority != b->priority)
+        return a->priority < b->priority;
+      return a->sequence_number > b->sequence_number;
+    }
+  };
+
+  void RunJobs();
+
+  const RunJobCallback run_job_;
+  const JobDoneCallback job_done_;
+  std::vector<ClosureThread*> runners_;
+
+  base::Lock lock_;  // Lock protecting the variables below.
+  std::priority_queue<Job*, std::vector<Job*>, JobCompareFn> jobs_;
+  // The cancellation tokens of the queued and running jobs, by job id.
+  std::map<std::string, scoped_refptr<CancellationToken> >
+      cancellation_tokens_;
+  bool closed_;
+  base::ConditionVariable job_available_cv_;
+
+  DISALLOW_COPY_AND_ASSIGN(JobScheduler);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // APP_JOB_SCHEDULER_H_
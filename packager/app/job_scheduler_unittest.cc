@@ -0,0 +1,214 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/app/job_scheduler.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "packager/base/bind.h"
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/synchronization/lock.h"
+#include "packager/base/synchronization/waitable_event.h"
+#include "packager/base/time/time.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+const char kStreamDescriptor[] = "input=a.mp4,stream=video,output=v.mp4";
+}  // namespace
+
+TEST(ParseJobTest, Valid) {
+  Job job;
+  std::string error;
+  ASSERT_TRUE(ParseJob(
+      "job1 5 out.mpd cpu_set=0-1 io_priority=batch io_bandwidth=2 "
+      "resource_report=report.json " + std::string(kStreamDescriptor) +
+          " input=a.mp4,stream=audio,output=a.mp4",
+      &job, &error))
+      << error;
+  EXPECT_EQ("job1", job.id);
+  EXPECT_EQ(5, job.priority);
+  EXPECT_EQ("out.mpd", job.mpd_output);
+  EXPECT_EQ(2u, job.cpu_set.size());
+  EXPECT_EQ(kBatchIoPriority, job.io_priority);
+  EXPECT_EQ(2u * 1024 * 1024, job.io_bytes_per_second);
+  EXPECT_EQ("report.json", job.resource_report_file);
+  EXPECT_EQ(2u, job.stream_descriptors.size());
+}
+
+TEST(ParseJobTest, DefaultOptions) {
+  Job job;
+  std::string error;
+  ASSERT_TRUE(ParseJob("job1 -3 - " + std::string(kStreamDescriptor), &job,
+                       &error))
+      << error;
+  EXPECT_EQ(-3, job.priority);
+  EXPECT_TRUE(job.mpd_output.empty());
+  EXPECT_TRUE(job.cpu_set.empty());
+  EXPECT_EQ(kLiveIoPriority, job.io_priority);
+  EXPECT_EQ(0u, job.io_bytes_per_second);
+  EXPECT_TRUE(job.resource_report_file.empty());
+  EXPECT_EQ(1u, job.stream_descriptors.size());
+}
+
+TEST(ParseJobTest, Malformed) {
+  const std::string kDescriptor(kStreamDescriptor);
+  const std::string kMalformedLines[] = {
+      "",
+      "job1",
+      "job1 5 out.mpd",
+      "job1 high out.mpd " + kDescriptor,
+      "job1 5 out.mpd cpu_set=0",
+      "job1 5 out.mpd cpu_set=x " + kDescriptor,
+      "job1 5 out.mpd io_priority=urgent " + kDescriptor,
+      "job1 5 out.mpd io_bandwidth=-1 " + kDescriptor,
+      "job1 5 out.mpd io_bandwidth=fast " + kDescriptor,
+      "job1 5 out.mpd resource_report= " + kDescriptor,
+      "job1 5 out.mpd stream=video",
+  };
+  for (const std::string& line : kMalformedLines) {
+    Job job;
+    std::string error;
+    EXPECT_FALSE(ParseJob(line, &job, &error)) << line;
+    EXPECT_FALSE(error.empty()) << line;
+  }
+
+  // The id is kept to report the error.
+  Job job;
+  std::string error;
+  EXPECT_FALSE(ParseJob("job1 high out.mpd " + kDescriptor, &job, &error));
+  EXPECT_EQ("job1", job.id);
+}
+
+class JobSchedulerTest : public ::testing::Test {
+ public:
+  JobSchedulerTest()
+      : first_job_started_(false, false),
+        release_first_job_(false, false),
+        sequence_number_(0) {}
+
+ protected:
+  // Runs the jobs on a single thread. The first job holds the thread until
+  // release_first_job_ is signaled, or until it is cancelled, so that the
+  // next jobs are queued.
+  void CreateScheduler() {
+    scheduler_.reset(new JobScheduler(
+        base::Bind(&JobSchedulerTest::RunJob, base::Unretained(this)),
+        base::Bind(&JobSchedulerTest::OnJobDone, base::Unretained(this)),
+        1));
+  }
+
+  void AddJob(const std::string& id, int priority) {
+    Job* job = new Job;
+    job->id = id;
+    job->priority = priority;
+    job->sequence_number = sequence_number_++;
+    scheduler_->AddJob(job);
+  }
+
+  Status RunJob(const Job& job) {
+    bool first_job = false;
+    {
+      base::AutoLock auto_lock(lock_);
+      first_job = run_order_.empty();
+      run_order_.push_back(job.id);
+    }
+    if (!first_job)
+      return Status::OK;
+    first_job_started_.Signal();
+    while (!release_first_job_.TimedWait(base::TimeDelta::FromMilliseconds(1)))
+      if (job.cancellation_token->IsCancelled())
+        return Status(error::CANCELLED, "Cancelled.");
+    return Status::OK;
+  }
+
+  void OnJobDone(const std::string& job_id, const Status& status) {
+    base::AutoLock auto_lock(lock_);
+    results_.push_back(std::make_pair(job_id, status.error_code()));
+  }
+
+  base::WaitableEvent first_job_started_;
+  base::WaitableEvent release_first_job_;
+  scoped_ptr<JobScheduler> scheduler_;
+  uint64_t sequence_number_;
+
+  base::Lock lock_;
+  std::vector<std::string> run_order_;
+  std::vector<std::pair<std::string, error::Code> > results_;
+};
+
+TEST_F(JobSchedulerTest, PriorityOrder) {
+  CreateScheduler();
+  AddJob("first", 0);
+  first_job_started_.Wait();
+
+  AddJob("low", 1);
+  AddJob("high", 5);
+  AddJob("low2", 1);
+  AddJob("negative", -1);
+  AddJob("high2", 5);
+  release_first_job_.Signal();
+  scheduler_->Close();
+
+  const char* kExpectedOrder[] = {"first", "high", "high2",
+                                  "low",   "low2", "negative"};
+  ASSERT_EQ(arraysize(kExpectedOrder), run_order_.size());
+  for (size_t i = 0; i < arraysize(kExpectedOrder); ++i)
+    EXPECT_EQ(kExpectedOrder[i], run_order_[i]);
+  ASSERT_EQ(arraysize(kExpectedOrder), results_.size());
+  for (size_t i = 0; i < results_.size(); ++i)
+    EXPECT_EQ(error::OK, results_[i].second) << results_[i].first;
+}
+
+TEST_F(JobSchedulerTest, CancelQueuedJob) {
+  CreateScheduler();
+  AddJob("first", 0);
+  first_job_started_.Wait();
+  AddJob("cancelled", 1);
+  AddJob("other", 0);
+
+  EXPECT_TRUE(scheduler_->CancelJob("cancelled"));
+  EXPECT_FALSE(scheduler_->CancelJob("unknown"));
+  release_first_job_.Signal();
+  scheduler_->Close();
+
+  // The cancelled job is not run, and completes when it is dequeued.
+  ASSERT_EQ(2u, run_order_.size());
+  EXPECT_EQ("first", run_order_[0]);
+  EXPECT_EQ("other", run_order_[1]);
+  ASSERT_EQ(3u, results_.size());
+  EXPECT_EQ("cancelled", results_[1].first);
+  EXPECT_EQ(error::CANCELLED, results_[1].second);
+  EXPECT_EQ(error::OK, results_[2].second);
+
+  // The completed jobs cannot be cancelled.
+  EXPECT_FALSE(scheduler_->CancelJob("first"));
+}
+
+TEST_F(JobSchedulerTest, CancelRunningJob) {
+  CreateScheduler();
+  AddJob("first", 0);
+  first_job_started_.Wait();
+  AddJob("next", 0);
+
+  // The running job stops without being released, and the next one runs.
+  EXPECT_TRUE(scheduler_->CancelJob("first"));
+  scheduler_->Close();
+
+  ASSERT_EQ(2u, results_.size());
+  EXPECT_EQ("first", results_[0].first);
+  EXPECT_EQ(error::CANCELLED, results_[0].second);
+  EXPECT_EQ("next", results_[1].first);
+  EXPECT_EQ(error::OK, results_[1].second);
+}
+
+}  // namespace media
+}  // namespace edash_packager
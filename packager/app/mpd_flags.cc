@@ -15,12 +15,44 @@ DEFINE_bool(output_media_info,
             "Create a human readable format of MediaInfo. The output file name "
             "will be the name specified by output flag, suffixed with "
             "'.media_info'. Exclusive with --mpd_output.");
+DEFINE_bool(binary_media_info,
+            false,
+            "Write the MediaInfo of --output_media_info in the binary "
+            "protobuf format instead of the human readable format. It is "
+            "smaller and faster to parse by mpd_generator.");
+DEFINE_bool(incremental_media_info,
+            false,
+            "With --output_media_info, also write the MediaInfo and the "
+            "subsegments of each output to a log suffixed with "
+            "'.media_info_log' as they complete, so that the MPD can be "
+            "published before the job ends. The log holds length-prefixed "
+            "MpdNotification records, as the MPD state log.");
 DEFINE_string(mpd_output, "",
               "MPD output file name. Exclusive with --output_media_info.");
+DEFINE_string(mpd_notification_receiver,
+              "",
+              "Address, as <host>:<port>, of the packager generating the MPD "
+              "with --mpd_notification_port. The MPD updates of the streams "
+              "are sent to it instead of generating an MPD, so that the "
+              "renditions of a live channel can be packaged on several "
+              "hosts. Exclusive with --mpd_output.");
+DEFINE_int32(mpd_notification_port,
+             0,
+             "TCP port on which to receive the MPD updates of the packagers "
+             "run with --mpd_notification_receiver, to list their streams "
+             "in --mpd_output too. The packager waits for them to end before "
+             "exiting. 0 to disable.");
 DEFINE_string(base_urls,
               "",
               "Comma separated BaseURLs for the MPD. The values will be added "
               "as <BaseURL> element(s) immediately under the <MPD> element.");
+DEFINE_int32(peak_bandwidth_window,
+             0,
+             "If positive, the bandwidth of a Representation without "
+             "user-specified bandwidth is the highest segment bitrate among "
+             "this many latest segments, instead of the average bitrate of "
+             "all the segments. Avoids under-reporting the bandwidth of live "
+             "streams with a varying bitrate.");
 DEFINE_double(min_buffer_time,
               2.0,
               "Specifies, in seconds, a common duration used in the definition "
@@ -48,3 +80,53 @@ DEFINE_bool(generate_dash_if_iop_compliant_mpd,
             "Try to generate DASH-IF IOPv3 compliant MPD. This is best effort "
             "and does not guarantee compliance. Off by default until players "
             "support IOP MPDs.");
+DEFINE_bool(use_streaming_mpd_writer,
+            false,
+            "Write the MPD straight into a string instead of building and "
+            "serializing a libxml2 tree. The output is the same, but "
+            "regenerating large live MPDs is cheaper.");
+DEFINE_int32(num_mpd_xml_threads,
+             0,
+             "If greater than 1, the streaming MPD writer serializes the "
+             "Representations of each AdaptationSet in parallel on this "
+             "many threads. The output is the same. Used only if "
+             "use_streaming_mpd_writer=true.");
+DEFINE_double(mpd_write_coalescing_window,
+              0.0,
+              "If positive, the manifests are written on a separate thread "
+              "and the updates received within this many seconds are "
+              "coalesced into a single write. If 0, the manifests are "
+              "written synchronously on every update.");
+DEFINE_string(mpd_patch_location,
+              "",
+              "If set, for live, an MPD Patch document which updates the "
+              "previous MPD to the new one is also written on each update, "
+              "so players can fetch it instead of the full MPD. This is its "
+              "URL relative to the MPD, which is also where it is written "
+              "relative to --mpd_output.");
+DEFINE_bool(segment_template_constant_duration,
+            false,
+            "For live with a $Number$ segment_template, describe the "
+            "segments with SegmentTemplate@duration instead of a "
+            "SegmentTimeline while they have a constant duration. Falls "
+            "back to SegmentTimeline if a segment drifts by more than half "
+            "a segment.");
+DEFINE_string(mpd_state_log,
+              "",
+              "If set, for live, the MPD updates are appended to this file, "
+              "and the MPD saved in it is restored on restart, so players "
+              "see the same timeline, segment numbers and "
+              "availabilityStartTime instead of a new presentation.");
+DEFINE_bool(mpd_batch_segment_notifications,
+            false,
+            "If true, for live, the segments with the same index of all the "
+            "Representations are added to the MPD together once the last of "
+            "them is complete, so the MPD is updated once per segment instead "
+            "of once per Representation.");
+DEFINE_bool(gzip_manifests,
+            false,
+            "If true, the MPDs and the HLS playlists are also written "
+            "gzip-compressed, next to them with a .gz extension, so that an "
+            "origin can serve them compressed without compressing them for "
+            "every request. Live manifests are compressed incrementally, "
+            "reusing the compression of their unchanged beginning.");
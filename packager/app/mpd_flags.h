@@ -12,13 +12,26 @@
 #include <gflags/gflags.h>
 
 DECLARE_bool(output_media_info);
+DECLARE_bool(binary_media_info);
+DECLARE_bool(incremental_media_info);
 DECLARE_string(mpd_output);
+DECLARE_string(mpd_notification_receiver);
+DECLARE_int32(mpd_notification_port);
 DECLARE_string(base_urls);
 DECLARE_double(availability_time_offset);
 DECLARE_double(minimum_update_period);
 DECLARE_double(min_buffer_time);
+DECLARE_int32(peak_bandwidth_window);
 DECLARE_double(time_shift_buffer_depth);
 DECLARE_double(suggested_presentation_delay);
 DECLARE_bool(generate_dash_if_iop_compliant_mpd);
+DECLARE_bool(use_streaming_mpd_writer);
+DECLARE_int32(num_mpd_xml_threads);
+DECLARE_double(mpd_write_coalescing_window);
+DECLARE_string(mpd_patch_location);
+DECLARE_bool(segment_template_constant_duration);
+DECLARE_string(mpd_state_log);
+DECLARE_bool(mpd_batch_segment_notifications);
+DECLARE_bool(gzip_manifests);
 
 #endif  // APP_MPD_FLAGS_H_
@@ -4,13 +4,18 @@
 // license that can be found in the LICENSE file or at
 // https://developers.google.com/open-source/licenses/bsd
 
+#include <algorithm>
+
 #include "packager/app/mpd_generator_flags.h"
 #include "packager/app/vlog_flags.h"
 #include "packager/base/at_exit.h"
 #include "packager/base/command_line.h"
 #include "packager/base/logging.h"
 #include "packager/base/strings/string_split.h"
+#include "packager/base/bind.h"
 #include "packager/base/strings/stringprintf.h"
+#include "packager/media/base/thread_pool.h"
+#include "packager/media/file/file.h"
 #include "packager/mpd/util/mpd_writer.h"
 #include "packager/version/version.h"
 
@@ -27,16 +32,32 @@ const char kUsage[] =
     "audio, and 1 text.\n"
     "Sample Usage:\n"
     "%s --input=\"video1.media_info,video2.media_info,audio1.media_info\" "
-    "--output=\"video_audio.mpd\"";
+    "--output=\"video_audio.mpd\"\n"
+    "Batch mode, generating several MPDs in one invocation:\n"
+    "%s --batch_input=mpds.txt\n"
+    "where each line of mpds.txt is of the form:\n"
+    "video_audio.mpd video1.media_info,video2.media_info,audio1.media_info\n"
+    "The MPDs are generated concurrently, see --num_threads. To regenerate "
+    "the MPDs of a whole catalog, --use_streaming_mpd_writer and "
+    "--mmap_media_info make each MPD cheaper.";
 
 enum ExitStatus {
   kSuccess = 0,
   kEmptyInputError,
   kEmptyOutputError,
-  kFailedToWriteMpdToFileError
+  kFailedToWriteMpdToFileError,
+  kFailedToReadBatchInputError,
 };
 
 ExitStatus CheckRequiredFlags() {
+  if (!FLAGS_batch_input.empty()) {
+    if (!FLAGS_input.empty() || !FLAGS_output.empty()) {
+      LOG(ERROR) << "--batch_input is exclusive with --input and --output.";
+      return kEmptyOutputError;
+    }
+    return kSuccess;
+  }
+
   if (FLAGS_input.empty()) {
     LOG(ERROR) << "--input is required.";
     return kEmptyInputError;
@@ -50,34 +71,95 @@ ExitStatus CheckRequiredFlags() {
   return kSuccess;
 }
 
-ExitStatus RunMpdGenerator() {
-  DCHECK_EQ(CheckRequiredFlags(), kSuccess);
-  std::vector<std::string> base_urls;
-  std::vector<std::string> input_files;
+// Generates |output| from the MediaInfo files listed in |input|, parsing them
+// on |thread_pool|.
+void GenerateMpd(const std::string& input,
+                 const std::string& output,
+                 const std::vector<std::string>& base_urls,
+                 media::ThreadPool* thread_pool,
+                 ExitStatus* status) {
   typedef std::vector<std::string>::const_iterator Iterator;
+  std::vector<std::string> input_files;
+  base::SplitString(input, ',', &input_files);
+
+  edash_packager::MpdWriter mpd_writer;
+  for (Iterator it = base_urls.begin(); it != base_urls.end(); ++it)
+    mpd_writer.AddBaseUrl(*it);
+
+  if (!mpd_writer.AddFiles(input_files, output, thread_pool)) {
+    LOG(WARNING) << "MpdWriter failed to read some of " << input
+                 << ", skipping them.";
+  }
 
-  base::SplitString(FLAGS_input, ',', &input_files);
+  if (!mpd_writer.WriteMpdToFile(output.c_str())) {
+    LOG(ERROR) << "Failed to write MPD to " << output;
+    *status = kFailedToWriteMpdToFileError;
+    return;
+  }
+  *status = kSuccess;
+}
 
+ExitStatus RunMpdGenerator() {
+  DCHECK_EQ(CheckRequiredFlags(), kSuccess);
+  std::vector<std::string> base_urls;
   if (!FLAGS_base_urls.empty()) {
     base::SplitString(FLAGS_base_urls, ',', &base_urls);
   }
 
-  edash_packager::MpdWriter mpd_writer;
-  for (Iterator it = base_urls.begin(); it != base_urls.end(); ++it)
-    mpd_writer.AddBaseUrl(*it);
+  media::ThreadPool thread_pool("MpdGenerator",
+                                std::max(FLAGS_num_threads, 0));
+  thread_pool.Start();
 
-  for (Iterator it = input_files.begin(); it != input_files.end(); ++it) {
-    if (!mpd_writer.AddFile(it->c_str(), FLAGS_output)) {
-      LOG(WARNING) << "MpdWriter failed to read " << *it << ", skipping.";
-    }
+  if (FLAGS_batch_input.empty()) {
+    ExitStatus status = kSuccess;
+    GenerateMpd(FLAGS_input, FLAGS_output, base_urls, &thread_pool, &status);
+    return status;
   }
 
-  if (!mpd_writer.WriteMpdToFile(FLAGS_output.c_str())) {
-    LOG(ERROR) << "Failed to write MPD to " << FLAGS_output;
-    return kFailedToWriteMpdToFileError;
+  std::string batch_input;
+  if (!media::File::ReadFileToString(FLAGS_batch_input.c_str(),
+                                     &batch_input)) {
+    LOG(ERROR) << "Failed to read " << FLAGS_batch_input;
+    return kFailedToReadBatchInputError;
+  }
+  std::vector<std::string> lines;
+  base::SplitString(batch_input, '\n', &lines);
+  std::vector<std::string> outputs;
+  std::vector<std::string> inputs;
+  for (const std::string& line : lines) {
+    if (line.empty())
+      continue;
+    const size_t separator = line.find(' ');
+    if (separator == std::string::npos) {
+      LOG(ERROR) << "Invalid line in " << FLAGS_batch_input << ": " << line;
+      return kFailedToReadBatchInputError;
+    }
+    outputs.push_back(line.substr(0, separator));
+    inputs.push_back(line.substr(separator + 1));
   }
 
-  return kSuccess;
+  // The MPDs are generated concurrently. The MediaInfo files of an MPD are
+  // parsed on the thread generating it, as it runs on the pool.
+  std::vector<ExitStatus> statuses(outputs.size(), kSuccess);
+  std::vector<base::Closure> tasks;
+  for (size_t i = 0; i < outputs.size(); ++i) {
+    tasks.push_back(base::Bind(&GenerateMpd, inputs[i], outputs[i],
+                               base_urls, &thread_pool, &statuses[i]));
+  }
+  thread_pool.RunTasksAndWait(tasks);
+
+  // A failed MPD does not stop the others; the first failure is returned.
+  ExitStatus first_failure = kSuccess;
+  size_t num_failures = 0;
+  for (ExitStatus status : statuses) {
+    if (status == kSuccess)
+      continue;
+    if (num_failures++ == 0)
+      first_failure = status;
+  }
+  LOG_IF(ERROR, num_failures > 0) << "Failed to write " << num_failures
+                                  << " of " << statuses.size() << " MPDs.";
+  return first_failure;
 }
 
 int MpdMain(int argc, char** argv) {
@@ -86,7 +168,7 @@ int MpdMain(int argc, char** argv) {
   base::CommandLine::Init(argc, argv);
   CHECK(logging::InitLogging(logging::LoggingSettings()));
 
-  google::SetUsageMessage(base::StringPrintf(kUsage, argv[0]));
+  google::SetUsageMessage(base::StringPrintf(kUsage, argv[0], argv[0]));
   google::ParseCommandLineFlags(&argc, &argv, true);
 
   ExitStatus status = CheckRequiredFlags();
@@ -15,4 +15,15 @@ DEFINE_string(base_urls,
               "",
               "Comma separated BaseURLs for the MPD. The values will be added "
               "as <BaseURL> element(s) immediately under the <MPD> element.");
+DEFINE_string(batch_input,
+              "",
+              "File listing the MPDs to generate, one per line, as the MPD "
+              "output file name followed by a space and the comma separated "
+              "list of its MediaInfo input files. Exclusive with --input and "
+              "--output.");
+DEFINE_int32(num_threads,
+             0,
+             "Number of threads reading and parsing the MediaInfo files and "
+             "generating the MPDs. If 0, one thread per available processor "
+             "is used.");
 #endif  // APP_MPD_GENERATOR_FLAGS_H_
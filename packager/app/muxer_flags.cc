@@ -38,6 +38,13 @@ DEFINE_bool(fragment_sap_aligned,
             true,
             "Force fragments to begin with stream access points. This flag "
             "implies segment_sap_aligned.");
+DEFINE_uint64(fragment_max_bytes,
+              0,
+              "Byte budget of the fragments of each stream. If non-zero, a "
+              "fragment reaching the budget ends at the next stream access "
+              "point, and fragments well under the budget are merged, "
+              "within the segments. 0 to end fragments on "
+              "fragment_duration only.");
 DEFINE_int32(num_subsegments_per_sidx,
              1,
              "For ISO BMFF only. Set the number of subsegments in each "
@@ -46,8 +53,62 @@ DEFINE_int32(num_subsegments_per_sidx,
              "subsegments in the root SIDX of the segment, with "
              "segment_duration/N/fragment_duration fragments per "
              "subsegment.");
+DEFINE_int32(num_encryption_threads,
+             0,
+             "Number of threads used to encrypt the samples of each fragment "
+             "(ISO BMFF) or of each batch of video samples (MPEG-2 TS "
+             "SAMPLE-AES) in parallel. If 0 or 1, samples are encrypted "
+             "serially as they are muxed.");
 DEFINE_string(temp_dir,
               "",
               "Specify a directory in which to store temporary (intermediate) "
-              " files. Used only if single_segment=true.");
-
+              "files. Used if single_segment=true and by "
+              "--sample_queue_memory_budget.");
+DEFINE_bool(single_segment_in_place,
+            false,
+            "Reserve space for the media header and the segment index at the "
+            "start of the output file and write the subsegments directly to "
+            "it. For ISO BMFF, this avoids writing them to a temporary file "
+            "first. For WebM, this places the Cues before the Clusters. Used "
+            "only if single_segment=true.");
+DEFINE_bool(low_latency_chunked_output,
+            false,
+            "For live profile only. Write every fragment to its segment as "
+            "soon as it is complete, as a CMAF chunk, so that clients can "
+            "fetch the segments in progress. The MPD signals this through "
+            "SegmentTemplate@availabilityTimeOffset. For ISO BMFF, implies "
+            "num_subsegments_per_sidx=-1. For WebM, the Clusters have an "
+            "unknown size and every block is flushed as soon as it is "
+            "muxed.");
+DEFINE_string(segment_checksum,
+              "",
+              "For multi-segment output only. Checksum of the segments, "
+              "computed as they are written: md5, sha256 or crc32c. It is "
+              "reported to the muxer listeners. Empty for no checksum.");
+DEFINE_bool(segment_checksum_files,
+            false,
+            "Write the checksum of every segment to a sidecar file named "
+            "after the segment with the checksum algorithm as extension, "
+            "e.g. segment1.m4s.md5, in the format of md5sum. Used only if "
+            "segment_checksum is set.");
+DEFINE_bool(open_segments_ahead,
+            false,
+            "For ISO BMFF and MPEG-2 TS multi-segment output with a "
+            "segment_template without $Time$. Open the file of the next "
+            "segment in the background while the current segment is "
+            "written, so that slow file creations, e.g. on network file "
+            "systems, do not delay live segments. An unused file opened "
+            "ahead is deleted; existing local files are not opened ahead.");
+DEFINE_bool(deduplicate_output,
+            false,
+            "For ISO BMFF output. Store the init segments and segments "
+            "identical to a file already written, e.g. the clear lead of "
+            "several encryption configurations, as hard links to that file. "
+            "Only local files are linked. Disables open_segments_ahead.");
+DEFINE_bool(streaming_output,
+            false,
+            "For ISO BMFF live profile output without segment_template. "
+            "Write the output forward only, without reopening or seeking "
+            "it: the init segment, then every segment, each preceded by its "
+            "sidx unless num_subsegments_per_sidx is negative. The output "
+            "can then be a named pipe or /dev/stdout.");
@@ -18,7 +18,16 @@ DECLARE_double(segment_duration);
 DECLARE_bool(segment_sap_aligned);
 DECLARE_double(fragment_duration);
 DECLARE_bool(fragment_sap_aligned);
+DECLARE_uint64(fragment_max_bytes);
 DECLARE_int32(num_subsegments_per_sidx);
+DECLARE_int32(num_encryption_threads);
 DECLARE_string(temp_dir);
+DECLARE_bool(single_segment_in_place);
+DECLARE_bool(low_latency_chunked_output);
+DECLARE_string(segment_checksum);
+DECLARE_bool(segment_checksum_files);
+DECLARE_bool(open_segments_ahead);
+DECLARE_bool(deduplicate_output);
+DECLARE_bool(streaming_output);
 
 #endif  // APP_MUXER_FLAGS_H_
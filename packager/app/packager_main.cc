@@ -5,10 +5,11 @@
 // https://developers.google.com/open-source/licenses/bsd
 
 #include <gflags/gflags.h>
-#include <iostream>
+
+#include <algorithm>
+#include <limits>
 
 #include "packager/app/fixed_key_encryption_flags.h"
-#include "packager/app/libcrypto_threading.h"
 #include "packager/app/mpd_flags.h"
 #include "packager/app/muxer_flags.h"
 #include "packager/app/packager_util.h"
@@ -16,29 +17,30 @@
 #include "packager/app/vlog_flags.h"
 #include "packager/app/widevine_encryption_flags.h"
 #include "packager/base/at_exit.h"
+#include "packager/base/bind.h"
 #include "packager/base/command_line.h"
 #include "packager/base/logging.h"
-#include "packager/base/stl_util.h"
+#include "packager/base/memory/ref_counted_memory.h"
+#include "packager/base/strings/string_number_conversions.h"
 #include "packager/base/strings/string_split.h"
 #include "packager/base/strings/stringprintf.h"
-#include "packager/base/threading/simple_thread.h"
+#include "packager/base/synchronization/waitable_event.h"
 #include "packager/base/time/clock.h"
-#include "packager/media/base/container_names.h"
-#include "packager/media/base/demuxer.h"
+#include "packager/base/trace_event/trace_event.h"
+#include "packager/media/base/async_log_sink.h"
+#include "packager/media/base/background_executor.h"
+#include "packager/media/base/closure_thread.h"
+#include "packager/media/base/cpu_affinity.h"
 #include "packager/media/base/fourccs.h"
+#include "packager/media/base/io_throttle.h"
 #include "packager/media/base/key_source.h"
-#include "packager/media/base/muxer_options.h"
-#include "packager/media/base/muxer_util.h"
-#include "packager/media/event/mpd_notify_muxer_listener.h"
-#include "packager/media/event/vod_media_info_dump_muxer_listener.h"
+#include "packager/media/base/large_buffer.h"
+#include "packager/media/base/memory_tracker.h"
+#include "packager/media/base/pipeline_metrics.h"
 #include "packager/media/file/file.h"
-#include "packager/media/formats/mp2t/ts_muxer.h"
-#include "packager/media/formats/mp4/mp4_muxer.h"
-#include "packager/media/formats/webm/webm_muxer.h"
-#include "packager/mpd/base/dash_iop_mpd_notifier.h"
-#include "packager/mpd/base/media_info.pb.h"
-#include "packager/mpd/base/mpd_builder.h"
-#include "packager/mpd/base/simple_mpd_notifier.h"
+#include "packager/media/file/local_file.h"
+#include "packager/media/file/manifest_sink.h"
+#include "packager/packager.h"
 #include "packager/version/version.h"
 
 DEFINE_bool(use_fake_clock_for_muxer,
@@ -46,6 +48,170 @@ DEFINE_bool(use_fake_clock_for_muxer,
             "Set to true to use a fake clock for muxer. With this flag set, "
             "creation time and modification time in outputs are set to 0. "
             "Should only be used for testing.");
+DEFINE_int32(num_worker_threads,
+             0,
+             "Number of worker threads used to run the remux jobs. If 0, one "
+             "thread per available processor is used. Jobs beyond the number "
+             "of worker threads are queued and run as threads become free.");
+DEFINE_int32(sample_channel_capacity,
+             0,
+             "If positive, samples of each stream are handed from the demuxer "
+             "to the muxer through a bounded channel of this many samples, so "
+             "muxing and encryption run in their own thread concurrently with "
+             "demuxing. 0 (default) muxes in the demuxing thread.");
+DEFINE_bool(mmap_input,
+            false,
+            "Set to true to memory map local input files instead of reading "
+            "them through buffered file reads. MP4 inputs are then parsed "
+            "directly from the mapped memory, without copying.");
+DEFINE_bool(random_access_input,
+            false,
+            "Set to true to read non-fragmented MP4 inputs by random access. "
+            "Only the samples of the streams being packaged are read, by "
+            "offset, using the sample tables. Ignored with --mmap_input.");
+DEFINE_string(media_index_cache_dir,
+              "",
+              "Directory keeping the indexes of the inputs read by random "
+              "access, see --random_access_input: the 'moov' box and the key "
+              "frame times of local MP4 inputs, keyed by their path, size and "
+              "modification time, so that inputs packaged again, e.g. for "
+              "other outputs, are not parsed again. Empty (default) for no "
+              "index cache.");
+DEFINE_bool(follow_input,
+            false,
+            "Set to true to package input files which are still being "
+            "written, e.g. live recordings in fragmented MP4 or MPEG-2 TS: "
+            "at the end of an input, the packager waits for more data until "
+            "the end marker of the input (see "
+            "--follow_input_end_marker_suffix) exists, or until the input "
+            "has not grown for --follow_input_idle_timeout_ms.");
+DEFINE_bool(cooperative_remux_jobs,
+            false,
+            "Set to true to run the remux jobs in slices on the worker "
+            "threads, yielding while their input has no data available, "
+            "instead of dedicating a worker to each job until it completes. "
+            "For many live inputs of low bitrate, e.g. with --follow_input or "
+            "UDP inputs, on few --num_worker_threads. The inputs are then "
+            "read without threaded I/O. Best with "
+            "--sample_channel_capacity=0.");
+DEFINE_double(sample_queue_memory_budget,
+              0,
+              "If positive, the memory budget, in megabytes, of the sample "
+              "data queued for each stream of an input, e.g. while the "
+              "demuxer waits for the samples of another stream of a badly "
+              "interleaved input. The samples past the budget are spilled "
+              "to a temporary file in --temp_dir and read back as they are "
+              "consumed. 0 (default) keeps all the queued samples in "
+              "memory.");
+DEFINE_double(max_parser_buffer_size,
+              0,
+              "If positive, the maximum size, in megabytes, of the input data "
+              "buffered by the parser of an input, e.g. while looking for the "
+              "end of an MP4 box or of an MPEG-2 TS access unit. Packaging "
+              "of the input fails past it. 0 (default) for no limit.");
+DEFINE_int32(max_boxes_per_moov,
+             0,
+             "If positive, the maximum number of boxes, nested boxes "
+             "included, in the 'moov' box of an MP4 input. Packaging of the "
+             "input fails past it. 0 (default) for no limit.");
+DEFINE_int64(max_parse_cpu_time_ms,
+             0,
+             "If positive, the maximum CPU time, in milliseconds, the parser "
+             "of an input may spend on one read of the input, not counting "
+             "the processing of the samples parsed. Packaging of the input "
+             "fails past it. 0 (default) for no limit.");
+DEFINE_int32(vod_parallel_splits,
+             0,
+             "If greater than 1, each non-fragmented MP4 input packaged to "
+             "segment_template based MP4 output is split at segment "
+             "boundaries into up to this many ranges, which are packaged in "
+             "parallel jobs. Ignored if the output is encrypted or the input "
+             "is decrypted.");
+DEFINE_string(checkpoint_file,
+              "",
+              "If set, the ranges packaged in parallel with "
+              "--vod_parallel_splits are recorded in this file as they "
+              "complete. If the packager is restarted with the same "
+              "arguments after a crash, it skips the ranges already "
+              "packaged, except the first range of every stream. The file "
+              "is deleted once packaging completes.");
+DEFINE_string(resource_report_output,
+              "",
+              "If set, a JSON report of the resources used by packaging is "
+              "written to this file when packaging ends: the CPU time of the "
+              "packaging threads, the time and bytes of the pipeline stages, "
+              "including the bytes encrypted, and the bytes read and written "
+              "per file.");
+DEFINE_string(cpu_set,
+              "",
+              "If set, the packager only runs on these CPUs, as a comma "
+              "separated list of CPUs, CPU ranges and NUMA nodes, e.g. "
+              "'0-7,16-23' or 'node:1'. Pinning the packager to a NUMA node "
+              "keeps its buffers in the memory of that node. If "
+              "--num_worker_threads is 0, one worker per CPU of the set is "
+              "used.");
+DEFINE_string(huge_pages,
+              "none",
+              "Huge page policy of the large, long-lived buffers of the "
+              "demuxers and of the I/O caches: 'none', 'transparent' for "
+              "transparent huge pages, or 'explicit' for the huge pages "
+              "reserved in /proc/sys/vm/nr_hugepages. Buffers fall back to "
+              "transparent huge pages, then to regular pages, when huge pages "
+              "are not available. The memory of the buffers by source is "
+              "exported in --metrics_output.");
+DEFINE_string(output_sync,
+              "none",
+              "Durability policy of the local output files: 'none' to leave "
+              "the data to the writeback of the kernel, 'segment' to sync "
+              "every segment to the disk, or 'close' to start the writeback "
+              "as the data is written and sync the files when they are "
+              "closed.");
+DEFINE_string(io_priority,
+              "live",
+              "I/O priority class of the job: 'live', whose reads and writes "
+              "are never delayed by --host_io_bandwidth, or 'batch', e.g. for "
+              "VOD, whose reads and writes use the host bandwidth left over "
+              "by the live jobs.");
+DEFINE_double(io_bandwidth_limit,
+              0,
+              "If positive, the I/O bandwidth budget of the job, in megabytes "
+              "per second, shared by its inputs and outputs.");
+DEFINE_double(host_io_bandwidth,
+              0,
+              "If positive, the I/O bandwidth of the host, in megabytes per "
+              "second, shared by all the jobs of the process, see "
+              "--io_priority. The bytes transferred and the time spent "
+              "waiting for the budgets are exported in the Prometheus "
+              "--metrics_output.");
+DEFINE_string(metrics_output,
+              "",
+              "If set, the metrics of the packaging pipeline stages (runs, "
+              "time spent and bytes processed) are written to this file every "
+              "--metrics_update_period seconds and when packaging ends.");
+DEFINE_string(metrics_format,
+              "prometheus",
+              "Format of --metrics_output: 'prometheus' for the Prometheus "
+              "text exposition format, e.g. for the node exporter textfile "
+              "collector, or 'json'.");
+DEFINE_double(metrics_update_period,
+              10.0,
+              "Interval, in seconds, between the writes of --metrics_output.");
+DEFINE_string(memory_soft_limits,
+              "",
+              "Comma separated soft limits on the memory used by the "
+              "packaging pipeline, as category=megabytes pairs, e.g. "
+              "'sample=512,io_cache=64'. The categories are sample, "
+              "stream_queue, demuxer_queue, fragmenter, io_cache, "
+              "mpd_segment_info and hls_entry. The demuxers pause, for a "
+              "bounded time, while any category is above its limit. The "
+              "memory usage is also exported in --metrics_output.");
+DEFINE_string(trace_output,
+              "",
+              "If set, trace events of the packaging threads (demuxing, "
+              "fragmenting, encryption, file writes, key fetches and waits on "
+              "the I/O caches) are recorded and written to this file in the "
+              "Chrome trace event JSON format when packaging ends. The file "
+              "can be loaded in chrome://tracing or Perfetto.");
 
 namespace {
 const char kUsage[] =
@@ -55,9 +221,12 @@ const char kUsage[] =
     "field_name=value,[field_name=value,]...\n"
     "Supported field names are as follows:\n"
     "  - input (in): Required input/source media file path or network stream\n"
-    "    URL.\n"
+    "    URL. An input split in chunks is the list of its files separated by\n"
+    "    '|', or a pattern where $Number$ is the chunk number, starting from\n"
+    "    1. The chunks are packaged as one timeline.\n"
     "  - stream_selector (stream): Required field with value 'audio',\n"
-    "    'video', or stream number (zero based).\n"
+    "    'video', 'program:<n>:audio' or 'program:<n>:video' for the streams\n"
+    "    of program <n> of a multi-program TS, or stream number (zero based).\n"
     "  - output (out): Required output file (single file) or initialization\n"
     "    file path (multiple file).\n"
     "  - segment_template (segment): Optional value which specifies the\n"
@@ -73,9 +242,25 @@ const char kUsage[] =
     "    metadata in the input track.\n"
     "  - output_format (format): Optional value which specifies the format\n"
     "    of the output files (MP4 or WebM).  If not specified, it will be\n"
-    "    derived from the file extension of the output file.\n";
-
-const char kMediaInfoSuffix[] = ".media_info";
+    "    derived from the file extension of the output file.\n"
+    "  - input_format: Optional value which specifies the format of the\n"
+    "    input (mp4, webm, ts, vtt, ttml or wvm). If not specified, it is\n"
+    "    determined from the first bytes of the input.\n"
+    "  - start_time (start): Optional time, in seconds, of the start of the\n"
+    "    range of the input to package. The range starts at the sync sample\n"
+    "    at or before it. Inputs parsed by random access skip the data\n"
+    "    before the range.\n"
+    "  - end_time (end): Optional time, in seconds, of the end of the range\n"
+    "    of the input to package. The input is not read past the range.\n"
+    "    The streams of an input should have the same range.\n"
+    "  - trick_play_factor (tpf): Optional value which specifies that the\n"
+    "    output is a trick play stream of the video input, with one in every\n"
+    "    trick_play_factor key frames. It is muxed from the same read of the\n"
+    "    input as the other streams, and listed as a trick mode\n"
+    "    AdaptationSet in the MPD and as an I-frame playlist in HLS.\n"
+    "  - mpd_output (mpd): Optional MPD the stream is listed in instead of\n"
+    "    --mpd_output, e.g. to package each program of a multi-program TS,\n"
+    "    read and parsed once, to an MPD of its own.\n";
 
 enum ExitStatus {
   kSuccess = 0,
@@ -84,43 +269,8 @@ enum ExitStatus {
   kInternalError,
 };
 
-// TODO(rkuroiwa): Write TTML and WebVTT parser (demuxing) for a better check
-// and for supporting live/segmenting (muxing).  With a demuxer and a muxer,
-// CreateRemuxJobs() shouldn't treat text as a special case.
-std::string DetermineTextFileFormat(const std::string& file) {
-  std::string content;
-  if (!edash_packager::media::File::ReadFileToString(file.c_str(), &content)) {
-    LOG(ERROR) << "Failed to open file " << file
-               << " to determine file format.";
-    return "";
-  }
-  edash_packager::media::MediaContainerName container_name =
-      edash_packager::media::DetermineContainer(
-          reinterpret_cast<const uint8_t*>(content.data()), content.size());
-  if (container_name == edash_packager::media::CONTAINER_WEBVTT) {
-    return "vtt";
-  } else if (container_name == edash_packager::media::CONTAINER_TTML) {
-    return "ttml";
-  }
-
-  return "";
-}
-
-edash_packager::media::FourCC GetProtectionScheme(
-    const std::string& protection_scheme) {
-  if (protection_scheme == "cenc") {
-    return edash_packager::media::FOURCC_cenc;
-  } else if (protection_scheme == "cens") {
-    return edash_packager::media::FOURCC_cens;
-  } else if (protection_scheme == "cbc1") {
-    return edash_packager::media::FOURCC_cbc1;
-  } else if (protection_scheme == "cbcs") {
-    return edash_packager::media::FOURCC_cbcs;
-  } else {
-    LOG(ERROR) << "Unknown protection scheme: " << protection_scheme;
-    return edash_packager::media::FOURCC_NULL;
-  }
-}
+// Size of the log buffer of each thread with --async_logging.
+const size_t kAsyncLogMessagesPerThread = 4096;
 
 }  // namespace
 
@@ -134,252 +284,131 @@ class FakeClock : public base::Clock {
   base::Time Now() override { return base::Time(); }
 };
 
-// Demux, Mux(es) and worker thread used to remux a source file/stream.
-class RemuxJob : public base::SimpleThread {
+// Writes the pipeline metrics to --metrics_output periodically on its own
+// thread, and a last time when destroyed.
+class MetricsWriter {
  public:
-  RemuxJob(scoped_ptr<Demuxer> demuxer)
-      : SimpleThread("RemuxJob"),
-        demuxer_(demuxer.Pass()) {}
-
-  ~RemuxJob() override {
-    STLDeleteElements(&muxers_);
+  MetricsWriter()
+      : stop_event_(true, false),
+        thread_("MetricsWriter",
+                base::Bind(&MetricsWriter::WriterLoop,
+                           base::Unretained(this))) {
+    thread_.Start();
   }
 
-  void AddMuxer(scoped_ptr<Muxer> mux) {
-    muxers_.push_back(mux.release());
+  ~MetricsWriter() {
+    stop_event_.Signal();
+    thread_.Join();
+    Write();
   }
 
-  Demuxer* demuxer() { return demuxer_.get(); }
-  Status status() { return status_; }
-
  private:
-  void Run() override {
-    DCHECK(demuxer_);
-    status_ = demuxer_->Run();
+  void WriterLoop() {
+    const base::TimeDelta period = base::TimeDelta::FromMicroseconds(
+        static_cast<int64_t>(FLAGS_metrics_update_period *
+                             base::Time::kMicrosecondsPerSecond));
+    while (!stop_event_.TimedWait(period))
+      Write();
   }
 
-  scoped_ptr<Demuxer> demuxer_;
-  std::vector<Muxer*> muxers_;
-  Status status_;
+  static void Write() {
+    std::string metrics;
+    if (FLAGS_metrics_format == "json") {
+      // Add the memory usage to the top level object of the stage metrics.
+      metrics = PipelineMetrics::ToJson();
+      DCHECK_EQ('}', metrics[metrics.size() - 1]);
+      metrics.insert(metrics.size() - 1,
+                     ",\"memory\":" + MemoryTracker::ToJson() +
+                         ",\"large_buffers\":" + LargeBuffer::ToJson() +
+                         ",\"background_queues\":" +
+                         BackgroundExecutor::ToJson());
+    } else {
+      metrics = PipelineMetrics::ToPrometheusText() +
+                MemoryTracker::ToPrometheusText() +
+                LargeBuffer::ToPrometheusText() +
+                IoThrottle::ToPrometheusText() +
+                BackgroundExecutor::ToPrometheusText();
+    }
+    if (!File::WriteFileAtomically(FLAGS_metrics_output.c_str(), metrics))
+      LOG(WARNING) << "Failed to write metrics to " << FLAGS_metrics_output;
+  }
+
+  base::WaitableEvent stop_event_;
+  ClosureThread thread_;
 
-  DISALLOW_COPY_AND_ASSIGN(RemuxJob);
+  DISALLOW_COPY_AND_ASSIGN(MetricsWriter);
 };
 
-bool StreamInfoToTextMediaInfo(const StreamDescriptor& stream_descriptor,
-                               const MuxerOptions& stream_muxer_options,
-                               MediaInfo* text_media_info) {
-  const std::string& language = stream_descriptor.language;
-  std::string format = DetermineTextFileFormat(stream_descriptor.input);
-  if (format.empty()) {
-    LOG(ERROR) << "Failed to determine the text file format for "
-               << stream_descriptor.input;
-    return false;
+// Records the "packager" trace events while alive, and writes them to
+// --trace_output when destroyed.
+class TraceWriter {
+ public:
+  TraceWriter() {
+    base::trace_event::TraceLog::GetInstance()->SetEnabled(
+        base::trace_event::TraceConfig("packager",
+                                       "record-as-much-as-possible"),
+        base::trace_event::TraceLog::RECORDING_MODE);
   }
 
-  if (!File::Copy(stream_descriptor.input.c_str(),
-                  stream_muxer_options.output_file_name.c_str())) {
-    LOG(ERROR) << "Failed to copy the input file (" << stream_descriptor.input
-               << ") to output file (" << stream_muxer_options.output_file_name
-               << ").";
-    return false;
+  ~TraceWriter() {
+    base::trace_event::TraceLog* trace_log =
+        base::trace_event::TraceLog::GetInstance();
+    trace_log->SetDisabled();
+    // The packaging threads have no message loop, so the events are flushed
+    // synchronously.
+    std::string events;
+    trace_log->Flush(base::Bind(&TraceWriter::AppendEvents, &events));
+    const std::string json = "{\"traceEvents\":[" + events + "]}";
+    if (!File::WriteFileAtomically(FLAGS_trace_output.c_str(), json))
+      LOG(WARNING) << "Failed to write trace events to " << FLAGS_trace_output;
   }
 
-  text_media_info->set_media_file_name(stream_muxer_options.output_file_name);
-  text_media_info->set_container_type(MediaInfo::CONTAINER_TEXT);
-
-  if (stream_muxer_options.bandwidth != 0) {
-    text_media_info->set_bandwidth(stream_muxer_options.bandwidth);
-  } else {
-    // Text files are usually small and since the input is one file; there's no
-    // way for the player to do ranged requests. So set this value to something
-    // reasonable.
-    text_media_info->set_bandwidth(256);
+ private:
+  // Appends a batch of comma-separated events to |events|.
+  static void AppendEvents(std::string* events,
+                           const scoped_refptr<base::RefCountedString>& batch,
+                           bool has_more_events) {
+    if (batch->data().empty())
+      return;
+    if (!events->empty())
+      *events += ",";
+    *events += batch->data();
   }
 
-  MediaInfo::TextInfo* text_info = text_media_info->mutable_text_info();
-  text_info->set_format(format);
-  if (!language.empty())
-    text_info->set_language(language);
-
-  return true;
-}
-
-scoped_ptr<Muxer> CreateOutputMuxer(const MuxerOptions& options,
-                                    MediaContainerName container) {
-  if (container == CONTAINER_WEBM) {
-    return scoped_ptr<Muxer>(new webm::WebMMuxer(options));
-  } else if (container == CONTAINER_MPEG2TS) {
-    return scoped_ptr<Muxer>(new mp2t::TsMuxer(options));
-  } else {
-    DCHECK_EQ(container, CONTAINER_MOV);
-    return scoped_ptr<Muxer>(new mp4::MP4Muxer(options));
-  }
-}
+  DISALLOW_COPY_AND_ASSIGN(TraceWriter);
+};
 
-bool CreateRemuxJobs(const StreamDescriptorList& stream_descriptors,
-                     const MuxerOptions& muxer_options,
-                     FakeClock* fake_clock,
-                     KeySource* key_source,
-                     MpdNotifier* mpd_notifier,
-                     std::vector<RemuxJob*>* remux_jobs) {
-  DCHECK(remux_jobs);
-
-  std::string previous_input;
-  for (StreamDescriptorList::const_iterator stream_iter =
-           stream_descriptors.begin();
-       stream_iter != stream_descriptors.end();
-       ++stream_iter) {
-    // Process stream descriptor.
-    MuxerOptions stream_muxer_options(muxer_options);
-    stream_muxer_options.output_file_name = stream_iter->output;
-    if (!stream_iter->segment_template.empty()) {
-      if (!ValidateSegmentTemplate(stream_iter->segment_template)) {
-        LOG(ERROR) << "ERROR: segment template with '"
-                   << stream_iter->segment_template << "' is invalid.";
-        return false;
-      }
-      stream_muxer_options.segment_template = stream_iter->segment_template;
-    }
-    stream_muxer_options.bandwidth = stream_iter->bandwidth;
-
-    // Handle text input.
-    if (stream_iter->stream_selector == "text") {
-      MediaInfo text_media_info;
-      if (!StreamInfoToTextMediaInfo(*stream_iter, stream_muxer_options,
-                                     &text_media_info)) {
-        return false;
-      }
-
-      if (mpd_notifier) {
-        uint32 unused;
-        if (!mpd_notifier->NotifyNewContainer(text_media_info, &unused)) {
-          LOG(ERROR) << "Failed to process text file " << stream_iter->input;
-        } else {
-          mpd_notifier->Flush();
-        }
-      } else if (FLAGS_output_media_info) {
-        VodMediaInfoDumpMuxerListener::WriteMediaInfoToFile(
-            text_media_info,
-            stream_muxer_options.output_file_name + kMediaInfoSuffix);
-      } else {
-        NOTIMPLEMENTED()
-            << "--mpd_output or --output_media_info flags are "
-               "required for text output. Skipping manifest related output for "
-            << stream_iter->input;
-      }
+// Sets the soft limits of MemoryTracker from --memory_soft_limits.
+bool SetMemorySoftLimits() {
+  std::vector<std::string> limits;
+  base::SplitString(FLAGS_memory_soft_limits, ',', &limits);
+  for (const std::string& limit : limits) {
+    if (limit.empty())
       continue;
+    const size_t separator = limit.find('=');
+    uint64_t megabytes = 0;
+    if (separator == std::string::npos ||
+        !base::StringToUint64(limit.substr(separator + 1), &megabytes)) {
+      LOG(ERROR) << "Invalid memory soft limit: " << limit;
+      return false;
     }
-
-    if (stream_iter->input != previous_input) {
-      // New remux job needed. Create demux and job thread.
-      scoped_ptr<Demuxer> demuxer(new Demuxer(stream_iter->input));
-      if (FLAGS_enable_widevine_decryption ||
-          FLAGS_enable_fixed_key_decryption) {
-        scoped_ptr<KeySource> key_source(CreateDecryptionKeySource());
-        if (!key_source)
-          return false;
-        demuxer->SetKeySource(key_source.Pass());
-      }
-      Status status = demuxer->Initialize();
-      if (!status.ok()) {
-        LOG(ERROR) << "Demuxer failed to initialize: " << status.ToString();
-        return false;
-      }
-      if (FLAGS_dump_stream_info) {
-        printf("\nFile \"%s\":\n", stream_iter->input.c_str());
-        DumpStreamInfo(demuxer->streams());
-        if (stream_iter->output.empty())
-          continue;  // just need stream info.
-      }
-      remux_jobs->push_back(new RemuxJob(demuxer.Pass()));
-      previous_input = stream_iter->input;
-    }
-    DCHECK(!remux_jobs->empty());
-
-    MediaContainerName output_format = stream_iter->output_format;
-    if (output_format == CONTAINER_UNKNOWN) {
-      output_format =
-          DetermineContainerFromFileName(stream_muxer_options.output_file_name);
-
-      if (output_format == CONTAINER_UNKNOWN) {
-        LOG(ERROR) << "Unable to determine output format for file "
-                   << stream_muxer_options.output_file_name;
-        return false;
-      }
-    }
-
-    scoped_ptr<Muxer> muxer(
-        CreateOutputMuxer(stream_muxer_options, output_format));
-    if (FLAGS_use_fake_clock_for_muxer) muxer->set_clock(fake_clock);
-
-    if (key_source) {
-      muxer->SetKeySource(key_source,
-                          FLAGS_max_sd_pixels,
-                          FLAGS_clear_lead,
-                          FLAGS_crypto_period_duration,
-                          GetProtectionScheme(FLAGS_protection_scheme));
-    }
-
-    scoped_ptr<MuxerListener> muxer_listener;
-    DCHECK(!(FLAGS_output_media_info && mpd_notifier));
-    if (FLAGS_output_media_info) {
-      const std::string output_media_info_file_name =
-          stream_muxer_options.output_file_name + kMediaInfoSuffix;
-      scoped_ptr<VodMediaInfoDumpMuxerListener>
-          vod_media_info_dump_muxer_listener(
-              new VodMediaInfoDumpMuxerListener(output_media_info_file_name));
-      muxer_listener = vod_media_info_dump_muxer_listener.Pass();
-    }
-    if (mpd_notifier) {
-      scoped_ptr<MpdNotifyMuxerListener> mpd_notify_muxer_listener(
-          new MpdNotifyMuxerListener(mpd_notifier));
-      muxer_listener = mpd_notify_muxer_listener.Pass();
+    const std::string category_name = limit.substr(0, separator);
+    int category = 0;
+    while (category < kNumMemoryCategories &&
+           category_name != MemoryTracker::GetCategoryName(
+                                static_cast<MemoryCategory>(category))) {
+      ++category;
     }
-
-    if (muxer_listener)
-      muxer->SetMuxerListener(muxer_listener.Pass());
-
-    if (!AddStreamToMuxer(remux_jobs->back()->demuxer()->streams(),
-                          stream_iter->stream_selector,
-                          stream_iter->language,
-                          muxer.get()))
+    if (category == kNumMemoryCategories) {
+      LOG(ERROR) << "Unknown memory category: " << category_name;
       return false;
-    remux_jobs->back()->AddMuxer(muxer.Pass());
+    }
+    MemoryTracker::SetSoftLimit(static_cast<MemoryCategory>(category),
+                                megabytes * 1024 * 1024);
   }
-
   return true;
 }
 
-Status RunRemuxJobs(const std::vector<RemuxJob*>& remux_jobs) {
-  // Start the job threads.
-  for (std::vector<RemuxJob*>::const_iterator job_iter = remux_jobs.begin();
-       job_iter != remux_jobs.end();
-       ++job_iter) {
-    (*job_iter)->Start();
-  }
-
-  // Wait for all jobs to complete or an error occurs.
-  Status status;
-  bool all_joined;
-  do {
-    all_joined = true;
-    for (std::vector<RemuxJob*>::const_iterator job_iter = remux_jobs.begin();
-         job_iter != remux_jobs.end();
-         ++job_iter) {
-      if ((*job_iter)->HasBeenJoined()) {
-        status = (*job_iter)->status();
-        if (!status.ok())
-          break;
-      } else {
-        all_joined = false;
-        (*job_iter)->Join();
-      }
-    }
-  } while (!all_joined && status.ok());
-
-  return status;
-}
-
 bool RunPackager(const StreamDescriptorList& stream_descriptors) {
   const FourCC protection_scheme = GetProtectionScheme(FLAGS_protection_scheme);
   if (protection_scheme == FOURCC_NULL)
@@ -387,27 +416,90 @@ bool RunPackager(const StreamDescriptorList& stream_descriptors) {
 
   if (!AssignFlagsFromProfile())
     return false;
+  if (!AssignFlagsFromMemoryBudget())
+    return false;
+
+  if (FLAGS_num_worker_threads < 0) {
+    LOG(ERROR) << "--num_worker_threads should not be negative.";
+    return false;
+  }
+  if (FLAGS_metrics_format != "prometheus" && FLAGS_metrics_format != "json") {
+    LOG(ERROR) << "Unknown metrics format: " << FLAGS_metrics_format;
+    return false;
+  }
+  if (!FLAGS_metrics_output.empty() && FLAGS_metrics_update_period <= 0) {
+    LOG(ERROR) << "--metrics_update_period should be positive.";
+    return false;
+  }
 
-  if (FLAGS_output_media_info && !FLAGS_mpd_output.empty()) {
-    NOTIMPLEMENTED() << "ERROR: --output_media_info and --mpd_output do not "
-                        "work together.";
+  if (!SetMemorySoftLimits())
+    return false;
+
+  LargeBufferSource huge_page_policy;
+  if (!LargeBuffer::ParseHugePagePolicy(FLAGS_huge_pages, &huge_page_policy)) {
+    LOG(ERROR) << "Unknown huge page policy: " << FLAGS_huge_pages;
     return false;
   }
-  if (FLAGS_output_media_info && !FLAGS_single_segment) {
-    // TODO(rkuroiwa, kqyang): Support partial media info dump for live.
-    NOTIMPLEMENTED() << "ERROR: --output_media_info is only supported if "
-                        "--single_segment is true.";
+  LargeBuffer::SetHugePagePolicy(huge_page_policy);
+
+  LocalFileSyncPolicy sync_policy;
+  if (!LocalFile::ParseSyncPolicy(FLAGS_output_sync, &sync_policy)) {
+    LOG(ERROR) << "Unknown output sync policy: " << FLAGS_output_sync;
     return false;
   }
+  LocalFile::SetSyncPolicy(sync_policy);
+  FileManifestSink::SetGzipManifests(FLAGS_gzip_manifests);
 
-  // Get basic muxer options.
-  MuxerOptions muxer_options;
-  if (!GetMuxerOptions(&muxer_options))
+  IoPriority io_priority;
+  if (!IoThrottle::ParseIoPriority(FLAGS_io_priority, &io_priority)) {
+    LOG(ERROR) << "Unknown I/O priority: " << FLAGS_io_priority;
     return false;
+  }
+  if (FLAGS_host_io_bandwidth > 0) {
+    IoThrottle::SetHostBandwidth(
+        static_cast<uint64_t>(FLAGS_host_io_bandwidth * 1024 * 1024));
+  }
 
-  MpdOptions mpd_options;
-  if (!GetMpdOptions(&mpd_options))
+  // Pins this thread first, so that all the threads of the packager, which
+  // inherit its CPUs, are pinned too.
+  std::vector<int> cpu_set;
+  if (!FLAGS_cpu_set.empty() && (!ParseCpuSet(FLAGS_cpu_set, &cpu_set) ||
+                                 !SetCurrentThreadAffinity(cpu_set))) {
+    LOG(ERROR) << "Failed to run on --cpu_set " << FLAGS_cpu_set;
     return false;
+  }
+  size_t num_worker_threads = FLAGS_num_worker_threads;
+  if (num_worker_threads == 0 && !cpu_set.empty())
+    num_worker_threads = cpu_set.size();
+
+  // Started before the key source, so that the key fetches are traced.
+  scoped_ptr<TraceWriter> trace_writer;
+  if (!FLAGS_trace_output.empty())
+    trace_writer.reset(new TraceWriter);
+
+  // Created first as it sets up libcrypto, which is used by the key sources.
+  Packager packager(num_worker_threads);
+
+  PackagingParams params;
+  if (!GetMuxerOptions(&params.muxer_options))
+    return false;
+  if (!GetMpdOptions(&params.mpd_options))
+    return false;
+  params.mpd_output = FLAGS_mpd_output;
+  params.mpd_notification_receiver = FLAGS_mpd_notification_receiver;
+  if (FLAGS_mpd_notification_port < 0 ||
+      FLAGS_mpd_notification_port > std::numeric_limits<uint16_t>::max()) {
+    LOG(ERROR) << "Invalid --mpd_notification_port.";
+    return false;
+  }
+  params.mpd_notification_port = FLAGS_mpd_notification_port;
+  base::SplitString(FLAGS_base_urls, ',', &params.base_urls);
+  params.generate_dash_if_iop_compliant_mpd =
+      FLAGS_generate_dash_if_iop_compliant_mpd;
+  params.output_media_info = FLAGS_output_media_info;
+  params.binary_media_info = FLAGS_binary_media_info;
+  params.incremental_media_info = FLAGS_incremental_media_info;
+  params.dump_stream_info = FLAGS_dump_stream_info;
 
   // Create encryption key source if needed.
   scoped_ptr<KeySource> encryption_key_source;
@@ -416,36 +508,54 @@ bool RunPackager(const StreamDescriptorList& stream_descriptors) {
     if (!encryption_key_source)
       return false;
   }
-
-  scoped_ptr<MpdNotifier> mpd_notifier;
-  if (!FLAGS_mpd_output.empty()) {
-    DashProfile profile =
-        FLAGS_single_segment ? kOnDemandProfile : kLiveProfile;
-    std::vector<std::string> base_urls;
-    base::SplitString(FLAGS_base_urls, ',', &base_urls);
-    if (FLAGS_generate_dash_if_iop_compliant_mpd) {
-      mpd_notifier.reset(new DashIopMpdNotifier(profile, mpd_options, base_urls,
-                                                FLAGS_mpd_output));
-    } else {
-      mpd_notifier.reset(new SimpleMpdNotifier(profile, mpd_options, base_urls,
-                                               FLAGS_mpd_output));
-    }
-    if (!mpd_notifier->Init()) {
-      LOG(ERROR) << "MpdNotifier failed to initialize.";
-      return false;
-    }
+  params.encryption_key_source = encryption_key_source.get();
+  params.max_sd_pixels = FLAGS_max_sd_pixels;
+  params.clear_lead_in_seconds = FLAGS_clear_lead;
+  params.crypto_period_duration_in_seconds = FLAGS_crypto_period_duration;
+  params.protection_scheme = protection_scheme;
+  if (FLAGS_enable_widevine_decryption || FLAGS_enable_fixed_key_decryption) {
+    params.decryption_key_source_factory =
+        base::Bind(&CreateDecryptionKeySource);
   }
 
-  std::vector<RemuxJob*> remux_jobs;
-  STLElementDeleter<std::vector<RemuxJob*> > scoped_jobs_deleter(&remux_jobs);
-  FakeClock fake_clock;
-  if (!CreateRemuxJobs(stream_descriptors, muxer_options, &fake_clock,
-                       encryption_key_source.get(), mpd_notifier.get(),
-                       &remux_jobs)) {
-    return false;
+  params.mmap_input = FLAGS_mmap_input;
+  params.random_access_input = FLAGS_random_access_input;
+  params.media_index_cache_dir = FLAGS_media_index_cache_dir;
+  params.follow_input = FLAGS_follow_input;
+  params.cooperative_remux_jobs = FLAGS_cooperative_remux_jobs;
+  params.sample_channel_capacity = FLAGS_sample_channel_capacity;
+  params.vod_parallel_splits = FLAGS_vod_parallel_splits;
+  if (FLAGS_sample_queue_memory_budget > 0) {
+    params.sample_queue_memory_budget =
+        static_cast<uint64_t>(FLAGS_sample_queue_memory_budget * 1024 * 1024);
+  }
+  if (FLAGS_max_parser_buffer_size > 0) {
+    params.parser_limits.max_buffered_bytes =
+        static_cast<uint64_t>(FLAGS_max_parser_buffer_size * 1024 * 1024);
+  }
+  params.parser_limits.max_boxes_per_moov =
+      std::max(FLAGS_max_boxes_per_moov, 0);
+  params.parser_limits.max_parse_cpu_time = base::TimeDelta::FromMilliseconds(
+      std::max<int64_t>(FLAGS_max_parse_cpu_time_ms, 0));
+  params.checkpoint_file = FLAGS_checkpoint_file;
+  params.resource_report_file = FLAGS_resource_report_output;
+  params.cpu_set = cpu_set;
+  params.io_priority = io_priority;
+  if (FLAGS_io_bandwidth_limit > 0) {
+    params.io_bytes_per_second =
+        static_cast<uint64_t>(FLAGS_io_bandwidth_limit * 1024 * 1024);
   }
+  FakeClock fake_clock;
+  if (FLAGS_use_fake_clock_for_muxer)
+    params.clock = &fake_clock;
+
+  scoped_ptr<MetricsWriter> metrics_writer;
+  if (!FLAGS_metrics_output.empty())
+    metrics_writer.reset(new MetricsWriter);
 
-  Status status = RunRemuxJobs(remux_jobs);
+  Status status = packager.Run(params, stream_descriptors);
+  // Write the final metrics, even if packaging failed.
+  metrics_writer.reset();
   if (!status.ok()) {
     LOG(ERROR) << "Packaging Error: " << status.ToString();
     return false;
@@ -454,7 +564,6 @@ bool RunPackager(const StreamDescriptorList& stream_descriptors) {
   printf("Packaging completed successfully.\n");
   return true;
 }
-
 int PackagerMain(int argc, char** argv) {
   base::AtExitManager exit;
   // Needed to enable VLOG/DVLOG through --vmodule or --v.
@@ -473,7 +582,14 @@ int PackagerMain(int argc, char** argv) {
   if (!ValidateWidevineCryptoFlags() || !ValidateFixedCryptoFlags())
     return kArgumentValidationFailed;
 
-  edash_packager::media::LibcryptoThreading libcrypto_threading;
+  scoped_ptr<AsyncLogSink> async_log_sink;
+  if (FLAGS_async_logging) {
+    async_log_sink.reset(new AsyncLogSink(kAsyncLogMessagesPerThread,
+                                          FLAGS_log_rate_limit,
+                                          AsyncLogSink::StderrWriteCallback()));
+    async_log_sink->Install();
+  }
+
   // TODO(tinskip): Make InsertStreamDescriptor a member of
   // StreamDescriptorList.
   StreamDescriptorList stream_descriptors;
@@ -0,0 +1,272 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+//
+// A long-running packager which packages the jobs read from a job queue file,
+// typically a named pipe or standard input, one job per line. The libcrypto
+// setup, the worker threads, the key source and its connections to the key
+// server are set up once and shared by all the jobs, instead of once per
+// process as with the packager binary.
+
+#include <gflags/gflags.h>
+#include <stdio.h>
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "packager/app/fixed_key_encryption_flags.h"
+#include "packager/app/job_scheduler.h"
+#include "packager/app/mpd_flags.h"
+#include "packager/app/muxer_flags.h"
+#include "packager/app/packager_util.h"
+#include "packager/app/stream_descriptor.h"
+#include "packager/app/vlog_flags.h"
+#include "packager/app/widevine_encryption_flags.h"
+#include "packager/base/at_exit.h"
+#include "packager/base/bind.h"
+#include "packager/base/command_line.h"
+#include "packager/base/logging.h"
+#include "packager/base/strings/string_split.h"
+#include "packager/base/strings/stringprintf.h"
+#include "packager/media/base/async_log_sink.h"
+#include "packager/media/base/io_throttle.h"
+#include "packager/media/base/key_source.h"
+#include "packager/media/file/manifest_sink.h"
+#include "packager/packager.h"
+#include "packager/version/version.h"
+
+namespace {
+const char kUsage[] =
+    "Packaging server.\n\n"
+    "Usage: %s [flags]\n\n"
+    "Reads packaging jobs from --job_queue, one per line:\n"
+    "  <job_id> <priority> <mpd_output> [cpu_set=<cpus>]\n"
+    "      [io_priority=<io_priority>] [io_bandwidth=<megabytes_per_second>]\n"
+    "      [resource_report=<file>] <stream_descriptor> ...\n"
+    "  - job_id identifies the job in the results.\n"
+    "  - priority is an integer. Jobs with higher priorities are started\n"
+    "    first; jobs with the same priority are started in order.\n"
+    "  - mpd_output is the MPD to generate, or '-' for none.\n"
+    "  - cpus are the CPUs to run the job on, e.g. 'node:0' for the CPUs of\n"
+    "    NUMA node 0, or '0-7,16-23'. The job runs on any CPU by default.\n"
+    "  - io_priority is 'live', the default, or 'batch', e.g. for VOD jobs,\n"
+    "    which use the --host_io_bandwidth left over by the live jobs.\n"
+    "  - io_bandwidth is the I/O bandwidth budget of the job. Unlimited by\n"
+    "    default.\n"
+    "  - file is where the JSON report of the resources used by the job,\n"
+    "    CPU time, stage times and bytes per file, is written when the job\n"
+    "    ends.\n"
+    "  - stream_descriptor is as accepted by the packager binary.\n"
+    "A line 'cancel <job_id>' cancels the job, queued or running. A running\n"
+    "job stops within milliseconds and releases its threads and memory.\n"
+    "The other packaging options are set by the flags of the server and are\n"
+    "common to all the jobs. The result of each job is printed on a line of\n"
+    "standard output when the job completes:\n"
+    "  <job_id> OK\n"
+    "  <job_id> ERROR <message>\n";
+
+enum ExitStatus {
+  kSuccess = 0,
+  kArgumentValidationFailed,
+  kServerError,
+};
+
+// Size of the log buffer of each thread with --async_logging.
+const size_t kAsyncLogMessagesPerThread = 4096;
+}  // namespace
+
+DEFINE_string(job_queue,
+              "-",
+              "File the jobs are read from, e.g. a named pipe. '-' reads the "
+              "jobs from standard input. The server exits once all the jobs "
+              "have been read and completed.");
+DEFINE_int32(max_concurrent_jobs,
+             4,
+             "Maximum number of jobs packaged concurrently. The other jobs "
+             "are queued by priority.");
+DEFINE_int32(num_worker_threads,
+             0,
+             "Number of worker threads shared by the remux jobs of all the "
+             "jobs. If 0, one thread per available processor is used.");
+DEFINE_double(host_io_bandwidth,
+              0,
+              "If positive, the I/O bandwidth of the host, in megabytes per "
+              "second, shared by the jobs: the batch jobs use the bandwidth "
+              "left over by the live jobs.");
+DEFINE_double(shared_input_replay_buffer_size,
+              0,
+              "If positive, the jobs packaging the same input concurrently, "
+              "e.g. a DASH and an HLS job, demux it once: a job starting "
+              "while another job demuxes one of its inputs joins that "
+              "demuxer and gets the samples demuxed so far from a replay "
+              "buffer of at most this many megabytes. Once the buffer "
+              "overflows, the jobs starting read the input themselves.");
+
+namespace edash_packager {
+namespace media {
+namespace {
+
+// Runs |job| with |default_params| for the options which are not set per job.
+Status RunJob(Packager* packager,
+              const PackagingParams& default_params,
+              const Job& job) {
+  PackagingParams params = default_params;
+  params.mpd_output = job.mpd_output;
+  params.cpu_set = job.cpu_set;
+  params.io_priority = job.io_priority;
+  params.io_bytes_per_second = job.io_bytes_per_second;
+  params.resource_report_file = job.resource_report_file;
+  params.cancellation_token = job.cancellation_token;
+  return packager->Run(params, job.stream_descriptors);
+}
+
+void PrintJobResult(const std::string& job_id, const Status& status) {
+  const std::string result =
+      status.ok() ? job_id + " OK" : job_id + " ERROR " + status.ToString();
+  // A single call so that the results of concurrent jobs do not interleave.
+  printf("%s\n", result.c_str());
+  fflush(stdout);
+}
+
+int RunServer() {
+  const FourCC protection_scheme = GetProtectionScheme(FLAGS_protection_scheme);
+  if (protection_scheme == FOURCC_NULL)
+    return kArgumentValidationFailed;
+  if (!AssignFlagsFromProfile())
+    return kArgumentValidationFailed;
+  if (!AssignFlagsFromMemoryBudget())
+    return kArgumentValidationFailed;
+  if (FLAGS_num_worker_threads < 0 || FLAGS_max_concurrent_jobs <= 0) {
+    LOG(ERROR) << "--num_worker_threads should not be negative and "
+                  "--max_concurrent_jobs should be positive.";
+    return kArgumentValidationFailed;
+  }
+  if (FLAGS_output_media_info) {
+    LOG(ERROR) << "--output_media_info is not supported by the server.";
+    return kArgumentValidationFailed;
+  }
+
+  if (FLAGS_host_io_bandwidth > 0) {
+    IoThrottle::SetHostBandwidth(
+        static_cast<uint64_t>(FLAGS_host_io_bandwidth * 1024 * 1024));
+  }
+  FileManifestSink::SetGzipManifests(FLAGS_gzip_manifests);
+
+  // Created first as it sets up libcrypto, which is used by the key sources.
+  Packager packager(FLAGS_num_worker_threads);
+
+  PackagingParams params;
+  if (!GetMuxerOptions(&params.muxer_options) ||
+      !GetMpdOptions(&params.mpd_options)) {
+    return kArgumentValidationFailed;
+  }
+  base::SplitString(FLAGS_base_urls, ',', &params.base_urls);
+  params.generate_dash_if_iop_compliant_mpd =
+      FLAGS_generate_dash_if_iop_compliant_mpd;
+  if (FLAGS_shared_input_replay_buffer_size > 0) {
+    params.shared_input_replay_buffer_size = static_cast<uint64_t>(
+        FLAGS_shared_input_replay_buffer_size * 1024 * 1024);
+  }
+
+  // The key source is shared by all the jobs, so its connections to the key
+  // server and its key cache stay warm.
+  scoped_ptr<KeySource> encryption_key_source;
+  if (FLAGS_enable_widevine_encryption || FLAGS_enable_fixed_key_encryption) {
+    encryption_key_source = CreateEncryptionKeySource();
+    if (!encryption_key_source)
+      return kServerError;
+  }
+  params.encryption_key_source = encryption_key_source.get();
+  params.max_sd_pixels = FLAGS_max_sd_pixels;
+  params.clear_lead_in_seconds = FLAGS_clear_lead;
+  params.crypto_period_duration_in_seconds = FLAGS_crypto_period_duration;
+  params.protection_scheme = protection_scheme;
+  if (FLAGS_enable_widevine_decryption || FLAGS_enable_fixed_key_decryption) {
+    params.decryption_key_source_factory =
+        base::Bind(&CreateDecryptionKeySource);
+  }
+
+  std::ifstream job_file;
+  std::istream* job_queue = &std::cin;
+  if (FLAGS_job_queue != "-") {
+    job_file.open(FLAGS_job_queue.c_str());
+    if (!job_file.is_open()) {
+      LOG(ERROR) << "Cannot open job queue " << FLAGS_job_queue;
+      return kServerError;
+    }
+    job_queue = &job_file;
+  }
+
+  JobScheduler scheduler(base::Bind(&RunJob, &packager, params),
+                         base::Bind(&PrintJobResult),
+                         FLAGS_max_concurrent_jobs);
+  uint64_t sequence_number = 0;
+  std::string line;
+  while (std::getline(*job_queue, line)) {
+    if (line.find_first_not_of(" \t\r") == std::string::npos)
+      continue;
+    std::vector<std::string> tokens;
+    base::SplitStringAlongWhitespace(line, &tokens);
+    if (tokens.size() == 2 && tokens[0] == "cancel") {
+      if (!scheduler.CancelJob(tokens[1])) {
+        printf("%s ERROR No queued or running job to cancel.\n",
+               tokens[1].c_str());
+        fflush(stdout);
+      }
+      continue;
+    }
+    scoped_ptr<Job> job(new Job);
+    job->sequence_number = sequence_number++;
+    std::string error;
+    if (!ParseJob(line, job.get(), &error)) {
+      printf("%s ERROR %s\n", job->id.empty() ? "-" : job->id.c_str(),
+             error.c_str());
+      fflush(stdout);
+      continue;
+    }
+    scheduler.AddJob(job.release());
+  }
+  scheduler.Close();
+  return kSuccess;
+}
+
+int PackagerServerMain(int argc, char** argv) {
+  base::AtExitManager exit;
+  // Needed to enable VLOG/DVLOG through --vmodule or --v.
+  base::CommandLine::Init(argc, argv);
+  CHECK(logging::InitLogging(logging::LoggingSettings()));
+
+  google::SetUsageMessage(base::StringPrintf(kUsage, argv[0]));
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  if (argc > 1) {
+    std::string version_string =
+        base::StringPrintf("edash-packager version %s", kPackagerVersion);
+    google::ShowUsageWithFlags(version_string.c_str());
+    return kArgumentValidationFailed;
+  }
+
+  if (!ValidateWidevineCryptoFlags() || !ValidateFixedCryptoFlags())
+    return kArgumentValidationFailed;
+
+  scoped_ptr<AsyncLogSink> async_log_sink;
+  if (FLAGS_async_logging) {
+    async_log_sink.reset(new AsyncLogSink(kAsyncLogMessagesPerThread,
+                                          FLAGS_log_rate_limit,
+                                          AsyncLogSink::StderrWriteCallback()));
+    async_log_sink->Install();
+  }
+
+  return RunServer();
+}
+
+}  // namespace
+}  // namespace media
+}  // namespace edash_packager
+
+int main(int argc, char** argv) {
+  return edash_packager::media::PackagerServerMain(argc, argv);
+}
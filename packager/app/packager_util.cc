@@ -7,6 +7,7 @@
 #include "packager/app/packager_util.h"
 
 #include <gflags/gflags.h>
+#include <algorithm>
 #include <iostream>
 
 #include "packager/app/fixed_key_encryption_flags.h"
@@ -15,8 +16,11 @@
 #include "packager/app/widevine_encryption_flags.h"
 #include "packager/base/logging.h"
 #include "packager/base/strings/string_number_conversions.h"
+#include "packager/base/strings/string_split.h"
+#include "packager/media/base/demuxer.h"
 #include "packager/media/base/fixed_key_source.h"
 #include "packager/media/base/media_stream.h"
+#include "packager/media/base/memory_tracker.h"
 #include "packager/media/base/muxer.h"
 #include "packager/media/base/muxer_options.h"
 #include "packager/media/base/request_signer.h"
@@ -26,6 +30,15 @@
 #include "packager/mpd/base/mpd_builder.h"
 
 DEFINE_bool(dump_stream_info, false, "Dump demuxed stream info.");
+DEFINE_double(memory_budget,
+              0,
+              "If positive, the memory budget of the packager, in megabytes, "
+              "e.g. on edge nodes with little memory. The demuxer buffers, "
+              "the I/O caches, the fragment sizes and the sample queues left "
+              "at their default sizes are scaled down to it, and the "
+              "demuxers pause while the samples or the I/O caches in memory "
+              "are over their share of the budget. Flags set explicitly, "
+              "--memory_soft_limits included, take precedence.");
 DEFINE_bool(override_version_string,
             false,
             "Override packager version string in the generated outputs with "
@@ -76,17 +89,33 @@ scoped_ptr<RequestSigner> CreateSigner() {
   return signer.Pass();
 }
 
+namespace {
+
+void SetBackupServerUrls(WidevineKeySource* widevine_key_source) {
+  if (FLAGS_key_server_backup_urls.empty())
+    return;
+  std::vector<std::string> backup_server_urls;
+  base::SplitString(FLAGS_key_server_backup_urls, ',', &backup_server_urls);
+  widevine_key_source->set_backup_server_urls(backup_server_urls);
+}
+
+}  // namespace
+
 scoped_ptr<KeySource> CreateEncryptionKeySource() {
   scoped_ptr<KeySource> encryption_key_source;
   if (FLAGS_enable_widevine_encryption) {
     scoped_ptr<WidevineKeySource> widevine_key_source(
         new WidevineKeySource(FLAGS_key_server_url, FLAGS_include_common_pssh));
+    SetBackupServerUrls(widevine_key_source.get());
     if (!FLAGS_signer.empty()) {
       scoped_ptr<RequestSigner> request_signer(CreateSigner());
       if (!request_signer)
         return scoped_ptr<KeySource>();
       widevine_key_source->set_signer(request_signer.Pass());
     }
+    if (FLAGS_key_prefetch_window > 0)
+      widevine_key_source->set_key_prefetch_window(FLAGS_key_prefetch_window);
+    widevine_key_source->set_key_cache_dir(FLAGS_key_cache_dir);
 
     std::vector<uint8_t> content_id;
     if (!base::HexStringToBytes(FLAGS_content_id, &content_id)) {
@@ -112,6 +141,7 @@ scoped_ptr<KeySource> CreateDecryptionKeySource() {
   if (FLAGS_enable_widevine_decryption) {
     scoped_ptr<WidevineKeySource> widevine_key_source(
         new WidevineKeySource(FLAGS_key_server_url, FLAGS_include_common_pssh));
+    SetBackupServerUrls(widevine_key_source.get());
     if (!FLAGS_signer.empty()) {
       scoped_ptr<RequestSigner> request_signer(CreateSigner());
       if (!request_signer)
@@ -129,6 +159,21 @@ scoped_ptr<KeySource> CreateDecryptionKeySource() {
   return decryption_key_source.Pass();
 }
 
+FourCC GetProtectionScheme(const std::string& protection_scheme) {
+  if (protection_scheme == "cenc") {
+    return FOURCC_cenc;
+  } else if (protection_scheme == "cens") {
+    return FOURCC_cens;
+  } else if (protection_scheme == "cbc1") {
+    return FOURCC_cbc1;
+  } else if (protection_scheme == "cbcs") {
+    return FOURCC_cbcs;
+  } else {
+    LOG(ERROR) << "Unknown protection scheme: " << protection_scheme;
+    return FOURCC_NULL;
+  }
+}
+
 bool AssignFlagsFromProfile() {
   bool single_segment = FLAGS_single_segment;
   if (FLAGS_profile == "on-demand") {
@@ -149,6 +194,66 @@ bool AssignFlagsFromProfile() {
   return true;
 }
 
+namespace {
+
+const uint64_t kKB = 1024;
+const uint64_t kMB = 1024 * 1024;
+
+uint64_t Clamp(uint64_t value, uint64_t min_value, uint64_t max_value) {
+  return std::max(min_value, std::min(value, max_value));
+}
+
+// Sets flag |name| to |value| if it is at its default. Flags which are not
+// defined by the program are ignored.
+void AssignFlagFromMemoryBudget(const char* name, const std::string& value) {
+  google::CommandLineFlagInfo flag_info;
+  if (!google::GetCommandLineFlagInfo(name, &flag_info) ||
+      !flag_info.is_default || flag_info.current_value == value) {
+    return;
+  }
+  google::SetCommandLineOption(name, value.c_str());
+  fprintf(stdout, "Memory budget %g MB: set --%s to %s.\n",
+          FLAGS_memory_budget, name, value.c_str());
+}
+
+}  // namespace
+
+bool AssignFlagsFromMemoryBudget() {
+  if (FLAGS_memory_budget < 0) {
+    fprintf(stderr, "ERROR: --memory_budget should not be negative.\n");
+    return false;
+  }
+  if (FLAGS_memory_budget == 0)
+    return true;
+  const uint64_t budget = static_cast<uint64_t>(FLAGS_memory_budget * kMB);
+
+  // A job holds a demuxer buffer and an I/O cache per input and output file,
+  // and tens of jobs may run concurrently. The sizes are only lowered.
+  const uint64_t io_cache_size = Clamp(budget / 64, kMB, 32 * kMB);
+  AssignFlagFromMemoryBudget("io_cache_size",
+                             base::Uint64ToString(io_cache_size));
+  AssignFlagFromMemoryBudget(
+      "io_block_size",
+      base::Uint64ToString(Clamp(io_cache_size / 8, 64 * kKB, 2 * kMB)));
+  AssignFlagFromMemoryBudget(
+      "demuxer_buffer_size",
+      base::Uint64ToString(Clamp(budget / 512, 64 * kKB, 2 * kMB)));
+  // Bounds the samples buffered by the fragmenters, which otherwise hold
+  // whole fragments.
+  AssignFlagFromMemoryBudget(
+      "fragment_max_bytes",
+      base::Uint64ToString(Clamp(budget / 128, 256 * kKB, 16 * kMB)));
+  // Spills the samples queued for badly interleaved inputs to disk instead
+  // of queuing up to thousands of samples per stream in memory.
+  AssignFlagFromMemoryBudget(
+      "sample_queue_memory_budget",
+      base::DoubleToString(FLAGS_memory_budget / 64));
+
+  MemoryTracker::SetSoftLimit(kSampleMemory, budget / 2);
+  MemoryTracker::SetSoftLimit(kIoCacheMemory, budget / 4);
+  return true;
+}
+
 bool GetMuxerOptions(MuxerOptions* muxer_options) {
   DCHECK(muxer_options);
 
@@ -157,8 +262,31 @@ bool GetMuxerOptions(MuxerOptions* muxer_options) {
   muxer_options->fragment_duration = FLAGS_fragment_duration;
   muxer_options->segment_sap_aligned = FLAGS_segment_sap_aligned;
   muxer_options->fragment_sap_aligned = FLAGS_fragment_sap_aligned;
+  muxer_options->fragment_max_bytes = FLAGS_fragment_max_bytes;
   muxer_options->num_subsegments_per_sidx = FLAGS_num_subsegments_per_sidx;
+  muxer_options->num_encryption_threads = FLAGS_num_encryption_threads;
   muxer_options->temp_dir = FLAGS_temp_dir;
+  muxer_options->single_segment_in_place = FLAGS_single_segment_in_place;
+  if (FLAGS_low_latency_chunked_output && FLAGS_single_segment) {
+    LOG(ERROR) << "--low_latency_chunked_output requires multi-segment "
+                  "output.";
+    return false;
+  }
+  muxer_options->low_latency_chunked_output = FLAGS_low_latency_chunked_output;
+  if (!SegmentChecksum::ParseAlgorithm(FLAGS_segment_checksum,
+                                       &muxer_options->segment_checksum)) {
+    LOG(ERROR) << "--segment_checksum '" << FLAGS_segment_checksum
+               << "' is not supported.";
+    return false;
+  }
+  muxer_options->write_segment_checksum_files = FLAGS_segment_checksum_files;
+  muxer_options->open_segments_ahead = FLAGS_open_segments_ahead;
+  muxer_options->deduplicate_output = FLAGS_deduplicate_output;
+  if (FLAGS_streaming_output && FLAGS_single_segment) {
+    LOG(ERROR) << "--streaming_output requires multi-segment output.";
+    return false;
+  }
+  muxer_options->streaming_output = FLAGS_streaming_output;
   if (FLAGS_override_version_string)
     muxer_options->packager_version_string = FLAGS_test_version_string;
   return true;
@@ -173,6 +301,17 @@ bool GetMpdOptions(MpdOptions* mpd_options) {
   mpd_options->time_shift_buffer_depth = FLAGS_time_shift_buffer_depth;
   mpd_options->suggested_presentation_delay =
       FLAGS_suggested_presentation_delay;
+  mpd_options->use_streaming_mpd_writer = FLAGS_use_streaming_mpd_writer;
+  mpd_options->num_xml_threads = FLAGS_num_mpd_xml_threads;
+  mpd_options->mpd_write_coalescing_window =
+      FLAGS_mpd_write_coalescing_window;
+  mpd_options->peak_bandwidth_window = FLAGS_peak_bandwidth_window;
+  mpd_options->mpd_patch_location = FLAGS_mpd_patch_location;
+  mpd_options->segment_template_constant_duration =
+      FLAGS_segment_template_constant_duration;
+  mpd_options->mpd_state_log = FLAGS_mpd_state_log;
+  mpd_options->batch_segment_notifications =
+      FLAGS_mpd_batch_segment_notifications;
   if (FLAGS_override_version_string)
     mpd_options->packager_version_string = FLAGS_test_version_string;
   return true;
@@ -194,14 +333,44 @@ MediaStream* FindFirstAudioStream(const std::vector<MediaStream*>& streams) {
   return FindFirstStreamOfType(streams, kStreamAudio);
 }
 
-bool AddStreamToMuxer(const std::vector<MediaStream*>& streams,
-                      const std::string& stream_selector,
-                      const std::string& language_override,
-                      Muxer* muxer) {
-  DCHECK(muxer);
+// Selects the first stream of a type of a program of a multi-program input,
+// e.g. an MPEG-2 TS multiplex. |program_selector| is
+// "<program_number>:audio" or "<program_number>:video".
+MediaStream* SelectProgramStream(const std::vector<MediaStream*>& streams,
+                                 const std::string& program_selector) {
+  const size_t separator = program_selector.find(':');
+  uint32_t program_number = 0;
+  if (separator == std::string::npos ||
+      !base::StringToUint(program_selector.substr(0, separator),
+                          &program_number)) {
+    return NULL;
+  }
+  const std::string type = program_selector.substr(separator + 1);
+  StreamType stream_type;
+  if (type == "audio")
+    stream_type = kStreamAudio;
+  else if (type == "video")
+    stream_type = kStreamVideo;
+  else
+    return NULL;
+  for (MediaStream* stream : streams) {
+    if (stream->info()->program_number() == program_number &&
+        stream->info()->stream_type() == stream_type) {
+      return stream;
+    }
+  }
+  return NULL;
+}
 
+MediaStream* SelectStream(const std::vector<MediaStream*>& streams,
+                          const std::string& stream_selector) {
+  const std::string kProgramPrefix = "program:";
   MediaStream* stream = NULL;
-  if (stream_selector == "video") {
+  if (stream_selector.compare(0, kProgramPrefix.size(), kProgramPrefix) ==
+      0) {
+    stream = SelectProgramStream(streams,
+                                 stream_selector.substr(kProgramPrefix.size()));
+  } else if (stream_selector == "video") {
     stream = FindFirstVideoStream(streams);
   } else if (stream_selector == "audio") {
     stream = FindFirstAudioStream(streams);
@@ -211,24 +380,39 @@ bool AddStreamToMuxer(const std::vector<MediaStream*>& streams,
     if (!base::StringToSizeT(stream_selector, &stream_id) ||
         stream_id >= streams.size()) {
       LOG(ERROR) << "Invalid argument --stream=" << stream_selector << "; "
-                 << "should be 'audio', 'video', or a number within [0, "
+                 << "should be 'audio', 'video', 'program:<n>:audio', "
+                 << "'program:<n>:video', or a number within [0, "
                  << streams.size() - 1 << "].";
-      return false;
+      return NULL;
     }
     stream = streams[stream_id];
     DCHECK(stream);
   }
 
-  // This could occur only if stream_selector=audio|video and the corresponding
-  // stream does not exist in the input.
-  if (!stream) {
+  // This could occur only if stream_selector=audio|video, or a program
+  // selector, and the corresponding stream does not exist in the input.
+  if (!stream)
     LOG(ERROR) << "No " << stream_selector << " stream found in the input.";
+  return stream;
+}
+
+bool AddStreamToMuxer(const std::vector<MediaStream*>& streams,
+                      const std::string& stream_selector,
+                      const std::string& language_override,
+                      Muxer* muxer) {
+  DCHECK(muxer);
+
+  MediaStream* stream = SelectStream(streams, stream_selector);
+  if (!stream)
     return false;
-  }
 
-  if (!language_override.empty()) {
-    stream->info()->set_language(language_override);
-  }
+  // The stream already feeds another muxer, e.g. for a differently encrypted
+  // rendition. Fan it out instead of parsing the input again.
+  if (stream->muxer())
+    stream = stream->demuxer()->CreateFanOutStream(stream);
+
+  if (!language_override.empty())
+    stream->OverrideLanguage(language_override);
 
   muxer->AddStream(stream);
   return true;
@@ -14,8 +14,10 @@
 #include <vector>
 
 #include "packager/base/memory/scoped_ptr.h"
+#include "packager/media/base/fourccs.h"
 
 DECLARE_bool(dump_stream_info);
+DECLARE_double(memory_budget);
 
 namespace edash_packager {
 
@@ -43,15 +45,37 @@ scoped_ptr<KeySource> CreateEncryptionKeySource();
 ///         is not required.
 scoped_ptr<KeySource> CreateDecryptionKeySource();
 
+/// Convert a --protection_scheme value to its FourCC.
+/// @return The FourCC of @a protection_scheme, or FOURCC_NULL if it is not a
+///         known protection scheme.
+FourCC GetProtectionScheme(const std::string& protection_scheme);
+
 /// Set flags according to profile.
 bool AssignFlagsFromProfile();
 
+/// Scale the buffer, cache and queue size flags left at their default to
+/// --memory_budget, and set the memory soft limits from it, so the demuxers
+/// pause while the pipeline is over budget.
+bool AssignFlagsFromMemoryBudget();
+
 /// Fill MuxerOptions members using provided command line options.
 bool GetMuxerOptions(MuxerOptions* muxer_options);
 
 /// Fill MpdOptions members using provided command line options.
 bool GetMpdOptions(edash_packager::MpdOptions* mpd_options);
 
+/// Select a stream from a provided set.
+/// @param streams contains the set of MediaStreams from which to select.
+/// @param stream_selector is a string containing one of the following values:
+///        "audio" to select the first audio track, "video" to select the first
+///        video track, "program:<n>:audio" or "program:<n>:video" to select
+///        the first audio or video track of program <n> of a multi-program
+///        input, e.g. an MPEG-2 TS multiplex, or a decimal number indicating
+///        which track number to select (start at "1").
+/// @return The selected stream, or NULL if there is no such stream.
+MediaStream* SelectStream(const std::vector<MediaStream*>& streams,
+                          const std::string& stream_selector);
+
 /// Select and add a stream from a provided set to a muxer.
 /// @param streams contains the set of MediaStreams from which to select.
 /// @param stream_selector is a string containing one of the following values:
@@ -26,6 +26,11 @@ enum FieldType {
   kBandwidthField,
   kLanguageField,
   kOutputFormatField,
+  kInputFormatField,
+  kStartTimeField,
+  kEndTimeField,
+  kTrickPlayFactorField,
+  kMpdOutputField,
 };
 
 struct FieldNameToTypeMapping {
@@ -50,6 +55,15 @@ const FieldNameToTypeMapping kFieldNameTypeMappings[] = {
   { "lang", kLanguageField },
   { "output_format", kOutputFormatField },
   { "format", kOutputFormatField },
+  { "input_format", kInputFormatField },
+  { "start_time", kStartTimeField },
+  { "start", kStartTimeField },
+  { "end_time", kEndTimeField },
+  { "end", kEndTimeField },
+  { "trick_play_factor", kTrickPlayFactorField },
+  { "tpf", kTrickPlayFactorField },
+  { "mpd_output", kMpdOutputField },
+  { "mpd", kMpdOutputField },
 };
 
 FieldType GetFieldType(const std::string& field_name) {
@@ -63,7 +77,12 @@ FieldType GetFieldType(const std::string& field_name) {
 }  // anonymous namespace
 
 StreamDescriptor::StreamDescriptor()
-    : bandwidth(0), output_format(CONTAINER_UNKNOWN) {}
+    : bandwidth(0),
+      output_format(CONTAINER_UNKNOWN),
+      input_format(CONTAINER_UNKNOWN),
+      start_time(0),
+      end_time(0),
+      trick_play_factor(0) {}
 
 StreamDescriptor::~StreamDescriptor() {}
 
@@ -117,13 +136,50 @@ bool InsertStreamDescriptor(const std::string& descriptor_string,
       case kOutputFormatField: {
         MediaContainerName output_format =
             DetermineContainerFromFormatName(iter->second);
-        if (output_format == CONTAINER_UNKNOWN) {
+        if (output_format != CONTAINER_MOV &&
+            output_format != CONTAINER_WEBM &&
+            output_format != CONTAINER_MPEG2TS) {
           LOG(ERROR) << "Unrecognized output format " << iter->second;
           return false;
         }
         descriptor.output_format = output_format;
         break;
       }
+      case kInputFormatField: {
+        MediaContainerName input_format =
+            DetermineContainerFromFormatName(iter->second);
+        if (input_format == CONTAINER_UNKNOWN) {
+          LOG(ERROR) << "Unrecognized input format " << iter->second;
+          return false;
+        }
+        descriptor.input_format = input_format;
+        break;
+      }
+      case kStartTimeField:
+      case kEndTimeField: {
+        double time;
+        if (!base::StringToDouble(iter->second, &time) || time < 0) {
+          LOG(ERROR) << "Invalid " << iter->first << " " << iter->second;
+          return false;
+        }
+        if (GetFieldType(iter->first) == kStartTimeField)
+          descriptor.start_time = time;
+        else
+          descriptor.end_time = time;
+        break;
+      }
+      case kTrickPlayFactorField: {
+        unsigned factor;
+        if (!base::StringToUint(iter->second, &factor) || factor == 0) {
+          LOG(ERROR) << "Invalid trick_play_factor " << iter->second;
+          return false;
+        }
+        descriptor.trick_play_factor = factor;
+        break;
+      }
+      case kMpdOutputField:
+        descriptor.mpd_output = iter->second;
+        break;
       default:
         LOG(ERROR) << "Unknown field in stream descriptor (\"" << iter->first
                    << "\").";
@@ -144,6 +200,20 @@ bool InsertStreamDescriptor(const std::string& descriptor_string,
     LOG(ERROR) << "Stream output not specified.";
     return false;
   }
+  if (descriptor.end_time > 0 && descriptor.end_time <= descriptor.start_time) {
+    LOG(ERROR) << "Stream end_time should be after start_time.";
+    return false;
+  }
+  // The streams of an input are demuxed together, so they share the range.
+  StreamDescriptorList::const_iterator same_input =
+      descriptor_list->find(descriptor);
+  if (same_input != descriptor_list->end() &&
+      (same_input->start_time != descriptor.start_time ||
+       same_input->end_time != descriptor.end_time)) {
+    LOG(ERROR) << "The streams of input " << descriptor.input
+               << " should have the same start_time and end_time.";
+    return false;
+  }
   descriptor_list->insert(descriptor);
   return true;
 }
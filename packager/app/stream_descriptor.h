@@ -30,6 +30,19 @@ struct StreamDescriptor {
   uint32_t bandwidth;
   std::string language;
   MediaContainerName output_format;
+  MediaContainerName input_format;
+  /// The range of the input to package, in seconds. The range starts at the
+  /// sync sample at or before |start_time|. |end_time| is zero to package to
+  /// the end of the input.
+  double start_time;
+  double end_time;
+  /// If positive, the output is a trick play stream with one in every
+  /// |trick_play_factor| key frames of the video input.
+  uint32_t trick_play_factor;
+  /// If set, the MPD the stream is listed in, instead of the MPD of the job,
+  /// e.g. to package each program of a multi-program TS, demultiplexed in a
+  /// single pass, to an MPD of its own.
+  std::string mpd_output;
 };
 
 class StreamDescriptorCompareFn {
@@ -24,3 +24,13 @@ DEFINE_string(
     "? and * in the glob pattern match any single or sequence of characters "
     "respectively including slashes. "
     "<log level> overrides any value given by --v.");
+DEFINE_bool(async_logging,
+            false,
+            "Queue the log messages below ERROR severity in per-thread "
+            "buffers written by a background thread, so that verbose "
+            "logging does not slow down the packaging threads. Messages "
+            "logged while a buffer is full are dropped.");
+DEFINE_int32(log_rate_limit,
+             100,
+             "With async_logging, the number of messages a logging statement "
+             "may log per second on a thread. Specify 0 for no limit.");
@@ -11,5 +11,7 @@
 
 DECLARE_int32(v);
 DECLARE_string(vmodule);
+DECLARE_bool(async_logging);
+DECLARE_int32(log_rate_limit);
 
 #endif  // APP_VLOG_FLAGS_H_
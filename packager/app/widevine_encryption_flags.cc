@@ -30,6 +30,12 @@ DEFINE_bool(include_common_pssh,
             "https://goo.gl/507mKp");
 DEFINE_string(key_server_url, "", "Key server url. Required for encryption and "
               "decryption");
+DEFINE_string(key_server_backup_urls,
+              "",
+              "Comma separated urls of backup key servers, optional. A key "
+              "request which the key server is slow to answer is also sent "
+              "to a backup server, and the retries of failed requests go to "
+              "the server with the fewest recent failures.");
 DEFINE_string(content_id, "", "Content Id (hex).");
 DEFINE_string(policy,
               "",
@@ -55,6 +61,17 @@ DEFINE_int32(crypto_period_duration,
              0,
              "Crypto period duration in seconds. If it is non-zero, key "
              "rotation is enabled.");
+DEFINE_int32(key_prefetch_window,
+             0,
+             "With key rotation, the number of crypto periods to fetch keys "
+             "for ahead of the period being encrypted. If 0, the keys of half "
+             "a key request (5 crypto periods) are prefetched.");
+DEFINE_string(key_cache_dir,
+              "",
+              "Optional local directory to cache the Widevine key server "
+              "responses in, so packager instances packaging the same content "
+              "share the keys instead of requesting them again. The keys are "
+              "stored in the clear; restrict access to the directory.");
 DEFINE_string(protection_scheme,
               "cenc",
               "Choose protection scheme, 'cenc' or 'cbc1' or pattern-based "
@@ -163,6 +180,11 @@ bool ValidateWidevineCryptoFlags() {
     PrintError("--crypto_period_duration should not be negative.");
     success = false;
   }
+
+  if (FLAGS_key_prefetch_window < 0) {
+    PrintError("--key_prefetch_window should not be negative.");
+    success = false;
+  }
   return success;
 }
 
@@ -15,6 +15,7 @@ DECLARE_bool(enable_widevine_encryption);
 DECLARE_bool(enable_widevine_decryption);
 DECLARE_bool(include_common_pssh);
 DECLARE_string(key_server_url);
+DECLARE_string(key_server_backup_urls);
 DECLARE_string(content_id);
 DECLARE_string(policy);
 DECLARE_int32(max_sd_pixels);
@@ -23,6 +24,8 @@ DECLARE_string(aes_signing_key);
 DECLARE_string(aes_signing_iv);
 DECLARE_string(rsa_signing_key_path);
 DECLARE_int32(crypto_period_duration);
+DECLARE_int32(key_prefetch_window);
+DECLARE_string(key_cache_dir);
 DECLARE_string(protection_scheme);
 
 namespace edash_packager {
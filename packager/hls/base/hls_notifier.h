@@ -13,6 +13,11 @@
 #include "packager/mpd/base/media_info.pb.h"
 
 namespace edash_packager {
+
+namespace media {
+struct TimedMetadataEvent;
+}  // namespace media
+
 namespace hls {
 
 // TODO(rkuroiwa): Consider merging this with MpdNotifier.
@@ -50,13 +55,52 @@ class HlsNotifier {
   // |start_time| is the start time of the segment in terms of timescale passed
   // in |media_info|.
   // |duration| is also in terms of timescale.
+  // |start_byte_offset| is the offset of the segment in the file, which is
+  // not 0 if all the segments are in one file.
   // |size| is the size in bytes.
   virtual bool NotifyNewSegment(uint32_t stream_id,
                                 const std::string& segment_name,
                                 uint64_t start_time,
                                 uint64_t duration,
+                                uint64_t start_byte_offset,
                                 uint64_t size) = 0;
 
+  /// Notifies a key frame of the next segment, so that the segments can also
+  /// be listed as I-frames. It must be called before NotifyNewSegment() for
+  /// the segment containing the key frame.
+  /// @param stream_id is the value set by NotifyNewStream().
+  /// @param timestamp is the timestamp of the key frame in terms of timescale
+  ///        passed in |media_info|.
+  /// @param start_byte_offset is the offset of the key frame in the file of
+  ///        the segment.
+  /// @param size is the size of the key frame in bytes.
+  virtual bool NotifyKeyFrame(uint32_t stream_id,
+                              uint64_t timestamp,
+                              uint64_t start_byte_offset,
+                              uint64_t size) = 0;
+
+  /// Notifies a timed metadata event of the stream, e.g. an SCTE-35 ad break.
+  /// It must be called before NotifyNewSegment() for the segment containing
+  /// the event.
+  /// @param stream_id is the value set by NotifyNewStream().
+  /// @param event is the event, timed in its own timescale.
+  virtual bool NotifyTimedMetadata(uint32_t stream_id,
+                                   const media::TimedMetadataEvent& event) = 0;
+
+  /// Same as NotifyNewSegment(), but for a part of a segment being written,
+  /// for Low-Latency HLS. The segment itself is notified once complete.
+  /// @param stream_id is the value set by NotifyNewStream().
+  /// @param segment_name is the name of the segment of the part.
+  /// @param start_time is the start time of the part in terms of timescale
+  ///        passed in |media_info|.
+  /// @param duration is also in terms of timescale.
+  /// @param size is the size in bytes.
+  virtual bool NotifyNewPart(uint32_t stream_id,
+                             const std::string& segment_name,
+                             uint64_t start_time,
+                             uint64_t duration,
+                             uint64_t size) = 0;
+
   /// @param stream_id is the value set by NotifyNewStream().
   /// @param key_id is the key ID for the stream.
   /// @param system_id is the DRM system ID in e.g. PSSH boxes. For example this
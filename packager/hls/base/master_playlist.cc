@@ -12,18 +12,36 @@
 #include <list>
 #include <map>
 #include <set>
+#include <vector>
 
+#include "packager/base/bind.h"
 #include "packager/base/strings/string_number_conversions.h"
 #include "packager/base/strings/stringprintf.h"
 #include "packager/hls/base/media_playlist.h"
-#include "packager/media/file/file.h"
-#include "packager/media/file/file_closer.h"
+#include "packager/media/base/thread_pool.h"
 
 namespace edash_packager {
 namespace hls {
 
+namespace {
+
+// Playlists are mostly written to network file systems, where the writes are
+// latency bound.
+const size_t kMaxConcurrentPlaylistWrites = 8;
+
+void WriteMediaPlaylist(MediaPlaylist* playlist,
+                        const std::string& file_path,
+                        uint64_t version,
+                        media::ManifestSink* sink,
+                        bool* result) {
+  *result = playlist->WriteToSink(file_path, version, sink);
+  LOG_IF(ERROR, !*result) << "Failed to write playlist " << file_path;
+}
+
+}  // namespace
+
 MasterPlaylist::MasterPlaylist(const std::string& file_name)
-    : file_name_(file_name) {}
+    : file_name_(file_name), manifest_sink_(&file_sink_) {}
 MasterPlaylist::~MasterPlaylist() {}
 
 void MasterPlaylist::AddMediaPlaylist(MediaPlaylist* media_playlist) {
@@ -32,11 +50,6 @@ void MasterPlaylist::AddMediaPlaylist(MediaPlaylist* media_playlist) {
 
 bool MasterPlaylist::WriteAllPlaylists(const std::string& base_url,
                                        const std::string& output_dir) {
-  if (!WriteMasterPlaylist(base_url, output_dir)) {
-    LOG(ERROR) << "Failed to write master playlist.";
-    return false;
-  }
-
   double longest_segment_duration = 0.0;
   if (!has_set_playlist_target_duration_) {
     for (const MediaPlaylist* playlist : media_playlists_) {
@@ -47,6 +60,9 @@ bool MasterPlaylist::WriteAllPlaylists(const std::string& base_url,
     }
   }
 
+  std::vector<MediaPlaylist*> dirty_playlists;
+  std::vector<std::string> file_paths;
+  std::vector<uint64_t> versions;
   for (MediaPlaylist* playlist : media_playlists_) {
     std::string file_path = output_dir + playlist->file_name();
     if (!has_set_playlist_target_duration_) {
@@ -55,37 +71,53 @@ bool MasterPlaylist::WriteAllPlaylists(const std::string& base_url,
       LOG_IF(WARNING, !set_target_duration)
           << "Target duration was already set for " << file_path;
     }
+    if (!playlist->dirty())
+      continue;
+    dirty_playlists.push_back(playlist);
+    versions.push_back(++manifest_versions_[file_path]);
+    file_paths.push_back(file_path);
+  }
+  has_set_playlist_target_duration_ = true;
 
-    scoped_ptr<media::File, media::FileCloser> file(
-        media::File::Open(file_path.c_str(), "w"));
-    if (!file) {
-      LOG(ERROR) << "Failed to open file " << file_path;
-      return false;
+  // Not a vector<bool>, whose elements cannot be written concurrently.
+  scoped_ptr<bool[]> results(new bool[dirty_playlists.size()]);
+  if (dirty_playlists.size() == 1) {
+    WriteMediaPlaylist(dirty_playlists[0], file_paths[0], versions[0],
+                       manifest_sink_, &results[0]);
+  } else if (dirty_playlists.size() > 1) {
+    std::vector<base::Closure> tasks;
+    for (size_t i = 0; i < dirty_playlists.size(); ++i) {
+      tasks.push_back(base::Bind(
+          &WriteMediaPlaylist, base::Unretained(dirty_playlists[i]),
+          file_paths[i], versions[i], base::Unretained(manifest_sink_),
+          &results[i]));
     }
-    if (!playlist->WriteToFile(file.get())) {
-      LOG(ERROR) << "Failed to write playlist " << file_path;
-      return false;
+    if (!io_thread_pool_) {
+      io_thread_pool_.reset(new media::ThreadPool(
+          "PlaylistWriter", kMaxConcurrentPlaylistWrites));
+      io_thread_pool_->Start();
     }
+    io_thread_pool_->RunTasksAndWait(tasks);
+  }
+  for (size_t i = 0; i < dirty_playlists.size(); ++i) {
+    if (!results[i])
+      return false;
   }
 
-  has_set_playlist_target_duration_ = true;
+  if (!WriteMasterPlaylist(base_url, output_dir)) {
+    LOG(ERROR) << "Failed to write master playlist.";
+    return false;
+  }
   return true;
 }
 
 bool MasterPlaylist::WriteMasterPlaylist(const std::string& base_url,
                                          const std::string& output_dir) {
-  std::string file_path = output_dir + file_name_;
-  scoped_ptr<media::File, media::FileCloser> file(
-      media::File::Open(file_path.c_str(), "w"));
-  if (!file) {
-    LOG(ERROR) << "Failed to open file " << file_path;
-    return false;
-  }
-
   // TODO(rkuroiwa): This can be done in AddMediaPlaylist(), no need to create
   // map and list on the fly.
   std::map<std::string, std::list<const MediaPlaylist*>> audio_group_map;
   std::list<const MediaPlaylist*> video_playlists;
+  std::list<const MediaPlaylist*> i_frame_playlists;
   for (const MediaPlaylist* media_playlist : media_playlists_) {
     MediaPlaylist::MediaPlaylistStreamType stream_type =
         media_playlist->stream_type();
@@ -95,6 +127,9 @@ bool MasterPlaylist::WriteMasterPlaylist(const std::string& base_url,
     } else if (stream_type ==
                MediaPlaylist::MediaPlaylistStreamType::kPlayListVideo) {
       video_playlists.push_back(media_playlist);
+    } else if (stream_type == MediaPlaylist::MediaPlaylistStreamType::
+                                  kPlayListVideoIFramesOnly) {
+      i_frame_playlists.push_back(media_playlist);
     } else {
       NOTIMPLEMENTED() << static_cast<int>(stream_type) << " not handled.";
     }
@@ -147,17 +182,43 @@ bool MasterPlaylist::WriteMasterPlaylist(const std::string& base_url,
     }
   }
 
-  std::string content = "#EXTM3U\n" + audio_output + video_output;
-  int64_t bytes_written = file->Write(content.data(), content.size());
-  if (bytes_written < 0) {
-    LOG(ERROR) << "Error while writing master playlist " << file_path;
-    return false;
+  // The I-frame playlists of the video playlists, and the trick play
+  // streams, are not variants of their own, whatever the audio.
+  for (const MediaPlaylist* video_playlist : video_playlists) {
+    const uint64_t i_frame_bitrate = video_playlist->IFrameBitrate();
+    if (i_frame_bitrate == 0)
+      continue;
+    base::StringAppendF(
+        &video_output,
+        "#EXT-X-I-FRAME-STREAM-INF:CODECS=\"%s\",BANDWIDTH=%" PRIu64
+        ",URI=\"%s\"\n",
+        video_playlist->codec().c_str(), i_frame_bitrate,
+        (base_url +
+         MediaPlaylist::IFramePlaylistName(video_playlist->file_name()))
+            .c_str());
+  }
+  for (const MediaPlaylist* i_frame_playlist : i_frame_playlists) {
+    base::StringAppendF(
+        &video_output,
+        "#EXT-X-I-FRAME-STREAM-INF:CODECS=\"%s\",BANDWIDTH=%" PRIu64
+        ",URI=\"%s\"\n",
+        i_frame_playlist->codec().c_str(), i_frame_playlist->Bitrate(),
+        (base_url + i_frame_playlist->file_name()).c_str());
   }
-  if (static_cast<size_t>(bytes_written) != content.size()) {
-    LOG(ERROR) << "Written " << bytes_written << " but content size is "
-               << content.size() << " " << file_path;
+
+  std::string content = "#EXTM3U\n" + audio_output + video_output;
+  std::string file_path = output_dir + file_name_;
+  if (file_path == written_file_path_ && content == written_content_)
+    return true;
+  // Players may fetch the master playlist at any time, so the default sink
+  // replaces it atomically instead of rewriting it in place.
+  if (!manifest_sink_->Publish(file_path, content,
+                               ++manifest_versions_[file_path])) {
+    LOG(ERROR) << "Failed to write master playlist " << file_path;
     return false;
   }
+  written_file_path_ = file_path;
+  written_content_.swap(content);
 
   return true;
 }
@@ -7,12 +7,23 @@
 #ifndef PACKAGER_HLS_BASE_MASTER_PLAYLIST_H_
 #define PACKAGER_HLS_BASE_MASTER_PLAYLIST_H_
 
+#include <stdint.h>
+
 #include <list>
+#include <map>
 #include <string>
 
+#include "packager/base/logging.h"
 #include "packager/base/macros.h"
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/media/file/manifest_sink.h"
 
 namespace edash_packager {
+
+namespace media {
+class ThreadPool;
+}  // namespace media
+
 namespace hls {
 
 class MediaPlaylist;
@@ -32,6 +43,9 @@ class MasterPlaylist {
 
   /// Write out Master Playlist and all the added MediaPlaylists to
   /// base_url + <name of playlist>.
+  /// Only the MediaPlaylists which have changed since they were last written
+  /// are written, concurrently. The Master Playlist is written after them, so
+  /// that it never refers to a Media Playlist which does not exist yet.
   /// This assumes that @a base_url is used as the prefix for Media Playlists.
   /// @param base_url is the prefix for the playlist files. This should be in
   ///        URI form such that prefix_+file_name is a valid HLS URI.
@@ -42,7 +56,8 @@ class MasterPlaylist {
   virtual bool WriteAllPlaylists(const std::string& base_url,
                                  const std::string& output_dir);
 
-  /// Writes Master Playlist to output_dir + <name of playlist>.
+  /// Writes Master Playlist to output_dir + <name of playlist>. The file is
+  /// not written again if its content has not changed since the last write.
   /// This assumes that @a base_url is used as the prefix for Media Playlists.
   /// @param base_url is the prefix for the Media Playlist files. This should be
   ///        in URI form such that base_url+file_name is a valid HLS URI.
@@ -53,12 +68,34 @@ class MasterPlaylist {
   virtual bool WriteMasterPlaylist(const std::string& base_url,
                                    const std::string& output_dir);
 
+  /// Sets where the playlists are published, instead of being written to
+  /// files. The playlists are still named after the paths they would be
+  /// written to.
+  /// @param manifest_sink is not owned and should outlive this object.
+  void set_manifest_sink(media::ManifestSink* manifest_sink) {
+    DCHECK(manifest_sink);
+    manifest_sink_ = manifest_sink;
+  }
+
  private:
   const std::string file_name_;
   std::list<MediaPlaylist*> media_playlists_;
 
   bool has_set_playlist_target_duration_ = false;
 
+  // Content of the last Master Playlist written successfully, and where.
+  std::string written_content_;
+  std::string written_file_path_;
+
+  media::FileManifestSink file_sink_;
+  media::ManifestSink* manifest_sink_;
+  // The last version published of each playlist, by path.
+  std::map<std::string, uint64_t> manifest_versions_;
+
+  // Writes the Media Playlists. Created when several of them are written at
+  // once.
+  scoped_ptr<media::ThreadPool> io_thread_pool_;
+
   DISALLOW_COPY_AND_ASSIGN(MasterPlaylist);
 };
 
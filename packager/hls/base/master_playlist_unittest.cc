@@ -4,15 +4,21 @@
 // license that can be found in the LICENSE file or at
 // https://developers.google.com/open-source/licenses/bsd
 
+#include <map>
+#include <string>
+#include <utility>
+
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
 #include "packager/base/files/file_util.h"
 #include "packager/base/files/scoped_temp_dir.h"
+#include "packager/base/synchronization/lock.h"
 #include "packager/hls/base/master_playlist.h"
 #include "packager/hls/base/media_playlist.h"
 #include "packager/hls/base/mock_media_playlist.h"
 #include "packager/media/file/file.h"
+#include "packager/media/file/manifest_sink.h"
 
 namespace edash_packager {
 namespace hls {
@@ -92,6 +98,69 @@ TEST_F(MasterPlaylistTest, WriteMasterPlaylistOneVideo) {
   ASSERT_EQ(expected, actual);
 }
 
+TEST_F(MasterPlaylistTest, WriteMasterPlaylistVideoAndTrickPlay) {
+  MockMediaPlaylist video_playlist(kVodPlaylist, "media1.m3u8", "somename",
+                                   "somegroupid");
+  video_playlist.SetStreamTypeForTesting(
+      MediaPlaylist::MediaPlaylistStreamType::kPlayListVideo);
+  video_playlist.SetCodecForTesting("avc1");
+  EXPECT_CALL(video_playlist, Bitrate()).WillOnce(Return(435889));
+  master_playlist_.AddMediaPlaylist(&video_playlist);
+
+  MockMediaPlaylist trick_play_playlist(kVodPlaylist, "trick_play.m3u8",
+                                        "somename", "somegroupid");
+  trick_play_playlist.SetStreamTypeForTesting(
+      MediaPlaylist::MediaPlaylistStreamType::kPlayListVideoIFramesOnly);
+  trick_play_playlist.SetCodecForTesting("avc1");
+  EXPECT_CALL(trick_play_playlist, Bitrate()).WillOnce(Return(54321));
+  master_playlist_.AddMediaPlaylist(&trick_play_playlist);
+
+  const char kBaseUrl[] = "http://myplaylistdomain.com/";
+  EXPECT_TRUE(master_playlist_.WriteMasterPlaylist(kBaseUrl, test_output_dir_));
+
+  std::string actual;
+  ASSERT_TRUE(base::ReadFileToString(
+      test_output_dir_path_.Append(kDefaultMasterPlaylistName), &actual));
+
+  const std::string expected =
+      "#EXTM3U\n"
+      "#EXT-X-STREAM-INF:CODECS=\"avc1\",BANDWIDTH=435889\n"
+      "http://myplaylistdomain.com/media1.m3u8\n"
+      "#EXT-X-I-FRAME-STREAM-INF:CODECS=\"avc1\",BANDWIDTH=54321,"
+      "URI=\"http://myplaylistdomain.com/trick_play.m3u8\"\n";
+
+  ASSERT_EQ(expected, actual);
+}
+
+// Verify that the I-frame playlist of a video playlist with key frames is
+// listed after the variants.
+TEST_F(MasterPlaylistTest, WriteMasterPlaylistVideoWithIFramePlaylist) {
+  MockMediaPlaylist video_playlist(kVodPlaylist, "media1.m3u8", "somename",
+                                   "somegroupid");
+  video_playlist.SetStreamTypeForTesting(
+      MediaPlaylist::MediaPlaylistStreamType::kPlayListVideo);
+  video_playlist.SetCodecForTesting("avc1");
+  EXPECT_CALL(video_playlist, Bitrate()).WillOnce(Return(435889));
+  EXPECT_CALL(video_playlist, IFrameBitrate()).WillOnce(Return(87654));
+  master_playlist_.AddMediaPlaylist(&video_playlist);
+
+  const char kBaseUrl[] = "http://myplaylistdomain.com/";
+  EXPECT_TRUE(master_playlist_.WriteMasterPlaylist(kBaseUrl, test_output_dir_));
+
+  std::string actual;
+  ASSERT_TRUE(base::ReadFileToString(
+      test_output_dir_path_.Append(kDefaultMasterPlaylistName), &actual));
+
+  const std::string expected =
+      "#EXTM3U\n"
+      "#EXT-X-STREAM-INF:CODECS=\"avc1\",BANDWIDTH=435889\n"
+      "http://myplaylistdomain.com/media1.m3u8\n"
+      "#EXT-X-I-FRAME-STREAM-INF:CODECS=\"avc1\",BANDWIDTH=87654,"
+      "URI=\"http://myplaylistdomain.com/media1_iframe.m3u8\"\n";
+
+  ASSERT_EQ(expected, actual);
+}
+
 TEST_F(MasterPlaylistTest, WriteMasterPlaylistVideoAndAudio) {
   // First video, sd.m3u8.
   std::string sd_video_codec = "sdvideocodec";
@@ -236,15 +305,9 @@ TEST_F(MasterPlaylistTest, WriteMasterPlaylistMultipleAudioGroups) {
   ASSERT_EQ(expected, actual);
 }
 
-MATCHER_P(FileNameMatches, expected_file_name, "") {
-  const std::string& actual_filename = arg->file_name();
-  *result_listener << "which is " << actual_filename;
-  return expected_file_name == actual_filename;
-}
-
 // This test basically is WriteMasterPlaylist() and also make sure that
 // the target duration is set for MediaPlaylist and
-// MediaPlaylist::WriteToFile() is called.
+// MediaPlaylist::WriteToSink() is called.
 TEST_F(MasterPlaylistTest, WriteAllPlaylists) {
   std::string codec = "avc1";
   MockMediaPlaylist mock_playlist(kVodPlaylist, "media1.m3u8", "somename",
@@ -259,8 +322,7 @@ TEST_F(MasterPlaylistTest, WriteAllPlaylists) {
   master_playlist_.AddMediaPlaylist(&mock_playlist);
 
   EXPECT_CALL(mock_playlist,
-              WriteToFile(FileNameMatches(
-                  test_output_dir_path_.Append("media1.m3u8").value())))
+              WriteToSink(test_output_dir_ + "media1.m3u8", 1u, _))
       .WillOnce(Return(true));
 
   const char kBaseUrl[] = "http://domain.com/";
@@ -271,5 +333,107 @@ TEST_F(MasterPlaylistTest, WriteAllPlaylists) {
       << "Cannot find master playlist at " << master_playlist_path.value();
 }
 
+// Verify that the Media Playlists are written concurrently and only when they
+// have changed.
+TEST_F(MasterPlaylistTest, WriteAllPlaylistsOnlyWritesChangedPlaylists) {
+  MediaInfo media_info;
+  MediaInfo::VideoInfo* video_info = media_info.mutable_video_info();
+  video_info->set_codec("avc1");
+  video_info->set_time_scale(90000);
+  MediaPlaylist playlist1(kVodPlaylist, "media1.m3u8", "name1", "group");
+  MediaPlaylist playlist2(kVodPlaylist, "media2.m3u8", "name2", "group");
+  ASSERT_TRUE(playlist1.SetMediaInfo(media_info));
+  ASSERT_TRUE(playlist2.SetMediaInfo(media_info));
+  playlist1.AddSegment("segment1.ts", 0, 900000, 0, 1000);
+  playlist2.AddSegment("segment1.ts", 0, 900000, 0, 1000);
+  master_playlist_.AddMediaPlaylist(&playlist1);
+  master_playlist_.AddMediaPlaylist(&playlist2);
+
+  const char kBaseUrl[] = "http://domain.com/";
+  EXPECT_TRUE(master_playlist_.WriteAllPlaylists(kBaseUrl, test_output_dir_));
+  const base::FilePath playlist1_path =
+      test_output_dir_path_.Append("media1.m3u8");
+  const base::FilePath playlist2_path =
+      test_output_dir_path_.Append("media2.m3u8");
+  EXPECT_TRUE(base::PathExists(playlist1_path));
+  EXPECT_TRUE(base::PathExists(playlist2_path));
+  EXPECT_FALSE(playlist1.dirty());
+  EXPECT_FALSE(playlist2.dirty());
+
+  ASSERT_TRUE(base::DeleteFile(playlist1_path, false));
+  ASSERT_TRUE(base::DeleteFile(playlist2_path, false));
+  playlist2.AddSegment("segment2.ts", 900000, 900000, 0, 1000);
+  EXPECT_TRUE(master_playlist_.WriteAllPlaylists(kBaseUrl, test_output_dir_));
+  EXPECT_FALSE(base::PathExists(playlist1_path));
+  EXPECT_TRUE(base::PathExists(playlist2_path));
+}
+
+namespace {
+
+// Keeps the last version of each playlist published, in memory.
+class RecordingManifestSink : public media::ManifestSink {
+ public:
+  RecordingManifestSink() {}
+  ~RecordingManifestSink() override {}
+
+  bool Publish(const std::string& name,
+               const std::string& content,
+               uint64_t version) override {
+    base::AutoLock auto_lock(lock_);
+    manifests_[name] = std::make_pair(content, version);
+    return true;
+  }
+
+  // Returns the version of |name|, 0 if it has not been published.
+  uint64_t GetVersion(const std::string& name) {
+    base::AutoLock auto_lock(lock_);
+    return manifests_.count(name) ? manifests_[name].second : 0;
+  }
+
+ private:
+  base::Lock lock_;
+  std::map<std::string, std::pair<std::string, uint64_t>> manifests_;
+
+  DISALLOW_COPY_AND_ASSIGN(RecordingManifestSink);
+};
+
+}  // namespace
+
+// Verify that the playlists are published to the manifest sink, with a version
+// per playlist, instead of being written to files.
+TEST_F(MasterPlaylistTest, WriteAllPlaylistsToManifestSink) {
+  MediaInfo media_info;
+  MediaInfo::VideoInfo* video_info = media_info.mutable_video_info();
+  video_info->set_codec("avc1");
+  video_info->set_time_scale(90000);
+  MediaPlaylist playlist1(kVodPlaylist, "media1.m3u8", "name1", "group");
+  MediaPlaylist playlist2(kVodPlaylist, "media2.m3u8", "name2", "group");
+  ASSERT_TRUE(playlist1.SetMediaInfo(media_info));
+  ASSERT_TRUE(playlist2.SetMediaInfo(media_info));
+  playlist1.AddSegment("segment1.ts", 0, 900000, 0, 1000);
+  playlist2.AddSegment("segment1.ts", 0, 900000, 0, 1000);
+  master_playlist_.AddMediaPlaylist(&playlist1);
+  master_playlist_.AddMediaPlaylist(&playlist2);
+
+  RecordingManifestSink sink;
+  master_playlist_.set_manifest_sink(&sink);
+  const char kBaseUrl[] = "http://domain.com/";
+  EXPECT_TRUE(master_playlist_.WriteAllPlaylists(kBaseUrl, test_output_dir_));
+  const std::string master_playlist_name =
+      test_output_dir_ + kDefaultMasterPlaylistName;
+  const std::string playlist1_name = test_output_dir_ + "media1.m3u8";
+  const std::string playlist2_name = test_output_dir_ + "media2.m3u8";
+  EXPECT_EQ(1u, sink.GetVersion(master_playlist_name));
+  EXPECT_EQ(1u, sink.GetVersion(playlist1_name));
+  EXPECT_EQ(1u, sink.GetVersion(playlist2_name));
+  EXPECT_FALSE(base::PathExists(
+      test_output_dir_path_.Append(kDefaultMasterPlaylistName)));
+
+  playlist2.AddSegment("segment2.ts", 900000, 900000, 0, 1000);
+  EXPECT_TRUE(master_playlist_.WriteAllPlaylists(kBaseUrl, test_output_dir_));
+  EXPECT_EQ(1u, sink.GetVersion(playlist1_name));
+  EXPECT_EQ(2u, sink.GetVersion(playlist2_name));
+}
+
 }  // namespace hls
 }  // namespace edash_packager
@@ -6,17 +6,35 @@
 
 #include "packager/hls/base/media_playlist.h"
 
+#include <inttypes.h>
+
 #include <algorithm>
 #include <cmath>
+#include <iterator>
 
 #include "packager/base/logging.h"
 #include "packager/base/strings/stringprintf.h"
+#include "packager/media/base/timed_metadata.h"
 #include "packager/media/file/file.h"
+#include "packager/media/file/manifest_sink.h"
 
 namespace edash_packager {
 namespace hls {
 
 namespace {
+// Estimated memory of an entry of a playlist with its list node and strings,
+// besides its serialized form.
+const size_t kEstimatedEntrySize = 128;
+
+// Low-Latency HLS parameters, in target durations or part target durations,
+// as recommended by the HLS specification: the parts are listed for the
+// segments in the last three target durations, the delta updates skip the
+// segments older than six target durations, and players start at least three
+// part target durations from the end.
+const double kPartListingTargetDurations = 3.0;
+const double kSkipUntilTargetDurations = 6.0;
+const double kPartHoldBackPartTargetDurations = 3.0;
+
 uint32_t GetTimeScale(const MediaInfo& media_info) {
   if (media_info.has_reference_time_scale())
     return media_info.reference_time_scale();
@@ -29,30 +47,86 @@ uint32_t GetTimeScale(const MediaInfo& media_info) {
   return 0u;
 }
 
+// Formats an EXTINF tag, with an EXT-X-BYTERANGE tag if |use_byte_range|,
+// and the URI of a segment.
+std::string FormatMediaSegment(const std::string& file_name,
+                               double duration,
+                               bool use_byte_range,
+                               uint64_t start_byte_offset,
+                               uint64_t size) {
+  if (!use_byte_range) {
+    return base::StringPrintf("#EXTINF:%.3f,\n%s\n", duration,
+                              file_name.c_str());
+  }
+  return base::StringPrintf(
+      "#EXTINF:%.3f,\n#EXT-X-BYTERANGE:%" PRIu64 "@%" PRIu64 "\n%s\n",
+      duration, size, start_byte_offset, file_name.c_str());
+}
+
+// Returns |name| with |suffix| inserted before its extension, if any.
+std::string InsertBeforeExtension(const std::string& name,
+                                  const std::string& suffix) {
+  const size_t extension_pos = name.rfind('.');
+  if (extension_pos == std::string::npos ||
+      name.find('/', extension_pos) != std::string::npos) {
+    return name + suffix;
+  }
+  std::string new_name(name);
+  new_name.insert(extension_pos, suffix);
+  return new_name;
+}
+
 class SegmentInfoEntry : public HlsEntry {
  public:
-  SegmentInfoEntry(const std::string& file_name, double duration);
+  SegmentInfoEntry(const std::string& file_name,
+                   double duration,
+                   bool use_byte_range,
+                   uint64_t start_byte_offset,
+                   uint64_t size);
   ~SegmentInfoEntry() override;
 
   std::string ToString() override;
 
+  double duration() const { return duration_; }
+  // The tags of the segment, e.g. EXT-X-CUE-OUT, written first.
+  void set_tags(const std::string& tags) { tags_ = tags; }
+  // EXT-X-PART tags of the segment, written before its EXTINF tag.
+  const std::string& parts() const { return parts_; }
+  void set_parts(const std::string& parts) { parts_ = parts; }
+  // The key frames of the segment, serialized for the I-frame playlist.
+  const std::string& i_frames() const { return i_frames_; }
+  void set_i_frames(const std::string& i_frames) { i_frames_ = i_frames; }
+
  private:
   const std::string file_name_;
   const double duration_;
+  const bool use_byte_range_;
+  const uint64_t start_byte_offset_;
+  const uint64_t size_;
+  std::string tags_;
+  std::string parts_;
+  std::string i_frames_;
 
   DISALLOW_COPY_AND_ASSIGN(SegmentInfoEntry);
 };
 
 SegmentInfoEntry::SegmentInfoEntry(const std::string& file_name,
-                                   double duration)
+                                   double duration,
+                                   bool use_byte_range,
+                                   uint64_t start_byte_offset,
+                                   uint64_t size)
     : HlsEntry(HlsEntry::EntryType::kExtInf),
       file_name_(file_name),
-      duration_(duration) {}
+      duration_(duration),
+      use_byte_range_(use_byte_range),
+      start_byte_offset_(start_byte_offset),
+      size_(size) {}
 SegmentInfoEntry::~SegmentInfoEntry() {}
 
 std::string SegmentInfoEntry::ToString() {
-  return base::StringPrintf("#EXTINF:%.3f,\n%s\n", duration_,
-                            file_name_.c_str());
+  return tags_ + parts_ +
+         FormatMediaSegment(file_name_, duration_, use_byte_range_,
+                            start_byte_offset_, size_);
 }
 
 class EncryptionInfoEntry : public HlsEntry {
@@ -128,7 +202,10 @@ MediaPlaylist::MediaPlaylist(MediaPlaylistType type,
       name_(name),
       group_id_(group_id),
       type_(type),
-      entries_deleter_(&entries_) {
+      bandwidth_estimator_(BandwidthEstimator::kUseAllBlocks),
+      i_frame_bandwidth_estimator_(BandwidthEstimator::kUseAllBlocks),
+      entries_deleter_(&entries_),
+      entries_memory_(media::kHlsEntryMemory) {
   LOG_IF(WARNING, type != MediaPlaylistType::kVod)
       << "Non VOD Media Playlist is not supported.";
 }
@@ -151,7 +228,9 @@ bool MediaPlaylist::SetMediaInfo(const MediaInfo& media_info) {
   }
 
   if (media_info.has_video_info()) {
-    stream_type_ = MediaPlaylistStreamType::kPlayListVideo;
+    stream_type_ = media_info.video_info().trick_play_factor() > 0
+                       ? MediaPlaylistStreamType::kPlayListVideoIFramesOnly
+                       : MediaPlaylistStreamType::kPlayListVideo;
     codec_ = media_info.video_info().codec();
   } else if (media_info.has_audio_info()) {
     stream_type_ = MediaPlaylistStreamType::kPlayListAudio;
@@ -162,18 +241,24 @@ bool MediaPlaylist::SetMediaInfo(const MediaInfo& media_info) {
   }
 
   time_scale_ = time_scale;
+  use_byte_range_ = media_info.has_media_file_name();
   media_info_ = media_info;
+  dirty_ = true;
   return true;
 }
 
 void MediaPlaylist::AddSegment(const std::string& file_name,
+                               uint64_t start_time,
                                uint64_t duration,
+                               uint64_t start_byte_offset,
                                uint64_t size) {
   if (time_scale_ == 0) {
     LOG(WARNING) << "Timescale is not set and the duration for " << duration
                  << " cannot be calculated. The output will be wrong.";
 
-    entries_.push_back(new SegmentInfoEntry(file_name, 0.0));
+    AddEntry(new SegmentInfoEntry(file_name, 0.0, use_byte_range_,
+                                  start_byte_offset, size));
+    pending_key_frames_.clear();
     return;
   }
 
@@ -182,11 +267,120 @@ void MediaPlaylist::AddSegment(const std::string& file_name,
   if (segment_duration_seconds > longest_segment_duration_)
     longest_segment_duration_ = segment_duration_seconds;
 
-  total_duration_in_seconds_ += segment_duration_seconds;
-  total_segments_size_ += size;
+  if (size > 0 && duration > 0)
+    bandwidth_estimator_.AddBlock(size, segment_duration_seconds);
   ++total_num_segments_;
+  playlist_duration_ += segment_duration_seconds;
+
+  SegmentInfoEntry* entry =
+      new SegmentInfoEntry(file_name, segment_duration_seconds,
+                           use_byte_range_, start_byte_offset, size);
+
+  // Each key frame lasts until the next one, or the end of the segment.
+  std::string i_frames;
+  const uint64_t end_time = start_time + duration;
+  for (size_t i = 0; i < pending_key_frames_.size(); ++i) {
+    const KeyFrameInfo& key_frame = pending_key_frames_[i];
+    const uint64_t next_time = i + 1 < pending_key_frames_.size()
+                                   ? pending_key_frames_[i + 1].timestamp
+                                   : end_time;
+    if (key_frame.timestamp >= next_time || key_frame.size == 0) {
+      LOG(WARNING) << "Ignoring the key frame at " << key_frame.timestamp
+                   << " of " << key_frame.size << " bytes, which does not end"
+                   << " before " << next_time << ".";
+      continue;
+    }
+    const double key_frame_duration_seconds =
+        static_cast<double>(next_time - key_frame.timestamp) / time_scale_;
+    i_frame_bandwidth_estimator_.AddBlock(key_frame.size,
+                                          key_frame_duration_seconds);
+    // The key frames are always byte ranges, of the segment file if there
+    // is one file per segment.
+    const bool kUseByteRange = true;
+    i_frames += FormatMediaSegment(file_name, key_frame_duration_seconds,
+                                   kUseByteRange, key_frame.start_byte_offset,
+                                   key_frame.size);
+  }
+  entry->set_i_frames(i_frames);
+  pending_key_frames_.clear();
+  entry->set_tags(GetAdBreakTags(start_time, end_time));
+  if (!pending_parts_file_name_.empty()) {
+    if (pending_parts_file_name_ == file_name) {
+      entry->set_parts(pending_parts_);
+      segments_with_parts_.push_back(entry);
+    } else {
+      LOG(WARNING) << "Dropping the parts of " << pending_parts_file_name_
+                   << ", which was not added.";
+    }
+    pending_parts_file_name_.clear();
+    pending_parts_.clear();
+    pending_parts_size_ = 0;
+  }
+  AddEntry(entry);
+
+  // Drop the parts of the segments which are not in the last
+  // kPartListingTargetDurations any more.
+  const double part_listing_duration =
+      kPartListingTargetDurations *
+      (target_duration_set_ ? target_duration_
+                            : std::ceil(longest_segment_duration_));
+  while (!segments_with_parts_.empty()) {
+    double newer_segments_duration = 0.0;
+    for (HlsEntry* segment : segments_with_parts_) {
+      if (segment != segments_with_parts_.front()) {
+        newer_segments_duration +=
+            static_cast<SegmentInfoEntry*>(segment)->duration();
+      }
+    }
+    if (newer_segments_duration < part_listing_duration)
+      break;
+    DropParts(segments_with_parts_.front());
+  }
+}
+
+void MediaPlaylist::AddPart(const std::string& file_name,
+                            uint64_t duration,
+                            uint64_t size) {
+  if (time_scale_ == 0) {
+    LOG(WARNING) << "Timescale is not set. Ignoring the part of " << file_name
+                 << ".";
+    return;
+  }
+  if (file_name != pending_parts_file_name_) {
+    LOG_IF(WARNING, !pending_parts_file_name_.empty())
+        << "Dropping the parts of " << pending_parts_file_name_
+        << ", which was not added.";
+    pending_parts_file_name_ = file_name;
+    pending_parts_.clear();
+    pending_parts_size_ = 0;
+  }
+
+  const double part_duration_seconds =
+      static_cast<double>(duration) / time_scale_;
+  part_target_duration_ =
+      std::max(part_target_duration_, part_duration_seconds);
+  pending_parts_ += base::StringPrintf(
+      "#EXT-X-PART:DURATION=%.3f,URI=\"%s\",BYTERANGE=\"%" PRIu64 "@%" PRIu64
+      "\"",
+      part_duration_seconds, file_name.c_str(), size, pending_parts_size_);
+  // Segments start with a key frame.
+  if (pending_parts_size_ == 0)
+    pending_parts_ += ",INDEPENDENT=YES";
+  pending_parts_ += "\n";
+  pending_parts_size_ += size;
+  dirty_ = true;
+}
 
-  entries_.push_back(new SegmentInfoEntry(file_name, segment_duration_seconds));
+void MediaPlaylist::AddKeyFrame(uint64_t timestamp,
+                                uint64_t start_byte_offset,
+                                uint64_t size) {
+  if (stream_type_ != MediaPlaylistStreamType::kPlayListVideo)
+    return;
+  KeyFrameInfo key_frame;
+  key_frame.timestamp = timestamp;
+  key_frame.start_byte_offset = start_byte_offset;
+  key_frame.size = size;
+  pending_key_frames_.push_back(key_frame);
 }
 
 // TODO(rkuroiwa): This works for single key format but won't work for multiple
@@ -199,6 +393,45 @@ void MediaPlaylist::AddSegment(const std::string& file_name,
 // erase the older ones using the iterator.
 // Note that when erasing std::list iterators, only the deleted iterators are
 // invalidated.
+void MediaPlaylist::AddTimedMetadata(const media::TimedMetadataEvent& event) {
+  if (event.scheme_id_uri != media::kScte35SchemeIdUri ||
+      event.duration == 0) {
+    return;
+  }
+  if (event.timescale == 0 || time_scale_ == 0) {
+    LOG(WARNING) << "Ignoring the ad break " << event.id
+                 << " without a timescale.";
+    return;
+  }
+  if (event.presentation_time < 0)
+    return;
+  AdBreak ad_break;
+  ad_break.start_time = static_cast<uint64_t>(event.presentation_time) *
+                        time_scale_ / event.timescale;
+  ad_break.duration = event.duration * time_scale_ / event.timescale;
+  pending_ad_breaks_.push_back(ad_break);
+}
+
+std::string MediaPlaylist::GetAdBreakTags(uint64_t start_time,
+                                          uint64_t end_time) {
+  std::string tags;
+  if (in_ad_break_ && start_time >= ad_break_end_time_) {
+    tags += "#EXT-X-CUE-IN\n";
+    in_ad_break_ = false;
+  }
+  // The ad breaks starting before the end of the segment start in it, or in
+  // a segment which was added before them.
+  std::vector<AdBreak>::iterator it = pending_ad_breaks_.begin();
+  for (; it != pending_ad_breaks_.end() && it->start_time < end_time; ++it) {
+    base::StringAppendF(&tags, "#EXT-X-CUE-OUT:DURATION=%.3f\n",
+                        static_cast<double>(it->duration) / time_scale_);
+    in_ad_break_ = true;
+    ad_break_end_time_ = it->start_time + it->duration;
+  }
+  pending_ad_breaks_.erase(pending_ad_breaks_.begin(), it);
+  return tags;
+}
+
 void MediaPlaylist::RemoveOldestSegment() {
   static_assert(
       base::is_same<decltype(entries_), std::list<HlsEntry*>>::value,
@@ -206,8 +439,7 @@ void MediaPlaylist::RemoveOldestSegment() {
   if (entries_.empty())
     return;
   if (entries_.front()->type() == HlsEntry::EntryType::kExtInf) {
-    delete entries_.front();
-    entries_.pop_front();
+    EraseEntry(entries_.begin());
     return;
   }
 
@@ -224,11 +456,9 @@ void MediaPlaylist::RemoveOldestSegment() {
     auto entries_itr = entries_.begin();
     ++entries_itr;
     if ((*entries_itr)->type() == HlsEntry::EntryType::kExtKey) {
-      delete entries_.front();
-      entries_.pop_front();
+      EraseEntry(entries_.begin());
     } else {
-      delete *entries_itr;
-      entries_.erase(entries_itr);
+      EraseEntry(entries_itr);
     }
     return;
   }
@@ -237,8 +467,7 @@ void MediaPlaylist::RemoveOldestSegment() {
   ++entries_itr;
   if ((*entries_itr)->type() == HlsEntry::EntryType::kExtInf) {
     DCHECK((*entries_itr)->type() == HlsEntry::EntryType::kExtInf);
-    delete *entries_itr;
-    entries_.erase(entries_itr);
+    EraseEntry(entries_itr);
     return;
   }
 
@@ -246,10 +475,8 @@ void MediaPlaylist::RemoveOldestSegment() {
   // This assumes that there is a segment between 2 EXT-X-KEY entries.
   // Which should be the case due to logic in AddEncryptionInfo().
   DCHECK((*entries_itr)->type() == HlsEntry::EntryType::kExtInf);
-  delete *entries_itr;
-  entries_.erase(entries_itr);
-  delete entries_.front();
-  entries_.pop_front();
+  EraseEntry(entries_itr);
+  EraseEntry(entries_.begin());
 }
 
 void MediaPlaylist::AddEncryptionInfo(MediaPlaylist::EncryptionMethod method,
@@ -260,65 +487,266 @@ void MediaPlaylist::AddEncryptionInfo(MediaPlaylist::EncryptionMethod method,
   if (!entries_.empty()) {
     // No reason to have two consecutive EXT-X-KEY entries. Remove the previous
     // one.
-    if (entries_.back()->type() == HlsEntry::EntryType::kExtKey)
+    if (entries_.back()->type() == HlsEntry::EntryType::kExtKey) {
+      serialized_entries_.resize(serialized_entries_.size() -
+                                 entries_.back()->ToString().size());
+      delete entries_.back();
       entries_.pop_back();
+    }
   }
-  entries_.push_back(
-      new EncryptionInfoEntry(
-          method, url, iv, key_format, key_format_versions));
+  AddEntry(new EncryptionInfoEntry(method, url, iv, key_format,
+                                   key_format_versions));
 }
 
 bool MediaPlaylist::WriteToFile(media::File* file) {
+  std::string content;
+  GenerateContent(false, &content);
+
+  int64_t bytes_written = file->Write(content.data(), content.size());
+  if (bytes_written < 0) {
+    LOG(ERROR) << "Error while writing playlist to file.";
+    return false;
+  }
+
+  // TODO(rkuroiwa): There are at least 2 while (remaining_bytes > 0) logic in
+  // this library to handle partial writes by File. Dedup them and use it here
+  // has well.
+  if (static_cast<size_t>(bytes_written) < content.size()) {
+    LOG(ERROR) << "Failed to write the whole playlist. Wrote " << bytes_written
+               << " but the playlist is " << content.size() << " bytes.";
+    return false;
+  }
+
+  dirty_ = false;
+  return true;
+}
+
+bool MediaPlaylist::WriteToSink(const std::string& name,
+                                uint64_t version,
+                                media::ManifestSink* sink) {
+  DCHECK(sink);
+  std::string content;
+  GenerateContent(false, &content);
+  if (!sink->Publish(name, content, version))
+    return false;
+  if (part_target_duration_ > 0 && type_ != MediaPlaylistType::kVod) {
+    GenerateContent(true, &content);
+    if (!sink->Publish(DeltaPlaylistName(name), content, version))
+      return false;
+  }
+  if (IFrameBitrate() > 0) {
+    GenerateIFrameContent(&content);
+    if (!sink->Publish(IFramePlaylistName(name), content, version))
+      return false;
+  }
+  dirty_ = false;
+  return true;
+}
+
+std::string MediaPlaylist::DeltaPlaylistName(const std::string& name) {
+  return InsertBeforeExtension(name, "_delta");
+}
+
+std::string MediaPlaylist::IFramePlaylistName(const std::string& name) {
+  return InsertBeforeExtension(name, "_iframe");
+}
+
+void MediaPlaylist::GenerateContent(bool delta, std::string* content) {
+  DCHECK(content);
   if (!target_duration_set_) {
     SetTargetDuration(ceil(GetLongestSegmentDuration()));
   }
 
-  // EXTINF with floating point duration requires version 4.
+  const bool low_latency =
+      part_target_duration_ > 0 && type_ != MediaPlaylistType::kVod;
+  DCHECK(low_latency || !delta);
+  // EXTINF with floating point duration requires version 4, and EXT-X-SKIP
+  // version 9.
   std::string header = base::StringPrintf("#EXTM3U\n"
-                                          "#EXT-X-VERSION:4\n"
+                                          "#EXT-X-VERSION:%d\n"
                                           "#EXT-X-TARGETDURATION:%d\n",
+                                          delta ? 9 : (low_latency ? 6 : 4),
                                           target_duration_);
   if (type_ == MediaPlaylistType::kVod) {
     header += "#EXT-X-PLAYLIST-TYPE:VOD\n";
   }
-  std::string body;
-  for (const auto& entry : entries_) {
-    body.append(entry->ToString());
+  if (stream_type_ == MediaPlaylistStreamType::kPlayListVideoIFramesOnly)
+    header += "#EXT-X-I-FRAMES-ONLY\n";
+  const double skip_until = kSkipUntilTargetDurations * target_duration_;
+  if (low_latency) {
+    header += base::StringPrintf(
+        "#EXT-X-SERVER-CONTROL:CAN-SKIP-UNTIL=%.3f,PART-HOLD-BACK=%.3f\n"
+        "#EXT-X-PART-INF:PART-TARGET=%.3f\n"
+        "#EXT-X-MEDIA-SEQUENCE:%d\n",
+        skip_until, kPartHoldBackPartTargetDurations * part_target_duration_,
+        part_target_duration_, media_sequence_number_);
   }
 
-  std::string content = header + body;
+  // The delta update skips the oldest segments as long as the ones left last
+  // at least |skip_until|. The EXT-X-KEY tags are never skipped, so the skip
+  // stops at the first one.
+  size_t entries_begin = serialized_entries_begin_;
+  if (delta) {
+    UpdateSkippedSegments(skip_until);
+    entries_begin += skipped_entries_size_;
+    header += base::StringPrintf("#EXT-X-SKIP:SKIPPED-SEGMENTS=%d\n",
+                                 num_skipped_segments_);
+  }
+
+  std::string preload_hint;
+  if (!pending_parts_file_name_.empty()) {
+    preload_hint = base::StringPrintf(
+        "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"%s\",BYTERANGE-START=%" PRIu64
+        "\n",
+        pending_parts_file_name_.c_str(), pending_parts_size_);
+  }
+  const char kEndList[] = "#EXT-X-ENDLIST\n";
+  content->clear();
+  content->reserve(header.size() + serialized_entries_.size() -
+                   entries_begin + pending_parts_.size() +
+                   preload_hint.size() + sizeof(kEndList));
+  content->append(header);
+  content->append(serialized_entries_, entries_begin, std::string::npos);
+  content->append(pending_parts_);
+  content->append(preload_hint);
 
   if (type_ == MediaPlaylistType::kVod) {
-    content += "#EXT-X-ENDLIST\n";
+    content->append(kEndList);
   }
+}
 
-  int64_t bytes_written = file->Write(content.data(), content.size());
-  if (bytes_written < 0) {
-    LOG(ERROR) << "Error while writing playlist to file.";
-    return false;
+void MediaPlaylist::UpdateSkippedSegments(double skip_until) {
+  auto itr = num_skipped_segments_ > 0 ? std::next(last_skipped_entry_)
+                                       : entries_.begin();
+  double duration_left = playlist_duration_ - skipped_duration_;
+  for (; itr != entries_.end(); ++itr) {
+    if ((*itr)->type() != HlsEntry::EntryType::kExtInf)
+      break;
+    const double segment_duration =
+        static_cast<SegmentInfoEntry*>(*itr)->duration();
+    if (duration_left - segment_duration < skip_until)
+      break;
+    duration_left -= segment_duration;
+    skipped_duration_ += segment_duration;
+    skipped_entries_size_ += (*itr)->ToString().size();
+    ++num_skipped_segments_;
+    last_skipped_entry_ = itr;
   }
+}
 
-  // TODO(rkuroiwa): There are at least 2 while (remaining_bytes > 0) logic in
-  // this library to handle partial writes by File. Dedup them and use it here
-  // has well.
-  if (static_cast<size_t>(bytes_written) < content.size()) {
-    LOG(ERROR) << "Failed to write the whole playlist. Wrote " << bytes_written
-               << " but the playlist is " << content.size() << " bytes.";
-    return false;
+void MediaPlaylist::GenerateIFrameContent(std::string* content) {
+  DCHECK(content);
+  DCHECK(target_duration_set_);
+  // The I-frames of a segment are never longer than the segment, so they
+  // share its target duration. EXT-X-I-FRAMES-ONLY requires version 4.
+  *content = base::StringPrintf("#EXTM3U\n"
+                                "#EXT-X-VERSION:4\n"
+                                "#EXT-X-TARGETDURATION:%d\n",
+                                target_duration_);
+  if (type_ == MediaPlaylistType::kVod) {
+    content->append("#EXT-X-PLAYLIST-TYPE:VOD\n");
+  } else {
+    base::StringAppendF(content, "#EXT-X-MEDIA-SEQUENCE:%d\n",
+                        media_sequence_number_);
+  }
+  content->append("#EXT-X-I-FRAMES-ONLY\n");
+  // The EXT-X-KEY tags apply to the I-frames as they do to the segments.
+  for (HlsEntry* entry : entries_) {
+    if (entry->type() == HlsEntry::EntryType::kExtInf)
+      content->append(static_cast<SegmentInfoEntry*>(entry)->i_frames());
+    else
+      content->append(entry->ToString());
   }
+  if (type_ == MediaPlaylistType::kVod)
+    content->append("#EXT-X-ENDLIST\n");
+}
 
-  return true;
+void MediaPlaylist::AddEntry(HlsEntry* entry) {
+  serialized_entries_.append(entry->ToString());
+  entries_.push_back(entry);
+  dirty_ = true;
+  UpdateTrackedMemory();
+}
+
+void MediaPlaylist::EraseEntry(std::list<HlsEntry*>::iterator entry_itr) {
+  size_t entry_begin = serialized_entries_begin_;
+  for (auto itr = entries_.begin(); itr != entry_itr; ++itr)
+    entry_begin += (*itr)->ToString().size();
+  const size_t entry_size = (*entry_itr)->ToString().size();
+  DCHECK_LE(entry_begin + entry_size, serialized_entries_.size());
+
+  // Move the preceding entries over the erased one, then drop the front.
+  std::copy_backward(serialized_entries_.begin() + serialized_entries_begin_,
+                     serialized_entries_.begin() + entry_begin,
+                     serialized_entries_.begin() + entry_begin + entry_size);
+  serialized_entries_begin_ += entry_size;
+  if (serialized_entries_begin_ * 2 >= serialized_entries_.size()) {
+    serialized_entries_.erase(0, serialized_entries_begin_);
+    serialized_entries_begin_ = 0;
+  }
+
+  if ((*entry_itr)->type() == HlsEntry::EntryType::kExtInf) {
+    const double segment_duration =
+        static_cast<SegmentInfoEntry*>(*entry_itr)->duration();
+    ++media_sequence_number_;
+    playlist_duration_ -= segment_duration;
+    segments_with_parts_.remove(*entry_itr);
+    // The skipped segments are the first entries, so they are removed first.
+    if (num_skipped_segments_ > 0) {
+      DCHECK(entry_itr == entries_.begin());
+      --num_skipped_segments_;
+      skipped_entries_size_ -= entry_size;
+      skipped_duration_ -= segment_duration;
+      if (num_skipped_segments_ == 0) {
+        skipped_entries_size_ = 0;
+        skipped_duration_ = 0.0;
+      }
+    }
+  }
+  delete *entry_itr;
+  entries_.erase(entry_itr);
+  dirty_ = true;
+  UpdateTrackedMemory();
+}
+
+void MediaPlaylist::DropParts(HlsEntry* entry) {
+  DCHECK(!segments_with_parts_.empty());
+  // The segments with parts are the latest ones, so this only looks at the
+  // last entries.
+  size_t entry_begin = serialized_entries_.size();
+  for (auto itr = entries_.rbegin(); itr != entries_.rend(); ++itr) {
+    entry_begin -= (*itr)->ToString().size();
+    if (*itr == entry)
+      break;
+  }
+  SegmentInfoEntry* segment = static_cast<SegmentInfoEntry*>(entry);
+  // The segments with parts are normally too recent to be skipped. If one
+  // is, the skipped segments are counted again.
+  if (num_skipped_segments_ > 0 &&
+      entry_begin < serialized_entries_begin_ + skipped_entries_size_) {
+    num_skipped_segments_ = 0;
+    skipped_entries_size_ = 0;
+    skipped_duration_ = 0.0;
+  }
+  serialized_entries_.erase(entry_begin, segment->parts().size());
+  segment->set_parts(std::string());
+  segments_with_parts_.remove(entry);
+  dirty_ = true;
+}
+
+void MediaPlaylist::UpdateTrackedMemory() {
+  entries_memory_.Set(entries_.size() * kEstimatedEntrySize +
+                      serialized_entries_.capacity());
 }
 
 uint64_t MediaPlaylist::Bitrate() const {
   if (media_info_.has_bandwidth())
     return media_info_.bandwidth();
-  if (total_duration_in_seconds_ == 0.0)
-    return 0;
-  if (total_segments_size_ == 0)
-    return 0;
-  const int kBytesToBits = 8;
-  return total_segments_size_ * kBytesToBits / total_duration_in_seconds_;
+  return bandwidth_estimator_.Max();
+}
+
+uint64_t MediaPlaylist::IFrameBitrate() const {
+  return i_frame_bandwidth_estimator_.Max();
 }
 
 double MediaPlaylist::GetLongestSegmentDuration() const {
@@ -333,6 +761,7 @@ bool MediaPlaylist::SetTargetDuration(uint32_t target_duration) {
   }
   target_duration_ = target_duration;
   target_duration_set_ = true;
+  dirty_ = true;
   return true;
 }
 
@@ -9,16 +9,21 @@
 
 #include <list>
 #include <string>
+#include <vector>
 
 #include "packager/base/macros.h"
 #include "packager/base/memory/scoped_ptr.h"
 #include "packager/base/stl_util.h"
+#include "packager/media/base/memory_tracker.h"
+#include "packager/mpd/base/bandwidth_estimator.h"
 #include "packager/mpd/base/media_info.pb.h"
 
 namespace edash_packager {
 
 namespace media {
 class File;
+class ManifestSink;
+struct TimedMetadataEvent;
 }  // namespace media
 
 namespace hls {
@@ -54,6 +59,8 @@ class MediaPlaylist {
     kPlayListAudio,
     kPlayListVideo,
     kPlayListSubtitle,
+    // Trick play video, see MediaInfo::VideoInfo::trick_play_factor.
+    kPlayListVideoIFramesOnly,
   };
   enum class EncryptionMethod {
     kNone,       // No encryption, i.e. clear.
@@ -92,14 +99,52 @@ class MediaPlaylist {
   /// @return true on success, false otherwise.
   virtual bool SetMediaInfo(const MediaInfo& media_info);
 
-  /// Segments must be added in order.
+  /// Segments must be added in order. If the segments are all in one file,
+  /// i.e. MediaInfo has media_file_name, they are listed as byte ranges of
+  /// the file with EXT-X-BYTERANGE tags.
   /// @param file_name is the file name of the segment.
+  /// @param start_time is in terms of the timescale of the media.
   /// @param duration is in terms of the timescale of the media.
+  /// @param start_byte_offset is the offset of the segment in the file.
   /// @param size is size in bytes.
   virtual void AddSegment(const std::string& file_name,
+                          uint64_t start_time,
                           uint64_t duration,
+                          uint64_t start_byte_offset,
                           uint64_t size);
 
+  /// Adds a key frame of the next segment to be added with AddSegment(). The
+  /// key frames are listed in the I-frame playlist of this playlist, see
+  /// WriteToSink(). They are ignored for audio and trick play playlists.
+  /// @param timestamp is in terms of the timescale of the media.
+  /// @param start_byte_offset is the offset of the key frame in the file of
+  ///        the segment.
+  /// @param size is the size of the key frame in bytes, including the
+  ///        container headers needed to decode it.
+  virtual void AddKeyFrame(uint64_t timestamp,
+                           uint64_t start_byte_offset,
+                           uint64_t size);
+
+  /// Adds a part of the segment being written, for Low-Latency HLS. The parts
+  /// are listed with EXT-X-PART tags, as byte ranges of the segment file, and
+  /// the next one with an EXT-X-PRELOAD-HINT tag. Parts must be added in
+  /// order, before their segment is added with AddSegment(). Only the parts of
+  /// the segments in the last three target durations are kept.
+  /// @param file_name is the file name of the segment of the part.
+  /// @param duration is in terms of the timescale of the media.
+  /// @param size is size in bytes.
+  virtual void AddPart(const std::string& file_name,
+                       uint64_t duration,
+                       uint64_t size);
+
+  /// Adds a timed metadata event of the stream. The SCTE-35 ad breaks, i.e.
+  /// the events of media::kScte35SchemeIdUri with a duration, are marked
+  /// with an EXT-X-CUE-OUT tag on the segment which contains their start,
+  /// and an EXT-X-CUE-IN tag on the first segment starting after their end.
+  /// The other events are only carried in band by the segments. Events must
+  /// be added before the segment which contains them.
+  virtual void AddTimedMetadata(const media::TimedMetadataEvent& event);
+
   /// Removes the oldest segment from the playlist. Useful for manually managing
   /// the length of the playlist.
   virtual void RemoveOldestSegment();
@@ -131,12 +176,33 @@ class MediaPlaylist {
   /// @return true on success, false otherwise.
   virtual bool WriteToFile(media::File* file);
 
+  /// Same as WriteToFile(), but publishes the playlist to @a sink. If the
+  /// playlist has parts, i.e. it is a Low-Latency HLS playlist, its delta
+  /// update, with the oldest segments replaced by an EXT-X-SKIP tag, is also
+  /// published as DeltaPlaylistName(@a name), with the same version. Servers
+  /// return it for the requests with the _HLS_skip=YES query parameter. If
+  /// key frames were added, the I-frame playlist, which lists them as byte
+  /// ranges of the segments, is also published as IFramePlaylistName(@a name).
+  /// @param name is the name of the playlist for @a sink.
+  /// @param version is the version of the playlist for @a sink.
+  /// @param sink is where the playlist is published.
+  /// @return true on success, false otherwise.
+  virtual bool WriteToSink(const std::string& name,
+                           uint64_t version,
+                           media::ManifestSink* sink);
+
   /// If bitrate is specified in MediaInfo then it will use that value.
-  /// Otherwise, it is calculated from the duration and the size of the
-  /// segments added to this object.
+  /// Otherwise, it is the peak segment bitrate, i.e. the highest bitrate of
+  /// the segments added to this object, as required for the BANDWIDTH
+  /// attribute of EXT-X-STREAM-INF.
   /// @return the bitrate (in bits per second) of this MediaPlaylist.
   virtual uint64_t Bitrate() const;
 
+  /// @return the peak bitrate (in bits per second) of the key frames listed
+  ///         in the I-frame playlist, i.e. the BANDWIDTH attribute of
+  ///         EXT-X-I-FRAME-STREAM-INF, or 0 if there is no I-frame playlist.
+  virtual uint64_t IFrameBitrate() const;
+
   /// @return the longest segment’s duration. This will return 0 if no
   ///         segments have been added.
   virtual double GetLongestSegmentDuration() const;
@@ -151,7 +217,53 @@ class MediaPlaylist {
   /// @return true if set, false otherwise.
   virtual bool SetTargetDuration(uint32_t target_duration);
 
+  /// @return true if the playlist has changed since it was last written
+  ///         successfully, or if it has never been written.
+  bool dirty() const { return dirty_; }
+
+  /// @return The name of the delta update of the playlist named @a name, i.e.
+  ///         @a name with "_delta" inserted before the extension.
+  static std::string DeltaPlaylistName(const std::string& name);
+
+  /// @return The name of the I-frame playlist of the playlist named @a name,
+  ///         i.e. @a name with "_iframe" inserted before the extension.
+  static std::string IFramePlaylistName(const std::string& name);
+
  private:
+  struct KeyFrameInfo {
+    uint64_t timestamp;
+    uint64_t start_byte_offset;
+    uint64_t size;
+  };
+  struct AdBreak {
+    uint64_t start_time;
+    uint64_t duration;
+  };
+
+  // Returns the ad break tags of the segment from |start_time| to
+  // |end_time|, updating |pending_ad_breaks_| and |ad_break_end_time_|.
+  std::string GetAdBreakTags(uint64_t start_time, uint64_t end_time);
+  // Serializes the playlist to |content|. Sets the target duration if it has
+  // not been set. If |delta| is true, this is the delta update, with the
+  // segments before the skip boundary left out.
+  void GenerateContent(bool delta, std::string* content);
+  // Serializes the I-frame playlist to |content|. GenerateContent() must be
+  // called first, so that the target duration is set.
+  void GenerateIFrameContent(std::string* content);
+  // Skips the segments which the delta update can skip, after the ones
+  // skipped already, given that the segments left must last at least
+  // |skip_until|.
+  void UpdateSkippedSegments(double skip_until);
+  // Drops the parts of |entry|, which is one of |segments_with_parts_|.
+  void DropParts(HlsEntry* entry);
+  // Appends |entry| to |entries_|, taking the ownership.
+  void AddEntry(HlsEntry* entry);
+  // Deletes the entry at |entry_itr|. Only the first entries may be erased
+  // this way, since the serialized entries before it are moved.
+  void EraseEntry(std::list<HlsEntry*>::iterator entry_itr);
+  // Accounts the estimated memory of the entries.
+  void UpdateTrackedMemory();
+
   // Mainly for MasterPlaylist to use these values.
   const std::string file_name_;
   const std::string name_;
@@ -165,18 +277,66 @@ class MediaPlaylist {
   double longest_segment_duration_ = 0.0;
   uint32_t time_scale_ = 0;
 
-  // The sum of the size of the segments listed in this playlist (in bytes).
-  uint64_t total_segments_size_ = 0;
-  double total_duration_in_seconds_ = 0.0;
+  // Tracks the peak bitrate of the segments, in constant memory.
+  BandwidthEstimator bandwidth_estimator_;
+  // Whether the segments are byte ranges of a single file.
+  bool use_byte_range_ = false;
+
+  // The key frames of the segment being written, which has not been added
+  // yet, and the peak bitrate of the key frames for the I-frame playlist.
+  std::vector<KeyFrameInfo> pending_key_frames_;
+  BandwidthEstimator i_frame_bandwidth_estimator_;
+  // The ad breaks not reached by the segments yet, in the timescale of the
+  // media, and the end of the ad break in progress, if |in_ad_break_|.
+  std::vector<AdBreak> pending_ad_breaks_;
+  bool in_ad_break_ = false;
+  uint64_t ad_break_end_time_ = 0;
   int total_num_segments_;
+  // EXT-X-MEDIA-SEQUENCE, i.e. the number of segments removed, and the total
+  // duration of the segments in the playlist.
+  int media_sequence_number_ = 0;
+  double playlist_duration_ = 0.0;
+
+  // The oldest segments skipped by the delta update, i.e. the first
+  // |num_skipped_segments_| entries, up to |last_skipped_entry_|, with their
+  // serialized size and their duration. They are updated as segments are
+  // added and removed, so that GenerateContent() does not go over all the
+  // entries for each delta update.
+  int num_skipped_segments_ = 0;
+  std::list<HlsEntry*>::iterator last_skipped_entry_;
+  size_t skipped_entries_size_ = 0;
+  double skipped_duration_ = 0.0;
+
+  // Low-Latency HLS parts. The longest part duration, for
+  // EXT-X-PART-INF:PART-TARGET, is 0 if there is no part.
+  double part_target_duration_ = 0.0;
+  // EXT-X-PART tags of the segment being written, which has not been added
+  // yet, and the size of its parts so far, i.e. the start of the next part.
+  std::string pending_parts_file_name_;
+  std::string pending_parts_;
+  uint64_t pending_parts_size_ = 0;
+  // The entries of |entries_| which still list their parts, oldest first.
+  std::list<HlsEntry*> segments_with_parts_;
 
   // See SetTargetDuration() comments.
   bool target_duration_set_ = false;
   uint32_t target_duration_ = 0;
 
+  // See dirty() comments.
+  bool dirty_ = true;
+
   std::list<HlsEntry*> entries_;
   STLElementDeleter<decltype(entries_)> entries_deleter_;
 
+  // |entries_| serialized, starting at |serialized_entries_begin_|. It is
+  // updated as entries are added and removed, so that GenerateContent() does
+  // not format all the entries again. Removed entries are only dropped from the
+  // front of the string once they make up half of it.
+  std::string serialized_entries_;
+  size_t serialized_entries_begin_ = 0;
+
+  media::TrackedMemory entries_memory_;
+
   DISALLOW_COPY_AND_ASSIGN(MediaPlaylist);
 };
 
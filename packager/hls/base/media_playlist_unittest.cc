@@ -7,7 +7,12 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <map>
+
+#include "packager/base/strings/stringprintf.h"
+#include "packager/media/base/timed_metadata.h"
 #include "packager/media/file/file.h"
+#include "packager/media/file/manifest_sink.h"
 #include "packager/hls/base/media_playlist.h"
 
 namespace edash_packager {
@@ -102,7 +107,7 @@ TEST_F(MediaPlaylistTest, SetMediaInfo) {
 // Verify that AddSegment works (not crash).
 TEST_F(MediaPlaylistTest, AddSegment) {
   ASSERT_TRUE(media_playlist_.SetMediaInfo(valid_video_media_info_));
-  media_playlist_.AddSegment("file1.ts", 900000, 1000000);
+  media_playlist_.AddSegment("file1.ts", 0, 900000, 0, 1000000);
 }
 
 // Verify that AddEncryptionInfo works (not crash).
@@ -144,12 +149,13 @@ TEST_F(MediaPlaylistTest, GetBitrateFromSegments) {
   ASSERT_TRUE(media_playlist_.SetMediaInfo(valid_video_media_info_));
 
   // 10 seconds, 1MB.
-  media_playlist_.AddSegment("file1.ts", 900000, 1000000);
+  media_playlist_.AddSegment("file1.ts", 0, 900000, 0, 1000000);
   // 20 seconds, 5MB.
-  media_playlist_.AddSegment("file2.ts", 1800000, 5000000);
+  media_playlist_.AddSegment("file2.ts", 900000, 1800000, 0, 5000000);
 
-  // 200KB per second which is 1600K bits / sec.
-  EXPECT_EQ(1600000u, media_playlist_.Bitrate());
+  // The peak is 250KB per second, from the second segment, which is 2000K
+  // bits / sec.
+  EXPECT_EQ(2000000u, media_playlist_.Bitrate());
 }
 
 TEST_F(MediaPlaylistTest, GetLongestSegmentDuration) {
@@ -157,11 +163,11 @@ TEST_F(MediaPlaylistTest, GetLongestSegmentDuration) {
   ASSERT_TRUE(media_playlist_.SetMediaInfo(valid_video_media_info_));
 
   // 10 seconds.
-  media_playlist_.AddSegment("file1.ts", 900000, 1000000);
+  media_playlist_.AddSegment("file1.ts", 0, 900000, 0, 1000000);
   // 30 seconds.
-  media_playlist_.AddSegment("file2.ts", 2700000, 5000000);
+  media_playlist_.AddSegment("file2.ts", 900000, 2700000, 0, 5000000);
   // 14 seconds.
-  media_playlist_.AddSegment("file3.ts", 1260000, 3000000);
+  media_playlist_.AddSegment("file3.ts", 3600000, 1260000, 0, 3000000);
 
   EXPECT_NEAR(30.0, media_playlist_.GetLongestSegmentDuration(), 0.01);
 }
@@ -192,9 +198,9 @@ TEST_F(MediaPlaylistTest, WriteToFileWithSegments) {
   ASSERT_TRUE(media_playlist_.SetMediaInfo(valid_video_media_info_));
 
   // 10 seconds.
-  media_playlist_.AddSegment("file1.ts", 900000, 1000000);
+  media_playlist_.AddSegment("file1.ts", 0, 900000, 0, 1000000);
   // 30 seconds.
-  media_playlist_.AddSegment("file2.ts", 2700000, 5000000);
+  media_playlist_.AddSegment("file2.ts", 900000, 2700000, 0, 5000000);
   const std::string kExpectedOutput =
       "#EXTM3U\n"
       "#EXT-X-VERSION:4\n"
@@ -213,6 +219,60 @@ TEST_F(MediaPlaylistTest, WriteToFileWithSegments) {
   EXPECT_TRUE(media_playlist_.WriteToFile(&file));
 }
 
+TEST_F(MediaPlaylistTest, WriteToFileTrickPlay) {
+  valid_video_media_info_.set_reference_time_scale(90000);
+  valid_video_media_info_.mutable_video_info()->set_trick_play_factor(2);
+  ASSERT_TRUE(media_playlist_.SetMediaInfo(valid_video_media_info_));
+  EXPECT_EQ(MediaPlaylist::MediaPlaylistStreamType::kPlayListVideoIFramesOnly,
+            media_playlist_.stream_type());
+
+  media_playlist_.AddSegment("file1.ts", 0, 180000, 0, 100000);
+  const std::string kExpectedOutput =
+      "#EXTM3U\n"
+      "#EXT-X-VERSION:4\n"
+      "#EXT-X-TARGETDURATION:2\n"
+      "#EXT-X-PLAYLIST-TYPE:VOD\n"
+      "#EXT-X-I-FRAMES-ONLY\n"
+      "#EXTINF:2.000,\n"
+      "file1.ts\n"
+      "#EXT-X-ENDLIST\n";
+
+  MockFile file;
+  EXPECT_CALL(file,
+              Write(MatchesString(kExpectedOutput), kExpectedOutput.size()))
+      .WillOnce(ReturnArg<1>());
+  EXPECT_TRUE(media_playlist_.WriteToFile(&file));
+}
+
+// Verify that the segments of a single file are listed as byte ranges.
+TEST_F(MediaPlaylistTest, WriteToFileWithByteRanges) {
+  valid_video_media_info_.set_reference_time_scale(90000);
+  valid_video_media_info_.set_media_file_name("video.mp4");
+  ASSERT_TRUE(media_playlist_.SetMediaInfo(valid_video_media_info_));
+
+  // 10 seconds, then 20 seconds, after the 1000 bytes of the headers.
+  media_playlist_.AddSegment("video.mp4", 0, 900000, 1000, 1000000);
+  media_playlist_.AddSegment("video.mp4", 900000, 1800000, 1001000, 5000000);
+  const std::string kExpectedOutput =
+      "#EXTM3U\n"
+      "#EXT-X-VERSION:4\n"
+      "#EXT-X-TARGETDURATION:20\n"
+      "#EXT-X-PLAYLIST-TYPE:VOD\n"
+      "#EXTINF:10.000,\n"
+      "#EXT-X-BYTERANGE:1000000@1000\n"
+      "video.mp4\n"
+      "#EXTINF:20.000,\n"
+      "#EXT-X-BYTERANGE:5000000@1001000\n"
+      "video.mp4\n"
+      "#EXT-X-ENDLIST\n";
+
+  MockFile file;
+  EXPECT_CALL(file,
+              Write(MatchesString(kExpectedOutput), kExpectedOutput.size()))
+      .WillOnce(ReturnArg<1>());
+  EXPECT_TRUE(media_playlist_.WriteToFile(&file));
+}
+
 TEST_F(MediaPlaylistTest, WriteToFileWithEncryptionInfo) {
   valid_video_media_info_.set_reference_time_scale(90000);
   ASSERT_TRUE(media_playlist_.SetMediaInfo(valid_video_media_info_));
@@ -221,9 +281,9 @@ TEST_F(MediaPlaylistTest, WriteToFileWithEncryptionInfo) {
                                     "http://example.com", "0x12345678",
                                     "com.widevine", "1/2/4");
   // 10 seconds.
-  media_playlist_.AddSegment("file1.ts", 900000, 1000000);
+  media_playlist_.AddSegment("file1.ts", 0, 900000, 0, 1000000);
   // 30 seconds.
-  media_playlist_.AddSegment("file2.ts", 2700000, 5000000);
+  media_playlist_.AddSegment("file2.ts", 900000, 2700000, 0, 5000000);
   const std::string kExpectedOutput =
       "#EXTM3U\n"
       "#EXT-X-VERSION:4\n"
@@ -253,9 +313,9 @@ TEST_F(MediaPlaylistTest, WriteToFileWithEncryptionInfoEmptyIv) {
                                     "http://example.com", "", "com.widevine",
                                     "");
   // 10 seconds.
-  media_playlist_.AddSegment("file1.ts", 900000, 1000000);
+  media_playlist_.AddSegment("file1.ts", 0, 900000, 0, 1000000);
   // 30 seconds.
-  media_playlist_.AddSegment("file2.ts", 2700000, 5000000);
+  media_playlist_.AddSegment("file2.ts", 900000, 2700000, 0, 5000000);
   const std::string kExpectedOutput =
       "#EXTM3U\n"
       "#EXT-X-VERSION:4\n"
@@ -281,9 +341,45 @@ TEST_F(MediaPlaylistTest, RemoveOldestSegment) {
   ASSERT_TRUE(media_playlist_.SetMediaInfo(valid_video_media_info_));
 
   // 10 seconds.
-  media_playlist_.AddSegment("file1.ts", 900000, 1000000);
+  media_playlist_.AddSegment("file1.ts", 0, 900000, 0, 1000000);
   // 30 seconds.
-  media_playlist_.AddSegment("file2.ts", 2700000, 5000000);
+  media_playlist_.AddSegment("file2.ts", 900000, 2700000, 0, 5000000);
+  media_playlist_.RemoveOldestSegment();
+
+  const std::string kExpectedOutput =
+      "#EXTM3U\n"
+      "#EXT-X-VERSION:4\n"
+      "#EXT-X-TARGETDURATION:30\n"
+      "#EXT-X-PLAYLIST-TYPE:VOD\n"
+      "#EXTINF:30.000,\n"
+      "file2.ts\n"
+      "#EXT-X-ENDLIST\n";
+
+  MockFile file;
+  EXPECT_CALL(file,
+              Write(MatchesString(kExpectedOutput), kExpectedOutput.size()))
+      .WillOnce(ReturnArg<1>());
+  EXPECT_TRUE(media_playlist_.WriteToFile(&file));
+}
+
+TEST_F(MediaPlaylistTest, RemoveOldestSegmentWithEncryptionInfo) {
+  valid_video_media_info_.set_reference_time_scale(90000);
+  ASSERT_TRUE(media_playlist_.SetMediaInfo(valid_video_media_info_));
+
+  media_playlist_.AddEncryptionInfo(MediaPlaylist::EncryptionMethod::kSampleAes,
+                                    "http://example.com/1", "", "", "");
+  // 10 seconds.
+  media_playlist_.AddSegment("file1.ts", 0, 900000, 0, 1000000);
+  // 30 seconds.
+  media_playlist_.AddSegment("file2.ts", 900000, 2700000, 0, 5000000);
+  media_playlist_.AddEncryptionInfo(MediaPlaylist::EncryptionMethod::kSampleAes,
+                                    "http://example.com/2", "", "", "");
+  // Replaces the previous EXT-X-KEY.
+  media_playlist_.AddEncryptionInfo(MediaPlaylist::EncryptionMethod::kSampleAes,
+                                    "http://example.com/3", "", "", "");
+  // 20 seconds.
+  media_playlist_.AddSegment("file3.ts", 3600000, 1800000, 0, 2000000);
+  // The first EXT-X-KEY is kept since it applies to the next segment.
   media_playlist_.RemoveOldestSegment();
 
   const std::string kExpectedOutput =
@@ -291,8 +387,12 @@ TEST_F(MediaPlaylistTest, RemoveOldestSegment) {
       "#EXT-X-VERSION:4\n"
       "#EXT-X-TARGETDURATION:30\n"
       "#EXT-X-PLAYLIST-TYPE:VOD\n"
+      "#EXT-X-KEY:METHOD=SAMPLE-AES,URI=\"http://example.com/1\"\n"
       "#EXTINF:30.000,\n"
       "file2.ts\n"
+      "#EXT-X-KEY:METHOD=SAMPLE-AES,URI=\"http://example.com/3\"\n"
+      "#EXTINF:20.000,\n"
+      "file3.ts\n"
       "#EXT-X-ENDLIST\n";
 
   MockFile file;
@@ -302,5 +402,254 @@ TEST_F(MediaPlaylistTest, RemoveOldestSegment) {
   EXPECT_TRUE(media_playlist_.WriteToFile(&file));
 }
 
+class LiveMediaPlaylistTest : public MediaPlaylistTest {
+ protected:
+  LiveMediaPlaylistTest()
+      : live_media_playlist_(MediaPlaylist::MediaPlaylistType::kLive,
+                             default_file_name_,
+                             default_name_,
+                             default_group_id_) {}
+
+  MediaPlaylist live_media_playlist_;
+};
+
+class RecordingManifestSink : public media::ManifestSink {
+ public:
+  bool Publish(const std::string& name,
+               const std::string& content,
+               uint64_t version) override {
+    manifests_[name] = content;
+    return true;
+  }
+
+  std::map<std::string, std::string> manifests_;
+};
+
+TEST_F(LiveMediaPlaylistTest, LowLatencyParts) {
+  valid_video_media_info_.set_reference_time_scale(90000);
+  ASSERT_TRUE(live_media_playlist_.SetMediaInfo(valid_video_media_info_));
+  ASSERT_TRUE(live_media_playlist_.SetTargetDuration(2));
+
+  // 2 seconds in 1 second parts each.
+  for (int i = 1; i <= 5; ++i) {
+    const std::string file_name = base::StringPrintf("file%d.mp4", i);
+    live_media_playlist_.AddPart(file_name, 90000, 1000);
+    live_media_playlist_.AddPart(file_name, 90000, 2000);
+    live_media_playlist_.AddSegment(file_name, (i - 1) * 180000, 180000, 0,
+                                    3000);
+  }
+  live_media_playlist_.AddPart("file6.mp4", 90000, 1000);
+  live_media_playlist_.RemoveOldestSegment();
+
+  // The parts of the first segment left are dropped, since it is not in the
+  // last 3 target durations any more.
+  const std::string kExpectedOutput =
+      "#EXTM3U\n"
+      "#EXT-X-VERSION:6\n"
+      "#EXT-X-TARGETDURATION:2\n"
+      "#EXT-X-SERVER-CONTROL:CAN-SKIP-UNTIL=12.000,PART-HOLD-BACK=3.000\n"
+      "#EXT-X-PART-INF:PART-TARGET=1.000\n"
+      "#EXT-X-MEDIA-SEQUENCE:1\n"
+      "#EXTINF:2.000,\n"
+      "file2.mp4\n"
+      "#EXT-X-PART:DURATION=1.000,URI=\"file3.mp4\",BYTERANGE=\"1000@0\","
+      "INDEPENDENT=YES\n"
+      "#EXT-X-PART:DURATION=1.000,URI=\"file3.mp4\",BYTERANGE=\"2000@1000\"\n"
+      "#EXTINF:2.000,\n"
+      "file3.mp4\n"
+      "#EXT-X-PART:DURATION=1.000,URI=\"file4.mp4\",BYTERANGE=\"1000@0\","
+      "INDEPENDENT=YES\n"
+      "#EXT-X-PART:DURATION=1.000,URI=\"file4.mp4\",BYTERANGE=\"2000@1000\"\n"
+      "#EXTINF:2.000,\n"
+      "file4.mp4\n"
+      "#EXT-X-PART:DURATION=1.000,URI=\"file5.mp4\",BYTERANGE=\"1000@0\","
+      "INDEPENDENT=YES\n"
+      "#EXT-X-PART:DURATION=1.000,URI=\"file5.mp4\",BYTERANGE=\"2000@1000\"\n"
+      "#EXTINF:2.000,\n"
+      "file5.mp4\n"
+      "#EXT-X-PART:DURATION=1.000,URI=\"file6.mp4\",BYTERANGE=\"1000@0\","
+      "INDEPENDENT=YES\n"
+      "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"file6.mp4\",BYTERANGE-START=1000\n";
+
+  MockFile file;
+  EXPECT_CALL(file,
+              Write(MatchesString(kExpectedOutput), kExpectedOutput.size()))
+      .WillOnce(ReturnArg<1>());
+  EXPECT_TRUE(live_media_playlist_.WriteToFile(&file));
+}
+
+TEST_F(LiveMediaPlaylistTest, DeltaUpdate) {
+  valid_video_media_info_.set_reference_time_scale(90000);
+  ASSERT_TRUE(live_media_playlist_.SetMediaInfo(valid_video_media_info_));
+  ASSERT_TRUE(live_media_playlist_.SetTargetDuration(2));
+
+  // 9 segments of 2 seconds, the last 6 of which are not skipped.
+  for (int i = 1; i <= 9; ++i) {
+    const std::string file_name = base::StringPrintf("file%d.mp4", i);
+    live_media_playlist_.AddPart(file_name, 180000, 1000);
+    live_media_playlist_.AddSegment(file_name, (i - 1) * 180000, 180000, 0,
+                                    1000);
+  }
+
+  RecordingManifestSink sink;
+  ASSERT_TRUE(live_media_playlist_.WriteToSink("out/video.m3u8", 1, &sink));
+  ASSERT_EQ(2u, sink.manifests_.size());
+
+  const std::string& delta = sink.manifests_["out/video_delta.m3u8"];
+  EXPECT_EQ(0u, delta.find("#EXTM3U\n"
+                           "#EXT-X-VERSION:9\n"
+                           "#EXT-X-TARGETDURATION:2\n"
+                           "#EXT-X-SERVER-CONTROL:CAN-SKIP-UNTIL=12.000,"
+                           "PART-HOLD-BACK=6.000\n"
+                           "#EXT-X-PART-INF:PART-TARGET=2.000\n"
+                           "#EXT-X-MEDIA-SEQUENCE:0\n"
+                           "#EXT-X-SKIP:SKIPPED-SEGMENTS=3\n"
+                           "#EXTINF:2.000,\n"
+                           "file4.mp4\n"));
+  // The delta update has the same end as the full playlist.
+  const std::string& full = sink.manifests_["out/video.m3u8"];
+  const size_t delta_entries_size = delta.size() - delta.find("#EXTINF");
+  ASSERT_LT(delta_entries_size, full.size());
+  EXPECT_EQ(full.substr(full.size() - delta_entries_size),
+            delta.substr(delta.size() - delta_entries_size));
+}
+
+// The skipped segments are updated as segments are added and removed.
+TEST_F(LiveMediaPlaylistTest, DeltaUpdateAfterRemovingSegments) {
+  valid_video_media_info_.set_reference_time_scale(90000);
+  ASSERT_TRUE(live_media_playlist_.SetMediaInfo(valid_video_media_info_));
+  ASSERT_TRUE(live_media_playlist_.SetTargetDuration(2));
+
+  RecordingManifestSink sink;
+  for (int i = 1; i <= 11; ++i) {
+    const std::string file_name = base::StringPrintf("file%d.mp4", i);
+    live_media_playlist_.AddPart(file_name, 180000, 1000);
+    live_media_playlist_.AddSegment(file_name, (i - 1) * 180000, 180000, 0,
+                                    1000);
+    if (i > 9)
+      live_media_playlist_.RemoveOldestSegment();
+    ASSERT_TRUE(live_media_playlist_.WriteToSink("out/video.m3u8", i, &sink));
+  }
+
+  const std::string& delta = sink.manifests_["out/video_delta.m3u8"];
+  EXPECT_NE(std::string::npos, delta.find("#EXT-X-MEDIA-SEQUENCE:2\n"
+                                          "#EXT-X-SKIP:SKIPPED-SEGMENTS=3\n"
+                                          "#EXTINF:2.000,\n"
+                                          "file6.mp4\n"));
+  const std::string& full = sink.manifests_["out/video.m3u8"];
+  const size_t delta_entries_size = delta.size() - delta.find("#EXTINF");
+  ASSERT_LT(delta_entries_size, full.size());
+  EXPECT_EQ(full.substr(full.size() - delta_entries_size),
+            delta.substr(delta.size() - delta_entries_size));
+}
+
+// Verify that the key frames are published in the I-frame playlist, as byte
+// ranges of their segments.
+TEST_F(MediaPlaylistTest, IFramePlaylist) {
+  valid_video_media_info_.set_reference_time_scale(90000);
+  ASSERT_TRUE(media_playlist_.SetMediaInfo(valid_video_media_info_));
+
+  // Two key frames in the first segment of 2 seconds, one in the second
+  // segment of 1 second.
+  media_playlist_.AddKeyFrame(0, 0, 20000);
+  media_playlist_.AddKeyFrame(90000, 50000, 15000);
+  media_playlist_.AddSegment("file1.ts", 0, 180000, 0, 100000);
+  media_playlist_.AddKeyFrame(180000, 0, 18000);
+  media_playlist_.AddSegment("file2.ts", 180000, 90000, 0, 40000);
+  // 20000 bytes in 1 second.
+  EXPECT_EQ(160000u, media_playlist_.IFrameBitrate());
+
+  RecordingManifestSink sink;
+  ASSERT_TRUE(media_playlist_.WriteToSink("out/video.m3u8", 1, &sink));
+  ASSERT_EQ(2u, sink.manifests_.size());
+  EXPECT_EQ(
+      "#EXTM3U\n"
+      "#EXT-X-VERSION:4\n"
+      "#EXT-X-TARGETDURATION:2\n"
+      "#EXT-X-PLAYLIST-TYPE:VOD\n"
+      "#EXT-X-I-FRAMES-ONLY\n"
+      "#EXTINF:1.000,\n"
+      "#EXT-X-BYTERANGE:20000@0\n"
+      "file1.ts\n"
+      "#EXTINF:1.000,\n"
+      "#EXT-X-BYTERANGE:15000@50000\n"
+      "file1.ts\n"
+      "#EXTINF:1.000,\n"
+      "#EXT-X-BYTERANGE:18000@0\n"
+      "file2.ts\n"
+      "#EXT-X-ENDLIST\n",
+      sink.manifests_["out/video_iframe.m3u8"]);
+}
+
+// Verify that there is no I-frame playlist for trick play streams, which only
+// have key frames.
+TEST_F(MediaPlaylistTest, NoIFramePlaylistForTrickPlay) {
+  valid_video_media_info_.set_reference_time_scale(90000);
+  valid_video_media_info_.mutable_video_info()->set_trick_play_factor(2);
+  ASSERT_TRUE(media_playlist_.SetMediaInfo(valid_video_media_info_));
+
+  media_playlist_.AddKeyFrame(0, 0, 20000);
+  media_playlist_.AddSegment("file1.ts", 0, 180000, 0, 20000);
+  EXPECT_EQ(0u, media_playlist_.IFrameBitrate());
+
+  RecordingManifestSink sink;
+  ASSERT_TRUE(media_playlist_.WriteToSink("out/video.m3u8", 1, &sink));
+  EXPECT_EQ(1u, sink.manifests_.size());
+}
+
+// Verify that the SCTE-35 ad breaks are marked on the segments containing
+// their start and following their end, and that the other events are not.
+TEST_F(MediaPlaylistTest, AdBreakCues) {
+  valid_video_media_info_.set_reference_time_scale(90000);
+  ASSERT_TRUE(media_playlist_.SetMediaInfo(valid_video_media_info_));
+
+  media::TimedMetadataEvent ad_break;
+  ad_break.scheme_id_uri = media::kScte35SchemeIdUri;
+  ad_break.timescale = 90000;
+  ad_break.presentation_time = 90000;
+  ad_break.duration = 225000;
+  media_playlist_.AddTimedMetadata(ad_break);
+  media::TimedMetadataEvent id3;
+  id3.scheme_id_uri = media::kId3SchemeIdUri;
+  id3.timescale = 1000;
+  id3.presentation_time = 500;
+  id3.duration = 1000;
+  media_playlist_.AddTimedMetadata(id3);
+
+  media_playlist_.AddSegment("file1.ts", 0, 180000, 0, 100000);
+  media_playlist_.AddSegment("file2.ts", 180000, 180000, 0, 100000);
+  media_playlist_.AddSegment("file3.ts", 360000, 180000, 0, 100000);
+
+  RecordingManifestSink sink;
+  ASSERT_TRUE(media_playlist_.WriteToSink("out/video.m3u8", 1, &sink));
+  EXPECT_EQ(
+      "#EXTM3U\n"
+      "#EXT-X-VERSION:4\n"
+      "#EXT-X-TARGETDURATION:2\n"
+      "#EXT-X-PLAYLIST-TYPE:VOD\n"
+      "#EXT-X-CUE-OUT:DURATION=2.500\n"
+      "#EXTINF:2.000,\n"
+      "file1.ts\n"
+      "#EXTINF:2.000,\n"
+      "file2.ts\n"
+      "#EXT-X-CUE-IN\n"
+      "#EXTINF:2.000,\n"
+      "file3.ts\n"
+      "#EXT-X-ENDLIST\n",
+      sink.manifests_["out/video.m3u8"]);
+}
+
+TEST(MediaPlaylistNameTest, DeltaPlaylistName) {
+  EXPECT_EQ("out/video_delta.m3u8",
+            MediaPlaylist::DeltaPlaylistName("out/video.m3u8"));
+  EXPECT_EQ("out.d/video_delta",
+            MediaPlaylist::DeltaPlaylistName("out.d/video"));
+}
+
+TEST(MediaPlaylistNameTest, IFramePlaylistName) {
+  EXPECT_EQ("out/video_iframe.m3u8",
+            MediaPlaylist::IFramePlaylistName("out/video.m3u8"));
+}
+
 }  // namespace hls
 }  // namespace edash_packager
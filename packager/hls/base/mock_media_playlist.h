@@ -10,6 +10,7 @@
 #include <gmock/gmock.h>
 
 #include "packager/hls/base/media_playlist.h"
+#include "packager/media/base/timed_metadata.h"
 
 namespace edash_packager {
 namespace hls {
@@ -25,10 +26,21 @@ class MockMediaPlaylist : public MediaPlaylist {
   ~MockMediaPlaylist() override;
 
   MOCK_METHOD1(SetMediaInfo, bool(const MediaInfo& media_info));
-  MOCK_METHOD3(AddSegment,
+  MOCK_METHOD5(AddSegment,
                void(const std::string& file_name,
+                    uint64_t start_time,
                     uint64_t duration,
+                    uint64_t start_byte_offset,
                     uint64_t size));
+  MOCK_METHOD3(AddKeyFrame,
+               void(uint64_t timestamp,
+                    uint64_t start_byte_offset,
+                    uint64_t size));
+  MOCK_METHOD3(AddPart,
+               void(const std::string& file_name,
+                    uint64_t duration,
+                    uint64_t size));
+  MOCK_METHOD1(AddTimedMetadata, void(const media::TimedMetadataEvent& event));
   MOCK_METHOD0(RemoveOldestSegment, void());
   MOCK_METHOD5(AddEncryptionInfo,
                void(EncryptionMethod method,
@@ -37,7 +49,12 @@ class MockMediaPlaylist : public MediaPlaylist {
                     const std::string& key_format,
                     const std::string& key_format_versions));
   MOCK_METHOD1(WriteToFile, bool(media::File* file));
+  MOCK_METHOD3(WriteToSink,
+               bool(const std::string& name,
+                    uint64_t version,
+                    media::ManifestSink* sink));
   MOCK_CONST_METHOD0(Bitrate, uint64_t());
+  MOCK_CONST_METHOD0(IFrameBitrate, uint64_t());
   MOCK_CONST_METHOD0(GetLongestSegmentDuration, double());
   MOCK_METHOD1(SetTargetDuration, bool(uint32_t target_duration));
 };
@@ -6,12 +6,18 @@
 
 #include "packager/hls/base/simple_hls_notifier.h"
 
+#include <algorithm>
+
 #include "packager/base/base64.h"
 #include "packager/base/logging.h"
 #include "packager/base/strings/string_number_conversions.h"
 #include "packager/base/strings/stringprintf.h"
+#include "packager/hls/base/hls_notification.pb.h"
 #include "packager/hls/base/media_playlist.h"
+#include "packager/media/base/pipeline_metrics.h"
+#include "packager/media/base/timed_metadata.h"
 #include "packager/media/base/widevine_pssh_data.pb.h"
+#include "packager/media/file/record_log.h"
 
 namespace edash_packager {
 namespace hls {
@@ -24,6 +30,10 @@ bool IsWidevineSystemId(const std::vector<uint8_t>& system_id) {
   return system_id.size() == arraysize(kSystemIdWidevine) &&
          std::equal(system_id.begin(), system_id.end(), kSystemIdWidevine);
 }
+
+std::vector<uint8_t> ToVector(const std::string& data) {
+  return std::vector<uint8_t>(data.begin(), data.end());
+}
 }  // namespace
 
 MediaPlaylistFactory::~MediaPlaylistFactory() {}
@@ -46,11 +56,29 @@ SimpleHlsNotifier::SimpleHlsNotifier(HlsProfile profile,
       output_dir_(output_dir),
       media_playlist_factory_(new MediaPlaylistFactory()),
       master_playlist_(new MasterPlaylist(master_playlist_name)),
-      media_playlist_map_deleter_(&media_playlist_map_) {}
+      media_playlist_map_deleter_(&media_playlist_map_),
+      next_log_stream_id_(0) {}
 
 SimpleHlsNotifier::~SimpleHlsNotifier() {}
 
 bool SimpleHlsNotifier::Init() {
+  if (state_log_path_.empty())
+    return true;
+  if (profile() != HlsProfile::kLiveProfile) {
+    LOG(ERROR) << "The playlist state log is only for live.";
+    return false;
+  }
+  scoped_ptr<media::RecordLog> state_log(
+      new media::RecordLog(state_log_path_));
+  std::vector<std::string> records;
+  if (!state_log->Open(&records) || !ReplayStateLog(records))
+    return false;
+  if (!records.empty()) {
+    LOG(INFO) << "Restored the playlists from " << records.size()
+              << " records of " << state_log_path_;
+  }
+  base::AutoLock auto_lock(lock_);
+  state_log_ = state_log.Pass();
   return true;
 }
 
@@ -60,6 +88,19 @@ bool SimpleHlsNotifier::NotifyNewStream(const MediaInfo& media_info,
                                         const std::string& group_id,
                                         uint32_t* stream_id) {
   DCHECK(stream_id);
+  uint32_t log_stream_id = 0;
+  {
+    base::AutoLock auto_lock(lock_);
+    if (state_log_) {
+      auto restored_stream = restored_streams_.find(playlist_name);
+      if (restored_stream != restored_streams_.end()) {
+        *stream_id = restored_stream->second;
+        restored_streams_.erase(restored_stream);
+        return true;
+      }
+      log_stream_id = next_log_stream_id_++;
+    }
+  }
   *stream_id = sequence_number_.GetNext();
 
   MediaPlaylist::MediaPlaylistType type;
@@ -85,13 +126,23 @@ bool SimpleHlsNotifier::NotifyNewStream(const MediaInfo& media_info,
   master_playlist_->AddMediaPlaylist(media_playlist.get());
   media_playlist_map_.insert(
       std::make_pair(*stream_id, media_playlist.release()));
-  return true;
+  if (!state_log_)
+    return true;
+  log_stream_ids_[*stream_id] = log_stream_id;
+  HlsNotification notification;
+  notification.set_type(HlsNotification::NEW_STREAM);
+  notification.set_media_info(media_info.SerializeAsString());
+  notification.set_playlist_name(playlist_name);
+  notification.set_stream_name(name);
+  notification.set_group_id(group_id);
+  return AppendToStateLog(*stream_id, &notification);
 }
 
 bool SimpleHlsNotifier::NotifyNewSegment(uint32_t stream_id,
                                          const std::string& segment_name,
                                          uint64_t start_time,
                                          uint64_t duration,
+                                         uint64_t start_byte_offset,
                                          uint64_t size) {
   base::AutoLock auto_lock(lock_);
   auto result = media_playlist_map_.find(stream_id);
@@ -100,7 +151,78 @@ bool SimpleHlsNotifier::NotifyNewSegment(uint32_t stream_id,
     return false;
   }
   auto& media_playlist = result->second;
-  media_playlist->AddSegment(prefix_ + segment_name, duration, size);
+  media_playlist->AddSegment(prefix_ + segment_name, start_time, duration,
+                             start_byte_offset, size);
+  if (!state_log_)
+    return true;
+  HlsNotification notification;
+  notification.set_type(HlsNotification::NEW_SEGMENT);
+  notification.set_segment_name(segment_name);
+  notification.set_start_time(start_time);
+  notification.set_duration(duration);
+  notification.set_start_byte_offset(start_byte_offset);
+  notification.set_size(size);
+  return AppendToStateLog(stream_id, &notification);
+}
+
+bool SimpleHlsNotifier::NotifyKeyFrame(uint32_t stream_id,
+                                       uint64_t timestamp,
+                                       uint64_t start_byte_offset,
+                                       uint64_t size) {
+  base::AutoLock auto_lock(lock_);
+  auto result = media_playlist_map_.find(stream_id);
+  if (result == media_playlist_map_.end()) {
+    LOG(ERROR) << "Cannot find stream with ID: " << stream_id;
+    return false;
+  }
+  auto& media_playlist = result->second;
+  media_playlist->AddKeyFrame(timestamp, start_byte_offset, size);
+  if (!state_log_)
+    return true;
+  HlsNotification notification;
+  notification.set_type(HlsNotification::KEY_FRAME);
+  notification.set_start_time(timestamp);
+  notification.set_start_byte_offset(start_byte_offset);
+  notification.set_size(size);
+  return AppendToStateLog(stream_id, &notification);
+}
+
+bool SimpleHlsNotifier::NotifyTimedMetadata(
+    uint32_t stream_id,
+    const media::TimedMetadataEvent& event) {
+  base::AutoLock auto_lock(lock_);
+  auto result = media_playlist_map_.find(stream_id);
+  if (result == media_playlist_map_.end()) {
+    LOG(ERROR) << "Cannot find stream with ID: " << stream_id;
+    return false;
+  }
+  auto& media_playlist = result->second;
+  media_playlist->AddTimedMetadata(event);
+  if (!state_log_)
+    return true;
+  HlsNotification notification;
+  notification.set_type(HlsNotification::TIMED_METADATA);
+  notification.set_start_time(event.presentation_time);
+  notification.set_duration(event.duration);
+  notification.set_scheme_id_uri(event.scheme_id_uri);
+  notification.set_timescale(event.timescale);
+  notification.set_event_id(event.id);
+  return AppendToStateLog(stream_id, &notification);
+}
+
+bool SimpleHlsNotifier::NotifyNewPart(uint32_t stream_id,
+                                      const std::string& segment_name,
+                                      uint64_t start_time,
+                                      uint64_t duration,
+                                      uint64_t size) {
+  base::AutoLock auto_lock(lock_);
+  auto result = media_playlist_map_.find(stream_id);
+  if (result == media_playlist_map_.end()) {
+    LOG(ERROR) << "Cannot find stream with ID: " << stream_id;
+    return false;
+  }
+  auto& media_playlist = result->second;
+  media_playlist->AddPart(prefix_ + segment_name, duration, size);
   return true;
 }
 
@@ -164,13 +286,114 @@ bool SimpleHlsNotifier::NotifyEncryptionUpdate(
       MediaPlaylist::EncryptionMethod::kSampleAes,
       "data:text/plain;base64," + json_format_base64, iv_string,
       "com.widevine", "");
-  return true;
+  if (!state_log_)
+    return true;
+  HlsNotification notification;
+  notification.set_type(HlsNotification::ENCRYPTION_UPDATE);
+  notification.set_key_id(key_id.data(), key_id.size());
+  notification.set_system_id(system_id.data(), system_id.size());
+  notification.set_iv(iv.data(), iv.size());
+  notification.set_protection_system_specific_data(
+      protection_system_specific_data.data(),
+      protection_system_specific_data.size());
+  return AppendToStateLog(stream_id, &notification);
+}
+
+void SimpleHlsNotifier::set_manifest_sink(media::ManifestSink* manifest_sink) {
+  base::AutoLock auto_lock(lock_);
+  master_playlist_->set_manifest_sink(manifest_sink);
 }
 
 bool SimpleHlsNotifier::Flush() {
+  media::ScopedStageTimer manifest_write_timer(media::kManifestWriteStage);
   base::AutoLock auto_lock(lock_);
   return master_playlist_->WriteAllPlaylists(prefix_, output_dir_);
 }
 
+bool SimpleHlsNotifier::ReplayStateLog(
+    const std::vector<std::string>& records) {
+  DCHECK(!state_log_);
+  // Maps the stream ids of the log to the ids of the streams restored.
+  std::map<uint32_t, uint32_t> stream_ids;
+  for (const std::string& record : records) {
+    HlsNotification notification;
+    if (!notification.ParseFromString(record)) {
+      LOG(ERROR) << "Failed to parse a record of " << state_log_path_;
+      return false;
+    }
+    if (notification.type() == HlsNotification::NEW_STREAM) {
+      MediaInfo media_info;
+      uint32_t stream_id;
+      if (!media_info.ParseFromString(notification.media_info()) ||
+          !NotifyNewStream(media_info, notification.playlist_name(),
+                           notification.stream_name(),
+                           notification.group_id(), &stream_id)) {
+        LOG(ERROR) << "Failed to restore a stream of " << state_log_path_;
+        return false;
+      }
+      stream_ids[notification.stream_id()] = stream_id;
+      base::AutoLock auto_lock(lock_);
+      log_stream_ids_[stream_id] = notification.stream_id();
+      restored_streams_[notification.playlist_name()] = stream_id;
+      next_log_stream_id_ =
+          std::max(next_log_stream_id_, notification.stream_id() + 1);
+      continue;
+    }
+
+    auto stream_id = stream_ids.find(notification.stream_id());
+    if (stream_id == stream_ids.end()) {
+      LOG(ERROR) << "Unexpected stream id " << notification.stream_id()
+                 << " in " << state_log_path_;
+      return false;
+    }
+    bool result = true;
+    switch (notification.type()) {
+      case HlsNotification::NEW_SEGMENT:
+        result = NotifyNewSegment(
+            stream_id->second, notification.segment_name(),
+            notification.start_time(), notification.duration(),
+            notification.start_byte_offset(), notification.size());
+        break;
+      case HlsNotification::KEY_FRAME:
+        result = NotifyKeyFrame(stream_id->second, notification.start_time(),
+                                notification.start_byte_offset(),
+                                notification.size());
+        break;
+      case HlsNotification::TIMED_METADATA: {
+        media::TimedMetadataEvent event;
+        event.scheme_id_uri = notification.scheme_id_uri();
+        event.timescale = notification.timescale();
+        event.presentation_time = notification.start_time();
+        event.duration = notification.duration();
+        event.id = notification.event_id();
+        result = NotifyTimedMetadata(stream_id->second, event);
+        break;
+      }
+      case HlsNotification::ENCRYPTION_UPDATE:
+        result = NotifyEncryptionUpdate(
+            stream_id->second, ToVector(notification.key_id()),
+            ToVector(notification.system_id()), ToVector(notification.iv()),
+            ToVector(notification.protection_system_specific_data()));
+        break;
+      default:
+        LOG(ERROR) << "Unexpected record type " << notification.type()
+                   << " in " << state_log_path_;
+        return false;
+    }
+    if (!result)
+      return false;
+  }
+  return true;
+}
+
+bool SimpleHlsNotifier::AppendToStateLog(uint32_t stream_id,
+                                         HlsNotification* notification) {
+  lock_.AssertAcquired();
+  DCHECK(state_log_);
+  DCHECK(ContainsKey(log_stream_ids_, stream_id));
+  notification->set_stream_id(log_stream_ids_[stream_id]);
+  return state_log_->Append(notification->SerializeAsString());
+}
+
 }  // namespace hls
 }  // namespace edash_packager
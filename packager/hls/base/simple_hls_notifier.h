@@ -7,6 +7,10 @@
 #ifndef PACKAGER_HLS_BASE_SIMPLE_HLS_NOTIFIER_H_
 #define PACKAGER_HLS_BASE_SIMPLE_HLS_NOTIFIER_H_
 
+#include <map>
+#include <string>
+#include <vector>
+
 #include "packager/base/atomic_sequence_num.h"
 #include "packager/base/macros.h"
 #include "packager/base/memory/scoped_ptr.h"
@@ -17,8 +21,15 @@
 #include "packager/hls/base/media_playlist.h"
 
 namespace edash_packager {
+
+namespace media {
+class RecordLog;
+}  // namespace media
+
 namespace hls {
 
+class HlsNotification;
+
 /// For testing.
 /// Creates MediaPlaylist. Mock this and return mock MediaPlaylist.
 class MediaPlaylistFactory {
@@ -32,6 +43,10 @@ class MediaPlaylistFactory {
 };
 
 /// This is thread safe.
+/// If a state log is set, the notifications are also appended to it, and
+/// Init() replays the log left by a previous run. The streams of the previous
+/// run are then resumed by the NotifyNewStream() calls with the same playlist
+/// name, so that a restart of a live packager does not reset the playlists.
 class SimpleHlsNotifier : public HlsNotifier {
  public:
   /// @a prefix is used as hte prefix for all the URIs for Media Playlist. This
@@ -50,6 +65,7 @@ class SimpleHlsNotifier : public HlsNotifier {
 
   /// @name HlsNotifier implemetation overrides.
   /// @{
+  /// Restores the playlists from the state log, if set.
   bool Init() override;
   bool NotifyNewStream(const MediaInfo& media_info,
                        const std::string& playlist_name,
@@ -60,7 +76,19 @@ class SimpleHlsNotifier : public HlsNotifier {
                         const std::string& segment_name,
                         uint64_t start_time,
                         uint64_t duration,
+                        uint64_t start_byte_offset,
                         uint64_t size) override;
+  bool NotifyKeyFrame(uint32_t stream_id,
+                      uint64_t timestamp,
+                      uint64_t start_byte_offset,
+                      uint64_t size) override;
+  bool NotifyTimedMetadata(uint32_t stream_id,
+                           const media::TimedMetadataEvent& event) override;
+  bool NotifyNewPart(uint32_t stream_id,
+                     const std::string& segment_name,
+                     uint64_t start_time,
+                     uint64_t duration,
+                     uint64_t size) override;
   bool NotifyEncryptionUpdate(
       uint32_t stream_id,
       const std::vector<uint8_t>& key_id,
@@ -70,9 +98,28 @@ class SimpleHlsNotifier : public HlsNotifier {
   bool Flush() override;
   /// }@
 
+  /// Sets where the playlists are published, instead of being written to
+  /// the output directory. See MasterPlaylist::set_manifest_sink().
+  /// @param manifest_sink is not owned and should outlive the notifier.
+  void set_manifest_sink(media::ManifestSink* manifest_sink);
+
+  /// Sets the state log of the playlists, for live. It should be set before
+  /// Init().
+  /// @param state_log_path is the file of the log.
+  void set_state_log_path(const std::string& state_log_path) {
+    state_log_path_ = state_log_path;
+  }
+
  private:
   friend class SimpleHlsNotifierTest;
 
+  // Applies the notifications of the state log to the playlists.
+  bool ReplayStateLog(const std::vector<std::string>& records);
+
+  // Appends |notification| about |stream_id| to the state log. |lock_| must
+  // be held.
+  bool AppendToStateLog(uint32_t stream_id, HlsNotification* notification);
+
   const std::string prefix_;
   const std::string output_dir_;
 
@@ -85,6 +132,19 @@ class SimpleHlsNotifier : public HlsNotifier {
 
   base::Lock lock_;
 
+  // State log. Set in Init() if enabled, so that the notifications replayed
+  // from it are not logged again.
+  std::string state_log_path_;
+  scoped_ptr<media::RecordLog> state_log_;
+  // The stream ids in |state_log_|, which are stable across restarts, by
+  // stream id. Protected by |lock_|.
+  std::map<uint32_t, uint32_t> log_stream_ids_;
+  // Stream id in |state_log_| of the next new stream. Protected by |lock_|.
+  uint32_t next_log_stream_id_;
+  // The streams restored from |state_log_| which have not been resumed yet,
+  // by playlist name. Protected by |lock_|.
+  std::map<std::string, uint32_t> restored_streams_;
+
   DISALLOW_COPY_AND_ASSIGN(SimpleHlsNotifier);
 };
 
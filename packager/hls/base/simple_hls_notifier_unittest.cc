@@ -11,10 +11,12 @@
 #include "packager/hls/base/mock_media_playlist.h"
 #include "packager/hls/base/simple_hls_notifier.h"
 #include "packager/media/base/widevine_pssh_data.pb.h"
+#include "packager/media/file/memory_file.h"
 
 namespace edash_packager {
 namespace hls {
 
+using ::testing::InSequence;
 using ::testing::Return;
 using ::testing::StrEq;
 using ::testing::_;
@@ -23,6 +25,8 @@ namespace {
 const char kMasterPlaylistName[] = "master.m3u8";
 const MediaPlaylist::MediaPlaylistType kVodPlaylist =
     MediaPlaylist::MediaPlaylistType::kVod;
+const MediaPlaylist::MediaPlaylistType kLivePlaylist =
+    MediaPlaylist::MediaPlaylistType::kLive;
 
 class MockMasterPlaylist : public MasterPlaylist {
  public:
@@ -66,7 +70,13 @@ class SimpleHlsNotifierTest : public ::testing::Test {
                   kMasterPlaylistName) {}
 
   void InjectMediaPlaylistFactory(scoped_ptr<MediaPlaylistFactory> factory) {
-    notifier_.media_playlist_factory_ = factory.Pass();
+    InjectMediaPlaylistFactory(factory.Pass(), &notifier_);
+  }
+
+  static void InjectMediaPlaylistFactory(
+      scoped_ptr<MediaPlaylistFactory> factory,
+      SimpleHlsNotifier* notifier) {
+    notifier->media_playlist_factory_ = factory.Pass();
   }
 
   void InjectMasterPlaylist(scoped_ptr<MasterPlaylist> playlist) {
@@ -125,10 +135,18 @@ TEST_F(SimpleHlsNotifierTest, NotifyNewSegment) {
 
   const uint64_t kStartTime = 1328;
   const uint64_t kDuration = 398407;
+  const uint64_t kStartByteOffset = 0;
   const uint64_t kSize = 6595840;
+  const uint64_t kKeyFrameSize = 180480;
   const std::string segment_name = "segmentname";
-  EXPECT_CALL(*mock_media_playlist,
-              AddSegment(StrEq(kTestPrefix + segment_name), kDuration, kSize));
+  {
+    InSequence s;
+    EXPECT_CALL(*mock_media_playlist,
+                AddKeyFrame(kStartTime, kStartByteOffset, kKeyFrameSize));
+    EXPECT_CALL(*mock_media_playlist,
+                AddSegment(StrEq(kTestPrefix + segment_name), kStartTime,
+                           kDuration, kStartByteOffset, kSize));
+  }
 
   InjectMasterPlaylist(mock_master_playlist.Pass());
   InjectMediaPlaylistFactory(factory.Pass());
@@ -138,13 +156,16 @@ TEST_F(SimpleHlsNotifierTest, NotifyNewSegment) {
   EXPECT_TRUE(notifier_.NotifyNewStream(media_info, "playlist.m3u8", "name",
                                         "groupid", &stream_id));
 
+  EXPECT_TRUE(notifier_.NotifyKeyFrame(stream_id, kStartTime, kStartByteOffset,
+                                       kKeyFrameSize));
   EXPECT_TRUE(notifier_.NotifyNewSegment(stream_id, segment_name, kStartTime,
-                                         kDuration, kSize));
+                                         kDuration, kStartByteOffset, kSize));
 }
 
 TEST_F(SimpleHlsNotifierTest, NotifyNewSegmentWithoutStreamsRegistered) {
   EXPECT_TRUE(notifier_.Init());
-  EXPECT_FALSE(notifier_.NotifyNewSegment(1u, "anything", 0u, 0u, 0u));
+  EXPECT_FALSE(notifier_.NotifyNewSegment(1u, "anything", 0u, 0u, 0u, 0u));
+  EXPECT_FALSE(notifier_.NotifyKeyFrame(1u, 0u, 0u, 0u));
 }
 
 TEST_F(SimpleHlsNotifierTest, NotifyEncryptionUpdate) {
@@ -356,6 +377,70 @@ TEST_F(SimpleHlsNotifierTest, NotifyEncryptionUpdateWithoutStreamsRegistered) {
                                                 pssh_data));
 }
 
+// Verify that a restarted notifier resumes the streams saved in its state
+// log.
+TEST_F(SimpleHlsNotifierTest, RestoresStreamsFromStateLog) {
+  const char kStateLogFile[] = "memory://hls_state_log";
+  const uint64_t kDuration = 90000;
+  const uint64_t kSize = 1000;
+  const uint64_t kKeyFrameSize = 100;
+  MediaInfo media_info;
+  uint32_t stream_id;
+  {
+    SimpleHlsNotifier notifier(HlsNotifier::HlsProfile::kLiveProfile,
+                               kTestPrefix, kAnyOutputDir,
+                               kMasterPlaylistName);
+    notifier.set_state_log_path(kStateLogFile);
+    scoped_ptr<MockMediaPlaylistFactory> factory(
+        new MockMediaPlaylistFactory());
+    MockMediaPlaylist* mock_media_playlist =
+        new MockMediaPlaylist(kLivePlaylist, "", "", "");
+    EXPECT_CALL(*mock_media_playlist, SetMediaInfo(_)).WillOnce(Return(true));
+    EXPECT_CALL(*mock_media_playlist, AddKeyFrame(_, _, _));
+    EXPECT_CALL(*mock_media_playlist, AddSegment(_, _, _, _, _));
+    EXPECT_CALL(*factory, CreateMock(_, _, _, _))
+        .WillOnce(Return(mock_media_playlist));
+    InjectMediaPlaylistFactory(factory.Pass(), &notifier);
+
+    ASSERT_TRUE(notifier.Init());
+    ASSERT_TRUE(notifier.NotifyNewStream(media_info, "playlist.m3u8", "name",
+                                         "groupid", &stream_id));
+    ASSERT_TRUE(notifier.NotifyKeyFrame(stream_id, 0, 0, kKeyFrameSize));
+    ASSERT_TRUE(notifier.NotifyNewSegment(stream_id, "segment1.ts", 0,
+                                          kDuration, 0, kSize));
+  }
+
+  SimpleHlsNotifier notifier(HlsNotifier::HlsProfile::kLiveProfile,
+                             kTestPrefix, kAnyOutputDir, kMasterPlaylistName);
+  notifier.set_state_log_path(kStateLogFile);
+  scoped_ptr<MockMediaPlaylistFactory> factory(new MockMediaPlaylistFactory());
+  MockMediaPlaylist* mock_media_playlist =
+      new MockMediaPlaylist(kLivePlaylist, "", "", "");
+  EXPECT_CALL(*mock_media_playlist, SetMediaInfo(_)).WillOnce(Return(true));
+  {
+    InSequence s;
+    EXPECT_CALL(*mock_media_playlist, AddKeyFrame(0, 0, kKeyFrameSize));
+    EXPECT_CALL(*mock_media_playlist,
+                AddSegment(StrEq(std::string(kTestPrefix) + "segment1.ts"), 0,
+                           kDuration, 0, kSize));
+    EXPECT_CALL(*mock_media_playlist,
+                AddSegment(StrEq(std::string(kTestPrefix) + "segment2.ts"),
+                           kDuration, kDuration, 0, kSize));
+  }
+  // The stream is only created again by the replay.
+  EXPECT_CALL(*factory, CreateMock(kLivePlaylist, StrEq("playlist.m3u8"),
+                                   StrEq("name"), StrEq("groupid")))
+      .WillOnce(Return(mock_media_playlist));
+  InjectMediaPlaylistFactory(factory.Pass(), &notifier);
+
+  ASSERT_TRUE(notifier.Init());
+  ASSERT_TRUE(notifier.NotifyNewStream(media_info, "playlist.m3u8", "name",
+                                       "groupid", &stream_id));
+  EXPECT_TRUE(notifier.NotifyNewSegment(stream_id, "segment2.ts", kDuration,
+                                        kDuration, 0, kSize));
+  media::MemoryFile::DeleteAll();
+}
+
 TEST_F(SimpleHlsNotifierTest, Flush) {
   scoped_ptr<MockMasterPlaylist> mock_master_playlist(new MockMasterPlaylist());
   EXPECT_CALL(*mock_master_playlist,
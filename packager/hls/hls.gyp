@@ -9,6 +9,18 @@
     '../common.gypi',
   ],
   'targets': [
+    {
+      'target_name': 'hls_notification_proto',
+      'type': 'static_library',
+      'sources': [
+        'base/hls_notification.proto',
+      ],
+      'variables': {
+        'proto_in_dir': 'base',
+        'proto_out_dir': 'packager/hls/base',
+      },
+      'includes': ['../build/protoc.gypi'],
+    },
     {
       'target_name': 'hls_builder',
       'type': '<(component)',
@@ -23,9 +35,12 @@
       ],
       'dependencies': [
         '../base/base.gyp:base',
+        '../media/base/media_base.gyp:media_base',
         '../media/base/media_base.gyp:widevine_pssh_data_proto',
         '../media/file/file.gyp:file',
+        '../mpd/mpd.gyp:manifest_base',
         '../mpd/mpd.gyp:media_info_proto',
+        'hls_notification_proto',
       ],
     },
     {
@@ -40,6 +55,7 @@
       ],
       'dependencies': [
         '../base/base.gyp:base',
+        '../media/file/file.gyp:file',
         '../media/test/media_test.gyp:run_tests_with_atexit_manager',
         '../mpd/mpd.gyp:media_info_proto',
         '../testing/gmock.gyp:gmock',
@@ -11,6 +11,7 @@
 
 #include <openssl/aes.h>
 #include <openssl/err.h>
+#include <openssl/evp.h>
 #include <openssl/rand.h>
 
 #include "packager/base/logging.h"
@@ -36,6 +37,16 @@ AesCryptor::AesCryptor(ConstantIvFlag constant_iv_flag)
 
 AesCryptor::~AesCryptor() {}
 
+void AesCryptor::CipherCtxDeleter::operator()(EVP_CIPHER_CTX* ctx) const {
+  EVP_CIPHER_CTX_free(ctx);
+}
+
+bool AesCryptor::InitializeWithCryptor(const AesCryptor& source,
+                                       const std::vector<uint8_t>& iv) {
+  *aes_key_ = *source.aes_key_;
+  return SetIv(iv);
+}
+
 bool AesCryptor::Crypt(const std::vector<uint8_t>& text,
                        std::vector<uint8_t>* crypt_text) {
   // Save text size to make it work for in-place conversion, since the
@@ -16,6 +16,8 @@
 
 struct aes_key_st;
 typedef struct aes_key_st AES_KEY;
+struct evp_cipher_ctx_st;
+typedef struct evp_cipher_ctx_st EVP_CIPHER_CTX;
 
 namespace edash_packager {
 namespace media {
@@ -43,6 +45,14 @@ class AesCryptor {
   virtual bool InitializeWithIv(const std::vector<uint8_t>& key,
                                 const std::vector<uint8_t>& iv) = 0;
 
+  /// Initialize the cryptor with the key of @a source and the specified IV.
+  /// The key schedule of @a source is copied instead of being expanded again.
+  /// @param source is an initialized cryptor of the same type, constructed
+  ///        with the same parameters. It is not modified.
+  /// @return true on successful initialization, false otherwise.
+  virtual bool InitializeWithCryptor(const AesCryptor& source,
+                                     const std::vector<uint8_t>& iv);
+
   /// @name Various forms of crypt (Encrypt/Decrypt) calls.
   /// It is an Encrypt function for encryptor and a Decrypt function for
   /// decryptor. The text and crypt_text pointers can be the same address for
@@ -72,6 +82,15 @@ class AesCryptor {
   /// @return true if successful, false if the input is invalid.
   bool SetIv(const std::vector<uint8_t>& iv);
 
+  /// Account for @a size bytes which have been crypted on behalf of this
+  /// cryptor by another instance, e.g. on a worker thread, so that
+  /// UpdateIv() advances the iv as if they had been crypted by Crypt.
+  /// It is a NOP if using kUseConstantIv.
+  void AddNumCryptBytes(size_t size) {
+    if (constant_iv_flag_ != kUseConstantIv)
+      num_crypt_bytes_ += size;
+  }
+
   /// Update IV for next sample. As recommended in ISO/IEC 23001-7: IV need to
   /// be updated per sample for CENC.
   /// This is used by encryptors only. It is a NOP if using kUseConstantIv.
@@ -88,6 +107,12 @@ class AesCryptor {
                                std::vector<uint8_t>* iv);
 
  protected:
+  struct CipherCtxDeleter {
+    void operator()(EVP_CIPHER_CTX* ctx) const;
+  };
+  /// EVP cipher context, used by the multi-block cipher implementations.
+  typedef scoped_ptr<EVP_CIPHER_CTX, CipherCtxDeleter> ScopedCipherCtx;
+
   const AES_KEY* aes_key() const { return aes_key_.get(); }
   AES_KEY* mutable_aes_key() { return aes_key_.get(); }
 
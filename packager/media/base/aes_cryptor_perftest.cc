@@ -0,0 +1,214 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+//
+// Throughput of the cryptors of all the protection schemes, over samples from
+// audio frames to 4K key frames, in full sample and subsample layouts. For
+// each scheme and layout, reports the throughput per sample size, in GB/s of
+// sample data, and the fixed cost per sample, in ns, from a linear fit of the
+// time per sample over the sample sizes.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "packager/base/strings/string_number_conversions.h"
+#include "packager/base/time/time.h"
+#include "packager/media/base/aes_decryptor.h"
+#include "packager/media/base/aes_encryptor.h"
+#include "packager/media/base/aes_pattern_cryptor.h"
+#include "packager/testing/perf/perf_test.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+const uint8_t kKey[] = {0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+                        0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c};
+const uint8_t kIv[] = {0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7,
+                       0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff};
+
+// Sample sizes covering audio frames up to 4K video key frames.
+const size_t kSampleSizes[] = {200, 4096, 65536, 2097152};
+// Total number of bytes processed for each sample size.
+const size_t kBytesPerRun = 256 * 1024 * 1024;
+
+const double kBytesPerGigabyte = 1024.0 * 1024 * 1024;
+const double kNanosecondsPerSecond = 1e9;
+
+// The cbcs and cens patterns.
+const uint8_t kCryptByteBlock = 1;
+const uint8_t kSkipByteBlock = 9;
+
+// The protected ranges of the samples.
+enum SubsampleLayout {
+  // The whole sample is protected, e.g. audio or cbc1 full sample encryption.
+  kFullSample,
+  // Every subsample has a clear header followed by protected data, like the
+  // NAL units of video samples.
+  kVideoSubsamples,
+};
+
+const size_t kSubsampleSize = 16 * 1024;
+const size_t kSubsampleClearBytes = 96;
+
+// Returns the protected ranges, as (offset, size) pairs, of a sample.
+std::vector<std::pair<size_t, size_t> > GetProtectedRanges(
+    SubsampleLayout layout,
+    size_t sample_size) {
+  std::vector<std::pair<size_t, size_t> > ranges;
+  if (layout == kFullSample) {
+    ranges.push_back(std::make_pair(static_cast<size_t>(0), sample_size));
+    return ranges;
+  }
+  for (size_t offset = 0; offset < sample_size; offset += kSubsampleSize) {
+    const size_t size = std::min(kSubsampleSize, sample_size - offset);
+    if (size > kSubsampleClearBytes) {
+      ranges.push_back(std::make_pair(offset + kSubsampleClearBytes,
+                                      size - kSubsampleClearBytes));
+    }
+  }
+  return ranges;
+}
+
+// Reports the throughput of |cryptor| over samples of various sizes, and its
+// fixed cost per sample.
+void MeasureThroughput(const std::string& trace_prefix,
+                       SubsampleLayout layout,
+                       AesCryptor* cryptor) {
+  const std::string trace =
+      trace_prefix + (layout == kFullSample ? "_full_" : "_subsamples_");
+  // Sums for the least squares fit of seconds per sample over sample size.
+  double sum_x = 0;
+  double sum_y = 0;
+  double sum_xx = 0;
+  double sum_xy = 0;
+  for (size_t sample_size : kSampleSizes) {
+    std::vector<uint8_t> sample(sample_size, 0x5a);
+    const std::vector<std::pair<size_t, size_t> > ranges =
+        GetProtectedRanges(layout, sample_size);
+    const size_t num_samples = kBytesPerRun / sample_size;
+    const base::TimeTicks start = base::TimeTicks::Now();
+    for (size_t i = 0; i < num_samples; ++i) {
+      for (const std::pair<size_t, size_t>& range : ranges) {
+        uint8_t* data = sample.data() + range.first;
+        ASSERT_TRUE(cryptor->Crypt(data, range.second, data));
+      }
+      cryptor->UpdateIv();
+    }
+    const double seconds = (base::TimeTicks::Now() - start).InSecondsF();
+
+    perf_test::PrintResult(
+        "aes_throughput", "", trace + base::SizeTToString(sample_size) + "B",
+        num_samples * sample_size / seconds / kBytesPerGigabyte, "GB/s", true);
+
+    const double x = static_cast<double>(sample_size);
+    const double y = seconds / num_samples;
+    sum_x += x;
+    sum_y += y;
+    sum_xx += x * x;
+    sum_xy += x * y;
+  }
+
+  const double n = arraysize(kSampleSizes);
+  const double slope =
+      (n * sum_xy - sum_x * sum_y) / (n * sum_xx - sum_x * sum_x);
+  const double intercept = (sum_y - slope * sum_x) / n;
+  perf_test::PrintResult("aes_per_sample_overhead", "", trace,
+                         std::max(intercept, 0.0) * kNanosecondsPerSecond,
+                         "ns", true);
+}
+
+}  // namespace
+
+class AesCryptorPerfTest : public ::testing::TestWithParam<SubsampleLayout> {
+ public:
+  AesCryptorPerfTest()
+      : key_(kKey, kKey + arraysize(kKey)), iv_(kIv, kIv + arraysize(kIv)) {}
+
+ protected:
+  void Measure(const std::string& trace_prefix, AesCryptor* cryptor) {
+    ASSERT_TRUE(cryptor->InitializeWithIv(key_, iv_));
+    MeasureThroughput(trace_prefix, GetParam(), cryptor);
+  }
+
+  std::vector<uint8_t> key_;
+  std::vector<uint8_t> iv_;
+};
+
+// cenc. The decryptor is the encryptor.
+TEST_P(AesCryptorPerfTest, AesCtr) {
+  AesCtrEncryptor encryptor;
+  Measure("ctr", &encryptor);
+}
+
+// cbc1.
+TEST_P(AesCryptorPerfTest, AesCbcEncrypt) {
+  AesCbcEncryptor encryptor(kNoPadding);
+  Measure("cbc_encrypt", &encryptor);
+}
+
+TEST_P(AesCryptorPerfTest, AesCbcEncryptConstantIv) {
+  AesCbcEncryptor encryptor(kNoPadding, AesCryptor::kUseConstantIv);
+  Measure("cbc_encrypt_constant_iv", &encryptor);
+}
+
+TEST_P(AesCryptorPerfTest, AesCbcDecrypt) {
+  AesCbcDecryptor decryptor(kNoPadding);
+  Measure("cbc_decrypt", &decryptor);
+}
+
+TEST_P(AesCryptorPerfTest, AesCbcDecryptConstantIv) {
+  AesCbcDecryptor decryptor(kNoPadding, AesCryptor::kUseConstantIv);
+  Measure("cbc_decrypt_constant_iv", &decryptor);
+}
+
+// cens. The decryptor is the encryptor.
+TEST_P(AesCryptorPerfTest, CensPattern) {
+  AesPatternCryptor cryptor(
+      kCryptByteBlock, kSkipByteBlock,
+      AesPatternCryptor::kEncryptIfCryptByteBlockRemaining,
+      AesCryptor::kDontUseConstantIv,
+      scoped_ptr<AesCryptor>(new AesCtrEncryptor));
+  Measure("cens", &cryptor);
+}
+
+// cbcs.
+TEST_P(AesCryptorPerfTest, CbcsPatternEncrypt) {
+  AesPatternCryptor encryptor(
+      kCryptByteBlock, kSkipByteBlock,
+      AesPatternCryptor::kEncryptIfCryptByteBlockRemaining,
+      AesCryptor::kUseConstantIv,
+      scoped_ptr<AesCryptor>(new AesCbcEncryptor(kNoPadding)));
+  Measure("cbcs_encrypt", &encryptor);
+}
+
+TEST_P(AesCryptorPerfTest, CbcsPatternDecrypt) {
+  AesPatternCryptor decryptor(
+      kCryptByteBlock, kSkipByteBlock,
+      AesPatternCryptor::kEncryptIfCryptByteBlockRemaining,
+      AesCryptor::kUseConstantIv,
+      scoped_ptr<AesCryptor>(new AesCbcDecryptor(kNoPadding)));
+  Measure("cbcs_decrypt", &decryptor);
+}
+
+TEST_P(AesCryptorPerfTest, CbcsPatternDecryptChainedIv) {
+  AesPatternCryptor decryptor(
+      kCryptByteBlock, kSkipByteBlock,
+      AesPatternCryptor::kEncryptIfCryptByteBlockRemaining,
+      AesCryptor::kDontUseConstantIv,
+      scoped_ptr<AesCryptor>(new AesCbcDecryptor(kNoPadding)));
+  Measure("cbcs_decrypt_chained_iv", &decryptor);
+}
+
+INSTANTIATE_TEST_CASE_P(SubsampleLayouts,
+                        AesCryptorPerfTest,
+                        ::testing::Values(kFullSample, kVideoSubsamples));
+
+}  // namespace media
+}  // namespace edash_packager
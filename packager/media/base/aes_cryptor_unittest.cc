@@ -5,6 +5,7 @@
 // https://developers.google.com/open-source/licenses/bsd
 
 #include <gtest/gtest.h>
+#include <openssl/aes.h>
 
 #include "packager/base/logging.h"
 #include "packager/base/memory/scoped_ptr.h"
@@ -220,6 +221,53 @@ TEST_F(AesCtrEncryptorTest, 128BitIVBoundaryCaseEncryption) {
   EXPECT_EQ(encrypted, encrypted_verify);
 }
 
+TEST_F(AesCtrEncryptorTest, 64BitCounterWrapInBulkRun) {
+  // The low 64 bits of the counter wrap after the first block. The high 64
+  // bits must stay unchanged, which the multi-block kernels would not do on
+  // their own.
+  const uint8_t kIvLowMax64[] = {0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5,
+                                 0xf6, 0xf7, 0xff, 0xff, 0xff, 0xff,
+                                 0xff, 0xff, 0xff, 0xff};
+  std::vector<uint8_t> iv(kIvLowMax64, kIvLowMax64 + arraysize(kIvLowMax64));
+  ASSERT_TRUE(encryptor_.InitializeWithIv(key_, iv));
+
+  // Enough full blocks for the bulk path, plus a trailing partial block.
+  const size_t kNumBlocks = 20;
+  std::vector<uint8_t> plaintext(kNumBlocks * kAesBlockSize + 5);
+  for (size_t i = 0; i < plaintext.size(); ++i)
+    plaintext[i] = static_cast<uint8_t>(i * 7);
+
+  // Reference: one AES block encryption per counter value, with the counter
+  // incremented as a 64-bit integer in bytes 8 to 15.
+  AES_KEY aes_key;
+  ASSERT_EQ(0, AES_set_encrypt_key(&key_[0], key_.size() * 8, &aes_key));
+  std::vector<uint8_t> counter = iv;
+  std::vector<uint8_t> expected(plaintext.size());
+  uint8_t key_stream[kAesBlockSize];
+  for (size_t i = 0; i < plaintext.size(); ++i) {
+    if (i % kAesBlockSize == 0) {
+      AES_encrypt(&counter[0], key_stream, &aes_key);
+      for (int j = 15; j >= 8 && ++counter[j] == 0; --j) {
+      }
+    }
+    expected[i] = plaintext[i] ^ key_stream[i % kAesBlockSize];
+  }
+
+  std::vector<uint8_t> encrypted;
+  ASSERT_TRUE(encryptor_.Crypt(plaintext, &encrypted));
+  EXPECT_EQ(expected, encrypted);
+
+  // Same data split mid-block: the counter now wraps in the single-block path
+  // and the bulk run starts after the left-over key stream.
+  ASSERT_TRUE(encryptor_.InitializeWithIv(key_, iv));
+  std::vector<uint8_t> encrypted_split(plaintext.size());
+  const size_t kSplit = 3;
+  ASSERT_TRUE(encryptor_.Crypt(&plaintext[0], kSplit, &encrypted_split[0]));
+  ASSERT_TRUE(encryptor_.Crypt(&plaintext[kSplit], plaintext.size() - kSplit,
+                               &encrypted_split[kSplit]));
+  EXPECT_EQ(expected, encrypted_split);
+}
+
 TEST_F(AesCtrEncryptorTest, 64BitIvUpdate) {
   std::vector<uint8_t> iv_zero(kIv64Zero, kIv64Zero + arraysize(kIv64Zero));
   ASSERT_TRUE(encryptor_.InitializeWithIv(key_, iv_zero));
@@ -7,6 +7,10 @@
 #include "packager/media/base/aes_decryptor.h"
 
 #include <openssl/aes.h>
+#include <openssl/evp.h>
+
+#include <algorithm>
+#include <limits>
 
 #include "packager/base/logging.h"
 
@@ -17,6 +21,19 @@ bool IsKeySizeValidForAes(size_t key_size) {
   return key_size == 16 || key_size == 24 || key_size == 32;
 }
 
+const EVP_CIPHER* GetCbcCipher(size_t key_size) {
+  switch (key_size) {
+    case 16:
+      return EVP_aes_128_cbc();
+    case 24:
+      return EVP_aes_192_cbc();
+    case 32:
+      return EVP_aes_256_cbc();
+    default:
+      return NULL;
+  }
+}
+
 }  // namespace
 
 namespace edash_packager {
@@ -27,7 +44,10 @@ AesCbcDecryptor::AesCbcDecryptor(CbcPaddingScheme padding_scheme)
 
 AesCbcDecryptor::AesCbcDecryptor(CbcPaddingScheme padding_scheme,
                                  ConstantIvFlag constant_iv_flag)
-    : AesCryptor(constant_iv_flag), padding_scheme_(padding_scheme) {
+    : AesCryptor(constant_iv_flag),
+      padding_scheme_(padding_scheme),
+      cipher_ctx_(EVP_CIPHER_CTX_new()) {
+  CHECK(cipher_ctx_);
   if (padding_scheme_ != kNoPadding) {
     CHECK_EQ(constant_iv_flag, kUseConstantIv)
         << "non-constant iv (cipher block chain across calls) only makes sense "
@@ -46,6 +66,12 @@ bool AesCbcDecryptor::InitializeWithIv(const std::vector<uint8_t>& key,
 
   CHECK_EQ(AES_set_decrypt_key(key.data(), key.size() * 8, mutable_aes_key()),
            0);
+  if (EVP_DecryptInit_ex(cipher_ctx_.get(), GetCbcCipher(key.size()), NULL,
+                         key.data(), NULL) != 1 ||
+      EVP_CIPHER_CTX_set_padding(cipher_ctx_.get(), 0) != 1) {
+    LOG(ERROR) << "Failed to initialize AES-CBC cipher context.";
+    return false;
+  }
   return SetIv(iv);
 }
 
@@ -78,8 +104,10 @@ bool AesCbcDecryptor::CryptInternal(const uint8_t* ciphertext,
   const size_t residual_block_size = ciphertext_size % AES_BLOCK_SIZE;
   const size_t cbc_size = ciphertext_size - residual_block_size;
   if (residual_block_size == 0) {
-    AES_cbc_encrypt(ciphertext, plaintext, ciphertext_size, aes_key(),
-                    internal_iv_.data(), AES_DECRYPT);
+    if (!CbcDecrypt(ciphertext, ciphertext_size, plaintext,
+                    internal_iv_.data())) {
+      return false;
+    }
     if (padding_scheme_ != kPkcs5Padding)
       return true;
 
@@ -93,8 +121,8 @@ bool AesCbcDecryptor::CryptInternal(const uint8_t* ciphertext,
     *plaintext_size -= num_padding_bytes;
     return true;
   } else if (padding_scheme_ == kNoPadding) {
-    AES_cbc_encrypt(ciphertext, plaintext, cbc_size, aes_key(),
-                    internal_iv_.data(), AES_DECRYPT);
+    if (!CbcDecrypt(ciphertext, cbc_size, plaintext, internal_iv_.data()))
+      return false;
 
     // The residual block is not encrypted.
     memcpy(plaintext + cbc_size, ciphertext + cbc_size, residual_block_size);
@@ -113,9 +141,10 @@ bool AesCbcDecryptor::CryptInternal(const uint8_t* ciphertext,
   }
 
   // AES-CBC decrypt everything up to the next-to-last full block.
-  if (cbc_size > AES_BLOCK_SIZE) {
-    AES_cbc_encrypt(ciphertext, plaintext, cbc_size - AES_BLOCK_SIZE, aes_key(),
-                    internal_iv_.data(), AES_DECRYPT);
+  if (cbc_size > AES_BLOCK_SIZE &&
+      !CbcDecrypt(ciphertext, cbc_size - AES_BLOCK_SIZE, plaintext,
+                  internal_iv_.data())) {
+    return false;
   }
 
   const uint8_t* next_to_last_ciphertext_block =
@@ -158,5 +187,34 @@ void AesCbcDecryptor::SetIvInternal() {
   internal_iv_.resize(AES_BLOCK_SIZE, 0);
 }
 
+bool AesCbcDecryptor::CbcDecrypt(const uint8_t* ciphertext,
+                                 size_t size,
+                                 uint8_t* plaintext,
+                                 uint8_t* iv) {
+  DCHECK_EQ(0u, size % AES_BLOCK_SIZE);
+  // EVP_DecryptUpdate takes an int length.
+  const size_t kMaxBytesPerUpdate =
+      std::numeric_limits<int>::max() / AES_BLOCK_SIZE * AES_BLOCK_SIZE;
+  uint8_t next_iv[AES_BLOCK_SIZE];
+  while (size > 0) {
+    const size_t update_size = std::min(size, kMaxBytesPerUpdate);
+    // Save the chaining block first as the decryption may be in place.
+    memcpy(next_iv, ciphertext + update_size - AES_BLOCK_SIZE, AES_BLOCK_SIZE);
+    int output_size = 0;
+    if (EVP_DecryptInit_ex(cipher_ctx_.get(), NULL, NULL, NULL, iv) != 1 ||
+        EVP_DecryptUpdate(cipher_ctx_.get(), plaintext, &output_size,
+                          ciphertext, static_cast<int>(update_size)) != 1 ||
+        output_size != static_cast<int>(update_size)) {
+      LOG(ERROR) << "Failed to decrypt " << update_size << " AES-CBC bytes.";
+      return false;
+    }
+    memcpy(iv, next_iv, AES_BLOCK_SIZE);
+    ciphertext += update_size;
+    plaintext += update_size;
+    size -= update_size;
+  }
+  return true;
+}
+
 }  // namespace media
 }  // namespace edash_packager
@@ -55,9 +55,21 @@ class AesCbcDecryptor : public AesCryptor {
                      size_t* plaintext_size) override;
   void SetIvInternal() override;
 
+  // CBC-decrypt |size| bytes, which must be a multiple of the block size, with
+  // |iv| as the initialization vector. |iv| is updated to the last ciphertext
+  // block to allow chaining. Unlike encryption, CBC decryption of different
+  // blocks is independent, so this goes to the multi-block (pipelined AES-NI /
+  // ARMv8 / bit-sliced) kernels of the crypto library.
+  bool CbcDecrypt(const uint8_t* ciphertext,
+                  size_t size,
+                  uint8_t* plaintext,
+                  uint8_t* iv);
+
   const CbcPaddingScheme padding_scheme_;
   // 16-byte internal iv for crypto operations.
   std::vector<uint8_t> internal_iv_;
+  // Cipher context for multi-block decryption.
+  ScopedCipherCtx cipher_ctx_;
 
   DISALLOW_COPY_AND_ASSIGN(AesCbcDecryptor);
 };
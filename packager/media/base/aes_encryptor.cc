@@ -7,6 +7,10 @@
 #include "packager/media/base/aes_encryptor.h"
 
 #include <openssl/aes.h>
+#include <openssl/evp.h>
+
+#include <algorithm>
+#include <limits>
 
 #include "packager/base/logging.h"
 
@@ -22,6 +26,33 @@ bool Increment64(uint8_t* counter) {
   return true;
 }
 
+uint64_t ReadUint64(const uint8_t* counter) {
+  uint64_t value = 0;
+  for (int i = 0; i < 8; ++i)
+    value = (value << 8) | counter[i];
+  return value;
+}
+
+void WriteUint64(uint64_t value, uint8_t* counter) {
+  for (int i = 7; i >= 0; --i) {
+    counter[i] = value & 0xff;
+    value >>= 8;
+  }
+}
+
+const EVP_CIPHER* GetCtrCipher(size_t key_size) {
+  switch (key_size) {
+    case 16:
+      return EVP_aes_128_ctr();
+    case 24:
+      return EVP_aes_192_ctr();
+    case 32:
+      return EVP_aes_256_ctr();
+    default:
+      return NULL;
+  }
+}
+
 // AES defines three key sizes: 128, 192 and 256 bits.
 bool IsKeySizeValidForAes(size_t key_size) {
   return key_size == 16 || key_size == 24 || key_size == 32;
@@ -53,10 +84,38 @@ bool AesEncryptor::InitializeWithIv(const std::vector<uint8_t>& key,
 AesCtrEncryptor::AesCtrEncryptor()
     : AesEncryptor(kDontUseConstantIv),
       block_offset_(0),
-      encrypted_counter_(AES_BLOCK_SIZE, 0) {}
+      encrypted_counter_(AES_BLOCK_SIZE, 0),
+      cipher_ctx_(EVP_CIPHER_CTX_new()) {
+  CHECK(cipher_ctx_);
+}
 
 AesCtrEncryptor::~AesCtrEncryptor() {}
 
+bool AesCtrEncryptor::InitializeWithIv(const std::vector<uint8_t>& key,
+                                       const std::vector<uint8_t>& iv) {
+  if (!AesEncryptor::InitializeWithIv(key, iv))
+    return false;
+  if (EVP_EncryptInit_ex(cipher_ctx_.get(), GetCtrCipher(key.size()), NULL,
+                         key.data(), NULL) != 1) {
+    LOG(ERROR) << "Failed to initialize AES-CTR cipher context.";
+    return false;
+  }
+  return true;
+}
+
+bool AesCtrEncryptor::InitializeWithCryptor(const AesCryptor& source,
+                                            const std::vector<uint8_t>& iv) {
+  if (!AesEncryptor::InitializeWithCryptor(source, iv))
+    return false;
+  const AesCtrEncryptor& ctr_source =
+      static_cast<const AesCtrEncryptor&>(source);
+  if (EVP_CIPHER_CTX_copy(cipher_ctx_.get(), ctr_source.cipher_ctx_.get()) !=
+      1) {
+    LOG(ERROR) << "Failed to copy AES-CTR cipher context.";
+    return false;
+  }
+  return true;
+}
 
 bool AesCtrEncryptor::CryptInternal(const uint8_t* plaintext,
                                     size_t plaintext_size,
@@ -74,18 +133,71 @@ bool AesCtrEncryptor::CryptInternal(const uint8_t* plaintext,
   }
   *ciphertext_size = plaintext_size;
 
-  for (size_t i = 0; i < plaintext_size; ++i) {
-    if (block_offset_ == 0) {
-      AES_encrypt(&counter_[0], &encrypted_counter_[0], aes_key());
-      // As mentioned in ISO/IEC 23001-7:2016 CENC spec, of the 16 byte counter
-      // block, bytes 8 to 15 (i.e. the least significant bytes) are used as a
-      // simple 64 bit unsigned integer that is incremented by one for each
-      // subsequent block of sample data processed and is kept in network byte
-      // order.
-      Increment64(&counter_[8]);
-    }
+  size_t i = 0;
+  // Use up the key stream left over from the previous call.
+  while (block_offset_ != 0 && i < plaintext_size) {
     ciphertext[i] = plaintext[i] ^ encrypted_counter_[block_offset_];
     block_offset_ = (block_offset_ + 1) % AES_BLOCK_SIZE;
+    ++i;
+  }
+
+  // Encrypt the full blocks in bulk. As mentioned in ISO/IEC 23001-7:2016 CENC
+  // spec, of the 16 byte counter block, bytes 8 to 15 (i.e. the least
+  // significant bytes) are used as a simple 64 bit unsigned integer that is
+  // incremented by one for each subsequent block of sample data processed and
+  // is kept in network byte order. The bulk kernels increment the whole 128-bit
+  // block instead, so runs are split where the 64-bit counter wraps around.
+  size_t num_blocks = (plaintext_size - i) / AES_BLOCK_SIZE;
+  while (num_blocks > 0) {
+    const uint64_t counter = ReadUint64(&counter_[8]);
+    const uint64_t blocks_before_wrap =
+        std::numeric_limits<uint64_t>::max() - counter + 1;
+    size_t run_blocks = num_blocks;
+    // |blocks_before_wrap| is zero if the counter is zero, i.e. no wrap.
+    if (blocks_before_wrap != 0 && run_blocks > blocks_before_wrap)
+      run_blocks = static_cast<size_t>(blocks_before_wrap);
+    if (!CryptBlocks(plaintext + i, run_blocks, ciphertext + i))
+      return false;
+    i += run_blocks * AES_BLOCK_SIZE;
+    num_blocks -= run_blocks;
+  }
+
+  // Encrypt the trailing partial block, keeping the rest of the key stream for
+  // the next call.
+  if (i < plaintext_size) {
+    AES_encrypt(&counter_[0], &encrypted_counter_[0], aes_key());
+    Increment64(&counter_[8]);
+    for (; i < plaintext_size; ++i) {
+      ciphertext[i] = plaintext[i] ^ encrypted_counter_[block_offset_];
+      ++block_offset_;
+    }
+  }
+  return true;
+}
+
+bool AesCtrEncryptor::CryptBlocks(const uint8_t* plaintext,
+                                  size_t num_blocks,
+                                  uint8_t* ciphertext) {
+  DCHECK_EQ(0u, block_offset_);
+  // EVP_EncryptUpdate takes an int length.
+  const size_t kMaxBlocksPerUpdate =
+      std::numeric_limits<int>::max() / AES_BLOCK_SIZE;
+  while (num_blocks > 0) {
+    const size_t update_blocks = std::min(num_blocks, kMaxBlocksPerUpdate);
+    const int update_size = static_cast<int>(update_blocks * AES_BLOCK_SIZE);
+    int output_size = 0;
+    if (EVP_EncryptInit_ex(cipher_ctx_.get(), NULL, NULL, NULL,
+                           counter_.data()) != 1 ||
+        EVP_EncryptUpdate(cipher_ctx_.get(), ciphertext, &output_size,
+                          plaintext, update_size) != 1 ||
+        output_size != update_size) {
+      LOG(ERROR) << "Failed to encrypt " << update_blocks << " AES-CTR blocks.";
+      return false;
+    }
+    WriteUint64(ReadUint64(&counter_[8]) + update_blocks, &counter_[8]);
+    plaintext += update_size;
+    ciphertext += update_size;
+    num_blocks -= update_blocks;
   }
   return true;
 }
@@ -39,15 +39,33 @@ class AesEncryptor : public AesCryptor {
   DISALLOW_COPY_AND_ASSIGN(AesEncryptor);
 };
 
-// Class which implements AES-CTR counter-mode encryption.
+// Class which implements AES-CTR counter-mode encryption. Runs of full
+// blocks are encrypted with the multi-block CTR kernels of the crypto library,
+// which select AES-NI / ARMv8 / bit-sliced implementations at runtime and fall
+// back to portable code when no hardware support is available.
 class AesCtrEncryptor : public AesEncryptor {
  public:
   AesCtrEncryptor();
   ~AesCtrEncryptor() override;
 
+  /// @name AesCryptor implementation overrides.
+  /// @{
+  bool InitializeWithIv(const std::vector<uint8_t>& key,
+                        const std::vector<uint8_t>& iv) override;
+  bool InitializeWithCryptor(const AesCryptor& source,
+                             const std::vector<uint8_t>& iv) override;
+  /// @}
+
   uint32_t block_offset() const { return block_offset_; }
 
  private:
+  // Encrypt |num_blocks| full blocks starting at the current counter, and
+  // advance the counter. The low 64 bits of the counter must not wrap around
+  // within the run.
+  bool CryptBlocks(const uint8_t* plaintext,
+                   size_t num_blocks,
+                   uint8_t* ciphertext);
+
   bool CryptInternal(const uint8_t* plaintext,
                      size_t plaintext_size,
                      uint8_t* ciphertext,
@@ -60,6 +78,8 @@ class AesCtrEncryptor : public AesEncryptor {
   std::vector<uint8_t> counter_;
   // Encrypted counter.
   std::vector<uint8_t> encrypted_counter_;
+  // Cipher context for multi-block encryption.
+  ScopedCipherCtx cipher_ctx_;
 
   DISALLOW_COPY_AND_ASSIGN(AesCtrEncryptor);
 };
@@ -59,6 +59,8 @@ class AesPatternCryptor : public AesCryptor {
   /// @{
   bool InitializeWithIv(const std::vector<uint8_t>& key,
                         const std::vector<uint8_t>& iv) override;
+  bool InitializeWithCryptor(const AesCryptor& source,
+                             const std::vector<uint8_t>& iv) override;
   /// @}
 
  private:
@@ -70,10 +72,16 @@ class AesPatternCryptor : public AesCryptor {
 
   bool NeedEncrypt(size_t input_size, size_t target_data_size);
 
+  // @return The number of crypt byte blocks encrypted / decrypted in a text of
+  //         |text_size| bytes.
+  size_t NumCryptRuns(size_t text_size);
+
   const uint8_t crypt_byte_block_;
   const uint8_t skip_byte_block_;
   const PatternEncryptionMode encryption_mode_;
   scoped_ptr<AesCryptor> cryptor_;
+  // Scratch buffer holding the crypt byte blocks of a sample back to back.
+  std::vector<uint8_t> crypt_runs_;
 
   DISALLOW_COPY_AND_ASSIGN(AesPatternCryptor);
 };
@@ -219,5 +219,30 @@ TEST(SampleAesPatternCryptor, MoreThan16Bytes) {
   ASSERT_TRUE(pattern_cryptor.Crypt("0123456789abcdef012", &crypt_text));
 }
 
+// The crypt byte blocks of a sample are processed with a single call to the
+// underlying cryptor.
+TEST(SampleAesPatternCryptor, CryptByteBlocksGathered) {
+  MockAesCryptor* mock_cryptor = new MockAesCryptor();
+  EXPECT_CALL(*mock_cryptor, CryptInternal(_, 3 * 16u, _, _))
+      .WillOnce(Return(true));
+
+  const uint8_t kSampleAesEncryptedBlock = 1;
+  const uint8_t kSampleAesClearBlock = 9;
+  AesPatternCryptor pattern_cryptor(
+      kSampleAesEncryptedBlock, kSampleAesClearBlock,
+      AesPatternCryptor::kSkipIfCryptByteBlockRemaining,
+      AesPatternCryptor::kUseConstantIv,
+      scoped_ptr<MockAesCryptor>(mock_cryptor));
+
+  std::vector<uint8_t> iv(8, 'i');
+  EXPECT_TRUE(pattern_cryptor.SetIv(iv));
+
+  // Two full patterns, followed by one more crypt byte block and a partial
+  // block.
+  std::vector<uint8_t> text(2 * 10 * 16 + 16 + 3, 'x');
+  std::vector<uint8_t> crypt_text;
+  ASSERT_TRUE(pattern_cryptor.Crypt(text, &crypt_text));
+}
+
 }  // namespace media
 }  // namespace edash_packager
@@ -0,0 +1,208 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/async_log_sink.h"
+
+#include <stdio.h>
+
+#include "packager/base/bind.h"
+#include "packager/base/bind_helpers.h"
+#include "packager/base/logging.h"
+#include "packager/base/stl_util.h"
+#include "packager/base/strings/stringprintf.h"
+#include "packager/media/base/closure_thread.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+// How often the queued messages are written, unless a ring fills up first.
+const int kFlushIntervalInMs = 100;
+
+base::subtle::AtomicWord g_installed_sink = 0;
+
+bool HandleLogMessage(int severity,
+                      const char* file,
+                      int line,
+                      size_t message_start,
+                      const std::string& str) {
+  AsyncLogSink* sink = reinterpret_cast<AsyncLogSink*>(
+      base::subtle::Acquire_Load(&g_installed_sink));
+  return sink && sink->Log(severity, file, line, str);
+}
+
+void WriteToStderr(const std::string& batch) {
+  fwrite(batch.data(), 1, batch.size(), stderr);
+  fflush(stderr);
+}
+
+}  // namespace
+
+AsyncLogSink::CallSiteWindow::CallSiteWindow() : num_messages(0) {}
+
+AsyncLogSink::ThreadBuffer::ThreadBuffer(size_t messages_per_thread)
+    : ring(messages_per_thread), num_dropped(0), num_rate_limited(0) {}
+AsyncLogSink::ThreadBuffer::~ThreadBuffer() {}
+
+AsyncLogSink::AsyncLogSink(size_t messages_per_thread,
+                           int max_messages_per_second,
+                           const WriteCallback& write_callback)
+    : messages_per_thread_(messages_per_thread),
+      max_messages_per_second_(max_messages_per_second),
+      write_callback_(write_callback),
+      num_dropped_reported_(0),
+      num_rate_limited_reported_(0),
+      flush_event_(false, false),
+      stop_(0),
+      thread_(new ClosureThread("AsyncLogFlusher",
+                                base::Bind(&AsyncLogSink::FlusherLoop,
+                                           base::Unretained(this)))) {
+  DCHECK_GT(messages_per_thread_, 0u);
+  DCHECK(!write_callback_.is_null());
+  thread_->Start();
+}
+
+AsyncLogSink::~AsyncLogSink() {
+  if (base::subtle::NoBarrier_Load(&g_installed_sink) ==
+      reinterpret_cast<base::subtle::AtomicWord>(this)) {
+    logging::SetLogMessageHandler(NULL);
+    base::subtle::Release_Store(&g_installed_sink, 0);
+  }
+  base::subtle::Release_Store(&stop_, 1);
+  flush_event_.Signal();
+  thread_->Join();
+  STLDeleteElements(&buffers_);
+}
+
+void AsyncLogSink::Install() {
+  base::subtle::Release_Store(&g_installed_sink,
+                              reinterpret_cast<base::subtle::AtomicWord>(this));
+  logging::SetLogMessageHandler(&HandleLogMessage);
+}
+
+bool AsyncLogSink::Log(int severity,
+                       const char* file,
+                       int line,
+                       const std::string& str) {
+  if (severity >= logging::LOG_ERROR) {
+    // Written after the messages logged before it.
+    Flush();
+    return false;
+  }
+
+  ThreadBuffer* buffer = GetThreadBuffer();
+  if (!CheckRateLimit(buffer, CallSite(file, line))) {
+    base::subtle::NoBarrier_AtomicIncrement(&buffer->num_rate_limited, 1);
+    return true;
+  }
+  if (!buffer->ring.TryPush(str)) {
+    base::subtle::NoBarrier_AtomicIncrement(&buffer->num_dropped, 1);
+    flush_event_.Signal();
+    return true;
+  }
+  // Wakes up the flusher early rather than dropping messages.
+  if (buffer->ring.Size() == buffer->ring.capacity() / 2)
+    flush_event_.Signal();
+  return true;
+}
+
+void AsyncLogSink::Flush() {
+  std::vector<ThreadBuffer*> buffers;
+  {
+    base::AutoLock auto_lock(buffers_lock_);
+    buffers = buffers_;
+  }
+
+  // Flush() may be called from any thread: |flush_lock_| keeps a single
+  // consumer per ring at a time.
+  base::AutoLock auto_lock(flush_lock_);
+  uint64_t num_dropped = 0;
+  uint64_t num_rate_limited = 0;
+  for (ThreadBuffer* buffer : buffers) {
+    while (buffer->ring.TryPop(&message_))
+      batch_ += message_;
+    num_dropped += base::subtle::NoBarrier_Load(&buffer->num_dropped);
+    num_rate_limited += base::subtle::NoBarrier_Load(&buffer->num_rate_limited);
+  }
+  if (num_dropped > num_dropped_reported_ ||
+      num_rate_limited > num_rate_limited_reported_) {
+    base::StringAppendF(
+        &batch_,
+        "[AsyncLogSink] %llu messages dropped with a full buffer, %llu "
+        "suppressed by the rate limit.\n",
+        static_cast<unsigned long long>(num_dropped - num_dropped_reported_),
+        static_cast<unsigned long long>(num_rate_limited -
+                                        num_rate_limited_reported_));
+    num_dropped_reported_ = num_dropped;
+    num_rate_limited_reported_ = num_rate_limited;
+  }
+  if (batch_.empty())
+    return;
+  write_callback_.Run(batch_);
+  batch_.clear();
+}
+
+uint64_t AsyncLogSink::num_dropped() const {
+  base::AutoLock auto_lock(buffers_lock_);
+  uint64_t num_dropped = 0;
+  for (const ThreadBuffer* buffer : buffers_)
+    num_dropped += base::subtle::NoBarrier_Load(&buffer->num_dropped);
+  return num_dropped;
+}
+
+uint64_t AsyncLogSink::num_rate_limited() const {
+  base::AutoLock auto_lock(buffers_lock_);
+  uint64_t num_rate_limited = 0;
+  for (const ThreadBuffer* buffer : buffers_)
+    num_rate_limited += base::subtle::NoBarrier_Load(&buffer->num_rate_limited);
+  return num_rate_limited;
+}
+
+// static
+AsyncLogSink::WriteCallback AsyncLogSink::StderrWriteCallback() {
+  return base::Bind(&WriteToStderr);
+}
+
+AsyncLogSink::ThreadBuffer* AsyncLogSink::GetThreadBuffer() {
+  ThreadBuffer* buffer = thread_buffer_.Get();
+  if (!buffer) {
+    // Once per thread. The buffers of the threads which exit are kept until
+    // the sink is destroyed.
+    buffer = new ThreadBuffer(messages_per_thread_);
+    thread_buffer_.Set(buffer);
+    base::AutoLock auto_lock(buffers_lock_);
+    buffers_.push_back(buffer);
+  }
+  return buffer;
+}
+
+bool AsyncLogSink::CheckRateLimit(ThreadBuffer* buffer,
+                                  const CallSite& call_site) {
+  if (max_messages_per_second_ <= 0)
+    return true;
+  const base::TimeTicks now = base::TimeTicks::Now();
+  CallSiteWindow& window = buffer->windows[call_site];
+  if (window.start.is_null() ||
+      now - window.start >= base::TimeDelta::FromSeconds(1)) {
+    window.start = now;
+    window.num_messages = 0;
+  }
+  return ++window.num_messages <= max_messages_per_second_;
+}
+
+void AsyncLogSink::FlusherLoop() {
+  while (!base::subtle::Acquire_Load(&stop_)) {
+    flush_event_.TimedWait(
+        base::TimeDelta::FromMilliseconds(kFlushIntervalInMs));
+    Flush();
+  }
+  // The messages queued before the sink was destroyed.
+  Flush();
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,130 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_BASE_ASYNC_LOG_SINK_H_
+#define MEDIA_BASE_ASYNC_LOG_SINK_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "packager/base/atomicops.h"
+#include "packager/base/callback.h"
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/synchronization/lock.h"
+#include "packager/base/synchronization/waitable_event.h"
+#include "packager/base/threading/thread_local.h"
+#include "packager/base/time/time.h"
+#include "packager/media/base/spsc_ring_buffer.h"
+
+namespace edash_packager {
+namespace media {
+
+class ClosureThread;
+
+/// Takes the log messages below ERROR severity, e.g. VLOG in per-sample
+/// paths, off the logging threads: each thread queues its messages in its
+/// own lock-free ring, which a background thread drains and writes in
+/// batches. The messages of a call site are rate limited per thread. ERROR
+/// and FATAL messages are still logged synchronously, after the queued
+/// messages are written.
+/// The messages are ordered per thread only. A message logged while the ring
+/// of its thread is full is dropped; the drops are reported in the log.
+///
+/// Thread Safety: Log() and Flush() can be called from any thread.
+class AsyncLogSink {
+ public:
+  /// The callback writes a batch of formatted messages.
+  typedef base::Callback<void(const std::string&)> WriteCallback;
+
+  /// Create an AsyncLogSink and start its thread.
+  /// @param messages_per_thread is the size of the ring of each thread.
+  /// @param max_messages_per_second is the number of messages a call site
+  ///        may log per second on a thread, 0 for no limit.
+  /// @param write_callback writes the messages, on the background thread.
+  AsyncLogSink(size_t messages_per_thread,
+               int max_messages_per_second,
+               const WriteCallback& write_callback);
+
+  /// Writes the queued messages, then joins the thread. Uninstalls the sink
+  /// if it is installed.
+  ~AsyncLogSink();
+
+  /// Routes the messages of base/logging.h to this sink, in place of its
+  /// synchronous writes. At most one sink is installed at a time.
+  void Install();
+
+  /// Queues a message. Called by the logging message handler.
+  /// @param str is the formatted message, with its prefix.
+  /// @return true if the message was taken, false if it should be logged
+  ///         synchronously.
+  bool Log(int severity, const char* file, int line, const std::string& str);
+
+  /// Writes the messages queued so far.
+  void Flush();
+
+  /// @return The number of messages dropped because a ring was full.
+  uint64_t num_dropped() const;
+  /// @return The number of messages suppressed by the rate limit.
+  uint64_t num_rate_limited() const;
+
+  /// @return A callback writing to stderr.
+  static WriteCallback StderrWriteCallback();
+
+ private:
+  typedef std::pair<const char*, int> CallSite;
+  // The rate limit state of a call site.
+  struct CallSiteWindow {
+    CallSiteWindow();
+
+    base::TimeTicks start;
+    int num_messages;
+  };
+  // The messages of a thread. |ring| and |windows| are only used by that
+  // thread, and by Flush() for the consumer side of |ring|.
+  struct ThreadBuffer {
+    explicit ThreadBuffer(size_t messages_per_thread);
+    ~ThreadBuffer();
+
+    SpscRingBuffer<std::string> ring;
+    std::map<CallSite, CallSiteWindow> windows;
+    base::subtle::AtomicWord num_dropped;
+    base::subtle::AtomicWord num_rate_limited;
+  };
+
+  ThreadBuffer* GetThreadBuffer();
+  // Returns false if the message of |call_site| exceeds the rate limit.
+  bool CheckRateLimit(ThreadBuffer* buffer, const CallSite& call_site);
+  void FlusherLoop();
+
+  const size_t messages_per_thread_;
+  const int max_messages_per_second_;
+  const WriteCallback write_callback_;
+
+  base::ThreadLocalPointer<ThreadBuffer> thread_buffer_;
+  mutable base::Lock buffers_lock_;  // Lock protecting |buffers_|.
+  std::vector<ThreadBuffer*> buffers_;
+
+  base::Lock flush_lock_;  // Lock protecting the variables below.
+  std::string batch_;
+  std::string message_;
+  uint64_t num_dropped_reported_;
+  uint64_t num_rate_limited_reported_;
+
+  base::WaitableEvent flush_event_;
+  base::subtle::Atomic32 stop_;
+  scoped_ptr<ClosureThread> thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(AsyncLogSink);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_BASE_ASYNC_LOG_SINK_H_
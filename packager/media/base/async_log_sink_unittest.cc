@@ -0,0 +1,122 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/async_log_sink.h"
+
+#include <gtest/gtest.h>
+#include <string.h>
+
+#include "packager/base/bind.h"
+#include "packager/base/bind_helpers.h"
+#include "packager/base/logging.h"
+#include "packager/base/strings/string_number_conversions.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+const char kFile[] = "file.cc";
+const size_t kMessagesPerThread = 64;
+const char kReportPrefix[] = "[AsyncLogSink]";
+
+}  // namespace
+
+class AsyncLogSinkTest : public ::testing::Test {
+ protected:
+  void CreateSink(size_t messages_per_thread, int max_messages_per_second) {
+    sink_.reset(new AsyncLogSink(
+        messages_per_thread, max_messages_per_second,
+        base::Bind(&AsyncLogSinkTest::Write, base::Unretained(this))));
+  }
+
+  // Returns the messages written so far, without the reports.
+  std::vector<std::string> GetMessages() {
+    base::AutoLock auto_lock(lock_);
+    std::vector<std::string> messages;
+    size_t start = 0;
+    size_t end;
+    while ((end = output_.find('\n', start)) != std::string::npos) {
+      const std::string message = output_.substr(start, end - start);
+      if (message.compare(0, strlen(kReportPrefix), kReportPrefix) != 0)
+        messages.push_back(message);
+      start = end + 1;
+    }
+    return messages;
+  }
+
+  scoped_ptr<AsyncLogSink> sink_;
+
+ private:
+  void Write(const std::string& batch) {
+    base::AutoLock auto_lock(lock_);
+    output_ += batch;
+  }
+
+  base::Lock lock_;
+  std::string output_;
+};
+
+TEST_F(AsyncLogSinkTest, WritesQueuedMessages) {
+  CreateSink(kMessagesPerThread, 0);
+  EXPECT_TRUE(sink_->Log(logging::LOG_INFO, kFile, 1, "first\n"));
+  EXPECT_TRUE(sink_->Log(logging::LOG_WARNING, kFile, 2, "second\n"));
+  sink_->Flush();
+
+  std::vector<std::string> messages = GetMessages();
+  ASSERT_EQ(2u, messages.size());
+  EXPECT_EQ("first", messages[0]);
+  EXPECT_EQ("second", messages[1]);
+}
+
+TEST_F(AsyncLogSinkTest, ErrorsAreSynchronous) {
+  CreateSink(kMessagesPerThread, 0);
+  EXPECT_TRUE(sink_->Log(logging::LOG_INFO, kFile, 1, "before\n"));
+  EXPECT_FALSE(sink_->Log(logging::LOG_ERROR, kFile, 2, "error\n"));
+  // The messages queued before the error are already written.
+  std::vector<std::string> messages = GetMessages();
+  ASSERT_EQ(1u, messages.size());
+  EXPECT_EQ("before", messages[0]);
+}
+
+TEST_F(AsyncLogSinkTest, RateLimitsPerCallSite) {
+  const int kMaxMessagesPerSecond = 2;
+  CreateSink(kMessagesPerThread, kMaxMessagesPerSecond);
+  for (int i = 0; i < 5; ++i)
+    EXPECT_TRUE(sink_->Log(logging::LOG_INFO, kFile, 1, "site 1\n"));
+  EXPECT_TRUE(sink_->Log(logging::LOG_INFO, kFile, 2, "site 2\n"));
+  sink_->Flush();
+
+  EXPECT_EQ(3u, sink_->num_rate_limited());
+  EXPECT_EQ(3u, GetMessages().size());
+}
+
+TEST_F(AsyncLogSinkTest, CountsDroppedMessages) {
+  const size_t kSmallRing = 4;
+  const int kNumMessages = 100;
+  CreateSink(kSmallRing, 0);
+  for (int i = 0; i < kNumMessages; ++i) {
+    EXPECT_TRUE(sink_->Log(logging::LOG_INFO, kFile, 1,
+                           base::IntToString(i) + "\n"));
+  }
+  sink_->Flush();
+
+  // Some messages may be dropped, depending on the background flushes.
+  const std::vector<std::string> messages = GetMessages();
+  EXPECT_EQ(static_cast<uint64_t>(kNumMessages),
+            messages.size() + sink_->num_dropped());
+  EXPECT_EQ("0", messages[0]);
+}
+
+TEST_F(AsyncLogSinkTest, WritesQueuedMessagesOnDestruction) {
+  CreateSink(kMessagesPerThread, 0);
+  EXPECT_TRUE(sink_->Log(logging::LOG_INFO, kFile, 1, "last\n"));
+  sink_.reset();
+  EXPECT_EQ(1u, GetMessages().size());
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -92,6 +92,15 @@ bool AudioStreamInfo::IsValidConfig() const {
          sampling_frequency_ <= limits::kMaxSampleRate;
 }
 
+scoped_refptr<StreamInfo> AudioStreamInfo::Clone() const {
+  scoped_refptr<AudioStreamInfo> clone(new AudioStreamInfo(
+      track_id(), time_scale(), duration(), codec_, codec_string(), language(),
+      sample_bits_, num_channels_, sampling_frequency_, seek_preroll_ns_,
+      codec_delay_ns_, max_bitrate_, avg_bitrate_, NULL, 0, is_encrypted()));
+  CopyOptionalFieldsTo(clone.get());
+  return clone;
+}
+
 std::string AudioStreamInfo::ToString() const {
   std::string str = base::StringPrintf(
       "%s codec: %s\n sample_bits: %d\n num_channels: %d\n "
@@ -56,6 +56,7 @@ class AudioStreamInfo : public StreamInfo {
   /// @{
   bool IsValidConfig() const override;
   std::string ToString() const override;
+  scoped_refptr<StreamInfo> Clone() const override;
   /// @}
 
   AudioCodec codec() const { return codec_; }
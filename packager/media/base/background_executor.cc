@@ -0,0 +1,354 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/background_executor.h"
+
+#include <gflags/gflags.h>
+
+#include <algorithm>
+
+#include "packager/base/lazy_instance.h"
+#include "packager/base/logging.h"
+#include "packager/base/stl_util.h"
+#include "packager/base/strings/string_number_conversions.h"
+#include "packager/base/strings/stringprintf.h"
+#include "packager/base/threading/simple_thread.h"
+
+DEFINE_int32(file_io_threads,
+             256,
+             "Maximum number of threads doing file I/O in the background. "
+             "Every file opened with threaded I/O, see --io_cache_size, uses "
+             "one while it is open; the files opened beyond the limit are "
+             "read and written directly, without a cache.");
+DEFINE_int32(key_fetch_threads,
+             16,
+             "Maximum number of threads fetching keys in the background, i.e. "
+             "of key sources with key rotation producing keys at once.");
+DEFINE_int32(manifest_write_threads,
+             4,
+             "Maximum number of threads writing coalesced manifests, see "
+             "--mpd_write_coalescing_window.");
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+const char* const kQueueNames[] = {
+    "file_io",
+    "key_fetch",
+    "manifest_write",
+};
+COMPILE_ASSERT(arraysize(kQueueNames) == BackgroundExecutor::kNumQueues,
+               queue_names_mismatch);
+
+// A metric exported for every queue.
+struct MetricDescriptor {
+  const char* json_name;
+  const char* prometheus_name;
+  const char* prometheus_type;
+  const char* help;
+  std::string (*get_value)(const BackgroundExecutor::QueueStats& stats);
+};
+
+std::string GetMaxThreads(const BackgroundExecutor::QueueStats& stats) {
+  return base::SizeTToString(stats.max_threads);
+}
+std::string GetNumThreads(const BackgroundExecutor::QueueStats& stats) {
+  return base::SizeTToString(stats.num_threads);
+}
+std::string GetNumBusyThreads(const BackgroundExecutor::QueueStats& stats) {
+  return base::SizeTToString(stats.num_busy_threads);
+}
+std::string GetNumReservedThreads(
+    const BackgroundExecutor::QueueStats& stats) {
+  return base::SizeTToString(stats.num_reserved_threads);
+}
+std::string GetNumRefusedReservations(
+    const BackgroundExecutor::QueueStats& stats) {
+  return base::Uint64ToString(stats.num_refused_reservations);
+}
+std::string GetNumPendingTasks(const BackgroundExecutor::QueueStats& stats) {
+  return base::SizeTToString(stats.num_pending_tasks);
+}
+std::string GetMaxPendingTasks(const BackgroundExecutor::QueueStats& stats) {
+  return base::SizeTToString(stats.max_pending_tasks);
+}
+std::string GetNumTasks(const BackgroundExecutor::QueueStats& stats) {
+  return base::Uint64ToString(stats.num_tasks);
+}
+std::string GetWaitSeconds(const BackgroundExecutor::QueueStats& stats) {
+  return base::DoubleToString(stats.total_wait_time.InSecondsF());
+}
+std::string GetMaxWaitSeconds(const BackgroundExecutor::QueueStats& stats) {
+  return base::DoubleToString(stats.max_wait_time.InSecondsF());
+}
+
+const MetricDescriptor kMetrics[] = {
+    {"max_threads", "packager_background_max_threads", "gauge",
+     "Maximum number of threads of the background queue.", &GetMaxThreads},
+    {"threads", "packager_background_threads", "gauge",
+     "Number of threads started by the background queue.", &GetNumThreads},
+    {"busy_threads", "packager_background_busy_threads", "gauge",
+     "Number of threads of the background queue running a task.",
+     &GetNumBusyThreads},
+    {"reserved_threads", "packager_background_reserved_threads", "gauge",
+     "Number of threads of the background queue reserved for long tasks.",
+     &GetNumReservedThreads},
+    {"refused_reservations", "packager_background_refused_reservations_total",
+     "counter", "Number of reservations refused by the background queue.",
+     &GetNumRefusedReservations},
+    {"pending_tasks", "packager_background_pending_tasks", "gauge",
+     "Number of tasks waiting for a thread of the background queue.",
+     &GetNumPendingTasks},
+    {"max_pending_tasks", "packager_background_max_pending_tasks", "gauge",
+     "Largest number of tasks which waited for a thread at once.",
+     &GetMaxPendingTasks},
+    {"tasks", "packager_background_tasks_total", "counter",
+     "Number of tasks run by the background queue.", &GetNumTasks},
+    {"wait_seconds", "packager_background_wait_seconds_total", "counter",
+     "Time spent by the tasks waiting for a thread of the background queue.",
+     &GetWaitSeconds},
+    {"max_wait_seconds", "packager_background_max_wait_seconds", "gauge",
+     "Longest wait of a task for a thread of the background queue.",
+     &GetMaxWaitSeconds},
+};
+
+std::vector<size_t> GetMaxThreadsFromFlags() {
+  std::vector<size_t> max_threads(BackgroundExecutor::kNumQueues);
+  max_threads[BackgroundExecutor::kFileIoQueue] =
+      std::max(FLAGS_file_io_threads, 1);
+  max_threads[BackgroundExecutor::kKeyFetchQueue] =
+      std::max(FLAGS_key_fetch_threads, 1);
+  max_threads[BackgroundExecutor::kManifestWriteQueue] =
+      std::max(FLAGS_manifest_write_threads, 1);
+  return max_threads;
+}
+
+// Holds the process-wide executor, which is never destroyed.
+struct GlobalExecutor {
+  GlobalExecutor() : executor(GetMaxThreadsFromFlags()) {}
+  BackgroundExecutor executor;
+};
+
+base::LazyInstance<GlobalExecutor>::Leaky g_executor =
+    LAZY_INSTANCE_INITIALIZER;
+
+}  // namespace
+
+class BackgroundExecutor::Worker : public base::SimpleThread {
+ public:
+  Worker(BackgroundExecutor* executor, Queue queue, size_t index)
+      : base::SimpleThread(base::StringPrintf(
+            "%s%zu", BackgroundExecutor::GetQueueName(queue), index)),
+        executor_(executor),
+        queue_(queue) {}
+  ~Worker() override {}
+
+ private:
+  void Run() override {
+    base::Closure task;
+    while (executor_->GetTask(queue_, &task)) {
+      task.Run();
+      task.Reset();
+      executor_->OnTaskDone(queue_);
+    }
+  }
+
+  BackgroundExecutor* const executor_;
+  const Queue queue_;
+
+  DISALLOW_COPY_AND_ASSIGN(Worker);
+};
+
+BackgroundExecutor::QueueStats::QueueStats()
+    : max_threads(0),
+      num_threads(0),
+      num_busy_threads(0),
+      num_reserved_threads(0),
+      num_refused_reservations(0),
+      num_pending_tasks(0),
+      max_pending_tasks(0),
+      num_tasks(0) {}
+
+BackgroundExecutor::QueueState::QueueState(base::Lock* lock,
+                                           size_t max_threads)
+    : task_available(lock), num_idle_threads(0) {
+  stats.max_threads = max_threads;
+}
+
+BackgroundExecutor::QueueState::~QueueState() {}
+
+BackgroundExecutor::BackgroundExecutor(const std::vector<size_t>& max_threads)
+    : shutdown_(false) {
+  DCHECK_EQ(static_cast<size_t>(kNumQueues), max_threads.size());
+  for (size_t i = 0; i < max_threads.size(); ++i) {
+    DCHECK_GT(max_threads[i], 0u);
+    queues_.push_back(new QueueState(&lock_, max_threads[i]));
+  }
+}
+
+BackgroundExecutor::~BackgroundExecutor() {
+  {
+    base::AutoLock auto_lock(lock_);
+    shutdown_ = true;
+    for (QueueState* queue : queues_)
+      queue->task_available.Broadcast();
+  }
+  for (QueueState* queue : queues_) {
+    for (Worker* worker : queue->workers)
+      worker->Join();
+    STLDeleteElements(&queue->workers);
+  }
+  STLDeleteElements(&queues_);
+}
+
+// static
+BackgroundExecutor* BackgroundExecutor::GetInstance() {
+  return &g_executor.Get().executor;
+}
+
+void BackgroundExecutor::PostTask(Queue queue, const base::Closure& task) {
+  PostDelayedTask(queue, task, base::TimeDelta());
+}
+
+void BackgroundExecutor::PostDelayedTask(Queue queue,
+                                         const base::Closure& task,
+                                         base::TimeDelta delay) {
+  DCHECK(!task.is_null());
+  Worker* new_worker = NULL;
+  {
+    base::AutoLock auto_lock(lock_);
+    DCHECK(!shutdown_);
+    QueueState* state = queues_[queue];
+    state->tasks.insert(
+        std::make_pair(base::TimeTicks::Now() + delay, task));
+    state->stats.max_pending_tasks =
+        std::max(state->stats.max_pending_tasks, state->tasks.size());
+    if (state->num_idle_threads > 0)
+      state->task_available.Signal();
+    if (state->tasks.size() > state->num_idle_threads &&
+        state->workers.size() < state->stats.max_threads) {
+      new_worker = new Worker(this, queue, state->workers.size());
+      state->workers.push_back(new_worker);
+    }
+  }
+  // The worker takes the task, or a task posted since, once started.
+  if (new_worker)
+    new_worker->Start();
+}
+
+bool BackgroundExecutor::ReserveThread(Queue queue) {
+  base::AutoLock auto_lock(lock_);
+  QueueStats& stats = queues_[queue]->stats;
+  if (stats.num_reserved_threads + 1 >= stats.max_threads) {
+    ++stats.num_refused_reservations;
+    return false;
+  }
+  ++stats.num_reserved_threads;
+  return true;
+}
+
+void BackgroundExecutor::ReleaseThread(Queue queue) {
+  base::AutoLock auto_lock(lock_);
+  QueueStats& stats = queues_[queue]->stats;
+  DCHECK_GT(stats.num_reserved_threads, 0u);
+  --stats.num_reserved_threads;
+}
+
+std::vector<BackgroundExecutor::QueueStats> BackgroundExecutor::GetStats()
+    const {
+  base::AutoLock auto_lock(lock_);
+  std::vector<QueueStats> stats;
+  for (const QueueState* queue : queues_) {
+    stats.push_back(queue->stats);
+    stats.back().num_threads = queue->workers.size();
+    stats.back().num_pending_tasks = queue->tasks.size();
+  }
+  return stats;
+}
+
+// static
+const char* BackgroundExecutor::GetQueueName(Queue queue) {
+  DCHECK_GE(queue, 0);
+  DCHECK_LT(queue, kNumQueues);
+  return kQueueNames[queue];
+}
+
+// static
+std::string BackgroundExecutor::ToPrometheusText() {
+  const std::vector<QueueStats> stats = GetInstance()->GetStats();
+  std::string text;
+  for (const MetricDescriptor& metric : kMetrics) {
+    text += std::string("# HELP ") + metric.prometheus_name + " " +
+            metric.help + "\n";
+    text += std::string("# TYPE ") + metric.prometheus_name + " " +
+            metric.prometheus_type + "\n";
+    for (int i = 0; i < kNumQueues; ++i) {
+      text += std::string(metric.prometheus_name) + "{queue=\"" +
+              kQueueNames[i] + "\"} " + metric.get_value(stats[i]) + "\n";
+    }
+  }
+  return text;
+}
+
+// static
+std::string BackgroundExecutor::ToJson() {
+  const std::vector<QueueStats> stats = GetInstance()->GetStats();
+  std::string json = "{";
+  for (int i = 0; i < kNumQueues; ++i) {
+    if (i > 0)
+      json += ",";
+    json += std::string("\"") + kQueueNames[i] + "\":{";
+    for (size_t j = 0; j < arraysize(kMetrics); ++j) {
+      if (j > 0)
+        json += ",";
+      json += std::string("\"") + kMetrics[j].json_name +
+              "\":" + kMetrics[j].get_value(stats[i]);
+    }
+    json += "}";
+  }
+  json += "}";
+  return json;
+}
+
+bool BackgroundExecutor::GetTask(Queue queue, base::Closure* task) {
+  base::AutoLock auto_lock(lock_);
+  QueueState* state = queues_[queue];
+  ++state->num_idle_threads;
+  base::TimeTicks now = base::TimeTicks::Now();
+  while (state->tasks.empty() ||
+         (!shutdown_ && state->tasks.begin()->first > now)) {
+    if (state->tasks.empty() && shutdown_) {
+      --state->num_idle_threads;
+      return false;
+    }
+    if (state->tasks.empty())
+      state->task_available.Wait();
+    else
+      state->task_available.TimedWait(state->tasks.begin()->first - now);
+    now = base::TimeTicks::Now();
+  }
+  --state->num_idle_threads;
+
+  *task = state->tasks.begin()->second;
+  const base::TimeDelta wait_time =
+      std::max(now - state->tasks.begin()->first, base::TimeDelta());
+  state->tasks.erase(state->tasks.begin());
+  ++state->stats.num_busy_threads;
+  ++state->stats.num_tasks;
+  state->stats.total_wait_time += wait_time;
+  state->stats.max_wait_time = std::max(state->stats.max_wait_time, wait_time);
+  return true;
+}
+
+void BackgroundExecutor::OnTaskDone(Queue queue) {
+  base::AutoLock auto_lock(lock_);
+  --queues_[queue]->stats.num_busy_threads;
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,160 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_BASE_BACKGROUND_EXECUTOR_H_
+#define MEDIA_BASE_BACKGROUND_EXECUTOR_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "packager/base/callback.h"
+#include "packager/base/macros.h"
+#include "packager/base/synchronization/condition_variable.h"
+#include "packager/base/synchronization/lock.h"
+#include "packager/base/time/time.h"
+
+namespace edash_packager {
+namespace media {
+
+/// Runs the background work of the packager, i.e. the work which is not part
+/// of the pipeline of a stream: the I/O loops of the files, the key fetches
+/// and the manifest writes. The work is posted to named queues, each served
+/// by at most a fixed number of threads, so that the number of threads is
+/// bounded whatever the number of jobs, files and key sources.
+///
+/// The threads of a queue are started on demand, up to the limit of the
+/// queue, and then kept. The tasks of a queue run in the order they are due;
+/// they wait in the queue while all its threads are busy. Delayed tasks do
+/// not occupy a thread until they are due.
+///
+/// Tasks which run for long, e.g. the I/O loop of a file, which runs until
+/// the file is closed, must run on a reserved thread, see ReserveThread(),
+/// so that they cannot occupy all the threads of their queue: one thread of
+/// each queue is never reserved, so the other tasks always make progress.
+///
+/// Thread Safety: All the methods can be called from any thread.
+class BackgroundExecutor {
+ public:
+  /// The queues of the background work.
+  enum Queue {
+    kFileIoQueue,         ///< Threaded file I/O and files opened ahead.
+    kKeyFetchQueue,       ///< Key production of the key sources.
+    kManifestWriteQueue,  ///< Coalesced manifest writes.
+    kNumQueues,
+  };
+
+  /// Measurements of a queue.
+  struct QueueStats {
+    QueueStats();
+
+    /// Maximum number of threads of the queue.
+    size_t max_threads;
+    /// Number of threads started.
+    size_t num_threads;
+    /// Number of threads running a task.
+    size_t num_busy_threads;
+    /// Number of threads reserved by ReserveThread().
+    size_t num_reserved_threads;
+    /// Number of reservations refused because of the limit.
+    uint64_t num_refused_reservations;
+    /// Number of tasks posted and not yet running, due or not.
+    size_t num_pending_tasks;
+    /// Largest number of tasks pending at once.
+    size_t max_pending_tasks;
+    /// Number of tasks which started to run.
+    uint64_t num_tasks;
+    /// Time spent by the due tasks waiting for a thread.
+    base::TimeDelta total_wait_time;
+    /// Longest wait of a due task for a thread.
+    base::TimeDelta max_wait_time;
+  };
+
+  /// Create an executor. The threads are started on demand.
+  /// @param max_threads are the maximum numbers of threads of the queues,
+  ///        indexed by Queue. At least one each.
+  explicit BackgroundExecutor(const std::vector<size_t>& max_threads);
+
+  /// Runs the tasks which have been posted, then joins the threads.
+  ~BackgroundExecutor();
+
+  /// @return the process-wide executor, whose limits are set by the
+  ///         --file_io_threads, --key_fetch_threads and
+  ///         --manifest_write_threads flags.
+  static BackgroundExecutor* GetInstance();
+
+  /// Post a task to a queue. The task is run in one of the threads of
+  /// @a queue.
+  void PostTask(Queue queue, const base::Closure& task);
+
+  /// Post a task to a queue, to run after @a delay. The tasks posted before
+  /// the executor is destroyed run then, without waiting for their delay.
+  void PostDelayedTask(Queue queue,
+                       const base::Closure& task,
+                       base::TimeDelta delay);
+
+  /// Reserve a thread of @a queue, to run a task which runs for long. The
+  /// reservation guarantees that the task eventually runs, but does not
+  /// dedicate a particular thread: the task is posted with PostTask() as
+  /// usual. The holder of a reservation must have at most one task running
+  /// for long at a time.
+  /// @return false if all the reservable threads of @a queue are reserved,
+  ///         in which case the work must be done without a thread of the
+  ///         queue.
+  bool ReserveThread(Queue queue);
+
+  /// Cancel a reservation made by ReserveThread().
+  void ReleaseThread(Queue queue);
+
+  /// @return the measurements of all the queues, indexed by Queue.
+  std::vector<QueueStats> GetStats() const;
+
+  /// @return the name of @a queue used in the thread names and the exported
+  ///         metrics.
+  static const char* GetQueueName(Queue queue);
+
+  /// @return the measurements of the process-wide executor in the Prometheus
+  ///         text exposition format.
+  static std::string ToPrometheusText();
+
+  /// @return the measurements of the process-wide executor as a JSON object.
+  static std::string ToJson();
+
+ private:
+  class Worker;
+
+  struct QueueState {
+    QueueState(base::Lock* lock, size_t max_threads);
+    ~QueueState();
+
+    // Signaled when a task is posted or the executor shuts down.
+    base::ConditionVariable task_available;
+    // The pending tasks, by the time they are due. The tasks due at the same
+    // time stay in the order they were posted.
+    std::multimap<base::TimeTicks, base::Closure> tasks;
+    std::vector<Worker*> workers;
+    size_t num_idle_threads;
+    QueueStats stats;
+  };
+
+  // Blocks until a task of |queue| is available. Returns false once the
+  // executor shuts down and |queue| has no more tasks.
+  bool GetTask(Queue queue, base::Closure* task);
+  void OnTaskDone(Queue queue);
+
+  mutable base::Lock lock_;  // Lock protecting the variables below.
+  std::vector<QueueState*> queues_;
+  bool shutdown_;
+
+  DISALLOW_COPY_AND_ASSIGN(BackgroundExecutor);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_BASE_BACKGROUND_EXECUTOR_H_
@@ -0,0 +1,128 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "packager/base/atomicops.h"
+#include "packager/base/bind.h"
+#include "packager/base/memory/scoped_vector.h"
+#include "packager/base/synchronization/waitable_event.h"
+#include "packager/media/base/background_executor.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+const size_t kMaxThreads = 3;
+const int kNumTasks = 100;
+
+void Increment(base::subtle::Atomic32* counter) {
+  base::subtle::NoBarrier_AtomicIncrement(counter, 1);
+}
+
+void BlockUntilSignaled(base::WaitableEvent* started,
+                        base::WaitableEvent* release) {
+  started->Signal();
+  release->Wait();
+}
+
+std::vector<size_t> MaxThreads(size_t max_threads) {
+  return std::vector<size_t>(BackgroundExecutor::kNumQueues, max_threads);
+}
+
+}  // namespace
+
+TEST(BackgroundExecutorTest, RunAllTasks) {
+  base::subtle::Atomic32 counter = 0;
+  {
+    BackgroundExecutor executor(MaxThreads(kMaxThreads));
+    for (int i = 0; i < kNumTasks; ++i) {
+      executor.PostTask(BackgroundExecutor::kManifestWriteQueue,
+                        base::Bind(&Increment, &counter));
+    }
+  }
+  EXPECT_EQ(kNumTasks, base::subtle::NoBarrier_Load(&counter));
+}
+
+TEST(BackgroundExecutorTest, DelayedTask) {
+  BackgroundExecutor executor(MaxThreads(1));
+  base::subtle::Atomic32 counter = 0;
+  base::WaitableEvent done(false, false);
+  const base::TimeTicks start = base::TimeTicks::Now();
+  const base::TimeDelta delay = base::TimeDelta::FromMilliseconds(50);
+  executor.PostDelayedTask(
+      BackgroundExecutor::kManifestWriteQueue,
+      base::Bind(&base::WaitableEvent::Signal, base::Unretained(&done)),
+      delay);
+  // The delayed task does not hold back the tasks due before it.
+  executor.PostTask(BackgroundExecutor::kManifestWriteQueue,
+                    base::Bind(&Increment, &counter));
+  done.Wait();
+  EXPECT_GE(base::TimeTicks::Now() - start, delay);
+  EXPECT_EQ(1, base::subtle::NoBarrier_Load(&counter));
+}
+
+TEST(BackgroundExecutorTest, ThreadLimit) {
+  BackgroundExecutor executor(MaxThreads(kMaxThreads));
+  base::WaitableEvent release(true, false);
+  ScopedVector<base::WaitableEvent> started;
+  for (size_t i = 0; i < kMaxThreads + 2; ++i) {
+    started.push_back(new base::WaitableEvent(false, false));
+    executor.PostTask(
+        BackgroundExecutor::kFileIoQueue,
+        base::Bind(&BlockUntilSignaled, started.back(), &release));
+  }
+  for (size_t i = 0; i < kMaxThreads; ++i)
+    started[i]->Wait();
+
+  std::vector<BackgroundExecutor::QueueStats> stats = executor.GetStats();
+  const BackgroundExecutor::QueueStats& file_io_stats =
+      stats[BackgroundExecutor::kFileIoQueue];
+  EXPECT_EQ(kMaxThreads, file_io_stats.num_threads);
+  EXPECT_EQ(kMaxThreads, file_io_stats.num_busy_threads);
+  EXPECT_EQ(2u, file_io_stats.num_pending_tasks);
+  // The other queues have their own threads.
+  EXPECT_EQ(0u, stats[BackgroundExecutor::kKeyFetchQueue].num_threads);
+
+  release.Signal();
+  for (size_t i = kMaxThreads; i < started.size(); ++i)
+    started[i]->Wait();
+}
+
+TEST(BackgroundExecutorTest, OneThreadIsNeverReserved) {
+  BackgroundExecutor executor(MaxThreads(kMaxThreads));
+  for (size_t i = 0; i < kMaxThreads - 1; ++i)
+    EXPECT_TRUE(executor.ReserveThread(BackgroundExecutor::kKeyFetchQueue));
+  EXPECT_FALSE(executor.ReserveThread(BackgroundExecutor::kKeyFetchQueue));
+
+  // The long tasks of the reservations do not hold back the other tasks.
+  base::WaitableEvent release(true, false);
+  base::WaitableEvent started(false, false);
+  for (size_t i = 0; i < kMaxThreads - 1; ++i) {
+    executor.PostTask(BackgroundExecutor::kKeyFetchQueue,
+                      base::Bind(&BlockUntilSignaled, &started, &release));
+    started.Wait();
+  }
+  base::WaitableEvent done(false, false);
+  executor.PostTask(BackgroundExecutor::kKeyFetchQueue,
+                    base::Bind(&base::WaitableEvent::Signal,
+                               base::Unretained(&done)));
+  done.Wait();
+  release.Signal();
+
+  executor.ReleaseThread(BackgroundExecutor::kKeyFetchQueue);
+  EXPECT_TRUE(executor.ReserveThread(BackgroundExecutor::kKeyFetchQueue));
+  EXPECT_EQ(
+      1u,
+      executor.GetStats()[BackgroundExecutor::kKeyFetchQueue]
+          .num_refused_reservations);
+}
+
+}  // namespace media
+}  // namespace edash_packager
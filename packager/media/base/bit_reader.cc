@@ -4,19 +4,32 @@
 
 #include "packager/media/base/bit_reader.h"
 
-#include <algorithm>
-
 namespace edash_packager {
 namespace media {
 
+namespace {
+
+uint64_t LoadBigEndian64(const uint8_t* data) {
+  return static_cast<uint64_t>(data[0]) << 56 |
+         static_cast<uint64_t>(data[1]) << 48 |
+         static_cast<uint64_t>(data[2]) << 40 |
+         static_cast<uint64_t>(data[3]) << 32 |
+         static_cast<uint64_t>(data[4]) << 24 |
+         static_cast<uint64_t>(data[5]) << 16 |
+         static_cast<uint64_t>(data[6]) << 8 | static_cast<uint64_t>(data[7]);
+}
+
+}  // namespace
+
 BitReader::BitReader(const uint8_t* data, off_t size)
     : data_(data),
       initial_size_(size),
       bytes_left_(size),
-      num_remaining_bits_in_curr_byte_(0) {
+      cache_(0),
+      num_cached_bits_(0) {
   DCHECK(data_ != NULL && bytes_left_ > 0);
 
-  UpdateCurrByte();
+  RefillCache();
 }
 
 BitReader::~BitReader() {}
@@ -24,82 +37,98 @@ BitReader::~BitReader() {}
 bool BitReader::SkipBits(int num_bits) {
   DCHECK_GE(num_bits, 0);
 
-  // Skip any bits in the current byte waiting to be processed, then
-  // process full bytes until less than 8 bits remaining.
-  if (num_bits > num_remaining_bits_in_curr_byte_) {
-    num_bits -= num_remaining_bits_in_curr_byte_;
-    num_remaining_bits_in_curr_byte_ = 0;
+  if (num_bits > bits_available()) {
+    SkipToEnd();
+    return false;
+  }
+  if (num_bits == 0)
+    return true;
 
-    int num_bytes = num_bits / 8;
+  // Skip the cached bits, then whole bytes, then the remaining bits from the
+  // refilled cache.
+  if (num_bits > num_cached_bits_) {
+    num_bits -= num_cached_bits_;
+    const int num_bytes = num_bits / 8;
     num_bits %= 8;
-    if (bytes_left_ < num_bytes) {
-      bytes_left_ = 0;
-      return false;
-    }
-    bytes_left_ -= num_bytes;
     data_ += num_bytes;
-    UpdateCurrByte();
-
-    // If there is no more data remaining, only return true if we
-    // skipped all that were requested.
-    if (num_remaining_bits_in_curr_byte_ == 0)
-      return (num_bits == 0);
+    bytes_left_ -= num_bytes;
+    cache_ = 0;
+    num_cached_bits_ = 0;
+    RefillCache();
+    if (num_bits == 0)
+      return true;
   }
-
-  // Less than 8 bits remaining to skip. Use ReadBitsInternal to verify
-  // that the remaining bits we need exist, and adjust them as necessary
-  // for subsequent operations.
-  uint64_t not_needed;
-  return ReadBitsInternal(num_bits, &not_needed);
+  TakeCachedBits(num_bits);
+  return true;
 }
 
 bool BitReader::SkipBytes(int num_bytes) {
-  if (num_remaining_bits_in_curr_byte_ != 8)
+  // The current position must be byte aligned and before the end.
+  if (num_cached_bits_ % 8 != 0 || bits_available() == 0)
     return false;
-  if (num_bytes == 0)
-    return true;
-
-  data_ += num_bytes - 1;  // One additional byte in curr_byte_.
-  if (num_bytes > bytes_left_ + 1)
+  if (num_bytes > bits_available() / 8)
     return false;
-  bytes_left_ -= num_bytes - 1;
-  num_remaining_bits_in_curr_byte_ = 0;
-  UpdateCurrByte();
-  return true;
+  return SkipBits(num_bytes * 8);
 }
 
 bool BitReader::ReadBitsInternal(int num_bits, uint64_t* out) {
   DCHECK_LE(num_bits, 64);
 
   *out = 0;
-
-  while (num_remaining_bits_in_curr_byte_ != 0 && num_bits != 0) {
-    int bits_to_take = std::min(num_remaining_bits_in_curr_byte_, num_bits);
-
-    *out <<= bits_to_take;
-    *out += curr_byte_ >> (num_remaining_bits_in_curr_byte_ - bits_to_take);
-    num_bits -= bits_to_take;
-    num_remaining_bits_in_curr_byte_ -= bits_to_take;
-    curr_byte_ &= (1 << num_remaining_bits_in_curr_byte_) - 1;
-
-    if (num_remaining_bits_in_curr_byte_ == 0)
-      UpdateCurrByte();
+  if (num_bits == 0)
+    return true;
+  if (num_bits > bits_available()) {
+    SkipToEnd();
+    return false;
   }
 
-  return num_bits == 0;
+  if (num_bits > num_cached_bits_) {
+    // Take all the cached bits, which are the high bits of |*out|.
+    const int num_high_bits = num_cached_bits_;
+    if (num_high_bits > 0)
+      *out = TakeCachedBits(num_high_bits);
+    num_bits -= num_high_bits;
+    cache_ = 0;
+    RefillCache();
+    *out <<= num_bits;
+  }
+  *out |= TakeCachedBits(num_bits);
+  return true;
 }
 
-void BitReader::UpdateCurrByte() {
-  DCHECK_EQ(num_remaining_bits_in_curr_byte_, 0);
-
-  if (bytes_left_ == 0)
+void BitReader::RefillCache() {
+  if (bytes_left_ >= 8) {
+    // The bits of the partial byte which does not fit are loaded too, they
+    // are loaded again by the next refill.
+    cache_ |= LoadBigEndian64(data_) >> num_cached_bits_;
+    const int num_bytes = (64 - num_cached_bits_) / 8;
+    data_ += num_bytes;
+    bytes_left_ -= num_bytes;
+    num_cached_bits_ += num_bytes * 8;
     return;
+  }
+  while (num_cached_bits_ <= 56 && bytes_left_ > 0) {
+    cache_ |= static_cast<uint64_t>(*data_) << (56 - num_cached_bits_);
+    ++data_;
+    --bytes_left_;
+    num_cached_bits_ += 8;
+  }
+}
+
+uint64_t BitReader::TakeCachedBits(int num_bits) {
+  DCHECK_GT(num_bits, 0);
+  DCHECK_LE(num_bits, num_cached_bits_);
+  const uint64_t bits = cache_ >> (64 - num_bits);
+  cache_ = num_bits == 64 ? 0 : cache_ << num_bits;
+  num_cached_bits_ -= num_bits;
+  return bits;
+}
 
-  // Load a new byte and advance pointers.
-  curr_byte_ = *data_;
-  ++data_;
-  --bytes_left_;
-  num_remaining_bits_in_curr_byte_ = 8;
+void BitReader::SkipToEnd() {
+  data_ += bytes_left_;
+  bytes_left_ = 0;
+  cache_ = 0;
+  num_cached_bits_ = 0;
 }
 
 }  // namespace media
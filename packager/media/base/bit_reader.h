@@ -9,6 +9,7 @@
 #include <sys/types.h>
 
 #include "packager/base/logging.h"
+#include "packager/media/base/hot_path.h"
 
 namespace edash_packager {
 namespace media {
@@ -33,7 +34,7 @@ class BitReader {
   ///         operations will always return false unless @a num_bits is 0.
   template <typename T>
   bool ReadBits(int num_bits, T* out) {
-    DCHECK_LE(num_bits, static_cast<int>(sizeof(T) * 8));
+    HOT_DCHECK_LE(num_bits, static_cast<int>(sizeof(T) * 8));
     uint64_t temp;
     bool ret = ReadBitsInternal(num_bits, &temp);
     *out = static_cast<T>(temp);
@@ -73,9 +74,7 @@ class BitReader {
   bool SkipBytes(int num_bytes);
 
   /// @return The number of bits available for reading.
-  int bits_available() const {
-    return 8 * bytes_left_ + num_remaining_bits_in_curr_byte_;
-  }
+  int bits_available() const { return 8 * bytes_left_ + num_cached_bits_; }
 
   /// @return The current bit position.
   int bit_position() const { return 8 * initial_size_ - bits_available(); }
@@ -84,27 +83,33 @@ class BitReader {
   // Help function used by ReadBits to avoid inlining the bit reading logic.
   bool ReadBitsInternal(int num_bits, uint64_t* out);
 
-  // Advance to the next byte, loading it into curr_byte_.
-  // If the num_remaining_bits_in_curr_byte_ is 0 after this function returns,
-  // the stream has reached the end.
-  void UpdateCurrByte();
+  // Loads as many whole bytes as fit into cache_, eight at a time when
+  // possible.
+  void RefillCache();
+
+  // Takes |num_bits| (1 to num_cached_bits_ inclusive) from cache_.
+  uint64_t TakeCachedBits(int num_bits);
+
+  // Drops all the remaining bits, to enter the failed state.
+  void SkipToEnd();
 
-  // Pointer to the next unread (not in curr_byte_) byte in the stream.
+  // Pointer to the next byte not loaded in cache_.
   const uint8_t* data_;
 
   // Initial size of the input data.
   // TODO(kqyang): Use size_t instead of off_t instead.
   off_t initial_size_;
 
-  // Bytes left in the stream (without the curr_byte_).
+  // Bytes left in the stream (without the bytes in cache_).
   off_t bytes_left_;
 
-  // Contents of the current byte; first unread bit starting at position
-  // 8 - num_remaining_bits_in_curr_byte_ from MSB.
-  uint8_t curr_byte_;
+  // Cached bits, starting with the first unread bit at the MSB. The bits
+  // after the first num_cached_bits_ are either zero or the next bits of the
+  // stream.
+  uint64_t cache_;
 
-  // Number of bits remaining in curr_byte_
-  int num_remaining_bits_in_curr_byte_;
+  // Number of unread bits in cache_.
+  int num_cached_bits_;
 
  private:
   DISALLOW_COPY_AND_ASSIGN(BitReader);
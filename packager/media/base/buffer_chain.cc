@@ -0,0 +1,103 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/buffer_chain.h"
+
+#include "packager/base/logging.h"
+#include "packager/media/base/media_sample.h"
+#include "packager/media/base/segment_checksum.h"
+#include "packager/media/file/file.h"
+
+namespace edash_packager {
+namespace media {
+
+BufferChain::Block::Block() : offset(0), size(0) {}
+BufferChain::Block::~Block() {}
+
+BufferChain::BufferChain() : size_(0) {}
+BufferChain::~BufferChain() {}
+
+void BufferChain::AppendBuffer(const BufferWriter& buffer) {
+  if (buffer.Size() == 0)
+    return;
+  // Consecutive buffers are contiguous in |owned_data_|, so they are merged.
+  if (blocks_.empty() || blocks_.back().sample) {
+    blocks_.resize(blocks_.size() + 1);
+    blocks_.back().offset = owned_data_.Size();
+  }
+  blocks_.back().size += buffer.Size();
+  owned_data_.AppendBuffer(buffer);
+  size_ += buffer.Size();
+}
+
+void BufferChain::AppendSample(const scoped_refptr<MediaSample>& sample) {
+  DCHECK(sample);
+  if (sample->data_size() == 0)
+    return;
+  blocks_.resize(blocks_.size() + 1);
+  Block& block = blocks_.back();
+  block.sample = sample;
+  block.size = sample->data_size();
+  size_ += block.size;
+}
+
+void BufferChain::Clear() {
+  owned_data_.Clear();
+  blocks_.clear();
+  size_ = 0;
+}
+
+void BufferChain::AddToChecksum(SegmentChecksum* checksum) const {
+  DCHECK(checksum);
+  for (const Block& block : blocks_) {
+    checksum->Update(block.sample ? block.sample->data()
+                                  : owned_data_.Buffer() + block.offset,
+                     block.size);
+  }
+}
+
+Status BufferChain::WriteToFile(File* file) {
+  DCHECK(file);
+  DCHECK(!blocks_.empty());
+
+  // The pointers into |owned_data_| are only stable once it is complete.
+  std::vector<File::WriteBlock> write_blocks(blocks_.size());
+  for (size_t i = 0; i < blocks_.size(); ++i) {
+    const Block& block = blocks_[i];
+    write_blocks[i].data = block.sample
+                               ? block.sample->data()
+                               : owned_data_.Buffer() + block.offset;
+    write_blocks[i].length = block.size;
+  }
+
+  size_t next_block = 0;
+  while (next_block < write_blocks.size()) {
+    int64_t size_written = file->WriteV(&write_blocks[next_block],
+                                        write_blocks.size() - next_block);
+    if (size_written <= 0) {
+      return Status(error::FILE_FAILURE,
+                    "Fail to write to file in BufferChain");
+    }
+    // Skip the blocks written, and the written part of a partial block.
+    while (next_block < write_blocks.size() &&
+           static_cast<uint64_t>(size_written) >=
+               write_blocks[next_block].length) {
+      size_written -= write_blocks[next_block].length;
+      ++next_block;
+    }
+    if (size_written > 0) {
+      File::WriteBlock& partial_block = write_blocks[next_block];
+      partial_block.data =
+          static_cast<const uint8_t*>(partial_block.data) + size_written;
+      partial_block.length -= size_written;
+    }
+  }
+  Clear();
+  return Status::OK;
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,79 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_BASE_BUFFER_CHAIN_H_
+#define MEDIA_BASE_BUFFER_CHAIN_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "packager/base/memory/ref_counted.h"
+#include "packager/media/base/buffer_writer.h"
+#include "packager/media/base/status.h"
+
+namespace edash_packager {
+namespace media {
+
+class File;
+class MediaSample;
+class SegmentChecksum;
+
+/// A sequence of blocks of data to be written to a file in one go, with
+/// File::WriteV(). Small blocks, e.g. boxes, are copied into a buffer owned by
+/// the chain, while the data of media samples is referenced, so it is copied
+/// only once on its way to the file.
+class BufferChain {
+ public:
+  BufferChain();
+  ~BufferChain();
+
+  /// Append a copy of the data in @a buffer.
+  void AppendBuffer(const BufferWriter& buffer);
+
+  /// Append the data of @a sample without copying it. A reference to the
+  /// sample is kept until the chain is written or cleared.
+  /// @param sample should not be modified in the meantime.
+  void AppendSample(const scoped_refptr<MediaSample>& sample);
+
+  /// @return The total size of the data in the chain.
+  uint64_t Size() const { return size_; }
+
+  /// Clear the chain. The capacity of its own buffer is retained for reuse.
+  void Clear();
+
+  /// Add the data of the chain to @a checksum, e.g. to compute the checksum
+  /// of a segment before it is written.
+  void AddToChecksum(SegmentChecksum* checksum) const;
+
+  /// Write the chain to file. The chain will be cleared after writing.
+  /// @param file should not be NULL.
+  /// @return OK on success.
+  Status WriteToFile(File* file);
+
+ private:
+  struct Block {
+    Block();
+    ~Block();
+
+    // The sample holding the data, or NULL if the data is in |owned_data_|.
+    scoped_refptr<MediaSample> sample;
+    // Offset of the data in |owned_data_|. Unused for samples.
+    size_t offset;
+    size_t size;
+  };
+
+  BufferWriter owned_data_;
+  std::vector<Block> blocks_;
+  uint64_t size_;
+
+  DISALLOW_COPY_AND_ASSIGN(BufferChain);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_BASE_BUFFER_CHAIN_H_
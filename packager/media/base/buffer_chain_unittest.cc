@@ -0,0 +1,159 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+
+#include "packager/base/files/file_util.h"
+#include "packager/media/base/buffer_chain.h"
+#include "packager/media/base/media_sample.h"
+#include "packager/media/base/segment_checksum.h"
+#include "packager/media/base/test/status_test_util.h"
+#include "packager/media/file/file.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+const bool kKeyFrame = true;
+
+// A file which writes at most |max_write_size| bytes per WriteV call, to
+// exercise partial writes.
+class PartialWriteFile : public File {
+ public:
+  explicit PartialWriteFile(size_t max_write_size)
+      : File("partial"), max_write_size_(max_write_size), num_writes_(0) {}
+  ~PartialWriteFile() override {}
+
+  bool Close() override { return true; }
+  int64_t Read(void* buffer, uint64_t length) override { return -1; }
+  int64_t Write(const void* buffer, uint64_t length) override {
+    const size_t size = std::min(max_write_size_, static_cast<size_t>(length));
+    data_.append(static_cast<const char*>(buffer), size);
+    return size;
+  }
+  int64_t WriteV(const WriteBlock* blocks, size_t num_blocks) override {
+    ++num_writes_;
+    size_t remaining_size = max_write_size_;
+    for (size_t i = 0; i < num_blocks && remaining_size > 0; ++i) {
+      const size_t size =
+          std::min(remaining_size, static_cast<size_t>(blocks[i].length));
+      data_.append(static_cast<const char*>(blocks[i].data), size);
+      remaining_size -= size;
+    }
+    return max_write_size_ - remaining_size;
+  }
+  int64_t Size() override { return data_.size(); }
+  bool Flush() override { return true; }
+  bool Seek(uint64_t position) override { return false; }
+  bool Tell(uint64_t* position) override { return false; }
+
+  const std::string& data() const { return data_; }
+  int num_writes() const { return num_writes_; }
+
+ protected:
+  bool Open() override { return true; }
+
+ private:
+  const size_t max_write_size_;
+  std::string data_;
+  int num_writes_;
+};
+
+}  // namespace
+
+class BufferChainTest : public testing::Test {
+ protected:
+  // Appends |data| to |chain_| either as a buffer or as a sample, and to
+  // |expected_data_|.
+  void AppendBuffer(const std::string& data) {
+    BufferWriter buffer;
+    buffer.AppendArray(reinterpret_cast<const uint8_t*>(data.data()),
+                       data.size());
+    chain_.AppendBuffer(buffer);
+    expected_data_ += data;
+  }
+  void AppendSample(const std::string& data) {
+    chain_.AppendSample(MediaSample::CopyFrom(
+        reinterpret_cast<const uint8_t*>(data.data()), data.size(),
+        kKeyFrame));
+    expected_data_ += data;
+  }
+
+  BufferChain chain_;
+  std::string expected_data_;
+};
+
+TEST_F(BufferChainTest, WriteToFile) {
+  AppendBuffer("moof");
+  AppendBuffer("mdat");
+  AppendSample("sample1");
+  AppendSample("sample2");
+  AppendBuffer("moof2");
+  AppendSample("sample3");
+  EXPECT_EQ(expected_data_.size(), chain_.Size());
+
+  base::FilePath path;
+  ASSERT_TRUE(base::CreateTemporaryFile(&path));
+  File* const output_file = File::Open(path.value().c_str(), "w");
+  ASSERT_TRUE(output_file != NULL);
+  ASSERT_OK(chain_.WriteToFile(output_file));
+  EXPECT_EQ(0u, chain_.Size());
+  ASSERT_TRUE(output_file->Close());
+
+  std::string data_read;
+  ASSERT_TRUE(base::ReadFileToString(path, &data_read));
+  EXPECT_EQ(expected_data_, data_read);
+  base::DeleteFile(path, false);
+}
+
+TEST_F(BufferChainTest, PartialWrites) {
+  AppendBuffer("header");
+  AppendSample("0123456789");
+  AppendSample("abc");
+  AppendBuffer("trailer");
+
+  PartialWriteFile file(4);
+  ASSERT_OK(chain_.WriteToFile(&file));
+  EXPECT_EQ(expected_data_, file.data());
+  EXPECT_EQ(7, file.num_writes());
+}
+
+TEST_F(BufferChainTest, AddToChecksum) {
+  AppendBuffer("moof");
+  AppendSample("sample1");
+  AppendBuffer("moof2");
+  AppendSample("sample2");
+
+  SegmentChecksum chain_checksum(SegmentChecksum::kSha256);
+  chain_.AddToChecksum(&chain_checksum);
+  SegmentChecksum expected_checksum(SegmentChecksum::kSha256);
+  expected_checksum.Update(expected_data_.data(), expected_data_.size());
+  EXPECT_EQ(expected_checksum.Finish(), chain_checksum.Finish());
+  // The chain is left as is.
+  EXPECT_EQ(expected_data_.size(), chain_.Size());
+}
+
+TEST_F(BufferChainTest, Clear) {
+  AppendBuffer("moof");
+  AppendSample("sample");
+  chain_.Clear();
+  EXPECT_EQ(0u, chain_.Size());
+
+  expected_data_.clear();
+  AppendSample("sample");
+  AppendBuffer("moof");
+  PartialWriteFile file(100);
+  ASSERT_OK(chain_.WriteToFile(&file));
+  EXPECT_EQ(expected_data_, file.data());
+  EXPECT_EQ(1, file.num_writes());
+}
+
+}  // namespace media
+}  // namespace edash_packager
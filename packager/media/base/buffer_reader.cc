@@ -7,12 +7,13 @@
 #include "packager/media/base/buffer_reader.h"
 
 #include "packager/base/logging.h"
+#include "packager/media/base/hot_path.h"
 
 namespace edash_packager {
 namespace media {
 
 bool BufferReader::Read1(uint8_t* v) {
-  DCHECK(v != NULL);
+  HOT_DCHECK(v != NULL);
   if (!HasBytes(1))
     return false;
   *v = buf_[pos_++];
@@ -45,7 +46,7 @@ bool BufferReader::ReadNBytesInto8s(int64_t* v, size_t num_bytes) {
 }
 
 bool BufferReader::ReadToVector(std::vector<uint8_t>* vec, size_t count) {
-  DCHECK(vec != NULL);
+  HOT_DCHECK(vec != NULL);
   if (!HasBytes(count))
     return false;
   vec->assign(buf_ + pos_, buf_ + pos_ + count);
@@ -54,7 +55,7 @@ bool BufferReader::ReadToVector(std::vector<uint8_t>* vec, size_t count) {
 }
 
 bool BufferReader::ReadToString(std::string* str, size_t size) {
-  DCHECK(str);
+  HOT_DCHECK(str);
   if (!HasBytes(size))
     return false;
   str->assign(buf_ + pos_, buf_ + pos_ + size);
@@ -76,8 +77,8 @@ bool BufferReader::Read(T* v) {
 
 template <typename T>
 bool BufferReader::ReadNBytes(T* v, size_t num_bytes) {
-  DCHECK(v != NULL);
-  DCHECK_LE(num_bytes, sizeof(*v));
+  HOT_DCHECK(v != NULL);
+  HOT_DCHECK_LE(num_bytes, sizeof(*v));
   if (!HasBytes(num_bytes))
     return false;
 
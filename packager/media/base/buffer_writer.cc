@@ -45,7 +45,7 @@ void BufferWriter::AppendInt(int64_t v) {
 }
 
 void BufferWriter::AppendNBytes(uint64_t v, size_t num_bytes) {
-  DCHECK_GE(sizeof(v), num_bytes);
+  HOT_DCHECK_GE(sizeof(v), num_bytes);
   v = base::HostToNet64(v);
   const uint8_t* data = reinterpret_cast<uint8_t*>(&v);
   AppendArray(&data[sizeof(v) - num_bytes], num_bytes);
@@ -63,6 +63,12 @@ void BufferWriter::AppendBuffer(const BufferWriter& buffer) {
   buf_.insert(buf_.end(), buffer.buf_.begin(), buffer.buf_.end());
 }
 
+uint8_t* BufferWriter::Extend(size_t size) {
+  const size_t old_size = buf_.size();
+  buf_.resize(old_size + size);
+  return buf_.data() + old_size;
+}
+
 Status BufferWriter::WriteToFile(File* file) {
   DCHECK(file);
   DCHECK(!buf_.empty());
@@ -7,9 +7,14 @@
 #ifndef MEDIA_BASE_BUFFER_WRITER_H_
 #define MEDIA_BASE_BUFFER_WRITER_H_
 
+#include <string.h>
+
 #include <vector>
 
+#include "packager/base/logging.h"
 #include "packager/base/macros.h"
+#include "packager/base/sys_byteorder.h"
+#include "packager/media/base/hot_path.h"
 #include "packager/media/base/status.h"
 
 namespace edash_packager {
@@ -50,13 +55,23 @@ class BufferWriter {
   void AppendArray(const uint8_t* buf, size_t size);
   void AppendBuffer(const BufferWriter& buffer);
 
+  /// Grow the buffer by @a size zero bytes, to be filled in place by the
+  /// caller. This is cheaper than appending many small values one by one.
+  /// @return A pointer to the appended bytes. It is invalidated by the next
+  ///         modification of the buffer.
+  uint8_t* Extend(size_t size);
+
   void Swap(BufferWriter* buffer) { buf_.swap(buffer->buf_); }
   void SwapBuffer(std::vector<uint8_t>* buffer) { buf_.swap(*buffer); }
 
+  /// Clear the buffer. Its capacity is retained for reuse.
   void Clear() { buf_.clear(); }
   size_t Size() const { return buf_.size(); }
   /// @return Underlying buffer. Behavior is undefined if the buffer size is 0.
   const uint8_t* Buffer() const { return buf_.data(); }
+  /// @return Underlying buffer, which can be modified in place. Behavior is
+  ///         undefined if the buffer size is 0.
+  uint8_t* MutableBuffer() { return buf_.data(); }
 
   /// Write the buffer to file. The internal buffer will be cleared after
   /// writing.
@@ -74,6 +89,74 @@ class BufferWriter {
   DISALLOW_COPY_AND_ASSIGN(BufferWriter);
 };
 
+/// A writer to a region of a known size, e.g. reserved at once with
+/// BufferWriter::Extend() once the size of what is written is computed. The
+/// writes are neither checked against the end of the region, except in debug
+/// builds, nor grow it, so serializing many small fields costs one store each.
+/// It has the append methods of BufferWriter.
+class UncheckedBufferWriter {
+ public:
+  /// @param buf points to the region to write to.
+  /// @param size is the size of the region. The caller must not write more.
+  UncheckedBufferWriter(uint8_t* buf, size_t size)
+      : begin_(buf), position_(buf), end_(buf + size) {}
+  ~UncheckedBufferWriter() {}
+
+  /// Same as the methods of BufferWriter.
+  /// @{
+  void AppendInt(uint8_t v) { *Advance(sizeof(v)) = v; }
+  void AppendInt(uint16_t v) { Store(base::HostToNet16(v)); }
+  void AppendInt(uint32_t v) { Store(base::HostToNet32(v)); }
+  void AppendInt(uint64_t v) { Store(base::HostToNet64(v)); }
+  void AppendInt(int16_t v) { Store(base::HostToNet16(v)); }
+  void AppendInt(int32_t v) { Store(base::HostToNet32(v)); }
+  void AppendInt(int64_t v) { Store(base::HostToNet64(v)); }
+  void AppendNBytes(uint64_t v, size_t num_bytes) {
+    HOT_DCHECK_GE(sizeof(v), num_bytes);
+    v = base::HostToNet64(v);
+    memcpy(Advance(num_bytes),
+           reinterpret_cast<const uint8_t*>(&v) + sizeof(v) - num_bytes,
+           num_bytes);
+  }
+  void AppendVector(const std::vector<uint8_t>& v) {
+    AppendArray(v.data(), v.size());
+  }
+  void AppendArray(const uint8_t* buf, size_t size) {
+    if (size > 0)
+      memcpy(Advance(size), buf, size);
+  }
+  uint8_t* Extend(size_t size) {
+    uint8_t* extension = Advance(size);
+    memset(extension, 0, size);
+    return extension;
+  }
+  /// @}
+
+  /// @return The number of bytes written.
+  size_t Size() const { return position_ - begin_; }
+
+ private:
+  // Returns where the next |size| bytes are written, and skips them.
+  uint8_t* Advance(size_t size) {
+    HOT_DCHECK_LE(size, static_cast<size_t>(end_ - position_));
+    uint8_t* position = position_;
+    position_ += size;
+    return position;
+  }
+
+  // Stores |v|, already in network byte order.
+  template <typename T>
+  void Store(T v) {
+    memcpy(Advance(sizeof(v)), &v, sizeof(v));
+  }
+
+  uint8_t* const begin_;
+  uint8_t* position_;
+  uint8_t* const end_;
+
+  DISALLOW_COPY_AND_ASSIGN(UncheckedBufferWriter);
+};
+
 }  // namespace media
 }  // namespace edash_packager
 
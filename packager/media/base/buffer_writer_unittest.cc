@@ -184,5 +184,38 @@ TEST_F(BufferWriterTest, WriteToFile) {
     EXPECT_EQ(kuint8Array[i], data_read[i]);
 }
 
+// The unchecked writer writes the same bytes as the buffer writer.
+TEST_F(BufferWriterTest, UncheckedBufferWriter) {
+  writer_->AppendInt(kuint8);
+  writer_->AppendInt(kuint16);
+  writer_->AppendInt(kint16);
+  writer_->AppendInt(kuint32);
+  writer_->AppendInt(kint32);
+  writer_->AppendInt(kuint64);
+  writer_->AppendInt(kint64);
+  writer_->AppendNBytes(kuint64, 5);
+  writer_->AppendArray(kuint8Array, sizeof(kuint8Array));
+  writer_->Extend(3);
+
+  BufferWriter buffer_writer;
+  const size_t kSize = writer_->Size();
+  UncheckedBufferWriter unchecked_writer(buffer_writer.Extend(kSize), kSize);
+  unchecked_writer.AppendInt(kuint8);
+  unchecked_writer.AppendInt(kuint16);
+  unchecked_writer.AppendInt(kint16);
+  unchecked_writer.AppendInt(kuint32);
+  unchecked_writer.AppendInt(kint32);
+  unchecked_writer.AppendInt(kuint64);
+  unchecked_writer.AppendInt(kint64);
+  unchecked_writer.AppendNBytes(kuint64, 5);
+  unchecked_writer.AppendArray(kuint8Array, sizeof(kuint8Array));
+  unchecked_writer.Extend(3);
+  ASSERT_EQ(kSize, unchecked_writer.Size());
+
+  EXPECT_EQ(std::vector<uint8_t>(writer_->Buffer(), writer_->Buffer() + kSize),
+            std::vector<uint8_t>(buffer_writer.Buffer(),
+                                 buffer_writer.Buffer() + kSize));
+}
+
 }  // namespace media
 }  // namespace edash_packager
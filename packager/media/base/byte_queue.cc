@@ -13,7 +13,7 @@ namespace media {
 enum { kDefaultQueueSize = 1024 };
 
 ByteQueue::ByteQueue()
-    : buffer_(new uint8_t[kDefaultQueueSize]),
+    : buffer_(new SharedBuffer(kDefaultQueueSize)),
       size_(kDefaultQueueSize),
       offset_(0),
       used_(0) {
@@ -22,6 +22,9 @@ ByteQueue::ByteQueue()
 ByteQueue::~ByteQueue() {}
 
 void ByteQueue::Reset() {
+  // The content of a shared buffer must be left intact.
+  if (IsBufferShared())
+    buffer_ = new SharedBuffer(size_);
   offset_ = 0;
   used_ = 0;
 }
@@ -41,15 +44,11 @@ void ByteQueue::Push(const uint8_t* data, int size) {
     // Sanity check to make sure we didn't overflow.
     CHECK_GT(new_size, size_);
 
-    scoped_ptr<uint8_t[]> new_buffer(new uint8_t[new_size]);
-
-    // Copy the data from the old buffer to the start of the new one.
-    if (used_ > 0)
-      memcpy(new_buffer.get(), front(), used_);
-
-    buffer_.reset(new_buffer.release());
-    size_ = new_size;
-    offset_ = 0;
+    Reallocate(new_size);
+  } else if ((offset_ + used_ + size) > size_ && IsBufferShared()) {
+    // The buffer is big enough, but its content is referenced, thus cannot be
+    // moved.
+    Reallocate(size_);
   } else if ((offset_ + used_ + size) > size_) {
     // The buffer is big enough, but we need to move the data in the queue.
     memmove(buffer_.get(), front(), used_);
@@ -73,15 +72,29 @@ void ByteQueue::Pop(int count) {
   offset_ += count;
   used_ -= count;
 
-  // Move the offset back to 0 if we have reached the end of the buffer.
-  if (offset_ == size_) {
+  // Move the offset back to 0 if we have reached the end of the buffer, unless
+  // the content is referenced.
+  if (offset_ == size_ && !IsBufferShared()) {
     DCHECK_EQ(used_, 0);
     offset_ = 0;
   }
 }
 
 uint8_t* ByteQueue::front() const {
-  return buffer_.get() + offset_;
+  return buffer_->data() + offset_;
+}
+
+void ByteQueue::Reallocate(size_t new_size) {
+  DCHECK_GE(new_size, static_cast<size_t>(used_));
+  scoped_refptr<SharedBuffer> new_buffer(new SharedBuffer(new_size));
+
+  // Copy the data from the old buffer to the start of the new one.
+  if (used_ > 0)
+    memcpy(new_buffer->data(), front(), used_);
+
+  buffer_ = new_buffer;
+  size_ = new_size;
+  offset_ = 0;
 }
 
 }  // namespace media
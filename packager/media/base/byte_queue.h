@@ -7,7 +7,9 @@
 
 #include <stdint.h>
 
+#include "packager/base/memory/ref_counted.h"
 #include "packager/base/memory/scoped_ptr.h"
+#include "packager/media/base/shared_buffer.h"
 
 namespace edash_packager {
 namespace media {
@@ -36,11 +38,26 @@ class ByteQueue {
   /// @param count specifies number of bytes to be popped.
   void Pop(int count);
 
+  /// @return The buffer backing the queue. Data returned by Peek() lies within
+  ///         this buffer and is guaranteed not to be modified or freed as long
+  ///         as a reference to the buffer is held, so it can be referenced
+  ///         without being copied (see MediaSample::CreateFromSharedBuffer).
+  ///         While referenced, the queue moves to a new buffer instead of
+  ///         reusing the memory.
+  const scoped_refptr<SharedBuffer>& shared_buffer() const { return buffer_; }
+
  private:
   // Returns a pointer to the front of the queue.
   uint8_t* front() const;
 
-  scoped_ptr<uint8_t[]> buffer_;
+  // Returns true if |buffer_| is referenced outside of the queue, in which
+  // case the bytes already pushed must not be overwritten.
+  bool IsBufferShared() const { return !buffer_->HasOneRef(); }
+
+  // Move the queue content to a new buffer of |new_size| bytes.
+  void Reallocate(size_t new_size);
+
+  scoped_refptr<SharedBuffer> buffer_;
 
   // Size of |buffer_|.
   size_t size_;
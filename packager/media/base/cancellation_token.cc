@@ -0,0 +1,51 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/cancellation_token.h"
+
+#include "packager/base/lazy_instance.h"
+#include "packager/base/threading/thread_local.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+base::LazyInstance<base::ThreadLocalPointer<CancellationToken> >::Leaky
+    g_current_token = LAZY_INSTANCE_INITIALIZER;
+
+}  // namespace
+
+CancellationToken::CancellationToken()
+    : cancelled_(0), cancelled_event_(true, false) {}
+
+CancellationToken::~CancellationToken() {}
+
+void CancellationToken::Cancel() {
+  base::subtle::Release_Store(&cancelled_, 1);
+  cancelled_event_.Signal();
+}
+
+bool CancellationToken::WaitForCancellation(base::TimeDelta max_wait) {
+  return cancelled_event_.TimedWait(max_wait) || IsCancelled();
+}
+
+// static
+CancellationToken* CancellationToken::Current() {
+  return g_current_token.Get().Get();
+}
+
+ScopedCancellationToken::ScopedCancellationToken(CancellationToken* token)
+    : previous_token_(CancellationToken::Current()) {
+  g_current_token.Get().Set(token);
+}
+
+ScopedCancellationToken::~ScopedCancellationToken() {
+  g_current_token.Get().Set(previous_token_);
+}
+
+}  // namespace media
+}  // namespace edash_packager
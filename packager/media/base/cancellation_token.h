@@ -0,0 +1,87 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_BASE_CANCELLATION_TOKEN_H_
+#define MEDIA_BASE_CANCELLATION_TOKEN_H_
+
+#include <stdint.h>
+
+#include "packager/base/atomicops.h"
+#include "packager/base/memory/ref_counted.h"
+#include "packager/base/synchronization/waitable_event.h"
+#include "packager/base/time/time.h"
+
+namespace edash_packager {
+namespace media {
+
+/// Upper bound, in milliseconds, of the slices of the blocking waits which
+/// check a CancellationToken, i.e. of the time a cancelled wait may take to
+/// return.
+const int64_t kCancellationCheckIntervalMs = 10;
+
+/// Cancellation of a packaging job. The token of a job is the current token,
+/// see ScopedCancellationToken, of the threads running it; the blocking waits
+/// of the pipeline (sample channels, queues, I/O caches, key fetches) pick up
+/// the current token of the thread starting them and return a CANCELLED
+/// status, or an I/O error, soon after the token is cancelled.
+///
+/// Thread Safety: All the methods can be called from any thread.
+class CancellationToken : public base::RefCountedThreadSafe<CancellationToken> {
+ public:
+  CancellationToken();
+
+  /// Cancels the job. Cancelling a token twice has no further effect.
+  void Cancel();
+
+  /// @return true if the token has been cancelled.
+  bool IsCancelled() const {
+    return base::subtle::Acquire_Load(&cancelled_) != 0;
+  }
+
+  /// Sleeps for @a max_wait, or until the token is cancelled.
+  /// @return true if the token is cancelled.
+  bool WaitForCancellation(base::TimeDelta max_wait);
+
+  /// @return the current token of the calling thread, or NULL if it has none.
+  static CancellationToken* Current();
+
+  /// @return true if the current token of the calling thread is cancelled.
+  static bool IsCurrentCancelled() {
+    CancellationToken* token = Current();
+    return token && token->IsCancelled();
+  }
+
+ private:
+  friend class base::RefCountedThreadSafe<CancellationToken>;
+  ~CancellationToken();
+
+  base::subtle::Atomic32 cancelled_;
+  base::WaitableEvent cancelled_event_;
+
+  DISALLOW_COPY_AND_ASSIGN(CancellationToken);
+};
+
+/// Makes a token the current token of the calling thread for the lifetime of
+/// the object, then restores the previous one. The tasks of a job run under
+/// it, and the threads a job creates propagate it, since it is not inherited
+/// like the CPU affinity.
+class ScopedCancellationToken {
+ public:
+  /// @param token is the token, which must outlive the object. NULL clears
+  ///        the current token.
+  explicit ScopedCancellationToken(CancellationToken* token);
+  ~ScopedCancellationToken();
+
+ private:
+  CancellationToken* previous_token_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedCancellationToken);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_BASE_CANCELLATION_TOKEN_H_
@@ -0,0 +1,84 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+
+#include "packager/base/bind.h"
+#include "packager/base/timer/elapsed_timer.h"
+#include "packager/media/base/cancellation_token.h"
+#include "packager/media/base/closure_thread.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+const int64_t kLongWaitMs = 10000;
+
+void CancelToken(CancellationToken* token) {
+  token->Cancel();
+}
+
+void GetCurrentToken(CancellationToken** token) {
+  *token = CancellationToken::Current();
+}
+}  // namespace
+
+TEST(CancellationTokenTest, Cancel) {
+  scoped_refptr<CancellationToken> token(new CancellationToken);
+  EXPECT_FALSE(token->IsCancelled());
+  EXPECT_FALSE(token->WaitForCancellation(base::TimeDelta()));
+  token->Cancel();
+  EXPECT_TRUE(token->IsCancelled());
+  EXPECT_TRUE(token->WaitForCancellation(base::TimeDelta()));
+  token->Cancel();
+  EXPECT_TRUE(token->IsCancelled());
+}
+
+TEST(CancellationTokenTest, CancelFromAnotherThread) {
+  scoped_refptr<CancellationToken> token(new CancellationToken);
+  ClosureThread thread("Canceller",
+                       base::Bind(&CancelToken, base::Unretained(token.get())));
+  base::ElapsedTimer timer;
+  thread.Start();
+  EXPECT_TRUE(token->WaitForCancellation(
+      base::TimeDelta::FromMilliseconds(kLongWaitMs)));
+  EXPECT_LT(timer.Elapsed().InMilliseconds(), kLongWaitMs);
+  thread.Join();
+}
+
+TEST(CancellationTokenTest, ScopedCancellationToken) {
+  scoped_refptr<CancellationToken> outer_token(new CancellationToken);
+  scoped_refptr<CancellationToken> inner_token(new CancellationToken);
+  EXPECT_EQ(NULL, CancellationToken::Current());
+  {
+    ScopedCancellationToken outer_scope(outer_token.get());
+    EXPECT_EQ(outer_token.get(), CancellationToken::Current());
+    {
+      ScopedCancellationToken inner_scope(inner_token.get());
+      EXPECT_EQ(inner_token.get(), CancellationToken::Current());
+      EXPECT_FALSE(CancellationToken::IsCurrentCancelled());
+      inner_token->Cancel();
+      EXPECT_TRUE(CancellationToken::IsCurrentCancelled());
+    }
+    EXPECT_EQ(outer_token.get(), CancellationToken::Current());
+    EXPECT_FALSE(CancellationToken::IsCurrentCancelled());
+  }
+  EXPECT_EQ(NULL, CancellationToken::Current());
+}
+
+// The current token is not inherited by the threads created.
+TEST(CancellationTokenTest, CurrentTokenIsPerThread) {
+  scoped_refptr<CancellationToken> token(new CancellationToken);
+  ScopedCancellationToken scope(token.get());
+  CancellationToken* thread_token = token.get();
+  ClosureThread thread("Getter", base::Bind(&GetCurrentToken, &thread_token));
+  thread.Start();
+  thread.Join();
+  EXPECT_EQ(NULL, thread_token);
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,137 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/coalescing_writer.h"
+
+#include "packager/base/bind.h"
+#include "packager/base/logging.h"
+#include "packager/base/synchronization/condition_variable.h"
+#include "packager/base/synchronization/lock.h"
+#include "packager/media/base/background_executor.h"
+
+namespace edash_packager {
+namespace media {
+
+class CoalescingWriter::State : public base::RefCountedThreadSafe<State> {
+ public:
+  State(const WriteCallback& write_callback, base::TimeDelta window)
+      : write_callback(write_callback),
+        window(window),
+        condition(&lock),
+        requested(0),
+        written(0),
+        num_writes(0),
+        write_failed(false),
+        writing(false),
+        write_posted(false),
+        stopped(false) {}
+
+  // Writes the requests made so far on the calling thread. |lock| must be
+  // held, and no write be in progress.
+  void Write() {
+    DCHECK(!writing);
+    writing = true;
+    // Requests made during the write are covered by the next one.
+    const uint64_t covered = requested;
+    bool success = false;
+    {
+      base::AutoUnlock auto_unlock(lock);
+      success = write_callback.Run();
+    }
+    if (!success)
+      write_failed = true;
+    written = covered;
+    ++num_writes;
+    writing = false;
+    condition.Broadcast();
+  }
+
+  const WriteCallback write_callback;
+  const base::TimeDelta window;
+
+  base::Lock lock;  // Lock protecting the variables below.
+  base::ConditionVariable condition;
+  // The requests are numbered. |written| is the number of the last request
+  // covered by a completed write.
+  uint64_t requested;
+  uint64_t written;
+  uint64_t num_writes;
+  bool write_failed;
+  bool writing;
+  // Whether a write task is posted for the current burst.
+  bool write_posted;
+  // Set once the writer is destroyed: |write_callback| must not run anymore.
+  bool stopped;
+
+ private:
+  friend class base::RefCountedThreadSafe<State>;
+  ~State() {}
+
+  DISALLOW_COPY_AND_ASSIGN(State);
+};
+
+CoalescingWriter::CoalescingWriter(const WriteCallback& write_callback,
+                                   base::TimeDelta window)
+    : state_(new State(write_callback, window)) {
+  DCHECK(!write_callback.is_null());
+}
+
+CoalescingWriter::~CoalescingWriter() {
+  base::AutoLock auto_lock(state_->lock);
+  state_->stopped = true;
+  while (state_->writing)
+    state_->condition.Wait();
+  if (state_->written < state_->requested)
+    state_->Write();
+}
+
+void CoalescingWriter::RequestWrite() {
+  base::AutoLock auto_lock(state_->lock);
+  DCHECK(!state_->stopped);
+  ++state_->requested;
+  // Only the first request of a burst posts a write, which lets the other
+  // requests of the burst come in during the window.
+  if (!state_->write_posted) {
+    state_->write_posted = true;
+    BackgroundExecutor::GetInstance()->PostDelayedTask(
+        BackgroundExecutor::kManifestWriteQueue,
+        base::Bind(&CoalescingWriter::WriteTask, state_), state_->window);
+  }
+}
+
+bool CoalescingWriter::Flush() {
+  base::AutoLock auto_lock(state_->lock);
+  const uint64_t target = state_->requested;
+  while (state_->written < target) {
+    if (state_->writing)
+      state_->condition.Wait();
+    else
+      state_->Write();
+  }
+
+  const bool success = !state_->write_failed;
+  state_->write_failed = false;
+  return success;
+}
+
+uint64_t CoalescingWriter::num_writes() const {
+  base::AutoLock auto_lock(state_->lock);
+  return state_->num_writes;
+}
+
+// static
+void CoalescingWriter::WriteTask(const scoped_refptr<State>& state) {
+  base::AutoLock auto_lock(state->lock);
+  state->write_posted = false;
+  // The requests of the burst may be written by Flush() already.
+  while (state->writing && !state->stopped)
+    state->condition.Wait();
+  if (!state->stopped && state->written < state->requested)
+    state->Write();
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,70 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_BASE_COALESCING_WRITER_H_
+#define MEDIA_BASE_COALESCING_WRITER_H_
+
+#include <stdint.h>
+
+#include "packager/base/callback.h"
+#include "packager/base/memory/ref_counted.h"
+#include "packager/base/time/time.h"
+
+namespace edash_packager {
+namespace media {
+
+/// Runs a write callback on the manifest write queue of the
+/// BackgroundExecutor, e.g. to write a manifest, without blocking the threads
+/// requesting the writes. The requests made within a window are coalesced
+/// into a single write, so a burst of updates is written once.
+///
+/// Thread Safety: RequestWrite() and Flush() can be called from any thread.
+class CoalescingWriter {
+ public:
+  /// The callback does the actual write. Returns true on success.
+  typedef base::Callback<bool()> WriteCallback;
+
+  /// Create a CoalescingWriter.
+  /// @param write_callback is run for every write, never concurrently.
+  /// @param window is how long to wait after the first request of a burst
+  ///        before writing, so later requests get coalesced with it.
+  CoalescingWriter(const WriteCallback& write_callback,
+                   base::TimeDelta window);
+
+  /// Waits for the write in progress, if any, then runs the last write on the
+  /// calling thread if any request is pending.
+  ~CoalescingWriter();
+
+  /// Requests a write. Returns immediately; the write happens on the manifest
+  /// write queue about @a window later.
+  void RequestWrite();
+
+  /// Waits until the requests made so far have been written, without waiting
+  /// for the end of the current window: the pending requests are written on
+  /// the calling thread.
+  /// @return false if any write failed since the last call, true otherwise.
+  bool Flush();
+
+  /// @return The number of writes done so far.
+  uint64_t num_writes() const;
+
+ private:
+  // The state shared with the write tasks, which may run after the writer
+  // is destroyed.
+  class State;
+
+  // Writes the burst of requests of |state| once its window is over.
+  static void WriteTask(const scoped_refptr<State>& state);
+
+  scoped_refptr<State> state_;
+
+  DISALLOW_COPY_AND_ASSIGN(CoalescingWriter);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_BASE_COALESCING_WRITER_H_
@@ -0,0 +1,100 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+
+#include "packager/base/atomicops.h"
+#include "packager/base/bind.h"
+#include "packager/base/synchronization/waitable_event.h"
+#include "packager/base/threading/platform_thread.h"
+#include "packager/media/base/coalescing_writer.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+const int kNumRequests = 100;
+
+bool CountWrite(base::subtle::Atomic32* counter, bool result) {
+  base::subtle::NoBarrier_AtomicIncrement(counter, 1);
+  return result;
+}
+
+bool BlockUntilSignaled(base::WaitableEvent* started,
+                        base::WaitableEvent* release) {
+  started->Signal();
+  release->Wait();
+  return true;
+}
+
+}  // namespace
+
+TEST(CoalescingWriterTest, CoalescesBurst) {
+  base::subtle::Atomic32 counter = 0;
+  // A window much longer than the test, so only Flush() triggers the write.
+  CoalescingWriter writer(base::Bind(&CountWrite, &counter, true),
+                          base::TimeDelta::FromHours(1));
+  for (int i = 0; i < kNumRequests; ++i)
+    writer.RequestWrite();
+  EXPECT_TRUE(writer.Flush());
+  EXPECT_EQ(1, base::subtle::NoBarrier_Load(&counter));
+  EXPECT_EQ(1u, writer.num_writes());
+
+  // Nothing is written without a new request.
+  EXPECT_TRUE(writer.Flush());
+  EXPECT_EQ(1, base::subtle::NoBarrier_Load(&counter));
+}
+
+TEST(CoalescingWriterTest, WritesAfterWindow) {
+  base::subtle::Atomic32 counter = 0;
+  CoalescingWriter writer(base::Bind(&CountWrite, &counter, true),
+                          base::TimeDelta::FromMilliseconds(1));
+  writer.RequestWrite();
+  while (writer.num_writes() == 0)
+    base::PlatformThread::YieldCurrentThread();
+  EXPECT_EQ(1, base::subtle::NoBarrier_Load(&counter));
+}
+
+TEST(CoalescingWriterTest, RequestsDuringWriteAreWrittenAgain) {
+  base::WaitableEvent started(false, false);
+  base::WaitableEvent release(false, false);
+  CoalescingWriter writer(base::Bind(&BlockUntilSignaled, &started, &release),
+                          base::TimeDelta());
+  writer.RequestWrite();
+  started.Wait();
+  // The write in progress may have read the state before these requests.
+  writer.RequestWrite();
+  writer.RequestWrite();
+  release.Signal();
+  started.Wait();
+  release.Signal();
+  EXPECT_TRUE(writer.Flush());
+  EXPECT_EQ(2u, writer.num_writes());
+}
+
+TEST(CoalescingWriterTest, FlushReportsFailure) {
+  base::subtle::Atomic32 counter = 0;
+  CoalescingWriter writer(base::Bind(&CountWrite, &counter, false),
+                          base::TimeDelta::FromHours(1));
+  writer.RequestWrite();
+  EXPECT_FALSE(writer.Flush());
+  // The failure is reported once.
+  EXPECT_TRUE(writer.Flush());
+}
+
+TEST(CoalescingWriterTest, WritesPendingRequestOnDestruction) {
+  base::subtle::Atomic32 counter = 0;
+  {
+    CoalescingWriter writer(base::Bind(&CountWrite, &counter, true),
+                            base::TimeDelta::FromHours(1));
+    writer.RequestWrite();
+  }
+  EXPECT_EQ(1, base::subtle::NoBarrier_Load(&counter));
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -1715,6 +1715,29 @@ MediaContainerName DetermineContainer(const uint8_t* buffer, int buffer_size) {
   return CONTAINER_UNKNOWN;
 }
 
+MediaContainerName DetermineContainerFromPrefix(const uint8_t* buffer,
+                                                int buffer_size) {
+  DCHECK(buffer);
+  // A few transport stream packets, i.e. a typical UDP datagram, so that the
+  // sync bytes of several packets are checked.
+  const int kMinMpeg2TransportStreamSize = 7 * 188;
+
+  // Only the containers identified by a signature at the start of the stream,
+  // which more data would not change.
+  const MediaContainerName result = DetermineContainer(buffer, buffer_size);
+  switch (result) {
+    case CONTAINER_MOV:
+    case CONTAINER_WEBM:
+    case CONTAINER_WEBVTT:
+      return result;
+    case CONTAINER_MPEG2TS:
+      return buffer_size >= kMinMpeg2TransportStreamSize ? result
+                                                         : CONTAINER_UNKNOWN;
+    default:
+      return CONTAINER_UNKNOWN;
+  }
+}
+
 MediaContainerName DetermineContainerFromFormatName(
     const std::string& format_name) {
   if (base::EqualsCaseInsensitiveASCII(format_name, "webm")) {
@@ -1727,6 +1750,13 @@ MediaContainerName DetermineContainerFromFormatName(
   } else if (base::EqualsCaseInsensitiveASCII(format_name, "ts") ||
              base::EqualsCaseInsensitiveASCII(format_name, "mpeg2ts")) {
     return CONTAINER_MPEG2TS;
+  } else if (base::EqualsCaseInsensitiveASCII(format_name, "vtt") ||
+             base::EqualsCaseInsensitiveASCII(format_name, "webvtt")) {
+    return CONTAINER_WEBVTT;
+  } else if (base::EqualsCaseInsensitiveASCII(format_name, "ttml")) {
+    return CONTAINER_TTML;
+  } else if (base::EqualsCaseInsensitiveASCII(format_name, "wvm")) {
+    return CONTAINER_MPEG2PS;
   }
   return CONTAINER_UNKNOWN;
 }
@@ -61,8 +61,17 @@ enum MediaContainerName {
 /// Determine the container type from input data.
 MediaContainerName DetermineContainer(const uint8_t* buffer, int buffer_size);
 
+/// Determine the container type from the first bytes of a stream, before all
+/// the data needed by DetermineContainer() is available.
+/// @param buffer contains the first @a buffer_size bytes of the stream.
+/// @return the container type if it is certain from the bytes available, which
+///         is only the case for the containers with a distinctive signature,
+///         or CONTAINER_UNKNOWN if more bytes are needed.
+MediaContainerName DetermineContainerFromPrefix(const uint8_t* buffer,
+                                                int buffer_size);
+
 /// Determine the container type from the format name.
-/// @param format_name Specifies the format, e.g. 'webm', 'mov', 'mp4'.
+/// @param format_name Specifies the format, e.g. 'webm', 'mov', 'mp4', 'vtt'.
 MediaContainerName DetermineContainerFromFormatName(
     const std::string& format_name);
 
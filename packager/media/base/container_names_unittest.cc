@@ -93,6 +93,10 @@ TEST(ContainerNamesTest, FromFormatName) {
   EXPECT_EQ(CONTAINER_MOV, DetermineContainerFromFormatName("Mp4"));
   EXPECT_EQ(CONTAINER_MPEG2TS, DetermineContainerFromFormatName("ts"));
   EXPECT_EQ(CONTAINER_MPEG2TS, DetermineContainerFromFormatName("mpeg2ts"));
+  EXPECT_EQ(CONTAINER_WEBVTT, DetermineContainerFromFormatName("vtt"));
+  EXPECT_EQ(CONTAINER_WEBVTT, DetermineContainerFromFormatName("WebVTT"));
+  EXPECT_EQ(CONTAINER_TTML, DetermineContainerFromFormatName("ttml"));
+  EXPECT_EQ(CONTAINER_MPEG2PS, DetermineContainerFromFormatName("wvm"));
   EXPECT_EQ(CONTAINER_UNKNOWN, DetermineContainerFromFormatName("cat"));
   EXPECT_EQ(CONTAINER_UNKNOWN, DetermineContainerFromFormatName("amp4"));
   EXPECT_EQ(CONTAINER_UNKNOWN, DetermineContainerFromFormatName(" mp4"));
@@ -194,6 +198,40 @@ TEST(ContainerNamesTest, WebVtt) {
                                webvtt_with_utf8_byte_order_mark.size()));
 }
 
+// Determine the container type of a specified file from its first
+// |prefix_size| bytes.
+void TestFilePrefix(MediaContainerName expected,
+                    const base::FilePath& filename,
+                    int prefix_size) {
+  std::vector<char> buffer(prefix_size);
+  int read = base::ReadFile(filename, buffer.data(), prefix_size);
+  ASSERT_EQ(prefix_size, read) << filename.value();
+
+  EXPECT_EQ(expected, DetermineContainerFromPrefix(
+                          reinterpret_cast<const uint8_t*>(buffer.data()),
+                          read))
+      << "Failure with file " << filename.value();
+}
+
+TEST(ContainerNamesTest, FromPrefix) {
+  TestFilePrefix(CONTAINER_MOV, GetTestDataFilePath("bear-640x360.mp4"), 64);
+  TestFilePrefix(CONTAINER_WEBM, GetTestDataFilePath("bear-640x360.webm"),
+                 256);
+  TestFilePrefix(CONTAINER_MPEG2TS, GetTestDataFilePath("bear-640x360.ts"),
+                 7 * 188);
+  // Too few transport stream packets to be certain.
+  TestFilePrefix(CONTAINER_UNKNOWN, GetTestDataFilePath("bear-640x360.ts"),
+                 2 * 188);
+  // Not a container with a signature.
+  TestFilePrefix(CONTAINER_UNKNOWN, GetTestDataFilePath("bear.ogv"), 64);
+
+  const char kWebVtt[] = "WEBVTT\n";
+  EXPECT_EQ(CONTAINER_WEBVTT,
+            DetermineContainerFromPrefix(
+                reinterpret_cast<const uint8_t*>(kWebVtt),
+                arraysize(kWebVtt) - 1));
+}
+
 TEST(ContainerNamesTest, FileCheckOGG) {
   TestFile(CONTAINER_OGG, GetTestDataFilePath("bear.ogv"));
   TestFile(CONTAINER_OGG, GetTestDataFilePath("9ch.ogg"));
@@ -0,0 +1,174 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/cpu_affinity.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "packager/base/files/file_path.h"
+#include "packager/base/files/file_util.h"
+#include "packager/base/logging.h"
+#include "packager/base/strings/string_number_conversions.h"
+#include "packager/base/strings/string_split.h"
+
+#if defined(OS_LINUX)
+#include <sched.h>
+#endif
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+const char kNumaNodePrefix[] = "node:";
+
+// Sorts |cpus| and removes the duplicates.
+void Normalize(std::vector<int>* cpus) {
+  std::sort(cpus->begin(), cpus->end());
+  cpus->erase(std::unique(cpus->begin(), cpus->end()), cpus->end());
+}
+
+// Parses "<cpu>" or "<first cpu>-<last cpu>" and appends the CPUs to |cpus|.
+bool ParseCpuRange(const std::string& range, std::vector<int>* cpus) {
+  const size_t dash = range.find('-');
+  int first_cpu;
+  int last_cpu;
+  if (dash == std::string::npos) {
+    if (!base::StringToInt(range, &first_cpu))
+      return false;
+    last_cpu = first_cpu;
+  } else if (!base::StringToInt(range.substr(0, dash), &first_cpu) ||
+             !base::StringToInt(range.substr(dash + 1), &last_cpu)) {
+    return false;
+  }
+  if (first_cpu < 0 || last_cpu < first_cpu)
+    return false;
+  for (int cpu = first_cpu; cpu <= last_cpu; ++cpu)
+    cpus->push_back(cpu);
+  return true;
+}
+
+}  // namespace
+
+bool ParseCpuSet(const std::string& spec, std::vector<int>* cpus) {
+  DCHECK(cpus);
+  cpus->clear();
+  std::vector<std::string> items;
+  base::SplitString(spec, ',', &items);
+  for (const std::string& item : items) {
+    if (item.compare(0, strlen(kNumaNodePrefix), kNumaNodePrefix) == 0) {
+      int node;
+      std::vector<int> node_cpus;
+      if (!base::StringToInt(item.substr(strlen(kNumaNodePrefix)), &node) ||
+          !GetNumaNodeCpus(node, &node_cpus)) {
+        LOG(ERROR) << "Invalid NUMA node " << item;
+        return false;
+      }
+      cpus->insert(cpus->end(), node_cpus.begin(), node_cpus.end());
+    } else if (!ParseCpuRange(item, cpus)) {
+      LOG(ERROR) << "Invalid CPU range " << item;
+      return false;
+    }
+  }
+  Normalize(cpus);
+  return !cpus->empty();
+}
+
+bool ParseCpuList(const std::string& cpu_list, std::vector<int>* cpus) {
+  DCHECK(cpus);
+  cpus->clear();
+  std::vector<std::string> ranges;
+  base::SplitString(cpu_list, ',', &ranges);
+  for (const std::string& range : ranges) {
+    // An empty list is a single empty range.
+    if (range.empty() && ranges.size() == 1)
+      break;
+    if (!ParseCpuRange(range, cpus))
+      return false;
+  }
+  Normalize(cpus);
+  return true;
+}
+
+bool GetNumaNodeCpus(int node, std::vector<int>* cpus) {
+#if defined(OS_LINUX)
+  if (node < 0)
+    return false;
+  const base::FilePath cpu_list_path(
+      "/sys/devices/system/node/node" + base::IntToString(node) + "/cpulist");
+  std::string cpu_list;
+  if (!base::ReadFileToString(cpu_list_path, &cpu_list))
+    return false;
+  // The list is terminated by a new line.
+  cpu_list.erase(cpu_list.find_last_not_of(" \n") + 1);
+  return ParseCpuList(cpu_list, cpus) && !cpus->empty();
+#else
+  NOTIMPLEMENTED() << "NUMA topology is only available on Linux.";
+  return false;
+#endif
+}
+
+bool GetCurrentThreadAffinity(std::vector<int>* cpus) {
+  DCHECK(cpus);
+  cpus->clear();
+#if defined(OS_LINUX)
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  // On Linux, a pid of 0 is the calling thread rather than the process.
+  if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+    PLOG(ERROR) << "sched_getaffinity failed";
+    return false;
+  }
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (CPU_ISSET(cpu, &cpu_set))
+      cpus->push_back(cpu);
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool SetCurrentThreadAffinity(const std::vector<int>& cpus) {
+#if defined(OS_LINUX)
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (int cpu : cpus) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+      LOG(ERROR) << "Invalid CPU " << cpu;
+      return false;
+    }
+    CPU_SET(cpu, &cpu_set);
+  }
+  if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+    PLOG(ERROR) << "sched_setaffinity failed";
+    return false;
+  }
+  return true;
+#else
+  NOTIMPLEMENTED() << "CPU pinning is only supported on Linux.";
+  return false;
+#endif
+}
+
+ScopedThreadAffinity::ScopedThreadAffinity(const std::vector<int>& cpus) {
+  if (cpus.empty())
+    return;
+  if (!GetCurrentThreadAffinity(&previous_cpus_) ||
+      !SetCurrentThreadAffinity(cpus)) {
+    previous_cpus_.clear();
+  }
+}
+
+ScopedThreadAffinity::~ScopedThreadAffinity() {
+  if (!previous_cpus_.empty())
+    SetCurrentThreadAffinity(previous_cpus_);
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,73 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+//
+// Pinning of the threads of a packaging job to a set of CPUs, typically the
+// CPUs of a NUMA node. Threads inherit the CPU affinity of the thread creating
+// them, and Linux allocates the memory a thread touches first on the node it
+// runs on, so pinning the threads of a job also keeps its buffers on that
+// node.
+
+#ifndef MEDIA_BASE_CPU_AFFINITY_H_
+#define MEDIA_BASE_CPU_AFFINITY_H_
+
+#include <string>
+#include <vector>
+
+#include "packager/base/macros.h"
+
+namespace edash_packager {
+namespace media {
+
+/// Parse a CPU set specification, which is a comma separated list of CPUs,
+/// e.g. "3", of CPU ranges, e.g. "0-7", and of NUMA nodes, e.g. "node:1",
+/// which stand for all the CPUs of the node.
+/// @param spec is the specification to parse.
+/// @param[out] cpus receives the CPUs, sorted and without duplicates.
+/// @return true on success, false if @a spec is invalid or a NUMA node does
+///         not exist.
+bool ParseCpuSet(const std::string& spec, std::vector<int>* cpus);
+
+/// Parse a CPU list, in the format of /sys/devices/system/node/node<N>/cpulist,
+/// e.g. "0-7,16-23".
+/// @param cpu_list is the list to parse.
+/// @param[out] cpus receives the CPUs, sorted and without duplicates.
+/// @return true on success, false otherwise.
+bool ParseCpuList(const std::string& cpu_list, std::vector<int>* cpus);
+
+/// @param node is the index of the NUMA node.
+/// @param[out] cpus receives the CPUs of @a node.
+/// @return true on success, false if the node does not exist or the topology
+///         is not available on this platform.
+bool GetNumaNodeCpus(int node, std::vector<int>* cpus);
+
+/// @param[out] cpus receives the CPUs the calling thread may run on.
+/// @return true on success, false if not supported on this platform.
+bool GetCurrentThreadAffinity(std::vector<int>* cpus);
+
+/// Restrict the calling thread, and the threads it creates from then on, to
+/// @a cpus.
+/// @return true on success, false otherwise.
+bool SetCurrentThreadAffinity(const std::vector<int>& cpus);
+
+/// Restricts the calling thread to a set of CPUs for the lifetime of the
+/// object, then restores its previous affinity. An empty set leaves the
+/// affinity unchanged, so that pinning can be optional.
+class ScopedThreadAffinity {
+ public:
+  /// @param cpus is the set of CPUs. Nothing is done if it is empty.
+  explicit ScopedThreadAffinity(const std::vector<int>& cpus);
+  ~ScopedThreadAffinity();
+
+ private:
+  std::vector<int> previous_cpus_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedThreadAffinity);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_BASE_CPU_AFFINITY_H_
@@ -0,0 +1,60 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "packager/media/base/cpu_affinity.h"
+
+using ::testing::ElementsAre;
+
+namespace edash_packager {
+namespace media {
+
+TEST(CpuAffinityTest, ParseCpuList) {
+  std::vector<int> cpus;
+  ASSERT_TRUE(ParseCpuList("0-3,8,10-11", &cpus));
+  EXPECT_THAT(cpus, ElementsAre(0, 1, 2, 3, 8, 10, 11));
+
+  ASSERT_TRUE(ParseCpuList("", &cpus));
+  EXPECT_TRUE(cpus.empty());
+
+  EXPECT_FALSE(ParseCpuList("3-1", &cpus));
+  EXPECT_FALSE(ParseCpuList("1,,2", &cpus));
+  EXPECT_FALSE(ParseCpuList("a", &cpus));
+}
+
+TEST(CpuAffinityTest, ParseCpuSet) {
+  std::vector<int> cpus;
+  ASSERT_TRUE(ParseCpuSet("4-5,1,5", &cpus));
+  EXPECT_THAT(cpus, ElementsAre(1, 4, 5));
+
+  EXPECT_FALSE(ParseCpuSet("", &cpus));
+  EXPECT_FALSE(ParseCpuSet("node:-1", &cpus));
+  EXPECT_FALSE(ParseCpuSet("node:x", &cpus));
+}
+
+#if defined(OS_LINUX)
+TEST(CpuAffinityTest, ScopedThreadAffinity) {
+  std::vector<int> original_cpus;
+  ASSERT_TRUE(GetCurrentThreadAffinity(&original_cpus));
+  ASSERT_FALSE(original_cpus.empty());
+
+  {
+    ScopedThreadAffinity affinity(std::vector<int>(1, original_cpus[0]));
+    std::vector<int> cpus;
+    ASSERT_TRUE(GetCurrentThreadAffinity(&cpus));
+    EXPECT_THAT(cpus, ElementsAre(original_cpus[0]));
+  }
+
+  std::vector<int> cpus;
+  ASSERT_TRUE(GetCurrentThreadAffinity(&cpus));
+  EXPECT_EQ(original_cpus, cpus);
+}
+#endif  // defined(OS_LINUX)
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,53 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/cpu_features.h"
+
+#include "packager/base/cpu.h"
+#include "packager/base/lazy_instance.h"
+#include "packager/build/build_config.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+struct DetectedCpuFeatures {
+  DetectedCpuFeatures() {
+    base::CPU cpu;
+    features.has_sse2 = cpu.has_sse2();
+    features.has_ssse3 = cpu.has_ssse3();
+    features.has_sse42 = cpu.has_sse42();
+    features.has_avx2 = cpu.has_avx2();
+    features.has_aesni = cpu.has_aesni();
+#if defined(ARCH_CPU_ARM64) || defined(__ARM_NEON__)
+    // Part of the baseline of the target.
+    features.has_neon = true;
+#endif
+  }
+
+  CpuFeatures features;
+};
+
+base::LazyInstance<DetectedCpuFeatures>::Leaky g_cpu_features =
+    LAZY_INSTANCE_INITIALIZER;
+
+}  // namespace
+
+CpuFeatures::CpuFeatures()
+    : has_sse2(false),
+      has_ssse3(false),
+      has_sse42(false),
+      has_avx2(false),
+      has_aesni(false),
+      has_neon(false) {}
+
+const CpuFeatures& GetCpuFeatures() {
+  return g_cpu_features.Get().features;
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,32 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_BASE_CPU_FEATURES_H_
+#define MEDIA_BASE_CPU_FEATURES_H_
+
+namespace edash_packager {
+namespace media {
+
+/// The instruction set extensions of the CPU the packager runs on, which
+/// the media kernels are selected for, see media_kernels.h.
+struct CpuFeatures {
+  CpuFeatures();
+
+  bool has_sse2;
+  bool has_ssse3;
+  bool has_sse42;
+  bool has_avx2;
+  bool has_aesni;
+  bool has_neon;
+};
+
+/// @return The features of the CPU, detected on the first call.
+const CpuFeatures& GetCpuFeatures();
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_BASE_CPU_FEATURES_H_
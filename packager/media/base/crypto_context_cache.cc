@@ -0,0 +1,134 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/crypto_context_cache.h"
+
+#include "packager/base/logging.h"
+#include "packager/base/stl_util.h"
+#include "packager/media/base/aes_encryptor.h"
+#include "packager/media/base/aes_pattern_cryptor.h"
+#include "packager/media/base/key_source.h"
+
+namespace edash_packager {
+namespace media {
+namespace {
+
+// Enough for the track types of a few crypto periods.
+const size_t kDefaultMaxContexts = 64;
+
+// Create an uninitialized encryptor for |protection_scheme|. Returns NULL if
+// the protection scheme is not supported.
+scoped_ptr<AesCryptor> NewEncryptor(FourCC protection_scheme,
+                                    uint8_t crypt_byte_block,
+                                    uint8_t skip_byte_block) {
+  switch (protection_scheme) {
+    case FOURCC_cenc:
+      return scoped_ptr<AesCryptor>(new AesCtrEncryptor);
+    case FOURCC_cbc1:
+      return scoped_ptr<AesCryptor>(new AesCbcEncryptor(kNoPadding));
+    case FOURCC_cens:
+      return scoped_ptr<AesCryptor>(new AesPatternCryptor(
+          crypt_byte_block, skip_byte_block,
+          AesPatternCryptor::kEncryptIfCryptByteBlockRemaining,
+          AesCryptor::kDontUseConstantIv,
+          scoped_ptr<AesCryptor>(new AesCtrEncryptor())));
+    case FOURCC_cbcs:
+      return scoped_ptr<AesCryptor>(new AesPatternCryptor(
+          crypt_byte_block, skip_byte_block,
+          AesPatternCryptor::kEncryptIfCryptByteBlockRemaining,
+          AesCryptor::kUseConstantIv,
+          scoped_ptr<AesCryptor>(new AesCbcEncryptor(kNoPadding))));
+    default:
+      return scoped_ptr<AesCryptor>();
+  }
+}
+
+}  // namespace
+
+CryptoContextCache::ContextKey::ContextKey()
+    : protection_scheme(FOURCC_NULL), crypt_byte_block(0), skip_byte_block(0) {}
+CryptoContextCache::ContextKey::~ContextKey() {}
+
+bool CryptoContextCache::ContextKey::operator<(const ContextKey& other) const {
+  if (protection_scheme != other.protection_scheme)
+    return protection_scheme < other.protection_scheme;
+  if (crypt_byte_block != other.crypt_byte_block)
+    return crypt_byte_block < other.crypt_byte_block;
+  if (skip_byte_block != other.skip_byte_block)
+    return skip_byte_block < other.skip_byte_block;
+  if (key_id != other.key_id)
+    return key_id < other.key_id;
+  return key < other.key;
+}
+
+CryptoContextCache::CryptoContextCache()
+    : max_contexts_(kDefaultMaxContexts) {}
+
+CryptoContextCache::CryptoContextCache(size_t max_contexts)
+    : max_contexts_(max_contexts) {
+  DCHECK_GT(max_contexts_, 0u);
+}
+
+CryptoContextCache::~CryptoContextCache() {
+  STLDeleteValues(&contexts_);
+}
+
+Status CryptoContextCache::CreateEncryptor(const EncryptionKey& encryption_key,
+                                           FourCC protection_scheme,
+                                           uint8_t crypt_byte_block,
+                                           uint8_t skip_byte_block,
+                                           scoped_ptr<AesCryptor>* encryptor) {
+  DCHECK(encryptor);
+  DCHECK(!encryption_key.iv.empty());
+  scoped_ptr<AesCryptor> new_encryptor =
+      NewEncryptor(protection_scheme, crypt_byte_block, skip_byte_block);
+  if (!new_encryptor)
+    return Status(error::MUXER_FAILURE, "Unsupported protection scheme.");
+
+  ContextKey context_key;
+  context_key.key_id = encryption_key.key_id;
+  context_key.key = encryption_key.key;
+  context_key.protection_scheme = protection_scheme;
+  context_key.crypt_byte_block = crypt_byte_block;
+  context_key.skip_byte_block = skip_byte_block;
+
+  // The context is copied with the lock held so that it cannot be dropped in
+  // the meantime. Copying is much cheaper than expanding the key.
+  base::AutoLock auto_lock(lock_);
+  ContextMap::iterator context = contexts_.find(context_key);
+  if (context == contexts_.end()) {
+    scoped_ptr<AesCryptor> initialized_encryptor =
+        NewEncryptor(protection_scheme, crypt_byte_block, skip_byte_block);
+    if (!initialized_encryptor->InitializeWithIv(encryption_key.key,
+                                                 encryption_key.iv)) {
+      return Status(error::MUXER_FAILURE, "Failed to create the encryptor.");
+    }
+    if (contexts_.size() >= max_contexts_) {
+      delete insertion_order_.front()->second;
+      contexts_.erase(insertion_order_.front());
+      insertion_order_.pop_front();
+    }
+    context =
+        contexts_.insert(std::make_pair(context_key,
+                                        initialized_encryptor.release()))
+            .first;
+    insertion_order_.push_back(context);
+  }
+  if (!new_encryptor->InitializeWithCryptor(*context->second,
+                                            encryption_key.iv)) {
+    return Status(error::MUXER_FAILURE, "Failed to create the encryptor.");
+  }
+  *encryptor = new_encryptor.Pass();
+  return Status::OK;
+}
+
+size_t CryptoContextCache::num_contexts() const {
+  base::AutoLock auto_lock(lock_);
+  return contexts_.size();
+}
+
+}  // namespace media
+}  // namespace edash_packager
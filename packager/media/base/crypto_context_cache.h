@@ -0,0 +1,94 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef PACKAGER_MEDIA_BASE_CRYPTO_CONTEXT_CACHE_H_
+#define PACKAGER_MEDIA_BASE_CRYPTO_CONTEXT_CACHE_H_
+
+#include <stdint.h>
+
+#include <deque>
+#include <map>
+#include <vector>
+
+#include "packager/base/macros.h"
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/synchronization/lock.h"
+#include "packager/media/base/fourccs.h"
+#include "packager/media/base/status.h"
+
+namespace edash_packager {
+namespace media {
+
+class AesCryptor;
+struct EncryptionKey;
+
+/// Creates the encryptors of a packaging job. The encryptors of the same key
+/// and protection scheme share the key schedule, which is expanded once, in
+/// the first encryptor created for the key, and copied into the following
+/// ones. A cache is typically shared by all the muxers of a job, so that the
+/// renditions encrypted with the same key, and the encryption threads of each
+/// rendition, do not expand the key again.
+/// Thread Safety: CryptoContextCache is thread safe.
+class CryptoContextCache {
+ public:
+  /// Create a cache with the default limit.
+  CryptoContextCache();
+  /// @param max_contexts is the maximum number of key schedules cached. The
+  ///        oldest one is dropped beyond this, e.g. on key rotation.
+  explicit CryptoContextCache(size_t max_contexts);
+  ~CryptoContextCache();
+
+  /// Create an encryptor for @a encryption_key and the protection scheme,
+  /// initialized with the iv of @a encryption_key.
+  /// @param protection_scheme specifies the protection scheme: 'cenc', 'cens',
+  ///        'cbc1', 'cbcs'.
+  /// @param crypt_byte_block indicates number of encrypted blocks (16-byte) in
+  ///        pattern based encryption.
+  /// @param skip_byte_block indicates number of unencrypted blocks (16-byte)
+  ///        in pattern based encryption.
+  /// @param[out] encryptor receives the new encryptor on success.
+  /// @return OK on success, an error status otherwise.
+  Status CreateEncryptor(const EncryptionKey& encryption_key,
+                         FourCC protection_scheme,
+                         uint8_t crypt_byte_block,
+                         uint8_t skip_byte_block,
+                         scoped_ptr<AesCryptor>* encryptor);
+
+  /// @return The number of key schedules currently cached.
+  size_t num_contexts() const;
+
+ private:
+  struct ContextKey {
+    ContextKey();
+    ~ContextKey();
+
+    bool operator<(const ContextKey& other) const;
+
+    // The key is part of the cache key so that key sources reusing a key id
+    // for different keys do not alias.
+    std::vector<uint8_t> key_id;
+    std::vector<uint8_t> key;
+    FourCC protection_scheme;
+    uint8_t crypt_byte_block;
+    uint8_t skip_byte_block;
+  };
+  typedef std::map<ContextKey, AesCryptor*> ContextMap;
+
+  const size_t max_contexts_;
+
+  mutable base::Lock lock_;
+  // Initialized encryptors, owned, which the new encryptors are copied from.
+  ContextMap contexts_;
+  // Cached contexts, oldest first.
+  std::deque<ContextMap::iterator> insertion_order_;
+
+  DISALLOW_COPY_AND_ASSIGN(CryptoContextCache);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // PACKAGER_MEDIA_BASE_CRYPTO_CONTEXT_CACHE_H_
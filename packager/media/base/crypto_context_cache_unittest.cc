@@ -0,0 +1,137 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/crypto_context_cache.h"
+
+#include <gtest/gtest.h>
+
+#include "packager/media/base/aes_cryptor.h"
+#include "packager/media/base/key_source.h"
+#include "packager/media/base/test/status_test_util.h"
+
+namespace edash_packager {
+namespace media {
+namespace {
+
+const uint8_t kKeyId[] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+                          0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10};
+const uint8_t kKey[] = {0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+                        0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c};
+const uint8_t kIv[] = {0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7,
+                       0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff};
+const uint8_t kCryptByteBlock = 1;
+const uint8_t kSkipByteBlock = 9;
+
+EncryptionKey GetEncryptionKey() {
+  EncryptionKey encryption_key;
+  encryption_key.key_id.assign(kKeyId, kKeyId + arraysize(kKeyId));
+  encryption_key.key.assign(kKey, kKey + arraysize(kKey));
+  encryption_key.iv.assign(kIv, kIv + arraysize(kIv));
+  return encryption_key;
+}
+
+std::vector<uint8_t> GetText() {
+  // Not a multiple of the block size, with several pattern runs.
+  std::vector<uint8_t> text(1000);
+  for (size_t i = 0; i < text.size(); ++i)
+    text[i] = static_cast<uint8_t>(i * 7);
+  return text;
+}
+
+}  // namespace
+
+class CryptoContextCacheTest : public ::testing::TestWithParam<FourCC> {};
+
+TEST_P(CryptoContextCacheTest, SameOutputAsNewKeySchedule) {
+  const EncryptionKey encryption_key = GetEncryptionKey();
+  const std::vector<uint8_t> text = GetText();
+
+  // The first encryptor expands the key, the following ones are copied.
+  CryptoContextCache cache;
+  std::vector<uint8_t> first_ciphertext;
+  for (int i = 0; i < 3; ++i) {
+    scoped_ptr<AesCryptor> encryptor;
+    ASSERT_OK(cache.CreateEncryptor(encryption_key, GetParam(),
+                                    kCryptByteBlock, kSkipByteBlock,
+                                    &encryptor));
+    EXPECT_EQ(encryption_key.iv, encryptor->iv());
+    std::vector<uint8_t> ciphertext;
+    ASSERT_TRUE(encryptor->Crypt(text, &ciphertext));
+    EXPECT_NE(text, ciphertext);
+    if (i == 0)
+      first_ciphertext = ciphertext;
+    else
+      EXPECT_EQ(first_ciphertext, ciphertext);
+  }
+  EXPECT_EQ(1u, cache.num_contexts());
+}
+
+INSTANTIATE_TEST_CASE_P(ProtectionSchemes,
+                        CryptoContextCacheTest,
+                        ::testing::Values(FOURCC_cenc,
+                                          FOURCC_cbc1,
+                                          FOURCC_cens,
+                                          FOURCC_cbcs));
+
+TEST(CryptoContextCacheLimitTest, OneContextPerKeyAndScheme) {
+  EncryptionKey encryption_key = GetEncryptionKey();
+  CryptoContextCache cache;
+  scoped_ptr<AesCryptor> encryptor;
+  ASSERT_OK(cache.CreateEncryptor(encryption_key, FOURCC_cenc, 0, 0,
+                                  &encryptor));
+  ASSERT_OK(cache.CreateEncryptor(encryption_key, FOURCC_cbc1, 0, 0,
+                                  &encryptor));
+  EXPECT_EQ(2u, cache.num_contexts());
+
+  // A different key, even with the same key id, gets its own context.
+  encryption_key.key[0] ^= 0xff;
+  ASSERT_OK(cache.CreateEncryptor(encryption_key, FOURCC_cenc, 0, 0,
+                                  &encryptor));
+  EXPECT_EQ(3u, cache.num_contexts());
+}
+
+TEST(CryptoContextCacheLimitTest, DropsOldestContext) {
+  EncryptionKey encryption_key = GetEncryptionKey();
+  const std::vector<uint8_t> text = GetText();
+  CryptoContextCache cache(2);
+
+  scoped_ptr<AesCryptor> encryptor;
+  ASSERT_OK(cache.CreateEncryptor(encryption_key, FOURCC_cenc, 0, 0,
+                                  &encryptor));
+  std::vector<uint8_t> expected_ciphertext;
+  ASSERT_TRUE(encryptor->Crypt(text, &expected_ciphertext));
+
+  for (int i = 1; i <= 3; ++i) {
+    EncryptionKey other_key = encryption_key;
+    other_key.key_id[0] = static_cast<uint8_t>(i);
+    ASSERT_OK(cache.CreateEncryptor(other_key, FOURCC_cenc, 0, 0,
+                                    &encryptor));
+  }
+  EXPECT_EQ(2u, cache.num_contexts());
+
+  // The dropped context is created again.
+  ASSERT_OK(cache.CreateEncryptor(encryption_key, FOURCC_cenc, 0, 0,
+                                  &encryptor));
+  std::vector<uint8_t> ciphertext;
+  ASSERT_TRUE(encryptor->Crypt(text, &ciphertext));
+  EXPECT_EQ(expected_ciphertext, ciphertext);
+}
+
+TEST(CryptoContextCacheLimitTest, InvalidKeyOrScheme) {
+  EncryptionKey encryption_key = GetEncryptionKey();
+  CryptoContextCache cache;
+  scoped_ptr<AesCryptor> encryptor;
+  EXPECT_FALSE(cache.CreateEncryptor(encryption_key, FOURCC_NULL, 0, 0,
+                                     &encryptor).ok());
+  encryption_key.key.resize(5);
+  EXPECT_FALSE(cache.CreateEncryptor(encryption_key, FOURCC_cenc, 0, 0,
+                                     &encryptor).ok());
+  EXPECT_FALSE(encryptor.get());
+  EXPECT_EQ(0u, cache.num_contexts());
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,96 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/curl_share.h"
+
+#include "packager/base/logging.h"
+#include "packager/base/macros.h"
+#include "packager/base/synchronization/lock.h"
+
+namespace edash_packager {
+
+namespace {
+
+class LibCurlInitializer {
+ public:
+  LibCurlInitializer() : initialized_(false) {
+    base::AutoLock lock(lock_);
+    if (!initialized_) {
+      curl_global_init(CURL_GLOBAL_DEFAULT);
+      initialized_ = true;
+    }
+  }
+
+  ~LibCurlInitializer() {
+    base::AutoLock lock(lock_);
+    if (initialized_) {
+      curl_global_cleanup();
+      initialized_ = false;
+    }
+  }
+
+ private:
+  base::Lock lock_;
+  bool initialized_;
+
+  DISALLOW_COPY_AND_ASSIGN(LibCurlInitializer);
+};
+
+// Shares the DNS cache, the TLS sessions and the connections of the curl
+// handles of the process.
+class CurlShare {
+ public:
+  CurlShare() : share_(curl_share_init()) {
+    if (!share_) {
+      LOG(WARNING) << "curl_share_init() failed. Connections are not shared.";
+      return;
+    }
+    curl_share_setopt(share_, CURLSHOPT_LOCKFUNC, LockData);
+    curl_share_setopt(share_, CURLSHOPT_UNLOCKFUNC, UnlockData);
+    curl_share_setopt(share_, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900
+    curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+  }
+
+  ~CurlShare() {
+    if (share_)
+      curl_share_cleanup(share_);
+  }
+
+  CURLSH* get() { return share_; }
+
+ private:
+  static void LockData(CURL* handle,
+                       curl_lock_data data,
+                       curl_lock_access access,
+                       void* user_data) {
+    DCHECK_LT(data, CURL_LOCK_DATA_LAST);
+    static_cast<CurlShare*>(user_data)->locks_[data].Acquire();
+  }
+
+  static void UnlockData(CURL* handle, curl_lock_data data, void* user_data) {
+    DCHECK_LT(data, CURL_LOCK_DATA_LAST);
+    static_cast<CurlShare*>(user_data)->locks_[data].Release();
+  }
+
+  CURLSH* share_;
+  base::Lock locks_[CURL_LOCK_DATA_LAST];
+
+  DISALLOW_COPY_AND_ASSIGN(CurlShare);
+};
+
+}  // namespace
+
+CURLSH* GetCurlShare() {
+  static LibCurlInitializer lib_curl_initializer;
+  static CurlShare curl_share;
+  return curl_share.get();
+}
+
+}  // namespace edash_packager
@@ -0,0 +1,23 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_BASE_CURL_SHARE_H_
+#define MEDIA_BASE_CURL_SHARE_H_
+
+#include <curl/curl.h>
+
+namespace edash_packager {
+
+/// Returns the curl share of the process, initializing libcurl first if
+/// needed. The share holds the DNS cache, the TLS sessions and, with libcurl
+/// 7.57 or later, the connections of the curl handles which use it.
+/// @return the share, or NULL if it could not be created. libcurl is
+///         initialized in both cases.
+CURLSH* GetCurlShare();
+
+}  // namespace edash_packager
+
+#endif  // MEDIA_BASE_CURL_SHARE_H_
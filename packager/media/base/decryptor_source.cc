@@ -6,20 +6,37 @@
 
 #include "packager/media/base/decryptor_source.h"
 
+#include <algorithm>
+
+#include "packager/base/bind.h"
 #include "packager/base/logging.h"
 #include "packager/base/stl_util.h"
 #include "packager/media/base/aes_decryptor.h"
 #include "packager/media/base/aes_pattern_cryptor.h"
+#include "packager/media/base/media_sample.h"
+#include "packager/media/base/thread_pool.h"
 
 namespace edash_packager {
 namespace media {
 
 DecryptorSource::DecryptorSource(KeySource* key_source)
-    : key_source_(key_source) {
+    : key_source_(key_source), decryptor_maps_(1) {
   CHECK(key_source);
 }
 DecryptorSource::~DecryptorSource() {
-  STLDeleteValues(&decryptor_map_);
+  // Join the decryption threads before deleting the decryptors.
+  thread_pool_.reset();
+  for (DecryptorMap& decryptors : decryptor_maps_)
+    STLDeleteValues(&decryptors);
+}
+
+void DecryptorSource::EnableParallelDecryption(size_t num_threads) {
+  DCHECK(!thread_pool_);
+  if (num_threads <= 1)
+    return;
+  thread_pool_.reset(new ThreadPool("DecryptionWorker", num_threads));
+  thread_pool_->Start();
+  decryptor_maps_.resize(num_threads);
 }
 
 bool DecryptorSource::DecryptSampleBuffer(const DecryptConfig* decrypt_config,
@@ -28,63 +45,128 @@ bool DecryptorSource::DecryptSampleBuffer(const DecryptConfig* decrypt_config,
   DCHECK(decrypt_config);
   DCHECK(buffer);
 
-  // Get the decryptor object.
-  AesCryptor* decryptor;
-  auto found = decryptor_map_.find(decrypt_config->key_id());
-  if (found == decryptor_map_.end()) {
-    // Create new AesDecryptor based on decryption mode.
-    EncryptionKey key;
-    Status status(key_source_->GetKey(decrypt_config->key_id(), &key));
-    if (!status.ok()) {
-      LOG(ERROR) << "Error retrieving decryption key: " << status;
+  if (!FetchKey(decrypt_config->key_id()))
+    return false;
+  const EncryptedBuffer encrypted_buffer = {decrypt_config, buffer,
+                                            buffer_size};
+  return DecryptBuffer(encrypted_buffer, &decryptor_maps_[0]);
+}
+
+bool DecryptorSource::DecryptSampleBuffers(
+    const std::vector<EncryptedBuffer>& buffers) {
+  for (const EncryptedBuffer& buffer : buffers) {
+    DCHECK(buffer.decrypt_config);
+    DCHECK(buffer.buffer);
+    if (!FetchKey(buffer.decrypt_config->key_id()))
       return false;
-    }
+  }
 
-    scoped_ptr<AesCryptor> aes_decryptor;
-    switch (decrypt_config->protection_scheme()) {
-      case FOURCC_cenc:
-        aes_decryptor.reset(new AesCtrDecryptor);
-        break;
-      case FOURCC_cbc1:
-        aes_decryptor.reset(new AesCbcDecryptor(kNoPadding));
-        break;
-      case FOURCC_cens:
-        aes_decryptor.reset(new AesPatternCryptor(
-            decrypt_config->crypt_byte_block(),
-            decrypt_config->skip_byte_block(),
-            AesPatternCryptor::kEncryptIfCryptByteBlockRemaining,
-            AesCryptor::kDontUseConstantIv,
-            scoped_ptr<AesCryptor>(new AesCtrDecryptor())));
-        break;
-      case FOURCC_cbcs:
-        aes_decryptor.reset(new AesPatternCryptor(
-            decrypt_config->crypt_byte_block(),
-            decrypt_config->skip_byte_block(),
-            AesPatternCryptor::kEncryptIfCryptByteBlockRemaining,
-            AesCryptor::kUseConstantIv,
-            scoped_ptr<AesCryptor>(new AesCbcDecryptor(kNoPadding))));
-        break;
-      default:
-        LOG(ERROR) << "Unsupported protection scheme: "
-                   << decrypt_config->protection_scheme();
+  if (!thread_pool_ || buffers.size() <= 1) {
+    for (const EncryptedBuffer& buffer : buffers) {
+      if (!DecryptBuffer(buffer, &decryptor_maps_[0]))
         return false;
     }
+    return true;
+  }
 
-    if (!aes_decryptor->InitializeWithIv(key.key, decrypt_config->iv())) {
-      LOG(ERROR) << "Failed to initialize AesDecryptor for decryption.";
-      return false;
-    }
-    decryptor = aes_decryptor.release();
-    decryptor_map_[decrypt_config->key_id()] = decryptor;
-  } else {
-    decryptor = found->second;
+  // Split the buffers in contiguous ranges, one per thread. Every buffer
+  // starts from its own IV, so the ranges are independent.
+  const size_t num_buffers = buffers.size();
+  const size_t num_tasks = std::min(num_buffers, thread_pool_->num_threads());
+  scoped_ptr<bool[]> success(new bool[num_tasks]);
+  std::vector<base::Closure> tasks;
+  for (size_t i = 0; i < num_tasks; ++i) {
+    tasks.push_back(base::Bind(&DecryptorSource::DecryptBufferRange,
+                               base::Unretained(this), &buffers,
+                               num_buffers * i / num_tasks,
+                               num_buffers * (i + 1) / num_tasks,
+                               &decryptor_maps_[i], &success[i]));
+  }
+  thread_pool_->RunTasksAndWait(tasks);
+  return std::find(success.get(), success.get() + num_tasks, false) ==
+         success.get() + num_tasks;
+}
+
+bool DecryptorSource::DeferSampleDecryption(
+    scoped_ptr<DecryptConfig> decrypt_config,
+    MediaSample* sample) {
+  DCHECK(decrypt_config);
+  DCHECK(sample);
+  if (!FetchKey(decrypt_config->key_id()))
+    return false;
+  const std::vector<uint8_t>& key = keys_[decrypt_config->key_id()].key;
+  sample->set_pending_decryption(decrypt_config.Pass(), key);
+  return true;
+}
+
+// static
+bool DecryptorSource::DecryptPendingSample(MediaSample* sample) {
+  DCHECK(sample);
+  const DecryptConfig* decrypt_config = sample->pending_decrypt_config();
+  DCHECK(decrypt_config);
+  scoped_ptr<AesCryptor> decryptor =
+      CreateDecryptor(*decrypt_config, sample->pending_decryption_key());
+  if (!decryptor ||
+      !DecryptWithDecryptor(*decrypt_config, decryptor.get(),
+                            sample->writable_data(), sample->data_size())) {
+    return false;
   }
-  if (!decryptor->SetIv(decrypt_config->iv())) {
+  sample->clear_pending_decryption();
+  return true;
+}
+
+// static
+scoped_ptr<AesCryptor> DecryptorSource::CreateDecryptor(
+    const DecryptConfig& decrypt_config,
+    const std::vector<uint8_t>& key) {
+  // Create new AesDecryptor based on decryption mode.
+  scoped_ptr<AesCryptor> aes_decryptor;
+  switch (decrypt_config.protection_scheme()) {
+    case FOURCC_cenc:
+      aes_decryptor.reset(new AesCtrDecryptor);
+      break;
+    case FOURCC_cbc1:
+      aes_decryptor.reset(new AesCbcDecryptor(kNoPadding));
+      break;
+    case FOURCC_cens:
+      aes_decryptor.reset(new AesPatternCryptor(
+          decrypt_config.crypt_byte_block(), decrypt_config.skip_byte_block(),
+          AesPatternCryptor::kEncryptIfCryptByteBlockRemaining,
+          AesCryptor::kDontUseConstantIv,
+          scoped_ptr<AesCryptor>(new AesCtrDecryptor())));
+      break;
+    case FOURCC_cbcs:
+      aes_decryptor.reset(new AesPatternCryptor(
+          decrypt_config.crypt_byte_block(), decrypt_config.skip_byte_block(),
+          AesPatternCryptor::kEncryptIfCryptByteBlockRemaining,
+          AesCryptor::kUseConstantIv,
+          scoped_ptr<AesCryptor>(new AesCbcDecryptor(kNoPadding))));
+      break;
+    default:
+      LOG(ERROR) << "Unsupported protection scheme: "
+                 << decrypt_config.protection_scheme();
+      return scoped_ptr<AesCryptor>();
+  }
+
+  if (!aes_decryptor->InitializeWithIv(key, decrypt_config.iv())) {
+    LOG(ERROR) << "Failed to initialize AesDecryptor for decryption.";
+    return scoped_ptr<AesCryptor>();
+  }
+  return aes_decryptor.Pass();
+}
+
+// static
+bool DecryptorSource::DecryptWithDecryptor(const DecryptConfig& decrypt_config,
+                                           AesCryptor* decryptor,
+                                           uint8_t* buffer,
+                                           size_t buffer_size) {
+  DCHECK(decryptor);
+  if (!decryptor->SetIv(decrypt_config.iv())) {
     LOG(ERROR) << "Invalid initialization vector.";
     return false;
   }
 
-  if (decrypt_config->subsamples().empty()) {
+  if (decrypt_config.subsamples().empty()) {
     // Sample not encrypted using subsample encryption. Decrypt whole.
     if (!decryptor->Crypt(buffer, buffer_size, buffer)) {
       LOG(ERROR) << "Error during bulk sample decryption.";
@@ -94,7 +176,7 @@ bool DecryptorSource::DecryptSampleBuffer(const DecryptConfig* decrypt_config,
   }
 
   // Subsample decryption.
-  const std::vector<SubsampleEntry>& subsamples = decrypt_config->subsamples();
+  const std::vector<SubsampleEntry>& subsamples = decrypt_config.subsamples();
   uint8_t* current_ptr = buffer;
   const uint8_t* const buffer_end = buffer + buffer_size;
   for (const auto& subsample : subsamples) {
@@ -113,5 +195,53 @@ bool DecryptorSource::DecryptSampleBuffer(const DecryptConfig* decrypt_config,
   return true;
 }
 
+bool DecryptorSource::FetchKey(const std::vector<uint8_t>& key_id) {
+  if (keys_.find(key_id) != keys_.end())
+    return true;
+  EncryptionKey key;
+  Status status(key_source_->GetKey(key_id, &key));
+  if (!status.ok()) {
+    LOG(ERROR) << "Error retrieving decryption key: " << status;
+    return false;
+  }
+  keys_[key_id] = key;
+  return true;
+}
+
+bool DecryptorSource::DecryptBuffer(const EncryptedBuffer& encrypted_buffer,
+                                    DecryptorMap* decryptors) {
+  const DecryptConfig* decrypt_config = encrypted_buffer.decrypt_config;
+
+  // Get the decryptor object.
+  AesCryptor* decryptor;
+  auto found = decryptors->find(decrypt_config->key_id());
+  if (found == decryptors->end()) {
+    auto key = keys_.find(decrypt_config->key_id());
+    DCHECK(key != keys_.end());
+    scoped_ptr<AesCryptor> aes_decryptor =
+        CreateDecryptor(*decrypt_config, key->second.key);
+    if (!aes_decryptor)
+      return false;
+    decryptor = aes_decryptor.release();
+    (*decryptors)[decrypt_config->key_id()] = decryptor;
+  } else {
+    decryptor = found->second;
+  }
+  return DecryptWithDecryptor(*decrypt_config, decryptor,
+                              encrypted_buffer.buffer,
+                              encrypted_buffer.buffer_size);
+}
+
+void DecryptorSource::DecryptBufferRange(
+    const std::vector<EncryptedBuffer>* buffers,
+    size_t begin,
+    size_t end,
+    DecryptorMap* decryptors,
+    bool* success) {
+  *success = true;
+  for (size_t i = begin; i < end && *success; ++i)
+    *success = DecryptBuffer((*buffers)[i], decryptors);
+}
+
 }  // namespace media
 }  // namespace edash_packager
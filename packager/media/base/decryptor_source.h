@@ -10,6 +10,7 @@
 #include <map>
 #include <vector>
 
+#include "packager/base/memory/scoped_ptr.h"
 #include "packager/media/base/aes_decryptor.h"
 #include "packager/media/base/decrypt_config.h"
 #include "packager/media/base/key_source.h"
@@ -17,19 +18,93 @@
 namespace edash_packager {
 namespace media {
 
+class MediaSample;
+class ThreadPool;
+
 /// DecryptorSource wraps KeySource and is responsible for decryptor management.
+/// The keys are retrieved once and the decryptors are cached per key id.
 class DecryptorSource {
  public:
+  /// A sample buffer to decrypt in place.
+  struct EncryptedBuffer {
+    const DecryptConfig* decrypt_config;
+    uint8_t* buffer;
+    size_t buffer_size;
+  };
+
   explicit DecryptorSource(KeySource* key_source);
   ~DecryptorSource();
 
+  /// Decrypt the buffers passed to DecryptSampleBuffers() on a pool of
+  /// threads. Should be called before any decryption.
+  /// @param num_threads is the number of decryption threads. 0 or 1 keeps
+  ///        decrypting on the calling thread.
+  void EnableParallelDecryption(size_t num_threads);
+
+  /// @return true if EnableParallelDecryption() started decryption threads.
+  bool parallel_decryption_enabled() const {
+    return thread_pool_.get() != NULL;
+  }
+
   bool DecryptSampleBuffer(const DecryptConfig* decrypt_config,
                            uint8_t* buffer,
                            size_t buffer_size);
 
+  /// Decrypt several sample buffers, e.g. the samples of a fragment. The
+  /// buffers are split in contiguous ranges decrypted in parallel if
+  /// parallel decryption is enabled, each thread with its own decryptors.
+  /// @param buffers contains the buffers to decrypt.
+  /// @return true if all the buffers are decrypted, false otherwise.
+  bool DecryptSampleBuffers(const std::vector<EncryptedBuffer>& buffers);
+
+  /// Leave the data of @a sample encrypted, so that it can be re-encrypted
+  /// in a single pass, see MediaSample::set_pending_decryption().
+  /// @param decrypt_config contains the decryption parameters of the data.
+  /// @param sample is the sample with the encrypted data.
+  /// @return true if the decryption key is available, false otherwise.
+  bool DeferSampleDecryption(scoped_ptr<DecryptConfig> decrypt_config,
+                             MediaSample* sample);
+
+  /// Decrypt the data of a sample whose decryption was deferred by
+  /// DeferSampleDecryption(), and clear the pending decryption.
+  /// @return true on success, false otherwise.
+  static bool DecryptPendingSample(MediaSample* sample);
+
  private:
+  typedef std::map<std::vector<uint8_t>, AesCryptor*> DecryptorMap;
+
+  // Retrieve the key of |key_id| into |keys_| if it is not there yet. Only
+  // called on the calling thread, so |key_source_| is never used
+  // concurrently.
+  bool FetchKey(const std::vector<uint8_t>& key_id);
+  // Create a decryptor for the protection scheme of |decrypt_config|,
+  // initialized with |key| and its IV. Returns NULL on failure.
+  static scoped_ptr<AesCryptor> CreateDecryptor(
+      const DecryptConfig& decrypt_config,
+      const std::vector<uint8_t>& key);
+  // Decrypt |buffer| in place with |decryptor|, from the IV and following the
+  // subsamples of |decrypt_config|.
+  static bool DecryptWithDecryptor(const DecryptConfig& decrypt_config,
+                                   AesCryptor* decryptor,
+                                   uint8_t* buffer,
+                                   size_t buffer_size);
+  // Decrypt |buffer| with the decryptor of its key in |decryptors|, which is
+  // created if needed. The key must have been fetched.
+  bool DecryptBuffer(const EncryptedBuffer& buffer, DecryptorMap* decryptors);
+  // Decrypt |buffers| in [|begin|, |end|) with |decryptors|. Run on the
+  // decryption threads.
+  void DecryptBufferRange(const std::vector<EncryptedBuffer>* buffers,
+                          size_t begin,
+                          size_t end,
+                          DecryptorMap* decryptors,
+                          bool* success);
+
   KeySource* key_source_;
-  std::map<std::vector<uint8_t>, AesCryptor*> decryptor_map_;
+  std::map<std::vector<uint8_t>, EncryptionKey> keys_;
+  // Decryptors of each decryption thread. Only the first one is used when
+  // decrypting on the calling thread.
+  std::vector<DecryptorMap> decryptor_maps_;
+  scoped_ptr<ThreadPool> thread_pool_;
 
   DISALLOW_COPY_AND_ASSIGN(DecryptorSource);
 };
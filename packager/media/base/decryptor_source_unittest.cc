@@ -11,6 +11,7 @@
 
 #include "packager/base/macros.h"
 #include "packager/media/base/fixed_key_source.h"
+#include "packager/media/base/media_sample.h"
 
 using ::testing::Return;
 using ::testing::SetArgPointee;
@@ -138,6 +139,35 @@ TEST_F(DecryptorSourceTest, SubsampleDecryption) {
             buffer_);
 }
 
+TEST_F(DecryptorSourceTest, DeferredSampleDecryption) {
+  EncryptionKey encryption_key;
+  encryption_key.key.assign(kMockKey, kMockKey + arraysize(kMockKey));
+  EXPECT_CALL(mock_key_source_, GetKey(key_id_, _))
+      .WillOnce(DoAll(SetArgPointee<1>(encryption_key), Return(Status::OK)));
+
+  scoped_refptr<MediaSample> sample =
+      MediaSample::CopyFrom(&buffer_[0], buffer_.size(), true);
+  scoped_ptr<DecryptConfig> decrypt_config(new DecryptConfig(
+      key_id_, std::vector<uint8_t>(kIv, kIv + arraysize(kIv)),
+      std::vector<SubsampleEntry>()));
+  ASSERT_TRUE(decryptor_source_.DeferSampleDecryption(decrypt_config.Pass(),
+                                                      sample.get()));
+  ASSERT_TRUE(sample->pending_decrypt_config());
+  EXPECT_EQ(encryption_key.key, sample->pending_decryption_key());
+  // The data is left encrypted.
+  EXPECT_EQ(buffer_,
+            std::vector<uint8_t>(sample->data(),
+                                 sample->data() + sample->data_size()));
+
+  ASSERT_TRUE(DecryptorSource::DecryptPendingSample(sample.get()));
+  EXPECT_FALSE(sample->pending_decrypt_config());
+  EXPECT_EQ(std::vector<uint8_t>(
+                kExpectedDecryptedBuffer,
+                kExpectedDecryptedBuffer + arraysize(kExpectedDecryptedBuffer)),
+            std::vector<uint8_t>(sample->data(),
+                                 sample->data() + sample->data_size()));
+}
+
 TEST_F(DecryptorSourceTest, SubsampleDecryptionSizeValidation) {
   EncryptionKey encryption_key;
   encryption_key.key.assign(kMockKey, kMockKey + arraysize(kMockKey));
@@ -158,6 +188,73 @@ TEST_F(DecryptorSourceTest, SubsampleDecryptionSizeValidation) {
       &decrypt_config, &buffer_[0], buffer_.size()));
 }
 
+TEST_F(DecryptorSourceTest, DecryptSampleBuffers) {
+  EncryptionKey encryption_key;
+  encryption_key.key.assign(kMockKey, kMockKey + arraysize(kMockKey));
+  EXPECT_CALL(mock_key_source_, GetKey(key_id_, _))
+      .WillOnce(DoAll(SetArgPointee<1>(encryption_key), Return(Status::OK)));
+
+  const size_t kNumThreads = 3;
+  decryptor_source_.EnableParallelDecryption(kNumThreads);
+  EXPECT_TRUE(decryptor_source_.parallel_decryption_enabled());
+
+  // More buffers than threads, alternating between the two IVs.
+  const size_t kNumBuffers = 8;
+  DecryptConfig decrypt_config(key_id_,
+                               std::vector<uint8_t>(kIv, kIv + arraysize(kIv)),
+                               std::vector<SubsampleEntry>());
+  DecryptConfig decrypt_config2(
+      key_id_, std::vector<uint8_t>(kIv2, kIv2 + arraysize(kIv2)),
+      std::vector<SubsampleEntry>());
+  std::vector<std::vector<uint8_t> > buffers(kNumBuffers);
+  std::vector<DecryptorSource::EncryptedBuffer> encrypted_buffers;
+  for (size_t i = 0; i < kNumBuffers; ++i) {
+    if (i % 2 == 0)
+      buffers[i].assign(kBuffer, kBuffer + arraysize(kBuffer));
+    else
+      buffers[i].assign(kBuffer2, kBuffer2 + arraysize(kBuffer2));
+    const DecryptorSource::EncryptedBuffer encrypted_buffer = {
+        i % 2 == 0 ? &decrypt_config : &decrypt_config2, &buffers[i][0],
+        buffers[i].size()};
+    encrypted_buffers.push_back(encrypted_buffer);
+  }
+  ASSERT_TRUE(decryptor_source_.DecryptSampleBuffers(encrypted_buffers));
+  for (size_t i = 0; i < kNumBuffers; i += 2) {
+    EXPECT_EQ(std::vector<uint8_t>(kExpectedDecryptedBuffer,
+                                   kExpectedDecryptedBuffer +
+                                       arraysize(kExpectedDecryptedBuffer)),
+              buffers[i]);
+    EXPECT_EQ(std::vector<uint8_t>(kExpectedDecryptedBuffer2,
+                                   kExpectedDecryptedBuffer2 +
+                                       arraysize(kExpectedDecryptedBuffer2)),
+              buffers[i + 1]);
+  }
+}
+
+TEST_F(DecryptorSourceTest, DecryptSampleBuffersSizeValidation) {
+  EncryptionKey encryption_key;
+  encryption_key.key.assign(kMockKey, kMockKey + arraysize(kMockKey));
+  EXPECT_CALL(mock_key_source_, GetKey(key_id_, _))
+      .WillOnce(DoAll(SetArgPointee<1>(encryption_key), Return(Status::OK)));
+
+  decryptor_source_.EnableParallelDecryption(2);
+
+  const SubsampleEntry kSubsamples[] = {{2, 3}, {3, 14}};
+  DecryptConfig decrypt_config(
+      key_id_, std::vector<uint8_t>(kIv, kIv + arraysize(kIv)),
+      std::vector<SubsampleEntry>(kSubsamples,
+                                  kSubsamples + arraysize(kSubsamples)));
+  std::vector<uint8_t> buffer2(buffer_);
+  const DecryptorSource::EncryptedBuffer kEncryptedBuffers[] = {
+      {&decrypt_config, &buffer_[0], buffer_.size()},
+      {&decrypt_config, &buffer2[0], buffer2.size()},
+  };
+  EXPECT_FALSE(decryptor_source_.DecryptSampleBuffers(
+      std::vector<DecryptorSource::EncryptedBuffer>(
+          kEncryptedBuffers,
+          kEncryptedBuffers + arraysize(kEncryptedBuffers))));
+}
+
 TEST_F(DecryptorSourceTest, DecryptFailedIfGetKeyFailed) {
   EXPECT_CALL(mock_key_source_, GetKey(key_id_, _))
       .WillOnce(Return(Status::UNKNOWN));
@@ -0,0 +1,81 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/delayed_task_queue.h"
+
+#include <vector>
+
+#include "packager/base/bind.h"
+#include "packager/base/logging.h"
+#include "packager/media/base/closure_thread.h"
+#include "packager/media/base/thread_pool.h"
+
+namespace edash_packager {
+namespace media {
+
+DelayedTaskQueue::DelayedTaskQueue(ThreadPool* thread_pool)
+    : thread_pool_(thread_pool), condition_(&lock_), stopped_(false) {
+  DCHECK(thread_pool_);
+  timer_thread_.reset(new ClosureThread(
+      "DelayedTasks",
+      base::Bind(&DelayedTaskQueue::RunTimer, base::Unretained(this))));
+  timer_thread_->Start();
+}
+
+DelayedTaskQueue::~DelayedTaskQueue() {
+  {
+    base::AutoLock l(lock_);
+    stopped_ = true;
+    condition_.Signal();
+  }
+  timer_thread_->Join();
+  for (const std::pair<const base::TimeTicks, base::Closure>& task : tasks_)
+    thread_pool_->PostTask(task.second);
+}
+
+void DelayedTaskQueue::PostDelayedTask(const base::Closure& task,
+                                       base::TimeDelta delay) {
+  if (delay <= base::TimeDelta()) {
+    thread_pool_->PostTask(task);
+    return;
+  }
+  const base::TimeTicks due_time = base::TimeTicks::Now() + delay;
+  base::AutoLock l(lock_);
+  // Only wake the timer up if the task is due before the others.
+  const bool first = tasks_.empty() || due_time < tasks_.begin()->first;
+  tasks_.insert(std::make_pair(due_time, task));
+  if (first)
+    condition_.Signal();
+}
+
+void DelayedTaskQueue::RunTimer() {
+  std::vector<base::Closure> due_tasks;
+  base::AutoLock l(lock_);
+  while (!stopped_) {
+    if (tasks_.empty()) {
+      condition_.Wait();
+      continue;
+    }
+    const base::TimeTicks now = base::TimeTicks::Now();
+    if (tasks_.begin()->first > now) {
+      condition_.TimedWait(tasks_.begin()->first - now);
+      continue;
+    }
+    while (!tasks_.empty() && tasks_.begin()->first <= now) {
+      due_tasks.push_back(tasks_.begin()->second);
+      tasks_.erase(tasks_.begin());
+    }
+    {
+      base::AutoUnlock unlock(lock_);
+      for (const base::Closure& task : due_tasks)
+        thread_pool_->PostTask(task);
+      due_tasks.clear();
+    }
+  }
+}
+
+}  // namespace media
+}  // namespace edash_packager
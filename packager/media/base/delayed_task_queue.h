@@ -0,0 +1,60 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef PACKAGER_MEDIA_BASE_DELAYED_TASK_QUEUE_H_
+#define PACKAGER_MEDIA_BASE_DELAYED_TASK_QUEUE_H_
+
+#include <map>
+
+#include "packager/base/callback.h"
+#include "packager/base/macros.h"
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/synchronization/condition_variable.h"
+#include "packager/base/synchronization/lock.h"
+#include "packager/base/time/time.h"
+
+namespace edash_packager {
+namespace media {
+
+class ClosureThread;
+class ThreadPool;
+
+/// Posts tasks to a ThreadPool after a delay, with a single timer thread for
+/// all the tasks, e.g. to resume many jobs waiting for their input without
+/// blocking a worker thread per job.
+class DelayedTaskQueue {
+ public:
+  /// @param thread_pool is the pool the tasks are posted to. It must outlive
+  ///        the queue.
+  explicit DelayedTaskQueue(ThreadPool* thread_pool);
+
+  /// Posts the tasks still waiting right away, then joins the timer thread.
+  ~DelayedTaskQueue();
+
+  /// Post @a task to the pool once @a delay has elapsed, or right away if
+  /// @a delay is not positive.
+  void PostDelayedTask(const base::Closure& task, base::TimeDelta delay);
+
+ private:
+  void RunTimer();
+
+  ThreadPool* const thread_pool_;
+
+  base::Lock lock_;  // Lock protecting the variables below.
+  base::ConditionVariable condition_;
+  // The tasks waiting, by the time they are due.
+  std::multimap<base::TimeTicks, base::Closure> tasks_;
+  bool stopped_;
+
+  scoped_ptr<ClosureThread> timer_thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(DelayedTaskQueue);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // PACKAGER_MEDIA_BASE_DELAYED_TASK_QUEUE_H_
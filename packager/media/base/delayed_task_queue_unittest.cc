@@ -0,0 +1,97 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "packager/base/bind.h"
+#include "packager/base/synchronization/lock.h"
+#include "packager/base/synchronization/waitable_event.h"
+#include "packager/media/base/delayed_task_queue.h"
+#include "packager/media/base/thread_pool.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+const size_t kNumThreads = 2;
+
+// Records the tasks in the order they run.
+class TaskRecorder {
+ public:
+  TaskRecorder() : done_(false, false), num_expected_(0) {}
+
+  void Expect(size_t num_tasks) { num_expected_ = num_tasks; }
+
+  void Run(int id) {
+    base::AutoLock l(lock_);
+    ids_.push_back(id);
+    if (ids_.size() == num_expected_)
+      done_.Signal();
+  }
+
+  void Wait() { done_.Wait(); }
+
+  std::vector<int> ids() {
+    base::AutoLock l(lock_);
+    return ids_;
+  }
+
+ private:
+  base::Lock lock_;
+  base::WaitableEvent done_;
+  size_t num_expected_;
+  std::vector<int> ids_;
+};
+
+}  // namespace
+
+TEST(DelayedTaskQueueTest, RunsTasksInDueOrder) {
+  ThreadPool pool("TestDelayedTasks", kNumThreads);
+  pool.Start();
+  TaskRecorder recorder;
+  recorder.Expect(3);
+  {
+    DelayedTaskQueue queue(&pool);
+    const base::TimeTicks start_time = base::TimeTicks::Now();
+    queue.PostDelayedTask(base::Bind(&TaskRecorder::Run,
+                                     base::Unretained(&recorder), 2),
+                          base::TimeDelta::FromMilliseconds(100));
+    queue.PostDelayedTask(base::Bind(&TaskRecorder::Run,
+                                     base::Unretained(&recorder), 1),
+                          base::TimeDelta::FromMilliseconds(50));
+    queue.PostDelayedTask(base::Bind(&TaskRecorder::Run,
+                                     base::Unretained(&recorder), 0),
+                          base::TimeDelta());
+    recorder.Wait();
+    EXPECT_GE(base::TimeTicks::Now() - start_time,
+              base::TimeDelta::FromMilliseconds(100));
+  }
+  const int kExpectedIds[] = {0, 1, 2};
+  EXPECT_EQ(std::vector<int>(kExpectedIds, kExpectedIds + 3), recorder.ids());
+  pool.Shutdown();
+}
+
+TEST(DelayedTaskQueueTest, PostsWaitingTasksOnDestruction) {
+  ThreadPool pool("TestDelayedTasks", kNumThreads);
+  pool.Start();
+  TaskRecorder recorder;
+  recorder.Expect(1);
+  {
+    DelayedTaskQueue queue(&pool);
+    queue.PostDelayedTask(base::Bind(&TaskRecorder::Run,
+                                     base::Unretained(&recorder), 0),
+                          base::TimeDelta::FromHours(1));
+  }
+  recorder.Wait();
+  EXPECT_EQ(1u, recorder.ids().size());
+  pool.Shutdown();
+}
+
+}  // namespace media
+}  // namespace edash_packager
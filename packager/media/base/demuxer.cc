@@ -6,14 +6,34 @@
 
 #include "packager/media/base/demuxer.h"
 
+#include <gflags/gflags.h>
+#include <inttypes.h>
+
+#include <algorithm>
+#include <limits>
+#include <set>
+
 #include "packager/base/bind.h"
 #include "packager/base/logging.h"
 #include "packager/base/stl_util.h"
+#include "packager/base/strings/string_split.h"
+#include "packager/base/strings/stringprintf.h"
+#include "packager/media/base/cancellation_token.h"
+#include "packager/media/base/closure_thread.h"
 #include "packager/media/base/decryptor_source.h"
+#include "packager/media/base/io_throttle.h"
+#include "packager/media/base/job_resource_usage.h"
 #include "packager/media/base/key_source.h"
+#include "packager/media/base/media_index_cache.h"
 #include "packager/media/base/media_sample.h"
 #include "packager/media/base/media_stream.h"
+#include "packager/media/base/memory_tracker.h"
+#include "packager/media/base/muxer_util.h"
+#include "packager/media/base/pipeline_metrics.h"
+#include "packager/media/base/sample_spill_queue.h"
+#include "packager/media/base/shared_buffer.h"
 #include "packager/media/base/stream_info.h"
+#include "packager/media/base/timed_metadata.h"
 #include "packager/media/file/file.h"
 #include "packager/media/formats/mp2t/mp2t_media_parser.h"
 #include "packager/media/formats/mp4/mp4_media_parser.h"
@@ -21,32 +41,146 @@
 #include "packager/media/formats/webvtt/webvtt_media_parser.h"
 #include "packager/media/formats/wvm/wvm_media_parser.h"
 
+DEFINE_uint64(demuxer_buffer_size,
+              2ULL << 20,
+              "Size of the read buffer of each demuxer, in bytes. It is at "
+              "least 64KB.");
+
 namespace {
 // 65KB, sufficient to determine the container and likely all init data.
 const size_t kInitBufSize = 0x10000;
-const size_t kBufSize = 0x200000;  // 2MB
-// Maximum number of allowed queued samples. If we are receiving a lot of
-// samples before seeing init_event, something is not right. The number
-// set here is arbitrary though.
+// Maximum number of allowed queued samples per track, unless the queued
+// samples are spilled to disk. If we are receiving a lot of samples before
+// seeing init_event, something is not right. The number set here is
+// arbitrary though.
 const size_t kQueuedSamplesLimit = 10000;
+// Maximum number of samples of a track held back to merge the tracks in
+// decoding time order, i.e. a few seconds of video. Inputs interleaved more
+// loosely are pushed partly out of order rather than buffered further,
+// unless the queued samples are spilled to disk.
+const size_t kMergedSamplesLimit = 256;
+// Number of samples read on each Parse() call in random access mode.
+const size_t kRandomAccessSamplesPerParse = 64;
+// Maximum time to wait for the memory to get under the soft limits before
+// each Parse() call when pushing samples.
+const int64_t kMaxMemoryWaitMs = 1000;
+// Maximum number of Parse() calls of a slice, so that a busy input does not
+// hold its thread for long.
+const size_t kMaxParsesPerSlice = 16;
+// Bounds of the backoff of the waits between the slices while the input has
+// no data available.
+const int64_t kMinInputWaitMs = 10;
+const int64_t kMaxInputWaitMs = 500;
+
+// Converts |time| from |from_timescale| to |to_timescale|. The maximum value,
+// which means the end of the stream, is kept as is.
+int64_t RescaleTime(int64_t time, uint32_t from_timescale,
+                    uint32_t to_timescale) {
+  if (time == std::numeric_limits<int64_t>::max())
+    return time;
+  return time * to_timescale / from_timescale;
+}
 }
 
 namespace edash_packager {
 namespace media {
 
 Demuxer::Demuxer(const std::string& file_name)
-    : file_name_(file_name),
-      media_file_(NULL),
-      init_event_received_(false),
-      container_name_(CONTAINER_UNKNOWN),
-      buffer_(new uint8_t[kBufSize]),
-      cancelled_(false) {
+    : media_file_(NULL),
+      buffer_(new LargeBuffer(std::max(
+          kInitBufSize, static_cast<size_t>(FLAGS_demuxer_buffer_size)))),
+      late_streams_condition_(&late_streams_lock_),
+      next_chunk_file_(NULL) {
+  Reset(file_name);
 }
 
 Demuxer::~Demuxer() {
-  if (media_file_)
+  CloseInput();
+}
+
+void Demuxer::Reset(const std::string& file_name) {
+  CloseInput();
+
+  file_name_ = file_name;
+  init_event_received_ = false;
+  init_parsing_status_ = Status::OK;
+  parser_limits_ = MediaParserLimits();
+  sample_cpu_time_ = base::TimeDelta();
+  spill_memory_budget_ = 0;
+  spill_temp_dir_.clear();
+  merged_track_ids_.clear();
+  input_format_ = CONTAINER_UNKNOWN;
+  container_name_ = CONTAINER_UNKNOWN;
+  memory_mapped_input_ = false;
+  mapped_input_ = NULL;
+  mapped_input_position_ = 0;
+  random_access_input_ = false;
+  media_index_cache_dir_.clear();
+  media_index_.reset();
+  follow_input_ = false;
+  cooperative_ = false;
+  input_would_block_ = false;
+  slice_status_ = Status::OK;
+  input_wait_ = base::TimeDelta();
+  random_access_parsing_ = false;
+  random_access_tracks_selected_ = false;
+  clipping_ = false;
+  clip_start_ = 0;
+  clip_end_ = std::numeric_limits<int64_t>::max();
+  clip_timescale_ = 1;
+  clip_started_ = false;
+  clip_sync_track_id_ = 0;
+  clip_pending_samples_.clear();
+  clip_ended_track_ids_.clear();
+  key_source_.reset();
+  cancelled_ = false;
+  late_streams_enabled_ = false;
+  max_replay_bytes_ = 0;
+  replay_samples_.clear();
+  replay_bytes_ = 0;
+  replay_overflowed_ = false;
+  late_streams_closed_ = false;
+  late_streams_status_ = Status::OK;
+  num_late_reservations_ = 0;
+  late_track_ids_.clear();
+  late_track_ids_fixed_ = false;
+  chunk_file_names_.clear();
+  chunk_pattern_.clear();
+  chunk_index_ = 0;
+  next_chunk_bytes_read_ = 0;
+  buffered_bytes_ = 0;
+  chunk_offset_set_ = false;
+  chunk_offset_ = 0;
+  timeline_end_ = 0;
+  timeline_timescale_ = 1;
+
+  if (file_name_.find("$Number") != std::string::npos)
+    chunk_pattern_ = file_name_;
+  else
+    base::SplitString(file_name_, kInputChunkSeparator, &chunk_file_names_);
+}
+
+void Demuxer::CloseInput() {
+  if (chunk_read_ahead_thread_) {
+    chunk_read_ahead_thread_->Join();
+    chunk_read_ahead_thread_.reset();
+  }
+  if (next_chunk_file_) {
+    next_chunk_file_->Close();
+    next_chunk_file_ = NULL;
+  }
+  if (media_file_) {
     media_file_->Close();
+    media_file_ = NULL;
+  }
+  parser_.reset();
+  // The late streams have ended, see CloseLateStreams().
+  DCHECK(running_late_streams_.empty());
+  DCHECK(started_late_streams_.empty());
+  STLDeleteElements(&late_streams_);
+  STLDeleteElements(&fan_out_streams_);
   STLDeleteElements(&streams_);
+  STLDeleteValues(&queued_samples_);
 }
 
 void Demuxer::SetKeySource(scoped_ptr<KeySource> key_source) {
@@ -55,30 +189,147 @@ void Demuxer::SetKeySource(scoped_ptr<KeySource> key_source) {
 
 Status Demuxer::Initialize() {
   DCHECK(!media_file_);
+  DCHECK(!mapped_input_);
   DCHECK(!init_event_received_);
 
   LOG(INFO) << "Initialize Demuxer for file '" << file_name_ << "'.";
 
-  media_file_ = File::Open(file_name_.c_str(), "r");
-  if (!media_file_) {
-    return Status(error::FILE_FAILURE,
-                  "Cannot open file for reading " + file_name_);
+  if (is_chunked_input()) {
+    LOG_IF(INFO, memory_mapped_input_ || random_access_input_)
+        << "Chunked input " << file_name_ << " is read sequentially.";
+    memory_mapped_input_ = false;
+    random_access_input_ = false;
+  }
+  if (follow_input_) {
+    LOG_IF(INFO, memory_mapped_input_ || random_access_input_)
+        << "Followed input " << file_name_ << " is read sequentially.";
+    LOG_IF(WARNING, is_chunked_input())
+        << "Chunked input " << file_name_ << " is not followed.";
+    memory_mapped_input_ = false;
+    random_access_input_ = false;
   }
+  const std::string input_file_name = GetChunkFileName(0);
 
-  // Read enough bytes before detecting the container.
+  // Only the inputs parsed by random access are indexed.
+  const bool indexed = !media_index_cache_dir_.empty() &&
+                       random_access_input_ && !memory_mapped_input_;
+  scoped_ptr<MediaIndex> cached_index;
+  if (indexed) {
+    cached_index.reset(new MediaIndex);
+    if (!MediaIndexCache(media_index_cache_dir_)
+             .Lookup(input_file_name, cached_index.get())) {
+      cached_index.reset();
+    }
+  }
+
+  std::string local_file_path;
+  if (memory_mapped_input_ &&
+      File::GetLocalFilePath(input_file_name, &local_file_path)) {
+    const bool kSequentialAccess = true;
+    mapped_input_ = SharedBuffer::MapFile(local_file_path, kSequentialAccess);
+    LOG_IF(WARNING, !mapped_input_) << "Cannot memory map " << input_file_name
+                                    << ". Falling back to file reads.";
+  }
+
+  const uint8_t* init_data = buffer_->data();
   size_t bytes_read = 0;
-  while (bytes_read < kInitBufSize) {
-    int64_t read_result =
-        media_file_->Read(buffer_.get() + bytes_read, kInitBufSize);
-    if (read_result < 0)
-      return Status(error::FILE_FAILURE, "Cannot read file " + file_name_);
-    if (read_result == 0)
-      break;
-    bytes_read += read_result;
+  container_name_ = input_format_;
+  if (container_name_ == CONTAINER_UNKNOWN && cached_index) {
+    container_name_ =
+        static_cast<MediaContainerName>(cached_index->container());
+  }
+  if (mapped_input_) {
+    init_data = mapped_input_->data();
+    bytes_read = std::min(kInitBufSize, mapped_input_->size());
+    mapped_input_position_ = bytes_read;
+  } else {
+    const std::string file_name = follow_input_ && !is_chunked_input()
+                                      ? kFollowFilePrefix + input_file_name
+                                      : input_file_name;
+    // Threaded I/O would wait for the data on its own thread.
+    media_file_ = cooperative_
+                      ? File::OpenWithNoBuffering(file_name.c_str(), "r")
+                      : File::Open(file_name.c_str(), "r");
+    if (!media_file_) {
+      return Status(error::FILE_FAILURE,
+                    "Cannot open file for reading " + input_file_name);
+    }
+    StartChunkReadAhead();
+
+    // Read until the container is known, which usually takes much less than
+    // |kInitBufSize| bytes. The bytes read are handed to the parser.
+    while (container_name_ == CONTAINER_UNKNOWN && bytes_read < kInitBufSize) {
+      int64_t read_result = media_file_->Read(buffer_->data() + bytes_read,
+                                              kInitBufSize - bytes_read);
+      if (read_result < 0) {
+        return Status(error::FILE_FAILURE,
+                      "Cannot read file " + input_file_name);
+      }
+      if (read_result == 0)
+        break;
+      bytes_read += read_result;
+      container_name_ = DetermineContainerFromPrefix(init_data, bytes_read);
+    }
+  }
+  if (container_name_ == CONTAINER_UNKNOWN)
+    container_name_ = DetermineContainer(init_data, bytes_read);
+
+  Status status = CreateParser();
+  if (!status.ok())
+    return status;
+
+  // Handle trailing 'moov'.
+  if (container_name_ == CONTAINER_MOV) {
+    mp4::MP4MediaParser* mp4_parser =
+        static_cast<mp4::MP4MediaParser*>(parser_.get());
+    if (random_access_input_ && !mapped_input_) {
+      mp4::MP4MediaParser::MoovBox moov_box;
+      if (cached_index) {
+        moov_box.offset = cached_index->moov_offset();
+        moov_box.data.assign(cached_index->moov().begin(),
+                             cached_index->moov().end());
+        cached_index->clear_moov();
+      }
+      if (mp4_parser->InitRandomAccess(input_file_name, &moov_box)) {
+        random_access_parsing_ = true;
+        DCHECK(init_event_received_);
+        if (cached_index)
+          media_index_ = cached_index.Pass();
+        else if (indexed)
+          StoreMediaIndex(moov_box.offset, moov_box.data);
+        return Status::OK;
+      }
+    }
+    if (mapped_input_)
+      mp4_parser->LoadMoov(*mapped_input_);
+    else
+      mp4_parser->LoadMoov(input_file_name);
+  } else if (container_name_ == CONTAINER_WEBM) {
+    // Seek through the Cues to the Clusters of a time range.
+    if (random_access_input_ && !mapped_input_ &&
+        static_cast<WebMMediaParser*>(parser_.get())
+            ->InitRandomAccess(input_file_name)) {
+      random_access_parsing_ = true;
+      DCHECK(init_event_received_);
+      return Status::OK;
+    }
+  }
+
+  if (mapped_input_)
+    parser_->SetInputBuffer(mapped_input_);
+  if (bytes_read > 0 && !parser_->Parse(init_data, bytes_read)) {
+    init_parsing_status_ = Status(error::PARSER_FAILURE,
+                                  "Cannot parse media file " + input_file_name);
   }
-  container_name_ = DetermineContainer(buffer_.get(), bytes_read);
 
-  // Initialize media parser.
+  // Parse until init event received or on error.
+  while (!init_event_received_ && init_parsing_status_.ok())
+    init_parsing_status_ = Parse();
+  // Defer error reporting if init completed successfully.
+  return init_event_received_ ? Status::OK : init_parsing_status_;
+}
+
+Status Demuxer::CreateParser() {
   switch (container_name_) {
     case CONTAINER_MOV:
       parser_.reset(new mp4::MP4MediaParser());
@@ -100,34 +351,495 @@ Status Demuxer::Initialize() {
       return Status(error::UNIMPLEMENTED, "Container not supported.");
   }
 
-  parser_->Init(base::Bind(&Demuxer::ParserInitEvent, base::Unretained(this)),
+  parser_->set_limits(parser_limits_);
+  parser_->set_timed_metadata_cb(base::Bind(&Demuxer::NewTimedMetadataEvent,
+                                            base::Unretained(this)));
+
+  // The streams of the first chunk are the streams of the Demuxer.
+  MediaParser::InitCB init_cb =
+      chunk_index_ == 0
+          ? base::Bind(&Demuxer::ParserInitEvent, base::Unretained(this))
+          : base::Bind(&Demuxer::ChunkInitEvent, base::Unretained(this));
+  parser_->Init(init_cb,
                 base::Bind(&Demuxer::NewSampleEvent, base::Unretained(this)),
                 key_source_.get());
+  return Status::OK;
+}
 
-  // Handle trailing 'moov'.
-  if (container_name_ == CONTAINER_MOV)
-    static_cast<mp4::MP4MediaParser*>(parser_.get())->LoadMoov(file_name_);
-
-  if (!parser_->Parse(buffer_.get(), bytes_read)) {
-    init_parsing_status_ =
-        Status(error::PARSER_FAILURE, "Cannot parse media file " + file_name_);
+void Demuxer::StoreMediaIndex(uint64_t moov_offset,
+                              const std::vector<uint8_t>& moov) {
+  DCHECK_EQ(CONTAINER_MOV, container_name_);
+  mp4::MP4MediaParser* mp4_parser =
+      static_cast<mp4::MP4MediaParser*>(parser_.get());
+  scoped_ptr<MediaIndex> index(new MediaIndex);
+  index->set_container(container_name_);
+  index->set_moov_offset(moov_offset);
+  index->set_moov(moov.data(), moov.size());
+  for (const MediaStream* stream : streams_) {
+    const uint32_t track_id = stream->info()->track_id();
+    std::vector<int64_t> key_frame_times;
+    if (!mp4_parser->GetKeyFrameTimes(track_id, &key_frame_times))
+      continue;
+    MediaIndex::Track* track = index->add_track();
+    track->set_track_id(track_id);
+    for (int64_t key_frame_time : key_frame_times)
+      track->add_key_frame_time(key_frame_time);
   }
-
-  // Parse until init event received or on error.
-  while (!init_event_received_ && init_parsing_status_.ok())
-    init_parsing_status_ = Parse();
-  // Defer error reporting if init completed successfully.
-  return init_event_received_ ? Status::OK : init_parsing_status_;
+  // The input is demuxed anyway if the index cannot be stored.
+  MediaIndexCache(media_index_cache_dir_).Store(GetChunkFileName(0),
+                                                index.get());
+  index->clear_moov();
+  media_index_ = index.Pass();
 }
 
 void Demuxer::ParserInitEvent(
     const std::vector<scoped_refptr<StreamInfo> >& streams) {
   init_event_received_ = true;
-
   std::vector<scoped_refptr<StreamInfo> >::const_iterator it = streams.begin();
   for (; it != streams.end(); ++it) {
     streams_.push_back(new MediaStream(*it, this));
+    streams_.back()->SetSpillOptions(spill_memory_budget_, spill_temp_dir_);
+  }
+  if (!streams_.empty())
+    timeline_timescale_ = streams_.front()->info()->time_scale();
+}
+
+void Demuxer::ChunkInitEvent(
+    const std::vector<scoped_refptr<StreamInfo> >& streams) {
+  const std::string chunk_file_name = GetChunkFileName(chunk_index_);
+  bool streams_match = streams.size() == streams_.size();
+  for (size_t i = 0; i < streams.size() && streams_match; ++i) {
+    const MediaStream* stream = FindStream(streams[i]->track_id());
+    streams_match = stream &&
+                    stream->info()->stream_type() ==
+                        streams[i]->stream_type() &&
+                    stream->info()->time_scale() == streams[i]->time_scale();
+  }
+  if (!streams_match) {
+    init_parsing_status_ =
+        Status(error::PARSER_FAILURE,
+               "The streams of chunk " + chunk_file_name +
+                   " do not match the streams of " + GetChunkFileName(0));
+  }
+}
+
+std::string Demuxer::GetChunkFileName(uint32_t chunk_index) const {
+  if (!chunk_pattern_.empty())
+    return GetSegmentName(chunk_pattern_, 0, chunk_index, 0);
+  return chunk_index < chunk_file_names_.size() ? chunk_file_names_[chunk_index]
+                                                : std::string();
+}
+
+void Demuxer::StartChunkReadAhead() {
+  DCHECK(!chunk_read_ahead_thread_);
+  const std::string next_chunk_file_name = GetChunkFileName(chunk_index_ + 1);
+  if (next_chunk_file_name.empty())
+    return;
+  if (!next_chunk_buffer_)
+    next_chunk_buffer_.reset(new LargeBuffer(buffer_->size()));
+  chunk_read_ahead_thread_.reset(new ClosureThread(
+      "ChunkReadAhead",
+      base::Bind(&Demuxer::ReadAheadNextChunk, base::Unretained(this),
+                 next_chunk_file_name)));
+  chunk_read_ahead_thread_->Start();
+}
+
+void Demuxer::ReadAheadNextChunk(const std::string& chunk_file_name) {
+  DCHECK(!next_chunk_file_);
+  next_chunk_bytes_read_ = 0;
+  next_chunk_file_ = File::Open(chunk_file_name.c_str(), "r");
+  if (next_chunk_file_)
+    next_chunk_bytes_read_ = next_chunk_file_->Read(
+        next_chunk_buffer_->data(), next_chunk_buffer_->size());
+}
+
+Status Demuxer::OpenNextChunk(bool* end_of_input) {
+  DCHECK(end_of_input);
+  *end_of_input = true;
+  if (!chunk_read_ahead_thread_)
+    return Status::OK;
+  chunk_read_ahead_thread_->Join();
+  chunk_read_ahead_thread_.reset();
+
+  const std::string chunk_file_name = GetChunkFileName(chunk_index_ + 1);
+  if (!next_chunk_file_) {
+    // A chunk pattern ends at the first missing chunk.
+    if (!chunk_pattern_.empty())
+      return Status::OK;
+    return Status(error::FILE_FAILURE,
+                  "Cannot open file for reading " + chunk_file_name);
+  }
+  if (next_chunk_bytes_read_ < 0)
+    return Status(error::FILE_FAILURE, "Cannot read file " + chunk_file_name);
+
+  LOG(INFO) << "Demuxing chunk '" << chunk_file_name << "'.";
+  media_file_->Close();
+  media_file_ = next_chunk_file_;
+  next_chunk_file_ = NULL;
+  buffer_.swap(next_chunk_buffer_);
+  buffered_bytes_ = next_chunk_bytes_read_;
+  ++chunk_index_;
+  chunk_offset_set_ = false;
+
+  Status status = CreateParser();
+  if (!status.ok())
+    return status;
+  if (container_name_ == CONTAINER_MOV) {
+    static_cast<mp4::MP4MediaParser*>(parser_.get())
+        ->LoadMoov(chunk_file_name);
+  }
+  parser_->SelectTracks(GetConsumedTrackIds());
+  StartChunkReadAhead();
+  *end_of_input = false;
+  return Status::OK;
+}
+
+void Demuxer::AdjustChunkTimestamps(uint32_t track_id,
+                                    const scoped_refptr<MediaSample>& sample) {
+  const MediaStream* stream = FindStream(track_id);
+  if (!stream)
+    return;
+  const uint32_t track_timescale = stream->info()->time_scale();
+  if (!chunk_offset_set_) {
+    // Chunks whose timestamps restart, e.g. at zero, continue the timeline
+    // from the end of the previous chunk.
+    const int64_t chunk_start =
+        RescaleTime(sample->dts(), track_timescale, timeline_timescale_);
+    chunk_offset_ =
+        chunk_index_ > 0 && chunk_start < timeline_end_
+            ? timeline_end_ - chunk_start
+            : 0;
+    chunk_offset_set_ = true;
+  }
+  if (chunk_offset_ != 0) {
+    const int64_t offset =
+        RescaleTime(chunk_offset_, timeline_timescale_, track_timescale);
+    sample->set_dts(sample->dts() + offset);
+    sample->set_pts(sample->pts() + offset);
+  }
+  timeline_end_ = std::max(
+      timeline_end_,
+      RescaleTime(sample->dts() + sample->duration(), track_timescale,
+                  timeline_timescale_));
+}
+
+void Demuxer::NewTimedMetadataEvent(const TimedMetadataEvent& event) {
+  // The events are on the timeline of the samples, which the chunks of a
+  // chunked input continue.
+  TimedMetadataEvent adjusted_event = event;
+  if (chunk_offset_set_ && chunk_offset_ != 0) {
+    adjusted_event.presentation_time += RescaleTime(
+        chunk_offset_, timeline_timescale_, adjusted_event.timescale);
+  }
+  // The events belong to the program rather than to a track, so every
+  // stream carries them, and each muxer takes those of one of its streams.
+  for (MediaStream* stream : streams_)
+    stream->PushTimedMetadata(adjusted_event);
+  for (MediaStream* stream : fan_out_streams_)
+    stream->PushTimedMetadata(adjusted_event);
+}
+
+MediaStream* Demuxer::CreateFanOutStream(MediaStream* stream) {
+  DCHECK(std::find(streams_.begin(), streams_.end(), stream) !=
+         streams_.end());
+  MediaStream* fan_out_stream = new MediaStream(stream->demuxed_info(), this);
+  fan_out_stream->set_sample_channel_capacity(
+      stream->sample_channel_capacity());
+  fan_out_stream->SetSpillOptions(spill_memory_budget_, spill_temp_dir_);
+  fan_out_streams_.push_back(fan_out_stream);
+  return fan_out_stream;
+}
+
+void Demuxer::EnableLateStreams(uint64_t max_replay_bytes) {
+  late_streams_enabled_ = true;
+  max_replay_bytes_ = max_replay_bytes;
+}
+
+bool Demuxer::ReserveLateStreams(const std::set<uint32_t>& track_ids) {
+  base::AutoLock l(late_streams_lock_);
+  if (!late_streams_enabled_ || replay_overflowed_ || late_streams_closed_)
+    return false;
+  if (late_track_ids_fixed_) {
+    // Only the tracks demuxed already can be joined.
+    if (!std::includes(late_track_ids_.begin(), late_track_ids_.end(),
+                       track_ids.begin(), track_ids.end())) {
+      return false;
+    }
+  } else {
+    late_track_ids_.insert(track_ids.begin(), track_ids.end());
+  }
+  ++num_late_reservations_;
+  return true;
+}
+
+MediaStream* Demuxer::CreateLateStream(MediaStream* stream) {
+  DCHECK(std::find(streams_.begin(), streams_.end(), stream) !=
+         streams_.end());
+  MediaStream* late_stream = new MediaStream(stream->demuxed_info(), this);
+  late_stream->set_sample_channel_capacity(stream->sample_channel_capacity());
+  late_stream->SetSpillOptions(spill_memory_budget_, spill_temp_dir_);
+  base::AutoLock l(late_streams_lock_);
+  DCHECK(late_track_ids_.count(stream->info()->track_id()));
+  late_streams_.push_back(late_stream);
+  return late_stream;
+}
+
+void Demuxer::StartLateStreams(const std::vector<MediaStream*>& streams,
+                               const LateStreamsDoneCB& done_callback) {
+  scoped_ptr<LateStreams> late_streams(new LateStreams);
+  late_streams->streams = streams;
+  late_streams->done_callback = done_callback;
+  late_streams->cancellation_token = CancellationToken::Current();
+  late_streams->io_throttle = IoThrottle::Current();
+  late_streams->resource_usage = JobResourceUsage::Current();
+  Status status;
+  {
+    base::AutoLock l(late_streams_lock_);
+    DCHECK_GT(num_late_reservations_, 0u);
+    --num_late_reservations_;
+    late_streams_condition_.Broadcast();
+    if (!late_streams_closed_) {
+      started_late_streams_.push_back(late_streams.release());
+      return;
+    }
+    // The Demuxer failed before the streams could start.
+    status = late_streams_status_;
+  }
+  DCHECK(!status.ok());
+  done_callback.Run(status);
+}
+
+void Demuxer::CancelLateStreamsReservation() {
+  base::AutoLock l(late_streams_lock_);
+  DCHECK_GT(num_late_reservations_, 0u);
+  --num_late_reservations_;
+  late_streams_condition_.Broadcast();
+}
+
+void Demuxer::CloseLateStreams(const Status& status) {
+  if (!late_streams_enabled_)
+    return;
+  {
+    base::AutoLock l(late_streams_lock_);
+    if (late_streams_closed_)
+      return;
+    // The late streams reserved get the whole input, from the replay buffer,
+    // if the input was demuxed. The reservations are only held while the
+    // jobs reserving them are set up.
+    while (status.ok() && num_late_reservations_ > 0)
+      late_streams_condition_.Wait();
+    late_streams_closed_ = true;
+    late_streams_status_ = status;
   }
+  if (status.ok()) {
+    StartPendingLateStreams();
+  } else {
+    std::vector<LateStreams*> started_late_streams;
+    {
+      base::AutoLock l(late_streams_lock_);
+      started_late_streams.swap(started_late_streams_);
+    }
+    for (LateStreams* late_streams : started_late_streams)
+      EndLateStreams(late_streams, status);
+  }
+  std::vector<LateStreams*> running_late_streams;
+  running_late_streams.swap(running_late_streams_);
+  for (LateStreams* late_streams : running_late_streams)
+    EndLateStreams(late_streams, status);
+  replay_samples_.clear();
+}
+
+void Demuxer::PushLateSample(uint32_t track_id,
+                             const scoped_refptr<MediaSample>& sample) {
+  StartPendingLateStreams();
+
+  for (std::vector<LateStreams*>::iterator it = running_late_streams_.begin();
+       it != running_late_streams_.end();) {
+    LateStreams* late_streams = *it;
+    Status status;
+    if (late_streams->cancellation_token.get() &&
+        late_streams->cancellation_token->IsCancelled()) {
+      status = Status(error::CANCELLED, "Late streams cancelled.");
+    } else {
+      ScopedCancellationToken scoped_token(
+          late_streams->cancellation_token.get());
+      ScopedIoThrottle scoped_throttle(late_streams->io_throttle.get());
+      ScopedJobResourceUsage scoped_usage(late_streams->resource_usage.get());
+      for (size_t i = 0; i < late_streams->streams.size() && status.ok();
+           ++i) {
+        MediaStream* stream = late_streams->streams[i];
+        if (stream->info()->track_id() == track_id)
+          status = stream->PushSample(sample->ShallowCopy());
+      }
+    }
+    if (status.ok()) {
+      ++it;
+    } else {
+      // The late streams fail on their own.
+      it = running_late_streams_.erase(it);
+      EndLateStreams(late_streams, status);
+    }
+  }
+
+  if (replay_overflowed_)
+    return;
+  base::AutoLock l(late_streams_lock_);
+  if (replay_bytes_ + sample->payload_size() > max_replay_bytes_ &&
+      num_late_reservations_ == 0) {
+    VLOG(1) << "The replay buffer of " << file_name_ << " is full; late "
+            << "streams cannot join anymore.";
+    replay_overflowed_ = true;
+    replay_samples_.clear();
+    return;
+  }
+  replay_samples_.push_back(QueuedSample(track_id, sample->ShallowCopy()));
+  replay_bytes_ += sample->payload_size();
+}
+
+void Demuxer::StartPendingLateStreams() {
+  std::vector<LateStreams*> started_late_streams;
+  {
+    base::AutoLock l(late_streams_lock_);
+    if (started_late_streams_.empty())
+      return;
+    started_late_streams.swap(started_late_streams_);
+  }
+  for (LateStreams* late_streams : started_late_streams) {
+    // The replay buffer is kept for the reserved streams.
+    DCHECK(!replay_overflowed_);
+    Status status;
+    {
+      ScopedCancellationToken scoped_token(
+          late_streams->cancellation_token.get());
+      ScopedIoThrottle scoped_throttle(late_streams->io_throttle.get());
+      ScopedJobResourceUsage scoped_usage(late_streams->resource_usage.get());
+      for (size_t i = 0; i < late_streams->streams.size() && status.ok(); ++i)
+        status = late_streams->streams[i]->Start(MediaStream::kPush);
+      for (std::deque<QueuedSample>::const_iterator it =
+               replay_samples_.begin();
+           it != replay_samples_.end() && status.ok(); ++it) {
+        for (size_t i = 0; i < late_streams->streams.size() && status.ok();
+             ++i) {
+          MediaStream* stream = late_streams->streams[i];
+          if (stream->info()->track_id() == it->track_id)
+            status = stream->PushSample(it->sample->ShallowCopy());
+        }
+      }
+    }
+    if (status.ok())
+      running_late_streams_.push_back(late_streams);
+    else
+      EndLateStreams(late_streams, status);
+  }
+}
+
+void Demuxer::EndLateStreams(LateStreams* late_streams, Status status) {
+  scoped_ptr<LateStreams> scoped_late_streams(late_streams);
+  {
+    ScopedCancellationToken scoped_token(
+        late_streams->cancellation_token.get());
+    ScopedIoThrottle scoped_throttle(late_streams->io_throttle.get());
+    ScopedJobResourceUsage scoped_usage(late_streams->resource_usage.get());
+    if (status.ok()) {
+      const scoped_refptr<MediaSample>& sample =
+          MediaSample::CreateEOSBuffer();
+      for (size_t i = 0; i < late_streams->streams.size() && status.ok(); ++i)
+        status = late_streams->streams[i]->PushSample(sample);
+    }
+    // Wait for the samples in flight to be muxed.
+    for (MediaStream* stream : late_streams->streams) {
+      Status stop_status = stream->Stop();
+      if (status.ok() && !stop_status.ok())
+        status = stop_status;
+    }
+  }
+  late_streams->done_callback.Run(status);
+}
+
+Status Demuxer::SetTimeRange(int64_t start, int64_t end, uint32_t timescale) {
+  if (!random_access_parsing_) {
+    return Status(error::UNIMPLEMENTED,
+                  "Time ranges require random access parsing.");
+  }
+  if (container_name_ == CONTAINER_WEBM) {
+    static_cast<WebMMediaParser*>(parser_.get())
+        ->SetRandomAccessTimeRange(start, end, timescale);
+  } else {
+    static_cast<mp4::MP4MediaParser*>(parser_.get())
+        ->SetRandomAccessTimeRange(start, end, timescale);
+  }
+  return Status::OK;
+}
+
+Status Demuxer::SetClipRange(int64_t start, int64_t end, uint32_t timescale) {
+  DCHECK(init_event_received_);
+  DCHECK_LT(start, end);
+  DCHECK_NE(0u, timescale);
+  if (streams_.empty())
+    return Status(error::PARSER_FAILURE, "No streams in " + file_name_);
+
+  // The clip starts at a sync sample of the video stream, if any.
+  const MediaStream* sync_stream = streams_.front();
+  for (const MediaStream* stream : streams_) {
+    if (stream->info()->stream_type() == kStreamVideo) {
+      sync_stream = stream;
+      break;
+    }
+  }
+
+  if (random_access_parsing_) {
+    // WebM inputs start at the Cluster of the cue point before the start.
+    std::vector<int64_t> key_frame_times;
+    if (container_name_ == CONTAINER_MOV && start > 0 &&
+        GetKeyFrameTimes(sync_stream->info()->track_id(), &key_frame_times)
+            .ok()) {
+      const uint32_t track_timescale = sync_stream->info()->time_scale();
+      std::vector<int64_t>::const_iterator it = std::upper_bound(
+          key_frame_times.begin(), key_frame_times.end(),
+          RescaleTime(start, timescale, track_timescale));
+      if (it != key_frame_times.begin()) {
+        return SetTimeRange(*(it - 1),
+                            RescaleTime(end, timescale, track_timescale),
+                            track_timescale);
+      }
+    }
+    return SetTimeRange(start, end, timescale);
+  }
+
+  clipping_ = true;
+  clip_start_ = start;
+  clip_end_ = end;
+  clip_timescale_ = timescale;
+  clip_sync_track_id_ = sync_stream->info()->track_id();
+  return Status::OK;
+}
+
+Status Demuxer::GetKeyFrameTimes(uint32_t track_id,
+                                 std::vector<int64_t>* key_frame_times) {
+  if (!random_access_parsing_) {
+    return Status(error::UNIMPLEMENTED,
+                  "Key frame times require random access parsing.");
+  }
+  // The Cues of WebM files do not index every key frame.
+  if (container_name_ == CONTAINER_WEBM) {
+    return Status(error::UNIMPLEMENTED,
+                  "Key frame times are not available for WebM inputs.");
+  }
+  if (media_index_) {
+    for (const MediaIndex::Track& track : media_index_->track()) {
+      if (track.track_id() == track_id) {
+        key_frame_times->assign(track.key_frame_time().begin(),
+                                track.key_frame_time().end());
+        return Status::OK;
+      }
+    }
+  }
+  if (!static_cast<mp4::MP4MediaParser*>(parser_.get())
+           ->GetKeyFrameTimes(track_id, key_frame_times)) {
+    return Status(error::PARSER_FAILURE,
+                  "Cannot get key frame times from " + file_name_);
+  }
+  return Status::OK;
 }
 
 Demuxer::QueuedSample::QueuedSample(uint32_t local_track_id,
@@ -135,77 +847,320 @@ Demuxer::QueuedSample::QueuedSample(uint32_t local_track_id,
     : track_id(local_track_id), sample(local_sample) {}
 Demuxer::QueuedSample::~QueuedSample() {}
 
+Demuxer::LateStreams::LateStreams() {}
+Demuxer::LateStreams::~LateStreams() {}
+
 bool Demuxer::NewSampleEvent(uint32_t track_id,
                              const scoped_refptr<MediaSample>& sample) {
+  if (parser_limits_.max_parse_cpu_time == base::TimeDelta())
+    return HandleNewSample(track_id, sample);
+  const base::TimeDelta start_cpu_time = JobResourceUsage::GetThreadCpuTime();
+  const bool result = HandleNewSample(track_id, sample);
+  sample_cpu_time_ += JobResourceUsage::GetThreadCpuTime() - start_cpu_time;
+  return result;
+}
+
+bool Demuxer::HandleNewSample(uint32_t track_id,
+                              const scoped_refptr<MediaSample>& sample) {
+  if (is_chunked_input() && init_event_received_)
+    AdjustChunkTimestamps(track_id, sample);
   if (!init_event_received_) {
-    if (queued_samples_.size() >= kQueuedSamplesLimit) {
+    SampleSpillQueue* queue = GetSampleQueue(track_id);
+    if (spill_memory_budget_ == 0 && queue->size() >= kQueuedSamplesLimit) {
       LOG(ERROR) << "Queued samples limit reached: " << kQueuedSamplesLimit;
       return false;
     }
-    queued_samples_.push_back(QueuedSample(track_id, sample));
+    Status status = queue->Push(sample);
+    if (!status.ok()) {
+      LOG(ERROR) << "Cannot queue sample: " << status;
+      return false;
+    }
     return true;
   }
-  while (!queued_samples_.empty()) {
-    if (!PushSample(queued_samples_.front().track_id,
-                    queued_samples_.front().sample)) {
+  if (merged_track_ids_.empty())
+    return PushMergedSamples(true) && PushClipSample(track_id, sample);
+  Status status = GetSampleQueue(track_id)->Push(sample);
+  if (!status.ok()) {
+    LOG(ERROR) << "Cannot queue sample: " << status;
+    return false;
+  }
+  return PushMergedSamples(false);
+}
+
+SampleSpillQueue* Demuxer::GetSampleQueue(uint32_t track_id) {
+  SampleSpillQueue*& queue = queued_samples_[track_id];
+  if (!queue) {
+    queue = new SampleSpillQueue(kDemuxerQueueMemory);
+    queue->SetSpillOptions(spill_memory_budget_, spill_temp_dir_);
+  }
+  return queue;
+}
+
+bool Demuxer::PushMergedSamples(bool flush) {
+  while (true) {
+    // Pick the queued sample with the earliest decoding time. There are only
+    // a few tracks, so a scan is as good as a heap.
+    bool found = false;
+    uint32_t next_track_id = 0;
+    double next_dts_in_seconds = 0;
+    bool queue_full = false;
+    for (std::map<uint32_t, SampleSpillQueue*>::const_iterator it =
+             queued_samples_.begin();
+         it != queued_samples_.end(); ++it) {
+      if (it->second->empty())
+        continue;
+      if (spill_memory_budget_ == 0 &&
+          it->second->size() >= kMergedSamplesLimit)
+        queue_full = true;
+      const MediaStream* stream = FindStream(it->first);
+      const double dts_in_seconds =
+          stream ? static_cast<double>(it->second->front()->dts()) /
+                       stream->info()->time_scale()
+                 : 0;
+      if (!found || dts_in_seconds < next_dts_in_seconds) {
+        found = true;
+        next_track_id = it->first;
+        next_dts_in_seconds = dts_in_seconds;
+      }
+    }
+    if (!found)
+      return true;
+
+    if (!flush && !queue_full) {
+      // Wait for the next sample of the tracks which have none queued, as it
+      // may come first. The tracks past the end of the clip have no more.
+      for (std::set<uint32_t>::const_iterator it = merged_track_ids_.begin();
+           it != merged_track_ids_.end(); ++it) {
+        if (GetSampleQueue(*it)->empty() &&
+            clip_ended_track_ids_.find(*it) == clip_ended_track_ids_.end()) {
+          return true;
+        }
+      }
+    }
+
+    scoped_refptr<MediaSample> sample;
+    Status status = queued_samples_[next_track_id]->Pop(&sample);
+    if (!status.ok()) {
+      LOG(ERROR) << "Cannot dequeue sample: " << status;
+      return false;
+    }
+    if (!PushClipSample(next_track_id, sample))
       return false;
+  }
+}
+
+bool Demuxer::PushClipSample(uint32_t track_id,
+                             const scoped_refptr<MediaSample>& sample) {
+  if (!clipping_)
+    return PushSample(track_id, sample);
+
+  const MediaStream* stream = FindStream(track_id);
+  if (!stream) {
+    LOG(ERROR) << "Track " << track_id << " not found.";
+    return false;
+  }
+  const uint32_t track_timescale = stream->info()->time_scale();
+  if (sample->dts() >= RescaleTime(clip_end_, clip_timescale_,
+                                   track_timescale)) {
+    clip_ended_track_ids_.insert(track_id);
+    return true;
+  }
+  if (!clip_started_) {
+    if (sample->dts() <
+        RescaleTime(clip_start_, clip_timescale_, track_timescale)) {
+      // Keep the samples from the last sync sample, which starts the clip.
+      if (track_id == clip_sync_track_id_ && sample->is_key_frame())
+        clip_pending_samples_.clear();
+      clip_pending_samples_.push_back(QueuedSample(track_id, sample));
+      return true;
+    }
+    clip_started_ = true;
+    while (!clip_pending_samples_.empty()) {
+      if (!PushSample(clip_pending_samples_.front().track_id,
+                      clip_pending_samples_.front().sample)) {
+        return false;
+      }
+      clip_pending_samples_.pop_front();
     }
-    queued_samples_.pop_front();
   }
   return PushSample(track_id, sample);
 }
 
+MediaStream* Demuxer::FindStream(uint32_t track_id) const {
+  for (MediaStream* stream : streams_) {
+    if (track_id == stream->info()->track_id())
+      return stream;
+  }
+  return NULL;
+}
+
 bool Demuxer::PushSample(uint32_t track_id,
                          const scoped_refptr<MediaSample>& sample) {
-  std::vector<MediaStream*>::iterator it = streams_.begin();
-  for (; it != streams_.end(); ++it) {
-    if (track_id == (*it)->info()->track_id()) {
-      Status status = (*it)->PushSample(sample);
-      if (!status.ok())
-        LOG(ERROR) << "Demuxer::PushSample failed with " << status;
-      return status.ok();
-    }
+  MediaStream* stream = FindStream(track_id);
+  if (!stream) {
+    LOG(ERROR) << "Track " << track_id << " not found.";
+    return false;
+  }
+
+  // The late streams get their copies first.
+  if (late_streams_enabled_)
+    PushLateSample(track_id, sample);
+
+  std::vector<MediaStream*> fan_out_streams;
+  for (std::vector<MediaStream*>::iterator it = fan_out_streams_.begin();
+       it != fan_out_streams_.end(); ++it) {
+    if (track_id == (*it)->info()->track_id())
+      fan_out_streams.push_back(*it);
   }
-  LOG(ERROR) << "Track " << track_id << " not found.";
-  return false;
+  // Make all the copies before any Muxer, possibly running in its own
+  // thread, gets hold of |sample|.
+  std::vector<scoped_refptr<MediaSample> > fan_out_samples;
+  for (size_t i = 0; i < fan_out_streams.size(); ++i)
+    fan_out_samples.push_back(sample->ShallowCopy());
+
+  Status status = stream->PushSample(sample);
+  for (size_t i = 0; i < fan_out_streams.size() && status.ok(); ++i)
+    status = fan_out_streams[i]->PushSample(fan_out_samples[i]);
+  if (!status.ok())
+    LOG(ERROR) << "Demuxer::PushSample failed with " << status;
+  return status.ok();
 }
 
 Status Demuxer::Run() {
-  Status status;
+  Status status = StartRun();
+  if (!status.ok())
+    return status;
 
+  while (!cancelled_ && !CancellationToken::IsCurrentCancelled()) {
+    // Let the muxers release memory before reading more of the input if the
+    // memory is above the soft limits.
+    MemoryTracker::WaitUntilUnderSoftLimits(
+        base::TimeDelta::FromMilliseconds(kMaxMemoryWaitMs));
+    status = Parse();
+    if (!status.ok())
+      break;
+  }
+  return EndRun(status);
+}
+
+Status Demuxer::StartRun() {
   LOG(INFO) << "Demuxer::Run() on file '" << file_name_ << "'.";
 
   // Start the streams.
-  for (std::vector<MediaStream*>::iterator it = streams_.begin();
-       it != streams_.end();
+  const std::vector<MediaStream*> all_streams = GetAllStreams();
+  for (std::vector<MediaStream*>::const_iterator it = all_streams.begin();
+       it != all_streams.end();
        ++it) {
-    status = (*it)->Start(MediaStream::kPush);
-    if (!status.ok())
+    Status status = (*it)->Start(MediaStream::kPush);
+    if (!status.ok()) {
+      CloseLateStreams(status);
       return status;
+    }
+  }
+  if (late_streams_enabled_) {
+    // The tracks demuxed are fixed from now on, so the late streams reserved
+    // from now on can only join those.
+    std::set<uint32_t> track_ids = GetConsumedTrackIds();
+    base::AutoLock l(late_streams_lock_);
+    late_track_ids_.insert(track_ids.begin(), track_ids.end());
+    late_track_ids_fixed_ = true;
+  }
+  // Let the parser skip the data of the streams which are not consumed, and
+  // merge the samples of the consumed streams.
+  if (!random_access_parsing_) {
+    parser_->SelectTracks(GetConsumedTrackIds());
+    merged_track_ids_ = GetConsumedTrackIds();
+  }
+  slice_status_ = Status::OK;
+  input_wait_ = base::TimeDelta();
+  return Status::OK;
+}
+
+bool Demuxer::RunSlice(base::TimeDelta* wait) {
+  DCHECK(wait);
+  *wait = base::TimeDelta();
+  for (size_t i = 0; i < kMaxParsesPerSlice; ++i) {
+    if (cancelled_ || CancellationToken::IsCurrentCancelled())
+      return false;
+    if (MemoryTracker::IsOverSoftLimit()) {
+      // Let the muxers of the other jobs release memory in the meantime.
+      *wait = base::TimeDelta::FromMilliseconds(kMinInputWaitMs);
+      return true;
+    }
+    input_would_block_ = false;
+    slice_status_ = Parse();
+    if (!slice_status_.ok())
+      return false;
+    if (input_would_block_) {
+      input_wait_ = std::min(
+          std::max(input_wait_ * 2,
+                   base::TimeDelta::FromMilliseconds(kMinInputWaitMs)),
+          base::TimeDelta::FromMilliseconds(kMaxInputWaitMs));
+      *wait = input_wait_;
+      return true;
+    }
+    input_wait_ = base::TimeDelta();
+  }
+  return true;
+}
+
+Status Demuxer::FinishRun() {
+  return EndRun(slice_status_);
+}
+
+std::vector<MediaStream*> Demuxer::GetAllStreams() const {
+  std::vector<MediaStream*> all_streams(streams_);
+  all_streams.insert(all_streams.end(), fan_out_streams_.begin(),
+                     fan_out_streams_.end());
+  return all_streams;
+}
+
+Status Demuxer::EndRun(Status status) {
+  // The reads interrupted by the cancellation of the job fail; report them
+  // as cancelled.
+  if ((cancelled_ || CancellationToken::IsCurrentCancelled()) &&
+      status.error_code() != error::END_OF_STREAM) {
+    status = Status(error::CANCELLED, "Demuxer run cancelled");
   }
 
-  while (!cancelled_ && (status = Parse()).ok())
-    continue;
+  // Push the samples held back for merging.
+  if (status.error_code() == error::END_OF_STREAM && !PushMergedSamples(true))
+    status = Status(error::MUXER_FAILURE, "Failed to push the samples.");
 
-  if (cancelled_ && status.ok())
-    return Status(error::CANCELLED, "Demuxer run cancelled");
+  CloseLateStreams(status.error_code() == error::END_OF_STREAM ? Status::OK
+                                                                : status);
 
+  const std::vector<MediaStream*> all_streams = GetAllStreams();
   if (status.error_code() == error::END_OF_STREAM) {
     // Push EOS sample to muxer to indicate end of stream.
     const scoped_refptr<MediaSample>& sample = MediaSample::CreateEOSBuffer();
-    for (std::vector<MediaStream*>::iterator it = streams_.begin();
-         it != streams_.end();
+    for (std::vector<MediaStream*>::const_iterator it = all_streams.begin();
+         it != all_streams.end();
          ++it) {
       status = (*it)->PushSample(sample);
       if (!status.ok())
-        return status;
+        break;
     }
   }
+
+  // Wait for the samples in flight to be muxed. Muxer errors take precedence
+  // only if demuxing itself succeeded.
+  for (std::vector<MediaStream*>::const_iterator it = all_streams.begin();
+       it != all_streams.end();
+       ++it) {
+    Status stop_status = (*it)->Stop();
+    if (status.ok() && !stop_status.ok())
+      status = stop_status;
+  }
   return status;
 }
 
+uint64_t Demuxer::GetInputCachedSize() {
+  return media_file_ ? media_file_->GetCachedSize() : 0;
+}
+
 Status Demuxer::Parse() {
-  DCHECK(media_file_);
+  DCHECK(media_file_ || mapped_input_);
   DCHECK(parser_);
   DCHECK(buffer_);
 
@@ -213,20 +1168,146 @@ Status Demuxer::Parse() {
   // the initialization.
   if (!init_parsing_status_.ok())
     return init_parsing_status_;
+  if (random_access_parsing_)
+    return ParseRandomAccess();
+  if (clipping_ && clip_ended_track_ids_.size() >= streams_.size()) {
+    // All the streams reached the end of the clip.
+    if (!parser_->Flush())
+      return Status(error::PARSER_FAILURE, "Failed to flush.");
+    return Status(error::END_OF_STREAM, "");
+  }
 
-  int64_t bytes_read = media_file_->Read(buffer_.get(), kBufSize);
+  const uint8_t* data = buffer_->data();
+  int64_t bytes_read;
+  if (mapped_input_) {
+    // Hand the mapped memory over directly; there is nothing to read.
+    data = mapped_input_->data() + mapped_input_position_;
+    bytes_read = std::min(
+        buffer_->size(),
+        static_cast<size_t>(mapped_input_->size() - mapped_input_position_));
+    mapped_input_position_ += bytes_read;
+  } else if (buffered_bytes_ > 0) {
+    // The first bytes of a chunk, read ahead.
+    bytes_read = buffered_bytes_;
+    buffered_bytes_ = 0;
+  } else if (cooperative_) {
+    bytes_read = media_file_->TryRead(buffer_->data(), buffer_->size());
+    if (bytes_read == File::kWouldBlock) {
+      input_would_block_ = true;
+      return Status::OK;
+    }
+  } else {
+    bytes_read = media_file_->Read(buffer_->data(), buffer_->size());
+  }
   if (bytes_read == 0) {
     if (!parser_->Flush())
       return Status(error::PARSER_FAILURE, "Failed to flush.");
-    return Status(error::END_OF_STREAM, "");
+    bool end_of_input = true;
+    if (is_chunked_input()) {
+      Status status = OpenNextChunk(&end_of_input);
+      if (!status.ok())
+        return status;
+    }
+    return end_of_input ? Status(error::END_OF_STREAM, "") : Status::OK;
   } else if (bytes_read < 0) {
-    return Status(error::FILE_FAILURE, "Cannot read file " + file_name_);
+    return Status(error::FILE_FAILURE,
+                  "Cannot read file " + GetChunkFileName(chunk_index_));
+  }
+
+  ScopedStageTimer parse_timer(kParseStage);
+  parse_timer.AddBytes(bytes_read);
+  const base::TimeDelta start_cpu_time = JobResourceUsage::GetThreadCpuTime();
+  sample_cpu_time_ = base::TimeDelta();
+  if (!parser_->Parse(data, bytes_read)) {
+    return Status(error::PARSER_FAILURE,
+                  "Cannot parse media file " + GetChunkFileName(chunk_index_));
+  }
+  const base::TimeDelta max_cpu_time = parser_limits_.max_parse_cpu_time;
+  if (max_cpu_time > base::TimeDelta()) {
+    const base::TimeDelta parse_cpu_time =
+        JobResourceUsage::GetThreadCpuTime() - start_cpu_time -
+        sample_cpu_time_;
+    if (parse_cpu_time > max_cpu_time) {
+      return Status(error::PARSER_FAILURE,
+                    base::StringPrintf(
+                        "Parsing %" PRId64 " bytes of %s took %" PRId64
+                        " ms of CPU time, more than the %" PRId64 " ms "
+                        "allowed.",
+                        bytes_read, GetChunkFileName(chunk_index_).c_str(),
+                        parse_cpu_time.InMilliseconds(),
+                        max_cpu_time.InMilliseconds()));
+    }
+  }
+  return Status::OK;
+}
+
+Status Demuxer::ParseRandomAccess() {
+  if (container_name_ == CONTAINER_WEBM)
+    return ParseWebMRandomAccess();
+
+  mp4::MP4MediaParser* mp4_parser =
+      static_cast<mp4::MP4MediaParser*>(parser_.get());
+  if (!random_access_tracks_selected_) {
+    // Only read the samples of the streams which are consumed.
+    if (!mp4_parser->SelectRandomAccessTracks(GetConsumedTrackIds())) {
+      return Status(error::PARSER_FAILURE,
+                    "Cannot parse media file " + file_name_);
+    }
+    random_access_tracks_selected_ = true;
+  }
+
+  bool end_of_stream = false;
+  {
+    ScopedStageTimer parse_timer(kParseStage);
+    if (!mp4_parser->ReadRandomAccessSamples(kRandomAccessSamplesPerParse,
+                                             &end_of_stream)) {
+      return Status(error::PARSER_FAILURE,
+                    "Cannot parse media file " + file_name_);
+    }
+  }
+  if (end_of_stream) {
+    if (!parser_->Flush())
+      return Status(error::PARSER_FAILURE, "Failed to flush.");
+    return Status(error::END_OF_STREAM, "");
   }
+  return Status::OK;
+}
 
-  return parser_->Parse(buffer_.get(), bytes_read)
-             ? Status::OK
-             : Status(error::PARSER_FAILURE,
-                      "Cannot parse media file " + file_name_);
+Status Demuxer::ParseWebMRandomAccess() {
+  bool end_of_stream = false;
+  {
+    ScopedStageTimer parse_timer(kParseStage);
+    if (!static_cast<WebMMediaParser*>(parser_.get())
+             ->ReadRandomAccessSamples(&end_of_stream)) {
+      return Status(error::PARSER_FAILURE,
+                    "Cannot parse media file " + file_name_);
+    }
+  }
+  if (end_of_stream) {
+    if (!parser_->Flush())
+      return Status(error::PARSER_FAILURE, "Failed to flush.");
+    return Status(error::END_OF_STREAM, "");
+  }
+  return Status::OK;
+}
+
+std::set<uint32_t> Demuxer::GetConsumedTrackIds() const {
+  std::set<uint32_t> track_ids;
+  for (std::vector<MediaStream*>::const_iterator it = streams_.begin();
+       it != streams_.end(); ++it) {
+    if ((*it)->muxer())
+      track_ids.insert((*it)->info()->track_id());
+  }
+  for (std::vector<MediaStream*>::const_iterator it = fan_out_streams_.begin();
+       it != fan_out_streams_.end(); ++it) {
+    if ((*it)->muxer())
+      track_ids.insert((*it)->info()->track_id());
+  }
+  if (late_streams_enabled_) {
+    base::AutoLock l(late_streams_lock_);
+    track_ids.insert(late_track_ids_.begin(), late_track_ids_.end());
+  }
+  return track_ids;
 }
 
 void Demuxer::Cancel() {
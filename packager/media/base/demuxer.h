@@ -8,24 +8,43 @@
 #define MEDIA_BASE_DEMUXER_H_
 
 #include <deque>
+#include <map>
+#include <set>
+#include <string>
 #include <vector>
 
+#include "packager/base/callback.h"
 #include "packager/base/compiler_specific.h"
 #include "packager/base/memory/ref_counted.h"
 #include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/synchronization/condition_variable.h"
+#include "packager/base/synchronization/lock.h"
 #include "packager/media/base/container_names.h"
+#include "packager/media/base/large_buffer.h"
+#include "packager/media/base/media_parser.h"
 #include "packager/media/base/status.h"
 
 namespace edash_packager {
 namespace media {
 
+class CancellationToken;
+class ClosureThread;
 class Decryptor;
 class File;
+class IoThrottle;
+class JobResourceUsage;
 class KeySource;
-class MediaParser;
+class MediaIndex;
 class MediaSample;
 class MediaStream;
+class SampleSpillQueue;
+class SharedBuffer;
 class StreamInfo;
+struct TimedMetadataEvent;
+
+/// Separates the files of an input split in chunks, e.g.
+/// "chunk1.mp4|chunk2.mp4".
+const char kInputChunkSeparator = '|';
 
 /// Demuxer is responsible for extracting elementary stream samples from a
 /// media file, e.g. an ISO BMFF file.
@@ -34,15 +53,106 @@ class Demuxer {
   /// @param file_name specifies the input source. It uses prefix matching to
   ///        create a proper File object. The user can extend File to support
   ///        a custom File object with its own prefix.
+  ///        An input split in chunks, e.g. by an encoder, is either the
+  ///        ordered list of its files separated by kInputChunkSeparator, or a
+  ///        pattern where $Number$ is the number of the chunk, starting from
+  ///        one, which ends at the first missing chunk. The chunks must have
+  ///        the same container and streams, and are demuxed as one timeline:
+  ///        a chunk whose timestamps restart is shifted to the end of the
+  ///        previous chunk. The next chunk is opened in the background while
+  ///        a chunk is demuxed. Chunked inputs are neither memory mapped nor
+  ///        parsed by random access.
   explicit Demuxer(const std::string& file_name);
   ~Demuxer();
 
+  /// Make the Demuxer demux another input, as if it were a new Demuxer of
+  /// @a file_name, but keep its read buffers, which saves allocating and
+  /// faulting them in again, e.g. when packaging many short inputs in turn
+  /// (see DemuxerPool). The streams, and the muxers they are connected to,
+  /// should not be used anymore. The options are back to their defaults.
+  /// Must not be called while the Demuxer runs.
+  /// @param file_name specifies the input source, see Demuxer().
+  void Reset(const std::string& file_name);
+
   /// Set the KeySource for media decryption.
   /// @param key_source points to the source of decryption keys. The key
   ///        source must support fetching of keys for the type of media being
   ///        demuxed.
   void SetKeySource(scoped_ptr<KeySource> key_source);
 
+  /// Read local input files through a memory mapping instead of File reads.
+  /// Parsers which support it work directly on the mapped memory (see
+  /// MediaParser::SetInputBuffer). Falls back to File reads if the input
+  /// cannot be mapped. Must be called before Initialize().
+  void set_memory_mapped_input(bool memory_mapped_input) {
+    memory_mapped_input_ = memory_mapped_input;
+  }
+
+  /// Read non-fragmented MP4 inputs by random access: the samples are read
+  /// by offset using the sample tables, interleaved by decoding time, and
+  /// only for the streams connected to a Muxer. WebM inputs with Cues are
+  /// read from the Cluster containing the start of the time range (see
+  /// SetTimeRange()). Other inputs are streamed as usual. Ignored for memory
+  /// mapped input. Must be called before Initialize().
+  void set_random_access_input(bool random_access_input) {
+    random_access_input_ = random_access_input;
+  }
+
+  /// Follow an input file which is still being written, e.g. a live
+  /// recording, instead of stopping at its end: the Demuxer waits for the
+  /// file to grow until its end marker exists or it stops growing (see
+  /// FollowFile). Only for fragmented MP4, MPEG-2 TS and other inputs
+  /// parsed sequentially; a followed input is neither memory mapped nor
+  /// parsed by random access, nor split in chunks. Must be called before
+  /// Initialize().
+  void set_follow_input(bool follow_input) { follow_input_ = follow_input; }
+
+  /// Read the input without waiting for data which is not available yet, so
+  /// that RunSlice() can yield instead, e.g. to run many live inputs of low
+  /// bitrate on a few threads. Only followed and UDP inputs are read without
+  /// waiting; the others are read as usual. The input is not cached by
+  /// threaded I/O then. Must be called before Initialize().
+  void set_cooperative(bool cooperative) { cooperative_ = cooperative; }
+
+  /// Keep the indexes of the inputs parsed by random access in @a cache_dir,
+  /// see MediaIndexCache, so that an input demuxed again is not parsed
+  /// again: the container, the 'moov' box of ISO BMFF inputs and the key
+  /// frame times of their tracks come from the cache. Empty, the default, for
+  /// no cache. Must be called before Initialize().
+  void set_media_index_cache_dir(const std::string& cache_dir) {
+    media_index_cache_dir_ = cache_dir;
+  }
+
+  /// Parse the input as @a input_format instead of determining the container
+  /// from the first bytes of the input, which may need to wait for more
+  /// data, e.g. on a live input. Must be called before Initialize().
+  void set_input_format(MediaContainerName input_format) {
+    input_format_ = input_format;
+  }
+
+  /// Bound the memory of the samples queued by the Demuxer and its streams,
+  /// e.g. for badly interleaved inputs whose streams are far apart: past
+  /// @a memory_budget bytes of sample data in a queue, the samples are
+  /// spilled to a temporary file and read back sequentially as they are
+  /// dequeued (see SampleSpillQueue). The samples of the tracks are then
+  /// merged in decoding time order however far apart the tracks are in the
+  /// input. Must be called before Initialize().
+  /// @param memory_budget is the budget of each queue, 0 to never spill,
+  ///        which is the default.
+  /// @param temp_dir is the directory of the spill files, or empty for the
+  ///        temporary directory of the system.
+  void SetSampleSpillOptions(uint64_t memory_budget,
+                             const std::string& temp_dir) {
+    spill_memory_budget_ = memory_budget;
+    spill_temp_dir_ = temp_dir;
+  }
+
+  /// Set the budgets of the parser of the input, see MediaParserLimits. The
+  /// parsing fails once one is exceeded. Must be called before Initialize().
+  void set_parser_limits(const MediaParserLimits& parser_limits) {
+    parser_limits_ = parser_limits;
+  }
+
   /// Initialize the Demuxer. Calling other public methods of this class
   /// without this method returning OK, results in an undefined behavior.
   /// This method primes the demuxer by parsing portions of the media file to
@@ -51,9 +161,30 @@ class Demuxer {
   Status Initialize();
 
   /// Drive the remuxing from demuxer side (push). Read the file and push
-  /// the Data to Muxer until Eof.
+  /// the Data to Muxer until Eof. Exits with a CANCELLED status soon after
+  /// the current CancellationToken of the calling thread is cancelled.
   Status Run();
 
+  /// @name Same as Run(), but in slices which return instead of waiting, so
+  ///       that the demuxers of many jobs can share a few threads. Call
+  ///       StartRun(), then RunSlice() until it returns false, then
+  ///       FinishRun(), each on any thread with the CancellationToken of the
+  ///       job.
+  /// @{
+  /// Start the streams.
+  /// @return OK on success. The run is over otherwise.
+  Status StartRun();
+  /// Demux until the input has no data available, the memory is above the
+  /// soft limits, or a bounded number of reads.
+  /// @param[out] wait is the time to wait before the next slice.
+  /// @return true if RunSlice() should be called again, false once the
+  ///         input has been demuxed or on error.
+  bool RunSlice(base::TimeDelta* wait);
+  /// End the run started by StartRun().
+  /// @return the same status as Run().
+  Status FinishRun();
+  /// @}
+
   /// Read from the source and send it to the parser.
   Status Parse();
 
@@ -67,10 +198,119 @@ class Demuxer {
   ///         through MediaStream APIs.
   const std::vector<MediaStream*>& streams() { return streams_; }
 
+  /// Create an additional stream fed with the samples of @a stream, so that
+  /// one demuxed stream can feed several Muxers, e.g. a clear and an
+  /// encrypted rendition, without parsing the input again. Each stream gets
+  /// its own MediaSample, sharing the sample data, which is only copied if a
+  /// Muxer modifies it. The demuxed stream info is shared with @a stream, see
+  /// MediaStream::OverrideLanguage() to change it for one stream only.
+  /// @param stream is one of streams().
+  /// @return the new stream, which is owned by the Demuxer and is not part
+  ///         of streams().
+  MediaStream* CreateFanOutStream(MediaStream* stream);
+
+  /// Only demux the samples within a time range, if the input is parsed by
+  /// random access (see set_random_access_input()). The other samples are
+  /// not read at all. Must be called after Initialize() and before the
+  /// samples are demuxed.
+  /// @param start is the start of the range, inclusive.
+  /// @param end is the end of the range, exclusive, or
+  ///        std::numeric_limits<int64_t>::max() to demux to the end.
+  /// @param timescale is the timescale of @a start and @a end.
+  /// @return OK on success, an error if the input is not parsed by random
+  ///         access.
+  Status SetTimeRange(int64_t start, int64_t end, uint32_t timescale);
+
+  /// Only demux a clip of the input, from the sync sample at or before
+  /// @a start to @a end. Unlike SetTimeRange(), any input can be clipped.
+  /// Inputs parsed by random access seek to the start of the clip, through the
+  /// sample tables of MP4 inputs or the Cues of WebM inputs. Other inputs are
+  /// parsed from the beginning, dropping the samples before the clip, and the
+  /// parsing stops at the end of the clip. Must be called after Initialize()
+  /// and before the samples are demuxed.
+  /// @param start is the start of the clip.
+  /// @param end is the end of the clip, exclusive, or
+  ///        std::numeric_limits<int64_t>::max() to demux to the end.
+  /// @param timescale is the timescale of @a start and @a end.
+  /// @return OK on success.
+  Status SetClipRange(int64_t start, int64_t end, uint32_t timescale);
+
+  /// Gets the decoding times of the key frames of a stream, if the input is
+  /// parsed by random access. Must be called after Initialize().
+  /// @param track_id is the track id of the stream.
+  /// @param[out] key_frame_times receives the decoding times, in the
+  ///             timescale of the stream.
+  /// @return OK on success, an error if the input is not parsed by random
+  ///         access or is a WebM input.
+  Status GetKeyFrameTimes(uint32_t track_id,
+                          std::vector<int64_t>* key_frame_times);
+
+  /// @return Streams created with CreateFanOutStream().
+  const std::vector<MediaStream*>& fan_out_streams() {
+    return fan_out_streams_;
+  }
+
+  /// @name Late streams.
+  /// Late streams join the Demuxer while it runs in another thread, e.g.
+  /// the streams of another job packaging the same input concurrently, so
+  /// that the input is demuxed once. The samples pushed before they join are
+  /// replayed to them from a bounded replay buffer, so that they get the
+  /// whole input.
+  /// @{
+
+  /// Called on the thread running the Demuxer once late streams have ended,
+  /// with the status of their muxers.
+  typedef base::Callback<void(Status)> LateStreamsDoneCB;
+
+  /// Accept late streams, and keep the first samples pushed, up to
+  /// @a max_replay_bytes of sample data, to replay them to the late streams.
+  /// Late streams cannot join anymore once the replay buffer overflows. Must
+  /// be called before Run().
+  void EnableLateStreams(uint64_t max_replay_bytes);
+
+  /// Reserve the joining of late streams of the tracks @a track_ids. The
+  /// replay buffer is kept, even past its budget, until the late streams
+  /// are started with StartLateStreams(), or the reservation is cancelled
+  /// with CancelLateStreamsReservation(). Thread safe.
+  /// @return false if late streams cannot join anymore: the replay buffer
+  ///         has overflowed, the Demuxer has ended, or one of the tracks is
+  ///         not demuxed.
+  bool ReserveLateStreams(const std::set<uint32_t>& track_ids);
+
+  /// Create a stream fed with the samples of @a stream, like
+  /// CreateFanOutStream(), which is started as a late stream. Thread safe.
+  /// @param stream is one of streams(), of a reserved track.
+  /// @return the new stream, which is owned by the Demuxer.
+  MediaStream* CreateLateStream(MediaStream* stream);
+
+  /// Start the late streams @a streams, which are connected to their
+  /// muxers, and consume the reservation made for them. The thread running
+  /// the Demuxer replays the samples kept to them, then pushes them the next
+  /// samples, with the current CancellationToken, IoThrottle and
+  /// JobResourceUsage of the calling thread. The streams end early if the
+  /// token is cancelled, without failing the Demuxer. Thread safe.
+  /// @param done_callback is run once the streams have ended.
+  void StartLateStreams(const std::vector<MediaStream*>& streams,
+                        const LateStreamsDoneCB& done_callback);
+
+  /// Cancel a reservation made with ReserveLateStreams(). Thread safe.
+  void CancelLateStreamsReservation();
+
+  /// Stop accepting late streams, and end those which have not ended with
+  /// @a status. Called by Run() once it ends, after the late streams
+  /// reserved have started. Should be called by the owner of a Demuxer
+  /// which accepts late streams but is not run.
+  void CloseLateStreams(const Status& status);
+  /// @}
+
   /// @return Container name (type). Value is CONTAINER_UNKNOWN if the demuxer
   ///         is not initialized.
   MediaContainerName container_name() { return container_name_; }
 
+  /// @return Number of input bytes read ahead and not parsed yet, e.g. in the
+  ///         cache of a live input. Can be called from any thread.
+  uint64_t GetInputCachedSize();
+
  private:
   struct QueuedSample {
     QueuedSample(uint32_t track_id, scoped_refptr<MediaSample> sample);
@@ -80,29 +320,217 @@ class Demuxer {
     scoped_refptr<MediaSample> sample;
   };
 
+  // Late streams started together, with the context of the thread which
+  // started them.
+  struct LateStreams {
+    LateStreams();
+    ~LateStreams();
+
+    std::vector<MediaStream*> streams;
+    LateStreamsDoneCB done_callback;
+    scoped_refptr<CancellationToken> cancellation_token;
+    scoped_refptr<IoThrottle> io_throttle;
+    scoped_refptr<JobResourceUsage> resource_usage;
+  };
+
+  // Returns the streams of the Demuxer and the fan out streams.
+  std::vector<MediaStream*> GetAllStreams() const;
+  // Ends a run whose demuxing ended with |status|. Returns the status of the
+  // run.
+  Status EndRun(Status status);
+  // Closes the input and deletes the streams and the parser.
+  void CloseInput();
   // Parser init event.
   void ParserInitEvent(const std::vector<scoped_refptr<StreamInfo> >& streams);
   // Parser new sample event handler. Queues the samples if init event has not
-  // been received, otherwise calls PushSample() to push the sample to
-  // corresponding stream.
+  // been received, otherwise merges the samples of the tracks in decoding
+  // time order, see PushMergedSamples(), before pushing them to the
+  // corresponding streams.
   bool NewSampleEvent(uint32_t track_id,
                       const scoped_refptr<MediaSample>& sample);
+  bool HandleNewSample(uint32_t track_id,
+                       const scoped_refptr<MediaSample>& sample);
+  // Parser timed metadata event handler. Passes the event to all the
+  // streams, on the side of their samples.
+  void NewTimedMetadataEvent(const TimedMetadataEvent& event);
+  // Pushes the queued samples in decoding time order across the tracks. The
+  // samples are held back while a track of |merged_track_ids_| has no queued
+  // sample, until a track has too many queued samples, so that the muxers of
+  // badly interleaved inputs make progress together with bounded memory.
+  // Pushes all the queued samples if |flush|.
+  bool PushMergedSamples(bool flush);
   // Helper function to push the sample to corresponding stream.
   bool PushSample(uint32_t track_id, const scoped_refptr<MediaSample>& sample);
+  // Pushes the sample if it is in the clip set by SetClipRange(), if any.
+  bool PushClipSample(uint32_t track_id,
+                      const scoped_refptr<MediaSample>& sample);
+  // Returns the stream with |track_id| in |streams_|, or NULL.
+  MediaStream* FindStream(uint32_t track_id) const;
+  // Reads the next samples by random access when |random_access_parsing_|.
+  Status ParseRandomAccess();
+  // Reads the next Clusters of a WebM input by random access.
+  Status ParseWebMRandomAccess();
+  // Returns the track ids of the streams which are connected to a muxer,
+  // including the late streams.
+  std::set<uint32_t> GetConsumedTrackIds() const;
+  // Pushes |sample| to the late streams, after replaying the samples kept to
+  // the late streams started since the last sample, and keeps it in the
+  // replay buffer if there is room.
+  void PushLateSample(uint32_t track_id,
+                      const scoped_refptr<MediaSample>& sample);
+  // Starts the late streams started since the last call, replaying the
+  // samples kept to them.
+  void StartPendingLateStreams();
+  // Ends and deletes |late_streams| with |status|, which is updated with the
+  // status of their muxers. The streams get an EOS sample if |status| is OK.
+  void EndLateStreams(LateStreams* late_streams, Status status);
+  // Creates |parser_| for |container_name_|.
+  Status CreateParser();
+  // Stores the index of the ISO BMFF input parsed by random access, whose
+  // 'moov' box at |moov_offset| is |moov|, in the cache, and keeps it in
+  // |media_index_|.
+  void StoreMediaIndex(uint64_t moov_offset, const std::vector<uint8_t>& moov);
+  // Returns the name of the chunk at |chunk_index|, or an empty string if the
+  // input has no such chunk.
+  std::string GetChunkFileName(uint32_t chunk_index) const;
+  bool is_chunked_input() const {
+    return !chunk_pattern_.empty() || chunk_file_names_.size() > 1;
+  }
+  // Opens the chunk after the current one and reads its first bytes. Runs on
+  // |chunk_read_ahead_thread_|.
+  void ReadAheadNextChunk(const std::string& chunk_file_name);
+  // Starts reading ahead the chunk after the current one, if any.
+  void StartChunkReadAhead();
+  // Switches to the chunk read ahead, if any. Sets |end_of_input| if the
+  // current chunk is the last one.
+  Status OpenNextChunk(bool* end_of_input);
+  // Init event of the chunks after the first one, whose streams should
+  // match |streams_|.
+  void ChunkInitEvent(const std::vector<scoped_refptr<StreamInfo> >& streams);
+  // Returns the queue of |track_id| in |queued_samples_|, created on demand.
+  SampleSpillQueue* GetSampleQueue(uint32_t track_id);
+  // Shifts the timestamps of |sample| so that the chunks are continuous.
+  void AdjustChunkTimestamps(uint32_t track_id,
+                             const scoped_refptr<MediaSample>& sample);
 
   std::string file_name_;
   File* media_file_;
   bool init_event_received_;
   Status init_parsing_status_;
-  // Queued samples received in NewSampleEvent() before ParserInitEvent().
-  std::deque<QueuedSample> queued_samples_;
+  // Queued samples received in NewSampleEvent(), by track id, which are
+  // merged by PushMergedSamples(). Owned.
+  std::map<uint32_t, SampleSpillQueue*> queued_samples_;
+  MediaParserLimits parser_limits_;
+  // The CPU time spent processing the samples emitted by the current
+  // MediaParser::Parse() call, which is not part of the parse time.
+  base::TimeDelta sample_cpu_time_;
+  // Set by SetSampleSpillOptions().
+  uint64_t spill_memory_budget_;
+  std::string spill_temp_dir_;
+  // The tracks whose samples are merged, i.e. the consumed tracks once Run()
+  // has started, unless the input is parsed by random access: the samples
+  // are then read in decoding time order already.
+  std::set<uint32_t> merged_track_ids_;
   scoped_ptr<MediaParser> parser_;
   std::vector<MediaStream*> streams_;
+  std::vector<MediaStream*> fan_out_streams_;
+  // The container of the input if it is known in advance.
+  MediaContainerName input_format_;
   MediaContainerName container_name_;
-  scoped_ptr<uint8_t[]> buffer_;
+  scoped_ptr<LargeBuffer> buffer_;
+  bool memory_mapped_input_;
+  // The mapped input file, if the input is memory mapped.
+  scoped_refptr<SharedBuffer> mapped_input_;
+  // The position of the next byte of |mapped_input_| to parse.
+  uint64_t mapped_input_position_;
+  bool random_access_input_;
+  // Set by set_media_index_cache_dir().
+  std::string media_index_cache_dir_;
+  // The index of the input, from the cache or stored in it, without its
+  // 'moov' box. NULL if the input is not indexed.
+  scoped_ptr<MediaIndex> media_index_;
+  bool follow_input_;
+  bool cooperative_;
+  // Set by Parse() if the input had no data available, in cooperative mode.
+  bool input_would_block_;
+  // The status of the slices run so far.
+  Status slice_status_;
+  // The wait before the next slice while the input has no data available,
+  // which backs off.
+  base::TimeDelta input_wait_;
+  // True if the input is parsed by random access.
+  bool random_access_parsing_;
+  bool random_access_tracks_selected_;
+  // The clip set by SetClipRange(), in |clip_timescale_|, if the samples are
+  // clipped by the Demuxer, i.e. if the input is not parsed by random access.
+  bool clipping_;
+  int64_t clip_start_;
+  int64_t clip_end_;
+  uint32_t clip_timescale_;
+  bool clip_started_;
+  // The track whose sync samples start the clip.
+  uint32_t clip_sync_track_id_;
+  // The samples since the last sync sample before the start of the clip.
+  std::deque<QueuedSample> clip_pending_samples_;
+  // The tracks whose samples reached the end of the clip.
+  std::set<uint32_t> clip_ended_track_ids_;
   scoped_ptr<KeySource> key_source_;
   bool cancelled_;
 
+  // Set by EnableLateStreams().
+  bool late_streams_enabled_;
+  uint64_t max_replay_bytes_;
+  // The samples kept for the late streams, if the replay buffer has not
+  // overflowed. Only accessed by the thread running the Demuxer.
+  std::deque<QueuedSample> replay_samples_;
+  uint64_t replay_bytes_;
+  // The late streams running. Only accessed by the thread running the
+  // Demuxer. Owned.
+  std::vector<LateStreams*> running_late_streams_;
+  // Lock protecting the variables below.
+  mutable base::Lock late_streams_lock_;
+  // Signalled when a reservation is consumed or cancelled.
+  base::ConditionVariable late_streams_condition_;
+  // Set by the thread running the Demuxer only.
+  bool replay_overflowed_;
+  bool late_streams_closed_;
+  // The status the late streams were closed with.
+  Status late_streams_status_;
+  size_t num_late_reservations_;
+  // The tracks of the late streams, which are demuxed too. Fixed once Run()
+  // starts, when it is extended to all the tracks demuxed.
+  std::set<uint32_t> late_track_ids_;
+  bool late_track_ids_fixed_;
+  // The late streams started and not yet started by the thread running the
+  // Demuxer. Owned.
+  std::vector<LateStreams*> started_late_streams_;
+  // Owned.
+  std::vector<MediaStream*> late_streams_;
+
+  // The files of the input, one per chunk if the input is split in chunks.
+  // Empty if the chunks are given by |chunk_pattern_|.
+  std::vector<std::string> chunk_file_names_;
+  // The name of the chunks, with $Number$ substituted by the chunk number.
+  std::string chunk_pattern_;
+  // The index of the chunk being demuxed.
+  uint32_t chunk_index_;
+  // Opens the next chunk in the background, in |next_chunk_file_|, and reads
+  // its first |next_chunk_bytes_read_| bytes in |next_chunk_buffer_|.
+  scoped_ptr<ClosureThread> chunk_read_ahead_thread_;
+  File* next_chunk_file_;
+  scoped_ptr<LargeBuffer> next_chunk_buffer_;
+  int64_t next_chunk_bytes_read_;
+  // The bytes of |buffer_| read ahead and not parsed yet.
+  int64_t buffered_bytes_;
+  // The offset added to the timestamps of the current chunk, in
+  // |timeline_timescale_|, once known.
+  bool chunk_offset_set_;
+  int64_t chunk_offset_;
+  // The end of the samples demuxed so far, in |timeline_timescale_|, which
+  // is the timescale of the first stream.
+  int64_t timeline_end_;
+  uint32_t timeline_timescale_;
+
   DISALLOW_COPY_AND_ASSIGN(Demuxer);
 };
 
@@ -0,0 +1,54 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/demuxer_pool.h"
+
+#include "packager/base/stl_util.h"
+#include "packager/media/base/demuxer.h"
+
+namespace edash_packager {
+namespace media {
+
+DemuxerPool::DemuxerPool(size_t max_idle_demuxers)
+    : max_idle_demuxers_(max_idle_demuxers) {}
+
+DemuxerPool::~DemuxerPool() {
+  STLDeleteElements(&idle_demuxers_);
+}
+
+scoped_ptr<Demuxer> DemuxerPool::Acquire(const std::string& file_name) {
+  scoped_ptr<Demuxer> demuxer;
+  {
+    base::AutoLock l(lock_);
+    if (!idle_demuxers_.empty()) {
+      demuxer.reset(idle_demuxers_.back());
+      idle_demuxers_.pop_back();
+    }
+  }
+  if (!demuxer)
+    return scoped_ptr<Demuxer>(new Demuxer(file_name));
+  demuxer->Reset(file_name);
+  return demuxer.Pass();
+}
+
+void DemuxerPool::Release(scoped_ptr<Demuxer> demuxer) {
+  if (!demuxer)
+    return;
+  // Closes the input and frees the streams and the queued samples now rather
+  // than when the Demuxer is reused.
+  demuxer->Reset(std::string());
+  base::AutoLock l(lock_);
+  if (idle_demuxers_.size() < max_idle_demuxers_)
+    idle_demuxers_.push_back(demuxer.release());
+}
+
+size_t DemuxerPool::num_idle_demuxers() const {
+  base::AutoLock l(lock_);
+  return idle_demuxers_.size();
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,59 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_BASE_DEMUXER_POOL_H_
+#define MEDIA_BASE_DEMUXER_POOL_H_
+
+#include <string>
+#include <vector>
+
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/synchronization/lock.h"
+
+namespace edash_packager {
+namespace media {
+
+class Demuxer;
+
+/// Keeps the Demuxers of the completed jobs, with their read buffers, and
+/// reuses them for the next inputs through Demuxer::Reset(), so that a
+/// service packaging many short inputs does not allocate the buffers of
+/// every input anew.
+///
+/// Thread Safety: Thread safe.
+class DemuxerPool {
+ public:
+  /// @param max_idle_demuxers is the maximum number of Demuxers kept for
+  ///        reuse. The Demuxers released past it are deleted.
+  explicit DemuxerPool(size_t max_idle_demuxers);
+  ~DemuxerPool();
+
+  /// @param file_name specifies the input source, see Demuxer::Demuxer().
+  /// @return a Demuxer of @a file_name, reset from an idle one if any.
+  scoped_ptr<Demuxer> Acquire(const std::string& file_name);
+
+  /// Close the input of @a demuxer and keep it for reuse. The streams of
+  /// @a demuxer are deleted, so the muxers connected to them should be
+  /// deleted first.
+  /// @param demuxer is the Demuxer to release. Can be NULL.
+  void Release(scoped_ptr<Demuxer> demuxer);
+
+  /// @return the number of Demuxers kept for reuse.
+  size_t num_idle_demuxers() const;
+
+ private:
+  const size_t max_idle_demuxers_;
+  mutable base::Lock lock_;
+  // Owned.
+  std::vector<Demuxer*> idle_demuxers_;
+
+  DISALLOW_COPY_AND_ASSIGN(DemuxerPool);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_BASE_DEMUXER_POOL_H_
@@ -0,0 +1,56 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+
+#include "packager/media/base/demuxer.h"
+#include "packager/media/base/demuxer_pool.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+const char kInput1[] = "input1.mp4";
+const char kInput2[] = "input2.mp4";
+const size_t kMaxIdleDemuxers = 2;
+}  // namespace
+
+TEST(DemuxerPoolTest, ReusesReleasedDemuxers) {
+  DemuxerPool pool(kMaxIdleDemuxers);
+  scoped_ptr<Demuxer> demuxer = pool.Acquire(kInput1);
+  ASSERT_TRUE(demuxer);
+  Demuxer* released_demuxer = demuxer.get();
+  pool.Release(demuxer.Pass());
+  EXPECT_EQ(1u, pool.num_idle_demuxers());
+
+  demuxer = pool.Acquire(kInput2);
+  EXPECT_EQ(released_demuxer, demuxer.get());
+  EXPECT_EQ(0u, pool.num_idle_demuxers());
+  EXPECT_EQ(CONTAINER_UNKNOWN, demuxer->container_name());
+  EXPECT_TRUE(demuxer->streams().empty());
+}
+
+TEST(DemuxerPoolTest, CreatesDemuxersWhenEmpty) {
+  DemuxerPool pool(kMaxIdleDemuxers);
+  scoped_ptr<Demuxer> demuxer1 = pool.Acquire(kInput1);
+  scoped_ptr<Demuxer> demuxer2 = pool.Acquire(kInput2);
+  ASSERT_TRUE(demuxer1);
+  ASSERT_TRUE(demuxer2);
+  EXPECT_NE(demuxer1.get(), demuxer2.get());
+}
+
+TEST(DemuxerPoolTest, KeepsAtMostMaxIdleDemuxers) {
+  DemuxerPool pool(kMaxIdleDemuxers);
+  for (size_t i = 0; i < kMaxIdleDemuxers + 1; ++i)
+    pool.Release(scoped_ptr<Demuxer>(new Demuxer(kInput1)));
+  EXPECT_EQ(kMaxIdleDemuxers, pool.num_idle_demuxers());
+
+  pool.Release(scoped_ptr<Demuxer>());
+  EXPECT_EQ(kMaxIdleDemuxers, pool.num_idle_demuxers());
+}
+
+}  // namespace media
+}  // namespace edash_packager
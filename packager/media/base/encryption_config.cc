@@ -0,0 +1,21 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/encryption_config.h"
+
+namespace edash_packager {
+namespace media {
+
+EncryptionConfig::EncryptionConfig()
+    : protection_scheme(FOURCC_NULL),
+      crypt_byte_block(0),
+      skip_byte_block(0),
+      per_sample_iv_size(0) {}
+
+EncryptionConfig::~EncryptionConfig() {}
+
+}  // namespace media
+}  // namespace edash_packager
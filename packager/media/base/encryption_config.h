@@ -0,0 +1,46 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_BASE_ENCRYPTION_CONFIG_H_
+#define MEDIA_BASE_ENCRYPTION_CONFIG_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "packager/media/base/fourccs.h"
+#include "packager/media/base/protection_system_specific_info.h"
+
+namespace edash_packager {
+namespace media {
+
+/// The encryption of a stream which is still encrypted, e.g. the Common
+/// Encryption parameters of an encrypted MP4 track remuxed without being
+/// decrypted. The muxer writes them unchanged, with the per-sample
+/// parameters of MediaSample::passthrough_decrypt_config().
+struct EncryptionConfig {
+  EncryptionConfig();
+  ~EncryptionConfig();
+
+  /// The protection scheme: 'cenc', 'cens', 'cbc1' or 'cbcs'.
+  FourCC protection_scheme;
+  /// The pattern of pattern-based protection schemes, 'cens' and 'cbcs'.
+  uint8_t crypt_byte_block;
+  uint8_t skip_byte_block;
+  /// The size of the per-sample IVs, 0 if @a constant_iv is used instead.
+  uint8_t per_sample_iv_size;
+  std::vector<uint8_t> constant_iv;
+  /// The default key ID.
+  std::vector<uint8_t> key_id;
+  /// The protection system specific information, i.e. the PSSH boxes, of
+  /// the input.
+  std::vector<ProtectionSystemSpecificInfo> key_system_info;
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_BASE_ENCRYPTION_CONFIG_H_
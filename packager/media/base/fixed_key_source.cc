@@ -138,7 +138,12 @@ scoped_ptr<FixedKeySource> FixedKeySource::CreateFromHexStrings(
 
 FixedKeySource::FixedKeySource() {}
 FixedKeySource::FixedKeySource(scoped_ptr<EncryptionKey> key)
-    : encryption_key_(key.Pass()) {}
+    : encryption_key_(key.Pass()) {
+  // The key, with its PSSH boxes, is copied for every track of the job, so
+  // the boxes are serialized once here rather than in every muxer.
+  for (ProtectionSystemSpecificInfo& info : encryption_key_->key_system_info)
+    info.CacheBox();
+}
 
 }  // namespace media
 }  // namespace edash_packager
@@ -0,0 +1,40 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+//
+// Debug checks and verbose logging of the code running per sample or per
+// byte, e.g. the sample accessors and the byte readers and writers. They are
+// DCHECK and VLOG, except in the max performance build
+// (packager_max_performance=1 in GYP_DEFINES), which compiles them out even
+// with dcheck_always_on. Error handling, e.g. RCHECK, is not affected.
+
+#ifndef MEDIA_BASE_HOT_PATH_H_
+#define MEDIA_BASE_HOT_PATH_H_
+
+#include "packager/base/logging.h"
+
+#if defined(PACKAGER_MAX_PERFORMANCE)
+
+// The arguments are still compiled, so that they do not trigger unused
+// variable warnings, but never evaluated.
+#define HOT_DCHECK(condition) EAT_STREAM_PARAMETERS << !(condition)
+#define HOT_DCHECK_EQ(val1, val2) HOT_DCHECK((val1) == (val2))
+#define HOT_DCHECK_NE(val1, val2) HOT_DCHECK((val1) != (val2))
+#define HOT_DCHECK_LE(val1, val2) HOT_DCHECK((val1) <= (val2))
+#define HOT_DCHECK_GE(val1, val2) HOT_DCHECK((val1) >= (val2))
+#define HOT_VLOG(verbose_level) EAT_STREAM_PARAMETERS
+
+#else
+
+#define HOT_DCHECK(condition) DCHECK(condition)
+#define HOT_DCHECK_EQ(val1, val2) DCHECK_EQ(val1, val2)
+#define HOT_DCHECK_NE(val1, val2) DCHECK_NE(val1, val2)
+#define HOT_DCHECK_LE(val1, val2) DCHECK_LE(val1, val2)
+#define HOT_DCHECK_GE(val1, val2) DCHECK_GE(val1, val2)
+#define HOT_VLOG(verbose_level) VLOG(verbose_level)
+
+#endif  // defined(PACKAGER_MAX_PERFORMANCE)
+
+#endif  // MEDIA_BASE_HOT_PATH_H_
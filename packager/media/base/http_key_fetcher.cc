@@ -7,32 +7,26 @@
 #include "packager/media/base/http_key_fetcher.h"
 
 #include <curl/curl.h>
+#include <gflags/gflags.h>
+
+#include <vector>
 
 #include "packager/base/logging.h"
 #include "packager/base/strings/stringprintf.h"
 #include "packager/base/synchronization/lock.h"
+#include "packager/media/base/cancellation_token.h"
+#include "packager/media/base/curl_share.h"
+
+DEFINE_bool(enable_http2_key_requests,
+            false,
+            "Set to true to negotiate HTTP/2 for key requests over https. "
+            "Falls back to HTTP/1.1 if the server does not support it.");
 
 namespace edash_packager {
 
 namespace {
 const char kUserAgentString[] = "edash-packager-http_fetcher/1.0";
 
-// Scoped CURL implementation which cleans up itself when goes out of scope.
-class ScopedCurl {
- public:
-  ScopedCurl() { ptr_ = curl_easy_init(); }
-  ~ScopedCurl() {
-    if (ptr_)
-      curl_easy_cleanup(ptr_);
-  }
-
-  CURL* get() { return ptr_; }
-
- private:
-  CURL* ptr_;
-  DISALLOW_COPY_AND_ASSIGN(ScopedCurl);
-};
-
 size_t AppendToString(char* ptr, size_t size, size_t nmemb, std::string* response) {
   DCHECK(ptr);
   DCHECK(response);
@@ -41,39 +35,76 @@ size_t AppendToString(char* ptr, size_t size, size_t nmemb, std::string* respons
   return total_size;
 }
 
-class LibCurlInitializer {
+// Aborts the transfer once |token| is cancelled. libcurl calls it at least
+// once per second, and more often while data is transferred.
+#if LIBCURL_VERSION_NUM >= 0x072000
+int AbortIfCancelled(void* token,
+                     curl_off_t /* dltotal */,
+                     curl_off_t /* dlnow */,
+                     curl_off_t /* ultotal */,
+                     curl_off_t /* ulnow */) {
+#else
+int AbortIfCancelled(void* token,
+                     double /* dltotal */,
+                     double /* dlnow */,
+                     double /* ultotal */,
+                     double /* ulnow */) {
+#endif
+  return static_cast<media::CancellationToken*>(token)->IsCancelled() ? 1 : 0;
+}
+
+}  // namespace
+
+namespace media {
+
+// Keeps the idle curl handles of a fetcher. A handle holds on to its
+// connections, so they are reused by the next request made with it.
+class HttpKeyFetcher::CurlHandlePool {
  public:
-  LibCurlInitializer() : initialized_(false) {
-    base::AutoLock lock(lock_);
-    if (!initialized_) {
-      curl_global_init(CURL_GLOBAL_DEFAULT);
-      initialized_ = true;
+  CurlHandlePool() {}
+  ~CurlHandlePool() {
+    for (CURL* curl : idle_handles_)
+      curl_easy_cleanup(curl);
+  }
+
+  // Returns an idle handle, reset to the default options, or a new handle if
+  // there is none. Returns NULL on failure.
+  CURL* Acquire() {
+    CURL* curl = NULL;
+    {
+      base::AutoLock lock(lock_);
+      if (!idle_handles_.empty()) {
+        curl = idle_handles_.back();
+        idle_handles_.pop_back();
+      }
     }
+    if (curl) {
+      // Keeps the live connections and the caches.
+      curl_easy_reset(curl);
+    } else {
+      curl = curl_easy_init();
+    }
+    return curl;
   }
 
-  ~LibCurlInitializer() {
+  void Release(CURL* curl) {
     base::AutoLock lock(lock_);
-    if (initialized_) {
-      curl_global_cleanup();
-      initialized_ = false;
-    }
+    idle_handles_.push_back(curl);
   }
 
  private:
   base::Lock lock_;
-  bool initialized_;
+  std::vector<CURL*> idle_handles_;
 
-  DISALLOW_COPY_AND_ASSIGN(LibCurlInitializer);
+  DISALLOW_COPY_AND_ASSIGN(CurlHandlePool);
 };
 
-}  // namespace
-
-namespace media {
-
-HttpKeyFetcher::HttpKeyFetcher() : timeout_in_seconds_(0) {}
+HttpKeyFetcher::HttpKeyFetcher()
+    : timeout_in_seconds_(0), handle_pool_(new CurlHandlePool) {}
 
 HttpKeyFetcher::HttpKeyFetcher(uint32_t timeout_in_seconds)
-    : timeout_in_seconds_(timeout_in_seconds) {}
+    : timeout_in_seconds_(timeout_in_seconds),
+      handle_pool_(new CurlHandlePool) {}
 
 HttpKeyFetcher::~HttpKeyFetcher() {}
 
@@ -99,16 +130,22 @@ Status HttpKeyFetcher::FetchInternal(HttpMethod method,
                                      std::string* response) {
   DCHECK(method == GET || method == POST);
 
-  static LibCurlInitializer lib_curl_initializer;
+  CURLSH* curl_share = GetCurlShare();
 
-  ScopedCurl scoped_curl;
-  CURL* curl = scoped_curl.get();
+  CURL* curl = handle_pool_->Acquire();
   if (!curl) {
     LOG(ERROR) << "curl_easy_init() failed.";
     return Status(error::HTTP_FAILURE, "curl_easy_init() failed.");
   }
   response->clear();
 
+  if (curl_share)
+    curl_easy_setopt(curl, CURLOPT_SHARE, curl_share);
+  curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+#ifdef CURL_HTTP_VERSION_2TLS
+  if (FLAGS_enable_http2_key_requests)
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+#endif
   curl_easy_setopt(curl, CURLOPT_URL, path.c_str());
   curl_easy_setopt(curl, CURLOPT_USERAGENT, kUserAgentString);
   curl_easy_setopt(curl, CURLOPT_TIMEOUT, timeout_in_seconds_);
@@ -120,17 +157,33 @@ Status HttpKeyFetcher::FetchInternal(HttpMethod method,
     curl_easy_setopt(curl, CURLOPT_POSTFIELDS, data.c_str());
     curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, data.size());
   }
+  // The fetches made for a job are aborted when the job is cancelled.
+  CancellationToken* cancellation_token = CancellationToken::Current();
+  if (cancellation_token) {
+    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+#if LIBCURL_VERSION_NUM >= 0x072000
+    curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, AbortIfCancelled);
+    curl_easy_setopt(curl, CURLOPT_XFERINFODATA, cancellation_token);
+#else
+    curl_easy_setopt(curl, CURLOPT_PROGRESSFUNCTION, AbortIfCancelled);
+    curl_easy_setopt(curl, CURLOPT_PROGRESSDATA, cancellation_token);
+#endif
+  }
+
+  const CURLcode res = curl_easy_perform(curl);
+  long response_code = 0;
+  if (res == CURLE_HTTP_RETURNED_ERROR)
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+  handle_pool_->Release(curl);
 
-  CURLcode res = curl_easy_perform(curl);
   if (res != CURLE_OK) {
     std::string error_message = base::StringPrintf(
         "curl_easy_perform() failed: %s.", curl_easy_strerror(res));
-    if (res == CURLE_HTTP_RETURNED_ERROR) {
-      long response_code = 0;
-      curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+    if (res == CURLE_HTTP_RETURNED_ERROR)
       error_message += base::StringPrintf(" Response code: %ld.", response_code);
-    }
 
+    if (res == CURLE_ABORTED_BY_CALLBACK)
+      return Status(error::CANCELLED, error_message);
     LOG(ERROR) << error_message;
     return Status(
         res == CURLE_OPERATION_TIMEDOUT ? error::TIME_OUT : error::HTTP_FAILURE,
@@ -12,6 +12,7 @@
 #define MEDIA_BASE_HTTP_KEY_FETCHER_H_
 
 #include "packager/base/compiler_specific.h"
+#include "packager/base/memory/scoped_ptr.h"
 #include "packager/media/base/key_fetcher.h"
 #include "packager/media/base/status.h"
 
@@ -19,6 +20,10 @@ namespace edash_packager {
 namespace media {
 
 /// A KeyFetcher implementation that retrieves keys over HTTP(s).
+/// Connections are kept alive and reused across requests. The DNS cache, the
+/// TLS sessions and, with libcurl 7.57 or later, the connections are shared
+/// by all the fetchers in the process. Requests made concurrently from
+/// different threads use different connections.
 /// This class is not fully thread safe. It can be used in multi-thread
 /// environment once constructed, but it may not be safe to create a
 /// HttpKeyFetcher object when any other thread is running due to use of
@@ -60,11 +65,15 @@ class HttpKeyFetcher : public KeyFetcher {
     PUT
   };
 
+  class CurlHandlePool;
+
   // Internal implementation of HTTP functions, e.g. Get and Post.
   Status FetchInternal(HttpMethod method, const std::string& url,
                        const std::string& data, std::string* response);
 
   const uint32_t timeout_in_seconds_;
+  // Idle curl handles, which keep their connections alive.
+  scoped_ptr<CurlHandlePool> handle_pool_;
 
   DISALLOW_COPY_AND_ASSIGN(HttpKeyFetcher);
 };
@@ -61,6 +61,16 @@ TEST(DISABLED_HttpKeyFetcherTest, HttpFetchKeys) {
   EXPECT_EQ(kExpectedPostResponse, response);
 }
 
+TEST(DISABLED_HttpKeyFetcherTest, ReuseFetcher) {
+  // The second request reuses the connection of the first one.
+  HttpKeyFetcher fetcher;
+  std::string response;
+  ASSERT_OK(fetcher.Get(kTestUrl, &response));
+  ASSERT_OK(fetcher.FetchKeys(kTestUrl, kPostData, &response));
+  base::RemoveChars(response, "\r\n\t ", &response);
+  EXPECT_EQ(kExpectedPostResponse, response);
+}
+
 TEST(DISABLED_HttpKeyFetcherTest, InvalidUrl) {
   const char kHttpNotFound[] = "404";
   HttpKeyFetcher fetcher;
@@ -0,0 +1,211 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/io_throttle.h"
+
+#include <algorithm>
+
+#include "packager/base/atomicops.h"
+#include "packager/base/lazy_instance.h"
+#include "packager/base/logging.h"
+#include "packager/base/strings/string_number_conversions.h"
+#include "packager/base/threading/platform_thread.h"
+#include "packager/base/threading/thread_local.h"
+#include "packager/media/base/cancellation_token.h"
+
+namespace edash_packager {
+namespace media {
+
+using base::subtle::AtomicWord;
+
+namespace {
+
+// The budget which accumulates while there is no I/O, i.e. the burst, in
+// seconds of the rate.
+const double kBurstSeconds = 0.1;
+
+const char* const kPriorityNames[] = {"live", "batch"};
+COMPILE_ASSERT(arraysize(kPriorityNames) == kNumIoPriorities,
+               priority_names_do_not_match_priorities);
+
+// The host budget, shared by all the jobs.
+struct HostBudget {
+  base::Lock lock;
+  IoTokenBucket bucket;
+};
+
+base::LazyInstance<HostBudget>::Leaky g_host_budget =
+    LAZY_INSTANCE_INITIALIZER;
+
+base::LazyInstance<base::ThreadLocalPointer<IoThrottle> >::Leaky
+    g_current_io_throttle = LAZY_INSTANCE_INITIALIZER;
+
+// Zero-initialized, so usable before main() and after exit.
+AtomicWord g_bytes[kNumIoPriorities];
+AtomicWord g_wait_us[kNumIoPriorities];
+
+// Waits until |bucket|, guarded by |lock|, lets a transfer start, then
+// accounts |bytes| in it. Adds the time waited to |wait_time|.
+bool WaitAndConsume(IoTokenBucket* bucket,
+                    base::Lock* lock,
+                    uint64_t bytes,
+                    CancellationToken* cancellation_token,
+                    base::TimeDelta* wait_time) {
+  while (true) {
+    base::TimeDelta delay;
+    {
+      base::AutoLock auto_lock(*lock);
+      const base::TimeTicks now = base::TimeTicks::Now();
+      delay = bucket->GetDelay(now);
+      if (delay == base::TimeDelta()) {
+        bucket->Consume(bytes, now);
+        return true;
+      }
+    }
+    // Wait in slices, so that a cancellation or a budget change is noticed.
+    delay = std::min(
+        delay, base::TimeDelta::FromMilliseconds(kCancellationCheckIntervalMs));
+    *wait_time += delay;
+    if (cancellation_token) {
+      if (cancellation_token->WaitForCancellation(delay))
+        return false;
+    } else {
+      base::PlatformThread::Sleep(delay);
+    }
+  }
+}
+
+}  // namespace
+
+IoTokenBucket::IoTokenBucket() : rate_(0), tokens_(0) {}
+
+void IoTokenBucket::SetRate(uint64_t bytes_per_second) {
+  rate_ = bytes_per_second;
+  tokens_ = 0;
+  last_refill_time_ = base::TimeTicks();
+}
+
+base::TimeDelta IoTokenBucket::GetDelay(base::TimeTicks now) {
+  if (rate_ == 0)
+    return base::TimeDelta();
+  Refill(now);
+  if (tokens_ >= 0)
+    return base::TimeDelta();
+  // At least a microsecond, so that a non-zero debt always waits.
+  return base::TimeDelta::FromMicroseconds(std::max<int64_t>(
+      1, -tokens_ / rate_ * base::Time::kMicrosecondsPerSecond));
+}
+
+void IoTokenBucket::Consume(uint64_t bytes, base::TimeTicks now) {
+  if (rate_ == 0)
+    return;
+  Refill(now);
+  tokens_ -= bytes;
+}
+
+void IoTokenBucket::Refill(base::TimeTicks now) {
+  if (!last_refill_time_.is_null()) {
+    tokens_ = std::min(kBurstSeconds * rate_,
+                       tokens_ + (now - last_refill_time_).InSecondsF() *
+                                     rate_);
+  }
+  last_refill_time_ = now;
+}
+
+IoThrottle::IoThrottle(IoPriority priority, uint64_t bytes_per_second)
+    : priority_(priority) {
+  DCHECK_GE(priority, 0);
+  DCHECK_LT(priority, kNumIoPriorities);
+  bucket_.SetRate(bytes_per_second);
+}
+
+IoThrottle::~IoThrottle() {}
+
+bool IoThrottle::Acquire(uint64_t bytes,
+                         CancellationToken* cancellation_token) {
+  base::TimeDelta wait_time;
+  bool acquired =
+      WaitAndConsume(&bucket_, &lock_, bytes, cancellation_token, &wait_time);
+  if (acquired) {
+    HostBudget* host_budget = g_host_budget.Pointer();
+    if (priority_ == kLiveIoPriority) {
+      // The debt of the host budget delays the batch jobs only.
+      base::AutoLock auto_lock(host_budget->lock);
+      host_budget->bucket.Consume(bytes, base::TimeTicks::Now());
+    } else {
+      acquired = WaitAndConsume(&host_budget->bucket, &host_budget->lock,
+                                bytes, cancellation_token, &wait_time);
+    }
+  }
+  if (acquired)
+    base::subtle::NoBarrier_AtomicIncrement(&g_bytes[priority_], bytes);
+  base::subtle::NoBarrier_AtomicIncrement(&g_wait_us[priority_],
+                                          wait_time.InMicroseconds());
+  return acquired;
+}
+
+// static
+IoThrottle* IoThrottle::Current() {
+  return g_current_io_throttle.Get().Get();
+}
+
+// static
+void IoThrottle::SetHostBandwidth(uint64_t bytes_per_second) {
+  HostBudget* host_budget = g_host_budget.Pointer();
+  base::AutoLock auto_lock(host_budget->lock);
+  host_budget->bucket.SetRate(bytes_per_second);
+}
+
+// static
+bool IoThrottle::ParseIoPriority(const std::string& name,
+                                 IoPriority* priority) {
+  DCHECK(priority);
+  for (int i = 0; i < kNumIoPriorities; ++i) {
+    if (name == kPriorityNames[i]) {
+      *priority = static_cast<IoPriority>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+// static
+std::string IoThrottle::ToPrometheusText() {
+  std::string text =
+      "# HELP packager_io_throttled_bytes Bytes read and written through the "
+      "I/O budgets, by priority.\n"
+      "# TYPE packager_io_throttled_bytes counter\n";
+  for (int i = 0; i < kNumIoPriorities; ++i) {
+    text += std::string("packager_io_throttled_bytes{priority=\"") +
+            kPriorityNames[i] + "\"} " +
+            base::Int64ToString(base::subtle::NoBarrier_Load(&g_bytes[i])) +
+            "\n";
+  }
+  text +=
+      "# HELP packager_io_throttle_wait_seconds Time spent waiting for the "
+      "I/O budgets, by priority.\n"
+      "# TYPE packager_io_throttle_wait_seconds counter\n";
+  for (int i = 0; i < kNumIoPriorities; ++i) {
+    text += std::string("packager_io_throttle_wait_seconds{priority=\"") +
+            kPriorityNames[i] + "\"} " +
+            base::DoubleToString(base::subtle::NoBarrier_Load(&g_wait_us[i]) /
+                                 1e6) +
+            "\n";
+  }
+  return text;
+}
+
+ScopedIoThrottle::ScopedIoThrottle(IoThrottle* io_throttle)
+    : previous_io_throttle_(IoThrottle::Current()) {
+  g_current_io_throttle.Get().Set(io_throttle);
+}
+
+ScopedIoThrottle::~ScopedIoThrottle() {
+  g_current_io_throttle.Get().Set(previous_io_throttle_);
+}
+
+}  // namespace media
+}  // namespace edash_packager
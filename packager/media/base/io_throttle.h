@@ -0,0 +1,132 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_BASE_IO_THROTTLE_H_
+#define MEDIA_BASE_IO_THROTTLE_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "packager/base/memory/ref_counted.h"
+#include "packager/base/synchronization/lock.h"
+#include "packager/base/time/time.h"
+
+namespace edash_packager {
+namespace media {
+
+class CancellationToken;
+
+/// I/O priority classes of the jobs sharing the I/O bandwidth of the host.
+enum IoPriority {
+  /// The I/O of live jobs is never delayed by the host budget, but it is
+  /// accounted in it.
+  kLiveIoPriority,
+  /// The I/O of batch jobs, e.g. VOD, uses the host budget left over by the
+  /// live jobs.
+  kBatchIoPriority,
+  kNumIoPriorities,
+};
+
+/// Token bucket of an I/O budget. Transfers may overdraw the bucket, so that
+/// transfers larger than the burst get through, and the following transfers
+/// wait for the debt to be paid back.
+class IoTokenBucket {
+ public:
+  IoTokenBucket();
+
+  /// @param bytes_per_second is the budget, 0 for unlimited.
+  void SetRate(uint64_t bytes_per_second);
+  uint64_t rate() const { return rate_; }
+
+  /// @return The time to wait before a transfer may start, zero if it may
+  ///         start now.
+  base::TimeDelta GetDelay(base::TimeTicks now);
+
+  /// Accounts @a bytes transferred.
+  void Consume(uint64_t bytes, base::TimeTicks now);
+
+ private:
+  void Refill(base::TimeTicks now);
+
+  uint64_t rate_;
+  double tokens_;
+  base::TimeTicks last_refill_time_;
+
+  DISALLOW_COPY_AND_ASSIGN(IoTokenBucket);
+};
+
+/// I/O budget and priority of a packaging job. The throttle of a job is the
+/// current throttle, see ScopedIoThrottle, of the threads running it; the
+/// threaded I/O of the files pick up the current throttle of the thread
+/// opening them and acquire every block read or written from it.
+///
+/// Thread Safety: All the methods can be called from any thread.
+class IoThrottle : public base::RefCountedThreadSafe<IoThrottle> {
+ public:
+  /// @param priority is the priority class of the I/O of the job.
+  /// @param bytes_per_second is the I/O budget of the job, 0 for unlimited.
+  IoThrottle(IoPriority priority, uint64_t bytes_per_second);
+
+  /// Waits until @a bytes may be transferred within the budget of the job
+  /// and, for batch jobs, within the host budget left over by the live jobs,
+  /// then accounts them.
+  /// @param bytes is the size of the transfer.
+  /// @param cancellation_token interrupts the wait once cancelled. Can be
+  ///        NULL.
+  /// @return true if the transfer may start, false if it is cancelled.
+  bool Acquire(uint64_t bytes, CancellationToken* cancellation_token);
+
+  IoPriority priority() const { return priority_; }
+
+  /// @return the current throttle of the calling thread, or NULL if it has
+  ///         none, in which case the I/O is not throttled.
+  static IoThrottle* Current();
+
+  /// Sets the I/O bandwidth of the host shared by all the jobs.
+  /// @param bytes_per_second is the bandwidth, 0 (the default) for
+  ///        unlimited.
+  static void SetHostBandwidth(uint64_t bytes_per_second);
+
+  /// Parses a priority name: "live" or "batch".
+  /// @return true on success, false if @a name is not a priority.
+  static bool ParseIoPriority(const std::string& name, IoPriority* priority);
+
+  /// @return The bytes acquired and the time spent waiting for the budgets,
+  ///         by priority, in the Prometheus text exposition format.
+  static std::string ToPrometheusText();
+
+ private:
+  friend class base::RefCountedThreadSafe<IoThrottle>;
+  ~IoThrottle();
+
+  const IoPriority priority_;
+  base::Lock lock_;
+  IoTokenBucket bucket_;
+
+  DISALLOW_COPY_AND_ASSIGN(IoThrottle);
+};
+
+/// Makes a throttle the current throttle of the calling thread for the
+/// lifetime of the object, then restores the previous one. It is propagated
+/// to the threads of a job like the CancellationToken.
+class ScopedIoThrottle {
+ public:
+  /// @param io_throttle is the throttle, which must outlive the object. NULL
+  ///        clears the current throttle.
+  explicit ScopedIoThrottle(IoThrottle* io_throttle);
+  ~ScopedIoThrottle();
+
+ private:
+  IoThrottle* previous_io_throttle_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedIoThrottle);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_BASE_IO_THROTTLE_H_
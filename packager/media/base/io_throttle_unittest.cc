@@ -0,0 +1,93 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+
+#include "packager/base/timer/elapsed_timer.h"
+#include "packager/media/base/cancellation_token.h"
+#include "packager/media/base/io_throttle.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+const uint64_t kBytesPerSecond = 1000000;
+const uint64_t kBlockSize = 100000;
+}  // namespace
+
+class IoThrottleTest : public testing::Test {
+ public:
+  void TearDown() override { IoThrottle::SetHostBandwidth(0); }
+};
+
+TEST_F(IoThrottleTest, ParseIoPriority) {
+  IoPriority priority = kNumIoPriorities;
+  ASSERT_TRUE(IoThrottle::ParseIoPriority("live", &priority));
+  EXPECT_EQ(kLiveIoPriority, priority);
+  ASSERT_TRUE(IoThrottle::ParseIoPriority("batch", &priority));
+  EXPECT_EQ(kBatchIoPriority, priority);
+  EXPECT_FALSE(IoThrottle::ParseIoPriority("vod", &priority));
+}
+
+TEST_F(IoThrottleTest, Unlimited) {
+  scoped_refptr<IoThrottle> throttle(new IoThrottle(kBatchIoPriority, 0));
+  base::ElapsedTimer timer;
+  for (int i = 0; i < 100; ++i)
+    EXPECT_TRUE(throttle->Acquire(kBlockSize, NULL));
+  EXPECT_LT(timer.Elapsed().InMilliseconds(), 100);
+}
+
+TEST_F(IoThrottleTest, JobBudget) {
+  scoped_refptr<IoThrottle> throttle(
+      new IoThrottle(kLiveIoPriority, kBytesPerSecond));
+  base::ElapsedTimer timer;
+  // The first block overdraws the bucket, the following ones wait for the
+  // debt to be paid back.
+  for (int i = 0; i < 3; ++i)
+    EXPECT_TRUE(throttle->Acquire(kBlockSize, NULL));
+  EXPECT_GE(timer.Elapsed().InMilliseconds(), 150);
+}
+
+TEST_F(IoThrottleTest, Cancelled) {
+  scoped_refptr<IoThrottle> throttle(
+      new IoThrottle(kBatchIoPriority, kBytesPerSecond));
+  scoped_refptr<CancellationToken> token(new CancellationToken);
+  EXPECT_TRUE(throttle->Acquire(10 * kBytesPerSecond, token.get()));
+  token->Cancel();
+  base::ElapsedTimer timer;
+  EXPECT_FALSE(throttle->Acquire(kBlockSize, token.get()));
+  EXPECT_LT(timer.Elapsed().InSeconds(), 5);
+}
+
+TEST_F(IoThrottleTest, LiveJobsGoFirst) {
+  IoThrottle::SetHostBandwidth(kBytesPerSecond);
+  scoped_refptr<IoThrottle> live(new IoThrottle(kLiveIoPriority, 0));
+  scoped_refptr<IoThrottle> batch(new IoThrottle(kBatchIoPriority, 0));
+
+  // The live job overdraws the host budget without waiting.
+  base::ElapsedTimer live_timer;
+  for (int i = 0; i < 3; ++i)
+    EXPECT_TRUE(live->Acquire(kBlockSize, NULL));
+  EXPECT_LT(live_timer.Elapsed().InMilliseconds(), 100);
+
+  // The batch job waits for the debt of the live job to be paid back.
+  base::ElapsedTimer batch_timer;
+  EXPECT_TRUE(batch->Acquire(kBlockSize, NULL));
+  EXPECT_GE(batch_timer.Elapsed().InMilliseconds(), 150);
+}
+
+TEST_F(IoThrottleTest, ScopedIoThrottle) {
+  scoped_refptr<IoThrottle> throttle(new IoThrottle(kLiveIoPriority, 0));
+  EXPECT_EQ(NULL, IoThrottle::Current());
+  {
+    ScopedIoThrottle scoped_throttle(throttle.get());
+    EXPECT_EQ(throttle.get(), IoThrottle::Current());
+  }
+  EXPECT_EQ(NULL, IoThrottle::Current());
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,171 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/job_resource_usage.h"
+
+#include "packager/base/lazy_instance.h"
+#include "packager/base/logging.h"
+#include "packager/base/strings/string_number_conversions.h"
+#include "packager/base/strings/stringprintf.h"
+#include "packager/base/threading/thread_local.h"
+
+#if defined(OS_POSIX)
+#include <time.h>
+#endif
+
+namespace edash_packager {
+namespace media {
+
+using base::subtle::AtomicWord;
+using base::subtle::NoBarrier_AtomicIncrement;
+using base::subtle::NoBarrier_Load;
+
+namespace {
+
+// The files accounted individually, at most.
+const size_t kMaxFiles = 1000;
+const char kOtherFiles[] = "other";
+
+base::LazyInstance<base::ThreadLocalPointer<JobResourceUsage> >::Leaky
+    g_current_usage = LAZY_INSTANCE_INITIALIZER;
+
+std::string ToJsonString(const std::string& value) {
+  std::string json = "\"";
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      json += '\\';
+      json += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      base::StringAppendF(&json, "\\u%04x", c);
+    } else {
+      json += c;
+    }
+  }
+  return json + "\"";
+}
+
+std::string MicrosecondsToSeconds(AtomicWord microseconds) {
+  return base::DoubleToString(
+      static_cast<double>(microseconds) / base::Time::kMicrosecondsPerSecond);
+}
+
+}  // namespace
+
+JobResourceUsage::FileBytes::FileBytes() : bytes_read(0), bytes_written(0) {}
+
+JobResourceUsage::JobResourceUsage() : cpu_time_us_(0) {
+  for (int i = 0; i < kNumPipelineStages; ++i) {
+    stage_counts_[i] = 0;
+    stage_time_us_[i] = 0;
+    stage_bytes_[i] = 0;
+  }
+}
+
+JobResourceUsage::~JobResourceUsage() {}
+
+void JobResourceUsage::AddCpuTime(base::TimeDelta cpu_time) {
+  NoBarrier_AtomicIncrement(&cpu_time_us_, cpu_time.InMicroseconds());
+}
+
+void JobResourceUsage::AddStageRun(PipelineStage stage,
+                                   base::TimeDelta time,
+                                   uint64_t bytes) {
+  DCHECK_GE(stage, 0);
+  DCHECK_LT(stage, kNumPipelineStages);
+  NoBarrier_AtomicIncrement(&stage_counts_[stage], 1);
+  NoBarrier_AtomicIncrement(&stage_time_us_[stage], time.InMicroseconds());
+  if (bytes > 0)
+    NoBarrier_AtomicIncrement(&stage_bytes_[stage], bytes);
+}
+
+void JobResourceUsage::AddFileBytes(const std::string& file_name,
+                                    uint64_t bytes_read,
+                                    uint64_t bytes_written) {
+  base::AutoLock auto_lock(lock_);
+  std::map<std::string, FileBytes>::iterator iter =
+      file_bytes_.find(file_name);
+  if (iter == file_bytes_.end()) {
+    const std::string& key =
+        file_bytes_.size() < kMaxFiles ? file_name : kOtherFiles;
+    iter = file_bytes_.insert(std::make_pair(key, FileBytes())).first;
+  }
+  iter->second.bytes_read += bytes_read;
+  iter->second.bytes_written += bytes_written;
+}
+
+base::TimeDelta JobResourceUsage::cpu_time() const {
+  return base::TimeDelta::FromMicroseconds(NoBarrier_Load(&cpu_time_us_));
+}
+
+std::string JobResourceUsage::ToJson() const {
+  std::string json = "{\"cpu_seconds\":" +
+                     MicrosecondsToSeconds(NoBarrier_Load(&cpu_time_us_)) +
+                     ",\"stages\":{";
+  for (int i = 0; i < kNumPipelineStages; ++i) {
+    if (i > 0)
+      json += ",";
+    json += std::string("\"") +
+            PipelineMetrics::GetStageName(static_cast<PipelineStage>(i)) +
+            "\":{\"count\":" +
+            base::Int64ToString(NoBarrier_Load(&stage_counts_[i])) +
+            ",\"seconds\":" +
+            MicrosecondsToSeconds(NoBarrier_Load(&stage_time_us_[i])) +
+            ",\"bytes\":" +
+            base::Int64ToString(NoBarrier_Load(&stage_bytes_[i])) + "}";
+  }
+  json += "},\"files\":{";
+  base::AutoLock auto_lock(lock_);
+  bool first = true;
+  for (const std::pair<const std::string, FileBytes>& entry : file_bytes_) {
+    if (!first)
+      json += ",";
+    first = false;
+    json += ToJsonString(entry.first) + ":{\"bytes_read\":" +
+            base::Uint64ToString(entry.second.bytes_read) +
+            ",\"bytes_written\":" +
+            base::Uint64ToString(entry.second.bytes_written) + "}";
+  }
+  json += "}}";
+  return json;
+}
+
+// static
+JobResourceUsage* JobResourceUsage::Current() {
+  return g_current_usage.Get().Get();
+}
+
+// static
+base::TimeDelta JobResourceUsage::GetThreadCpuTime() {
+#if defined(OS_POSIX)
+  struct timespec cpu_time;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_time) != 0)
+    return base::TimeDelta();
+  return base::TimeDelta::FromMicroseconds(
+      cpu_time.tv_sec * base::Time::kMicrosecondsPerSecond +
+      cpu_time.tv_nsec / base::Time::kNanosecondsPerMicrosecond);
+#else
+  // Not supported: no CPU time is accounted.
+  return base::TimeDelta();
+#endif
+}
+
+ScopedJobResourceUsage::ScopedJobResourceUsage(JobResourceUsage* usage)
+    : usage_(usage),
+      previous_usage_(JobResourceUsage::Current()),
+      start_cpu_time_(usage && usage != previous_usage_
+                          ? JobResourceUsage::GetThreadCpuTime()
+                          : base::TimeDelta()) {
+  g_current_usage.Get().Set(usage);
+}
+
+ScopedJobResourceUsage::~ScopedJobResourceUsage() {
+  if (usage_ && usage_ != previous_usage_)
+    usage_->AddCpuTime(JobResourceUsage::GetThreadCpuTime() - start_cpu_time_);
+  g_current_usage.Get().Set(previous_usage_);
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,109 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_BASE_JOB_RESOURCE_USAGE_H_
+#define MEDIA_BASE_JOB_RESOURCE_USAGE_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+
+#include "packager/base/atomicops.h"
+#include "packager/base/memory/ref_counted.h"
+#include "packager/base/synchronization/lock.h"
+#include "packager/base/time/time.h"
+#include "packager/media/base/pipeline_metrics.h"
+
+namespace edash_packager {
+namespace media {
+
+/// Resources used by a packaging job, reported when the job ends, e.g. for
+/// capacity planning: the CPU time of the threads while they run the job,
+/// the time and bytes of its pipeline stages, including the bytes encrypted,
+/// and the bytes read and written per file. The usage of a job is the
+/// current usage, see ScopedJobResourceUsage, of the threads running it; the
+/// stage timers and the files opened pick up the current usage of their
+/// thread.
+///
+/// Thread Safety: All the methods can be called from any thread.
+class JobResourceUsage : public base::RefCountedThreadSafe<JobResourceUsage> {
+ public:
+  JobResourceUsage();
+
+  /// Accounts CPU time used by a thread of the job.
+  void AddCpuTime(base::TimeDelta cpu_time);
+
+  /// Accounts a run of a pipeline stage of the job.
+  void AddStageRun(PipelineStage stage, base::TimeDelta time, uint64_t bytes);
+
+  /// Accounts the bytes read from and written to a file of the job. Beyond
+  /// a number of files, e.g. the segments of a long live job, the bytes of
+  /// the new files are summed up under "other".
+  void AddFileBytes(const std::string& file_name,
+                    uint64_t bytes_read,
+                    uint64_t bytes_written);
+
+  /// @return The CPU time accounted so far.
+  base::TimeDelta cpu_time() const;
+
+  /// @return The resource report of the job as a JSON object.
+  std::string ToJson() const;
+
+  /// @return the current usage of the calling thread, or NULL if it has
+  ///         none, in which case nothing is accounted.
+  static JobResourceUsage* Current();
+
+  /// @return The CPU time used by the calling thread so far.
+  static base::TimeDelta GetThreadCpuTime();
+
+ private:
+  friend class base::RefCountedThreadSafe<JobResourceUsage>;
+  ~JobResourceUsage();
+
+  struct FileBytes {
+    FileBytes();
+
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+  };
+
+  // Updated on the hot paths, hence atomic.
+  base::subtle::AtomicWord cpu_time_us_;
+  base::subtle::AtomicWord stage_counts_[kNumPipelineStages];
+  base::subtle::AtomicWord stage_time_us_[kNumPipelineStages];
+  base::subtle::AtomicWord stage_bytes_[kNumPipelineStages];
+
+  mutable base::Lock lock_;  // Lock protecting the variables below.
+  std::map<std::string, FileBytes> file_bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(JobResourceUsage);
+};
+
+/// Makes a usage the current usage of the calling thread for the lifetime of
+/// the object, then restores the previous one, and accounts the CPU time of
+/// the thread meanwhile in it. It is propagated to the threads of a job like
+/// the CancellationToken. The CPU time of a scope nested in a scope of the
+/// same usage is not accounted twice.
+class ScopedJobResourceUsage {
+ public:
+  /// @param usage is the usage, which must outlive the object. NULL clears
+  ///        the current usage.
+  explicit ScopedJobResourceUsage(JobResourceUsage* usage);
+  ~ScopedJobResourceUsage();
+
+ private:
+  JobResourceUsage* const usage_;
+  JobResourceUsage* const previous_usage_;
+  const base::TimeDelta start_cpu_time_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedJobResourceUsage);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_BASE_JOB_RESOURCE_USAGE_H_
@@ -0,0 +1,88 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/job_resource_usage.h"
+
+#include <gtest/gtest.h>
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+bool Contains(const std::string& json, const std::string& value) {
+  return json.find(value) != std::string::npos;
+}
+
+}  // namespace
+
+TEST(JobResourceUsageTest, ScopeSetsCurrentUsage) {
+  scoped_refptr<JobResourceUsage> usage = new JobResourceUsage;
+  scoped_refptr<JobResourceUsage> other_usage = new JobResourceUsage;
+  EXPECT_EQ(NULL, JobResourceUsage::Current());
+  {
+    ScopedJobResourceUsage scoped_usage(usage.get());
+    EXPECT_EQ(usage.get(), JobResourceUsage::Current());
+    {
+      ScopedJobResourceUsage scoped_other_usage(other_usage.get());
+      EXPECT_EQ(other_usage.get(), JobResourceUsage::Current());
+    }
+    EXPECT_EQ(usage.get(), JobResourceUsage::Current());
+  }
+  EXPECT_EQ(NULL, JobResourceUsage::Current());
+}
+
+#if defined(OS_POSIX)
+TEST(JobResourceUsageTest, AccountsThreadCpuTime) {
+  scoped_refptr<JobResourceUsage> usage = new JobResourceUsage;
+  {
+    ScopedJobResourceUsage scoped_usage(usage.get());
+    // The same usage nested is not accounted twice.
+    ScopedJobResourceUsage nested_usage(usage.get());
+    const base::TimeDelta start = JobResourceUsage::GetThreadCpuTime();
+    volatile uint64_t sum = 0;
+    while (JobResourceUsage::GetThreadCpuTime() - start <
+           base::TimeDelta::FromMilliseconds(20)) {
+      for (int i = 0; i < 1000; ++i)
+        sum += i;
+    }
+  }
+  EXPECT_GE(usage->cpu_time(), base::TimeDelta::FromMilliseconds(20));
+  EXPECT_LT(usage->cpu_time(), base::TimeDelta::FromMilliseconds(40));
+}
+#endif  // defined(OS_POSIX)
+
+TEST(JobResourceUsageTest, AccountsStageRuns) {
+  scoped_refptr<JobResourceUsage> usage = new JobResourceUsage;
+  {
+    ScopedJobResourceUsage scoped_usage(usage.get());
+    ScopedStageTimer encrypt_timer(kEncryptStage);
+    encrypt_timer.AddBytes(100);
+  }
+  {
+    // Not the current usage anymore.
+    ScopedStageTimer encrypt_timer(kEncryptStage);
+    encrypt_timer.AddBytes(100);
+  }
+  const std::string json = usage->ToJson();
+  EXPECT_TRUE(Contains(json, "\"encrypt\":{\"count\":1,"));
+  EXPECT_TRUE(Contains(json, ",\"bytes\":100}"));
+}
+
+TEST(JobResourceUsageTest, AccountsFileBytes) {
+  scoped_refptr<JobResourceUsage> usage = new JobResourceUsage;
+  usage->AddFileBytes("in.mp4", 10, 0);
+  usage->AddFileBytes("in.mp4", 5, 0);
+  usage->AddFileBytes("out\"1\".mp4", 0, 7);
+  const std::string json = usage->ToJson();
+  EXPECT_TRUE(Contains(
+      json, "\"in.mp4\":{\"bytes_read\":15,\"bytes_written\":0}"));
+  EXPECT_TRUE(Contains(
+      json, "\"out\\\"1\\\".mp4\":{\"bytes_read\":0,\"bytes_written\":7}"));
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,132 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/key_rotation_schedule.h"
+
+#include "packager/base/bind.h"
+#include "packager/base/logging.h"
+#include "packager/media/base/thread_pool.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+// The number of crypto periods kept behind the latest one of a track type,
+// for the renditions lagging behind the others. A rendition lagging further
+// fetches the key again.
+const uint32_t kNumRetainedCryptoPeriods = 4;
+
+}  // namespace
+
+KeyRotationSchedule::CryptoPeriod::CryptoPeriod() : ready(false) {}
+KeyRotationSchedule::CryptoPeriod::~CryptoPeriod() {}
+
+KeyRotationSchedule::KeyRotationSchedule(KeySource* key_source)
+    : key_source_(key_source),
+      period_ready_(&lock_),
+      num_keys_fetched_(0),
+      prefetch_thread_(new ThreadPool("KeyRotationPrefetch", 1)) {
+  DCHECK(key_source);
+  prefetch_thread_->Start();
+}
+
+KeyRotationSchedule::~KeyRotationSchedule() {}
+
+Status KeyRotationSchedule::GetCryptoPeriodKey(
+    uint32_t crypto_period_index,
+    KeySource::TrackType track_type,
+    EncryptionKey* key,
+    std::vector<std::vector<uint8_t> >* pssh_boxes) {
+  DCHECK(key);
+  DCHECK(pssh_boxes);
+  const PeriodKey period_key(track_type, crypto_period_index);
+  scoped_refptr<CryptoPeriod> crypto_period;
+  bool fetch;
+  {
+    base::AutoLock auto_lock(lock_);
+    fetch = AddCryptoPeriod(period_key, &crypto_period);
+  }
+  if (fetch)
+    FetchCryptoPeriod(period_key, crypto_period);
+
+  base::AutoLock auto_lock(lock_);
+  while (!crypto_period->ready)
+    period_ready_.Wait();
+
+  // The first rendition reaching the period prefetches the next one.
+  const PeriodKey next_period_key(track_type, crypto_period_index + 1);
+  scoped_refptr<CryptoPeriod> next_crypto_period;
+  if (AddCryptoPeriod(next_period_key, &next_crypto_period)) {
+    // Unretained is safe: |prefetch_thread_| runs the pending task before the
+    // schedule is destroyed.
+    prefetch_thread_->PostTask(base::Bind(
+        &KeyRotationSchedule::FetchCryptoPeriod, base::Unretained(this),
+        next_period_key, next_crypto_period));
+  }
+
+  if (!crypto_period->status.ok())
+    return crypto_period->status;
+  *key = crypto_period->key;
+  *pssh_boxes = crypto_period->pssh_boxes;
+  return Status::OK;
+}
+
+size_t KeyRotationSchedule::num_keys_fetched() const {
+  base::AutoLock auto_lock(lock_);
+  return num_keys_fetched_;
+}
+
+bool KeyRotationSchedule::AddCryptoPeriod(
+    const PeriodKey& period_key,
+    scoped_refptr<CryptoPeriod>* crypto_period) {
+  lock_.AssertAcquired();
+  PeriodMap::iterator iter = periods_.find(period_key);
+  if (iter != periods_.end()) {
+    *crypto_period = iter->second;
+    return false;
+  }
+  *crypto_period = new CryptoPeriod;
+  periods_[period_key] = *crypto_period;
+
+  // The periods being fetched are kept for their waiters.
+  iter = periods_.lower_bound(PeriodKey(period_key.first, 0));
+  while (iter != periods_.end() && iter->first.first == period_key.first &&
+         iter->first.second + kNumRetainedCryptoPeriods < period_key.second) {
+    if (iter->second->ready)
+      periods_.erase(iter++);
+    else
+      ++iter;
+  }
+  return true;
+}
+
+void KeyRotationSchedule::FetchCryptoPeriod(
+    const PeriodKey& period_key,
+    scoped_refptr<CryptoPeriod> crypto_period) {
+  EncryptionKey key;
+  Status status = key_source_->GetCryptoPeriodKey(period_key.second,
+                                                  period_key.first, &key);
+  std::vector<std::vector<uint8_t> > pssh_boxes;
+  if (status.ok()) {
+    const std::vector<ProtectionSystemSpecificInfo>& system_info =
+        key.key_system_info;
+    pssh_boxes.resize(system_info.size());
+    for (size_t i = 0; i < system_info.size(); i++)
+      pssh_boxes[i] = system_info[i].CreateBox();
+  }
+
+  base::AutoLock auto_lock(lock_);
+  ++num_keys_fetched_;
+  crypto_period->status = status;
+  crypto_period->key = key;
+  crypto_period->pssh_boxes.swap(pssh_boxes);
+  crypto_period->ready = true;
+  period_ready_.Broadcast();
+}
+
+}  // namespace media
+}  // namespace edash_packager
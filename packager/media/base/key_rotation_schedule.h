@@ -0,0 +1,107 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef PACKAGER_MEDIA_BASE_KEY_ROTATION_SCHEDULE_H_
+#define PACKAGER_MEDIA_BASE_KEY_ROTATION_SCHEDULE_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "packager/base/macros.h"
+#include "packager/base/memory/ref_counted.h"
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/synchronization/condition_variable.h"
+#include "packager/base/synchronization/lock.h"
+#include "packager/media/base/key_source.h"
+#include "packager/media/base/status.h"
+
+namespace edash_packager {
+namespace media {
+
+class ThreadPool;
+
+/// Schedules the crypto periods of key rotation for the renditions of a
+/// packaging job. The key of a crypto period is fetched from the key source
+/// once, by the first rendition reaching the period, and the renditions of
+/// the same track type reaching it later get the same key and 'pssh' boxes.
+/// The key of the next period is prefetched on a single background thread
+/// for all the renditions, so that switching periods does not stall the
+/// media path on the key source. A schedule is typically shared by all the
+/// muxers of a job.
+/// Thread Safety: KeyRotationSchedule is thread safe.
+class KeyRotationSchedule {
+ public:
+  /// @param key_source is the source of the crypto period keys. It is not
+  ///        owned, should be thread safe and should outlive the schedule.
+  explicit KeyRotationSchedule(KeySource* key_source);
+  /// Waits for the pending prefetch, if any.
+  ~KeyRotationSchedule();
+
+  /// Get the key of a crypto period, and prefetch the key of the next one.
+  /// Waits if the key is being fetched by another rendition.
+  /// @param crypto_period_index is the sequence number of the crypto period.
+  /// @param track_type is the type of track for which retrieving the key.
+  /// @param[out] key receives the key. Its iv is left as provided by the key
+  ///        source, so that each rendition can use its own iv.
+  /// @param[out] pssh_boxes receives the serialized 'pssh' boxes of the key.
+  /// @return OK on success, an error status otherwise.
+  Status GetCryptoPeriodKey(uint32_t crypto_period_index,
+                            KeySource::TrackType track_type,
+                            EncryptionKey* key,
+                            std::vector<std::vector<uint8_t> >* pssh_boxes);
+
+  /// @return The number of keys fetched from the key source.
+  size_t num_keys_fetched() const;
+
+ private:
+  // A crypto period of a track type, fetched or being fetched.
+  struct CryptoPeriod : public base::RefCountedThreadSafe<CryptoPeriod> {
+    CryptoPeriod();
+
+    bool ready;
+    Status status;
+    EncryptionKey key;
+    std::vector<std::vector<uint8_t> > pssh_boxes;
+
+   private:
+    friend class base::RefCountedThreadSafe<CryptoPeriod>;
+    ~CryptoPeriod();
+  };
+  typedef std::pair<KeySource::TrackType, uint32_t> PeriodKey;
+  typedef std::map<PeriodKey, scoped_refptr<CryptoPeriod> > PeriodMap;
+
+  // Adds an entry for |period_key| if there is none. Returns true if the
+  // entry was added, in which case the caller must fetch it. Drops the
+  // periods far behind |period_key|. Must be called with |lock_| held.
+  bool AddCryptoPeriod(const PeriodKey& period_key,
+                       scoped_refptr<CryptoPeriod>* crypto_period);
+  // Fetches the key of |period_key| into |crypto_period|. Called without
+  // |lock_| held.
+  void FetchCryptoPeriod(const PeriodKey& period_key,
+                         scoped_refptr<CryptoPeriod> crypto_period);
+
+  KeySource* const key_source_;
+
+  mutable base::Lock lock_;
+  // Signaled when a crypto period is ready.
+  base::ConditionVariable period_ready_;
+  PeriodMap periods_;
+  size_t num_keys_fetched_;
+
+  // Declared last, so that its pending task completes before the members
+  // above are destroyed.
+  scoped_ptr<ThreadPool> prefetch_thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(KeyRotationSchedule);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // PACKAGER_MEDIA_BASE_KEY_ROTATION_SCHEDULE_H_
@@ -0,0 +1,117 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/key_rotation_schedule.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "packager/media/base/fixed_key_source.h"
+#include "packager/media/base/test/status_test_util.h"
+
+using ::testing::_;
+using ::testing::DoAll;
+using ::testing::Return;
+using ::testing::SetArgPointee;
+
+namespace edash_packager {
+namespace media {
+namespace {
+
+const uint8_t kSystemId[] = {0xed, 0xef, 0x8b, 0xa9, 0x79, 0xd6, 0x4a, 0xce,
+                             0xa3, 0xc8, 0x27, 0xdc, 0xd5, 0x1d, 0x21, 0xed};
+
+class MockKeySource : public FixedKeySource {
+ public:
+  MOCK_METHOD3(GetCryptoPeriodKey,
+               Status(uint32_t crypto_period_index,
+                      TrackType track_type,
+                      EncryptionKey* key));
+};
+
+EncryptionKey GetCryptoPeriodKey(uint8_t crypto_period_index) {
+  EncryptionKey key;
+  key.key_id.assign(16, crypto_period_index);
+  key.key.assign(16, crypto_period_index + 0x80);
+  ProtectionSystemSpecificInfo info;
+  info.set_system_id(kSystemId, arraysize(kSystemId));
+  info.set_pssh_data(std::vector<uint8_t>(4, crypto_period_index));
+  key.key_system_info.push_back(info);
+  return key;
+}
+
+}  // namespace
+
+class KeyRotationScheduleTest : public ::testing::Test {
+ protected:
+  void ExpectKeyFetched(uint32_t crypto_period_index,
+                        KeySource::TrackType track_type) {
+    EXPECT_CALL(key_source_,
+                GetCryptoPeriodKey(crypto_period_index, track_type, _))
+        .WillOnce(DoAll(SetArgPointee<2>(GetCryptoPeriodKey(
+                            static_cast<uint8_t>(crypto_period_index))),
+                        Return(Status::OK)));
+  }
+
+  MockKeySource key_source_;
+};
+
+TEST_F(KeyRotationScheduleTest, KeyFetchedOnceForAllRenditions) {
+  // The key of each period, including the prefetched one, is fetched once.
+  ExpectKeyFetched(0, KeySource::TRACK_TYPE_SD);
+  ExpectKeyFetched(1, KeySource::TRACK_TYPE_SD);
+  ExpectKeyFetched(2, KeySource::TRACK_TYPE_SD);
+  KeyRotationSchedule schedule(&key_source_);
+
+  for (uint32_t index = 0; index < 2; ++index) {
+    const EncryptionKey expected_key = GetCryptoPeriodKey(index);
+    // Several renditions reaching the period.
+    for (int rendition = 0; rendition < 3; ++rendition) {
+      EncryptionKey key;
+      std::vector<std::vector<uint8_t> > pssh_boxes;
+      ASSERT_OK(schedule.GetCryptoPeriodKey(index, KeySource::TRACK_TYPE_SD,
+                                            &key, &pssh_boxes));
+      EXPECT_EQ(expected_key.key_id, key.key_id);
+      EXPECT_EQ(expected_key.key, key.key);
+      EXPECT_TRUE(key.iv.empty());
+      ASSERT_EQ(1u, pssh_boxes.size());
+      EXPECT_EQ(expected_key.key_system_info[0].CreateBox(), pssh_boxes[0]);
+    }
+  }
+}
+
+TEST_F(KeyRotationScheduleTest, TrackTypesFetchedSeparately) {
+  ExpectKeyFetched(0, KeySource::TRACK_TYPE_SD);
+  ExpectKeyFetched(1, KeySource::TRACK_TYPE_SD);
+  ExpectKeyFetched(0, KeySource::TRACK_TYPE_HD);
+  ExpectKeyFetched(1, KeySource::TRACK_TYPE_HD);
+  KeyRotationSchedule schedule(&key_source_);
+
+  EncryptionKey key;
+  std::vector<std::vector<uint8_t> > pssh_boxes;
+  ASSERT_OK(schedule.GetCryptoPeriodKey(0, KeySource::TRACK_TYPE_SD, &key,
+                                        &pssh_boxes));
+  ASSERT_OK(schedule.GetCryptoPeriodKey(0, KeySource::TRACK_TYPE_HD, &key,
+                                        &pssh_boxes));
+}
+
+TEST_F(KeyRotationScheduleTest, KeySourceError) {
+  const Status kError(error::SERVER_ERROR, "Key server unavailable.");
+  EXPECT_CALL(key_source_, GetCryptoPeriodKey(0, KeySource::TRACK_TYPE_SD, _))
+      .WillOnce(Return(kError));
+  ExpectKeyFetched(1, KeySource::TRACK_TYPE_SD);
+  KeyRotationSchedule schedule(&key_source_);
+
+  for (int rendition = 0; rendition < 2; ++rendition) {
+    EncryptionKey key;
+    std::vector<std::vector<uint8_t> > pssh_boxes;
+    EXPECT_EQ(kError, schedule.GetCryptoPeriodKey(0, KeySource::TRACK_TYPE_SD,
+                                                  &key, &pssh_boxes));
+  }
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -16,6 +16,14 @@ EncryptionKey::~EncryptionKey() {}
 
 KeySource::~KeySource() {}
 
+void KeySource::GetKeyFetchStalls(uint32_t* num_stalls,
+                                  base::TimeDelta* stall_time) const {
+  DCHECK(num_stalls);
+  DCHECK(stall_time);
+  *num_stalls = 0;
+  *stall_time = base::TimeDelta();
+}
+
 KeySource::TrackType KeySource::GetTrackTypeFromString(
     const std::string& track_type_string) {
   if (track_type_string == "SD")
@@ -11,6 +11,7 @@
 #include <vector>
 
 #include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/time/time.h"
 #include "packager/media/base/protection_system_specific_info.h"
 #include "packager/media/base/status.h"
 
@@ -85,6 +86,14 @@ class KeySource {
                                     TrackType track_type,
                                     EncryptionKey* key) = 0;
 
+  /// Get how often and how long the callers waited for keys which were not
+  /// fetched yet, e.g. crypto period keys not prefetched in time. The default
+  /// implementation reports no stalls.
+  /// @param[out] num_stalls is the number of requests which waited.
+  /// @param[out] stall_time is the total time spent waiting.
+  virtual void GetKeyFetchStalls(uint32_t* num_stalls,
+                                 base::TimeDelta* stall_time) const;
+
   /// Convert string representation of track type to enum representation.
   static TrackType GetTrackTypeFromString(const std::string& track_type_string);
 
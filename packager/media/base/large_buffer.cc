@@ -0,0 +1,210 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/large_buffer.h"
+
+#include <stdlib.h>
+
+#include "packager/base/atomicops.h"
+#include "packager/base/logging.h"
+#include "packager/base/strings/string_number_conversions.h"
+
+#if defined(OS_LINUX)
+#include <sys/mman.h>
+#endif
+
+namespace edash_packager {
+namespace media {
+
+using base::subtle::AtomicWord;
+
+namespace {
+
+const char* const kSourceNames[] = {
+    "explicit_huge_pages", "transparent_huge_pages", "heap",
+};
+COMPILE_ASSERT(arraysize(kSourceNames) == kNumLargeBufferSources,
+               source_names_do_not_match_sources);
+
+const char* const kPolicyNames[] = {"explicit", "transparent", "none"};
+COMPILE_ASSERT(arraysize(kPolicyNames) == kNumLargeBufferSources,
+               policy_names_do_not_match_sources);
+
+// Constant-initialized, so usable before main() and after exit.
+AtomicWord g_policy = kHeapPages;
+AtomicWord g_allocated_bytes[kNumLargeBufferSources];
+AtomicWord g_num_buffers[kNumLargeBufferSources];
+
+size_t RoundUpToHugePages(size_t size) {
+  return (size + LargeBuffer::kHugePageSize - 1) /
+         LargeBuffer::kHugePageSize * LargeBuffer::kHugePageSize;
+}
+
+}  // namespace
+
+const size_t LargeBuffer::kHugePageSize;
+
+LargeBuffer::LargeBuffer(size_t size)
+    : data_(NULL), size_(size), allocated_size_(0), source_(kHeapPages) {
+  if (size == 0)
+    return;
+  int source = size < kHugePageSize ? kHeapPages : GetHugePagePolicy();
+  while (!Allocate(static_cast<LargeBufferSource>(source))) {
+    ++source;
+    CHECK_LT(source, kNumLargeBufferSources) << "Out of memory.";
+  }
+  source_ = static_cast<LargeBufferSource>(source);
+  base::subtle::NoBarrier_AtomicIncrement(&g_allocated_bytes[source_],
+                                          allocated_size_);
+  base::subtle::NoBarrier_AtomicIncrement(&g_num_buffers[source_], 1);
+}
+
+LargeBuffer::~LargeBuffer() {
+  if (!data_)
+    return;
+  base::subtle::NoBarrier_AtomicIncrement(
+      &g_allocated_bytes[source_], -static_cast<AtomicWord>(allocated_size_));
+  base::subtle::NoBarrier_AtomicIncrement(&g_num_buffers[source_], -1);
+#if defined(OS_LINUX)
+  if (source_ == kExplicitHugePages) {
+    if (munmap(data_, allocated_size_) != 0)
+      PLOG(ERROR) << "munmap failed";
+    return;
+  }
+#endif
+  free(data_);
+}
+
+bool LargeBuffer::Allocate(LargeBufferSource source) {
+  void* data = NULL;
+  switch (source) {
+    case kExplicitHugePages:
+#if defined(OS_LINUX) && defined(MAP_HUGETLB)
+      allocated_size_ = RoundUpToHugePages(size_);
+      data = mmap(NULL, allocated_size_, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      // Usually fails because no huge pages are reserved.
+      if (data == MAP_FAILED) {
+        VLOG(1) << "No explicit huge pages for a buffer of " << size_
+                << " bytes.";
+        return false;
+      }
+      break;
+#else
+      return false;
+#endif
+    case kTransparentHugePages:
+#if defined(OS_LINUX) && defined(MADV_HUGEPAGE)
+      // The kernel only backs the huge page aligned ranges with huge pages.
+      allocated_size_ = RoundUpToHugePages(size_);
+      if (posix_memalign(&data, kHugePageSize, allocated_size_) != 0)
+        return false;
+      // Fails if transparent huge pages are disabled in the kernel.
+      if (madvise(data, allocated_size_, MADV_HUGEPAGE) != 0) {
+        VLOG(1) << "No transparent huge pages for a buffer of " << size_
+                << " bytes.";
+        free(data);
+        return false;
+      }
+      break;
+#else
+      return false;
+#endif
+    case kHeapPages:
+      allocated_size_ = size_;
+      data = malloc(allocated_size_);
+      if (!data)
+        return false;
+      break;
+    default:
+      NOTREACHED() << "Unknown source " << source;
+      return false;
+  }
+  data_ = static_cast<uint8_t*>(data);
+  return true;
+}
+
+void LargeBuffer::SetHugePagePolicy(LargeBufferSource preferred_source) {
+  DCHECK_GE(preferred_source, 0);
+  DCHECK_LT(preferred_source, kNumLargeBufferSources);
+  base::subtle::NoBarrier_Store(&g_policy, preferred_source);
+}
+
+LargeBufferSource LargeBuffer::GetHugePagePolicy() {
+  return static_cast<LargeBufferSource>(
+      base::subtle::NoBarrier_Load(&g_policy));
+}
+
+bool LargeBuffer::ParseHugePagePolicy(const std::string& name,
+                                      LargeBufferSource* preferred_source) {
+  DCHECK(preferred_source);
+  for (int i = 0; i < kNumLargeBufferSources; ++i) {
+    if (name == kPolicyNames[i]) {
+      *preferred_source = static_cast<LargeBufferSource>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+uint64_t LargeBuffer::GetAllocatedBytes(LargeBufferSource source) {
+  DCHECK_GE(source, 0);
+  DCHECK_LT(source, kNumLargeBufferSources);
+  return base::subtle::NoBarrier_Load(&g_allocated_bytes[source]);
+}
+
+uint64_t LargeBuffer::GetNumBuffers(LargeBufferSource source) {
+  DCHECK_GE(source, 0);
+  DCHECK_LT(source, kNumLargeBufferSources);
+  return base::subtle::NoBarrier_Load(&g_num_buffers[source]);
+}
+
+const char* LargeBuffer::GetSourceName(LargeBufferSource source) {
+  DCHECK_GE(source, 0);
+  DCHECK_LT(source, kNumLargeBufferSources);
+  return kSourceNames[source];
+}
+
+std::string LargeBuffer::ToPrometheusText() {
+  std::string text =
+      "# HELP packager_large_buffer_bytes Memory of the large buffers of the "
+      "demuxers and of the I/O caches, by source.\n"
+      "# TYPE packager_large_buffer_bytes gauge\n";
+  for (int i = 0; i < kNumLargeBufferSources; ++i) {
+    const LargeBufferSource source = static_cast<LargeBufferSource>(i);
+    text += std::string("packager_large_buffer_bytes{source=\"") +
+            kSourceNames[i] + "\"} " +
+            base::Uint64ToString(GetAllocatedBytes(source)) + "\n";
+  }
+  text +=
+      "# HELP packager_large_buffers Number of large buffers, by source.\n"
+      "# TYPE packager_large_buffers gauge\n";
+  for (int i = 0; i < kNumLargeBufferSources; ++i) {
+    const LargeBufferSource source = static_cast<LargeBufferSource>(i);
+    text += std::string("packager_large_buffers{source=\"") +
+            kSourceNames[i] + "\"} " +
+            base::Uint64ToString(GetNumBuffers(source)) + "\n";
+  }
+  return text;
+}
+
+std::string LargeBuffer::ToJson() {
+  std::string json = "{";
+  for (int i = 0; i < kNumLargeBufferSources; ++i) {
+    const LargeBufferSource source = static_cast<LargeBufferSource>(i);
+    if (i > 0)
+      json += ",";
+    json += std::string("\"") + kSourceNames[i] + "\":{\"bytes\":" +
+            base::Uint64ToString(GetAllocatedBytes(source)) +
+            ",\"buffers\":" + base::Uint64ToString(GetNumBuffers(source)) +
+            "}";
+  }
+  json += "}";
+  return json;
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,103 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_BASE_LARGE_BUFFER_H_
+#define MEDIA_BASE_LARGE_BUFFER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "packager/base/macros.h"
+
+namespace edash_packager {
+namespace media {
+
+/// Sources of the memory of the LargeBuffers, in the order of preference of
+/// the huge page policy: a buffer which cannot be allocated from a source
+/// falls back to the next one.
+enum LargeBufferSource {
+  /// Explicit huge pages, reserved in /proc/sys/vm/nr_hugepages.
+  kExplicitHugePages,
+  /// Transparent huge pages, which the kernel may back the buffer with.
+  kTransparentHugePages,
+  /// Regular pages of the heap.
+  kHeapPages,
+  kNumLargeBufferSources,
+};
+
+/// A fixed size buffer for the large, long-lived buffers of the pipeline,
+/// i.e. the read buffers of the Demuxers and the IoCaches of the threaded
+/// files. With many streams, these buffers take many TLB entries when backed
+/// by regular pages, so they are allocated from huge pages according to a
+/// process-wide policy, see SetHugePagePolicy(). The content of the buffer
+/// is not initialized.
+///
+/// Thread Safety: A LargeBuffer is not thread safe. The static methods can be
+/// called from any thread.
+class LargeBuffer {
+ public:
+  /// Size of the huge pages. The size of the buffers allocated from huge
+  /// pages is rounded up to a multiple of it.
+  static const size_t kHugePageSize = 2 * 1024 * 1024;
+
+  /// @param size is the size of the buffer, in bytes. Buffers smaller than
+  ///        kHugePageSize are always allocated from the heap, to not waste
+  ///        most of a huge page.
+  explicit LargeBuffer(size_t size);
+  ~LargeBuffer();
+
+  uint8_t* data() { return data_; }
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+  /// @return the source the buffer was actually allocated from.
+  LargeBufferSource source() const { return source_; }
+
+  /// Sets the preferred source of the buffers allocated from then on. The
+  /// default is kHeapPages, i.e. no huge pages.
+  static void SetHugePagePolicy(LargeBufferSource preferred_source);
+  static LargeBufferSource GetHugePagePolicy();
+
+  /// Parses a huge page policy: "none", "transparent" or "explicit".
+  /// @return true on success, false if @a name is not a policy.
+  static bool ParseHugePagePolicy(const std::string& name,
+                                  LargeBufferSource* preferred_source);
+
+  /// @return the memory of the live buffers allocated from @a source, in
+  ///         bytes, including the rounding to huge pages.
+  static uint64_t GetAllocatedBytes(LargeBufferSource source);
+
+  /// @return the number of live buffers allocated from @a source.
+  static uint64_t GetNumBuffers(LargeBufferSource source);
+
+  /// @return the name of @a source used in the exported usage.
+  static const char* GetSourceName(LargeBufferSource source);
+
+  /// @return the memory of the buffers by source in the Prometheus text
+  ///         exposition format.
+  static std::string ToPrometheusText();
+
+  /// @return the memory of the buffers by source as a JSON object.
+  static std::string ToJson();
+
+ private:
+  // Allocates |size_| bytes from |source|, rounded up to |allocated_size_|.
+  // Returns false if the source is not available.
+  bool Allocate(LargeBufferSource source);
+
+  uint8_t* data_;
+  size_t size_;
+  size_t allocated_size_;
+  LargeBufferSource source_;
+
+  DISALLOW_COPY_AND_ASSIGN(LargeBuffer);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_BASE_LARGE_BUFFER_H_
@@ -0,0 +1,107 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+#include <string.h>
+
+#include "packager/media/base/large_buffer.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+const size_t kLargeBufferSize = 3 * LargeBuffer::kHugePageSize + 1;
+const size_t kSmallBufferSize = 1000;
+
+uint64_t GetTotalAllocatedBytes() {
+  uint64_t bytes = 0;
+  for (int i = 0; i < kNumLargeBufferSources; ++i)
+    bytes += LargeBuffer::GetAllocatedBytes(static_cast<LargeBufferSource>(i));
+  return bytes;
+}
+}  // namespace
+
+class LargeBufferTest : public ::testing::Test {
+ public:
+  void TearDown() override { LargeBuffer::SetHugePagePolicy(kHeapPages); }
+};
+
+TEST_F(LargeBufferTest, HeapPolicy) {
+  const uint64_t initial_heap_bytes =
+      LargeBuffer::GetAllocatedBytes(kHeapPages);
+  const uint64_t initial_heap_buffers = LargeBuffer::GetNumBuffers(kHeapPages);
+  {
+    LargeBuffer buffer(kLargeBufferSize);
+    EXPECT_EQ(kHeapPages, buffer.source());
+    ASSERT_TRUE(buffer.data());
+    EXPECT_EQ(kLargeBufferSize, buffer.size());
+    memset(buffer.data(), 0xAB, buffer.size());
+    EXPECT_EQ(initial_heap_bytes + kLargeBufferSize,
+              LargeBuffer::GetAllocatedBytes(kHeapPages));
+    EXPECT_EQ(initial_heap_buffers + 1,
+              LargeBuffer::GetNumBuffers(kHeapPages));
+  }
+  EXPECT_EQ(initial_heap_bytes, LargeBuffer::GetAllocatedBytes(kHeapPages));
+  EXPECT_EQ(initial_heap_buffers, LargeBuffer::GetNumBuffers(kHeapPages));
+}
+
+// Huge pages may not be available on the test machine, so the buffers can
+// fall back to any source after the preferred one.
+TEST_F(LargeBufferTest, HugePagePolicies) {
+  const LargeBufferSource kPolicies[] = {kExplicitHugePages,
+                                         kTransparentHugePages};
+  for (LargeBufferSource policy : kPolicies) {
+    LargeBuffer::SetHugePagePolicy(policy);
+    EXPECT_EQ(policy, LargeBuffer::GetHugePagePolicy());
+    const uint64_t initial_bytes = GetTotalAllocatedBytes();
+    {
+      LargeBuffer buffer(kLargeBufferSize);
+      EXPECT_GE(buffer.source(), policy);
+      ASSERT_TRUE(buffer.data());
+      memset(buffer.data(), 0xAB, buffer.size());
+      EXPECT_LE(initial_bytes + kLargeBufferSize, GetTotalAllocatedBytes());
+      if (buffer.source() != kHeapPages) {
+        EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(buffer.data()) %
+                          LargeBuffer::kHugePageSize);
+      }
+    }
+    EXPECT_EQ(initial_bytes, GetTotalAllocatedBytes());
+  }
+}
+
+TEST_F(LargeBufferTest, SmallBufferFromHeap) {
+  LargeBuffer::SetHugePagePolicy(kExplicitHugePages);
+  LargeBuffer buffer(kSmallBufferSize);
+  EXPECT_EQ(kHeapPages, buffer.source());
+  ASSERT_TRUE(buffer.data());
+  EXPECT_EQ(kSmallBufferSize, buffer.size());
+}
+
+TEST_F(LargeBufferTest, ParseHugePagePolicy) {
+  LargeBufferSource policy = kNumLargeBufferSources;
+  ASSERT_TRUE(LargeBuffer::ParseHugePagePolicy("none", &policy));
+  EXPECT_EQ(kHeapPages, policy);
+  ASSERT_TRUE(LargeBuffer::ParseHugePagePolicy("transparent", &policy));
+  EXPECT_EQ(kTransparentHugePages, policy);
+  ASSERT_TRUE(LargeBuffer::ParseHugePagePolicy("explicit", &policy));
+  EXPECT_EQ(kExplicitHugePages, policy);
+  EXPECT_FALSE(LargeBuffer::ParseHugePagePolicy("huge", &policy));
+}
+
+TEST_F(LargeBufferTest, ExportedUsage) {
+  LargeBuffer buffer(kLargeBufferSize);
+  const std::string text = LargeBuffer::ToPrometheusText();
+  EXPECT_NE(std::string::npos,
+            text.find("packager_large_buffer_bytes{source=\"heap\"}"));
+  EXPECT_NE(std::string::npos, text.find("packager_large_buffers{source="
+                                         "\"explicit_huge_pages\"}"));
+  const std::string json = LargeBuffer::ToJson();
+  EXPECT_EQ('{', json[0]);
+  EXPECT_NE(std::string::npos, json.find("\"transparent_huge_pages\":{"));
+}
+
+}  // namespace media
+}  // namespace edash_packager
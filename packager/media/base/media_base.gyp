@@ -12,6 +12,7 @@
     {
       'target_name': 'media_base',
       'type': '<(component)',
+      'includes': ['../../hot_code.gypi'],
       'sources': [
         'aes_cryptor.cc',
         'aes_cryptor.h',
@@ -21,45 +22,85 @@
         'aes_encryptor.h',
         'aes_pattern_cryptor.cc',
         'aes_pattern_cryptor.h',
+        'async_log_sink.cc',
+        'async_log_sink.h',
         'audio_stream_info.cc',
         'audio_stream_info.h',
         'audio_timestamp_helper.cc',
         'audio_timestamp_helper.h',
+        'background_executor.cc',
+        'background_executor.h',
         'bit_reader.cc',
         'bit_reader.h',
+        'buffer_chain.cc',
+        'buffer_chain.h',
         'buffer_reader.cc',
         'buffer_reader.h',
         'buffer_writer.cc',
         'buffer_writer.h',
         'byte_queue.cc',
         'byte_queue.h',
+        'cancellation_token.cc',
+        'cancellation_token.h',
         'closure_thread.cc',
         'closure_thread.h',
+        'curl_share.cc',
+        'curl_share.h',
+        'coalescing_writer.cc',
+        'coalescing_writer.h',
         'container_names.cc',
         'container_names.h',
+        'cpu_affinity.cc',
+        'cpu_affinity.h',
+        'cpu_features.cc',
+        'cpu_features.h',
+        'crypto_context_cache.cc',
+        'crypto_context_cache.h',
+        'delayed_task_queue.cc',
+        'delayed_task_queue.h',
         'demuxer.cc',
         'demuxer.h',
+        'demuxer_pool.cc',
+        'demuxer_pool.h',
         'decrypt_config.cc',
         'decrypt_config.h',
         'decryptor_source.cc',
         'decryptor_source.h',
+        'encryption_config.cc',
+        'encryption_config.h',
         'encryption_modes.h',
         'fixed_key_source.cc',
         'fixed_key_source.h',
         'fourccs.h',
+        'hot_path.h',
         'http_key_fetcher.cc',
         'http_key_fetcher.h',
         'key_fetcher.cc',
         'key_fetcher.h',
+        'key_rotation_schedule.cc',
+        'key_rotation_schedule.h',
         'key_source.cc',
         'key_source.h',
+        'io_throttle.cc',
+        'io_throttle.h',
+        'job_resource_usage.cc',
+        'job_resource_usage.h',
+        'large_buffer.cc',
+        'large_buffer.h',
         'limits.h',
         'macros.h',
+        'media_index_cache.cc',
+        'media_index_cache.h',
         'media_parser.h',
+        'media_kernels.cc',
+        'media_kernels.h',
         'media_sample.cc',
         'media_sample.h',
         'media_stream.cc',
         'media_stream.h',
+        'memory_tracker.cc',
+        'memory_tracker.h',
+        'mpmc_queue.h',
         'muxer.cc',
         'muxer.h',
         'muxer_options.cc',
@@ -70,6 +111,8 @@
         'network_util.h',
         'offset_byte_queue.cc',
         'offset_byte_queue.h',
+        'pipeline_metrics.cc',
+        'pipeline_metrics.h',
         'producer_consumer_queue.h',
         'protection_system_specific_info.cc',
         'protection_system_specific_info.h',
@@ -78,6 +121,19 @@
         'request_signer.h',
         'rsa_key.cc',
         'rsa_key.h',
+        'sample_buffer_pool.cc',
+        'sample_buffer_pool.h',
+        'sample_slab_allocator.cc',
+        'sample_slab_allocator.h',
+        'sample_spill_queue.cc',
+        'sample_spill_queue.h',
+        'segment_checksum.cc',
+        'segment_checksum.h',
+        'shared_buffer.cc',
+        'shared_buffer.h',
+        'shared_demuxer.cc',
+        'shared_demuxer.h',
+        'spsc_ring_buffer.h',
         'status.cc',
         'status.h',
         'stream_info.cc',
@@ -87,21 +143,42 @@
         'text_track.h',
         'text_track_config.cc',
         'text_track_config.h',
+        'thread_pool.cc',
+        'thread_pool.h',
+        'timed_metadata.cc',
+        'timed_metadata.h',
         'timestamp.h',
+        'timestamp_unroller.cc',
+        'timestamp_unroller.h',
         'video_stream_info.cc',
         'video_stream_info.h',
         'widevine_key_source.cc',
         'widevine_key_source.h',
       ],
       'dependencies': [
+        'media_index_proto',
         'widevine_pssh_data_proto',
         '../../base/base.gyp:base',
         '../../third_party/boringssl/boringssl.gyp:boringssl',
         '../../third_party/curl/curl.gyp:libcurl',
+        '../../third_party/gflags/gflags.gyp:gflags',
         '../../third_party/libxml/libxml.gyp:libxml',
         '../../version/version.gyp:version',
       ],
     },
+    {
+      'target_name': 'media_index_proto',
+      'type': '<(component)',
+      'sources': ['media_index.proto'],
+      'variables': {
+        'proto_in_dir': '.',
+        'proto_out_dir': 'packager/media/base',
+      },
+      'includes': ['../../build/protoc.gypi'],
+      'dependencies': [
+        '../../third_party/protobuf/protobuf.gyp:protobuf_lite',
+      ],
+    },
     {
       'target_name': 'widevine_pssh_data_proto',
       'type': '<(component)',
@@ -121,19 +198,45 @@
       'sources': [
         'aes_cryptor_unittest.cc',
         'aes_pattern_cryptor_unittest.cc',
+        'async_log_sink_unittest.cc',
         'audio_timestamp_helper_unittest.cc',
+        'background_executor_unittest.cc',
         'bit_reader_unittest.cc',
+        'buffer_chain_unittest.cc',
         'buffer_writer_unittest.cc',
+        'cancellation_token_unittest.cc',
         'closure_thread_unittest.cc',
+        'coalescing_writer_unittest.cc',
         'container_names_unittest.cc',
+        'cpu_affinity_unittest.cc',
+        'crypto_context_cache_unittest.cc',
         'decryptor_source_unittest.cc',
+        'delayed_task_queue_unittest.cc',
+        'demuxer_pool_unittest.cc',
         'fixed_key_source_unittest.cc',
         'http_key_fetcher_unittest.cc',
+        'io_throttle_unittest.cc',
+        'job_resource_usage_unittest.cc',
+        'key_rotation_schedule_unittest.cc',
+        'large_buffer_unittest.cc',
+        'media_index_cache_unittest.cc',
+        'media_kernels_unittest.cc',
+        'media_sample_unittest.cc',
+        'memory_tracker_unittest.cc',
+        'mpmc_queue_unittest.cc',
         'muxer_util_unittest.cc',
         'offset_byte_queue_unittest.cc',
+        'pipeline_metrics_unittest.cc',
         'producer_consumer_queue_unittest.cc',
         'protection_system_specific_info_unittest.cc',
+        'request_signer_unittest.cc',
         'rsa_key_unittest.cc',
+        'sample_buffer_pool_unittest.cc',
+        'sample_slab_allocator_unittest.cc',
+        'sample_spill_queue_unittest.cc',
+        'segment_checksum_unittest.cc',
+        'shared_demuxer_unittest.cc',
+        'spsc_ring_buffer_unittest.cc',
         'status_test_util_unittest.cc',
         'status_unittest.cc',
         'test/fake_prng.cc',  # For rsa_key_unittest
@@ -141,6 +244,8 @@
         'test/rsa_test_data.cc',  # For rsa_key_unittest
         'test/rsa_test_data.h',   # For rsa_key_unittest
         'test/status_test_util.h',
+        'thread_pool_unittest.cc',
+        'timestamp_unroller_unittest.cc',
         'widevine_key_source_unittest.cc',
       ],
       'dependencies': [
@@ -152,5 +257,21 @@
         'media_base',
       ],
     },
+    {
+      'target_name': 'media_base_perftest',
+      'type': '<(gtest_target_type)',
+      'sources': [
+        'aes_cryptor_perftest.cc',
+        'rsa_key_perftest.cc',
+        'test/rsa_test_data.cc',
+        'test/rsa_test_data.h',
+      ],
+      'dependencies': [
+        '../../testing/gtest.gyp:gtest',
+        '../../testing/perf/perf_test.gyp:perf_test',
+        '../test/media_test.gyp:media_test_support',
+        'media_base',
+      ],
+    },
   ],
 }
@@ -0,0 +1,113 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/media_index_cache.h"
+
+#include "packager/base/files/file.h"
+#include "packager/base/files/file_path.h"
+#include "packager/base/files/file_util.h"
+#include "packager/base/logging.h"
+#include "packager/base/sha1.h"
+#include "packager/base/strings/string_number_conversions.h"
+#include "packager/media/file/file.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+// The version of the index format, to be incremented whenever the content or
+// the meaning of an index changes.
+const uint32_t kMediaIndexVersion = 1;
+
+}  // namespace
+
+MediaIndexCache::MediaIndexCache(const std::string& cache_dir)
+    : cache_dir_(cache_dir) {}
+
+MediaIndexCache::~MediaIndexCache() {}
+
+bool MediaIndexCache::Lookup(const std::string& file_name,
+                             MediaIndex* index) const {
+  DCHECK(index);
+  std::string path;
+  int64_t file_size = 0;
+  int64_t modification_time = 0;
+  if (!GetIdentity(file_name, &path, &file_size, &modification_time))
+    return false;
+
+  std::string contents;
+  if (!File::ReadFileToString(GetIndexFileName(path).c_str(), &contents))
+    return false;
+  if (!index->ParseFromString(contents)) {
+    LOG(WARNING) << "Ignoring the corrupted media index of " << file_name;
+    return false;
+  }
+  if (index->version() != kMediaIndexVersion || index->file_name() != path ||
+      index->file_size() != file_size ||
+      index->modification_time() != modification_time) {
+    VLOG(1) << "The media index of " << file_name << " is out of date.";
+    return false;
+  }
+  VLOG(1) << "Found the media index of " << file_name;
+  return true;
+}
+
+bool MediaIndexCache::Store(const std::string& file_name,
+                            MediaIndex* index) const {
+  DCHECK(index);
+  std::string path;
+  int64_t file_size = 0;
+  int64_t modification_time = 0;
+  if (!GetIdentity(file_name, &path, &file_size, &modification_time))
+    return false;
+
+  index->set_version(kMediaIndexVersion);
+  index->set_file_name(path);
+  index->set_file_size(file_size);
+  index->set_modification_time(modification_time);
+  std::string contents;
+  if (!index->SerializeToString(&contents) ||
+      !File::WriteFileAtomically(GetIndexFileName(path).c_str(), contents)) {
+    LOG(WARNING) << "Failed to store the media index of " << file_name;
+    return false;
+  }
+  return true;
+}
+
+bool MediaIndexCache::GetIdentity(const std::string& file_name,
+                                  std::string* path,
+                                  int64_t* file_size,
+                                  int64_t* modification_time) const {
+  const std::string local_file_prefix(kLocalFilePrefix);
+  std::string local_path = file_name;
+  if (file_name.compare(0, local_file_prefix.size(), local_file_prefix) == 0)
+    local_path = file_name.substr(local_file_prefix.size());
+  else if (file_name.find("://") != std::string::npos)
+    return false;
+
+  const base::FilePath absolute_path =
+      base::MakeAbsoluteFilePath(base::FilePath(local_path));
+  base::File::Info info;
+  if (absolute_path.empty() || !base::GetFileInfo(absolute_path, &info) ||
+      info.is_directory) {
+    return false;
+  }
+  *path = absolute_path.value();
+  *file_size = info.size;
+  *modification_time = info.last_modified.ToInternalValue();
+  return true;
+}
+
+std::string MediaIndexCache::GetIndexFileName(const std::string& path) const {
+  const std::string hash = base::SHA1HashString(path);
+  return base::FilePath(cache_dir_)
+      .Append(base::HexEncode(hash.data(), hash.size()) + ".index")
+      .value();
+}
+
+}  // namespace media
+}  // namespace edash_packager
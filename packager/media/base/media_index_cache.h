@@ -0,0 +1,67 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_BASE_MEDIA_INDEX_CACHE_H_
+#define MEDIA_BASE_MEDIA_INDEX_CACHE_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "packager/base/macros.h"
+#include "packager/media/base/media_index.pb.h"
+
+namespace edash_packager {
+namespace media {
+
+/// A persistent cache of the indexes of the inputs, see MediaIndex, so that
+/// an input packaged again, e.g. with other keys or another ladder, is not
+/// parsed again: the Demuxer gets the container, the 'moov' box of an ISO
+/// BMFF input and the key frame times of its tracks from the cache. The
+/// index of an input is stored in a file of the cache directory named after
+/// the input, and is used as long as the input keeps the same size and
+/// modification time. Only local inputs are indexed.
+/// Thread Safety: the indexes are written atomically, so the cache can be
+/// shared by concurrent jobs and processes.
+class MediaIndexCache {
+ public:
+  /// @param cache_dir is the directory of the index files. It should exist.
+  explicit MediaIndexCache(const std::string& cache_dir);
+  ~MediaIndexCache();
+
+  /// Look up the index of an input.
+  /// @param file_name is the name of the input.
+  /// @param[out] index receives the index.
+  /// @return true if the cache has an index of the input in its current
+  ///         state, false otherwise.
+  bool Lookup(const std::string& file_name, MediaIndex* index) const;
+
+  /// Store the index of an input.
+  /// @param file_name is the name of the input.
+  /// @param index is the index. Its version and the identity of the input
+  ///        are set.
+  /// @return true on success, false if the input is not local or the index
+  ///         cannot be written.
+  bool Store(const std::string& file_name, MediaIndex* index) const;
+
+ private:
+  // Gets the identity of |file_name|, which is then named by its absolute
+  // |path|. Returns false if it is not a local file.
+  bool GetIdentity(const std::string& file_name,
+                   std::string* path,
+                   int64_t* file_size,
+                   int64_t* modification_time) const;
+  std::string GetIndexFileName(const std::string& path) const;
+
+  const std::string cache_dir_;
+
+  DISALLOW_COPY_AND_ASSIGN(MediaIndexCache);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_BASE_MEDIA_INDEX_CACHE_H_
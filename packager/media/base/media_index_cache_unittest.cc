@@ -0,0 +1,95 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+
+#include "packager/base/files/file_util.h"
+#include "packager/base/files/scoped_temp_dir.h"
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/media/base/container_names.h"
+#include "packager/media/base/media_index_cache.h"
+#include "packager/media/file/file.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+const char kContents[] = "media";
+const char kMoreContents[] = " grown";
+const uint32_t kTrackId = 1;
+const int64_t kKeyFrameTimes[] = {0, 90000, 180000};
+}  // namespace
+
+class MediaIndexCacheTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(cache_dir_.CreateUniqueTempDir());
+    ASSERT_TRUE(input_dir_.CreateUniqueTempDir());
+    input_path_ = input_dir_.path().AppendASCII("input.mp4");
+    ASSERT_EQ(static_cast<int>(arraysize(kContents) - 1),
+              base::WriteFile(input_path_, kContents,
+                              arraysize(kContents) - 1));
+    cache_.reset(new MediaIndexCache(cache_dir_.path().value()));
+  }
+
+  MediaIndex CreateIndex() const {
+    MediaIndex index;
+    index.set_container(CONTAINER_MOV);
+    index.set_moov_offset(32);
+    index.set_moov("moov");
+    MediaIndex::Track* track = index.add_track();
+    track->set_track_id(kTrackId);
+    for (int64_t key_frame_time : kKeyFrameTimes)
+      track->add_key_frame_time(key_frame_time);
+    return index;
+  }
+
+  base::ScopedTempDir cache_dir_;
+  base::ScopedTempDir input_dir_;
+  base::FilePath input_path_;
+  scoped_ptr<MediaIndexCache> cache_;
+};
+
+TEST_F(MediaIndexCacheTest, StoreAndLookup) {
+  MediaIndex index;
+  EXPECT_FALSE(cache_->Lookup(input_path_.value(), &index));
+
+  index = CreateIndex();
+  ASSERT_TRUE(cache_->Store(input_path_.value(), &index));
+
+  MediaIndex cached_index;
+  // The input is identified by its path, with or without prefix.
+  ASSERT_TRUE(cache_->Lookup(std::string(kLocalFilePrefix) +
+                                 input_path_.value(),
+                             &cached_index));
+  EXPECT_EQ(CONTAINER_MOV, cached_index.container());
+  EXPECT_EQ(32u, cached_index.moov_offset());
+  EXPECT_EQ("moov", cached_index.moov());
+  ASSERT_EQ(1, cached_index.track_size());
+  EXPECT_EQ(kTrackId, cached_index.track(0).track_id());
+  ASSERT_EQ(static_cast<int>(arraysize(kKeyFrameTimes)),
+            cached_index.track(0).key_frame_time_size());
+  EXPECT_EQ(kKeyFrameTimes[2], cached_index.track(0).key_frame_time(2));
+}
+
+TEST_F(MediaIndexCacheTest, ModifiedInputIsNotFound) {
+  MediaIndex index = CreateIndex();
+  ASSERT_TRUE(cache_->Store(input_path_.value(), &index));
+
+  ASSERT_TRUE(base::AppendToFile(input_path_, kMoreContents,
+                                 arraysize(kMoreContents) - 1));
+  MediaIndex cached_index;
+  EXPECT_FALSE(cache_->Lookup(input_path_.value(), &cached_index));
+}
+
+TEST_F(MediaIndexCacheTest, RemoteInputIsNotIndexed) {
+  MediaIndex index = CreateIndex();
+  EXPECT_FALSE(cache_->Store("http://example.com/input.mp4", &index));
+  EXPECT_FALSE(cache_->Lookup("http://example.com/input.mp4", &index));
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,298 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/media_kernels.h"
+
+#include <string.h>
+
+#include "packager/base/atomicops.h"
+#include "packager/base/lazy_instance.h"
+#include "packager/build/build_config.h"
+#include "packager/media/base/cpu_features.h"
+
+#if defined(ARCH_CPU_X86_FAMILY)
+#include <emmintrin.h>
+#include <immintrin.h>
+#include <nmmintrin.h>
+#endif
+
+// The SIMD kernels are compiled for their instruction set whatever the
+// target of the build, and only called if the CPU supports it.
+#if defined(ARCH_CPU_X86_FAMILY) && defined(COMPILER_GCC)
+#define KERNEL_TARGET(isa) __attribute__((target(isa)))
+#else
+#define KERNEL_TARGET(isa)
+#endif
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+// Reflected CRC32C polynomial.
+const uint32_t kCrc32cPolynomial = 0x82f63b78;
+
+struct Crc32cTable {
+  Crc32cTable() {
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t crc = i;
+      for (int bit = 0; bit < 8; ++bit)
+        crc = (crc >> 1) ^ (crc & 1 ? kCrc32cPolynomial : 0);
+      entries[i] = crc;
+    }
+  }
+
+  uint32_t entries[256];
+};
+
+base::LazyInstance<Crc32cTable>::Leaky g_crc32c_table =
+    LAZY_INSTANCE_INITIALIZER;
+
+// Scalar kernels.
+
+// Continues the scan of FindStartCodeScalar() from |i|, the position of the
+// last byte of the next candidate.
+uint64_t FindStartCodeFrom(const uint8_t* data,
+                           uint64_t data_size,
+                           uint64_t i) {
+  while (i < data_size) {
+    if (data[i] > 0x01) {
+      // None of the candidates ending at i, i + 1 and i + 2 can match.
+      i += 3;
+    } else if (data[i] == 0x01) {
+      if (data[i - 1] == 0x00 && data[i - 2] == 0x00)
+        return i - 2;
+      i += 3;
+    } else {
+      ++i;
+    }
+  }
+  return data_size;
+}
+
+uint64_t FindStartCodeScalar(const uint8_t* data, uint64_t data_size) {
+  // |i| is the position of the last byte (0x01) of a candidate start code.
+  return FindStartCodeFrom(data, data_size, 2);
+}
+
+size_t FindEscapeCandidateScalar(const uint8_t* data,
+                                 size_t data_size,
+                                 size_t position) {
+  size_t i = position;
+  while (i + 3 <= data_size) {
+    if (data[i + 2] > 0x03) {
+      // None of the candidates starting at i, i + 1 and i + 2 can match.
+      i += 3;
+    } else if (data[i] == 0x00 && data[i + 1] == 0x00) {
+      return i;
+    } else {
+      ++i;
+    }
+  }
+  return data_size;
+}
+
+uint32_t Crc32cScalar(uint32_t crc, const uint8_t* data, size_t size) {
+  const Crc32cTable& table = g_crc32c_table.Get();
+  crc = ~crc;
+  for (; size > 0; --size)
+    crc = table.entries[(crc ^ *data++) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+#if defined(ARCH_CPU_X86_FAMILY)
+
+// SSE2 kernels: check 16 candidates at once.
+
+KERNEL_TARGET("sse2")
+uint64_t FindStartCodeSse2(const uint8_t* data, uint64_t data_size) {
+  const __m128i kZeros = _mm_setzero_si128();
+  const __m128i kOnes = _mm_set1_epi8(1);
+  uint64_t i = 2;
+  for (; i + 16 <= data_size; i += 16) {
+    const __m128i last_bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    const __m128i middle_bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i - 1));
+    const __m128i first_bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i - 2));
+    const __m128i matches = _mm_and_si128(
+        _mm_cmpeq_epi8(last_bytes, kOnes),
+        _mm_and_si128(_mm_cmpeq_epi8(middle_bytes, kZeros),
+                      _mm_cmpeq_epi8(first_bytes, kZeros)));
+    const int mask = _mm_movemask_epi8(matches);
+    if (mask)
+      return i - 2 + __builtin_ctz(mask);
+  }
+  return FindStartCodeFrom(data, data_size, i);
+}
+
+KERNEL_TARGET("sse2")
+size_t FindEscapeCandidateSse2(const uint8_t* data,
+                               size_t data_size,
+                               size_t position) {
+  const __m128i kZeros = _mm_setzero_si128();
+  const __m128i kThrees = _mm_set1_epi8(3);
+  size_t i = position;
+  for (; i + 18 <= data_size; i += 16) {
+    const __m128i first_bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    const __m128i second_bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 1));
+    const __m128i third_bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 2));
+    // Unsigned third byte <= 3 iff min(third byte, 3) == third byte.
+    const __m128i matches = _mm_and_si128(
+        _mm_cmpeq_epi8(_mm_min_epu8(third_bytes, kThrees), third_bytes),
+        _mm_and_si128(_mm_cmpeq_epi8(first_bytes, kZeros),
+                      _mm_cmpeq_epi8(second_bytes, kZeros)));
+    const int mask = _mm_movemask_epi8(matches);
+    if (mask)
+      return i + __builtin_ctz(mask);
+  }
+  return FindEscapeCandidateScalar(data, data_size, i);
+}
+
+// AVX2 kernels: check 32 candidates at once, then the remaining ones with
+// the SSE2 kernels.
+
+KERNEL_TARGET("avx2")
+uint64_t FindStartCodeAvx2(const uint8_t* data, uint64_t data_size) {
+  const __m256i kZeros = _mm256_setzero_si256();
+  const __m256i kOnes = _mm256_set1_epi8(1);
+  uint64_t i = 2;
+  for (; i + 32 <= data_size; i += 32) {
+    const __m256i last_bytes =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+    const __m256i middle_bytes =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i - 1));
+    const __m256i first_bytes =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i - 2));
+    const __m256i matches = _mm256_and_si256(
+        _mm256_cmpeq_epi8(last_bytes, kOnes),
+        _mm256_and_si256(_mm256_cmpeq_epi8(middle_bytes, kZeros),
+                         _mm256_cmpeq_epi8(first_bytes, kZeros)));
+    const uint32_t mask = _mm256_movemask_epi8(matches);
+    if (mask)
+      return i - 2 + __builtin_ctz(mask);
+  }
+  // No start code ends before |i|, so none starts before |i - 2|.
+  const uint64_t start = i - 2;
+  return start + FindStartCodeSse2(data + start, data_size - start);
+}
+
+KERNEL_TARGET("avx2")
+size_t FindEscapeCandidateAvx2(const uint8_t* data,
+                               size_t data_size,
+                               size_t position) {
+  const __m256i kZeros = _mm256_setzero_si256();
+  const __m256i kThrees = _mm256_set1_epi8(3);
+  size_t i = position;
+  for (; i + 34 <= data_size; i += 32) {
+    const __m256i first_bytes =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+    const __m256i second_bytes =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 1));
+    const __m256i third_bytes =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 2));
+    const __m256i matches = _mm256_and_si256(
+        _mm256_cmpeq_epi8(_mm256_min_epu8(third_bytes, kThrees), third_bytes),
+        _mm256_and_si256(_mm256_cmpeq_epi8(first_bytes, kZeros),
+                         _mm256_cmpeq_epi8(second_bytes, kZeros)));
+    const uint32_t mask = _mm256_movemask_epi8(matches);
+    if (mask)
+      return i + __builtin_ctz(mask);
+  }
+  return FindEscapeCandidateSse2(data, data_size, i);
+}
+
+// SSE4.2 kernels.
+
+KERNEL_TARGET("sse4.2")
+uint32_t Crc32cSse42(uint32_t crc, const uint8_t* data, size_t size) {
+  crc = ~crc;
+#if defined(ARCH_CPU_X86_64)
+  uint64_t crc64 = crc;
+  for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t)) {
+    uint64_t value;
+    memcpy(&value, data, sizeof(value));
+    crc64 = _mm_crc32_u64(crc64, value);
+    data += sizeof(value);
+  }
+  crc = static_cast<uint32_t>(crc64);
+#endif
+  for (; size >= sizeof(uint32_t); size -= sizeof(uint32_t)) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    crc = _mm_crc32_u32(crc, value);
+    data += sizeof(value);
+  }
+  for (; size > 0; --size)
+    crc = _mm_crc32_u8(crc, *data++);
+  return ~crc;
+}
+
+#endif  // defined(ARCH_CPU_X86_FAMILY)
+
+const MediaKernels kScalarKernels = {
+    &FindStartCodeScalar, &FindEscapeCandidateScalar, &Crc32cScalar,
+};
+
+// The kernel tables the CPU supports, each one adding the kernels of an
+// instruction set to the previous one.
+struct SupportedKernels {
+  SupportedKernels() {
+    MediaKernels kernels = kScalarKernels;
+    tables.push_back(kernels);
+#if defined(ARCH_CPU_X86_FAMILY)
+    const CpuFeatures& features = GetCpuFeatures();
+    if (features.has_sse2) {
+      kernels.find_start_code = &FindStartCodeSse2;
+      kernels.find_escape_candidate = &FindEscapeCandidateSse2;
+      tables.push_back(kernels);
+    }
+    if (features.has_sse42) {
+      kernels.crc32c = &Crc32cSse42;
+      tables.push_back(kernels);
+    }
+    if (features.has_sse2 && features.has_avx2) {
+      kernels.find_start_code = &FindStartCodeAvx2;
+      kernels.find_escape_candidate = &FindEscapeCandidateAvx2;
+      tables.push_back(kernels);
+    }
+#endif
+  }
+
+  std::vector<MediaKernels> tables;
+};
+
+base::LazyInstance<SupportedKernels>::Leaky g_supported_kernels =
+    LAZY_INSTANCE_INITIALIZER;
+
+base::subtle::Atomic32 g_force_scalar = 0;
+
+}  // namespace
+
+const MediaKernels& GetMediaKernels() {
+  if (base::subtle::NoBarrier_Load(&g_force_scalar))
+    return kScalarKernels;
+  return g_supported_kernels.Get().tables.back();
+}
+
+const MediaKernels& GetScalarMediaKernels() {
+  return kScalarKernels;
+}
+
+std::vector<MediaKernels> GetSupportedMediaKernels() {
+  return g_supported_kernels.Get().tables;
+}
+
+void ForceScalarMediaKernels(bool force_scalar) {
+  base::subtle::NoBarrier_Store(&g_force_scalar, force_scalar ? 1 : 0);
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,61 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+//
+// The byte scanning and checksum kernels of the media pipeline, with SIMD
+// variants selected at runtime from the features of the CPU, so that a
+// single binary uses the best variant the CPU it runs on supports.
+
+#ifndef MEDIA_BASE_MEDIA_KERNELS_H_
+#define MEDIA_BASE_MEDIA_KERNELS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+namespace edash_packager {
+namespace media {
+
+/// A table of kernels. All the variants of a kernel return the same results.
+struct MediaKernels {
+  /// @return The position of the first three-byte start code, 00 00 01, in
+  ///         @a data, or @a data_size if there is none.
+  uint64_t (*find_start_code)(const uint8_t* data, uint64_t data_size);
+
+  /// @return The position of the first sequence 00 00 0x, where x <= 3, at
+  ///         or after @a position in @a data, i.e. of the first candidate
+  ///         for emulation prevention, or @a data_size if there is none.
+  size_t (*find_escape_candidate)(const uint8_t* data,
+                                  size_t data_size,
+                                  size_t position);
+
+  /// @return The CRC32C (Castagnoli) of @a data, continuing from @a crc,
+  ///         which is 0 for the first block.
+  uint32_t (*crc32c)(uint32_t crc, const uint8_t* data, size_t size);
+};
+
+/// @return The kernels for the CPU the packager runs on, or the scalar
+///         kernels if they are forced. Cheap enough to call per buffer.
+const MediaKernels& GetMediaKernels();
+
+/// @return The scalar reference kernels.
+const MediaKernels& GetScalarMediaKernels();
+
+/// @return The kernel tables the CPU supports, from the scalar kernels to
+///         the kernels GetMediaKernels() selects, e.g. to test each variant
+///         against the scalar reference.
+std::vector<MediaKernels> GetSupportedMediaKernels();
+
+/// Forces the scalar kernels, e.g. for testing or to rule out a SIMD kernel
+/// when investigating an issue.
+/// @param force_scalar is true to use the scalar kernels, false to select
+///        the kernels from the CPU features again.
+void ForceScalarMediaKernels(bool force_scalar);
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_BASE_MEDIA_KERNELS_H_
@@ -0,0 +1,135 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/media_kernels.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+const size_t kMaxSize = 200;
+const int kNumBuffers = 500;
+
+// Returns random bytes, mostly 0 to 3 so that the buffers are full of
+// near-misses, with a few start codes and escape candidates.
+std::vector<uint8_t> CreateBuffer(uint32_t* seed) {
+  std::vector<uint8_t> buffer;
+  *seed = *seed * 1103515245 + 12345;
+  const size_t size = (*seed >> 8) % kMaxSize;
+  for (size_t i = 0; i < size; ++i) {
+    *seed = *seed * 1103515245 + 12345;
+    const uint32_t value = *seed >> 16;
+    buffer.push_back(value % 4 == 0 ? static_cast<uint8_t>(value >> 8)
+                                    : static_cast<uint8_t>(value % 4));
+  }
+  return buffer;
+}
+
+}  // namespace
+
+class MediaKernelsTest : public ::testing::Test {
+ protected:
+  void TearDown() override { ForceScalarMediaKernels(false); }
+};
+
+TEST_F(MediaKernelsTest, FindStartCodeMatchesScalar) {
+  const MediaKernels& scalar = GetScalarMediaKernels();
+  for (const MediaKernels& kernels : GetSupportedMediaKernels()) {
+    uint32_t seed = 1;
+    for (int i = 0; i < kNumBuffers; ++i) {
+      const std::vector<uint8_t> buffer = CreateBuffer(&seed);
+      const uint8_t* data = buffer.empty() ? NULL : &buffer[0];
+      ASSERT_EQ(scalar.find_start_code(data, buffer.size()),
+                kernels.find_start_code(data, buffer.size()));
+    }
+  }
+}
+
+TEST_F(MediaKernelsTest, FindStartCode) {
+  const uint8_t kData[] = {0x12, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00,
+                           0x34, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+                           0x00, 0x00, 0x00, 0x00, 0x56, 0x00, 0x00, 0x01};
+  EXPECT_EQ(21u, GetMediaKernels().find_start_code(kData, sizeof(kData)));
+  EXPECT_EQ(20u, GetMediaKernels().find_start_code(kData, 20));
+}
+
+TEST_F(MediaKernelsTest, FindEscapeCandidateMatchesScalar) {
+  const MediaKernels& scalar = GetScalarMediaKernels();
+  for (const MediaKernels& kernels : GetSupportedMediaKernels()) {
+    uint32_t seed = 2;
+    for (int i = 0; i < kNumBuffers; ++i) {
+      const std::vector<uint8_t> buffer = CreateBuffer(&seed);
+      const uint8_t* data = buffer.empty() ? NULL : &buffer[0];
+      for (size_t position = 0; position < buffer.size(); position += 7) {
+        ASSERT_EQ(
+            scalar.find_escape_candidate(data, buffer.size(), position),
+            kernels.find_escape_candidate(data, buffer.size(), position));
+      }
+    }
+  }
+}
+
+TEST_F(MediaKernelsTest, FindEscapeCandidate) {
+  const uint8_t kData[] = {0x00, 0x00, 0x04, 0x00, 0x12, 0x00, 0x00, 0x05,
+                           0x00, 0x00, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00,
+                           0x56, 0x00, 0x00, 0x03, 0x11};
+  EXPECT_EQ(11u,
+            GetMediaKernels().find_escape_candidate(kData, sizeof(kData), 0));
+  EXPECT_EQ(17u,
+            GetMediaKernels().find_escape_candidate(kData, sizeof(kData), 14));
+  EXPECT_EQ(sizeof(kData),
+            GetMediaKernels().find_escape_candidate(kData, sizeof(kData), 18));
+}
+
+TEST_F(MediaKernelsTest, Crc32cMatchesScalar) {
+  const MediaKernels& scalar = GetScalarMediaKernels();
+  for (const MediaKernels& kernels : GetSupportedMediaKernels()) {
+    uint32_t seed = 3;
+    uint32_t crc = 0;
+    for (int i = 0; i < kNumBuffers; ++i) {
+      const std::vector<uint8_t> buffer = CreateBuffer(&seed);
+      const uint8_t* data = buffer.empty() ? NULL : &buffer[0];
+      const uint32_t expected_crc = scalar.crc32c(crc, data, buffer.size());
+      crc = kernels.crc32c(crc, data, buffer.size());
+      ASSERT_EQ(expected_crc, crc);
+    }
+  }
+}
+
+TEST_F(MediaKernelsTest, Crc32c) {
+  // The check value of CRC32C.
+  const uint8_t kData[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+  EXPECT_EQ(0xe3069283u, GetMediaKernels().crc32c(0, kData, sizeof(kData)));
+  EXPECT_EQ(0xe3069283u,
+            GetMediaKernels().crc32c(GetMediaKernels().crc32c(0, kData, 4),
+                                     kData + 4, sizeof(kData) - 4));
+}
+
+TEST_F(MediaKernelsTest, SelectsTheLastSupportedKernels) {
+  const std::vector<MediaKernels> tables = GetSupportedMediaKernels();
+  ASSERT_FALSE(tables.empty());
+  EXPECT_EQ(GetScalarMediaKernels().crc32c, tables.front().crc32c);
+  EXPECT_EQ(tables.back().find_start_code, GetMediaKernels().find_start_code);
+  EXPECT_EQ(tables.back().find_escape_candidate,
+            GetMediaKernels().find_escape_candidate);
+  EXPECT_EQ(tables.back().crc32c, GetMediaKernels().crc32c);
+}
+
+TEST_F(MediaKernelsTest, ForceScalar) {
+  const MediaKernels& selected = GetMediaKernels();
+  ForceScalarMediaKernels(true);
+  EXPECT_EQ(&GetScalarMediaKernels(), &GetMediaKernels());
+  ForceScalarMediaKernels(false);
+  EXPECT_EQ(&selected, &GetMediaKernels());
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -7,6 +7,9 @@
 #ifndef MEDIA_BASE_MEDIA_PARSER_H_
 #define MEDIA_BASE_MEDIA_PARSER_H_
 
+#include <stdint.h>
+
+#include <set>
 #include <string>
 #include <vector>
 
@@ -14,6 +17,7 @@
 #include "packager/base/compiler_specific.h"
 #include "packager/base/memory/ref_counted.h"
 #include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/time/time.h"
 #include "packager/media/base/container_names.h"
 
 namespace edash_packager {
@@ -21,7 +25,24 @@ namespace media {
 
 class KeySource;
 class MediaSample;
+class SharedBuffer;
 class StreamInfo;
+struct TimedMetadataEvent;
+
+/// Budgets of the work of a parser, which fails quickly once one is
+/// exceeded, so that a malformed or adversarial input does not hold a worker
+/// for long. 0 means no limit.
+struct MediaParserLimits {
+  /// Maximum number of input bytes buffered by the parser, e.g. while
+  /// looking for the end of a box or of an access unit.
+  uint64_t max_buffered_bytes = 0;
+  /// Maximum number of boxes in the 'moov' box of an MP4 input, counting the
+  /// nested boxes.
+  uint64_t max_boxes_per_moov = 0;
+  /// Maximum CPU time of a MediaParser::Parse() call, not counting the
+  /// processing of the samples emitted. Enforced by the Demuxer.
+  base::TimeDelta max_parse_cpu_time;
+};
 
 class MediaParser {
  public:
@@ -43,6 +64,12 @@ class MediaParser {
                               const scoped_refptr<MediaSample>& media_sample)>
       NewSampleCB;
 
+  /// Called when a timed metadata event of the program has been parsed, e.g.
+  /// an SCTE-35 splice information section. The event is not tied to a
+  /// track.
+  typedef base::Callback<void(const TimedMetadataEvent& event)>
+      TimedMetadataCB;
+
   /// Initialize the parser with necessary callbacks. Must be called before any
   /// data is passed to Parse().
   /// @param init_cb will be called once enough data has been parsed to
@@ -63,7 +90,38 @@ class MediaParser {
   /// @return true if successful.
   virtual bool Parse(const uint8_t* buf, int size) WARN_UNUSED_RESULT = 0;
 
+  /// Inform the parser that the data passed to the subsequent Parse() calls
+  /// are consecutive ranges of @a input_buffer, starting at its beginning.
+  /// @a input_buffer holds the whole input, e.g. a memory mapped file, so the
+  /// parser may reference it instead of copying the data. Must be called
+  /// before the first Parse() call. The default implementation ignores it.
+  virtual void SetInputBuffer(const scoped_refptr<SharedBuffer>& input_buffer) {
+  }
+
+  /// Inform the parser that only the samples of the tracks in @a track_ids
+  /// are consumed, so it may skip the data of the other tracks. Must be
+  /// called after initialization, before the samples are parsed. The default
+  /// implementation ignores it.
+  virtual void SelectTracks(const std::set<uint32_t>& track_ids) {}
+
+  /// Set the limits of the parser. Must be called before Init().
+  void set_limits(const MediaParserLimits& limits) { limits_ = limits; }
+  const MediaParserLimits& limits() const { return limits_; }
+
+  /// Set the callback of the timed metadata events. Optional: the parsers
+  /// which find timed metadata drop it without a callback. Must be called
+  /// before Init().
+  void set_timed_metadata_cb(const TimedMetadataCB& timed_metadata_cb) {
+    timed_metadata_cb_ = timed_metadata_cb;
+  }
+  const TimedMetadataCB& timed_metadata_cb() const {
+    return timed_metadata_cb_;
+  }
+
  private:
+  MediaParserLimits limits_;
+  TimedMetadataCB timed_metadata_cb_;
+
   DISALLOW_COPY_AND_ASSIGN(MediaParser);
 };
 
@@ -7,13 +7,32 @@
 #include "packager/media/base/media_sample.h"
 
 #include <inttypes.h>
+#include <string.h>
 
 #include "packager/base/logging.h"
 #include "packager/base/strings/stringprintf.h"
+#include "packager/media/base/decrypt_config.h"
+#include "packager/media/base/sample_buffer_pool.h"
+#include "packager/media/base/shared_buffer.h"
 
 namespace edash_packager {
 namespace media {
 
+namespace {
+
+// The headroom of the data copied into a sample, enough for the encrypted
+// block header of WebM: a signal byte and a 16-byte IV.
+const size_t kDataHeadroom = 17;
+
+scoped_ptr<DecryptConfig> CopyDecryptConfig(const DecryptConfig& config) {
+  return scoped_ptr<DecryptConfig>(new DecryptConfig(
+      config.key_id(), config.iv(), config.subsamples(),
+      config.protection_scheme(), config.crypt_byte_block(),
+      config.skip_byte_block()));
+}
+
+}  // namespace
+
 MediaSample::MediaSample(const uint8_t* data,
                          size_t size,
                          const uint8_t* side_data,
@@ -23,23 +42,73 @@ MediaSample::MediaSample(const uint8_t* data,
       pts_(0),
       duration_(0),
       is_key_frame_(is_key_frame),
-      is_encrypted_(false) {
+      is_encrypted_(false),
+      headroom_(0),
+      shared_data_(NULL),
+      shared_data_size_(0),
+      memory_(kSampleMemory) {
   if (!data) {
     CHECK_EQ(size, 0u);
   }
 
-  data_.assign(data, data + size);
+  AssignData(data, size);
   if (side_data)
     side_data_.assign(side_data, side_data + side_data_size);
+  UpdateTrackedMemory();
+}
+
+MediaSample::MediaSample(const uint8_t* data,
+                         size_t size,
+                         const uint8_t* side_data,
+                         size_t side_data_size,
+                         bool is_key_frame,
+                         SampleBufferPool* pool)
+    : dts_(0),
+      pts_(0),
+      duration_(0),
+      is_key_frame_(is_key_frame),
+      is_encrypted_(false),
+      headroom_(0),
+      pool_(pool),
+      shared_data_(NULL),
+      shared_data_size_(0),
+      memory_(kSampleMemory) {
+  if (!data) {
+    CHECK_EQ(size, 0u);
+  }
+  if (!side_data) {
+    CHECK_EQ(side_data_size, 0u);
+  }
+  AssignData(data, size);
+  if (!pool_) {
+    side_data_.assign(side_data, side_data + side_data_size);
+    UpdateTrackedMemory();
+    return;
+  }
+
+  if (side_data_size > 0) {
+    pool_->Acquire(side_data_size, &side_data_);
+    memcpy(&side_data_[0], side_data, side_data_size);
+  }
+  UpdateTrackedMemory();
 }
 
 MediaSample::MediaSample() : dts_(0),
                              pts_(0),
                              duration_(0),
                              is_key_frame_(false),
-                             is_encrypted_(false) {}
+                             is_encrypted_(false),
+                             headroom_(0),
+                             shared_data_(NULL),
+                             shared_data_size_(0),
+                             memory_(kSampleMemory) {}
 
-MediaSample::~MediaSample() {}
+MediaSample::~MediaSample() {
+  if (pool_) {
+    pool_->Recycle(&data_);
+    pool_->Recycle(&side_data_);
+  }
+}
 
 // static
 scoped_refptr<MediaSample> MediaSample::CopyFrom(const uint8_t* data,
@@ -63,6 +132,39 @@ scoped_refptr<MediaSample> MediaSample::CopyFrom(const uint8_t* data,
       data, data_size, side_data, side_data_size, is_key_frame));
 }
 
+// static
+scoped_refptr<MediaSample> MediaSample::CopyFrom(const uint8_t* data,
+                                                 size_t data_size,
+                                                 const uint8_t* side_data,
+                                                 size_t side_data_size,
+                                                 bool is_key_frame,
+                                                 SampleBufferPool* pool) {
+  // If you hit this CHECK you likely have a bug in a demuxer. Go fix it.
+  CHECK(data);
+  DCHECK(pool);
+  return make_scoped_refptr(new MediaSample(
+      data, data_size, side_data, side_data_size, is_key_frame, pool));
+}
+
+// static
+scoped_refptr<MediaSample> MediaSample::CreateFromSharedBuffer(
+    const scoped_refptr<SharedBuffer>& buffer,
+    const uint8_t* data,
+    size_t size,
+    bool is_key_frame) {
+  // If you hit this CHECK you likely have a bug in a demuxer. Go fix it.
+  CHECK(data);
+  CHECK_GT(size, 0u);
+  DCHECK(buffer);
+  DCHECK(buffer->Contains(data, size));
+  scoped_refptr<MediaSample> sample(new MediaSample());
+  sample->is_key_frame_ = is_key_frame;
+  sample->shared_buffer_ = buffer;
+  sample->shared_data_ = data;
+  sample->shared_data_size_ = size;
+  return sample;
+}
+
 // static
 scoped_refptr<MediaSample> MediaSample::FromMetadata(const uint8_t* metadata,
                                                      size_t metadata_size) {
@@ -81,6 +183,139 @@ scoped_refptr<MediaSample> MediaSample::CreateEOSBuffer() {
   return make_scoped_refptr(new MediaSample(NULL, 0, NULL, 0, false));
 }
 
+void MediaSample::ReleasePayload() {
+  DCHECK(!shared_buffer_);
+  if (pool_) {
+    pool_->Recycle(&data_);
+    pool_->Recycle(&side_data_);
+  } else {
+    std::vector<uint8_t>().swap(data_);
+    std::vector<uint8_t>().swap(side_data_);
+  }
+  headroom_ = 0;
+  UpdateTrackedMemory();
+}
+
+scoped_refptr<MediaSample> MediaSample::ShallowCopy() {
+  if (end_of_stream())
+    return CreateEOSBuffer();
+
+  if (!shared_buffer_) {
+    // Move the data to a SharedBuffer which both samples can reference.
+    scoped_refptr<SharedBuffer> buffer(new SharedBuffer(data_size()));
+    memcpy(buffer->data(), data(), data_size());
+    if (pool_)
+      pool_->Recycle(&data_);
+    else
+      std::vector<uint8_t>().swap(data_);
+    headroom_ = 0;
+    shared_buffer_ = buffer;
+    shared_data_ = buffer->data();
+    shared_data_size_ = buffer->size();
+    UpdateTrackedMemory();
+  }
+
+  scoped_refptr<MediaSample> sample(new MediaSample());
+  sample->dts_ = dts_;
+  sample->pts_ = pts_;
+  sample->duration_ = duration_;
+  sample->is_key_frame_ = is_key_frame_;
+  sample->is_encrypted_ = is_encrypted_;
+  sample->side_data_ = side_data_;
+  sample->config_id_ = config_id_;
+  if (pending_decrypt_config_) {
+    sample->pending_decrypt_config_ =
+        CopyDecryptConfig(*pending_decrypt_config_);
+    sample->pending_decryption_key_ = pending_decryption_key_;
+  }
+  if (passthrough_decrypt_config_) {
+    sample->passthrough_decrypt_config_ =
+        CopyDecryptConfig(*passthrough_decrypt_config_);
+  }
+  sample->shared_buffer_ = shared_buffer_;
+  sample->shared_data_ = shared_data_;
+  sample->shared_data_size_ = shared_data_size_;
+  sample->UpdateTrackedMemory();
+  return sample;
+}
+
+void MediaSample::set_pending_decryption(
+    scoped_ptr<DecryptConfig> decrypt_config,
+    const std::vector<uint8_t>& key) {
+  DCHECK(decrypt_config);
+  pending_decrypt_config_ = decrypt_config.Pass();
+  pending_decryption_key_ = key;
+}
+
+void MediaSample::clear_pending_decryption() {
+  pending_decrypt_config_.reset();
+  pending_decryption_key_.clear();
+}
+
+void MediaSample::set_passthrough_encryption(
+    scoped_ptr<DecryptConfig> decrypt_config) {
+  DCHECK(decrypt_config);
+  passthrough_decrypt_config_ = decrypt_config.Pass();
+}
+
+uint8_t* MediaSample::PrependData(size_t size) {
+  DCHECK(!end_of_stream());
+  if (shared_buffer_) {
+    const size_t data_size = shared_data_size_;
+    if (pool_) {
+      pool_->Acquire(size + data_size, &data_);
+      memcpy(&data_[size], shared_data_, data_size);
+    } else {
+      data_.clear();
+      data_.reserve(size + data_size);
+      data_.resize(size);
+      data_.insert(data_.end(), shared_data_, shared_data_ + data_size);
+    }
+    headroom_ = 0;
+    ReleaseSharedData();
+  } else if (size <= headroom_) {
+    headroom_ -= size;
+  } else {
+    // Not enough headroom: the data is moved.
+    data_.insert(data_.begin() + headroom_, size - headroom_, 0);
+    headroom_ = 0;
+    UpdateTrackedMemory();
+  }
+  return &data_[headroom_];
+}
+
+void MediaSample::AssignData(const uint8_t* data, size_t size) {
+  if (size == 0) {
+    data_.clear();
+    headroom_ = 0;
+    return;
+  }
+  headroom_ = kDataHeadroom;
+  if (pool_) {
+    pool_->Acquire(headroom_ + size, &data_);
+    memcpy(&data_[headroom_], data, size);
+  } else {
+    // Reserved first, so the data is copied once and not zero-filled.
+    data_.clear();
+    data_.reserve(headroom_ + size);
+    data_.resize(headroom_);
+    data_.insert(data_.end(), data, data + size);
+  }
+}
+
+void MediaSample::CopySharedData() {
+  DCHECK(shared_buffer_);
+  AssignData(shared_data_, shared_data_size_);
+  ReleaseSharedData();
+}
+
+void MediaSample::ReleaseSharedData() {
+  shared_buffer_ = NULL;
+  shared_data_ = NULL;
+  shared_data_size_ = 0;
+  UpdateTrackedMemory();
+}
+
 std::string MediaSample::ToString() const {
   if (end_of_stream())
     return "End of stream sample\n";
@@ -91,7 +326,7 @@ std::string MediaSample::ToString() const {
       pts_,
       duration_,
       is_key_frame_ ? "true" : "false",
-      data_.size(),
+      data_size(),
       side_data_.size());
 }
 
@@ -14,10 +14,16 @@
 #include "packager/base/logging.h"
 #include "packager/base/memory/ref_counted.h"
 #include "packager/base/memory/scoped_ptr.h"
+#include "packager/media/base/hot_path.h"
+#include "packager/media/base/memory_tracker.h"
 
 namespace edash_packager {
 namespace media {
 
+class DecryptConfig;
+class SampleBufferPool;
+class SharedBuffer;
+
 /// Class to hold a media sample.
 class MediaSample : public base::RefCountedThreadSafe<MediaSample> {
  public:
@@ -45,6 +51,48 @@ class MediaSample : public base::RefCountedThreadSafe<MediaSample> {
                                              size_t side_data_size,
                                              bool is_key_frame);
 
+  /// Create a MediaSample object from input, with the payload buffers taken
+  /// from @a pool. The buffers are returned to @a pool for reuse when the
+  /// sample is destroyed.
+  /// @param data points to the buffer containing the sample data.
+  ///        Must not be NULL.
+  /// @param size indicates sample size in bytes. Must not be negative.
+  /// @param side_data points to the buffer containing the additional data.
+  ///        Can be NULL if @a side_data_size is zero.
+  /// @param side_data_size indicates additional sample data size in bytes.
+  /// @param is_key_frame indicates whether the sample is a key frame.
+  /// @param pool is the SampleBufferPool to allocate from. Must not be NULL.
+  static scoped_refptr<MediaSample> CopyFrom(const uint8_t* data,
+                                             size_t size,
+                                             const uint8_t* side_data,
+                                             size_t side_data_size,
+                                             bool is_key_frame,
+                                             SampleBufferPool* pool);
+
+  /// Create a MediaSample object referencing a slice of a SharedBuffer,
+  /// without copying the data. The data is copied (copy-on-write) only if the
+  /// sample is modified, e.g. through writable_data().
+  /// @param buffer is the SharedBuffer holding the sample data. The caller
+  ///        must not modify the referenced range afterwards.
+  /// @param data points to the sample data within @a buffer. Must not be
+  ///        NULL.
+  /// @param size indicates sample size in bytes. Must not be zero.
+  /// @param is_key_frame indicates whether the sample is a key frame.
+  static scoped_refptr<MediaSample> CreateFromSharedBuffer(
+      const scoped_refptr<SharedBuffer>& buffer,
+      const uint8_t* data,
+      size_t size,
+      bool is_key_frame);
+
+  /// Create a MediaSample sharing the data of this sample, so the same
+  /// demuxed sample can be handed to several muxers. The payload is moved to
+  /// a SharedBuffer first if it is not already held in one, and is copied
+  /// only if either sample is modified through writable_data() (copy on
+  /// write). The other properties of the sample are copied. Must be called
+  /// before this sample is handed to another thread.
+  /// @return the new sample.
+  scoped_refptr<MediaSample> ShallowCopy();
+
   /// Create a MediaSample object from metadata.
   /// Unlike other factory methods, this cannot be a key frame. It must be only
   /// for metadata.
@@ -63,53 +111,66 @@ class MediaSample : public base::RefCountedThreadSafe<MediaSample> {
   static scoped_refptr<MediaSample> CreateEOSBuffer();
 
   int64_t dts() const {
-    DCHECK(!end_of_stream());
+    HOT_DCHECK(!end_of_stream());
     return dts_;
   }
 
   void set_dts(int64_t dts) { dts_ = dts; }
 
   int64_t pts() const {
-    DCHECK(!end_of_stream());
+    HOT_DCHECK(!end_of_stream());
     return pts_;
   }
 
   void set_pts(int64_t pts) { pts_ = pts; }
 
   int64_t duration() const {
-    DCHECK(!end_of_stream());
+    HOT_DCHECK(!end_of_stream());
     return duration_;
   }
 
   void set_duration(int64_t duration) {
-    DCHECK(!end_of_stream());
+    HOT_DCHECK(!end_of_stream());
     duration_ = duration;
   }
 
   bool is_key_frame() const {
-    DCHECK(!end_of_stream());
+    HOT_DCHECK(!end_of_stream());
     return is_key_frame_;
   }
 
   bool is_encrypted() const {
-    DCHECK(!end_of_stream());
+    HOT_DCHECK(!end_of_stream());
     return is_encrypted_;
   }
   const uint8_t* data() const {
-    DCHECK(!end_of_stream());
-    return &data_[0];
+    HOT_DCHECK(!end_of_stream());
+    return shared_buffer_ ? shared_data_ : &data_[headroom_];
   }
 
   uint8_t* writable_data() {
-    DCHECK(!end_of_stream());
-    return &data_[0];
+    HOT_DCHECK(!end_of_stream());
+    if (shared_buffer_)
+      CopySharedData();
+    return &data_[headroom_];
   }
 
   size_t data_size() const {
-    DCHECK(!end_of_stream());
-    return data_.size();
+    HOT_DCHECK(!end_of_stream());
+    return shared_buffer_ ? shared_data_size_ : data_.size() - headroom_;
   }
 
+  /// Grows the data by @a size bytes at its front, e.g. for a block header
+  /// of the container. The data copied into the sample is preceded by a few
+  /// bytes of headroom, so a small header is added without moving the data;
+  /// shared data is copied once, after the new bytes.
+  /// @return the writable data, starting with the @a size new bytes.
+  uint8_t* PrependData(size_t size);
+
+  /// @return true if the sample data references a SharedBuffer, i.e. it has
+  ///         not been copied.
+  bool is_shared() const { return shared_buffer_.get() != NULL; }
+
   const uint8_t* side_data() const {
     return &side_data_[0];
   }
@@ -118,12 +179,38 @@ class MediaSample : public base::RefCountedThreadSafe<MediaSample> {
     return side_data_.size();
   }
 
+  /// @return The size of the data and of the side data, or 0 for end of
+  ///         stream samples.
+  size_t payload_size() const {
+    return end_of_stream() ? side_data_.size()
+                           : data_size() + side_data_.size();
+  }
+
   void set_data(const uint8_t* data, const size_t data_size) {
+    // |data| may point into the shared buffer; copy it before releasing.
     data_.assign(data, data + data_size);
+    headroom_ = 0;
+    ReleaseSharedData();
+    UpdateTrackedMemory();
   }
 
   void resize_data(const size_t data_size) {
-    data_.resize(data_size);
+    if (shared_buffer_)
+      CopySharedData();
+    data_.resize(headroom_ + data_size);
+    UpdateTrackedMemory();
+  }
+
+  /// Releases the memory of the data and side data, e.g. while they are
+  /// spilled to disk by SampleSpillQueue, which restores them with
+  /// resize_data() and set_side_data(). The other fields are kept. The
+  /// sample reads as an end of stream sample until then. Shared data cannot
+  /// be released.
+  void ReleasePayload();
+
+  void set_side_data(const uint8_t* side_data, size_t side_data_size) {
+    side_data_.assign(side_data, side_data + side_data_size);
+    UpdateTrackedMemory();
   }
 
   void set_is_key_frame(bool value) {
@@ -134,8 +221,38 @@ class MediaSample : public base::RefCountedThreadSafe<MediaSample> {
     is_encrypted_ = value;
   }
 
+  /// Leaves the sample data encrypted so that the muxer can re-encrypt it in
+  /// a single pass, see EncryptingFragmenter. Muxers which do not re-encrypt
+  /// the data decrypt it with DecryptorSource::DecryptPendingSample().
+  /// @param decrypt_config contains the decryption parameters of the data.
+  /// @param key is the decryption key.
+  void set_pending_decryption(scoped_ptr<DecryptConfig> decrypt_config,
+                              const std::vector<uint8_t>& key);
+  /// Clears the pending decryption, after the data has been decrypted.
+  void clear_pending_decryption();
+  /// @return the decryption parameters of the data, or NULL if the data is
+  ///         not pending decryption.
+  const DecryptConfig* pending_decrypt_config() const {
+    return pending_decrypt_config_.get();
+  }
+  const std::vector<uint8_t>& pending_decryption_key() const {
+    return pending_decryption_key_;
+  }
+
+  /// Leaves the sample data encrypted so that the muxer writes it with its
+  /// encryption unchanged, see StreamInfo::encryption_config().
+  /// @param decrypt_config contains the encryption parameters of the data.
+  void set_passthrough_encryption(scoped_ptr<DecryptConfig> decrypt_config);
+  /// @return the encryption parameters of the data, or NULL if the data is
+  ///         not passed through encrypted.
+  const DecryptConfig* passthrough_decrypt_config() const {
+    return passthrough_decrypt_config_.get();
+  }
+
   // If there's no data in this buffer, it represents end of stream.
-  bool end_of_stream() const { return data_.size() == 0; }
+  bool end_of_stream() const {
+    return data_.size() == headroom_ && !shared_buffer_;
+  }
 
   const std::string& config_id() const { return config_id_; }
   void set_config_id(const std::string& config_id) {
@@ -156,9 +273,29 @@ class MediaSample : public base::RefCountedThreadSafe<MediaSample> {
               const uint8_t* side_data,
               size_t side_data_size,
               bool is_key_frame);
+  // Same as above, but with the buffers allocated from |pool|, which can be
+  // NULL.
+  MediaSample(const uint8_t* data,
+              size_t size,
+              const uint8_t* side_data,
+              size_t side_data_size,
+              bool is_key_frame,
+              SampleBufferPool* pool);
   MediaSample();
   virtual ~MediaSample();
 
+  // Copy |size| bytes of |data| to |data_|, after the headroom.
+  void AssignData(const uint8_t* data, size_t size);
+  // Copy the referenced shared data to |data_| and drop the reference.
+  void CopySharedData();
+  // Drop the reference to the shared data without copying it.
+  void ReleaseSharedData();
+  // Account the memory of |data_| and |side_data_| in kSampleMemory. The
+  // shared data is accounted by its SharedBuffer.
+  void UpdateTrackedMemory() {
+    memory_.Set(data_.capacity() + side_data_.capacity());
+  }
+
   // Decoding time stamp.
   int64_t dts_;
   // Presentation time stamp.
@@ -168,8 +305,9 @@ class MediaSample : public base::RefCountedThreadSafe<MediaSample> {
   // is sample encrypted ?
   bool is_encrypted_;
 
-  // Main buffer data.
+  // Main buffer data, after |headroom_| bytes reserved for PrependData().
   std::vector<uint8_t> data_;
+  size_t headroom_;
   // Contain additional buffers to complete the main one. Needed by WebM
   // http://www.matroska.org/technical/specs/index.html BlockAdditional[A5].
   // Not used by mp4 and other containers.
@@ -179,6 +317,24 @@ class MediaSample : public base::RefCountedThreadSafe<MediaSample> {
   // For now this is the cue identifier for WebVTT.
   std::string config_id_;
 
+  // Set if the data is still encrypted, see set_pending_decryption().
+  scoped_ptr<DecryptConfig> pending_decrypt_config_;
+  std::vector<uint8_t> pending_decryption_key_;
+  // Set if the data is passed through encrypted, see
+  // set_passthrough_encryption().
+  scoped_ptr<DecryptConfig> passthrough_decrypt_config_;
+
+  // Pool which |data_| and |side_data_| are returned to on destruction. Can
+  // be NULL.
+  scoped_refptr<SampleBufferPool> pool_;
+
+  // Set if the sample data is a slice of a SharedBuffer instead of |data_|.
+  scoped_refptr<SharedBuffer> shared_buffer_;
+  const uint8_t* shared_data_;
+  size_t shared_data_size_;
+
+  TrackedMemory memory_;
+
   DISALLOW_COPY_AND_ASSIGN(MediaSample);
 };
 
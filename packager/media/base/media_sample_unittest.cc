@@ -0,0 +1,133 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+#include <string.h>
+
+#include "packager/media/base/media_sample.h"
+#include "packager/media/base/memory_tracker.h"
+#include "packager/media/base/shared_buffer.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+const uint8_t kData[] = {0x01, 0x02, 0x03, 0x04, 0x05};
+const uint8_t kSideData[] = {0x0a, 0x0b};
+const bool kKeyFrame = true;
+const int64_t kDts = 1000;
+const int64_t kPts = 2000;
+const int64_t kDuration = 100;
+
+void SetTimestamps(MediaSample* sample) {
+  sample->set_dts(kDts);
+  sample->set_pts(kPts);
+  sample->set_duration(kDuration);
+}
+}  // namespace
+
+TEST(MediaSampleTest, ShallowCopySharesData) {
+  scoped_refptr<MediaSample> sample(MediaSample::CopyFrom(
+      kData, sizeof(kData), kSideData, sizeof(kSideData), kKeyFrame));
+  SetTimestamps(sample.get());
+
+  scoped_refptr<MediaSample> copy(sample->ShallowCopy());
+  EXPECT_TRUE(sample->is_shared());
+  EXPECT_TRUE(copy->is_shared());
+  EXPECT_EQ(sample->data(), copy->data());
+  ASSERT_EQ(sizeof(kData), copy->data_size());
+  EXPECT_EQ(0, memcmp(kData, copy->data(), sizeof(kData)));
+  ASSERT_EQ(sizeof(kSideData), copy->side_data_size());
+  EXPECT_EQ(0, memcmp(kSideData, copy->side_data(), sizeof(kSideData)));
+  EXPECT_EQ(kDts, copy->dts());
+  EXPECT_EQ(kPts, copy->pts());
+  EXPECT_EQ(kDuration, copy->duration());
+  EXPECT_EQ(kKeyFrame, copy->is_key_frame());
+}
+
+TEST(MediaSampleTest, ShallowCopyIsCopiedOnWrite) {
+  scoped_refptr<SharedBuffer> buffer(new SharedBuffer(sizeof(kData)));
+  memcpy(buffer->data(), kData, sizeof(kData));
+  scoped_refptr<MediaSample> sample(MediaSample::CreateFromSharedBuffer(
+      buffer, buffer->data(), sizeof(kData), kKeyFrame));
+  scoped_refptr<MediaSample> copy(sample->ShallowCopy());
+  EXPECT_EQ(buffer->data(), copy->data());
+
+  copy->writable_data()[0] = 0xff;
+  copy->set_dts(kDts);
+  EXPECT_FALSE(copy->is_shared());
+  EXPECT_EQ(0xff, copy->data()[0]);
+  // The original sample is not affected.
+  EXPECT_EQ(buffer->data(), sample->data());
+  EXPECT_EQ(kData[0], sample->data()[0]);
+  EXPECT_EQ(0, sample->dts());
+}
+
+TEST(MediaSampleTest, TrackedMemory) {
+  const uint64_t initial_usage = MemoryTracker::GetUsage(kSampleMemory);
+  {
+    scoped_refptr<MediaSample> sample(MediaSample::CopyFrom(
+        kData, sizeof(kData), kSideData, sizeof(kSideData), kKeyFrame));
+    EXPECT_EQ(sizeof(kData) + sizeof(kSideData), sample->payload_size());
+    EXPECT_LE(initial_usage + sample->payload_size(),
+              MemoryTracker::GetUsage(kSampleMemory));
+
+    // The data moves to a SharedBuffer, which is accounted once.
+    scoped_refptr<MediaSample> copy(sample->ShallowCopy());
+    EXPECT_GT(initial_usage + 2 * sample->payload_size(),
+              MemoryTracker::GetUsage(kSampleMemory));
+  }
+  EXPECT_EQ(initial_usage, MemoryTracker::GetUsage(kSampleMemory));
+}
+
+TEST(MediaSampleTest, PrependDataUsesHeadroom) {
+  scoped_refptr<MediaSample> sample(
+      MediaSample::CopyFrom(kData, sizeof(kData), kKeyFrame));
+  const uint8_t* data = sample->data();
+
+  const uint8_t kHeader[] = {0x00, 0xaa};
+  uint8_t* prepended_data = sample->PrependData(sizeof(kHeader));
+  // The data is not moved.
+  EXPECT_EQ(data - sizeof(kHeader), prepended_data);
+  memcpy(prepended_data, kHeader, sizeof(kHeader));
+  ASSERT_EQ(sizeof(kHeader) + sizeof(kData), sample->data_size());
+  EXPECT_EQ(0, memcmp(kHeader, sample->data(), sizeof(kHeader)));
+  EXPECT_EQ(0, memcmp(kData, sample->data() + sizeof(kHeader),
+                      sizeof(kData)));
+}
+
+TEST(MediaSampleTest, PrependDataBeyondHeadroom) {
+  scoped_refptr<MediaSample> sample(
+      MediaSample::CopyFrom(kData, sizeof(kData), kKeyFrame));
+  const size_t kHeaderSize = 100;
+  memset(sample->PrependData(kHeaderSize), 0xaa, kHeaderSize);
+  ASSERT_EQ(kHeaderSize + sizeof(kData), sample->data_size());
+  EXPECT_EQ(0xaa, sample->data()[kHeaderSize - 1]);
+  EXPECT_EQ(0, memcmp(kData, sample->data() + kHeaderSize, sizeof(kData)));
+}
+
+TEST(MediaSampleTest, PrependDataToSharedData) {
+  scoped_refptr<SharedBuffer> buffer(new SharedBuffer(sizeof(kData)));
+  memcpy(buffer->data(), kData, sizeof(kData));
+  scoped_refptr<MediaSample> sample(MediaSample::CreateFromSharedBuffer(
+      buffer, buffer->data(), sizeof(kData), kKeyFrame));
+
+  sample->PrependData(1)[0] = 0xaa;
+  EXPECT_FALSE(sample->is_shared());
+  ASSERT_EQ(1 + sizeof(kData), sample->data_size());
+  EXPECT_EQ(0xaa, sample->data()[0]);
+  EXPECT_EQ(0, memcmp(kData, sample->data() + 1, sizeof(kData)));
+  // The shared buffer is not modified.
+  EXPECT_EQ(0, memcmp(kData, buffer->data(), sizeof(kData)));
+}
+
+TEST(MediaSampleTest, ShallowCopyEndOfStream) {
+  scoped_refptr<MediaSample> sample(MediaSample::CreateEOSBuffer());
+  EXPECT_TRUE(sample->ShallowCopy()->end_of_stream());
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -6,20 +6,51 @@
 
 #include "packager/media/base/media_stream.h"
 
+#include "packager/base/bind.h"
 #include "packager/base/logging.h"
 #include "packager/base/strings/stringprintf.h"
+#include "packager/media/base/closure_thread.h"
 #include "packager/media/base/demuxer.h"
 #include "packager/media/base/media_sample.h"
 #include "packager/media/base/muxer.h"
+#include "packager/media/base/pipeline_metrics.h"
 #include "packager/media/base/stream_info.h"
 
+namespace {
+// Upper bound on how long a side of the sample channel sleeps before checking
+// the channel again. Wake ups are normally signalled; this only bounds the cost
+// of a (rare) missed signal.
+const int64_t kChannelWaitTimeoutMs = 10;
+}  // namespace
+
 namespace edash_packager {
 namespace media {
 
+using base::subtle::Acquire_Load;
+using base::subtle::NoBarrier_Load;
+using base::subtle::NoBarrier_Store;
+using base::subtle::Release_Store;
+
 MediaStream::MediaStream(scoped_refptr<StreamInfo> info, Demuxer* demuxer)
-    : info_(info), demuxer_(demuxer), muxer_(NULL), state_(kIdle) {}
+    : info_(info),
+      demuxed_info_(info),
+      demuxer_(demuxer),
+      muxer_(NULL),
+      state_(kIdle),
+      samples_(kStreamQueueMemory),
+      sample_channel_capacity_(0),
+      sample_available_event_(false, false),
+      space_available_event_(false, false),
+      consumer_waiting_(0),
+      producer_waiting_(0),
+      channel_closed_(0),
+      muxer_thread_done_(0),
+      num_timed_metadata_(0) {}
 
-MediaStream::~MediaStream() {}
+MediaStream::~MediaStream() {
+  if (muxer_thread_)
+    Stop();
+}
 
 Status MediaStream::PullSample(scoped_refptr<MediaSample>* sample) {
   DCHECK_EQ(state_, kPulling);
@@ -31,21 +62,34 @@ Status MediaStream::PullSample(scoped_refptr<MediaSample>* sample) {
       return status;
   }
 
-  *sample = samples_.front();
-  samples_.pop_front();
-  return Status::OK;
+  return samples_.Pop(sample);
 }
 
 Status MediaStream::PushSample(const scoped_refptr<MediaSample>& sample) {
   switch (state_) {
     case kIdle:
     case kPulling:
-      samples_.push_back(sample);
-      return Status::OK;
+      return samples_.Push(sample);
     case kDisconnected:
       return Status::OK;
     case kPushing:
-      return muxer_->AddSample(this, sample);
+      if (!sample_channel_)
+        return muxer_->AddSample(this, sample);
+      while (true) {
+        if (Acquire_Load(&muxer_thread_done_)) {
+          // The muxing thread exited before end of stream, which means the
+          // muxer failed.
+          Status status = Stop();
+          return status.ok() ? Status(error::MUXER_FAILURE,
+                                      "Muxing thread exited unexpectedly.")
+                             : status;
+        }
+        if (sample_channel_->TryPush(sample))
+          break;
+        WaitForSpace();
+      }
+      SignalChannel(&consumer_waiting_, &sample_available_event_);
+      return Status::OK;
     default:
       NOTREACHED() << "Unexpected State " << state_;
       return Status::UNKNOWN;
@@ -67,17 +111,31 @@ Status MediaStream::Start(MediaStreamOperation operation) {
     case kIdle:
       // Disconnect the stream if it is not connected to a muxer.
       state_ = kDisconnected;
-      samples_.clear();
+      samples_.Clear();
       return Status::OK;
     case kConnected:
       state_ = (operation == kPush) ? kPushing : kPulling;
       if (operation == kPush) {
         // Push samples in the queue to muxer if there is any.
         while (!samples_.empty()) {
-          Status status = muxer_->AddSample(this, samples_.front());
+          scoped_refptr<MediaSample> sample;
+          Status status = samples_.Pop(&sample);
           if (!status.ok())
             return status;
-          samples_.pop_front();
+          status = muxer_->AddSample(this, sample);
+          if (!status.ok())
+            return status;
+        }
+        if (sample_channel_capacity_ > 0) {
+          sample_channel_.reset(new SpscRingBuffer<scoped_refptr<MediaSample> >(
+              sample_channel_capacity_));
+          cancellation_token_ = CancellationToken::Current();
+          io_throttle_ = IoThrottle::Current();
+          muxer_thread_.reset(new ClosureThread(
+              "MediaStreamMuxer",
+              base::Bind(&MediaStream::MuxSamplesFromChannel,
+                         base::Unretained(this))));
+          muxer_thread_->Start();
         }
       } else {
         // We need to disconnect all its peer streams which are not connected
@@ -87,6 +145,11 @@ Status MediaStream::Start(MediaStreamOperation operation) {
           if (!status.ok())
             return status;
         }
+        for (size_t i = 0; i < demuxer_->fan_out_streams().size(); ++i) {
+          Status status = demuxer_->fan_out_streams()[i]->Start(operation);
+          if (!status.ok())
+            return status;
+        }
       }
       return Status::OK;
     case kPulling:
@@ -98,8 +161,116 @@ Status MediaStream::Start(MediaStreamOperation operation) {
   }
 }
 
+Status MediaStream::Stop() {
+  if (!muxer_thread_)
+    return Status::OK;
+
+  Release_Store(&channel_closed_, 1);
+  SignalChannel(&consumer_waiting_, &sample_available_event_);
+  muxer_thread_->Join();
+  muxer_thread_.reset();
+  // No more samples can be muxed.
+  state_ = kDisconnected;
+  return muxer_thread_status_;
+}
+
+void MediaStream::MuxSamplesFromChannel() {
+  DCHECK(sample_channel_);
+  // The files opened and the keys fetched by the muxer are cancelled with
+  // the job.
+  ScopedCancellationToken scoped_token(cancellation_token_.get());
+  ScopedIoThrottle scoped_throttle(io_throttle_.get());
+
+  scoped_refptr<MediaSample> sample;
+  while (true) {
+    if (cancellation_token_.get() && cancellation_token_->IsCancelled()) {
+      // The producer sees the thread exit and stops pushing.
+      muxer_thread_status_ = Status(error::CANCELLED, "Muxing cancelled.");
+      break;
+    }
+    if (!sample_channel_->TryPop(&sample)) {
+      // Check |channel_closed_| before re-checking the channel, as samples
+      // pushed before the channel was closed must all be muxed.
+      if (Acquire_Load(&channel_closed_) && sample_channel_->Empty())
+        break;
+      WaitForSample();
+      continue;
+    }
+    SignalChannel(&producer_waiting_, &space_available_event_);
+
+    muxer_thread_status_ = muxer_->AddSample(this, sample);
+    if (!muxer_thread_status_.ok() || sample->end_of_stream())
+      break;
+  }
+
+  Release_Store(&muxer_thread_done_, 1);
+  // Release the producer if it is blocked on a full channel.
+  SignalChannel(&producer_waiting_, &space_available_event_);
+}
+
+void MediaStream::WaitForSpace() {
+  ScopedStageTimer queue_timer(kQueueStage);
+  NoBarrier_Store(&producer_waiting_, 1);
+  // Pairs with the barrier in SignalChannel: either we see the consumer's
+  // update, or the consumer sees |producer_waiting_| set and signals.
+  base::subtle::MemoryBarrier();
+  if (sample_channel_->Full() && !Acquire_Load(&muxer_thread_done_)) {
+    space_available_event_.TimedWait(
+        base::TimeDelta::FromMilliseconds(kChannelWaitTimeoutMs));
+  }
+  NoBarrier_Store(&producer_waiting_, 0);
+}
+
+void MediaStream::WaitForSample() {
+  NoBarrier_Store(&consumer_waiting_, 1);
+  // Pairs with the barrier in SignalChannel: either we see the producer's
+  // update, or the producer sees |consumer_waiting_| set and signals.
+  base::subtle::MemoryBarrier();
+  if (sample_channel_->Empty() && !Acquire_Load(&channel_closed_)) {
+    sample_available_event_.TimedWait(
+        base::TimeDelta::FromMilliseconds(kChannelWaitTimeoutMs));
+  }
+  NoBarrier_Store(&consumer_waiting_, 0);
+}
+
+// static
+void MediaStream::SignalChannel(base::subtle::Atomic32* waiting,
+                                base::WaitableEvent* event) {
+  base::subtle::MemoryBarrier();
+  if (NoBarrier_Load(waiting))
+    event->Signal();
+}
+
 const scoped_refptr<StreamInfo> MediaStream::info() const { return info_; }
 
+void MediaStream::OverrideLanguage(const std::string& language) {
+  DCHECK_EQ(state_, kIdle);
+  if (info_ == demuxed_info_)
+    info_ = demuxed_info_->Clone();
+  info_->set_language(language);
+}
+
+void MediaStream::PushTimedMetadata(const TimedMetadataEvent& event) {
+  if (!muxer_ || state_ == kDisconnected)
+    return;
+  base::AutoLock auto_lock(timed_metadata_lock_);
+  timed_metadata_.push_back(event);
+  Release_Store(&num_timed_metadata_,
+                static_cast<base::subtle::Atomic32>(timed_metadata_.size()));
+}
+
+void MediaStream::TakeTimedMetadata(std::vector<TimedMetadataEvent>* events) {
+  DCHECK(events);
+  base::AutoLock auto_lock(timed_metadata_lock_);
+  events->assign(timed_metadata_.begin(), timed_metadata_.end());
+  timed_metadata_.clear();
+  Release_Store(&num_timed_metadata_, 0);
+}
+
+size_t MediaStream::GetNumQueuedSamples() const {
+  return samples_.size() + (sample_channel_ ? sample_channel_->Size() : 0);
+}
+
 std::string MediaStream::ToString() const {
   return base::StringPrintf("state: %d\n samples in the queue: %zu\n %s",
                             state_, samples_.size(), info_->ToString().c_str());
@@ -8,14 +8,26 @@
 #define MEDIA_BASE_MEDIA_STREAM_H_
 
 #include <deque>
+#include <string>
+#include <vector>
 
+#include "packager/base/atomicops.h"
+#include "packager/base/logging.h"
 #include "packager/base/memory/ref_counted.h"
 #include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/synchronization/lock.h"
+#include "packager/base/synchronization/waitable_event.h"
+#include "packager/media/base/cancellation_token.h"
+#include "packager/media/base/io_throttle.h"
+#include "packager/media/base/sample_spill_queue.h"
+#include "packager/media/base/spsc_ring_buffer.h"
 #include "packager/media/base/status.h"
+#include "packager/media/base/timed_metadata.h"
 
 namespace edash_packager {
 namespace media {
 
+class ClosureThread;
 class Demuxer;
 class Muxer;
 class MediaSample;
@@ -38,18 +50,73 @@ class MediaStream {
   /// @param muxer cannot be NULL.
   void Connect(Muxer* muxer);
 
+  /// Hand samples to the Muxer through a bounded lock-free channel in push
+  /// mode, so that muxing runs in its own thread, concurrently with demuxing.
+  /// PushSample blocks when the channel is full. Should be called before
+  /// Start.
+  /// @param capacity is the maximum number of samples in flight between the
+  ///        Demuxer and the Muxer. A value of zero disables the channel, in
+  ///        which case samples are muxed synchronously in PushSample.
+  void set_sample_channel_capacity(size_t capacity) {
+    DCHECK_NE(state_, kPushing);
+    sample_channel_capacity_ = capacity;
+  }
+  size_t sample_channel_capacity() const { return sample_channel_capacity_; }
+
+  /// Spill the samples queued in the stream past @a memory_budget bytes to
+  /// a temporary file in @a temp_dir, see SampleSpillQueue. Should be called
+  /// before the first sample is pushed.
+  void SetSpillOptions(uint64_t memory_budget, const std::string& temp_dir) {
+    samples_.SetSpillOptions(memory_budget, temp_dir);
+  }
+
   /// Start the stream for pushing or pulling.
   Status Start(MediaStreamOperation operation);
 
   /// Push sample to Muxer (triggered by Demuxer).
   Status PushSample(const scoped_refptr<MediaSample>& sample);
 
+  /// Stop pushing samples. If the sample channel is in use, wait for the
+  /// samples in flight to be muxed.
+  /// @return The status of the muxing thread, OK if the channel is not used.
+  Status Stop();
+
   /// Pull sample from Demuxer (triggered by Muxer).
   Status PullSample(scoped_refptr<MediaSample>* sample);
 
+  /// Hand a timed metadata event to the Muxer (triggered by Demuxer). The
+  /// events do not go through the samples: they are taken by the Muxer with
+  /// TakeTimedMetadata() when it muxes the next sample, and placed by their
+  /// time. Dropped if the stream is not connected.
+  void PushTimedMetadata(const TimedMetadataEvent& event);
+
+  /// @return true if there are timed metadata events to take. Cheap, so that
+  ///         it can be checked for every sample.
+  bool HasTimedMetadata() const {
+    return base::subtle::Acquire_Load(&num_timed_metadata_) > 0;
+  }
+
+  /// Take the timed metadata events pushed so far, in order.
+  void TakeTimedMetadata(std::vector<TimedMetadataEvent>* events);
+
   Demuxer* demuxer() { return demuxer_; }
   Muxer* muxer() { return muxer_; }
   const scoped_refptr<StreamInfo> info() const;
+  /// @return The stream info as demuxed, without the language override.
+  const scoped_refptr<StreamInfo> demuxed_info() const {
+    return demuxed_info_;
+  }
+
+  /// Override the language of the stream. The stream gets its own copy of
+  /// the stream info, so the demuxed stream info and the other streams fed
+  /// with the same samples keep their language. Should be called before
+  /// Connect.
+  void OverrideLanguage(const std::string& language);
+
+  /// @return Number of samples demuxed but not muxed yet, in the internal
+  ///         queue and in the sample channel. Should be called from the
+  ///         muxing thread.
+  size_t GetNumQueuedSamples() const;
 
   /// @return a human-readable string describing |*this|.
   std::string ToString() const;
@@ -64,12 +131,53 @@ class MediaStream {
     kPulling,
   };
 
+  // Muxing thread loop when the sample channel is in use.
+  void MuxSamplesFromChannel();
+  // Block the producer until there is space in the channel, the muxing
+  // thread exits or a short timeout expires.
+  void WaitForSpace();
+  // Block the muxing thread until there is a sample in the channel, the
+  // channel is closed or a short timeout expires.
+  void WaitForSample();
+  // Wake up the other side if it is waiting on |event|.
+  static void SignalChannel(base::subtle::Atomic32* waiting,
+                            base::WaitableEvent* event);
+
   scoped_refptr<StreamInfo> info_;
+  scoped_refptr<StreamInfo> demuxed_info_;
   Demuxer* demuxer_;
   Muxer* muxer_;
   State state_;
   // An internal buffer to store samples temporarily.
-  std::deque<scoped_refptr<MediaSample> > samples_;
+  SampleSpillQueue samples_;
+
+  // Sample channel between the Demuxer (producer) and the muxing thread
+  // (consumer). Only used in push mode with a non-zero capacity.
+  size_t sample_channel_capacity_;
+  scoped_ptr<SpscRingBuffer<scoped_refptr<MediaSample> > > sample_channel_;
+  scoped_ptr<ClosureThread> muxer_thread_;
+  base::WaitableEvent sample_available_event_;
+  base::WaitableEvent space_available_event_;
+  base::subtle::Atomic32 consumer_waiting_;
+  base::subtle::Atomic32 producer_waiting_;
+  // Set by the producer when no more samples will be pushed.
+  base::subtle::Atomic32 channel_closed_;
+  // Set by the muxing thread when it exits, e.g. on muxer error.
+  base::subtle::Atomic32 muxer_thread_done_;
+  // Status of the muxing thread. Valid after the thread is joined.
+  Status muxer_thread_status_;
+  // Current CancellationToken of the demuxing thread, which is also the
+  // current token of the muxing thread.
+  scoped_refptr<CancellationToken> cancellation_token_;
+  // Likewise the current IoThrottle.
+  scoped_refptr<IoThrottle> io_throttle_;
+
+  // Timed metadata events pushed by the Demuxer, not yet taken by the Muxer,
+  // which may run in the muxing thread.
+  base::Lock timed_metadata_lock_;
+  std::deque<TimedMetadataEvent> timed_metadata_;
+  // Number of events in |timed_metadata_|, read without the lock.
+  base::subtle::Atomic32 num_timed_metadata_;
 
   DISALLOW_COPY_AND_ASSIGN(MediaStream);
 };
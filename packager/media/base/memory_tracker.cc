@@ -0,0 +1,213 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/memory_tracker.h"
+
+#include "packager/base/atomicops.h"
+#include "packager/base/logging.h"
+#include "packager/base/strings/string_number_conversions.h"
+#include "packager/base/threading/platform_thread.h"
+#include "packager/media/base/cancellation_token.h"
+
+namespace edash_packager {
+namespace media {
+
+using base::subtle::AtomicWord;
+
+namespace {
+
+const char* const kCategoryNames[] = {
+    "sample", "stream_queue", "demuxer_queue", "fragmenter", "io_cache",
+    "mpd_segment_info", "hls_entry",
+};
+COMPILE_ASSERT(arraysize(kCategoryNames) == kNumMemoryCategories,
+               category_names_do_not_match_categories);
+
+const MemoryCategory kCategoryParents[] = {
+    kNumMemoryCategories, kSampleMemory, kSampleMemory, kSampleMemory,
+    kNumMemoryCategories, kNumMemoryCategories, kNumMemoryCategories,
+};
+COMPILE_ASSERT(arraysize(kCategoryParents) == kNumMemoryCategories,
+               category_parents_do_not_match_categories);
+
+// Interval between the checks of the usage while waiting for memory.
+const int64_t kSoftLimitPollIntervalMs = 10;
+
+// Zero-initialized, so usable before main() and after exit.
+AtomicWord g_usage[kNumMemoryCategories];
+AtomicWord g_peak_usage[kNumMemoryCategories];
+AtomicWord g_soft_limits[kNumMemoryCategories];
+
+void UpdatePeakUsage(MemoryCategory category, AtomicWord usage) {
+  AtomicWord peak = base::subtle::NoBarrier_Load(&g_peak_usage[category]);
+  while (usage > peak) {
+    const AtomicWord previous = base::subtle::NoBarrier_CompareAndSwap(
+        &g_peak_usage[category], peak, usage);
+    if (previous == peak)
+      break;
+    peak = previous;
+  }
+}
+
+}  // namespace
+
+void MemoryTracker::Add(MemoryCategory category, uint64_t bytes) {
+  DCHECK_GE(category, 0);
+  DCHECK_LT(category, kNumMemoryCategories);
+  if (bytes == 0)
+    return;
+  const AtomicWord usage = base::subtle::NoBarrier_AtomicIncrement(
+      &g_usage[category], static_cast<AtomicWord>(bytes));
+  UpdatePeakUsage(category, usage);
+}
+
+void MemoryTracker::Subtract(MemoryCategory category, uint64_t bytes) {
+  DCHECK_GE(category, 0);
+  DCHECK_LT(category, kNumMemoryCategories);
+  if (bytes == 0)
+    return;
+  const AtomicWord usage = base::subtle::NoBarrier_AtomicIncrement(
+      &g_usage[category], -static_cast<AtomicWord>(bytes));
+  DCHECK_GE(usage, 0);
+}
+
+uint64_t MemoryTracker::GetUsage(MemoryCategory category) {
+  DCHECK_GE(category, 0);
+  DCHECK_LT(category, kNumMemoryCategories);
+  return base::subtle::NoBarrier_Load(&g_usage[category]);
+}
+
+uint64_t MemoryTracker::GetPeakUsage(MemoryCategory category) {
+  DCHECK_GE(category, 0);
+  DCHECK_LT(category, kNumMemoryCategories);
+  return base::subtle::NoBarrier_Load(&g_peak_usage[category]);
+}
+
+MemoryCategory MemoryTracker::GetParent(MemoryCategory category) {
+  DCHECK_GE(category, 0);
+  DCHECK_LT(category, kNumMemoryCategories);
+  return kCategoryParents[category];
+}
+
+const char* MemoryTracker::GetCategoryName(MemoryCategory category) {
+  DCHECK_GE(category, 0);
+  DCHECK_LT(category, kNumMemoryCategories);
+  return kCategoryNames[category];
+}
+
+void MemoryTracker::SetSoftLimit(MemoryCategory category, uint64_t limit) {
+  DCHECK_GE(category, 0);
+  DCHECK_LT(category, kNumMemoryCategories);
+  base::subtle::NoBarrier_Store(&g_soft_limits[category],
+                                static_cast<AtomicWord>(limit));
+}
+
+bool MemoryTracker::IsOverSoftLimit() {
+  for (int i = 0; i < kNumMemoryCategories; ++i) {
+    const AtomicWord limit = base::subtle::NoBarrier_Load(&g_soft_limits[i]);
+    if (limit > 0 && base::subtle::NoBarrier_Load(&g_usage[i]) > limit)
+      return true;
+  }
+  return false;
+}
+
+bool MemoryTracker::WaitUntilUnderSoftLimits(base::TimeDelta max_wait) {
+  if (!IsOverSoftLimit())
+    return true;
+  const base::TimeTicks deadline = base::TimeTicks::Now() + max_wait;
+  do {
+    base::PlatformThread::Sleep(
+        base::TimeDelta::FromMilliseconds(kSoftLimitPollIntervalMs));
+    if (!IsOverSoftLimit())
+      return true;
+    // A cancelled job stops waiting, to release its memory.
+    if (CancellationToken::IsCurrentCancelled())
+      return false;
+  } while (base::TimeTicks::Now() < deadline);
+  return false;
+}
+
+std::string MemoryTracker::ToPrometheusText() {
+  std::string text =
+      "# HELP packager_memory_bytes Memory used by the packaging pipeline. "
+      "The categories with a parent are included in it.\n"
+      "# TYPE packager_memory_bytes gauge\n";
+  for (int i = 0; i < kNumMemoryCategories; ++i) {
+    const MemoryCategory category = static_cast<MemoryCategory>(i);
+    text += std::string("packager_memory_bytes{category=\"") +
+            kCategoryNames[i] + "\"";
+    if (kCategoryParents[i] != kNumMemoryCategories)
+      text += std::string(",parent=\"") + kCategoryNames[kCategoryParents[i]] +
+              "\"";
+    text += "} " + base::Uint64ToString(GetUsage(category)) + "\n";
+  }
+  text +=
+      "# HELP packager_memory_peak_bytes Largest memory used by the "
+      "packaging pipeline.\n"
+      "# TYPE packager_memory_peak_bytes gauge\n";
+  for (int i = 0; i < kNumMemoryCategories; ++i) {
+    const MemoryCategory category = static_cast<MemoryCategory>(i);
+    text += std::string("packager_memory_peak_bytes{category=\"") +
+            kCategoryNames[i] + "\"} " +
+            base::Uint64ToString(GetPeakUsage(category)) + "\n";
+  }
+  return text;
+}
+
+std::string MemoryTracker::ToJson() {
+  std::string json = "{";
+  for (int i = 0; i < kNumMemoryCategories; ++i) {
+    const MemoryCategory category = static_cast<MemoryCategory>(i);
+    if (i > 0)
+      json += ",";
+    json += std::string("\"") + kCategoryNames[i] + "\":{";
+    if (kCategoryParents[i] != kNumMemoryCategories)
+      json += std::string("\"parent\":\"") +
+              kCategoryNames[kCategoryParents[i]] + "\",";
+    json += "\"bytes\":" + base::Uint64ToString(GetUsage(category)) +
+            ",\"peak_bytes\":" +
+            base::Uint64ToString(GetPeakUsage(category)) + "}";
+  }
+  json += "}";
+  return json;
+}
+
+void MemoryTracker::ResetForTesting() {
+  for (int i = 0; i < kNumMemoryCategories; ++i) {
+    base::subtle::NoBarrier_Store(&g_peak_usage[i],
+                                  base::subtle::NoBarrier_Load(&g_usage[i]));
+    base::subtle::NoBarrier_Store(&g_soft_limits[i], 0);
+  }
+}
+
+TrackedMemory::TrackedMemory(MemoryCategory category)
+    : category_(category), bytes_(0) {}
+
+TrackedMemory::~TrackedMemory() {
+  MemoryTracker::Subtract(category_, bytes_);
+}
+
+void TrackedMemory::Set(uint64_t bytes) {
+  if (bytes > bytes_)
+    MemoryTracker::Add(category_, bytes - bytes_);
+  else
+    MemoryTracker::Subtract(category_, bytes_ - bytes);
+  bytes_ = bytes;
+}
+
+void TrackedMemory::Add(uint64_t bytes) {
+  MemoryTracker::Add(category_, bytes);
+  bytes_ += bytes;
+}
+
+void TrackedMemory::Subtract(uint64_t bytes) {
+  DCHECK_LE(bytes, bytes_);
+  MemoryTracker::Subtract(category_, bytes);
+  bytes_ -= bytes;
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,129 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_BASE_MEMORY_TRACKER_H_
+#define MEDIA_BASE_MEMORY_TRACKER_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "packager/base/macros.h"
+#include "packager/base/time/time.h"
+
+namespace edash_packager {
+namespace media {
+
+/// Categories of the memory accounted by MemoryTracker. The categories form
+/// a hierarchy: the memory of a child category is also counted in its parent,
+/// see MemoryTracker::GetParent().
+enum MemoryCategory {
+  /// Payloads of the MediaSamples and of the SharedBuffers they reference.
+  kSampleMemory,
+  /// Payloads of the samples queued in MediaStreams. Part of kSampleMemory.
+  kStreamQueueMemory,
+  /// Payloads of the samples queued in Demuxers until the streams are
+  /// initialized. Part of kSampleMemory.
+  kDemuxerQueueMemory,
+  /// Payloads of the samples held in mp4 fragments. Part of kSampleMemory.
+  kFragmenterMemory,
+  /// Buffers of the IoCaches of the threaded files.
+  kIoCacheMemory,
+  /// Estimated size of the segment infos of the MPD representations.
+  kMpdSegmentInfoMemory,
+  /// Estimated size of the entries of the HLS media playlists.
+  kHlsEntryMemory,
+  kNumMemoryCategories,
+};
+
+/// Process-wide accounting of the memory used by the packaging pipeline, by
+/// category. Optional soft limits let the demuxers wait for the memory to be
+/// released instead of growing without bounds.
+///
+/// Thread Safety: All the methods can be called from any thread.
+class MemoryTracker {
+ public:
+  /// Accounts @a bytes more memory in @a category. Usually called through
+  /// TrackedMemory.
+  static void Add(MemoryCategory category, uint64_t bytes);
+
+  /// Accounts @a bytes less memory in @a category.
+  static void Subtract(MemoryCategory category, uint64_t bytes);
+
+  /// @return the memory currently used in @a category, in bytes.
+  static uint64_t GetUsage(MemoryCategory category);
+
+  /// @return the largest memory used in @a category so far, in bytes.
+  static uint64_t GetPeakUsage(MemoryCategory category);
+
+  /// @return the parent of @a category, or kNumMemoryCategories if it is a
+  ///         top level category.
+  static MemoryCategory GetParent(MemoryCategory category);
+
+  /// @return the name of @a category used in the exported usage.
+  static const char* GetCategoryName(MemoryCategory category);
+
+  /// Sets a soft limit on the memory used in @a category.
+  /// @param limit is the limit in bytes, or 0 for no limit.
+  static void SetSoftLimit(MemoryCategory category, uint64_t limit);
+
+  /// @return true if the memory used in any category is above its limit.
+  static bool IsOverSoftLimit();
+
+  /// Blocks while the memory used in any category is above its limit, for
+  /// at most @a max_wait. The wait has to be bounded since the memory of some
+  /// categories is only released further down the pipeline, which may depend
+  /// on the caller making progress.
+  /// The wait also ends when the current CancellationToken of the calling
+  /// thread is cancelled.
+  /// @return true if the memory is within the limits.
+  static bool WaitUntilUnderSoftLimits(base::TimeDelta max_wait);
+
+  /// @return the usage of the categories in the Prometheus text exposition
+  ///         format.
+  static std::string ToPrometheusText();
+
+  /// @return the usage of the categories as a JSON object.
+  static std::string ToJson();
+
+  /// Resets the peak usage to the current usage and clears the soft limits.
+  /// The current usage is kept since it is released later by its owners.
+  static void ResetForTesting();
+
+ private:
+  DISALLOW_IMPLICIT_CONSTRUCTORS(MemoryTracker);
+};
+
+/// Memory of an object accounted in a MemoryTracker category. The memory is
+/// released from the category when the TrackedMemory is destroyed.
+///
+/// Thread Safety: Not thread safe; owned by a single object like the memory
+/// it accounts.
+class TrackedMemory {
+ public:
+  explicit TrackedMemory(MemoryCategory category);
+  ~TrackedMemory();
+
+  /// Sets the accounted memory to @a bytes.
+  void Set(uint64_t bytes);
+  /// Accounts @a bytes more memory.
+  void Add(uint64_t bytes);
+  /// Accounts @a bytes less memory.
+  void Subtract(uint64_t bytes);
+
+  uint64_t bytes() const { return bytes_; }
+
+ private:
+  const MemoryCategory category_;
+  uint64_t bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(TrackedMemory);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_BASE_MEMORY_TRACKER_H_
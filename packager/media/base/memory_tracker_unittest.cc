@@ -0,0 +1,93 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+
+#include "packager/media/base/memory_tracker.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+const uint64_t kBytes = 1000;
+}  // namespace
+
+// The usage is process-wide, so it is compared to the usage before the test.
+class MemoryTrackerTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    MemoryTracker::ResetForTesting();
+    initial_usage_ = MemoryTracker::GetUsage(kIoCacheMemory);
+  }
+  void TearDown() override { MemoryTracker::ResetForTesting(); }
+
+ protected:
+  uint64_t initial_usage_;
+};
+
+TEST_F(MemoryTrackerTest, TrackedMemory) {
+  {
+    TrackedMemory memory(kIoCacheMemory);
+    memory.Set(kBytes);
+    EXPECT_EQ(initial_usage_ + kBytes, MemoryTracker::GetUsage(kIoCacheMemory));
+    memory.Add(kBytes);
+    EXPECT_EQ(2 * kBytes, memory.bytes());
+    memory.Subtract(kBytes / 2);
+    memory.Set(kBytes / 4);
+    EXPECT_EQ(initial_usage_ + kBytes / 4,
+              MemoryTracker::GetUsage(kIoCacheMemory));
+  }
+  // Released on destruction.
+  EXPECT_EQ(initial_usage_, MemoryTracker::GetUsage(kIoCacheMemory));
+  EXPECT_EQ(initial_usage_ + 2 * kBytes,
+            MemoryTracker::GetPeakUsage(kIoCacheMemory));
+}
+
+TEST_F(MemoryTrackerTest, Hierarchy) {
+  EXPECT_EQ(kSampleMemory, MemoryTracker::GetParent(kStreamQueueMemory));
+  EXPECT_EQ(kSampleMemory, MemoryTracker::GetParent(kFragmenterMemory));
+  EXPECT_EQ(kNumMemoryCategories, MemoryTracker::GetParent(kSampleMemory));
+  EXPECT_EQ(kNumMemoryCategories, MemoryTracker::GetParent(kHlsEntryMemory));
+  EXPECT_STREQ("stream_queue",
+               MemoryTracker::GetCategoryName(kStreamQueueMemory));
+}
+
+TEST_F(MemoryTrackerTest, SoftLimit) {
+  TrackedMemory memory(kIoCacheMemory);
+  MemoryTracker::SetSoftLimit(kIoCacheMemory, initial_usage_ + kBytes);
+  memory.Set(kBytes);
+  EXPECT_FALSE(MemoryTracker::IsOverSoftLimit());
+  memory.Add(1);
+  EXPECT_TRUE(MemoryTracker::IsOverSoftLimit());
+  EXPECT_FALSE(MemoryTracker::WaitUntilUnderSoftLimits(
+      base::TimeDelta::FromMilliseconds(20)));
+
+  memory.Set(0);
+  EXPECT_TRUE(
+      MemoryTracker::WaitUntilUnderSoftLimits(base::TimeDelta::FromSeconds(1)));
+
+  // No limit.
+  MemoryTracker::SetSoftLimit(kIoCacheMemory, 0);
+  memory.Set(initial_usage_ + 2 * kBytes);
+  EXPECT_FALSE(MemoryTracker::IsOverSoftLimit());
+}
+
+TEST_F(MemoryTrackerTest, ToJson) {
+  EXPECT_EQ(0u, MemoryTracker::ToJson().find("{\"sample\":{\"bytes\":"));
+  EXPECT_NE(std::string::npos,
+            MemoryTracker::ToJson().find(
+                "\"stream_queue\":{\"parent\":\"sample\",\"bytes\":"));
+}
+
+TEST_F(MemoryTrackerTest, ToPrometheusText) {
+  EXPECT_NE(std::string::npos,
+            MemoryTracker::ToPrometheusText().find(
+                "packager_memory_bytes{category=\"fragmenter\","
+                "parent=\"sample\"} "));
+}
+
+}  // namespace media
+}  // namespace edash_packager
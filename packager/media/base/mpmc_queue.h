@@ -0,0 +1,457 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_BASE_MPMC_QUEUE_H_
+#define MEDIA_BASE_MPMC_QUEUE_H_
+
+#include <algorithm>
+
+#include "packager/base/atomicops.h"
+#include "packager/base/logging.h"
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/synchronization/condition_variable.h"
+#include "packager/base/synchronization/lock.h"
+#include "packager/base/threading/platform_thread.h"
+#include "packager/base/timer/elapsed_timer.h"
+#include "packager/media/base/cancellation_token.h"
+#include "packager/media/base/producer_consumer_queue.h"
+#include "packager/media/base/status.h"
+
+namespace edash_packager {
+namespace media {
+
+/// A lock-free bounded multi-producer multi-consumer FIFO queue. Each slot of
+/// the ring has a sequence number telling whether it is free for the
+/// producer or full for the consumer of a given position, so producers and
+/// consumers only contend on the position they claim with a compare and swap,
+/// and batches of consecutive slots are claimed with a single one. The
+/// operations never block; see BlockingMpmcQueue for blocking ones.
+/// T must be default constructible and assignable. The elements popped are
+/// left in the ring, until overwritten, as default constructed values.
+template <class T>
+class MpmcQueue {
+ public:
+  /// @param capacity is the maximum number of elements that the queue can hold
+  ///        at once, rounded up to a power of two. Must not be zero.
+  explicit MpmcQueue(size_t capacity);
+  ~MpmcQueue() {}
+
+  /// Push an element to the back of the queue.
+  /// @return false if the queue is full.
+  bool TryPush(const T& element) { return TryPushBatch(&element, 1) == 1; }
+
+  /// Pop an element from the front of the queue.
+  /// @return false if the queue is empty.
+  bool TryPop(T* element) { return TryPopBatch(element, 1) == 1; }
+
+  /// Push up to @a num_elements elements, in order, as far as there is room.
+  /// @return the number of elements pushed, from the front of @a elements.
+  size_t TryPushBatch(const T* elements, size_t num_elements);
+
+  /// Pop up to @a max_elements elements, in order.
+  /// @return the number of elements popped into @a elements.
+  size_t TryPopBatch(T* elements, size_t max_elements);
+
+  /// @return the number of elements in the queue, which may be outdated by
+  ///         the time it is returned if other threads use the queue.
+  size_t Size() const;
+
+  /// @return the capacity of the queue.
+  size_t capacity() const { return mask_ + 1; }
+
+ private:
+  typedef base::subtle::AtomicWord AtomicWord;
+
+  struct Slot {
+    Slot() : sequence(0) {}
+
+    // Position + 1 once the element of the position is written, position +
+    // capacity once it is read.
+    AtomicWord sequence;
+    T element;
+  };
+
+  // Rough size of a cache line. The positions are placed on different cache
+  // lines to avoid false sharing between the producers and the consumers.
+  static const size_t kCacheLineSize = 64;
+
+  // Capacity - 1, the capacity being a power of two.
+  const AtomicWord mask_;
+  scoped_ptr<Slot[]> slots_;
+  // Position of the next element to push.
+  AtomicWord push_position_;
+  char push_position_padding_[kCacheLineSize - sizeof(AtomicWord)];
+  // Position of the next element to pop.
+  AtomicWord pop_position_;
+  char pop_position_padding_[kCacheLineSize - sizeof(AtomicWord)];
+
+  DISALLOW_COPY_AND_ASSIGN(MpmcQueue);
+};
+
+/// A bounded multi-producer multi-consumer FIFO queue with blocking
+/// operations, with the same semantics as the Push() and Pop() of
+/// ProducerConsumerQueue, on top of MpmcQueue. A blocked thread first spins
+/// for a little while, which is enough when the other side is busy on
+/// another core, before it parks on a condition variable. The lock of the
+/// condition variable is only taken to park and to wake parked threads up.
+/// Unlike ProducerConsumerQueue, there is no positional Peek(): use
+/// ProducerConsumerQueue when the elements have to be looked up by position,
+/// e.g. for key rotation.
+template <class T>
+class BlockingMpmcQueue {
+ public:
+  /// @param capacity is the maximum number of elements that the queue can hold
+  ///        at once, rounded up to a power of two. Must not be zero.
+  explicit BlockingMpmcQueue(size_t capacity);
+  ~BlockingMpmcQueue() {}
+
+  /// Push an element to the back of the queue, waiting for room.
+  /// @param timeout_ms indicates timeout in milliseconds. A value of zero means
+  ///        return immediately. A negative value means waiting indefinitely.
+  /// @return OK if the element was pushed, STOPPED if Stop() has been called,
+  ///         TIME_OUT if times out, CANCELLED if the current
+  ///         CancellationToken is cancelled while waiting.
+  Status Push(const T& element, int64_t timeout_ms) {
+    return PushBatch(&element, 1, timeout_ms);
+  }
+
+  /// Push @a num_elements elements, in order, waiting for room as needed.
+  /// Another producer may interleave its elements with the elements of a
+  /// batch which does not fit at once.
+  /// @return same as Push(). On error, only some of the elements may have been
+  ///         pushed.
+  Status PushBatch(const T* elements, size_t num_elements, int64_t timeout_ms);
+
+  /// Pop an element from the front of the queue, waiting for one.
+  /// @param timeout_ms is as in Push().
+  /// @return STOPPED if Stop() has been called and the queue is empty,
+  ///         TIME_OUT if times out, CANCELLED if the current CancellationToken
+  ///         is cancelled while waiting, OK otherwise.
+  Status Pop(T* element, int64_t timeout_ms) {
+    size_t num_popped;
+    return PopBatch(element, 1, &num_popped, timeout_ms);
+  }
+
+  /// Pop at least one and up to @a max_elements elements, in order, waiting
+  /// for the first one.
+  /// @param[out] num_popped receives the number of elements popped.
+  /// @return same as Pop().
+  Status PopBatch(T* elements,
+                  size_t max_elements,
+                  size_t* num_popped,
+                  int64_t timeout_ms);
+
+  /// Terminate the waiting and future Push requests immediately, and the Pop
+  /// requests once the queue is empty.
+  void Stop();
+
+  /// @return true if Stop() has been called.
+  bool Stopped() const { return base::subtle::Acquire_Load(&stopped_) != 0; }
+
+  /// @return the number of elements in the queue, approximately.
+  size_t Size() const { return queue_.Size(); }
+
+ private:
+  typedef base::subtle::Atomic32 Atomic32;
+
+  // Number of tries before parking. A try costs about as much as a cache
+  // miss, so this is in the order of microseconds.
+  static const int kSpinCount = 100;
+
+  // Waits on |cv| until |done| returns true, spinning first. |waiters| is the
+  // number of threads parked on |cv|.
+  // Returns TIME_OUT if timed out, CANCELLED if cancelled, OK otherwise.
+  template <class Predicate>
+  Status WaitUntil(const Predicate& done,
+                   base::ConditionVariable* cv,
+                   Atomic32* waiters,
+                   int64_t timeout_ms,
+                   const char* timeout_message);
+  // Wakes up the threads parked on |cv| if there are any.
+  void WakeUp(base::ConditionVariable* cv, Atomic32* waiters);
+
+  // Predicates of WaitUntil().
+  struct PushPredicate;
+  struct PopPredicate;
+
+  MpmcQueue<T> queue_;
+  Atomic32 stopped_;
+  Atomic32 push_waiters_;
+  Atomic32 pop_waiters_;
+  base::Lock lock_;
+  base::ConditionVariable not_full_cv_;
+  base::ConditionVariable not_empty_cv_;
+
+  DISALLOW_COPY_AND_ASSIGN(BlockingMpmcQueue);
+};
+
+// Implementations of non-inline functions.
+namespace internal {
+
+inline size_t RoundUpToPowerOfTwo(size_t value) {
+  size_t power_of_two = 1;
+  while (power_of_two < value)
+    power_of_two *= 2;
+  return power_of_two;
+}
+
+}  // namespace internal
+
+template <class T>
+MpmcQueue<T>::MpmcQueue(size_t capacity)
+    : mask_(internal::RoundUpToPowerOfTwo(capacity) - 1),
+      slots_(new Slot[mask_ + 1]),
+      push_position_(0),
+      pop_position_(0) {
+  DCHECK_GT(capacity, 0u);
+  for (AtomicWord i = 0; i <= mask_; ++i)
+    slots_[i].sequence = i;
+}
+
+template <class T>
+size_t MpmcQueue<T>::TryPushBatch(const T* elements, size_t num_elements) {
+  while (true) {
+    const AtomicWord position = base::subtle::NoBarrier_Load(&push_position_);
+    // The slots free for the next positions. A slot free for a position stays
+    // so until the position is claimed.
+    size_t num_free = 0;
+    bool outdated = false;
+    while (num_free < num_elements) {
+      const AtomicWord slot_position = position + num_free;
+      const AtomicWord sequence = base::subtle::Acquire_Load(
+          &slots_[slot_position & mask_].sequence);
+      if (sequence != slot_position) {
+        // Ahead: another producer claimed the position already. Behind: the
+        // element of the previous lap is not popped yet.
+        outdated = num_free == 0 && sequence > slot_position;
+        break;
+      }
+      ++num_free;
+    }
+    if (outdated)
+      continue;
+    if (num_free == 0)
+      return 0;  // Full.
+    if (base::subtle::NoBarrier_CompareAndSwap(&push_position_, position,
+                                               position + num_free) !=
+        position) {
+      continue;
+    }
+    for (size_t i = 0; i < num_free; ++i) {
+      Slot& slot = slots_[(position + i) & mask_];
+      slot.element = elements[i];
+      base::subtle::Release_Store(&slot.sequence, position + i + 1);
+    }
+    return num_free;
+  }
+}
+
+template <class T>
+size_t MpmcQueue<T>::TryPopBatch(T* elements, size_t max_elements) {
+  while (true) {
+    const AtomicWord position = base::subtle::NoBarrier_Load(&pop_position_);
+    size_t num_full = 0;
+    bool outdated = false;
+    while (num_full < max_elements) {
+      const AtomicWord slot_position = position + num_full;
+      const AtomicWord sequence = base::subtle::Acquire_Load(
+          &slots_[slot_position & mask_].sequence);
+      if (sequence != slot_position + 1) {
+        // Ahead: another consumer popped the element already. Behind: the
+        // element is not pushed yet.
+        outdated = num_full == 0 && sequence > slot_position + 1;
+        break;
+      }
+      ++num_full;
+    }
+    if (outdated)
+      continue;
+    if (num_full == 0)
+      return 0;  // Empty.
+    if (base::subtle::NoBarrier_CompareAndSwap(&pop_position_, position,
+                                               position + num_full) !=
+        position) {
+      continue;
+    }
+    for (size_t i = 0; i < num_full; ++i) {
+      Slot& slot = slots_[(position + i) & mask_];
+      elements[i] = slot.element;
+      // Releases what the element holds, e.g. a reference.
+      slot.element = T();
+      base::subtle::Release_Store(&slot.sequence, position + i + mask_ + 1);
+    }
+    return num_full;
+  }
+}
+
+template <class T>
+size_t MpmcQueue<T>::Size() const {
+  const AtomicWord pop_position = base::subtle::Acquire_Load(&pop_position_);
+  const AtomicWord push_position = base::subtle::Acquire_Load(&push_position_);
+  return push_position > pop_position ? push_position - pop_position : 0;
+}
+
+template <class T>
+struct BlockingMpmcQueue<T>::PushPredicate {
+  PushPredicate(MpmcQueue<T>* queue,
+                const T* elements,
+                size_t num_elements,
+                size_t* num_pushed)
+      : queue(queue),
+        elements(elements),
+        num_elements(num_elements),
+        num_pushed(num_pushed) {}
+
+  bool operator()() const {
+    *num_pushed += queue->TryPushBatch(elements + *num_pushed,
+                                       num_elements - *num_pushed);
+    return *num_pushed == num_elements;
+  }
+
+  MpmcQueue<T>* queue;
+  const T* elements;
+  size_t num_elements;
+  size_t* num_pushed;
+};
+
+template <class T>
+struct BlockingMpmcQueue<T>::PopPredicate {
+  PopPredicate(MpmcQueue<T>* queue,
+               T* elements,
+               size_t max_elements,
+               size_t* num_popped)
+      : queue(queue),
+        elements(elements),
+        max_elements(max_elements),
+        num_popped(num_popped) {}
+
+  bool operator()() const {
+    *num_popped = queue->TryPopBatch(elements, max_elements);
+    return *num_popped > 0;
+  }
+
+  MpmcQueue<T>* queue;
+  T* elements;
+  size_t max_elements;
+  size_t* num_popped;
+};
+
+template <class T>
+BlockingMpmcQueue<T>::BlockingMpmcQueue(size_t capacity)
+    : queue_(capacity),
+      stopped_(0),
+      push_waiters_(0),
+      pop_waiters_(0),
+      not_full_cv_(&lock_),
+      not_empty_cv_(&lock_) {}
+
+template <class T>
+Status BlockingMpmcQueue<T>::PushBatch(const T* elements,
+                                       size_t num_elements,
+                                       int64_t timeout_ms) {
+  if (Stopped())
+    return Status(error::STOPPED, "");
+  size_t num_pushed = 0;
+  Status status =
+      WaitUntil(PushPredicate(&queue_, elements, num_elements, &num_pushed),
+                &not_full_cv_, &push_waiters_, timeout_ms,
+                "Time out on pushing.");
+  if (num_pushed > 0)
+    WakeUp(&not_empty_cv_, &pop_waiters_);
+  return status;
+}
+
+template <class T>
+Status BlockingMpmcQueue<T>::PopBatch(T* elements,
+                                      size_t max_elements,
+                                      size_t* num_popped,
+                                      int64_t timeout_ms) {
+  DCHECK(num_popped);
+  *num_popped = 0;
+  Status status = WaitUntil(
+      PopPredicate(&queue_, elements, max_elements, num_popped),
+      &not_empty_cv_, &pop_waiters_, timeout_ms, "Time out on popping.");
+  if (*num_popped > 0)
+    WakeUp(&not_full_cv_, &push_waiters_);
+  return status;
+}
+
+template <class T>
+void BlockingMpmcQueue<T>::Stop() {
+  base::AutoLock auto_lock(lock_);
+  base::subtle::Release_Store(&stopped_, 1);
+  not_full_cv_.Broadcast();
+  not_empty_cv_.Broadcast();
+}
+
+template <class T>
+template <class Predicate>
+Status BlockingMpmcQueue<T>::WaitUntil(const Predicate& done,
+                                       base::ConditionVariable* cv,
+                                       Atomic32* waiters,
+                                       int64_t timeout_ms,
+                                       const char* timeout_message) {
+  if (done())
+    return Status::OK;
+  const CancellationToken* token = CancellationToken::Current();
+  base::ElapsedTimer timer;
+  const base::TimeDelta timeout = base::TimeDelta::FromMilliseconds(timeout_ms);
+  for (int i = 0; timeout_ms != 0 && i < kSpinCount; ++i) {
+    base::PlatformThread::YieldCurrentThread();
+    if (done())
+      return Status::OK;
+  }
+
+  base::AutoLock auto_lock(lock_);
+  base::subtle::NoBarrier_AtomicIncrement(waiters, 1);
+  Status status;
+  while (true) {
+    // Pairs with the barrier in WakeUp(): either the other side's update is
+    // seen, or the other side sees |waiters| and signals under |lock_|.
+    base::subtle::MemoryBarrier();
+    if (done())
+      break;
+    // Pop drains the queue before reporting that it is stopped.
+    if (Stopped()) {
+      status = Status(error::STOPPED, "");
+      break;
+    }
+    if (token && token->IsCancelled()) {
+      status = Status(error::CANCELLED, "Cancelled while waiting.");
+      break;
+    }
+    base::TimeDelta wait_delta =
+        base::TimeDelta::FromMilliseconds(kCancellationCheckIntervalMs);
+    if (timeout_ms >= 0) {
+      const base::TimeDelta elapsed = timer.Elapsed();
+      if (elapsed >= timeout) {
+        status = Status(error::TIME_OUT, timeout_message);
+        break;
+      }
+      wait_delta = std::min(wait_delta, timeout - elapsed);
+    }
+    // Timed even without a token, as in ProducerConsumerQueue, so that a
+    // missed wake up only delays the waiter.
+    cv->TimedWait(wait_delta);
+  }
+  base::subtle::NoBarrier_AtomicIncrement(waiters, -1);
+  return status;
+}
+
+template <class T>
+void BlockingMpmcQueue<T>::WakeUp(base::ConditionVariable* cv,
+                                  Atomic32* waiters) {
+  base::subtle::MemoryBarrier();
+  if (base::subtle::NoBarrier_Load(waiters) == 0)
+    return;
+  base::AutoLock auto_lock(lock_);
+  cv->Broadcast();
+}
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_BASE_MPMC_QUEUE_H_
@@ -0,0 +1,227 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "packager/base/bind.h"
+#include "packager/base/timer/elapsed_timer.h"
+#include "packager/media/base/cancellation_token.h"
+#include "packager/media/base/closure_thread.h"
+#include "packager/media/base/mpmc_queue.h"
+#include "packager/media/base/test/status_test_util.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+const size_t kCapacity = 8u;
+const int64_t kTimeout = 100;  // 0.1s.
+
+// Small enough for the producers and consumers to wait on each other.
+const size_t kMultiThreadCapacity = 16u;
+const int kNumProducers = 3;
+const int kNumConsumers = 3;
+const int kNumElementsPerProducer = 10000;
+const size_t kBatchSize = 5u;
+
+}  // namespace
+
+TEST(MpmcQueueTest, RoundsCapacityUp) {
+  EXPECT_EQ(1u, MpmcQueue<int>(1u).capacity());
+  EXPECT_EQ(8u, MpmcQueue<int>(5u).capacity());
+  EXPECT_EQ(8u, MpmcQueue<int>(8u).capacity());
+}
+
+TEST(MpmcQueueTest, PushPop) {
+  MpmcQueue<size_t> queue(kCapacity);
+  size_t value;
+  EXPECT_FALSE(queue.TryPop(&value));
+
+  // Twice, so that the positions wrap around the ring.
+  for (int round = 0; round < 2; ++round) {
+    for (size_t i = 0; i < kCapacity; ++i)
+      ASSERT_TRUE(queue.TryPush(i));
+    EXPECT_EQ(kCapacity, queue.Size());
+    EXPECT_FALSE(queue.TryPush(kCapacity));
+
+    for (size_t i = 0; i < kCapacity; ++i) {
+      ASSERT_TRUE(queue.TryPop(&value));
+      EXPECT_EQ(i, value);
+    }
+    EXPECT_EQ(0u, queue.Size());
+    EXPECT_FALSE(queue.TryPop(&value));
+  }
+}
+
+TEST(MpmcQueueTest, Batches) {
+  MpmcQueue<size_t> queue(kCapacity);
+  std::vector<size_t> elements(kCapacity + 3);
+  for (size_t i = 0; i < elements.size(); ++i)
+    elements[i] = i;
+
+  // Only the elements which fit are pushed.
+  EXPECT_EQ(5u, queue.TryPushBatch(&elements[0], 5));
+  EXPECT_EQ(kCapacity - 5, queue.TryPushBatch(&elements[5], 6));
+  EXPECT_EQ(0u, queue.TryPushBatch(&elements[kCapacity], 3));
+
+  std::vector<size_t> popped(kCapacity + 3);
+  EXPECT_EQ(3u, queue.TryPopBatch(&popped[0], 3));
+  EXPECT_EQ(3u, queue.TryPushBatch(&elements[kCapacity], 3));
+  EXPECT_EQ(kCapacity, queue.TryPopBatch(&popped[3], popped.size()));
+  EXPECT_EQ(elements, popped);
+  EXPECT_EQ(0u, queue.TryPopBatch(&popped[0], popped.size()));
+}
+
+TEST(MpmcQueueTest, ReleasesPoppedElements) {
+  MpmcQueue<scoped_refptr<CancellationToken> > queue(kCapacity);
+  scoped_refptr<CancellationToken> token(new CancellationToken);
+  ASSERT_TRUE(queue.TryPush(token));
+  scoped_refptr<CancellationToken> popped;
+  ASSERT_TRUE(queue.TryPop(&popped));
+  popped = NULL;
+  EXPECT_TRUE(token->HasOneRef());
+}
+
+TEST(BlockingMpmcQueueTest, PushWithTimeout) {
+  BlockingMpmcQueue<size_t> queue(kCapacity);
+  for (size_t i = 0; i < kCapacity; ++i)
+    ASSERT_OK(queue.Push(i, 0));
+  EXPECT_EQ(error::TIME_OUT, queue.Push(0, 0).error_code());
+
+  base::ElapsedTimer timer;
+  EXPECT_EQ(error::TIME_OUT, queue.Push(0, kTimeout).error_code());
+  EXPECT_GE(timer.Elapsed().InMilliseconds(), kTimeout);
+}
+
+TEST(BlockingMpmcQueueTest, PopWithTimeout) {
+  BlockingMpmcQueue<size_t> queue(kCapacity);
+  size_t value;
+  EXPECT_EQ(error::TIME_OUT, queue.Pop(&value, 0).error_code());
+
+  base::ElapsedTimer timer;
+  EXPECT_EQ(error::TIME_OUT, queue.Pop(&value, kTimeout).error_code());
+  EXPECT_GE(timer.Elapsed().InMilliseconds(), kTimeout);
+}
+
+TEST(BlockingMpmcQueueTest, PopBatch) {
+  BlockingMpmcQueue<size_t> queue(kCapacity);
+  const size_t elements[] = {1, 2, 3};
+  ASSERT_OK(queue.PushBatch(elements, arraysize(elements), 0));
+
+  // Returns what is there without waiting for more.
+  size_t popped[kCapacity];
+  size_t num_popped = 0;
+  ASSERT_OK(queue.PopBatch(popped, kCapacity, &num_popped, kInfiniteTimeout));
+  ASSERT_EQ(arraysize(elements), num_popped);
+  EXPECT_EQ(1u, popped[0]);
+  EXPECT_EQ(3u, popped[2]);
+}
+
+TEST(BlockingMpmcQueueTest, Stop) {
+  BlockingMpmcQueue<size_t> queue(kCapacity);
+  ASSERT_OK(queue.Push(1, 0));
+  queue.Stop();
+  EXPECT_TRUE(queue.Stopped());
+  EXPECT_EQ(error::STOPPED, queue.Push(2, 0).error_code());
+
+  // The elements left are still popped.
+  size_t value;
+  ASSERT_OK(queue.Pop(&value, kInfiniteTimeout));
+  EXPECT_EQ(1u, value);
+  EXPECT_EQ(error::STOPPED,
+            queue.Pop(&value, kInfiniteTimeout).error_code());
+}
+
+TEST(BlockingMpmcQueueTest, CancelledToken) {
+  BlockingMpmcQueue<size_t> queue(kCapacity);
+  scoped_refptr<CancellationToken> token(new CancellationToken);
+  token->Cancel();
+  ScopedCancellationToken scoped_token(token.get());
+
+  size_t value;
+  EXPECT_EQ(error::CANCELLED,
+            queue.Pop(&value, kInfiniteTimeout).error_code());
+}
+
+class MultiThreadBlockingMpmcQueueTest : public ::testing::Test {
+ public:
+  MultiThreadBlockingMpmcQueueTest()
+      : queue_(kMultiThreadCapacity), sums_(kNumConsumers, 0) {}
+
+ protected:
+  // Pushes |producer| * kNumElementsPerProducer + 1 and up, in batches.
+  void Produce(int producer) {
+    const size_t first = producer * kNumElementsPerProducer + 1;
+    std::vector<size_t> batch;
+    for (int i = 0; i < kNumElementsPerProducer; ++i) {
+      batch.push_back(first + i);
+      if (batch.size() == kBatchSize || i == kNumElementsPerProducer - 1) {
+        ASSERT_OK(
+            queue_.PushBatch(&batch[0], batch.size(), kInfiniteTimeout));
+        batch.clear();
+      }
+    }
+  }
+
+  // Sums the elements popped until the queue is stopped.
+  void Consume(int consumer) {
+    size_t batch[kBatchSize];
+    size_t num_popped;
+    while (true) {
+      Status status =
+          queue_.PopBatch(batch, kBatchSize, &num_popped, kInfiniteTimeout);
+      if (status.error_code() == error::STOPPED)
+        return;
+      ASSERT_OK(status);
+      for (size_t i = 0; i < num_popped; ++i)
+        sums_[consumer] += batch[i];
+    }
+  }
+
+  BlockingMpmcQueue<size_t> queue_;
+  std::vector<uint64_t> sums_;
+};
+
+TEST_F(MultiThreadBlockingMpmcQueueTest, ProducersAndConsumers) {
+  std::vector<ClosureThread*> producers;
+  std::vector<ClosureThread*> consumers;
+  for (int i = 0; i < kNumProducers; ++i) {
+    producers.push_back(new ClosureThread(
+        "Producer", base::Bind(&MultiThreadBlockingMpmcQueueTest::Produce,
+                               base::Unretained(this), i)));
+    producers.back()->Start();
+  }
+  for (int i = 0; i < kNumConsumers; ++i) {
+    consumers.push_back(new ClosureThread(
+        "Consumer", base::Bind(&MultiThreadBlockingMpmcQueueTest::Consume,
+                               base::Unretained(this), i)));
+    consumers.back()->Start();
+  }
+
+  for (size_t i = 0; i < producers.size(); ++i) {
+    producers[i]->Join();
+    delete producers[i];
+  }
+  queue_.Stop();
+  for (size_t i = 0; i < consumers.size(); ++i) {
+    consumers[i]->Join();
+    delete consumers[i];
+  }
+
+  // Every element is popped exactly once.
+  const uint64_t num_elements = kNumProducers * kNumElementsPerProducer;
+  uint64_t sum = 0;
+  for (size_t i = 0; i < sums_.size(); ++i)
+    sum += sums_[i];
+  EXPECT_EQ(num_elements * (num_elements + 1) / 2, sum);
+  EXPECT_EQ(0u, queue_.Size());
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -6,13 +6,27 @@
 
 #include "packager/media/base/muxer.h"
 
+#include "packager/media/base/cancellation_token.h"
+#include "packager/media/base/decryptor_source.h"
+#include "packager/media/base/demuxer.h"
 #include "packager/media/base/fourccs.h"
+#include "packager/media/base/key_source.h"
 #include "packager/media/base/media_sample.h"
 #include "packager/media/base/media_stream.h"
+#include "packager/media/base/pipeline_metrics.h"
+#include "packager/media/base/stream_info.h"
+#include "packager/media/base/timed_metadata.h"
 
 namespace edash_packager {
 namespace media {
 
+namespace {
+// Minimum interval between two health reports of a stream.
+const int64_t kLiveStreamHealthReportIntervalMs = 1000;
+}  // namespace
+
+Muxer::StreamTiming::StreamTiming() : start_dts(0) {}
+
 Muxer::Muxer(const MuxerOptions& options)
     : options_(options),
       initialized_(false),
@@ -21,7 +35,11 @@ Muxer::Muxer(const MuxerOptions& options)
       clear_lead_in_seconds_(0),
       crypto_period_duration_in_seconds_(0),
       protection_scheme_(FOURCC_NULL),
+      crypto_context_cache_(NULL),
+      key_rotation_schedule_(NULL),
       cancelled_(false),
+      num_trick_play_key_frames_(0),
+      trick_play_end_time_(0),
       clock_(NULL) {}
 
 Muxer::~Muxer() {}
@@ -43,6 +61,7 @@ void Muxer::AddStream(MediaStream* stream) {
   DCHECK(stream);
   stream->Connect(this);
   streams_.push_back(stream);
+  stream_timings_.push_back(StreamTiming());
 }
 
 Status Muxer::Run() {
@@ -58,25 +77,33 @@ Status Muxer::Run() {
       return status;
   }
 
+  // Pull a sample of each stream in turn, so that the samples of the streams
+  // are interleaved, until the end of all the streams.
+  std::vector<bool> end_of_stream(streams_.size(), false);
+  size_t num_streams_ended = 0;
   uint32_t current_stream_id = 0;
-  while (status.ok()) {
-    if (cancelled_)
+  while (num_streams_ended < streams_.size()) {
+    if (cancelled_ || CancellationToken::IsCurrentCancelled())
       return Status(error::CANCELLED, "muxer run cancelled");
 
-    scoped_refptr<MediaSample> sample;
-    status = streams_[current_stream_id]->PullSample(&sample);
-    if (!status.ok())
-      break;
-    status = AddSample(streams_[current_stream_id], sample);
-
-    // Switch to next stream if the current stream is ready for fragmentation.
-    if (status.error_code() == error::FRAGMENT_FINALIZED) {
-      current_stream_id = (current_stream_id + 1) % streams_.size();
-      status.Clear();
+    if (!end_of_stream[current_stream_id]) {
+      scoped_refptr<MediaSample> sample;
+      status = streams_[current_stream_id]->PullSample(&sample);
+      if (status.error_code() == error::END_OF_STREAM) {
+        end_of_stream[current_stream_id] = true;
+        ++num_streams_ended;
+      } else if (!status.ok()) {
+        return status;
+      } else {
+        status = AddSample(streams_[current_stream_id], sample);
+        if (!status.ok())
+          return status;
+      }
     }
+    current_stream_id = (current_stream_id + 1) % streams_.size();
   }
   // Finalize the muxer after reaching end of stream.
-  return status.error_code() == error::END_OF_STREAM ? Finalize() : status;
+  return FinalizeMuxer();
 }
 
 void Muxer::Cancel() {
@@ -95,23 +122,151 @@ void Muxer::SetProgressListener(
 Status Muxer::AddSample(const MediaStream* stream,
                         scoped_refptr<MediaSample> sample) {
   DCHECK(std::find(streams_.begin(), streams_.end(), stream) != streams_.end());
+  ScopedStageTimer mux_timer(kMuxStage);
 
   if (!initialized_) {
+    if (options_.trick_play_factor > 0 &&
+        (streams_.size() != 1 ||
+         streams_[0]->info()->stream_type() != kStreamVideo)) {
+      return Status(error::INVALID_ARGUMENT,
+                    "Trick play requires a single video stream.");
+    }
     Status status = Initialize();
     if (!status.ok())
       return status;
     initialized_ = true;
   }
+  if (streams_[0]->HasTimedMetadata())
+    MuxTimedMetadata();
   if (sample->end_of_stream()) {
     // EOS sample should be sent only when the sample was pushed from Demuxer
     // to Muxer. In this case, there should be only one stream in Muxer.
     DCHECK_EQ(1u, streams_.size());
-    return Finalize();
-  } else if (sample->is_encrypted()) {
+    return FinalizeMuxer();
+  }
+  if (options_.trick_play_factor > 0) {
+    FilterTrickPlaySample(&sample);
+    if (!sample)
+      return Status::OK;
+  }
+  return MuxSample(stream, sample);
+}
+
+Status Muxer::MuxSample(const MediaStream* stream,
+                        scoped_refptr<MediaSample> sample) {
+  if (sample->is_encrypted()) {
     LOG(ERROR) << "Unable to multiplex encrypted media sample";
     return Status(error::INTERNAL_ERROR, "Encrypted media sample.");
+  } else if (sample->pending_decrypt_config() && !AcceptsPendingDecryption()) {
+    if (!DecryptorSource::DecryptPendingSample(sample.get()))
+      return Status(error::MUXER_FAILURE, "Failed to decrypt the sample.");
+  } else if (sample->passthrough_decrypt_config() &&
+             !AcceptsEncryptionPassthrough()) {
+    LOG(ERROR) << "Unable to multiplex encrypted media sample without "
+                  "decrypting it";
+    return Status(error::UNIMPLEMENTED,
+                  "Encryption pass-through is not supported by the muxer.");
+  }
+  Status status = DoAddSample(stream, sample);
+  if (status.ok() || status.error_code() == error::FRAGMENT_FINALIZED) {
+    if (progress_listener_) {
+      ReportLiveStreamHealth(
+          std::find(streams_.begin(), streams_.end(), stream) -
+              streams_.begin(),
+          *sample);
+    }
+  }
+  return status;
+}
+
+void Muxer::FilterTrickPlaySample(scoped_refptr<MediaSample>* sample) {
+  DCHECK(sample);
+  trick_play_end_time_ = (*sample)->dts() + (*sample)->duration();
+  if (!(*sample)->is_key_frame() ||
+      num_trick_play_key_frames_++ % options_.trick_play_factor != 0) {
+    *sample = NULL;
+    return;
+  }
+  // The sample is a shallow copy of its own if the stream is fanned out, so
+  // its duration can be changed.
+  if (trick_play_sample_) {
+    trick_play_sample_->set_duration((*sample)->dts() -
+                                     trick_play_sample_->dts());
+  }
+  trick_play_sample_.swap(*sample);
+}
+
+Status Muxer::FinalizeMuxer() {
+  MuxTimedMetadata();
+  if (trick_play_sample_) {
+    trick_play_sample_->set_duration(trick_play_end_time_ -
+                                     trick_play_sample_->dts());
+    scoped_refptr<MediaSample> sample;
+    sample.swap(trick_play_sample_);
+    Status status = MuxSample(streams_[0], sample);
+    if (!status.ok() && status.error_code() != error::FRAGMENT_FINALIZED)
+      return status;
+  }
+  return Finalize();
+}
+
+void Muxer::MuxTimedMetadata() {
+  std::vector<TimedMetadataEvent> events;
+  for (size_t i = 0; i < streams_.size(); ++i) {
+    if (!streams_[i]->HasTimedMetadata())
+      continue;
+    streams_[i]->TakeTimedMetadata(&events);
+    if (i > 0)
+      continue;
+    for (const TimedMetadataEvent& event : events)
+      DoAddTimedMetadata(event);
+  }
+}
+
+void Muxer::DoAddTimedMetadata(const TimedMetadataEvent& event) {
+  if (muxer_listener_)
+    muxer_listener_->OnTimedMetadata(event);
+}
+
+void Muxer::ReportLiveStreamHealth(size_t stream_index,
+                                   const MediaSample& sample) {
+  DCHECK_LT(stream_index, streams_.size());
+  StreamTiming& timing = stream_timings_[stream_index];
+  const base::TimeTicks now = base::TimeTicks::Now();
+  if (timing.start_time.is_null()) {
+    timing.start_time = now;
+    timing.start_dts = sample.dts();
+    timing.last_report_time = now;
+    return;
+  }
+  if (now - timing.last_report_time <
+      base::TimeDelta::FromMilliseconds(kLiveStreamHealthReportIntervalMs)) {
+    return;
+  }
+  timing.last_report_time = now;
+
+  MediaStream* stream = streams_[stream_index];
+  const uint32_t time_scale = stream->info()->time_scale();
+  if (time_scale == 0)
+    return;
+
+  LiveStreamHealth health;
+  health.track_id = stream->info()->track_id();
+  const double media_seconds =
+      static_cast<double>(sample.dts() + sample.duration() - timing.start_dts) /
+      time_scale;
+  health.real_time_lag =
+      (now - timing.start_time) -
+      base::TimeDelta::FromMicroseconds(static_cast<int64_t>(
+          media_seconds * base::Time::kMicrosecondsPerSecond));
+  health.queued_samples = stream->GetNumQueuedSamples();
+  if (stream->demuxer())
+    health.input_cached_bytes = stream->demuxer()->GetInputCachedSize();
+  if (encryption_key_source_) {
+    encryption_key_source_->GetKeyFetchStalls(&health.num_key_fetch_stalls,
+                                              &health.key_fetch_stall_time);
   }
-  return DoAddSample(stream, sample);
+  progress_listener_->OnLiveStreamHealth(health);
 }
 
 }  // namespace media
@@ -14,6 +14,7 @@
 #include "packager/base/memory/ref_counted.h"
 #include "packager/base/memory/scoped_ptr.h"
 #include "packager/base/time/clock.h"
+#include "packager/base/time/time.h"
 #include "packager/media/base/fourccs.h"
 #include "packager/media/base/muxer_options.h"
 #include "packager/media/base/status.h"
@@ -23,9 +24,12 @@
 namespace edash_packager {
 namespace media {
 
+class CryptoContextCache;
+class KeyRotationSchedule;
 class KeySource;
 class MediaSample;
 class MediaStream;
+struct TimedMetadataEvent;
 
 /// Muxer is responsible for taking elementary stream samples and producing
 /// media containers. An optional KeySource can be provided to Muxer
@@ -53,10 +57,27 @@ class Muxer {
                     double crypto_period_duration_in_seconds,
                     FourCC protection_scheme);
 
+  /// Share the key schedules of the encryptors with other muxers, typically
+  /// the muxers of the same packaging job. Optional.
+  /// @param crypto_context_cache is not owned and should outlive the muxer.
+  void set_crypto_context_cache(CryptoContextCache* crypto_context_cache) {
+    crypto_context_cache_ = crypto_context_cache;
+  }
+
+  /// Share the crypto periods of key rotation with other muxers, typically
+  /// the muxers of the same packaging job, so that their keys are fetched
+  /// once. Optional.
+  /// @param key_rotation_schedule is not owned and should outlive the muxer.
+  void set_key_rotation_schedule(KeyRotationSchedule* key_rotation_schedule) {
+    key_rotation_schedule_ = key_rotation_schedule;
+  }
+
   /// Add video/audio stream.
   void AddStream(MediaStream* stream);
 
-  /// Drive the remuxing from muxer side (pull).
+  /// Drive the remuxing from muxer side (pull). Exits with a CANCELLED status
+  /// soon after the current CancellationToken of the calling thread is
+  /// cancelled.
   Status Run();
 
   /// Cancel a muxing job in progress. Will cause @a Run to exit with an error
@@ -97,6 +118,10 @@ class Muxer {
   ProgressListener* progress_listener() { return progress_listener_.get(); }
   base::Clock* clock() { return clock_; }
   FourCC protection_scheme() const { return protection_scheme_; }
+  CryptoContextCache* crypto_context_cache() { return crypto_context_cache_; }
+  KeyRotationSchedule* key_rotation_schedule() {
+    return key_rotation_schedule_;
+  }
 
  private:
   friend class MediaStream;  // Needed to access AddSample.
@@ -105,6 +130,23 @@ class Muxer {
   Status AddSample(const MediaStream* stream,
                    scoped_refptr<MediaSample> sample);
 
+  // Decrypts |sample| if needed and passes it to DoAddSample().
+  Status MuxSample(const MediaStream* stream,
+                   scoped_refptr<MediaSample> sample);
+
+  // For trick play, see MuxerOptions::trick_play_factor. Holds back the key
+  // frames kept until the next one, which sets their duration, and drops the
+  // other samples. Returns the sample to mux in |sample|, or NULL.
+  void FilterTrickPlaySample(scoped_refptr<MediaSample>* sample);
+
+  // Muxes the last trick play sample held back, if any, then finalizes.
+  Status FinalizeMuxer();
+
+  // Takes the timed metadata events of the streams and passes them to
+  // DoAddTimedMetadata(). The streams of a Muxer carry the same events, so
+  // only those of the first stream are passed.
+  void MuxTimedMetadata();
+
   // Initialize the muxer.
   virtual Status Initialize() = 0;
 
@@ -115,16 +157,52 @@ class Muxer {
   virtual Status DoAddSample(const MediaStream* stream,
                              scoped_refptr<MediaSample> sample) = 0;
 
+  // Adds a timed metadata event to the output. The default implementation
+  // only passes it to the muxer listener, e.g. for the HLS playlists.
+  virtual void DoAddTimedMetadata(const TimedMetadataEvent& event);
+
+  // Whether DoAddSample() accepts samples whose data is still pending
+  // decryption, see MediaSample::set_pending_decryption(). Otherwise the data
+  // is decrypted before DoAddSample() is called.
+  virtual bool AcceptsPendingDecryption() const { return false; }
+
+  // Whether DoAddSample() accepts samples whose data is passed through
+  // encrypted, see MediaSample::set_passthrough_encryption().
+  virtual bool AcceptsEncryptionPassthrough() const { return false; }
+
+  // Reports the health of |streams_[stream_index]| to the progress listener
+  // after |sample| was muxed, if it has not been reported recently.
+  void ReportLiveStreamHealth(size_t stream_index, const MediaSample& sample);
+
+  // Real time tracking of a stream to report its health.
+  struct StreamTiming {
+    StreamTiming();
+
+    // Wall clock time and decoding time of the first sample muxed.
+    base::TimeTicks start_time;
+    int64_t start_dts;
+    base::TimeTicks last_report_time;
+  };
+
   MuxerOptions options_;
   bool initialized_;
   std::vector<MediaStream*> streams_;
+  std::vector<StreamTiming> stream_timings_;
   KeySource* encryption_key_source_;
   uint32_t max_sd_pixels_;
   double clear_lead_in_seconds_;
   double crypto_period_duration_in_seconds_;
   FourCC protection_scheme_;
+  CryptoContextCache* crypto_context_cache_;
+  KeyRotationSchedule* key_rotation_schedule_;
   bool cancelled_;
 
+  // Trick play state: the key frame held back, the number of key frames
+  // received and the end time of the latest sample received.
+  scoped_refptr<MediaSample> trick_play_sample_;
+  uint64_t num_trick_play_key_frames_;
+  int64_t trick_play_end_time_;
+
   scoped_ptr<MuxerListener> muxer_listener_;
   scoped_ptr<ProgressListener> progress_listener_;
   // An external injected clock, can be NULL.
@@ -16,9 +16,21 @@ MuxerOptions::MuxerOptions()
       fragment_duration(0),
       segment_sap_aligned(false),
       fragment_sap_aligned(false),
+      fragment_max_bytes(0),
       num_subsegments_per_sidx(0),
+      single_segment_in_place(false),
       bandwidth(0),
-      packager_version_string(kPackagerVersion) {}
+      packager_version_string(kPackagerVersion),
+      num_encryption_threads(0),
+      first_segment_index(0),
+      write_init_segment(true),
+      low_latency_chunked_output(false),
+      trick_play_factor(0),
+      segment_checksum(SegmentChecksum::kNone),
+      write_segment_checksum_files(false),
+      open_segments_ahead(false),
+      deduplicate_output(false),
+      streaming_output(false) {}
 MuxerOptions::~MuxerOptions() {}
 
 }  // namespace media
@@ -11,6 +11,8 @@
 
 #include <string>
 
+#include "packager/media/base/segment_checksum.h"
+
 namespace edash_packager {
 namespace media {
 
@@ -42,6 +44,14 @@ struct MuxerOptions {
   /// implies that segment_sap_aligned is true as well.
   bool fragment_sap_aligned;
 
+  /// Byte budget of the fragments, per track. If 0, the default, fragments
+  /// end on fragment_duration only. Otherwise, fragment_duration is a target:
+  /// a fragment reaching the budget ends at the next stream access point,
+  /// or the next sample if fragment_sap_aligned is false, and a fragment
+  /// well under the budget is merged with the next ones. Segments still end
+  /// on segment_duration.
+  uint64_t fragment_max_bytes;
+
   /// For ISO BMFF only.
   /// Set the number of subsegments in each SIDX box. If 0, a single SIDX box
   /// is used per segment. If -1, no SIDX box is used. Otherwise, the Muxer
@@ -74,12 +84,80 @@ struct MuxerOptions {
   /// Specify temporary directory for intermediate files.
   std::string temp_dir;
 
+  /// For single segment output only. Reserve space for the media header and
+  /// the segment index at the start of the output file and write the
+  /// subsegments directly to it. For ISO BMFF, this avoids going through a
+  /// temporary file, which is used only if the reserved space turns out to be
+  /// too small. For WebM, the Cues are placed before the Clusters if they fit
+  /// in the reserved space, and at the end of the file otherwise.
+  bool single_segment_in_place;
+
   /// User-specified bit rate for the media stream. If zero, the muxer will
   /// attempt to estimate.
   uint32_t bandwidth;
 
   /// Specify the version string to be embedded in the output files.
   std::string packager_version_string;
+
+  /// For multi-segment output only. The $Number$ of the first segment, minus
+  /// one. Set when the input is packaged in several ranges by different
+  /// muxers, so the segments of each range are numbered after the previous
+  /// ranges.
+  uint32_t first_segment_index;
+
+  /// For multi-segment output only. Write the init segment. Cleared for all
+  /// but one muxer if the input is packaged in several ranges.
+  bool write_init_segment;
+
+  /// For ISO BMFF and MPEG-2 TS.
+  /// Number of threads used to encrypt the samples of a fragment, or of a
+  /// batch of TS video samples, in parallel. If 0 or 1, samples are encrypted
+  /// serially as they are added.
+  int num_encryption_threads;
+
+  /// For multi-segment output only. Write every fragment to its segment file
+  /// as soon as it is complete, i.e. as a CMAF chunk, instead of writing
+  /// whole segments. The segments in progress can then be served to low
+  /// latency clients. No SIDX box is generated in this mode. For WebM, the
+  /// Clusters are written with an unknown size, never patched, and every
+  /// block is flushed to its segment file as soon as it is muxed.
+  bool low_latency_chunked_output;
+
+  /// For video only. If positive, the output is a trick play stream made of
+  /// one in every |trick_play_factor| key frames of the input, each lasting
+  /// until the next one kept. If 0, all the samples are muxed.
+  uint32_t trick_play_factor;
+
+  /// For multi-segment output with a segment template only. Checksum of the
+  /// segments, computed as they are written and passed to
+  /// MuxerListener::OnNewSegment().
+  SegmentChecksum::Algorithm segment_checksum;
+
+  /// Write the checksum of every segment to a sidecar file next to it. Used
+  /// only if segment_checksum is set.
+  bool write_segment_checksum_files;
+
+  /// For ISO BMFF and MPEG-2 TS multi-segment output with a segment template
+  /// without $Time$ only. Open the file of the next segment on a worker
+  /// thread while the current segment is written, so that creating the
+  /// files does not delay the segments. Must not be set for the ranges of an
+  /// input packaged by different muxers, as the file of the next range would
+  /// be opened.
+  bool open_segments_ahead;
+
+  /// For ISO BMFF output only. Store the init segment and the segments
+  /// identical to a file written before by the process, e.g. by the outputs
+  /// of another encryption configuration, as hard links to that file. Only
+  /// local files are linked. Disables open_segments_ahead.
+  bool deduplicate_output;
+
+  /// For ISO BMFF multi-segment output without a segment template only.
+  /// Write the output file forward only, keeping it open from the init
+  /// segment to the last segment, which are written in order and never
+  /// patched, so that it can be a pipe, a socket or /dev/stdout. Every
+  /// segment is preceded by its SIDX box unless num_subsegments_per_sidx is
+  /// negative.
+  bool streaming_output;
 };
 
 }  // namespace media
@@ -6,15 +6,12 @@
 
 #include "packager/media/base/muxer_util.h"
 
-#include <inttypes.h>
-
 #include <string>
 #include <vector>
 
 #include "packager/base/logging.h"
 #include "packager/base/strings/string_number_conversions.h"
 #include "packager/base/strings/string_split.h"
-#include "packager/base/strings/stringprintf.h"
 #include "packager/media/base/video_stream_info.h"
 
 namespace edash_packager {
@@ -105,53 +102,103 @@ std::string GetSegmentName(const std::string& segment_template,
                            uint32_t bandwidth) {
   DCHECK(ValidateSegmentTemplate(segment_template));
 
+  std::string segment_name;
+  SegmentNameTemplate(segment_template)
+      .Expand(segment_start_time, segment_index, bandwidth, &segment_name);
+  return segment_name;
+}
+
+SegmentNameTemplate::SegmentNameTemplate(const std::string& segment_template)
+    : has_time_(false) {
   std::vector<std::string> splits;
   base::SplitString(segment_template, '$', &splits);
   // "$" always appears in pairs, so there should be odd number of splits.
-  DCHECK_EQ(1u, splits.size() % 2);
+  DCHECK(segment_template.empty() || splits.size() % 2 == 1);
 
-  std::string segment_name;
   for (size_t i = 0; i < splits.size(); ++i) {
+    Token token;
+    token.type = Token::kLiteral;
+    token.width = 0;
     // Every second substring in split output should be an identifier.
     // Simply copy the non-identifier part.
     if (i % 2 == 0) {
-      segment_name += splits[i];
-      continue;
-    }
-    if (splits[i].empty()) {
+      token.literal = splits[i];
+    } else if (splits[i].empty()) {
       // "$$" is an escape sequence, replaced with a single "$".
-      segment_name += "$";
-      continue;
+      token.literal = "$";
+    } else {
+      size_t format_pos = splits[i].find('%');
+      std::string identifier = splits[i].substr(0, format_pos);
+      if (identifier == "Number") {
+        token.type = Token::kNumber;
+      } else if (identifier == "Time") {
+        token.type = Token::kTime;
+        has_time_ = true;
+      } else if (identifier == "Bandwidth") {
+        token.type = Token::kBandwidth;
+      } else {
+        NOTREACHED() << "Invalid identifier " << identifier;
+        continue;
+      }
+
+      // Default format tag "%01d".
+      token.width = 1;
+      if (format_pos != std::string::npos) {
+        const std::string format_tag = splits[i].substr(format_pos);
+        DCHECK(ValidateFormatTag(format_tag));
+        unsigned width;
+        if (base::StringToUint(
+                format_tag.substr(2, format_tag.size() - 3), &width)) {
+          token.width = width;
+        }
+      }
     }
-    size_t format_pos = splits[i].find('%');
-    std::string identifier = splits[i].substr(0, format_pos);
-    DCHECK(identifier == "Number" || identifier == "Time" ||
-           identifier == "Bandwidth");
 
-    std::string format_tag;
-    if (format_pos != std::string::npos) {
-      format_tag = splits[i].substr(format_pos);
-      DCHECK(ValidateFormatTag(format_tag));
-      // Replace %d formatting to correctly format uint64_t.
-      format_tag = format_tag.substr(0, format_tag.size() - 1) + PRIu64;
-    } else {
-      // Default format tag "%01d", modified to format uint64_t correctly.
-      format_tag = "%01" PRIu64;
+    if (token.type == Token::kLiteral) {
+      if (token.literal.empty())
+        continue;
+      // Merge the text around escaped "$".
+      if (!tokens_.empty() && tokens_.back().type == Token::kLiteral) {
+        tokens_.back().literal += token.literal;
+        continue;
+      }
     }
+    tokens_.push_back(token);
+  }
+}
 
-    if (identifier == "Number") {
-      // SegmentNumber starts from 1.
-      segment_name += base::StringPrintf(
-          format_tag.c_str(), static_cast<uint64_t>(segment_index + 1));
-    } else if (identifier == "Time") {
-      segment_name +=
-          base::StringPrintf(format_tag.c_str(), segment_start_time);
-    } else if (identifier == "Bandwidth") {
-      segment_name += base::StringPrintf(format_tag.c_str(),
-                                         static_cast<uint64_t>(bandwidth));
+SegmentNameTemplate::~SegmentNameTemplate() {}
+
+void SegmentNameTemplate::Expand(uint64_t segment_start_time,
+                                 uint32_t segment_index,
+                                 uint32_t bandwidth,
+                                 std::string* segment_name) const {
+  DCHECK(segment_name);
+  segment_name->clear();
+  for (size_t i = 0; i < tokens_.size(); ++i) {
+    const Token& token = tokens_[i];
+    uint64_t value = 0;
+    switch (token.type) {
+      case Token::kLiteral:
+        segment_name->append(token.literal);
+        continue;
+      case Token::kNumber:
+        // SegmentNumber starts from 1.
+        value = static_cast<uint64_t>(segment_index) + 1;
+        break;
+      case Token::kTime:
+        value = segment_start_time;
+        break;
+      case Token::kBandwidth:
+        value = bandwidth;
+        break;
     }
+    // Same as printf with format tag %0[width]d, without parsing it.
+    const std::string digits = base::Uint64ToString(value);
+    if (digits.size() < token.width)
+      segment_name->append(token.width - digits.size(), '0');
+    segment_name->append(digits);
   }
-  return segment_name;
 }
 
 KeySource::TrackType GetTrackTypeForEncryption(const StreamInfo& stream_info,
@@ -12,7 +12,9 @@
 #include <stdint.h>
 
 #include <string>
+#include <vector>
 
+#include "packager/base/macros.h"
 #include "packager/media/base/key_source.h"
 
 namespace edash_packager {
@@ -39,6 +41,42 @@ std::string GetSegmentName(const std::string& segment_template,
                            uint32_t segment_index,
                            uint32_t bandwidth);
 
+/// A segment template parsed once, so that the names of the segments are
+/// built without parsing the template again for every segment.
+class SegmentNameTemplate {
+ public:
+  /// @param segment_template is the segment template pattern, which should
+  ///        comply with ISO/IEC 23009-1:2012 5.3.9.4.4.
+  explicit SegmentNameTemplate(const std::string& segment_template);
+  ~SegmentNameTemplate();
+
+  /// Build the segment name from provided input, as GetSegmentName() does.
+  /// @param segment_name receives the segment name. Its capacity is reused.
+  void Expand(uint64_t segment_start_time,
+              uint32_t segment_index,
+              uint32_t bandwidth,
+              std::string* segment_name) const;
+
+  /// @return true if the segment names depend on the segment start time,
+  ///         i.e. the template contains $Time$.
+  bool has_time() const { return has_time_; }
+
+ private:
+  struct Token {
+    enum Type { kLiteral, kNumber, kTime, kBandwidth };
+    Type type;
+    // The text of a kLiteral token.
+    std::string literal;
+    // The minimum number of digits of the other tokens, padded with zeros.
+    size_t width;
+  };
+
+  std::vector<Token> tokens_;
+  bool has_time_;
+
+  DISALLOW_COPY_AND_ASSIGN(SegmentNameTemplate);
+};
+
 /// Determine the track type for encryption from input.
 /// @param stream_info is the info of the stream.
 /// @param max_sd_pixels is the maximum number of pixels to be considered SD.
@@ -153,5 +153,20 @@ TEST(MuxerUtilTest, GetSegmentNameLargeTime) {
                            kBandwidth));
 }
 
+TEST(MuxerUtilTest, SegmentNameTemplate) {
+  SegmentNameTemplate number_template("seg$$$Number%03d$-$Bandwidth$.m4s");
+  EXPECT_FALSE(number_template.has_time());
+  std::string segment_name = "previous name";
+  number_template.Expand(180180, 11, 1234, &segment_name);
+  EXPECT_EQ("seg$012-1234.m4s", segment_name);
+  number_template.Expand(180180, 1233, 1234, &segment_name);
+  EXPECT_EQ("seg$1234-1234.m4s", segment_name);
+
+  SegmentNameTemplate time_template("$Time$.ts");
+  EXPECT_TRUE(time_template.has_time());
+  time_template.Expand(8589934592ULL, 0, 0, &segment_name);
+  EXPECT_EQ("8589934592.ts", segment_name);
+}
+
 }  // namespace media
 }  // namespace edash_packager
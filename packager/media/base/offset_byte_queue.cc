@@ -6,22 +6,42 @@
 
 #include <stdint.h>
 
+#include <algorithm>
+#include <limits>
+
 #include "packager/base/logging.h"
+#include "packager/media/base/shared_buffer.h"
 
 namespace edash_packager {
 namespace media {
 
+namespace {
+int ClampToInt(int64_t size) {
+  return static_cast<int>(
+      std::min<int64_t>(size, std::numeric_limits<int>::max()));
+}
+}  // namespace
+
 OffsetByteQueue::OffsetByteQueue() : buf_(NULL), size_(0), head_(0) {}
 OffsetByteQueue::~OffsetByteQueue() {}
 
 void OffsetByteQueue::Reset() {
   queue_.Reset();
+  input_buffer_ = NULL;
   buf_ = NULL;
   size_ = 0;
   head_ = 0;
 }
 
 void OffsetByteQueue::Push(const uint8_t* buf, int size) {
+  if (input_buffer_) {
+    // The data is already in |input_buffer_|; extend the queue over it.
+    CHECK(buf == input_buffer_->data() + tail())
+        << "Data pushed is not the continuation of the input buffer.";
+    CHECK(input_buffer_->Contains(buf, size));
+    size_ += size;
+    return;
+  }
   queue_.Push(buf, size);
   Sync();
   DVLOG(4) << "Buffer pushed. head=" << head() << " tail=" << tail();
@@ -29,13 +49,11 @@ void OffsetByteQueue::Push(const uint8_t* buf, int size) {
 
 void OffsetByteQueue::Peek(const uint8_t** buf, int* size) {
   *buf = size_ > 0 ? buf_ : NULL;
-  *size = size_;
+  *size = ClampToInt(size_);
 }
 
 void OffsetByteQueue::Pop(int count) {
-  queue_.Pop(count);
-  head_ += count;
-  Sync();
+  Advance(count);
 }
 
 void OffsetByteQueue::PeekAt(int64_t offset, const uint8_t** buf, int* size) {
@@ -45,21 +63,44 @@ void OffsetByteQueue::PeekAt(int64_t offset, const uint8_t** buf, int* size) {
     return;
   }
   *buf = &buf_[offset - head()];
-  *size = tail() - offset;
+  *size = ClampToInt(tail() - offset);
 }
 
 bool OffsetByteQueue::Trim(int64_t max_offset) {
   if (max_offset < head_) return true;
   if (max_offset > tail()) {
-    Pop(size_);
+    Advance(size_);
     return false;
   }
-  Pop(max_offset - head_);
+  Advance(max_offset - head_);
   return true;
 }
 
+void OffsetByteQueue::SetInputBuffer(
+    const scoped_refptr<SharedBuffer>& input_buffer) {
+  DCHECK(input_buffer);
+  DCHECK_EQ(0, size_);
+  DCHECK_EQ(0, head_);
+  input_buffer_ = input_buffer;
+  buf_ = input_buffer_->data();
+}
+
 void OffsetByteQueue::Sync() {
-  queue_.Peek(&buf_, &size_);
+  int size;
+  queue_.Peek(&buf_, &size);
+  size_ = size;
+}
+
+void OffsetByteQueue::Advance(int64_t count) {
+  DCHECK_LE(count, size_);
+  head_ += count;
+  if (input_buffer_) {
+    buf_ += count;
+    size_ -= count;
+    return;
+  }
+  queue_.Pop(count);
+  Sync();
 }
 
 }  // namespace media
@@ -48,6 +48,19 @@ class OffsetByteQueue {
   ///         buffered are still cleared).
   bool Trim(int64_t max_offset);
 
+  /// Make the queue reference @a input_buffer, which holds the whole input,
+  /// instead of copying the data pushed. The data passed to subsequent Push()
+  /// calls must be consecutive ranges of @a input_buffer, starting at its
+  /// beginning. The queue must be empty. Reset() leaves this mode.
+  /// Sizes returned by Peek() and PeekAt() are capped to the int range, so the
+  /// input may be larger than 2GB.
+  void SetInputBuffer(const scoped_refptr<SharedBuffer>& input_buffer);
+
+  /// @return The buffer backing the queue. See ByteQueue::shared_buffer().
+  const scoped_refptr<SharedBuffer>& shared_buffer() const {
+    return input_buffer_ ? input_buffer_ : queue_.shared_buffer();
+  }
+
   /// @return The head position, in terms of the file's absolute offset.
   int64_t head() { return head_; }
   /// @return The tail position (exclusive), in terms of the file's absolute
@@ -57,10 +70,14 @@ class OffsetByteQueue {
  private:
   // Synchronize |buf_| and |size_| with |queue_|.
   void Sync();
+  // Remove |count| bytes from the front of the queue.
+  void Advance(int64_t count);
 
   ByteQueue queue_;
+  // Set if the queue references the input instead of |queue_|.
+  scoped_refptr<SharedBuffer> input_buffer_;
   const uint8_t* buf_;
-  int size_;
+  int64_t size_;
   int64_t head_;
 
   DISALLOW_COPY_AND_ASSIGN(OffsetByteQueue);
@@ -7,7 +7,9 @@
 #include <string.h>
 
 #include "packager/base/memory/scoped_ptr.h"
+#include "packager/media/base/media_sample.h"
 #include "packager/media/base/offset_byte_queue.h"
+#include "packager/media/base/shared_buffer.h"
 
 namespace edash_packager {
 namespace media {
@@ -90,5 +92,76 @@ TEST_F(OffsetByteQueueTest, Trim) {
   EXPECT_TRUE(queue_->Trim(512));
 }
 
+// Samples created from the queue buffer must keep their content while the
+// queue is popped, reset and refilled.
+TEST_F(OffsetByteQueueTest, SharedBufferNotOverwritten) {
+  const uint8_t* buf;
+  int size;
+  queue_->PeekAt(400, &buf, &size);
+  const int kSampleSize = 16;
+  ASSERT_GE(size, kSampleSize);
+  scoped_refptr<MediaSample> sample = MediaSample::CreateFromSharedBuffer(
+      queue_->shared_buffer(), buf, kSampleSize, true);
+  EXPECT_TRUE(sample->is_shared());
+  EXPECT_EQ(buf, sample->data());
+
+  uint8_t new_data[1024];
+  memset(new_data, 0xff, sizeof(new_data));
+  queue_->Pop(128);
+  queue_->Push(new_data, sizeof(new_data));
+  queue_->Reset();
+  queue_->Push(new_data, sizeof(new_data));
+
+  ASSERT_EQ(static_cast<size_t>(kSampleSize), sample->data_size());
+  for (int i = 0; i < kSampleSize; ++i)
+    EXPECT_EQ(400 - 256 + i, sample->data()[i]);
+}
+
+TEST_F(OffsetByteQueueTest, SharedSampleCopyOnWrite) {
+  const uint8_t* buf;
+  int size;
+  queue_->Peek(&buf, &size);
+  scoped_refptr<MediaSample> sample = MediaSample::CreateFromSharedBuffer(
+      queue_->shared_buffer(), buf, size, false);
+
+  sample->writable_data()[0] = 0;
+  EXPECT_FALSE(sample->is_shared());
+  EXPECT_EQ(static_cast<size_t>(size), sample->data_size());
+  EXPECT_EQ(0, sample->data()[0]);
+  EXPECT_EQ(129, sample->data()[1]);
+  // The queue content is untouched.
+  EXPECT_EQ(128, buf[0]);
+}
+
+TEST(OffsetByteQueueInputBufferTest, ReferencesInputBuffer) {
+  const size_t kInputSize = 1024;
+  scoped_refptr<SharedBuffer> input(new SharedBuffer(kInputSize));
+  for (size_t i = 0; i < kInputSize; ++i)
+    input->data()[i] = i % 256;
+
+  OffsetByteQueue queue;
+  queue.SetInputBuffer(input);
+  queue.Push(input->data(), kInputSize / 2);
+
+  const uint8_t* buf;
+  int size;
+  queue.Peek(&buf, &size);
+  EXPECT_EQ(input->data(), buf);
+  EXPECT_EQ(static_cast<int>(kInputSize / 2), size);
+
+  queue.Pop(100);
+  queue.Push(input->data() + kInputSize / 2, kInputSize / 2);
+  EXPECT_EQ(100, queue.head());
+  EXPECT_EQ(static_cast<int64_t>(kInputSize), queue.tail());
+  queue.PeekAt(600, &buf, &size);
+  EXPECT_EQ(input->data() + 600, buf);
+  EXPECT_EQ(static_cast<int>(kInputSize - 600), size);
+  EXPECT_EQ(input, queue.shared_buffer());
+
+  EXPECT_TRUE(queue.Trim(kInputSize));
+  queue.Peek(&buf, &size);
+  EXPECT_EQ(0, size);
+}
+
 }  // namespace media
 }  // namespace edash_packager
@@ -0,0 +1,251 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/pipeline_metrics.h"
+
+#include <algorithm>
+
+#include "packager/base/lazy_instance.h"
+#include "packager/base/logging.h"
+#include "packager/base/strings/string_number_conversions.h"
+#include "packager/base/synchronization/lock.h"
+#include "packager/base/threading/thread_local_storage.h"
+#include "packager/base/trace_event/trace_event.h"
+#include "packager/media/base/job_resource_usage.h"
+
+namespace edash_packager {
+namespace media {
+
+// The measurements of a thread. Only the owning thread records into them;
+// the lock is only contended while the metrics are read.
+struct PipelineThreadStats {
+  PipelineThreadStats() : current_timer(NULL) {}
+
+  base::Lock lock;
+  PipelineStageStats stats[kNumPipelineStages];
+  // The innermost running timer of the thread. Only used by the thread.
+  ScopedStageTimer* current_timer;
+};
+
+namespace {
+
+const char* const kStageNames[] = {
+    "parse", "queue", "mux", "fragment", "encrypt", "segment_write",
+    "manifest_write",
+};
+COMPILE_ASSERT(arraysize(kStageNames) == kNumPipelineStages,
+               stage_names_do_not_match_stages);
+
+void OnThreadExit(void* thread_stats);
+
+// Keeps track of the measurements of all the threads.
+class MetricsRegistry {
+ public:
+  MetricsRegistry() : slot_(&OnThreadExit) {}
+
+  PipelineThreadStats* GetThreadStats() {
+    PipelineThreadStats* thread_stats =
+        static_cast<PipelineThreadStats*>(slot_.Get());
+    if (!thread_stats) {
+      thread_stats = new PipelineThreadStats;
+      slot_.Set(thread_stats);
+      base::AutoLock auto_lock(lock_);
+      threads_.push_back(thread_stats);
+    }
+    return thread_stats;
+  }
+
+  // Keeps the measurements of an exited thread.
+  void RetireThread(PipelineThreadStats* thread_stats) {
+    base::AutoLock auto_lock(lock_);
+    for (int i = 0; i < kNumPipelineStages; ++i)
+      retired_stats_[i].Merge(thread_stats->stats[i]);
+    threads_.erase(
+        std::find(threads_.begin(), threads_.end(), thread_stats));
+    delete thread_stats;
+  }
+
+  std::vector<PipelineStageStats> GetStats() {
+    base::AutoLock auto_lock(lock_);
+    std::vector<PipelineStageStats> stats(retired_stats_,
+                                          retired_stats_ + kNumPipelineStages);
+    for (PipelineThreadStats* thread_stats : threads_) {
+      base::AutoLock thread_lock(thread_stats->lock);
+      for (int i = 0; i < kNumPipelineStages; ++i)
+        stats[i].Merge(thread_stats->stats[i]);
+    }
+    return stats;
+  }
+
+  void Reset() {
+    base::AutoLock auto_lock(lock_);
+    std::fill(retired_stats_, retired_stats_ + kNumPipelineStages,
+              PipelineStageStats());
+    for (PipelineThreadStats* thread_stats : threads_) {
+      base::AutoLock thread_lock(thread_stats->lock);
+      std::fill(thread_stats->stats, thread_stats->stats + kNumPipelineStages,
+                PipelineStageStats());
+    }
+  }
+
+ private:
+  base::ThreadLocalStorage::Slot slot_;
+
+  base::Lock lock_;  // Lock protecting the variables below.
+  std::vector<PipelineThreadStats*> threads_;
+  PipelineStageStats retired_stats_[kNumPipelineStages];
+
+  DISALLOW_COPY_AND_ASSIGN(MetricsRegistry);
+};
+
+base::LazyInstance<MetricsRegistry>::Leaky g_metrics_registry =
+    LAZY_INSTANCE_INITIALIZER;
+
+void OnThreadExit(void* thread_stats) {
+  g_metrics_registry.Get().RetireThread(
+      static_cast<PipelineThreadStats*>(thread_stats));
+}
+
+void AddStageRun(PipelineThreadStats* thread_stats,
+                 PipelineStage stage,
+                 base::TimeDelta time,
+                 uint64_t bytes) {
+  DCHECK_GE(stage, 0);
+  DCHECK_LT(stage, kNumPipelineStages);
+  base::AutoLock auto_lock(thread_stats->lock);
+  PipelineStageStats& stats = thread_stats->stats[stage];
+  ++stats.count;
+  stats.total_time += time;
+  stats.max_time = std::max(stats.max_time, time);
+  stats.bytes += bytes;
+}
+
+std::string GetCount(const PipelineStageStats& stats) {
+  return base::Uint64ToString(stats.count);
+}
+std::string GetTotalSeconds(const PipelineStageStats& stats) {
+  return base::DoubleToString(stats.total_time.InSecondsF());
+}
+std::string GetMaxSeconds(const PipelineStageStats& stats) {
+  return base::DoubleToString(stats.max_time.InSecondsF());
+}
+std::string GetBytes(const PipelineStageStats& stats) {
+  return base::Uint64ToString(stats.bytes);
+}
+
+struct MetricDescriptor {
+  // Names of the metric in JSON and in Prometheus.
+  const char* json_name;
+  const char* prometheus_name;
+  const char* prometheus_type;
+  const char* help;
+  std::string (*get_value)(const PipelineStageStats& stats);
+};
+
+const MetricDescriptor kMetrics[] = {
+    {"count", "packager_stage_runs_total", "counter",
+     "Number of runs of the pipeline stage.", &GetCount},
+    {"seconds", "packager_stage_seconds_total", "counter",
+     "Time spent in the pipeline stage, not including the nested stages.",
+     &GetTotalSeconds},
+    {"max_seconds", "packager_stage_max_seconds", "gauge",
+     "Longest run of the pipeline stage.", &GetMaxSeconds},
+    {"bytes", "packager_stage_bytes_total", "counter",
+     "Bytes processed by the pipeline stage.", &GetBytes},
+};
+
+}  // namespace
+
+PipelineStageStats::PipelineStageStats() : count(0), bytes(0) {}
+
+void PipelineStageStats::Merge(const PipelineStageStats& other) {
+  count += other.count;
+  total_time += other.total_time;
+  max_time = std::max(max_time, other.max_time);
+  bytes += other.bytes;
+}
+
+void PipelineMetrics::Record(PipelineStage stage,
+                             base::TimeDelta time,
+                             uint64_t bytes) {
+  AddStageRun(g_metrics_registry.Get().GetThreadStats(), stage, time, bytes);
+}
+
+std::vector<PipelineStageStats> PipelineMetrics::GetStats() {
+  return g_metrics_registry.Get().GetStats();
+}
+
+const char* PipelineMetrics::GetStageName(PipelineStage stage) {
+  DCHECK_GE(stage, 0);
+  DCHECK_LT(stage, kNumPipelineStages);
+  return kStageNames[stage];
+}
+
+std::string PipelineMetrics::ToPrometheusText() {
+  const std::vector<PipelineStageStats> stats = GetStats();
+  std::string text;
+  for (const MetricDescriptor& metric : kMetrics) {
+    text += std::string("# HELP ") + metric.prometheus_name + " " +
+            metric.help + "\n";
+    text += std::string("# TYPE ") + metric.prometheus_name + " " +
+            metric.prometheus_type + "\n";
+    for (int i = 0; i < kNumPipelineStages; ++i) {
+      text += std::string(metric.prometheus_name) + "{stage=\"" +
+              kStageNames[i] + "\"} " + metric.get_value(stats[i]) + "\n";
+    }
+  }
+  return text;
+}
+
+std::string PipelineMetrics::ToJson() {
+  const std::vector<PipelineStageStats> stats = GetStats();
+  std::string json = "{\"stages\":{";
+  for (int i = 0; i < kNumPipelineStages; ++i) {
+    if (i > 0)
+      json += ",";
+    json += std::string("\"") + kStageNames[i] + "\":{";
+    for (size_t j = 0; j < arraysize(kMetrics); ++j) {
+      if (j > 0)
+        json += ",";
+      json += std::string("\"") + kMetrics[j].json_name +
+              "\":" + kMetrics[j].get_value(stats[i]);
+    }
+    json += "}";
+  }
+  json += "}}";
+  return json;
+}
+
+void PipelineMetrics::ResetForTesting() {
+  g_metrics_registry.Get().Reset();
+}
+
+ScopedStageTimer::ScopedStageTimer(PipelineStage stage)
+    : stage_(stage),
+      start_(base::TimeTicks::Now()),
+      bytes_(0),
+      thread_stats_(g_metrics_registry.Get().GetThreadStats()),
+      parent_(thread_stats_->current_timer),
+      job_usage_(JobResourceUsage::Current()) {
+  thread_stats_->current_timer = this;
+  TRACE_EVENT_BEGIN0("packager", PipelineMetrics::GetStageName(stage_));
+}
+
+ScopedStageTimer::~ScopedStageTimer() {
+  DCHECK_EQ(this, thread_stats_->current_timer);
+  const base::TimeDelta time = base::TimeTicks::Now() - start_;
+  thread_stats_->current_timer = parent_;
+  if (parent_)
+    parent_->nested_time_ += time;
+  AddStageRun(thread_stats_, stage_, time - nested_time_, bytes_);
+  if (job_usage_)
+    job_usage_->AddStageRun(stage_, time - nested_time_, bytes_);
+  TRACE_EVENT_END1("packager", PipelineMetrics::GetStageName(stage_), "bytes",
+                   bytes_);
+}
+
+}  // namespace media
+}  // namespace edash_packager
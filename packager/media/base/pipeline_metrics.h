@@ -0,0 +1,119 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_BASE_PIPELINE_METRICS_H_
+#define MEDIA_BASE_PIPELINE_METRICS_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "packager/base/macros.h"
+#include "packager/base/time/time.h"
+
+namespace edash_packager {
+namespace media {
+
+/// Stages of the packaging pipeline measured by PipelineMetrics.
+enum PipelineStage {
+  kParseStage,          ///< MediaParser::Parse() in Demuxer.
+  kQueueStage,          ///< Demuxer waiting for space in a sample channel.
+  kMuxStage,            ///< Muxer::AddSample(), besides the stages below.
+  kFragmentStage,       ///< Adding samples to mp4 fragments.
+  kEncryptStage,        ///< Sample encryption.
+  kSegmentWriteStage,   ///< Writing segments, clusters and chunks.
+  kManifestWriteStage,  ///< Writing MPDs and HLS playlists.
+  kNumPipelineStages,
+};
+
+/// Measurements of a pipeline stage.
+struct PipelineStageStats {
+  PipelineStageStats();
+
+  /// Adds the measurements of @a other.
+  void Merge(const PipelineStageStats& other);
+
+  /// Number of times the stage ran.
+  uint64_t count;
+  /// Time spent in the stage, not including the nested stages.
+  base::TimeDelta total_time;
+  /// Longest single run of the stage, not including the nested stages.
+  base::TimeDelta max_time;
+  /// Number of bytes processed by the stage, if it counts them.
+  uint64_t bytes;
+};
+
+/// Process-wide timers and counters of the pipeline stages, which are always
+/// on. The measurements are aggregated per thread, so recording does not
+/// contend across threads, and are summed over all threads, running or
+/// exited, when read.
+///
+/// Thread Safety: All the methods can be called from any thread.
+class PipelineMetrics {
+ public:
+  /// Records a run of a pipeline stage on the current thread. Usually called
+  /// through ScopedStageTimer.
+  /// @param stage is the stage which ran.
+  /// @param time is the time spent in the stage.
+  /// @param bytes is the number of bytes processed, or 0.
+  static void Record(PipelineStage stage, base::TimeDelta time,
+                     uint64_t bytes);
+
+  /// @return the measurements of all the stages, indexed by PipelineStage.
+  static std::vector<PipelineStageStats> GetStats();
+
+  /// @return the name of @a stage used in the exported metrics.
+  static const char* GetStageName(PipelineStage stage);
+
+  /// @return the measurements in the Prometheus text exposition format, e.g.
+  ///         for the node exporter textfile collector.
+  static std::string ToPrometheusText();
+
+  /// @return the measurements as a JSON object.
+  static std::string ToJson();
+
+  /// Clears the measurements of all the threads.
+  static void ResetForTesting();
+
+ private:
+  DISALLOW_IMPLICIT_CONSTRUCTORS(PipelineMetrics);
+};
+
+class JobResourceUsage;
+struct PipelineThreadStats;
+
+/// Times the enclosing scope as a run of a pipeline stage. Timers can be
+/// nested on a thread: the time spent in an inner timer is not counted in the
+/// outer one, so the stage times add up to the time spent in all the stages.
+/// The run is also recorded as a "packager" trace event when tracing is on,
+/// and in the current JobResourceUsage of the thread, if any.
+class ScopedStageTimer {
+ public:
+  explicit ScopedStageTimer(PipelineStage stage);
+  ~ScopedStageTimer();
+
+  /// Counts @a bytes as processed in this run of the stage.
+  void AddBytes(uint64_t bytes) { bytes_ += bytes; }
+
+ private:
+  const PipelineStage stage_;
+  const base::TimeTicks start_;
+  // Time spent in the nested timers.
+  base::TimeDelta nested_time_;
+  uint64_t bytes_;
+  PipelineThreadStats* const thread_stats_;
+  // The enclosing timer on this thread, if any.
+  ScopedStageTimer* const parent_;
+  JobResourceUsage* const job_usage_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedStageTimer);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_BASE_PIPELINE_METRICS_H_
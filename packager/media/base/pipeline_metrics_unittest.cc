@@ -0,0 +1,120 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+
+#include "packager/base/bind.h"
+#include "packager/base/threading/platform_thread.h"
+#include "packager/media/base/closure_thread.h"
+#include "packager/media/base/pipeline_metrics.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+const int64_t kSleepMs = 20;
+
+void RecordParse(int num_runs) {
+  for (int i = 0; i < num_runs; ++i) {
+    PipelineMetrics::Record(kParseStage, base::TimeDelta::FromMilliseconds(1),
+                            10);
+  }
+}
+
+}  // namespace
+
+class PipelineMetricsTest : public ::testing::Test {
+ public:
+  void SetUp() override { PipelineMetrics::ResetForTesting(); }
+  void TearDown() override { PipelineMetrics::ResetForTesting(); }
+};
+
+TEST_F(PipelineMetricsTest, Record) {
+  PipelineMetrics::Record(kParseStage, base::TimeDelta::FromMilliseconds(3),
+                          100);
+  PipelineMetrics::Record(kParseStage, base::TimeDelta::FromMilliseconds(5),
+                          50);
+  PipelineMetrics::Record(kEncryptStage, base::TimeDelta::FromMilliseconds(1),
+                          0);
+
+  std::vector<PipelineStageStats> stats = PipelineMetrics::GetStats();
+  ASSERT_EQ(static_cast<size_t>(kNumPipelineStages), stats.size());
+  EXPECT_EQ(2u, stats[kParseStage].count);
+  EXPECT_EQ(8, stats[kParseStage].total_time.InMilliseconds());
+  EXPECT_EQ(5, stats[kParseStage].max_time.InMilliseconds());
+  EXPECT_EQ(150u, stats[kParseStage].bytes);
+  EXPECT_EQ(1u, stats[kEncryptStage].count);
+  EXPECT_EQ(0u, stats[kMuxStage].count);
+}
+
+TEST_F(PipelineMetricsTest, NestedTimers) {
+  {
+    ScopedStageTimer outer(kMuxStage);
+    base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(kSleepMs));
+    {
+      ScopedStageTimer inner(kSegmentWriteStage);
+      inner.AddBytes(42);
+      base::PlatformThread::Sleep(
+          base::TimeDelta::FromMilliseconds(2 * kSleepMs));
+    }
+  }
+
+  std::vector<PipelineStageStats> stats = PipelineMetrics::GetStats();
+  EXPECT_EQ(1u, stats[kMuxStage].count);
+  EXPECT_EQ(1u, stats[kSegmentWriteStage].count);
+  EXPECT_EQ(42u, stats[kSegmentWriteStage].bytes);
+  EXPECT_GE(stats[kSegmentWriteStage].total_time.InMilliseconds(),
+            2 * kSleepMs);
+  // The inner timer is not counted in the outer one.
+  EXPECT_GE(stats[kMuxStage].total_time.InMilliseconds(), kSleepMs);
+  EXPECT_LT(stats[kMuxStage].total_time,
+            stats[kSegmentWriteStage].total_time);
+}
+
+TEST_F(PipelineMetricsTest, ExitedThreads) {
+  const int kNumRuns = 5;
+  ClosureThread thread("PipelineMetricsTest",
+                       base::Bind(&RecordParse, kNumRuns));
+  thread.Start();
+  thread.Join();
+  RecordParse(1);
+
+  std::vector<PipelineStageStats> stats = PipelineMetrics::GetStats();
+  EXPECT_EQ(static_cast<uint64_t>(kNumRuns + 1), stats[kParseStage].count);
+  EXPECT_EQ(10u * (kNumRuns + 1), stats[kParseStage].bytes);
+}
+
+TEST_F(PipelineMetricsTest, ToPrometheusText) {
+  PipelineMetrics::Record(kParseStage, base::TimeDelta::FromMilliseconds(500),
+                          1000);
+  const std::string text = PipelineMetrics::ToPrometheusText();
+  EXPECT_NE(std::string::npos,
+            text.find("# TYPE packager_stage_runs_total counter\n"));
+  EXPECT_NE(std::string::npos,
+            text.find("packager_stage_runs_total{stage=\"parse\"} 1\n"));
+  EXPECT_NE(std::string::npos,
+            text.find("packager_stage_seconds_total{stage=\"parse\"} 0.5\n"));
+  EXPECT_NE(std::string::npos,
+            text.find("packager_stage_bytes_total{stage=\"parse\"} 1000\n"));
+  EXPECT_NE(std::string::npos,
+            text.find("packager_stage_runs_total{stage=\"manifest_write\"} "
+                      "0\n"));
+}
+
+TEST_F(PipelineMetricsTest, ToJson) {
+  PipelineMetrics::Record(kEncryptStage, base::TimeDelta::FromMilliseconds(250),
+                          64);
+  const std::string json = PipelineMetrics::ToJson();
+  EXPECT_EQ(0u, json.find("{\"stages\":{\"parse\":{\"count\":0,"));
+  EXPECT_NE(std::string::npos,
+            json.find("\"encrypt\":{\"count\":1,\"seconds\":0.25,"
+                      "\"max_seconds\":0.25,\"bytes\":64}"));
+  EXPECT_EQ('}', json[json.size() - 1]);
+}
+
+}  // namespace media
+}  // namespace edash_packager
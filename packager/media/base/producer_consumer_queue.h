@@ -7,12 +7,14 @@
 #ifndef MEDIA_BASE_PRODUCER_CONSUMER_QUEUE_H_
 #define MEDIA_BASE_PRODUCER_CONSUMER_QUEUE_H_
 
+#include <algorithm>
 #include <deque>
 
 #include "packager/base/strings/stringprintf.h"
 #include "packager/base/synchronization/condition_variable.h"
 #include "packager/base/synchronization/lock.h"
 #include "packager/base/timer/elapsed_timer.h"
+#include "packager/media/base/cancellation_token.h"
 #include "packager/media/base/status.h"
 
 namespace edash_packager {
@@ -24,6 +26,8 @@ static const int64_t kInfiniteTimeout = -1;
 /// A thread safe producer consumer queue implementation. It allows the standard
 /// push and pop operations. It also maintains a monotonically-increasing
 /// element position and allows peeking at the element at certain position.
+/// The blocking operations return CANCELLED soon after the current
+/// CancellationToken of the calling thread, if any, is cancelled.
 template <class T>
 class ProducerConsumerQueue {
  public:
@@ -47,7 +51,8 @@ class ProducerConsumerQueue {
   /// @param timeout_ms indicates timeout in milliseconds. A value of zero means
   ///        return immediately. A negative value means waiting indefinitely.
   /// @return OK if the element was pushed successfully, STOPPED if Stop has
-  ///         has been called, TIME_OUT if times out.
+  ///         has been called, TIME_OUT if times out, CANCELLED if the current
+  ///         CancellationToken is cancelled while waiting.
   Status Push(const T& element, int64_t timeout_ms);
 
   /// Pop an element from the front of the queue. If the queue is empty, block
@@ -56,7 +61,8 @@ class ProducerConsumerQueue {
   /// @param timeout_ms indicates timeout in milliseconds. A value of zero means
   ///        return immediately. A negative value means waiting indefinitely.
   /// @return STOPPED if Stop has been called and the queue is completely empty,
-  ///         TIME_OUT if times out, OK otherwise.
+  ///         TIME_OUT if times out, CANCELLED if the current CancellationToken
+  ///         is cancelled while waiting, OK otherwise.
   Status Pop(T* element, int64_t timeout_ms);
 
   /// Peek at the element at the specified position from the queue. If the
@@ -70,7 +76,8 @@ class ProducerConsumerQueue {
   ///        return immediately. A negative value means waiting indefinitely.
   /// @return STOPPED if Stop has been called and @a pos is out of range,
   ///         INVALID_ARGUMENT if the pos < Head(), TIME_OUT if times out,
-  ///         OK otherwise.
+  ///         CANCELLED if the current CancellationToken is cancelled while
+  ///         waiting, OK otherwise.
   Status Peek(size_t pos, T* element, int64_t timeout_ms);
 
   /// Terminate Pop and Peek requests once the queue drains entirely.
@@ -121,6 +128,16 @@ class ProducerConsumerQueue {
   // Move head_pos_ to center on pos.
   void SlideHeadOnCenter(size_t pos);
 
+  // Wait on |cv| until it is signalled, or until |timeout_ms| since |timer|
+  // started. If |token| is not NULL, wait in slices to check whether it is
+  // cancelled. |lock_| must be held.
+  // Returns TIME_OUT if timed out, CANCELLED if cancelled, OK otherwise.
+  Status WaitFor(base::ConditionVariable* cv,
+                 const CancellationToken* token,
+                 const base::ElapsedTimer& timer,
+                 int64_t timeout_ms,
+                 const char* timeout_message);
+
   const size_t capacity_;  // Maximum number of elements; zero means unlimited.
   mutable base::Lock lock_;  // Lock protecting all other variables below.
   size_t head_pos_;          // Head position.
@@ -159,6 +176,7 @@ ProducerConsumerQueue<T>::~ProducerConsumerQueue() {}
 
 template <class T>
 Status ProducerConsumerQueue<T>::Push(const T& element, int64_t timeout_ms) {
+  const CancellationToken* token = CancellationToken::Current();
   base::AutoLock l(lock_);
   bool woken = false;
 
@@ -167,23 +185,14 @@ Status ProducerConsumerQueue<T>::Push(const T& element, int64_t timeout_ms) {
     return Status(error::STOPPED, "");
 
   base::ElapsedTimer timer;
-  base::TimeDelta timeout_delta = base::TimeDelta::FromMilliseconds(timeout_ms);
 
   if (capacity_) {
     while (q_.size() == capacity_) {
-      if (timeout_ms < 0) {
-        // Wait forever, or until Stop.
-        not_full_cv_.Wait();
-      } else {
-        base::TimeDelta elapsed = timer.Elapsed();
-        if (elapsed < timeout_delta) {
-          // Wait with timeout, or until Stop.
-          not_full_cv_.TimedWait(timeout_delta - elapsed);
-        } else {
-          // We're through waiting.
-          return Status(error::TIME_OUT, "Time out on pushing.");
-        }
-      }
+      // Wait with timeout, or until Stop.
+      Status status = WaitFor(&not_full_cv_, token, timer, timeout_ms,
+                              "Time out on pushing.");
+      if (!status.ok())
+        return status;
       // Re-check for queue shutdown after waking from Wait.
       if (stop_requested_)
         return Status(error::STOPPED, "");
@@ -208,29 +217,21 @@ Status ProducerConsumerQueue<T>::Push(const T& element, int64_t timeout_ms) {
 
 template <class T>
 Status ProducerConsumerQueue<T>::Pop(T* element, int64_t timeout_ms) {
+  const CancellationToken* token = CancellationToken::Current();
   base::AutoLock l(lock_);
   bool woken = false;
 
   base::ElapsedTimer timer;
-  base::TimeDelta timeout_delta = base::TimeDelta::FromMilliseconds(timeout_ms);
 
   while (q_.empty()) {
     if (stop_requested_)
       return Status(error::STOPPED, "");
 
-    if (timeout_ms < 0) {
-      // Wait forever, or until Stop.
-      not_empty_cv_.Wait();
-    } else {
-      base::TimeDelta elapsed = timer.Elapsed();
-      if (elapsed < timeout_delta) {
-        // Wait with timeout, or until Stop.
-        not_empty_cv_.TimedWait(timeout_delta - elapsed);
-      } else {
-        // We're through waiting.
-        return Status(error::TIME_OUT, "Time out on popping.");
-      }
-    }
+    // Wait with timeout, or until Stop.
+    Status status = WaitFor(&not_empty_cv_, token, timer, timeout_ms,
+                            "Time out on popping.");
+    if (!status.ok())
+      return status;
     woken = true;
   }
 
@@ -252,6 +253,7 @@ template <class T>
 Status ProducerConsumerQueue<T>::Peek(size_t pos,
                                       T* element,
                                       int64_t timeout_ms) {
+  const CancellationToken* token = CancellationToken::Current();
   base::AutoLock l(lock_);
   if (pos < head_pos_) {
     return Status(
@@ -263,7 +265,6 @@ Status ProducerConsumerQueue<T>::Peek(size_t pos,
   bool woken = false;
 
   base::ElapsedTimer timer;
-  base::TimeDelta timeout_delta = base::TimeDelta::FromMilliseconds(timeout_ms);
 
   // Move head to create some space (move the sliding window centered @ pos).
   SlideHeadOnCenter(pos);
@@ -272,19 +273,11 @@ Status ProducerConsumerQueue<T>::Peek(size_t pos,
     if (stop_requested_)
       return Status(error::STOPPED, "");
 
-    if (timeout_ms < 0) {
-      // Wait forever, or until Stop.
-      new_element_cv_.Wait();
-    } else {
-      base::TimeDelta elapsed = timer.Elapsed();
-      if (elapsed < timeout_delta) {
-        // Wait with timeout, or until Stop.
-        new_element_cv_.TimedWait(timeout_delta - elapsed);
-      } else {
-        // We're through waiting.
-        return Status(error::TIME_OUT, "Time out on peeking.");
-      }
-    }
+    // Wait with timeout, or until Stop.
+    Status status = WaitFor(&new_element_cv_, token, timer, timeout_ms,
+                            "Time out on peeking.");
+    if (!status.ok())
+      return status;
     // Move head to create some space (move the sliding window centered @ pos).
     SlideHeadOnCenter(pos);
     woken = true;
@@ -314,6 +307,43 @@ void ProducerConsumerQueue<T>::SlideHeadOnCenter(size_t pos) {
   }
 }
 
+template <class T>
+Status ProducerConsumerQueue<T>::WaitFor(base::ConditionVariable* cv,
+                                         const CancellationToken* token,
+                                         const base::ElapsedTimer& timer,
+                                         int64_t timeout_ms,
+                                         const char* timeout_message) {
+  lock_.AssertAcquired();
+
+  if (token && token->IsCancelled())
+    return Status(error::CANCELLED, "Cancelled while waiting on the queue.");
+
+  const bool wait_forever = timeout_ms < 0;
+  base::TimeDelta wait_delta;
+  if (!wait_forever) {
+    const base::TimeDelta timeout_delta =
+        base::TimeDelta::FromMilliseconds(timeout_ms);
+    const base::TimeDelta elapsed = timer.Elapsed();
+    if (elapsed >= timeout_delta) {
+      // We're through waiting.
+      return Status(error::TIME_OUT, timeout_message);
+    }
+    wait_delta = timeout_delta - elapsed;
+  }
+
+  if (token) {
+    const base::TimeDelta check_interval =
+        base::TimeDelta::FromMilliseconds(kCancellationCheckIntervalMs);
+    cv->TimedWait(wait_forever ? check_interval
+                               : std::min(wait_delta, check_interval));
+  } else if (wait_forever) {
+    cv->Wait();
+  } else {
+    cv->TimedWait(wait_delta);
+  }
+  return Status::OK;
+}
+
 }  // namespace media
 }  // namespace edash_packager
 
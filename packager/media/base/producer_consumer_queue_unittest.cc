@@ -8,6 +8,8 @@
 
 #include "packager/base/bind.h"
 #include "packager/base/synchronization/waitable_event.h"
+#include "packager/base/threading/platform_thread.h"
+#include "packager/media/base/cancellation_token.h"
 #include "packager/media/base/closure_thread.h"
 #include "packager/media/base/producer_consumer_queue.h"
 #include "packager/media/base/test/status_test_util.h"
@@ -149,6 +151,25 @@ TEST(ProducerConsumerQueueTest, PeekWithTimeout) {
   }
 }
 
+TEST(ProducerConsumerQueueTest, CancelledToken) {
+  ProducerConsumerQueue<int> queue(1);
+  ASSERT_OK(queue.Push(0, kInfiniteTimeout));
+
+  scoped_refptr<CancellationToken> token(new CancellationToken);
+  token->Cancel();
+  ScopedCancellationToken scoped_token(token.get());
+
+  base::ElapsedTimer timer;
+  // The queue is full, so Push waits, and returns as it is cancelled.
+  EXPECT_EQ(error::CANCELLED, queue.Push(1, kInfiniteTimeout).error_code());
+  int val;
+  ASSERT_OK(queue.Pop(&val, kInfiniteTimeout));
+  EXPECT_EQ(error::CANCELLED, queue.Pop(&val, kInfiniteTimeout).error_code());
+  EXPECT_EQ(error::CANCELLED,
+            queue.Peek(1, &val, kInfiniteTimeout).error_code());
+  ExpectTimeApproxEqual(0, timer.Elapsed());
+}
+
 TEST(ProducerConsumerQueueTest, CheckStop) {
   scoped_ptr<base::ElapsedTimer> timer;
   ProducerConsumerQueue<int> queue(kUnlimitedCapacity);
@@ -301,11 +322,13 @@ enum Operation {
 class MultiThreadProducerConsumerQueueStopTest
     : public ::testing::TestWithParam<Operation> {
  public:
-  MultiThreadProducerConsumerQueueStopTest() : queue_(1), event_(true, false) {}
+  MultiThreadProducerConsumerQueueStopTest()
+      : queue_(1), event_(true, false), token_(new CancellationToken) {}
   ~MultiThreadProducerConsumerQueueStopTest() override {}
 
  public:
   void ClosureTask(Operation op) {
+    ScopedCancellationToken scoped_token(token_.get());
     int val = 0;
     switch (op) {
       case kPush:
@@ -332,9 +355,10 @@ class MultiThreadProducerConsumerQueueStopTest
  protected:
   ProducerConsumerQueue<int> queue_;
   base::WaitableEvent event_;
+  scoped_refptr<CancellationToken> token_;
+  Status status_;
 
  private:
-  Status status_;
 
   DISALLOW_COPY_AND_ASSIGN(MultiThreadProducerConsumerQueueStopTest);
 };
@@ -359,6 +383,29 @@ TEST_P(MultiThreadProducerConsumerQueueStopTest, StopTests) {
   thread.Join();
 }
 
+// Verify that cancelling the token of the thread stops Push/Pop/Peek
+// operations promptly.
+TEST_P(MultiThreadProducerConsumerQueueStopTest, CancelTests) {
+  Operation op = GetParam();
+  ClosureThread thread(
+      "My Thread",
+      base::Bind(&MultiThreadProducerConsumerQueueStopTest::ClosureTask,
+                 base::Unretained(this),
+                 op));
+  thread.Start();
+
+  // Let the operation block.
+  base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(kTimeout));
+  ASSERT_TRUE(!event_.IsSignaled());
+  base::ElapsedTimer timer;
+  token_->Cancel();
+  event_.Wait();
+  ExpectTimeApproxEqual(0, timer.Elapsed());
+
+  thread.Join();
+  EXPECT_EQ(error::CANCELLED, status_.error_code());
+}
+
 INSTANTIATE_TEST_CASE_P(Operations,
                         MultiThreadProducerConsumerQueueStopTest,
                         ::testing::Values(kPush, kPop, kPeek));
@@ -47,6 +47,7 @@ bool ProtectionSystemSpecificInfo::Parse(const uint8_t* data,
   uint32_t box_type;
   uint32_t version_and_flags;
   BufferReader reader(data, data_size);
+  box_.clear();
 
   RCHECK(reader.Read4(&size));
   RCHECK(reader.Read4(&box_type));
@@ -81,6 +82,12 @@ bool ProtectionSystemSpecificInfo::Parse(const uint8_t* data,
 }
 
 std::vector<uint8_t> ProtectionSystemSpecificInfo::CreateBox() const {
+  if (!box_.empty())
+    return box_;
+  return SerializeBox();
+}
+
+std::vector<uint8_t> ProtectionSystemSpecificInfo::SerializeBox() const {
   DCHECK_EQ(kSystemIdSize, system_id_.size());
 
   const uint32_t box_type = FOURCC_pssh;
@@ -36,6 +36,11 @@ class ProtectionSystemSpecificInfo {
   /// Creates a PSSH box for the current data.
   std::vector<uint8_t> CreateBox() const;
 
+  /// Serializes the PSSH box once, so that CreateBox() returns a copy of it
+  /// instead of serializing it again, e.g. for the boxes shared by all the
+  /// muxers of a job. Modifying the data drops the serialized box.
+  void CacheBox() { box_ = SerializeBox(); }
+
   uint8_t pssh_box_version() const { return version_; }
   const std::vector<uint8_t>& system_id() const { return system_id_; }
   const std::vector<std::vector<uint8_t>>& key_ids() const { return key_ids_; }
@@ -44,25 +49,36 @@ class ProtectionSystemSpecificInfo {
   void set_pssh_box_version(uint8_t version) {
     DCHECK_LT(version, 2);
     version_ = version;
+    box_.clear();
   }
   void set_system_id(const uint8_t* system_id, size_t system_id_size) {
     DCHECK_EQ(16u, system_id_size);
     system_id_.assign(system_id, system_id + system_id_size);
+    box_.clear();
   }
   void add_key_id(const std::vector<uint8_t>& key_id) {
     DCHECK_EQ(16u, key_id.size());
     key_ids_.push_back(key_id);
+    box_.clear();
+  }
+  void clear_key_ids() {
+    key_ids_.clear();
+    box_.clear();
   }
-  void clear_key_ids() { key_ids_.clear(); }
   void set_pssh_data(const std::vector<uint8_t>& pssh_data) {
     pssh_data_ = pssh_data;
+    box_.clear();
   }
 
  private:
+  std::vector<uint8_t> SerializeBox() const;
+
   uint8_t version_;
   std::vector<uint8_t> system_id_;
   std::vector<std::vector<uint8_t>> key_ids_;
   std::vector<uint8_t> pssh_data_;
+  // The box serialized by CacheBox(), if any.
+  std::vector<uint8_t> box_;
 
   // Don't use DISALLOW_COPY_AND_ASSIGN since the data stored here should be
   // small, so the performance impact should be minimal.
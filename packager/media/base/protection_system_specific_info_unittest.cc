@@ -136,5 +136,22 @@ TEST_F(PsshTest, CreateBox_MakesV1Boxes) {
   EXPECT_EQ(v1_box_, info.CreateBox());
 }
 
+TEST_F(PsshTest, CacheBox_IsDroppedOnModification) {
+  ProtectionSystemSpecificInfo info;
+  info.set_system_id(kTestSystemIdArray, arraysize(kTestSystemIdArray));
+  info.set_pssh_data(test_pssh_data_);
+  info.set_pssh_box_version(0);
+  info.CacheBox();
+  EXPECT_EQ(v0_box_, info.CreateBox());
+
+  // A copy keeps the serialized box.
+  ProtectionSystemSpecificInfo copy = info;
+  EXPECT_EQ(v0_box_, copy.CreateBox());
+
+  copy.add_key_id(test_key_id_);
+  copy.set_pssh_box_version(1);
+  EXPECT_EQ(v1_box_, copy.CreateBox());
+}
+
 }  // namespace media
 }  // namespace edash_packager
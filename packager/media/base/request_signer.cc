@@ -6,19 +6,33 @@
 
 #include "packager/media/base/request_signer.h"
 
+#include <algorithm>
+
+#include "packager/base/bind.h"
 #include "packager/base/logging.h"
 #include "packager/base/sha1.h"
 #include "packager/base/strings/string_number_conversions.h"
+#include "packager/base/synchronization/waitable_event.h"
 #include "packager/media/base/aes_encryptor.h"
 #include "packager/media/base/rsa_key.h"
+#include "packager/media/base/thread_pool.h"
 
 namespace edash_packager {
 namespace media {
 
+namespace {
+// Number of prepared signatures kept until they are requested. The oldest
+// ones are dropped beyond that.
+const size_t kMaxPreparedSignatures = 4;
+const size_t kNumSigningThreads = 2;
+}  // namespace
+
 RequestSigner::RequestSigner(const std::string& signer_name)
     : signer_name_(signer_name) {}
 RequestSigner::~RequestSigner() {}
 
+void RequestSigner::PrepareSignature(const std::string& message) {}
+
 AesRequestSigner::AesRequestSigner(const std::string& signer_name,
                                    scoped_ptr<AesCbcEncryptor> encryptor)
     : RequestSigner(signer_name), aes_cbc_encryptor_(encryptor.Pass()) {
@@ -53,6 +67,35 @@ bool AesRequestSigner::GenerateSignature(const std::string& message,
   return true;
 }
 
+// A signature being generated in a worker thread.
+class RsaRequestSigner::PreparedSignature
+    : public base::RefCountedThreadSafe<PreparedSignature> {
+ public:
+  PreparedSignature() : done_(true, false), success_(false) {}
+
+  // Called in a worker thread.
+  void Generate(RsaPrivateKey* rsa_private_key, const std::string& message) {
+    success_ = rsa_private_key->GenerateSignature(message, &signature_);
+    done_.Signal();
+  }
+
+  bool Wait(std::string* signature) {
+    done_.Wait();
+    *signature = signature_;
+    return success_;
+  }
+
+ private:
+  friend class base::RefCountedThreadSafe<PreparedSignature>;
+  ~PreparedSignature() {}
+
+  base::WaitableEvent done_;
+  bool success_;
+  std::string signature_;
+
+  DISALLOW_COPY_AND_ASSIGN(PreparedSignature);
+};
+
 RsaRequestSigner::RsaRequestSigner(const std::string& signer_name,
                                    scoped_ptr<RsaPrivateKey> rsa_private_key)
     : RequestSigner(signer_name), rsa_private_key_(rsa_private_key.Pass()) {
@@ -72,8 +115,47 @@ RsaRequestSigner* RsaRequestSigner::CreateSigner(
 
 bool RsaRequestSigner::GenerateSignature(const std::string& message,
                                          std::string* signature) {
+  DCHECK(signature);
+  scoped_refptr<PreparedSignature> prepared_signature;
+  {
+    base::AutoLock lock(lock_);
+    std::map<std::string, scoped_refptr<PreparedSignature> >::iterator iter =
+        prepared_signatures_.find(message);
+    if (iter != prepared_signatures_.end()) {
+      prepared_signature = iter->second;
+      prepared_signatures_.erase(iter);
+      prepared_messages_.erase(std::find(prepared_messages_.begin(),
+                                         prepared_messages_.end(), message));
+    }
+  }
+  if (prepared_signature)
+    return prepared_signature->Wait(signature);
   return rsa_private_key_->GenerateSignature(message, signature);
 }
 
+void RsaRequestSigner::PrepareSignature(const std::string& message) {
+  base::AutoLock lock(lock_);
+  if (prepared_signatures_.find(message) != prepared_signatures_.end())
+    return;
+  if (!signing_thread_pool_) {
+    signing_thread_pool_.reset(
+        new ThreadPool("RsaSigningThread", kNumSigningThreads));
+    signing_thread_pool_->Start();
+  }
+
+  scoped_refptr<PreparedSignature> prepared_signature(new PreparedSignature);
+  prepared_signatures_[message] = prepared_signature;
+  prepared_messages_.push_back(message);
+  signing_thread_pool_->PostTask(base::Bind(
+      &PreparedSignature::Generate, prepared_signature,
+      base::Unretained(rsa_private_key_.get()), message));
+
+  // Drop the oldest signatures, which are likely not going to be requested.
+  while (prepared_messages_.size() > kMaxPreparedSignatures) {
+    prepared_signatures_.erase(prepared_messages_.front());
+    prepared_messages_.pop_front();
+  }
+}
+
 }  // namespace media
 }  // namespace edash_packager
@@ -7,15 +7,20 @@
 #ifndef MEDIA_BASE_REQUEST_SIGNER_H_
 #define MEDIA_BASE_REQUEST_SIGNER_H_
 
+#include <deque>
+#include <map>
 #include <string>
 
+#include "packager/base/memory/ref_counted.h"
 #include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/synchronization/lock.h"
 
 namespace edash_packager {
 namespace media {
 
 class AesCbcEncryptor;
 class RsaPrivateKey;
+class ThreadPool;
 
 /// Abstract class used for signature generation.
 class RequestSigner {
@@ -28,6 +33,11 @@ class RequestSigner {
   virtual bool GenerateSignature(const std::string& message,
                                  std::string* signature) = 0;
 
+  /// Hint that the signature of @a message is going to be requested, so it
+  /// can be generated ahead of time, e.g. in a worker thread. The default
+  /// implementation does nothing.
+  virtual void PrepareSignature(const std::string& message);
+
   const std::string& signer_name() const { return signer_name_; }
 
  protected:
@@ -73,16 +83,33 @@ class RsaRequestSigner : public RequestSigner {
   static RsaRequestSigner* CreateSigner(const std::string& signer_name,
                                         const std::string& pkcs1_rsa_key);
 
-  /// RequestSigner implementation override.
+  /// @name RequestSigner implementation overrides.
+  /// @{
+  /// Returns the signature generated by PrepareSignature() if there is one,
+  /// waiting for it if needed. Thread safe.
   bool GenerateSignature(const std::string& message,
                          std::string* signature) override;
+  /// Generates the signature of @a message in a worker thread. A few
+  /// prepared signatures are kept until they are requested.
+  void PrepareSignature(const std::string& message) override;
+  /// @}
 
  private:
+  class PreparedSignature;
+
   RsaRequestSigner(const std::string& signer_name,
                    scoped_ptr<RsaPrivateKey> rsa_private_key);
 
   scoped_ptr<RsaPrivateKey> rsa_private_key_;
 
+  base::Lock lock_;
+  // Prepared signatures by message, and the messages in preparation order.
+  std::map<std::string, scoped_refptr<PreparedSignature> > prepared_signatures_;
+  std::deque<std::string> prepared_messages_;
+  // Signs the prepared messages. Created on first use. Declared last, so
+  // its threads are joined before the key is destroyed.
+  scoped_ptr<ThreadPool> signing_thread_pool_;
+
   DISALLOW_COPY_AND_ASSIGN(RsaRequestSigner);
 };
 
@@ -0,0 +1,78 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/strings/string_number_conversions.h"
+#include "packager/media/base/request_signer.h"
+#include "packager/media/base/rsa_key.h"
+#include "packager/media/base/test/rsa_test_data.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+const char kSignerName[] = "SignerFoo";
+}  // namespace
+
+class RsaRequestSignerTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    const RsaTestSet& test_set = test_data_.test_set_2048_bits();
+    signer_.reset(
+        RsaRequestSigner::CreateSigner(kSignerName, test_set.private_key));
+    ASSERT_TRUE(signer_);
+    public_key_.reset(RsaPublicKey::Create(test_set.public_key));
+    ASSERT_TRUE(public_key_);
+  }
+
+ protected:
+  RsaTestData test_data_;
+  scoped_ptr<RsaRequestSigner> signer_;
+  scoped_ptr<RsaPublicKey> public_key_;
+};
+
+TEST_F(RsaRequestSignerTest, GenerateSignature) {
+  const std::string kMessage = "request message";
+  std::string signature;
+  ASSERT_TRUE(signer_->GenerateSignature(kMessage, &signature));
+  EXPECT_TRUE(public_key_->VerifySignature(kMessage, signature));
+  EXPECT_EQ(kSignerName, signer_->signer_name());
+}
+
+TEST_F(RsaRequestSignerTest, PreparedSignatures) {
+  const int kNumMessages = 3;
+  for (int i = 0; i < kNumMessages; ++i)
+    signer_->PrepareSignature("message " + base::IntToString(i));
+
+  // Requested out of order, and twice; the second request is signed again.
+  for (int i = kNumMessages - 1; i >= 0; --i) {
+    const std::string message = "message " + base::IntToString(i);
+    for (int j = 0; j < 2; ++j) {
+      std::string signature;
+      ASSERT_TRUE(signer_->GenerateSignature(message, &signature));
+      EXPECT_TRUE(public_key_->VerifySignature(message, signature));
+    }
+  }
+}
+
+TEST_F(RsaRequestSignerTest, UnusedPreparedSignatures) {
+  // More signatures than are kept; the oldest are dropped, and the requests
+  // for them are signed on demand.
+  const int kNumMessages = 10;
+  for (int i = 0; i < kNumMessages; ++i)
+    signer_->PrepareSignature("message " + base::IntToString(i));
+  for (int i = 0; i < kNumMessages; i += 3) {
+    const std::string message = "message " + base::IntToString(i);
+    std::string signature;
+    ASSERT_TRUE(signer_->GenerateSignature(message, &signature));
+    EXPECT_TRUE(public_key_->VerifySignature(message, signature));
+  }
+}
+
+}  // namespace media
+}  // namespace edash_packager
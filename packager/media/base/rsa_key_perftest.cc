@@ -0,0 +1,87 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/strings/string_number_conversions.h"
+#include "packager/base/time/time.h"
+#include "packager/media/base/request_signer.h"
+#include "packager/media/base/rsa_key.h"
+#include "packager/media/base/test/rsa_test_data.h"
+#include "packager/testing/perf/perf_test.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+const int kNumSignatures = 500;
+// A key request is a few hundred bytes of JSON.
+const size_t kMessageSize = 512;
+}  // namespace
+
+class RsaKeyPerfTest : public ::testing::Test {
+ protected:
+  std::string Message(int index) {
+    std::string message = base::IntToString(index);
+    message.resize(kMessageSize, 'x');
+    return message;
+  }
+
+  void PrintSignaturesPerSecond(const std::string& trace,
+                                base::TimeTicks start) {
+    const double seconds = (base::TimeTicks::Now() - start).InSecondsF();
+    perf_test::PrintResult("rsa_signing", "", trace, kNumSignatures / seconds,
+                           "signatures/s", true);
+  }
+
+  RsaTestData test_data_;
+};
+
+TEST_F(RsaKeyPerfTest, GenerateSignature2048) {
+  scoped_ptr<RsaPrivateKey> private_key(
+      RsaPrivateKey::Create(test_data_.test_set_2048_bits().private_key));
+  ASSERT_TRUE(private_key);
+  std::string signature;
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kNumSignatures; ++i)
+    ASSERT_TRUE(private_key->GenerateSignature(Message(i), &signature));
+  PrintSignaturesPerSecond("2048", start);
+}
+
+TEST_F(RsaKeyPerfTest, GenerateSignature3072) {
+  scoped_ptr<RsaPrivateKey> private_key(
+      RsaPrivateKey::Create(test_data_.test_set_3072_bits().private_key));
+  ASSERT_TRUE(private_key);
+  std::string signature;
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kNumSignatures; ++i)
+    ASSERT_TRUE(private_key->GenerateSignature(Message(i), &signature));
+  PrintSignaturesPerSecond("3072", start);
+}
+
+// Requests are prepared one ahead, as with key rotation, so the signing
+// overlaps with the caller's work, here simulated by signing synchronously.
+TEST_F(RsaKeyPerfTest, PreparedSignature2048) {
+  scoped_ptr<RsaRequestSigner> signer(RsaRequestSigner::CreateSigner(
+      "signer", test_data_.test_set_2048_bits().private_key));
+  ASSERT_TRUE(signer);
+  scoped_ptr<RsaPrivateKey> private_key(
+      RsaPrivateKey::Create(test_data_.test_set_2048_bits().private_key));
+  ASSERT_TRUE(private_key);
+  std::string signature;
+  base::TimeTicks start = base::TimeTicks::Now();
+  signer->PrepareSignature(Message(0));
+  for (int i = 0; i < kNumSignatures; ++i) {
+    signer->PrepareSignature(Message(i + 1));
+    ASSERT_TRUE(signer->GenerateSignature(Message(i), &signature));
+    ASSERT_TRUE(private_key->GenerateSignature(Message(i), &signature));
+  }
+  PrintSignaturesPerSecond("2048_prepared_with_concurrent_work", start);
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,134 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/sample_buffer_pool.h"
+
+#include <inttypes.h>
+
+#include "packager/base/logging.h"
+#include "packager/base/strings/stringprintf.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+// Buffers smaller than 2^kMinSizeClassBits bytes are rounded up to this size.
+const size_t kMinSizeClassBits = 8;  // 256 bytes.
+// Buffers larger than 2^kMaxSizeClassBits bytes are not pooled.
+const size_t kMaxSizeClassBits = 24;  // 16MB.
+const size_t kNumSizeClasses = kMaxSizeClassBits - kMinSizeClassBits + 1;
+// Default limit on the capacity of free buffers held by a pool.
+const uint64_t kDefaultMaxPooledBytes = 32 * 1024 * 1024;
+
+// Return the minimum buffer capacity of |size_class|.
+size_t SizeClassCapacity(size_t size_class) {
+  return static_cast<size_t>(1) << (size_class + kMinSizeClassBits);
+}
+
+// Return the smallest size class which can hold |size| bytes. Returns
+// kNumSizeClasses if |size| is too large to be pooled.
+size_t SizeClassForSize(size_t size) {
+  size_t size_class = 0;
+  while (size_class < kNumSizeClasses && SizeClassCapacity(size_class) < size)
+    ++size_class;
+  return size_class;
+}
+
+// Return the largest size class that a buffer of |capacity| bytes can serve.
+// Returns kNumSizeClasses if |capacity| is not within the pooled range.
+size_t SizeClassForCapacity(size_t capacity) {
+  if (capacity < SizeClassCapacity(0) ||
+      capacity >= 2 * SizeClassCapacity(kNumSizeClasses - 1)) {
+    return kNumSizeClasses;
+  }
+  size_t size_class = 0;
+  while (size_class + 1 < kNumSizeClasses &&
+         SizeClassCapacity(size_class + 1) <= capacity) {
+    ++size_class;
+  }
+  return size_class;
+}
+
+}  // namespace
+
+SampleBufferPool::Stats::Stats()
+    : hits(0), misses(0), recycled(0), dropped(0), pooled_bytes(0) {}
+
+std::string SampleBufferPool::Stats::ToString() const {
+  return base::StringPrintf(
+      "hits: %" PRIu64 " misses: %" PRIu64 " recycled: %" PRIu64
+      " dropped: %" PRIu64 " pooled_bytes: %" PRIu64,
+      hits, misses, recycled, dropped, pooled_bytes);
+}
+
+SampleBufferPool::SampleBufferPool()
+    : free_buffers_(kNumSizeClasses),
+      max_pooled_bytes_(kDefaultMaxPooledBytes) {}
+
+SampleBufferPool::SampleBufferPool(uint64_t max_pooled_bytes)
+    : free_buffers_(kNumSizeClasses), max_pooled_bytes_(max_pooled_bytes) {}
+
+SampleBufferPool::~SampleBufferPool() {
+  VLOG(1) << "SampleBufferPool " << stats_.ToString();
+}
+
+void SampleBufferPool::Acquire(size_t size, std::vector<uint8_t>* buffer) {
+  DCHECK(buffer);
+
+  const size_t size_class = SizeClassForSize(size);
+  {
+    base::AutoLock l(lock_);
+    if (size_class < kNumSizeClasses && !free_buffers_[size_class].empty()) {
+      std::vector<std::vector<uint8_t> >& free_list = free_buffers_[size_class];
+      buffer->swap(free_list.back());
+      free_list.pop_back();
+      stats_.pooled_bytes -= buffer->capacity();
+      ++stats_.hits;
+      buffer->resize(size);
+      return;
+    }
+    ++stats_.misses;
+  }
+
+  std::vector<uint8_t> new_buffer;
+  // Reserve the full size class so the buffer can be reused for any request
+  // in the same class.
+  if (size_class < kNumSizeClasses)
+    new_buffer.reserve(SizeClassCapacity(size_class));
+  new_buffer.resize(size);
+  buffer->swap(new_buffer);
+}
+
+void SampleBufferPool::Recycle(std::vector<uint8_t>* buffer) {
+  DCHECK(buffer);
+
+  const size_t capacity = buffer->capacity();
+  if (capacity == 0)
+    return;
+  const size_t size_class = SizeClassForCapacity(capacity);
+
+  base::AutoLock l(lock_);
+  if (size_class >= kNumSizeClasses ||
+      stats_.pooled_bytes + capacity > max_pooled_bytes_) {
+    ++stats_.dropped;
+    std::vector<uint8_t>().swap(*buffer);
+    return;
+  }
+  buffer->clear();
+  free_buffers_[size_class].push_back(std::vector<uint8_t>());
+  free_buffers_[size_class].back().swap(*buffer);
+  stats_.pooled_bytes += capacity;
+  ++stats_.recycled;
+}
+
+SampleBufferPool::Stats SampleBufferPool::GetStats() const {
+  base::AutoLock l(lock_);
+  return stats_;
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,86 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef PACKAGER_MEDIA_BASE_SAMPLE_BUFFER_POOL_H_
+#define PACKAGER_MEDIA_BASE_SAMPLE_BUFFER_POOL_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "packager/base/macros.h"
+#include "packager/base/memory/ref_counted.h"
+#include "packager/base/synchronization/lock.h"
+
+namespace edash_packager {
+namespace media {
+
+/// A pool of recycled payload buffers for MediaSample. Buffers are grouped in
+/// power-of-two size classes. A MediaSample created from a pool returns its
+/// buffers to the pool when it is destroyed, i.e. once the muxer has flushed
+/// the fragment containing the sample, so that steady-state demuxing does not
+/// hit the heap allocator for sample payloads.
+/// Thread Safety: SampleBufferPool is thread safe. Samples are typically
+/// created in the demuxer thread and released in a muxer thread.
+class SampleBufferPool : public base::RefCountedThreadSafe<SampleBufferPool> {
+ public:
+  struct Stats {
+    Stats();
+
+    /// Number of buffer requests served from the pool.
+    uint64_t hits;
+    /// Number of buffer requests that had to allocate.
+    uint64_t misses;
+    /// Number of buffers returned to the pool for reuse.
+    uint64_t recycled;
+    /// Number of returned buffers freed as the pool was full or the buffer
+    /// was too large to be pooled.
+    uint64_t dropped;
+    /// Total capacity of the buffers currently held by the pool, in bytes.
+    uint64_t pooled_bytes;
+
+    /// @return a human-readable string describing |*this|.
+    std::string ToString() const;
+  };
+
+  /// Create a pool with the default limits.
+  SampleBufferPool();
+  /// @param max_pooled_bytes is the maximum total capacity of the free buffers
+  ///        held by the pool. Buffers returned beyond this are freed.
+  explicit SampleBufferPool(uint64_t max_pooled_bytes);
+
+  /// Get a buffer of @a size bytes. The buffer content is unspecified.
+  /// @param size is the requested buffer size.
+  /// @param[out] buffer receives the buffer. Its previous content is
+  ///             discarded.
+  void Acquire(size_t size, std::vector<uint8_t>* buffer);
+
+  /// Return a buffer to the pool. @a buffer is left empty.
+  void Recycle(std::vector<uint8_t>* buffer);
+
+  /// @return A snapshot of the pool statistics.
+  Stats GetStats() const;
+
+ private:
+  friend class base::RefCountedThreadSafe<SampleBufferPool>;
+  ~SampleBufferPool();
+
+  // Free buffers, indexed by size class. Every buffer in class |i| has a
+  // capacity of at least 2^(i + kMinSizeClassBits) bytes.
+  std::vector<std::vector<std::vector<uint8_t> > > free_buffers_;
+  const uint64_t max_pooled_bytes_;
+
+  mutable base::Lock lock_;
+  Stats stats_;
+
+  DISALLOW_COPY_AND_ASSIGN(SampleBufferPool);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // PACKAGER_MEDIA_BASE_SAMPLE_BUFFER_POOL_H_
@@ -0,0 +1,102 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+
+#include "packager/media/base/media_sample.h"
+#include "packager/media/base/sample_buffer_pool.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+const uint8_t kData[] = {0x01, 0x02, 0x03, 0x04, 0x05};
+const uint8_t kSideData[] = {0x0a, 0x0b};
+const bool kKeyFrame = true;
+}  // namespace
+
+TEST(SampleBufferPoolTest, AcquireRecycle) {
+  scoped_refptr<SampleBufferPool> pool(new SampleBufferPool);
+
+  std::vector<uint8_t> buffer;
+  pool->Acquire(1000, &buffer);
+  EXPECT_EQ(1000u, buffer.size());
+  EXPECT_EQ(0u, pool->GetStats().hits);
+  EXPECT_EQ(1u, pool->GetStats().misses);
+
+  const uint8_t* buffer_data = buffer.data();
+  pool->Recycle(&buffer);
+  EXPECT_TRUE(buffer.empty());
+  EXPECT_EQ(1u, pool->GetStats().recycled);
+  EXPECT_GE(pool->GetStats().pooled_bytes, 1000u);
+
+  // A request in the same size class reuses the buffer.
+  pool->Acquire(900, &buffer);
+  EXPECT_EQ(900u, buffer.size());
+  EXPECT_EQ(buffer_data, buffer.data());
+  EXPECT_EQ(1u, pool->GetStats().hits);
+  EXPECT_EQ(0u, pool->GetStats().pooled_bytes);
+}
+
+TEST(SampleBufferPoolTest, DifferentSizeClass) {
+  scoped_refptr<SampleBufferPool> pool(new SampleBufferPool);
+
+  std::vector<uint8_t> buffer;
+  pool->Acquire(1000, &buffer);
+  pool->Recycle(&buffer);
+
+  // Too large for the pooled buffer.
+  pool->Acquire(5000, &buffer);
+  EXPECT_EQ(5000u, buffer.size());
+  EXPECT_EQ(0u, pool->GetStats().hits);
+  EXPECT_EQ(2u, pool->GetStats().misses);
+}
+
+TEST(SampleBufferPoolTest, MaxPooledBytes) {
+  const uint64_t kMaxPooledBytes = 4096;
+  scoped_refptr<SampleBufferPool> pool(new SampleBufferPool(kMaxPooledBytes));
+
+  std::vector<uint8_t> buffer1;
+  std::vector<uint8_t> buffer2;
+  pool->Acquire(4096, &buffer1);
+  pool->Acquire(4096, &buffer2);
+  pool->Recycle(&buffer1);
+  pool->Recycle(&buffer2);
+  EXPECT_EQ(1u, pool->GetStats().recycled);
+  EXPECT_EQ(1u, pool->GetStats().dropped);
+  EXPECT_LE(pool->GetStats().pooled_bytes, kMaxPooledBytes);
+}
+
+TEST(SampleBufferPoolTest, MediaSampleReturnsBuffersToPool) {
+  scoped_refptr<SampleBufferPool> pool(new SampleBufferPool);
+
+  scoped_refptr<MediaSample> sample =
+      MediaSample::CopyFrom(kData, sizeof(kData), kSideData, sizeof(kSideData),
+                            kKeyFrame, pool.get());
+  ASSERT_EQ(sizeof(kData), sample->data_size());
+  EXPECT_EQ(std::vector<uint8_t>(kData, kData + sizeof(kData)),
+            std::vector<uint8_t>(sample->data(),
+                                 sample->data() + sample->data_size()));
+  ASSERT_EQ(sizeof(kSideData), sample->side_data_size());
+  EXPECT_EQ(std::vector<uint8_t>(kSideData, kSideData + sizeof(kSideData)),
+            std::vector<uint8_t>(sample->side_data(),
+                                 sample->side_data() +
+                                     sample->side_data_size()));
+  EXPECT_TRUE(sample->is_key_frame());
+  EXPECT_EQ(2u, pool->GetStats().misses);
+
+  sample = NULL;
+  EXPECT_EQ(2u, pool->GetStats().recycled);
+
+  // The next sample is served from the pool.
+  sample = MediaSample::CopyFrom(kData, sizeof(kData), NULL, 0, !kKeyFrame,
+                                 pool.get());
+  EXPECT_EQ(1u, pool->GetStats().hits);
+  EXPECT_FALSE(sample->is_key_frame());
+}
+
+}  // namespace media
+}  // namespace edash_packager
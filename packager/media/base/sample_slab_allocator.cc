@@ -0,0 +1,71 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/sample_slab_allocator.h"
+
+#include <string.h>
+
+#include "packager/base/logging.h"
+#include "packager/media/base/media_sample.h"
+#include "packager/media/base/sample_buffer_pool.h"
+#include "packager/media/base/shared_buffer.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+// A 64KB slab holds about three seconds of 128kbps AAC, so the slabs are
+// released shortly after the fragments referencing them are written.
+const size_t kDefaultSlabSize = 64 * 1024;
+// Larger samples are not packed, to bound the space wasted at the end of a
+// slab.
+const size_t kDefaultMaxPackedSize = 4 * 1024;
+}  // namespace
+
+SampleSlabAllocator::SampleSlabAllocator(SampleBufferPool* fallback_pool)
+    : fallback_pool_(fallback_pool),
+      slab_size_(kDefaultSlabSize),
+      max_packed_size_(kDefaultMaxPackedSize),
+      slab_offset_(0) {
+  DCHECK(fallback_pool_);
+}
+
+SampleSlabAllocator::SampleSlabAllocator(SampleBufferPool* fallback_pool,
+                                         size_t slab_size,
+                                         size_t max_packed_size)
+    : fallback_pool_(fallback_pool),
+      slab_size_(slab_size),
+      max_packed_size_(max_packed_size),
+      slab_offset_(0) {
+  DCHECK(fallback_pool_);
+  DCHECK_LE(max_packed_size_, slab_size_);
+}
+
+SampleSlabAllocator::~SampleSlabAllocator() {}
+
+scoped_refptr<MediaSample> SampleSlabAllocator::CopyFrom(const uint8_t* data,
+                                                         size_t size,
+                                                         bool is_key_frame) {
+  // Empty samples cannot reference a shared buffer.
+  if (size == 0 || size > max_packed_size_) {
+    return MediaSample::CopyFrom(data, size, NULL, 0, is_key_frame,
+                                 fallback_pool_.get());
+  }
+
+  if (!slab_ || slab_size_ - slab_offset_ < size) {
+    // The previous slab stays alive as long as samples reference it.
+    slab_ = new SharedBuffer(slab_size_);
+    slab_offset_ = 0;
+  }
+  uint8_t* sample_data = slab_->data() + slab_offset_;
+  memcpy(sample_data, data, size);
+  slab_offset_ += size;
+  return MediaSample::CreateFromSharedBuffer(slab_, sample_data, size,
+                                             is_key_frame);
+}
+
+}  // namespace media
+}  // namespace edash_packager
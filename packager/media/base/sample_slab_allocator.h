@@ -0,0 +1,72 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef PACKAGER_MEDIA_BASE_SAMPLE_SLAB_ALLOCATOR_H_
+#define PACKAGER_MEDIA_BASE_SAMPLE_SLAB_ALLOCATOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "packager/base/macros.h"
+#include "packager/base/memory/ref_counted.h"
+
+namespace edash_packager {
+namespace media {
+
+class MediaSample;
+class SampleBufferPool;
+class SharedBuffer;
+
+/// Packs the payloads of small samples, e.g. audio frames, contiguously into
+/// shared slabs. The samples reference their slice of the slab (see
+/// MediaSample::CreateFromSharedBuffer), so a slab is allocated once for a
+/// few hundred frames instead of once per frame, and the payloads of
+/// consecutive frames are adjacent in memory when the fragment is written. A
+/// slab is freed when the last sample referencing it is destroyed.
+/// Thread Safety: SampleSlabAllocator is not thread safe; it is meant to be
+/// owned by a parser. The samples it creates can be used on any thread.
+class SampleSlabAllocator {
+ public:
+  /// Create an allocator with the default slab size.
+  /// @param fallback_pool is the pool to allocate the payload of samples too
+  ///        large to be packed from. Must not be NULL.
+  explicit SampleSlabAllocator(SampleBufferPool* fallback_pool);
+  /// @param fallback_pool is the same as above.
+  /// @param slab_size is the size of the slabs in bytes.
+  /// @param max_packed_size is the size above which samples are not packed.
+  ///        Must not exceed @a slab_size.
+  SampleSlabAllocator(SampleBufferPool* fallback_pool,
+                      size_t slab_size,
+                      size_t max_packed_size);
+  ~SampleSlabAllocator();
+
+  /// Create a MediaSample with a copy of @a data. The copy is packed in the
+  /// current slab if @a size does not exceed the packing limit, and is
+  /// allocated from the fallback pool otherwise.
+  /// @param data points to the buffer containing the sample data.
+  ///        Must not be NULL.
+  /// @param size indicates sample size in bytes.
+  /// @param is_key_frame indicates whether the sample is a key frame.
+  scoped_refptr<MediaSample> CopyFrom(const uint8_t* data,
+                                      size_t size,
+                                      bool is_key_frame);
+
+ private:
+  scoped_refptr<SampleBufferPool> fallback_pool_;
+  const size_t slab_size_;
+  const size_t max_packed_size_;
+
+  // Slab being filled and the offset of its first unused byte.
+  scoped_refptr<SharedBuffer> slab_;
+  size_t slab_offset_;
+
+  DISALLOW_COPY_AND_ASSIGN(SampleSlabAllocator);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // PACKAGER_MEDIA_BASE_SAMPLE_SLAB_ALLOCATOR_H_
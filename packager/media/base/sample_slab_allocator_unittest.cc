@@ -0,0 +1,91 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+#include "packager/media/base/media_sample.h"
+#include "packager/media/base/sample_buffer_pool.h"
+#include "packager/media/base/sample_slab_allocator.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+const uint8_t kData[] = {0x01, 0x02, 0x03, 0x04, 0x05};
+const uint8_t kOtherData[] = {0x0a, 0x0b, 0x0c};
+const bool kKeyFrame = true;
+const size_t kSlabSize = 8;
+const size_t kMaxPackedSize = 6;
+}  // namespace
+
+class SampleSlabAllocatorTest : public ::testing::Test {
+ public:
+  SampleSlabAllocatorTest()
+      : pool_(new SampleBufferPool),
+        allocator_(pool_.get(), kSlabSize, kMaxPackedSize) {}
+
+ protected:
+  scoped_refptr<SampleBufferPool> pool_;
+  SampleSlabAllocator allocator_;
+};
+
+TEST_F(SampleSlabAllocatorTest, PacksSamplesContiguously) {
+  scoped_refptr<MediaSample> sample1 =
+      allocator_.CopyFrom(kData, sizeof(kData), kKeyFrame);
+  scoped_refptr<MediaSample> sample2 =
+      allocator_.CopyFrom(kOtherData, 2, !kKeyFrame);
+
+  ASSERT_TRUE(sample1->is_shared());
+  ASSERT_TRUE(sample2->is_shared());
+  EXPECT_EQ(sample1->data() + sizeof(kData), sample2->data());
+  EXPECT_EQ(std::vector<uint8_t>(kData, kData + sizeof(kData)),
+            std::vector<uint8_t>(sample1->data(),
+                                 sample1->data() + sample1->data_size()));
+  EXPECT_EQ(std::vector<uint8_t>(kOtherData, kOtherData + 2),
+            std::vector<uint8_t>(sample2->data(),
+                                 sample2->data() + sample2->data_size()));
+  EXPECT_TRUE(sample1->is_key_frame());
+  EXPECT_FALSE(sample2->is_key_frame());
+}
+
+TEST_F(SampleSlabAllocatorTest, StartsNewSlabWhenFull) {
+  scoped_refptr<MediaSample> sample1 =
+      allocator_.CopyFrom(kData, sizeof(kData), kKeyFrame);
+  // Does not fit in the remaining 3 bytes of the first slab.
+  scoped_refptr<MediaSample> sample2 =
+      allocator_.CopyFrom(kData, sizeof(kData), kKeyFrame);
+
+  ASSERT_TRUE(sample2->is_shared());
+  EXPECT_NE(sample1->data() + sizeof(kData), sample2->data());
+  EXPECT_EQ(0, memcmp(kData, sample1->data(), sizeof(kData)));
+  EXPECT_EQ(0, memcmp(kData, sample2->data(), sizeof(kData)));
+}
+
+TEST_F(SampleSlabAllocatorTest, LargeSamplesAreNotPacked) {
+  const uint8_t kLargeData[kMaxPackedSize + 1] = {0x01};
+  scoped_refptr<MediaSample> sample =
+      allocator_.CopyFrom(kLargeData, sizeof(kLargeData), kKeyFrame);
+
+  EXPECT_FALSE(sample->is_shared());
+  EXPECT_EQ(sizeof(kLargeData), sample->data_size());
+  EXPECT_EQ(1u, pool_->GetStats().misses);
+}
+
+TEST_F(SampleSlabAllocatorTest, WritableDataDoesNotAffectOtherSamples) {
+  scoped_refptr<MediaSample> sample1 =
+      allocator_.CopyFrom(kData, sizeof(kData), kKeyFrame);
+  scoped_refptr<MediaSample> sample2 =
+      allocator_.CopyFrom(kOtherData, 2, kKeyFrame);
+
+  sample1->writable_data()[sizeof(kData) - 1] = 0xff;
+  EXPECT_FALSE(sample1->is_shared());
+  EXPECT_EQ(0, memcmp(kOtherData, sample2->data(), 2));
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,190 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/sample_spill_queue.h"
+
+#include <vector>
+
+#include "packager/base/files/file_path.h"
+#include "packager/base/files/file_util.h"
+#include "packager/base/logging.h"
+#include "packager/media/base/media_sample.h"
+#include "packager/media/file/file.h"
+
+namespace edash_packager {
+namespace media {
+
+SampleSpillQueue::SampleSpillQueue(MemoryCategory category)
+    : memory_(category),
+      memory_budget_(0),
+      read_position_(0),
+      write_position_(0),
+      file_position_(0),
+      spilled_bytes_(0) {}
+
+SampleSpillQueue::~SampleSpillQueue() {
+  if (!spill_file_)
+    return;
+  spill_file_.reset();
+  if (!File::Delete(spill_file_name_.c_str()))
+    LOG(WARNING) << "Unable to delete spill file " << spill_file_name_;
+}
+
+void SampleSpillQueue::SetSpillOptions(uint64_t memory_budget,
+                                       const std::string& temp_dir) {
+  memory_budget_ = memory_budget;
+  temp_dir_ = temp_dir;
+}
+
+Status SampleSpillQueue::Push(const scoped_refptr<MediaSample>& sample) {
+  Entry entry;
+  entry.sample = sample;
+  entry.data_size = sample->end_of_stream() ? 0 : sample->data_size();
+  entry.side_data_size = sample->side_data_size();
+  entry.spilled = false;
+  const uint64_t payload_size = entry.data_size + entry.side_data_size;
+
+  // The front sample stays in memory. Shared data is held by its buffer
+  // anyway, and an empty sample has nothing to spill.
+  if (memory_budget_ > 0 && !entries_.empty() &&
+      memory_.bytes() + payload_size > memory_budget_ &&
+      entry.data_size > 0 && !sample->is_shared()) {
+    Status status = Spill(&entry);
+    if (!status.ok())
+      return status;
+  } else {
+    memory_.Add(payload_size);
+  }
+  entries_.push_back(entry);
+  return Status::OK;
+}
+
+Status SampleSpillQueue::Pop(scoped_refptr<MediaSample>* sample) {
+  DCHECK(!entries_.empty());
+  const Entry& entry = entries_.front();
+  DCHECK(!entry.spilled);
+  if (sample)
+    *sample = entry.sample;
+  memory_.Subtract(entry.data_size + entry.side_data_size);
+  entries_.pop_front();
+
+  if (!entries_.empty() && entries_.front().spilled)
+    return Restore(&entries_.front());
+  return Status::OK;
+}
+
+void SampleSpillQueue::Clear() {
+  entries_.clear();
+  memory_.Set(0);
+  read_position_ = 0;
+  write_position_ = 0;
+  spilled_bytes_ = 0;
+}
+
+Status SampleSpillQueue::Spill(Entry* entry) {
+  if (!spill_file_) {
+    Status status = OpenSpillFile();
+    if (!status.ok())
+      return status;
+  }
+  if (!SeekSpillFile(write_position_)) {
+    return Status(error::FILE_FAILURE,
+                  "Cannot seek in spill file " + spill_file_name_);
+  }
+
+  MediaSample* sample = entry->sample.get();
+  File::WriteBlock blocks[2];
+  blocks[0].data = sample->data();
+  blocks[0].length = entry->data_size;
+  blocks[1].data = sample->side_data();
+  blocks[1].length = entry->side_data_size;
+  const int64_t payload_size = entry->data_size + entry->side_data_size;
+  if (spill_file_->WriteV(blocks, entry->side_data_size > 0 ? 2 : 1) !=
+      payload_size) {
+    return Status(error::FILE_FAILURE,
+                  "Cannot write to spill file " + spill_file_name_);
+  }
+  write_position_ += payload_size;
+  file_position_ = write_position_;
+  spilled_bytes_ += payload_size;
+
+  sample->ReleasePayload();
+  entry->spilled = true;
+  return Status::OK;
+}
+
+Status SampleSpillQueue::Restore(Entry* entry) {
+  DCHECK(spill_file_);
+  if (!SeekSpillFile(read_position_)) {
+    return Status(error::FILE_FAILURE,
+                  "Cannot seek in spill file " + spill_file_name_);
+  }
+
+  MediaSample* sample = entry->sample.get();
+  sample->resize_data(entry->data_size);
+  std::vector<uint8_t> side_data(entry->side_data_size);
+  if (spill_file_->Read(sample->writable_data(), entry->data_size) !=
+          static_cast<int64_t>(entry->data_size) ||
+      (!side_data.empty() &&
+       spill_file_->Read(side_data.data(), side_data.size()) !=
+           static_cast<int64_t>(side_data.size()))) {
+    return Status(error::FILE_FAILURE,
+                  "Cannot read from spill file " + spill_file_name_);
+  }
+  if (!side_data.empty())
+    sample->set_side_data(side_data.data(), side_data.size());
+
+  const uint64_t payload_size = entry->data_size + entry->side_data_size;
+  read_position_ += payload_size;
+  file_position_ = read_position_;
+  spilled_bytes_ -= payload_size;
+  // Start over at the beginning of the file once everything is read back.
+  if (spilled_bytes_ == 0) {
+    read_position_ = 0;
+    write_position_ = 0;
+  }
+
+  entry->spilled = false;
+  memory_.Add(payload_size);
+  return Status::OK;
+}
+
+Status SampleSpillQueue::OpenSpillFile() {
+  base::FilePath temp_file_path;
+  const bool created =
+      temp_dir_.empty()
+          ? base::CreateTemporaryFile(&temp_file_path)
+          : base::CreateTemporaryFileInDir(base::FilePath(temp_dir_),
+                                           &temp_file_path);
+  if (!created) {
+    LOG(ERROR) << "Failed to create temporary file in '" << temp_dir_ << "'.";
+    return Status(error::FILE_FAILURE, "Unable to create temporary file.");
+  }
+  spill_file_name_ = temp_file_path.value();
+  // Read and written in place. File::Open() does not cache "w+" files.
+  spill_file_.reset(File::Open(spill_file_name_.c_str(), "w+"));
+  if (!spill_file_) {
+    return Status(error::FILE_FAILURE,
+                  "Cannot open spill file " + spill_file_name_);
+  }
+  file_position_ = 0;
+  VLOG(1) << "Spilling queued samples to " << spill_file_name_;
+  return Status::OK;
+}
+
+// The read position is always behind the write position, so switching
+// between reads and writes always seeks, as stdio requires.
+bool SampleSpillQueue::SeekSpillFile(uint64_t position) {
+  if (position == file_position_)
+    return true;
+  if (!spill_file_->Seek(position))
+    return false;
+  file_position_ = position;
+  return true;
+}
+
+}  // namespace media
+}  // namespace edash_packager
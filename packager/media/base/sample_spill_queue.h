@@ -0,0 +1,114 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_BASE_SAMPLE_SPILL_QUEUE_H_
+#define MEDIA_BASE_SAMPLE_SPILL_QUEUE_H_
+
+#include <deque>
+#include <string>
+
+#include "packager/base/memory/ref_counted.h"
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/media/base/memory_tracker.h"
+#include "packager/media/base/status.h"
+#include "packager/media/file/file_closer.h"
+
+namespace edash_packager {
+namespace media {
+
+class File;
+class MediaSample;
+
+/// A FIFO queue of samples which holds the payloads of the samples in memory
+/// up to a budget. Past the budget, the payloads of the samples pushed are
+/// spilled to a temporary file and read back, sequentially, when the samples
+/// reach the front of the queue. The other fields of the samples, e.g. the
+/// timestamps, stay in memory. This lets badly interleaved inputs, e.g. with
+/// all the audio after all the video, be packaged in bounded memory.
+/// Not thread safe.
+class SampleSpillQueue {
+ public:
+  /// @param category is the category the payloads held in memory are
+  ///        accounted in.
+  explicit SampleSpillQueue(MemoryCategory category);
+  /// Deletes the spill file, if any.
+  ~SampleSpillQueue();
+
+  /// Spill the payloads past @a memory_budget bytes. Should be called before
+  /// the first Push().
+  /// @param memory_budget is the number of payload bytes held in memory, 0
+  ///        to never spill, which is the default.
+  /// @param temp_dir is the directory of the spill file, or empty for the
+  ///        temporary directory of the system.
+  void SetSpillOptions(uint64_t memory_budget, const std::string& temp_dir);
+
+  /// Add a sample at the end of the queue. The queue takes over the payload
+  /// of @a sample, which must not be accessed until the sample is popped.
+  /// @return OK on success, an error if the payload cannot be spilled.
+  Status Push(const scoped_refptr<MediaSample>& sample);
+
+  /// Remove the sample at the front of the queue, and read the payload of
+  /// the next sample back if it was spilled.
+  /// @param[out] sample receives the sample. Can be NULL.
+  /// @return OK on success, an error if the next payload cannot be read.
+  Status Pop(scoped_refptr<MediaSample>* sample);
+
+  /// Remove all the samples.
+  void Clear();
+
+  /// @return the sample at the front of the queue, whose payload is always
+  ///         in memory. The queue must not be empty.
+  const scoped_refptr<MediaSample>& front() const {
+    return entries_.front().sample;
+  }
+
+  bool empty() const { return entries_.empty(); }
+  size_t size() const { return entries_.size(); }
+
+  /// @return the number of payload bytes held in memory.
+  uint64_t memory_bytes() const { return memory_.bytes(); }
+  /// @return the number of payload bytes spilled and not read back yet.
+  uint64_t spilled_bytes() const { return spilled_bytes_; }
+
+ private:
+  struct Entry {
+    scoped_refptr<MediaSample> sample;
+    // Payload size when the sample was pushed.
+    size_t data_size;
+    size_t side_data_size;
+    bool spilled;
+  };
+
+  // Writes the payload of |entry| at the end of the spill file and releases
+  // it.
+  Status Spill(Entry* entry);
+  // Reads the payload of |entry| back from the spill file.
+  Status Restore(Entry* entry);
+  Status OpenSpillFile();
+  // Moves the spill file to |position| unless it is there already.
+  bool SeekSpillFile(uint64_t position);
+
+  std::deque<Entry> entries_;
+  TrackedMemory memory_;
+
+  uint64_t memory_budget_;
+  std::string temp_dir_;
+  scoped_ptr<File, FileCloser> spill_file_;
+  std::string spill_file_name_;
+  // The payloads are written and read back in queue order: the spilled
+  // payloads are between |read_position_| and |write_position_|.
+  uint64_t read_position_;
+  uint64_t write_position_;
+  uint64_t file_position_;
+  uint64_t spilled_bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(SampleSpillQueue);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_BASE_SAMPLE_SPILL_QUEUE_H_
@@ -0,0 +1,176 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "packager/base/files/file_path.h"
+#include "packager/base/files/file_util.h"
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/media/base/media_sample.h"
+#include "packager/media/base/sample_spill_queue.h"
+#include "packager/media/base/test/status_test_util.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+const size_t kDataSize = 1000;
+const size_t kSideDataSize = 10;
+const int kNumSamples = 20;
+// Holds a few samples in memory.
+const uint64_t kMemoryBudget = 3 * (kDataSize + kSideDataSize);
+
+// Creates a sample whose data, side data and timestamps derive from
+// |index|.
+scoped_refptr<MediaSample> CreateSample(int index) {
+  const std::vector<uint8_t> data(kDataSize, static_cast<uint8_t>(index));
+  const std::vector<uint8_t> side_data(kSideDataSize,
+                                       static_cast<uint8_t>(~index));
+  scoped_refptr<MediaSample> sample =
+      MediaSample::CopyFrom(data.data(), data.size(), side_data.data(),
+                            side_data.size(), index % 4 == 0);
+  sample->set_dts(index * 100);
+  sample->set_pts(index * 100 + 50);
+  sample->set_duration(100);
+  return sample;
+}
+
+void ExpectSample(int index, const scoped_refptr<MediaSample>& sample) {
+  ASSERT_TRUE(sample);
+  EXPECT_EQ(index * 100, sample->dts());
+  EXPECT_EQ(index * 100 + 50, sample->pts());
+  EXPECT_EQ(100, sample->duration());
+  EXPECT_EQ(index % 4 == 0, sample->is_key_frame());
+  EXPECT_EQ(std::vector<uint8_t>(kDataSize, static_cast<uint8_t>(index)),
+            std::vector<uint8_t>(sample->data(),
+                                 sample->data() + sample->data_size()));
+  EXPECT_EQ(std::vector<uint8_t>(kSideDataSize, static_cast<uint8_t>(~index)),
+            std::vector<uint8_t>(sample->side_data(),
+                                 sample->side_data() +
+                                     sample->side_data_size()));
+}
+
+}  // namespace
+
+class SampleSpillQueueTest : public ::testing::Test {
+ public:
+  SampleSpillQueueTest() : queue_(new SampleSpillQueue(kStreamQueueMemory)) {}
+
+  void SetUp() override {
+    ASSERT_TRUE(base::CreateNewTempDirectory("sample_spill_", &temp_dir_));
+  }
+
+  void TearDown() override {
+    queue_.reset();
+    base::DeleteFile(temp_dir_, true);
+  }
+
+ protected:
+  scoped_ptr<SampleSpillQueue> queue_;
+  base::FilePath temp_dir_;
+};
+
+TEST_F(SampleSpillQueueTest, NoSpillWithoutBudget) {
+  for (int i = 0; i < kNumSamples; ++i)
+    ASSERT_OK(queue_->Push(CreateSample(i)));
+  EXPECT_EQ(static_cast<size_t>(kNumSamples), queue_->size());
+  EXPECT_EQ(kNumSamples * (kDataSize + kSideDataSize), queue_->memory_bytes());
+  EXPECT_EQ(0u, queue_->spilled_bytes());
+  EXPECT_TRUE(base::IsDirectoryEmpty(temp_dir_));
+
+  for (int i = 0; i < kNumSamples; ++i) {
+    scoped_refptr<MediaSample> sample;
+    ASSERT_OK(queue_->Pop(&sample));
+    ExpectSample(i, sample);
+  }
+  EXPECT_TRUE(queue_->empty());
+  EXPECT_EQ(0u, queue_->memory_bytes());
+}
+
+TEST_F(SampleSpillQueueTest, SpillsPastBudget) {
+  queue_->SetSpillOptions(kMemoryBudget, temp_dir_.value());
+  for (int i = 0; i < kNumSamples; ++i)
+    ASSERT_OK(queue_->Push(CreateSample(i)));
+  EXPECT_EQ(kMemoryBudget, queue_->memory_bytes());
+  EXPECT_EQ((kNumSamples - 3) * (kDataSize + kSideDataSize),
+            queue_->spilled_bytes());
+  EXPECT_FALSE(base::IsDirectoryEmpty(temp_dir_));
+
+  for (int i = 0; i < kNumSamples; ++i) {
+    // The front sample is always in memory.
+    ExpectSample(i, queue_->front());
+    scoped_refptr<MediaSample> sample;
+    ASSERT_OK(queue_->Pop(&sample));
+    ExpectSample(i, sample);
+    EXPECT_LE(queue_->memory_bytes(), kMemoryBudget);
+  }
+  EXPECT_EQ(0u, queue_->memory_bytes());
+  EXPECT_EQ(0u, queue_->spilled_bytes());
+
+  // The spill file is deleted with the queue.
+  queue_.reset();
+  EXPECT_TRUE(base::IsDirectoryEmpty(temp_dir_));
+}
+
+TEST_F(SampleSpillQueueTest, InterleavedPushAndPop) {
+  queue_->SetSpillOptions(kMemoryBudget, temp_dir_.value());
+  int next_pushed = 0;
+  int next_popped = 0;
+  // Pushes two samples for each one popped, then drains the queue, twice,
+  // so that the spill file is written while it is read and then reused.
+  for (int round = 0; round < 2; ++round) {
+    for (int i = 0; i < kNumSamples; ++i) {
+      ASSERT_OK(queue_->Push(CreateSample(next_pushed++)));
+      ASSERT_OK(queue_->Push(CreateSample(next_pushed++)));
+      scoped_refptr<MediaSample> sample;
+      ASSERT_OK(queue_->Pop(&sample));
+      ExpectSample(next_popped++, sample);
+    }
+    EXPECT_GT(queue_->spilled_bytes(), 0u);
+    while (!queue_->empty()) {
+      scoped_refptr<MediaSample> sample;
+      ASSERT_OK(queue_->Pop(&sample));
+      ExpectSample(next_popped++, sample);
+    }
+    EXPECT_EQ(0u, queue_->spilled_bytes());
+  }
+  EXPECT_EQ(next_pushed, next_popped);
+}
+
+TEST_F(SampleSpillQueueTest, SharedSamplesStayInMemory) {
+  queue_->SetSpillOptions(kMemoryBudget, temp_dir_.value());
+  std::vector<scoped_refptr<MediaSample> > copies;
+  for (int i = 0; i < kNumSamples; ++i) {
+    scoped_refptr<MediaSample> sample = CreateSample(i);
+    // The data of both samples moves to a shared buffer.
+    copies.push_back(sample->ShallowCopy());
+    ASSERT_OK(queue_->Push(sample));
+  }
+  EXPECT_EQ(0u, queue_->spilled_bytes());
+  EXPECT_TRUE(base::IsDirectoryEmpty(temp_dir_));
+}
+
+TEST_F(SampleSpillQueueTest, Clear) {
+  queue_->SetSpillOptions(kMemoryBudget, temp_dir_.value());
+  for (int i = 0; i < kNumSamples; ++i)
+    ASSERT_OK(queue_->Push(CreateSample(i)));
+  queue_->Clear();
+  EXPECT_TRUE(queue_->empty());
+  EXPECT_EQ(0u, queue_->memory_bytes());
+  EXPECT_EQ(0u, queue_->spilled_bytes());
+
+  ASSERT_OK(queue_->Push(CreateSample(0)));
+  ASSERT_OK(queue_->Push(CreateSample(1)));
+  scoped_refptr<MediaSample> sample;
+  ASSERT_OK(queue_->Pop(&sample));
+  ExpectSample(0, sample);
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,134 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/segment_checksum.h"
+
+#include "packager/base/logging.h"
+#include "packager/base/strings/string_number_conversions.h"
+#include "packager/base/strings/string_util.h"
+#include "packager/base/strings/stringprintf.h"
+#include "packager/media/base/media_kernels.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+const char kMd5Name[] = "md5";
+const char kSha256Name[] = "sha256";
+const char kCrc32cName[] = "crc32c";
+
+std::string LowerHexEncode(const uint8_t* data, size_t size) {
+  return base::StringToLowerASCII(base::HexEncode(data, size));
+}
+
+}  // namespace
+
+SegmentChecksum::SegmentChecksum(Algorithm algorithm)
+    : algorithm_(algorithm), crc32c_(0) {
+  Reset();
+}
+
+SegmentChecksum::~SegmentChecksum() {}
+
+bool SegmentChecksum::ParseAlgorithm(const std::string& name,
+                                     Algorithm* algorithm) {
+  DCHECK(algorithm);
+  if (name.empty()) {
+    *algorithm = kNone;
+  } else if (name == kMd5Name) {
+    *algorithm = kMd5;
+  } else if (name == kSha256Name) {
+    *algorithm = kSha256;
+  } else if (name == kCrc32cName) {
+    *algorithm = kCrc32c;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+std::string SegmentChecksum::AlgorithmName(Algorithm algorithm) {
+  switch (algorithm) {
+    case kNone:
+      return "";
+    case kMd5:
+      return kMd5Name;
+    case kSha256:
+      return kSha256Name;
+    case kCrc32c:
+      return kCrc32cName;
+  }
+  NOTREACHED();
+  return "";
+}
+
+void SegmentChecksum::Update(const void* data, size_t size) {
+  switch (algorithm_) {
+    case kNone:
+      break;
+    case kMd5:
+      MD5_Update(&md5_, data, size);
+      break;
+    case kSha256:
+      SHA256_Update(&sha256_, data, size);
+      break;
+    case kCrc32c:
+      crc32c_ =
+          Crc32c(crc32c_, reinterpret_cast<const uint8_t*>(data), size);
+      break;
+  }
+}
+
+std::string SegmentChecksum::Finish() {
+  std::string checksum;
+  switch (algorithm_) {
+    case kNone:
+      break;
+    case kMd5: {
+      uint8_t digest[MD5_DIGEST_LENGTH];
+      MD5_Final(digest, &md5_);
+      checksum = LowerHexEncode(digest, sizeof(digest));
+      break;
+    }
+    case kSha256: {
+      uint8_t digest[SHA256_DIGEST_LENGTH];
+      SHA256_Final(digest, &sha256_);
+      checksum = LowerHexEncode(digest, sizeof(digest));
+      break;
+    }
+    case kCrc32c:
+      checksum = base::StringPrintf("%08x", crc32c_);
+      break;
+  }
+  Reset();
+  return checksum;
+}
+
+uint32_t SegmentChecksum::Crc32c(uint32_t crc,
+                                 const uint8_t* data,
+                                 size_t size) {
+  return GetMediaKernels().crc32c(crc, data, size);
+}
+
+void SegmentChecksum::Reset() {
+  switch (algorithm_) {
+    case kNone:
+      break;
+    case kMd5:
+      MD5_Init(&md5_);
+      break;
+    case kSha256:
+      SHA256_Init(&sha256_);
+      break;
+    case kCrc32c:
+      crc32c_ = 0;
+      break;
+  }
+}
+
+}  // namespace media
+}  // namespace edash_packager
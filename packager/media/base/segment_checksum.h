@@ -0,0 +1,74 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_BASE_SEGMENT_CHECKSUM_H_
+#define MEDIA_BASE_SEGMENT_CHECKSUM_H_
+
+#include <openssl/md5.h>
+#include <openssl/sha.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "packager/base/macros.h"
+
+namespace edash_packager {
+namespace media {
+
+/// Streaming checksum of the data of a segment, updated as the segment is
+/// written so that the segment does not need to be read back.
+class SegmentChecksum {
+ public:
+  enum Algorithm {
+    kNone = 0,
+    kMd5,
+    kSha256,
+    kCrc32c,
+  };
+
+  explicit SegmentChecksum(Algorithm algorithm);
+  ~SegmentChecksum();
+
+  /// Parse the name of a checksum algorithm: "md5", "sha256" or "crc32c".
+  /// An empty name is kNone.
+  /// @return true on success, false if @a name is not supported.
+  static bool ParseAlgorithm(const std::string& name, Algorithm* algorithm);
+
+  /// @return The name of @a algorithm, which is also the extension of its
+  ///         sidecar files. Empty for kNone.
+  static std::string AlgorithmName(Algorithm algorithm);
+
+  /// Add data to the checksum.
+  void Update(const void* data, size_t size);
+
+  /// @return The checksum of the data added since the construction or the
+  ///         previous call, as a lowercase hex string. The CRC32C is
+  ///         formatted as a big endian 32-bit value. Empty for kNone.
+  std::string Finish();
+
+  /// Update the CRC32C (Castagnoli) @a crc with @a size bytes of @a data.
+  /// Uses the SSE4.2 CRC32 instruction if the CPU supports it.
+  /// @param crc is the CRC of the previous data, 0 to start.
+  static uint32_t Crc32c(uint32_t crc, const uint8_t* data, size_t size);
+
+  Algorithm algorithm() const { return algorithm_; }
+
+ private:
+  void Reset();
+
+  const Algorithm algorithm_;
+  MD5_CTX md5_;
+  SHA256_CTX sha256_;
+  uint32_t crc32c_;
+
+  DISALLOW_COPY_AND_ASSIGN(SegmentChecksum);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_BASE_SEGMENT_CHECKSUM_H_
@@ -0,0 +1,76 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+#include <string.h>
+
+#include "packager/media/base/segment_checksum.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+const char kData[] = "123456789";
+}  // namespace
+
+TEST(SegmentChecksumTest, ParseAlgorithm) {
+  SegmentChecksum::Algorithm algorithm;
+  ASSERT_TRUE(SegmentChecksum::ParseAlgorithm("", &algorithm));
+  EXPECT_EQ(SegmentChecksum::kNone, algorithm);
+  ASSERT_TRUE(SegmentChecksum::ParseAlgorithm("md5", &algorithm));
+  EXPECT_EQ(SegmentChecksum::kMd5, algorithm);
+  ASSERT_TRUE(SegmentChecksum::ParseAlgorithm("sha256", &algorithm));
+  EXPECT_EQ(SegmentChecksum::kSha256, algorithm);
+  ASSERT_TRUE(SegmentChecksum::ParseAlgorithm("crc32c", &algorithm));
+  EXPECT_EQ(SegmentChecksum::kCrc32c, algorithm);
+  EXPECT_FALSE(SegmentChecksum::ParseAlgorithm("crc32", &algorithm));
+
+  EXPECT_EQ("sha256", SegmentChecksum::AlgorithmName(SegmentChecksum::kSha256));
+}
+
+TEST(SegmentChecksumTest, Md5) {
+  SegmentChecksum checksum(SegmentChecksum::kMd5);
+  checksum.Update(kData, strlen(kData));
+  EXPECT_EQ("25f9e794323b453885f5181f1b624d0b", checksum.Finish());
+}
+
+TEST(SegmentChecksumTest, Sha256) {
+  SegmentChecksum checksum(SegmentChecksum::kSha256);
+  checksum.Update(kData, strlen(kData));
+  EXPECT_EQ("15e2b0d3c33891ebb0f1ef609ec419420c20e320ce94c65fbc8c3312448eb225",
+            checksum.Finish());
+}
+
+TEST(SegmentChecksumTest, Crc32c) {
+  SegmentChecksum checksum(SegmentChecksum::kCrc32c);
+  checksum.Update(kData, strlen(kData));
+  EXPECT_EQ("e3069283", checksum.Finish());
+}
+
+TEST(SegmentChecksumTest, Crc32cOfUnalignedBlocks) {
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(kData);
+  uint32_t crc = SegmentChecksum::Crc32c(0, data, 3);
+  crc = SegmentChecksum::Crc32c(crc, data + 3, 6);
+  EXPECT_EQ(0xe3069283, crc);
+}
+
+TEST(SegmentChecksumTest, FinishStartsNewChecksum) {
+  SegmentChecksum checksum(SegmentChecksum::kMd5);
+  checksum.Update(kData, 4);
+  checksum.Update(kData + 4, strlen(kData) - 4);
+  EXPECT_EQ("25f9e794323b453885f5181f1b624d0b", checksum.Finish());
+  // The checksum of no data.
+  EXPECT_EQ("d41d8cd98f00b204e9800998ecf8427e", checksum.Finish());
+}
+
+TEST(SegmentChecksumTest, None) {
+  SegmentChecksum checksum(SegmentChecksum::kNone);
+  checksum.Update(kData, strlen(kData));
+  EXPECT_EQ("", checksum.Finish());
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,58 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/shared_buffer.h"
+
+#include "packager/base/files/file_path.h"
+#include "packager/base/files/memory_mapped_file.h"
+#include "packager/base/logging.h"
+
+#if defined(OS_POSIX)
+#include <sys/mman.h>
+#endif
+
+namespace edash_packager {
+namespace media {
+
+SharedBuffer::SharedBuffer(size_t size)
+    : owned_data_(new uint8_t[size]),
+      data_(owned_data_.get()),
+      size_(size),
+      memory_(kSampleMemory) {
+  memory_.Set(size);
+}
+
+SharedBuffer::SharedBuffer(scoped_ptr<base::MemoryMappedFile> mapped_file)
+    : mapped_file_(mapped_file.Pass()),
+      // The mapping is read-only; the buffer is never written by its owner.
+      data_(const_cast<uint8_t*>(mapped_file_->data())),
+      size_(mapped_file_->length()),
+      // Mapped files are backed by the page cache and not accounted.
+      memory_(kSampleMemory) {}
+
+SharedBuffer::~SharedBuffer() {}
+
+// static
+scoped_refptr<SharedBuffer> SharedBuffer::MapFile(const std::string& file_path,
+                                                  bool sequential_access) {
+  scoped_ptr<base::MemoryMappedFile> mapped_file(new base::MemoryMappedFile);
+  if (!mapped_file->Initialize(base::FilePath(file_path)) ||
+      mapped_file->length() == 0) {
+    LOG(WARNING) << "Cannot map file '" << file_path << "' in memory.";
+    return NULL;
+  }
+#if defined(OS_POSIX)
+  if (sequential_access &&
+      madvise(const_cast<uint8_t*>(mapped_file->data()), mapped_file->length(),
+              MADV_SEQUENTIAL) != 0) {
+    PLOG(WARNING) << "madvise failed for '" << file_path << "'";
+  }
+#endif
+  return make_scoped_refptr(new SharedBuffer(mapped_file.Pass()));
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,78 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef PACKAGER_MEDIA_BASE_SHARED_BUFFER_H_
+#define PACKAGER_MEDIA_BASE_SHARED_BUFFER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "packager/base/macros.h"
+#include "packager/base/memory/ref_counted.h"
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/media/base/memory_tracker.h"
+
+namespace base {
+class MemoryMappedFile;
+}  // namespace base
+
+namespace edash_packager {
+namespace media {
+
+/// A fixed-size, ref-counted block of memory. Used to share demuxed data
+/// between a parser's input queue and the MediaSamples referencing slices of
+/// it, so that sample payloads do not need to be copied out.
+///
+/// The owner (e.g. ByteQueue) may only modify ranges that have not been
+/// handed out, or the whole buffer once it holds the only reference.
+class SharedBuffer : public base::RefCountedThreadSafe<SharedBuffer> {
+ public:
+  /// @param size is the size of the buffer in bytes. The content is
+  ///        uninitialized.
+  explicit SharedBuffer(size_t size);
+
+  /// Map a local file in memory. The content of the returned buffer is
+  /// read-only.
+  /// @param file_path is the path of the file to map.
+  /// @param sequential_access hints that the file is going to be accessed
+  ///        sequentially, so the pages can be read ahead aggressively and
+  ///        dropped soon after being accessed.
+  /// @return The buffer on success, NULL otherwise, e.g. if the file is empty.
+  static scoped_refptr<SharedBuffer> MapFile(const std::string& file_path,
+                                             bool sequential_access);
+
+  uint8_t* data() { return data_; }
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+
+  /// @return true if the range [@a data, @a data + @a size) lies within the
+  ///         buffer.
+  bool Contains(const uint8_t* data, size_t size) const {
+    return data >= data_ && size <= size_ &&
+           data - data_ <= static_cast<ptrdiff_t>(size_ - size);
+  }
+
+ private:
+  friend class base::RefCountedThreadSafe<SharedBuffer>;
+  explicit SharedBuffer(scoped_ptr<base::MemoryMappedFile> mapped_file);
+  ~SharedBuffer();
+
+  // Exactly one of |owned_data_| and |mapped_file_| holds the memory.
+  scoped_ptr<uint8_t[]> owned_data_;
+  scoped_ptr<base::MemoryMappedFile> mapped_file_;
+  uint8_t* const data_;
+  const size_t size_;
+  TrackedMemory memory_;
+
+  DISALLOW_COPY_AND_ASSIGN(SharedBuffer);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // PACKAGER_MEDIA_BASE_SHARED_BUFFER_H_
@@ -0,0 +1,102 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/shared_demuxer.h"
+
+#include <inttypes.h>
+
+#include "packager/base/files/file_path.h"
+#include "packager/base/files/file_util.h"
+#include "packager/base/logging.h"
+#include "packager/base/strings/stringprintf.h"
+#include "packager/media/base/demuxer.h"
+#include "packager/media/base/demuxer_pool.h"
+#include "packager/media/file/file.h"
+
+namespace edash_packager {
+namespace media {
+
+SharedDemuxer::SharedDemuxer(scoped_ptr<Demuxer> demuxer,
+                             DemuxerPool* demuxer_pool)
+    : demuxer_(demuxer.Pass()), demuxer_pool_(demuxer_pool), registry_(NULL) {
+  DCHECK(demuxer_);
+  DCHECK(demuxer_pool_);
+}
+
+SharedDemuxer::~SharedDemuxer() {
+  DCHECK(!registry_);
+  demuxer_pool_->Release(demuxer_.Pass());
+}
+
+void SharedDemuxer::Share(SharedDemuxerRegistry* registry,
+                          const std::string& key) {
+  DCHECK(registry);
+  DCHECK(!registry_);
+  registry_ = registry;
+  key_ = key;
+  registry_->Register(key_, this);
+}
+
+void SharedDemuxer::StopSharing() {
+  if (!registry_)
+    return;
+  registry_->Unregister(key_, this);
+  registry_ = NULL;
+}
+
+SharedDemuxerRegistry::SharedDemuxerRegistry() {}
+
+SharedDemuxerRegistry::~SharedDemuxerRegistry() {
+  DCHECK(shared_demuxers_.empty());
+}
+
+// static
+std::string SharedDemuxerRegistry::GetInputKey(const std::string& file_name) {
+  std::string path;
+  base::File::Info info;
+  // Inputs split in chunks have no single file to take the info of.
+  if (file_name.find(kInputChunkSeparator) != std::string::npos ||
+      !File::GetLocalFilePath(file_name, &path) ||
+      !base::GetFileInfo(base::FilePath(path), &info)) {
+    return file_name;
+  }
+  return base::StringPrintf("%s|%" PRId64 "|%" PRId64, file_name.c_str(),
+                            info.size, info.last_modified.ToInternalValue());
+}
+
+scoped_refptr<SharedDemuxer> SharedDemuxerRegistry::Find(
+    const std::string& key) {
+  base::AutoLock l(lock_);
+  std::map<std::string, SharedDemuxer*>::const_iterator it =
+      shared_demuxers_.find(key);
+  // The job sharing the demuxer holds it until it is unregistered.
+  return it != shared_demuxers_.end() ? make_scoped_refptr(it->second)
+                                      : scoped_refptr<SharedDemuxer>();
+}
+
+size_t SharedDemuxerRegistry::num_shared_inputs() const {
+  base::AutoLock l(lock_);
+  return shared_demuxers_.size();
+}
+
+void SharedDemuxerRegistry::Register(const std::string& key,
+                                     SharedDemuxer* shared_demuxer) {
+  base::AutoLock l(lock_);
+  shared_demuxers_[key] = shared_demuxer;
+}
+
+void SharedDemuxerRegistry::Unregister(const std::string& key,
+                                       SharedDemuxer* shared_demuxer) {
+  base::AutoLock l(lock_);
+  std::map<std::string, SharedDemuxer*>::iterator it =
+      shared_demuxers_.find(key);
+  // The input may be demuxed by a later job already.
+  if (it != shared_demuxers_.end() && it->second == shared_demuxer)
+    shared_demuxers_.erase(it);
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,98 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_BASE_SHARED_DEMUXER_H_
+#define MEDIA_BASE_SHARED_DEMUXER_H_
+
+#include <map>
+#include <string>
+
+#include "packager/base/memory/ref_counted.h"
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/synchronization/lock.h"
+
+namespace edash_packager {
+namespace media {
+
+class Demuxer;
+class DemuxerPool;
+class SharedDemuxerRegistry;
+
+/// A Demuxer shared by the jobs packaging the same input concurrently, e.g.
+/// a DASH and an HLS job of a source: the job which created it runs it, and
+/// the streams of the other jobs join it as late streams (see
+/// Demuxer::EnableLateStreams()). The Demuxer is released to its pool once
+/// the last job holding it drops it.
+class SharedDemuxer : public base::RefCountedThreadSafe<SharedDemuxer> {
+ public:
+  /// @param demuxer is the Demuxer shared.
+  /// @param demuxer_pool is where @a demuxer is released. Not owned.
+  SharedDemuxer(scoped_ptr<Demuxer> demuxer, DemuxerPool* demuxer_pool);
+
+  /// Let the jobs find the Demuxer in @a registry as the Demuxer of the
+  /// input @a key, until StopSharing() is called.
+  /// @param registry is not owned and must outlive the sharing.
+  void Share(SharedDemuxerRegistry* registry, const std::string& key);
+
+  /// Stop sharing the Demuxer, if shared. Should be called by the job running
+  /// the Demuxer once it ends, before dropping it.
+  void StopSharing();
+
+  Demuxer* demuxer() { return demuxer_.get(); }
+
+ private:
+  friend class base::RefCountedThreadSafe<SharedDemuxer>;
+  ~SharedDemuxer();
+
+  scoped_ptr<Demuxer> demuxer_;
+  DemuxerPool* const demuxer_pool_;
+  // Set while the Demuxer is shared.
+  SharedDemuxerRegistry* registry_;
+  std::string key_;
+
+  DISALLOW_COPY_AND_ASSIGN(SharedDemuxer);
+};
+
+/// Finds the SharedDemuxer of an input demuxed by another job.
+///
+/// Thread Safety: Thread safe.
+class SharedDemuxerRegistry {
+ public:
+  SharedDemuxerRegistry();
+  ~SharedDemuxerRegistry();
+
+  /// @param file_name specifies an input, see Demuxer::Demuxer().
+  /// @return the key identifying the content of @a file_name: its name,
+  ///         with the size and the modification time of a local file, so
+  ///         that a file replaced in between is demuxed again.
+  static std::string GetInputKey(const std::string& file_name);
+
+  /// @return the SharedDemuxer of the input @a key, or NULL if the input is
+  ///         not demuxed by another job. If several jobs demux the input,
+  ///         the latest one is returned, which is the most likely to accept
+  ///         late streams.
+  scoped_refptr<SharedDemuxer> Find(const std::string& key);
+
+  /// @return the number of inputs with a SharedDemuxer.
+  size_t num_shared_inputs() const;
+
+ private:
+  friend class SharedDemuxer;
+
+  void Register(const std::string& key, SharedDemuxer* shared_demuxer);
+  void Unregister(const std::string& key, SharedDemuxer* shared_demuxer);
+
+  mutable base::Lock lock_;
+  // The demuxers shared, which are unregistered before they are deleted.
+  std::map<std::string, SharedDemuxer*> shared_demuxers_;
+
+  DISALLOW_COPY_AND_ASSIGN(SharedDemuxerRegistry);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_BASE_SHARED_DEMUXER_H_
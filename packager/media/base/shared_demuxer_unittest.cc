@@ -0,0 +1,124 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+
+#include <set>
+#include <vector>
+
+#include "packager/base/bind.h"
+#include "packager/base/files/file_path.h"
+#include "packager/base/files/file_util.h"
+#include "packager/media/base/demuxer.h"
+#include "packager/media/base/demuxer_pool.h"
+#include "packager/media/base/media_stream.h"
+#include "packager/media/base/shared_demuxer.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+const char kInput[] = "input.mp4";
+const size_t kMaxIdleDemuxers = 2;
+const uint64_t kMaxReplayBytes = 1000;
+const uint32_t kTrackId = 1;
+
+void SaveStatus(Status* status_out, Status status) {
+  *status_out = status;
+}
+}  // namespace
+
+class SharedDemuxerTest : public testing::Test {
+ public:
+  SharedDemuxerTest() : demuxer_pool_(kMaxIdleDemuxers) {}
+
+ protected:
+  scoped_refptr<SharedDemuxer> CreateSharedDemuxer() {
+    return make_scoped_refptr(new SharedDemuxer(
+        scoped_ptr<Demuxer>(new Demuxer(kInput)), &demuxer_pool_));
+  }
+
+  DemuxerPool demuxer_pool_;
+  SharedDemuxerRegistry registry_;
+};
+
+TEST_F(SharedDemuxerTest, FindsSharedDemuxerUntilStopSharing) {
+  scoped_refptr<SharedDemuxer> shared_demuxer = CreateSharedDemuxer();
+  EXPECT_FALSE(registry_.Find(kInput).get());
+
+  shared_demuxer->Share(&registry_, kInput);
+  EXPECT_EQ(shared_demuxer.get(), registry_.Find(kInput).get());
+  EXPECT_EQ(1u, registry_.num_shared_inputs());
+
+  shared_demuxer->StopSharing();
+  EXPECT_FALSE(registry_.Find(kInput).get());
+  EXPECT_EQ(0u, registry_.num_shared_inputs());
+}
+
+TEST_F(SharedDemuxerTest, FindsLatestSharedDemuxerOfInput) {
+  scoped_refptr<SharedDemuxer> shared_demuxer1 = CreateSharedDemuxer();
+  scoped_refptr<SharedDemuxer> shared_demuxer2 = CreateSharedDemuxer();
+  shared_demuxer1->Share(&registry_, kInput);
+  shared_demuxer2->Share(&registry_, kInput);
+  EXPECT_EQ(shared_demuxer2.get(), registry_.Find(kInput).get());
+
+  shared_demuxer1->StopSharing();
+  EXPECT_EQ(shared_demuxer2.get(), registry_.Find(kInput).get());
+  shared_demuxer2->StopSharing();
+  EXPECT_FALSE(registry_.Find(kInput).get());
+}
+
+TEST_F(SharedDemuxerTest, ReleasesDemuxerWithLastReference) {
+  scoped_refptr<SharedDemuxer> shared_demuxer = CreateSharedDemuxer();
+  scoped_refptr<SharedDemuxer> other_reference = shared_demuxer;
+  shared_demuxer = NULL;
+  EXPECT_EQ(0u, demuxer_pool_.num_idle_demuxers());
+  other_reference = NULL;
+  EXPECT_EQ(1u, demuxer_pool_.num_idle_demuxers());
+}
+
+TEST_F(SharedDemuxerTest, InputKeyChangesWithLocalFile) {
+  base::FilePath path;
+  ASSERT_TRUE(base::CreateTemporaryFile(&path));
+  const std::string file_name = path.value();
+  ASSERT_EQ(4, base::WriteFile(path, "data", 4));
+  const std::string key = SharedDemuxerRegistry::GetInputKey(file_name);
+  EXPECT_EQ(key, SharedDemuxerRegistry::GetInputKey(file_name));
+
+  ASSERT_TRUE(base::AppendToFile(path, "more", 4));
+  EXPECT_NE(key, SharedDemuxerRegistry::GetInputKey(file_name));
+  base::DeleteFile(path, false);
+
+  EXPECT_EQ("udp://239.0.0.1:1234",
+            SharedDemuxerRegistry::GetInputKey("udp://239.0.0.1:1234"));
+}
+
+TEST_F(SharedDemuxerTest, LateStreamsNotAcceptedByDefault) {
+  Demuxer demuxer(kInput);
+  std::set<uint32_t> track_ids;
+  track_ids.insert(kTrackId);
+  EXPECT_FALSE(demuxer.ReserveLateStreams(track_ids));
+}
+
+TEST_F(SharedDemuxerTest, LateStreamsEndWithClosingStatus) {
+  Demuxer demuxer(kInput);
+  demuxer.EnableLateStreams(kMaxReplayBytes);
+  std::set<uint32_t> track_ids;
+  track_ids.insert(kTrackId);
+  ASSERT_TRUE(demuxer.ReserveLateStreams(track_ids));
+
+  // Closing with an error does not wait for the reservation.
+  demuxer.CloseLateStreams(Status(error::CANCELLED, "Not run."));
+  EXPECT_FALSE(demuxer.ReserveLateStreams(track_ids));
+
+  Status status;
+  demuxer.StartLateStreams(std::vector<MediaStream*>(),
+                           base::Bind(&SaveStatus, &status));
+  EXPECT_EQ(error::CANCELLED, status.error_code());
+}
+
+}  // namespace media
+}  // namespace edash_packager
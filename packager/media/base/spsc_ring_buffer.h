@@ -0,0 +1,128 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef PACKAGER_MEDIA_BASE_SPSC_RING_BUFFER_H_
+#define PACKAGER_MEDIA_BASE_SPSC_RING_BUFFER_H_
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "packager/base/atomicops.h"
+#include "packager/base/logging.h"
+#include "packager/base/macros.h"
+
+namespace edash_packager {
+namespace media {
+
+/// A bounded, lock-free, single-producer / single-consumer ring buffer.
+/// TryPush must only be called from one (producer) thread and TryPop must
+/// only be called from one (consumer) thread. Neither call blocks; callers
+/// are responsible for waiting / backing off when the buffer is full or empty.
+template <class T>
+class SpscRingBuffer {
+ public:
+  /// @param capacity is the maximum number of elements the buffer can hold.
+  ///        It is rounded up to the next power of two.
+  explicit SpscRingBuffer(size_t capacity);
+  ~SpscRingBuffer();
+
+  /// Push an element to the back of the buffer. Producer thread only.
+  /// @return false if the buffer is full.
+  bool TryPush(const T& element);
+
+  /// Pop an element from the front of the buffer. Consumer thread only. The
+  /// slot is reset to T() so that any resources held are released
+  /// immediately.
+  /// @return false if the buffer is empty.
+  bool TryPop(T* element);
+
+  /// @return The number of elements in the buffer. Only a snapshot if called
+  ///         while the other side is active.
+  size_t Size() const {
+    return base::subtle::Acquire_Load(&tail_) -
+           base::subtle::Acquire_Load(&head_);
+  }
+
+  bool Empty() const { return Size() == 0; }
+  bool Full() const { return Size() == capacity(); }
+
+  size_t capacity() const { return slots_.size(); }
+
+ private:
+  // Rough size of a cache line. |head_| and |tail_| are placed on different
+  // cache lines to avoid false sharing between the two threads.
+  static const size_t kCacheLineSize = 64;
+
+  std::vector<T> slots_;
+  const size_t mask_;
+  // Position of the next element to pop. Written by the consumer only.
+  base::subtle::AtomicWord head_;
+  char head_padding_[kCacheLineSize - sizeof(base::subtle::AtomicWord)];
+  // Position of the next element to push. Written by the producer only.
+  base::subtle::AtomicWord tail_;
+  char tail_padding_[kCacheLineSize - sizeof(base::subtle::AtomicWord)];
+
+  DISALLOW_COPY_AND_ASSIGN(SpscRingBuffer);
+};
+
+namespace internal {
+
+inline size_t RoundUpToPowerOfTwo(size_t value) {
+  size_t result = 1;
+  while (result < value)
+    result <<= 1;
+  return result;
+}
+
+}  // namespace internal
+
+// Implementations of non-inline functions.
+template <class T>
+SpscRingBuffer<T>::SpscRingBuffer(size_t capacity)
+    : slots_(internal::RoundUpToPowerOfTwo(capacity)),
+      mask_(slots_.size() - 1),
+      head_(0),
+      tail_(0) {
+  DCHECK_GT(capacity, 0u);
+}
+
+template <class T>
+SpscRingBuffer<T>::~SpscRingBuffer() {}
+
+template <class T>
+bool SpscRingBuffer<T>::TryPush(const T& element) {
+  // Only the producer writes |tail_|, so it can be read without a barrier.
+  const base::subtle::AtomicWord tail = base::subtle::NoBarrier_Load(&tail_);
+  if (static_cast<size_t>(tail - base::subtle::Acquire_Load(&head_)) ==
+      slots_.size()) {
+    return false;
+  }
+  slots_[tail & mask_] = element;
+  // Publish the element to the consumer.
+  base::subtle::Release_Store(&tail_, tail + 1);
+  return true;
+}
+
+template <class T>
+bool SpscRingBuffer<T>::TryPop(T* element) {
+  DCHECK(element);
+  // Only the consumer writes |head_|, so it can be read without a barrier.
+  const base::subtle::AtomicWord head = base::subtle::NoBarrier_Load(&head_);
+  if (head == base::subtle::Acquire_Load(&tail_))
+    return false;
+  T& slot = slots_[head & mask_];
+  *element = slot;
+  slot = T();
+  // Hand the slot back to the producer.
+  base::subtle::Release_Store(&head_, head + 1);
+  return true;
+}
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // PACKAGER_MEDIA_BASE_SPSC_RING_BUFFER_H_
@@ -0,0 +1,113 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+
+#include "packager/base/bind.h"
+#include "packager/base/memory/ref_counted.h"
+#include "packager/base/threading/platform_thread.h"
+#include "packager/media/base/closure_thread.h"
+#include "packager/media/base/spsc_ring_buffer.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+const size_t kCapacity = 8;
+const int kNumElements = 100000;
+
+class RefCountedInt : public base::RefCountedThreadSafe<RefCountedInt> {
+ public:
+  explicit RefCountedInt(int value) : value_(value) {}
+  int value() const { return value_; }
+
+ private:
+  friend class base::RefCountedThreadSafe<RefCountedInt>;
+  ~RefCountedInt() {}
+
+  int value_;
+};
+
+void Produce(SpscRingBuffer<int>* buffer) {
+  for (int i = 0; i < kNumElements; ++i) {
+    while (!buffer->TryPush(i))
+      base::PlatformThread::YieldCurrentThread();
+  }
+}
+
+}  // namespace
+
+TEST(SpscRingBufferTest, CapacityRoundedUpToPowerOfTwo) {
+  SpscRingBuffer<int> buffer(5);
+  EXPECT_EQ(8u, buffer.capacity());
+  SpscRingBuffer<int> buffer2(16);
+  EXPECT_EQ(16u, buffer2.capacity());
+}
+
+TEST(SpscRingBufferTest, PushPop) {
+  SpscRingBuffer<int> buffer(kCapacity);
+  EXPECT_TRUE(buffer.Empty());
+
+  int value;
+  EXPECT_FALSE(buffer.TryPop(&value));
+
+  for (size_t i = 0; i < kCapacity; ++i)
+    EXPECT_TRUE(buffer.TryPush(i));
+  EXPECT_TRUE(buffer.Full());
+  EXPECT_FALSE(buffer.TryPush(100));
+  EXPECT_EQ(kCapacity, buffer.Size());
+
+  for (size_t i = 0; i < kCapacity; ++i) {
+    ASSERT_TRUE(buffer.TryPop(&value));
+    EXPECT_EQ(static_cast<int>(i), value);
+  }
+  EXPECT_TRUE(buffer.Empty());
+}
+
+TEST(SpscRingBufferTest, WrapAround) {
+  SpscRingBuffer<int> buffer(kCapacity);
+  int value;
+  for (int i = 0; i < 10 * static_cast<int>(kCapacity); ++i) {
+    EXPECT_TRUE(buffer.TryPush(i));
+    EXPECT_TRUE(buffer.TryPush(i + 1));
+    ASSERT_TRUE(buffer.TryPop(&value));
+    EXPECT_EQ(i, value);
+    ASSERT_TRUE(buffer.TryPop(&value));
+    EXPECT_EQ(i + 1, value);
+  }
+}
+
+TEST(SpscRingBufferTest, PopReleasesReference) {
+  SpscRingBuffer<scoped_refptr<RefCountedInt> > buffer(kCapacity);
+  scoped_refptr<RefCountedInt> element(new RefCountedInt(1));
+  EXPECT_TRUE(element->HasOneRef());
+  EXPECT_TRUE(buffer.TryPush(element));
+  EXPECT_FALSE(element->HasOneRef());
+
+  scoped_refptr<RefCountedInt> popped;
+  ASSERT_TRUE(buffer.TryPop(&popped));
+  popped = NULL;
+  EXPECT_TRUE(element->HasOneRef());
+}
+
+TEST(SpscRingBufferTest, ProducerConsumer) {
+  SpscRingBuffer<int> buffer(kCapacity);
+  ClosureThread producer("SpscProducer", base::Bind(&Produce, &buffer));
+  producer.Start();
+
+  int value;
+  for (int i = 0; i < kNumElements; ++i) {
+    while (!buffer.TryPop(&value))
+      base::PlatformThread::YieldCurrentThread();
+    ASSERT_EQ(i, value);
+  }
+  producer.Join();
+  EXPECT_TRUE(buffer.Empty());
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -7,6 +7,7 @@
 #include "packager/media/base/status.h"
 
 #include "packager/base/logging.h"
+#include "packager/base/strings/string_util.h"
 #include "packager/base/strings/stringprintf.h"
 
 namespace edash_packager {
@@ -57,14 +58,30 @@ std::string ErrorCodeToString(Code error_code) {
 const Status Status::OK = Status(error::OK, "");
 const Status Status::UNKNOWN = Status(error::UNKNOWN, "");
 
+const std::string& Status::error_message() const {
+  return error_ ? error_->message : base::EmptyString();
+}
+
 std::string Status::ToString() const {
-  if (error_code_ == error::OK)
+  if (ok())
     return "OK";
 
   return base::StringPrintf("%d (%s): %s",
-                            error_code_,
-                            error::ErrorCodeToString(error_code_).c_str(),
-                            error_message_.c_str());
+                            error_->code,
+                            error::ErrorCodeToString(error_->code).c_str(),
+                            error_->message.c_str());
+}
+
+void Status::Assign(const Status& other) {
+  if (this == &other)
+    return;
+  if (!other.error_) {
+    Clear();
+  } else if (error_) {
+    *error_ = *other.error_;
+  } else {
+    error_ = new Error(*other.error_);
+  }
 }
 
 std::ostream& operator<<(std::ostream& os, const Status& x) {
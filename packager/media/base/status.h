@@ -72,21 +72,33 @@ enum Code {
 
 }  // namespace error
 
+/// A Status is returned on every media sample, so the success path is kept
+/// cheap: an OK Status is a single NULL pointer, which is copied, assigned and
+/// destroyed without any allocation. The code and message of an error are
+/// allocated out of line, only when an error is set.
 class Status {
  public:
   /// Creates a "successful" status.
-  Status() : error_code_(error::OK) {}
+  Status() : error_(NULL) {}
 
   /// Create a status with the specified code, and error message.
   /// If "error_code == error::OK", error_message is ignored and a Status
   /// object identical to Status::OK is constructed.
   Status(error::Code error_code, const std::string& error_message)
-      : error_code_(error_code) {
-    if (!ok())
-      error_message_ = error_message;
-  }
+      : error_(error_code == error::OK
+                   ? NULL
+                   : new Error(error_code, error_message)) {}
+
+  Status(const Status& other)
+      : error_(other.error_ ? new Error(*other.error_) : NULL) {}
 
-  ~Status() {}
+  ~Status() { delete error_; }
+
+  Status& operator=(const Status& other) {
+    if (error_ || other.error_)
+      Assign(other);
+    return *this;
+  }
 
   /// @name Some pre-defined Status objects.
   /// @{
@@ -98,12 +110,7 @@ class Status {
   /// If "error_code == error::OK", error_message is ignored and a Status
   /// object identical to Status::OK is constructed.
   void SetError(error::Code error_code, const std::string& error_message) {
-    if (error_code == error::OK) {
-      Clear();
-    } else {
-      error_code_ = error_code;
-      error_message_ = error_message;
-    }
+    Status(error_code, error_message).Swap(this);
   }
 
   /// If "ok()", stores "new_status" into *this.  If "!ok()", preserves
@@ -121,40 +128,50 @@ class Status {
 
   /// Clear this status object to contain the OK code and no error message.
   void Clear() {
-    error_code_ = error::OK;
-    error_message_ = "";
+    delete error_;
+    error_ = NULL;
   }
 
-  bool ok() const { return error_code_ == error::OK; }
-  error::Code error_code() const { return error_code_; }
-  const std::string& error_message() const { return error_message_; }
+  bool ok() const { return !error_; }
+  error::Code error_code() const {
+    return error_ ? error_->code : error::OK;
+  }
+  const std::string& error_message() const;
 
   bool operator==(const Status& x) const {
-    return error_code_ == x.error_code() && error_message_ == x.error_message();
+    return error_code() == x.error_code() &&
+           (ok() || error_->message == x.error_->message);
   }
   bool operator!=(const Status& x) const { return !(*this == x); }
 
   /// @return true iff this has the same error_code as "x", i.e., the two
   ///         Status objects are identical except possibly for the error
   ///         message.
-  bool Matches(const Status& x) const { return error_code_ == x.error_code(); }
+  bool Matches(const Status& x) const { return error_code() == x.error_code(); }
 
   /// @return A combination of the error code name and message.
   std::string ToString() const;
 
   void Swap(Status* other) {
-    error::Code error_code = error_code_;
-    error_code_ = other->error_code_;
-    other->error_code_ = error_code;
-    error_message_.swap(other->error_message_);
+    Error* error = error_;
+    error_ = other->error_;
+    other->error_ = error;
   }
 
  private:
-  error::Code error_code_;
-  std::string error_message_;
+  struct Error {
+    Error(error::Code code, const std::string& message)
+        : code(code), message(message) {}
+
+    error::Code code;
+    std::string message;
+  };
+
+  // Copies |other|, when either status is an error.
+  void Assign(const Status& other);
 
-  // Not using DISALLOW_COPY_AND_ASSIGN here intentionally to allow the compiler
-  // generated copy constructor and assignment operator.
+  // NULL if the status is OK.
+  Error* error_;
 };
 
 std::ostream& operator<<(std::ostream& os, const Status& x);
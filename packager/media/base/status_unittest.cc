@@ -89,6 +89,19 @@ TEST(Status, AssignEmpty) {
   ASSERT_TRUE(a.ok());
 }
 
+TEST(Status, AssignError) {
+  Status a(error::CANCELLED, "message");
+  Status b(error::UNIMPLEMENTED, "other message");
+  a = b;
+  ASSERT_EQ(a, b);
+  a = a;
+  ASSERT_EQ(a, b);
+}
+
+TEST(Status, OkIsOneWord) {
+  ASSERT_EQ(sizeof(void*), sizeof(Status));
+}
+
 TEST(Status, Update) {
   Status s;
   s.Update(Status::OK);
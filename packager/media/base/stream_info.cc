@@ -29,7 +29,9 @@ StreamInfo::StreamInfo(StreamType stream_type,
       duration_(duration),
       codec_string_(codec_string),
       language_(language),
-      is_encrypted_(is_encrypted) {
+      program_number_(0),
+      is_encrypted_(is_encrypted),
+      has_encryption_config_(false) {
   if (extra_data_size > 0) {
     extra_data_.assign(extra_data, extra_data + extra_data_size);
   }
@@ -37,6 +39,13 @@ StreamInfo::StreamInfo(StreamType stream_type,
 
 StreamInfo::~StreamInfo() {}
 
+void StreamInfo::CopyOptionalFieldsTo(StreamInfo* clone) const {
+  clone->extra_data_ = extra_data_;
+  clone->program_number_ = program_number_;
+  clone->has_encryption_config_ = has_encryption_config_;
+  clone->encryption_config_ = encryption_config_;
+}
+
 std::string StreamInfo::ToString() const {
   return base::StringPrintf(
       "type: %s\n codec_string: %s\n time_scale: %d\n duration: "
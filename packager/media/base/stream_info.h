@@ -11,6 +11,7 @@
 #include <vector>
 
 #include "packager/base/memory/ref_counted.h"
+#include "packager/media/base/encryption_config.h"
 
 namespace edash_packager {
 namespace media {
@@ -42,14 +43,26 @@ class StreamInfo : public base::RefCountedThreadSafe<StreamInfo> {
   /// @return A human-readable string describing the stream info.
   virtual std::string ToString() const;
 
+  /// @return A copy of this stream info, which can be changed independently.
+  virtual scoped_refptr<StreamInfo> Clone() const = 0;
+
   StreamType stream_type() const { return stream_type_; }
   uint32_t track_id() const { return track_id_; }
   uint32_t time_scale() const { return time_scale_; }
   uint64_t duration() const { return duration_; }
   const std::string& codec_string() const { return codec_string_; }
   const std::string& language() const { return language_; }
+  /// @return The number of the program of a multi-program input, e.g. an
+  ///         MPEG-2 TS multiplex, the stream belongs to, 0 if none.
+  uint32_t program_number() const { return program_number_; }
 
   bool is_encrypted() const { return is_encrypted_; }
+  /// @return true if the samples of the stream are still encrypted and are
+  ///         to be remuxed with their encryption, see encryption_config().
+  bool has_encryption_config() const { return has_encryption_config_; }
+  const EncryptionConfig& encryption_config() const {
+    return encryption_config_;
+  }
 
   const std::vector<uint8_t>& extra_data() const { return extra_data_; }
 
@@ -63,10 +76,22 @@ class StreamInfo : public base::RefCountedThreadSafe<StreamInfo> {
 
   void set_language(const std::string& language) { language_ = language; }
 
+  void set_program_number(uint32_t program_number) {
+    program_number_ = program_number;
+  }
+
+  void set_encryption_config(const EncryptionConfig& encryption_config) {
+    encryption_config_ = encryption_config;
+    has_encryption_config_ = true;
+  }
+
  protected:
   friend class base::RefCountedThreadSafe<StreamInfo>;
   virtual ~StreamInfo();
 
+  /// Copy the fields which are not set by the constructor, for Clone().
+  void CopyOptionalFieldsTo(StreamInfo* clone) const;
+
  private:
   // Whether the stream is Audio or Video.
   StreamType stream_type_;
@@ -77,10 +102,14 @@ class StreamInfo : public base::RefCountedThreadSafe<StreamInfo> {
   uint64_t duration_;
   std::string codec_string_;
   std::string language_;
+  uint32_t program_number_;
   // Whether the stream is potentially encrypted.
   // Note that in a potentially encrypted stream, individual buffers
   // can be encrypted or not encrypted.
   bool is_encrypted_;
+  // The encryption of the samples which are remuxed without being decrypted.
+  bool has_encryption_config_;
+  EncryptionConfig encryption_config_;
   // Optional byte data required for some audio/video decoders such as Vorbis
   // codebooks.
   std::vector<uint8_t> extra_data_;
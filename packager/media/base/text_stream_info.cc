@@ -35,5 +35,13 @@ bool TextStreamInfo::IsValidConfig() const {
   return true;
 }
 
+scoped_refptr<StreamInfo> TextStreamInfo::Clone() const {
+  scoped_refptr<TextStreamInfo> clone(
+      new TextStreamInfo(track_id(), time_scale(), duration(), codec_string(),
+                         language(), std::string(), width_, height_));
+  CopyOptionalFieldsTo(clone.get());
+  return clone;
+}
+
 }  // namespace media
 }  // namespace edash_packager
@@ -37,6 +37,7 @@ class TextStreamInfo : public StreamInfo {
                  uint16_t height);
 
   bool IsValidConfig() const override;
+  scoped_refptr<StreamInfo> Clone() const override;
 
   uint16_t width() const { return width_; }
   uint16_t height() const { return height_; }
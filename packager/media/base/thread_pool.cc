@@ -0,0 +1,233 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/thread_pool.h"
+
+#include "packager/base/bind.h"
+#include "packager/base/logging.h"
+#include "packager/base/stl_util.h"
+#include "packager/base/strings/stringprintf.h"
+#include "packager/base/sys_info.h"
+#include "packager/base/threading/simple_thread.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+// Counts down the tasks of a RunTasksAndWait call.
+class TaskCountdown {
+ public:
+  explicit TaskCountdown(size_t count) : done_cv_(&lock_), count_(count) {}
+
+  void RunTask(const base::Closure& task) {
+    task.Run();
+    base::AutoLock l(lock_);
+    if (--count_ == 0)
+      done_cv_.Signal();
+  }
+
+  void Wait() {
+    base::AutoLock l(lock_);
+    while (count_ > 0)
+      done_cv_.Wait();
+  }
+
+ private:
+  base::Lock lock_;
+  base::ConditionVariable done_cv_;
+  size_t count_;
+
+  DISALLOW_COPY_AND_ASSIGN(TaskCountdown);
+};
+
+}  // namespace
+
+class ThreadPool::Worker : public base::SimpleThread {
+ public:
+  Worker(ThreadPool* pool, size_t index)
+      : base::SimpleThread(
+            base::StringPrintf("%s%zu", pool->name_prefix_.c_str(), index)),
+        pool_(pool),
+        index_(index) {}
+  ~Worker() override {}
+
+  size_t index() const { return index_; }
+
+ private:
+  void Run() override {
+    pool_->current_worker_.Set(this);
+    base::Closure task;
+    while (pool_->GetTask(index_, &task)) {
+      task.Run();
+      task.Reset();
+    }
+    pool_->current_worker_.Set(NULL);
+  }
+
+  ThreadPool* const pool_;
+  const size_t index_;
+
+  DISALLOW_COPY_AND_ASSIGN(Worker);
+};
+
+ThreadPool::WorkQueue::WorkQueue() {}
+ThreadPool::WorkQueue::~WorkQueue() {}
+
+ThreadPool::ThreadPool(const std::string& name_prefix, size_t num_threads)
+    : name_prefix_(name_prefix),
+      num_threads_(num_threads == 0 ? DefaultNumThreads() : num_threads),
+      task_available_cv_(&lock_),
+      num_pending_tasks_(0),
+      next_queue_(0),
+      num_stolen_tasks_(0),
+      started_(false),
+      shutdown_requested_(false) {
+  DCHECK_GT(num_threads_, 0u);
+  for (size_t i = 0; i < num_threads_; ++i)
+    queues_.push_back(new WorkQueue);
+}
+
+ThreadPool::~ThreadPool() {
+  if (started_)
+    Shutdown();
+  STLDeleteElements(&queues_);
+}
+
+void ThreadPool::Start() {
+  DCHECK(!started_);
+  started_ = true;
+  for (size_t i = 0; i < num_threads_; ++i) {
+    workers_.push_back(new Worker(this, i));
+    workers_.back()->Start();
+  }
+}
+
+void ThreadPool::PostTask(const base::Closure& task) {
+  DCHECK(!task.is_null());
+
+  Worker* current_worker = current_worker_.Get();
+  size_t queue_index;
+  if (current_worker) {
+    queue_index = current_worker->index();
+  } else {
+    base::AutoLock l(lock_);
+    if (shutdown_requested_) {
+      LOG(WARNING) << "Dropping task posted after shutdown.";
+      return;
+    }
+    queue_index = next_queue_;
+    next_queue_ = (next_queue_ + 1) % num_threads_;
+  }
+
+  {
+    WorkQueue* queue = queues_[queue_index];
+    base::AutoLock l(queue->lock);
+    queue->tasks.push_back(task);
+  }
+
+  // The task must be visible in its queue before it is counted, so a worker
+  // which has claimed it is guaranteed to find it.
+  base::AutoLock l(lock_);
+  ++num_pending_tasks_;
+  task_available_cv_.Signal();
+}
+
+void ThreadPool::RunTasksAndWait(const std::vector<base::Closure>& tasks) {
+  DCHECK(started_);
+  if (current_worker_.Get()) {
+    for (const base::Closure& task : tasks)
+      task.Run();
+    return;
+  }
+  if (tasks.empty())
+    return;
+
+  TaskCountdown countdown(tasks.size());
+  for (const base::Closure& task : tasks) {
+    PostTask(base::Bind(&TaskCountdown::RunTask, base::Unretained(&countdown),
+                        task));
+  }
+  countdown.Wait();
+}
+
+void ThreadPool::Shutdown() {
+  DCHECK(started_);
+  DCHECK(!current_worker_.Get()) << "Cannot shut down from a worker thread.";
+  {
+    base::AutoLock l(lock_);
+    if (shutdown_requested_ && workers_.empty())
+      return;
+    shutdown_requested_ = true;
+    task_available_cv_.Broadcast();
+  }
+  for (size_t i = 0; i < workers_.size(); ++i)
+    workers_[i]->Join();
+  STLDeleteElements(&workers_);
+}
+
+size_t ThreadPool::num_stolen_tasks() const {
+  base::AutoLock l(lock_);
+  return num_stolen_tasks_;
+}
+
+// static
+size_t ThreadPool::DefaultNumThreads() {
+  int num_processors = base::SysInfo::NumberOfProcessors();
+  return num_processors > 0 ? num_processors : 1;
+}
+
+bool ThreadPool::GetTask(size_t worker_index, base::Closure* task) {
+  {
+    base::AutoLock l(lock_);
+    while (num_pending_tasks_ == 0) {
+      if (shutdown_requested_) {
+        // Wake up the other workers so they can exit too.
+        task_available_cv_.Broadcast();
+        return false;
+      }
+      task_available_cv_.Wait();
+    }
+    // Claim a task. It is in one of the queues.
+    --num_pending_tasks_;
+  }
+
+  if (PopLocalTask(worker_index, task))
+    return true;
+  while (!StealTask(worker_index, task))
+    continue;
+  base::AutoLock l(lock_);
+  ++num_stolen_tasks_;
+  return true;
+}
+
+bool ThreadPool::PopLocalTask(size_t worker_index, base::Closure* task) {
+  WorkQueue* queue = queues_[worker_index];
+  base::AutoLock l(queue->lock);
+  if (queue->tasks.empty())
+    return false;
+  *task = queue->tasks.back();
+  queue->tasks.pop_back();
+  return true;
+}
+
+bool ThreadPool::StealTask(size_t worker_index, base::Closure* task) {
+  for (size_t i = 1; i < num_threads_; ++i) {
+    WorkQueue* queue = queues_[(worker_index + i) % num_threads_];
+    base::AutoLock l(queue->lock);
+    if (!queue->tasks.empty()) {
+      *task = queue->tasks.front();
+      queue->tasks.pop_front();
+      return true;
+    }
+  }
+  // The claimed task may have been pushed to our own queue after the check
+  // above.
+  return PopLocalTask(worker_index, task);
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,124 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef PACKAGER_MEDIA_BASE_THREAD_POOL_H_
+#define PACKAGER_MEDIA_BASE_THREAD_POOL_H_
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "packager/base/callback.h"
+#include "packager/base/macros.h"
+#include "packager/base/synchronization/condition_variable.h"
+#include "packager/base/synchronization/lock.h"
+#include "packager/base/threading/thread_local.h"
+
+namespace edash_packager {
+namespace media {
+
+/// A fixed-size pool of worker threads with work stealing.
+/// Every worker owns a task queue. Tasks posted from a worker thread are
+/// pushed to the queue of that worker and are executed in LIFO order by the
+/// owning worker, which keeps related work on the same core. Tasks posted from
+/// outside the pool are distributed round-robin across the worker queues. An
+/// idle worker steals the oldest task from the queues of the other workers,
+/// so the load is balanced even if the tasks have very different costs.
+///
+/// Thread Safety: PostTask can be called from any thread, including the
+/// worker threads. Start and Shutdown should be called from the thread that
+/// created the pool.
+class ThreadPool {
+ public:
+  /// Create a ThreadPool. The threads will not be created until Start() is
+  /// called.
+  /// @param name_prefix is the thread name prefix. Every thread has a name,
+  ///        in the form of @a name_prefix followed by the worker index and
+  ///        /TID, for example "my_thread2/321" for the third worker.
+  /// @param num_threads is the number of worker threads. A value of zero means
+  ///        one thread per available processor.
+  ThreadPool(const std::string& name_prefix, size_t num_threads);
+
+  /// The destructor calls Shutdown automatically if it is not yet shut down.
+  ~ThreadPool();
+
+  /// Start the worker threads.
+  void Start();
+
+  /// Post a task to the pool. The task is run in one of the worker threads.
+  /// Tasks posted after Shutdown() has been called are dropped.
+  /// @param task is the Closure to run.
+  void PostTask(const base::Closure& task);
+
+  /// Run @a tasks on the pool and wait until all of them have completed. If
+  /// called from a worker thread of this pool, the tasks are run on the
+  /// calling thread instead, so a task never waits on the pool it runs on.
+  /// The pool must have been started.
+  /// @param tasks contains the Closures to run.
+  void RunTasksAndWait(const std::vector<base::Closure>& tasks);
+
+  /// Run all the tasks which have been posted, including those posted by the
+  /// running tasks, then join the worker threads.
+  void Shutdown();
+
+  /// @return The number of worker threads.
+  size_t num_threads() const { return num_threads_; }
+
+  /// @return The number of tasks that have been executed by a worker other
+  ///         than the one they were queued on.
+  size_t num_stolen_tasks() const;
+
+  /// @return The number of logical processors available, which is the default
+  ///         number of worker threads.
+  static size_t DefaultNumThreads();
+
+ private:
+  class Worker;
+
+  // Task queue owned by a worker. Protected by its own lock so that posting
+  // and stealing contend only on the queues involved.
+  struct WorkQueue {
+    WorkQueue();
+    ~WorkQueue();
+
+    base::Lock lock;
+    std::deque<base::Closure> tasks;
+  };
+
+  // Block until a task is available or the pool is shut down. Returns false
+  // if the pool is shut down and there are no more tasks to run.
+  bool GetTask(size_t worker_index, base::Closure* task);
+  // Pop the most recently pushed task from the queue of |worker_index|.
+  bool PopLocalTask(size_t worker_index, base::Closure* task);
+  // Steal the oldest task from the queue of a worker other than
+  // |worker_index|.
+  bool StealTask(size_t worker_index, base::Closure* task);
+
+  const std::string name_prefix_;
+  const size_t num_threads_;
+  std::vector<WorkQueue*> queues_;
+  std::vector<Worker*> workers_;
+  // The worker running on the current thread, NULL if the current thread does
+  // not belong to this pool.
+  base::ThreadLocalPointer<Worker> current_worker_;
+
+  mutable base::Lock lock_;  // Lock protecting the variables below.
+  base::ConditionVariable task_available_cv_;
+  // Number of queued tasks not yet claimed by a worker.
+  size_t num_pending_tasks_;
+  // Queue to receive the next task posted from outside the pool.
+  size_t next_queue_;
+  size_t num_stolen_tasks_;
+  bool started_;
+  bool shutdown_requested_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadPool);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // PACKAGER_MEDIA_BASE_THREAD_POOL_H_
@@ -0,0 +1,141 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+
+#include "packager/base/atomicops.h"
+#include "packager/base/bind.h"
+#include "packager/base/synchronization/waitable_event.h"
+#include "packager/base/threading/platform_thread.h"
+#include "packager/media/base/thread_pool.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+const char kThreadNamePrefix[] = "TestThreadPool";
+const size_t kNumThreads = 4;
+const int kNumTasks = 1000;
+
+void Increment(base::subtle::Atomic32* counter) {
+  base::subtle::NoBarrier_AtomicIncrement(counter, 1);
+}
+
+// Posts |depth| levels of nested tasks, each incrementing |counter|.
+void PostNested(ThreadPool* pool, base::subtle::Atomic32* counter, int depth) {
+  Increment(counter);
+  if (depth > 0) {
+    pool->PostTask(base::Bind(&PostNested, pool, counter, depth - 1));
+    pool->PostTask(base::Bind(&PostNested, pool, counter, depth - 1));
+  }
+}
+
+void BlockUntilSignaled(base::WaitableEvent* started,
+                        base::WaitableEvent* release) {
+  started->Signal();
+  release->Wait();
+}
+
+void RunTasksAndWaitNested(ThreadPool* pool, base::subtle::Atomic32* counter) {
+  std::vector<base::Closure> tasks(kNumThreads,
+                                   base::Bind(&Increment, counter));
+  pool->RunTasksAndWait(tasks);
+}
+
+}  // namespace
+
+TEST(ThreadPoolTest, DefaultNumThreads) {
+  ThreadPool pool(kThreadNamePrefix, 0);
+  EXPECT_EQ(ThreadPool::DefaultNumThreads(), pool.num_threads());
+  EXPECT_GE(pool.num_threads(), 1u);
+}
+
+TEST(ThreadPoolTest, RunAllTasks) {
+  base::subtle::Atomic32 counter = 0;
+  ThreadPool pool(kThreadNamePrefix, kNumThreads);
+  pool.Start();
+  for (int i = 0; i < kNumTasks; ++i)
+    pool.PostTask(base::Bind(&Increment, &counter));
+  pool.Shutdown();
+  EXPECT_EQ(kNumTasks, base::subtle::NoBarrier_Load(&counter));
+}
+
+TEST(ThreadPoolTest, TasksPostedBeforeStart) {
+  base::subtle::Atomic32 counter = 0;
+  ThreadPool pool(kThreadNamePrefix, kNumThreads);
+  for (int i = 0; i < kNumTasks; ++i)
+    pool.PostTask(base::Bind(&Increment, &counter));
+  pool.Start();
+  pool.Shutdown();
+  EXPECT_EQ(kNumTasks, base::subtle::NoBarrier_Load(&counter));
+}
+
+TEST(ThreadPoolTest, NestedTasks) {
+  const int kDepth = 8;
+  base::subtle::Atomic32 counter = 0;
+  ThreadPool pool(kThreadNamePrefix, kNumThreads);
+  pool.Start();
+  pool.PostTask(base::Bind(&PostNested, &pool, &counter, kDepth));
+  pool.Shutdown();
+  EXPECT_EQ((1 << (kDepth + 1)) - 1, base::subtle::NoBarrier_Load(&counter));
+}
+
+// A worker blocked on a long task should not hold back the tasks queued
+// behind it; they are stolen by the other workers.
+TEST(ThreadPoolTest, StealFromBlockedWorker) {
+  base::WaitableEvent started(false, false);
+  base::WaitableEvent release(true, false);
+  base::subtle::Atomic32 counter = 0;
+
+  ThreadPool pool(kThreadNamePrefix, 2);
+  // Make sure the blocking task is running before queuing the rest.
+  pool.Start();
+  pool.PostTask(base::Bind(&BlockUntilSignaled, &started, &release));
+  started.Wait();
+  for (int i = 0; i < kNumTasks; ++i)
+    pool.PostTask(base::Bind(&Increment, &counter));
+
+  // Half of the tasks are queued on the blocked worker, and must be stolen.
+  while (base::subtle::NoBarrier_Load(&counter) < kNumTasks)
+    base::PlatformThread::YieldCurrentThread();
+  EXPECT_GT(pool.num_stolen_tasks(), 0u);
+
+  release.Signal();
+  pool.Shutdown();
+}
+
+TEST(ThreadPoolTest, RunTasksAndWait) {
+  base::subtle::Atomic32 counter = 0;
+  ThreadPool pool(kThreadNamePrefix, kNumThreads);
+  pool.Start();
+  std::vector<base::Closure> tasks(kNumTasks, base::Bind(&Increment, &counter));
+  pool.RunTasksAndWait(tasks);
+  EXPECT_EQ(kNumTasks, base::subtle::NoBarrier_Load(&counter));
+
+  // Nested calls from the workers must not deadlock, even with every worker
+  // waiting.
+  std::vector<base::Closure> nested_tasks(
+      kNumThreads, base::Bind(&RunTasksAndWaitNested, &pool, &counter));
+  pool.RunTasksAndWait(nested_tasks);
+  EXPECT_EQ(kNumTasks + static_cast<int>(kNumThreads * kNumThreads),
+            base::subtle::NoBarrier_Load(&counter));
+  pool.Shutdown();
+}
+
+TEST(ThreadPoolTest, DestructorShutsDown) {
+  base::subtle::Atomic32 counter = 0;
+  {
+    ThreadPool pool(kThreadNamePrefix, kNumThreads);
+    pool.Start();
+    for (int i = 0; i < kNumTasks; ++i)
+      pool.PostTask(base::Bind(&Increment, &counter));
+  }
+  EXPECT_EQ(kNumTasks, base::subtle::NoBarrier_Load(&counter));
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,21 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/timed_metadata.h"
+
+namespace edash_packager {
+namespace media {
+
+const char kScte35SchemeIdUri[] = "urn:scte:scte35:2013:bin";
+const char kId3SchemeIdUri[] = "https://aomedia.org/emsg/ID3";
+
+TimedMetadataEvent::TimedMetadataEvent()
+    : timescale(0), presentation_time(0), duration(0), id(0) {}
+
+TimedMetadataEvent::~TimedMetadataEvent() {}
+
+}  // namespace media
+}  // namespace edash_packager
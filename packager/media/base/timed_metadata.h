@@ -0,0 +1,50 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_BASE_TIMED_METADATA_H_
+#define MEDIA_BASE_TIMED_METADATA_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace edash_packager {
+namespace media {
+
+/// The scheme of SCTE-35 splice information sections, carried in binary.
+extern const char kScte35SchemeIdUri[];
+/// The scheme of ID3 tags.
+extern const char kId3SchemeIdUri[];
+
+/// A sparse timed metadata event of a program, e.g. an SCTE-35 ad marker or
+/// an ID3 tag. The events do not go through the sample path: they are handed
+/// to the muxers on the side, see MediaStream::PushTimedMetadata(), and
+/// written as 'emsg' boxes in MP4 segments or as tags in HLS playlists. The
+/// fields match those of the DASH event message box.
+struct TimedMetadataEvent {
+  TimedMetadataEvent();
+  ~TimedMetadataEvent();
+
+  /// The scheme of the event, which defines @a value and @a message_data.
+  std::string scheme_id_uri;
+  std::string value;
+  /// The timescale of @a presentation_time and @a duration.
+  uint32_t timescale;
+  /// The time the event applies at, on the timeline of the samples.
+  int64_t presentation_time;
+  /// The duration of the event, 0 if unknown.
+  uint64_t duration;
+  /// The identifier of the event, the same for the repetitions of an event.
+  uint32_t id;
+  /// The payload of the event, e.g. the SCTE-35 section.
+  std::vector<uint8_t> message_data;
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_BASE_TIMED_METADATA_H_
@@ -0,0 +1,53 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/timestamp_unroller.h"
+
+#include "packager/base/logging.h"
+#include "packager/media/base/timestamp.h"
+
+namespace edash_packager {
+namespace media {
+
+TimestampUnroller::TimestampUnroller(int timestamp_bits)
+    : shift_(64 - timestamp_bits),
+      mask_((INT64_C(1) << timestamp_bits) - 1),
+      previous_valid_(false),
+      previous_(0) {
+  DCHECK_GT(timestamp_bits, 0);
+  DCHECK_LT(timestamp_bits, 64);
+}
+
+TimestampUnroller::~TimestampUnroller() {}
+
+int64_t TimestampUnroller::Unroll(int64_t timestamp) {
+  if (timestamp == kNoTimestamp)
+    return timestamp;
+  if (!previous_valid_) {
+    previous_ = timestamp & mask_;
+    previous_valid_ = true;
+    return previous_;
+  }
+  // The difference modulo 2^timestamp_bits, sign extended, is the distance
+  // to the nearest position of |timestamp| on the unrolled timeline.
+  const uint64_t diff =
+      static_cast<uint64_t>(timestamp) - static_cast<uint64_t>(previous_);
+  previous_ += static_cast<int64_t>(diff << shift_) >> shift_;
+  return previous_;
+}
+
+void TimestampUnroller::Unroll(int64_t* timestamps, size_t num_timestamps) {
+  for (size_t i = 0; i < num_timestamps; ++i)
+    timestamps[i] = Unroll(timestamps[i]);
+}
+
+void TimestampUnroller::Reset() {
+  previous_valid_ = false;
+  previous_ = 0;
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,54 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_BASE_TIMESTAMP_UNROLLER_H_
+#define MEDIA_BASE_TIMESTAMP_UNROLLER_H_
+
+#include <stdint.h>
+
+#include "packager/base/macros.h"
+
+namespace edash_packager {
+namespace media {
+
+/// Unrolls the timestamps of a track which are coded on a limited number of
+/// bits, e.g. the 33-bit PTS and DTS of MPEG-2, into a continuous 64-bit
+/// timeline. Each timestamp is placed at the position nearest to the
+/// previous one, so that the timeline is continuous across the wraparounds
+/// as long as two successive timestamps are less than half the range apart.
+/// The first timestamp, and the first one after Reset(), is kept as is.
+class TimestampUnroller {
+ public:
+  /// @param timestamp_bits is the number of bits the timestamps are coded
+  ///        on, between 1 and 63.
+  explicit TimestampUnroller(int timestamp_bits);
+  ~TimestampUnroller();
+
+  /// @param timestamp is the coded timestamp. Only its low timestamp_bits
+  ///        bits are considered, except for kNoTimestamp which is returned
+  ///        as is.
+  /// @return the unrolled timestamp.
+  int64_t Unroll(int64_t timestamp);
+
+  /// Unroll @a num_timestamps timestamps in place, in decoding order.
+  void Unroll(int64_t* timestamps, size_t num_timestamps);
+
+  /// Forget the previous timestamp, e.g. on a discontinuity.
+  void Reset();
+
+ private:
+  const int shift_;
+  const int64_t mask_;
+  bool previous_valid_;
+  int64_t previous_;
+
+  DISALLOW_COPY_AND_ASSIGN(TimestampUnroller);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_BASE_TIMESTAMP_UNROLLER_H_
@@ -0,0 +1,52 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+
+#include "packager/base/macros.h"
+#include "packager/media/base/timestamp.h"
+#include "packager/media/base/timestamp_unroller.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+const int kTimestampBits = 33;
+const int64_t kWrap = INT64_C(1) << kTimestampBits;
+}  // namespace
+
+TEST(TimestampUnrollerTest, FirstTimestampKept) {
+  TimestampUnroller unroller(kTimestampBits);
+  EXPECT_EQ(kWrap - 100, unroller.Unroll(kWrap - 100));
+  EXPECT_EQ(kWrap - 10, unroller.Unroll(kWrap - 10));
+}
+
+TEST(TimestampUnrollerTest, Wraparound) {
+  TimestampUnroller unroller(kTimestampBits);
+  EXPECT_EQ(kWrap - 100, unroller.Unroll(kWrap - 100));
+  EXPECT_EQ(kWrap + 50, unroller.Unroll(50));
+  // Backward steps, e.g. B-frame PTS, across the wraparound.
+  EXPECT_EQ(kWrap - 20, unroller.Unroll(kWrap - 20));
+  // Values outside the coded range are taken modulo the range.
+  EXPECT_EQ(kWrap + 10, unroller.Unroll(3 * kWrap + 10));
+}
+
+TEST(TimestampUnrollerTest, BatchAndReset) {
+  TimestampUnroller unroller(kTimestampBits);
+  int64_t timestamps[] = {kWrap - 3000, kWrap - 1500, 0, kNoTimestamp, 1500};
+  unroller.Unroll(timestamps, arraysize(timestamps));
+  EXPECT_EQ(kWrap - 3000, timestamps[0]);
+  EXPECT_EQ(kWrap - 1500, timestamps[1]);
+  EXPECT_EQ(kWrap, timestamps[2]);
+  EXPECT_EQ(kNoTimestamp, timestamps[3]);
+  EXPECT_EQ(kWrap + 1500, timestamps[4]);
+
+  unroller.Reset();
+  EXPECT_EQ(1500, unroller.Unroll(1500));
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -89,6 +89,15 @@ bool VideoStreamInfo::IsValidConfig() const {
          (nalu_length_size_ <= 2 || nalu_length_size_ == 4);
 }
 
+scoped_refptr<StreamInfo> VideoStreamInfo::Clone() const {
+  scoped_refptr<VideoStreamInfo> clone(new VideoStreamInfo(
+      track_id(), time_scale(), duration(), codec_, codec_string(), language(),
+      width_, height_, pixel_width_, pixel_height_, trick_play_rate_,
+      nalu_length_size_, NULL, 0, is_encrypted()));
+  CopyOptionalFieldsTo(clone.get());
+  return clone;
+}
+
 std::string VideoStreamInfo::ToString() const {
   return base::StringPrintf(
       "%s codec: %s\n width: %d\n height: %d\n pixel_aspect_ratio: %d:%d\n "
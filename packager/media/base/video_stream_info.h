@@ -53,6 +53,7 @@ class VideoStreamInfo : public StreamInfo {
   /// @{
   bool IsValidConfig() const override;
   std::string ToString() const override;
+  scoped_refptr<StreamInfo> Clone() const override;
   /// @}
 
   VideoCodec codec() const { return codec_; }
@@ -6,20 +6,29 @@
 
 #include "packager/media/base/widevine_key_source.h"
 
+#include <algorithm>
 #include <set>
 
 #include "packager/base/base64.h"
 #include "packager/base/bind.h"
+#include "packager/base/files/file_util.h"
 #include "packager/base/json/json_reader.h"
 #include "packager/base/json/json_writer.h"
 #include "packager/base/memory/ref_counted.h"
+#include "packager/base/sha1.h"
 #include "packager/base/stl_util.h"
+#include "packager/base/strings/string_number_conversions.h"
+#include "packager/base/timer/elapsed_timer.h"
+#include "packager/base/trace_event/trace_event.h"
+#include "packager/media/base/background_executor.h"
+#include "packager/media/base/cancellation_token.h"
 #include "packager/media/base/fixed_key_source.h"
 #include "packager/media/base/http_key_fetcher.h"
 #include "packager/media/base/producer_consumer_queue.h"
 #include "packager/media/base/protection_system_specific_info.h"
 #include "packager/media/base/rcheck.h"
 #include "packager/media/base/request_signer.h"
+#include "packager/media/base/thread_pool.h"
 #include "packager/media/base/widevine_pssh_data.pb.h"
 
 namespace edash_packager {
@@ -36,10 +45,19 @@ const char kLicenseStatusTransientError[] = "INTERNAL_ERROR";
 // the server.
 const int kNumTransientErrorRetries = 5;
 const int kFirstRetryDelayMilliseconds = 1000;
+const char kRetriesExhaustedMessage[] =
+    "Failed to recover from server internal error.";
+// With several key servers, time after which a request to a server whose
+// latency is not known yet is hedged, and lower bound of the hedge delay of
+// the other servers.
+const int kDefaultHedgeDelayMilliseconds = 1000;
+const int kMinHedgeDelayMilliseconds = 100;
 
 // Default crypto period count, which is the number of keys to fetch on every
 // key rotation enabled request.
 const int kDefaultCryptoPeriodCount = 10;
+// Maximum number of key requests in flight for FetchKeysForContents().
+const size_t kMaxConcurrentKeyRequests = 8;
 const int kGetKeyTimeoutInSeconds = 5 * 60;  // 5 minutes.
 const int kKeyFetchTimeoutInSeconds = 60;  // 1 minute.
 
@@ -111,6 +129,26 @@ bool GetPsshDataFromTrack(const base::DictionaryValue& track_dict,
   return true;
 }
 
+// Runs |task| with |cancellation_token| as the current token.
+void RunWithCancellationToken(
+    const scoped_refptr<media::CancellationToken>& cancellation_token,
+    const base::Closure& task) {
+  media::ScopedCancellationToken scoped_token(cancellation_token.get());
+  task.Run();
+}
+
+// Cancels a token when going out of scope.
+class ScopedCancel {
+ public:
+  explicit ScopedCancel(media::CancellationToken* token) : token_(token) {}
+  ~ScopedCancel() { token_->Cancel(); }
+
+ private:
+  media::CancellationToken* token_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedCancel);
+};
+
 }  // namespace
 
 namespace media {
@@ -138,31 +176,103 @@ class WidevineKeySource::RefCountedEncryptionKeyMap
   DISALLOW_COPY_AND_ASSIGN(RefCountedEncryptionKeyMap);
 };
 
+// The request and the keys of one content of FetchKeysForContents().
+struct WidevineKeySource::ContentKeyRequest {
+  ContentKeyRequest() {}
+  ~ContentKeyRequest() { STLDeleteValues(&encryption_key_map); }
+
+  std::vector<uint8_t> content_id;
+  base::DictionaryValue request_dict;
+  EncryptionKeyMap encryption_key_map;
+  Status status;
+
+  DISALLOW_COPY_AND_ASSIGN(ContentKeyRequest);
+};
+
+// The result of one attempt of a key request.
+struct WidevineKeySource::KeyFetchResult {
+  KeyFetchResult() : server_index(0) {}
+
+  size_t server_index;
+  Status status;
+  std::string raw_response;
+};
+
+// The attempts of one key request, which run concurrently when the request
+// is hedged. Held by the attempts in flight too, which may complete after
+// the request.
+class WidevineKeySource::KeyFetchAttempts
+    : public base::RefCountedThreadSafe<KeyFetchAttempts> {
+ public:
+  KeyFetchAttempts()
+      : cancellation_token(new CancellationToken),
+        results(kUnlimitedCapacity) {}
+
+  // The current token of the attempts run on the thread pool, cancelled
+  // once the request completes.
+  scoped_refptr<CancellationToken> cancellation_token;
+  ProducerConsumerQueue<KeyFetchResult> results;
+
+ private:
+  friend class base::RefCountedThreadSafe<KeyFetchAttempts>;
+  ~KeyFetchAttempts() {}
+
+  DISALLOW_COPY_AND_ASSIGN(KeyFetchAttempts);
+};
+
+WidevineKeySource::KeyFetchStats::EndpointStats::EndpointStats()
+    : num_fetches(0), num_failures(0), num_consecutive_failures(0) {}
+
+WidevineKeySource::KeyFetchStats::KeyFetchStats()
+    : num_fetches(0), num_cache_hits(0), num_stalls(0) {}
+WidevineKeySource::KeyFetchStats::~KeyFetchStats() {}
+
+namespace {
+
+// Returns the mean latency of the requests of |endpoint_stats|, zero if
+// there are none.
+base::TimeDelta GetMeanFetchTime(
+    const WidevineKeySource::KeyFetchStats::EndpointStats& endpoint_stats) {
+  const uint32_t num_requests =
+      endpoint_stats.num_fetches + endpoint_stats.num_failures;
+  return num_requests > 0 ? endpoint_stats.total_fetch_time / num_requests
+                          : base::TimeDelta();
+}
+
+}  // namespace
+
 WidevineKeySource::WidevineKeySource(const std::string& server_url,
                                      bool add_common_pssh)
-    : key_production_thread_("KeyProductionThread",
-                             base::Bind(&WidevineKeySource::FetchKeysTask,
-                                        base::Unretained(this))),
-      key_fetcher_(new HttpKeyFetcher(kKeyFetchTimeoutInSeconds)),
-      server_url_(server_url),
+    : key_fetcher_(new HttpKeyFetcher(kKeyFetchTimeoutInSeconds)),
+      server_urls_(1, server_url),
       crypto_period_count_(kDefaultCryptoPeriodCount),
+      key_prefetch_window_(kDefaultCryptoPeriodCount / 2),
       add_common_pssh_(add_common_pssh),
       key_production_started_(false),
-      start_key_production_(false, false),
-      first_crypto_period_index_(0) {
-  key_production_thread_.Start();
-}
+      key_production_done_(false, false),
+      first_crypto_period_index_(0) {}
 
 WidevineKeySource::~WidevineKeySource() {
   if (key_pool_)
     key_pool_->Stop();
-  if (key_production_thread_.HasBeenStarted()) {
-    // Signal the production thread to start key production if it is not
-    // signaled yet so the thread can be joined.
-    start_key_production_.Signal();
-    key_production_thread_.Join();
+  if (key_production_started_) {
+    key_production_done_.Wait();
+    BackgroundExecutor::GetInstance()->ReleaseThread(
+        BackgroundExecutor::kKeyFetchQueue);
   }
+  // The attempts still running use |key_fetcher_|.
+  if (key_fetch_thread_pool_)
+    key_fetch_thread_pool_->Shutdown();
   STLDeleteValues(&encryption_key_map_);
+  for (auto& content_key_map : content_key_maps_)
+    STLDeleteValues(&content_key_map.second);
+
+  VLOG(1) << "Key requests: " << stats_.num_fetches << " fetched in "
+          << stats_.total_fetch_time.InMilliseconds() << " ms (max "
+          << stats_.max_fetch_time.InMilliseconds() << " ms), "
+          << stats_.num_cache_hits << " cached; " << stats_.num_stalls
+          << " stalls for " << stats_.total_stall_time.InMilliseconds()
+          << " ms.";
 }
 
 Status WidevineKeySource::FetchKeys(const std::vector<uint8_t>& content_id,
@@ -176,6 +286,75 @@ Status WidevineKeySource::FetchKeys(const std::vector<uint8_t>& content_id,
   return FetchKeysInternal(!kEnableKeyRotation, 0, false);
 }
 
+Status WidevineKeySource::FetchKeysForContents(
+    const std::vector<std::vector<uint8_t>>& content_ids,
+    const std::string& policy) {
+  if (content_ids.empty())
+    return Status(error::INVALID_ARGUMENT, "No content ids given.");
+
+  std::vector<ContentKeyRequest*> content_key_requests;
+  STLElementDeleter<std::vector<ContentKeyRequest*> > scoped_requests_deleter(
+      &content_key_requests);
+  std::vector<base::Closure> tasks;
+  for (const std::vector<uint8_t>& content_id : content_ids) {
+    ContentKeyRequest* content_key_request = new ContentKeyRequest;
+    content_key_requests.push_back(content_key_request);
+    content_key_request->content_id = content_id;
+    std::string content_id_base64_string;
+    BytesToBase64String(content_id, &content_id_base64_string);
+    content_key_request->request_dict.SetString("content_id",
+                                                content_id_base64_string);
+    content_key_request->request_dict.SetString("policy", policy);
+    tasks.push_back(base::Bind(&WidevineKeySource::FetchContentKeys,
+                               base::Unretained(this), content_key_request));
+  }
+
+  ThreadPool thread_pool(
+      "KeyRequestThread",
+      std::min(content_key_requests.size(), kMaxConcurrentKeyRequests));
+  thread_pool.Start();
+  thread_pool.RunTasksAndWait(tasks);
+  thread_pool.Shutdown();
+
+  base::AutoLock scoped_lock(lock_);
+  for (const ContentKeyRequest* content_key_request : content_key_requests) {
+    if (!content_key_request->status.ok())
+      return content_key_request->status;
+  }
+  for (ContentKeyRequest* content_key_request : content_key_requests) {
+    EncryptionKeyMap& encryption_key_map =
+        content_key_maps_[content_key_request->content_id];
+    STLDeleteValues(&encryption_key_map);
+    encryption_key_map.swap(content_key_request->encryption_key_map);
+  }
+  content_policy_ = policy;
+  return Status::OK;
+}
+
+Status WidevineKeySource::SelectContent(
+    const std::vector<uint8_t>& content_id) {
+  base::AutoLock scoped_lock(lock_);
+  DCHECK(!key_production_started_);
+  std::map<std::vector<uint8_t>, EncryptionKeyMap>::const_iterator iter =
+      content_key_maps_.find(content_id);
+  if (iter == content_key_maps_.end()) {
+    return Status(error::NOT_FOUND,
+                  "The keys of the content have not been fetched.");
+  }
+
+  STLDeleteValues(&encryption_key_map_);
+  for (const EncryptionKeyMap::value_type& pair : iter->second)
+    encryption_key_map_[pair.first] = new EncryptionKey(*pair.second);
+
+  // Crypto period keys are requested for the selected content.
+  request_dict_.Clear();
+  std::string content_id_base64_string;
+  BytesToBase64String(content_id, &content_id_base64_string);
+  request_dict_.SetString("content_id", content_id_base64_string);
+  request_dict_.SetString("policy", content_policy_);
+  return Status::OK;
+}
+
 Status WidevineKeySource::FetchKeys(const std::vector<uint8_t>& pssh_box) {
   const std::vector<uint8_t> widevine_system_id(
       kWidevineSystemId, kWidevineSystemId + arraysize(kWidevineSystemId));
@@ -255,6 +434,15 @@ Status WidevineKeySource::GetKey(const std::vector<uint8_t>& key_id,
       return Status::OK;
     }
   }
+  base::AutoLock scoped_lock(lock_);
+  for (const auto& content_key_map : content_key_maps_) {
+    for (const EncryptionKeyMap::value_type& pair : content_key_map.second) {
+      if (pair.second->key_id == key_id) {
+        *key = *pair.second;
+        return Status::OK;
+      }
+    }
+  }
   return Status(error::INTERNAL_ERROR,
                 "Cannot find key with specified key ID");
 }
@@ -262,20 +450,31 @@ Status WidevineKeySource::GetKey(const std::vector<uint8_t>& key_id,
 Status WidevineKeySource::GetCryptoPeriodKey(uint32_t crypto_period_index,
                                              TrackType track_type,
                                              EncryptionKey* key) {
-  DCHECK(key_production_thread_.HasBeenStarted());
   // TODO(kqyang): This is not elegant. Consider refactoring later.
   {
     base::AutoLock scoped_lock(lock_);
     if (!key_production_started_) {
+      // The key production runs until the key source is destroyed.
+      if (!BackgroundExecutor::GetInstance()->ReserveThread(
+              BackgroundExecutor::kKeyFetchQueue)) {
+        return Status(error::INTERNAL_ERROR,
+                      "Too many key sources producing keys at once, see "
+                      "--key_fetch_threads.");
+      }
       // Another client may have a slightly smaller starting crypto period
       // index. Set the initial value to account for that.
       first_crypto_period_index_ =
           crypto_period_index ? crypto_period_index - 1 : 0;
       DCHECK(!key_pool_);
-      key_pool_.reset(new EncryptionKeyQueue(crypto_period_count_,
+      // The pool keeps as many elements before the peeked position as after,
+      // which are prefetched.
+      key_pool_.reset(new EncryptionKeyQueue(2 * key_prefetch_window_,
                                              first_crypto_period_index_));
-      start_key_production_.Signal();
       key_production_started_ = true;
+      BackgroundExecutor::GetInstance()->PostTask(
+          BackgroundExecutor::kKeyFetchQueue,
+          base::Bind(&WidevineKeySource::FetchKeysTask,
+                     base::Unretained(this)));
     }
   }
   return GetKeyInternal(crypto_period_index, track_type, key);
@@ -285,6 +484,48 @@ void WidevineKeySource::set_signer(scoped_ptr<RequestSigner> signer) {
   signer_ = signer.Pass();
 }
 
+void WidevineKeySource::set_key_prefetch_window(uint32_t num_crypto_periods) {
+  base::AutoLock scoped_lock(lock_);
+  DCHECK(!key_production_started_);
+  // A whole request must fit in the pool, or the fetched keys could not be
+  // pushed before the keys in use are released.
+  key_prefetch_window_ = std::max(num_crypto_periods,
+                                  (crypto_period_count_ + 1) / 2);
+}
+
+void WidevineKeySource::set_key_cache_dir(const std::string& key_cache_dir) {
+  key_cache_dir_ = key_cache_dir;
+}
+
+void WidevineKeySource::GetKeyFetchStalls(uint32_t* num_stalls,
+                                          base::TimeDelta* stall_time) const {
+  DCHECK(num_stalls);
+  DCHECK(stall_time);
+  base::AutoLock scoped_lock(stats_lock_);
+  *num_stalls = stats_.num_stalls;
+  *stall_time = stats_.total_stall_time;
+}
+
+void WidevineKeySource::set_backup_server_urls(
+    const std::vector<std::string>& backup_server_urls) {
+  server_urls_.resize(1);
+  server_urls_.insert(server_urls_.end(), backup_server_urls.begin(),
+                      backup_server_urls.end());
+  if (server_urls_.size() > 1 && !key_fetch_thread_pool_) {
+    // Room for the concurrent requests of FetchKeysForContents() to be
+    // hedged on every server.
+    key_fetch_thread_pool_.reset(
+        new ThreadPool("KeyFetchThread",
+                       kMaxConcurrentKeyRequests * server_urls_.size()));
+    key_fetch_thread_pool_->Start();
+  }
+}
+
+WidevineKeySource::KeyFetchStats WidevineKeySource::key_fetch_stats() const {
+  base::AutoLock scoped_lock(stats_lock_);
+  return stats_;
+}
+
 void WidevineKeySource::set_key_fetcher(scoped_ptr<KeyFetcher> key_fetcher) {
   key_fetcher_ = key_fetcher.Pass();
 }
@@ -299,8 +540,17 @@ Status WidevineKeySource::GetKeyInternal(uint32_t crypto_period_index,
 
   scoped_refptr<RefCountedEncryptionKeyMap> ref_counted_encryption_key_map;
   Status status =
-      key_pool_->Peek(crypto_period_index, &ref_counted_encryption_key_map,
-                      kGetKeyTimeoutInSeconds * 1000);
+      key_pool_->Peek(crypto_period_index, &ref_counted_encryption_key_map, 0);
+  if (status.error_code() == error::TIME_OUT) {
+    // The key has not been prefetched yet.
+    base::ElapsedTimer stall_timer;
+    status =
+        key_pool_->Peek(crypto_period_index, &ref_counted_encryption_key_map,
+                        kGetKeyTimeoutInSeconds * 1000);
+    base::AutoLock scoped_lock(stats_lock_);
+    ++stats_.num_stalls;
+    stats_.total_stall_time += stall_timer.Elapsed();
+  }
   if (!status.ok()) {
     if (status.error_code() == error::STOPPED) {
       CHECK(!common_encryption_request_status_.ok());
@@ -318,17 +568,30 @@ Status WidevineKeySource::GetKeyInternal(uint32_t crypto_period_index,
   return Status::OK;
 }
 
+void WidevineKeySource::FetchContentKeys(
+    ContentKeyRequest* content_key_request) {
+  content_key_request->status = FetchKeysWithRequest(
+      &content_key_request->request_dict, !kEnableKeyRotation, 0, false,
+      &content_key_request->encryption_key_map);
+}
+
 void WidevineKeySource::FetchKeysTask() {
-  // Wait until key production is signaled.
-  start_key_production_.Wait();
-  if (!key_pool_ || key_pool_->Stopped())
-    return;
+  // The key source may have been stopped before the task ran.
+  if (!key_pool_->Stopped())
+    ProduceKeys();
+  key_production_done_.Signal();
+}
 
+void WidevineKeySource::ProduceKeys() {
+  // The next request is signed while the current one is in flight.
+  PrepareKeyRotationRequest(first_crypto_period_index_ + crypto_period_count_);
   Status status = FetchKeysInternal(kEnableKeyRotation,
                                     first_crypto_period_index_,
                                     false);
   while (status.ok()) {
     first_crypto_period_index_ += crypto_period_count_;
+    PrepareKeyRotationRequest(first_crypto_period_index_ +
+                              crypto_period_count_);
     status = FetchKeysInternal(kEnableKeyRotation,
                                first_crypto_period_index_,
                                false);
@@ -337,68 +600,292 @@ void WidevineKeySource::FetchKeysTask() {
   key_pool_->Stop();
 }
 
+void WidevineKeySource::PrepareKeyRotationRequest(
+    uint32_t first_crypto_period_index) {
+  base::AutoLock scoped_lock(signer_lock_);
+  if (!signer_)
+    return;
+  std::string request;
+  FillRequest(&request_dict_, kEnableKeyRotation, first_crypto_period_index,
+              &request);
+  signer_->PrepareSignature(request);
+}
+
 Status WidevineKeySource::FetchKeysInternal(bool enable_key_rotation,
                                             uint32_t first_crypto_period_index,
                                             bool widevine_classic) {
+  return FetchKeysWithRequest(&request_dict_, enable_key_rotation,
+                              first_crypto_period_index, widevine_classic,
+                              &encryption_key_map_);
+}
+
+Status WidevineKeySource::FetchKeysWithRequest(
+    base::DictionaryValue* request_dict,
+    bool enable_key_rotation,
+    uint32_t first_crypto_period_index,
+    bool widevine_classic,
+    EncryptionKeyMap* encryption_key_map) {
+  TRACE_EVENT1("packager", "WidevineKeySource::FetchKeys",
+               "first_crypto_period_index", first_crypto_period_index);
   std::string request;
-  FillRequest(enable_key_rotation,
-              first_crypto_period_index,
+  FillRequest(request_dict, enable_key_rotation, first_crypto_period_index,
               &request);
 
+  std::string cached_response;
+  if (ReadCachedResponse(request, &cached_response)) {
+    bool transient_error = false;
+    if (ExtractEncryptionKey(enable_key_rotation, widevine_classic,
+                             cached_response, encryption_key_map,
+                             &transient_error)) {
+      base::AutoLock scoped_lock(stats_lock_);
+      ++stats_.num_cache_hits;
+      return Status::OK;
+    }
+    LOG(WARNING) << "Ignoring invalid cached key response "
+                 << GetCacheFileName(request);
+  }
+
   std::string message;
   Status status = GenerateKeyMessage(request, &message);
   if (!status.ok())
     return status;
   VLOG(1) << "Message: " << message;
 
-  std::string raw_response;
-  int64_t sleep_duration = kFirstRetryDelayMilliseconds;
+  // Each attempt goes to the server with the fewest recent failures, then
+  // the lowest latency, which is not working on the request yet. An attempt
+  // which does not complete within the hedge delay of its server is hedged
+  // by an attempt on another server, and a transient error is retried after
+  // an exponential backoff. The first response is used.
+  const size_t num_servers = server_urls_.size();
+  const size_t max_attempts = kNumTransientErrorRetries * num_servers;
+  scoped_refptr<KeyFetchAttempts> attempts(new KeyFetchAttempts);
+  // The attempts still in flight once the request completes are cancelled.
+  ScopedCancel cancel_attempts(attempts->cancellation_token.get());
+  std::vector<bool> in_flight(num_servers, false);
+  size_t num_in_flight = 0;
+  size_t num_attempts = 0;
+  int num_retries = 0;
+  int64_t retry_delay = kFirstRetryDelayMilliseconds;
+  // Set if an attempt, a hedge or a retry, starts at |next_attempt_time|.
+  bool attempt_scheduled = true;
+  base::TimeTicks next_attempt_time = base::TimeTicks::Now();
+  status = Status(error::SERVER_ERROR, kRetriesExhaustedMessage);
+  while (true) {
+    const base::TimeTicks now = base::TimeTicks::Now();
+    if (attempt_scheduled && now >= next_attempt_time) {
+      const size_t server_index = ChooseServer(in_flight);
+      in_flight[server_index] = true;
+      ++num_in_flight;
+      ++num_attempts;
+      StartKeyFetch(server_index, message, attempts);
+      attempt_scheduled =
+          num_in_flight < num_servers && num_attempts < max_attempts;
+      if (attempt_scheduled)
+        next_attempt_time = now + GetHedgeDelay(server_index);
+      continue;
+    }
+    if (num_in_flight == 0 && !attempt_scheduled)
+      return status;
 
-  // Perform client side retries if seeing server transient error to workaround
-  // server limitation.
-  for (int i = 0; i < kNumTransientErrorRetries; ++i) {
-    status = key_fetcher_->FetchKeys(server_url_, message, &raw_response);
-    if (status.ok()) {
-      VLOG(1) << "Retry [" << i << "] Response:" << raw_response;
+    // Waits for a result until the next attempt, cut short if the job
+    // fetching the keys is cancelled.
+    const int64_t timeout_ms =
+        attempt_scheduled ? (next_attempt_time - now).InMillisecondsRoundedUp()
+                          : kInfiniteTimeout;
+    KeyFetchResult result;
+    Status wait_status = attempts->results.Pop(&result, timeout_ms);
+    if (wait_status.error_code() == error::TIME_OUT)
+      continue;
+    if (!wait_status.ok())
+      return wait_status;
+    in_flight[result.server_index] = false;
+    --num_in_flight;
+
+    if (result.status.ok()) {
+      VLOG(1) << "Attempt [" << num_attempts << "] Response from "
+              << server_urls_[result.server_index] << ":"
+              << result.raw_response;
 
       std::string response;
-      if (!DecodeResponse(raw_response, &response)) {
-        return Status(error::SERVER_ERROR,
-                      "Failed to decode response '" + raw_response + "'.");
+      if (!DecodeResponse(result.raw_response, &response)) {
+        return Status(
+            error::SERVER_ERROR,
+            "Failed to decode response '" + result.raw_response + "'.");
       }
 
       bool transient_error = false;
       if (ExtractEncryptionKey(enable_key_rotation,
                                widevine_classic,
                                response,
-                               &transient_error))
+                               encryption_key_map,
+                               &transient_error)) {
+        WriteCachedResponse(request, response);
         return Status::OK;
+      }
 
       if (!transient_error) {
         return Status(
             error::SERVER_ERROR,
             "Failed to extract encryption key from '" + response + "'.");
       }
-    } else if (status.error_code() != error::TIME_OUT) {
-      return status;
+    } else if (result.status.error_code() != error::TIME_OUT) {
+      // The attempts on the other servers may still succeed.
+      status = result.status;
+      if (num_in_flight == 0)
+        return status;
+      continue;
+    }
+
+    // A transient error, retried after a backoff unless a hedge starts
+    // before.
+    status = Status(error::SERVER_ERROR, kRetriesExhaustedMessage);
+    if (num_retries + 1 < kNumTransientErrorRetries &&
+        num_attempts < max_attempts) {
+      ++num_retries;
+      const base::TimeTicks retry_time =
+          base::TimeTicks::Now() +
+          base::TimeDelta::FromMilliseconds(retry_delay);
+      retry_delay *= 2;
+      if (!attempt_scheduled || retry_time < next_attempt_time)
+        next_attempt_time = retry_time;
+      attempt_scheduled = true;
     }
+  }
+}
+
+void WidevineKeySource::StartKeyFetch(
+    size_t server_index,
+    const std::string& message,
+    const scoped_refptr<KeyFetchAttempts>& attempts) {
+  if (!key_fetch_thread_pool_) {
+    RunKeyFetch(server_index, message, attempts);
+    return;
+  }
+  key_fetch_thread_pool_->PostTask(base::Bind(
+      &RunWithCancellationToken, attempts->cancellation_token,
+      base::Bind(&WidevineKeySource::RunKeyFetch, base::Unretained(this),
+                 server_index, message, attempts)));
+}
 
-    // Exponential backoff.
-    if (i != kNumTransientErrorRetries - 1) {
-      base::PlatformThread::Sleep(
-          base::TimeDelta::FromMilliseconds(sleep_duration));
-      sleep_duration *= 2;
+void WidevineKeySource::RunKeyFetch(
+    size_t server_index,
+    const std::string& message,
+    const scoped_refptr<KeyFetchAttempts>& attempts) {
+  const std::string& server_url = server_urls_[server_index];
+  KeyFetchResult result;
+  result.server_index = server_index;
+  base::ElapsedTimer fetch_timer;
+  result.status =
+      key_fetcher_->FetchKeys(server_url, message, &result.raw_response);
+  const base::TimeDelta fetch_time = fetch_timer.Elapsed();
+  {
+    base::AutoLock scoped_lock(stats_lock_);
+    KeyFetchStats::EndpointStats& endpoint_stats =
+        stats_.endpoint_stats[server_url];
+    endpoint_stats.total_fetch_time += fetch_time;
+    endpoint_stats.max_fetch_time =
+        std::max(endpoint_stats.max_fetch_time, fetch_time);
+    if (result.status.ok()) {
+      ++endpoint_stats.num_fetches;
+      endpoint_stats.num_consecutive_failures = 0;
+      ++stats_.num_fetches;
+      stats_.total_fetch_time += fetch_time;
+      stats_.max_fetch_time = std::max(stats_.max_fetch_time, fetch_time);
+    } else {
+      ++endpoint_stats.num_failures;
+      ++endpoint_stats.num_consecutive_failures;
     }
   }
-  return Status(error::SERVER_ERROR,
-                "Failed to recover from server internal error.");
+  // Does not block: the queue is unbounded.
+  attempts->results.Push(result, 0);
+}
+
+size_t WidevineKeySource::ChooseServer(
+    const std::vector<bool>& in_flight) const {
+  base::AutoLock scoped_lock(stats_lock_);
+  size_t best_index = in_flight.size();
+  uint32_t best_failures = 0;
+  base::TimeDelta best_fetch_time;
+  for (size_t i = 0; i < in_flight.size(); ++i) {
+    if (in_flight[i])
+      continue;
+    uint32_t failures = 0;
+    base::TimeDelta fetch_time;
+    std::map<std::string, KeyFetchStats::EndpointStats>::const_iterator iter =
+        stats_.endpoint_stats.find(server_urls_[i]);
+    if (iter != stats_.endpoint_stats.end()) {
+      failures = iter->second.num_consecutive_failures;
+      fetch_time = GetMeanFetchTime(iter->second);
+    }
+    if (best_index == in_flight.size() || failures < best_failures ||
+        (failures == best_failures && fetch_time < best_fetch_time)) {
+      best_index = i;
+      best_failures = failures;
+      best_fetch_time = fetch_time;
+    }
+  }
+  DCHECK_LT(best_index, in_flight.size());
+  return best_index;
+}
+
+base::TimeDelta WidevineKeySource::GetHedgeDelay(size_t server_index) const {
+  base::AutoLock scoped_lock(stats_lock_);
+  std::map<std::string, KeyFetchStats::EndpointStats>::const_iterator iter =
+      stats_.endpoint_stats.find(server_urls_[server_index]);
+  if (iter == stats_.endpoint_stats.end() || iter->second.num_fetches == 0)
+    return base::TimeDelta::FromMilliseconds(kDefaultHedgeDelayMilliseconds);
+  return std::max(
+      base::TimeDelta::FromMilliseconds(kMinHedgeDelayMilliseconds),
+      GetMeanFetchTime(iter->second) * 2);
+}
+
+bool WidevineKeySource::ReadCachedResponse(const std::string& request,
+                                           std::string* response) {
+  DCHECK(response);
+  if (key_cache_dir_.empty())
+    return false;
+  return base::ReadFileToString(
+      base::FilePath::FromUTF8Unsafe(GetCacheFileName(request)), response);
+}
+
+void WidevineKeySource::WriteCachedResponse(const std::string& request,
+                                            const std::string& response) {
+  if (key_cache_dir_.empty())
+    return;
+  // Write to a temporary file first, so other instances sharing the cache
+  // never read a partially written response.
+  const base::FilePath cache_dir =
+      base::FilePath::FromUTF8Unsafe(key_cache_dir_);
+  base::FilePath temp_file_path;
+  if (!base::CreateTemporaryFileInDir(cache_dir, &temp_file_path) ||
+      base::WriteFile(temp_file_path, response.data(), response.size()) !=
+          static_cast<int>(response.size()) ||
+      !base::ReplaceFile(temp_file_path,
+                         base::FilePath::FromUTF8Unsafe(
+                             GetCacheFileName(request)),
+                         NULL)) {
+    LOG(WARNING) << "Failed to cache the key response in " << key_cache_dir_;
+    if (!temp_file_path.empty())
+      base::DeleteFile(temp_file_path, false);
+  }
+}
+
+std::string WidevineKeySource::GetCacheFileName(
+    const std::string& request) const {
+  // The request identifies the content, and the crypto periods with key
+  // rotation. It does not depend on the signer.
+  const std::string hash = base::SHA1HashString(request);
+  return key_cache_dir_ + "/" + base::HexEncode(hash.data(), hash.size()) +
+         ".json";
 }
 
-void WidevineKeySource::FillRequest(bool enable_key_rotation,
+void WidevineKeySource::FillRequest(base::DictionaryValue* request_dict,
+                                    bool enable_key_rotation,
                                     uint32_t first_crypto_period_index,
                                     std::string* request) {
+  DCHECK(request_dict);
   DCHECK(request);
-  DCHECK(!request_dict_.empty());
+  DCHECK(!request_dict->empty());
 
   // Build tracks.
   base::ListValue* tracks = new base::ListValue();
@@ -413,24 +900,24 @@ void WidevineKeySource::FillRequest(bool enable_key_rotation,
   track_audio->SetString("type", "AUDIO");
   tracks->Append(track_audio);
 
-  request_dict_.Set("tracks", tracks);
+  request_dict->Set("tracks", tracks);
 
   // Build DRM types.
   base::ListValue* drm_types = new base::ListValue();
   drm_types->AppendString("WIDEVINE");
-  request_dict_.Set("drm_types", drm_types);
+  request_dict->Set("drm_types", drm_types);
 
   // Build key rotation fields.
   if (enable_key_rotation) {
     // Javascript/JSON does not support int64_t or unsigned numbers. Use double
     // instead as 32-bit integer can be lossless represented using double.
-    request_dict_.SetDouble("first_crypto_period_index",
+    request_dict->SetDouble("first_crypto_period_index",
                             first_crypto_period_index);
-    request_dict_.SetInteger("crypto_period_count", crypto_period_count_);
+    request_dict->SetInteger("crypto_period_count", crypto_period_count_);
   }
 
   base::JSONWriter::WriteWithOptions(
-      request_dict_,
+      *request_dict,
       // Write doubles that have no fractional part as a normal integer, i.e.
       // without using exponential notation or appending a '.0'.
       base::JSONWriter::OPTIONS_OMIT_DOUBLE_TYPE_PRESERVATION, request);
@@ -447,6 +934,7 @@ Status WidevineKeySource::GenerateKeyMessage(const std::string& request,
   request_dict.SetString("request", request_base64_string);
 
   // Sign the request.
+  base::AutoLock scoped_lock(signer_lock_);
   if (signer_) {
     std::string signature;
     if (!signer_->GenerateSignature(request, &signature))
@@ -487,6 +975,7 @@ bool WidevineKeySource::ExtractEncryptionKey(
     bool enable_key_rotation,
     bool widevine_classic,
     const std::string& response,
+    EncryptionKeyMap* non_rotation_key_map,
     bool* transient_error) {
   DCHECK(transient_error);
   *transient_error = false;
@@ -593,7 +1082,9 @@ bool WidevineKeySource::ExtractEncryptionKey(
 
   DCHECK(!encryption_key_map.empty());
   if (!enable_key_rotation) {
-    encryption_key_map_ = encryption_key_map;
+    DCHECK(non_rotation_key_map);
+    STLDeleteValues(non_rotation_key_map);
+    non_rotation_key_map->swap(encryption_key_map);
     return true;
   }
   return PushToKeyPool(&encryption_key_map);
@@ -8,11 +8,14 @@
 #define MEDIA_BASE_WIDEVINE_KEY_SOURCE_H_
 
 #include <map>
+#include <string>
+#include <vector>
 
+#include "packager/base/memory/ref_counted.h"
 #include "packager/base/memory/scoped_ptr.h"
 #include "packager/base/synchronization/waitable_event.h"
+#include "packager/base/time/time.h"
 #include "packager/base/values.h"
-#include "packager/media/base/closure_thread.h"
 #include "packager/media/base/key_source.h"
 
 namespace edash_packager {
@@ -20,11 +23,46 @@ namespace media {
 class KeyFetcher;
 class RequestSigner;
 template <class T> class ProducerConsumerQueue;
+class ThreadPool;
 
 /// WidevineKeySource talks to the Widevine encryption service to
 /// acquire the encryption keys.
 class WidevineKeySource : public KeySource {
  public:
+  /// Statistics of the requests to the key server.
+  struct KeyFetchStats {
+    /// Statistics of the requests to one server of the key service.
+    struct EndpointStats {
+      EndpointStats();
+
+      /// Number of requests which got a response, and which failed.
+      uint32_t num_fetches;
+      uint32_t num_failures;
+      /// Number of failures since the last response.
+      uint32_t num_consecutive_failures;
+      /// Total and maximum latency of the requests, failed or not.
+      base::TimeDelta total_fetch_time;
+      base::TimeDelta max_fetch_time;
+    };
+
+    KeyFetchStats();
+    ~KeyFetchStats();
+
+    /// Number of successful requests to the key server.
+    uint32_t num_fetches;
+    /// Number of requests served from the key cache instead of the server.
+    uint32_t num_cache_hits;
+    /// Total and maximum latency of the successful requests to the server.
+    base::TimeDelta total_fetch_time;
+    base::TimeDelta max_fetch_time;
+    /// Number of times a crypto period key was not prefetched yet when it
+    /// was requested, and the total time spent waiting for these keys.
+    uint32_t num_stalls;
+    base::TimeDelta total_stall_time;
+    /// Statistics of the requests to each server, by url.
+    std::map<std::string, EndpointStats> endpoint_stats;
+  };
+
   /// @param server_url is the Widevine common encryption server url.
   WidevineKeySource(const std::string& server_url, bool add_common_pssh);
 
@@ -42,6 +80,8 @@ class WidevineKeySource : public KeySource {
   Status GetCryptoPeriodKey(uint32_t crypto_period_index,
                             TrackType track_type,
                             EncryptionKey* key) override;
+  void GetKeyFetchStalls(uint32_t* num_stalls,
+                         base::TimeDelta* stall_time) const override;
   /// @}
 
   /// Fetch keys for CENC from the key server.
@@ -51,22 +91,70 @@ class WidevineKeySource : public KeySource {
   Status FetchKeys(const std::vector<uint8_t>& content_id,
                    const std::string& policy);
 
+  /// Fetch the keys of several contents from the key server at once. The
+  /// requests are sent concurrently, reusing the connections to the server,
+  /// instead of one round trip after another.
+  /// The keys of all the contents are then found by GetKey(key_id); use
+  /// SelectContent() to get them by track type, or to rotate them.
+  /// @param content_ids identify the contents.
+  /// @param policy specifies the DRM content rights, for all the contents.
+  /// @return OK if the keys of all the contents are fetched, an error status
+  ///         otherwise.
+  Status FetchKeysForContents(
+      const std::vector<std::vector<uint8_t>>& content_ids,
+      const std::string& policy);
+
+  /// Make the keys of a content fetched by FetchKeysForContents() the keys
+  /// returned by GetKey(track_type), and the content of the crypto period
+  /// keys. Must be called before the first GetCryptoPeriodKey() call.
+  /// @param content_id identifies the content.
+  /// @return OK on success, NOT_FOUND if the keys of the content have not
+  ///         been fetched.
+  Status SelectContent(const std::vector<uint8_t>& content_id);
+
   /// Set signer for the key source.
   /// @param signer signs the request message.
   void set_signer(scoped_ptr<RequestSigner> signer);
 
+  /// Set the number of crypto periods to prefetch keys for, ahead of the
+  /// period being encrypted. Must be called before the first
+  /// GetCryptoPeriodKey() call.
+  /// @param num_crypto_periods is the prefetch window. It is rounded up to
+  ///        half of the number of crypto periods fetched per request.
+  void set_key_prefetch_window(uint32_t num_crypto_periods);
+
+  /// Set a directory to cache the key server responses in. A request made
+  /// before, e.g. by another packager instance packaging the same content, is
+  /// then served from the cache. The cache contains the content keys in the
+  /// clear; access to the directory must be restricted accordingly.
+  /// @param key_cache_dir is a local directory, which must exist.
+  void set_key_cache_dir(const std::string& key_cache_dir);
+
+  /// Send the key requests to other servers of the key service as well. A
+  /// request is hedged: if the server it is sent to does not respond within
+  /// about twice its usual latency, the request is sent to another server
+  /// too, and the first response is used. The failed requests are retried on
+  /// the server with the fewest recent failures, then the lowest latency.
+  /// Must be called before the keys are fetched.
+  /// @param backup_server_urls are the urls of the other servers.
+  void set_backup_server_urls(
+      const std::vector<std::string>& backup_server_urls);
+
+  /// @return The statistics of the requests made so far.
+  KeyFetchStats key_fetch_stats() const;
+
   /// Inject an @b KeyFetcher object, mainly used for testing.
   /// @param key_fetcher points to the @b KeyFetcher object to be injected.
   void set_key_fetcher(scoped_ptr<KeyFetcher> key_fetcher);
 
- protected:
-   ClosureThread key_production_thread_;
-
  private:
   typedef std::map<TrackType, EncryptionKey*> EncryptionKeyMap;
   class RefCountedEncryptionKeyMap;
   typedef ProducerConsumerQueue<scoped_refptr<RefCountedEncryptionKeyMap> >
       EncryptionKeyQueue;
+  struct ContentKeyRequest;
+  struct KeyFetchResult;
+  class KeyFetchAttempts;
 
   // Internal routine for getting keys.
   Status GetKeyInternal(uint32_t crypto_period_index,
@@ -75,15 +163,57 @@ class WidevineKeySource : public KeySource {
 
   // The closure task to fetch keys repeatedly.
   void FetchKeysTask();
+  // Fetches the keys of the next crypto periods until |key_pool_| is stopped
+  // or a fetch fails.
+  void ProduceKeys();
+
+  // Let the signer sign the key rotation request starting at
+  // |first_crypto_period_index| ahead of time.
+  void PrepareKeyRotationRequest(uint32_t first_crypto_period_index);
 
   // Fetch keys from server.
   Status FetchKeysInternal(bool enable_key_rotation,
                            uint32_t first_crypto_period_index,
                            bool widevine_classic);
+  // Fetch keys from server, for the content identified by |request_dict|.
+  // Non key rotation keys are stored in |encryption_key_map|. May be called
+  // concurrently for different requests without key rotation.
+  Status FetchKeysWithRequest(base::DictionaryValue* request_dict,
+                              bool enable_key_rotation,
+                              uint32_t first_crypto_period_index,
+                              bool widevine_classic,
+                              EncryptionKeyMap* encryption_key_map);
+  // Runs the request of one content of FetchKeysForContents().
+  void FetchContentKeys(ContentKeyRequest* content_key_request);
+  // Sends |message| to the server |server_index| of |server_urls_|. The
+  // result is pushed to |attempts|.
+  void StartKeyFetch(size_t server_index,
+                     const std::string& message,
+                     const scoped_refptr<KeyFetchAttempts>& attempts);
+  // Runs a request started by StartKeyFetch().
+  void RunKeyFetch(size_t server_index,
+                   const std::string& message,
+                   const scoped_refptr<KeyFetchAttempts>& attempts);
+  // Returns the server to send the next attempt of a request to, among the
+  // servers |in_flight| is false for.
+  size_t ChooseServer(const std::vector<bool>& in_flight) const;
+  // Returns the time after which a request to server |server_index| is
+  // hedged.
+  base::TimeDelta GetHedgeDelay(size_t server_index) const;
+
+  // Read the response to |request| from the key cache. Returns false if it
+  // is not cached.
+  bool ReadCachedResponse(const std::string& request, std::string* response);
+  // Write the response to |request| to the key cache.
+  void WriteCachedResponse(const std::string& request,
+                           const std::string& response);
+  // Returns the key cache file name of |request|.
+  std::string GetCacheFileName(const std::string& request) const;
 
-  // Fill |request| with necessary fields for Widevine encryption request.
-  // |request| should not be NULL.
-  void FillRequest(bool enable_key_rotation,
+  // Fill |request| with |request_dict| and the other necessary fields for
+  // Widevine encryption request. |request| should not be NULL.
+  void FillRequest(base::DictionaryValue* request_dict,
+                   bool enable_key_rotation,
                    uint32_t first_crypto_period_index,
                    std::string* request);
   // Base64 escape and format the request. Optionally sign the request if a
@@ -93,12 +223,15 @@ class WidevineKeySource : public KeySource {
   // |response| should not be NULL.
   bool DecodeResponse(const std::string& raw_response, std::string* response);
   // Extract encryption key from |response|, which is expected to be properly
-  // formatted. |transient_error| will be set to true if it fails and the
-  // failure is because of a transient error from the server. |transient_error|
-  // should not be NULL.
+  // formatted. Non key rotation keys replace the keys in
+  // |non_rotation_key_map|; key rotation keys are pushed to the key pool.
+  // |transient_error| will be set to true if it fails and the failure is
+  // because of a transient error from the server. |transient_error| should not
+  // be NULL.
   bool ExtractEncryptionKey(bool enable_key_rotation,
                             bool widevine_classic,
                             const std::string& response,
+                            EncryptionKeyMap* non_rotation_key_map,
                             bool* transient_error);
   // Push the keys to the key pool.
   bool PushToKeyPool(EncryptionKeyMap* encryption_key_map);
@@ -107,20 +240,36 @@ class WidevineKeySource : public KeySource {
   // It is initialized to a default fetcher on class initialization.
   // Can be overridden using set_key_fetcher for testing or other purposes.
   scoped_ptr<KeyFetcher> key_fetcher_;
-  std::string server_url_;
+  // The servers of the key service; the first one is the main server.
+  std::vector<std::string> server_urls_;
+  // Runs the requests when there are several servers, so that they can be
+  // hedged. NULL otherwise: the requests run in the calling thread.
+  scoped_ptr<ThreadPool> key_fetch_thread_pool_;
   scoped_ptr<RequestSigner> signer_;
+  // Serializes the uses of |signer_| by concurrent requests.
+  base::Lock signer_lock_;
   base::DictionaryValue request_dict_;
 
   const uint32_t crypto_period_count_;
+  uint32_t key_prefetch_window_;
+  std::string key_cache_dir_;
   base::Lock lock_;
   bool add_common_pssh_;
   bool key_production_started_;
-  base::WaitableEvent start_key_production_;
+  // Signaled once the key production, which runs on a reserved thread of the
+  // key fetch queue of the BackgroundExecutor, exits.
+  base::WaitableEvent key_production_done_;
   uint32_t first_crypto_period_index_;
   scoped_ptr<EncryptionKeyQueue> key_pool_;
   EncryptionKeyMap encryption_key_map_;  // For non key rotation request.
+  // Keys fetched by FetchKeysForContents(), by content id.
+  std::map<std::vector<uint8_t>, EncryptionKeyMap> content_key_maps_;
+  std::string content_policy_;
   Status common_encryption_request_status_;
 
+  mutable base::Lock stats_lock_;
+  KeyFetchStats stats_;
+
   DISALLOW_COPY_AND_ASSIGN(WidevineKeySource);
 };
 
@@ -10,8 +10,10 @@
 #include <algorithm>
 
 #include "packager/base/base64.h"
+#include "packager/base/files/scoped_temp_dir.h"
 #include "packager/base/strings/string_number_conversions.h"
 #include "packager/base/strings/stringprintf.h"
+#include "packager/base/synchronization/waitable_event.h"
 #include "packager/media/base/fixed_key_source.h"
 #include "packager/media/base/key_fetcher.h"
 #include "packager/media/base/request_signer.h"
@@ -21,6 +23,7 @@
 using ::testing::_;
 using ::testing::DoAll;
 using ::testing::InSequence;
+using ::testing::InvokeWithoutArgs;
 using ::testing::Return;
 using ::testing::SetArgPointee;
 using ::testing::StrEq;
@@ -28,6 +31,7 @@ using ::testing::StrEq;
 namespace edash_packager {
 namespace {
 const char kServerUrl[] = "http://www.foo.com/getcontentkey";
+const char kBackupServerUrl[] = "http://backup.foo.com/getcontentkey";
 const char kContentId[] = "ContentFoo";
 const char kPolicy[] = "PolicyFoo";
 const char kSignerName[] = "SignerFoo";
@@ -281,6 +285,89 @@ TEST_P(WidevineKeySourceTest, LicenseStatusCencOK) {
   VerifyKeys(false);
 }
 
+TEST_P(WidevineKeySourceTest, KeyCache) {
+  base::ScopedTempDir cache_dir;
+  ASSERT_TRUE(cache_dir.CreateUniqueTempDir());
+  std::string mock_response = base::StringPrintf(
+      kHttpResponseFormat, Base64Encode(GenerateMockLicenseResponse()).c_str());
+  EXPECT_CALL(*mock_key_fetcher_, FetchKeys(_, _, _))
+      .WillOnce(DoAll(SetArgPointee<2>(mock_response), Return(Status::OK)));
+
+  CreateWidevineKeySource();
+  widevine_key_source_->set_key_cache_dir(cache_dir.path().AsUTF8Unsafe());
+  ASSERT_OK(widevine_key_source_->FetchKeys(content_id_, kPolicy));
+  VerifyKeys(false);
+  WidevineKeySource::KeyFetchStats stats =
+      widevine_key_source_->key_fetch_stats();
+  EXPECT_EQ(1u, stats.num_fetches);
+  EXPECT_EQ(0u, stats.num_cache_hits);
+
+  // Another key source requesting the same keys is served from the cache.
+  scoped_ptr<MockKeyFetcher> mock_key_fetcher(new MockKeyFetcher());
+  EXPECT_CALL(*mock_key_fetcher, FetchKeys(_, _, _)).Times(0);
+  widevine_key_source_.reset(new WidevineKeySource(kServerUrl, GetParam()));
+  widevine_key_source_->set_key_fetcher(mock_key_fetcher.Pass());
+  widevine_key_source_->set_key_cache_dir(cache_dir.path().AsUTF8Unsafe());
+  ASSERT_OK(widevine_key_source_->FetchKeys(content_id_, kPolicy));
+  VerifyKeys(false);
+  stats = widevine_key_source_->key_fetch_stats();
+  EXPECT_EQ(0u, stats.num_fetches);
+  EXPECT_EQ(1u, stats.num_cache_hits);
+}
+
+TEST_P(WidevineKeySourceTest, FetchKeysForContents) {
+  const char* const kContentIds[] = {"ContentA", "ContentB", "ContentC"};
+  std::string mock_response = base::StringPrintf(
+      kHttpResponseFormat, Base64Encode(GenerateMockLicenseResponse()).c_str());
+  std::vector<std::vector<uint8_t>> content_ids;
+  for (const char* content_id : kContentIds) {
+    content_ids.push_back(std::vector<uint8_t>(
+        content_id, content_id + strlen(content_id)));
+    std::string expected_message = base::StringPrintf(
+        kExpectedRequestMessageFormat, Base64Encode(content_id).c_str(),
+        kPolicy);
+    std::string expected_post_data = base::StringPrintf(
+        "{\"request\":\"%s\"}", Base64Encode(expected_message).c_str());
+    EXPECT_CALL(*mock_key_fetcher_, FetchKeys(_, expected_post_data, _))
+        .WillOnce(DoAll(SetArgPointee<2>(mock_response), Return(Status::OK)));
+  }
+
+  CreateWidevineKeySource();
+  ASSERT_OK(widevine_key_source_->FetchKeysForContents(content_ids, kPolicy));
+
+  const std::string key_id = GetMockKeyId("SD");
+  EncryptionKey encryption_key;
+  ASSERT_OK(widevine_key_source_->GetKey(
+      std::vector<uint8_t>(key_id.begin(), key_id.end()), &encryption_key));
+  EXPECT_EQ(GetMockKey("SD"), ToString(encryption_key.key));
+
+  for (const std::vector<uint8_t>& content_id : content_ids) {
+    ASSERT_OK(widevine_key_source_->SelectContent(content_id));
+    VerifyKeys(false);
+  }
+  EXPECT_EQ(error::NOT_FOUND,
+            widevine_key_source_->SelectContent(content_id_).error_code());
+}
+
+TEST_P(WidevineKeySourceTest, FetchKeysForContentsFailure) {
+  const char* const kContentIds[] = {"ContentA", "ContentB"};
+  std::vector<std::vector<uint8_t>> content_ids;
+  for (const char* content_id : kContentIds) {
+    content_ids.push_back(std::vector<uint8_t>(
+        content_id, content_id + strlen(content_id)));
+  }
+  const Status kMockStatus = Status(error::SERVER_ERROR, "mock error");
+  EXPECT_CALL(*mock_key_fetcher_, FetchKeys(_, _, _))
+      .Times(2)
+      .WillRepeatedly(Return(kMockStatus));
+
+  CreateWidevineKeySource();
+  EXPECT_EQ(kMockStatus,
+            widevine_key_source_->FetchKeysForContents(content_ids, kPolicy));
+  EXPECT_EQ(error::NOT_FOUND,
+            widevine_key_source_->SelectContent(content_ids[0]).error_code());
+}
+
 TEST_P(WidevineKeySourceTest, LicenseStatusCencNotOK) {
   std::string mock_response = base::StringPrintf(
       kHttpResponseFormat, Base64Encode(
@@ -408,6 +495,55 @@ TEST_P(WidevineKeySourceTest, NoRetryOnUnknownError) {
             widevine_key_source_->FetchKeys(content_id_, kPolicy).error_code());
 }
 
+TEST_P(WidevineKeySourceTest, RetryOnBackupServer) {
+  std::string mock_response = base::StringPrintf(
+      kHttpResponseFormat, Base64Encode(GenerateMockLicenseResponse()).c_str());
+
+  // The retry goes to the server which did not fail.
+  EXPECT_CALL(*mock_key_fetcher_, FetchKeys(StrEq(kServerUrl), _, _))
+      .WillOnce(Return(Status(error::TIME_OUT, "")));
+  EXPECT_CALL(*mock_key_fetcher_, FetchKeys(StrEq(kBackupServerUrl), _, _))
+      .WillOnce(DoAll(SetArgPointee<2>(mock_response), Return(Status::OK)));
+
+  CreateWidevineKeySource();
+  widevine_key_source_->set_backup_server_urls(
+      std::vector<std::string>(1, kBackupServerUrl));
+  ASSERT_OK(widevine_key_source_->FetchKeys(content_id_, kPolicy));
+  VerifyKeys(false);
+
+  WidevineKeySource::KeyFetchStats stats =
+      widevine_key_source_->key_fetch_stats();
+  EXPECT_EQ(1u, stats.endpoint_stats[kServerUrl].num_failures);
+  EXPECT_EQ(1u, stats.endpoint_stats[kBackupServerUrl].num_fetches);
+}
+
+TEST_P(WidevineKeySourceTest, HedgeSlowRequest) {
+  std::string mock_response = base::StringPrintf(
+      kHttpResponseFormat, Base64Encode(GenerateMockLicenseResponse()).c_str());
+
+  // The request to the main server hangs until the end of the test, so the
+  // keys come from the hedged request to the backup server.
+  base::WaitableEvent release_request(true, false);
+  EXPECT_CALL(*mock_key_fetcher_, FetchKeys(StrEq(kServerUrl), _, _))
+      .WillOnce(DoAll(InvokeWithoutArgs(&release_request,
+                                        &base::WaitableEvent::Wait),
+                      Return(Status(error::TIME_OUT, ""))));
+  EXPECT_CALL(*mock_key_fetcher_, FetchKeys(StrEq(kBackupServerUrl), _, _))
+      .WillOnce(DoAll(SetArgPointee<2>(mock_response), Return(Status::OK)));
+
+  CreateWidevineKeySource();
+  widevine_key_source_->set_backup_server_urls(
+      std::vector<std::string>(1, kBackupServerUrl));
+  ASSERT_OK(widevine_key_source_->FetchKeys(content_id_, kPolicy));
+  VerifyKeys(false);
+  EXPECT_EQ(1u, widevine_key_source_->key_fetch_stats()
+                    .endpoint_stats[kBackupServerUrl]
+                    .num_fetches);
+
+  release_request.Signal();
+  widevine_key_source_.reset();
+}
+
 namespace {
 
 const char kCryptoPeriodRequestMessageFormat[] =
@@ -514,6 +650,63 @@ TEST_P(WidevineKeySourceTest, KeyRotationTest) {
   EXPECT_EQ(error::INVALID_ARGUMENT, status.error_code());
 }
 
+TEST_P(WidevineKeySourceTest, KeyRotationPrefetchWindow) {
+  const uint32_t kCryptoPeriodCount = 10;
+  const uint32_t kPrefetchWindow = 20;
+  // The pool holds twice the window, i.e. four requests. The fifth one
+  // blocks until the keys are released.
+  const uint32_t kNumRequests = 5;
+
+  InSequence dummy;
+  EXPECT_CALL(*mock_key_fetcher_, FetchKeys(_, _, _))
+      .WillOnce(DoAll(SetArgPointee<2>(base::StringPrintf(
+                          kHttpResponseFormat,
+                          Base64Encode(GenerateMockLicenseResponse()).c_str())),
+                      Return(Status::OK)));
+  // The key source may be destroyed before the last requests are made.
+  auto& rotation_fetches =
+      EXPECT_CALL(*mock_key_fetcher_, FetchKeys(_, _, _))
+          .Times(::testing::Between(2, static_cast<int>(kNumRequests)));
+  for (uint32_t i = 0; i < kNumRequests; ++i) {
+    std::string mock_response = base::StringPrintf(
+        kHttpResponseFormat,
+        Base64Encode(GenerateMockKeyRotationLicenseResponse(
+                         i * kCryptoPeriodCount, kCryptoPeriodCount))
+            .c_str());
+    rotation_fetches.WillOnce(
+        DoAll(SetArgPointee<2>(mock_response), Return(Status::OK)));
+  }
+
+  CreateWidevineKeySource();
+  widevine_key_source_->set_key_prefetch_window(kPrefetchWindow);
+  ASSERT_OK(widevine_key_source_->FetchKeys(content_id_, kPolicy));
+
+  // Start key production at the first crypto period, and wait until the keys
+  // of the window are fetched; they are then served without stalling.
+  EncryptionKey encryption_key;
+  ASSERT_OK(widevine_key_source_->GetCryptoPeriodKey(
+      0, KeySource::TRACK_TYPE_SD, &encryption_key));
+  ASSERT_OK(widevine_key_source_->GetCryptoPeriodKey(
+      kPrefetchWindow - 1, KeySource::TRACK_TYPE_SD, &encryption_key));
+  const uint32_t num_stalls =
+      widevine_key_source_->key_fetch_stats().num_stalls;
+  EXPECT_LE(num_stalls, 2u);
+  for (uint32_t index = 0; index < kPrefetchWindow; ++index) {
+    ASSERT_OK(widevine_key_source_->GetCryptoPeriodKey(
+        index, KeySource::TRACK_TYPE_SD, &encryption_key));
+    EXPECT_EQ(GetMockKey("SD", index), ToString(encryption_key.key));
+  }
+  EXPECT_EQ(num_stalls, widevine_key_source_->key_fetch_stats().num_stalls);
+
+  uint32_t reported_num_stalls = 0;
+  base::TimeDelta reported_stall_time;
+  widevine_key_source_->GetKeyFetchStalls(&reported_num_stalls,
+                                          &reported_stall_time);
+  EXPECT_EQ(num_stalls, reported_num_stalls);
+  EXPECT_EQ(widevine_key_source_->key_fetch_stats().total_stall_time,
+            reported_stall_time);
+}
+
 INSTANTIATE_TEST_CASE_P(WidevineKeySourceInstance,
                         WidevineKeySourceTest,
                         ::testing::Bool());
@@ -51,6 +51,7 @@ void HlsNotifyMuxerListener::OnMediaStart(const MuxerOptions& muxer_options,
       media_info, playlist_name_, muxer_options.hls_name,
       muxer_options.hls_group_id, &stream_id_);
   LOG_IF(WARNING, !result) << "Failed to notify new stream.";
+  single_segment_ = muxer_options.single_segment;
 }
 
 void HlsNotifyMuxerListener::OnSampleDurationReady(uint32_t sample_duration) {
@@ -64,6 +65,33 @@ void HlsNotifyMuxerListener::OnMediaEnd(bool has_init_range,
                                         uint64_t index_range_end,
                                         float duration_seconds,
                                         uint64_t file_size) {
+  if (!pending_segments_.empty()) {
+    // The segments are at the end of the file, after the headers.
+    uint64_t segments_size = 0;
+    for (const SegmentInfo& segment : pending_segments_)
+      segments_size += segment.size;
+    if (segments_size > file_size) {
+      LOG(WARNING) << "The segments of " << segments_size
+                   << " bytes do not fit in the file of " << file_size
+                   << " bytes.";
+      segments_size = file_size;
+    }
+    uint64_t start_byte_offset = file_size - segments_size;
+    for (const SegmentInfo& segment : pending_segments_) {
+      for (const KeyFrameInfo& key_frame : segment.key_frames) {
+        const bool result = hls_notifier_->NotifyKeyFrame(
+            stream_id_, key_frame.timestamp,
+            start_byte_offset + key_frame.start_byte_offset, key_frame.size);
+        LOG_IF(WARNING, !result) << "Failed to add key frame.";
+      }
+      const bool result = hls_notifier_->NotifyNewSegment(
+          stream_id_, segment.file_name, segment.start_time, segment.duration,
+          start_byte_offset, segment.size);
+      LOG_IF(WARNING, !result) << "Failed to add new segment.";
+      start_byte_offset += segment.size;
+    }
+    pending_segments_.clear();
+  }
   const bool result = hls_notifier_->Flush();
   LOG_IF(WARNING, !result) << "Failed to flush.";
 }
@@ -71,11 +99,57 @@ void HlsNotifyMuxerListener::OnMediaEnd(bool has_init_range,
 void HlsNotifyMuxerListener::OnNewSegment(const std::string& file_name,
                                           uint64_t start_time,
                                           uint64_t duration,
-                                          uint64_t segment_file_size) {
+                                          uint64_t segment_file_size,
+                                          const std::string& checksum) {
+  if (single_segment_) {
+    SegmentInfo segment;
+    segment.file_name = file_name;
+    segment.start_time = start_time;
+    segment.duration = duration;
+    segment.size = segment_file_size;
+    segment.key_frames.swap(pending_key_frames_);
+    pending_segments_.push_back(segment);
+    return;
+  }
+  const uint64_t kStartByteOffset = 0;
   const bool result = hls_notifier_->NotifyNewSegment(
-      stream_id_, file_name, start_time, duration, segment_file_size);
+      stream_id_, file_name, start_time, duration, kStartByteOffset,
+      segment_file_size);
   LOG_IF(WARNING, !result) << "Failed to add new segment.";
 }
 
+void HlsNotifyMuxerListener::OnNewChunk(const std::string& segment_name,
+                                        uint64_t start_time,
+                                        uint64_t duration,
+                                        uint64_t chunk_size) {
+  const bool result = hls_notifier_->NotifyNewPart(
+      stream_id_, segment_name, start_time, duration, chunk_size);
+  LOG_IF(WARNING, !result) << "Failed to add new part.";
+}
+
+void HlsNotifyMuxerListener::OnKeyFrame(uint64_t timestamp,
+                                        uint64_t start_byte_offset,
+                                        uint64_t size) {
+  if (single_segment_) {
+    KeyFrameInfo key_frame;
+    key_frame.timestamp = timestamp;
+    key_frame.start_byte_offset = start_byte_offset;
+    key_frame.size = size;
+    pending_key_frames_.push_back(key_frame);
+    return;
+  }
+  const bool result = hls_notifier_->NotifyKeyFrame(
+      stream_id_, timestamp, start_byte_offset, size);
+  LOG_IF(WARNING, !result) << "Failed to add key frame.";
+}
+
+void HlsNotifyMuxerListener::OnTimedMetadata(
+    const TimedMetadataEvent& event) {
+  // The playlist places the event by its time, so it does not wait for the
+  // segments which are buffered.
+  const bool result = hls_notifier_->NotifyTimedMetadata(stream_id_, event);
+  LOG_IF(WARNING, !result) << "Failed to add timed metadata.";
+}
+
 }  // namespace media
 }  // namespace edash_packager
@@ -8,6 +8,7 @@
 #define PACKAGER_MEDIA_EVENT_HLS_NOTIFY_MUXER_LISTENER_H_
 
 #include <string>
+#include <vector>
 
 #include "packager/base/macros.h"
 #include "packager/media/event/muxer_listener.h"
@@ -53,14 +54,45 @@ class HlsNotifyMuxerListener : public MuxerListener {
   void OnNewSegment(const std::string& file_name,
                     uint64_t start_time,
                     uint64_t duration,
-                    uint64_t segment_file_size) override;
+                    uint64_t segment_file_size,
+                    const std::string& checksum) override;
+  void OnNewChunk(const std::string& segment_name,
+                  uint64_t start_time,
+                  uint64_t duration,
+                  uint64_t chunk_size) override;
+  void OnKeyFrame(uint64_t timestamp,
+                  uint64_t start_byte_offset,
+                  uint64_t size) override;
+  void OnTimedMetadata(const TimedMetadataEvent& event) override;
   /// @}
 
  private:
+  struct KeyFrameInfo {
+    uint64_t timestamp;
+    uint64_t start_byte_offset;
+    uint64_t size;
+  };
+  struct SegmentInfo {
+    std::string file_name;
+    uint64_t start_time;
+    uint64_t duration;
+    uint64_t size;
+    std::vector<KeyFrameInfo> key_frames;
+  };
+
   const std::string playlist_name_;
   hls::HlsNotifier* const hls_notifier_;
   uint32_t stream_id_ = 0;
 
+  // If the segments are all in one file, their byte ranges in the file are
+  // only known once the headers are written, in OnMediaEnd(). Until then, the
+  // segments and the key frames are kept here, with the offsets relative to
+  // their segment.
+  bool single_segment_ = false;
+  std::vector<SegmentInfo> pending_segments_;
+  // The key frames of the next segment, if the segments are buffered.
+  std::vector<KeyFrameInfo> pending_key_frames_;
+
   DISALLOW_COPY_AND_ASSIGN(HlsNotifyMuxerListener);
 };
 
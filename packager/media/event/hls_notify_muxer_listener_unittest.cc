@@ -10,12 +10,14 @@
 #include "packager/hls/base/hls_notifier.h"
 #include "packager/media/base/muxer_options.h"
 #include "packager/media/base/protection_system_specific_info.h"
+#include "packager/media/base/timed_metadata.h"
 #include "packager/media/event/hls_notify_muxer_listener.h"
 #include "packager/media/event/muxer_listener_test_helper.h"
 
 namespace edash_packager {
 namespace media {
 
+using ::testing::InSequence;
 using ::testing::Return;
 using ::testing::StrEq;
 using ::testing::_;
@@ -34,7 +36,22 @@ class MockHlsNotifier : public hls::HlsNotifier {
                     const std::string& name,
                     const std::string& group_id,
                     uint32_t* stream_id));
-  MOCK_METHOD5(NotifyNewSegment,
+  MOCK_METHOD6(NotifyNewSegment,
+               bool(uint32_t stream_id,
+                    const std::string& segment_name,
+                    uint64_t start_time,
+                    uint64_t duration,
+                    uint64_t start_byte_offset,
+                    uint64_t size));
+  MOCK_METHOD4(NotifyKeyFrame,
+               bool(uint32_t stream_id,
+                    uint64_t timestamp,
+                    uint64_t start_byte_offset,
+                    uint64_t size));
+  MOCK_METHOD2(NotifyTimedMetadata,
+               bool(uint32_t stream_id,
+                    const media::TimedMetadataEvent& event));
+  MOCK_METHOD5(NotifyNewPart,
                bool(uint32_t stream_id,
                     const std::string& segment_name,
                     uint64_t start_time,
@@ -133,9 +150,73 @@ TEST_F(HlsNotifyMuxerListenerTest, OnNewSegment) {
   const uint64_t kFileSize = 756739;
   EXPECT_CALL(mock_notifier_,
               NotifyNewSegment(_, StrEq("new_segment_name10.ts"), kStartTime,
-                               kDuration, kFileSize));
+                               kDuration, 0, kFileSize));
   listener_.OnNewSegment("new_segment_name10.ts", kStartTime, kDuration,
-                         kFileSize);
+                         kFileSize, "");
+}
+
+TEST_F(HlsNotifyMuxerListenerTest, OnKeyFrame) {
+  const uint64_t kTimestamp = 19283;
+  const uint64_t kStartByteOffset = 376;
+  const uint64_t kSize = 35720;
+  EXPECT_CALL(mock_notifier_,
+              NotifyKeyFrame(_, kTimestamp, kStartByteOffset, kSize));
+  listener_.OnKeyFrame(kTimestamp, kStartByteOffset, kSize);
+}
+
+// Verify that the segments of a single file are notified at the end of the
+// media, with their byte ranges in the file.
+TEST_F(HlsNotifyMuxerListenerTest, SingleSegmentByteRanges) {
+  MuxerOptions muxer_options;
+  SetDefaultMuxerOptionsValues(&muxer_options);
+  ASSERT_TRUE(muxer_options.single_segment);
+  scoped_refptr<StreamInfo> video_stream_info =
+      CreateVideoStreamInfo(GetDefaultVideoStreamInfoParams());
+  EXPECT_CALL(mock_notifier_, NotifyNewStream(_, _, _, _, _))
+      .WillOnce(Return(true));
+  listener_.OnMediaStart(muxer_options, *video_stream_info, 90000,
+                         MuxerListener::kContainerMp4);
+
+  const uint64_t kHeaderSize = 1000;
+  const uint64_t kSegmentSize1 = 30000;
+  const uint64_t kSegmentSize2 = 20000;
+  const uint64_t kKeyFrameOffset = 200;
+  const uint64_t kKeyFrameSize = 8000;
+  {
+    InSequence s;
+    EXPECT_CALL(mock_notifier_,
+                NotifyKeyFrame(_, 0, kHeaderSize + kKeyFrameOffset,
+                               kKeyFrameSize));
+    EXPECT_CALL(mock_notifier_,
+                NotifyNewSegment(_, StrEq("output.mp4"), 0, 180000,
+                                 kHeaderSize, kSegmentSize1));
+    EXPECT_CALL(mock_notifier_,
+                NotifyKeyFrame(_, 180000,
+                               kHeaderSize + kSegmentSize1 + kKeyFrameOffset,
+                               kKeyFrameSize));
+    EXPECT_CALL(mock_notifier_,
+                NotifyNewSegment(_, StrEq("output.mp4"), 180000, 180000,
+                                 kHeaderSize + kSegmentSize1, kSegmentSize2));
+    EXPECT_CALL(mock_notifier_, Flush()).WillOnce(Return(true));
+  }
+
+  listener_.OnKeyFrame(0, kKeyFrameOffset, kKeyFrameSize);
+  listener_.OnNewSegment("output.mp4", 0, 180000, kSegmentSize1, "");
+  listener_.OnKeyFrame(180000, kKeyFrameOffset, kKeyFrameSize);
+  listener_.OnNewSegment("output.mp4", 180000, 180000, kSegmentSize2, "");
+  listener_.OnMediaEnd(true, 0, 799, true, 800, kHeaderSize - 1, 4.0f,
+                       kHeaderSize + kSegmentSize1 + kSegmentSize2);
+}
+
+TEST_F(HlsNotifyMuxerListenerTest, OnNewChunk) {
+  const uint64_t kStartTime = 19283;
+  const uint64_t kDuration = 9802;
+  const uint64_t kChunkSize = 75673;
+  EXPECT_CALL(mock_notifier_,
+              NotifyNewPart(_, StrEq("new_segment_name10.mp4"), kStartTime,
+                            kDuration, kChunkSize));
+  listener_.OnNewChunk("new_segment_name10.mp4", kStartTime, kDuration,
+                       kChunkSize);
 }
 
 }  // namespace media
@@ -15,11 +15,15 @@
       'sources': [
         'hls_notify_muxer_listener.cc',
         'hls_notify_muxer_listener.h',
+        'merging_muxer_listener.cc',
+        'merging_muxer_listener.h',
         'mpd_notify_muxer_listener.cc',
         'mpd_notify_muxer_listener.h',
         'muxer_listener.h',
         'muxer_listener_internal.cc',
         'muxer_listener_internal.h',
+        'packaging_checkpoint.cc',
+        'packaging_checkpoint.h',
         'vod_media_info_dump_muxer_listener.cc',
         'vod_media_info_dump_muxer_listener.h',
       ],
@@ -30,6 +34,21 @@
         '../base/media_base.gyp:media_base',
         '../file/file.gyp:file',
         '../filters/filters.gyp:filters',
+        'packaging_checkpoint_proto',
+      ],
+    },
+    {
+      'target_name': 'packaging_checkpoint_proto',
+      'type': 'static_library',
+      'sources': ['packaging_checkpoint.proto'],
+      'variables': {
+        'proto_in_dir': '.',
+        'proto_out_dir': 'packager/media/event',
+      },
+      'includes': ['../../build/protoc.gypi'],
+      'dependencies': [
+        # Full protobuf, to read and write the checkpoint with TextFormat.
+        '../../third_party/protobuf/protobuf.gyp:protobuf_full_do_not_use',
       ],
     },
     {
@@ -49,9 +68,11 @@
       'type': '<(gtest_target_type)',
       'sources': [
         'hls_notify_muxer_listener_unittest.cc',
+        'merging_muxer_listener_unittest.cc',
         'mpd_notify_muxer_listener_unittest.cc',
         'muxer_listener_test_helper.cc',
         'muxer_listener_test_helper.h',
+        'packaging_checkpoint_unittest.cc',
         'vod_media_info_dump_muxer_listener_unittest.cc',
       ],
       'dependencies': [
@@ -64,6 +85,7 @@
         '../../third_party/protobuf/protobuf.gyp:protobuf_full_do_not_use',
         '../test/media_test.gyp:run_tests_with_atexit_manager',
         'media_event',
+        'mock_muxer_listener',
       ],
     },
   ],
@@ -0,0 +1,271 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/event/merging_muxer_listener.h"
+
+#include "packager/base/logging.h"
+
+namespace edash_packager {
+namespace media {
+
+class MergingMuxerListener::PartListener : public MuxerListener {
+ public:
+  // |listener| is the listener of the stream if this is the first part, and
+  // NULL otherwise.
+  PartListener(MuxerListener* listener, Part* part)
+      : listener_(listener), part_(part) {}
+  ~PartListener() override {}
+
+  void OnEncryptionInfoReady(bool is_initial_encryption_info,
+                             FourCC protection_scheme,
+                             const std::vector<uint8_t>& key_id,
+                             const std::vector<uint8_t>& iv,
+                             const std::vector<ProtectionSystemSpecificInfo>&
+                                 key_system_info) override {
+    if (listener_) {
+      listener_->OnEncryptionInfoReady(is_initial_encryption_info,
+                                       protection_scheme, key_id, iv,
+                                       key_system_info);
+    }
+  }
+
+  void OnMediaStart(const MuxerOptions& muxer_options,
+                    const StreamInfo& stream_info,
+                    uint32_t time_scale,
+                    ContainerType container_type) override {
+    if (listener_) {
+      listener_->OnMediaStart(muxer_options, stream_info, time_scale,
+                              container_type);
+    }
+  }
+
+  void OnSampleDurationReady(uint32_t sample_duration) override {
+    if (listener_)
+      listener_->OnSampleDurationReady(sample_duration);
+  }
+
+  void OnMediaEnd(bool has_init_range,
+                  uint64_t init_range_start,
+                  uint64_t init_range_end,
+                  bool has_index_range,
+                  uint64_t index_range_start,
+                  uint64_t index_range_end,
+                  float duration_seconds,
+                  uint64_t file_size) override {
+    MediaEnd& media_end = part_->media_end;
+    media_end.received = true;
+    media_end.has_init_range = has_init_range;
+    media_end.init_range_start = init_range_start;
+    media_end.init_range_end = init_range_end;
+    media_end.has_index_range = has_index_range;
+    media_end.index_range_start = index_range_start;
+    media_end.index_range_end = index_range_end;
+    media_end.duration_seconds = duration_seconds;
+    media_end.file_size = file_size;
+  }
+
+  void OnNewSegment(const std::string& segment_name,
+                    uint64_t start_time,
+                    uint64_t duration,
+                    uint64_t segment_file_size,
+                    const std::string& checksum) override {
+    if (listener_) {
+      listener_->OnNewSegment(segment_name, start_time, duration,
+                              segment_file_size, checksum);
+      return;
+    }
+    Segment segment;
+    segment.name = segment_name;
+    segment.start_time = start_time;
+    segment.duration = duration;
+    segment.file_size = segment_file_size;
+    segment.checksum = checksum;
+    segment.key_frames.swap(key_frames_);
+    segment.timed_metadata.swap(timed_metadata_);
+    part_->segments.push_back(segment);
+  }
+
+  void OnNewChunk(const std::string& segment_name,
+                  uint64_t start_time,
+                  uint64_t duration,
+                  uint64_t chunk_size) override {
+    // Buffered parts are only reported once they are complete, so their
+    // chunks are dropped.
+    if (listener_)
+      listener_->OnNewChunk(segment_name, start_time, duration, chunk_size);
+  }
+
+  void OnKeyFrame(uint64_t timestamp,
+                  uint64_t start_byte_offset,
+                  uint64_t size) override {
+    if (listener_) {
+      listener_->OnKeyFrame(timestamp, start_byte_offset, size);
+      return;
+    }
+    KeyFrame key_frame;
+    key_frame.timestamp = timestamp;
+    key_frame.start_byte_offset = start_byte_offset;
+    key_frame.size = size;
+    key_frames_.push_back(key_frame);
+  }
+
+  void OnTimedMetadata(const TimedMetadataEvent& event) override {
+    if (listener_) {
+      listener_->OnTimedMetadata(event);
+      return;
+    }
+    timed_metadata_.push_back(event);
+  }
+
+ private:
+  MuxerListener* const listener_;
+  Part* const part_;
+  // The key frames and the timed metadata of the segment in progress.
+  std::vector<KeyFrame> key_frames_;
+  std::vector<TimedMetadataEvent> timed_metadata_;
+
+  DISALLOW_COPY_AND_ASSIGN(PartListener);
+};
+
+MergingMuxerListener::MediaEnd::MediaEnd()
+    : received(false),
+      has_init_range(false),
+      init_range_start(0),
+      init_range_end(0),
+      has_index_range(false),
+      index_range_start(0),
+      index_range_end(0),
+      duration_seconds(0),
+      file_size(0) {}
+MergingMuxerListener::MediaEnd::~MediaEnd() {}
+
+MergingMuxerListener::Part::Part() {}
+MergingMuxerListener::Part::~Part() {}
+
+MergingMuxerListener::MergingMuxerListener(scoped_ptr<MuxerListener> listener,
+                                           size_t num_parts)
+    : listener_(listener.Pass()), parts_(num_parts) {
+  DCHECK(listener_);
+  DCHECK_GT(num_parts, 0u);
+}
+
+MergingMuxerListener::~MergingMuxerListener() {}
+
+scoped_ptr<MuxerListener> MergingMuxerListener::CreatePartListener(
+    size_t part_index) {
+  DCHECK_LT(part_index, parts_.size());
+  return scoped_ptr<MuxerListener>(new PartListener(
+      part_index == 0 ? listener_.get() : NULL, &parts_[part_index]));
+}
+
+void MergingMuxerListener::Flush() {
+  float duration_seconds = 0;
+  for (size_t i = 0; i < parts_.size(); ++i) {
+    const Part& part = parts_[i];
+    for (const Segment& segment : part.segments) {
+      for (const TimedMetadataEvent& event : segment.timed_metadata)
+        listener_->OnTimedMetadata(event);
+      for (const KeyFrame& key_frame : segment.key_frames) {
+        listener_->OnKeyFrame(key_frame.timestamp, key_frame.start_byte_offset,
+                              key_frame.size);
+      }
+      listener_->OnNewSegment(segment.name, segment.start_time,
+                              segment.duration, segment.file_size,
+                              segment.checksum);
+    }
+    if (!part.media_end.received) {
+      LOG(ERROR) << "Part " << i << " of the stream did not end.";
+      return;
+    }
+    duration_seconds += part.media_end.duration_seconds;
+    // Only the first part writes the init segment, see the header.
+    DCHECK(i == 0 || part.media_end.file_size == 0)
+        << "Part " << i << " wrote the init segment.";
+  }
+
+  const MediaEnd& media_end = parts_[0].media_end;
+  listener_->OnMediaEnd(media_end.has_init_range, media_end.init_range_start,
+                        media_end.init_range_end, media_end.has_index_range,
+                        media_end.index_range_start, media_end.index_range_end,
+                        duration_seconds, media_end.file_size);
+}
+
+void MergingMuxerListener::SavePart(size_t part_index,
+                                    PackagingCheckpointData::Part* part) const {
+  DCHECK_GT(part_index, 0u);
+  DCHECK_LT(part_index, parts_.size());
+  DCHECK(part);
+  const Part& saved_part = parts_[part_index];
+  DCHECK(saved_part.media_end.received);
+
+  part->Clear();
+  part->set_part_index(part_index);
+  for (const Segment& segment : saved_part.segments) {
+    PackagingCheckpointData::Segment* saved_segment = part->add_segment();
+    saved_segment->set_name(segment.name);
+    saved_segment->set_start_time(segment.start_time);
+    saved_segment->set_duration(segment.duration);
+    saved_segment->set_file_size(segment.file_size);
+    saved_segment->set_checksum(segment.checksum);
+    for (const KeyFrame& key_frame : segment.key_frames) {
+      PackagingCheckpointData::KeyFrame* saved_key_frame =
+          saved_segment->add_key_frame();
+      saved_key_frame->set_timestamp(key_frame.timestamp);
+      saved_key_frame->set_start_byte_offset(key_frame.start_byte_offset);
+      saved_key_frame->set_size(key_frame.size);
+    }
+  }
+  const MediaEnd& media_end = saved_part.media_end;
+  PackagingCheckpointData::MediaEnd* saved_media_end =
+      part->mutable_media_end();
+  saved_media_end->set_has_init_range(media_end.has_init_range);
+  saved_media_end->set_init_range_start(media_end.init_range_start);
+  saved_media_end->set_init_range_end(media_end.init_range_end);
+  saved_media_end->set_has_index_range(media_end.has_index_range);
+  saved_media_end->set_index_range_start(media_end.index_range_start);
+  saved_media_end->set_index_range_end(media_end.index_range_end);
+  saved_media_end->set_duration_seconds(media_end.duration_seconds);
+  saved_media_end->set_file_size(media_end.file_size);
+}
+
+void MergingMuxerListener::RestorePart(
+    const PackagingCheckpointData::Part& part) {
+  DCHECK_GT(part.part_index(), 0u);
+  DCHECK_LT(part.part_index(), parts_.size());
+  Part& restored_part = parts_[part.part_index()];
+  restored_part.segments.clear();
+  for (const PackagingCheckpointData::Segment& saved_segment : part.segment()) {
+    Segment segment;
+    segment.name = saved_segment.name();
+    segment.start_time = saved_segment.start_time();
+    segment.duration = saved_segment.duration();
+    segment.file_size = saved_segment.file_size();
+    segment.checksum = saved_segment.checksum();
+    for (const PackagingCheckpointData::KeyFrame& saved_key_frame :
+         saved_segment.key_frame()) {
+      KeyFrame key_frame;
+      key_frame.timestamp = saved_key_frame.timestamp();
+      key_frame.start_byte_offset = saved_key_frame.start_byte_offset();
+      key_frame.size = saved_key_frame.size();
+      segment.key_frames.push_back(key_frame);
+    }
+    restored_part.segments.push_back(segment);
+  }
+  const PackagingCheckpointData::MediaEnd& saved_media_end = part.media_end();
+  MediaEnd& media_end = restored_part.media_end;
+  media_end.received = true;
+  media_end.has_init_range = saved_media_end.has_init_range();
+  media_end.init_range_start = saved_media_end.init_range_start();
+  media_end.init_range_end = saved_media_end.init_range_end();
+  media_end.has_index_range = saved_media_end.has_index_range();
+  media_end.index_range_start = saved_media_end.index_range_start();
+  media_end.index_range_end = saved_media_end.index_range_end();
+  media_end.duration_seconds = saved_media_end.duration_seconds();
+  media_end.file_size = saved_media_end.file_size();
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,120 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+//
+// Merges the events of several muxers, each packaging a consecutive time range
+// of the same stream, into the events of a single muxer.
+
+#ifndef MEDIA_EVENT_MERGING_MUXER_LISTENER_H_
+#define MEDIA_EVENT_MERGING_MUXER_LISTENER_H_
+
+#include <string>
+#include <vector>
+
+#include "packager/base/compiler_specific.h"
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/media/base/timed_metadata.h"
+#include "packager/media/event/muxer_listener.h"
+#include "packager/media/event/packaging_checkpoint.pb.h"
+
+namespace edash_packager {
+namespace media {
+
+/// Owns the listener of a stream which is packaged in several consecutive
+/// parts, each by a different muxer, and hands out one listener per part.
+/// The events of the first part are passed through. The segments of the other
+/// parts are kept until Flush(), which passes them on in order, followed by
+/// the end of the media with the total duration. The parts may be muxed on
+/// different threads; each part listener is only used by its own muxer.
+class MergingMuxerListener {
+ public:
+  /// @param listener is the listener of the whole stream.
+  /// @param num_parts is the number of parts the stream is packaged in.
+  MergingMuxerListener(scoped_ptr<MuxerListener> listener, size_t num_parts);
+  ~MergingMuxerListener();
+
+  /// @param part_index is the index of the part, in presentation order.
+  /// @return The listener of the part. The first part must be the one which
+  ///         writes the init segment. The caller owns the listener, which
+  ///         must not outlive this object.
+  scoped_ptr<MuxerListener> CreatePartListener(size_t part_index);
+
+  /// Passes the events kept for the parts on to the listener of the stream.
+  /// Must be called once all the parts are muxed. The end of the media
+  /// reports the file size of the first part: only segment template outputs
+  /// are split, for which the file size is the size of the init segment,
+  /// which is written by the first part only. The other parts report a zero
+  /// file size, and the sizes of their media segments are reported with the
+  /// segments.
+  void Flush();
+
+  /// Copy the events kept for a part, once it is muxed, e.g. to save them in
+  /// a checkpoint of the job.
+  /// @param part_index is the index of the part. The events of the first
+  ///        part are passed through, so it cannot be saved.
+  /// @param part receives the events of the part.
+  void SavePart(size_t part_index, PackagingCheckpointData::Part* part) const;
+
+  /// Restore the events of a part muxed by a previous run of the job, from a
+  /// checkpoint. The part must then not be muxed again.
+  /// @param part contains the events saved by SavePart(). Its part_index
+  ///        must not be the first part.
+  void RestorePart(const PackagingCheckpointData::Part& part);
+
+ private:
+  class PartListener;
+
+  struct KeyFrame {
+    uint64_t timestamp;
+    uint64_t start_byte_offset;
+    uint64_t size;
+  };
+
+  struct Segment {
+    std::string name;
+    uint64_t start_time;
+    uint64_t duration;
+    uint64_t file_size;
+    std::string checksum;
+    // The key frames of the segment, reported before it.
+    std::vector<KeyFrame> key_frames;
+    // The timed metadata of the segment, reported before it. Not saved by
+    // SavePart(): the metadata of the restored parts is lost.
+    std::vector<TimedMetadataEvent> timed_metadata;
+  };
+
+  struct MediaEnd {
+    MediaEnd();
+    ~MediaEnd();
+
+    bool received;
+    bool has_init_range;
+    uint64_t init_range_start;
+    uint64_t init_range_end;
+    bool has_index_range;
+    uint64_t index_range_start;
+    uint64_t index_range_end;
+    float duration_seconds;
+    uint64_t file_size;
+  };
+
+  struct Part {
+    Part();
+    ~Part();
+
+    std::vector<Segment> segments;
+    MediaEnd media_end;
+  };
+
+  scoped_ptr<MuxerListener> listener_;
+  std::vector<Part> parts_;
+
+  DISALLOW_COPY_AND_ASSIGN(MergingMuxerListener);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_EVENT_MERGING_MUXER_LISTENER_H_
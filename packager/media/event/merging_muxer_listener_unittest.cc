@@ -0,0 +1,192 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/event/merging_muxer_listener.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "packager/base/stl_util.h"
+#include "packager/base/strings/string_number_conversions.h"
+#include "packager/media/event/mock_muxer_listener.h"
+#include "packager/media/event/muxer_listener_test_helper.h"
+
+using ::testing::_;
+using ::testing::FloatEq;
+using ::testing::InSequence;
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+const size_t kNumParts = 3;
+const uint64_t kInitRangeEnd = 99;
+const uint64_t kInitFileSize = 100;
+const uint64_t kSegmentDuration = 1000;
+const uint64_t kSegmentFileSize = 5000;
+const uint64_t kKeyFrameOffset = 100;
+const uint64_t kKeyFrameSize = 1500;
+const float kPartDurationSeconds = 2.0f;
+const uint32_t kSampleDuration = 40;
+}  // namespace
+
+class MergingMuxerListenerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    mock_listener_ = new MockMuxerListener;
+    merging_listener_.reset(new MergingMuxerListener(
+        scoped_ptr<MuxerListener>(mock_listener_), kNumParts));
+    for (size_t i = 0; i < kNumParts; ++i)
+      part_listeners_.push_back(
+          merging_listener_->CreatePartListener(i).release());
+  }
+
+  void TearDown() override { STLDeleteElements(&part_listeners_); }
+
+  // Sends two segments, each starting with a key frame, and the end of the
+  // media for part |part_index|.
+  void MuxPart(size_t part_index) {
+    MuxerListener* listener = part_listeners_[part_index];
+    for (uint64_t i = 0; i < 2; ++i) {
+      const uint64_t segment_index = part_index * 2 + i;
+      listener->OnKeyFrame(segment_index * kSegmentDuration, kKeyFrameOffset,
+                           kKeyFrameSize);
+      listener->OnNewSegment(SegmentName(segment_index),
+                             segment_index * kSegmentDuration,
+                             kSegmentDuration, kSegmentFileSize,
+                             Checksum(segment_index));
+    }
+    listener->OnMediaEnd(true, 0, kInitRangeEnd, false, 0, 0,
+                         kPartDurationSeconds,
+                         part_index == 0 ? kInitFileSize : 0);
+  }
+
+  static std::string SegmentName(uint64_t segment_index) {
+    return "segment-" + base::Uint64ToString(segment_index + 1) + ".m4s";
+  }
+
+  static std::string Checksum(uint64_t segment_index) {
+    return "checksum-" + base::Uint64ToString(segment_index + 1);
+  }
+
+  MockMuxerListener* mock_listener_;
+  scoped_ptr<MergingMuxerListener> merging_listener_;
+  std::vector<MuxerListener*> part_listeners_;
+};
+
+TEST_F(MergingMuxerListenerTest, FirstPartIsPassedThrough) {
+  MuxerOptions muxer_options;
+  scoped_refptr<StreamInfo> stream_info =
+      CreateVideoStreamInfo(GetDefaultVideoStreamInfoParams());
+  EXPECT_CALL(*mock_listener_, OnMediaStart(_, _, 90000, _));
+  EXPECT_CALL(*mock_listener_, OnSampleDurationReady(kSampleDuration));
+  part_listeners_[0]->OnMediaStart(muxer_options, *stream_info, 90000,
+                                   MuxerListener::kContainerMp4);
+  part_listeners_[0]->OnSampleDurationReady(kSampleDuration);
+
+  // The other parts do not start the media again.
+  part_listeners_[1]->OnMediaStart(muxer_options, *stream_info, 90000,
+                                   MuxerListener::kContainerMp4);
+  part_listeners_[2]->OnSampleDurationReady(kSampleDuration);
+}
+
+TEST_F(MergingMuxerListenerTest, SegmentsAreMergedInOrder) {
+  {
+    InSequence s;
+    for (uint64_t i = 0; i < kNumParts * 2; ++i) {
+      EXPECT_CALL(*mock_listener_, OnKeyFrame(i * kSegmentDuration,
+                                              kKeyFrameOffset, kKeyFrameSize));
+      EXPECT_CALL(*mock_listener_,
+                  OnNewSegment(SegmentName(i), i * kSegmentDuration,
+                               kSegmentDuration, kSegmentFileSize,
+                               Checksum(i)));
+    }
+    EXPECT_CALL(*mock_listener_,
+                OnMediaEnd(true, 0, kInitRangeEnd, false, 0, 0,
+                           FloatEq(kPartDurationSeconds * kNumParts),
+                           kInitFileSize));
+  }
+
+  // Parts may finish in any order.
+  MuxPart(2);
+  MuxPart(0);
+  MuxPart(1);
+  merging_listener_->Flush();
+}
+
+// The file size at the end of the media is the size of the init segment,
+// written by the first part, not the total size of the segments.
+TEST_F(MergingMuxerListenerTest, MediaEndFileSizeIsInitSegmentSize) {
+  EXPECT_CALL(*mock_listener_, OnNewSegment(_, _, _, _, _))
+      .Times(kNumParts * 2);
+  EXPECT_CALL(*mock_listener_, OnKeyFrame(_, _, _)).Times(kNumParts * 2);
+  const uint64_t kTotalSegmentSize = kNumParts * 2 * kSegmentFileSize;
+  ASSERT_NE(kTotalSegmentSize, kInitFileSize);
+  EXPECT_CALL(*mock_listener_,
+              OnMediaEnd(_, _, _, _, _, _, _, kInitFileSize));
+
+  for (size_t i = 0; i < kNumParts; ++i)
+    MuxPart(i);
+  merging_listener_->Flush();
+}
+
+// A part saved to a checkpoint by a previous run is restored instead of being
+// muxed again.
+TEST_F(MergingMuxerListenerTest, RestoredPart) {
+  MuxPart(1);
+  PackagingCheckpointData::Part saved_part;
+  merging_listener_->SavePart(1, &saved_part);
+  EXPECT_EQ(1u, saved_part.part_index());
+  ASSERT_EQ(2, saved_part.segment_size());
+  EXPECT_EQ(Checksum(2), saved_part.segment(0).checksum());
+
+  MockMuxerListener* mock_listener = new MockMuxerListener;
+  MergingMuxerListener merging_listener(
+      scoped_ptr<MuxerListener>(mock_listener), kNumParts);
+  {
+    InSequence s;
+    for (uint64_t i = 0; i < kNumParts * 2; ++i) {
+      EXPECT_CALL(*mock_listener, OnKeyFrame(i * kSegmentDuration,
+                                             kKeyFrameOffset, kKeyFrameSize));
+      EXPECT_CALL(*mock_listener,
+                  OnNewSegment(SegmentName(i), i * kSegmentDuration,
+                               kSegmentDuration, kSegmentFileSize,
+                               Checksum(i)));
+    }
+    EXPECT_CALL(*mock_listener,
+                OnMediaEnd(true, 0, kInitRangeEnd, false, 0, 0,
+                           FloatEq(kPartDurationSeconds * kNumParts),
+                           kInitFileSize));
+  }
+
+  STLDeleteElements(&part_listeners_);
+  part_listeners_.push_back(
+      merging_listener.CreatePartListener(0).release());
+  part_listeners_.push_back(NULL);
+  part_listeners_.push_back(
+      merging_listener.CreatePartListener(2).release());
+  merging_listener.RestorePart(saved_part);
+  MuxPart(0);
+  MuxPart(2);
+  merging_listener.Flush();
+}
+
+TEST_F(MergingMuxerListenerTest, UnfinishedPart) {
+  EXPECT_CALL(*mock_listener_, OnKeyFrame(_, _, _)).Times(2);
+  EXPECT_CALL(*mock_listener_, OnNewSegment(_, _, _, _, _)).Times(4);
+  EXPECT_CALL(*mock_listener_, OnMediaEnd(_, _, _, _, _, _, _, _)).Times(0);
+
+  MuxPart(0);
+  part_listeners_[1]->OnNewSegment(SegmentName(2), 2 * kSegmentDuration,
+                                   kSegmentDuration, kSegmentFileSize, "");
+  part_listeners_[1]->OnNewSegment(SegmentName(3), 3 * kSegmentDuration,
+                                   kSegmentDuration, kSegmentFileSize, "");
+  MuxPart(2);
+  merging_listener_->Flush();
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -12,6 +12,7 @@
 #include "packager/media/base/muxer_options.h"
 #include "packager/media/base/protection_system_specific_info.h"
 #include "packager/media/base/stream_info.h"
+#include "packager/media/base/timed_metadata.h"
 #include "packager/media/event/muxer_listener.h"
 
 namespace edash_packager {
@@ -48,11 +49,25 @@ class MockMuxerListener : public MuxerListener {
                     float duration_seconds,
                     uint64_t file_size));
 
-  MOCK_METHOD4(OnNewSegment,
+  MOCK_METHOD5(OnNewSegment,
                void(const std::string& segment_name,
                     uint64_t start_time,
                     uint64_t duration,
-                    uint64_t segment_file_size));
+                    uint64_t segment_file_size,
+                    const std::string& checksum));
+
+  MOCK_METHOD4(OnNewChunk,
+               void(const std::string& segment_name,
+                    uint64_t start_time,
+                    uint64_t duration,
+                    uint64_t chunk_size));
+
+  MOCK_METHOD3(OnKeyFrame,
+               void(uint64_t timestamp,
+                    uint64_t start_byte_offset,
+                    uint64_t size));
+
+  MOCK_METHOD1(OnTimedMetadata, void(const TimedMetadataEvent& event));
 };
 
 }  // namespace media
@@ -117,6 +117,7 @@ void MpdNotifyMuxerListener::OnMediaEnd(bool has_init_range,
                                         uint64_t file_size) {
   if (mpd_notifier_->dash_profile() == kLiveProfile) {
     DCHECK(subsegments_.empty());
+    mpd_notifier_->NotifyContainerEnd(notification_id_);
     return;
   }
 
@@ -149,7 +150,8 @@ void MpdNotifyMuxerListener::OnMediaEnd(bool has_init_range,
 void MpdNotifyMuxerListener::OnNewSegment(const std::string& file_name,
                                           uint64_t start_time,
                                           uint64_t duration,
-                                          uint64_t segment_file_size) {
+                                          uint64_t segment_file_size,
+                                          const std::string& checksum) {
   if (mpd_notifier_->dash_profile() == kLiveProfile) {
     // TODO(kqyang): Check return result.
     mpd_notifier_->NotifyNewSegment(
@@ -161,5 +163,20 @@ void MpdNotifyMuxerListener::OnNewSegment(const std::string& file_name,
   }
 }
 
+void MpdNotifyMuxerListener::OnNewChunk(const std::string& segment_name,
+                                        uint64_t start_time,
+                                        uint64_t duration,
+                                        uint64_t chunk_size) {
+  // The MPD lists whole segments only. Clients request the segments in
+  // progress according to SegmentTemplate@availabilityTimeOffset.
+}
+
+void MpdNotifyMuxerListener::OnKeyFrame(uint64_t timestamp,
+                                        uint64_t start_byte_offset,
+                                        uint64_t size) {
+  // The MPD does not list key frames. Trick play is described with dedicated
+  // trick play streams instead.
+}
+
 }  // namespace media
 }  // namespace edash_packager
@@ -55,7 +55,15 @@ class MpdNotifyMuxerListener : public MuxerListener {
   void OnNewSegment(const std::string& file_name,
                     uint64_t start_time,
                     uint64_t duration,
-                    uint64_t segment_file_size) override;
+                    uint64_t segment_file_size,
+                    const std::string& checksum) override;
+  void OnNewChunk(const std::string& segment_name,
+                  uint64_t start_time,
+                  uint64_t duration,
+                  uint64_t chunk_size) override;
+  void OnKeyFrame(uint64_t timestamp,
+                  uint64_t start_byte_offset,
+                  uint64_t size) override;
   /// @}
 
  private:
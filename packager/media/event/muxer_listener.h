@@ -22,6 +22,7 @@ namespace media {
 struct MuxerOptions;
 class ProtectionSystemSpecificInfo;
 class StreamInfo;
+struct TimedMetadataEvent;
 
 /// MuxerListener is an event handler that can be registered to a muxer.
 /// A MuxerListener cannot be shared amongst muxer instances, in other words,
@@ -116,10 +117,48 @@ class MuxerListener {
   /// @param duration is the duration of the segment, relative to the timescale
   ///        specified by MediaInfo passed to OnMediaStart().
   /// @param segment_file_size is the segment size in bytes.
+  /// @param checksum is the checksum of the segment, computed as it is
+  ///        written, if MuxerOptions::segment_checksum is set. It is in the
+  ///        format of SegmentChecksum::Finish(). Empty otherwise.
   virtual void OnNewSegment(const std::string& segment_name,
                             uint64_t start_time,
                             uint64_t duration,
-                            uint64_t segment_file_size) = 0;
+                            uint64_t segment_file_size,
+                            const std::string& checksum) = 0;
+
+  /// Called when a chunk of a segment has been muxed and written, if the
+  /// muxer writes the segments progressively. OnNewSegment() is still called
+  /// once the whole segment is written.
+  /// @param segment_name is the name of the segment the chunk belongs to.
+  /// @param start_time is the start time of the chunk, relative to the
+  ///        timescale specified by MediaInfo passed to OnMediaStart().
+  /// @param duration is the duration of the chunk, relative to the timescale
+  ///        specified by MediaInfo passed to OnMediaStart().
+  /// @param chunk_size is the chunk size in bytes.
+  virtual void OnNewChunk(const std::string& segment_name,
+                          uint64_t start_time,
+                          uint64_t duration,
+                          uint64_t chunk_size) = 0;
+
+  /// Called when a key frame has been muxed, before OnNewSegment() is called
+  /// for the segment containing it. The byte range covers the container
+  /// headers and the key frame, so that it can be played on its own, e.g. in
+  /// an I-frame playlist.
+  /// @param timestamp is the timestamp of the key frame, relative to the
+  ///        timescale of the segments passed to OnNewSegment().
+  /// @param start_byte_offset is the offset of the key frame data, relative
+  ///        to the start of the segment containing it.
+  /// @param size is the size of the key frame data in bytes.
+  virtual void OnKeyFrame(uint64_t timestamp,
+                          uint64_t start_byte_offset,
+                          uint64_t size) = 0;
+
+  /// Called when a timed metadata event of the stream has been muxed, i.e.
+  /// placed in the segment which contains its time, or passed to the
+  /// listener only if the muxer does not write timed metadata. Called before
+  /// OnNewSegment() is called for that segment.
+  /// @param event is the event, timed in its own timescale.
+  virtual void OnTimedMetadata(const TimedMetadataEvent& event) {}
 
  protected:
   MuxerListener() {};
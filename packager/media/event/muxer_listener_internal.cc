@@ -155,6 +155,14 @@ void SetMediaInfoMuxerOptions(const MuxerOptions& muxer_options,
   } else {
     media_info->set_init_segment_name(muxer_options.output_file_name);
     media_info->set_segment_template(muxer_options.segment_template);
+    // A segment is available once its first fragment is written.
+    const double availability_time_offset =
+        muxer_options.segment_duration - muxer_options.fragment_duration;
+    if (muxer_options.low_latency_chunked_output &&
+        availability_time_offset > 0) {
+      media_info->set_availability_time_offset_seconds(
+          availability_time_offset);
+    }
   }
 }
 
@@ -169,6 +177,10 @@ bool GenerateMediaInfo(const MuxerOptions& muxer_options,
 
   SetMediaInfoMuxerOptions(muxer_options, media_info);
   SetMediaInfoStreamInfo(stream_info, media_info);
+  if (muxer_options.trick_play_factor > 0 && media_info->has_video_info()) {
+    media_info->mutable_video_info()->set_trick_play_factor(
+        muxer_options.trick_play_factor);
+  }
   media_info->set_reference_time_scale(reference_time_scale);
   SetMediaInfoContainerType(container_type, media_info);
   if (muxer_options.bandwidth > 0)
@@ -0,0 +1,102 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/event/packaging_checkpoint.h"
+
+#include <google/protobuf/text_format.h>
+
+#include "packager/base/logging.h"
+#include "packager/media/file/file.h"
+
+namespace edash_packager {
+namespace media {
+
+PackagingCheckpoint::PackagingCheckpoint(const std::string& file_name)
+    : file_name_(file_name) {}
+
+PackagingCheckpoint::~PackagingCheckpoint() {}
+
+bool PackagingCheckpoint::Load() {
+  std::string contents;
+  if (!File::ReadFileToString(file_name_.c_str(), &contents)) {
+    VLOG(1) << "No checkpoint to resume from in " << file_name_;
+    return true;
+  }
+  base::AutoLock auto_lock(lock_);
+  if (!google::protobuf::TextFormat::ParseFromString(contents, &data_)) {
+    LOG(ERROR) << "Failed to parse checkpoint " << file_name_;
+    data_.Clear();
+    return false;
+  }
+  return true;
+}
+
+const PackagingCheckpointData::Part* PackagingCheckpoint::GetCompletedPart(
+    const std::string& segment_template,
+    const std::vector<int64_t>& part_start_times,
+    size_t part_index) {
+  base::AutoLock auto_lock(lock_);
+  const PackagingCheckpointData::Stream* stream =
+      GetStream(segment_template, part_start_times);
+  for (const PackagingCheckpointData::Part& part : stream->part()) {
+    if (part.part_index() == part_index)
+      return &part;
+  }
+  return NULL;
+}
+
+bool PackagingCheckpoint::AddCompletedPart(
+    const std::string& segment_template,
+    const std::vector<int64_t>& part_start_times,
+    const PackagingCheckpointData::Part& part) {
+  // The lock is held while the file is written, so that the parts completing
+  // concurrently do not write the same temporary file.
+  base::AutoLock auto_lock(lock_);
+  *GetStream(segment_template, part_start_times)->add_part() = part;
+  std::string contents;
+  if (!google::protobuf::TextFormat::PrintToString(data_, &contents)) {
+    LOG(ERROR) << "Failed to serialize checkpoint.";
+    return false;
+  }
+  return File::WriteFileAtomically(file_name_.c_str(), contents);
+}
+
+bool PackagingCheckpoint::Delete() {
+  return File::Delete(file_name_.c_str());
+}
+
+PackagingCheckpointData::Stream* PackagingCheckpoint::GetStream(
+    const std::string& segment_template,
+    const std::vector<int64_t>& part_start_times) {
+  lock_.AssertAcquired();
+  PackagingCheckpointData::Stream* stream = NULL;
+  for (int i = 0; i < data_.stream_size(); ++i) {
+    if (data_.stream(i).segment_template() == segment_template) {
+      stream = data_.mutable_stream(i);
+      break;
+    }
+  }
+  if (!stream) {
+    stream = data_.add_stream();
+    stream->set_segment_template(segment_template);
+  }
+  const std::vector<int64_t> saved_part_start_times(
+      stream->part_start_time().begin(), stream->part_start_time().end());
+  if (saved_part_start_times != part_start_times) {
+    if (stream->part_size() > 0) {
+      LOG(WARNING) << "The ranges of " << segment_template
+                   << " differ from the checkpoint; they are packaged again.";
+    }
+    stream->clear_part();
+    stream->clear_part_start_time();
+    for (int64_t part_start_time : part_start_times)
+      stream->add_part_start_time(part_start_time);
+  }
+  return stream;
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,81 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_EVENT_PACKAGING_CHECKPOINT_H_
+#define MEDIA_EVENT_PACKAGING_CHECKPOINT_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "packager/base/macros.h"
+#include "packager/base/synchronization/lock.h"
+#include "packager/media/event/packaging_checkpoint.pb.h"
+
+namespace edash_packager {
+namespace media {
+
+/// The checkpoint of a VOD packaging job. The ranges of the streams packaged
+/// in parallel are recorded, with the events of their muxer listeners, as
+/// they complete. The checkpoint is saved to a file after every range, so a
+/// job restarted after a crash can skip the ranges already packaged.
+/// Thread Safety: AddCompletedPart() can be called from any thread.
+class PackagingCheckpoint {
+ public:
+  /// @param file_name is the file the checkpoint is saved to.
+  explicit PackagingCheckpoint(const std::string& file_name);
+  ~PackagingCheckpoint();
+
+  /// Load the checkpoint saved by a previous run of the job, if any.
+  /// @return true on success or if there is no checkpoint, false if the
+  ///         checkpoint cannot be parsed.
+  bool Load();
+
+  /// @param segment_template identifies the stream.
+  /// @param part_start_times are the start times of the ranges of the
+  ///        stream.
+  /// @param part_index is the index of the range.
+  /// @return The range, if the previous run completed it and split the
+  ///         stream at the same times, NULL otherwise. It is valid until the
+  ///         next call.
+  const PackagingCheckpointData::Part* GetCompletedPart(
+      const std::string& segment_template,
+      const std::vector<int64_t>& part_start_times,
+      size_t part_index);
+
+  /// Record a completed range and save the checkpoint.
+  /// @param segment_template identifies the stream.
+  /// @param part_start_times are the start times of the ranges of the
+  ///        stream.
+  /// @param part is the completed range.
+  /// @return true on success, false if the checkpoint cannot be saved.
+  bool AddCompletedPart(const std::string& segment_template,
+                        const std::vector<int64_t>& part_start_times,
+                        const PackagingCheckpointData::Part& part);
+
+  /// Delete the checkpoint file, once the job is complete.
+  /// @return true on success, false otherwise.
+  bool Delete();
+
+ private:
+  // Returns the stream |segment_template|. Its ranges are dropped if the
+  // stream is split at different times.
+  PackagingCheckpointData::Stream* GetStream(
+      const std::string& segment_template,
+      const std::vector<int64_t>& part_start_times);
+
+  const std::string file_name_;
+  base::Lock lock_;  // Lock protecting |data_|.
+  PackagingCheckpointData data_;
+
+  DISALLOW_COPY_AND_ASSIGN(PackagingCheckpoint);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_EVENT_PACKAGING_CHECKPOINT_H_
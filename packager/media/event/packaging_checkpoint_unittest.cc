@@ -0,0 +1,102 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+
+#include "packager/base/strings/string_number_conversions.h"
+#include "packager/media/event/packaging_checkpoint.h"
+#include "packager/media/file/file.h"
+#include "packager/media/file/memory_file.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+const char kCheckpointFile[] = "memory://checkpoint";
+const char kSegmentTemplate[] = "video-$Number$.m4s";
+const char kOtherSegmentTemplate[] = "audio-$Number$.m4s";
+const int64_t kPartStartTimes[] = {0, 90000, 180000};
+}  // namespace
+
+class PackagingCheckpointTest : public ::testing::Test {
+ protected:
+  PackagingCheckpointTest()
+      : part_start_times_(kPartStartTimes,
+                          kPartStartTimes + arraysize(kPartStartTimes)) {}
+
+  void TearDown() override { MemoryFile::DeleteAll(); }
+
+  static PackagingCheckpointData::Part CreatePart(size_t part_index) {
+    PackagingCheckpointData::Part part;
+    part.set_part_index(part_index);
+    PackagingCheckpointData::Segment* segment = part.add_segment();
+    segment->set_name("video-" + base::SizeTToString(part_index + 1) + ".m4s");
+    segment->set_start_time(kPartStartTimes[part_index]);
+    segment->set_duration(90000);
+    segment->set_file_size(1000);
+    part.mutable_media_end()->set_duration_seconds(1.0f);
+    return part;
+  }
+
+  const std::vector<int64_t> part_start_times_;
+};
+
+TEST_F(PackagingCheckpointTest, NoCheckpoint) {
+  PackagingCheckpoint checkpoint(kCheckpointFile);
+  ASSERT_TRUE(checkpoint.Load());
+  EXPECT_FALSE(
+      checkpoint.GetCompletedPart(kSegmentTemplate, part_start_times_, 1));
+}
+
+TEST_F(PackagingCheckpointTest, ResumeFromCheckpoint) {
+  {
+    PackagingCheckpoint checkpoint(kCheckpointFile);
+    ASSERT_TRUE(checkpoint.Load());
+    ASSERT_TRUE(checkpoint.AddCompletedPart(kSegmentTemplate,
+                                            part_start_times_, CreatePart(2)));
+    ASSERT_TRUE(checkpoint.AddCompletedPart(kOtherSegmentTemplate,
+                                            part_start_times_, CreatePart(1)));
+  }
+
+  PackagingCheckpoint checkpoint(kCheckpointFile);
+  ASSERT_TRUE(checkpoint.Load());
+  EXPECT_FALSE(
+      checkpoint.GetCompletedPart(kSegmentTemplate, part_start_times_, 1));
+  const PackagingCheckpointData::Part* part =
+      checkpoint.GetCompletedPart(kSegmentTemplate, part_start_times_, 2);
+  ASSERT_TRUE(part);
+  EXPECT_EQ(CreatePart(2).SerializeAsString(), part->SerializeAsString());
+  EXPECT_TRUE(
+      checkpoint.GetCompletedPart(kOtherSegmentTemplate, part_start_times_, 1));
+
+  ASSERT_TRUE(checkpoint.Delete());
+  std::string contents;
+  EXPECT_FALSE(File::ReadFileToString(kCheckpointFile, &contents));
+}
+
+TEST_F(PackagingCheckpointTest, StreamSplitDifferently) {
+  {
+    PackagingCheckpoint checkpoint(kCheckpointFile);
+    ASSERT_TRUE(checkpoint.AddCompletedPart(kSegmentTemplate,
+                                            part_start_times_, CreatePart(1)));
+  }
+
+  PackagingCheckpoint checkpoint(kCheckpointFile);
+  ASSERT_TRUE(checkpoint.Load());
+  std::vector<int64_t> other_part_start_times(part_start_times_);
+  other_part_start_times[1] += 1;
+  EXPECT_FALSE(checkpoint.GetCompletedPart(kSegmentTemplate,
+                                           other_part_start_times, 1));
+}
+
+TEST_F(PackagingCheckpointTest, InvalidCheckpoint) {
+  ASSERT_TRUE(File::WriteFileAtomically(kCheckpointFile, "not a checkpoint"));
+  PackagingCheckpoint checkpoint(kCheckpointFile);
+  EXPECT_FALSE(checkpoint.Load());
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -12,10 +12,38 @@
 #include <stdint.h>
 
 #include "packager/base/macros.h"
+#include "packager/base/time/time.h"
 
 namespace edash_packager {
 namespace media {
 
+/// Health of a stream packaged in real time, e.g. from a live input.
+struct LiveStreamHealth {
+  LiveStreamHealth()
+      : track_id(0),
+        queued_samples(0),
+        input_cached_bytes(0),
+        num_key_fetch_stalls(0) {}
+
+  /// Track id of the stream.
+  uint32_t track_id;
+  /// How far the output is behind the wall clock: the wall clock time elapsed
+  /// since the first sample of the stream was muxed minus the media time
+  /// muxed since then. It keeps growing if the packager cannot keep up with
+  /// a live input, and is negative if the input is packaged faster than real
+  /// time, e.g. for files.
+  base::TimeDelta real_time_lag;
+  /// Number of samples demuxed but not muxed yet.
+  size_t queued_samples;
+  /// Number of input bytes read ahead but not demuxed yet.
+  uint64_t input_cached_bytes;
+  /// Number of times encryption waited for keys which were not fetched yet,
+  /// since the start.
+  uint32_t num_key_fetch_stalls;
+  /// Total time encryption waited for keys, since the start.
+  base::TimeDelta key_fetch_stall_time;
+};
+
 /// This class listens to progress updates events.
 class ProgressListener {
  public:
@@ -25,6 +53,11 @@ class ProgressListener {
   /// @param progress is the current progress metric, ranges from 0 to 1.
   virtual void OnProgress(double progress) = 0;
 
+  /// Called periodically, about once per second for each stream, with the
+  /// health of the stream. The default implementation ignores it.
+  /// @param health is the current health of the stream.
+  virtual void OnLiveStreamHealth(const LiveStreamHealth& health) {}
+
  protected:
   ProgressListener() {}
 
@@ -14,14 +14,18 @@
 #include "packager/media/base/protection_system_specific_info.h"
 #include "packager/media/event/muxer_listener_internal.h"
 #include "packager/media/file/file.h"
+#include "packager/media/file/record_log.h"
 #include "packager/mpd/base/media_info.pb.h"
+#include "packager/mpd/base/mpd_notification.pb.h"
 
 namespace edash_packager {
 namespace media {
 
 VodMediaInfoDumpMuxerListener::VodMediaInfoDumpMuxerListener(
     const std::string& output_file_path)
-    : output_file_name_(output_file_path), is_encrypted_(false) {}
+    : output_file_name_(output_file_path),
+      binary_format_(false),
+      is_encrypted_(false) {}
 
 VodMediaInfoDumpMuxerListener::~VodMediaInfoDumpMuxerListener() {}
 
@@ -60,12 +64,37 @@ void VodMediaInfoDumpMuxerListener::OnMediaStart(
     internal::SetContentProtectionFields(protection_scheme_, default_key_id_,
                                          key_system_info_, media_info_.get());
   }
+
+  if (segment_log_path_.empty())
+    return;
+  // Start a new log, whatever a previous run left.
+  File::Delete(segment_log_path_.c_str());
+  segment_log_.reset(new RecordLog(segment_log_path_));
+  std::vector<std::string> unused_records;
+  if (!segment_log_->Open(&unused_records)) {
+    LOG(ERROR) << "Failed to open segment log " << segment_log_path_;
+    segment_log_.reset();
+    return;
+  }
+  MpdNotification notification;
+  notification.set_type(MpdNotification::NEW_CONTAINER);
+  notification.set_container_id(0);
+  notification.set_media_info(media_info_->SerializeAsString());
+  AppendToSegmentLog(notification);
 }
 
 void VodMediaInfoDumpMuxerListener::OnSampleDurationReady(
     uint32_t sample_duration) {
   // Assume one VideoInfo.
   if (media_info_->has_video_info()) {
+    // It is reported with every subsegment; log the changes only.
+    if (media_info_->video_info().frame_duration() != sample_duration) {
+      MpdNotification notification;
+      notification.set_type(MpdNotification::SAMPLE_DURATION);
+      notification.set_container_id(0);
+      notification.set_sample_duration(sample_duration);
+      AppendToSegmentLog(notification);
+    }
     media_info_->mutable_video_info()->set_frame_duration(sample_duration);
   }
 }
@@ -91,21 +120,65 @@ void VodMediaInfoDumpMuxerListener::OnMediaEnd(bool has_init_range,
     LOG(ERROR) << "Failed to generate VOD information from input.";
     return;
   }
-  WriteMediaInfoToFile(*media_info_, output_file_name_);
+  WriteMediaInfoToFile(*media_info_, output_file_name_, binary_format_);
+
+  MpdNotification notification;
+  notification.set_type(MpdNotification::NEW_CONTAINER);
+  notification.set_container_id(0);
+  notification.set_media_info(media_info_->SerializeAsString());
+  AppendToSegmentLog(notification);
+  MpdNotification flush;
+  flush.set_type(MpdNotification::FLUSH);
+  AppendToSegmentLog(flush);
+  segment_log_.reset();
 }
 
 void VodMediaInfoDumpMuxerListener::OnNewSegment(const std::string& file_name,
                                                  uint64_t start_time,
                                                  uint64_t duration,
-                                                 uint64_t segment_file_size) {}
+                                                 uint64_t segment_file_size,
+                                                 const std::string& checksum) {
+  MpdNotification notification;
+  notification.set_type(MpdNotification::NEW_SEGMENT);
+  notification.set_container_id(0);
+  notification.set_start_time(start_time);
+  notification.set_duration(duration);
+  notification.set_size(segment_file_size);
+  AppendToSegmentLog(notification);
+}
+
+void VodMediaInfoDumpMuxerListener::OnNewChunk(const std::string& segment_name,
+                                               uint64_t start_time,
+                                               uint64_t duration,
+                                               uint64_t chunk_size) {}
+
+void VodMediaInfoDumpMuxerListener::OnKeyFrame(uint64_t timestamp,
+                                               uint64_t start_byte_offset,
+                                               uint64_t size) {}
+
+void VodMediaInfoDumpMuxerListener::AppendToSegmentLog(
+    const MpdNotification& notification) {
+  if (!segment_log_)
+    return;
+  if (!segment_log_->Append(notification.SerializeAsString())) {
+    LOG(ERROR) << "Failed to append to segment log " << segment_log_path_
+               << ", which is no longer updated.";
+    segment_log_.reset();
+  }
+}
 
 // static
 bool VodMediaInfoDumpMuxerListener::WriteMediaInfoToFile(
     const edash_packager::MediaInfo& media_info,
-    const std::string& output_file_path) {
+    const std::string& output_file_path,
+    bool binary_format) {
   std::string output_string;
-  if (!google::protobuf::TextFormat::PrintToString(media_info,
-                                                   &output_string)) {
+  const bool serialized =
+      binary_format
+          ? media_info.SerializeToString(&output_string)
+          : google::protobuf::TextFormat::PrintToString(media_info,
+                                                        &output_string);
+  if (!serialized) {
     LOG(ERROR) << "Failed to serialize MediaInfo to string.";
     return false;
   }
@@ -22,9 +22,12 @@
 namespace edash_packager {
 
 class MediaInfo;
+class MpdNotification;
 
 namespace media {
 
+class RecordLog;
+
 class VodMediaInfoDumpMuxerListener : public MuxerListener {
  public:
   VodMediaInfoDumpMuxerListener(const std::string& output_file_name);
@@ -54,22 +57,58 @@ class VodMediaInfoDumpMuxerListener : public MuxerListener {
   void OnNewSegment(const std::string& file_name,
                     uint64_t start_time,
                     uint64_t duration,
-                    uint64_t segment_file_size) override;
+                    uint64_t segment_file_size,
+                    const std::string& checksum) override;
+  void OnNewChunk(const std::string& segment_name,
+                  uint64_t start_time,
+                  uint64_t duration,
+                  uint64_t chunk_size) override;
+  void OnKeyFrame(uint64_t timestamp,
+                  uint64_t start_byte_offset,
+                  uint64_t size) override;
   /// @}
 
-  /// Write @a media_info to @a output_file_path in human readable format.
+  /// Write the MediaInfo in the binary protobuf format instead of the human
+  /// readable text format. Binary MediaInfo is smaller and much faster to
+  /// parse, e.g. by mpd_generator. Text by default.
+  void set_binary_format(bool binary_format) { binary_format_ = binary_format; }
+
+  /// Also write the MediaInfo and the subsegments incrementally to a segment
+  /// log, so that a manifest can be published before the media ends. The log
+  /// is a RecordLog of serialized MpdNotification records, as the MPD state
+  /// log: a NEW_CONTAINER record with the MediaInfo known at the start, then
+  /// SAMPLE_DURATION and NEW_SEGMENT records as the subsegments complete, and
+  /// at the end a NEW_CONTAINER record with the complete MediaInfo, which
+  /// supersedes the first one, followed by a FLUSH record. The container id is
+  /// always 0. A previous log is replaced. Disabled by default.
+  /// @param segment_log_path is the file of the log.
+  void set_segment_log_path(const std::string& segment_log_path) {
+    segment_log_path_ = segment_log_path;
+  }
+
+  /// Write @a media_info to @a output_file_path.
   /// @param media_info is the MediaInfo to write out.
   /// @param output_file_path is the path of the output file.
+  /// @param binary_format indicates whether to write @a media_info in the
+  ///        binary protobuf format or in human readable text format.
   /// @return true on success, false otherwise.
   // TODO(rkuroiwa): Move this to muxer_listener_internal and rename
   // muxer_listener_internal to muxer_listener_util.
   static bool WriteMediaInfoToFile(const MediaInfo& media_info,
-                                   const std::string& output_file_path);
+                                   const std::string& output_file_path,
+                                   bool binary_format);
 
  private:
+  // Appends |notification| to |segment_log_|, if open. The log is closed on
+  // failure.
+  void AppendToSegmentLog(const MpdNotification& notification);
 
   std::string output_file_name_;
   scoped_ptr<MediaInfo> media_info_;
+  bool binary_format_;
+
+  std::string segment_log_path_;
+  scoped_ptr<RecordLog> segment_log_;
 
   bool is_encrypted_;
   // Storage for values passed to OnEncryptionInfoReady().
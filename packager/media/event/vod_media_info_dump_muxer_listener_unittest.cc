@@ -17,7 +17,9 @@
 #include "packager/media/event/muxer_listener_test_helper.h"
 #include "packager/media/event/vod_media_info_dump_muxer_listener.h"
 #include "packager/media/file/file.h"
+#include "packager/media/file/record_log.h"
 #include "packager/mpd/base/media_info.pb.h"
+#include "packager/mpd/base/mpd_notification.pb.h"
 
 namespace {
 const bool kEnableEncryption = true;
@@ -233,5 +235,107 @@ TEST_F(VodMediaInfoDumpMuxerListenerTest, CheckPixelWidthAndHeightSet) {
   ASSERT_NO_FATAL_FAILURE(ExpectTempFileToEqual(kExpectedProtobufOutput));
 }
 
+// Verify that the MediaInfo is written in the binary format if requested.
+TEST_F(VodMediaInfoDumpMuxerListenerTest, BinaryFormat) {
+  listener_->set_binary_format(true);
+  scoped_refptr<StreamInfo> stream_info =
+      CreateVideoStreamInfo(GetDefaultVideoStreamInfoParams());
+  FireOnMediaStartWithDefaultMuxerOptions(*stream_info, !kEnableEncryption);
+  FireOnMediaEndWithParams(GetDefaultOnMediaEndParams());
+
+  const char kExpectedProtobufOutput[] =
+      "bandwidth: 7620\n"
+      "video_info {\n"
+      "  codec: 'avc1.010101'\n"
+      "  width: 720\n"
+      "  height: 480\n"
+      "  time_scale: 10\n"
+      "  pixel_width: 1\n"
+      "  pixel_height: 1\n"
+      "}\n"
+      "init_range {\n"
+      "  begin: 0\n"
+      "  end: 120\n"
+      "}\n"
+      "index_range {\n"
+      "  begin: 121\n"
+      "  end: 221\n"
+      "}\n"
+      "reference_time_scale: 1000\n"
+      "container_type: 1\n"
+      "media_file_name: 'test_output_file_name.mp4'\n"
+      "media_duration_seconds: 10.5\n";
+  MediaInfo expected_media_info;
+  ASSERT_TRUE(::google::protobuf::TextFormat::ParseFromString(
+      kExpectedProtobufOutput, &expected_media_info));
+
+  std::string temp_file_content;
+  ASSERT_TRUE(File::ReadFileToString(temp_file_path_.value().c_str(),
+                                     &temp_file_content));
+  MediaInfo actual_media_info;
+  ASSERT_TRUE(actual_media_info.ParseFromString(temp_file_content));
+  ExpectMediaInfoEqual(expected_media_info, actual_media_info);
+}
+
+// Verify that the subsegments are logged as they complete, followed by the
+// complete MediaInfo.
+TEST_F(VodMediaInfoDumpMuxerListenerTest, SegmentLog) {
+  base::FilePath segment_log_path;
+  ASSERT_TRUE(base::CreateTemporaryFile(&segment_log_path));
+  listener_->set_segment_log_path(segment_log_path.value());
+
+  scoped_refptr<StreamInfo> stream_info =
+      CreateVideoStreamInfo(GetDefaultVideoStreamInfoParams());
+  FireOnMediaStartWithDefaultMuxerOptions(*stream_info, !kEnableEncryption);
+  const uint32_t kSampleDuration = 1001;
+  listener_->OnSampleDurationReady(kSampleDuration);
+  listener_->OnNewSegment("", 0, 5000, 2000, "");
+  // Unchanged, so not logged.
+  listener_->OnSampleDurationReady(kSampleDuration);
+  listener_->OnNewSegment("", 5000, 5500, 2100, "");
+
+  // The subsegments are readable before the media ends.
+  std::vector<std::string> records;
+  {
+    RecordLog reader(segment_log_path.value());
+    ASSERT_TRUE(reader.Open(&records));
+  }
+  ASSERT_EQ(4u, records.size());
+
+  FireOnMediaEndWithParams(GetDefaultOnMediaEndParams());
+  {
+    RecordLog reader(segment_log_path.value());
+    ASSERT_TRUE(reader.Open(&records));
+  }
+  base::DeleteFile(segment_log_path, false);
+  ASSERT_EQ(6u, records.size());
+
+  std::vector<MpdNotification> notifications(records.size());
+  for (size_t i = 0; i < records.size(); ++i)
+    ASSERT_TRUE(notifications[i].ParseFromString(records[i]));
+
+  EXPECT_EQ(MpdNotification::NEW_CONTAINER, notifications[0].type());
+  MediaInfo start_media_info;
+  ASSERT_TRUE(start_media_info.ParseFromString(notifications[0].media_info()));
+  EXPECT_FALSE(start_media_info.has_init_range());
+
+  EXPECT_EQ(MpdNotification::SAMPLE_DURATION, notifications[1].type());
+  EXPECT_EQ(kSampleDuration, notifications[1].sample_duration());
+
+  EXPECT_EQ(MpdNotification::NEW_SEGMENT, notifications[2].type());
+  EXPECT_EQ(0u, notifications[2].start_time());
+  EXPECT_EQ(5000u, notifications[2].duration());
+  EXPECT_EQ(2000u, notifications[2].size());
+  EXPECT_EQ(MpdNotification::NEW_SEGMENT, notifications[3].type());
+  EXPECT_EQ(5000u, notifications[3].start_time());
+
+  EXPECT_EQ(MpdNotification::NEW_CONTAINER, notifications[4].type());
+  MediaInfo end_media_info;
+  ASSERT_TRUE(end_media_info.ParseFromString(notifications[4].media_info()));
+  EXPECT_TRUE(end_media_info.has_init_range());
+  EXPECT_TRUE(end_media_info.has_index_range());
+  EXPECT_EQ(MpdNotification::FLUSH, notifications[5].type());
+}
+
 }  // namespace media
 }  // namespace edash_packager
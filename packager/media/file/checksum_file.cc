@@ -0,0 +1,125 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/file/checksum_file.h"
+
+#include <algorithm>
+
+#include "packager/base/logging.h"
+
+namespace edash_packager {
+namespace media {
+
+ChecksumFile::ChecksumFile(scoped_ptr<File, FileCloser> internal_file,
+                           SegmentChecksum::Algorithm algorithm)
+    : File(internal_file->file_name()),
+      internal_file_(internal_file.Pass()),
+      checksum_(algorithm),
+      sequential_(true) {}
+
+ChecksumFile::~ChecksumFile() {}
+
+ChecksumFile* ChecksumFile::OpenWithChecksum(
+    const char* file_name,
+    const char* mode,
+    SegmentChecksum::Algorithm algorithm) {
+  scoped_ptr<File, FileCloser> file(File::Open(file_name, mode));
+  if (!file)
+    return NULL;
+  return new ChecksumFile(file.Pass(), algorithm);
+}
+
+File* ChecksumFile::OpenSegmentFile(SegmentChecksum::Algorithm algorithm,
+                                    const std::string& file_name) {
+  if (algorithm == SegmentChecksum::kNone)
+    return File::Open(file_name.c_str(), "w");
+  return OpenWithChecksum(file_name.c_str(), "w", algorithm);
+}
+
+bool ChecksumFile::WriteSidecarFile(const std::string& file_name,
+                                    SegmentChecksum::Algorithm algorithm,
+                                    const std::string& checksum) {
+  DCHECK_NE(algorithm, SegmentChecksum::kNone);
+  const size_t pos = file_name.find_last_of('/');
+  const std::string base_name =
+      pos == std::string::npos ? file_name : file_name.substr(pos + 1);
+  const std::string sidecar_file_name =
+      file_name + "." + SegmentChecksum::AlgorithmName(algorithm);
+  if (!File::WriteFileAtomically(sidecar_file_name.c_str(),
+                                 checksum + "  " + base_name + "\n")) {
+    LOG(ERROR) << "Failed to write checksum file " << sidecar_file_name;
+    return false;
+  }
+  return true;
+}
+
+bool ChecksumFile::Open() {
+  // The internal file is opened already.
+  return true;
+}
+
+bool ChecksumFile::Close() {
+  DCHECK(internal_file_);
+  const bool result = internal_file_.release()->Close();
+  delete this;
+  return result;
+}
+
+int64_t ChecksumFile::Read(void* buffer, uint64_t length) {
+  return internal_file_->Read(buffer, length);
+}
+
+int64_t ChecksumFile::Write(const void* buffer, uint64_t length) {
+  const int64_t bytes_written = internal_file_->Write(buffer, length);
+  if (bytes_written > 0)
+    checksum_.Update(buffer, bytes_written);
+  return bytes_written;
+}
+
+int64_t ChecksumFile::WriteV(const WriteBlock* blocks, size_t num_blocks) {
+  const int64_t bytes_written = internal_file_->WriteV(blocks, num_blocks);
+  uint64_t bytes_left = bytes_written > 0 ? bytes_written : 0;
+  for (size_t i = 0; i < num_blocks && bytes_left > 0; ++i) {
+    const uint64_t size = std::min(blocks[i].length, bytes_left);
+    checksum_.Update(blocks[i].data, size);
+    bytes_left -= size;
+  }
+  return bytes_written;
+}
+
+int64_t ChecksumFile::Size() {
+  return internal_file_->Size();
+}
+
+bool ChecksumFile::Flush() {
+  return internal_file_->Flush();
+}
+
+bool ChecksumFile::Seek(uint64_t position) {
+  sequential_ = false;
+  return internal_file_->Seek(position);
+}
+
+bool ChecksumFile::Tell(uint64_t* position) {
+  return internal_file_->Tell(position);
+}
+
+uint64_t ChecksumFile::GetCachedSize() {
+  return internal_file_->GetCachedSize();
+}
+
+std::string ChecksumFile::FinishChecksum() {
+  const std::string checksum = checksum_.Finish();
+  if (!sequential_) {
+    LOG(WARNING) << "No checksum for " << file_name()
+                 << ", which is not written sequentially.";
+    return "";
+  }
+  return checksum;
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,86 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef PACKAGER_FILE_CHECKSUM_FILE_H_
+#define PACKAGER_FILE_CHECKSUM_FILE_H_
+
+#include <string>
+
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/media/base/segment_checksum.h"
+#include "packager/media/file/file.h"
+#include "packager/media/file/file_closer.h"
+
+namespace edash_packager {
+namespace media {
+
+/// Wraps an output file to compute the checksum of the data written to it
+/// while the data is in the cache, instead of reading the file back once it
+/// is written.
+class ChecksumFile : public File {
+ public:
+  /// @param internal_file is the opened file which the data is written to.
+  /// @param algorithm is the checksum algorithm.
+  ChecksumFile(scoped_ptr<File, FileCloser> internal_file,
+               SegmentChecksum::Algorithm algorithm);
+
+  /// Open a file with File::Open() and wrap it.
+  /// @return The file on success, NULL otherwise.
+  static ChecksumFile* OpenWithChecksum(const char* file_name,
+                                        const char* mode,
+                                        SegmentChecksum::Algorithm algorithm);
+
+  /// Open a segment file for writing, wrapped in a ChecksumFile unless
+  /// @a algorithm is SegmentChecksum::kNone. Suitable for
+  /// FileOpenAhead::OpenFileCB.
+  /// @return The file on success, NULL otherwise.
+  static File* OpenSegmentFile(SegmentChecksum::Algorithm algorithm,
+                               const std::string& file_name);
+
+  /// Write the checksum of a file to a sidecar file, named after the file
+  /// with the name of the algorithm as extension, in the format of md5sum,
+  /// i.e. the checksum and the base name of the file.
+  /// @return true on success, false otherwise.
+  static bool WriteSidecarFile(const std::string& file_name,
+                               SegmentChecksum::Algorithm algorithm,
+                               const std::string& checksum);
+
+  /// @name File implementation overrides.
+  /// @{
+  bool Close() override;
+  int64_t Read(void* buffer, uint64_t length) override;
+  int64_t Write(const void* buffer, uint64_t length) override;
+  int64_t WriteV(const WriteBlock* blocks, size_t num_blocks) override;
+  int64_t Size() override;
+  bool Flush() override;
+  bool Seek(uint64_t position) override;
+  bool Tell(uint64_t* position) override;
+  uint64_t GetCachedSize() override;
+  /// @}
+
+  /// @return The checksum of the data written so far, in the format of
+  ///         SegmentChecksum::Finish(). Empty if the file was written out of
+  ///         order, i.e. after a Seek().
+  std::string FinishChecksum();
+
+ protected:
+  ~ChecksumFile() override;
+
+  bool Open() override;
+
+ private:
+  scoped_ptr<File, FileCloser> internal_file_;
+  SegmentChecksum checksum_;
+  // Cleared by Seek(), since the checksum covers the data in write order.
+  bool sequential_;
+
+  DISALLOW_COPY_AND_ASSIGN(ChecksumFile);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // PACKAGER_FILE_CHECKSUM_FILE_H_
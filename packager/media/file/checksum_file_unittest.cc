@@ -0,0 +1,72 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+
+#include "packager/media/file/checksum_file.h"
+#include "packager/media/file/memory_file.h"
+
+namespace edash_packager {
+namespace media {
+namespace {
+
+const char kFileName[] = "memory://dir/segment1.ts";
+const char kData[] = "123456789";
+// MD5 of kData.
+const char kDataMd5[] = "25f9e794323b453885f5181f1b624d0b";
+
+}  // namespace
+
+class ChecksumFileTest : public testing::Test {
+ protected:
+  void TearDown() override { MemoryFile::DeleteAll(); }
+};
+
+TEST_F(ChecksumFileTest, Write) {
+  ChecksumFile* file =
+      ChecksumFile::OpenWithChecksum(kFileName, "w", SegmentChecksum::kMd5);
+  ASSERT_TRUE(file);
+  EXPECT_EQ(4, file->Write(kData, 4));
+  EXPECT_EQ(5, file->Write(kData + 4, 5));
+  EXPECT_EQ(kDataMd5, file->FinishChecksum());
+  ASSERT_TRUE(file->Close());
+
+  std::string contents;
+  ASSERT_TRUE(File::ReadFileToString(kFileName, &contents));
+  EXPECT_EQ(kData, contents);
+}
+
+TEST_F(ChecksumFileTest, WriteV) {
+  ChecksumFile* file =
+      ChecksumFile::OpenWithChecksum(kFileName, "w", SegmentChecksum::kMd5);
+  ASSERT_TRUE(file);
+  const File::WriteBlock blocks[] = {{kData, 2}, {kData + 2, 7}};
+  EXPECT_EQ(9, file->WriteV(blocks, arraysize(blocks)));
+  EXPECT_EQ(kDataMd5, file->FinishChecksum());
+  ASSERT_TRUE(file->Close());
+}
+
+TEST_F(ChecksumFileTest, NoChecksumAfterSeek) {
+  ChecksumFile* file =
+      ChecksumFile::OpenWithChecksum(kFileName, "w", SegmentChecksum::kMd5);
+  ASSERT_TRUE(file);
+  EXPECT_EQ(9, file->Write(kData, 9));
+  ASSERT_TRUE(file->Seek(0));
+  EXPECT_EQ("", file->FinishChecksum());
+  ASSERT_TRUE(file->Close());
+}
+
+TEST_F(ChecksumFileTest, WriteSidecarFile) {
+  ASSERT_TRUE(ChecksumFile::WriteSidecarFile(kFileName, SegmentChecksum::kMd5,
+                                             kDataMd5));
+  std::string contents;
+  ASSERT_TRUE(File::ReadFileToString("memory://dir/segment1.ts.md5",
+                                     &contents));
+  EXPECT_EQ(std::string(kDataMd5) + "  segment1.ts\n", contents);
+}
+
+}  // namespace media
+}  // namespace edash_packager
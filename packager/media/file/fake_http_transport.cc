@@ -0,0 +1,64 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/file/fake_http_transport.h"
+
+namespace edash_packager {
+namespace media {
+
+class FakeHttpTransport::FakeConnection : public HttpConnection {
+ public:
+  explicit FakeConnection(FakeHttpTransport* transport)
+      : transport_(transport) {}
+  ~FakeConnection() override {}
+
+  bool Send(const HttpRequest& request, HttpResponse* response) override {
+    return transport_->Send(request, response);
+  }
+
+ private:
+  FakeHttpTransport* const transport_;
+
+  DISALLOW_COPY_AND_ASSIGN(FakeConnection);
+};
+
+FakeHttpTransport::FakeHttpTransport(const Handler& handler)
+    : handler_(handler) {
+  HttpTransport::SetForTesting(this);
+}
+
+FakeHttpTransport::~FakeHttpTransport() {
+  HttpTransport::SetForTesting(NULL);
+}
+
+scoped_ptr<HttpConnection> FakeHttpTransport::CreateConnection() {
+  return scoped_ptr<HttpConnection>(new FakeConnection(this));
+}
+
+std::vector<HttpRequest> FakeHttpTransport::requests() const {
+  base::AutoLock lock(lock_);
+  return requests_;
+}
+
+bool FakeHttpTransport::Send(const HttpRequest& request,
+                             HttpResponse* response) {
+  base::AutoLock lock(lock_);
+  requests_.push_back(request);
+  *response = HttpResponse();
+  if (!request.abort_callback.is_null() && request.abort_callback.Run()) {
+    response->error = "Aborted.";
+    return false;
+  }
+  if (!handler_.Run(request, response)) {
+    if (response->error.empty())
+      response->error = "Connection failed.";
+    return false;
+  }
+  return true;
+}
+
+}  // namespace media
+}  // namespace edash_packager
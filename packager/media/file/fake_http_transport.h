@@ -0,0 +1,56 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_FILE_FAKE_HTTP_TRANSPORT_H_
+#define MEDIA_FILE_FAKE_HTTP_TRANSPORT_H_
+
+#include <vector>
+
+#include "packager/base/callback.h"
+#include "packager/base/synchronization/lock.h"
+#include "packager/media/file/http_transport.h"
+
+namespace edash_packager {
+namespace media {
+
+/// An HttpTransport which answers the requests of the Files with a handler
+/// instead of a server, and records them. It replaces the transport of the
+/// Files while it exists.
+class FakeHttpTransport : public HttpTransport {
+ public:
+  /// Fills the response to a request. Returns false to fail the request as
+  /// a network error would. The requests are handled one at a time.
+  typedef base::Callback<bool(const HttpRequest& request,
+                              HttpResponse* response)> Handler;
+
+  explicit FakeHttpTransport(const Handler& handler);
+  ~FakeHttpTransport() override;
+
+  /// @name HttpTransport implementation overrides.
+  /// @{
+  scoped_ptr<HttpConnection> CreateConnection() override;
+  /// @}
+
+  /// @return the requests received so far, in order.
+  std::vector<HttpRequest> requests() const;
+
+ private:
+  class FakeConnection;
+
+  bool Send(const HttpRequest& request, HttpResponse* response);
+
+  const Handler handler_;
+
+  mutable base::Lock lock_;  // Lock protecting the variables below.
+  std::vector<HttpRequest> requests_;
+
+  DISALLOW_COPY_AND_ASSIGN(FakeHttpTransport);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_FILE_FAKE_HTTP_TRANSPORT_H_
@@ -9,10 +9,22 @@
 #include <algorithm>
 
 #include <gflags/gflags.h>
+#include "packager/base/files/file_path.h"
+#include "packager/base/files/file_util.h"
 #include "packager/base/logging.h"
 #include "packager/base/memory/scoped_ptr.h"
+#include "packager/media/base/background_executor.h"
+#include "packager/media/base/job_resource_usage.h"
+#include "packager/media/file/follow_file.h"
+#include "packager/media/file/http_file.h"
+#include "packager/media/file/http_input_file.h"
+#include "packager/media/file/io_uring_file.h"
 #include "packager/media/file/local_file.h"
 #include "packager/media/file/memory_file.h"
+#include "packager/media/file/object_store_file.h"
+#include "packager/media/file/resource_usage_file.h"
+#include "packager/media/file/shm_file.h"
+#include "packager/media/file/tee_file.h"
 #include "packager/media/file/threaded_io_file.h"
 #include "packager/media/file/udp_file.h"
 #include "packager/base/strings/string_util.h"
@@ -24,6 +36,76 @@ DEFINE_uint64(io_cache_size,
 DEFINE_uint64(io_block_size,
               2ULL << 20,
               "Size of the block size used for threaded I/O, in bytes.");
+DEFINE_uint64(io_max_cache_size,
+              0,
+              "Maximum size of the threaded I/O cache of input files, in "
+              "bytes. If larger than io_cache_size, the read-ahead adapts to "
+              "each input: when the reader waits for data, the reads grow as "
+              "long as larger reads are faster, and the cache grows to hide "
+              "the latency of the reads at the rate of the reader.");
+DEFINE_uint64(io_max_output_cache_size,
+              0,
+              "Maximum size of the threaded I/O cache of output files, in "
+              "bytes. If larger than io_cache_size, a write which finds the "
+              "cache full grows it, up to this size, as long as the memory is "
+              "under its soft limits, see --memory_soft_limits and "
+              "--memory_budget, so that a burst of writes or a stall of the "
+              "storage does not block the muxer.");
+DEFINE_string(io_output_spool_dir,
+              "",
+              "Local directory to spool the writes of an output file to when "
+              "its threaded I/O cache is full and cannot grow, e.g. while a "
+              "network file system stalls, instead of blocking the muxer. "
+              "The spool is written to the output after the cache. Empty to "
+              "block instead.");
+DEFINE_bool(io_uring,
+            false,
+            "Linux only. Use a shared io_uring for local file I/O instead of "
+            "a helper thread per file. io_block_size is the request size and "
+            "io_cache_size / io_block_size the number of requests in flight "
+            "per file.");
+DEFINE_bool(io_direct,
+            false,
+            "Open local files with O_DIRECT, bypassing the page cache. Used "
+            "only if io_uring=true.");
+DEFINE_uint64(http_input_block_size,
+              4ULL << 20,
+              "Size of the range requests of http:// and https:// input "
+              "files, in bytes.");
+DEFINE_int32(http_input_parallel_requests,
+             4,
+             "Number of range requests of an http:// or https:// input file "
+             "in flight, on as many connections.");
+DEFINE_string(object_store_endpoint,
+              "https://storage.googleapis.com",
+              "URL of the S3 compatible object store of the s3:// output "
+              "files. s3://bucket/key is uploaded to <endpoint>/bucket/key.");
+DEFINE_uint64(object_store_part_size,
+              16ULL << 20,
+              "Size of the parts of the multipart uploads of s3:// output "
+              "files, in bytes. At least 5 MiB.");
+DEFINE_int32(object_store_parallel_uploads,
+             4,
+             "Number of parts of an s3:// output file uploaded in parallel.");
+DEFINE_string(follow_input_end_marker_suffix,
+              ".done",
+              "Suffix of the end marker of the follow:// input files: a "
+              "followed file is complete once a file named after it with "
+              "this suffix exists. Empty for no end marker.");
+DEFINE_int64(follow_input_idle_timeout_ms,
+             30000,
+             "A follow:// input file is complete once it has not grown for "
+             "this many milliseconds. 0 to wait for the end marker only.");
+DEFINE_string(shm_file_store,
+              "edash_packager",
+              "Name of the shared memory store of the shm:// files, which "
+              "lets a co-located origin server read the output without any "
+              "disk I/O.");
+DEFINE_uint64(shm_file_store_size,
+              1ULL << 30,
+              "Budget of the shared memory store, in bytes, if the packager "
+              "creates it. The least recently used files which are not open "
+              "are evicted to stay within the budget.");
 
 namespace edash_packager {
 namespace media {
@@ -31,6 +113,14 @@ namespace media {
 const char* kLocalFilePrefix = "file://";
 const char* kUdpFilePrefix = "udp://";
 const char* kMemoryFilePrefix = "memory://";
+const char* kShmFilePrefix = "shm://";
+const char* kHttpFilePrefix = "http://";
+const char* kHttpsFilePrefix = "https://";
+const char* kTeeFilePrefix = "tee://";
+const char* kObjectStoreFilePrefix = "s3://";
+const char* kFollowFilePrefix = "follow://";
+
+const int64_t File::kWouldBlock = -2;
 
 namespace {
 
@@ -52,6 +142,57 @@ bool DeleteLocalFile(const char* file_name) {
   return LocalFile::Delete(file_name);
 }
 
+bool IsShmFile(const char* file_name) {
+  return strncmp(file_name, kShmFilePrefix, strlen(kShmFilePrefix)) == 0;
+}
+
+bool IsTeeFile(const char* file_name) {
+  return strncmp(file_name, kTeeFilePrefix, strlen(kTeeFilePrefix)) == 0;
+}
+
+bool IsFollowFile(const char* file_name) {
+  return strncmp(file_name, kFollowFilePrefix, strlen(kFollowFilePrefix)) == 0;
+}
+
+bool IsObjectStoreFile(const char* file_name) {
+  return strncmp(file_name, kObjectStoreFilePrefix,
+                 strlen(kObjectStoreFilePrefix)) == 0;
+}
+
+bool IsHttpFile(const char* file_name) {
+  return strncmp(file_name, kHttpFilePrefix, strlen(kHttpFilePrefix)) == 0 ||
+         strncmp(file_name, kHttpsFilePrefix, strlen(kHttpsFilePrefix)) == 0;
+}
+
+// Returns the path of |file_name| if it is a local file, NULL otherwise.
+const char* GetLocalPath(const char* file_name) {
+  if (strncmp(file_name, kLocalFilePrefix, strlen(kLocalFilePrefix)) == 0)
+    return file_name + strlen(kLocalFilePrefix);
+  if (strncmp(file_name, kUdpFilePrefix, strlen(kUdpFilePrefix)) == 0 ||
+      strncmp(file_name, kMemoryFilePrefix, strlen(kMemoryFilePrefix)) == 0 ||
+      IsShmFile(file_name) || IsHttpFile(file_name) || IsTeeFile(file_name) ||
+      IsObjectStoreFile(file_name) || IsFollowFile(file_name)) {
+    return NULL;
+  }
+  return file_name;
+}
+
+bool IsIoUringMode(const char* mode) {
+  return !strcmp(mode, "r") || !strcmp(mode, "w") || !strcmp(mode, "a");
+}
+
+// Wraps |file| to account its bytes in the current JobResourceUsage, if any.
+// The destinations of tee files are accounted instead of the tee files, and
+// memory files do no I/O.
+File* AccountResourceUsage(const char* file_name, File* file) {
+  JobResourceUsage* usage = JobResourceUsage::Current();
+  if (!file || !usage || IsTeeFile(file_name) ||
+      !strncmp(file_name, kMemoryFilePrefix, strlen(kMemoryFilePrefix))) {
+    return file;
+  }
+  return new ResourceUsageFile(scoped_ptr<File, FileCloser>(file), usage);
+}
+
 File* CreateUdpFile(const char* file_name, const char* mode) {
   if (base::strcasecmp(mode, "r")) {
     NOTIMPLEMENTED() << "UdpFile only supports read (receive) mode.";
@@ -69,6 +210,61 @@ bool DeleteMemoryFile(const char* file_name) {
   return true;
 }
 
+File* CreateShmFile(const char* file_name, const char* mode) {
+  return new ShmFile(file_name, mode, FLAGS_shm_file_store,
+                     FLAGS_shm_file_store_size);
+}
+
+bool DeleteShmFile(const char* file_name) {
+  return ShmFile::Delete(file_name, FLAGS_shm_file_store);
+}
+
+// Input files are downloaded with range requests, output files uploaded.
+File* CreateHttpFileWithUrl(const std::string& url, const char* mode) {
+  if (!strcmp(mode, "r")) {
+    return new HttpInputFile(url.c_str(), FLAGS_http_input_block_size,
+                             FLAGS_http_input_parallel_requests);
+  }
+  return new HttpFile(url.c_str(), mode);
+}
+
+// The prefix is part of the URL.
+File* CreateHttpFile(const char* file_name, const char* mode) {
+  return CreateHttpFileWithUrl(std::string(kHttpFilePrefix) + file_name, mode);
+}
+
+File* CreateHttpsFile(const char* file_name, const char* mode) {
+  return CreateHttpFileWithUrl(std::string(kHttpsFilePrefix) + file_name,
+                               mode);
+}
+
+File* CreateObjectStoreFile(const char* file_name, const char* mode) {
+  std::string url = FLAGS_object_store_endpoint;
+  if (url.empty() || url[url.size() - 1] != '/')
+    url += '/';
+  return new ObjectStoreFile((url + file_name).c_str(), mode,
+                             FLAGS_object_store_part_size,
+                             FLAGS_object_store_parallel_uploads);
+}
+
+File* CreateFollowFile(const char* file_name, const char* mode) {
+  if (strcmp(mode, "r")) {
+    NOTIMPLEMENTED() << "FollowFile only supports read mode.";
+    return NULL;
+  }
+  return new FollowFile(
+      file_name, FLAGS_follow_input_end_marker_suffix,
+      base::TimeDelta::FromMilliseconds(FLAGS_follow_input_idle_timeout_ms));
+}
+
+File* CreateTeeFile(const char* file_name, const char* mode) {
+  return new TeeFile(file_name, mode);
+}
+
+bool DeleteTeeFile(const char* file_name) {
+  return TeeFile::Delete(file_name);
+}
+
 static const SupportedTypeInfo kSupportedTypeInfo[] = {
   {
     kLocalFilePrefix,
@@ -88,16 +284,82 @@ static const SupportedTypeInfo kSupportedTypeInfo[] = {
     &CreateMemoryFile,
     &DeleteMemoryFile
   },
+  {
+    kShmFilePrefix,
+    strlen(kShmFilePrefix),
+    &CreateShmFile,
+    &DeleteShmFile
+  },
+  {
+    kHttpFilePrefix,
+    strlen(kHttpFilePrefix),
+    &CreateHttpFile,
+    NULL
+  },
+  {
+    kHttpsFilePrefix,
+    strlen(kHttpsFilePrefix),
+    &CreateHttpsFile,
+    NULL
+  },
+  {
+    kTeeFilePrefix,
+    strlen(kTeeFilePrefix),
+    &CreateTeeFile,
+    &DeleteTeeFile
+  },
+  {
+    kObjectStoreFilePrefix,
+    strlen(kObjectStoreFilePrefix),
+    &CreateObjectStoreFile,
+    NULL
+  },
+  {
+    kFollowFilePrefix,
+    strlen(kFollowFilePrefix),
+    &CreateFollowFile,
+    NULL
+  },
 };
 
 }  // namespace
 
 File* File::Create(const char* file_name, const char* mode) {
+  if (FLAGS_io_uring && IsIoUringMode(mode)) {
+    const char* local_file_path = GetLocalPath(file_name);
+    if (local_file_path && IoUringFile::IsSupported()) {
+      const uint64_t num_blocks =
+          FLAGS_io_block_size ? FLAGS_io_cache_size / FLAGS_io_block_size : 0;
+      return new IoUringFile(local_file_path, mode, FLAGS_io_block_size,
+                             num_blocks, FLAGS_io_direct);
+    }
+    LOG_IF(WARNING, local_file_path)
+        << "io_uring is not supported. Falling back to threaded I/O.";
+  }
+
   scoped_ptr<File, FileCloser> internal_file(
       CreateInternalFile(file_name, mode));
 
-  if (!strncmp(file_name, kMemoryFilePrefix, strlen(kMemoryFilePrefix))) {
-    // Disable caching for memory files.
+  if (!strncmp(file_name, kMemoryFilePrefix, strlen(kMemoryFilePrefix)) ||
+      IsShmFile(file_name) || (IsHttpFile(file_name) && strcmp(mode, "r")) ||
+      IsTeeFile(file_name) || IsObjectStoreFile(file_name)) {
+    // Disable caching for memory and shared memory files. HTTP and object
+    // store output files queue the data for their own upload threads
+    // already, and the destinations of tee files are opened with their own
+    // caches. HTTP input files are cached, so that the reader does not wait
+    // for each block.
+    return internal_file.release();
+  }
+
+  const bool threaded_io_mode =
+      !strcmp(mode, "r") || !strcmp(mode, "w") || !strcmp(mode, "a");
+  if (FLAGS_io_cache_size && threaded_io_mode &&
+      !BackgroundExecutor::GetInstance()->ReserveThread(
+          BackgroundExecutor::kFileIoQueue)) {
+    // The I/O loop of the file would occupy a thread of the queue as long as
+    // the file is open, see --file_io_threads.
+    VLOG(1) << "No file I/O thread left for " << file_name
+            << ". Threaded I/O is disabled.";
     return internal_file.release();
   }
 
@@ -107,12 +369,17 @@ File* File::Create(const char* file_name, const char* mode) {
       return new ThreadedIoFile(internal_file.Pass(),
                                 ThreadedIoFile::kInputMode,
                                 FLAGS_io_cache_size,
-                                FLAGS_io_block_size);
+                                FLAGS_io_block_size,
+                                FLAGS_io_max_cache_size);
     } else if (!strcmp(mode, "w") || !strcmp(mode, "a")) {
-      return new ThreadedIoFile(internal_file.Pass(),
-                                ThreadedIoFile::kOutputMode,
-                                FLAGS_io_cache_size,
-                                FLAGS_io_block_size);
+      ThreadedIoFile* file =
+          new ThreadedIoFile(internal_file.Pass(),
+                             ThreadedIoFile::kOutputMode,
+                             FLAGS_io_cache_size,
+                             FLAGS_io_block_size,
+                             FLAGS_io_max_output_cache_size);
+      file->set_output_spool_dir(FLAGS_io_output_spool_dir);
+      return file;
     }
   }
 
@@ -138,7 +405,8 @@ File* File::CreateInternalFile(const char* file_name, const char* mode) {
 }
 
 File* File::Open(const char* file_name, const char* mode) {
-  File* file = File::Create(file_name, mode);
+  File* file =
+      AccountResourceUsage(file_name, File::Create(file_name, mode));
   if (!file)
     return NULL;
   if (!file->Open()) {
@@ -148,6 +416,21 @@ File* File::Open(const char* file_name, const char* mode) {
   return file;
 }
 
+File* File::OpenWithExpectedSize(const char* file_name,
+                                 const char* mode,
+                                 uint64_t expected_size) {
+  File* file =
+      AccountResourceUsage(file_name, File::Create(file_name, mode));
+  if (!file)
+    return NULL;
+  file->SetExpectedSize(expected_size);
+  if (!file->Open()) {
+    delete file;
+    return NULL;
+  }
+  return file;
+}
+
 File* File::OpenWithNoBuffering(const char* file_name, const char* mode) {
   File* file = File::CreateInternalFile(file_name, mode);
   if (!file)
@@ -159,6 +442,29 @@ File* File::OpenWithNoBuffering(const char* file_name, const char* mode) {
   return file;
 }
 
+int64_t File::WriteV(const WriteBlock* blocks, size_t num_blocks) {
+  int64_t bytes_written = 0;
+  for (size_t i = 0; i < num_blocks; ++i) {
+    const int64_t result = Write(blocks[i].data, blocks[i].length);
+    if (result < 0)
+      return bytes_written > 0 ? bytes_written : result;
+    bytes_written += result;
+    if (static_cast<uint64_t>(result) < blocks[i].length)
+      break;
+  }
+  return bytes_written;
+}
+
+int64_t File::TryRead(void* buffer, uint64_t length) {
+  return Read(buffer, length);
+}
+
+uint64_t File::GetCachedSize() {
+  return 0;
+}
+
+void File::SetExpectedSize(uint64_t size) {}
+
 bool File::Delete(const char* file_name) {
   for (size_t i = 0; i < arraysize(kSupportedTypeInfo); ++i) {
     const SupportedTypeInfo& type_info = kSupportedTypeInfo[i];
@@ -172,6 +478,23 @@ bool File::Delete(const char* file_name) {
   return DeleteLocalFile(file_name);
 }
 
+bool File::Link(const char* existing_file_name, const char* new_file_name) {
+  const char* existing_path = GetLocalPath(existing_file_name);
+  const char* new_path = GetLocalPath(new_file_name);
+  if (!existing_path || !new_path)
+    return false;
+  return LocalFile::Link(existing_path, new_path);
+}
+
+bool File::GetLocalFilePath(const std::string& file_name, std::string* path) {
+  DCHECK(path);
+  const char* local_path = GetLocalPath(file_name.c_str());
+  if (!local_path)
+    return false;
+  path->assign(local_path);
+  return true;
+}
+
 int64_t File::GetFileSize(const char* file_name) {
   File* file = File::Open(file_name, "r");
   if (!file)
@@ -199,6 +522,49 @@ bool File::ReadFileToString(const char* file_name, std::string* contents) {
   return len == 0;
 }
 
+bool File::WriteFileAtomically(const char* file_name,
+                               const std::string& contents) {
+  const char* local_file_path = GetLocalPath(file_name);
+  const std::string temp_file_name =
+      local_file_path ? std::string(file_name) + ".tmp" : file_name;
+
+  scoped_ptr<File, FileCloser> file(
+      File::Open(temp_file_name.c_str(), "w"));
+  if (!file) {
+    LOG(ERROR) << "Failed to open file " << temp_file_name;
+    return false;
+  }
+  const char* data = contents.data();
+  size_t bytes_left = contents.size();
+  while (bytes_left > 0) {
+    const int64_t bytes_written = file->Write(data, bytes_left);
+    if (bytes_written <= 0) {
+      LOG(ERROR) << "Failed to write to " << temp_file_name << " ("
+                 << bytes_written << ").";
+      return false;
+    }
+    data += bytes_written;
+    bytes_left -= bytes_written;
+  }
+  // Close() destructs the file, release it from the scoped_ptr.
+  if (!file.release()->Close()) {
+    LOG(ERROR) << "Failed to close " << temp_file_name;
+    return false;
+  }
+
+  if (!local_file_path)
+    return true;
+  const std::string local_file(local_file_path);
+  base::File::Error error;
+  if (!base::ReplaceFile(base::FilePath(local_file + ".tmp"),
+                         base::FilePath(local_file), &error)) {
+    LOG(ERROR) << "Failed to rename " << temp_file_name << " to "
+               << file_name << " (" << error << ").";
+    return false;
+  }
+  return true;
+}
+
 bool File::Copy(const char* from_file_name, const char* to_file_name) {
   std::string content;
   if (!ReadFileToString(from_file_name, &content)) {
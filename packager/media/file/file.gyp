@@ -13,18 +13,51 @@
       'target_name': 'file',
       'type': '<(component)',
       'sources': [
+        'checksum_file.cc',
+        'checksum_file.h',
         'file.cc',
         'file.h',
         'file_closer.h',
+        'file_open_ahead.cc',
+        'file_open_ahead.h',
+        'follow_file.cc',
+        'follow_file.h',
+        'http_file.cc',
+        'http_file.h',
+        'http_input_file.cc',
+        'http_input_file.h',
+        'http_transport.cc',
+        'http_transport.h',
+        'incremental_gzip_compressor.cc',
+        'incremental_gzip_compressor.h',
         'io_cache.cc',
         'io_cache.h',
+        'io_uring_file.h',
         'local_file.cc',
         'local_file.h',
+        'manifest_sink.cc',
+        'manifest_sink.h',
         'memory_file.cc',
         'memory_file.h',
+        'object_store_file.cc',
+        'object_store_file.h',
+        'output_deduplicator.cc',
+        'output_deduplicator.h',
+        'record_log.cc',
+        'record_log.h',
+        'resource_usage_file.cc',
+        'resource_usage_file.h',
+        'rtp_fec_decoder.cc',
+        'rtp_fec_decoder.h',
+        'shm_file.cc',
+        'shm_file.h',
+        'tee_file.cc',
+        'tee_file.h',
         'threaded_io_file.cc',
         'threaded_io_file.h',
         'udp_file.h',
+        'udp_jitter_buffer.cc',
+        'udp_jitter_buffer.h',
       ],
       'conditions': [
         ['OS == "win"', {
@@ -36,10 +69,23 @@
             'udp_file_posix.cc',
           ],
         }],
+        ['OS == "linux"', {
+          'sources': [
+            'io_uring_file_linux.cc',
+            'shm_file_store_linux.cc',
+          ],
+        }, {
+          'sources': [
+            'io_uring_file_unsupported.cc',
+            'shm_file_store_unsupported.cc',
+          ],
+        }],
       ],
       'dependencies': [
         '../../base/base.gyp:base',
+        '../../third_party/curl/curl.gyp:libcurl',
         '../../third_party/gflags/gflags.gyp:gflags',
+        '../../third_party/zlib/zlib.gyp:zlib',
         '../base/media_base.gyp:media_base',
       ],
     },
@@ -47,12 +93,49 @@
       'target_name': 'file_unittest',
       'type': '<(gtest_target_type)',
       'sources': [
+        'checksum_file_unittest.cc',
+        'fake_http_transport.cc',
+        'fake_http_transport.h',
+        'file_open_ahead_unittest.cc',
         'file_unittest.cc',
+        'follow_file_unittest.cc',
+        'http_input_file_unittest.cc',
+        'incremental_gzip_compressor_unittest.cc',
         'io_cache_unittest.cc',
+        'io_uring_file_unittest.cc',
         'memory_file_unittest.cc',
+        'object_store_file_unittest.cc',
+        'output_deduplicator_unittest.cc',
+        'record_log_unittest.cc',
+        'rtp_fec_decoder_unittest.cc',
+        'tee_file_unittest.cc',
+        'udp_jitter_buffer_unittest.cc',
+      ],
+      'conditions': [
+        ['OS != "win"', {
+          'sources': [
+            'shm_file_unittest.cc',
+            'udp_file_unittest.cc',
+          ],
+        }],
+      ],
+      'dependencies': [
+        '../../testing/gtest.gyp:gtest',
+        '../../third_party/gflags/gflags.gyp:gflags',
+        '../../third_party/zlib/zlib.gyp:zlib',
+        '../test/media_test.gyp:run_tests_with_atexit_manager',
+        'file',
+      ],
+    },
+    {
+      'target_name': 'file_perftest',
+      'type': '<(gtest_target_type)',
+      'sources': [
+        'file_perftest.cc',
       ],
       'dependencies': [
         '../../testing/gtest.gyp:gtest',
+        '../../testing/perf/perf_test.gyp:perf_test',
         '../../third_party/gflags/gflags.gyp:gflags',
         '../test/media_test.gyp:run_tests_with_atexit_manager',
         'file',
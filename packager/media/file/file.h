@@ -18,11 +18,20 @@ namespace media {
 
 extern const char* kLocalFilePrefix;
 extern const char* kMemoryFilePrefix;
+extern const char* kShmFilePrefix;
+extern const char* kTeeFilePrefix;
+extern const char* kFollowFilePrefix;
 const int64_t kWholeFile = -1;
 
 /// Define an abstract file interface.
 class File {
  public:
+  /// A block of memory to be written by WriteV().
+  struct WriteBlock {
+    const void* data;
+    uint64_t length;
+  };
+
   /// Open the specified file.
   /// This is a file factory method, it opens a proper file automatically
   /// based on prefix, e.g. "file://" for LocalFile.
@@ -31,6 +40,16 @@ class File {
   /// @return A File pointer on success, false otherwise.
   static File* Open(const char* file_name, const char* mode);
 
+  /// Open the specified file for writing, with a hint of its final size.
+  /// Local files preallocate the disk space, other files ignore the hint.
+  /// @param file_name is the file to be opened.
+  /// @param mode is the access mode, "w" or "a".
+  /// @param expected_size is the expected size of the file, in bytes.
+  /// @return A File pointer on success, NULL otherwise.
+  static File* OpenWithExpectedSize(const char* file_name,
+                                    const char* mode,
+                                    uint64_t expected_size);
+
   /// Open the specified file in direct-access mode (no buffering).
   /// This is a file factory method, it opens a proper file automatically
   /// based on prefix, e.g. "file://" for LocalFile.
@@ -44,6 +63,12 @@ class File {
   /// @return true if successful, false otherwise.
   static bool Delete(const char* file_name);
 
+  /// Make @a new_file_name a hard link to @a existing_file_name, so that the
+  /// contents are stored once. Only local files are supported.
+  /// @return true if successful, false otherwise, in which case the contents
+  ///         have to be written to @a new_file_name.
+  static bool Link(const char* existing_file_name, const char* new_file_name);
+
   /// Flush() and de-allocate resources associated with this file, and
   /// delete this File object.  THIS IS THE ONE TRUE WAY TO DEALLOCATE
   /// THIS OBJECT.
@@ -59,12 +84,29 @@ class File {
   ///         Zero on end-of-file, or if 'length' is zero.
   virtual int64_t Read(void* buffer, uint64_t length) = 0;
 
+  /// Same as Read(), but returns kWouldBlock instead of waiting for data
+  /// which is not available yet, e.g. at the end of a file still being
+  /// written. The default implementation calls Read().
+  virtual int64_t TryRead(void* buffer, uint64_t length);
+
+  /// Returned by TryRead() if no data is available yet.
+  static const int64_t kWouldBlock;
+
   /// Write block of data.
   /// @param buffer points to a block of memory with at least @a length bytes.
   /// @param length indicates number of bytes to write.
   /// @return Number of bytes written, or a value < 0 on error.
   virtual int64_t Write(const void* buffer, uint64_t length) = 0;
 
+  /// Write several blocks of data, in order, e.g. to write data scattered in
+  /// memory without gathering it in a buffer first. The default
+  /// implementation calls Write() for every block.
+  /// @param blocks points to @a num_blocks blocks.
+  /// @param num_blocks is the number of blocks to write.
+  /// @return Number of bytes written, which may be less than the total size
+  ///         of the blocks, or a value < 0 on error.
+  virtual int64_t WriteV(const WriteBlock* blocks, size_t num_blocks);
+
   /// @return Size of the file in bytes. A return value less than zero
   ///         indicates a problem getting the size.
   virtual int64_t Size() = 0;
@@ -87,6 +129,12 @@ class File {
   /// @return true on succcess, false otherwise.
   virtual bool Tell(uint64_t* position) = 0;
 
+  /// @return Number of bytes buffered by the file and not consumed yet, i.e.
+  ///         read ahead but not read by the caller for input files, or
+  ///         written by the caller but not to the underlying file for output
+  ///         files. The default implementation returns 0.
+  virtual uint64_t GetCachedSize();
+
   /// @return The file name.
   const std::string& file_name() const { return file_name_; }
 
@@ -94,6 +142,14 @@ class File {
   // * Static Methods: File-on-the-filesystem status
   // ************************************************************
 
+  /// Get the path of a file on the local filesystem, e.g. for memory mapping.
+  /// @param file_name is the file name, with or without the "file://" prefix.
+  /// @param path[out] is set to the local path on success. Should not be
+  ///        NULL.
+  /// @return true if @a file_name is a local file, false if it is handled by
+  ///         another file type, e.g. memory, udp, http or tee files.
+  static bool GetLocalFilePath(const std::string& file_name, std::string* path);
+
   /// @return The size of a file in bytes on success, a value < 0 otherwise.
   ///         The file will be opened and closed in the process.
   static int64_t GetFileSize(const char* file_name);
@@ -104,6 +160,16 @@ class File {
   /// @return true on success, false otherwise.
   static bool ReadFileToString(const char* file_name, std::string* contents);
 
+  /// Write a string to a file. Local files are replaced atomically: the
+  /// contents are written to a temporary file in the same directory, which is
+  /// then renamed to @a file_name, so readers never see a partial file. Other
+  /// file types are written in place.
+  /// @param file_name is the file to be written.
+  /// @param contents is the data to be written.
+  /// @return true on success, false otherwise.
+  static bool WriteFileAtomically(const char* file_name,
+                                  const std::string& contents);
+
   /// Copies files. This is not good for copying huge files. Although not
   /// recommended, it is safe to have source file and destination file name be
   /// the same.
@@ -134,7 +200,12 @@ class File {
   /// Internal open. Should not be used directly.
   virtual bool Open() = 0;
 
+  /// Hints the expected size of the file, in bytes, before Open(). The
+  /// default implementation ignores it.
+  virtual void SetExpectedSize(uint64_t size);
+
  private:
+  friend class ResourceUsageFile;
   friend class ThreadedIoFile;
 
   // This is a file factory method, it creates a proper file, e.g.
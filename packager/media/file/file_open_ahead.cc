@@ -0,0 +1,122 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/file/file_open_ahead.h"
+
+#include <string.h>
+
+#include "packager/base/bind.h"
+#include "packager/base/files/file_util.h"
+#include "packager/base/logging.h"
+#include "packager/media/base/background_executor.h"
+#include "packager/media/base/cancellation_token.h"
+#include "packager/media/base/cpu_affinity.h"
+#include "packager/media/base/io_throttle.h"
+#include "packager/media/base/job_resource_usage.h"
+#include "packager/media/file/file.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+bool HasPrefix(const std::string& file_name, const char* prefix) {
+  return file_name.compare(0, strlen(prefix), prefix) == 0;
+}
+
+// Returns true if |file_name| can be opened ahead: a local file which does
+// not exist, or a memory or shared memory file. The other files, e.g. HTTP
+// uploads, cannot be deleted if they turn out not to be used.
+bool CanOpenAhead(const std::string& file_name) {
+  if (HasPrefix(file_name, kMemoryFilePrefix) ||
+      HasPrefix(file_name, kShmFilePrefix)) {
+    return true;
+  }
+  std::string path = file_name;
+  if (HasPrefix(path, kLocalFilePrefix))
+    path = path.substr(strlen(kLocalFilePrefix));
+  else if (path.find("://") != std::string::npos)
+    return false;
+  return !base::PathExists(base::FilePath(path));
+}
+
+}  // namespace
+
+FileOpenAhead::FileOpenAhead(const OpenFileCB& open_file_cb)
+    : open_file_cb_(open_file_cb),
+      file_(NULL),
+      open_pending_(false),
+      open_complete_event_(false, false) {}
+
+FileOpenAhead::~FileOpenAhead() {
+  Discard();
+}
+
+void FileOpenAhead::Start(const std::string& file_name) {
+  Discard();
+  file_name_ = file_name;
+  open_pending_ = true;
+
+  std::vector<int> cpus;
+  GetCurrentThreadAffinity(&cpus);
+  BackgroundExecutor::GetInstance()->PostTask(
+      BackgroundExecutor::kFileIoQueue,
+      base::Bind(&FileOpenAhead::OpenTask, base::Unretained(this), cpus,
+                 make_scoped_refptr(CancellationToken::Current()),
+                 make_scoped_refptr(IoThrottle::Current()),
+                 make_scoped_refptr(JobResourceUsage::Current())));
+}
+
+File* FileOpenAhead::Open(const std::string& file_name) {
+  if (file_name_ != file_name) {
+    Discard();
+    return open_file_cb_.Run(file_name);
+  }
+  WaitForOpen();
+  File* file = file_;
+  file_ = NULL;
+  file_name_.clear();
+  // The file existed, or failed to open ahead; open it now.
+  return file ? file : open_file_cb_.Run(file_name);
+}
+
+void FileOpenAhead::Discard() {
+  if (file_name_.empty())
+    return;
+  WaitForOpen();
+  if (file_) {
+    VLOG(1) << "Discarding " << file_name_ << ", opened ahead.";
+    if (!file_->Close())
+      LOG(WARNING) << "Failed to close the file properly: " << file_name_;
+    if (!File::Delete(file_name_.c_str()))
+      LOG(WARNING) << "Failed to delete " << file_name_;
+    file_ = NULL;
+  }
+  file_name_.clear();
+}
+
+void FileOpenAhead::OpenTask(
+    const std::vector<int>& cpus,
+    const scoped_refptr<CancellationToken>& cancellation_token,
+    const scoped_refptr<IoThrottle>& io_throttle,
+    const scoped_refptr<JobResourceUsage>& resource_usage) {
+  ScopedThreadAffinity affinity(cpus);
+  ScopedCancellationToken scoped_token(cancellation_token.get());
+  ScopedIoThrottle scoped_throttle(io_throttle.get());
+  ScopedJobResourceUsage scoped_usage(resource_usage.get());
+  file_ = CanOpenAhead(file_name_) ? open_file_cb_.Run(file_name_) : NULL;
+  open_complete_event_.Signal();
+}
+
+void FileOpenAhead::WaitForOpen() {
+  if (!open_pending_)
+    return;
+  open_complete_event_.Wait();
+  open_pending_ = false;
+}
+
+}  // namespace media
+}  // namespace edash_packager
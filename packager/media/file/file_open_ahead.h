@@ -0,0 +1,83 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_FILE_FILE_OPEN_AHEAD_H_
+#define MEDIA_FILE_FILE_OPEN_AHEAD_H_
+
+#include <string>
+#include <vector>
+
+#include "packager/base/callback.h"
+#include "packager/base/memory/ref_counted.h"
+#include "packager/base/synchronization/waitable_event.h"
+
+namespace edash_packager {
+namespace media {
+
+class CancellationToken;
+class File;
+class IoThrottle;
+class JobResourceUsage;
+
+/// Opens the next output file, e.g. the next segment, on a worker thread
+/// ahead of its use, so that a slow file creation, e.g. on a network file
+/// system, is off the thread writing the output. The file is opened with the
+/// CPU affinity, the cancellation token and the I/O throttle of the thread
+/// starting the open, which its I/O thread inherits.
+///
+/// A file opened ahead and not used is closed and deleted. So a local file
+/// which exists already is not opened ahead, lest a file of another job be
+/// truncated, nor a file which cannot be deleted, e.g. an HTTP upload; these
+/// are opened when used.
+class FileOpenAhead {
+ public:
+  /// Opens @a file_name for writing, e.g. with File::Open(). Returns NULL on
+  /// failure.
+  typedef base::Callback<File*(const std::string& file_name)> OpenFileCB;
+
+  /// @param open_file_cb opens the files, on the worker thread for the files
+  ///        opened ahead.
+  explicit FileOpenAhead(const OpenFileCB& open_file_cb);
+  /// Discards the file opened ahead, if any.
+  ~FileOpenAhead();
+
+  /// Starts opening @a file_name on a worker thread. A file opened ahead
+  /// before and not used is discarded.
+  void Start(const std::string& file_name);
+
+  /// Gets the file @a file_name, opened ahead if it is the file started, once
+  /// its open completes, or opened by the calling thread otherwise.
+  /// @return The file, owned by the caller, or NULL on failure.
+  File* Open(const std::string& file_name);
+
+  /// Discards the file opened ahead, if any, i.e. closes and deletes it.
+  void Discard();
+
+ private:
+  // Opens |file_name_| into |file_|. Runs on a worker thread.
+  void OpenTask(const std::vector<int>& cpus,
+                const scoped_refptr<CancellationToken>& cancellation_token,
+                const scoped_refptr<IoThrottle>& io_throttle,
+                const scoped_refptr<JobResourceUsage>& resource_usage);
+  // Waits for the open started, if any, to complete.
+  void WaitForOpen();
+
+  OpenFileCB open_file_cb_;
+  // The file opened ahead, empty if none.
+  std::string file_name_;
+  // Set by OpenTask(): the file opened, or NULL if it existed already or the
+  // open failed.
+  File* file_;
+  bool open_pending_;
+  base::WaitableEvent open_complete_event_;
+
+  DISALLOW_COPY_AND_ASSIGN(FileOpenAhead);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_FILE_FILE_OPEN_AHEAD_H_
@@ -0,0 +1,108 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+
+#include "packager/base/bind.h"
+#include "packager/base/files/file_util.h"
+#include "packager/media/file/file.h"
+#include "packager/media/file/file_open_ahead.h"
+#include "packager/media/file/memory_file.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+const char kFileName[] = "memory://segment1.m4s";
+const char kOtherFileName[] = "memory://segment2.m4s";
+const uint8_t kData[] = {1, 2, 3, 4};
+
+File* OpenFileForWrite(const std::string& file_name) {
+  return File::Open(file_name.c_str(), "w");
+}
+
+bool FileExists(const char* file_name) {
+  File* file = File::Open(file_name, "r");
+  if (!file)
+    return false;
+  file->Close();
+  return true;
+}
+}  // namespace
+
+class FileOpenAheadTest : public testing::Test {
+ public:
+  FileOpenAheadTest() : open_ahead_(base::Bind(&OpenFileForWrite)) {}
+
+  void TearDown() override { MemoryFile::DeleteAll(); }
+
+ protected:
+  FileOpenAhead open_ahead_;
+};
+
+TEST_F(FileOpenAheadTest, OpenFileStarted) {
+  open_ahead_.Start(kFileName);
+  File* file = open_ahead_.Open(kFileName);
+  ASSERT_TRUE(file);
+  EXPECT_EQ(static_cast<int64_t>(sizeof(kData)),
+            file->Write(kData, sizeof(kData)));
+  EXPECT_TRUE(file->Close());
+  EXPECT_EQ(static_cast<int64_t>(sizeof(kData)),
+            File::GetFileSize(kFileName));
+}
+
+TEST_F(FileOpenAheadTest, OpenOtherFile) {
+  open_ahead_.Start(kFileName);
+  File* file = open_ahead_.Open(kOtherFileName);
+  ASSERT_TRUE(file);
+  EXPECT_TRUE(file->Close());
+  // The file opened ahead is deleted.
+  EXPECT_FALSE(FileExists(kFileName));
+  EXPECT_TRUE(FileExists(kOtherFileName));
+}
+
+TEST_F(FileOpenAheadTest, Discard) {
+  open_ahead_.Start(kFileName);
+  open_ahead_.Discard();
+  EXPECT_FALSE(FileExists(kFileName));
+  // Nothing left to discard.
+  open_ahead_.Discard();
+}
+
+TEST_F(FileOpenAheadTest, DiscardOnDestruction) {
+  {
+    FileOpenAhead open_ahead(base::Bind(&OpenFileForWrite));
+    open_ahead.Start(kFileName);
+  }
+  EXPECT_FALSE(FileExists(kFileName));
+}
+
+// An existing local file is not truncated ahead of its use, nor deleted if
+// it is not used.
+TEST_F(FileOpenAheadTest, ExistingLocalFile) {
+  base::FilePath path;
+  ASSERT_TRUE(base::CreateTemporaryFile(&path));
+  ASSERT_EQ(static_cast<int>(sizeof(kData)),
+            base::WriteFile(path, reinterpret_cast<const char*>(kData),
+                            sizeof(kData)));
+  open_ahead_.Start(path.value());
+  open_ahead_.Discard();
+  int64_t file_size = 0;
+  ASSERT_TRUE(base::GetFileSize(path, &file_size));
+  EXPECT_EQ(static_cast<int64_t>(sizeof(kData)), file_size);
+
+  // The file is opened when used.
+  open_ahead_.Start(path.value());
+  File* file = open_ahead_.Open(path.value());
+  ASSERT_TRUE(file);
+  EXPECT_TRUE(file->Close());
+  ASSERT_TRUE(base::GetFileSize(path, &file_size));
+  EXPECT_EQ(0, file_size);
+  base::DeleteFile(path, false);
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,294 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+// I/O benchmarks of the File backends: local files, with and without
+// threaded I/O over a range of io_cache_size and io_block_size, memory files
+// and UDP over the loopback interface. Each scenario reports the throughput,
+// the number of read and write system calls of the process (Linux only),
+// which includes those of the I/O threads, and the 99th percentile of the
+// latency of the File calls.
+
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "packager/base/files/file_path.h"
+#include "packager/base/files/file_util.h"
+#include "packager/base/strings/string_number_conversions.h"
+#include "packager/base/strings/string_split.h"
+#include "packager/base/strings/stringprintf.h"
+#include "packager/base/time/time.h"
+#include "packager/media/file/file.h"
+#include "packager/media/file/file_closer.h"
+#include "packager/media/file/memory_file.h"
+#include "packager/testing/perf/perf_test.h"
+
+#if defined(OS_POSIX)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+DECLARE_uint64(io_cache_size);
+DECLARE_uint64(io_block_size);
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+// Amount of data written or read by each scenario.
+const int64_t kBytesPerScenario = 128 * 1024 * 1024;
+const double kBytesPerMB = 1024 * 1024;
+
+// The sizes of the calls of each access pattern, repeated until
+// kBytesPerScenario bytes are transferred.
+// Large sequential reads and writes.
+const size_t kSequentialCalls[] = {64 * 1024};
+// The writes of MkvWriter: the element IDs and sizes, the block headers, then
+// the frames.
+const size_t kMkvWriterCalls[] = {4, 8, 1, 4, 1500, 1, 4, 9000, 1, 4, 600};
+// The writes of BufferWriter::WriteToFile: whole fragments or segments.
+const size_t kBufferWriterCalls[] = {300 * 1024, 48 * 1024, 1200 * 1024};
+
+// The threaded I/O settings: io_cache_size, io_block_size.
+const uint64_t kThreadedIoSettings[][2] = {
+    {8 << 20, 1 << 20}, {32 << 20, 2 << 20}, {64 << 20, 8 << 20}};
+
+// The UDP scenario: 7 TS packets per datagram, sent in bursts.
+const char kUdpAddress[] = "127.0.0.1";
+const uint16_t kUdpPort = 42391;
+const size_t kDatagramSize = 7 * 188;
+const int kDatagramsPerBurst = 32;
+
+// Returns the number of read and write system calls of the process so far,
+// or false if they are not available on this platform.
+bool GetSyscallCounts(uint64_t* reads, uint64_t* writes) {
+#if defined(OS_LINUX)
+  std::string content;
+  if (!base::ReadFileToString(base::FilePath("/proc/self/io"), &content))
+    return false;
+  std::vector<std::string> lines;
+  base::SplitString(content, '\n', &lines);
+  bool found_reads = false;
+  bool found_writes = false;
+  for (const std::string& line : lines) {
+    std::vector<std::string> fields;
+    base::SplitString(line, ':', &fields);
+    if (fields.size() != 2)
+      continue;
+    if (fields[0] == "syscr")
+      found_reads = base::StringToUint64(fields[1], reads);
+    else if (fields[0] == "syscw")
+      found_writes = base::StringToUint64(fields[1], writes);
+  }
+  return found_reads && found_writes;
+#else
+  return false;
+#endif
+}
+
+// Measures a scenario: the latency of its calls, its duration, the bytes
+// transferred and the system calls.
+class ScenarioStats {
+ public:
+  ScenarioStats() : num_bytes_(0), start_reads_(0), start_writes_(0) {
+    has_syscalls_ = GetSyscallCounts(&start_reads_, &start_writes_);
+    start_ = base::TimeTicks::Now();
+  }
+
+  // Accounts a File call which took |latency| and transferred |num_bytes|
+  // bytes.
+  void AddCall(base::TimeDelta latency, int64_t num_bytes) {
+    latencies_.push_back(latency);
+    if (num_bytes > 0)
+      num_bytes_ += num_bytes;
+  }
+
+  // Ends the scenario and prints its results.
+  void Report(const std::string& trace) {
+    const double seconds = (base::TimeTicks::Now() - start_).InSecondsF();
+    perf_test::PrintResult("file_throughput", "", trace,
+                           num_bytes_ / seconds / kBytesPerMB, "MB/s", true);
+    if (!latencies_.empty()) {
+      std::sort(latencies_.begin(), latencies_.end());
+      const size_t p99 = std::min(latencies_.size() - 1,
+                                  latencies_.size() * 99 / 100);
+      perf_test::PrintResult("file_call_latency_p99", "", trace,
+                             latencies_[p99].InMicrosecondsF(), "us", true);
+      perf_test::PrintResult("file_calls", "", trace, latencies_.size(),
+                             "calls", false);
+    }
+    uint64_t reads = 0;
+    uint64_t writes = 0;
+    if (has_syscalls_ && GetSyscallCounts(&reads, &writes)) {
+      perf_test::PrintResult("file_syscalls", "", trace,
+                             static_cast<size_t>(reads - start_reads_ +
+                                                 writes - start_writes_),
+                             "syscalls", true);
+    }
+  }
+
+ private:
+  std::vector<base::TimeDelta> latencies_;
+  int64_t num_bytes_;
+  bool has_syscalls_;
+  uint64_t start_reads_;
+  uint64_t start_writes_;
+  base::TimeTicks start_;
+};
+
+}  // namespace
+
+class FilePerfTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    ASSERT_TRUE(base::CreateNewTempDirectory("file_perf_", &test_directory_));
+    io_cache_size_ = FLAGS_io_cache_size;
+    io_block_size_ = FLAGS_io_block_size;
+  }
+
+  void TearDown() override {
+    FLAGS_io_cache_size = io_cache_size_;
+    FLAGS_io_block_size = io_block_size_;
+    base::DeleteFile(test_directory_, true);
+    MemoryFile::DeleteAll();
+  }
+
+ protected:
+  // Opens a file of the backend named |backend|.
+  File* OpenFile(const std::string& backend, const char* mode) {
+    if (backend == "memory")
+      return File::Open("memory://file_perf", mode);
+    const std::string path =
+        test_directory_.AppendASCII("file_perf").value();
+    if (backend == "local")
+      return File::OpenWithNoBuffering(path.c_str(), mode);
+    return File::Open(path.c_str(), mode);
+  }
+
+  // Writes kBytesPerScenario bytes with calls of |call_sizes|, cycling.
+  void MeasureWrites(const std::string& backend,
+                     const std::string& pattern,
+                     const size_t* call_sizes,
+                     size_t num_call_sizes) {
+    const std::vector<uint8_t> buffer(
+        *std::max_element(call_sizes, call_sizes + num_call_sizes), 0x5a);
+    ScenarioStats stats;
+    scoped_ptr<File, FileCloser> file(OpenFile(backend, "w"));
+    ASSERT_TRUE(file);
+    int64_t bytes_written = 0;
+    for (size_t i = 0; bytes_written < kBytesPerScenario; ++i) {
+      const size_t size = call_sizes[i % num_call_sizes];
+      const base::TimeTicks start = base::TimeTicks::Now();
+      const int64_t result = file->Write(buffer.data(), size);
+      stats.AddCall(base::TimeTicks::Now() - start, result);
+      ASSERT_EQ(static_cast<int64_t>(size), result);
+      bytes_written += result;
+    }
+    // The data has to reach the backend.
+    ASSERT_TRUE(file.release()->Close());
+    stats.Report(backend + "_" + pattern);
+  }
+
+  // Reads the file written by the previous scenario in kSequentialCalls.
+  void MeasureReads(const std::string& backend) {
+    std::vector<uint8_t> buffer(kSequentialCalls[0]);
+    ScenarioStats stats;
+    scoped_ptr<File, FileCloser> file(OpenFile(backend, "r"));
+    ASSERT_TRUE(file);
+    while (true) {
+      const base::TimeTicks start = base::TimeTicks::Now();
+      const int64_t result = file->Read(buffer.data(), buffer.size());
+      stats.AddCall(base::TimeTicks::Now() - start, result);
+      ASSERT_GE(result, 0);
+      if (result == 0)
+        break;
+    }
+    stats.Report(backend + "_sequential_read");
+  }
+
+  void MeasureBackend(const std::string& backend) {
+    MeasureWrites(backend, "mkv_writer", kMkvWriterCalls,
+                  arraysize(kMkvWriterCalls));
+    MeasureWrites(backend, "buffer_writer", kBufferWriterCalls,
+                  arraysize(kBufferWriterCalls));
+    MeasureWrites(backend, "sequential_write", kSequentialCalls,
+                  arraysize(kSequentialCalls));
+    MeasureReads(backend);
+  }
+
+  base::FilePath test_directory_;
+
+ private:
+  uint64_t io_cache_size_;
+  uint64_t io_block_size_;
+};
+
+TEST_F(FilePerfTest, LocalFile) {
+  MeasureBackend("local");
+}
+
+TEST_F(FilePerfTest, ThreadedIoFile) {
+  for (const uint64_t* settings : kThreadedIoSettings) {
+    FLAGS_io_cache_size = settings[0];
+    FLAGS_io_block_size = settings[1];
+    MeasureBackend(base::StringPrintf(
+        "threaded_%dMB_%dMB", static_cast<int>(settings[0] >> 20),
+        static_cast<int>(settings[1] >> 20)));
+  }
+}
+
+TEST_F(FilePerfTest, MemoryFile) {
+  MeasureBackend("memory");
+}
+
+#if defined(OS_POSIX)
+// Sends datagrams over the loopback interface to a UdpFile and reads them, in
+// bursts small enough for the socket receive buffer.
+TEST_F(FilePerfTest, UdpFileLoopback) {
+  scoped_ptr<File, FileCloser> file(File::OpenWithNoBuffering(
+      base::StringPrintf("udp://%s:%d", kUdpAddress, kUdpPort).c_str(), "r"));
+  ASSERT_TRUE(file);
+
+  const int sender = socket(AF_INET, SOCK_DGRAM, 0);
+  ASSERT_GE(sender, 0);
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons(kUdpPort);
+  ASSERT_EQ(1, inet_pton(AF_INET, kUdpAddress, &address.sin_addr));
+
+  const std::vector<uint8_t> datagram(kDatagramSize, 0x47);
+  std::vector<uint8_t> buffer(64 * 1024);
+  ScenarioStats stats;
+  int64_t bytes_read = 0;
+  while (bytes_read < kBytesPerScenario) {
+    for (int i = 0; i < kDatagramsPerBurst; ++i) {
+      ASSERT_EQ(static_cast<ssize_t>(datagram.size()),
+                sendto(sender, datagram.data(), datagram.size(), 0,
+                       reinterpret_cast<struct sockaddr*>(&address),
+                       sizeof(address)));
+    }
+    for (int i = 0; i < kDatagramsPerBurst; ++i) {
+      const base::TimeTicks start = base::TimeTicks::Now();
+      const int64_t result = file->Read(buffer.data(), buffer.size());
+      stats.AddCall(base::TimeTicks::Now() - start, result);
+      ASSERT_EQ(static_cast<int64_t>(kDatagramSize), result);
+      bytes_read += result;
+    }
+  }
+  stats.Report("udp_loopback_read");
+  close(sender);
+}
+#endif  // defined(OS_POSIX)
+
+}  // namespace media
+}  // namespace edash_packager
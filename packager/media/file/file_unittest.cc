@@ -8,10 +8,15 @@
 #include <gtest/gtest.h>
 
 #include "packager/base/files/file_util.h"
+#include "packager/media/base/job_resource_usage.h"
 #include "packager/media/file/file.h"
+#include "packager/media/file/local_file.h"
 
 DECLARE_uint64(io_cache_size);
 DECLARE_uint64(io_block_size);
+DECLARE_uint64(io_max_cache_size);
+DECLARE_uint64(io_max_output_cache_size);
+DECLARE_string(io_output_spool_dir);
 
 namespace {
 const int kDataSize = 1024;
@@ -105,6 +110,126 @@ TEST_F(LocalFileTest, Write) {
   EXPECT_EQ(data_, read_data);
 }
 
+TEST_F(LocalFileTest, WriteV) {
+  // Open the local file directly, so its own WriteV() is used.
+  File* file = File::OpenWithNoBuffering(local_file_name_.c_str(), "w");
+  ASSERT_TRUE(file != NULL);
+  // Mix buffered and vectored writes, which must end up in order.
+  const int kPrefixSize = 10;
+  EXPECT_EQ(kPrefixSize, file->Write(&data_[0], kPrefixSize));
+  const File::WriteBlock blocks[] = {
+      {&data_[kPrefixSize], 100},
+      {&data_[kPrefixSize + 100], 0},
+      {&data_[kPrefixSize + 100], 500},
+  };
+  EXPECT_EQ(600, file->WriteV(blocks, arraysize(blocks)));
+  uint64_t position = 0;
+  ASSERT_TRUE(file->Tell(&position));
+  EXPECT_EQ(kPrefixSize + 600u, position);
+  const int kSuffixSize = kDataSize - kPrefixSize - 600;
+  EXPECT_EQ(kSuffixSize, file->Write(&data_[kPrefixSize + 600], kSuffixSize));
+  EXPECT_TRUE(file->Close());
+
+  std::string read_data(kDataSize, 0);
+  ASSERT_EQ(kDataSize,
+            base::ReadFile(test_file_path_, &read_data[0], kDataSize));
+  EXPECT_EQ(data_, read_data);
+}
+
+// The space preallocated beyond the data written does not change the size of
+// the file.
+TEST_F(LocalFileTest, WriteWithExpectedSize) {
+  File* file = File::OpenWithExpectedSize(local_file_name_.c_str(), "w",
+                                          100 * kDataSize);
+  ASSERT_TRUE(file != NULL);
+  EXPECT_EQ(kDataSize, file->Write(&data_[0], kDataSize));
+  EXPECT_TRUE(file->Close());
+  EXPECT_EQ(kDataSize, File::GetFileSize(local_file_name_.c_str()));
+
+  std::string read_data(kDataSize, 0);
+  ASSERT_EQ(kDataSize,
+            base::ReadFile(test_file_path_, &read_data[0], kDataSize));
+  EXPECT_EQ(data_, read_data);
+}
+
+TEST_F(LocalFileTest, SyncPolicies) {
+  const LocalFileSyncPolicy kPolicies[] = {kSyncPerSegment, kSyncOnClose};
+  for (LocalFileSyncPolicy policy : kPolicies) {
+    LocalFile::SetSyncPolicy(policy);
+    File* file = File::Open(local_file_name_.c_str(), "w");
+    ASSERT_TRUE(file != NULL);
+    EXPECT_EQ(kDataSize, file->Write(&data_[0], kDataSize));
+    EXPECT_TRUE(file->Flush());
+    EXPECT_EQ(kDataSize, file->Write(&data_[0], kDataSize));
+    EXPECT_TRUE(file->Close());
+    EXPECT_EQ(2 * kDataSize, File::GetFileSize(local_file_name_.c_str()));
+  }
+  LocalFile::SetSyncPolicy(kNoSync);
+}
+
+TEST(LocalFileSyncPolicyTest, Parse) {
+  LocalFileSyncPolicy policy = kNumLocalFileSyncPolicies;
+  ASSERT_TRUE(LocalFile::ParseSyncPolicy("none", &policy));
+  EXPECT_EQ(kNoSync, policy);
+  ASSERT_TRUE(LocalFile::ParseSyncPolicy("segment", &policy));
+  EXPECT_EQ(kSyncPerSegment, policy);
+  ASSERT_TRUE(LocalFile::ParseSyncPolicy("close", &policy));
+  EXPECT_EQ(kSyncOnClose, policy);
+  EXPECT_FALSE(LocalFile::ParseSyncPolicy("always", &policy));
+}
+
+TEST_F(LocalFileTest, WriteFileAtomically) {
+  ASSERT_EQ(kDataSize,
+            base::WriteFile(test_file_path_, data_.data(), kDataSize));
+
+  // Replaces the existing file, without leaving the temporary file behind.
+  const std::string kContents = "new contents";
+  ASSERT_TRUE(
+      File::WriteFileAtomically(local_file_name_.c_str(), kContents));
+
+  std::string read_data;
+  ASSERT_TRUE(base::ReadFileToString(test_file_path_, &read_data));
+  EXPECT_EQ(kContents, read_data);
+  EXPECT_FALSE(
+      base::PathExists(base::FilePath(local_file_name_no_prefix_ + ".tmp")));
+}
+
+#if defined(OS_POSIX)
+TEST_F(LocalFileTest, Link) {
+  ASSERT_EQ(kDataSize,
+            base::WriteFile(test_file_path_, data_.data(), kDataSize));
+  base::FilePath link_path;
+  ASSERT_TRUE(base::CreateTemporaryFile(&link_path));
+
+  // Replaces the existing file.
+  ASSERT_TRUE(File::Link(local_file_name_.c_str(), link_path.value().c_str()));
+  std::string read_data;
+  ASSERT_TRUE(base::ReadFileToString(link_path, &read_data));
+  EXPECT_EQ(data_, read_data);
+  base::DeleteFile(link_path, false);
+
+  // Only local files can be linked.
+  EXPECT_FALSE(File::Link(local_file_name_.c_str(), "memory://link"));
+}
+#endif  // defined(OS_POSIX)
+
+TEST(FileTest, GetLocalFilePath) {
+  std::string path;
+  ASSERT_TRUE(File::GetLocalFilePath("file:///tmp/a.mp4", &path));
+  EXPECT_EQ("/tmp/a.mp4", path);
+  ASSERT_TRUE(File::GetLocalFilePath("a.mp4", &path));
+  EXPECT_EQ("a.mp4", path);
+
+  EXPECT_FALSE(File::GetLocalFilePath("memory://a.mp4", &path));
+  EXPECT_FALSE(File::GetLocalFilePath("udp://1.2.3.4:5", &path));
+  EXPECT_FALSE(File::GetLocalFilePath("http://host/a.mp4", &path));
+  EXPECT_FALSE(File::GetLocalFilePath("https://host/a.mp4", &path));
+  EXPECT_FALSE(File::GetLocalFilePath("s3://bucket/a.mp4", &path));
+  EXPECT_FALSE(File::GetLocalFilePath("tee://a.mp4|b.mp4", &path));
+  EXPECT_FALSE(File::GetLocalFilePath("follow://a.mp4", &path));
+  EXPECT_FALSE(File::GetLocalFilePath("shm://a.mp4", &path));
+}
+
 TEST_F(LocalFileTest, Read_And_Eof) {
   // Write file using file_util API.
   ASSERT_EQ(kDataSize,
@@ -173,6 +298,93 @@ TEST_F(LocalFileTest, WriteFlushCheckSize) {
   }
 }
 
+TEST_F(LocalFileTest, AccountsResourceUsage) {
+  scoped_refptr<JobResourceUsage> usage = new JobResourceUsage;
+  {
+    ScopedJobResourceUsage scoped_usage(usage.get());
+    File* file = File::Open(local_file_name_.c_str(), "w");
+    ASSERT_TRUE(file != NULL);
+    EXPECT_EQ(kDataSize, file->Write(&data_[0], kDataSize));
+    EXPECT_TRUE(file->Close());
+
+    file = File::Open(local_file_name_.c_str(), "r");
+    ASSERT_TRUE(file != NULL);
+    std::string read_data(kDataSize, 0);
+    EXPECT_EQ(kDataSize, file->Read(&read_data[0], kDataSize));
+    EXPECT_TRUE(file->Close());
+  }
+  EXPECT_NE(std::string::npos,
+            usage->ToJson().find(
+                "\"" + local_file_name_no_prefix_ +
+                "\":{\"bytes_read\":1024,\"bytes_written\":1024}"));
+}
+
+TEST_F(LocalFileTest, AdaptiveReadAhead) {
+  const uint64_t kBlockSize(16);
+  const int kNumWrites(64);
+
+  google::FlagSaver flag_saver;
+  FLAGS_io_block_size = kBlockSize;
+  FLAGS_io_cache_size = 4 * kBlockSize;
+  FLAGS_io_max_cache_size = kNumWrites * kDataSize;
+
+  File* file = File::Open(local_file_name_.c_str(), "w");
+  ASSERT_TRUE(file != NULL);
+  for (int i = 0; i < kNumWrites; ++i)
+    ASSERT_EQ(kDataSize, file->Write(data_.data(), kDataSize));
+  ASSERT_TRUE(file->Close());
+
+  // The read-ahead may grow while the file is read, without changing the
+  // data read.
+  file = File::Open(local_file_name_.c_str(), "r");
+  ASSERT_TRUE(file != NULL);
+  std::string read_data(kDataSize, 0);
+  for (int i = 0; i < kNumWrites; ++i) {
+    int64_t bytes_read = 0;
+    while (bytes_read < kDataSize) {
+      const int64_t read_result =
+          file->Read(&read_data[bytes_read], kDataSize - bytes_read);
+      ASSERT_LT(0, read_result);
+      bytes_read += read_result;
+    }
+    EXPECT_EQ(data_, read_data);
+  }
+  EXPECT_EQ(0, file->Read(&read_data[0], kDataSize));
+  EXPECT_TRUE(file->Close());
+}
+
+// Writes larger than the cache, which may grow or spool them, are written in
+// order.
+TEST_F(LocalFileTest, OutputCacheGrowthAndSpool) {
+  const uint64_t kBlockSize(16);
+  const int kNumWrites(64);
+  base::FilePath spool_dir;
+  ASSERT_TRUE(base::CreateNewTempDirectory("", &spool_dir));
+
+  google::FlagSaver flag_saver;
+  FLAGS_io_block_size = kBlockSize;
+  FLAGS_io_cache_size = 4 * kBlockSize;
+  FLAGS_io_max_output_cache_size = 4 * kDataSize;
+  FLAGS_io_output_spool_dir = spool_dir.value();
+
+  std::string expected_data;
+  File* file = File::Open(local_file_name_.c_str(), "w");
+  ASSERT_TRUE(file != NULL);
+  for (int i = 0; i < kNumWrites; ++i) {
+    const std::string data = data_.substr(i) + data_.substr(0, i);
+    ASSERT_EQ(kDataSize, file->Write(data.data(), kDataSize));
+    expected_data += data;
+  }
+  ASSERT_TRUE(file->Close());
+
+  std::string read_data;
+  ASSERT_TRUE(File::ReadFileToString(local_file_name_.c_str(), &read_data));
+  EXPECT_EQ(expected_data, read_data);
+  // The spool file is deleted with the file.
+  EXPECT_TRUE(base::IsDirectoryEmpty(spool_dir));
+  EXPECT_TRUE(base::DeleteFile(spool_dir, false));
+}
+
 class ParamLocalFileTest : public LocalFileTest,
                            public ::testing::WithParamInterface<uint8_t> {
 };
@@ -279,5 +491,12 @@ TEST_F(LocalFileTest, DISABLED_ReadSeekOutOfBounds) {
   EXPECT_TRUE(file->Close());
 }
 
+TEST(HttpFileTest, WriteOnly) {
+  // Nothing is sent for unsupported modes.
+  EXPECT_EQ(NULL, File::Open("http://localhost/segment.m4s", "r"));
+  EXPECT_EQ(NULL, File::Open("https://localhost/segment.m4s", "a"));
+  EXPECT_FALSE(File::Delete("http://localhost/segment.m4s"));
+}
+
 }  // namespace media
 }  // namespace edash_packager
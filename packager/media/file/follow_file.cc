@@ -0,0 +1,184 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/file/follow_file.h"
+
+#include <algorithm>
+
+#include "packager/base/logging.h"
+#include "packager/base/threading/platform_thread.h"
+
+#if defined(OS_LINUX)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+// Bounds of the backoff of the polls of the file, which are also the waits
+// for the end marker, which is not watched.
+const int64_t kMinPollIntervalMs = 10;
+const int64_t kMaxPollIntervalMs = 500;
+
+}  // namespace
+
+FollowFile::FollowFile(const char* file_name,
+                       const std::string& end_marker_suffix,
+                       base::TimeDelta idle_timeout)
+    : File(file_name),
+      end_marker_suffix_(end_marker_suffix),
+      idle_timeout_(idle_timeout),
+      position_(0),
+      end_marker_seen_(false),
+      inotify_fd_(-1) {}
+
+FollowFile::~FollowFile() {
+#if defined(OS_LINUX)
+  if (inotify_fd_ >= 0)
+    close(inotify_fd_);
+#endif
+}
+
+bool FollowFile::Open() {
+  // The internal file is cached by the caller, if at all.
+  file_.reset(File::OpenWithNoBuffering(file_name().c_str(), "r"));
+  if (!file_)
+    return false;
+  cancellation_token_ = CancellationToken::Current();
+
+#if defined(OS_LINUX)
+  inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd_ >= 0 &&
+      inotify_add_watch(inotify_fd_, file_name().c_str(),
+                        IN_MODIFY | IN_CLOSE_WRITE) < 0) {
+    // Not a local file. It is polled instead.
+    close(inotify_fd_);
+    inotify_fd_ = -1;
+  }
+#endif
+  return true;
+}
+
+bool FollowFile::Close() {
+  bool result = file_.release()->Close();
+  delete this;
+  return result;
+}
+
+int64_t FollowFile::Read(void* buffer, uint64_t length) {
+  int64_t poll_interval_ms = kMinPollIntervalMs;
+  while (true) {
+    const int64_t result = TryRead(buffer, length);
+    if (result != kWouldBlock)
+      return result;
+    if (!WaitForData(base::TimeDelta::FromMilliseconds(poll_interval_ms)))
+      return -1;
+    poll_interval_ms = std::min(poll_interval_ms * 2, kMaxPollIntervalMs);
+  }
+}
+
+int64_t FollowFile::TryRead(void* buffer, uint64_t length) {
+  while (true) {
+    const int64_t result = file_->Read(buffer, length);
+    if (result > 0) {
+      position_ += result;
+      idle_start_time_ = base::TimeTicks();
+    }
+    if (result != 0 || end_marker_seen_)
+      return result;
+
+    // Clears the end of file state of the internal file.
+    if (!file_->Seek(position_))
+      return -1;
+    if (EndMarkerExists()) {
+      end_marker_seen_ = true;
+      continue;
+    }
+    const base::TimeTicks now = base::TimeTicks::Now();
+    if (idle_start_time_.is_null())
+      idle_start_time_ = now;
+    if (idle_timeout_ > base::TimeDelta() &&
+        now - idle_start_time_ >= idle_timeout_) {
+      LOG(INFO) << file_name() << " has not grown for "
+                << idle_timeout_.InMilliseconds() << " ms. Assuming it is "
+                << "complete.";
+      return 0;
+    }
+    return kWouldBlock;
+  }
+}
+
+int64_t FollowFile::Write(const void* buffer, uint64_t length) {
+  NOTIMPLEMENTED() << "FollowFile does not support Write().";
+  return -1;
+}
+
+int64_t FollowFile::Size() {
+  return File::GetFileSize(file_name().c_str());
+}
+
+bool FollowFile::Flush() {
+  NOTIMPLEMENTED() << "FollowFile does not support Flush().";
+  return false;
+}
+
+bool FollowFile::Seek(uint64_t position) {
+  if (!file_->Seek(position))
+    return false;
+  position_ = position;
+  return true;
+}
+
+bool FollowFile::Tell(uint64_t* position) {
+  *position = position_;
+  return true;
+}
+
+bool FollowFile::WaitForData(base::TimeDelta max_wait) {
+#if defined(OS_LINUX)
+  if (inotify_fd_ >= 0) {
+    // The file is watched, so the wait is only bounded by the end marker
+    // checks and the cancellation checks.
+    const base::TimeTicks end_time =
+        base::TimeTicks::Now() +
+        base::TimeDelta::FromMilliseconds(kMaxPollIntervalMs);
+    while (true) {
+      if (cancellation_token_ && cancellation_token_->IsCancelled())
+        return false;
+      const int64_t wait_ms =
+          std::min((end_time - base::TimeTicks::Now()).InMilliseconds(),
+                   cancellation_token_ ? kCancellationCheckIntervalMs
+                                       : kMaxPollIntervalMs);
+      if (wait_ms <= 0)
+        return true;
+      struct pollfd poll_fd = {inotify_fd_, POLLIN, 0};
+      if (poll(&poll_fd, 1, static_cast<int>(wait_ms)) > 0) {
+        // Drains the events; the file is read again anyway.
+        char events[4096];
+        while (read(inotify_fd_, events, sizeof(events)) > 0) {
+        }
+        return true;
+      }
+    }
+  }
+#endif
+  if (cancellation_token_)
+    return !cancellation_token_->WaitForCancellation(max_wait);
+  base::PlatformThread::Sleep(max_wait);
+  return true;
+}
+
+bool FollowFile::EndMarkerExists() const {
+  return !end_marker_suffix_.empty() &&
+         File::GetFileSize((file_name() + end_marker_suffix_).c_str()) >= 0;
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,89 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_FILE_FOLLOW_FILE_H_
+#define MEDIA_FILE_FOLLOW_FILE_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "packager/base/memory/ref_counted.h"
+#include "packager/base/time/time.h"
+#include "packager/media/base/cancellation_token.h"
+#include "packager/media/file/file.h"
+#include "packager/media/file/file_closer.h"
+
+namespace edash_packager {
+namespace media {
+
+/// Implements a read only File which follows a file still being written,
+/// e.g. a live recording: at the end of the file, Read() waits for more data
+/// instead of returning 0, until the file is complete. The file is complete
+/// once its end marker, a file named after it with a suffix, exists, or once
+/// it has not grown for an idle timeout. The growth of local files is
+/// watched with inotify on Linux; otherwise the file is polled with a
+/// backoff.
+class FollowFile : public File {
+ public:
+  /// @param file_name is the name of the file followed.
+  /// @param end_marker_suffix is the suffix of the name of the end marker,
+  ///        e.g. ".done", or empty for no end marker.
+  /// @param idle_timeout is the time the file may not grow before it is
+  ///        complete, or zero to wait for the end marker only.
+  FollowFile(const char* file_name,
+             const std::string& end_marker_suffix,
+             base::TimeDelta idle_timeout);
+
+  /// @name File implementation overrides.
+  /// @{
+  bool Close() override;
+  /// Waits for the file to grow at the end of the file.
+  /// @return 0 once the file is complete, -1 on error or if the job is
+  ///         cancelled.
+  int64_t Read(void* buffer, uint64_t length) override;
+  /// Returns kWouldBlock at the end of the file until it is complete.
+  int64_t TryRead(void* buffer, uint64_t length) override;
+  int64_t Write(const void* buffer, uint64_t length) override;
+  /// @return the current size of the file.
+  int64_t Size() override;
+  bool Flush() override;
+  bool Seek(uint64_t position) override;
+  bool Tell(uint64_t* position) override;
+  /// @}
+
+ protected:
+  ~FollowFile() override;
+
+  bool Open() override;
+
+ private:
+  // Waits for at most |max_wait| for the file to grow.
+  // Returns false if the job is cancelled.
+  bool WaitForData(base::TimeDelta max_wait);
+  bool EndMarkerExists() const;
+
+  const std::string end_marker_suffix_;
+  const base::TimeDelta idle_timeout_;
+  scoped_ptr<File, FileCloser> file_;
+  uint64_t position_;
+  // The time the file stopped growing, null while it grows.
+  base::TimeTicks idle_start_time_;
+  // Set once the end marker is seen. The file is read to its end once more,
+  // since data may have been written just before the marker.
+  bool end_marker_seen_;
+  // The inotify watch of the file, -1 if none.
+  int inotify_fd_;
+  // The token of the job opening the file, NULL if none.
+  scoped_refptr<CancellationToken> cancellation_token_;
+
+  DISALLOW_COPY_AND_ASSIGN(FollowFile);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_FILE_FOLLOW_FILE_H_
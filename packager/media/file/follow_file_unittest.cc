@@ -0,0 +1,109 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+#include <string.h>
+
+#include <string>
+
+#include "packager/base/bind.h"
+#include "packager/base/files/file_path.h"
+#include "packager/base/files/file_util.h"
+#include "packager/base/threading/platform_thread.h"
+#include "packager/media/base/closure_thread.h"
+#include "packager/media/file/file.h"
+
+DECLARE_string(follow_input_end_marker_suffix);
+DECLARE_int64(follow_input_idle_timeout_ms);
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+const char kFirstData[] = "recorded";
+const char kSecondData[] = " then appended";
+const int64_t kAppendDelayMs = 100;
+
+// Appends |data| to |path| after a delay, then creates its end marker.
+void AppendAndEnd(const base::FilePath& path, const std::string& data) {
+  base::PlatformThread::Sleep(
+      base::TimeDelta::FromMilliseconds(kAppendDelayMs));
+  ASSERT_TRUE(base::AppendToFile(path, data.data(), data.size()));
+  const base::FilePath end_marker(path.value() + ".done");
+  ASSERT_EQ(0, base::WriteFile(end_marker, "", 0));
+}
+
+}  // namespace
+
+class FollowFileTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(base::CreateTemporaryFile(&path_));
+    ASSERT_EQ(static_cast<int>(strlen(kFirstData)),
+              base::WriteFile(path_, kFirstData, strlen(kFirstData)));
+    follow_file_name_ = std::string(kFollowFilePrefix) + path_.value();
+  }
+
+  void TearDown() override {
+    base::DeleteFile(path_, false);
+    base::DeleteFile(base::FilePath(path_.value() + ".done"), false);
+  }
+
+  base::FilePath path_;
+  std::string follow_file_name_;
+};
+
+TEST_F(FollowFileTest, WaitsForEndMarker) {
+  google::FlagSaver flag_saver;
+  FLAGS_follow_input_end_marker_suffix = ".done";
+  FLAGS_follow_input_idle_timeout_ms = 0;
+
+  ClosureThread writer("Writer",
+                       base::Bind(&AppendAndEnd, path_, kSecondData));
+  writer.Start();
+  std::string contents;
+  ASSERT_TRUE(File::ReadFileToString(follow_file_name_.c_str(), &contents));
+  writer.Join();
+  EXPECT_EQ(std::string(kFirstData) + kSecondData, contents);
+}
+
+TEST_F(FollowFileTest, IdleTimeout) {
+  google::FlagSaver flag_saver;
+  FLAGS_follow_input_end_marker_suffix = "";
+  FLAGS_follow_input_idle_timeout_ms = 50;
+
+  std::string contents;
+  ASSERT_TRUE(File::ReadFileToString(follow_file_name_.c_str(), &contents));
+  EXPECT_EQ(kFirstData, contents);
+}
+
+TEST_F(FollowFileTest, TryReadDoesNotWait) {
+  google::FlagSaver flag_saver;
+  FLAGS_follow_input_end_marker_suffix = ".done";
+  FLAGS_follow_input_idle_timeout_ms = 0;
+
+  File* file = File::OpenWithNoBuffering(follow_file_name_.c_str(), "r");
+  ASSERT_TRUE(file);
+  char buffer[64];
+  EXPECT_EQ(static_cast<int64_t>(strlen(kFirstData)),
+            file->TryRead(buffer, sizeof(buffer)));
+  EXPECT_EQ(File::kWouldBlock, file->TryRead(buffer, sizeof(buffer)));
+
+  ASSERT_TRUE(base::AppendToFile(path_, kSecondData, strlen(kSecondData)));
+  EXPECT_EQ(static_cast<int64_t>(strlen(kSecondData)),
+            file->TryRead(buffer, sizeof(buffer)));
+  EXPECT_EQ(File::kWouldBlock, file->TryRead(buffer, sizeof(buffer)));
+
+  const base::FilePath end_marker(path_.value() + ".done");
+  ASSERT_EQ(0, base::WriteFile(end_marker, "", 0));
+  EXPECT_EQ(0, file->TryRead(buffer, sizeof(buffer)));
+  EXPECT_TRUE(file->Close());
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,249 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/file/http_file.h"
+
+#include <curl/curl.h>
+#include <gflags/gflags.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "packager/base/bind.h"
+#include "packager/base/bind_helpers.h"
+#include "packager/base/lazy_instance.h"
+#include "packager/base/logging.h"
+#include "packager/base/strings/stringprintf.h"
+#include "packager/media/base/closure_thread.h"
+#include "packager/media/base/curl_share.h"
+
+DEFINE_string(http_upload_method,
+              "PUT",
+              "HTTP method used to upload http:// and https:// output files. "
+              "Either PUT or POST.");
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+const char kUserAgentString[] = "edash-packager-http_file/1.0";
+// Write() blocks while this much data is waiting to be sent.
+const size_t kMaxQueuedSize = 4 << 20;
+
+// The idle curl handles of the process. A handle holds on to its connections,
+// so they are reused by the next upload made with it.
+class IdleCurlHandles {
+ public:
+  IdleCurlHandles() {}
+  ~IdleCurlHandles() {
+    for (CURL* curl : handles_)
+      curl_easy_cleanup(curl);
+  }
+
+  // Returns an idle handle, reset to the default options, or a new handle if
+  // there is none. Returns NULL on failure.
+  CURL* Acquire() {
+    CURL* curl = NULL;
+    {
+      base::AutoLock lock(lock_);
+      if (!handles_.empty()) {
+        curl = handles_.back();
+        handles_.pop_back();
+      }
+    }
+    if (curl) {
+      curl_easy_reset(curl);
+    } else {
+      curl = curl_easy_init();
+    }
+    return curl;
+  }
+
+  void Release(CURL* curl) {
+    base::AutoLock lock(lock_);
+    handles_.push_back(curl);
+  }
+
+ private:
+  base::Lock lock_;
+  std::vector<CURL*> handles_;
+
+  DISALLOW_COPY_AND_ASSIGN(IdleCurlHandles);
+};
+
+base::LazyInstance<IdleCurlHandles>::Leaky g_idle_curl_handles =
+    LAZY_INSTANCE_INITIALIZER;
+
+}  // namespace
+
+HttpFile::HttpFile(const char* url, const char* mode)
+    : File(url),
+      mode_(mode),
+      size_(0),
+      condition_(&lock_),
+      queue_offset_(0),
+      closed_(false),
+      upload_done_(false),
+      upload_succeeded_(false) {}
+
+HttpFile::~HttpFile() {}
+
+bool HttpFile::Open() {
+  if (mode_ != "w") {
+    NOTIMPLEMENTED() << "HttpFile only supports write mode.";
+    return false;
+  }
+  if (FLAGS_http_upload_method != "PUT" &&
+      FLAGS_http_upload_method != "POST") {
+    LOG(ERROR) << "Unsupported http_upload_method "
+               << FLAGS_http_upload_method;
+    return false;
+  }
+  upload_thread_.reset(new ClosureThread(
+      "HttpFile", base::Bind(&HttpFile::Upload, base::Unretained(this))));
+  upload_thread_->Start();
+  return true;
+}
+
+bool HttpFile::Close() {
+  {
+    base::AutoLock lock(lock_);
+    closed_ = true;
+    condition_.Broadcast();
+  }
+  bool result = false;
+  if (upload_thread_) {
+    upload_thread_->Join();
+    result = upload_succeeded_;
+  }
+  delete this;
+  return result;
+}
+
+int64_t HttpFile::Read(void* buffer, uint64_t length) {
+  NOTIMPLEMENTED() << "HttpFile does not support Read().";
+  return -1;
+}
+
+int64_t HttpFile::Write(const void* buffer, uint64_t length) {
+  base::AutoLock lock(lock_);
+  while (!upload_done_ && queue_.size() - queue_offset_ >= kMaxQueuedSize)
+    condition_.Wait();
+  if (upload_done_)
+    return -1;
+
+  if (queue_offset_ == queue_.size()) {
+    queue_.clear();
+    queue_offset_ = 0;
+  }
+  queue_.append(static_cast<const char*>(buffer), length);
+  size_ += length;
+  condition_.Broadcast();
+  return length;
+}
+
+int64_t HttpFile::Size() {
+  return size_;
+}
+
+bool HttpFile::Flush() {
+  base::AutoLock lock(lock_);
+  while (!upload_done_ && queue_offset_ < queue_.size())
+    condition_.Wait();
+  return !upload_done_ || upload_succeeded_;
+}
+
+bool HttpFile::Seek(uint64_t position) {
+  NOTIMPLEMENTED() << "HttpFile does not support Seek().";
+  return false;
+}
+
+bool HttpFile::Tell(uint64_t* position) {
+  *position = size_;
+  return true;
+}
+
+void HttpFile::Upload() {
+  CURLSH* curl_share = GetCurlShare();
+  CURL* curl = g_idle_curl_handles.Get().Acquire();
+  if (!curl) {
+    LOG(ERROR) << "curl_easy_init() failed.";
+    base::AutoLock lock(lock_);
+    upload_done_ = true;
+    condition_.Broadcast();
+    return;
+  }
+
+  // Chunked transfer encoding sends the data as soon as it is written. The
+  // empty Expect header skips the "100 Continue" round trip.
+  struct curl_slist* headers = NULL;
+  headers = curl_slist_append(headers, "Transfer-Encoding: chunked");
+  headers = curl_slist_append(headers, "Expect:");
+
+  if (curl_share)
+    curl_easy_setopt(curl, CURLOPT_SHARE, curl_share);
+  curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+  curl_easy_setopt(curl, CURLOPT_URL, file_name().c_str());
+  curl_easy_setopt(curl, CURLOPT_USERAGENT, kUserAgentString);
+  curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+  if (FLAGS_http_upload_method == "POST")
+    curl_easy_setopt(curl, CURLOPT_POST, 1L);
+  else
+    curl_easy_setopt(curl, CURLOPT_UPLOAD, 1L);
+  curl_easy_setopt(curl, CURLOPT_READFUNCTION, ReadCallback);
+  curl_easy_setopt(curl, CURLOPT_READDATA, this);
+
+  const CURLcode res = curl_easy_perform(curl);
+  long response_code = 0;
+  if (res == CURLE_HTTP_RETURNED_ERROR)
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+  // The handle must not keep pointers to |headers| and |this|.
+  curl_easy_reset(curl);
+  g_idle_curl_handles.Get().Release(curl);
+  curl_slist_free_all(headers);
+
+  if (res != CURLE_OK) {
+    std::string error_message = base::StringPrintf(
+        "curl_easy_perform() failed: %s.", curl_easy_strerror(res));
+    if (res == CURLE_HTTP_RETURNED_ERROR) {
+      error_message +=
+          base::StringPrintf(" Response code: %ld.", response_code);
+    }
+    LOG(ERROR) << "Failed to upload " << file_name() << ". " << error_message;
+  }
+
+  base::AutoLock lock(lock_);
+  upload_done_ = true;
+  upload_succeeded_ = res == CURLE_OK;
+  condition_.Broadcast();
+}
+
+size_t HttpFile::ReadCallback(char* buffer,
+                              size_t size,
+                              size_t nmemb,
+                              void* user_data) {
+  return static_cast<HttpFile*>(user_data)->ReadQueuedData(buffer,
+                                                           size * nmemb);
+}
+
+size_t HttpFile::ReadQueuedData(char* buffer, size_t length) {
+  base::AutoLock lock(lock_);
+  while (!closed_ && queue_offset_ == queue_.size())
+    condition_.Wait();
+
+  // Returning 0 ends the request.
+  const size_t read_size = std::min(length, queue_.size() - queue_offset_);
+  memcpy(buffer, queue_.data() + queue_offset_, read_size);
+  queue_offset_ += read_size;
+  condition_.Broadcast();
+  return read_size;
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,88 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_FILE_HTTP_FILE_H_
+#define MEDIA_FILE_HTTP_FILE_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/synchronization/condition_variable.h"
+#include "packager/base/synchronization/lock.h"
+#include "packager/media/file/file.h"
+
+namespace edash_packager {
+namespace media {
+
+class ClosureThread;
+
+/// Implements a write only File which uploads its content to an HTTP(S)
+/// server, e.g. a CDN origin. The upload starts when the file is opened. The
+/// data is sent with chunked transfer encoding as it is written, so a segment
+/// reaches the server while it is being produced. The upload completes when
+/// the file is closed. Connections are kept alive and reused by the next
+/// upload to the same server.
+class HttpFile : public File {
+ public:
+  /// @param url is the URL which the content is uploaded to, including the
+  ///        scheme.
+  /// @param mode is the file mode. Only "w" is supported.
+  HttpFile(const char* url, const char* mode);
+
+  /// @name File implementation overrides.
+  /// @{
+  /// Waits for the upload to complete.
+  /// @return true if the server accepted the upload.
+  bool Close() override;
+  int64_t Read(void* buffer, uint64_t length) override;
+  /// Queues the data for upload. Blocks if too much data is queued already.
+  int64_t Write(const void* buffer, uint64_t length) override;
+  int64_t Size() override;
+  /// Waits until the data written so far has been handed to the connection.
+  bool Flush() override;
+  bool Seek(uint64_t position) override;
+  bool Tell(uint64_t* position) override;
+  /// @}
+
+ protected:
+  ~HttpFile() override;
+
+  bool Open() override;
+
+ private:
+  // Runs the request on |upload_thread_|.
+  void Upload();
+  // curl read callback, which passes the queued data to the request.
+  static size_t ReadCallback(char* buffer,
+                             size_t size,
+                             size_t nmemb,
+                             void* user_data);
+  size_t ReadQueuedData(char* buffer, size_t length);
+
+  const std::string mode_;
+  uint64_t size_;
+
+  base::Lock lock_;  // Lock protecting the variables below.
+  base::ConditionVariable condition_;
+  // Data written but not handed to the request yet, starting at
+  // |queue_offset_|.
+  std::string queue_;
+  size_t queue_offset_;
+  bool closed_;
+  bool upload_done_;
+  bool upload_succeeded_;
+
+  scoped_ptr<ClosureThread> upload_thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(HttpFile);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_FILE_HTTP_FILE_H_
@@ -0,0 +1,289 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/file/http_input_file.h"
+
+#include <inttypes.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "packager/base/bind.h"
+#include "packager/base/bind_helpers.h"
+#include "packager/base/logging.h"
+#include "packager/base/strings/string_number_conversions.h"
+#include "packager/base/strings/stringprintf.h"
+#include "packager/media/base/closure_thread.h"
+#include "packager/media/file/http_transport.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+const char kUserAgentString[] = "edash-packager-http_input_file/1.0";
+const char kContentRangeHeader[] = "content-range";
+// Number of attempts of a range request before the read fails.
+const int kMaxAttempts = 3;
+
+// Parses the size of the file from "Content-Range: bytes first-last/size".
+uint64_t ParseFileSize(const HttpResponse& response) {
+  std::map<std::string, std::string>::const_iterator it =
+      response.headers.find(kContentRangeHeader);
+  if (it == response.headers.end())
+    return 0;
+  const size_t slash_pos = it->second.rfind('/');
+  uint64_t file_size = 0;
+  if (slash_pos == std::string::npos ||
+      !base::StringToUint64(it->second.substr(slash_pos + 1), &file_size)) {
+    return 0;
+  }
+  return file_size;
+}
+
+}  // namespace
+
+HttpInputFile::HttpInputFile(const char* url,
+                             uint64_t block_size,
+                             size_t num_parallel_requests)
+    : File(url),
+      block_size_(std::max<uint64_t>(block_size, 1)),
+      num_parallel_requests_(std::max<size_t>(num_parallel_requests, 1)),
+      size_(0),
+      closed_(0),
+      condition_(&lock_),
+      position_(0) {}
+
+HttpInputFile::~HttpInputFile() {}
+
+bool HttpInputFile::Open() {
+  // The requests made for a job are aborted when the job is cancelled.
+  cancellation_token_ = CancellationToken::Current();
+
+  for (size_t i = 0; i < num_parallel_requests_; ++i) {
+    scoped_ptr<HttpConnection> connection =
+        HttpTransport::Get()->CreateConnection();
+    if (!connection)
+      return false;
+    connections_.push_back(connection.release());
+  }
+
+  Block first_block;
+  uint64_t file_size = 0;
+  if (!FetchRange(connections_[0], 0, block_size_ - 1, &first_block.data,
+                  &file_size)) {
+    return false;
+  }
+  first_block.state = Block::kDone;
+  size_ = file_size;
+  // The whole file is in the first block if the server ignored the range.
+  if (first_block.data.size() == size_) {
+    block_size_ = std::max(block_size_, std::max<uint64_t>(size_, 1));
+  } else if (first_block.data.size() != std::min(block_size_, size_)) {
+    LOG(ERROR) << "Unexpected range size from " << file_name()
+               << ". The server may not support range requests.";
+    return false;
+  }
+
+  {
+    base::AutoLock lock(lock_);
+    blocks_[0].state = Block::kDone;
+    blocks_[0].data.swap(first_block.data);
+    UpdateBlocks();
+  }
+  for (HttpConnection* connection : connections_) {
+    fetch_threads_.push_back(new ClosureThread(
+        "HttpInputFile", base::Bind(&HttpInputFile::FetchBlocks,
+                                    base::Unretained(this), connection)));
+    fetch_threads_.back()->Start();
+  }
+  return true;
+}
+
+bool HttpInputFile::Close() {
+  base::subtle::NoBarrier_Store(&closed_, 1);
+  {
+    base::AutoLock lock(lock_);
+    condition_.Broadcast();
+  }
+  for (ClosureThread* thread : fetch_threads_)
+    thread->Join();
+  delete this;
+  return true;
+}
+
+int64_t HttpInputFile::Read(void* buffer, uint64_t length) {
+  base::AutoLock lock(lock_);
+  if (position_ >= size_)
+    return 0;
+  UpdateBlocks();
+
+  const uint64_t index = position_ / block_size_;
+  Block& block = blocks_[index];
+  while (block.state == Block::kPending || block.state == Block::kFetching)
+    condition_.Wait();
+  if (block.state == Block::kFailed)
+    return -1;
+
+  const uint64_t offset = position_ - index * block_size_;
+  DCHECK_LT(offset, block.data.size());
+  const uint64_t bytes_read = std::min<uint64_t>(
+      length, block.data.size() - offset);
+  memcpy(buffer, block.data.data() + offset, bytes_read);
+  position_ += bytes_read;
+  UpdateBlocks();
+  return bytes_read;
+}
+
+int64_t HttpInputFile::Write(const void* buffer, uint64_t length) {
+  NOTIMPLEMENTED() << "HttpInputFile does not support Write().";
+  return -1;
+}
+
+int64_t HttpInputFile::Size() {
+  return size_;
+}
+
+bool HttpInputFile::Flush() {
+  NOTIMPLEMENTED() << "HttpInputFile does not support Flush().";
+  return false;
+}
+
+bool HttpInputFile::Seek(uint64_t position) {
+  base::AutoLock lock(lock_);
+  if (position > size_)
+    return false;
+  position_ = position;
+  UpdateBlocks();
+  return true;
+}
+
+bool HttpInputFile::Tell(uint64_t* position) {
+  base::AutoLock lock(lock_);
+  *position = position_;
+  return true;
+}
+
+void HttpInputFile::FetchBlocks(HttpConnection* connection) {
+  base::AutoLock lock(lock_);
+  while (true) {
+    // The nearest pending block is fetched first.
+    std::map<uint64_t, Block>::iterator it = blocks_.begin();
+    while (it != blocks_.end() && it->second.state != Block::kPending)
+      ++it;
+    if (base::subtle::NoBarrier_Load(&closed_))
+      break;
+    if (it == blocks_.end()) {
+      condition_.Wait();
+      continue;
+    }
+
+    const uint64_t index = it->first;
+    it->second.state = Block::kFetching;
+    const uint64_t first = index * block_size_;
+    const uint64_t last = std::min(first + block_size_, size_) - 1;
+    std::string data;
+    bool result;
+    {
+      base::AutoUnlock unlock(lock_);
+      result = FetchRange(connection, first, last, &data, NULL);
+      if (result && data.size() != last - first + 1) {
+        LOG(ERROR) << "Unexpected range size from " << file_name()
+                   << ". The server may not support range requests.";
+        result = false;
+      }
+    }
+
+    // The block is dropped if the reader seeked away in the meantime.
+    it = blocks_.find(index);
+    if (it == blocks_.end() || it->second.state != Block::kFetching)
+      continue;
+    it->second.state = result ? Block::kDone : Block::kFailed;
+    it->second.data.swap(data);
+    condition_.Broadcast();
+  }
+}
+
+bool HttpInputFile::FetchRange(HttpConnection* connection,
+                               uint64_t first,
+                               uint64_t last,
+                               std::string* data,
+                               uint64_t* file_size) {
+  DCHECK(data);
+  const std::string range = base::StringPrintf(
+      "%" PRIu64 "-%" PRIu64, first, last);
+  HttpRequest request;
+  request.method = "GET";
+  request.url = file_name();
+  request.user_agent = kUserAgentString;
+  request.headers.push_back("Range: bytes=" + range);
+  request.abort_callback =
+      base::Bind(&HttpInputFile::IsAborted, base::Unretained(this));
+
+  for (int attempt = 1; attempt <= kMaxAttempts; ++attempt) {
+    HttpResponse response;
+    const bool sent = connection->Send(request, &response);
+    if (sent && (response.status_code == 200 ||
+                 response.status_code == 206)) {
+      if (file_size) {
+        // 200 instead of 206: the server ignored the range and sent the
+        // whole file.
+        *file_size = response.status_code == 200 ? response.body.size()
+                                                 : ParseFileSize(response);
+        if (*file_size == 0) {
+          LOG(ERROR) << "Unknown size of " << file_name() << ".";
+          return false;
+        }
+      }
+      data->swap(response.body);
+      return true;
+    }
+    if (IsAborted())
+      return false;
+
+    const std::string error_message =
+        sent ? base::StringPrintf("Response code: %d.", response.status_code)
+             : response.error;
+    LOG(ERROR) << "Failed to read bytes " << range << " of " << file_name()
+               << " (attempt " << attempt << "/" << kMaxAttempts << "). "
+               << error_message;
+  }
+  return false;
+}
+
+void HttpInputFile::UpdateBlocks() {
+  lock_.AssertAcquired();
+  const uint64_t first_index = position_ / block_size_;
+  const uint64_t num_blocks = (size_ + block_size_ - 1) / block_size_;
+  const uint64_t end_index =
+      std::min<uint64_t>(first_index + num_parallel_requests_, num_blocks);
+
+  std::map<uint64_t, Block>::iterator it = blocks_.begin();
+  while (it != blocks_.end()) {
+    if (it->first < first_index || it->first >= end_index)
+      blocks_.erase(it++);
+    else
+      ++it;
+  }
+
+  bool scheduled = false;
+  for (uint64_t index = first_index; index < end_index; ++index) {
+    if (blocks_.find(index) == blocks_.end()) {
+      blocks_[index].state = Block::kPending;
+      scheduled = true;
+    }
+  }
+  if (scheduled)
+    condition_.Broadcast();
+}
+
+bool HttpInputFile::IsAborted() const {
+  return base::subtle::NoBarrier_Load(&closed_) ||
+         (cancellation_token_ && cancellation_token_->IsCancelled());
+}
+
+}  // namespace media
+}  // namespace edash_packager
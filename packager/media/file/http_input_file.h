@@ -0,0 +1,115 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_FILE_HTTP_INPUT_FILE_H_
+#define MEDIA_FILE_HTTP_INPUT_FILE_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+
+#include "packager/base/atomicops.h"
+#include "packager/base/memory/ref_counted.h"
+#include "packager/base/memory/scoped_vector.h"
+#include "packager/base/synchronization/condition_variable.h"
+#include "packager/base/synchronization/lock.h"
+#include "packager/media/base/cancellation_token.h"
+#include "packager/media/file/file.h"
+
+namespace edash_packager {
+namespace media {
+
+class ClosureThread;
+class HttpConnection;
+
+/// Implements a read only File which downloads its content from an HTTP(S)
+/// server, e.g. an object storage, with range requests. The blocks following
+/// the read position are fetched in parallel, on several connections, so
+/// the input is read at the speed of the network rather than at the speed
+/// of a single connection. Seeking only moves the blocks fetched, so the
+/// moov box at the end of an MP4 file is read without downloading the file.
+/// The server must support range requests, unless the whole file fits in
+/// one block.
+class HttpInputFile : public File {
+ public:
+  /// @param url is the URL of the content, including the scheme.
+  /// @param block_size is the size of the range requests.
+  /// @param num_parallel_requests is the maximum number of range requests in
+  ///        flight.
+  HttpInputFile(const char* url,
+                uint64_t block_size,
+                size_t num_parallel_requests);
+
+  /// @name File implementation overrides.
+  /// @{
+  bool Close() override;
+  /// Waits for the block at the read position if it is still fetched.
+  int64_t Read(void* buffer, uint64_t length) override;
+  int64_t Write(const void* buffer, uint64_t length) override;
+  int64_t Size() override;
+  bool Flush() override;
+  bool Seek(uint64_t position) override;
+  bool Tell(uint64_t* position) override;
+  /// @}
+
+ protected:
+  ~HttpInputFile() override;
+
+  /// Fetches the first block, which gives the size of the file.
+  bool Open() override;
+
+ private:
+  struct Block {
+    enum State { kPending, kFetching, kDone, kFailed };
+
+    Block() : state(kPending) {}
+
+    State state;
+    std::string data;
+  };
+
+  // Fetches the pending blocks on |connection| until the file is closed.
+  // Runs on |fetch_threads_|, one per connection.
+  void FetchBlocks(HttpConnection* connection);
+  // Fetches the bytes [first, last] of the file on |connection| into |data|.
+  // Sets |file_size|, if not NULL, to the size of the file, which is the size
+  // of |data| if the server ignored the range.
+  bool FetchRange(HttpConnection* connection,
+                  uint64_t first,
+                  uint64_t last,
+                  std::string* data,
+                  uint64_t* file_size);
+  // Schedules the blocks which follow the read position, and drops the
+  // others. Called with |lock_| held.
+  void UpdateBlocks();
+  // Returns true once the file is closed or the job cancelled, which aborts
+  // the requests in flight.
+  bool IsAborted() const;
+
+  uint64_t block_size_;
+  const size_t num_parallel_requests_;
+  uint64_t size_;
+  base::subtle::Atomic32 closed_;
+  // The token of the job opening the file, NULL if none.
+  scoped_refptr<CancellationToken> cancellation_token_;
+
+  base::Lock lock_;  // Lock protecting the variables below.
+  base::ConditionVariable condition_;
+  uint64_t position_;
+  // The blocks scheduled, by index.
+  std::map<uint64_t, Block> blocks_;
+
+  ScopedVector<HttpConnection> connections_;
+  ScopedVector<ClosureThread> fetch_threads_;
+
+  DISALLOW_COPY_AND_ASSIGN(HttpInputFile);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_FILE_HTTP_INPUT_FILE_H_
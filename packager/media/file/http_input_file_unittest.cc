@@ -0,0 +1,218 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+#include <inttypes.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "packager/base/bind.h"
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/strings/stringprintf.h"
+#include "packager/media/file/fake_http_transport.h"
+#include "packager/media/file/file.h"
+#include "packager/media/file/file_closer.h"
+
+DECLARE_uint64(http_input_block_size);
+DECLARE_int32(http_input_parallel_requests);
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+const char kUrl[] = "http://example.com/input.mp4";
+const uint64_t kBlockSize = 16;
+const uint64_t kFileSize = 100;
+// The blocks of the file are [0, 15], [16, 31], ..., [96, 99].
+const char kFirstRange[] = "Range: bytes=0-15";
+const char kLastRange[] = "Range: bytes=96-99";
+}  // namespace
+
+class HttpInputFileTest : public testing::Test {
+ public:
+  HttpInputFileTest()
+      : transport_(base::Bind(&HttpInputFileTest::HandleRequest,
+                              base::Unretained(this))),
+        ignore_range_(false),
+        error_status_code_(0),
+        error_range_(kFirstRange),
+        short_range_(false) {}
+
+  void SetUp() override {
+    for (uint64_t i = 0; i < kFileSize; ++i)
+      content_.push_back(static_cast<char>(i));
+    FLAGS_http_input_block_size = kBlockSize;
+    FLAGS_http_input_parallel_requests = 2;
+  }
+
+ protected:
+  // Serves |content_| with range requests, unless told otherwise.
+  bool HandleRequest(const HttpRequest& request, HttpResponse* response) {
+    EXPECT_EQ("GET", request.method);
+    EXPECT_EQ(kUrl, request.url);
+    EXPECT_EQ(1u, request.headers.size());
+    const std::string range =
+        request.headers.empty() ? std::string() : request.headers[0];
+    uint64_t first = 0;
+    uint64_t last = 0;
+    if (sscanf(range.c_str(), "Range: bytes=%" SCNu64 "-%" SCNu64, &first,
+               &last) != 2) {
+      ADD_FAILURE() << "Unexpected range: " << range;
+      return false;
+    }
+
+    if (error_status_code_ != 0 && range == error_range_) {
+      response->status_code = error_status_code_;
+      return true;
+    }
+    if (ignore_range_) {
+      response->status_code = 200;
+      response->body = content_;
+      return true;
+    }
+    response->status_code = 206;
+    response->headers["content-range"] = base::StringPrintf(
+        "bytes %" PRIu64 "-%" PRIu64 "/%" PRIu64, first, last, kFileSize);
+    response->body = content_.substr(first, last - first + 1);
+    // The connection is cut short.
+    if (short_range_ && range == error_range_)
+      response->body.resize(response->body.size() - 1);
+    return true;
+  }
+
+  // Reads |length| bytes from |file| at |position|.
+  bool ReadAt(File* file, uint64_t position, uint64_t length,
+              std::string* data) {
+    if (!file->Seek(position))
+      return false;
+    data->resize(length);
+    uint64_t bytes_read = 0;
+    while (bytes_read < length) {
+      const int64_t result =
+          file->Read(&(*data)[bytes_read], length - bytes_read);
+      if (result <= 0)
+        return false;
+      bytes_read += result;
+    }
+    return true;
+  }
+
+  // Returns the number of requests of |range|.
+  size_t CountRequests(const std::string& range) const {
+    const std::vector<HttpRequest> requests = transport_.requests();
+    size_t count = 0;
+    for (const HttpRequest& request : requests) {
+      if (!request.headers.empty() && request.headers[0] == range)
+        ++count;
+    }
+    return count;
+  }
+
+  FakeHttpTransport transport_;
+  std::string content_;
+  // Set to send the whole file with a 200 status instead of a range.
+  bool ignore_range_;
+  // Set to answer the requests of |error_range_| with this status code.
+  int error_status_code_;
+  std::string error_range_;
+  // Set to drop the last byte of the response to |error_range_|.
+  bool short_range_;
+};
+
+TEST_F(HttpInputFileTest, ReadRanges) {
+  scoped_ptr<File, FileCloser> file(File::OpenWithNoBuffering(kUrl, "r"));
+  ASSERT_TRUE(file);
+  EXPECT_EQ(static_cast<int64_t>(kFileSize), file->Size());
+
+  std::string data;
+  ASSERT_TRUE(ReadAt(file.get(), 0, kFileSize, &data));
+  EXPECT_EQ(content_, data);
+  uint8_t byte = 0;
+  EXPECT_EQ(0, file->Read(&byte, 1));
+  EXPECT_EQ(1u, CountRequests(kFirstRange));
+  EXPECT_EQ(1u, CountRequests(kLastRange));
+}
+
+TEST_F(HttpInputFileTest, SeekRefetchesDroppedBlocks) {
+  scoped_ptr<File, FileCloser> file(File::OpenWithNoBuffering(kUrl, "r"));
+  ASSERT_TRUE(file);
+
+  // Seeking to the end drops the first blocks and fetches the last ones
+  // without fetching the blocks in between.
+  std::string data;
+  ASSERT_TRUE(ReadAt(file.get(), 90, 10, &data));
+  EXPECT_EQ(content_.substr(90), data);
+  EXPECT_EQ(0u, CountRequests("Range: bytes=48-63"));
+
+  // Seeking back fetches the first block again.
+  ASSERT_TRUE(ReadAt(file.get(), 5, 20, &data));
+  EXPECT_EQ(content_.substr(5, 20), data);
+  EXPECT_EQ(2u, CountRequests(kFirstRange));
+  uint64_t position = 0;
+  ASSERT_TRUE(file->Tell(&position));
+  EXPECT_EQ(25u, position);
+
+  EXPECT_FALSE(file->Seek(kFileSize + 1));
+}
+
+TEST_F(HttpInputFileTest, ServerIgnoresRange) {
+  ignore_range_ = true;
+  scoped_ptr<File, FileCloser> file(File::OpenWithNoBuffering(kUrl, "r"));
+  ASSERT_TRUE(file);
+  EXPECT_EQ(static_cast<int64_t>(kFileSize), file->Size());
+
+  // The whole file is a single block.
+  std::string data;
+  ASSERT_TRUE(ReadAt(file.get(), 0, kFileSize, &data));
+  EXPECT_EQ(content_, data);
+  ASSERT_TRUE(ReadAt(file.get(), 50, 10, &data));
+  EXPECT_EQ(content_.substr(50, 10), data);
+  EXPECT_EQ(1u, transport_.requests().size());
+}
+
+TEST_F(HttpInputFileTest, ShortFirstRange) {
+  short_range_ = true;
+  EXPECT_FALSE(File::OpenWithNoBuffering(kUrl, "r"));
+}
+
+TEST_F(HttpInputFileTest, ShortRange) {
+  short_range_ = true;
+  error_range_ = kLastRange;
+  scoped_ptr<File, FileCloser> file(File::OpenWithNoBuffering(kUrl, "r"));
+  ASSERT_TRUE(file);
+
+  std::string data;
+  ASSERT_TRUE(ReadAt(file.get(), 0, 96, &data));
+  EXPECT_EQ(content_.substr(0, 96), data);
+  uint8_t byte = 0;
+  EXPECT_EQ(-1, file->Read(&byte, 1));
+}
+
+TEST_F(HttpInputFileTest, ErrorStatus) {
+  error_status_code_ = 404;
+  EXPECT_FALSE(File::OpenWithNoBuffering(kUrl, "r"));
+  // The request is retried.
+  EXPECT_EQ(3u, CountRequests(kFirstRange));
+}
+
+TEST_F(HttpInputFileTest, ErrorStatusOfLaterBlock) {
+  error_status_code_ = 503;
+  error_range_ = kLastRange;
+  scoped_ptr<File, FileCloser> file(File::OpenWithNoBuffering(kUrl, "r"));
+  ASSERT_TRUE(file);
+
+  std::string data;
+  ASSERT_TRUE(ReadAt(file.get(), 0, 96, &data));
+  uint8_t byte = 0;
+  EXPECT_EQ(-1, file->Read(&byte, 1));
+  EXPECT_EQ(3u, CountRequests(kLastRange));
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,173 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/file/http_transport.h"
+
+#include <curl/curl.h>
+
+#include "packager/base/logging.h"
+#include "packager/base/strings/string_util.h"
+#include "packager/base/strings/stringprintf.h"
+#include "packager/media/base/curl_share.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+// A request is aborted if it transfers less than this many bytes per second
+// for kLowSpeedTimeInSeconds, so that a stalled connection is retried.
+const long kLowSpeedLimit = 1;
+const long kLowSpeedTimeInSeconds = 30;
+
+HttpTransport* g_transport_for_testing = NULL;
+
+// The state of a request, shared with the curl callbacks.
+struct Exchange {
+  const HttpRequest* request;
+  HttpResponse* response;
+};
+
+// curl write callback. Aborts the request if the abort callback says so.
+size_t AppendBody(char* ptr, size_t size, size_t nmemb, void* user_data) {
+  Exchange* exchange = static_cast<Exchange*>(user_data);
+  if (!exchange->request->abort_callback.is_null() &&
+      exchange->request->abort_callback.Run()) {
+    return 0;
+  }
+  exchange->response->body.append(ptr, size * nmemb);
+  return size * nmemb;
+}
+
+// curl header callback. The headers of a response which redirects are
+// dropped with the status line of the next response.
+size_t ParseHeader(char* ptr, size_t size, size_t nmemb, void* user_data) {
+  HttpResponse* response = static_cast<Exchange*>(user_data)->response;
+  const size_t length = size * nmemb;
+  const std::string line(ptr, length);
+  if (base::StartsWith(line, "HTTP/", base::CompareCase::SENSITIVE)) {
+    response->headers.clear();
+    return length;
+  }
+  const size_t colon_pos = line.find(':');
+  if (colon_pos == std::string::npos)
+    return length;
+  std::string value;
+  base::TrimWhitespaceASCII(line.substr(colon_pos + 1), base::TRIM_ALL,
+                            &value);
+  response->headers[base::StringToLowerASCII(line.substr(0, colon_pos))] =
+      value;
+  return length;
+}
+
+class CurlHttpConnection : public HttpConnection {
+ public:
+  explicit CurlHttpConnection(CURL* curl) : curl_(curl) {}
+  ~CurlHttpConnection() override { curl_easy_cleanup(curl_); }
+
+  bool Send(const HttpRequest& request, HttpResponse* response) override {
+    DCHECK(response);
+    response->status_code = 0;
+    response->headers.clear();
+    response->body.clear();
+    response->error.clear();
+    Exchange exchange = {&request, response};
+
+    // The empty Expect header skips the "100 Continue" round trip.
+    struct curl_slist* headers = curl_slist_append(NULL, "Expect:");
+    for (const std::string& header : request.headers)
+      headers = curl_slist_append(headers, header.c_str());
+
+    // Keeps the live connections of the handle.
+    curl_easy_reset(curl_);
+    CURLSH* curl_share = GetCurlShare();
+    if (curl_share)
+      curl_easy_setopt(curl_, CURLOPT_SHARE, curl_share);
+    curl_easy_setopt(curl_, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl_, CURLOPT_URL, request.url.c_str());
+    curl_easy_setopt(curl_, CURLOPT_USERAGENT, request.user_agent.c_str());
+    curl_easy_setopt(curl_, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl_, CURLOPT_LOW_SPEED_LIMIT, kLowSpeedLimit);
+    curl_easy_setopt(curl_, CURLOPT_LOW_SPEED_TIME, kLowSpeedTimeInSeconds);
+    if (request.method == "GET") {
+      curl_easy_setopt(curl_, CURLOPT_HTTPGET, 1L);
+      curl_easy_setopt(curl_, CURLOPT_FOLLOWLOCATION, 1L);
+    } else {
+      curl_easy_setopt(curl_, CURLOPT_CUSTOMREQUEST, request.method.c_str());
+      if (request.method != "DELETE") {
+        curl_easy_setopt(curl_, CURLOPT_POSTFIELDS, request.body.data());
+        curl_easy_setopt(curl_, CURLOPT_POSTFIELDSIZE_LARGE,
+                         static_cast<curl_off_t>(request.body.size()));
+      }
+    }
+    curl_easy_setopt(curl_, CURLOPT_WRITEFUNCTION, AppendBody);
+    curl_easy_setopt(curl_, CURLOPT_WRITEDATA, &exchange);
+    curl_easy_setopt(curl_, CURLOPT_HEADERFUNCTION, ParseHeader);
+    curl_easy_setopt(curl_, CURLOPT_HEADERDATA, &exchange);
+
+    const CURLcode res = curl_easy_perform(curl_);
+    long status_code = 0;
+    curl_easy_getinfo(curl_, CURLINFO_RESPONSE_CODE, &status_code);
+    // The handle must not keep pointers to |headers| and |exchange|.
+    curl_easy_reset(curl_);
+    curl_slist_free_all(headers);
+
+    if (res != CURLE_OK) {
+      response->error = base::StringPrintf("curl_easy_perform() failed: %s.",
+                                           curl_easy_strerror(res));
+      return false;
+    }
+    response->status_code = static_cast<int>(status_code);
+    return true;
+  }
+
+ private:
+  CURL* curl_;
+
+  DISALLOW_COPY_AND_ASSIGN(CurlHttpConnection);
+};
+
+class CurlHttpTransport : public HttpTransport {
+ public:
+  CurlHttpTransport() {}
+  ~CurlHttpTransport() override {}
+
+  scoped_ptr<HttpConnection> CreateConnection() override {
+    // Initializes libcurl first.
+    GetCurlShare();
+    CURL* curl = curl_easy_init();
+    if (!curl) {
+      LOG(ERROR) << "curl_easy_init() failed.";
+      return scoped_ptr<HttpConnection>();
+    }
+    return scoped_ptr<HttpConnection>(new CurlHttpConnection(curl));
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(CurlHttpTransport);
+};
+
+}  // namespace
+
+HttpRequest::HttpRequest() {}
+HttpRequest::~HttpRequest() {}
+
+HttpResponse::HttpResponse() : status_code(0) {}
+HttpResponse::~HttpResponse() {}
+
+HttpTransport* HttpTransport::Get() {
+  if (g_transport_for_testing)
+    return g_transport_for_testing;
+  static CurlHttpTransport curl_transport;
+  return &curl_transport;
+}
+
+void HttpTransport::SetForTesting(HttpTransport* transport) {
+  g_transport_for_testing = transport;
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,96 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_FILE_HTTP_TRANSPORT_H_
+#define MEDIA_FILE_HTTP_TRANSPORT_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "packager/base/callback.h"
+#include "packager/base/macros.h"
+#include "packager/base/memory/scoped_ptr.h"
+
+namespace edash_packager {
+namespace media {
+
+/// A request of a File stored on an HTTP server.
+struct HttpRequest {
+  HttpRequest();
+  ~HttpRequest();
+
+  /// The method, e.g. "GET" or "PUT".
+  std::string method;
+  std::string url;
+  std::string user_agent;
+  /// The headers of the request, e.g. "Range: bytes=0-99".
+  std::vector<std::string> headers;
+  /// The body, sent unless the method is GET or DELETE.
+  std::string body;
+  /// Polled as the response is received. The request is aborted once it
+  /// returns true. Can be null.
+  base::Callback<bool()> abort_callback;
+};
+
+/// The response to an HttpRequest.
+struct HttpResponse {
+  HttpResponse();
+  ~HttpResponse();
+
+  int status_code;
+  /// The headers of the response, by lower case name.
+  std::map<std::string, std::string> headers;
+  std::string body;
+  /// The reason why the request failed, if it did.
+  std::string error;
+};
+
+/// A connection to HTTP servers, which sends a request at a time and is kept
+/// alive between the requests.
+class HttpConnection {
+ public:
+  virtual ~HttpConnection() {}
+
+  /// Sends a request and receives the response.
+  /// @param request is the request.
+  /// @param response receives the response, or the error.
+  /// @return true if a response is received, whatever its status code, false
+  ///         if the request failed or was aborted.
+  virtual bool Send(const HttpRequest& request, HttpResponse* response) = 0;
+};
+
+/// Creates the connections of the Files stored on HTTP servers. The
+/// connections are made with libcurl, unless the transport is replaced for
+/// testing.
+class HttpTransport {
+ public:
+  virtual ~HttpTransport() {}
+
+  /// Thread Safety: Can be called from any thread.
+  /// @return a new connection, or NULL on failure.
+  virtual scoped_ptr<HttpConnection> CreateConnection() = 0;
+
+  /// @return the transport of the Files.
+  static HttpTransport* Get();
+
+  /// Replaces the transport of the Files, e.g. with a fake server. It must be
+  /// called while no such File is open.
+  /// @param transport is the new transport, which is not owned. NULL
+  ///        restores the libcurl transport.
+  static void SetForTesting(HttpTransport* transport);
+
+ protected:
+  HttpTransport() {}
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(HttpTransport);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_FILE_HTTP_TRANSPORT_H_
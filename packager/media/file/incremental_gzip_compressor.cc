@@ -0,0 +1,169 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/file/incremental_gzip_compressor.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "packager/base/logging.h"
+#include "packager/third_party/zlib/zlib.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+// Raw deflate, with the gzip header and trailer written here, so that the
+// CRC-32 of the prefix can be resumed from the checkpoint.
+const int kRawDeflateWindowBits = -15;
+const int kMemLevel = 8;
+// The prefix is not worth a checkpoint below this size.
+const size_t kMinCheckpointOffset = 4096;
+// Compressing once per version, for many downloads, is worth the best
+// compression.
+const int kCompressionLevel = Z_BEST_COMPRESSION;
+const size_t kDeflateChunkSize = 16384;
+
+// Fixed gzip header: no file name nor modification time, OS unknown.
+const char kGzipHeader[] = {'\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, '\xff'};
+
+void AppendUint32LittleEndian(uint32_t value, std::string* output) {
+  for (int i = 0; i < 4; ++i)
+    output->push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+}
+
+size_t CommonPrefixLength(const std::string& a, const std::string& b) {
+  const size_t length = std::min(a.size(), b.size());
+  return std::mismatch(a.begin(), a.begin() + length, b.begin()).first -
+         a.begin();
+}
+
+}  // namespace
+
+IncrementalGzipCompressor::IncrementalGzipCompressor()
+    : checkpoint_offset_(0), checkpoint_crc_(0), last_bytes_compressed_(0) {}
+
+IncrementalGzipCompressor::~IncrementalGzipCompressor() {
+  ResetCheckpoint();
+}
+
+bool IncrementalGzipCompressor::Compress(const std::string& content,
+                                         std::string* gzip) {
+  DCHECK(gzip);
+  const size_t common_prefix = CommonPrefixLength(previous_content_, content);
+
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  std::string deflated;
+  uint32_t crc;
+  size_t offset;
+  if (checkpoint_ && checkpoint_offset_ <= common_prefix) {
+    if (deflateCopy(&stream, checkpoint_.get()) != Z_OK) {
+      LOG(ERROR) << "Failed to copy the deflate state.";
+      return false;
+    }
+    deflated = checkpoint_output_;
+    crc = checkpoint_crc_;
+    offset = checkpoint_offset_;
+  } else {
+    // The checkpoint must stay a prefix of |previous_content_|.
+    ResetCheckpoint();
+    if (deflateInit2(&stream, kCompressionLevel, Z_DEFLATED,
+                     kRawDeflateWindowBits, kMemLevel,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+      LOG(ERROR) << "Failed to initialize deflate.";
+      return false;
+    }
+    crc = crc32(0, Z_NULL, 0);
+    offset = 0;
+  }
+  last_bytes_compressed_ = content.size() - offset;
+
+  // The next version is expected to share at least the prefix this one
+  // shares with the previous one, e.g. all but the tail of an append-mostly
+  // document.
+  bool result = true;
+  if (common_prefix >= kMinCheckpointOffset && common_prefix > offset) {
+    const size_t length = common_prefix - offset;
+    result = Deflate(&stream, content.data() + offset, length, Z_NO_FLUSH,
+                     &deflated);
+    crc = crc32(crc, reinterpret_cast<const Bytef*>(content.data() + offset),
+                length);
+    offset = common_prefix;
+    if (result) {
+      if (!checkpoint_)
+        checkpoint_.reset(new z_stream());
+      else
+        deflateEnd(checkpoint_.get());
+      if (deflateCopy(checkpoint_.get(), &stream) == Z_OK) {
+        checkpoint_offset_ = offset;
+        checkpoint_output_ = deflated;
+        checkpoint_crc_ = crc;
+      } else {
+        checkpoint_.reset();
+      }
+    }
+  }
+  if (result) {
+    result = Deflate(&stream, content.data() + offset, content.size() - offset,
+                     Z_FINISH, &deflated);
+    crc = crc32(crc, reinterpret_cast<const Bytef*>(content.data() + offset),
+                content.size() - offset);
+  }
+  deflateEnd(&stream);
+  if (!result) {
+    LOG(ERROR) << "Failed to deflate.";
+    ResetCheckpoint();
+    previous_content_.clear();
+    return false;
+  }
+
+  gzip->assign(kGzipHeader, sizeof(kGzipHeader));
+  gzip->append(deflated);
+  AppendUint32LittleEndian(crc, gzip);
+  AppendUint32LittleEndian(static_cast<uint32_t>(content.size()), gzip);
+  previous_content_ = content;
+  return true;
+}
+
+void IncrementalGzipCompressor::ResetCheckpoint() {
+  if (!checkpoint_)
+    return;
+  deflateEnd(checkpoint_.get());
+  checkpoint_.reset();
+  checkpoint_offset_ = 0;
+  checkpoint_output_.clear();
+  checkpoint_crc_ = 0;
+}
+
+bool IncrementalGzipCompressor::Deflate(z_stream* stream,
+                                        const char* data,
+                                        size_t length,
+                                        int flush,
+                                        std::string* output) {
+  stream->next_in =
+      reinterpret_cast<Bytef*>(const_cast<char*>(data));
+  stream->avail_in = length;
+  char chunk[kDeflateChunkSize];
+  while (true) {
+    stream->next_out = reinterpret_cast<Bytef*>(chunk);
+    stream->avail_out = sizeof(chunk);
+    const int status = deflate(stream, flush);
+    if (status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR)
+      return false;
+    output->append(chunk, sizeof(chunk) - stream->avail_out);
+    if (status == Z_STREAM_END)
+      return true;
+    // All the input is consumed and the output flushed.
+    if (flush != Z_FINISH && stream->avail_in == 0 && stream->avail_out > 0)
+      return true;
+  }
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,71 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_FILE_INCREMENTAL_GZIP_COMPRESSOR_H_
+#define MEDIA_FILE_INCREMENTAL_GZIP_COMPRESSOR_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "packager/base/macros.h"
+#include "packager/base/memory/scoped_ptr.h"
+
+typedef struct z_stream_s z_stream;
+
+namespace edash_packager {
+namespace media {
+
+/// Compresses the successive versions of a document, e.g. a live manifest,
+/// to gzip. Append-mostly documents are compressed incrementally: the
+/// compressor state at the end of the prefix each version shared with the
+/// previous one is kept, and the next version which still starts with that
+/// prefix only compresses what follows it. Each output is a complete gzip
+/// member of its version.
+/// Thread Safety: Not thread safe.
+class IncrementalGzipCompressor {
+ public:
+  IncrementalGzipCompressor();
+  ~IncrementalGzipCompressor();
+
+  /// Compresses a new version of the document.
+  /// @param content is the document.
+  /// @param[out] gzip receives the gzip compressed document.
+  /// @return true on success, false otherwise.
+  bool Compress(const std::string& content, std::string* gzip);
+
+  /// @return The number of bytes of the last version which were compressed,
+  ///         i.e. which did not come from the saved state.
+  uint64_t last_bytes_compressed() const { return last_bytes_compressed_; }
+
+ private:
+  void ResetCheckpoint();
+
+  // Compresses |length| bytes of |data| into |output| with |flush|.
+  static bool Deflate(z_stream* stream,
+                      const char* data,
+                      size_t length,
+                      int flush,
+                      std::string* output);
+
+  // The previous version, to find the prefix the next one shares with it.
+  std::string previous_content_;
+  // The compressor state after the first |checkpoint_offset_| bytes of the
+  // previous version, and the deflate output and CRC-32 up to it. NULL if
+  // none.
+  scoped_ptr<z_stream> checkpoint_;
+  uint64_t checkpoint_offset_;
+  std::string checkpoint_output_;
+  uint32_t checkpoint_crc_;
+  uint64_t last_bytes_compressed_;
+
+  DISALLOW_COPY_AND_ASSIGN(IncrementalGzipCompressor);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_FILE_INCREMENTAL_GZIP_COMPRESSOR_H_
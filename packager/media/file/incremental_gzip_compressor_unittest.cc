@@ -0,0 +1,103 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+#include <string.h>
+
+#include <string>
+
+#include "packager/base/strings/stringprintf.h"
+#include "packager/media/file/incremental_gzip_compressor.h"
+#include "packager/third_party/zlib/zlib.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+// Accepts the gzip wrapper only.
+const int kGzipWindowBits = 16 + MAX_WBITS;
+
+bool Gunzip(const std::string& gzip, std::string* content) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  if (inflateInit2(&stream, kGzipWindowBits) != Z_OK)
+    return false;
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(gzip.data()));
+  stream.avail_in = gzip.size();
+  content->clear();
+  char chunk[4096];
+  int status;
+  do {
+    stream.next_out = reinterpret_cast<Bytef*>(chunk);
+    stream.avail_out = sizeof(chunk);
+    status = inflate(&stream, Z_NO_FLUSH);
+    content->append(chunk, sizeof(chunk) - stream.avail_out);
+  } while (status == Z_OK);
+  inflateEnd(&stream);
+  // The whole input is a single gzip member, checksum included.
+  return status == Z_STREAM_END && stream.avail_in == 0;
+}
+
+// A playlist-like document, appended with one line per segment.
+std::string Playlist(int num_segments) {
+  std::string playlist = "#EXTM3U\n#EXT-X-TARGETDURATION:6\n";
+  for (int i = 0; i < num_segments; ++i)
+    playlist += base::StringPrintf("#EXTINF:6.000,\nsegment_%d.ts\n", i);
+  return playlist;
+}
+
+}  // namespace
+
+TEST(IncrementalGzipCompressorTest, Empty) {
+  IncrementalGzipCompressor compressor;
+  std::string gzip;
+  ASSERT_TRUE(compressor.Compress("", &gzip));
+  std::string content;
+  ASSERT_TRUE(Gunzip(gzip, &content));
+  EXPECT_EQ("", content);
+}
+
+TEST(IncrementalGzipCompressorTest, AppendedVersionsCompressTheTailOnly) {
+  IncrementalGzipCompressor compressor;
+  std::string gzip;
+  std::string content;
+  for (int num_segments = 200; num_segments < 210; ++num_segments) {
+    const std::string playlist = Playlist(num_segments);
+    ASSERT_TRUE(compressor.Compress(playlist, &gzip));
+    ASSERT_TRUE(Gunzip(gzip, &content));
+    EXPECT_EQ(playlist, content);
+    // From the third version on, the checkpoint taken at the prefix shared
+    // by the two previous versions is reused.
+    if (num_segments >= 202)
+      EXPECT_LT(compressor.last_bytes_compressed(), 100u);
+  }
+}
+
+TEST(IncrementalGzipCompressorTest, ChangedBeginningCompressesEverything) {
+  IncrementalGzipCompressor compressor;
+  std::string gzip;
+  std::string content;
+  ASSERT_TRUE(compressor.Compress(Playlist(200), &gzip));
+  ASSERT_TRUE(compressor.Compress(Playlist(201), &gzip));
+  ASSERT_TRUE(compressor.Compress(Playlist(202), &gzip));
+
+  const std::string changed = "#EXTM3U\n#EXT-X-VERSION:3\n" + Playlist(203);
+  ASSERT_TRUE(compressor.Compress(changed, &gzip));
+  EXPECT_EQ(changed.size(), compressor.last_bytes_compressed());
+  ASSERT_TRUE(Gunzip(gzip, &content));
+  EXPECT_EQ(changed, content);
+
+  // The same beginning as the previous version again, with the checkpoint
+  // of the version before it dropped.
+  const std::string next = "#EXTM3U\n#EXT-X-VERSION:3\n" + Playlist(204);
+  ASSERT_TRUE(compressor.Compress(next, &gzip));
+  ASSERT_TRUE(Gunzip(gzip, &content));
+  EXPECT_EQ(next, content);
+}
+
+}  // namespace media
+}  // namespace edash_packager
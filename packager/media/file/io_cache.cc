@@ -11,56 +11,94 @@
 #include <algorithm>
 
 #include "packager/base/logging.h"
+#include "packager/base/trace_event/trace_event.h"
 
 namespace edash_packager {
 
-using base::AutoLock;
-using base::AutoUnlock;
+using base::subtle::Acquire_Load;
+using base::subtle::AtomicWord;
+using base::subtle::NoBarrier_Load;
+using base::subtle::NoBarrier_Store;
+using base::subtle::Release_Store;
 
 namespace media {
 
+namespace {
+
+// Maximum time to wait for the other thread before checking the cache again.
+// The waits are normally ended by a signal of the other thread.
+const int64_t kWaitTimeoutMs = 10;
+
+}  // namespace
+
+IoCache::Ring::Ring(uint64_t size)
+    : buffer(size),
+      read_position(0),
+      write_position(0),
+      next(0),
+      memory(kIoCacheMemory) {
+  memory.Set(buffer.size());
+}
+
+IoCache::Ring::~Ring() {}
+
+uint64_t IoCache::Ring::BytesCached() const {
+  // Load the read position first: the write position cannot be behind it.
+  const AtomicWord read = Acquire_Load(&read_position);
+  return static_cast<uintptr_t>(Acquire_Load(&write_position) - read);
+}
+
 IoCache::IoCache(uint64_t cache_size)
-    : cache_size_(cache_size),
-      read_event_(false, false),
-      write_event_(false, false),
-      // Make the buffer one byte larger than the cache so that when the
-      // condition r_ptr == w_ptr is unambiguous (buffer empty).
-      circular_buffer_(cache_size + 1),
-      end_ptr_(&circular_buffer_[0] + cache_size + 1),
-      r_ptr_(circular_buffer_.data()),
-      w_ptr_(circular_buffer_.data()),
-      closed_(false) {}
+    : read_ring_(new Ring(cache_size)),
+      write_ring_(read_ring_),
+      bytes_read_(0),
+      bytes_written_(0),
+      cache_size_(cache_size),
+      num_read_waits_(0),
+      closed_(0),
+      consumer_waiting_(0),
+      producer_waiting_(0),
+      data_available_event_(false, false),
+      space_available_event_(false, false) {
+  DCHECK_GT(cache_size, 0u);
+}
 
 IoCache::~IoCache() {
   Close();
+  DeleteReadRings();
+  delete write_ring_;
 }
 
 uint64_t IoCache::Read(void* buffer, uint64_t size) {
   DCHECK(buffer);
 
-  AutoLock lock(lock_);
-  while (!closed_ && (BytesCachedInternal() == 0)) {
-    AutoUnlock unlock(lock_);
-    write_event_.Wait();
+  uint64_t region_size = 0;
+  const uint8_t* region = GetReadRegion(true, &region_size);
+  uint64_t bytes_read = 0;
+  // Read the data cached, possibly in several regions, up to |size|.
+  while (region && bytes_read < size) {
+    const uint64_t copy_size = std::min(size - bytes_read, region_size);
+    memcpy(static_cast<uint8_t*>(buffer) + bytes_read, region, copy_size);
+    EndRead(copy_size);
+    bytes_read += copy_size;
+    region = GetReadRegion(false, &region_size);
   }
+  return bytes_read;
+}
 
-  size = std::min(size, BytesCachedInternal());
-  uint64_t first_chunk_size(std::min(size, static_cast<uint64_t>(
-      end_ptr_ - r_ptr_)));
-  memcpy(buffer, r_ptr_, first_chunk_size);
-  r_ptr_ += first_chunk_size;
-  DCHECK_GE(end_ptr_, r_ptr_);
-  if (r_ptr_ == end_ptr_)
-    r_ptr_ = &circular_buffer_[0];
-  uint64_t second_chunk_size(size - first_chunk_size);
-  if (second_chunk_size) {
-    memcpy(static_cast<uint8_t*>(buffer) + first_chunk_size, r_ptr_,
-           second_chunk_size);
-    r_ptr_ += second_chunk_size;
-    DCHECK_GT(end_ptr_, r_ptr_);
-  }
-  read_event_.Signal();
-  return size;
+const uint8_t* IoCache::BeginRead(uint64_t* size) {
+  DCHECK(size);
+  return GetReadRegion(true, size);
+}
+
+void IoCache::EndRead(uint64_t size) {
+  Ring* ring = read_ring_;
+  const AtomicWord read_position = NoBarrier_Load(&ring->read_position);
+  DCHECK_LE(size, ring->BytesCached());
+  // Hand the bytes back to the producer.
+  Release_Store(&ring->read_position, read_position + size);
+  Release_Store(&bytes_read_, NoBarrier_Load(&bytes_read_) + size);
+  Signal(&producer_waiting_, &space_available_event_);
 }
 
 uint64_t IoCache::Write(const void* buffer, uint64_t size) {
@@ -69,85 +107,199 @@ uint64_t IoCache::Write(const void* buffer, uint64_t size) {
   const uint8_t* r_ptr(static_cast<const uint8_t*>(buffer));
   uint64_t bytes_left(size);
   while (bytes_left) {
-    AutoLock lock(lock_);
-    while (!closed_ && (BytesFreeInternal() == 0)) {
-      AutoUnlock unlock(lock_);
-      read_event_.Wait();
-    }
-    if (closed_)
+    uint64_t region_size = 0;
+    uint8_t* region = GetWriteRegion(true, &region_size);
+    if (!region)
       return 0;
 
-    uint64_t write_size(std::min(bytes_left, BytesFreeInternal()));
-    uint64_t first_chunk_size(std::min(write_size, static_cast<uint64_t>(
-        end_ptr_ - w_ptr_)));
-    memcpy(w_ptr_, r_ptr, first_chunk_size);
-    w_ptr_ += first_chunk_size;
-    DCHECK_GE(end_ptr_, w_ptr_);
-    if (w_ptr_ == end_ptr_)
-      w_ptr_ = &circular_buffer_[0];
-    r_ptr += first_chunk_size;
-    uint64_t second_chunk_size(write_size - first_chunk_size);
-    if (second_chunk_size) {
-      memcpy(w_ptr_, r_ptr, second_chunk_size);
-      w_ptr_ += second_chunk_size;
-      DCHECK_GT(end_ptr_, w_ptr_);
-      r_ptr += second_chunk_size;
-    }
+    const uint64_t write_size(std::min(bytes_left, region_size));
+    memcpy(region, r_ptr, write_size);
+    EndWrite(write_size);
+    r_ptr += write_size;
     bytes_left -= write_size;
-    write_event_.Signal();
   }
   return size;
 }
 
+uint8_t* IoCache::BeginWrite(uint64_t* size) {
+  DCHECK(size);
+  return GetWriteRegion(true, size);
+}
+
+void IoCache::EndWrite(uint64_t size) {
+  Ring* ring = write_ring_;
+  const AtomicWord write_position = NoBarrier_Load(&ring->write_position);
+  DCHECK_LE(size, ring->buffer.size() - ring->BytesCached());
+  // Publish the bytes to the consumer.
+  Release_Store(&ring->write_position, write_position + size);
+  Release_Store(&bytes_written_, NoBarrier_Load(&bytes_written_) + size);
+  Signal(&consumer_waiting_, &data_available_event_);
+}
+
 void IoCache::Clear() {
-  AutoLock lock(lock_);
-  r_ptr_ = w_ptr_ = circular_buffer_.data();
+  DeleteReadRings();
+  NoBarrier_Store(&write_ring_->read_position, 0);
+  NoBarrier_Store(&write_ring_->write_position, 0);
+  NoBarrier_Store(&bytes_read_, 0);
+  NoBarrier_Store(&bytes_written_, 0);
+  base::subtle::MemoryBarrier();
   // Let any writers know that there is room in the cache.
-  read_event_.Signal();
+  space_available_event_.Signal();
 }
 
 void IoCache::Close() {
-  AutoLock lock(lock_);
-  closed_ = true;
-  read_event_.Signal();
-  write_event_.Signal();
+  Release_Store(&closed_, 1);
+  data_available_event_.Signal();
+  space_available_event_.Signal();
 }
 
 void IoCache::Reopen() {
-  AutoLock lock(lock_);
-  CHECK(closed_);
-  r_ptr_ = w_ptr_ = circular_buffer_.data();
-  closed_ = false;
-  read_event_.Reset();
-  write_event_.Reset();
+  CHECK(closed());
+  Clear();
+  data_available_event_.Reset();
+  space_available_event_.Reset();
+  Release_Store(&closed_, 0);
 }
 
 uint64_t IoCache::BytesCached() {
-  AutoLock lock(lock_);
-  return BytesCachedInternal();
+  // Load the bytes read first: the bytes written cannot be behind them.
+  const AtomicWord bytes_read = Acquire_Load(&bytes_read_);
+  return static_cast<uintptr_t>(Acquire_Load(&bytes_written_) - bytes_read);
 }
 
 uint64_t IoCache::BytesFree() {
-  AutoLock lock(lock_);
-  return BytesFreeInternal();
+  const uint64_t bytes_cached = BytesCached();
+  const uint64_t size = cache_size();
+  return bytes_cached < size ? size - bytes_cached : 0;
+}
+
+void IoCache::WaitUntilEmptyOrClosed() {
+  while (!closed() && !cancelled() && BytesCached()) {
+    NoBarrier_Store(&producer_waiting_, 1);
+    base::subtle::MemoryBarrier();
+    if (!closed() && BytesCached()) {
+      space_available_event_.TimedWait(
+          base::TimeDelta::FromMilliseconds(kWaitTimeoutMs));
+    }
+    NoBarrier_Store(&producer_waiting_, 0);
+  }
+}
+
+void IoCache::Grow(uint64_t cache_size) {
+  if (cache_size <= this->cache_size())
+    return;
+
+  // The consumer moves to the new ring once it has read the current one.
+  Ring* ring = new Ring(cache_size);
+  Release_Store(&write_ring_->next, reinterpret_cast<AtomicWord>(ring));
+  write_ring_ = ring;
+  Release_Store(&cache_size_, cache_size);
+  // Let any writers know that there is room in the cache.
+  space_available_event_.Signal();
 }
 
-uint64_t IoCache::BytesCachedInternal() {
-  return (r_ptr_ <= w_ptr_)
-             ? w_ptr_ - r_ptr_
-             : (end_ptr_ - r_ptr_) + (w_ptr_ - circular_buffer_.data());
+uint64_t IoCache::cache_size() {
+  return static_cast<uintptr_t>(Acquire_Load(&cache_size_));
 }
 
-uint64_t IoCache::BytesFreeInternal() {
-  return cache_size_ - BytesCachedInternal();
+uint64_t IoCache::num_read_waits() {
+  return static_cast<uintptr_t>(Acquire_Load(&num_read_waits_));
 }
 
-void IoCache::WaitUntilEmptyOrClosed() {
-  AutoLock lock(lock_);
-  while (!closed_ && BytesCachedInternal()) {
-    AutoUnlock unlock(lock_);
-    read_event_.Wait();
+const uint8_t* IoCache::GetReadRegion(bool wait, uint64_t* size) {
+  bool waited = false;
+  while (true) {
+    // Load |closed_| first: the data written before the cache was closed is
+    // read before the cache is reported as closed.
+    const bool closed = Acquire_Load(&closed_) != 0;
+    Ring* ring = read_ring_;
+    // Load |next| before the write position: the producer does not write the
+    // ring once |next| is set.
+    Ring* next = reinterpret_cast<Ring*>(Acquire_Load(&ring->next));
+    const uint64_t bytes_cached = ring->BytesCached();
+    if (bytes_cached > 0) {
+      const uint64_t offset =
+          static_cast<uintptr_t>(NoBarrier_Load(&ring->read_position)) %
+          ring->buffer.size();
+      *size = std::min(bytes_cached, ring->buffer.size() - offset);
+      return ring->buffer.data() + offset;
+    }
+    if (next) {
+      read_ring_ = next;
+      delete ring;
+      continue;
+    }
+    if (!wait || closed || cancelled())
+      return NULL;
+    if (!waited) {
+      Release_Store(&num_read_waits_, NoBarrier_Load(&num_read_waits_) + 1);
+      waited = true;
+    }
+    TRACE_EVENT0("packager", "IoCache::WaitForData");
+    WaitForData();
+  }
+}
+
+uint8_t* IoCache::GetWriteRegion(bool wait, uint64_t* size) {
+  while (true) {
+    if (closed())
+      return NULL;
+    Ring* ring = write_ring_;
+    const uint64_t bytes_cached = ring->BytesCached();
+    if (bytes_cached < ring->buffer.size()) {
+      const uint64_t offset =
+          static_cast<uintptr_t>(NoBarrier_Load(&ring->write_position)) %
+          ring->buffer.size();
+      *size = std::min(ring->buffer.size() - bytes_cached,
+                       ring->buffer.size() - offset);
+      return ring->buffer.data() + offset;
+    }
+    if (!wait || cancelled())
+      return NULL;
+    TRACE_EVENT0("packager", "IoCache::WaitForSpace");
+    WaitForSpace();
+  }
+}
+
+void IoCache::WaitForData() {
+  NoBarrier_Store(&consumer_waiting_, 1);
+  // Pairs with the barrier in Signal: either we see the producer's update,
+  // or the producer sees |consumer_waiting_| set and signals.
+  base::subtle::MemoryBarrier();
+  if (BytesCached() == 0 && !closed()) {
+    data_available_event_.TimedWait(
+        base::TimeDelta::FromMilliseconds(kWaitTimeoutMs));
+  }
+  NoBarrier_Store(&consumer_waiting_, 0);
+}
+
+void IoCache::WaitForSpace() {
+  NoBarrier_Store(&producer_waiting_, 1);
+  // Pairs with the barrier in Signal: either we see the consumer's update,
+  // or the consumer sees |producer_waiting_| set and signals.
+  base::subtle::MemoryBarrier();
+  if (write_ring_->BytesCached() == write_ring_->buffer.size() && !closed()) {
+    space_available_event_.TimedWait(
+        base::TimeDelta::FromMilliseconds(kWaitTimeoutMs));
+  }
+  NoBarrier_Store(&producer_waiting_, 0);
+}
+
+// static
+void IoCache::Signal(base::subtle::Atomic32* waiting,
+                     base::WaitableEvent* event) {
+  base::subtle::MemoryBarrier();
+  if (NoBarrier_Load(waiting))
+    event->Signal();
+}
+
+void IoCache::DeleteReadRings() {
+  while (read_ring_ != write_ring_) {
+    Ring* next = reinterpret_cast<Ring*>(NoBarrier_Load(&read_ring_->next));
+    delete read_ring_;
+    read_ring_ = next;
   }
+  NoBarrier_Store(&write_ring_->next, 0);
 }
 
 }  // namespace media
@@ -8,51 +8,107 @@
 #define PACKAGER_FILE_IO_CACHE_H_
 
 #include <stdint.h>
-#include <vector>
+#include "packager/base/atomicops.h"
 #include "packager/base/macros.h"
-#include "packager/base/synchronization/lock.h"
+#include "packager/base/memory/ref_counted.h"
 #include "packager/base/synchronization/waitable_event.h"
+#include "packager/media/base/cancellation_token.h"
+#include "packager/media/base/large_buffer.h"
+#include "packager/media/base/memory_tracker.h"
 
 namespace edash_packager {
 namespace media {
 
 /// Declaration of class which implements a thread-safe circular buffer.
+/// The cache is lock-free for one producer thread, which writes, and one
+/// consumer thread, which reads. A thread only waits, on an event, when the
+/// cache is full or empty. The data can be written and read in place through
+/// the regions of BeginWrite() and BeginRead(), instead of being copied by
+/// Write() and Read().
 class IoCache {
  public:
   explicit IoCache(uint64_t cache_size);
   ~IoCache();
 
   /// Read data from the cache. This function may block until there is data in
-  /// the cache.
+  /// the cache. Consumer thread only.
   /// @param buffer is a buffer into which to read the data from the cache.
   /// @param size is the size of @a buffer.
   /// @return the number of bytes read into @a buffer, or 0 if the call
-  ///         unblocked because the cache has been closed and is empty.
+  ///         unblocked because the cache has been closed and is empty, or
+  ///         cancelled.
   uint64_t Read(void* buffer, uint64_t size);
 
+  /// Borrow the next contiguous region of the cached data, to be read in
+  /// place. This function may block until there is data in the cache.
+  /// Consumer thread only.
+  /// @param[out] size receives the size of the region.
+  /// @return the region, or NULL if the call unblocked because the cache has
+  ///         been closed and is empty, or cancelled.
+  const uint8_t* BeginRead(uint64_t* size);
+
+  /// Release the first bytes of the region of BeginRead(), which have been
+  /// read.
+  /// @param size is the number of bytes read, at most the size of the region.
+  void EndRead(uint64_t size);
+
   /// Write data to the cache. This function may block until there is enough
-  /// room in the cache.
+  /// room in the cache. Producer thread only.
   /// @param buffer is a buffer containing the data to be written to the cache.
   /// @param size is the size of the data to be written to the cache.
   /// @return the amount of data written to the buffer (which will equal
   ///         @a data), or 0 if the call unblocked because the cache has been
-  ///         closed.
+  ///         closed or cancelled.
   uint64_t Write(const void* buffer, uint64_t size);
 
-  /// Empties the cache.
+  /// Borrow the next contiguous free region of the cache, to be written in
+  /// place. This function may block until there is room in the cache.
+  /// Producer thread only.
+  /// @param[out] size receives the size of the region.
+  /// @return the region, or NULL if the call unblocked because the cache has
+  ///         been closed or cancelled.
+  uint8_t* BeginWrite(uint64_t* size);
+
+  /// Hand the first bytes of the region of BeginWrite(), which have been
+  /// written, to the consumer.
+  /// @param size is the number of bytes written, at most the size of the
+  ///        region.
+  void EndWrite(uint64_t size);
+
+  /// Empties the cache. Neither the producer nor the consumer should be
+  /// active.
   void Clear();
 
   /// Close the cache. This will call any blocking calls to unblock, and the
-  /// cache won't be usable until Reopened.
+  /// cache won't be usable until Reopened. Can be called from any thread.
   void Close();
 
   /// @return true if the cache is closed, false otherwise.
-  bool closed() { return closed_; }
-
-  /// Reopens the cache. Any data still in the cache will be lost.
+  bool closed() { return base::subtle::Acquire_Load(&closed_) != 0; }
+
+  /// Makes the blocking calls return, as if the cache was closed, soon after
+  /// @a token is cancelled. Neither the producer nor the consumer should be
+  /// active.
+  void set_cancellation_token(CancellationToken* token) {
+    cancellation_token_ = token;
+  }
+
+  /// @return the cancellation token of the cache, NULL if none.
+  CancellationToken* cancellation_token() const {
+    return cancellation_token_.get();
+  }
+
+  /// @return true if the cancellation token of the cache is cancelled.
+  bool cancelled() const {
+    return cancellation_token_.get() && cancellation_token_->IsCancelled();
+  }
+
+  /// Reopens the cache. Any data still in the cache will be lost. Neither the
+  /// producer nor the consumer should be active.
   void Reopen();
 
-  /// Returns the number of bytes in the cache.
+  /// Returns the number of bytes in the cache. Only a snapshot if called while
+  /// the producer or the consumer is active.
   /// @return the number of bytes in the cache.
   uint64_t BytesCached();
 
@@ -60,22 +116,84 @@ class IoCache {
   /// @return the number of free bytes in the cache.
   uint64_t BytesFree();
 
-  /// Waits until the cache is empty or has been closed.
+  /// Waits until the cache is empty or has been closed or cancelled. Producer
+  /// thread only.
   void WaitUntilEmptyOrClosed();
 
+  /// Grows the cache, keeping the data in the cache. Producer thread only.
+  /// @param cache_size is the new size of the cache. The cache is left as is
+  ///        if it is not larger than the current size.
+  void Grow(uint64_t cache_size);
+
+  /// @return the size of the cache.
+  uint64_t cache_size();
+
+  /// @return the number of Read() and BeginRead() calls which waited for
+  ///         data, i.e. which found the cache empty.
+  uint64_t num_read_waits();
+
  private:
-  uint64_t BytesCachedInternal();
-  uint64_t BytesFreeInternal();
-
-  const uint64_t cache_size_;
-  base::Lock lock_;
-  base::WaitableEvent read_event_;
-  base::WaitableEvent write_event_;
-  std::vector<uint8_t> circular_buffer_;
-  const uint8_t* end_ptr_;
-  uint8_t* r_ptr_;
-  uint8_t* w_ptr_;
-  bool closed_;
+  // A circular buffer. The cache grows by chaining a larger ring, which the
+  // producer writes from then on, and which the consumer reads once the
+  // previous ring is empty.
+  struct Ring {
+    explicit Ring(uint64_t size);
+    ~Ring();
+
+    // Returns the number of bytes in the ring.
+    uint64_t BytesCached() const;
+
+    LargeBuffer buffer;
+    // Rough size of a cache line. The positions are placed on different cache
+    // lines to avoid false sharing between the two threads.
+    static const size_t kCacheLineSize = 64;
+    // Position of the next byte to read, which only increases. Written by the
+    // consumer only.
+    base::subtle::AtomicWord read_position;
+    char read_position_padding[kCacheLineSize -
+                               sizeof(base::subtle::AtomicWord)];
+    // Position of the next byte to write, which only increases. Written by
+    // the producer only.
+    base::subtle::AtomicWord write_position;
+    char write_position_padding[kCacheLineSize -
+                                sizeof(base::subtle::AtomicWord)];
+    // The next ring, set by the producer once it no longer writes this ring.
+    base::subtle::AtomicWord next;
+    TrackedMemory memory;
+
+   private:
+    DISALLOW_COPY_AND_ASSIGN(Ring);
+  };
+
+  // Returns the next region to read or to write, or NULL if there is none.
+  // If |wait|, waits for a region until the cache is closed or cancelled.
+  const uint8_t* GetReadRegion(bool wait, uint64_t* size);
+  uint8_t* GetWriteRegion(bool wait, uint64_t* size);
+  // Wait for the other thread to update the cache, with the same handshake
+  // as the sample channel of MediaStream.
+  void WaitForData();
+  void WaitForSpace();
+  // Signals |event| if the other thread is waiting on it.
+  static void Signal(base::subtle::Atomic32* waiting,
+                     base::WaitableEvent* event);
+  // Deletes the rings before |write_ring_|.
+  void DeleteReadRings();
+
+  // The ring read by the consumer, which owns the rings up to |write_ring_|.
+  Ring* read_ring_;
+  // The ring written by the producer.
+  Ring* write_ring_;
+  // Total numbers of bytes read and written, over all the rings.
+  base::subtle::AtomicWord bytes_read_;
+  base::subtle::AtomicWord bytes_written_;
+  base::subtle::AtomicWord cache_size_;
+  base::subtle::AtomicWord num_read_waits_;
+  base::subtle::Atomic32 closed_;
+  base::subtle::Atomic32 consumer_waiting_;
+  base::subtle::Atomic32 producer_waiting_;
+  base::WaitableEvent data_available_event_;
+  base::WaitableEvent space_available_event_;
+  scoped_refptr<CancellationToken> cancellation_token_;
 
   DISALLOW_COPY_AND_ASSIGN(IoCache);
 };
@@ -10,6 +10,7 @@
 #include "packager/base/bind.h"
 #include "packager/base/bind_helpers.h"
 #include "packager/base/threading/platform_thread.h"
+#include "packager/media/base/cancellation_token.h"
 #include "packager/media/base/closure_thread.h"
 #include "packager/media/file/io_cache.h"
 
@@ -207,6 +208,37 @@ TEST_F(IoCacheTest, CloseByWriter) {
   WaitForWriterThread();
 }
 
+TEST_F(IoCacheTest, CancelBlockedWriter) {
+  const uint64_t kNumWrites(kCacheSize * 1000 / kBlockSize);
+  scoped_refptr<CancellationToken> token(new CancellationToken);
+  cache_->set_cancellation_token(token.get());
+
+  std::vector<uint8_t> write_buffer;
+  GenerateTestBuffer(kBlockSize, &write_buffer);
+  WriteToCacheThreaded(write_buffer, kNumWrites, 0, false);
+  while (cache_->BytesCached() < kCacheSize) {
+    base::PlatformThread::Sleep(
+        base::TimeDelta::FromMilliseconds(10));
+  }
+  token->Cancel();
+  WaitForWriterThread();
+  EXPECT_TRUE(cache_closed_);
+  EXPECT_FALSE(cache_->closed());
+  EXPECT_TRUE(cache_->cancelled());
+  cache_->WaitUntilEmptyOrClosed();
+}
+
+TEST_F(IoCacheTest, CancelBlockedReader) {
+  scoped_refptr<CancellationToken> token(new CancellationToken);
+  cache_->set_cancellation_token(token.get());
+  ClosureThread canceller(
+      "Canceller", base::Bind(&CancellationToken::Cancel, token));
+  canceller.Start();
+  uint8_t test_buffer[kBlockSize];
+  EXPECT_EQ(0U, cache_->Read(test_buffer, kBlockSize));
+  canceller.Join();
+}
+
 TEST_F(IoCacheTest, Reopen) {
   const uint64_t kTestBytes1(5);
   const uint64_t kTestBytes2(10);
@@ -268,5 +300,91 @@ TEST_F(IoCacheTest, LargeRead) {
   cache_->Close();
 }
 
+TEST_F(IoCacheTest, ReadAndWriteInPlace) {
+  const uint64_t kTestBytes(kCacheSize - kBlockSize);
+
+  uint64_t region_size = 0;
+  uint8_t* write_region = cache_->BeginWrite(&region_size);
+  ASSERT_TRUE(write_region);
+  EXPECT_EQ(kCacheSize, region_size);
+  memset(write_region, 1, kTestBytes);
+  cache_->EndWrite(kTestBytes);
+  EXPECT_EQ(kTestBytes, cache_->BytesCached());
+
+  const uint8_t* read_region = cache_->BeginRead(&region_size);
+  ASSERT_TRUE(read_region);
+  EXPECT_EQ(kTestBytes, region_size);
+  EXPECT_EQ(std::vector<uint8_t>(kTestBytes, 1),
+            std::vector<uint8_t>(read_region, read_region + region_size));
+  cache_->EndRead(kTestBytes);
+  EXPECT_EQ(0u, cache_->BytesCached());
+
+  // The free space is split at the end of the buffer.
+  write_region = cache_->BeginWrite(&region_size);
+  ASSERT_TRUE(write_region);
+  EXPECT_EQ(kBlockSize, region_size);
+  cache_->EndWrite(region_size);
+  write_region = cache_->BeginWrite(&region_size);
+  ASSERT_TRUE(write_region);
+  EXPECT_EQ(kCacheSize - kBlockSize, region_size);
+
+  cache_->Close();
+  read_region = cache_->BeginRead(&region_size);
+  ASSERT_TRUE(read_region);
+  EXPECT_EQ(kBlockSize, region_size);
+  cache_->EndRead(region_size);
+  EXPECT_FALSE(cache_->BeginRead(&region_size));
+  EXPECT_FALSE(cache_->BeginWrite(&region_size));
+}
+
+TEST_F(IoCacheTest, GrowKeepsWrappedData) {
+  const uint64_t kTestBytes1(kCacheSize - kBlockSize);
+  const uint64_t kTestBytes2(2 * kBlockSize);
+
+  std::vector<uint8_t> write_buffer1;
+  GenerateTestBuffer(kTestBytes1, &write_buffer1);
+  EXPECT_EQ(kTestBytes1, cache_->Write(write_buffer1.data(), kTestBytes1));
+  std::vector<uint8_t> read_buffer(kTestBytes1);
+  EXPECT_EQ(kTestBytes1, cache_->Read(read_buffer.data(), kTestBytes1));
+  // The data wraps around the end of the cache.
+  std::vector<uint8_t> write_buffer2;
+  GenerateTestBuffer(kTestBytes2, &write_buffer2);
+  EXPECT_EQ(kTestBytes2, cache_->Write(write_buffer2.data(), kTestBytes2));
+
+  cache_->Grow(kCacheSize * 2);
+  EXPECT_EQ(kCacheSize * 2, cache_->cache_size());
+  EXPECT_EQ(kTestBytes2, cache_->BytesCached());
+  EXPECT_EQ(kCacheSize * 2 - kTestBytes2, cache_->BytesFree());
+  read_buffer.resize(kTestBytes2);
+  EXPECT_EQ(kTestBytes2, cache_->Read(read_buffer.data(), kTestBytes2));
+  EXPECT_EQ(write_buffer2, read_buffer);
+
+  // The cache does not shrink.
+  cache_->Grow(kCacheSize);
+  EXPECT_EQ(kCacheSize * 2, cache_->cache_size());
+}
+
+TEST_F(IoCacheTest, NumReadWaits) {
+  std::vector<uint8_t> write_buffer;
+  GenerateTestBuffer(kBlockSize, &write_buffer);
+  EXPECT_EQ(kBlockSize, cache_->Write(write_buffer.data(), kBlockSize));
+  std::vector<uint8_t> read_buffer(kBlockSize);
+  EXPECT_EQ(kBlockSize, cache_->Read(read_buffer.data(), kBlockSize));
+  EXPECT_EQ(0u, cache_->num_read_waits());
+
+  ClosureThread reader_thread(
+      "ReaderThread",
+      base::Bind(base::IgnoreResult(&IoCache::Read),
+                 base::Unretained(cache_.get()),
+                 static_cast<void*>(read_buffer.data()), kBlockSize));
+  reader_thread.Start();
+  while (cache_->num_read_waits() == 0)
+    base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(1));
+  EXPECT_EQ(kBlockSize, cache_->Write(write_buffer.data(), kBlockSize));
+  reader_thread.Join();
+  EXPECT_EQ(1u, cache_->num_read_waits());
+  EXPECT_EQ(write_buffer, read_buffer);
+}
+
 }  // namespace media
 }  // namespace edash_packager
@@ -0,0 +1,104 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef PACKAGER_FILE_IO_URING_FILE_H_
+#define PACKAGER_FILE_IO_URING_FILE_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "packager/base/compiler_specific.h"
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/media/file/file.h"
+
+namespace edash_packager {
+namespace media {
+
+/// Implements a local file on top of a Linux io_uring. All IoUringFiles share
+/// a single ring, so reads are prefetched and writes are flushed
+/// asynchronously without a helper thread per file, and without going
+/// through an IoCache. The data is staged in a few aligned blocks per file,
+/// which also makes O_DIRECT possible.
+/// Only "r", "w" and "a" modes are supported.
+class IoUringFile : public File {
+ public:
+  /// @param file_name C string containing the name of the file to be accessed.
+  /// @param mode C string containing a file access mode: "r", "w" or "a".
+  /// @param block_size is the size of an I/O request, in bytes. It is rounded
+  ///        up to a multiple of the direct I/O alignment.
+  /// @param num_blocks is the number of blocks which can be in flight at the
+  ///        same time, i.e. the read-ahead or write-behind depth.
+  /// @param direct_io indicates whether the file should be opened with
+  ///        O_DIRECT, bypassing the page cache. Falls back to buffered I/O
+  ///        if the filesystem does not support it.
+  IoUringFile(const char* file_name,
+              const char* mode,
+              uint64_t block_size,
+              size_t num_blocks,
+              bool direct_io);
+
+  /// @name File implementation overrides.
+  /// @{
+  bool Close() override;
+  int64_t Read(void* buffer, uint64_t length) override;
+  int64_t Write(const void* buffer, uint64_t length) override;
+  int64_t Size() override;
+  bool Flush() override;
+  bool Seek(uint64_t position) override;
+  bool Tell(uint64_t* position) override;
+  /// @}
+
+  /// @return true if io_uring is available on this system.
+  static bool IsSupported();
+
+ protected:
+  ~IoUringFile() override;
+
+  bool Open() override;
+
+ private:
+  struct Block;
+
+  // Waits for the pending request of |block|, if any. Returns false if the
+  // request failed.
+  bool WaitForBlock(Block* block);
+  // Waits for the pending requests of all blocks.
+  bool WaitForAllBlocks();
+  // Submits a read request for |block| at |offset|.
+  bool SubmitRead(Block* block, uint64_t offset);
+  // Submits a write request for the valid data of |block|.
+  bool SubmitWrite(Block* block);
+  // Makes |block| the current write block, starting at file |position|.
+  bool StartWriteBlock(Block* block, uint64_t position);
+  // Restarts read-ahead from file |position|.
+  bool StartReadAhead(uint64_t position);
+
+  Block* current_block() { return blocks_[current_block_]; }
+
+  const std::string file_mode_;
+  const uint64_t block_size_;
+  const bool direct_io_requested_;
+  bool direct_io_;
+  int fd_;
+  std::vector<Block*> blocks_;
+  size_t current_block_;
+  // Logical position in the file.
+  uint64_t position_;
+  // File size, including the data which has not been written yet.
+  uint64_t size_;
+  // The offset of the next block to be prefetched, in read mode.
+  uint64_t next_read_offset_;
+  bool error_;
+
+  DISALLOW_COPY_AND_ASSIGN(IoUringFile);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // PACKAGER_FILE_IO_URING_FILE_H_
@@ -0,0 +1,629 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/file/io_uring_file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "packager/base/lazy_instance.h"
+#include "packager/base/logging.h"
+#include "packager/base/posix/eintr_wrapper.h"
+#include "packager/base/stl_util.h"
+#include "packager/base/synchronization/condition_variable.h"
+#include "packager/base/synchronization/lock.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+// Alignment of the buffers, offsets and sizes of O_DIRECT requests.
+const uint64_t kDirectIoAlignment = 4096;
+// Number of submission queue entries of the shared ring.
+const unsigned kRingEntries = 256;
+
+uint64_t AlignDown(uint64_t value) {
+  return value & ~(kDirectIoAlignment - 1);
+}
+
+uint64_t AlignUp(uint64_t value) {
+  return AlignDown(value + kDirectIoAlignment - 1);
+}
+
+int SysIoUringSetup(unsigned entries, io_uring_params* params) {
+  return syscall(__NR_io_uring_setup, entries, params);
+}
+
+int SysIoUringEnter(int ring_fd,
+                    unsigned to_submit,
+                    unsigned min_complete,
+                    unsigned flags) {
+  return syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags,
+                 NULL, 0);
+}
+
+struct IoRequest {
+  IoRequest() : done(false), result(0) {}
+
+  bool done;
+  // Number of bytes transferred, or a negative errno value.
+  int32_t result;
+};
+
+// A single io_uring shared by all the IoUringFiles of the process.
+// Submissions and completions are serialized with |lock_|. Whichever thread
+// waits for a completion first reaps the completion queue on behalf of the
+// others.
+class IoUring {
+ public:
+  IoUring();
+  ~IoUring();
+
+  bool initialized() const { return ring_fd_ >= 0; }
+
+  // Submits a vectored read or write request. |iov| and the buffer it points
+  // to must stay valid until the request completes.
+  bool Submit(uint8_t opcode,
+              int fd,
+              const iovec* iov,
+              uint64_t offset,
+              IoRequest* request);
+
+  // Waits until |request| completes.
+  void Wait(IoRequest* request);
+
+ private:
+  // Waits for at least one completion and dispatches all the completions
+  // available. Called with |lock_| held.
+  void ReapCompletions();
+
+  int ring_fd_;
+  unsigned max_in_flight_;
+
+  void* sq_ring_;
+  size_t sq_ring_size_;
+  void* cq_ring_;
+  size_t cq_ring_size_;
+  io_uring_sqe* sqes_;
+  size_t sqes_size_;
+
+  unsigned* sq_tail_;
+  unsigned sq_mask_;
+  unsigned* sq_array_;
+  unsigned* cq_head_;
+  unsigned* cq_tail_;
+  unsigned cq_mask_;
+  io_uring_cqe* cqes_;
+
+  base::Lock lock_;
+  base::ConditionVariable completion_cv_;
+  unsigned num_in_flight_;
+  bool reaping_;
+
+  DISALLOW_COPY_AND_ASSIGN(IoUring);
+};
+
+IoUring::IoUring()
+    : ring_fd_(-1),
+      max_in_flight_(0),
+      sq_ring_(MAP_FAILED),
+      sq_ring_size_(0),
+      cq_ring_(MAP_FAILED),
+      cq_ring_size_(0),
+      sqes_(static_cast<io_uring_sqe*>(MAP_FAILED)),
+      sqes_size_(0),
+      sq_tail_(NULL),
+      sq_mask_(0),
+      sq_array_(NULL),
+      cq_head_(NULL),
+      cq_tail_(NULL),
+      cq_mask_(0),
+      cqes_(NULL),
+      completion_cv_(&lock_),
+      num_in_flight_(0),
+      reaping_(false) {
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  const int ring_fd = SysIoUringSetup(kRingEntries, &params);
+  if (ring_fd < 0) {
+    PLOG(WARNING) << "io_uring is not available";
+    return;
+  }
+
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_size_ =
+      params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mmap)
+    sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+
+  sq_ring_ = mmap(NULL, sq_ring_size_, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+  if (sq_ring_ != MAP_FAILED) {
+    cq_ring_ = single_mmap ? sq_ring_
+                           : mmap(NULL, cq_ring_size_, PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_POPULATE, ring_fd,
+                                  IORING_OFF_CQ_RING);
+  }
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  if (cq_ring_ != MAP_FAILED) {
+    sqes_ = static_cast<io_uring_sqe*>(
+        mmap(NULL, sqes_size_, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES));
+  }
+  if (sqes_ == MAP_FAILED) {
+    PLOG(WARNING) << "Failed to map io_uring";
+    close(ring_fd);
+    return;
+  }
+
+  uint8_t* sq_ring = static_cast<uint8_t*>(sq_ring_);
+  sq_tail_ = reinterpret_cast<unsigned*>(sq_ring + params.sq_off.tail);
+  sq_mask_ = *reinterpret_cast<unsigned*>(sq_ring + params.sq_off.ring_mask);
+  sq_array_ = reinterpret_cast<unsigned*>(sq_ring + params.sq_off.array);
+  uint8_t* cq_ring = static_cast<uint8_t*>(cq_ring_);
+  cq_head_ = reinterpret_cast<unsigned*>(cq_ring + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<unsigned*>(cq_ring + params.cq_off.tail);
+  cq_mask_ = *reinterpret_cast<unsigned*>(cq_ring + params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<io_uring_cqe*>(cq_ring + params.cq_off.cqes);
+
+  // Never have more requests in flight than the completion queue can hold,
+  // so completions are never dropped.
+  max_in_flight_ = std::min(params.sq_entries, params.cq_entries);
+  ring_fd_ = ring_fd;
+}
+
+IoUring::~IoUring() {
+  if (sqes_ != MAP_FAILED)
+    munmap(sqes_, sqes_size_);
+  if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_)
+    munmap(cq_ring_, cq_ring_size_);
+  if (sq_ring_ != MAP_FAILED)
+    munmap(sq_ring_, sq_ring_size_);
+  if (ring_fd_ >= 0)
+    close(ring_fd_);
+}
+
+bool IoUring::Submit(uint8_t opcode,
+                     int fd,
+                     const iovec* iov,
+                     uint64_t offset,
+                     IoRequest* request) {
+  DCHECK(initialized());
+  request->done = false;
+  request->result = 0;
+
+  base::AutoLock l(lock_);
+  while (num_in_flight_ >= max_in_flight_)
+    ReapCompletions();
+
+  // Only submitters write the tail, and they are serialized by |lock_|.
+  const unsigned tail = *sq_tail_;
+  const unsigned index = tail & sq_mask_;
+  io_uring_sqe* sqe = &sqes_[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<uint64_t>(iov);
+  sqe->len = 1;
+  sqe->off = offset;
+  sqe->user_data = reinterpret_cast<uint64_t>(request);
+  sq_array_[index] = index;
+  __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+
+  int ret;
+  do {
+    ret = SysIoUringEnter(ring_fd_, 1, 0, 0);
+  } while (ret < 0 && (errno == EINTR || errno == EAGAIN));
+  if (ret != 1) {
+    PLOG(ERROR) << "Failed to submit io_uring request";
+    // The entry has not been consumed by the kernel; take it back.
+    __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+    return false;
+  }
+  ++num_in_flight_;
+  return true;
+}
+
+void IoUring::Wait(IoRequest* request) {
+  base::AutoLock l(lock_);
+  while (!request->done)
+    ReapCompletions();
+}
+
+void IoUring::ReapCompletions() {
+  lock_.AssertAcquired();
+  if (reaping_) {
+    // Another thread is reaping; it signals once it is done.
+    completion_cv_.Wait();
+    return;
+  }
+  DCHECK_GT(num_in_flight_, 0u);
+
+  reaping_ = true;
+  {
+    base::AutoUnlock unlock(lock_);
+    int ret;
+    do {
+      ret = SysIoUringEnter(ring_fd_, 0, 1, IORING_ENTER_GETEVENTS);
+    } while (ret < 0 && errno == EINTR);
+    // There is no way to recover the requests in flight.
+    PCHECK(ret >= 0) << "Failed to wait for io_uring completions";
+  }
+
+  unsigned head = *cq_head_;
+  const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+  for (; head != tail; ++head) {
+    const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+    IoRequest* request = reinterpret_cast<IoRequest*>(cqe.user_data);
+    request->result = cqe.res;
+    request->done = true;
+    DCHECK_GT(num_in_flight_, 0u);
+    --num_in_flight_;
+  }
+  __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+
+  reaping_ = false;
+  completion_cv_.Broadcast();
+}
+
+base::LazyInstance<IoUring>::Leaky g_io_uring = LAZY_INSTANCE_INITIALIZER;
+
+}  // namespace
+
+struct IoUringFile::Block {
+  explicit Block(uint64_t size)
+      : data(NULL), offset(0), valid(0), fill(0), pending(false),
+        writing(false) {
+    void* buffer = NULL;
+    CHECK_EQ(0, posix_memalign(&buffer, kDirectIoAlignment, size));
+    data = static_cast<uint8_t*>(buffer);
+    iov.iov_base = data;
+    iov.iov_len = 0;
+  }
+  ~Block() {
+    DCHECK(!pending);
+    free(data);
+  }
+
+  uint8_t* data;
+  // File offset of |data|.
+  uint64_t offset;
+  // Number of bytes of |data| holding file content.
+  uint64_t valid;
+  // Write position in |data|, in write mode.
+  uint64_t fill;
+  bool pending;
+  bool writing;
+  iovec iov;
+  IoRequest request;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Block);
+};
+
+IoUringFile::IoUringFile(const char* file_name,
+                         const char* mode,
+                         uint64_t block_size,
+                         size_t num_blocks,
+                         bool direct_io)
+    : File(file_name),
+      file_mode_(mode),
+      block_size_(AlignUp(std::max<uint64_t>(block_size, 1))),
+      direct_io_requested_(direct_io),
+      direct_io_(false),
+      fd_(-1),
+      current_block_(0),
+      position_(0),
+      size_(0),
+      next_read_offset_(0),
+      error_(false) {
+  const size_t kMinNumBlocks = 2;
+  for (size_t i = 0; i < std::max(num_blocks, kMinNumBlocks); ++i)
+    blocks_.push_back(new Block(block_size_));
+}
+
+IoUringFile::~IoUringFile() {
+  if (fd_ >= 0)
+    close(fd_);
+  STLDeleteElements(&blocks_);
+}
+
+bool IoUringFile::Close() {
+  bool result = true;
+  if (fd_ >= 0) {
+    // The blocks must not be freed with requests in flight.
+    result = file_mode_ == "r" ? WaitForAllBlocks() : Flush();
+    if (IGNORE_EINTR(close(fd_)) < 0) {
+      PLOG(ERROR) << "Failed to close " << file_name();
+      result = false;
+    }
+    fd_ = -1;
+  }
+  delete this;
+  return result;
+}
+
+int64_t IoUringFile::Read(void* buffer, uint64_t length) {
+  DCHECK(buffer != NULL);
+  DCHECK_GE(fd_, 0);
+  DCHECK_EQ(file_mode_, "r");
+  if (error_)
+    return -1;
+
+  uint8_t* output = static_cast<uint8_t*>(buffer);
+  uint64_t bytes_read = 0;
+  while (bytes_read < length) {
+    Block* block = current_block();
+    if (!WaitForBlock(block))
+      return -1;
+    DCHECK_GE(position_, block->offset);
+    const uint64_t block_position = position_ - block->offset;
+    if (block_position >= block->valid) {
+      // A short block marks the end of the file.
+      if (block->valid < block_size_)
+        break;
+      // The block is consumed; reuse it to read further ahead.
+      if (!SubmitRead(block, next_read_offset_))
+        return -1;
+      next_read_offset_ += block_size_;
+      current_block_ = (current_block_ + 1) % blocks_.size();
+      continue;
+    }
+    const uint64_t size =
+        std::min(length - bytes_read, block->valid - block_position);
+    memcpy(output + bytes_read, block->data + block_position, size);
+    bytes_read += size;
+    position_ += size;
+  }
+  return bytes_read;
+}
+
+int64_t IoUringFile::Write(const void* buffer, uint64_t length) {
+  DCHECK(buffer != NULL);
+  DCHECK_GE(fd_, 0);
+  DCHECK_NE(file_mode_, "r");
+  if (error_)
+    return -1;
+
+  const uint8_t* input = static_cast<const uint8_t*>(buffer);
+  uint64_t bytes_written = 0;
+  while (bytes_written < length) {
+    Block* block = current_block();
+    const uint64_t size =
+        std::min(length - bytes_written, block_size_ - block->fill);
+    memcpy(block->data + block->fill, input + bytes_written, size);
+    block->fill += size;
+    block->valid = std::max(block->valid, block->fill);
+    bytes_written += size;
+    position_ += size;
+    size_ = std::max(size_, block->offset + block->valid);
+
+    if (block->fill == block_size_) {
+      if (!SubmitWrite(block))
+        return -1;
+      current_block_ = (current_block_ + 1) % blocks_.size();
+      if (!StartWriteBlock(current_block(), position_))
+        return -1;
+    }
+  }
+  return bytes_written;
+}
+
+int64_t IoUringFile::Size() {
+  DCHECK_GE(fd_, 0);
+  if (file_mode_ != "r")
+    return size_;
+
+  struct stat info;
+  if (fstat(fd_, &info) != 0) {
+    PLOG(ERROR) << "Cannot get file size of " << file_name();
+    return -1;
+  }
+  return info.st_size;
+}
+
+bool IoUringFile::Flush() {
+  DCHECK_GE(fd_, 0);
+  if (file_mode_ == "r")
+    return true;
+  if (error_)
+    return false;
+
+  // The current block is written as is and kept, so that subsequent writes
+  // keep filling it. Waiting for completion guarantees that it is not
+  // modified while in flight.
+  if (!SubmitWrite(current_block()) || !WaitForAllBlocks())
+    return false;
+  if (direct_io_ && ftruncate(fd_, size_) != 0) {
+    // Padded writes may have extended the file beyond its actual size.
+    PLOG(ERROR) << "Failed to truncate " << file_name();
+    error_ = true;
+    return false;
+  }
+  return true;
+}
+
+bool IoUringFile::Seek(uint64_t position) {
+  DCHECK_GE(fd_, 0);
+  if (file_mode_ == "r")
+    return StartReadAhead(position);
+
+  if (!Flush())
+    return false;
+  position_ = position;
+  return StartWriteBlock(current_block(), position);
+}
+
+bool IoUringFile::Tell(uint64_t* position) {
+  DCHECK(position);
+  *position = position_;
+  return true;
+}
+
+// static
+bool IoUringFile::IsSupported() {
+  return g_io_uring.Get().initialized();
+}
+
+bool IoUringFile::Open() {
+  if (!IsSupported())
+    return false;
+
+  int flags = O_CLOEXEC;
+  if (file_mode_ == "r") {
+    flags |= O_RDONLY;
+  } else if (file_mode_ == "w") {
+    // Direct writes may need to read back partial blocks.
+    flags |= O_RDWR | O_CREAT | O_TRUNC;
+  } else if (file_mode_ == "a") {
+    flags |= O_RDWR | O_CREAT;
+  } else {
+    LOG(ERROR) << "Unsupported mode " << file_mode_ << " for " << file_name();
+    return false;
+  }
+
+  const mode_t kCreateMode = 0666;
+  if (direct_io_requested_) {
+    fd_ = HANDLE_EINTR(
+        open(file_name().c_str(), flags | O_DIRECT, kCreateMode));
+    if (fd_ >= 0) {
+      direct_io_ = true;
+    } else if (errno == EINVAL) {
+      LOG(WARNING) << "O_DIRECT is not supported for " << file_name()
+                   << ", using buffered I/O.";
+    }
+  }
+  if (fd_ < 0)
+    fd_ = HANDLE_EINTR(open(file_name().c_str(), flags, kCreateMode));
+  if (fd_ < 0)
+    return false;
+
+  if (file_mode_ == "r")
+    return StartReadAhead(0);
+
+  if (file_mode_ == "a") {
+    struct stat info;
+    if (fstat(fd_, &info) != 0)
+      return false;
+    size_ = info.st_size;
+  }
+  position_ = size_;
+  return StartWriteBlock(current_block(), position_);
+}
+
+bool IoUringFile::WaitForBlock(Block* block) {
+  if (!block->pending)
+    return !error_;
+  g_io_uring.Get().Wait(&block->request);
+  block->pending = false;
+
+  const int32_t result = block->request.result;
+  if (result < 0) {
+    LOG(ERROR) << "I/O error on " << file_name() << ": " << strerror(-result);
+    error_ = true;
+    return false;
+  }
+  if (block->writing) {
+    if (static_cast<uint64_t>(result) != block->iov.iov_len) {
+      LOG(ERROR) << "Short write on " << file_name();
+      error_ = true;
+      return false;
+    }
+  } else {
+    block->valid = result;
+  }
+  return !error_;
+}
+
+bool IoUringFile::WaitForAllBlocks() {
+  bool result = true;
+  for (size_t i = 0; i < blocks_.size(); ++i)
+    result &= WaitForBlock(blocks_[i]);
+  return result;
+}
+
+bool IoUringFile::SubmitRead(Block* block, uint64_t offset) {
+  DCHECK(!block->pending);
+  block->offset = offset;
+  block->valid = 0;
+  block->writing = false;
+  block->iov.iov_len = block_size_;
+  if (!g_io_uring.Get().Submit(IORING_OP_READV, fd_, &block->iov, offset,
+                               &block->request)) {
+    error_ = true;
+    return false;
+  }
+  block->pending = true;
+  return true;
+}
+
+bool IoUringFile::SubmitWrite(Block* block) {
+  DCHECK(!block->pending);
+  if (block->valid == 0)
+    return true;
+  // Direct writes are rounded up with the zeros past |valid|; the file is
+  // truncated back to its actual size on Flush.
+  block->writing = true;
+  block->iov.iov_len = direct_io_ ? AlignUp(block->valid) : block->valid;
+  if (!g_io_uring.Get().Submit(IORING_OP_WRITEV, fd_, &block->iov,
+                               block->offset, &block->request)) {
+    error_ = true;
+    return false;
+  }
+  block->pending = true;
+  return true;
+}
+
+bool IoUringFile::StartWriteBlock(Block* block, uint64_t position) {
+  if (!WaitForBlock(block))
+    return false;
+
+  block->offset = direct_io_ ? AlignDown(position) : position;
+  block->fill = position - block->offset;
+  block->valid = 0;
+  if (direct_io_) {
+    memset(block->data, 0, block_size_);
+    if (block->offset < size_) {
+      // The block is written back in full, so it must start with the data
+      // already in the file.
+      if (!SubmitRead(block, block->offset) || !WaitForBlock(block))
+        return false;
+    }
+    block->valid = std::max(block->valid, block->fill);
+  }
+  return true;
+}
+
+bool IoUringFile::StartReadAhead(uint64_t position) {
+  // The requests in flight cannot be cancelled; let them complete.
+  if (!WaitForAllBlocks())
+    return false;
+
+  position_ = position;
+  current_block_ = 0;
+  next_read_offset_ = AlignDown(position);
+  for (size_t i = 0; i < blocks_.size(); ++i) {
+    if (!SubmitRead(blocks_[i], next_read_offset_))
+      return false;
+    next_read_offset_ += block_size_;
+  }
+  return true;
+}
+
+}  // namespace media
+}  // namespace edash_packager
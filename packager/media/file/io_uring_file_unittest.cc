@@ -0,0 +1,165 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+#include "packager/base/files/file_util.h"
+#include "packager/base/logging.h"
+#include "packager/media/file/file.h"
+#include "packager/media/file/io_uring_file.h"
+
+DECLARE_uint64(io_cache_size);
+DECLARE_uint64(io_block_size);
+DECLARE_bool(io_uring);
+DECLARE_bool(io_direct);
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+const uint64_t kBlockSize = 4096;
+const uint64_t kNumBlocks = 4;
+// Spans several blocks and ends with a partial block.
+const size_t kDataSize = 10 * kBlockSize + 123;
+}  // namespace
+
+class IoUringFileTest : public ::testing::TestWithParam<bool> {
+ protected:
+  void SetUp() override {
+    if (!IoUringFile::IsSupported()) {
+      LOG(WARNING) << "io_uring is not supported. Skipping test.";
+      return;
+    }
+
+    FLAGS_io_uring = true;
+    FLAGS_io_direct = GetParam();
+    FLAGS_io_block_size = kBlockSize;
+    FLAGS_io_cache_size = kBlockSize * kNumBlocks;
+
+    data_.resize(kDataSize);
+    for (size_t i = 0; i < kDataSize; ++i)
+      data_[i] = i % 251;
+    ASSERT_TRUE(base::CreateTemporaryFile(&test_file_path_));
+    file_name_ = test_file_path_.value();
+  }
+
+  void TearDown() override {
+    if (!file_name_.empty())
+      base::DeleteFile(test_file_path_, false);
+  }
+
+  bool skipped() const { return file_name_.empty(); }
+
+  google::FlagSaver flag_saver_;
+  std::string data_;
+  base::FilePath test_file_path_;
+  std::string file_name_;
+};
+
+TEST_P(IoUringFileTest, WriteRead) {
+  if (skipped())
+    return;
+
+  File* file = File::Open(file_name_.c_str(), "w");
+  ASSERT_TRUE(file != NULL);
+  // Write in odd-sized chunks so writes straddle the blocks.
+  const size_t kChunkSize = 1000;
+  for (size_t offset = 0; offset < kDataSize; offset += kChunkSize) {
+    const size_t size = std::min(kChunkSize, kDataSize - offset);
+    ASSERT_EQ(static_cast<int64_t>(size),
+              file->Write(data_.data() + offset, size));
+  }
+  EXPECT_EQ(static_cast<int64_t>(kDataSize), file->Size());
+  ASSERT_TRUE(file->Close());
+
+  std::string read_data;
+  ASSERT_TRUE(base::ReadFileToString(test_file_path_, &read_data));
+  EXPECT_EQ(data_, read_data);
+
+  file = File::Open(file_name_.c_str(), "r");
+  ASSERT_TRUE(file != NULL);
+  EXPECT_EQ(static_cast<int64_t>(kDataSize), file->Size());
+  std::string buffer(kDataSize + 1, 0);
+  EXPECT_EQ(static_cast<int64_t>(kDataSize),
+            file->Read(&buffer[0], buffer.size()));
+  buffer.resize(kDataSize);
+  EXPECT_EQ(data_, buffer);
+  EXPECT_EQ(0, file->Read(&buffer[0], 1));
+  EXPECT_TRUE(file->Close());
+}
+
+TEST_P(IoUringFileTest, SeekWriteAndSeekRead) {
+  if (skipped())
+    return;
+
+  File* file = File::Open(file_name_.c_str(), "w");
+  ASSERT_TRUE(file != NULL);
+  ASSERT_EQ(static_cast<int64_t>(kDataSize),
+            file->Write(data_.data(), kDataSize));
+
+  // Overwrite a range straddling two blocks in the middle of the file.
+  const uint64_t kOverwriteOffset = 3 * kBlockSize - 10;
+  const std::string kOverwrite(100, 'x');
+  ASSERT_TRUE(file->Seek(kOverwriteOffset));
+  ASSERT_EQ(static_cast<int64_t>(kOverwrite.size()),
+            file->Write(kOverwrite.data(), kOverwrite.size()));
+  uint64_t position = 0;
+  ASSERT_TRUE(file->Tell(&position));
+  EXPECT_EQ(kOverwriteOffset + kOverwrite.size(), position);
+  EXPECT_EQ(static_cast<int64_t>(kDataSize), file->Size());
+  ASSERT_TRUE(file->Close());
+  data_.replace(kOverwriteOffset, kOverwrite.size(), kOverwrite);
+
+  std::string read_data;
+  ASSERT_TRUE(base::ReadFileToString(test_file_path_, &read_data));
+  EXPECT_EQ(data_, read_data);
+
+  file = File::Open(file_name_.c_str(), "r");
+  ASSERT_TRUE(file != NULL);
+  const uint64_t kReadOffset = 5 * kBlockSize + 7;
+  ASSERT_TRUE(file->Seek(kReadOffset));
+  ASSERT_TRUE(file->Tell(&position));
+  EXPECT_EQ(kReadOffset, position);
+  std::string buffer(kBlockSize, 0);
+  ASSERT_EQ(static_cast<int64_t>(kBlockSize),
+            file->Read(&buffer[0], kBlockSize));
+  EXPECT_EQ(data_.substr(kReadOffset, kBlockSize), buffer);
+  ASSERT_TRUE(file->Seek(0));
+  ASSERT_EQ(1, file->Read(&buffer[0], 1));
+  EXPECT_EQ(data_[0], buffer[0]);
+  EXPECT_TRUE(file->Close());
+}
+
+TEST_P(IoUringFileTest, Append) {
+  if (skipped())
+    return;
+
+  const size_t kFirstPartSize = kBlockSize + 5;
+  File* file = File::Open(file_name_.c_str(), "w");
+  ASSERT_TRUE(file != NULL);
+  ASSERT_EQ(static_cast<int64_t>(kFirstPartSize),
+            file->Write(data_.data(), kFirstPartSize));
+  ASSERT_TRUE(file->Close());
+
+  file = File::Open(file_name_.c_str(), "a");
+  ASSERT_TRUE(file != NULL);
+  const size_t kSecondPartSize = kDataSize - kFirstPartSize;
+  ASSERT_EQ(static_cast<int64_t>(kSecondPartSize),
+            file->Write(data_.data() + kFirstPartSize, kSecondPartSize));
+  ASSERT_TRUE(file->Close());
+
+  std::string read_data;
+  ASSERT_TRUE(base::ReadFileToString(test_file_path_, &read_data));
+  EXPECT_EQ(data_, read_data);
+}
+
+INSTANTIATE_TEST_CASE_P(TrueIsDirectIo, IoUringFileTest, ::testing::Bool());
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,107 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/file/io_uring_file.h"
+
+#include "packager/base/logging.h"
+
+namespace edash_packager {
+namespace media {
+
+// io_uring is Linux only. IsSupported() returns false so IoUringFile is never
+// created on other platforms.
+
+struct IoUringFile::Block {};
+
+IoUringFile::IoUringFile(const char* file_name,
+                         const char* mode,
+                         uint64_t block_size,
+                         size_t num_blocks,
+                         bool direct_io)
+    : File(file_name),
+      file_mode_(mode),
+      block_size_(block_size),
+      direct_io_requested_(direct_io),
+      direct_io_(false),
+      fd_(-1),
+      current_block_(0),
+      position_(0),
+      size_(0),
+      next_read_offset_(0),
+      error_(false) {}
+
+IoUringFile::~IoUringFile() {}
+
+bool IoUringFile::Close() {
+  delete this;
+  return false;
+}
+
+int64_t IoUringFile::Read(void* buffer, uint64_t length) {
+  NOTIMPLEMENTED();
+  return -1;
+}
+
+int64_t IoUringFile::Write(const void* buffer, uint64_t length) {
+  NOTIMPLEMENTED();
+  return -1;
+}
+
+int64_t IoUringFile::Size() {
+  NOTIMPLEMENTED();
+  return -1;
+}
+
+bool IoUringFile::Flush() {
+  NOTIMPLEMENTED();
+  return false;
+}
+
+bool IoUringFile::Seek(uint64_t position) {
+  NOTIMPLEMENTED();
+  return false;
+}
+
+bool IoUringFile::Tell(uint64_t* position) {
+  NOTIMPLEMENTED();
+  return false;
+}
+
+// static
+bool IoUringFile::IsSupported() {
+  return false;
+}
+
+bool IoUringFile::Open() {
+  return false;
+}
+
+bool IoUringFile::WaitForBlock(Block* block) {
+  return false;
+}
+
+bool IoUringFile::WaitForAllBlocks() {
+  return false;
+}
+
+bool IoUringFile::SubmitRead(Block* block, uint64_t offset) {
+  return false;
+}
+
+bool IoUringFile::SubmitWrite(Block* block) {
+  return false;
+}
+
+bool IoUringFile::StartWriteBlock(Block* block, uint64_t position) {
+  return false;
+}
+
+bool IoUringFile::StartReadAhead(uint64_t position) {
+  return false;
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -8,19 +8,70 @@
 
 #include <stdio.h>
 
+#include <algorithm>
+#include <vector>
+
+#include "packager/base/atomicops.h"
 #include "packager/base/files/file_util.h"
 #include "packager/base/logging.h"
 
+#if defined(OS_POSIX)
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
 namespace edash_packager {
 namespace media {
 
+namespace {
+
+// The writeback of the files synced on close is started every time this many
+// bytes are written.
+const uint64_t kWritebackSize = 8 << 20;  // 8MB
+
+const char* const kSyncPolicyNames[] = {"none", "segment", "close"};
+COMPILE_ASSERT(arraysize(kSyncPolicyNames) == kNumLocalFileSyncPolicies,
+               sync_policy_names_do_not_match_policies);
+
+// Constant-initialized, so usable before main() and after exit.
+base::subtle::Atomic32 g_sync_policy = kNoSync;
+
+bool IsWriteMode(const std::string& mode) {
+  return !mode.empty() && (mode[0] == 'w' || mode[0] == 'a');
+}
+
+}  // namespace
+
 LocalFile::LocalFile(const char* file_name, const char* mode)
-    : File(file_name), file_mode_(mode), internal_file_(NULL) {}
+    : File(file_name),
+      file_mode_(mode),
+      internal_file_(NULL),
+      expected_size_(0),
+      sync_policy_(kNoSync),
+      bytes_not_written_back_(0) {}
 
 bool LocalFile::Close() {
   bool result = true;
   if (internal_file_) {
-    result = base::CloseFile(internal_file_);
+    if (sync_policy_ != kNoSync && !Sync())
+      result = false;
+#if defined(OS_POSIX)
+    // Release the preallocated space beyond the data written.
+    struct stat file_stat;
+    if (expected_size_ > 0 && FlushBuffer() &&
+        fstat(fileno(internal_file_), &file_stat) == 0 &&
+        static_cast<uint64_t>(file_stat.st_size) < expected_size_ &&
+        ftruncate(fileno(internal_file_), file_stat.st_size) != 0) {
+      PLOG(WARNING) << "Cannot release the space preallocated for "
+                    << file_name();
+    }
+#endif
+    if (!base::CloseFile(internal_file_))
+      result = false;
     internal_file_ = NULL;
   }
   delete this;
@@ -36,14 +87,64 @@ int64_t LocalFile::Read(void* buffer, uint64_t length) {
 int64_t LocalFile::Write(const void* buffer, uint64_t length) {
   DCHECK(buffer != NULL);
   DCHECK(internal_file_ != NULL);
-  return fwrite(buffer, sizeof(char), length, internal_file_);
+  const int64_t bytes_written =
+      fwrite(buffer, sizeof(char), length, internal_file_);
+  StartWriteback(bytes_written);
+  return bytes_written;
+}
+
+int64_t LocalFile::WriteV(const WriteBlock* blocks, size_t num_blocks) {
+#if defined(OS_POSIX)
+  DCHECK(blocks != NULL);
+  DCHECK(internal_file_ != NULL);
+  // The blocks are written directly to the file descriptor, bypassing the
+  // stdio buffer, which is flushed first so the data stays in order.
+  if (!FlushBuffer())
+    return -1;
+  const int fd = fileno(internal_file_);
+
+  int64_t bytes_written = 0;
+  std::vector<struct iovec> iovecs;
+  for (size_t i = 0; i < num_blocks;) {
+    const size_t num_iovecs =
+        std::min(num_blocks - i, static_cast<size_t>(IOV_MAX));
+    iovecs.resize(num_iovecs);
+    size_t length = 0;
+    for (size_t j = 0; j < num_iovecs; ++j) {
+      iovecs[j].iov_base = const_cast<void*>(blocks[i + j].data);
+      iovecs[j].iov_len = blocks[i + j].length;
+      length += blocks[i + j].length;
+    }
+    const ssize_t result = writev(fd, iovecs.data(), num_iovecs);
+    if (result < 0) {
+      if (bytes_written == 0)
+        bytes_written = -1;
+      break;
+    }
+    bytes_written += result;
+    if (static_cast<size_t>(result) < length)
+      break;
+    i += num_iovecs;
+  }
+
+  // stdio caches the file position, which has moved behind its back. There is
+  // no position to restore for pipes, on which lseek fails.
+  const off_t position = lseek(fd, 0, SEEK_CUR);
+  if (position >= 0 && fseeko(internal_file_, position, SEEK_SET) < 0)
+    return -1;
+  if (bytes_written > 0)
+    StartWriteback(bytes_written);
+  return bytes_written;
+#else
+  return File::WriteV(blocks, num_blocks);
+#endif
 }
 
 int64_t LocalFile::Size() {
   DCHECK(internal_file_ != NULL);
 
   // Flush any buffered data, so we get the true file size.
-  if (!Flush()) {
+  if (!FlushBuffer()) {
     LOG(ERROR) << "Cannot flush file.";
     return -1;
   }
@@ -58,7 +159,9 @@ int64_t LocalFile::Size() {
 
 bool LocalFile::Flush() {
   DCHECK(internal_file_ != NULL);
-  return ((fflush(internal_file_) == 0) && !ferror(internal_file_));
+  if (sync_policy_ == kSyncPerSegment)
+    return Sync();
+  return FlushBuffer();
 }
 
 bool LocalFile::Seek(uint64_t position) {
@@ -78,12 +181,120 @@ LocalFile::~LocalFile() {}
 bool LocalFile::Open() {
   internal_file_ =
       base::OpenFile(base::FilePath(file_name()), file_mode_.c_str());
-  return (internal_file_ != NULL);
+  if (!internal_file_)
+    return false;
+  if (!IsWriteMode(file_mode_)) {
+    expected_size_ = 0;
+    return true;
+  }
+  sync_policy_ = GetSyncPolicy();
+#if defined(OS_LINUX) && defined(FALLOC_FL_KEEP_SIZE)
+  // The space is reserved without changing the file size, so the file can be
+  // written as usual and the space left over released on Close().
+  if (expected_size_ > 0 &&
+      fallocate(fileno(internal_file_), FALLOC_FL_KEEP_SIZE, 0,
+                expected_size_) != 0) {
+    // Not supported by every file system.
+    VPLOG(1) << "Cannot preallocate " << expected_size_ << " bytes for "
+             << file_name();
+    expected_size_ = 0;
+  }
+#else
+  expected_size_ = 0;
+#endif
+  return true;
+}
+
+void LocalFile::SetExpectedSize(uint64_t size) {
+  expected_size_ = size;
+}
+
+bool LocalFile::FlushBuffer() {
+  DCHECK(internal_file_ != NULL);
+  return ((fflush(internal_file_) == 0) && !ferror(internal_file_));
+}
+
+void LocalFile::StartWriteback(uint64_t bytes_written) {
+  if (sync_policy_ != kSyncOnClose)
+    return;
+  bytes_not_written_back_ += bytes_written;
+  if (bytes_not_written_back_ < kWritebackSize)
+    return;
+  bytes_not_written_back_ = 0;
+#if defined(OS_LINUX)
+  // Starts the writeback of the dirty pages without waiting for it.
+  if (FlushBuffer() &&
+      sync_file_range(fileno(internal_file_), 0, 0, SYNC_FILE_RANGE_WRITE) !=
+          0) {
+    VPLOG(1) << "Cannot start the writeback of " << file_name();
+  }
+#endif
+}
+
+bool LocalFile::Sync() {
+  if (!FlushBuffer())
+    return false;
+#if defined(OS_POSIX)
+#if defined(OS_LINUX)
+  // The metadata which is not needed to read the data back is not synced.
+  const int result = fdatasync(fileno(internal_file_));
+#else
+  const int result = fsync(fileno(internal_file_));
+#endif
+  if (result != 0) {
+    PLOG(ERROR) << "Cannot sync " << file_name();
+    return false;
+  }
+#endif
+  return true;
 }
 
 bool LocalFile::Delete(const char* file_name) {
   return base::DeleteFile(base::FilePath(file_name), false);
 }
 
+bool LocalFile::Link(const char* existing_file_name,
+                     const char* new_file_name) {
+#if defined(OS_POSIX)
+  // The new name gets its own directory entry: writing to a file which has
+  // been replaced in place would change the contents of all its links.
+  if (unlink(new_file_name) != 0 && errno != ENOENT) {
+    PLOG(ERROR) << "Cannot replace " << new_file_name;
+    return false;
+  }
+  if (link(existing_file_name, new_file_name) != 0) {
+    PLOG(WARNING) << "Cannot link " << new_file_name << " to "
+                  << existing_file_name;
+    return false;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+void LocalFile::SetSyncPolicy(LocalFileSyncPolicy policy) {
+  DCHECK_GE(policy, 0);
+  DCHECK_LT(policy, kNumLocalFileSyncPolicies);
+  base::subtle::NoBarrier_Store(&g_sync_policy, policy);
+}
+
+LocalFileSyncPolicy LocalFile::GetSyncPolicy() {
+  return static_cast<LocalFileSyncPolicy>(
+      base::subtle::NoBarrier_Load(&g_sync_policy));
+}
+
+bool LocalFile::ParseSyncPolicy(const std::string& name,
+                                LocalFileSyncPolicy* policy) {
+  DCHECK(policy);
+  for (int i = 0; i < kNumLocalFileSyncPolicies; ++i) {
+    if (name == kSyncPolicyNames[i]) {
+      *policy = static_cast<LocalFileSyncPolicy>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
 }  // namespace media
 }  // namespace edash_packager
@@ -17,6 +17,20 @@
 namespace edash_packager {
 namespace media {
 
+/// Durability policy of the local files written.
+enum LocalFileSyncPolicy {
+  /// The data is left to the writeback of the kernel.
+  kNoSync,
+  /// The data is synced to the disk on every Flush() and on Close(), i.e. at
+  /// the end of every segment of the outputs with a file per segment, or
+  /// which are flushed at the end of every segment.
+  kSyncPerSegment,
+  /// The writeback of the data is started as it is written, and the data is
+  /// synced to the disk on Close(), which then has little left to wait for.
+  kSyncOnClose,
+  kNumLocalFileSyncPolicies,
+};
+
 /// Implement LocalFile which deals with local storage.
 class LocalFile : public File {
  public:
@@ -30,6 +44,7 @@ class LocalFile : public File {
   bool Close() override;
   int64_t Read(void* buffer, uint64_t length) override;
   int64_t Write(const void* buffer, uint64_t length) override;
+  int64_t WriteV(const WriteBlock* blocks, size_t num_blocks) override;
   int64_t Size() override;
   bool Flush() override;
   bool Seek(uint64_t position) override;
@@ -41,14 +56,45 @@ class LocalFile : public File {
   /// @return true if successful, or false otherwise.
   static bool Delete(const char* file_name);
 
+  /// Make @a new_file_name a hard link to @a existing_file_name, replacing
+  /// the file @a new_file_name if it exists.
+  /// @return true if successful, false otherwise, e.g. if hard links are not
+  ///         supported.
+  static bool Link(const char* existing_file_name, const char* new_file_name);
+
+  /// Sets the durability policy of the local files opened for writing
+  /// thereafter. The default policy is kNoSync.
+  static void SetSyncPolicy(LocalFileSyncPolicy policy);
+  static LocalFileSyncPolicy GetSyncPolicy();
+
+  /// Parses a durability policy name: "none", "segment" or "close".
+  /// @return true on success, false if @a name is not a policy.
+  static bool ParseSyncPolicy(const std::string& name,
+                              LocalFileSyncPolicy* policy);
+
  protected:
   ~LocalFile() override;
 
   bool Open() override;
+  /// Preallocates the disk space of @a size bytes on Open() if the file is
+  /// opened for writing, so that large outputs are not fragmented. The space
+  /// beyond the data written is released on Close().
+  void SetExpectedSize(uint64_t size) override;
 
  private:
+  // Flushes the stdio buffer, without syncing.
+  bool FlushBuffer();
+  // Starts the writeback of the data written, every few megabytes.
+  void StartWriteback(uint64_t bytes_written);
+  // Syncs the data written to the disk.
+  bool Sync();
+
   std::string file_mode_;
   FILE* internal_file_;
+  uint64_t expected_size_;
+  LocalFileSyncPolicy sync_policy_;
+  // The bytes written since the writeback was last started.
+  uint64_t bytes_not_written_back_;
 
   DISALLOW_COPY_AND_ASSIGN(LocalFile);
 };
@@ -0,0 +1,81 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/file/manifest_sink.h"
+
+#include "packager/base/atomicops.h"
+#include "packager/base/logging.h"
+#include "packager/base/stl_util.h"
+#include "packager/media/file/file.h"
+#include "packager/media/file/incremental_gzip_compressor.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+const char kGzipExtension[] = ".gz";
+
+base::subtle::Atomic32 g_gzip_manifests = 0;
+
+}  // namespace
+
+FileManifestSink::FileManifestSink() {}
+
+FileManifestSink::~FileManifestSink() {
+  STLDeleteValues(&compressors_);
+}
+
+bool FileManifestSink::Publish(const std::string& name,
+                               const std::string& content,
+                               uint64_t version) {
+  // The compressed manifest is written first, so that it is never older than
+  // the plain one.
+  if (base::subtle::NoBarrier_Load(&g_gzip_manifests) &&
+      !WriteGzipManifest(name, content)) {
+    return false;
+  }
+  if (!File::WriteFileAtomically(name.c_str(), content)) {
+    LOG(ERROR) << "Failed to write manifest " << name;
+    return false;
+  }
+  return true;
+}
+
+// static
+void FileManifestSink::SetGzipManifests(bool gzip_manifests) {
+  base::subtle::NoBarrier_Store(&g_gzip_manifests, gzip_manifests ? 1 : 0);
+}
+
+bool FileManifestSink::WriteGzipManifest(const std::string& name,
+                                         const std::string& content) {
+  IncrementalGzipCompressor* compressor;
+  {
+    base::AutoLock auto_lock(lock_);
+    IncrementalGzipCompressor*& entry = compressors_[name];
+    if (!entry)
+      entry = new IncrementalGzipCompressor;
+    compressor = entry;
+  }
+  // The versions of a manifest are published one at a time, so its
+  // compressor is not used concurrently.
+  std::string gzip;
+  if (!compressor->Compress(content, &gzip)) {
+    LOG(ERROR) << "Failed to compress manifest " << name;
+    return false;
+  }
+  const std::string gzip_name = name + kGzipExtension;
+  if (!File::WriteFileAtomically(gzip_name.c_str(), gzip)) {
+    LOG(ERROR) << "Failed to write manifest " << gzip_name;
+    return false;
+  }
+  VLOG(2) << "Compressed " << compressor->last_bytes_compressed() << " of "
+          << content.size() << " bytes of manifest " << name;
+  return true;
+}
+
+}  // namespace media
+}  // namespace edash_packager
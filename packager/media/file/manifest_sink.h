@@ -0,0 +1,87 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_FILE_MANIFEST_SINK_H_
+#define MEDIA_FILE_MANIFEST_SINK_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+
+#include "packager/base/macros.h"
+#include "packager/base/synchronization/lock.h"
+
+namespace edash_packager {
+namespace media {
+
+/// Receives the manifests, i.e. the MPD and the HLS playlists, as they are
+/// generated. The default sink writes them to files. An application embedding
+/// the packager can provide its own sink, e.g. to serve the manifests from
+/// memory.
+/// Thread Safety: Publish() may be called concurrently for different
+/// manifests. The versions of a manifest are published one at a time, in
+/// order.
+class ManifestSink {
+ public:
+  virtual ~ManifestSink() {}
+
+  /// Publishes a new version of a manifest.
+  /// @param name is the name of the manifest, i.e. the path it would be
+  ///        written to.
+  /// @param content is the serialized manifest.
+  /// @param version is the version of @a content. It starts from 1 and
+  ///        increases with each version published for @a name, so that it can
+  ///        be used, e.g., to derive an HTTP ETag.
+  /// @return true on success, false otherwise.
+  virtual bool Publish(const std::string& name,
+                       const std::string& content,
+                       uint64_t version) = 0;
+
+ protected:
+  ManifestSink() {}
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ManifestSink);
+};
+
+class IncrementalGzipCompressor;
+
+/// Writes the manifests to files named after them, replacing local files
+/// atomically. With SetGzipManifests(true), each manifest is also written
+/// gzip-compressed to <name>.gz, so that an origin can serve it compressed
+/// without compressing it again for every request.
+class FileManifestSink : public ManifestSink {
+ public:
+  FileManifestSink();
+  ~FileManifestSink() override;
+
+  /// @name ManifestSink implementation overrides.
+  /// @{
+  bool Publish(const std::string& name,
+               const std::string& content,
+               uint64_t version) override;
+  /// @}
+
+  /// Sets whether the manifests are also written gzip-compressed. Applies to
+  /// all the file sinks of the process. Off by default.
+  static void SetGzipManifests(bool gzip_manifests);
+
+ private:
+  bool WriteGzipManifest(const std::string& name, const std::string& content);
+
+  base::Lock lock_;
+  // The compressor of each manifest, which keeps the state of the previous
+  // version of it. Owned.
+  std::map<std::string, IncrementalGzipCompressor*> compressors_;
+
+  DISALLOW_COPY_AND_ASSIGN(FileManifestSink);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_FILE_MANIFEST_SINK_H_
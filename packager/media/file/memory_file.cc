@@ -116,14 +116,14 @@ bool MemoryFile::Open() {
       return false;
   } else if (mode_ == "w") {
     file_system->Delete(file_name());
-  } else {
+  } else if (mode_ != "a") {
     NOTIMPLEMENTED() << "File mode " << mode_ << " not supported by MemoryFile";
     return false;
   }
 
   file_ = file_system->GetFile(file_name());
   DCHECK(file_);
-  position_ = 0;
+  position_ = mode_ == "a" ? file_->size() : 0;
   return true;
 }
 
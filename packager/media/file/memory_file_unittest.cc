@@ -111,5 +111,16 @@ TEST_F(MemoryFileTest, WriteExistingFileDeletes) {
   EXPECT_EQ(0, file2->Size());
 }
 
+TEST_F(MemoryFileTest, AppendToExistingFile) {
+  scoped_ptr<File, FileCloser> file1(File::Open("memory://file1", "w"));
+  ASSERT_TRUE(file1);
+  ASSERT_EQ(kWriteBufferSize, file1->Write(kWriteBuffer, kWriteBufferSize));
+
+  scoped_ptr<File, FileCloser> file2(File::Open("memory://file1", "a"));
+  ASSERT_TRUE(file2);
+  ASSERT_EQ(kWriteBufferSize, file2->Write(kWriteBuffer, kWriteBufferSize));
+  EXPECT_EQ(2 * kWriteBufferSize, file2->Size());
+}
+
 }  // namespace media
 }  // namespace edash_packager
@@ -0,0 +1,382 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/file/object_store_file.h"
+
+#include <gflags/gflags.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "packager/base/bind.h"
+#include "packager/base/bind_helpers.h"
+#include "packager/base/logging.h"
+#include "packager/base/strings/string_number_conversions.h"
+#include "packager/base/strings/stringprintf.h"
+#include "packager/media/base/closure_thread.h"
+#include "packager/media/file/http_transport.h"
+
+DEFINE_string(object_store_authorization,
+              "",
+              "Value of the Authorization header of the requests to the "
+              "object store of s3:// output files, e.g. 'Bearer <token>' for "
+              "Google Cloud Storage. Requests are not signed with AWS "
+              "Signature Version 4; use a signing proxy as endpoint if the "
+              "store requires it.");
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+const char kUserAgentString[] = "edash-packager-object_store_file/1.0";
+const char kETagHeader[] = "etag";
+// The minimum size of the parts but the last of an S3 multipart upload.
+const uint64_t kMinPartSize = 5 << 20;
+// Number of attempts of a request before the upload fails.
+const int kMaxAttempts = 3;
+
+// Percent-encodes |value| for the query of a URL. Only the unreserved
+// characters of RFC 3986 are kept.
+std::string EscapeQueryValue(const std::string& value) {
+  std::string escaped;
+  for (const char c : value) {
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+        (c >= '0' && c <= '9') || c == '-' || c == '.' || c == '_' ||
+        c == '~') {
+      escaped += c;
+    } else {
+      escaped += base::StringPrintf("%%%02X", static_cast<uint8_t>(c));
+    }
+  }
+  return escaped;
+}
+
+// Returns the text of the first |element| of |xml|, empty if none.
+std::string GetXmlElement(const std::string& xml, const std::string& element) {
+  const std::string start_tag = "<" + element + ">";
+  const size_t start_pos = xml.find(start_tag);
+  if (start_pos == std::string::npos)
+    return std::string();
+  const size_t text_pos = start_pos + start_tag.size();
+  const size_t end_pos = xml.find("</" + element + ">", text_pos);
+  if (end_pos == std::string::npos)
+    return std::string();
+  return xml.substr(text_pos, end_pos - text_pos);
+}
+
+}  // namespace
+
+ObjectStoreFile::ObjectStoreFile(const char* url,
+                                 const char* mode,
+                                 uint64_t part_size,
+                                 size_t num_parallel_uploads)
+    : File(url),
+      mode_(mode),
+      part_size_(part_size),
+      num_parallel_uploads_(std::max<size_t>(num_parallel_uploads, 1)),
+      size_(0),
+      position_(0),
+      condition_(&lock_),
+      num_uploads_in_progress_(0),
+      closed_(false),
+      failed_(false) {}
+
+ObjectStoreFile::~ObjectStoreFile() {}
+
+bool ObjectStoreFile::Open() {
+  if (mode_ != "w") {
+    NOTIMPLEMENTED() << "ObjectStoreFile only supports write mode.";
+    return false;
+  }
+  if (part_size_ < kMinPartSize) {
+    LOG(ERROR) << "The parts of a multipart upload must be at least "
+               << kMinPartSize << " bytes.";
+    return false;
+  }
+  connection_ = HttpTransport::Get()->CreateConnection();
+  return connection_.get() != NULL;
+}
+
+bool ObjectStoreFile::Close() {
+  bool result = true;
+  if (upload_id_.empty() && parts_.size() <= 1) {
+    // The file fits in one part.
+    const std::string data =
+        parts_.empty() ? std::string() : parts_.begin()->second;
+    result = SendRequest(connection_.get(), "PUT", file_name(), data, NULL,
+                         NULL);
+  } else {
+    result = QueueParts(true);
+    {
+      base::AutoLock lock(lock_);
+      closed_ = true;
+      condition_.Broadcast();
+    }
+    for (ClosureThread* thread : upload_threads_)
+      thread->Join();
+    // The upload threads are done with |failed_|.
+    if (!upload_id_.empty())
+      result = FinishUpload(result && !failed_) && result;
+  }
+  delete this;
+  return result;
+}
+
+int64_t ObjectStoreFile::Read(void* buffer, uint64_t length) {
+  NOTIMPLEMENTED() << "ObjectStoreFile does not support Read().";
+  return -1;
+}
+
+int64_t ObjectStoreFile::Write(const void* buffer, uint64_t length) {
+  const uint8_t* data = static_cast<const uint8_t*>(buffer);
+  uint64_t bytes_left = length;
+  while (bytes_left > 0) {
+    const uint64_t index = position_ / part_size_;
+    const uint64_t offset = position_ % part_size_;
+    std::map<uint64_t, std::string>::iterator it = parts_.find(index);
+    if (it == parts_.end()) {
+      // Seek() only allows a new part at the end of the file.
+      DCHECK_EQ(size_, position_);
+      DCHECK_EQ(0u, offset);
+      it = parts_.insert(std::make_pair(index, std::string())).first;
+      it->second.reserve(part_size_);
+    }
+    std::string& part = it->second;
+    DCHECK_LE(offset, part.size());
+    const uint64_t bytes_to_write =
+        std::min(bytes_left, part_size_ - offset);
+    if (offset + bytes_to_write > part.size())
+      part.resize(offset + bytes_to_write);
+    memcpy(&part[offset], data, bytes_to_write);
+    data += bytes_to_write;
+    bytes_left -= bytes_to_write;
+    position_ += bytes_to_write;
+    size_ = std::max(size_, position_);
+  }
+  if (!QueueParts(false))
+    return -1;
+  return length;
+}
+
+int64_t ObjectStoreFile::Size() {
+  return size_;
+}
+
+bool ObjectStoreFile::Flush() {
+  base::AutoLock lock(lock_);
+  while (!failed_ && (!queue_.empty() || num_uploads_in_progress_ > 0))
+    condition_.Wait();
+  return !failed_;
+}
+
+bool ObjectStoreFile::Seek(uint64_t position) {
+  if (position > size_)
+    return false;
+  if (position != size_ &&
+      parts_.find(position / part_size_) == parts_.end()) {
+    LOG(ERROR) << "Cannot seek to " << position << " in " << file_name()
+               << ", which is uploaded already.";
+    return false;
+  }
+  position_ = position;
+  return true;
+}
+
+bool ObjectStoreFile::Tell(uint64_t* position) {
+  *position = position_;
+  return true;
+}
+
+bool ObjectStoreFile::QueueParts(bool all) {
+  // The first part, which holds the header, and the last two parts written
+  // are kept for the writer to patch.
+  const uint64_t last_index = size_ / part_size_;
+  std::map<uint64_t, std::string>::iterator it = parts_.begin();
+  if (!all && it != parts_.end() && it->first == 0)
+    ++it;
+  if (it == parts_.end() || (!all && it->first + 2 > last_index))
+    return true;
+
+  if (upload_id_.empty()) {
+    std::string response;
+    if (!SendRequest(connection_.get(), "POST", GetUploadUrl("uploads"),
+                     std::string(), &response, NULL)) {
+      return false;
+    }
+    const std::string upload_id = GetXmlElement(response, "UploadId");
+    if (upload_id.empty()) {
+      LOG(ERROR) << "No UploadId in the response to the multipart upload of "
+                 << file_name() << ": " << response;
+      return false;
+    }
+    // The ID is only used in the query of the URLs.
+    upload_id_ = EscapeQueryValue(upload_id);
+    for (size_t i = 0; i < num_parallel_uploads_; ++i) {
+      scoped_ptr<HttpConnection> connection =
+          HttpTransport::Get()->CreateConnection();
+      if (!connection) {
+        base::AutoLock lock(lock_);
+        failed_ = true;
+        return false;
+      }
+      upload_connections_.push_back(connection.release());
+      upload_threads_.push_back(new ClosureThread(
+          "ObjectStoreFile",
+          base::Bind(&ObjectStoreFile::UploadParts, base::Unretained(this),
+                     upload_connections_.back())));
+      upload_threads_.back()->Start();
+    }
+  }
+
+  base::AutoLock lock(lock_);
+  while (it != parts_.end() && (all || it->first + 2 <= last_index)) {
+    while (!failed_ && queue_.size() >= num_parallel_uploads_)
+      condition_.Wait();
+    if (failed_)
+      return false;
+    queue_.push_back(Part());
+    queue_.back().number = static_cast<int>(it->first + 1);
+    queue_.back().data.swap(it->second);
+    parts_.erase(it++);
+    condition_.Broadcast();
+  }
+  return true;
+}
+
+void ObjectStoreFile::UploadParts(HttpConnection* connection) {
+  base::AutoLock lock(lock_);
+  while (true) {
+    while (queue_.empty() && !closed_)
+      condition_.Wait();
+    if (queue_.empty())
+      break;
+    if (failed_) {
+      // The upload is aborted.
+      queue_.clear();
+      condition_.Broadcast();
+      continue;
+    }
+
+    Part part;
+    part.number = queue_.front().number;
+    part.data.swap(queue_.front().data);
+    queue_.pop_front();
+    ++num_uploads_in_progress_;
+    condition_.Broadcast();
+
+    std::string etag;
+    bool result;
+    {
+      base::AutoUnlock unlock(lock_);
+      result = SendRequest(
+          connection, "PUT",
+          GetUploadUrl(base::StringPrintf("partNumber=%d&uploadId=",
+                                          part.number) +
+                       upload_id_),
+          part.data, NULL, &etag);
+      if (result && etag.empty()) {
+        LOG(ERROR) << "No ETag in the response to the upload of part "
+                   << part.number << " of " << file_name() << ".";
+        result = false;
+      }
+    }
+
+    --num_uploads_in_progress_;
+    if (result)
+      etags_[part.number] = etag;
+    else
+      failed_ = true;
+    condition_.Broadcast();
+  }
+}
+
+bool ObjectStoreFile::SendRequest(HttpConnection* connection,
+                                  const char* method,
+                                  const std::string& url,
+                                  const std::string& body,
+                                  std::string* response,
+                                  std::string* etag) {
+  HttpRequest request;
+  request.method = method;
+  request.url = url;
+  request.user_agent = kUserAgentString;
+  if (!FLAGS_object_store_authorization.empty()) {
+    request.headers.push_back("Authorization: " +
+                              FLAGS_object_store_authorization);
+  }
+  request.body = body;
+
+  for (int attempt = 1; attempt <= kMaxAttempts; ++attempt) {
+    HttpResponse http_response;
+    const bool sent = connection->Send(request, &http_response);
+    if (sent && http_response.status_code >= 200 &&
+        http_response.status_code < 300) {
+      if (response)
+        response->swap(http_response.body);
+      if (etag)
+        *etag = http_response.headers[kETagHeader];
+      return true;
+    }
+    const std::string error_message =
+        sent ? base::StringPrintf("Response code: %d.",
+                                  http_response.status_code)
+             : http_response.error;
+    LOG(ERROR) << method << " " << url << " failed (attempt " << attempt
+               << "/" << kMaxAttempts << "). " << error_message;
+  }
+  return false;
+}
+
+std::string ObjectStoreFile::GetUploadUrl(const std::string& query) const {
+  return file_name() +
+         (file_name().find('?') == std::string::npos ? "?" : "&") + query;
+}
+
+bool ObjectStoreFile::FinishUpload(bool succeeded) {
+  DCHECK(!upload_id_.empty());
+  const std::string upload_url = GetUploadUrl("uploadId=" + upload_id_);
+  const int num_parts = static_cast<int>((size_ + part_size_ - 1) / part_size_);
+  if (succeeded && etags_.size() != static_cast<size_t>(num_parts)) {
+    LOG(ERROR) << "Uploaded " << etags_.size() << " of " << num_parts
+               << " parts of " << file_name() << ".";
+    succeeded = false;
+  }
+  if (!succeeded) {
+    if (!SendRequest(connection_.get(), "DELETE", upload_url, std::string(),
+                     NULL, NULL)) {
+      LOG(WARNING) << "Failed to abort the multipart upload of "
+                   << file_name() << ".";
+    }
+    return false;
+  }
+
+  std::string request = "<CompleteMultipartUpload>";
+  for (std::map<int, std::string>::const_iterator it = etags_.begin();
+       it != etags_.end(); ++it) {
+    request += base::StringPrintf("<Part><PartNumber>%d</PartNumber>",
+                                  it->first);
+    request += "<ETag>" + it->second + "</ETag></Part>";
+  }
+  request += "</CompleteMultipartUpload>";
+
+  std::string response;
+  if (!SendRequest(connection_.get(), "POST", upload_url, request, &response,
+                   NULL)) {
+    return false;
+  }
+  // The request can fail after the response status is sent.
+  if (response.find("<Error>") != std::string::npos) {
+    LOG(ERROR) << "Failed to complete the multipart upload of " << file_name()
+               << ": " << response;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,127 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_FILE_OBJECT_STORE_FILE_H_
+#define MEDIA_FILE_OBJECT_STORE_FILE_H_
+
+#include <stdint.h>
+
+#include <deque>
+#include <map>
+#include <string>
+
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/memory/scoped_vector.h"
+#include "packager/base/synchronization/condition_variable.h"
+#include "packager/base/synchronization/lock.h"
+#include "packager/media/file/file.h"
+
+namespace edash_packager {
+namespace media {
+
+class ClosureThread;
+class HttpConnection;
+
+/// Implements a write only File which uploads its content to an S3
+/// compatible object store, e.g. Amazon S3, Google Cloud Storage or MinIO,
+/// with a multipart upload. The content is split in parts of the same size,
+/// which are uploaded in parallel while the next parts are written. The
+/// object is created when the file is closed. A file which fits in one part
+/// is uploaded with a single PUT instead.
+///
+/// The writer can seek back to patch the data already written, e.g. the
+/// header reserved by SingleSegmentSegmenter or the element sizes patched by
+/// MkvWriter, within the first part, which is uploaded when the file is
+/// closed, and within the last two parts written.
+class ObjectStoreFile : public File {
+ public:
+  /// @param url is the URL of the object.
+  /// @param mode is the file mode. Only "w" is supported.
+  /// @param part_size is the size of the parts.
+  /// @param num_parallel_uploads is the maximum number of parts uploaded in
+  ///        parallel.
+  ObjectStoreFile(const char* url,
+                  const char* mode,
+                  uint64_t part_size,
+                  size_t num_parallel_uploads);
+
+  /// @name File implementation overrides.
+  /// @{
+  /// Uploads the parts left and creates the object.
+  /// @return true if the object is created.
+  bool Close() override;
+  int64_t Read(void* buffer, uint64_t length) override;
+  /// Blocks if too many parts wait for upload already.
+  int64_t Write(const void* buffer, uint64_t length) override;
+  int64_t Size() override;
+  /// Waits until the parts queued have been uploaded.
+  bool Flush() override;
+  /// Fails if @a position is in a part which is uploaded already.
+  bool Seek(uint64_t position) override;
+  bool Tell(uint64_t* position) override;
+  /// @}
+
+ protected:
+  ~ObjectStoreFile() override;
+
+  bool Open() override;
+
+ private:
+  struct Part {
+    int number;
+    std::string data;
+  };
+
+  // Queues the parts which the writer is not expected to patch anymore, all
+  // the parts if |all|. Starts the multipart upload first if needed.
+  bool QueueParts(bool all);
+  // Uploads the queued parts on |connection| until the file is closed. Runs
+  // on |upload_threads_|, one per connection.
+  void UploadParts(HttpConnection* connection);
+  // Sends a request with |body| to |url| on |connection|. Sets |response|
+  // and |etag|, if not NULL, to the body and the ETag header of the response.
+  bool SendRequest(HttpConnection* connection,
+                   const char* method,
+                   const std::string& url,
+                   const std::string& body,
+                   std::string* response,
+                   std::string* etag);
+  // Returns the URL of the multipart upload with |query| appended.
+  std::string GetUploadUrl(const std::string& query) const;
+  // Completes or, if |succeeded| is false, aborts the multipart upload.
+  bool FinishUpload(bool succeeded);
+
+  const std::string mode_;
+  const uint64_t part_size_;
+  const size_t num_parallel_uploads_;
+  uint64_t size_;
+  uint64_t position_;
+  // The parts which can still be written, by index, i.e. part number - 1.
+  std::map<uint64_t, std::string> parts_;
+  // The connection of the requests made by the writer.
+  scoped_ptr<HttpConnection> connection_;
+  // The ID of the multipart upload, empty until the first part is queued.
+  std::string upload_id_;
+
+  base::Lock lock_;  // Lock protecting the variables below.
+  base::ConditionVariable condition_;
+  std::deque<Part> queue_;
+  size_t num_uploads_in_progress_;
+  // The ETags of the parts uploaded, by part number.
+  std::map<int, std::string> etags_;
+  bool closed_;
+  bool failed_;
+
+  ScopedVector<HttpConnection> upload_connections_;
+  ScopedVector<ClosureThread> upload_threads_;
+
+  DISALLOW_COPY_AND_ASSIGN(ObjectStoreFile);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_FILE_OBJECT_STORE_FILE_H_
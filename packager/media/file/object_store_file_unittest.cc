@@ -0,0 +1,200 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "packager/base/bind.h"
+#include "packager/base/strings/stringprintf.h"
+#include "packager/media/file/fake_http_transport.h"
+#include "packager/media/file/file.h"
+
+DECLARE_string(object_store_endpoint);
+DECLARE_uint64(object_store_part_size);
+DECLARE_int32(object_store_parallel_uploads);
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+const char kFileName[] = "s3://bucket/key";
+const char kObjectUrl[] = "http://store.example.com/bucket/key";
+const uint64_t kPartSize = 5 << 20;
+// Escaped in the URLs of the upload.
+const char kUploadId[] = "id+1/x";
+const char kUploadUrl[] =
+    "http://store.example.com/bucket/key?uploadId=id%2B1%2Fx";
+const char kPartQuery[] = "?partNumber=";
+// Written in chunks which are not aligned on the parts.
+const uint64_t kChunkSize = (1 << 20) + 3;
+}  // namespace
+
+class ObjectStoreFileTest : public testing::Test {
+ public:
+  ObjectStoreFileTest()
+      : transport_(base::Bind(&ObjectStoreFileTest::HandleRequest,
+                              base::Unretained(this))),
+        failed_part_number_(0) {}
+
+  void SetUp() override {
+    FLAGS_object_store_endpoint = "http://store.example.com";
+    FLAGS_object_store_part_size = kPartSize;
+    FLAGS_object_store_parallel_uploads = 2;
+  }
+
+ protected:
+  // Answers the requests as an S3 compatible object store.
+  bool HandleRequest(const HttpRequest& request, HttpResponse* response) {
+    const std::string& url = request.url;
+    const size_t part_query_pos = url.find(kPartQuery);
+    if (request.method == "PUT" && part_query_pos != std::string::npos) {
+      int part_number = 0;
+      EXPECT_EQ(1, sscanf(url.c_str() + part_query_pos, "?partNumber=%d",
+                          &part_number));
+      EXPECT_NE(std::string::npos,
+                url.find("&uploadId=id%2B1%2Fx", part_query_pos));
+      if (part_number == failed_part_number_) {
+        response->status_code = 500;
+        return true;
+      }
+      parts_[part_number] = request.body;
+      response->status_code = 200;
+      response->headers["etag"] =
+          base::StringPrintf("\"etag-%d\"", part_number);
+      return true;
+    }
+    if (request.method == "PUT" && url == kObjectUrl) {
+      object_ = request.body;
+      response->status_code = 200;
+      return true;
+    }
+    if (request.method == "POST" &&
+        url == std::string(kObjectUrl) + "?uploads") {
+      response->status_code = 200;
+      response->body = base::StringPrintf(
+          "<InitiateMultipartUploadResult><Bucket>bucket</Bucket>"
+          "<Key>key</Key><UploadId>%s</UploadId>"
+          "</InitiateMultipartUploadResult>",
+          kUploadId);
+      return true;
+    }
+    if (request.method == "POST" && url == kUploadUrl) {
+      response->status_code = 200;
+      response->body =
+          "<CompleteMultipartUploadResult></CompleteMultipartUploadResult>";
+      return true;
+    }
+    if (request.method == "DELETE" && url == kUploadUrl) {
+      response->status_code = 204;
+      return true;
+    }
+    ADD_FAILURE() << "Unexpected request: " << request.method << " " << url;
+    response->status_code = 400;
+    return true;
+  }
+
+  // Writes |size| bytes to a new file and closes it.
+  // @return the result of Close().
+  bool WriteFile(uint64_t size) {
+    content_.clear();
+    for (uint64_t i = 0; i < size; ++i)
+      content_.push_back(static_cast<char>(i * 31 % 251));
+    File* file = File::OpenWithNoBuffering(kFileName, "w");
+    EXPECT_TRUE(file);
+    if (!file)
+      return false;
+    for (uint64_t position = 0; position < size; position += kChunkSize) {
+      const uint64_t length = std::min(kChunkSize, size - position);
+      EXPECT_EQ(static_cast<int64_t>(length),
+                file->Write(content_.data() + position, length));
+    }
+    return file->Close();
+  }
+
+  // Returns the number of requests with |method| to |url|.
+  size_t CountRequests(const std::string& method,
+                       const std::string& url) const {
+    const std::vector<HttpRequest> requests = transport_.requests();
+    size_t count = 0;
+    for (const HttpRequest& request : requests) {
+      if (request.method == method && request.url == url)
+        ++count;
+    }
+    return count;
+  }
+
+  FakeHttpTransport transport_;
+  std::string content_;
+  // Set to answer the uploads of this part with an error.
+  int failed_part_number_;
+  // The object uploaded with a single PUT.
+  std::string object_;
+  // The parts uploaded, by part number.
+  std::map<int, std::string> parts_;
+};
+
+TEST_F(ObjectStoreFileTest, SinglePartIsPut) {
+  ASSERT_TRUE(WriteFile(kPartSize));
+  EXPECT_EQ(content_, object_);
+  EXPECT_TRUE(parts_.empty());
+  EXPECT_EQ(1u, transport_.requests().size());
+}
+
+TEST_F(ObjectStoreFileTest, PartsSplitAtPartSize) {
+  ASSERT_TRUE(WriteFile(2 * kPartSize));
+  EXPECT_TRUE(object_.empty());
+  ASSERT_EQ(2u, parts_.size());
+  EXPECT_EQ(content_.substr(0, kPartSize), parts_[1]);
+  EXPECT_EQ(content_.substr(kPartSize), parts_[2]);
+
+  // One more byte is a part of its own.
+  parts_.clear();
+  ASSERT_TRUE(WriteFile(2 * kPartSize + 1));
+  ASSERT_EQ(3u, parts_.size());
+  EXPECT_EQ(content_.substr(0, kPartSize), parts_[1]);
+  EXPECT_EQ(content_.substr(kPartSize, kPartSize), parts_[2]);
+  EXPECT_EQ(content_.substr(2 * kPartSize), parts_[3]);
+}
+
+TEST_F(ObjectStoreFileTest, CompleteUploadRequest) {
+  ASSERT_TRUE(WriteFile(2 * kPartSize + 1));
+  EXPECT_EQ(1u, CountRequests("POST", std::string(kObjectUrl) + "?uploads"));
+  EXPECT_EQ(0u, CountRequests("DELETE", kUploadUrl));
+
+  const std::vector<HttpRequest> requests = transport_.requests();
+  ASSERT_FALSE(requests.empty());
+  const HttpRequest& complete_request = requests.back();
+  EXPECT_EQ("POST", complete_request.method);
+  EXPECT_EQ(kUploadUrl, complete_request.url);
+  EXPECT_EQ(
+      "<CompleteMultipartUpload>"
+      "<Part><PartNumber>1</PartNumber><ETag>\"etag-1\"</ETag></Part>"
+      "<Part><PartNumber>2</PartNumber><ETag>\"etag-2\"</ETag></Part>"
+      "<Part><PartNumber>3</PartNumber><ETag>\"etag-3\"</ETag></Part>"
+      "</CompleteMultipartUpload>",
+      complete_request.body);
+}
+
+TEST_F(ObjectStoreFileTest, FailedPartAbortsUpload) {
+  failed_part_number_ = 2;
+  EXPECT_FALSE(WriteFile(2 * kPartSize + 1));
+  EXPECT_EQ(0u, parts_.count(2));
+  // The upload of the part is retried before the upload is aborted.
+  EXPECT_EQ(3u, CountRequests(
+                    "PUT", std::string(kObjectUrl) +
+                               "?partNumber=2&uploadId=id%2B1%2Fx"));
+  EXPECT_EQ(1u, CountRequests("DELETE", kUploadUrl));
+  EXPECT_EQ(0u, CountRequests("POST", kUploadUrl));
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,95 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/file/output_deduplicator.h"
+
+#include "packager/base/lazy_instance.h"
+#include "packager/base/logging.h"
+#include "packager/media/file/file.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+// Maximum number of files remembered. Past it, the oldest files are
+// forgotten, and no longer linked to.
+const size_t kMaxFiles = 100000;
+
+base::LazyInstance<OutputDeduplicator>::Leaky g_output_deduplicator =
+    LAZY_INSTANCE_INITIALIZER;
+
+}  // namespace
+
+OutputDeduplicator::OutputDeduplicator() {}
+OutputDeduplicator::~OutputDeduplicator() {}
+
+OutputDeduplicator* OutputDeduplicator::GetInstance() {
+  return g_output_deduplicator.Pointer();
+}
+
+bool OutputDeduplicator::LinkToDuplicate(const std::string& digest,
+                                         const std::string& file_name) {
+  base::AutoLock auto_lock(lock_);
+  std::map<std::string, std::string>::iterator it = files_.find(digest);
+  if (it != files_.end()) {
+    // Written again with the same contents.
+    if (it->second == file_name)
+      return true;
+    if (File::Link(it->second.c_str(), file_name.c_str())) {
+      VLOG(1) << "Linked " << file_name << " to " << it->second;
+      RememberFile(file_name, digest);
+      return true;
+    }
+    // The file is gone, e.g. removed from the live window, or cannot be
+    // linked to.
+    ForgetFile(it->second);
+  }
+  // Writing in place to a file linked to others would change them too.
+  if (digests_.find(file_name) != digests_.end()) {
+    ForgetFile(file_name);
+    if (!File::Delete(file_name.c_str()))
+      LOG(WARNING) << "Cannot delete " << file_name << " before rewriting it.";
+  }
+  return false;
+}
+
+void OutputDeduplicator::AddFile(const std::string& digest,
+                                 const std::string& file_name) {
+  base::AutoLock auto_lock(lock_);
+  files_[digest] = file_name;
+  RememberFile(file_name, digest);
+}
+
+void OutputDeduplicator::RememberFile(const std::string& file_name,
+                                      const std::string& digest) {
+  lock_.AssertAcquired();
+  if (digests_.find(file_name) == digests_.end())
+    file_order_.push_back(file_name);
+  digests_[file_name] = digest;
+  while (digests_.size() > kMaxFiles) {
+    const std::string oldest_file_name = file_order_.front();
+    file_order_.pop_front();
+    ForgetFile(oldest_file_name);
+  }
+}
+
+void OutputDeduplicator::ForgetFile(const std::string& file_name) {
+  lock_.AssertAcquired();
+  std::map<std::string, std::string>::iterator it = digests_.find(file_name);
+  if (it == digests_.end())
+    return;
+  std::map<std::string, std::string>::iterator file_it =
+      files_.find(it->second);
+  if (file_it != files_.end() && file_it->second == file_name)
+    files_.erase(file_it);
+  digests_.erase(it);
+  // |file_order_| is left as is: the files forgotten are skipped when they
+  // reach its front.
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,67 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_FILE_OUTPUT_DEDUPLICATOR_H_
+#define MEDIA_FILE_OUTPUT_DEDUPLICATOR_H_
+
+#include <deque>
+#include <map>
+#include <string>
+
+#include "packager/base/macros.h"
+#include "packager/base/synchronization/lock.h"
+
+namespace edash_packager {
+namespace media {
+
+/// Stores the output files with identical contents once, e.g. the init
+/// segments or the clear lead segments shared by the outputs of several
+/// encryption configurations: the first file is written, and the next ones
+/// are hard links to it. The files are identified by the digest of their
+/// contents, computed before they are written. Only local files can be
+/// linked; the other files are always written. Thread safe.
+class OutputDeduplicator {
+ public:
+  OutputDeduplicator();
+  ~OutputDeduplicator();
+
+  /// @return The deduplicator shared by the outputs of the process.
+  static OutputDeduplicator* GetInstance();
+
+  /// Link @a file_name to the file written before with the same contents, if
+  /// any.
+  /// @param digest is the digest of the contents, e.g. their SHA-256.
+  /// @return true if @a file_name is linked, false if the contents are to be
+  ///         written to @a file_name, and AddFile() called once written.
+  bool LinkToDuplicate(const std::string& digest, const std::string& file_name);
+
+  /// Record @a file_name, just written with contents of digest @a digest, as
+  /// the file which the next files with the same contents are linked to.
+  void AddFile(const std::string& digest, const std::string& file_name);
+
+ private:
+  // Records that |file_name| has contents of digest |digest|. Called with
+  // |lock_| held.
+  void RememberFile(const std::string& file_name, const std::string& digest);
+  // Forgets |file_name|. Called with |lock_| held.
+  void ForgetFile(const std::string& file_name);
+
+  base::Lock lock_;
+  // The files written, by digest of their contents.
+  std::map<std::string, std::string> files_;
+  // The digests of the contents of the files written or linked, by file.
+  std::map<std::string, std::string> digests_;
+  // The files in |digests_|, oldest first, to bound the memory used by long
+  // live sessions.
+  std::deque<std::string> file_order_;
+
+  DISALLOW_COPY_AND_ASSIGN(OutputDeduplicator);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_FILE_OUTPUT_DEDUPLICATOR_H_
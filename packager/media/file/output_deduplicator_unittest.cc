@@ -0,0 +1,95 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "packager/base/files/file_path.h"
+#include "packager/base/files/file_util.h"
+#include "packager/media/file/output_deduplicator.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+const char kContents[] = "contents";
+const char kOtherContents[] = "other contents";
+// The digests only need to tell the contents apart.
+const char kDigest[] = "digest";
+const char kOtherDigest[] = "other digest";
+}  // namespace
+
+class OutputDeduplicatorTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    ASSERT_TRUE(base::CreateNewTempDirectory("dedup_", &temp_dir_));
+  }
+
+  void TearDown() override { base::DeleteFile(temp_dir_, true); }
+
+ protected:
+  std::string FileName(const char* name) {
+    return temp_dir_.AppendASCII(name).value();
+  }
+
+  // Writes |contents| to |file_name| unless it is linked to a duplicate.
+  void Write(const std::string& file_name,
+             const std::string& contents,
+             const std::string& digest) {
+    if (deduplicator_.LinkToDuplicate(digest, file_name))
+      return;
+    ASSERT_EQ(static_cast<int>(contents.size()),
+              base::WriteFile(base::FilePath(file_name), contents.data(),
+                              contents.size()));
+    deduplicator_.AddFile(digest, file_name);
+  }
+
+  std::string Read(const std::string& file_name) {
+    std::string contents;
+    EXPECT_TRUE(base::ReadFileToString(base::FilePath(file_name), &contents));
+    return contents;
+  }
+
+  OutputDeduplicator deduplicator_;
+  base::FilePath temp_dir_;
+};
+
+#if defined(OS_POSIX)
+TEST_F(OutputDeduplicatorTest, LinksDuplicates) {
+  Write(FileName("a"), kContents, kDigest);
+  EXPECT_TRUE(deduplicator_.LinkToDuplicate(kDigest, FileName("b")));
+  EXPECT_EQ(kContents, Read(FileName("b")));
+
+  // Different contents are written.
+  EXPECT_FALSE(deduplicator_.LinkToDuplicate(kOtherDigest, FileName("c")));
+}
+
+TEST_F(OutputDeduplicatorTest, RewriteDoesNotChangeLinkedFiles) {
+  Write(FileName("a"), kContents, kDigest);
+  Write(FileName("b"), kContents, kDigest);
+  // The link is deleted before "b" is written again.
+  Write(FileName("b"), kOtherContents, kOtherDigest);
+  EXPECT_EQ(kContents, Read(FileName("a")));
+  EXPECT_EQ(kOtherContents, Read(FileName("b")));
+}
+
+TEST_F(OutputDeduplicatorTest, WritesAgainOnceDeleted) {
+  Write(FileName("a"), kContents, kDigest);
+  ASSERT_TRUE(base::DeleteFile(base::FilePath(FileName("a")), false));
+  EXPECT_FALSE(deduplicator_.LinkToDuplicate(kDigest, FileName("b")));
+  deduplicator_.AddFile(kDigest, FileName("b"));
+  EXPECT_TRUE(deduplicator_.LinkToDuplicate(kDigest, FileName("c")));
+}
+#endif  // defined(OS_POSIX)
+
+TEST_F(OutputDeduplicatorTest, DoesNotLinkOtherFiles) {
+  deduplicator_.AddFile(kDigest, "memory://a");
+  EXPECT_FALSE(deduplicator_.LinkToDuplicate(kDigest, "memory://b"));
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,82 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/file/record_log.h"
+
+#include <limits>
+
+#include "packager/base/logging.h"
+#include "packager/media/base/buffer_reader.h"
+#include "packager/media/base/buffer_writer.h"
+#include "packager/media/file/file.h"
+
+namespace edash_packager {
+namespace media {
+
+RecordLog::RecordLog(const std::string& file_name)
+    : file_name_(file_name), file_(NULL) {}
+
+RecordLog::~RecordLog() {
+  if (file_)
+    file_->Close();
+}
+
+bool RecordLog::Open(std::vector<std::string>* records) {
+  DCHECK(records);
+  DCHECK(!file_);
+  records->clear();
+
+  std::string contents;
+  if (File::ReadFileToString(file_name_.c_str(), &contents)) {
+    BufferReader reader(reinterpret_cast<const uint8_t*>(contents.data()),
+                        contents.size());
+    size_t valid_size = 0;
+    uint32_t record_size;
+    std::string record;
+    while (reader.Read4(&record_size) &&
+           reader.ReadToString(&record, record_size)) {
+      records->push_back(record);
+      valid_size = reader.pos();
+    }
+    if (valid_size < contents.size()) {
+      LOG(WARNING) << "Dropping the last record of " << file_name_
+                   << ", which is incomplete.";
+      contents.resize(valid_size);
+      // Appending after the incomplete record would corrupt the log.
+      if (!File::WriteFileAtomically(file_name_.c_str(), contents))
+        return false;
+    }
+  }
+
+  // The records are flushed one by one, so there is no point in buffering.
+  file_ = File::OpenWithNoBuffering(file_name_.c_str(), "a");
+  if (!file_) {
+    LOG(ERROR) << "Failed to open " << file_name_ << " for appending.";
+    return false;
+  }
+  return true;
+}
+
+bool RecordLog::Append(const std::string& record) {
+  DCHECK(file_);
+  DCHECK_LE(record.size(), std::numeric_limits<uint32_t>::max());
+  BufferWriter buffer(sizeof(uint32_t) + record.size());
+  buffer.AppendInt(static_cast<uint32_t>(record.size()));
+  buffer.AppendArray(reinterpret_cast<const uint8_t*>(record.data()),
+                     record.size());
+  // The record is written at once, so that a crash leaves at most the last
+  // record incomplete.
+  const int64_t size = static_cast<int64_t>(buffer.Size());
+  if (file_->Write(buffer.Buffer(), buffer.Size()) != size ||
+      !file_->Flush()) {
+    LOG(ERROR) << "Failed to append to " << file_name_;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace media
+}  // namespace edash_packager
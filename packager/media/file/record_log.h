@@ -0,0 +1,51 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_FILE_RECORD_LOG_H_
+#define MEDIA_FILE_RECORD_LOG_H_
+
+#include <string>
+#include <vector>
+
+#include "packager/base/macros.h"
+
+namespace edash_packager {
+namespace media {
+
+class File;
+
+/// An append-only log of records, e.g. of the updates of a live manifest, so
+/// that its state can be restored when the packager restarts. Each record is
+/// written as its size, as a 32-bit big-endian integer, followed by its
+/// contents, and is flushed right away.
+class RecordLog {
+ public:
+  /// @param file_name is the file of the log.
+  explicit RecordLog(const std::string& file_name);
+  /// Closes the log.
+  ~RecordLog();
+
+  /// Read the records of the log, if it exists, and open it for appending. A
+  /// record cut short, e.g. by a crash while it was written, is dropped.
+  /// @param[out] records receives the records, in order.
+  /// @return true on success, false otherwise.
+  bool Open(std::vector<std::string>* records);
+
+  /// Append a record to the log, which should be open.
+  /// @return true on success, false otherwise.
+  bool Append(const std::string& record);
+
+ private:
+  const std::string file_name_;
+  File* file_;
+
+  DISALLOW_COPY_AND_ASSIGN(RecordLog);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_FILE_RECORD_LOG_H_
@@ -0,0 +1,87 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+
+#include "packager/media/file/file.h"
+#include "packager/media/file/memory_file.h"
+#include "packager/media/file/record_log.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+const char kLogFile[] = "memory://log";
+}  // namespace
+
+class RecordLogTest : public ::testing::Test {
+ protected:
+  void TearDown() override { MemoryFile::DeleteAll(); }
+};
+
+TEST_F(RecordLogTest, NoLog) {
+  RecordLog log(kLogFile);
+  std::vector<std::string> records;
+  ASSERT_TRUE(log.Open(&records));
+  EXPECT_TRUE(records.empty());
+}
+
+TEST_F(RecordLogTest, RecordsAreAppended) {
+  {
+    RecordLog log(kLogFile);
+    std::vector<std::string> records;
+    ASSERT_TRUE(log.Open(&records));
+    ASSERT_TRUE(log.Append("first"));
+    ASSERT_TRUE(log.Append(""));
+  }
+  {
+    RecordLog log(kLogFile);
+    std::vector<std::string> records;
+    ASSERT_TRUE(log.Open(&records));
+    ASSERT_EQ(2u, records.size());
+    ASSERT_TRUE(log.Append("third"));
+  }
+
+  RecordLog log(kLogFile);
+  std::vector<std::string> records;
+  ASSERT_TRUE(log.Open(&records));
+  ASSERT_EQ(3u, records.size());
+  EXPECT_EQ("first", records[0]);
+  EXPECT_EQ("", records[1]);
+  EXPECT_EQ("third", records[2]);
+}
+
+TEST_F(RecordLogTest, IncompleteRecordIsDropped) {
+  {
+    RecordLog log(kLogFile);
+    std::vector<std::string> records;
+    ASSERT_TRUE(log.Open(&records));
+    ASSERT_TRUE(log.Append("complete"));
+  }
+  std::string contents;
+  ASSERT_TRUE(File::ReadFileToString(kLogFile, &contents));
+  // A record of 16 bytes, of which only 3 were written.
+  contents.append("\0\0\0\x10inc", 7);
+  ASSERT_TRUE(File::WriteFileAtomically(kLogFile, contents));
+
+  {
+    RecordLog log(kLogFile);
+    std::vector<std::string> records;
+    ASSERT_TRUE(log.Open(&records));
+    ASSERT_EQ(1u, records.size());
+    ASSERT_TRUE(log.Append("appended"));
+  }
+
+  RecordLog log(kLogFile);
+  std::vector<std::string> records;
+  ASSERT_TRUE(log.Open(&records));
+  ASSERT_EQ(2u, records.size());
+  EXPECT_EQ("complete", records[0]);
+  EXPECT_EQ("appended", records[1]);
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,92 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/file/resource_usage_file.h"
+
+#include "packager/base/logging.h"
+
+namespace edash_packager {
+namespace media {
+
+ResourceUsageFile::ResourceUsageFile(scoped_ptr<File, FileCloser> internal_file,
+                                     JobResourceUsage* usage)
+    : File(internal_file->file_name()),
+      internal_file_(internal_file.Pass()),
+      usage_(usage),
+      bytes_read_(0),
+      bytes_written_(0) {
+  DCHECK(usage_);
+}
+
+ResourceUsageFile::~ResourceUsageFile() {}
+
+bool ResourceUsageFile::Open() {
+  return internal_file_->Open();
+}
+
+void ResourceUsageFile::SetExpectedSize(uint64_t size) {
+  internal_file_->SetExpectedSize(size);
+}
+
+bool ResourceUsageFile::Close() {
+  DCHECK(internal_file_);
+  const bool result = internal_file_.release()->Close();
+  usage_->AddFileBytes(file_name(), bytes_read_, bytes_written_);
+  delete this;
+  return result;
+}
+
+int64_t ResourceUsageFile::Read(void* buffer, uint64_t length) {
+  const int64_t bytes_read = internal_file_->Read(buffer, length);
+  if (bytes_read > 0)
+    bytes_read_ += bytes_read;
+  return bytes_read;
+}
+
+int64_t ResourceUsageFile::TryRead(void* buffer, uint64_t length) {
+  const int64_t bytes_read = internal_file_->TryRead(buffer, length);
+  if (bytes_read > 0)
+    bytes_read_ += bytes_read;
+  return bytes_read;
+}
+
+int64_t ResourceUsageFile::Write(const void* buffer, uint64_t length) {
+  const int64_t bytes_written = internal_file_->Write(buffer, length);
+  if (bytes_written > 0)
+    bytes_written_ += bytes_written;
+  return bytes_written;
+}
+
+int64_t ResourceUsageFile::WriteV(const WriteBlock* blocks,
+                                  size_t num_blocks) {
+  const int64_t bytes_written = internal_file_->WriteV(blocks, num_blocks);
+  if (bytes_written > 0)
+    bytes_written_ += bytes_written;
+  return bytes_written;
+}
+
+int64_t ResourceUsageFile::Size() {
+  return internal_file_->Size();
+}
+
+bool ResourceUsageFile::Flush() {
+  return internal_file_->Flush();
+}
+
+bool ResourceUsageFile::Seek(uint64_t position) {
+  return internal_file_->Seek(position);
+}
+
+bool ResourceUsageFile::Tell(uint64_t* position) {
+  return internal_file_->Tell(position);
+}
+
+uint64_t ResourceUsageFile::GetCachedSize() {
+  return internal_file_->GetCachedSize();
+}
+
+}  // namespace media
+}  // namespace edash_packager
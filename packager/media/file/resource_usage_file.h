@@ -0,0 +1,61 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef PACKAGER_FILE_RESOURCE_USAGE_FILE_H_
+#define PACKAGER_FILE_RESOURCE_USAGE_FILE_H_
+
+#include "packager/base/memory/ref_counted.h"
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/media/base/job_resource_usage.h"
+#include "packager/media/file/file.h"
+#include "packager/media/file/file_closer.h"
+
+namespace edash_packager {
+namespace media {
+
+/// Wraps a file to count the bytes read from and written to it, which are
+/// accounted in the JobResourceUsage of the job which opened it when the file
+/// is closed.
+class ResourceUsageFile : public File {
+ public:
+  /// @param internal_file is the file, opened by Open().
+  /// @param usage is the usage the bytes are accounted in.
+  ResourceUsageFile(scoped_ptr<File, FileCloser> internal_file,
+                    JobResourceUsage* usage);
+
+  /// @name File implementation overrides.
+  /// @{
+  bool Close() override;
+  int64_t Read(void* buffer, uint64_t length) override;
+  int64_t TryRead(void* buffer, uint64_t length) override;
+  int64_t Write(const void* buffer, uint64_t length) override;
+  int64_t WriteV(const WriteBlock* blocks, size_t num_blocks) override;
+  int64_t Size() override;
+  bool Flush() override;
+  bool Seek(uint64_t position) override;
+  bool Tell(uint64_t* position) override;
+  uint64_t GetCachedSize() override;
+  /// @}
+
+ protected:
+  ~ResourceUsageFile() override;
+
+  bool Open() override;
+  void SetExpectedSize(uint64_t size) override;
+
+ private:
+  scoped_ptr<File, FileCloser> internal_file_;
+  scoped_refptr<JobResourceUsage> usage_;
+  uint64_t bytes_read_;
+  uint64_t bytes_written_;
+
+  DISALLOW_COPY_AND_ASSIGN(ResourceUsageFile);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // PACKAGER_FILE_RESOURCE_USAGE_FILE_H_
@@ -0,0 +1,255 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/file/rtp_fec_decoder.h"
+
+#include <algorithm>
+
+#include "packager/base/logging.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+const size_t kRtpHeaderSize = 12;
+const uint8_t kRtpVersion = 2;
+// SNBase low bits, Length Recovery, E, PT recovery, Mask, TS recovery, X, D,
+// type, index, Offset, NA and SNBase ext bits.
+const size_t kFecHeaderSize = 16;
+// The FEC packets waiting for their media packets, at most.
+const size_t kMaxFecPackets = 1024;
+// The first extended sequence number, so that the packets received late do
+// not wrap around.
+const uint64_t kFirstSequenceNumberBase = 1ull << 32;
+
+// Parses the RTP header of |data|. Sets |payload_offset| and |payload_size|
+// to the payload, without the header and the padding.
+bool ParseRtpHeader(const uint8_t* data,
+                    size_t size,
+                    uint16_t* sequence_number,
+                    size_t* payload_offset,
+                    size_t* payload_size) {
+  if (size < kRtpHeaderSize || (data[0] >> 6) != kRtpVersion)
+    return false;
+  // Skip the CSRC identifiers and the header extension.
+  size_t header_size = kRtpHeaderSize + 4 * (data[0] & 0x0f);
+  if (data[0] & 0x10) {
+    if (header_size + 4 > size)
+      return false;
+    header_size += 4 + 4 * ((data[header_size + 2] << 8) |
+                            data[header_size + 3]);
+  }
+  const size_t padding_size = (data[0] & 0x20) ? data[size - 1] : 0;
+  if (header_size + padding_size > size)
+    return false;
+  *sequence_number = (data[2] << 8) | data[3];
+  *payload_offset = header_size;
+  *payload_size = size - header_size - padding_size;
+  return true;
+}
+
+}  // namespace
+
+RtpFecDecoder::FecPacket::FecPacket()
+    : sequence_number_base(0),
+      offset(0),
+      num_associated(0),
+      length_recovery(0) {}
+RtpFecDecoder::FecPacket::~FecPacket() {}
+
+RtpFecDecoder::RtpFecDecoder(size_t max_delay_packets)
+    : max_delay_packets_(max_delay_packets),
+      started_(false),
+      next_sequence_number_(0),
+      highest_sequence_number_(0),
+      skip_until_sequence_number_(0),
+      num_packets_(0),
+      num_recovered_(0),
+      num_lost_(0),
+      num_dropped_(0) {}
+
+RtpFecDecoder::~RtpFecDecoder() {}
+
+bool RtpFecDecoder::AddMediaPacket(const uint8_t* data, size_t size) {
+  uint16_t sequence_number;
+  size_t payload_offset;
+  size_t payload_size;
+  if (!ParseRtpHeader(data, size, &sequence_number, &payload_offset,
+                      &payload_size)) {
+    return false;
+  }
+  ++num_packets_;
+  if (!started_) {
+    started_ = true;
+    next_sequence_number_ = kFirstSequenceNumberBase + sequence_number;
+    highest_sequence_number_ = next_sequence_number_;
+  }
+  const uint64_t extended_sequence_number =
+      ExtendSequenceNumber(sequence_number);
+  if (extended_sequence_number < next_sequence_number_ ||
+      payloads_.find(extended_sequence_number) != payloads_.end()) {
+    ++num_dropped_;
+    return true;
+  }
+  AddPayload(extended_sequence_number, data + payload_offset, payload_size);
+  // The packet may leave a single packet missing for a FEC packet.
+  if (!fec_packets_.empty())
+    Recover();
+  return true;
+}
+
+bool RtpFecDecoder::AddFecPacket(const uint8_t* data, size_t size) {
+  uint16_t sequence_number;
+  size_t payload_offset;
+  size_t payload_size;
+  if (!ParseRtpHeader(data, size, &sequence_number, &payload_offset,
+                      &payload_size) ||
+      payload_size < kFecHeaderSize) {
+    return false;
+  }
+  const uint8_t* header = data + payload_offset;
+  FecPacket fec_packet;
+  fec_packet.length_recovery = (header[2] << 8) | header[3];
+  fec_packet.offset = header[13];
+  fec_packet.num_associated = header[14];
+  if (fec_packet.offset == 0 || fec_packet.num_associated == 0)
+    return false;
+  // Nothing to recover yet.
+  if (!started_)
+    return true;
+
+  fec_packet.sequence_number_base =
+      ExtendSequenceNumber((header[0] << 8) | header[1]);
+  fec_packet.payload_recovery.assign(header + kFecHeaderSize,
+                                     header + payload_size);
+  fec_packets_.push_back(fec_packet);
+  if (fec_packets_.size() > kMaxFecPackets)
+    fec_packets_.pop_front();
+  Recover();
+  return true;
+}
+
+bool RtpFecDecoder::PopPayload(std::vector<uint8_t>* payload) {
+  DCHECK(payload);
+  // The packets missing after a packet given up on are given up on too: they
+  // have been waited for as long.
+  bool giving_up = false;
+  while (started_ && next_sequence_number_ <= highest_sequence_number_) {
+    PayloadMap::const_iterator iter = payloads_.find(next_sequence_number_);
+    if (iter != payloads_.end()) {
+      // Copied, as the payload is kept for the FEC packets to come.
+      *payload = iter->second;
+      ++next_sequence_number_;
+      PruneHistory();
+      return true;
+    }
+    if (!giving_up &&
+        highest_sequence_number_ - next_sequence_number_ <
+            max_delay_packets_ &&
+        next_sequence_number_ > skip_until_sequence_number_) {
+      return false;
+    }
+    giving_up = true;
+    ++num_lost_;
+    ++next_sequence_number_;
+  }
+  return false;
+}
+
+void RtpFecDecoder::SkipMissingPackets() {
+  skip_until_sequence_number_ = highest_sequence_number_;
+}
+
+uint64_t RtpFecDecoder::ExtendSequenceNumber(uint16_t sequence_number) const {
+  const int16_t difference = static_cast<int16_t>(
+      sequence_number - static_cast<uint16_t>(highest_sequence_number_));
+  return highest_sequence_number_ + difference;
+}
+
+void RtpFecDecoder::AddPayload(uint64_t sequence_number,
+                               const uint8_t* payload,
+                               size_t size) {
+  payloads_[sequence_number].assign(payload, payload + size);
+  highest_sequence_number_ =
+      std::max(highest_sequence_number_, sequence_number);
+}
+
+void RtpFecDecoder::Recover() {
+  // A recovered packet may leave a single packet missing for another FEC
+  // packet, e.g. a row FEC packet completing a column.
+  bool recovered = true;
+  while (recovered) {
+    recovered = false;
+    std::deque<FecPacket>::iterator iter = fec_packets_.begin();
+    while (iter != fec_packets_.end()) {
+      if (RecoverWith(*iter)) {
+        iter = fec_packets_.erase(iter);
+        recovered = true;
+      } else {
+        ++iter;
+      }
+    }
+  }
+}
+
+bool RtpFecDecoder::RecoverWith(const FecPacket& fec_packet) {
+  uint64_t missing_sequence_number = 0;
+  size_t num_missing = 0;
+  for (size_t i = 0; i < fec_packet.num_associated; ++i) {
+    const uint64_t sequence_number =
+        fec_packet.sequence_number_base + i * fec_packet.offset;
+    if (payloads_.find(sequence_number) != payloads_.end())
+      continue;
+    // Given up or dropped from the history: the FEC packet is of no use.
+    if (sequence_number < next_sequence_number_)
+      return true;
+    missing_sequence_number = sequence_number;
+    if (++num_missing > 1)
+      return false;
+  }
+  if (num_missing == 0)
+    return true;
+
+  std::vector<uint8_t> payload(fec_packet.payload_recovery);
+  size_t length = fec_packet.length_recovery;
+  for (size_t i = 0; i < fec_packet.num_associated; ++i) {
+    const uint64_t sequence_number =
+        fec_packet.sequence_number_base + i * fec_packet.offset;
+    if (sequence_number == missing_sequence_number)
+      continue;
+    const std::vector<uint8_t>& associated_payload =
+        payloads_[sequence_number];
+    if (associated_payload.size() > payload.size())
+      return true;
+    length ^= associated_payload.size();
+    for (size_t j = 0; j < associated_payload.size(); ++j)
+      payload[j] ^= associated_payload[j];
+  }
+  if (length > payload.size()) {
+    LOG(WARNING) << "Invalid FEC packet: recovered length " << length
+                 << " larger than its payload.";
+    return true;
+  }
+  payload.resize(length);
+  ++num_recovered_;
+  AddPayload(missing_sequence_number, payload.empty() ? NULL : &payload[0],
+             payload.size());
+  return true;
+}
+
+void RtpFecDecoder::PruneHistory() {
+  // The FEC packets protect packets released up to max_delay_packets_
+  // earlier.
+  const uint64_t history_size = 2 * max_delay_packets_;
+  while (!payloads_.empty() &&
+         payloads_.begin()->first + history_size < next_sequence_number_) {
+    payloads_.erase(payloads_.begin());
+  }
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,120 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_FILE_RTP_FEC_DECODER_H_
+#define MEDIA_FILE_RTP_FEC_DECODER_H_
+
+#include <stdint.h>
+
+#include <deque>
+#include <map>
+#include <vector>
+
+#include "packager/base/macros.h"
+
+namespace edash_packager {
+namespace media {
+
+/// Depacketizes an RTP stream, e.g. MPEG-2 TS over RTP, and recovers its
+/// lost packets with the SMPTE 2022-1 FEC packets of its column and row
+/// FEC streams, if any. The payloads are released in sequence number order.
+/// A missing packet is waited for until @a max_delay_packets newer packets
+/// have been received, for it to be reordered or recovered.
+/// Only media packets with the 12-byte fixed RTP header, without CSRC nor
+/// header extension, are recovered, which is the case of SMPTE 2022-2
+/// streams.
+/// Thread Safety: Not thread safe.
+class RtpFecDecoder {
+ public:
+  /// @param max_delay_packets is the number of packets a missing packet is
+  ///        waited for. It should cover the FEC matrix, i.e. more than L * D
+  ///        packets with column FEC.
+  explicit RtpFecDecoder(size_t max_delay_packets);
+  ~RtpFecDecoder();
+
+  /// Adds a packet of the media stream.
+  /// @return false if the packet is not a valid RTP packet, true otherwise.
+  bool AddMediaPacket(const uint8_t* data, size_t size);
+
+  /// Adds a packet of a column or row FEC stream.
+  /// @return false if the packet is not a valid FEC packet, true otherwise.
+  bool AddFecPacket(const uint8_t* data, size_t size);
+
+  /// Releases the payload of the next media packet, unless it is still
+  /// waited for.
+  /// @param[out] payload receives the payload.
+  /// @return true if a payload is released, false otherwise.
+  bool PopPayload(std::vector<uint8_t>* payload);
+
+  /// Gives up on the missing packets which are waited for, e.g. when the
+  /// stream stalls.
+  void SkipMissingPackets();
+
+  /// @return The number of media packets received.
+  uint64_t num_packets() const { return num_packets_; }
+  /// @return The number of media packets recovered with FEC.
+  uint64_t num_recovered() const { return num_recovered_; }
+  /// @return The number of media packets neither received nor recovered.
+  uint64_t num_lost() const { return num_lost_; }
+  /// @return The number of media packets dropped because they arrived too
+  ///         late or twice.
+  uint64_t num_dropped() const { return num_dropped_; }
+
+ private:
+  // The packets protected by a FEC packet, and the XOR of their payloads
+  // and payload lengths.
+  struct FecPacket {
+    FecPacket();
+    ~FecPacket();
+
+    uint64_t sequence_number_base;
+    uint8_t offset;
+    uint8_t num_associated;
+    uint16_t length_recovery;
+    std::vector<uint8_t> payload_recovery;
+  };
+  typedef std::map<uint64_t, std::vector<uint8_t> > PayloadMap;
+
+  // Extends the 16-bit |sequence_number| to 64 bits, close to the highest
+  // sequence number received.
+  uint64_t ExtendSequenceNumber(uint16_t sequence_number) const;
+  // Adds |payload| of |sequence_number|, received or recovered.
+  void AddPayload(uint64_t sequence_number,
+                  const uint8_t* payload,
+                  size_t size);
+  // Recovers the packets which are the only one missing of a FEC packet,
+  // until no more can be recovered.
+  void Recover();
+  // Returns true if |fec_packet| recovered a packet or is no longer useful.
+  bool RecoverWith(const FecPacket& fec_packet);
+  // Drops the payloads older than the history kept for recovery.
+  void PruneHistory();
+
+  const size_t max_delay_packets_;
+
+  bool started_;
+  // The next sequence number to release, and the highest one received.
+  uint64_t next_sequence_number_;
+  uint64_t highest_sequence_number_;
+  // The missing packets up to this one are not waited for.
+  uint64_t skip_until_sequence_number_;
+  // The payloads waiting to be released, and the ones released recently,
+  // which later FEC packets may need.
+  PayloadMap payloads_;
+  std::deque<FecPacket> fec_packets_;
+
+  uint64_t num_packets_;
+  uint64_t num_recovered_;
+  uint64_t num_lost_;
+  uint64_t num_dropped_;
+
+  DISALLOW_COPY_AND_ASSIGN(RtpFecDecoder);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_FILE_RTP_FEC_DECODER_H_
@@ -0,0 +1,177 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/file/rtp_fec_decoder.h"
+
+#include <gtest/gtest.h>
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+const size_t kMaxDelayPackets = 8;
+const uint16_t kFirstSequenceNumber = 0xfffe;
+
+std::vector<uint8_t> GetPayload(uint16_t index) {
+  // Payloads of different sizes.
+  std::vector<uint8_t> payload(10 + index % 3);
+  for (size_t i = 0; i < payload.size(); ++i)
+    payload[i] = static_cast<uint8_t>(index * 31 + i);
+  return payload;
+}
+
+std::vector<uint8_t> GetRtpPacket(uint16_t sequence_number,
+                                  const std::vector<uint8_t>& payload) {
+  std::vector<uint8_t> packet(12, 0);
+  packet[0] = 0x80;
+  packet[1] = 33;  // MP2T.
+  packet[2] = sequence_number >> 8;
+  packet[3] = sequence_number & 0xff;
+  packet.insert(packet.end(), payload.begin(), payload.end());
+  return packet;
+}
+
+// A FEC packet protecting the packets of index |first_index| +
+// i * |offset|, i < |num_associated|.
+std::vector<uint8_t> GetFecPacket(uint16_t first_index,
+                                  uint8_t offset,
+                                  uint8_t num_associated) {
+  std::vector<uint8_t> recovery;
+  uint16_t length_recovery = 0;
+  for (uint16_t i = 0; i < num_associated; ++i) {
+    const std::vector<uint8_t> payload = GetPayload(first_index + i * offset);
+    length_recovery ^= payload.size();
+    if (recovery.size() < payload.size())
+      recovery.resize(payload.size());
+    for (size_t j = 0; j < payload.size(); ++j)
+      recovery[j] ^= payload[j];
+  }
+  const uint16_t sequence_number_base = kFirstSequenceNumber + first_index;
+  std::vector<uint8_t> fec(16, 0);
+  fec[0] = sequence_number_base >> 8;
+  fec[1] = sequence_number_base & 0xff;
+  fec[2] = length_recovery >> 8;
+  fec[3] = length_recovery & 0xff;
+  fec[12] = offset == 1 ? 0x40 : 0;  // D: row FEC.
+  fec[13] = offset;
+  fec[14] = num_associated;
+  fec.insert(fec.end(), recovery.begin(), recovery.end());
+  return GetRtpPacket(0, fec);
+}
+
+}  // namespace
+
+class RtpFecDecoderTest : public ::testing::Test {
+ protected:
+  RtpFecDecoderTest() : decoder_(kMaxDelayPackets) {}
+
+  void AddMediaPacket(uint16_t index) {
+    const std::vector<uint8_t> packet =
+        GetRtpPacket(kFirstSequenceNumber + index, GetPayload(index));
+    ASSERT_TRUE(decoder_.AddMediaPacket(&packet[0], packet.size()));
+  }
+
+  void AddFecPacket(uint16_t first_index,
+                    uint8_t offset,
+                    uint8_t num_associated) {
+    const std::vector<uint8_t> packet =
+        GetFecPacket(first_index, offset, num_associated);
+    ASSERT_TRUE(decoder_.AddFecPacket(&packet[0], packet.size()));
+  }
+
+  void ExpectPayload(uint16_t index) {
+    std::vector<uint8_t> payload;
+    ASSERT_TRUE(decoder_.PopPayload(&payload));
+    EXPECT_EQ(GetPayload(index), payload);
+  }
+
+  void ExpectNoPayload() {
+    std::vector<uint8_t> payload;
+    EXPECT_FALSE(decoder_.PopPayload(&payload));
+  }
+
+  RtpFecDecoder decoder_;
+};
+
+TEST_F(RtpFecDecoderTest, ReleasesPayloadsInOrder) {
+  AddMediaPacket(0);
+  AddMediaPacket(2);
+  ExpectPayload(0);
+  // The missing packet is waited for.
+  ExpectNoPayload();
+  AddMediaPacket(1);
+  ExpectPayload(1);
+  ExpectPayload(2);
+  ExpectNoPayload();
+
+  // Too late, and twice.
+  AddMediaPacket(1);
+  AddMediaPacket(3);
+  AddMediaPacket(3);
+  ExpectPayload(3);
+  EXPECT_EQ(2u, decoder_.num_dropped());
+  EXPECT_EQ(0u, decoder_.num_lost());
+}
+
+TEST_F(RtpFecDecoderTest, RejectsInvalidPackets) {
+  const uint8_t kNotRtp[] = {0x47, 0x00, 0x00, 0x10};
+  EXPECT_FALSE(decoder_.AddMediaPacket(kNotRtp, sizeof(kNotRtp)));
+  // Too short for the FEC header.
+  const std::vector<uint8_t> packet = GetRtpPacket(0, GetPayload(0));
+  EXPECT_FALSE(decoder_.AddFecPacket(&packet[0], packet.size()));
+}
+
+TEST_F(RtpFecDecoderTest, RecoversWithRowFec) {
+  AddMediaPacket(0);
+  AddMediaPacket(1);
+  AddMediaPacket(3);
+  AddFecPacket(0, 1, 4);
+  for (uint16_t i = 0; i < 4; ++i)
+    ExpectPayload(i);
+  EXPECT_EQ(1u, decoder_.num_recovered());
+  EXPECT_EQ(0u, decoder_.num_lost());
+}
+
+TEST_F(RtpFecDecoderTest, RecoversWithColumnAndRowFec) {
+  // A 2x2 matrix: columns {0, 2} and {1, 3}, rows {0, 1} and {2, 3}. Only
+  // packet 0 is received.
+  AddMediaPacket(0);
+  ExpectPayload(0);
+  AddFecPacket(1, 2, 2);
+  AddFecPacket(2, 1, 2);
+  ExpectNoPayload();
+  // Recovers 2 with the column, then 3 with the row, then 1 with the other
+  // column.
+  AddFecPacket(0, 2, 2);
+  for (uint16_t i = 1; i < 4; ++i)
+    ExpectPayload(i);
+  EXPECT_EQ(3u, decoder_.num_recovered());
+}
+
+TEST_F(RtpFecDecoderTest, GivesUpAfterMaxDelay) {
+  AddMediaPacket(0);
+  ExpectPayload(0);
+  AddMediaPacket(kMaxDelayPackets);
+  ExpectNoPayload();
+  AddMediaPacket(kMaxDelayPackets + 1);
+  ExpectPayload(kMaxDelayPackets);
+  ExpectPayload(kMaxDelayPackets + 1);
+  EXPECT_EQ(kMaxDelayPackets - 1, decoder_.num_lost());
+}
+
+TEST_F(RtpFecDecoderTest, SkipMissingPackets) {
+  AddMediaPacket(0);
+  AddMediaPacket(2);
+  ExpectPayload(0);
+  ExpectNoPayload();
+  decoder_.SkipMissingPackets();
+  ExpectPayload(2);
+  EXPECT_EQ(1u, decoder_.num_lost());
+}
+
+}  // namespace media
+}  // namespace edash_packager
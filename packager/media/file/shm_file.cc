@@ -0,0 +1,122 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/file/shm_file.h"
+
+#include <string.h>  // for memcpy
+
+#include <algorithm>
+
+#include "packager/base/logging.h"
+
+namespace edash_packager {
+namespace media {
+
+ShmFile::ShmFile(const std::string& file_name,
+                 const std::string& mode,
+                 const std::string& store_name,
+                 uint64_t store_max_size)
+    : File(file_name),
+      mode_(mode),
+      store_name_(store_name),
+      store_max_size_(store_max_size),
+      store_(NULL),
+      data_(NULL),
+      size_(0),
+      object_id_(0),
+      position_(0) {}
+
+ShmFile::~ShmFile() {}
+
+bool ShmFile::Close() {
+  bool result = true;
+  if (store_) {
+    if (mode_ == "w") {
+      result = store_->Put(file_name(), buffer_.data(), buffer_.size());
+      LOG_IF(ERROR, !result) << "Cannot store " << file_name()
+                             << " in shared memory store " << store_name_;
+    } else {
+      store_->Release(object_id_, data_, size_);
+    }
+  }
+  delete this;
+  return result;
+}
+
+int64_t ShmFile::Read(void* buffer, uint64_t length) {
+  DCHECK_EQ("r", mode_);
+  if (position_ >= size_)
+    return 0;
+
+  const uint64_t bytes_to_read = std::min(length, size_ - position_);
+  memcpy(buffer, data_ + position_, bytes_to_read);
+  position_ += bytes_to_read;
+  return bytes_to_read;
+}
+
+int64_t ShmFile::Write(const void* buffer, uint64_t length) {
+  DCHECK_EQ("w", mode_);
+  if (buffer_.size() < position_ + length)
+    buffer_.resize(position_ + length);
+
+  memcpy(&buffer_[position_], buffer, length);
+  position_ += length;
+  return length;
+}
+
+int64_t ShmFile::Size() {
+  return mode_ == "w" ? buffer_.size() : size_;
+}
+
+bool ShmFile::Flush() {
+  // The file is stored when it is closed.
+  return true;
+}
+
+bool ShmFile::Seek(uint64_t position) {
+  if (Size() < static_cast<int64_t>(position))
+    return false;
+
+  position_ = position;
+  return true;
+}
+
+bool ShmFile::Tell(uint64_t* position) {
+  *position = position_;
+  return true;
+}
+
+bool ShmFile::Open() {
+  if (mode_ != "r" && mode_ != "w") {
+    NOTIMPLEMENTED() << "File mode " << mode_ << " not supported by ShmFile";
+    return false;
+  }
+  if (file_name().empty() ||
+      file_name().size() >= ShmFileStore::kMaxFileNameSize) {
+    LOG(ERROR) << "Invalid file name for a shared memory store: '"
+               << file_name() << "'.";
+    return false;
+  }
+  ShmFileStore* store = ShmFileStore::Get(store_name_, store_max_size_);
+  if (!store)
+    return false;
+  if (mode_ == "r" &&
+      !store->Acquire(file_name(), &data_, &size_, &object_id_)) {
+    return false;
+  }
+  store_ = store;
+  position_ = 0;
+  return true;
+}
+
+bool ShmFile::Delete(const std::string& file_name,
+                     const std::string& store_name) {
+  ShmFileStore* store = ShmFileStore::Get(store_name, 0);
+  return store && store->Delete(file_name);
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,155 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_FILE_SHM_FILE_H_
+#define MEDIA_FILE_SHM_FILE_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "packager/media/file/file.h"
+
+namespace edash_packager {
+namespace media {
+
+/// A store of files in named shared memory, which lets the processes of a
+/// host, e.g. the packager and an origin server, share files without any
+/// disk I/O. The index of the store is a shared memory object named after
+/// the store, holding a process-shared mutex and a table of the files. The
+/// data of each file is a shared memory object of its own, named
+/// "<store name>.<object id>", written once. The files which are not open
+/// are evicted, least recently used first, to keep the size of the files
+/// within the budget of the store.
+/// Only supported on Linux.
+class ShmFileStore {
+ public:
+  /// The maximum number of files and the maximum size of their names.
+  static const size_t kMaxFiles = 4096;
+  static const size_t kMaxFileNameSize = 256;
+
+  /// @return true if shared memory stores are supported on this system.
+  static bool IsSupported();
+
+  /// Gets a store, which stays mapped in the process from then on.
+  /// @param store_name is the name of the store, without any '/'.
+  /// @param max_size is the budget, in bytes, of the files of the store. It is
+  ///        only used if the store does not exist yet. Zero only gets an
+  ///        existing store.
+  /// @return The store, or NULL on failure.
+  static ShmFileStore* Get(const std::string& store_name, uint64_t max_size);
+
+  /// Stores a file, replacing the file with the same name, if any. The files
+  /// which are not open are evicted as needed to stay within the budget.
+  /// @return true on success, false if the file cannot be stored, e.g. if it
+  ///         does not fit in the budget.
+  bool Put(const std::string& file_name, const uint8_t* data, uint64_t size);
+
+  /// Opens a file, which cannot be evicted until it is closed with
+  /// Release(). The data of the file is mapped read-only.
+  /// @param[out] data receives the data of the file, NULL if it is empty.
+  /// @param[out] size receives the size of the file.
+  /// @param[out] object_id identifies the data of the file.
+  /// @return true on success, false if the file does not exist.
+  bool Acquire(const std::string& file_name,
+               const uint8_t** data,
+               uint64_t* size,
+               uint64_t* object_id);
+
+  /// Closes a file opened with Acquire().
+  void Release(uint64_t object_id, const uint8_t* data, uint64_t size);
+
+  /// Deletes a file. The processes which have the file open can keep reading
+  /// it until they close it.
+  /// @return true if the file existed.
+  bool Delete(const std::string& file_name);
+
+  /// @return The total size of the files of the store.
+  uint64_t GetBytesUsed();
+
+ private:
+  struct Index;
+
+  // Maps the store, creating it if needed.
+  static ShmFileStore* Create(const std::string& store_name,
+                              uint64_t max_size);
+
+  ShmFileStore(const std::string& store_name, Index* index);
+  ~ShmFileStore();
+
+  // Returns the name of the shared memory object of |object_id|.
+  std::string GetObjectName(uint64_t object_id) const;
+  // Returns the index of the entry of |file_name|, or of a free entry if
+  // |file_name| is empty, or kMaxFiles if there is none. The index should be
+  // locked.
+  size_t FindEntryWithLock(const std::string& file_name) const;
+  // Removes the entry at |entry_index| from the index, with the index locked.
+  void RemoveEntryWithLock(size_t entry_index);
+
+  const std::string store_name_;
+  Index* const index_;
+
+  DISALLOW_COPY_AND_ASSIGN(ShmFileStore);
+};
+
+/// Implements a File stored in a ShmFileStore. Files are written in memory
+/// and stored when they are closed. Files opened for reading are mapped, and
+/// can be read in place through data().
+class ShmFile : public File {
+ public:
+  /// @param file_name is the name of the file in the store.
+  /// @param mode is "r" or "w".
+  /// @param store_name is the name of the store.
+  /// @param store_max_size is the budget of the store, if it is created.
+  ShmFile(const std::string& file_name,
+          const std::string& mode,
+          const std::string& store_name,
+          uint64_t store_max_size);
+
+  /// @name File implementation overrides.
+  /// @{
+  /// Stores the file written, if in write mode.
+  bool Close() override;
+  int64_t Read(void* buffer, uint64_t length) override;
+  int64_t Write(const void* buffer, uint64_t length) override;
+  int64_t Size() override;
+  bool Flush() override;
+  bool Seek(uint64_t position) override;
+  bool Tell(uint64_t* position) override;
+  /// @}
+
+  /// @return The data of a file open for reading.
+  const uint8_t* data() const { return data_; }
+
+  /// Deletes a file from a store.
+  static bool Delete(const std::string& file_name,
+                     const std::string& store_name);
+
+ protected:
+  ~ShmFile() override;
+  bool Open() override;
+
+ private:
+  const std::string mode_;
+  const std::string store_name_;
+  const uint64_t store_max_size_;
+  ShmFileStore* store_;
+  // The data written, in write mode.
+  std::vector<uint8_t> buffer_;
+  // The data mapped, in read mode.
+  const uint8_t* data_;
+  uint64_t size_;
+  uint64_t object_id_;
+  uint64_t position_;
+
+  DISALLOW_COPY_AND_ASSIGN(ShmFile);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_FILE_SHM_FILE_H_
@@ -0,0 +1,393 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/file/shm_file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <map>
+
+#include "packager/base/atomicops.h"
+#include "packager/base/lazy_instance.h"
+#include "packager/base/logging.h"
+#include "packager/base/posix/eintr_wrapper.h"
+#include "packager/base/strings/string_number_conversions.h"
+#include "packager/base/synchronization/lock.h"
+#include "packager/base/threading/platform_thread.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+// Identifies an initialized index, of this layout.
+const base::subtle::Atomic32 kIndexMagic = 0x53484d31;  // "SHM1"
+// Maximum time to wait for another process to initialize the index.
+const int kMaxIndexInitWaitMs = 1000;
+
+struct ShmFileEntry {
+  // Empty if the entry is unused.
+  char file_name[ShmFileStore::kMaxFileNameSize];
+  uint64_t object_id;
+  uint64_t size;
+  // The number of processes which have the file open.
+  uint32_t ref_count;
+  // The value of the access clock of the index when the file was last
+  // stored or opened.
+  uint64_t last_access;
+};
+
+// Maps a shared memory object of |size| bytes, or returns NULL.
+void* MapObject(int fd, size_t size, int protection) {
+  void* data = mmap(NULL, size, protection, MAP_SHARED, fd, 0);
+  return data == MAP_FAILED ? NULL : data;
+}
+
+// Locks the mutex of the index, recovering it if its owner died.
+class ScopedIndexLock {
+ public:
+  explicit ScopedIndexLock(pthread_mutex_t* mutex) : mutex_(mutex) {
+    if (pthread_mutex_lock(mutex_) == EOWNERDEAD) {
+      LOG(WARNING) << "Recovering a shared memory store left locked by a "
+                      "terminated process.";
+      pthread_mutex_consistent(mutex_);
+    }
+  }
+  ~ScopedIndexLock() { pthread_mutex_unlock(mutex_); }
+
+ private:
+  pthread_mutex_t* mutex_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedIndexLock);
+};
+
+}  // namespace
+
+struct ShmFileStore::Index {
+  // Set to |kIndexMagic| once the index is initialized.
+  base::subtle::Atomic32 magic;
+  pthread_mutex_t mutex;
+  // The fields below are protected by |mutex|.
+  uint64_t max_size;
+  uint64_t bytes_used;
+  uint64_t next_object_id;
+  uint64_t access_clock;
+  ShmFileEntry entries[kMaxFiles];
+};
+
+namespace {
+
+// The stores mapped in the process, which are never unmapped.
+class ShmFileStores {
+ public:
+  ShmFileStores() {}
+
+  ShmFileStore* Get(const std::string& store_name,
+                    ShmFileStore* (*create)(const std::string&, uint64_t),
+                    uint64_t max_size) {
+    base::AutoLock auto_lock(lock_);
+    ShmFileStore*& store = stores_[store_name];
+    if (!store)
+      store = create(store_name, max_size);
+    return store;
+  }
+
+ private:
+  base::Lock lock_;
+  std::map<std::string, ShmFileStore*> stores_;
+
+  DISALLOW_COPY_AND_ASSIGN(ShmFileStores);
+};
+
+base::LazyInstance<ShmFileStores>::Leaky g_shm_file_stores =
+    LAZY_INSTANCE_INITIALIZER;
+
+// Opens the index of |store_name|, creating it with |max_size| if it does not
+// exist and |max_size| is not zero.
+void* OpenIndex(const std::string& store_name,
+                uint64_t max_size,
+                size_t index_size,
+                bool* created) {
+  const std::string index_name = "/" + store_name;
+  *created = false;
+  int fd = -1;
+  if (max_size > 0) {
+    fd = shm_open(index_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    *created = fd >= 0;
+  }
+  if (fd < 0)
+    fd = shm_open(index_name.c_str(), O_RDWR, 0600);
+  if (fd < 0) {
+    PLOG(ERROR) << "Cannot open shared memory store " << store_name;
+    return NULL;
+  }
+
+  if (*created) {
+    if (HANDLE_EINTR(ftruncate(fd, index_size)) < 0) {
+      PLOG(ERROR) << "Cannot size shared memory store " << store_name;
+      close(fd);
+      shm_unlink(index_name.c_str());
+      return NULL;
+    }
+  } else {
+    // Wait for the creator to size the index.
+    struct stat stat_buffer;
+    int waited_ms = 0;
+    while (fstat(fd, &stat_buffer) == 0 &&
+           static_cast<size_t>(stat_buffer.st_size) < index_size &&
+           waited_ms < kMaxIndexInitWaitMs) {
+      base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(1));
+      ++waited_ms;
+    }
+    if (static_cast<size_t>(stat_buffer.st_size) != index_size) {
+      LOG(ERROR) << "Shared memory store " << store_name
+                 << " has an unexpected size.";
+      close(fd);
+      return NULL;
+    }
+  }
+
+  void* index = MapObject(fd, index_size, PROT_READ | PROT_WRITE);
+  close(fd);
+  PLOG_IF(ERROR, !index) << "Cannot map shared memory store " << store_name;
+  return index;
+}
+
+}  // namespace
+
+bool ShmFileStore::IsSupported() {
+  return true;
+}
+
+ShmFileStore* ShmFileStore::Get(const std::string& store_name,
+                                uint64_t max_size) {
+  if (store_name.empty() || store_name.find('/') != std::string::npos) {
+    LOG(ERROR) << "Invalid shared memory store name '" << store_name << "'.";
+    return NULL;
+  }
+  return g_shm_file_stores.Get().Get(store_name, &ShmFileStore::Create,
+                                     max_size);
+}
+
+// static
+ShmFileStore* ShmFileStore::Create(const std::string& store_name,
+                                   uint64_t max_size) {
+  bool created = false;
+  Index* index = static_cast<Index*>(
+      OpenIndex(store_name, max_size, sizeof(Index), &created));
+  if (!index)
+    return NULL;
+
+  if (created) {
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&index->mutex, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+    index->max_size = max_size;
+    index->bytes_used = 0;
+    index->next_object_id = 0;
+    index->access_clock = 0;
+    // The entries of the new object are zeroed.
+    base::subtle::Release_Store(&index->magic, kIndexMagic);
+  } else {
+    int waited_ms = 0;
+    while (base::subtle::Acquire_Load(&index->magic) != kIndexMagic &&
+           waited_ms < kMaxIndexInitWaitMs) {
+      base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(1));
+      ++waited_ms;
+    }
+    if (base::subtle::Acquire_Load(&index->magic) != kIndexMagic) {
+      LOG(ERROR) << "Shared memory store " << store_name
+                 << " is not initialized.";
+      munmap(index, sizeof(Index));
+      return NULL;
+    }
+  }
+  return new ShmFileStore(store_name, index);
+}
+
+ShmFileStore::ShmFileStore(const std::string& store_name, Index* index)
+    : store_name_(store_name), index_(index) {}
+
+ShmFileStore::~ShmFileStore() {}
+
+bool ShmFileStore::Put(const std::string& file_name,
+                       const uint8_t* data,
+                       uint64_t size) {
+  DCHECK(!file_name.empty());
+  DCHECK_LT(file_name.size(), kMaxFileNameSize);
+
+  // Write the data first, in an object of its own, without the lock.
+  uint64_t object_id;
+  {
+    ScopedIndexLock lock(&index_->mutex);
+    object_id = index_->next_object_id++;
+  }
+  const std::string object_name = GetObjectName(object_id);
+  int fd = shm_open(object_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0) {
+    PLOG(ERROR) << "Cannot create shared memory object " << object_name;
+    return false;
+  }
+  bool written = HANDLE_EINTR(ftruncate(fd, size)) == 0;
+  if (written && size > 0) {
+    void* object_data = MapObject(fd, size, PROT_READ | PROT_WRITE);
+    written = object_data != NULL;
+    if (written) {
+      memcpy(object_data, data, size);
+      munmap(object_data, size);
+    }
+  }
+  close(fd);
+  if (!written) {
+    PLOG(ERROR) << "Cannot write shared memory object " << object_name;
+    shm_unlink(object_name.c_str());
+    return false;
+  }
+
+  ScopedIndexLock lock(&index_->mutex);
+  // The processes which have the replaced file open keep its data mapped.
+  size_t free_entry = FindEntryWithLock(file_name);
+  if (free_entry != kMaxFiles)
+    RemoveEntryWithLock(free_entry);
+  else
+    free_entry = FindEntryWithLock(std::string());
+  // Evict the least recently used files which are not open.
+  while (free_entry == kMaxFiles ||
+         index_->bytes_used + size > index_->max_size) {
+    size_t lru_entry = kMaxFiles;
+    for (size_t i = 0; i < kMaxFiles; ++i) {
+      const ShmFileEntry& entry = index_->entries[i];
+      if (entry.file_name[0] != '\0' && entry.ref_count == 0 &&
+          (lru_entry == kMaxFiles ||
+           entry.last_access < index_->entries[lru_entry].last_access)) {
+        lru_entry = i;
+      }
+    }
+    if (lru_entry == kMaxFiles) {
+      LOG(ERROR) << "Shared memory store " << store_name_ << " is full: "
+                 << index_->bytes_used << " bytes used out of "
+                 << index_->max_size << ".";
+      shm_unlink(object_name.c_str());
+      return false;
+    }
+    VLOG(1) << "Evicting " << index_->entries[lru_entry].file_name
+            << " from shared memory store " << store_name_;
+    RemoveEntryWithLock(lru_entry);
+    if (free_entry == kMaxFiles)
+      free_entry = lru_entry;
+  }
+
+  ShmFileEntry& entry = index_->entries[free_entry];
+  strncpy(entry.file_name, file_name.c_str(), kMaxFileNameSize);
+  entry.object_id = object_id;
+  entry.size = size;
+  entry.ref_count = 0;
+  entry.last_access = index_->access_clock++;
+  index_->bytes_used += size;
+  return true;
+}
+
+bool ShmFileStore::Acquire(const std::string& file_name,
+                           const uint8_t** data,
+                           uint64_t* size,
+                           uint64_t* object_id) {
+  DCHECK(data);
+  DCHECK(size);
+  DCHECK(object_id);
+
+  {
+    ScopedIndexLock lock(&index_->mutex);
+    const size_t entry_index = FindEntryWithLock(file_name);
+    if (file_name.empty() || entry_index == kMaxFiles)
+      return false;
+    ShmFileEntry& entry = index_->entries[entry_index];
+    ++entry.ref_count;
+    entry.last_access = index_->access_clock++;
+    *object_id = entry.object_id;
+    *size = entry.size;
+  }
+
+  *data = NULL;
+  if (*size == 0)
+    return true;
+  // The object stays until the file is released.
+  const std::string object_name = GetObjectName(*object_id);
+  int fd = shm_open(object_name.c_str(), O_RDONLY, 0600);
+  void* object_data = fd >= 0 ? MapObject(fd, *size, PROT_READ) : NULL;
+  if (fd >= 0)
+    close(fd);
+  if (!object_data) {
+    PLOG(ERROR) << "Cannot map shared memory object " << object_name;
+    Release(*object_id, NULL, 0);
+    return false;
+  }
+  *data = static_cast<const uint8_t*>(object_data);
+  return true;
+}
+
+void ShmFileStore::Release(uint64_t object_id,
+                           const uint8_t* data,
+                           uint64_t size) {
+  if (data)
+    munmap(const_cast<uint8_t*>(data), size);
+
+  ScopedIndexLock lock(&index_->mutex);
+  // The file may have been replaced or deleted since it was opened.
+  for (size_t i = 0; i < kMaxFiles; ++i) {
+    ShmFileEntry& entry = index_->entries[i];
+    if (entry.file_name[0] != '\0' && entry.object_id == object_id) {
+      DCHECK_GT(entry.ref_count, 0u);
+      --entry.ref_count;
+      return;
+    }
+  }
+}
+
+bool ShmFileStore::Delete(const std::string& file_name) {
+  ScopedIndexLock lock(&index_->mutex);
+  const size_t entry_index = FindEntryWithLock(file_name);
+  if (file_name.empty() || entry_index == kMaxFiles)
+    return false;
+  RemoveEntryWithLock(entry_index);
+  return true;
+}
+
+uint64_t ShmFileStore::GetBytesUsed() {
+  ScopedIndexLock lock(&index_->mutex);
+  return index_->bytes_used;
+}
+
+std::string ShmFileStore::GetObjectName(uint64_t object_id) const {
+  return "/" + store_name_ + "." + base::Uint64ToString(object_id);
+}
+
+size_t ShmFileStore::FindEntryWithLock(const std::string& file_name) const {
+  for (size_t i = 0; i < kMaxFiles; ++i) {
+    if (file_name == index_->entries[i].file_name)
+      return i;
+  }
+  return kMaxFiles;
+}
+
+void ShmFileStore::RemoveEntryWithLock(size_t entry_index) {
+  ShmFileEntry& entry = index_->entries[entry_index];
+  shm_unlink(GetObjectName(entry.object_id).c_str());
+  DCHECK_GE(index_->bytes_used, entry.size);
+  index_->bytes_used -= entry.size;
+  memset(&entry, 0, sizeof(entry));
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,85 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/file/shm_file.h"
+
+#include "packager/base/logging.h"
+
+namespace edash_packager {
+namespace media {
+
+// Shared memory stores rely on robust process-shared mutexes, which are Linux
+// only. Get() returns NULL so ShmFileStore is never created on other
+// platforms.
+
+struct ShmFileStore::Index {};
+
+// static
+bool ShmFileStore::IsSupported() {
+  return false;
+}
+
+// static
+ShmFileStore* ShmFileStore::Get(const std::string& store_name,
+                                uint64_t max_size) {
+  NOTIMPLEMENTED() << "Shared memory stores are not supported.";
+  return NULL;
+}
+
+// static
+ShmFileStore* ShmFileStore::Create(const std::string& store_name,
+                                   uint64_t max_size) {
+  return NULL;
+}
+
+ShmFileStore::ShmFileStore(const std::string& store_name, Index* index)
+    : store_name_(store_name), index_(index) {}
+
+ShmFileStore::~ShmFileStore() {}
+
+bool ShmFileStore::Put(const std::string& file_name,
+                       const uint8_t* data,
+                       uint64_t size) {
+  NOTIMPLEMENTED();
+  return false;
+}
+
+bool ShmFileStore::Acquire(const std::string& file_name,
+                           const uint8_t** data,
+                           uint64_t* size,
+                           uint64_t* object_id) {
+  NOTIMPLEMENTED();
+  return false;
+}
+
+void ShmFileStore::Release(uint64_t object_id,
+                           const uint8_t* data,
+                           uint64_t size) {
+  NOTIMPLEMENTED();
+}
+
+bool ShmFileStore::Delete(const std::string& file_name) {
+  NOTIMPLEMENTED();
+  return false;
+}
+
+uint64_t ShmFileStore::GetBytesUsed() {
+  NOTIMPLEMENTED();
+  return 0;
+}
+
+std::string ShmFileStore::GetObjectName(uint64_t object_id) const {
+  return std::string();
+}
+
+size_t ShmFileStore::FindEntryWithLock(const std::string& file_name) const {
+  return kMaxFiles;
+}
+
+void ShmFileStore::RemoveEntryWithLock(size_t entry_index) {}
+
+}  // namespace media
+}  // namespace edash_packager
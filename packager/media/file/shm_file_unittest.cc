@@ -0,0 +1,164 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/strings/string_number_conversions.h"
+#include "packager/media/file/file.h"
+#include "packager/media/file/file_closer.h"
+#include "packager/media/file/shm_file.h"
+
+DECLARE_string(shm_file_store);
+
+namespace edash_packager {
+namespace media {
+namespace {
+
+const uint8_t kWriteBuffer[] = {1, 2, 3, 4, 5, 6, 7, 8};
+const int64_t kWriteBufferSize = sizeof(kWriteBuffer);
+const uint64_t kStoreSize = 3 * kWriteBufferSize;
+
+}  // namespace
+
+class ShmFileTest : public testing::Test {
+ protected:
+  ShmFileTest() : store_(NULL) {}
+
+  void SetUp() override {
+    if (!ShmFileStore::IsSupported())
+      return;
+    // Stores outlive the process, so each test uses a store of its own.
+    store_name_ =
+        std::string("edash_packager_test_") +
+        testing::UnitTest::GetInstance()->current_test_info()->name() + "_" +
+        base::IntToString(getpid());
+    store_ = ShmFileStore::Get(store_name_, kStoreSize);
+    ASSERT_TRUE(store_);
+  }
+
+  void TearDown() override {
+    if (!store_)
+      return;
+    for (size_t i = 0; i < arraysize(kFileNames); ++i)
+      store_->Delete(kFileNames[i]);
+    shm_unlink(("/" + store_name_).c_str());
+  }
+
+  bool Put(const std::string& file_name) {
+    return store_->Put(file_name, kWriteBuffer, kWriteBufferSize);
+  }
+
+  static const char* const kFileNames[];
+
+  std::string store_name_;
+  ShmFileStore* store_;
+};
+
+const char* const ShmFileTest::kFileNames[] = {"file1", "file2", "file3",
+                                               "file4"};
+
+TEST_F(ShmFileTest, WritesAndReadsFile) {
+  if (!store_)
+    return;
+  FLAGS_shm_file_store = store_name_;
+
+  scoped_ptr<File, FileCloser> writer(File::Open("shm://file1", "w"));
+  ASSERT_TRUE(writer);
+  ASSERT_EQ(kWriteBufferSize, writer->Write(kWriteBuffer, kWriteBufferSize));
+  // The file is stored when it is closed.
+  EXPECT_FALSE(File::Open("shm://file1", "r"));
+  ASSERT_TRUE(writer.release()->Close());
+
+  scoped_ptr<File, FileCloser> reader(File::Open("shm://file1", "r"));
+  ASSERT_TRUE(reader);
+  EXPECT_EQ(kWriteBufferSize, reader->Size());
+  uint8_t read_buffer[kWriteBufferSize];
+  ASSERT_EQ(kWriteBufferSize, reader->Read(read_buffer, kWriteBufferSize));
+  EXPECT_EQ(0, memcmp(kWriteBuffer, read_buffer, kWriteBufferSize));
+  EXPECT_EQ(0, reader->Read(read_buffer, kWriteBufferSize));
+  reader.reset();
+
+  EXPECT_TRUE(File::Delete("shm://file1"));
+  EXPECT_FALSE(File::Open("shm://file1", "r"));
+  EXPECT_EQ(0u, store_->GetBytesUsed());
+}
+
+TEST_F(ShmFileTest, ReplacesFile) {
+  if (!store_)
+    return;
+  ASSERT_TRUE(Put("file1"));
+
+  const uint8_t* data = NULL;
+  uint64_t size = 0;
+  uint64_t object_id = 0;
+  ASSERT_TRUE(store_->Acquire("file1", &data, &size, &object_id));
+
+  const uint8_t kNewBuffer[] = {9, 10};
+  ASSERT_TRUE(store_->Put("file1", kNewBuffer, sizeof(kNewBuffer)));
+  EXPECT_EQ(sizeof(kNewBuffer), store_->GetBytesUsed());
+
+  // The file open keeps the old data.
+  ASSERT_EQ(static_cast<uint64_t>(kWriteBufferSize), size);
+  EXPECT_EQ(0, memcmp(kWriteBuffer, data, size));
+  store_->Release(object_id, data, size);
+
+  ASSERT_TRUE(store_->Acquire("file1", &data, &size, &object_id));
+  ASSERT_EQ(sizeof(kNewBuffer), size);
+  EXPECT_EQ(0, memcmp(kNewBuffer, data, size));
+  store_->Release(object_id, data, size);
+}
+
+TEST_F(ShmFileTest, EvictsLeastRecentlyUsedFile) {
+  if (!store_)
+    return;
+  ASSERT_TRUE(Put("file1"));
+  ASSERT_TRUE(Put("file2"));
+  ASSERT_TRUE(Put("file3"));
+
+  // Opening file1 makes file2 the least recently used file.
+  const uint8_t* data = NULL;
+  uint64_t size = 0;
+  uint64_t object_id = 0;
+  ASSERT_TRUE(store_->Acquire("file1", &data, &size, &object_id));
+  store_->Release(object_id, data, size);
+
+  ASSERT_TRUE(Put("file4"));
+  EXPECT_EQ(kStoreSize, store_->GetBytesUsed());
+  EXPECT_FALSE(store_->Acquire("file2", &data, &size, &object_id));
+  ASSERT_TRUE(store_->Acquire("file1", &data, &size, &object_id));
+  store_->Release(object_id, data, size);
+}
+
+TEST_F(ShmFileTest, DoesNotEvictOpenFiles) {
+  if (!store_)
+    return;
+  std::vector<uint64_t> object_ids(3);
+  std::vector<const uint8_t*> data(3);
+  uint64_t size = 0;
+  for (size_t i = 0; i < 3; ++i) {
+    ASSERT_TRUE(Put(kFileNames[i]));
+    ASSERT_TRUE(
+        store_->Acquire(kFileNames[i], &data[i], &size, &object_ids[i]));
+  }
+
+  EXPECT_FALSE(Put("file4"));
+  EXPECT_EQ(kStoreSize, store_->GetBytesUsed());
+
+  store_->Release(object_ids[1], data[1], size);
+  EXPECT_TRUE(Put("file4"));
+  store_->Release(object_ids[0], data[0], size);
+  store_->Release(object_ids[2], data[2], size);
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,191 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/file/tee_file.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "packager/base/logging.h"
+#include "packager/base/strings/string_split.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+const char kDestinationSeparator = '|';
+
+void SplitDestinations(const char* destinations,
+                       std::vector<std::string>* destination_names) {
+  base::SplitString(destinations, kDestinationSeparator, destination_names);
+  destination_names->erase(std::remove(destination_names->begin(),
+                                       destination_names->end(),
+                                       std::string()),
+                           destination_names->end());
+}
+
+// Writes all the |length| bytes of |buffer| to |file|, which may accept
+// fewer bytes per call. Returns false on failure.
+bool WriteAll(File* file, const uint8_t* buffer, uint64_t length) {
+  while (length > 0) {
+    const int64_t result = file->Write(buffer, length);
+    if (result <= 0)
+      return false;
+    buffer += result;
+    length -= result;
+  }
+  return true;
+}
+
+}  // namespace
+
+TeeFile::TeeFile(const char* destinations, const char* mode)
+    : File(destinations),
+      mode_(mode),
+      expected_size_(0),
+      num_open_destinations_(0),
+      position_(0),
+      size_(0) {
+  SplitDestinations(destinations, &destination_names_);
+}
+
+TeeFile::~TeeFile() {}
+
+bool TeeFile::Open() {
+  if (destination_names_.empty()) {
+    LOG(ERROR) << "No destination in tee file " << file_name();
+    return false;
+  }
+  const bool read_mode = mode_ == "r";
+  if (!read_mode && mode_ != "w" && mode_ != "a") {
+    NOTIMPLEMENTED() << "Tee files only support modes 'r', 'w' and 'a'.";
+    return false;
+  }
+  // Only the first destination is read.
+  const size_t num_destinations = read_mode ? 1 : destination_names_.size();
+  destinations_.assign(num_destinations, NULL);
+  for (size_t i = 0; i < num_destinations; ++i) {
+    const char* name = destination_names_[i].c_str();
+    destinations_[i] =
+        expected_size_ > 0
+            ? File::OpenWithExpectedSize(name, mode_.c_str(), expected_size_)
+            : File::Open(name, mode_.c_str());
+    if (!destinations_[i]) {
+      LOG(ERROR) << "Failed to open " << name;
+      for (size_t j = 0; j < i; ++j)
+        destinations_[j]->Close();
+      destinations_.clear();
+      return false;
+    }
+  }
+  num_open_destinations_ = num_destinations;
+  return true;
+}
+
+void TeeFile::SetExpectedSize(uint64_t size) {
+  expected_size_ = size;
+}
+
+bool TeeFile::Close() {
+  bool result = false;
+  for (size_t i = 0; i < destinations_.size(); ++i) {
+    if (!destinations_[i])
+      continue;
+    if (destinations_[i]->Close()) {
+      result = true;
+    } else {
+      LOG(WARNING) << "Failed to close tee destination "
+                   << destination_names_[i];
+    }
+  }
+  delete this;
+  return result;
+}
+
+int64_t TeeFile::Read(void* buffer, uint64_t length) {
+  if (num_open_destinations_ == 0)
+    return -1;
+  const int64_t result = destinations_[0]->Read(buffer, length);
+  if (result > 0)
+    position_ += result;
+  return result;
+}
+
+int64_t TeeFile::Write(const void* buffer, uint64_t length) {
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(buffer);
+  for (size_t i = 0; i < destinations_.size(); ++i) {
+    if (destinations_[i] && !WriteAll(destinations_[i], data, length))
+      DropDestination(i, "write");
+  }
+  if (num_open_destinations_ == 0)
+    return -1;
+  position_ += length;
+  size_ = std::max(size_, position_);
+  return length;
+}
+
+int64_t TeeFile::Size() {
+  if (num_open_destinations_ == 0)
+    return -1;
+  if (mode_ == "r")
+    return destinations_[0]->Size();
+  return size_;
+}
+
+bool TeeFile::Flush() {
+  for (size_t i = 0; i < destinations_.size(); ++i) {
+    if (destinations_[i] && !destinations_[i]->Flush())
+      DropDestination(i, "flush");
+  }
+  return num_open_destinations_ > 0;
+}
+
+bool TeeFile::Seek(uint64_t position) {
+  for (size_t i = 0; i < destinations_.size(); ++i) {
+    if (destinations_[i] && !destinations_[i]->Seek(position))
+      DropDestination(i, "seek");
+  }
+  if (num_open_destinations_ == 0)
+    return false;
+  position_ = position;
+  return true;
+}
+
+bool TeeFile::Tell(uint64_t* position) {
+  DCHECK(position);
+  if (num_open_destinations_ == 0)
+    return false;
+  *position = position_;
+  return true;
+}
+
+bool TeeFile::Delete(const char* destinations) {
+  std::vector<std::string> destination_names;
+  SplitDestinations(destinations, &destination_names);
+  bool result = true;
+  for (const std::string& destination_name : destination_names) {
+    if (!File::Delete(destination_name.c_str())) {
+      LOG(WARNING) << "Failed to delete tee destination "
+                   << destination_name;
+      result = false;
+    }
+  }
+  return result;
+}
+
+void TeeFile::DropDestination(size_t index, const char* operation) {
+  DCHECK(destinations_[index]);
+  LOG(WARNING) << "Failed to " << operation << " tee destination "
+               << destination_names_[index] << "; dropping it.";
+  destinations_[index]->Close();
+  destinations_[index] = NULL;
+  --num_open_destinations_;
+}
+
+}  // namespace media
+}  // namespace edash_packager
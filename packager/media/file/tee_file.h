@@ -0,0 +1,82 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_FILE_TEE_FILE_H_
+#define MEDIA_FILE_TEE_FILE_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "packager/media/file/file.h"
+
+namespace edash_packager {
+namespace media {
+
+/// Implements a File which writes the same content to several destinations,
+/// e.g. a local cache disk and a remote origin, so that the output is muxed
+/// and encrypted once. The destinations are the files of the list separated
+/// by '|', e.g. "tee://output/seg1.m4s|http://origin/seg1.m4s"; each one is
+/// opened with File::Open(), so it writes through its own queue, e.g. the
+/// cache of a threaded local file or the upload queue of an HTTP file, and a
+/// slow destination does not hold the others back until its queue is full.
+///
+/// A destination which fails is closed and dropped with a warning; the
+/// writes go on to the others. The file fails once no destination is left.
+///
+/// In read mode, the first destination is read.
+class TeeFile : public File {
+ public:
+  /// @param destinations is the list of the destinations, separated by '|'.
+  /// @param mode is the file mode, "w" or "a" to write the destinations, or
+  ///        "r" to read the first one.
+  TeeFile(const char* destinations, const char* mode);
+
+  /// @name File implementation overrides.
+  /// @{
+  /// @return true if at least one destination was written and closed
+  ///         successfully.
+  bool Close() override;
+  int64_t Read(void* buffer, uint64_t length) override;
+  int64_t Write(const void* buffer, uint64_t length) override;
+  int64_t Size() override;
+  bool Flush() override;
+  bool Seek(uint64_t position) override;
+  bool Tell(uint64_t* position) override;
+  /// @}
+
+  /// Deletes all the destinations of @a destinations.
+  /// @return true if all of them were deleted.
+  static bool Delete(const char* destinations);
+
+ protected:
+  ~TeeFile() override;
+
+  bool Open() override;
+  void SetExpectedSize(uint64_t size) override;
+
+ private:
+  // Closes and drops destination |index| after an |operation| failure.
+  void DropDestination(size_t index, const char* operation);
+
+  const std::string mode_;
+  uint64_t expected_size_;
+  std::vector<std::string> destination_names_;
+  // The destinations, in the order of |destination_names_|. NULL once
+  // dropped.
+  std::vector<File*> destinations_;
+  size_t num_open_destinations_;
+  uint64_t position_;
+  uint64_t size_;
+
+  DISALLOW_COPY_AND_ASSIGN(TeeFile);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_FILE_TEE_FILE_H_
@@ -0,0 +1,71 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "packager/media/file/file.h"
+#include "packager/media/file/memory_file.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+const char kTeeFileName[] = "tee://memory://cache/seg1.m4s|memory://seg1.m4s";
+const char kFirstDestination[] = "memory://cache/seg1.m4s";
+const char kSecondDestination[] = "memory://seg1.m4s";
+const char kData[] = "segment data";
+}  // namespace
+
+class TeeFileTest : public testing::Test {
+ public:
+  void TearDown() override { MemoryFile::DeleteAll(); }
+};
+
+TEST_F(TeeFileTest, WriteAllDestinations) {
+  File* file = File::Open(kTeeFileName, "w");
+  ASSERT_TRUE(file);
+  EXPECT_EQ(static_cast<int64_t>(sizeof(kData)),
+            file->Write(kData, sizeof(kData)));
+  EXPECT_EQ(static_cast<int64_t>(sizeof(kData)), file->Size());
+  uint64_t position = 0;
+  ASSERT_TRUE(file->Tell(&position));
+  EXPECT_EQ(sizeof(kData), position);
+  EXPECT_TRUE(file->Close());
+
+  std::string contents;
+  ASSERT_TRUE(File::ReadFileToString(kFirstDestination, &contents));
+  EXPECT_EQ(std::string(kData, sizeof(kData)), contents);
+  contents.clear();
+  ASSERT_TRUE(File::ReadFileToString(kSecondDestination, &contents));
+  EXPECT_EQ(std::string(kData, sizeof(kData)), contents);
+}
+
+TEST_F(TeeFileTest, ReadFirstDestination) {
+  ASSERT_TRUE(File::WriteFileAtomically(kFirstDestination, "first"));
+  ASSERT_TRUE(File::WriteFileAtomically(kSecondDestination, "second"));
+  std::string contents;
+  ASSERT_TRUE(File::ReadFileToString(kTeeFileName, &contents));
+  EXPECT_EQ("first", contents);
+}
+
+TEST_F(TeeFileTest, Delete) {
+  ASSERT_TRUE(File::WriteFileAtomically(kTeeFileName, kData));
+  EXPECT_TRUE(File::Delete(kTeeFileName));
+  EXPECT_FALSE(File::Open(kFirstDestination, "r"));
+  EXPECT_FALSE(File::Open(kSecondDestination, "r"));
+}
+
+// A destination which cannot be opened fails the open.
+TEST_F(TeeFileTest, OpenFailure) {
+  EXPECT_FALSE(File::Open("tee://memory://seg1.m4s|udp://127.0.0.1:1234",
+                          "w"));
+  EXPECT_FALSE(File::Open("tee://", "w"));
+}
+
+}  // namespace media
+}  // namespace edash_packager
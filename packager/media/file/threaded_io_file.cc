@@ -6,37 +6,98 @@
 
 #include "packager/media/file/threaded_io_file.h"
 
+#include <algorithm>
+
 #include "packager/base/bind.h"
 #include "packager/base/bind_helpers.h"
-#include "packager/base/location.h"
-#include "packager/base/threading/worker_pool.h"
+#include "packager/base/files/file_path.h"
+#include "packager/base/files/file_util.h"
+#include "packager/base/trace_event/trace_event.h"
+#include "packager/media/base/background_executor.h"
+#include "packager/media/base/cancellation_token.h"
+#include "packager/media/base/cpu_affinity.h"
+#include "packager/media/base/memory_tracker.h"
 
 namespace edash_packager {
 namespace media {
 
+using base::subtle::Acquire_Load;
 using base::subtle::NoBarrier_Load;
 using base::subtle::NoBarrier_Store;
+using base::subtle::Release_Store;
+
+namespace {
+
+// The cache of the adaptive read-ahead holds at least this many blocks.
+const uint64_t kMinBlocksInCache = 4;
+// The number of reads at a block size before it can grow.
+const uint64_t kMinReadsPerBlockSize = 4;
+// The block size grows as long as the previous growth improved the
+// throughput of the reads by this factor.
+const double kMinBlockThroughputGain = 1.1;
+// The cache holds enough data for the reader during this many reads.
+const double kReadsHiddenByCache = 4;
+// A write waiting for room in the cache for this long is reported.
+const int64_t kWriteStallWarningMs = 500;
+
+}  // namespace
+
+ThreadedIoFile::ReadAheadStats::ReadAheadStats()
+    : block_size(0),
+      cache_size(0),
+      bytes_read(0),
+      num_reads(0),
+      num_underruns(0) {}
+
+ThreadedIoFile::WriteStats::WriteStats()
+    : cache_size(0), num_stalls(0), bytes_spooled(0) {}
 
 ThreadedIoFile::ThreadedIoFile(scoped_ptr<File, FileCloser> internal_file,
                                Mode mode,
                                uint64_t io_cache_size,
-                               uint64_t io_block_size)
+                               uint64_t io_block_size,
+                               uint64_t max_io_cache_size)
     : File(internal_file->file_name()),
       internal_file_(internal_file.Pass()),
       mode_(mode),
       cache_(io_cache_size),
-      io_buffer_(io_block_size),
+      io_block_size_(io_block_size),
       position_(0),
       size_(0),
       eof_(false),
       flushing_(false),
       flush_complete_event_(false, false),
       internal_file_error_(0),
-      task_exit_event_(false, false) {
+      task_exit_event_(false, false),
+      adaptive_read_ahead_(mode == kInputMode &&
+                           max_io_cache_size > io_cache_size),
+      max_io_cache_size_(max_io_cache_size),
+      last_num_underruns_(0),
+      last_adapt_bytes_consumed_(0),
+      block_num_reads_(0),
+      block_bytes_read_(0),
+      previous_block_throughput_(0),
+      adaptive_output_cache_(mode == kOutputMode &&
+                             max_io_cache_size > io_cache_size),
+      spooling_(0),
+      spool_read_position_(0),
+      spool_write_position_(0),
+      spool_file_position_(0) {
   DCHECK(internal_file_);
+  stats_.block_size = io_block_size;
+  stats_.cache_size = io_cache_size;
+  write_stats_.cache_size = io_cache_size;
 }
 
-ThreadedIoFile::~ThreadedIoFile() {}
+ThreadedIoFile::~ThreadedIoFile() {
+  if (spool_file_) {
+    spool_file_.reset();
+    if (!File::Delete(spool_file_name_.c_str()))
+      LOG(WARNING) << "Failed to delete spool file " << spool_file_name_;
+  }
+  BackgroundExecutor::GetInstance()->ReleaseThread(
+      BackgroundExecutor::kFileIoQueue);
+}
 
 bool ThreadedIoFile::Open() {
   DCHECK(internal_file_);
@@ -47,12 +108,26 @@ bool ThreadedIoFile::Open() {
   position_ = 0;
   size_ = internal_file_->Size();
 
-  base::WorkerPool::PostTask(FROM_HERE, base::Bind(&ThreadedIoFile::TaskHandler,
-                                                   base::Unretained(this)),
-                             true /* task_is_slow */);
+  // The I/O runs on the CPUs of the thread opening the file, i.e. on the NUMA
+  // node of the job, see cpu_affinity.h, which is also where |cache_| is.
+  GetCurrentThreadAffinity(&cpus_);
+  // The reads, writes and flushes of a cancelled job fail promptly instead of
+  // waiting for the cache.
+  cache_.set_cancellation_token(CancellationToken::Current());
+  // The blocks read or written are accounted in the I/O budget of the job.
+  io_throttle_ = IoThrottle::Current();
+  // The CPU time of the thread task is accounted in the usage of the job.
+  resource_usage_ = JobResourceUsage::Current();
+  BackgroundExecutor::GetInstance()->PostTask(
+      BackgroundExecutor::kFileIoQueue,
+      base::Bind(&ThreadedIoFile::TaskHandler, base::Unretained(this)));
   return true;
 }
 
+void ThreadedIoFile::SetExpectedSize(uint64_t size) {
+  internal_file_->SetExpectedSize(size);
+}
+
 bool ThreadedIoFile::Close() {
   DCHECK(internal_file_);
 
@@ -62,6 +137,21 @@ bool ThreadedIoFile::Close() {
   cache_.Close();
   task_exit_event_.Wait();
 
+  if (mode_ == kInputMode) {
+    const ReadAheadStats stats = GetReadAheadStats();
+    VLOG(1) << "Read-ahead of " << file_name() << ": " << stats.bytes_read
+            << " bytes in " << stats.num_reads << " reads taking "
+            << stats.read_time.InMilliseconds() << " ms, block size "
+            << stats.block_size << ", cache size " << stats.cache_size << ", "
+            << stats.num_underruns << " underruns.";
+  } else {
+    const WriteStats stats = GetWriteStats();
+    VLOG(1) << "Writes of " << file_name() << ": cache size "
+            << stats.cache_size << ", " << stats.num_stalls << " stalls taking "
+            << stats.stall_time.InMilliseconds() << " ms, "
+            << stats.bytes_spooled << " bytes spooled.";
+  }
+
   bool result = internal_file_.release()->Close();
   delete this;
   return result;
@@ -77,8 +167,11 @@ int64_t ThreadedIoFile::Read(void* buffer, uint64_t length) {
   if (NoBarrier_Load(&internal_file_error_))
     return NoBarrier_Load(&internal_file_error_);
 
-
   uint64_t bytes_read = cache_.Read(buffer, length);
+  if (bytes_read == 0 && cache_.cancelled()) {
+    LOG(ERROR) << "Read of " << file_name() << " cancelled.";
+    return -1;
+  }
   position_ += bytes_read;
 
   return bytes_read;
@@ -91,7 +184,35 @@ int64_t ThreadedIoFile::Write(const void* buffer, uint64_t length) {
   if (NoBarrier_Load(&internal_file_error_))
     return NoBarrier_Load(&internal_file_error_);
 
-  uint64_t bytes_written = cache_.Write(buffer, length);
+  const bool spooling = Acquire_Load(&spooling_) != 0;
+  if (!spooling && adaptive_output_cache_ && cache_.BytesFree() < length)
+    GrowOutputCache(length);
+  bool spooled = false;
+  if ((spooling || (cache_.BytesFree() < length && !spool_dir_.empty())) &&
+      !WriteToSpool(buffer, length, &spooled)) {
+    return -1;
+  }
+
+  uint64_t bytes_written = length;
+  if (!spooled) {
+    const bool stalled = cache_.BytesFree() < length;
+    const base::TimeTicks start_time =
+        stalled ? base::TimeTicks::Now() : base::TimeTicks();
+    bytes_written = cache_.Write(buffer, length);
+    if (bytes_written < length && cache_.cancelled()) {
+      LOG(ERROR) << "Write of " << file_name() << " cancelled.";
+      return -1;
+    }
+    if (stalled) {
+      const base::TimeDelta stall_time = base::TimeTicks::Now() - start_time;
+      LOG_IF(WARNING, stall_time.InMilliseconds() >= kWriteStallWarningMs)
+          << "Write of " << file_name() << " waited "
+          << stall_time.InMilliseconds() << " ms for the storage.";
+      base::AutoLock auto_lock(stats_lock_);
+      ++write_stats_.num_stalls;
+      write_stats_.stall_time += stall_time;
+    }
+  }
   position_ += bytes_written;
   if (position_ > size_)
     size_ = position_;
@@ -105,13 +226,38 @@ int64_t ThreadedIoFile::Size() {
   return size_;
 }
 
+uint64_t ThreadedIoFile::GetCachedSize() {
+  return cache_.BytesCached();
+}
+
+ThreadedIoFile::ReadAheadStats ThreadedIoFile::GetReadAheadStats() {
+  ReadAheadStats stats;
+  {
+    base::AutoLock auto_lock(stats_lock_);
+    stats = stats_;
+  }
+  stats.num_underruns = cache_.num_read_waits();
+  return stats;
+}
+
+ThreadedIoFile::WriteStats ThreadedIoFile::GetWriteStats() {
+  base::AutoLock auto_lock(stats_lock_);
+  return write_stats_;
+}
+
 bool ThreadedIoFile::Flush() {
   DCHECK(internal_file_);
   DCHECK_EQ(kOutputMode, mode_);
 
+  // The thread task has exited if the file failed or was cancelled.
+  if (NoBarrier_Load(&internal_file_error_))
+    return false;
+
   flushing_ = true;
   cache_.Close();
   flush_complete_event_.Wait();
+  if (NoBarrier_Load(&internal_file_error_))
+    return false;
   return internal_file_->Flush();
 }
 
@@ -134,10 +280,9 @@ bool ThreadedIoFile::Seek(uint64_t position) {
     }
     cache_.Reopen();
     eof_ = false;
-    base::WorkerPool::PostTask(
-        FROM_HERE,
-        base::Bind(&ThreadedIoFile::TaskHandler, base::Unretained(this)),
-        true /* task_is_slow */);
+    BackgroundExecutor::GetInstance()->PostTask(
+        BackgroundExecutor::kFileIoQueue,
+        base::Bind(&ThreadedIoFile::TaskHandler, base::Unretained(this)));
     if (!result) return false;
   }
   position_ = position;
@@ -152,10 +297,14 @@ bool ThreadedIoFile::Tell(uint64_t* position) {
 }
 
 void ThreadedIoFile::TaskHandler() {
-  if (mode_ == kInputMode)
-    RunInInputMode();
-  else
-    RunInOutputMode();
+  {
+    ScopedThreadAffinity affinity(cpus_);
+    ScopedJobResourceUsage scoped_usage(resource_usage_.get());
+    if (mode_ == kInputMode)
+      RunInInputMode();
+    else
+      RunInOutputMode();
+  }
   task_exit_event_.Signal();
 }
 
@@ -164,27 +313,130 @@ void ThreadedIoFile::RunInInputMode() {
   DCHECK_EQ(kInputMode, mode_);
 
   while (true) {
-    int64_t read_result = internal_file_->Read(&io_buffer_[0],
-                                               io_buffer_.size());
+    // Read in place, in the free space of the cache.
+    uint64_t region_size = 0;
+    uint8_t* region = cache_.BeginWrite(&region_size);
+    if (!region)
+      return;
+    region_size = std::min(region_size, io_block_size_);
+    if (io_throttle_ &&
+        !io_throttle_->Acquire(region_size, cache_.cancellation_token())) {
+      NoBarrier_Store(&internal_file_error_, -1);
+      cache_.Close();
+      return;
+    }
+    int64_t read_result;
+    const base::TimeTicks read_start_time = base::TimeTicks::Now();
+    {
+      TRACE_EVENT0("packager", "ThreadedIoFile::ReadInternal");
+      read_result = internal_file_->Read(region, region_size);
+    }
     if (read_result <= 0) {
       NoBarrier_Store(&eof_, read_result == 0);
       NoBarrier_Store(&internal_file_error_, read_result);
       cache_.Close();
       return;
     }
-    if (cache_.Write(&io_buffer_[0], read_result) == 0) {
-      return;
+    const base::TimeDelta read_time =
+        base::TimeTicks::Now() - read_start_time;
+    ++block_num_reads_;
+    block_bytes_read_ += read_result;
+    block_read_time_ += read_time;
+    {
+      base::AutoLock auto_lock(stats_lock_);
+      stats_.bytes_read += read_result;
+      ++stats_.num_reads;
+      stats_.read_time += read_time;
     }
+    cache_.EndWrite(read_result);
+    if (adaptive_read_ahead_)
+      AdaptReadAhead();
   }
 }
 
+void ThreadedIoFile::AdaptReadAhead() {
+  // Only the reader waiting for data, i.e. the storage being slower than the
+  // reader, calls for more read-ahead.
+  const uint64_t num_underruns = cache_.num_read_waits();
+  if (num_underruns == last_num_underruns_ ||
+      block_num_reads_ < kMinReadsPerBlockSize) {
+    return;
+  }
+  last_num_underruns_ = num_underruns;
+
+  const base::TimeTicks now = base::TimeTicks::Now();
+  uint64_t bytes_read;
+  {
+    base::AutoLock auto_lock(stats_lock_);
+    bytes_read = stats_.bytes_read;
+  }
+  const uint64_t bytes_consumed = bytes_read - cache_.BytesCached();
+  const double elapsed_seconds = (now - last_adapt_time_).InSecondsF();
+  const double reader_rate =
+      last_adapt_time_.is_null() || elapsed_seconds <= 0
+          ? 0
+          : (bytes_consumed - last_adapt_bytes_consumed_) / elapsed_seconds;
+  last_adapt_time_ = now;
+  last_adapt_bytes_consumed_ = bytes_consumed;
+
+  if (MemoryTracker::IsOverSoftLimit())
+    return;
+
+  const double read_seconds = block_read_time_.InSecondsF();
+  const double read_latency = read_seconds / block_num_reads_;
+  uint64_t block_size = io_block_size_;
+  // Larger reads amortize the latency of each read, as long as they make
+  // the reads faster.
+  const double block_throughput =
+      read_seconds > 0 ? block_bytes_read_ / read_seconds : 0;
+  if (block_throughput >
+          previous_block_throughput_ * kMinBlockThroughputGain &&
+      block_size * 2 * kMinBlocksInCache <= max_io_cache_size_) {
+    previous_block_throughput_ = block_throughput;
+    block_size *= 2;
+    io_block_size_ = block_size;
+    block_num_reads_ = 0;
+    block_bytes_read_ = 0;
+    block_read_time_ = base::TimeDelta();
+  }
+
+  // Cache enough data for the reader to keep going during several reads.
+  uint64_t cache_size = std::max(
+      kMinBlocksInCache * block_size,
+      static_cast<uint64_t>(kReadsHiddenByCache * reader_rate * read_latency));
+  cache_size = std::min(cache_size, max_io_cache_size_);
+  cache_.Grow(cache_size);
+
+  base::AutoLock auto_lock(stats_lock_);
+  stats_.block_size = block_size;
+  stats_.cache_size = cache_.cache_size();
+}
+
 void ThreadedIoFile::RunInOutputMode() {
   DCHECK(internal_file_);
   DCHECK_EQ(kOutputMode, mode_);
 
   while (true) {
-    uint64_t write_bytes = cache_.Read(&io_buffer_[0], io_buffer_.size());
-    if (write_bytes == 0) {
+    bool written_from_spool = false;
+    if (!WriteFromSpool(&written_from_spool))
+      return;
+    if (written_from_spool)
+      continue;
+
+    // Write in place, from the data of the cache.
+    uint64_t write_bytes = 0;
+    const uint8_t* region = cache_.BeginRead(&write_bytes);
+    if (cache_.cancelled()) {
+      // The data left in the cache is dropped. A flush in progress, or to
+      // come, fails.
+      NoBarrier_Store(&internal_file_error_, -1);
+      flush_complete_event_.Signal();
+      return;
+    }
+    if (!region) {
+      // The spool, if any, is written before the flush completes.
+      if (Acquire_Load(&spooling_))
+        continue;
       if (flushing_) {
         cache_.Reopen();
         flushing_ = false;
@@ -193,19 +445,165 @@ void ThreadedIoFile::RunInOutputMode() {
         return;
       }
     } else {
-      uint64_t bytes_written(0);
-      while (bytes_written < write_bytes) {
-        int64_t write_result = internal_file_->Write(
-            &io_buffer_[bytes_written], write_bytes - bytes_written);
-        if (write_result < 0) {
-          NoBarrier_Store(&internal_file_error_, write_result);
-          cache_.Close();
-          return;
-        }
-        bytes_written += write_result;
+      write_bytes = std::min(write_bytes, io_block_size_);
+      if (!WriteInternal(region, write_bytes))
+        return;
+      cache_.EndRead(write_bytes);
+    }
+  }
+}
+
+void ThreadedIoFile::GrowOutputCache(uint64_t length) {
+  // Absorb the burst in memory if the budget allows.
+  const uint64_t cache_size = cache_.cache_size();
+  if (cache_size >= max_io_cache_size_ || MemoryTracker::IsOverSoftLimit())
+    return;
+  cache_.Grow(std::min(std::max(cache_size * 2, cache_.BytesCached() + length),
+                       max_io_cache_size_));
+  base::AutoLock auto_lock(stats_lock_);
+  write_stats_.cache_size = cache_.cache_size();
+}
+
+bool ThreadedIoFile::WriteToSpool(const void* buffer,
+                                  uint64_t length,
+                                  bool* spooled) {
+  DCHECK(spooled);
+  const uint8_t* data = static_cast<const uint8_t*>(buffer);
+  {
+    base::AutoLock auto_lock(spool_lock_);
+    if (!Acquire_Load(&spooling_)) {
+      // Only what does not fit in the cache is spooled, so the cache is not
+      // empty when spooling starts, and the thread task, which reads the
+      // spool once the cache is empty, cannot be left waiting for the cache.
+      const uint64_t head_size = cache_.BytesFree();
+      if (head_size >= length || !OpenSpoolFile()) {
+        *spooled = false;
+        return true;
       }
+      LOG(WARNING) << "The storage of " << file_name()
+                   << " is slow. Spooling the writes to " << spool_file_name_;
+      // Does not wait: the writer is the only one filling the cache.
+      if (head_size > 0 && cache_.Write(data, head_size) < head_size)
+        return false;
+      data += head_size;
+      length -= head_size;
+      Release_Store(&spooling_, 1);
+    }
+    if (!SeekSpoolFile(spool_write_position_) ||
+        spool_file_->Write(data, length) != static_cast<int64_t>(length)) {
+      LOG(ERROR) << "Failed to write spool file " << spool_file_name_;
+      return false;
+    }
+    spool_write_position_ += length;
+    spool_file_position_ = spool_write_position_;
+  }
+  *spooled = true;
+  base::AutoLock auto_lock(stats_lock_);
+  write_stats_.bytes_spooled += length;
+  return true;
+}
+
+bool ThreadedIoFile::OpenSpoolFile() {
+  if (spool_file_)
+    return true;
+  base::FilePath spool_file_path;
+  if (!base::CreateTemporaryFileInDir(base::FilePath(spool_dir_),
+                                      &spool_file_path)) {
+    LOG(ERROR) << "Failed to create spool file in '" << spool_dir_
+               << "'. Writes of " << file_name() << " wait instead.";
+    spool_dir_.clear();
+    return false;
+  }
+  spool_file_name_ = spool_file_path.value();
+  // Read and written in place. File::Open() does not cache "w+" files.
+  spool_file_.reset(File::Open(spool_file_name_.c_str(), "w+"));
+  if (!spool_file_) {
+    LOG(ERROR) << "Failed to open spool file " << spool_file_name_
+               << ". Writes of " << file_name() << " wait instead.";
+    base::DeleteFile(spool_file_path, false);
+    spool_dir_.clear();
+    return false;
+  }
+  spool_file_position_ = 0;
+  return true;
+}
+
+bool ThreadedIoFile::WriteFromSpool(bool* written) {
+  DCHECK(written);
+  *written = false;
+  if (!Acquire_Load(&spooling_) || cache_.cancelled())
+    return true;
+
+  uint64_t size = 0;
+  {
+    base::AutoLock auto_lock(spool_lock_);
+    // The data in the cache precedes the spool. The writer does not write
+    // to the cache while spooling.
+    if (cache_.BytesCached() > 0)
+      return true;
+    if (spool_read_position_ == spool_write_position_) {
+      // The spool has been written: the writer writes to the cache again,
+      // and the spool file is reused from its beginning.
+      spool_read_position_ = 0;
+      spool_write_position_ = 0;
+      Release_Store(&spooling_, 0);
+      VLOG(1) << "The spool of " << file_name() << " has been written.";
+      return true;
+    }
+    size = std::min(spool_write_position_ - spool_read_position_,
+                    io_block_size_);
+    spool_buffer_.resize(size);
+    if (!SeekSpoolFile(spool_read_position_) ||
+        spool_file_->Read(&spool_buffer_[0], size) !=
+            static_cast<int64_t>(size)) {
+      LOG(ERROR) << "Failed to read spool file " << spool_file_name_;
+      NoBarrier_Store(&internal_file_error_, -1);
+      cache_.Close();
+      flush_complete_event_.Signal();
+      return false;
+    }
+    spool_read_position_ += size;
+    spool_file_position_ = spool_read_position_;
+  }
+  if (!WriteInternal(&spool_buffer_[0], size))
+    return false;
+  *written = true;
+  return true;
+}
+
+// The read position is always behind the write position, so switching
+// between reads and writes always seeks, as stdio requires.
+bool ThreadedIoFile::SeekSpoolFile(uint64_t position) {
+  if (position == spool_file_position_)
+    return true;
+  if (!spool_file_->Seek(position))
+    return false;
+  spool_file_position_ = position;
+  return true;
+}
+
+bool ThreadedIoFile::WriteInternal(const uint8_t* data, uint64_t size) {
+  if (io_throttle_ &&
+      !io_throttle_->Acquire(size, cache_.cancellation_token())) {
+    // Cancelled while waiting for the budget.
+    NoBarrier_Store(&internal_file_error_, -1);
+    flush_complete_event_.Signal();
+    return false;
+  }
+  TRACE_EVENT1("packager", "ThreadedIoFile::WriteInternal", "bytes", size);
+  uint64_t bytes_written(0);
+  while (bytes_written < size) {
+    int64_t write_result =
+        internal_file_->Write(data + bytes_written, size - bytes_written);
+    if (write_result < 0) {
+      NoBarrier_Store(&internal_file_error_, write_result);
+      cache_.Close();
+      flush_complete_event_.Signal();
+      return false;
     }
+    bytes_written += write_result;
   }
+  return true;
 }
 
 }  // namespace media
@@ -7,9 +7,17 @@
 #ifndef PACKAGER_FILE_THREADED_IO_FILE_H_
 #define PACKAGER_FILE_THREADED_IO_FILE_H_
 
+#include <string>
+#include <vector>
+
 #include "packager/base/atomicops.h"
+#include "packager/base/memory/ref_counted.h"
 #include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/synchronization/lock.h"
 #include "packager/base/synchronization/waitable_event.h"
+#include "packager/base/time/time.h"
+#include "packager/media/base/io_throttle.h"
+#include "packager/media/base/job_resource_usage.h"
 #include "packager/media/file/file.h"
 #include "packager/media/file/file_closer.h"
 #include "packager/media/file/io_cache.h"
@@ -25,10 +33,55 @@ class ThreadedIoFile : public File {
     kOutputMode
   };
 
+  /// Statistics of the read-ahead of a file in input mode.
+  struct ReadAheadStats {
+    ReadAheadStats();
+
+    /// The current size of the reads of the internal file.
+    uint64_t block_size;
+    /// The current size of the cache.
+    uint64_t cache_size;
+    uint64_t bytes_read;
+    uint64_t num_reads;
+    /// The time spent in the reads of the internal file.
+    base::TimeDelta read_time;
+    /// The number of times the reader found the cache empty.
+    uint64_t num_underruns;
+  };
+
+  /// Statistics of the writes of a file in output mode.
+  struct WriteStats {
+    WriteStats();
+
+    /// The current size of the cache.
+    uint64_t cache_size;
+    /// The number of writes which waited for room in the cache.
+    uint64_t num_stalls;
+    /// The time spent by the writer waiting for room in the cache.
+    base::TimeDelta stall_time;
+    /// The number of bytes written to the spool.
+    uint64_t bytes_spooled;
+  };
+
+  /// @param io_cache_size is the initial size of the cache.
+  /// @param io_block_size is the initial size of the reads and writes of
+  ///        the internal file.
+  /// @param max_io_cache_size enables the adaptive read-ahead of files in
+  ///        input mode if larger than @a io_cache_size. When the reader finds
+  ///        the cache empty, the block size grows as long as larger reads
+  ///        have a higher throughput, and the cache grows to hide the latency
+  ///        of the reads at the rate of the reader, up to this size.
+  ///        In output mode, it lets the cache absorb bursts of writes: when a
+  ///        write finds the cache full, the cache doubles, up to this size, as
+  ///        long as the memory is under its soft limits, see MemoryTracker.
+  /// A thread of the file I/O queue of the BackgroundExecutor must have been
+  /// reserved for the file; the reservation is released when the file is
+  /// destroyed.
   ThreadedIoFile(scoped_ptr<File, FileCloser> internal_file,
                  Mode mode,
                  uint64_t io_cache_size,
-                 uint64_t io_block_size);
+                 uint64_t io_block_size,
+                 uint64_t max_io_cache_size);
 
   /// @name File implementation overrides.
   /// @{
@@ -39,12 +92,33 @@ class ThreadedIoFile : public File {
   bool Flush() override;
   bool Seek(uint64_t position) override;
   bool Tell(uint64_t* position) override;
+  uint64_t GetCachedSize() override;
   /// @}
 
+  /// @return The statistics of the read-ahead. Can be called from any
+  ///         thread.
+  ReadAheadStats GetReadAheadStats();
+
+  /// @return The statistics of the writes. Can be called from any thread.
+  WriteStats GetWriteStats();
+
+  /// Spool the writes to a local file instead of waiting when the cache of a
+  /// file in output mode is full and cannot grow, e.g. while the storage of
+  /// the file stalls. The spool is written to the file after the cache, so
+  /// the data stays in order, and the writes return to the cache once the
+  /// spool has been written. Should be called before Open().
+  /// @param spool_dir is the directory of the spool file, which is created
+  ///        when first needed and deleted with the file. Empty to wait for
+  ///        the cache instead, which is the default.
+  void set_output_spool_dir(const std::string& spool_dir) {
+    spool_dir_ = spool_dir;
+  }
+
  protected:
   ~ThreadedIoFile() override;
 
   bool Open() override;
+  void SetExpectedSize(uint64_t size) override;
 
  private:
   // Internal task handler implementation. Will dispatch to either
@@ -52,19 +126,78 @@ class ThreadedIoFile : public File {
   void TaskHandler();
   void RunInInputMode();
   void RunInOutputMode();
+  // Grows the read-ahead if the reader waits for it.
+  void AdaptReadAhead();
+  // Grows the cache for a write of |length| bytes which does not fit in it.
+  // Writer thread only.
+  void GrowOutputCache(uint64_t length);
+  // Writes |buffer| to the spool, starting to spool if needed. Sets |spooled|
+  // to false, and does nothing, if |buffer| fits in the cache or the spool
+  // cannot be opened. Writer thread only. Returns false on error.
+  bool WriteToSpool(const void* buffer, uint64_t length, bool* spooled);
+  // Creates the spool file, if not done yet. |spool_lock_| must be held.
+  bool OpenSpoolFile();
+  // Writes the next block of the spool to |internal_file_|, once the cache
+  // has been written. Sets |written| to false if there is nothing to write
+  // from the spool. Returns false on error.
+  bool WriteFromSpool(bool* written);
+  // Seeks the spool file. |spool_lock_| must be held.
+  bool SeekSpoolFile(uint64_t position);
+  // Writes |data| to |internal_file_|. Returns false on error.
+  bool WriteInternal(const uint8_t* data, uint64_t size);
 
   scoped_ptr<File, FileCloser> internal_file_;
   const Mode mode_;
   IoCache cache_;
-  std::vector<uint8_t> io_buffer_;
+  // The size of the reads and writes of |internal_file_|.
+  uint64_t io_block_size_;
   uint64_t position_;
   uint64_t size_;
   base::subtle::Atomic32 eof_;
   bool flushing_;
   base::WaitableEvent flush_complete_event_;
   base::subtle::Atomic32 internal_file_error_;
+  // The I/O budget of the job opening the file, NULL if unlimited.
+  scoped_refptr<IoThrottle> io_throttle_;
+  // The resource usage of the job opening the file, NULL if not accounted.
+  scoped_refptr<JobResourceUsage> resource_usage_;
   // Signalled when thread task exits.
   base::WaitableEvent task_exit_event_;
+  // The CPUs the thread task runs on, those of the thread opening the file.
+  std::vector<int> cpus_;
+
+  // The state of the adaptive read-ahead, used by the thread task only.
+  const bool adaptive_read_ahead_;
+  const uint64_t max_io_cache_size_;
+  uint64_t last_num_underruns_;
+  base::TimeTicks last_adapt_time_;
+  uint64_t last_adapt_bytes_consumed_;
+  // The reads at the current block size, and the throughput of the reads at
+  // the previous block size.
+  uint64_t block_num_reads_;
+  uint64_t block_bytes_read_;
+  base::TimeDelta block_read_time_;
+  double previous_block_throughput_;
+
+  // The state of the adaptive output cache, used by the writer only.
+  const bool adaptive_output_cache_;
+
+  // The spool of the writes, see set_output_spool_dir(). |spooling_| is set
+  // by the writer and cleared by the thread task, under |spool_lock_|.
+  std::string spool_dir_;
+  base::subtle::Atomic32 spooling_;
+  base::Lock spool_lock_;  // Lock protecting the spool file and positions.
+  scoped_ptr<File, FileCloser> spool_file_;
+  std::string spool_file_name_;
+  uint64_t spool_read_position_;
+  uint64_t spool_write_position_;
+  uint64_t spool_file_position_;
+  // Used by the thread task only.
+  std::vector<uint8_t> spool_buffer_;
+
+  base::Lock stats_lock_;  // Lock protecting |stats_| and |write_stats_|.
+  ReadAheadStats stats_;
+  WriteStats write_stats_;
 
   DISALLOW_COPY_AND_ASSIGN(ThreadedIoFile);
 };
@@ -12,12 +12,17 @@
 #include <string>
 
 #include "packager/base/compiler_specific.h"
+#include "packager/base/memory/scoped_ptr.h"
 #include "packager/media/file/file.h"
 
 namespace edash_packager {
 namespace media {
 
 /// Implements UdpFile, which receives UDP unicast and multicast streams.
+/// On Linux, a Read() receives a batch of datagrams with a single recvmmsg()
+/// call. With --udp_receive_thread, the datagrams are received on a dedicated
+/// thread and queued in a lock-free ring, so the socket is drained even when
+/// the reader is busy.
 class UdpFile : public File {
  public:
   /// @param file_name C string containing the address of the stream to receive.
@@ -27,7 +32,12 @@ class UdpFile : public File {
   /// @name File implementation overrides.
   /// @{
   bool Close() override;
+  /// Reads as many whole datagrams as available and fitting in @a buffer,
+  /// blocking until there is at least one.
   int64_t Read(void* buffer, uint64_t length) override;
+  /// Returns kWouldBlock if no datagram has been received yet. With
+  /// --udp_receive_thread or a jitter buffer, waits like Read().
+  int64_t TryRead(void* buffer, uint64_t length) override;
   int64_t Write(const void* buffer, uint64_t length) override;
   int64_t Size() override;
   bool Flush() override;
@@ -41,7 +51,11 @@ class UdpFile : public File {
   bool Open() override;
 
  private:
+  // Receives the datagrams and keeps the receive statistics.
+  class Receiver;
+
   int socket_;
+  scoped_ptr<Receiver> receiver_;
 
   DISALLOW_COPY_AND_ASSIGN(UdpFile);
 };
@@ -8,15 +8,39 @@
 
 #include <arpa/inet.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <gflags/gflags.h>
+#include <poll.h>
+#include <string.h>
 #include <strings.h>
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <limits>
-
+#include <map>
+#include <vector>
+
+#include "packager/base/atomicops.h"
+#include "packager/base/bind.h"
+#include "packager/base/bind_helpers.h"
+#include "packager/base/callback.h"
+#include "packager/base/lazy_instance.h"
 #include "packager/base/logging.h"
+#include "packager/base/posix/eintr_wrapper.h"
 #include "packager/base/strings/string_number_conversions.h"
+#include "packager/base/synchronization/lock.h"
+#include "packager/base/synchronization/waitable_event.h"
+#include "packager/base/time/time.h"
+#include "packager/media/base/closure_thread.h"
+#include "packager/media/base/spsc_ring_buffer.h"
+#include "packager/media/file/rtp_fec_decoder.h"
+#include "packager/media/file/udp_jitter_buffer.h"
+
+#if defined(OS_LINUX)
+#include <sys/epoll.h>
+#endif
 
 // TODO(tinskip): Adapt to work with winsock.
 
@@ -24,6 +48,52 @@ DEFINE_string(udp_interface_address,
               "0.0.0.0",
               "IP address of the interface over which to receive UDP unicast"
               " or multicast streams");
+DEFINE_int32(udp_socket_receive_buffer_size,
+             0,
+             "Size of the receive buffer (SO_RCVBUF) of UDP sockets, in "
+             "bytes. A large buffer absorbs the bursts of the senders. "
+             "Specify 0 to keep the system default.");
+DEFINE_int32(udp_datagrams_per_read,
+             32,
+             "Linux only. Maximum number of UDP datagrams received by a "
+             "single recvmmsg() call.");
+DEFINE_bool(udp_receive_thread,
+            false,
+            "Receive UDP datagrams on a dedicated thread, which queues them "
+            "in a lock-free ring until they are read, so the socket is "
+            "drained even when the reader is busy.");
+DEFINE_bool(udp_shared_receiver,
+            false,
+            "Linux only. Receive the UDP datagrams of all the inputs on a "
+            "single thread, which waits for their sockets with epoll and "
+            "queues the datagrams in the ring of each input, instead of a "
+            "receive thread per input. Implies udp_receive_thread.");
+DEFINE_int32(udp_receive_ring_size,
+             4096,
+             "Number of UDP datagrams queued by udp_receive_thread. "
+             "Datagrams received while the ring is full are dropped.");
+DEFINE_int32(udp_jitter_buffer_ms,
+             0,
+             "Hold the UDP datagrams of MPEG-2 TS streams for this many "
+             "milliseconds to reorder them by RTP sequence number, if "
+             "present, and release them at the pace of their PCR, which "
+             "evens out the bursts of jittery networks. Implies "
+             "udp_receive_thread. Specify 0 to disable.");
+DEFINE_bool(udp_rtp,
+            false,
+            "Receive MPEG-2 TS over RTP: remove the RTP headers and read the "
+            "payloads in sequence number order, waiting up to "
+            "udp_rtp_max_delay_packets packets for the missing ones. Implies "
+            "udp_receive_thread.");
+DEFINE_bool(udp_rtp_fec,
+            false,
+            "Recover the lost RTP packets with the SMPTE 2022-1 column and "
+            "row FEC streams, received on the ports 2 and 4 above the media "
+            "port. Implies udp_rtp.");
+DEFINE_int32(udp_rtp_max_delay_packets,
+             200,
+             "Number of newer RTP packets received before a missing packet is "
+             "given up on. With udp_rtp_fec, it should cover the FEC matrix.");
 
 namespace edash_packager {
 namespace media {
@@ -31,6 +101,13 @@ namespace media {
 namespace {
 
 const int kInvalidSocket(-1);
+const size_t kMaxDatagramSize = 65535;
+// How often the receive thread checks whether it should stop, and how long
+// an RTP stream may stall before its missing packets are given up on.
+const int kReceiveTimeoutInMs = 100;
+#if defined(OS_LINUX)
+const size_t kControlSize = CMSG_SPACE(sizeof(uint32_t));
+#endif
 
 bool StringToIpv4Address(const std::string& addr_in, uint32_t* addr_out) {
   DCHECK(addr_out);
@@ -79,8 +156,564 @@ bool IsIpv4MulticastAddress(uint32_t addr) {
   return (addr & 0xf0000000) == 0xe0000000;
 }
 
+#if defined(OS_LINUX)
+// Waits for the sockets of all the UDP inputs with a single epoll instance,
+// on a single thread, and runs the handler of each socket which is readable.
+// Used with --udp_shared_receiver.
+class UdpReactor {
+ public:
+  // Runs on the reactor thread when the socket is readable, or with
+  // |readable| false when it has not been for kReceiveTimeoutInMs.
+  // Returns false to unregister the socket.
+  typedef base::Callback<bool(bool readable)> Handler;
+
+  UdpReactor() : epoll_fd_(-1) {}
+
+  // |socket| should be non-blocking, since it stays readable until it is
+  // drained: the handler should receive one batch of datagrams, so that the
+  // other sockets are serviced in between.
+  bool Register(int socket, const Handler& handler) {
+    base::AutoLock l(lock_);
+    if (!thread_) {
+      epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+      if (epoll_fd_ < 0) {
+        PLOG(ERROR) << "Failed to create the epoll instance.";
+        return false;
+      }
+      thread_.reset(new ClosureThread(
+          "UdpReactor", base::Bind(&UdpReactor::Run, base::Unretained(this))));
+      thread_->Start();
+    }
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = socket;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, socket, &event) < 0) {
+      PLOG(ERROR) << "Failed to add the socket to the epoll instance.";
+      return false;
+    }
+    Registration& registration = registrations_[socket];
+    registration.handler = handler;
+    registration.last_event_time = base::TimeTicks::Now();
+    return true;
+  }
+
+  // Once it returns, the handler of |socket| is not running and does not run
+  // anymore, so the socket can be closed.
+  void Unregister(int socket) {
+    base::AutoLock l(lock_);
+    std::map<int, Registration>::iterator it = registrations_.find(socket);
+    if (it != registrations_.end())
+      RemoveRegistration(it);
+  }
+
+ private:
+  struct Registration {
+    Handler handler;
+    base::TimeTicks last_event_time;
+  };
+
+  // The handlers run with |lock_| held, which is what Unregister() waits for.
+  void Run() {
+    std::vector<struct epoll_event> events(64);
+    const base::TimeDelta timeout =
+        base::TimeDelta::FromMilliseconds(kReceiveTimeoutInMs);
+    base::TimeTicks last_timeout_check = base::TimeTicks::Now();
+    while (true) {
+      const int num_events =
+          HANDLE_EINTR(epoll_wait(epoll_fd_, &events[0], events.size(),
+                                  kReceiveTimeoutInMs));
+      PCHECK(num_events >= 0) << "Failed to wait for the UDP sockets.";
+      const base::TimeTicks now = base::TimeTicks::Now();
+
+      base::AutoLock l(lock_);
+      // Events of the sockets unregistered since the wait are ignored.
+      for (int i = 0; i < num_events; ++i) {
+        std::map<int, Registration>::iterator it =
+            registrations_.find(events[i].data.fd);
+        if (it == registrations_.end())
+          continue;
+        it->second.last_event_time = now;
+        if (!it->second.handler.Run(true))
+          RemoveRegistration(it);
+      }
+
+      if (now - last_timeout_check < timeout)
+        continue;
+      last_timeout_check = now;
+      std::map<int, Registration>::iterator it = registrations_.begin();
+      while (it != registrations_.end()) {
+        std::map<int, Registration>::iterator current = it++;
+        if (now - current->second.last_event_time >= timeout &&
+            !current->second.handler.Run(false)) {
+          RemoveRegistration(current);
+        }
+      }
+    }
+  }
+
+  void RemoveRegistration(std::map<int, Registration>::iterator it) {
+    lock_.AssertAcquired();
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, it->first, NULL) < 0)
+      PLOG(WARNING) << "Failed to remove the socket from the epoll instance.";
+    registrations_.erase(it);
+  }
+
+  base::Lock lock_;  // Lock protecting the variables below.
+  int epoll_fd_;
+  std::map<int, Registration> registrations_;
+  // Never stopped, as the reactor is leaked.
+  scoped_ptr<ClosureThread> thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(UdpReactor);
+};
+
+base::LazyInstance<UdpReactor>::Leaky g_udp_reactor =
+    LAZY_INSTANCE_INITIALIZER;
+#endif  // defined(OS_LINUX)
+
 }  // anonymous namespace
 
+class UdpFile::Receiver {
+ public:
+  Receiver(int socket, const std::string& file_name)
+      : socket_(socket),
+        file_name_(file_name),
+        datagrams_per_read_(
+            static_cast<size_t>(std::max(FLAGS_udp_datagrams_per_read, 1))),
+        sizes_(datagrams_per_read_),
+        num_datagrams_(0),
+        num_kernel_drops_(0),
+        num_truncated_(0),
+        num_ring_overruns_(0),
+        num_invalid_rtp_(0),
+        pending_(NULL),
+        data_available_(false, false),
+        stop_(0),
+        receive_failed_(0),
+        shared_(false) {
+#if defined(OS_LINUX)
+    messages_.resize(datagrams_per_read_);
+    iovecs_.resize(datagrams_per_read_);
+    control_.resize(datagrams_per_read_ * kControlSize);
+#endif
+  }
+
+  ~Receiver() {
+    if (thread_) {
+      base::subtle::Release_Store(&stop_, 1);
+      thread_->Join();
+    }
+#if defined(OS_LINUX)
+    if (shared_)
+      g_udp_reactor.Get().Unregister(socket_);
+#endif
+    for (int fec_socket : fec_sockets_)
+      close(fec_socket);
+    LOG_IF(WARNING, num_kernel_drops_ || num_truncated_ || num_ring_overruns_)
+        << "UDP stream " << file_name_ << ": received " << num_datagrams_
+        << " datagrams, " << num_kernel_drops_
+        << " dropped by the socket, " << num_truncated_ << " truncated, "
+        << num_ring_overruns_ << " dropped by the receive ring.";
+    LOG_IF(WARNING, jitter_buffer_ && (jitter_buffer_->num_reordered() ||
+                                       jitter_buffer_->num_lost() ||
+                                       jitter_buffer_->num_dropped()))
+        << "UDP stream " << file_name_ << ": "
+        << jitter_buffer_->num_reordered() << " datagrams reordered, "
+        << jitter_buffer_->num_lost() << " lost, "
+        << jitter_buffer_->num_dropped() << " dropped as late or duplicate, "
+        << jitter_buffer_->num_pcr_resyncs() << " PCR resyncs.";
+    LOG_IF(WARNING, rtp_decoder_ && (num_invalid_rtp_ ||
+                                     rtp_decoder_->num_recovered() ||
+                                     rtp_decoder_->num_lost() ||
+                                     rtp_decoder_->num_dropped()))
+        << "RTP stream " << file_name_ << ": " << num_invalid_rtp_
+        << " invalid packets, " << rtp_decoder_->num_recovered()
+        << " recovered with FEC, " << rtp_decoder_->num_lost() << " lost, "
+        << rtp_decoder_->num_dropped() << " dropped as late or duplicate.";
+  }
+
+  // Depacketizes the RTP stream on the receiving thread, recovering its lost
+  // packets with the FEC streams received on |fec_sockets|, if any. Takes
+  // ownership of |fec_sockets|. Must be called before StartThread() or
+  // StartSharedReceiver().
+  void EnableRtp(size_t max_delay_packets,
+                 const std::vector<int>& fec_sockets) {
+    DCHECK(!filled_);
+    rtp_decoder_.reset(new RtpFecDecoder(max_delay_packets));
+    fec_sockets_ = fec_sockets;
+    if (!fec_sockets_.empty())
+      fec_scratch_.resize(kMaxDatagramSize);
+  }
+
+  // Starts receiving the datagrams on a dedicated thread. With a positive
+  // |jitter_buffer_delay|, they are read through a UdpJitterBuffer.
+  bool StartThread(size_t ring_size, base::TimeDelta jitter_buffer_delay) {
+    DCHECK(!filled_);
+    struct timeval timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_usec = kReceiveTimeoutInMs * 1000;
+    if (setsockopt(socket_, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+                   sizeof(timeout)) < 0) {
+      PLOG(ERROR) << "Failed to set the receive timeout.";
+      return false;
+    }
+    CreateRing(ring_size, jitter_buffer_delay);
+
+    thread_.reset(new ClosureThread(
+        "UdpReceiver",
+        base::Bind(&Receiver::ReceiveLoop, base::Unretained(this))));
+    thread_->Start();
+    return true;
+  }
+
+  // Same as StartThread(), but the datagrams are received on the thread of
+  // the UdpReactor shared by all the UDP inputs.
+  bool StartSharedReceiver(size_t ring_size,
+                           base::TimeDelta jitter_buffer_delay) {
+    DCHECK(!filled_);
+#if defined(OS_LINUX)
+    const int flags = fcntl(socket_, F_GETFL);
+    if (flags < 0 || fcntl(socket_, F_SETFL, flags | O_NONBLOCK) < 0) {
+      PLOG(ERROR) << "Failed to make the socket non-blocking.";
+      return false;
+    }
+    CreateRing(ring_size, jitter_buffer_delay);
+
+    if (!g_udp_reactor.Get().Register(
+            socket_, base::Bind(&Receiver::OnSocketEvent,
+                                base::Unretained(this)))) {
+      return false;
+    }
+    shared_ = true;
+    return true;
+#else
+    NOTIMPLEMENTED() << "The shared UDP receiver requires epoll.";
+    return false;
+#endif
+  }
+
+  // Returns false if Read() would wait for a datagram. Reads from the
+  // jitter buffer may wait anyway.
+  bool CanReadWithoutWaiting() {
+    if (jitter_buffer_)
+      return true;
+    if (filled_) {
+      return pending_ || !filled_->Empty() ||
+             base::subtle::Acquire_Load(&receive_failed_);
+    }
+    struct pollfd poll_fd = {socket_, POLLIN, 0};
+    return poll(&poll_fd, 1, 0) != 0;
+  }
+
+  int64_t Read(uint8_t* buffer, uint64_t length) {
+    if (jitter_buffer_)
+      return ReadFromJitterBuffer(buffer, length);
+    if (filled_)
+      return ReadFromRing(buffer, length);
+
+    // Receive into |kMaxDatagramSize| slots of |buffer|, then pack the
+    // datagrams.
+    const size_t num_slots = std::max<size_t>(
+        1, std::min<size_t>(datagrams_per_read_, length / kMaxDatagramSize));
+    const size_t slot_size = num_slots == 1 ? length : kMaxDatagramSize;
+    int num_received;
+    do {
+      num_received = ReceiveBatch(buffer, slot_size, num_slots);
+    } while (num_received == 0);
+    if (num_received < 0)
+      return -1;
+
+    uint64_t size = sizes_[0];
+    for (int i = 1; i < num_received; ++i) {
+      memmove(buffer + size, buffer + i * slot_size, sizes_[i]);
+      size += sizes_[i];
+    }
+    return size;
+  }
+
+ private:
+  // Receives up to |num_slots| datagrams, each into a |slot_size| slot of
+  // |buffer|. Their sizes are stored in |sizes_|.
+  // Returns the number of datagrams received, 0 on timeout or -1 on error.
+  int ReceiveBatch(uint8_t* buffer, size_t slot_size, size_t num_slots) {
+    DCHECK_LE(num_slots, datagrams_per_read_);
+#if defined(OS_LINUX)
+    for (size_t i = 0; i < num_slots; ++i) {
+      iovecs_[i].iov_base = buffer + i * slot_size;
+      iovecs_[i].iov_len = slot_size;
+      struct msghdr* header = &messages_[i].msg_hdr;
+      memset(header, 0, sizeof(*header));
+      header->msg_iov = &iovecs_[i];
+      header->msg_iovlen = 1;
+      header->msg_control = &control_[i * kControlSize];
+      header->msg_controllen = kControlSize;
+    }
+    int result;
+    do {
+      result = recvmmsg(socket_, &messages_[0], num_slots, MSG_WAITFORONE,
+                        NULL);
+    } while ((result == -1) && (errno == EINTR));
+    if (result < 0)
+      return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+
+    for (int i = 0; i < result; ++i) {
+      struct msghdr* header = &messages_[i].msg_hdr;
+      sizes_[i] = messages_[i].msg_len;
+      if (header->msg_flags & MSG_TRUNC)
+        ++num_truncated_;
+      // SO_RXQ_OVFL reports the number of datagrams dropped by the socket so
+      // far.
+      for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(header); cmsg;
+           cmsg = CMSG_NXTHDR(header, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL)
+          memcpy(&num_kernel_drops_, CMSG_DATA(cmsg), sizeof(uint32_t));
+      }
+    }
+#else
+    int64_t size;
+    do {
+      size = recvfrom(socket_, buffer, slot_size, 0, NULL, 0);
+    } while ((size == -1) && (errno == EINTR));
+    if (size < 0)
+      return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+    sizes_[0] = size;
+    const int result = 1;
+#endif
+    num_datagrams_ += result;
+    return result;
+  }
+
+  // Creates the ring through which the datagrams are passed to the reader.
+  void CreateRing(size_t ring_size, base::TimeDelta jitter_buffer_delay) {
+    scratch_.resize(datagrams_per_read_ * kMaxDatagramSize);
+    datagrams_.resize(ring_size);
+    filled_.reset(new SpscRingBuffer<Datagram*>(ring_size));
+    free_.reset(new SpscRingBuffer<Datagram*>(ring_size));
+    for (Datagram& datagram : datagrams_)
+      CHECK(free_->TryPush(&datagram));
+    if (jitter_buffer_delay > base::TimeDelta())
+      jitter_buffer_.reset(new UdpJitterBuffer(jitter_buffer_delay, ring_size));
+  }
+
+  // Runs on |thread_|.
+  void ReceiveLoop() {
+    while (!base::subtle::Acquire_Load(&stop_)) {
+      const int num_received = ReceiveIntoRing();
+      if (num_received < 0)
+        return;
+      if (num_received == 0 && rtp_decoder_)
+        DecodeRtp(0, base::TimeTicks::Now());
+    }
+  }
+
+  // Runs on the thread of the UdpReactor. See UdpReactor::Handler.
+  bool OnSocketEvent(bool readable) {
+    if (readable)
+      return ReceiveIntoRing() >= 0;
+    if (rtp_decoder_)
+      DecodeRtp(0, base::TimeTicks::Now());
+    return true;
+  }
+
+  // Runs on the receiving thread, which is the only one popping |free_| and
+  // pushing |filled_|. Receives a batch of datagrams and queues them, or
+  // their RTP payloads. Returns the number of datagrams received, or -1
+  // after reporting a failure to the reader.
+  int ReceiveIntoRing() {
+    const int num_received =
+        ReceiveBatch(&scratch_[0], kMaxDatagramSize, datagrams_per_read_);
+    const base::TimeTicks receive_time = base::TimeTicks::Now();
+    if (num_received < 0) {
+      PLOG(ERROR) << "Failed to receive from " << file_name_;
+      base::subtle::Release_Store(&receive_failed_, 1);
+      data_available_.Signal();
+      return -1;
+    }
+    if (num_received == 0)
+      return 0;
+    if (rtp_decoder_) {
+      DecodeRtp(num_received, receive_time);
+      return num_received;
+    }
+    for (int i = 0; i < num_received; ++i) {
+      Datagram* datagram = NULL;
+      if (!free_->TryPop(&datagram)) {
+        ++num_ring_overruns_;
+        continue;
+      }
+      const uint8_t* data = &scratch_[i * kMaxDatagramSize];
+      datagram->data.assign(data, data + sizes_[i]);
+      datagram->receive_time = receive_time;
+      CHECK(filled_->TryPush(datagram));
+    }
+    data_available_.Signal();
+    return num_received;
+  }
+
+  // Runs on the receiving thread. Feeds the |num_received| datagrams in
+  // |scratch_| and the pending FEC packets to |rtp_decoder_|, and queues the
+  // payloads it releases.
+  void DecodeRtp(int num_received, base::TimeTicks receive_time) {
+    for (int i = 0; i < num_received; ++i) {
+      if (!rtp_decoder_->AddMediaPacket(&scratch_[i * kMaxDatagramSize],
+                                        sizes_[i])) {
+        ++num_invalid_rtp_;
+      }
+    }
+    for (int fec_socket : fec_sockets_) {
+      while (true) {
+        const ssize_t size = recv(fec_socket, &fec_scratch_[0],
+                                  fec_scratch_.size(), MSG_DONTWAIT);
+        if (size < 0) {
+          if (errno == EINTR)
+            continue;
+          break;
+        }
+        if (!rtp_decoder_->AddFecPacket(&fec_scratch_[0], size))
+          ++num_invalid_rtp_;
+      }
+    }
+    // Nothing to wait for when the stream stalls.
+    if (num_received == 0)
+      rtp_decoder_->SkipMissingPackets();
+
+    bool released = false;
+    while (rtp_decoder_->PopPayload(&payload_)) {
+      Datagram* datagram = NULL;
+      if (!free_->TryPop(&datagram)) {
+        ++num_ring_overruns_;
+        continue;
+      }
+      datagram->data.swap(payload_);
+      datagram->receive_time = receive_time;
+      CHECK(filled_->TryPush(datagram));
+      released = true;
+    }
+    if (released)
+      data_available_.Signal();
+  }
+
+  // Only the reading thread pops |filled_| and pushes |free_|.
+  int64_t ReadFromRing(uint8_t* buffer, uint64_t length) {
+    uint64_t size = 0;
+    while (true) {
+      if (!pending_ && !filled_->TryPop(&pending_)) {
+        if (size > 0)
+          return size;
+        // The datagrams received before the failure are read first.
+        if (base::subtle::Acquire_Load(&receive_failed_))
+          return -1;
+        data_available_.Wait();
+        continue;
+      }
+      // Keep the datagram for the next read if it does not fit.
+      if (size + pending_->data.size() > length && size > 0)
+        return size;
+      const size_t datagram_size =
+          std::min<uint64_t>(pending_->data.size(), length);
+      if (datagram_size > 0)
+        memcpy(buffer + size, &pending_->data[0], datagram_size);
+      size += datagram_size;
+      CHECK(free_->TryPush(pending_));
+      pending_ = NULL;
+    }
+  }
+
+  // Same as ReadFromRing(), through |jitter_buffer_|.
+  int64_t ReadFromJitterBuffer(uint8_t* buffer, uint64_t length) {
+    uint64_t size = 0;
+    while (true) {
+      // Loaded first, so that the datagrams received before the failure are
+      // drained, then released without delay.
+      const bool receive_failed =
+          base::subtle::Acquire_Load(&receive_failed_) != 0;
+      Datagram* datagram = NULL;
+      while (filled_->TryPop(&datagram)) {
+        jitter_buffer_->Push(datagram->data.empty() ? NULL : &datagram->data[0],
+                             datagram->data.size(), datagram->receive_time);
+        CHECK(free_->TryPush(datagram));
+      }
+
+      const base::TimeTicks now = base::TimeTicks::Now();
+      while (!released_.empty() ||
+             jitter_buffer_->Pop(
+                 receive_failed ? jitter_buffer_->NextReleaseTime() : now,
+                 &released_)) {
+        // Keep the datagram for the next read if it does not fit.
+        if (size + released_.size() > length && size > 0)
+          return size;
+        const size_t datagram_size =
+            std::min<uint64_t>(released_.size(), length);
+        if (datagram_size > 0)
+          memcpy(buffer + size, &released_[0], datagram_size);
+        size += datagram_size;
+        released_.clear();
+      }
+      if (size > 0)
+        return size;
+      if (receive_failed)
+        return -1;
+
+      const base::TimeTicks release_time = jitter_buffer_->NextReleaseTime();
+      if (release_time.is_null()) {
+        data_available_.Wait();
+      } else if (release_time > now) {
+        data_available_.TimedWait(release_time - now);
+      }
+    }
+  }
+
+  const int socket_;
+  const std::string file_name_;
+  const size_t datagrams_per_read_;
+#if defined(OS_LINUX)
+  std::vector<struct mmsghdr> messages_;
+  std::vector<struct iovec> iovecs_;
+  std::vector<uint8_t> control_;
+#endif
+  std::vector<size_t> sizes_;
+
+  // Statistics, updated by the receiving thread.
+  uint64_t num_datagrams_;
+  uint32_t num_kernel_drops_;
+  uint64_t num_truncated_;
+  uint64_t num_ring_overruns_;
+  uint64_t num_invalid_rtp_;
+
+  // Used with a receiving thread only. |datagrams_| owns the buffers which
+  // are passed around through |free_| and |filled_|.
+  struct Datagram {
+    std::vector<uint8_t> data;
+    base::TimeTicks receive_time;
+  };
+  std::vector<uint8_t> scratch_;
+  std::vector<Datagram> datagrams_;
+  scoped_ptr<SpscRingBuffer<Datagram*> > filled_;
+  scoped_ptr<SpscRingBuffer<Datagram*> > free_;
+  // The datagram popped from |filled_| which did not fit in the last read.
+  Datagram* pending_;
+  // Set with --udp_jitter_buffer_ms, with the datagram released which did
+  // not fit in the last read.
+  scoped_ptr<UdpJitterBuffer> jitter_buffer_;
+  std::vector<uint8_t> released_;
+  // Set with --udp_rtp, with the FEC sockets of --udp_rtp_fec and the
+  // buffers used to receive the FEC packets and release the payloads.
+  scoped_ptr<RtpFecDecoder> rtp_decoder_;
+  std::vector<int> fec_sockets_;
+  std::vector<uint8_t> fec_scratch_;
+  std::vector<uint8_t> payload_;
+  base::WaitableEvent data_available_;
+  base::subtle::Atomic32 stop_;
+  base::subtle::Atomic32 receive_failed_;
+  scoped_ptr<ClosureThread> thread_;
+  // Set if the datagrams are received on the UdpReactor thread instead of
+  // |thread_|.
+  bool shared_;
+
+  DISALLOW_COPY_AND_ASSIGN(Receiver);
+};
+
 UdpFile::UdpFile(const char* file_name) :
     File(file_name),
     socket_(kInvalidSocket) {}
@@ -88,6 +721,8 @@ UdpFile::UdpFile(const char* file_name) :
 UdpFile::~UdpFile() {}
 
 bool UdpFile::Close() {
+  // Stops the receive thread before the socket is closed.
+  receiver_.reset();
   if (socket_ != kInvalidSocket) {
     close(socket_);
     socket_ = kInvalidSocket;
@@ -104,12 +739,15 @@ int64_t UdpFile::Read(void* buffer, uint64_t length) {
   if (socket_ == kInvalidSocket)
     return -1;
 
-  int64_t result;
-  do {
-    result = recvfrom(socket_, buffer, length, 0, NULL, 0);
-  } while ((result == -1) && (errno == EINTR));
+  return receiver_->Read(static_cast<uint8_t*>(buffer), length);
+}
 
-  return result;
+int64_t UdpFile::TryRead(void* buffer, uint64_t length) {
+  if (socket_ == kInvalidSocket)
+    return -1;
+  if (!receiver_->CanReadWithoutWaiting())
+    return kWouldBlock;
+  return Read(buffer, length);
 }
 
 int64_t UdpFile::Write(const void* buffer, uint64_t length) {
@@ -163,23 +801,16 @@ class ScopedSocket {
   DISALLOW_COPY_AND_ASSIGN(ScopedSocket);
 };
 
-bool UdpFile::Open() {
-  DCHECK_EQ(kInvalidSocket, socket_);
-
-  // TODO(tinskip): Support IPv6 addresses.
-  uint32_t dest_addr;
-  uint16_t dest_port;
-  if (!StringToIpv4AddressAndPort(file_name(),
-                                  &dest_addr,
-                                  &dest_port)) {
-    LOG(ERROR) << "Malformed IPv4 address:port UDP stream specifier.";
-    return false;
-  }
+namespace {
 
+// Returns a UDP socket bound to |dest_addr|:|dest_port|, member of the
+// multicast group if |dest_addr| is a multicast address, or kInvalidSocket
+// on error.
+int OpenUdpSocket(uint32_t dest_addr, uint16_t dest_port) {
   ScopedSocket new_socket(socket(AF_INET, SOCK_DGRAM, 0));
   if (new_socket.get() == kInvalidSocket) {
     LOG(ERROR) << "Could not allocate socket.";
-    return false;
+    return kInvalidSocket;
   }
 
   struct sockaddr_in local_sock_addr;
@@ -191,14 +822,14 @@ bool UdpFile::Open() {
            reinterpret_cast<struct sockaddr*>(&local_sock_addr),
            sizeof(local_sock_addr))) {
     LOG(ERROR) << "Could not bind UDP socket";
-    return false;
+    return kInvalidSocket;
   }
 
   if (IsIpv4MulticastAddress(dest_addr)) {
     uint32_t if_addr;
     if (!StringToIpv4Address(FLAGS_udp_interface_address, &if_addr)) {
       LOG(ERROR) << "Malformed IPv4 address for interface.";
-      return false;
+      return kInvalidSocket;
     }
     struct ip_mreq multicast_group;
     multicast_group.imr_multiaddr.s_addr = htonl(dest_addr);
@@ -209,11 +840,115 @@ bool UdpFile::Open() {
                    &multicast_group,
                    sizeof(multicast_group)) < 0) {
       LOG(ERROR) << "Failed to join multicast group.";
-      return false;
+      return kInvalidSocket;
     }
   }
 
+  if (FLAGS_udp_socket_receive_buffer_size > 0) {
+    const int requested_size = FLAGS_udp_socket_receive_buffer_size;
+    bool size_set = false;
+#if defined(OS_LINUX)
+    // SO_RCVBUFFORCE ignores net.core.rmem_max, but requires CAP_NET_ADMIN.
+    size_set = setsockopt(new_socket.get(), SOL_SOCKET, SO_RCVBUFFORCE,
+                          &requested_size, sizeof(requested_size)) == 0;
+#endif
+    if (!size_set &&
+        setsockopt(new_socket.get(), SOL_SOCKET, SO_RCVBUF, &requested_size,
+                   sizeof(requested_size)) < 0) {
+      LOG(ERROR) << "Failed to set the UDP socket receive buffer size.";
+      return kInvalidSocket;
+    }
+    int size = 0;
+    socklen_t size_length = sizeof(size);
+    if (getsockopt(new_socket.get(), SOL_SOCKET, SO_RCVBUF, &size,
+                   &size_length) == 0 &&
+        size < requested_size) {
+      LOG(WARNING) << "The UDP socket receive buffer size is " << size
+                   << " instead of " << requested_size
+                   << ". It is capped by net.core.rmem_max.";
+    }
+  }
+
+#if defined(OS_LINUX)
+  // Reports the datagrams dropped by the socket with every datagram.
+  const int enable = 1;
+  if (setsockopt(new_socket.get(), SOL_SOCKET, SO_RXQ_OVFL, &enable,
+                 sizeof(enable)) < 0) {
+    LOG(WARNING) << "Dropped UDP datagrams cannot be counted.";
+  }
+#endif
+
+  return new_socket.release();
+}
+
+}  // anonymous namespace
+
+bool UdpFile::Open() {
+  DCHECK_EQ(kInvalidSocket, socket_);
+
+  // TODO(tinskip): Support IPv6 addresses.
+  uint32_t dest_addr;
+  uint16_t dest_port;
+  if (!StringToIpv4AddressAndPort(file_name(),
+                                  &dest_addr,
+                                  &dest_port)) {
+    LOG(ERROR) << "Malformed IPv4 address:port UDP stream specifier.";
+    return false;
+  }
+
+  ScopedSocket new_socket(OpenUdpSocket(dest_addr, dest_port));
+  if (new_socket.get() == kInvalidSocket)
+    return false;
+
+  scoped_ptr<Receiver> receiver(new Receiver(new_socket.get(), file_name()));
+  const bool rtp = FLAGS_udp_rtp || FLAGS_udp_rtp_fec;
+  if (rtp) {
+    std::vector<int> fec_sockets;
+    if (FLAGS_udp_rtp_fec) {
+      // SMPTE 2022-1: the column FEC stream is on port + 2, the row FEC
+      // stream on port + 4.
+      if (dest_port > 65535 - 4) {
+        LOG(ERROR) << "No port for the FEC streams of " << file_name();
+        return false;
+      }
+      for (uint16_t port_offset = 2; port_offset <= 4; port_offset += 2) {
+        const int fec_socket =
+            OpenUdpSocket(dest_addr, dest_port + port_offset);
+        if (fec_socket == kInvalidSocket) {
+          for (int opened_socket : fec_sockets)
+            close(opened_socket);
+          return false;
+        }
+        fec_sockets.push_back(fec_socket);
+      }
+    }
+    receiver->EnableRtp(
+        static_cast<size_t>(std::max(FLAGS_udp_rtp_max_delay_packets, 1)),
+        fec_sockets);
+  }
+
+  const base::TimeDelta jitter_buffer_delay = base::TimeDelta::FromMilliseconds(
+      std::max(FLAGS_udp_jitter_buffer_ms, 0));
+  const size_t ring_size =
+      static_cast<size_t>(std::max(FLAGS_udp_receive_ring_size, 1));
+#if defined(OS_LINUX)
+  const bool shared_receiver = FLAGS_udp_shared_receiver;
+#else
+  LOG_IF(WARNING, FLAGS_udp_shared_receiver)
+      << "udp_shared_receiver is not supported on this platform.";
+  const bool shared_receiver = false;
+#endif
+  if (shared_receiver) {
+    if (!receiver->StartSharedReceiver(ring_size, jitter_buffer_delay))
+      return false;
+  } else if ((FLAGS_udp_receive_thread || rtp ||
+              jitter_buffer_delay > base::TimeDelta()) &&
+             !receiver->StartThread(ring_size, jitter_buffer_delay)) {
+    return false;
+  }
+
   socket_ = new_socket.release();
+  receiver_ = receiver.Pass();
   return true;
 }
 
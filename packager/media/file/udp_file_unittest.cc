@@ -0,0 +1,125 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <arpa/inet.h>
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/media/file/file.h"
+#include "packager/media/file/file_closer.h"
+
+DECLARE_bool(udp_receive_thread);
+DECLARE_bool(udp_shared_receiver);
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+const char kUdpFileName[] = "udp://127.0.0.1:42321";
+const uint16_t kPort = 42321;
+const char kOtherUdpFileName[] = "udp://127.0.0.1:42322";
+const uint16_t kOtherPort = 42322;
+const size_t kDatagramSize = 1316;
+const size_t kNumDatagrams = 20;
+const size_t kReadSize = 4 * 65535;
+}  // namespace
+
+class UdpFileTest : public ::testing::TestWithParam<bool> {
+ protected:
+  void SetUp() override {
+    FLAGS_udp_receive_thread = GetParam();
+    socket_ = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_GE(socket_, 0);
+  }
+
+  void TearDown() override {
+    if (socket_ >= 0)
+      close(socket_);
+  }
+
+  void Send(const std::string& datagram) { SendTo(kPort, datagram); }
+
+  void SendTo(uint16_t port, const std::string& datagram) {
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(static_cast<ssize_t>(datagram.size()),
+              sendto(socket_, datagram.data(), datagram.size(), 0,
+                     reinterpret_cast<struct sockaddr*>(&address),
+                     sizeof(address)));
+  }
+
+  google::FlagSaver flag_saver_;
+  int socket_;
+};
+
+TEST_P(UdpFileTest, ReceiveDatagrams) {
+  scoped_ptr<File, FileCloser> file(
+      File::OpenWithNoBuffering(kUdpFileName, "r"));
+  ASSERT_TRUE(file);
+
+  std::string sent;
+  for (size_t i = 0; i < kNumDatagrams; ++i) {
+    const std::string datagram(kDatagramSize, static_cast<char>(i));
+    Send(datagram);
+    sent += datagram;
+  }
+
+  // A read returns whole datagrams, as many as available.
+  std::string received;
+  std::vector<char> buffer(kReadSize);
+  while (received.size() < sent.size()) {
+    const int64_t size = file->Read(&buffer[0], buffer.size());
+    ASSERT_GT(size, 0);
+    EXPECT_EQ(0u, size % kDatagramSize);
+    received.append(&buffer[0], size);
+  }
+  EXPECT_EQ(sent, received);
+}
+
+#if defined(OS_LINUX)
+// Both inputs are received on the thread of the shared receiver.
+TEST_P(UdpFileTest, SharedReceiver) {
+  FLAGS_udp_shared_receiver = true;
+  scoped_ptr<File, FileCloser> file(
+      File::OpenWithNoBuffering(kUdpFileName, "r"));
+  ASSERT_TRUE(file);
+  scoped_ptr<File, FileCloser> other_file(
+      File::OpenWithNoBuffering(kOtherUdpFileName, "r"));
+  ASSERT_TRUE(other_file);
+
+  std::vector<char> buffer(kReadSize);
+  EXPECT_EQ(File::kWouldBlock, file->TryRead(&buffer[0], buffer.size()));
+
+  const std::string datagram(kDatagramSize, 'a');
+  const std::string other_datagram(kDatagramSize, 'b');
+  SendTo(kOtherPort, other_datagram);
+  Send(datagram);
+
+  int64_t size = file->Read(&buffer[0], buffer.size());
+  ASSERT_GT(size, 0);
+  EXPECT_EQ(datagram, std::string(&buffer[0], size));
+  size = other_file->Read(&buffer[0], buffer.size());
+  ASSERT_GT(size, 0);
+  EXPECT_EQ(other_datagram, std::string(&buffer[0], size));
+}
+#endif  // defined(OS_LINUX)
+
+INSTANTIATE_TEST_CASE_P(TrueIsReceiveThread,
+                        UdpFileTest,
+                        ::testing::Bool());
+
+}  // namespace media
+}  // namespace edash_packager
@@ -11,6 +11,9 @@
 namespace edash_packager {
 namespace media {
 
+// UdpFile is not implemented on Windows.
+class UdpFile::Receiver {};
+
 UdpFile::UdpFile(const char* file_name) : File(file_name), socket_(0) {
 }
 
@@ -27,6 +30,11 @@ int64_t UdpFile::Read(void* buffer, uint64_t length) {
   return -1;
 }
 
+int64_t UdpFile::TryRead(void* buffer, uint64_t length) {
+  NOTIMPLEMENTED();
+  return -1;
+}
+
 int64_t UdpFile::Write(const void* buffer, uint64_t length) {
   NOTIMPLEMENTED();
   return -1;
@@ -0,0 +1,207 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/file/udp_jitter_buffer.h"
+
+#include <algorithm>
+
+#include "packager/base/logging.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+const uint8_t kTsSyncByte = 0x47;
+const size_t kTsPacketSize = 188;
+const size_t kRtpHeaderSize = 12;
+const uint8_t kRtpVersion = 2;
+// The PCR clock runs at 27 MHz.
+const uint64_t kPcrTicksPerMicrosecond = 27;
+// The first extended sequence number, so that the datagrams received late
+// do not wrap around.
+const uint64_t kFirstSequenceNumberBase = 1ull << 32;
+
+// Finds the first PCR of |pcr_pid| in the TS packets of |data|, or of any PID
+// if |*pcr_pid| is negative, in which case |*pcr_pid| is set to its PID.
+bool FindPcr(const std::vector<uint8_t>& data, int* pcr_pid, uint64_t* pcr) {
+  for (size_t offset = 0; offset + kTsPacketSize <= data.size();
+       offset += kTsPacketSize) {
+    const uint8_t* packet = &data[offset];
+    if (packet[0] != kTsSyncByte)
+      return false;
+    const int pid = ((packet[1] & 0x1f) << 8) | packet[2];
+    const bool has_adaptation_field = (packet[3] & 0x20) != 0;
+    // The adaptation field is at least 7 bytes long with a PCR.
+    if (!has_adaptation_field || packet[4] < 7 || !(packet[5] & 0x10))
+      continue;
+    if (*pcr_pid >= 0 && pid != *pcr_pid)
+      continue;
+    const uint64_t pcr_base = (static_cast<uint64_t>(packet[6]) << 25) |
+                              (packet[7] << 17) | (packet[8] << 9) |
+                              (packet[9] << 1) | (packet[10] >> 7);
+    const uint64_t pcr_extension = ((packet[10] & 0x01) << 8) | packet[11];
+    *pcr_pid = pid;
+    *pcr = pcr_base * 300 + pcr_extension;
+    return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+UdpJitterBuffer::Datagram::Datagram() {}
+UdpJitterBuffer::Datagram::~Datagram() {}
+
+UdpJitterBuffer::UdpJitterBuffer(base::TimeDelta delay, size_t max_datagrams)
+    : delay_(delay),
+      max_datagrams_(max_datagrams),
+      has_rtp_header_(false),
+      first_datagram_(true),
+      highest_sequence_number_(0),
+      has_released_(false),
+      last_released_sequence_number_(0),
+      pcr_pid_(-1),
+      has_pcr_anchor_(false),
+      anchor_pcr_(0),
+      num_reordered_(0),
+      num_lost_(0),
+      num_dropped_(0),
+      num_pcr_resyncs_(0) {
+  DCHECK_GT(max_datagrams, 0u);
+}
+
+UdpJitterBuffer::~UdpJitterBuffer() {}
+
+void UdpJitterBuffer::Push(const uint8_t* data,
+                           size_t size,
+                           base::TimeTicks receive_time) {
+  size_t payload_offset = 0;
+  const uint64_t sequence_number =
+      GetSequenceNumber(data, size, &payload_offset);
+  if ((has_released_ &&
+       sequence_number <= last_released_sequence_number_) ||
+      datagrams_.find(sequence_number) != datagrams_.end()) {
+    ++num_dropped_;
+    return;
+  }
+
+  Datagram& datagram = datagrams_[sequence_number];
+  datagram.payload.assign(data + payload_offset, data + size);
+  datagram.receive_time = receive_time;
+  uint64_t pcr;
+  if (FindPcr(datagram.payload, &pcr_pid_, &pcr))
+    datagram.pcr_release_time = GetPcrReleaseTime(pcr, receive_time);
+}
+
+bool UdpJitterBuffer::Pop(base::TimeTicks now,
+                          std::vector<uint8_t>* datagram) {
+  DCHECK(datagram);
+  if (datagrams_.empty())
+    return false;
+  DatagramMap::iterator head = datagrams_.begin();
+  if (datagrams_.size() <= max_datagrams_ &&
+      GetReleaseTime(head->first, head->second) > now) {
+    return false;
+  }
+
+  if (has_released_ && head->first > last_released_sequence_number_ + 1)
+    num_lost_ += head->first - last_released_sequence_number_ - 1;
+  has_released_ = true;
+  last_released_sequence_number_ = head->first;
+  datagram->swap(head->second.payload);
+  datagrams_.erase(head);
+  return true;
+}
+
+base::TimeTicks UdpJitterBuffer::NextReleaseTime() const {
+  if (datagrams_.empty())
+    return base::TimeTicks();
+  DatagramMap::const_iterator head = datagrams_.begin();
+  return GetReleaseTime(head->first, head->second);
+}
+
+uint64_t UdpJitterBuffer::GetSequenceNumber(const uint8_t* data,
+                                            size_t size,
+                                            size_t* payload_offset) {
+  if (first_datagram_) {
+    has_rtp_header_ =
+        size >= kRtpHeaderSize && data[0] != kTsSyncByte &&
+        (data[0] >> 6) == kRtpVersion;
+  }
+  *payload_offset = 0;
+  if (!has_rtp_header_ || size < kRtpHeaderSize) {
+    // Numbered in order of arrival.
+    if (first_datagram_) {
+      first_datagram_ = false;
+      highest_sequence_number_ = kFirstSequenceNumberBase;
+    } else {
+      ++highest_sequence_number_;
+    }
+    return highest_sequence_number_;
+  }
+
+  // Skip the CSRC identifiers and the header extension.
+  size_t header_size = kRtpHeaderSize + 4 * (data[0] & 0x0f);
+  if ((data[0] & 0x10) && header_size + 4 <= size)
+    header_size += 4 + 4 * ((data[header_size + 2] << 8) |
+                            data[header_size + 3]);
+  *payload_offset = std::min(header_size, size);
+
+  const uint16_t sequence_number = (data[2] << 8) | data[3];
+  if (first_datagram_) {
+    first_datagram_ = false;
+    highest_sequence_number_ = kFirstSequenceNumberBase + sequence_number;
+    return highest_sequence_number_;
+  }
+  const int16_t difference = static_cast<int16_t>(
+      sequence_number - static_cast<uint16_t>(highest_sequence_number_));
+  const uint64_t extended_sequence_number =
+      highest_sequence_number_ + difference;
+  if (difference > 0)
+    highest_sequence_number_ = extended_sequence_number;
+  else if (difference < 0)
+    ++num_reordered_;
+  return extended_sequence_number;
+}
+
+base::TimeTicks UdpJitterBuffer::GetPcrReleaseTime(
+    uint64_t pcr,
+    base::TimeTicks receive_time) {
+  if (has_pcr_anchor_ && pcr >= anchor_pcr_) {
+    const base::TimeTicks release_time =
+        anchor_time_ + base::TimeDelta::FromMicroseconds(
+                           (pcr - anchor_pcr_) / kPcrTicksPerMicrosecond);
+    if (release_time >= receive_time &&
+        release_time <= receive_time + delay_ * 2) {
+      return release_time;
+    }
+  }
+  // Realigned on a PCR discontinuity or wrap around, or if the jitter or
+  // the clock drift exceeds the delay.
+  if (has_pcr_anchor_)
+    ++num_pcr_resyncs_;
+  has_pcr_anchor_ = true;
+  anchor_pcr_ = pcr;
+  anchor_time_ = receive_time + delay_;
+  return anchor_time_;
+}
+
+base::TimeTicks UdpJitterBuffer::GetReleaseTime(
+    uint64_t sequence_number,
+    const Datagram& datagram) const {
+  if (!datagram.pcr_release_time.is_null())
+    return datagram.pcr_release_time;
+  // Follows the datagram before it on the PCR timeline.
+  if (has_pcr_anchor_ && has_released_ &&
+      sequence_number == last_released_sequence_number_ + 1) {
+    return datagram.receive_time;
+  }
+  return datagram.receive_time + delay_;
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,124 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_FILE_UDP_JITTER_BUFFER_H_
+#define MEDIA_FILE_UDP_JITTER_BUFFER_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <vector>
+
+#include "packager/base/macros.h"
+#include "packager/base/time/time.h"
+
+namespace edash_packager {
+namespace media {
+
+/// Smooths the delivery of a live MPEG-2 TS stream received over UDP, with
+/// or without RTP encapsulation. The datagrams are reordered by RTP sequence
+/// number, if present, and released at the pace of the PCR they carry, a
+/// fixed delay after they would have been received over a network without
+/// jitter. The RTP headers are removed.
+/// The datagrams without PCR are released right after the datagram before
+/// them, or held for the delay before the first PCR. A datagram is never
+/// held more than twice the delay, and a missing datagram is waited for at
+/// most the delay.
+/// Thread Safety: Not thread safe.
+class UdpJitterBuffer {
+ public:
+  /// @param delay is the time the datagrams are held to absorb the jitter.
+  /// @param max_datagrams is the maximum number of datagrams held. The
+  ///        oldest one is released early beyond this.
+  UdpJitterBuffer(base::TimeDelta delay, size_t max_datagrams);
+  ~UdpJitterBuffer();
+
+  /// Adds a received datagram.
+  /// @param data points to the datagram.
+  /// @param size is the size of the datagram in bytes.
+  /// @param receive_time is the time the datagram was received.
+  void Push(const uint8_t* data, size_t size, base::TimeTicks receive_time);
+
+  /// Releases the next datagram if it is due.
+  /// @param now is the current time.
+  /// @param[out] datagram receives the TS payload of the datagram.
+  /// @return true if a datagram is released, false otherwise.
+  bool Pop(base::TimeTicks now, std::vector<uint8_t>* datagram);
+
+  /// @return The time the next datagram is due, or a null TimeTicks if the
+  ///         buffer is empty.
+  base::TimeTicks NextReleaseTime() const;
+
+  /// @return The number of datagrams held.
+  size_t size() const { return datagrams_.size(); }
+
+  /// @return The number of datagrams received out of order.
+  uint64_t num_reordered() const { return num_reordered_; }
+  /// @return The number of datagrams not received in time, given up.
+  uint64_t num_lost() const { return num_lost_; }
+  /// @return The number of datagrams dropped because they arrived too late
+  ///         or twice.
+  uint64_t num_dropped() const { return num_dropped_; }
+  /// @return The number of times the PCR timeline was realigned on the
+  ///         receive time, e.g. on a PCR discontinuity.
+  uint64_t num_pcr_resyncs() const { return num_pcr_resyncs_; }
+
+ private:
+  struct Datagram {
+    Datagram();
+    ~Datagram();
+
+    std::vector<uint8_t> payload;
+    base::TimeTicks receive_time;
+    // Null if the datagram does not carry a PCR.
+    base::TimeTicks pcr_release_time;
+  };
+  typedef std::map<uint64_t, Datagram> DatagramMap;
+
+  // Returns the sequence number of |data|, extended to 64 bits, and sets
+  // |payload_offset| past the RTP header. Datagrams without RTP header are
+  // numbered in order of arrival.
+  uint64_t GetSequenceNumber(const uint8_t* data,
+                             size_t size,
+                             size_t* payload_offset);
+  // Returns the time |pcr| is due, realigning the PCR timeline on
+  // |receive_time| if |pcr| is off it by more than the delay.
+  base::TimeTicks GetPcrReleaseTime(uint64_t pcr,
+                                    base::TimeTicks receive_time);
+  // Returns the time |datagram| is due once it is the oldest one held.
+  base::TimeTicks GetReleaseTime(uint64_t sequence_number,
+                                 const Datagram& datagram) const;
+
+  const base::TimeDelta delay_;
+  const size_t max_datagrams_;
+
+  DatagramMap datagrams_;
+  // Whether the stream has RTP headers, decided on the first datagram.
+  bool has_rtp_header_;
+  bool first_datagram_;
+  // The highest sequence number received, and the last one released.
+  uint64_t highest_sequence_number_;
+  bool has_released_;
+  uint64_t last_released_sequence_number_;
+  // The PID carrying the PCR used, -1 before the first PCR.
+  int pcr_pid_;
+  // The PCR timeline: |anchor_pcr_| is due at |anchor_time_|.
+  bool has_pcr_anchor_;
+  uint64_t anchor_pcr_;
+  base::TimeTicks anchor_time_;
+
+  uint64_t num_reordered_;
+  uint64_t num_lost_;
+  uint64_t num_dropped_;
+  uint64_t num_pcr_resyncs_;
+
+  DISALLOW_COPY_AND_ASSIGN(UdpJitterBuffer);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_FILE_UDP_JITTER_BUFFER_H_
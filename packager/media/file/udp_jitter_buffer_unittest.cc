@@ -0,0 +1,164 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/file/udp_jitter_buffer.h"
+
+#include <gtest/gtest.h>
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+const size_t kTsPacketSize = 188;
+const uint16_t kPcrPid = 0x100;
+const size_t kMaxDatagrams = 16;
+// 27 MHz PCR ticks per millisecond.
+const uint64_t kPcrTicksPerMs = 27000;
+
+base::TimeDelta Ms(int64_t milliseconds) {
+  return base::TimeDelta::FromMilliseconds(milliseconds);
+}
+
+// A TS packet whose payload bytes are |fill|, with a PCR if |has_pcr|.
+std::vector<uint8_t> GetTsPacket(uint8_t fill, bool has_pcr, uint64_t pcr) {
+  std::vector<uint8_t> packet(kTsPacketSize, fill);
+  packet[0] = 0x47;
+  packet[1] = kPcrPid >> 8;
+  packet[2] = kPcrPid & 0xff;
+  packet[3] = 0x10;
+  if (has_pcr) {
+    const uint64_t pcr_base = pcr / 300;
+    const uint64_t pcr_extension = pcr % 300;
+    packet[3] = 0x30;
+    packet[4] = 7;
+    packet[5] = 0x10;
+    packet[6] = pcr_base >> 25;
+    packet[7] = pcr_base >> 17;
+    packet[8] = pcr_base >> 9;
+    packet[9] = pcr_base >> 1;
+    packet[10] = ((pcr_base & 1) << 7) | 0x7e | (pcr_extension >> 8);
+    packet[11] = pcr_extension & 0xff;
+  }
+  return packet;
+}
+
+std::vector<uint8_t> GetRtpDatagram(uint16_t sequence_number,
+                                    const std::vector<uint8_t>& payload) {
+  std::vector<uint8_t> datagram(12, 0);
+  datagram[0] = 0x80;
+  datagram[1] = 33;  // MP2T.
+  datagram[2] = sequence_number >> 8;
+  datagram[3] = sequence_number & 0xff;
+  datagram.insert(datagram.end(), payload.begin(), payload.end());
+  return datagram;
+}
+
+}  // namespace
+
+class UdpJitterBufferTest : public ::testing::Test {
+ protected:
+  UdpJitterBufferTest()
+      : jitter_buffer_(Ms(100), kMaxDatagrams),
+        start_time_(base::TimeTicks::Now()) {}
+
+  void Push(const std::vector<uint8_t>& datagram, base::TimeDelta offset) {
+    jitter_buffer_.Push(&datagram[0], datagram.size(), start_time_ + offset);
+  }
+
+  // Pops a datagram at |offset| and returns the fill byte of its TS packet,
+  // or -1 if none is released.
+  int Pop(base::TimeDelta offset) {
+    std::vector<uint8_t> datagram;
+    if (!jitter_buffer_.Pop(start_time_ + offset, &datagram))
+      return -1;
+    EXPECT_EQ(kTsPacketSize, datagram.size());
+    return datagram.back();
+  }
+
+  UdpJitterBuffer jitter_buffer_;
+  const base::TimeTicks start_time_;
+};
+
+TEST_F(UdpJitterBufferTest, ReordersByRtpSequenceNumber) {
+  Push(GetRtpDatagram(1, GetTsPacket(1, false, 0)), Ms(0));
+  Push(GetRtpDatagram(3, GetTsPacket(3, false, 0)), Ms(1));
+  Push(GetRtpDatagram(2, GetTsPacket(2, false, 0)), Ms(2));
+
+  // Held for the delay, then released in order with the RTP header removed.
+  EXPECT_EQ(-1, Pop(Ms(99)));
+  EXPECT_EQ(1, Pop(Ms(100)));
+  EXPECT_EQ(-1, Pop(Ms(101)));
+  EXPECT_EQ(2, Pop(Ms(102)));
+  EXPECT_EQ(3, Pop(Ms(102)));
+  EXPECT_EQ(0u, jitter_buffer_.size());
+  EXPECT_EQ(1u, jitter_buffer_.num_reordered());
+  EXPECT_EQ(0u, jitter_buffer_.num_lost());
+}
+
+TEST_F(UdpJitterBufferTest, SequenceNumberWrapAround) {
+  Push(GetRtpDatagram(0xfffe, GetTsPacket(1, false, 0)), Ms(0));
+  Push(GetRtpDatagram(0, GetTsPacket(3, false, 0)), Ms(1));
+  Push(GetRtpDatagram(0xffff, GetTsPacket(2, false, 0)), Ms(2));
+
+  EXPECT_EQ(1, Pop(Ms(102)));
+  EXPECT_EQ(2, Pop(Ms(102)));
+  EXPECT_EQ(3, Pop(Ms(102)));
+}
+
+TEST_F(UdpJitterBufferTest, ReleasesAtPcrPace) {
+  // A burst of datagrams 10 ms apart on the PCR timeline.
+  Push(GetTsPacket(1, true, 0), Ms(0));
+  Push(GetTsPacket(2, false, 0), Ms(0));
+  Push(GetTsPacket(3, true, 10 * kPcrTicksPerMs), Ms(1));
+  Push(GetTsPacket(4, true, 20 * kPcrTicksPerMs), Ms(1));
+
+  EXPECT_EQ(start_time_ + Ms(100), jitter_buffer_.NextReleaseTime());
+  EXPECT_EQ(-1, Pop(Ms(99)));
+  EXPECT_EQ(1, Pop(Ms(100)));
+  // Without PCR, released right after the datagram before it.
+  EXPECT_EQ(2, Pop(Ms(100)));
+  EXPECT_EQ(start_time_ + Ms(110), jitter_buffer_.NextReleaseTime());
+  EXPECT_EQ(-1, Pop(Ms(109)));
+  EXPECT_EQ(3, Pop(Ms(110)));
+  EXPECT_EQ(-1, Pop(Ms(119)));
+  EXPECT_EQ(4, Pop(Ms(120)));
+  EXPECT_EQ(0u, jitter_buffer_.num_pcr_resyncs());
+}
+
+TEST_F(UdpJitterBufferTest, ResyncsOnPcrDiscontinuity) {
+  Push(GetTsPacket(1, true, 1000 * kPcrTicksPerMs), Ms(0));
+  EXPECT_EQ(1, Pop(Ms(100)));
+  // The PCR goes back in time.
+  Push(GetTsPacket(2, true, 0), Ms(10));
+  EXPECT_EQ(start_time_ + Ms(110), jitter_buffer_.NextReleaseTime());
+  EXPECT_EQ(1u, jitter_buffer_.num_pcr_resyncs());
+}
+
+TEST_F(UdpJitterBufferTest, GivesUpOnMissingDatagram) {
+  Push(GetRtpDatagram(1, GetTsPacket(1, false, 0)), Ms(0));
+  EXPECT_EQ(1, Pop(Ms(100)));
+  Push(GetRtpDatagram(3, GetTsPacket(3, false, 0)), Ms(110));
+  EXPECT_EQ(-1, Pop(Ms(209)));
+  EXPECT_EQ(3, Pop(Ms(210)));
+  EXPECT_EQ(1u, jitter_buffer_.num_lost());
+
+  // Too late.
+  Push(GetRtpDatagram(2, GetTsPacket(2, false, 0)), Ms(220));
+  EXPECT_EQ(0u, jitter_buffer_.size());
+  EXPECT_EQ(1u, jitter_buffer_.num_dropped());
+}
+
+TEST_F(UdpJitterBufferTest, ReleasesEarlyWhenFull) {
+  for (size_t i = 0; i <= kMaxDatagrams; ++i)
+    Push(GetTsPacket(static_cast<uint8_t>(i), false, 0), Ms(0));
+  EXPECT_EQ(0, Pop(Ms(0)));
+  EXPECT_EQ(-1, Pop(Ms(0)));
+  EXPECT_EQ(1, Pop(Ms(100)));
+}
+
+}  // namespace media
+}  // namespace edash_packager
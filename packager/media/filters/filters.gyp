@@ -12,6 +12,7 @@
     {
       'target_name': 'filters',
       'type': '<(component)',
+      'includes': ['../../hot_code.gypi'],
       'sources': [
         'avc_decoder_configuration.cc',
         'avc_decoder_configuration.h',
@@ -75,5 +76,18 @@
         'filters',
       ],
     },
+    {
+      'target_name': 'filters_perftest',
+      'type': '<(gtest_target_type)',
+      'sources': [
+        'nalu_reader_perftest.cc',
+      ],
+      'dependencies': [
+        '../../testing/gtest.gyp:gtest',
+        '../../testing/perf/perf_test.gyp:perf_test',
+        '../test/media_test.gyp:media_test_support',
+        'filters',
+      ],
+    },
   ],
 }
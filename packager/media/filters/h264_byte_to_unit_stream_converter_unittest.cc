@@ -7,6 +7,9 @@
 #include <gtest/gtest.h>
 #include <stdio.h>
 
+#include <algorithm>
+
+#include "packager/base/macros.h"
 #include "packager/base/strings/string_number_conversions.h"
 #include "packager/media/filters/h264_byte_to_unit_stream_converter.h"
 #include "packager/media/test/test_data_util.h"
@@ -44,6 +47,81 @@ TEST(H264ByteToUnitStreamConverter, ConversionSuccess) {
   EXPECT_EQ(expected_decoder_config, decoder_config);
 }
 
+TEST(H264ByteToUnitStreamConverter, InPlaceConversion) {
+  std::vector<uint8_t> frame = ReadTestDataFile("avc-byte-stream-frame.h264");
+  ASSERT_FALSE(frame.empty());
+
+  std::vector<uint8_t> expected_output_frame =
+      ReadTestDataFile("avc-unit-stream-frame.h264");
+  ASSERT_FALSE(expected_output_frame.empty());
+
+  H264ByteToUnitStreamConverter converter;
+  size_t output_frame_size = 0;
+  ASSERT_TRUE(converter.ParseByteStream(frame.data(), frame.size(),
+                                        &output_frame_size));
+  EXPECT_EQ(expected_output_frame.size(), output_frame_size);
+  frame.resize(std::max(frame.size(), output_frame_size));
+  converter.WriteNalUnitStreamInPlace(frame.data());
+  frame.resize(output_frame_size);
+  EXPECT_EQ(expected_output_frame, frame);
+}
+
+// The NAL units move to later positions with 3-byte start codes, and to
+// earlier positions when NAL units are dropped.
+TEST(H264ByteToUnitStreamConverter, InPlaceConversionWithMovingNalus) {
+  const uint8_t kThreeByteStartCodesFrame[] = {
+      0x00, 0x00, 0x01, 0x41, 0xAA, 0xBB,
+      0x00, 0x00, 0x01, 0x41, 0xCC,
+  };
+  const uint8_t kThreeByteStartCodesOutput[] = {
+      0x00, 0x00, 0x00, 0x03, 0x41, 0xAA, 0xBB,
+      0x00, 0x00, 0x00, 0x02, 0x41, 0xCC,
+  };
+  const uint8_t kMixedFrame[] = {
+      0x00, 0x00, 0x01, 0x41, 0xAA, 0xBB,
+      // AUD, which is dropped.
+      0x00, 0x00, 0x00, 0x01, 0x09, 0xF0,
+      0x00, 0x00, 0x00, 0x01, 0x41, 0xCC,
+  };
+  const uint8_t kMixedOutput[] = {
+      0x00, 0x00, 0x00, 0x03, 0x41, 0xAA, 0xBB,
+      0x00, 0x00, 0x00, 0x02, 0x41, 0xCC,
+  };
+  const struct {
+    const uint8_t* input;
+    size_t input_size;
+    const uint8_t* output;
+    size_t output_size;
+  } kTestCases[] = {
+      {kThreeByteStartCodesFrame, arraysize(kThreeByteStartCodesFrame),
+       kThreeByteStartCodesOutput, arraysize(kThreeByteStartCodesOutput)},
+      {kMixedFrame, arraysize(kMixedFrame), kMixedOutput,
+       arraysize(kMixedOutput)},
+  };
+
+  H264ByteToUnitStreamConverter converter;
+  for (const auto& test_case : kTestCases) {
+    const std::vector<uint8_t> expected_output_frame(
+        test_case.output, test_case.output + test_case.output_size);
+
+    std::vector<uint8_t> output_frame;
+    ASSERT_TRUE(converter.ConvertByteStreamToNalUnitStream(
+        test_case.input, test_case.input_size, &output_frame));
+    EXPECT_EQ(expected_output_frame, output_frame);
+
+    std::vector<uint8_t> frame(test_case.input,
+                               test_case.input + test_case.input_size);
+    size_t output_frame_size = 0;
+    ASSERT_TRUE(converter.ParseByteStream(frame.data(), frame.size(),
+                                          &output_frame_size));
+    ASSERT_EQ(test_case.output_size, output_frame_size);
+    frame.resize(std::max(frame.size(), output_frame_size));
+    converter.WriteNalUnitStreamInPlace(frame.data());
+    frame.resize(output_frame_size);
+    EXPECT_EQ(expected_output_frame, frame);
+  }
+}
+
 TEST(H264ByteToUnitStreamConverter, ConversionFailure) {
   std::vector<uint8_t> input_frame(100, 0);
 
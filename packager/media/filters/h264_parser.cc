@@ -707,6 +707,7 @@ H264Parser::Result H264Parser::ParseSps(const Nalu& nalu, int* sps_id) {
   *sps_id = sps->seq_parameter_set_id;
   delete active_SPSes_[*sps_id];
   active_SPSes_[*sps_id] = sps.release();
+  slice_header_layouts_.clear();
 
   return kOk;
 }
@@ -781,6 +782,7 @@ H264Parser::Result H264Parser::ParsePps(const Nalu& nalu, int* pps_id) {
   *pps_id = pps->pic_parameter_set_id;
   delete active_PPSes_[*pps_id];
   active_PPSes_[*pps_id] = pps.release();
+  slice_header_layouts_.clear();
 
   return kOk;
 }
@@ -1131,6 +1133,190 @@ H264Parser::Result H264Parser::ParseSliceHeader(const Nalu& nalu,
   return kOk;
 }
 
+H264Parser::Result H264Parser::ParseSliceHeaderSize(const Nalu& nalu,
+                                                    off_t* header_bit_size) {
+  if (SkipSliceHeader(nalu, header_bit_size))
+    return kOk;
+
+  H264SliceHeader shdr;
+  Result res = ParseSliceHeader(nalu, &shdr);
+  if (res != kOk)
+    return res;
+  *header_bit_size = shdr.header_bit_size;
+  return kOk;
+}
+
+const H264Parser::SliceHeaderLayout* H264Parser::GetSliceHeaderLayout(
+    int pps_id) {
+  // PPS ids are in the range [0, 255].
+  if (pps_id < 0 || pps_id > 255)
+    return NULL;
+  if (static_cast<size_t>(pps_id) >= slice_header_layouts_.size()) {
+    const SliceHeaderLayout kUnknownLayout = {SliceHeaderLayout::kUnknown};
+    slice_header_layouts_.resize(pps_id + 1, kUnknownLayout);
+  }
+  SliceHeaderLayout* layout = &slice_header_layouts_[pps_id];
+  if (layout->state != SliceHeaderLayout::kUnknown)
+    return layout;
+
+  const H264Pps* pps = GetPps(pps_id);
+  if (!pps)
+    return NULL;
+  const H264Sps* sps = GetSps(pps->seq_parameter_set_id);
+  if (!sps)
+    return NULL;
+
+  // Interlaced streams and slice groups are not supported by
+  // ParseSliceHeader() and are left to it, as are the invalid default
+  // numbers of reference indices.
+  if (sps->separate_colour_plane_flag || !sps->frame_mbs_only_flag ||
+      pps->num_slice_groups_minus1 > 0 ||
+      pps->num_ref_idx_l0_default_active_minus1 >= 16 ||
+      pps->num_ref_idx_l1_default_active_minus1 >= 16) {
+    layout->state = SliceHeaderLayout::kSlow;
+    return layout;
+  }
+
+  layout->state = SliceHeaderLayout::kFast;
+  layout->frame_num_bits = sps->log2_max_frame_num_minus4 + 4;
+  layout->pic_order_cnt_lsb_bits = 0;
+  layout->num_delta_pic_order_cnt = 0;
+  if (sps->pic_order_cnt_type == 0) {
+    layout->pic_order_cnt_lsb_bits = sps->log2_max_pic_order_cnt_lsb_minus4 + 4;
+    if (pps->bottom_field_pic_order_in_frame_present_flag)
+      layout->num_delta_pic_order_cnt = 1;
+  } else if (sps->pic_order_cnt_type == 1 &&
+             !sps->delta_pic_order_always_zero_flag) {
+    layout->num_delta_pic_order_cnt =
+        pps->bottom_field_pic_order_in_frame_present_flag ? 2 : 1;
+  }
+  layout->redundant_pic_cnt_present_flag = pps->redundant_pic_cnt_present_flag;
+  layout->weighted_pred_flag = pps->weighted_pred_flag;
+  layout->weighted_bipred_flag = pps->weighted_bipred_idc == 1;
+  layout->entropy_coding_mode_flag = pps->entropy_coding_mode_flag;
+  layout->deblocking_filter_control_present_flag =
+      pps->deblocking_filter_control_present_flag;
+  return layout;
+}
+
+bool H264Parser::SkipSliceHeader(const Nalu& nalu, off_t* header_bit_size) {
+  // See 7.3.3. This follows ParseSliceHeader(), leaving the less common
+  // syntax elements, and any error, to it.
+  if (nalu.type() != Nalu::H264_NonIDRSlice &&
+      nalu.type() != Nalu::H264_IDRSlice) {
+    return false;
+  }
+  H26xBitReader br;
+  if (!br.Initialize(nalu.data() + nalu.header_size(), nalu.payload_size()))
+    return false;
+
+  int first_mb_in_slice;
+  int slice_type;
+  int pps_id;
+  if (!br.ReadUE(&first_mb_in_slice) || !br.ReadUE(&slice_type) ||
+      slice_type >= 10 || !br.ReadUE(&pps_id)) {
+    return false;
+  }
+  const SliceHeaderLayout* layout = GetSliceHeaderLayout(pps_id);
+  if (!layout || layout->state != SliceHeaderLayout::kFast)
+    return false;
+
+  const int type = slice_type % 5;
+  const bool is_p_slice = type == H264SliceHeader::kPSlice;
+  const bool is_b_slice = type == H264SliceHeader::kBSlice;
+  const bool is_sp_slice = type == H264SliceHeader::kSPSlice;
+  const bool is_si_slice = type == H264SliceHeader::kSISlice;
+  const bool is_i_slice = type == H264SliceHeader::kISlice;
+  const bool is_idr = nalu.type() == Nalu::H264_IDRSlice;
+
+  int value;
+  if (!br.SkipBits(layout->frame_num_bits))
+    return false;
+  if (is_idr && !br.ReadUE(&value))
+    return false;
+  if (layout->pic_order_cnt_lsb_bits > 0 &&
+      !br.SkipBits(layout->pic_order_cnt_lsb_bits)) {
+    return false;
+  }
+  for (int i = 0; i < layout->num_delta_pic_order_cnt; ++i) {
+    if (!br.ReadSE(&value))
+      return false;
+  }
+  if (layout->redundant_pic_cnt_present_flag &&
+      (!br.ReadUE(&value) || value >= 128)) {
+    return false;
+  }
+  if (is_b_slice && !br.SkipBits(1))
+    return false;
+
+  if (is_p_slice || is_sp_slice || is_b_slice) {
+    bool num_ref_idx_active_override_flag;
+    if (!br.ReadBool(&num_ref_idx_active_override_flag))
+      return false;
+    // The number of reference indices only matters for the less common
+    // syntax elements, but is validated by ParseSliceHeader().
+    if (num_ref_idx_active_override_flag) {
+      if (!br.ReadUE(&value) || value >= 16)
+        return false;
+      if (is_b_slice && (!br.ReadUE(&value) || value >= 16))
+        return false;
+    }
+  }
+
+  // Reference picture list modifications.
+  bool flag;
+  if (!is_i_slice && !is_si_slice && (!br.ReadBool(&flag) || flag))
+    return false;
+  if (is_b_slice && (!br.ReadBool(&flag) || flag))
+    return false;
+
+  // Prediction weight table.
+  if ((layout->weighted_pred_flag && (is_p_slice || is_sp_slice)) ||
+      (layout->weighted_bipred_flag && is_b_slice)) {
+    return false;
+  }
+
+  // Decoded reference picture marking.
+  if (nalu.ref_idc() != 0) {
+    if (is_idr) {
+      if (!br.SkipBits(2))
+        return false;
+    } else if (!br.ReadBool(&flag) || flag) {
+      return false;
+    }
+  }
+
+  if (layout->entropy_coding_mode_flag && !is_i_slice && !is_si_slice &&
+      (!br.ReadUE(&value) || value >= 3)) {
+    return false;
+  }
+  // slice_qp_delta.
+  if (!br.ReadSE(&value))
+    return false;
+  if (is_sp_slice && !br.SkipBits(1))
+    return false;
+  if ((is_sp_slice || is_si_slice) && !br.ReadSE(&value))
+    return false;
+
+  if (layout->deblocking_filter_control_present_flag) {
+    int disable_deblocking_filter_idc;
+    if (!br.ReadUE(&disable_deblocking_filter_idc) ||
+        disable_deblocking_filter_idc >= 3) {
+      return false;
+    }
+    if (disable_deblocking_filter_idc != 1) {
+      if (!br.ReadSE(&value) || value < -6 || value > 6)
+        return false;
+      if (!br.ReadSE(&value) || value < -6 || value > 6)
+        return false;
+    }
+  }
+
+  const size_t epb = br.NumEmulationPreventionBytesRead();
+  *header_bit_size = (nalu.payload_size() - epb) * 8 - br.NumBitsLeft();
+  return true;
+}
+
 H264Parser::Result H264Parser::ParseSEI(const Nalu& nalu,
                                         H264SEIMessage* sei_msg) {
   int byte;
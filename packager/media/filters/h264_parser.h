@@ -11,6 +11,7 @@
 #include <stdlib.h>
 
 #include <map>
+#include <vector>
 
 #include "packager/media/filters/h26x_bit_reader.h"
 #include "packager/media/filters/nalu_reader.h"
@@ -280,11 +281,50 @@ class H264Parser {
   // the NALU returned from AdvanceToNextNALU() and corresponding to |*shdr|.
   Result ParseSliceHeader(const Nalu& nalu, H264SliceHeader* shdr);
 
+  // Compute the size of the slice header of |nalu|, in bits, returning it in
+  // |*header_bit_size|. This is the same as the header_bit_size computed by
+  // ParseSliceHeader(), but the common slice headers are only skipped over,
+  // using what is needed from the SPS/PPS, which is cached per PPS until
+  // the next SPS or PPS is parsed. Other slice headers are parsed in full.
+  Result ParseSliceHeaderSize(const Nalu& nalu, off_t* header_bit_size);
+
   // Parse a SEI message, returning it in |*sei_msg|, provided and managed
   // by the caller.
   Result ParseSEI(const Nalu& nalu, H264SEIMessage* sei_msg);
 
  private:
+  // The SPS/PPS fields needed to skip over the slice headers referring to a
+  // PPS.
+  struct SliceHeaderLayout {
+    enum State {
+      kUnknown,
+      // Slice headers can be skipped over.
+      kFast,
+      // Slice headers must be parsed in full, e.g. for interlaced streams.
+      kSlow,
+    };
+
+    State state;
+    int frame_num_bits;
+    // Zero if pic_order_cnt_lsb is not present.
+    int pic_order_cnt_lsb_bits;
+    // Number of delta_pic_order_cnt_bottom / delta_pic_order_cnt[] fields.
+    int num_delta_pic_order_cnt;
+    bool redundant_pic_cnt_present_flag;
+    bool weighted_pred_flag;
+    bool weighted_bipred_flag;
+    bool entropy_coding_mode_flag;
+    bool deblocking_filter_control_present_flag;
+  };
+
+  // Returns the slice header layout for PPS |pps_id|, or NULL if the PPS or
+  // its SPS are not present.
+  const SliceHeaderLayout* GetSliceHeaderLayout(int pps_id);
+
+  // Skip over the slice header of |nalu|. Returns false if the slice header
+  // must be parsed in full instead, including when it is invalid.
+  bool SkipSliceHeader(const Nalu& nalu, off_t* header_bit_size);
+
   // Parse scaling lists (see spec).
   Result ParseScalingList(H26xBitReader* br,
                           int size,
@@ -328,6 +368,8 @@ class H264Parser {
   typedef std::map<int, H264Pps*> PpsById;
   SpsById active_SPSes_;
   PpsById active_PPSes_;
+  // Indexed by PPS id.
+  std::vector<SliceHeaderLayout> slice_header_layouts_;
 
   DISALLOW_COPY_AND_ASSIGN(H264Parser);
 };
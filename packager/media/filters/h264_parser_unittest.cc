@@ -41,9 +41,14 @@ TEST(H264ParserTest, StreamFileParsing) {
     int id;
     switch (nalu.type()) {
       case Nalu::H264_IDRSlice:
-      case Nalu::H264_NonIDRSlice:
+      case Nalu::H264_NonIDRSlice: {
         ASSERT_EQ(parser.ParseSliceHeader(nalu, &shdr), H264Parser::kOk);
+        off_t header_bit_size = 0;
+        ASSERT_EQ(parser.ParseSliceHeaderSize(nalu, &header_bit_size),
+                  H264Parser::kOk);
+        EXPECT_EQ(shdr.header_bit_size, header_bit_size);
         break;
+      }
 
       case Nalu::H264_SPS:
         ASSERT_EQ(parser.ParseSps(nalu, &id), H264Parser::kOk);
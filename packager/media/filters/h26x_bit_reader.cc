@@ -8,11 +8,51 @@
 namespace edash_packager {
 namespace media {
 
+namespace {
+
+const uint8_t kEmulationPreventionByte = 0x03;
+
+uint64_t LoadBigEndian64(const uint8_t* data) {
+  return static_cast<uint64_t>(data[0]) << 56 |
+         static_cast<uint64_t>(data[1]) << 48 |
+         static_cast<uint64_t>(data[2]) << 40 |
+         static_cast<uint64_t>(data[3]) << 32 |
+         static_cast<uint64_t>(data[4]) << 24 |
+         static_cast<uint64_t>(data[5]) << 16 |
+         static_cast<uint64_t>(data[6]) << 8 | static_cast<uint64_t>(data[7]);
+}
+
+// Returns true if any of the eight bytes of |word| is |byte|.
+bool HasByte(uint64_t word, uint8_t byte) {
+  const uint64_t kLowBits = 0x0101010101010101ULL;
+  const uint64_t kHighBits = 0x8080808080808080ULL;
+  const uint64_t x = word ^ (kLowBits * byte);
+  return ((x - kLowBits) & ~x & kHighBits) != 0;
+}
+
+// Returns the number of leading zero bits of |value|, 64 if it is zero.
+int CountLeadingZeros(uint64_t value) {
+  if (value == 0)
+    return 64;
+#if defined(__GNUC__)
+  return __builtin_clzll(value);
+#else
+  int count = 0;
+  while ((value & (1ULL << 63)) == 0) {
+    value <<= 1;
+    ++count;
+  }
+  return count;
+#endif
+}
+
+}  // namespace
+
 H26xBitReader::H26xBitReader()
     : data_(NULL),
       bytes_left_(0),
-      curr_byte_(0),
-      num_remaining_bits_in_curr_byte_(0),
+      cache_(0),
+      num_cached_bits_(0),
       prev_two_bytes_(0),
       emulation_prevention_bytes_(0) {}
 
@@ -26,7 +66,8 @@ bool H26xBitReader::Initialize(const uint8_t* data, off_t size) {
 
   data_ = data;
   bytes_left_ = size;
-  num_remaining_bits_in_curr_byte_ = 0;
+  cache_ = 0;
+  num_cached_bits_ = 0;
   // Initially set to 0xffff to accept all initial two-byte sequences.
   prev_two_bytes_ = 0xffff;
   emulation_prevention_bytes_ = 0;
@@ -34,89 +75,110 @@ bool H26xBitReader::Initialize(const uint8_t* data, off_t size) {
   return true;
 }
 
-bool H26xBitReader::UpdateCurrByte() {
-  if (bytes_left_ < 1)
-    return false;
+void H26xBitReader::RefillCache() {
+  const int num_bytes = (64 - num_cached_bits_) / 8;
+  if (num_bytes == 0)
+    return;
+
+  if (bytes_left_ >= 8) {
+    const uint64_t word = LoadBigEndian64(data_);
+    // An emulation prevention byte is a 0x03 byte, so there is none if there
+    // is no 0x03 byte.
+    if (!HasByte(word, kEmulationPreventionByte)) {
+      const int num_bits = num_bytes * 8;
+      const uint64_t bits = num_bytes == 8 ? word : word >> (64 - num_bits)
+                                                      << (64 - num_bits);
+      cache_ |= bits >> num_cached_bits_;
+      num_cached_bits_ += num_bits;
+      data_ += num_bytes;
+      bytes_left_ -= num_bytes;
+      prev_two_bytes_ = num_bytes == 1
+                            ? ((prev_two_bytes_ << 8) | data_[-1]) & 0xffff
+                            : (data_[-2] << 8) | data_[-1];
+      return;
+    }
+  }
 
-  // Emulation prevention three-byte detection.
-  // If a sequence of 0x000003 is found, skip (ignore) the last byte (0x03).
-  if (*data_ == 0x03 && (prev_two_bytes_ & 0xffff) == 0) {
-    // Detected 0x000003, skip last byte.
-    ++data_;
+  while (num_cached_bits_ <= 56 && bytes_left_ > 0) {
+    // Emulation prevention three-byte detection.
+    // If a sequence of 0x000003 is found, skip (ignore) the last byte (0x03).
+    if (*data_ == kEmulationPreventionByte && (prev_two_bytes_ & 0xffff) == 0) {
+      // Detected 0x000003, skip last byte.
+      ++data_;
+      --bytes_left_;
+      ++emulation_prevention_bytes_;
+      // Need another full three bytes before we can detect the sequence
+      // again.
+      prev_two_bytes_ = 0xffff;
+      continue;
+    }
+
+    // Load a new byte and advance pointers.
+    const uint8_t byte = *data_++;
     --bytes_left_;
-    ++emulation_prevention_bytes_;
-    // Need another full three bytes before we can detect the sequence again.
-    prev_two_bytes_ = 0xffff;
-
-    if (bytes_left_ < 1)
-      return false;
+    cache_ |= static_cast<uint64_t>(byte) << (56 - num_cached_bits_);
+    num_cached_bits_ += 8;
+    prev_two_bytes_ = (prev_two_bytes_ << 8) | byte;
   }
+}
 
-  // Load a new byte and advance pointers.
-  curr_byte_ = *data_++ & 0xff;
-  --bytes_left_;
-  num_remaining_bits_in_curr_byte_ = 8;
-
-  prev_two_bytes_ = (prev_two_bytes_ << 8) | curr_byte_;
-
-  return true;
+uint64_t H26xBitReader::TakeCachedBits(int num_bits) {
+  DCHECK_GT(num_bits, 0);
+  DCHECK_LE(num_bits, num_cached_bits_);
+  const uint64_t bits = cache_ >> (64 - num_bits);
+  cache_ = num_bits == 64 ? 0 : cache_ << num_bits;
+  num_cached_bits_ -= num_bits;
+  return bits;
 }
 
 // Read |num_bits| (1 to 31 inclusive) from the stream and return them
 // in |out|, with first bit in the stream as MSB in |out| at position
 // (|num_bits| - 1).
 bool H26xBitReader::ReadBits(int num_bits, int* out) {
-  int bits_left = num_bits;
-  *out = 0;
   DCHECK(num_bits <= 31);
+  *out = 0;
 
-  while (num_remaining_bits_in_curr_byte_ < bits_left) {
-    // Take all that's left in current byte, shift to make space for the rest.
-    *out |= (curr_byte_ << (bits_left - num_remaining_bits_in_curr_byte_));
-    bits_left -= num_remaining_bits_in_curr_byte_;
-
-    if (!UpdateCurrByte())
+  if (num_bits > num_cached_bits_) {
+    RefillCache();
+    if (num_bits > num_cached_bits_)
       return false;
   }
-
-  *out |= (curr_byte_ >> (num_remaining_bits_in_curr_byte_ - bits_left));
-  *out &= ((1 << num_bits) - 1);
-  num_remaining_bits_in_curr_byte_ -= bits_left;
-
+  *out = static_cast<int>(TakeCachedBits(num_bits));
   return true;
 }
 
 bool H26xBitReader::SkipBits(int num_bits) {
-  int bits_left = num_bits;
-  while (num_remaining_bits_in_curr_byte_ < bits_left) {
-    bits_left -= num_remaining_bits_in_curr_byte_;
-    if (!UpdateCurrByte())
+  while (num_bits > num_cached_bits_) {
+    num_bits -= num_cached_bits_;
+    cache_ = 0;
+    num_cached_bits_ = 0;
+    RefillCache();
+    if (num_cached_bits_ == 0)
       return false;
   }
 
-  num_remaining_bits_in_curr_byte_ -= bits_left;
+  if (num_bits > 0)
+    TakeCachedBits(num_bits);
   return true;
 }
 
 bool H26xBitReader::ReadUE(int* val) {
-  int num_bits = -1;
-  int bit;
-  int rest;
+  // The cache holds at least 57 bits, unless the end of the stream is
+  // reached. A code with more than 31 leading zero bits is invalid.
+  if (num_cached_bits_ < 57)
+    RefillCache();
 
   // Count the number of contiguous zero bits.
-  do {
-    if (!ReadBits(1, &bit))
-      return false;
-    num_bits++;
-  } while (bit == 0);
-
-  if (num_bits > 31)
+  const int num_bits = CountLeadingZeros(cache_);
+  if (num_bits >= num_cached_bits_ || num_bits > 31)
     return false;
+  TakeCachedBits(num_bits + 1);
 
   // Calculate exp-Golomb code value of size num_bits.
   *val = (1 << num_bits) - 1;
 
   if (num_bits > 0) {
+    int rest;
     if (!ReadBits(num_bits, &rest))
       return false;
     *val += rest;
@@ -141,24 +203,26 @@ bool H26xBitReader::ReadSE(int* val) {
 }
 
 off_t H26xBitReader::NumBitsLeft() {
-  return (num_remaining_bits_in_curr_byte_ + bytes_left_ * 8);
+  return (num_cached_bits_ + bytes_left_ * 8);
 }
 
 bool H26xBitReader::HasMoreRBSPData() {
-  // Make sure we have more bits, if we are at 0 bits in current byte
-  // and updating current byte fails, we don't have more data anyway.
-  if (num_remaining_bits_in_curr_byte_ == 0 && !UpdateCurrByte())
+  // Make sure we have more bits, if we are at 0 bits left and refilling
+  // fails, we don't have more data anyway.
+  if (num_cached_bits_ == 0)
+    RefillCache();
+  if (num_cached_bits_ == 0)
     return false;
 
   // On last byte?
-  if (bytes_left_)
+  if (bytes_left_ || num_cached_bits_ > 8)
     return true;
 
   // Last byte, look for stop bit;
   // We have more RBSP data if the last non-zero bit we find is not the
   // first available bit.
-  return (curr_byte_ &
-          ((1 << (num_remaining_bits_in_curr_byte_ - 1)) - 1)) != 0;
+  const uint64_t last_bits = cache_ >> (64 - num_cached_bits_);
+  return (last_bits & ((1 << (num_cached_bits_ - 1)) - 1)) != 0;
 }
 
 size_t H26xBitReader::NumEmulationPreventionBytesRead() {
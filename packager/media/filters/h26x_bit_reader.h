@@ -64,26 +64,34 @@ class H26xBitReader {
   // See the definition of more_rbsp_data() in spec.
   bool HasMoreRBSPData();
 
-  // Return the number of emulation prevention bytes already read.
+  // Return the number of emulation prevention bytes already read. The
+  // bytes loaded in the cache count as read, so that
+  // (size - NumEmulationPreventionBytesRead()) * 8 - NumBitsLeft() is the
+  // number of bits read, emulation prevention bytes excluded.
   size_t NumEmulationPreventionBytesRead();
 
  private:
-  // Advance to the next byte, loading it into curr_byte_.
-  // Return false on end of stream.
-  bool UpdateCurrByte();
+  // Load as many whole bytes as fit into cache_, skipping the emulation
+  // prevention bytes. Eight bytes are loaded at once when none of them can
+  // be an emulation prevention byte.
+  void RefillCache();
 
-  // Pointer to the next unread (not in curr_byte_) byte in the stream.
+  // Take |num_bits| (1 to num_cached_bits_ inclusive) from cache_.
+  uint64_t TakeCachedBits(int num_bits);
+
+  // Pointer to the next byte in the stream not loaded in cache_.
   const uint8_t* data_;
 
-  // Bytes left in the stream (without the curr_byte_).
+  // Bytes left in the stream (without the bytes in cache_).
   off_t bytes_left_;
 
-  // Contents of the current byte; first unread bit starting at position
-  // 8 - num_remaining_bits_in_curr_byte_ from MSB.
-  int curr_byte_;
+  // Cached bits, emulation prevention bytes removed, starting with the first
+  // unread bit at the MSB. The bits after the first num_cached_bits_ are
+  // zero.
+  uint64_t cache_;
 
-  // Number of bits remaining in curr_byte_
-  int num_remaining_bits_in_curr_byte_;
+  // Number of unread bits in cache_.
+  int num_cached_bits_;
 
   // Used in emulation prevention three byte detection (see spec).
   // Initially set to 0xffff to accept all initial two-byte sequences.
@@ -112,5 +112,55 @@ TEST(H26xBitReaderTest, StopBitOccupyFullByte) {
   EXPECT_FALSE(reader.HasMoreRBSPData());
 }
 
+TEST(H26xBitReaderTest, EmulationPreventionBytes) {
+  H26xBitReader reader;
+  const unsigned char rbsp[] = {0x00, 0x00, 0x03, 0x01, 0xff,
+                                0x00, 0x00, 0x03, 0x02, 0x80};
+  int dummy = 0;
+
+  EXPECT_TRUE(reader.Initialize(rbsp, sizeof(rbsp)));
+  EXPECT_TRUE(reader.ReadBits(24, &dummy));
+  EXPECT_EQ(0x000001, dummy);
+  EXPECT_TRUE(reader.ReadBits(8, &dummy));
+  EXPECT_EQ(0xff, dummy);
+  EXPECT_TRUE(reader.ReadBits(16, &dummy));
+  EXPECT_EQ(0, dummy);
+  EXPECT_TRUE(reader.ReadBits(8, &dummy));
+  EXPECT_EQ(0x02, dummy);
+  EXPECT_EQ(2u, reader.NumEmulationPreventionBytesRead());
+  // Number of bits read, without the emulation prevention bytes.
+  EXPECT_EQ(56, (static_cast<off_t>(sizeof(rbsp)) -
+                 static_cast<off_t>(reader.NumEmulationPreventionBytesRead())) *
+                        8 -
+                    reader.NumBitsLeft());
+  EXPECT_FALSE(reader.HasMoreRBSPData());
+}
+
+TEST(H26xBitReaderTest, ReadExpGolomb) {
+  H26xBitReader reader;
+  // 1, 010, 011, 00100 then a code with 20 leading zero bits.
+  const unsigned char rbsp[] = {0xa6, 0x40, 0x00, 0x00, 0x80,
+                                0x00, 0x18, 0x00};
+  int value = 0;
+
+  EXPECT_TRUE(reader.Initialize(rbsp, sizeof(rbsp)));
+  EXPECT_TRUE(reader.ReadUE(&value));
+  EXPECT_EQ(0, value);
+  EXPECT_TRUE(reader.ReadSE(&value));
+  EXPECT_EQ(1, value);
+  EXPECT_TRUE(reader.ReadSE(&value));
+  EXPECT_EQ(-1, value);
+  EXPECT_TRUE(reader.ReadUE(&value));
+  EXPECT_EQ(3, value);
+  EXPECT_TRUE(reader.ReadUE(&value));
+  EXPECT_EQ((1 << 20) - 1 + 3, value);
+  EXPECT_EQ(11, reader.NumBitsLeft());
+
+  // More than 31 leading zero bits.
+  const unsigned char invalid_rbsp[] = {0x00, 0x00, 0x00, 0x00, 0x80};
+  EXPECT_TRUE(reader.Initialize(invalid_rbsp, sizeof(invalid_rbsp)));
+  EXPECT_FALSE(reader.ReadUE(&value));
+}
+
 }  // namespace media
 }  // namespace edash_packager
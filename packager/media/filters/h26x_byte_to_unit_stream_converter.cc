@@ -6,6 +6,8 @@
 
 #include "packager/media/filters/h26x_byte_to_unit_stream_converter.h"
 
+#include <string.h>
+
 #include <limits>
 
 #include "packager/base/logging.h"
@@ -15,14 +17,19 @@ namespace edash_packager {
 namespace media {
 
 namespace {
-// Additional space to reserve for output frame. This value ought to be enough
-// to acommodate frames consisting of 100 NAL units with 3-byte start codes.
-const size_t kStreamConversionOverhead = 100;
+
+void WriteNaluLength(uint32_t nalu_size, uint8_t* output) {
+  output[0] = nalu_size >> 24;
+  output[1] = nalu_size >> 16;
+  output[2] = nalu_size >> 8;
+  output[3] = nalu_size;
 }
 
+}  // namespace
+
 H26xByteToUnitStreamConverter::H26xByteToUnitStreamConverter(
     Nalu::CodecType type)
-    : type_(type) {}
+    : type_(type), input_frame_size_(0), output_frame_size_(0) {}
 H26xByteToUnitStreamConverter::~H26xByteToUnitStreamConverter() {}
 
 bool H26xByteToUnitStreamConverter::ConvertByteStreamToNalUnitStream(
@@ -32,7 +39,26 @@ bool H26xByteToUnitStreamConverter::ConvertByteStreamToNalUnitStream(
   DCHECK(input_frame);
   DCHECK(output_frame);
 
-  BufferWriter output_buffer(input_frame_size + kStreamConversionOverhead);
+  size_t output_frame_size = 0;
+  if (!ParseByteStream(input_frame, input_frame_size, &output_frame_size))
+    return false;
+  // A single allocation of the exact size.
+  output_frame->resize(output_frame_size);
+  if (output_frame_size > 0)
+    WriteNalUnitStream(input_frame, &(*output_frame)[0]);
+  return true;
+}
+
+bool H26xByteToUnitStreamConverter::ParseByteStream(
+    const uint8_t* input_frame,
+    size_t input_frame_size,
+    size_t* output_frame_size) {
+  DCHECK(input_frame);
+  DCHECK(output_frame_size);
+
+  nalus_.clear();
+  input_frame_size_ = input_frame_size;
+  output_frame_size_ = 0;
 
   Nalu nalu;
   NaluReader reader(type_, kIsAnnexbByteStream, input_frame, input_frame_size);
@@ -48,15 +74,65 @@ bool H26xByteToUnitStreamConverter::ConvertByteStreamToNalUnitStream(
     if (ProcessNalu(nalu))
       continue;
 
-    // Append 4-byte length and NAL unit data to the buffer.
-    output_buffer.AppendInt(static_cast<uint32_t>(nalu_size));
-    output_buffer.AppendArray(nalu.data(), nalu_size);
+    // The NAL unit is written after a 4-byte length.
+    NaluRange range;
+    range.input_offset = nalu.data() - input_frame;
+    range.output_offset = output_frame_size_;
+    range.size = nalu_size;
+    nalus_.push_back(range);
+    output_frame_size_ += kUnitStreamNaluLengthSize + nalu_size;
   }
 
-  output_buffer.SwapBuffer(output_frame);
+  *output_frame_size = output_frame_size_;
   return true;
 }
 
+void H26xByteToUnitStreamConverter::WriteNalUnitStreamInPlace(uint8_t* frame) {
+  DCHECK(frame);
+  // Moving the NAL units front to back is safe if none of them moves to a
+  // later position, i.e. the start codes have 4 bytes or some NAL units are
+  // dropped. Moving them back to front is safe if none of them moves to an
+  // earlier position, e.g. with 3-byte start codes only.
+  bool can_move_forward = true;
+  bool can_move_backward = true;
+  for (const NaluRange& range : nalus_) {
+    const size_t output_data_offset =
+        range.output_offset + kUnitStreamNaluLengthSize;
+    if (output_data_offset > range.input_offset)
+      can_move_forward = false;
+    if (output_data_offset < range.input_offset)
+      can_move_backward = false;
+  }
+
+  if (can_move_forward) {
+    WriteNalUnitStream(frame, frame);
+  } else if (can_move_backward) {
+    for (size_t i = nalus_.size(); i > 0; --i) {
+      const NaluRange& range = nalus_[i - 1];
+      uint8_t* output = frame + range.output_offset;
+      memmove(output + kUnitStreamNaluLengthSize, frame + range.input_offset,
+              range.size);
+      WriteNaluLength(range.size, output);
+    }
+  } else {
+    // Rare mix of both. Convert from a copy of the byte stream.
+    const std::vector<uint8_t> input(frame, frame + input_frame_size_);
+    WriteNalUnitStream(input.data(), frame);
+  }
+}
+
+void H26xByteToUnitStreamConverter::WriteNalUnitStream(const uint8_t* input,
+                                                       uint8_t* output) const {
+  for (const NaluRange& range : nalus_) {
+    uint8_t* nalu_output = output + range.output_offset;
+    // The length is written after the data is moved, it may overlap the
+    // start code of the NAL unit.
+    memmove(nalu_output + kUnitStreamNaluLengthSize,
+            input + range.input_offset, range.size);
+    WriteNaluLength(range.size, nalu_output);
+  }
+}
+
 }  // namespace media
 }  // namespace edash_packager
 
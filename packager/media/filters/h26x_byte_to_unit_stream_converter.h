@@ -38,6 +38,25 @@ class H26xByteToUnitStreamConverter {
                                         size_t input_frame_size,
                                         std::vector<uint8_t>* output_frame);
 
+  /// Converts a frame in two steps, so the NAL unit stream can be written
+  /// over the byte stream, e.g. in a copy of the frame which is already the
+  /// sample buffer. This is the first step: it parses the byte stream.
+  /// @param input_frame is a buffer containing a whole H.26x frame in byte
+  ///        stream format.
+  /// @param input_frame_size is the size of the H.26x frame, in bytes.
+  /// @param[out] output_frame_size is the size of the converted frame.
+  /// @return true if successful, false otherwise.
+  bool ParseByteStream(const uint8_t* input_frame,
+                       size_t input_frame_size,
+                       size_t* output_frame_size);
+
+  /// Second step of the conversion of the frame passed to ParseByteStream().
+  /// @param frame contains the byte stream frame passed to ParseByteStream(),
+  ///        or a copy of it. On return, it contains the converted frame.
+  ///        Its size must be the largest of the byte stream frame size and
+  ///        the converted frame size.
+  void WriteNalUnitStreamInPlace(uint8_t* frame);
+
   /// Creates either an AVCDecoderConfigurationRecord or a
   /// HEVCDecoderConfigurationRecord from the units extracted from the byte
   /// stream.
@@ -48,11 +67,28 @@ class H26xByteToUnitStreamConverter {
       std::vector<uint8_t>* decoder_config) const = 0;
 
  private:
+  // A NAL unit to be written to the NAL unit stream.
+  struct NaluRange {
+    // Offset of the NAL unit in the byte stream.
+    size_t input_offset;
+    // Offset of the NAL unit length in the NAL unit stream.
+    size_t output_offset;
+    size_t size;
+  };
+
   // Process the given Nalu.  If this returns true, it was handled and should
   // not be copied to the buffer.
   virtual bool ProcessNalu(const Nalu& nalu) = 0;
 
+  // Writes the NAL units in |nalus_| to |output|, reading them from |input|.
+  void WriteNalUnitStream(const uint8_t* input, uint8_t* output) const;
+
   Nalu::CodecType type_;
+  // The NAL units of the frame passed to ParseByteStream(). The vector keeps
+  // its capacity across frames.
+  std::vector<NaluRange> nalus_;
+  size_t input_frame_size_;
+  size_t output_frame_size_;
 
   DISALLOW_COPY_AND_ASSIGN(H26xByteToUnitStreamConverter);
 };
@@ -6,6 +6,7 @@
 
 #include "packager/media/filters/nal_unit_to_byte_stream_converter.h"
 
+#include <algorithm>
 #include <list>
 
 #include "packager/base/logging.h"
@@ -13,6 +14,7 @@
 #include "packager/media/base/buffer_reader.h"
 #include "packager/media/base/buffer_writer.h"
 #include "packager/media/base/macros.h"
+#include "packager/media/base/media_kernels.h"
 #include "packager/media/filters/avc_decoder_configuration.h"
 #include "packager/media/filters/nalu_reader.h"
 
@@ -27,6 +29,30 @@ const uint8_t kEmulationPreventionByte = 0x03;
 
 const uint8_t kAccessUnitDelimiterRbspAnyPrimaryPicType = 0xF0;
 
+// Size of the access unit delimiter NAL unit, without start code.
+const size_t kAccessUnitDelimiterSize = 2;
+
+// The access unit delimiter NAL unit, with start code.
+const uint8_t kAccessUnitDelimiterByteStream[] = {
+    0x00, 0x00, 0x00, 0x01, Nalu::H264_AUD,
+    kAccessUnitDelimiterRbspAnyPrimaryPicType,
+};
+
+// Returns true if the NAL unit is dropped from the samples, i.e. replaced by
+// the parameter sets from the decoder configuration or by a new AUD.
+bool IsDroppedNalu(const Nalu& nalu) {
+  switch (nalu.type()) {
+    case Nalu::H264_AUD:
+      FALLTHROUGH_INTENDED;
+    case Nalu::H264_SPS:
+      FALLTHROUGH_INTENDED;
+    case Nalu::H264_PPS:
+      return true;
+    default:
+      return false;
+  }
+}
+
 void AppendNalu(const Nalu& nalu,
                 int nalu_length_size,
                 bool escape_data,
@@ -40,6 +66,13 @@ void AppendNalu(const Nalu& nalu,
   }
 }
 
+void AddSlice(const uint8_t* data,
+              size_t size,
+              std::vector<ByteStreamSlice>* slices) {
+  const ByteStreamSlice slice = {data, size};
+  slices->push_back(slice);
+}
+
 void AddAccessUnitDelimiter(BufferWriter* buffer_writer) {
   buffer_writer->AppendInt(static_cast<uint8_t>(Nalu::H264_AUD));
   // For now, primary_pic_type is 7 which is "anything".
@@ -55,16 +88,27 @@ void EscapeNalByteSequence(const uint8_t* input,
   // byte), so that the algorithm doesn't need to go back to check the same
   // bytes.
   int consecutive_zero_count = 0;
+  // Bytes which need no escaping are appended in runs, starting at
+  // |run_start|.
+  size_t run_start = 0;
+  const MediaKernels& kernels = GetMediaKernels();
   for (size_t i = 0; i < input_size; ++i) {
-    if (consecutive_zero_count <= 1) {
-      output_writer->AppendInt(input[i]);
-    } else if (consecutive_zero_count == 2) {
+    if (consecutive_zero_count == 0) {
+      // Nothing needs escaping before the next candidate, which is not
+      // preceded by a zero. The last byte is always visited, for the
+      // cabac_zero_word check below.
+      const size_t candidate =
+          kernels.find_escape_candidate(input, input_size, i);
+      i = std::max(i, std::min(candidate, input_size - 1));
+    }
+    if (consecutive_zero_count == 2) {
       if (input[i] == 0 || input[i] == 1 || input[i] == 2 || input[i] == 3) {
         // Must be escaped.
+        output_writer->AppendArray(input + run_start, i - run_start);
         output_writer->AppendInt(kEmulationPreventionByte);
+        run_start = i;
       }
 
-      output_writer->AppendInt(input[i]);
       // Note that input[i] can be 0.
       // 00 00 00 00 00 00 should become
       // 00 00 03 00 00 03 00 00 03
@@ -76,6 +120,8 @@ void EscapeNalByteSequence(const uint8_t* input,
     consecutive_zero_count = input[i] == 0 ? consecutive_zero_count + 1 : 0;
   }
 
+  output_writer->AppendArray(input + run_start, input_size - run_start);
+
   // ISO 14496-10 Section 7.4.1.1 mentions that if the last byte is 0 (which
   // only happens if RBSP has cabac_zero_word), 0x03 must be appended.
   if (consecutive_zero_count > 0) {
@@ -149,28 +195,34 @@ bool NalUnitToByteStreamConverter::ConvertUnitToByteStream(
     return true;
   }
 
-  BufferWriter buffer_writer(sample_size);
+  // Walking the NAL unit lengths is cheap compared to copying the data, so
+  // the output size is computed first to allocate the output once. It is
+  // exact unless the data is escaped, which rarely adds bytes.
+  size_t output_size = arraysize(kNaluStartCode) + kAccessUnitDelimiterSize;
+  if (is_key_frame)
+    output_size += decoder_configuration_in_byte_stream_.size();
+  Nalu nalu;
+  NaluReader size_reader(Nalu::kH264, nalu_length_size_, sample, sample_size);
+  while (size_reader.Advance(&nalu) == NaluReader::kOk) {
+    if (!IsDroppedNalu(nalu)) {
+      output_size += arraysize(kNaluStartCode) + nalu.header_size() +
+                     nalu.payload_size();
+    }
+  }
+
+  BufferWriter buffer_writer(output_size);
   buffer_writer.AppendArray(kNaluStartCode, arraysize(kNaluStartCode));
   AddAccessUnitDelimiter(&buffer_writer);
   if (is_key_frame)
     buffer_writer.AppendVector(decoder_configuration_in_byte_stream_);
 
   NaluReader nalu_reader(Nalu::kH264, nalu_length_size_, sample, sample_size);
-  Nalu nalu;
   NaluReader::Result result = nalu_reader.Advance(&nalu);
 
   while (result == NaluReader::kOk) {
-    switch (nalu.type()) {
-      case Nalu::H264_AUD:
-        FALLTHROUGH_INTENDED;
-      case Nalu::H264_SPS:
-        FALLTHROUGH_INTENDED;
-      case Nalu::H264_PPS:
-        break;
-      default:
-        buffer_writer.AppendArray(kNaluStartCode, arraysize(kNaluStartCode));
-        AppendNalu(nalu, nalu_length_size_, escape_data_, &buffer_writer);
-        break;
+    if (!IsDroppedNalu(nalu)) {
+      buffer_writer.AppendArray(kNaluStartCode, arraysize(kNaluStartCode));
+      AppendNalu(nalu, nalu_length_size_, escape_data_, &buffer_writer);
     }
     result = nalu_reader.Advance(&nalu);
   }
@@ -185,5 +237,47 @@ bool NalUnitToByteStreamConverter::ConvertUnitToByteStream(
   return true;
 }
 
+bool NalUnitToByteStreamConverter::ConvertUnitToByteStreamSlices(
+    const uint8_t* sample,
+    size_t sample_size,
+    bool is_key_frame,
+    std::vector<ByteStreamSlice>* slices) {
+  DCHECK(slices);
+  if (escape_data_) {
+    LOG(ERROR) << "Escaped byte stream cannot reference the sample.";
+    return false;
+  }
+  slices->clear();
+  if (!sample || sample_size == 0) {
+    LOG(WARNING) << "Sample is empty.";
+    return true;
+  }
+
+  AddSlice(kAccessUnitDelimiterByteStream,
+           arraysize(kAccessUnitDelimiterByteStream), slices);
+  if (is_key_frame) {
+    AddSlice(decoder_configuration_in_byte_stream_.data(),
+             decoder_configuration_in_byte_stream_.size(), slices);
+  }
+
+  Nalu nalu;
+  NaluReader nalu_reader(Nalu::kH264, nalu_length_size_, sample, sample_size);
+  NaluReader::Result result = nalu_reader.Advance(&nalu);
+  while (result == NaluReader::kOk) {
+    if (!IsDroppedNalu(nalu)) {
+      AddSlice(kNaluStartCode, arraysize(kNaluStartCode), slices);
+      AddSlice(nalu.data(), nalu.header_size() + nalu.payload_size(), slices);
+    }
+    result = nalu_reader.Advance(&nalu);
+  }
+
+  DCHECK_NE(result, NaluReader::kOk);
+  if (result != NaluReader::kEOStream) {
+    LOG(ERROR) << "Stopped reading before end of stream.";
+    return false;
+  }
+  return true;
+}
+
 }  // namespace media
 }  // namespace edash_packager
@@ -30,6 +30,12 @@ void EscapeNalByteSequence(const uint8_t* input,
                            size_t input_size,
                            BufferWriter* output);
 
+/// A contiguous part of a byte stream.
+struct ByteStreamSlice {
+  const uint8_t* data;
+  size_t size;
+};
+
 // Methods are virtual for mocking.
 class NalUnitToByteStreamConverter {
  public:
@@ -60,6 +66,18 @@ class NalUnitToByteStreamConverter {
                                        bool is_key_frame,
                                        std::vector<uint8_t>* output);
 
+  /// Same as ConvertUnitToByteStream(), without copying the NAL units: the
+  /// byte stream is the concatenation of @a slices, which point either into
+  /// @a sample or to data owned by the converter, e.g. start codes. Not
+  /// supported if the data is escaped.
+  /// @param slices is set to the slices of the converted sample, on success.
+  /// @return true on success, false otherwise.
+  virtual bool ConvertUnitToByteStreamSlices(
+      const uint8_t* sample,
+      size_t sample_size,
+      bool is_key_frame,
+      std::vector<ByteStreamSlice>* slices);
+
  private:
   friend class NalUnitToByteStreamConverterTest;
 
@@ -6,6 +6,7 @@
 
 #include <gtest/gtest.h>
 
+#include "packager/media/base/buffer_writer.h"
 #include "packager/media/base/media_sample.h"
 #include "packager/media/filters/nal_unit_to_byte_stream_converter.h"
 
@@ -189,6 +190,62 @@ TEST(NalUnitToByteStreamConverterTest, ConvertUnitToByteStream) {
             output);
 }
 
+// Verify that the slices make the same byte stream, referencing the NAL units
+// of the sample.
+TEST(NalUnitToByteStreamConverterTest, ConvertUnitToByteStreamSlices) {
+  const uint8_t kUnitStreamLikeMediaSample[] = {
+      0x00, 0x00, 0x00, 0x0A,  // Size 10 NALU.
+      0x06,                    // NAL unit type.
+      0xFD, 0x78, 0xA4, 0xC3, 0x82, 0x62, 0x11, 0x29, 0x77,
+      0x00, 0x00, 0x00, 0x02,  // Size 2 AUD, which is dropped.
+      0x09, 0xF0,
+      0x00, 0x00, 0x00, 0x03,  // Size 3 NALU.
+      0x01, 0x9A, 0x00,
+  };
+  NalUnitToByteStreamConverter converter;
+  EXPECT_TRUE(
+      converter.Initialize(kTestAVCDecoderConfigurationRecord,
+                           arraysize(kTestAVCDecoderConfigurationRecord),
+                           !kEscapeData));
+
+  for (int key_frame = 0; key_frame < 2; ++key_frame) {
+    std::vector<uint8_t> expected_output;
+    EXPECT_TRUE(converter.ConvertUnitToByteStream(
+        kUnitStreamLikeMediaSample, arraysize(kUnitStreamLikeMediaSample),
+        key_frame != 0, &expected_output));
+
+    std::vector<ByteStreamSlice> slices;
+    EXPECT_TRUE(converter.ConvertUnitToByteStreamSlices(
+        kUnitStreamLikeMediaSample, arraysize(kUnitStreamLikeMediaSample),
+        key_frame != 0, &slices));
+    std::vector<uint8_t> output;
+    size_t num_sample_slices = 0;
+    for (const ByteStreamSlice& slice : slices) {
+      output.insert(output.end(), slice.data, slice.data + slice.size);
+      if (slice.data >= kUnitStreamLikeMediaSample &&
+          slice.data < kUnitStreamLikeMediaSample +
+                           arraysize(kUnitStreamLikeMediaSample)) {
+        ++num_sample_slices;
+      }
+    }
+    EXPECT_EQ(expected_output, output);
+    // The two NAL units kept are referenced.
+    EXPECT_EQ(2u, num_sample_slices);
+  }
+}
+
+TEST(NalUnitToByteStreamConverterTest, ConvertUnitToByteStreamSlicesEscaped) {
+  NalUnitToByteStreamConverter converter;
+  EXPECT_TRUE(
+      converter.Initialize(kTestAVCDecoderConfigurationRecord,
+                           arraysize(kTestAVCDecoderConfigurationRecord),
+                           kEscapeData));
+  const uint8_t kSample[] = {0x00, 0x00, 0x00, 0x01, 0x06};
+  std::vector<ByteStreamSlice> slices;
+  EXPECT_FALSE(converter.ConvertUnitToByteStreamSlices(
+      kSample, arraysize(kSample), kIsKeyFrame, &slices));
+}
+
 // Verify that escaping works on all data.
 TEST(NalUnitToByteStreamConverterTest, ConvertUnitToByteStreamWithEscape) {
   // Only the type of the NAL units are checked.
@@ -370,5 +427,32 @@ TEST(NalUnitToByteStreamConverterTest, DoNotEscape) {
             output);
 }
 
+// Verify that escaping finds the sequences to escape anywhere in long data,
+// which is scanned many bytes at a time.
+TEST(NalUnitToByteStreamConverterTest, EscapeLongData) {
+  std::vector<uint8_t> input(40, 0x11);
+  const uint8_t kToEscape[] = {0x00, 0x00, 0x01};
+  input.insert(input.end(), kToEscape, kToEscape + arraysize(kToEscape));
+  input.insert(input.end(), 20, 0x22);
+  // Two zeros which are not escaped, then a cabac_zero_word at the end.
+  const uint8_t kNotEscaped[] = {0x00, 0x00, 0x04, 0x00, 0x00};
+  input.insert(input.end(), kNotEscaped, kNotEscaped + arraysize(kNotEscaped));
+
+  std::vector<uint8_t> expected_output(40, 0x11);
+  const uint8_t kEscaped[] = {0x00, 0x00, 0x03, 0x01};
+  expected_output.insert(expected_output.end(), kEscaped,
+                         kEscaped + arraysize(kEscaped));
+  expected_output.insert(expected_output.end(), 20, 0x22);
+  const uint8_t kExpectedEnd[] = {0x00, 0x00, 0x04, 0x00, 0x00, 0x03};
+  expected_output.insert(expected_output.end(), kExpectedEnd,
+                         kExpectedEnd + arraysize(kExpectedEnd));
+
+  BufferWriter writer;
+  EscapeNalByteSequence(input.data(), input.size(), &writer);
+  EXPECT_EQ(expected_output,
+            std::vector<uint8_t>(writer.Buffer(),
+                                 writer.Buffer() + writer.Size()));
+}
+
 }  // namespace media
 }  // namespace edash_packager
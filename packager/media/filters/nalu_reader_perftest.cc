@@ -0,0 +1,76 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "packager/base/time/time.h"
+#include "packager/media/filters/nalu_reader.h"
+#include "packager/media/test/test_data_util.h"
+#include "packager/testing/perf/perf_test.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+// Number of bytes scanned for each measurement.
+const size_t kBytesPerRun = 512 * 1024 * 1024;
+
+// Reports the throughput of reading all the NAL units of the Annex B stream
+// |file_name|.
+void MeasureAnnexbThroughput(const std::string& file_name,
+                             Nalu::CodecType type) {
+  const std::vector<uint8_t> stream = ReadTestDataFile(file_name);
+  ASSERT_FALSE(stream.empty());
+
+  const size_t num_runs = kBytesPerRun / stream.size() + 1;
+  size_t num_nalus = 0;
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (size_t i = 0; i < num_runs; ++i) {
+    NaluReader reader(type, kIsAnnexbByteStream, stream.data(), stream.size());
+    Nalu nalu;
+    while (reader.Advance(&nalu) == NaluReader::kOk)
+      ++num_nalus;
+  }
+  const double seconds = (base::TimeTicks::Now() - start).InSecondsF();
+  ASSERT_GT(num_nalus, 0u);
+
+  perf_test::PrintResult("annexb_nalu_reader", "", file_name,
+                         num_runs * stream.size() / seconds / (1024 * 1024),
+                         "MB/s", true);
+}
+
+}  // namespace
+
+TEST(NaluReaderPerfTest, H264) {
+  MeasureAnnexbThroughput("bear.h264", Nalu::kH264);
+  MeasureAnnexbThroughput("test-25fps.h264", Nalu::kH264);
+}
+
+TEST(NaluReaderPerfTest, H265) {
+  MeasureAnnexbThroughput("hevc-byte-stream-frame.h265", Nalu::kH265);
+}
+
+TEST(NaluReaderPerfTest, StartCodeSearch) {
+  // A start code free buffer is the worst case, e.g. the data of slices.
+  std::vector<uint8_t> data(1024 * 1024, 0x5a);
+  const size_t num_runs = kBytesPerRun / data.size();
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (size_t i = 0; i < num_runs; ++i) {
+    uint64_t offset = 0;
+    uint8_t start_code_size = 0;
+    ASSERT_FALSE(NaluReader::FindStartCode(data.data(), data.size(), &offset,
+                                           &start_code_size));
+  }
+  const double seconds = (base::TimeTicks::Now() - start).InSecondsF();
+  perf_test::PrintResult("start_code_search", "", "no_start_code",
+                         kBytesPerRun / seconds / (1024 * 1024), "MB/s", true);
+}
+
+}  // namespace media
+}  // namespace edash_packager
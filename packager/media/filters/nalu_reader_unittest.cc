@@ -6,6 +6,8 @@
 
 #include <gtest/gtest.h>
 
+#include <vector>
+
 #include "packager/media/filters/nalu_reader.h"
 
 namespace edash_packager {
@@ -75,6 +77,44 @@ TEST(NaluReaderTest, StartCodeSearchWithStartCodeInsideNalUnit) {
   EXPECT_EQ(NaluReader::kEOStream, reader.Advance(&nalu));
 }
 
+// Start codes at every position around the blocks of the vectorized search.
+TEST(NaluReaderTest, FindStartCode) {
+  const size_t kDataSize = 70;
+  for (size_t position = 0; position + 3 <= kDataSize; ++position) {
+    for (uint8_t start_code_size = 3; start_code_size <= 4;
+         ++start_code_size) {
+      if (start_code_size == 4 && position + 4 > kDataSize)
+        continue;
+      // Bytes which look like the beginning of a start code.
+      std::vector<uint8_t> data(kDataSize, 0x01);
+      for (size_t i = 0; i < kDataSize; i += 3)
+        data[i] = 0x00;
+      for (size_t i = 0; i < position + start_code_size; ++i)
+        data[i] = i % 2 ? 0x01 : 0x00;
+      if (position > 0)
+        data[position - 1] = 0x02;
+      for (size_t i = 0; i < start_code_size - 1u; ++i)
+        data[position + i] = 0x00;
+      data[position + start_code_size - 1] = 0x01;
+
+      uint64_t offset = 0;
+      uint8_t found_start_code_size = 0;
+      ASSERT_TRUE(NaluReader::FindStartCode(data.data(), data.size(), &offset,
+                                            &found_start_code_size));
+      EXPECT_EQ(position, offset);
+      EXPECT_EQ(start_code_size, found_start_code_size);
+    }
+  }
+
+  const std::vector<uint8_t> kNoStartCode(kDataSize, 0x00);
+  uint64_t offset = 0;
+  uint8_t start_code_size = 0;
+  EXPECT_FALSE(NaluReader::FindStartCode(
+      kNoStartCode.data(), kNoStartCode.size(), &offset, &start_code_size));
+  EXPECT_EQ(kDataSize - 2, offset);
+  EXPECT_EQ(0u, start_code_size);
+}
+
 TEST(NaluReaderTest, OneByteNaluLength) {
   const uint8_t kNaluData[] = {
       // First NALU
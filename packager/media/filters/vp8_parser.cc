@@ -8,6 +8,7 @@
 
 #include "packager/base/logging.h"
 #include "packager/media/base/bit_reader.h"
+#include "packager/media/base/hot_path.h"
 #include "packager/media/base/rcheck.h"
 
 namespace edash_packager {
@@ -70,7 +71,7 @@ bool ReadLoopFilter(BitReader* reader) {
 bool ReadQuantization(BitReader* reader) {
   uint32_t yac_index;
   RCHECK(reader->ReadBits(7, &yac_index));
-  VLOG(4) << "yac_index: " << yac_index;
+  HOT_VLOG(4) << "yac_index: " << yac_index;
   RCHECK(reader->SkipBitsConditional(true, 4 + 1));  // y dc delta
   RCHECK(reader->SkipBitsConditional(true, 4 + 1));  // y2 dc delta
   RCHECK(reader->SkipBitsConditional(true, 4 + 1));  // y2 ac delta
@@ -170,13 +171,13 @@ bool VP8Parser::Parse(const uint8_t* data,
   vpx_frames->clear();
   vpx_frames->push_back(vpx_frame);
 
-  VLOG(3) << "\n frame_size: " << vpx_frame.frame_size
-          << "\n uncompressed_header_size: "
-          << vpx_frame.uncompressed_header_size
-          << "\n bits read: " << reader.bit_position()
-          << "\n header_size: " << header_size
-          << "\n width: " << vpx_frame.width
-          << "\n height: " << vpx_frame.height;
+  HOT_VLOG(3) << "\n frame_size: " << vpx_frame.frame_size
+              << "\n uncompressed_header_size: "
+              << vpx_frame.uncompressed_header_size
+              << "\n bits read: " << reader.bit_position()
+              << "\n header_size: " << header_size
+              << "\n width: " << vpx_frame.width
+              << "\n height: " << vpx_frame.height;
   return true;
 }
 
@@ -8,6 +8,7 @@
 
 #include "packager/base/logging.h"
 #include "packager/media/base/bit_reader.h"
+#include "packager/media/base/hot_path.h"
 #include "packager/media/base/rcheck.h"
 
 namespace edash_packager {
@@ -117,8 +118,8 @@ bool ParseIfSuperframeIndex(const uint8_t* data,
                   "index.";
     return false;
   }
-  VLOG(3) << "Superframe num_frames=" << num_frames
-          << " frame_size_length=" << frame_size_length;
+  HOT_VLOG(3) << "Superframe num_frames=" << num_frames
+              << " frame_size_length=" << frame_size_length;
 
   data += data_size - index_size + 1;
   size_t total_frame_sizes = 0;
@@ -422,7 +423,7 @@ bool VP9Parser::Parse(const uint8_t* data,
   RCHECK(ParseIfSuperframeIndex(data, data_size, vpx_frames));
 
   for (auto& vpx_frame : *vpx_frames) {
-    VLOG(4) << "process frame with size " << vpx_frame.frame_size;
+    HOT_VLOG(4) << "process frame with size " << vpx_frame.frame_size;
     BitReader reader(data, vpx_frame.frame_size);
     uint8_t frame_marker;
     RCHECK(reader.ReadBits(2, &frame_marker));
@@ -504,7 +505,8 @@ bool VP9Parser::Parse(const uint8_t* data,
     }
     RCHECK(reader.SkipBits(FRAME_CONTEXTS_LOG2));  // frame_context_idx
 
-    VLOG(4) << "bits read before ReadLoopFilter: " << reader.bit_position();
+    HOT_VLOG(4) << "bits read before ReadLoopFilter: "
+                << reader.bit_position();
     RCHECK(ReadLoopFilter(&reader));
     RCHECK(ReadQuantization(&reader));
     RCHECK(ReadSegmentation(&reader));
@@ -517,11 +519,11 @@ bool VP9Parser::Parse(const uint8_t* data,
     vpx_frame.width = width_;
     vpx_frame.height = height_;
 
-    VLOG(3) << "\n frame_size: " << vpx_frame.frame_size
-            << "\n uncompressed_header_size: "
-            << vpx_frame.uncompressed_header_size
-            << "\n bits read: " << reader.bit_position()
-            << "\n header_size: " << header_size;
+    HOT_VLOG(3) << "\n frame_size: " << vpx_frame.frame_size
+                << "\n uncompressed_header_size: "
+                << vpx_frame.uncompressed_header_size
+                << "\n bits read: " << reader.bit_position()
+                << "\n header_size: " << header_size;
 
     RCHECK(header_size > 0);
     RCHECK(header_size * 8 <= reader.bits_available());
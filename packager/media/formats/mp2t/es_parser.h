@@ -9,6 +9,9 @@
 
 #include "packager/base/callback.h"
 #include "packager/base/memory/ref_counted.h"
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/media/base/sample_buffer_pool.h"
+#include "packager/media/base/sample_slab_allocator.h"
 
 namespace edash_packager {
 namespace media {
@@ -25,7 +28,12 @@ class EsParser {
   typedef base::Callback<void(uint32_t, const scoped_refptr<MediaSample>&)>
       EmitSampleCB;
 
-  EsParser(uint32_t pid) : pid_(pid) {}
+  EsParser(uint32_t pid)
+      : pid_(pid),
+        max_buffered_bytes_(0),
+        sample_buffer_pool_(new SampleBufferPool),
+        sample_slab_allocator_(
+            new SampleSlabAllocator(sample_buffer_pool_.get())) {}
   virtual ~EsParser() {}
 
   // ES parsing.
@@ -43,8 +51,27 @@ class EsParser {
 
   uint32_t pid() { return pid_; }
 
+  // Maximum number of bytes buffered by the parser and by its PES section
+  // parser, 0 for no limit. Parse() fails past it.
+  void set_max_buffered_bytes(uint64_t max_buffered_bytes) {
+    max_buffered_bytes_ = max_buffered_bytes;
+  }
+  uint64_t max_buffered_bytes() const { return max_buffered_bytes_; }
+
+ protected:
+  // Pool to allocate the payload of the emitted samples from.
+  SampleBufferPool* sample_buffer_pool() { return sample_buffer_pool_.get(); }
+  // Allocator packing the payload of small samples, e.g. audio frames, in
+  // shared slabs. Larger samples are allocated from sample_buffer_pool().
+  SampleSlabAllocator* sample_slab_allocator() {
+    return sample_slab_allocator_.get();
+  }
+
  private:
   uint32_t pid_;
+  uint64_t max_buffered_bytes_;
+  scoped_refptr<SampleBufferPool> sample_buffer_pool_;
+  scoped_ptr<SampleSlabAllocator> sample_slab_allocator_;
 };
 
 }  // namespace mp2t
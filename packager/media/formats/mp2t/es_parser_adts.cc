@@ -5,6 +5,7 @@
 #include "packager/media/formats/mp2t/es_parser_adts.h"
 
 #include <stdint.h>
+#include <string.h>
 
 #include <list>
 
@@ -55,7 +56,13 @@ static bool LookForSyncWord(const uint8_t* raw_es,
   }
 
   for (int offset = pos; offset < max_offset; offset++) {
-    const uint8_t* cur_buf = &raw_es[offset];
+    // Jump to the next 0xff byte, which is the only possible start of a
+    // syncword, instead of testing every byte.
+    const uint8_t* cur_buf = static_cast<const uint8_t*>(
+        memchr(&raw_es[offset], 0xff, max_offset - offset));
+    if (!cur_buf)
+      break;
+    offset = cur_buf - raw_es;
 
     if (!isAdtsSyncWord(cur_buf))
       // The first 12 bits must be 1.
@@ -95,7 +102,8 @@ EsParserAdts::EsParserAdts(uint32_t pid,
     : EsParser(pid),
       new_stream_info_cb_(new_stream_info_cb),
       emit_sample_cb_(emit_sample_cb),
-      sbr_in_mimetype_(sbr_in_mimetype) {
+      sbr_in_mimetype_(sbr_in_mimetype),
+      last_fixed_header_(0) {
 }
 
 EsParserAdts::~EsParserAdts() {
@@ -118,10 +126,17 @@ bool EsParserAdts::Parse(const uint8_t* buf,
   // Copy the input data to the ES buffer.
   es_byte_queue_.Push(buf, size);
   es_byte_queue_.Peek(&raw_es, &raw_es_size);
+  if (max_buffered_bytes() > 0 &&
+      static_cast<uint64_t>(raw_es_size) > max_buffered_bytes()) {
+    LOG(ERROR) << "More than " << max_buffered_bytes()
+               << " bytes buffered without an ADTS frame.";
+    return false;
+  }
 
   // Look for every ADTS frame in the ES buffer starting at offset = 0
   int es_position = 0;
   int frame_size;
+  int64_t next_pts = kNoTimestamp;
   while (LookForSyncWord(raw_es, raw_es_size, es_position,
                          &es_position, &frame_size)) {
     const uint8_t* frame_ptr = raw_es + es_position;
@@ -139,38 +154,47 @@ bool EsParserAdts::Parse(const uint8_t* buf,
 
     size_t header_size = AdtsHeader::GetAdtsHeaderSize(frame_ptr, frame_size);
 
-    // Update the audio configuration if needed.
+    // Update the audio configuration if needed. Frames sharing the fixed
+    // part of the header of the previous frame share its configuration, so
+    // the header is only fully parsed when that part changes.
     DCHECK_GE(frame_size, kAdtsHeaderMinSize);
-    if (!UpdateAudioConfiguration(frame_ptr, frame_size))
-      return false;
+    const uint32_t fixed_header = GetFixedHeader(frame_ptr);
+    if (!last_audio_decoder_config_ || fixed_header != last_fixed_header_) {
+      if (!UpdateAudioConfiguration(frame_ptr, frame_size))
+        return false;
+      last_fixed_header_ = fixed_header;
+      next_pts = kNoTimestamp;
+    }
 
     // Get the PTS & the duration of this access unit.
     while (!pts_list_.empty() &&
            pts_list_.front().first <= es_position) {
       audio_timestamp_helper_->SetBaseTimestamp(pts_list_.front().second);
       pts_list_.pop_front();
+      next_pts = kNoTimestamp;
     }
 
-    int64_t current_pts = audio_timestamp_helper_->GetTimestamp();
-    int64_t frame_duration =
-        audio_timestamp_helper_->GetFrameDuration(kSamplesPerAACFrame);
+    // The end timestamp of the previous frame is the start timestamp of this
+    // one unless the timestamp helper has been reset.
+    int64_t current_pts = next_pts != kNoTimestamp
+                              ? next_pts
+                              : audio_timestamp_helper_->GetTimestamp();
+    // Update the PTS of the next frame.
+    audio_timestamp_helper_->AddFrames(kSamplesPerAACFrame);
+    next_pts = audio_timestamp_helper_->GetTimestamp();
+    int64_t frame_duration = next_pts - current_pts;
 
     // Emit an audio frame.
     bool is_key_frame = true;
 
-    scoped_refptr<MediaSample> sample =
-        MediaSample::CopyFrom(
-            frame_ptr + header_size,
-            frame_size - header_size,
-            is_key_frame);
+    // AAC frames are small, so they are packed together in shared slabs.
+    scoped_refptr<MediaSample> sample = sample_slab_allocator()->CopyFrom(
+        frame_ptr + header_size, frame_size - header_size, is_key_frame);
     sample->set_pts(current_pts);
     sample->set_dts(current_pts);
     sample->set_duration(frame_duration);
     emit_sample_cb_.Run(pid(), sample);
 
-    // Update the PTS of the next frame.
-    audio_timestamp_helper_->AddFrames(kSamplesPerAACFrame);
-
     // Skip the current frame.
     es_position += frame_size;
   }
@@ -188,6 +212,16 @@ void EsParserAdts::Reset() {
   es_byte_queue_.Reset();
   pts_list_.clear();
   last_audio_decoder_config_ = scoped_refptr<AudioStreamInfo>();
+  last_fixed_header_ = 0;
+}
+
+uint32_t EsParserAdts::GetFixedHeader(const uint8_t* adts_frame) {
+  // The fixed header ends with the home bit in the 4 MSBs of byte 3; the
+  // rest of byte 3 belongs to the variable header.
+  return (static_cast<uint32_t>(adts_frame[0]) << 24) |
+         (static_cast<uint32_t>(adts_frame[1]) << 16) |
+         (static_cast<uint32_t>(adts_frame[2]) << 8) |
+         (adts_frame[3] & 0xf0);
 }
 
 bool EsParserAdts::UpdateAudioConfiguration(const uint8_t* adts_frame,
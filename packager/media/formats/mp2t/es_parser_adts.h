@@ -45,6 +45,10 @@ class EsParserAdts : public EsParser {
   // a supported ADTS audio config.
   bool UpdateAudioConfiguration(const uint8_t* adts_frame, size_t frame_size);
 
+  // Return the fixed part of the ADTS header of |adts_frame|, i.e. the part
+  // which is the same for all the frames with the same audio configuration.
+  static uint32_t GetFixedHeader(const uint8_t* adts_frame);
+
   // Discard some bytes from the ES stream.
   void DiscardEs(int nbytes);
 
@@ -69,6 +73,9 @@ class EsParserAdts : public EsParser {
 
   scoped_refptr<StreamInfo> last_audio_decoder_config_;
 
+  // Fixed header of the frame |last_audio_decoder_config_| was built from.
+  uint32_t last_fixed_header_;
+
   DISALLOW_COPY_AND_ASSIGN(EsParserAdts);
 };
 
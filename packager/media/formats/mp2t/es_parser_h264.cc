@@ -51,20 +51,28 @@ bool EsParserH264::ProcessNalu(const Nalu& nalu,
     }
     case Nalu::H264_SPS: {
       DVLOG(LOG_LEVEL_ES) << "Nalu: SPS";
+      if (IsRepeatedParameterSet(nalu))
+        break;
       int sps_id;
       if (h264_parser_->ParseSps(nalu, &sps_id) != H264Parser::kOk)
         return false;
+      RecordParameterSet(nalu, sps_id);
+      // The PPS are parsed against the SPS.
+      ForgetParameterSets(Nalu::H264_PPS);
       decoder_config_check_pending_ = true;
       break;
     }
     case Nalu::H264_PPS: {
       DVLOG(LOG_LEVEL_ES) << "Nalu: PPS";
+      if (IsRepeatedParameterSet(nalu))
+        break;
       int pps_id;
       if (h264_parser_->ParsePps(nalu, &pps_id) != H264Parser::kOk) {
         // Allow PPS parsing to fail if waiting for SPS.
         if (last_video_decoder_config_)
           return false;
       } else {
+        RecordParameterSet(nalu, pps_id);
         decoder_config_check_pending_ = true;
       }
       break;
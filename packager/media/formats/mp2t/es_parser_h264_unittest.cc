@@ -119,6 +119,7 @@ class EsParserH264Test : public testing::Test {
  public:
   EsParserH264Test()
       : sample_count_(0),
+        new_config_count_(0),
         first_frame_is_key_frame_(false) {}
 
   void LoadStream(const char* filename);
@@ -133,9 +134,11 @@ class EsParserH264Test : public testing::Test {
   void NewVideoConfig(const scoped_refptr<StreamInfo>& config) {
     DVLOG(1) << config->ToString();
     stream_map_[config->track_id()] = config;
+    new_config_count_++;
   }
 
   size_t sample_count() const { return sample_count_; }
+  size_t new_config_count() const { return new_config_count_; }
   bool first_frame_is_key_frame() { return first_frame_is_key_frame_; }
 
   // Stream with AUD NALUs.
@@ -148,6 +151,7 @@ class EsParserH264Test : public testing::Test {
   typedef std::map<int, scoped_refptr<StreamInfo> > StreamMap;
   StreamMap stream_map_;
   size_t sample_count_;
+  size_t new_config_count_;
   bool first_frame_is_key_frame_;
 };
 
@@ -280,6 +284,27 @@ TEST_F(EsParserH264Test, NonIFrameStart) {
   EXPECT_TRUE(first_frame_is_key_frame());
 }
 
+// Verify that the parameter sets repeated in the stream give a single stream
+// info.
+TEST_F(EsParserH264Test, RepeatedParameterSets) {
+  LoadStream("bear.h264");
+  // Play the stream twice, with the same parameter sets.
+  const std::vector<uint8_t> stream(stream_);
+  const size_t stream_size = stream.size();
+  const size_t num_access_units = access_units_.size();
+  stream_.insert(stream_.end(), stream.begin(), stream.end());
+  for (size_t i = 0; i < num_access_units; ++i) {
+    Packet access_unit = access_units_[i];
+    access_unit.offset += stream_size;
+    access_units_.push_back(access_unit);
+  }
+
+  std::vector<Packet> pes_packets(access_units_);
+  ProcessPesPackets(pes_packets);
+  EXPECT_EQ(access_units_.size(), sample_count());
+  EXPECT_EQ(1u, new_config_count());
+}
+
 // Verify that the parser can get the the sar width and height.
 TEST_F(EsParserH264Test, PixelWidthPixelHeight) {
   LoadStream("bear.h264");
@@ -54,20 +54,28 @@ bool EsParserH265::ProcessNalu(const Nalu& nalu,
     }
     case Nalu::H265_SPS: {
       DVLOG(LOG_LEVEL_ES) << "Nalu: SPS";
+      if (IsRepeatedParameterSet(nalu))
+        break;
       int sps_id;
       if (h265_parser_->ParseSps(nalu, &sps_id) != H265Parser::kOk)
         return false;
+      RecordParameterSet(nalu, sps_id);
+      // The PPS are parsed against the SPS.
+      ForgetParameterSets(Nalu::H265_PPS);
       decoder_config_check_pending_ = true;
       break;
     }
     case Nalu::H265_PPS: {
       DVLOG(LOG_LEVEL_ES) << "Nalu: PPS";
+      if (IsRepeatedParameterSet(nalu))
+        break;
       int pps_id;
       if (h265_parser_->ParsePps(nalu, &pps_id) != H265Parser::kOk) {
         // Allow PPS parsing to fail if waiting for SPS.
         if (last_video_decoder_config_)
           return false;
       } else {
+        RecordParameterSet(nalu, pps_id);
         decoder_config_check_pending_ = true;
       }
       break;
@@ -6,9 +6,12 @@
 
 #include <stdint.h>
 
+#include <algorithm>
+
 #include "packager/base/logging.h"
 #include "packager/base/numerics/safe_conversions.h"
 #include "packager/media/base/media_sample.h"
+#include "packager/media/base/media_kernels.h"
 #include "packager/media/base/offset_byte_queue.h"
 #include "packager/media/base/timestamp.h"
 #include "packager/media/base/video_stream_info.h"
@@ -63,6 +66,13 @@ bool EsParserH26x::Parse(const uint8_t* buf,
 
   // Add the incoming bytes to the ES queue.
   es_queue_->Push(buf, size);
+  if (max_buffered_bytes() > 0 &&
+      static_cast<uint64_t>(es_queue_->tail() - es_queue_->head()) >
+          max_buffered_bytes()) {
+    LOG(ERROR) << "More than " << max_buffered_bytes()
+               << " bytes buffered without an access unit.";
+    return false;
+  }
 
   // Skip to the first access unit.
   if (!found_access_unit_) {
@@ -109,6 +119,51 @@ void EsParserH26x::Reset() {
   pending_sample_ = scoped_refptr<MediaSample>();
   pending_sample_duration_ = 0;
   waiting_for_key_frame_ = true;
+  parameter_sets_.clear();
+}
+
+bool EsParserH26x::IsRepeatedParameterSet(const Nalu& nalu) const {
+  const size_t size = nalu.header_size() + nalu.payload_size();
+  const uint32_t checksum = GetMediaKernels().crc32c(0, nalu.data(), size);
+  for (const ParameterSet& parameter_set : parameter_sets_) {
+    if (parameter_set.type == nalu.type() &&
+        parameter_set.checksum == checksum &&
+        parameter_set.data.size() == size &&
+        std::equal(parameter_set.data.begin(), parameter_set.data.end(),
+                   nalu.data())) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void EsParserH26x::RecordParameterSet(const Nalu& nalu, int id) {
+  const size_t size = nalu.header_size() + nalu.payload_size();
+  ParameterSet* recorded = nullptr;
+  for (ParameterSet& parameter_set : parameter_sets_) {
+    if (parameter_set.type == nalu.type() && parameter_set.id == id) {
+      recorded = &parameter_set;
+      break;
+    }
+  }
+  if (!recorded) {
+    parameter_sets_.resize(parameter_sets_.size() + 1);
+    recorded = &parameter_sets_.back();
+    recorded->type = nalu.type();
+    recorded->id = id;
+  }
+  recorded->checksum = GetMediaKernels().crc32c(0, nalu.data(), size);
+  recorded->data.assign(nalu.data(), nalu.data() + size);
+}
+
+void EsParserH26x::ForgetParameterSets(int nalu_type) {
+  std::vector<ParameterSet>::iterator it = parameter_sets_.begin();
+  while (it != parameter_sets_.end()) {
+    if (it->type == nalu_type)
+      it = parameter_sets_.erase(it);
+    else
+      ++it;
+  }
 }
 
 bool EsParserH26x::FindNextAccessUnit(int64_t stream_pos,
@@ -251,10 +306,9 @@ bool EsParserH26x::EmitFrame(int64_t access_unit_pos,
   es_queue_->PeekAt(current_access_unit_pos_, &es, &es_size);
   CHECK_GE(es_size, access_unit_size);
 
-  // Convert frame to unit stream format.
-  std::vector<uint8_t> converted_frame;
-  if (!stream_converter_->ConvertByteStreamToNalUnitStream(
-          es, access_unit_size, &converted_frame)) {
+  size_t converted_frame_size = 0;
+  if (!stream_converter_->ParseByteStream(es, access_unit_size,
+                                          &converted_frame_size)) {
     DLOG(ERROR) << "Failure to convert video frame to unit stream format.";
     return false;
   }
@@ -263,9 +317,14 @@ bool EsParserH26x::EmitFrame(int64_t access_unit_pos,
   RCHECK(UpdateVideoDecoderConfig(pps_id));
 
   // Create the media sample, emitting always the previous sample after
-  // calculating its duration.
+  // calculating its duration. The frame is copied once, then converted to
+  // unit stream format in the sample buffer.
   scoped_refptr<MediaSample> media_sample = MediaSample::CopyFrom(
-      converted_frame.data(), converted_frame.size(), is_key_frame);
+      es, access_unit_size, NULL, 0, is_key_frame, sample_buffer_pool());
+  if (converted_frame_size > static_cast<size_t>(access_unit_size))
+    media_sample->resize_data(converted_frame_size);
+  stream_converter_->WriteNalUnitStreamInPlace(media_sample->writable_data());
+  media_sample->resize_data(converted_frame_size);
   media_sample->set_dts(current_timing_desc.dts);
   media_sample->set_pts(current_timing_desc.pts);
   if (pending_sample_) {
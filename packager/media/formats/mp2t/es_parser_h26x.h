@@ -8,6 +8,7 @@
 #include <stdint.h>
 
 #include <list>
+#include <vector>
 
 #include "packager/base/callback.h"
 #include "packager/base/compiler_specific.h"
@@ -42,12 +43,31 @@ class EsParserH26x : public EsParser {
     return stream_converter_.get();
   }
 
+  // Returns true if |nalu|, a parameter set, is byte for byte the parameter
+  // set of its type and id recorded last, so that parsing it again would
+  // change nothing. Broadcast streams repeat the parameter sets before every
+  // key frame.
+  bool IsRepeatedParameterSet(const Nalu& nalu) const;
+  // Records |nalu|, a parameter set just parsed, whose id is |id|.
+  void RecordParameterSet(const Nalu& nalu, int id);
+  // Forgets the parameter sets of type |nalu_type|, e.g. once the parameter
+  // sets they are parsed against change.
+  void ForgetParameterSets(int nalu_type);
+
  private:
   struct TimingDesc {
     int64_t dts;
     int64_t pts;
   };
 
+  struct ParameterSet {
+    int type;
+    int id;
+    // CRC32C of |data|, to tell most changes without comparing the bytes.
+    uint32_t checksum;
+    std::vector<uint8_t> data;
+  };
+
   // Processes a NAL unit found in ParseInternal.  The @a pps_id_for_access_unit
   // value will be passed to UpdateVideoDecoderConfig.
   virtual bool ProcessNalu(const Nalu& nalu,
@@ -100,6 +120,9 @@ class EsParserH26x : public EsParser {
 
   // Indicates whether waiting for first key frame.
   bool waiting_for_key_frame_;
+
+  // The parameter sets recorded, at most one per type and id.
+  std::vector<ParameterSet> parameter_sets_;
 };
 
 }  // namespace mp2t
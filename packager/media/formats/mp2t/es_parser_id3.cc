@@ -0,0 +1,54 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/formats/mp2t/es_parser_id3.h"
+
+#include "packager/base/logging.h"
+#include "packager/media/base/timed_metadata.h"
+#include "packager/media/base/timestamp.h"
+
+namespace edash_packager {
+namespace media {
+namespace mp2t {
+
+namespace {
+const uint32_t kMpeg2Timescale = 90000;
+}  // namespace
+
+EsParserId3::EsParserId3(uint32_t pid,
+                         const MediaParser::TimedMetadataCB& event_cb)
+    : EsParser(pid), event_cb_(event_cb) {}
+
+EsParserId3::~EsParserId3() {}
+
+bool EsParserId3::Parse(const uint8_t* buf,
+                        int size,
+                        int64_t pts,
+                        int64_t dts) {
+  // The metadata is only meaningful at a time.
+  if (pts == kNoTimestamp || size <= 0) {
+    DVLOG(1) << "Ignoring ID3 data without a timestamp on pid " << pid();
+    return true;
+  }
+  if (event_cb_.is_null())
+    return true;
+
+  TimedMetadataEvent event;
+  event.scheme_id_uri = kId3SchemeIdUri;
+  event.timescale = kMpeg2Timescale;
+  event.presentation_time = pts;
+  event.message_data.assign(buf, buf + size);
+  event_cb_.Run(event);
+  return true;
+}
+
+void EsParserId3::Flush() {}
+
+void EsParserId3::Reset() {}
+
+}  // namespace mp2t
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,42 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_FORMATS_MP2T_ES_PARSER_ID3_H_
+#define MEDIA_FORMATS_MP2T_ES_PARSER_ID3_H_
+
+#include "packager/base/callback.h"
+#include "packager/base/compiler_specific.h"
+#include "packager/media/base/media_parser.h"
+#include "packager/media/formats/mp2t/es_parser.h"
+
+namespace edash_packager {
+namespace media {
+namespace mp2t {
+
+/// Parser of the ID3 timed metadata carried in PES packets, which emits each
+/// PES packet as a timed metadata event. The tags are not parsed: the
+/// payload of the event is the whole ID3 data of the packet.
+class EsParserId3 : public EsParser {
+ public:
+  EsParserId3(uint32_t pid, const MediaParser::TimedMetadataCB& event_cb);
+  ~EsParserId3() override;
+
+  // EsParser implementation.
+  bool Parse(const uint8_t* buf, int size, int64_t pts, int64_t dts) override;
+  void Flush() override;
+  void Reset() override;
+
+ private:
+  MediaParser::TimedMetadataCB event_cb_;
+
+  DISALLOW_COPY_AND_ASSIGN(EsParserId3);
+};
+
+}  // namespace mp2t
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_FORMATS_MP2T_ES_PARSER_ID3_H_
@@ -12,6 +12,7 @@
     {
       'target_name': 'mp2t',
       'type': '<(component)',
+      'includes': ['../../../hot_code.gypi'],
       'sources': [
         'adts_header.cc',
         'adts_header.h',
@@ -25,6 +26,8 @@
         'es_parser_h265.h',
         'es_parser_h26x.cc',
         'es_parser_h26x.h',
+        'es_parser_id3.cc',
+        'es_parser_id3.h',
         'es_parser.h',
         'mp2t_media_parser.cc',
         'mp2t_media_parser.h',
@@ -48,6 +51,8 @@
         'ts_section_pmt.h',
         'ts_section_psi.cc',
         'ts_section_psi.h',
+        'ts_section_scte35.cc',
+        'ts_section_scte35.h',
         'ts_segmenter.cc',
         'ts_segmenter.h',
         'ts_writer.cc',
@@ -59,6 +64,7 @@
         # TODO(rkuroiwa): AACAudioSpecificConfig is used to create ADTS.
         # Break this dependency on mp4 by moving it to media/filters.
         '../../formats/mp4/mp4.gyp:mp4',
+        '../../../third_party/gflags/gflags.gyp:gflags',
       ],
     },
     {
@@ -71,12 +77,14 @@
         'mp2t_media_parser_unittest.cc',
         'pes_packet_generator_unittest.cc',
         'program_map_table_writer_unittest.cc',
+        'ts_section_scte35_unittest.cc',
         'ts_segmenter_unittest.cc',
         'ts_writer_unittest.cc',
       ],
       'dependencies': [
         '../../../testing/gtest.gyp:gtest',
         '../../../testing/gmock.gyp:gmock',
+        '../../../third_party/gflags/gflags.gyp:gflags',
         '../../event/media_event.gyp:mock_muxer_listener',
         '../../filters/filters.gyp:filters',
         '../../test/media_test.gyp:media_test_support',
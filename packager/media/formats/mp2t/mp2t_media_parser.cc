@@ -4,32 +4,54 @@
 
 #include "packager/media/formats/mp2t/mp2t_media_parser.h"
 
+#include <gflags/gflags.h>
+
 #include "packager/base/bind.h"
 #include "packager/base/memory/scoped_ptr.h"
 #include "packager/base/stl_util.h"
 #include "packager/media/base/media_sample.h"
 #include "packager/media/base/stream_info.h"
+#include "packager/media/base/thread_pool.h"
 #include "packager/media/formats/mp2t/es_parser.h"
 #include "packager/media/formats/mp2t/es_parser_adts.h"
 #include "packager/media/formats/mp2t/es_parser_h264.h"
 #include "packager/media/formats/mp2t/es_parser_h265.h"
+#include "packager/media/formats/mp2t/es_parser_id3.h"
 #include "packager/media/formats/mp2t/mp2t_common.h"
 #include "packager/media/formats/mp2t/ts_packet.h"
 #include "packager/media/formats/mp2t/ts_section.h"
 #include "packager/media/formats/mp2t/ts_section_pat.h"
 #include "packager/media/formats/mp2t/ts_section_pes.h"
 #include "packager/media/formats/mp2t/ts_section_pmt.h"
+#include "packager/media/formats/mp2t/ts_section_scte35.h"
+
+DEFINE_int32(mp2t_es_parser_threads,
+             0,
+             "Number of threads parsing the elementary streams of MPEG-2 TS "
+             "inputs, so that the audio and video streams are parsed "
+             "concurrently. 0 or 1 parses them on the demuxer thread.");
 
 namespace edash_packager {
 namespace media {
 namespace mp2t {
 
+namespace {
+// PIDs are 13 bits. The null packets, which are only stuffing, use the last
+// one.
+const int kNumPids = 1 << 13;
+const int kPidNull = 0x1fff;
+const uint8_t kTsHeaderSyncword = 0x47;
+}  // namespace
+
 enum StreamType {
   // ISO-13818.1 / ITU H.222 Table 2.34 "Stream type assignments"
   kStreamTypeMpeg1Audio = 0x3,
   kStreamTypeAAC = 0xf,
+  kStreamTypeId3 = 0x15,
   kStreamTypeAVC = 0x1b,
   kStreamTypeHEVC = 0x24,
+  // SCTE 35, section 8.1 "Program Map Table requirements".
+  kStreamTypeScte35 = 0x86,
 };
 
 class PidState {
@@ -39,15 +61,29 @@ class PidState {
     kPidPmt,
     kPidAudioPes,
     kPidVideoPes,
+    // Timed metadata, i.e. ID3 PES or SCTE-35 sections, which is not a
+    // stream of the program.
+    kPidMetadata,
   };
 
   PidState(int pid, PidType pid_type,
            scoped_ptr<TsSection> section_parser);
+  ~PidState();
 
   // Extract the content of the TS packet and parse it.
   // Return true if successful.
   bool PushTsPacket(const TsPacket& ts_packet);
 
+  // Queue a TS packet, to be parsed by PushQueuedTsPackets(). The payload of
+  // the packet must stay valid until then.
+  void QueueTsPacket(scoped_ptr<TsPacket> ts_packet);
+  bool has_queued_ts_packets() const { return !queued_ts_packets_.empty(); }
+
+  // Push the queued TS packets in order, stopping at the first failure. The
+  // result is returned by queued_ts_packets_status().
+  void PushQueuedTsPackets();
+  bool queued_ts_packets_status() const { return queued_ts_packets_status_; }
+
   // Flush the PID state (possibly emitting some pending frames)
   // and reset its state.
   void Flush();
@@ -60,12 +96,20 @@ class PidState {
   bool IsEnabled() const;
 
   PidType pid_type() const { return pid_type_; }
+  bool is_pes() const {
+    return pid_type_ == kPidAudioPes || pid_type_ == kPidVideoPes;
+  }
 
   scoped_refptr<StreamInfo>& config() { return config_; }
   void set_config(const scoped_refptr<StreamInfo>& config) { config_ = config; }
 
   SampleQueue& sample_queue() { return sample_queue_; }
 
+  int program_number() const { return program_number_; }
+  void set_program_number(int program_number) {
+    program_number_ = program_number;
+  }
+
  private:
   void ResetState();
 
@@ -77,6 +121,9 @@ class PidState {
   int continuity_counter_;
   scoped_refptr<StreamInfo> config_;
   SampleQueue sample_queue_;
+  int program_number_;
+  std::vector<TsPacket*> queued_ts_packets_;
+  bool queued_ts_packets_status_;
 };
 
 PidState::PidState(int pid, PidType pid_type,
@@ -85,10 +132,16 @@ PidState::PidState(int pid, PidType pid_type,
       pid_type_(pid_type),
       section_parser_(section_parser.Pass()),
       enable_(false),
-      continuity_counter_(-1) {
+      continuity_counter_(-1),
+      program_number_(0),
+      queued_ts_packets_status_(true) {
   DCHECK(section_parser_);
 }
 
+PidState::~PidState() {
+  STLDeleteElements(&queued_ts_packets_);
+}
+
 bool PidState::PushTsPacket(const TsPacket& ts_packet) {
   DCHECK_EQ(ts_packet.pid(), pid_);
 
@@ -120,6 +173,21 @@ bool PidState::PushTsPacket(const TsPacket& ts_packet) {
   return status;
 }
 
+void PidState::QueueTsPacket(scoped_ptr<TsPacket> ts_packet) {
+  queued_ts_packets_.push_back(ts_packet.release());
+}
+
+void PidState::PushQueuedTsPackets() {
+  queued_ts_packets_status_ = true;
+  for (const TsPacket* ts_packet : queued_ts_packets_) {
+    if (!PushTsPacket(*ts_packet)) {
+      queued_ts_packets_status_ = false;
+      break;
+    }
+  }
+  STLDeleteElements(&queued_ts_packets_);
+}
+
 void PidState::Flush() {
   section_parser_->Flush();
   ResetState();
@@ -148,7 +216,16 @@ void PidState::ResetState() {
 
 Mp2tMediaParser::Mp2tMediaParser()
     : sbr_in_mimetype_(false),
-      is_initialized_(false) {
+      is_initialized_(false),
+      tracks_selected_(false),
+      skipped_pids_(kNumPids, false),
+      parsing_es_concurrently_(false) {
+  skipped_pids_[kPidNull] = true;
+  if (FLAGS_mp2t_es_parser_threads > 1) {
+    es_parser_thread_pool_.reset(
+        new ThreadPool("Mp2tEsParser", FLAGS_mp2t_es_parser_threads));
+    es_parser_thread_pool_->Start();
+  }
 }
 
 Mp2tMediaParser::~Mp2tMediaParser() {
@@ -209,6 +286,14 @@ bool Mp2tMediaParser::Parse(const uint8_t* buf, int size) {
       continue;
     }
 
+    // Drop the packets which would be ignored anyway without parsing them.
+    int skipped_packets = CountSkippedTsPackets(ts_buffer, ts_buffer_size);
+    if (skipped_packets > 0) {
+      DVLOG(LOG_LEVEL_TS) << "Skipping " << skipped_packets << " TS packets";
+      ts_byte_queue_.Pop(skipped_packets * TsPacket::kPacketSize);
+      continue;
+    }
+
     // Parse the TS header, skipping 1 byte if the header is invalid.
     scoped_ptr<TsPacket> ts_packet(TsPacket::Parse(ts_buffer, ts_buffer_size));
     if (!ts_packet) {
@@ -239,8 +324,17 @@ bool Mp2tMediaParser::Parse(const uint8_t* buf, int size) {
     }
 
     if (it != pids_.end()) {
-      if (!it->second->PushTsPacket(*ts_packet))
+      if (es_parser_thread_pool_ && it->second->is_pes()) {
+        // The PES packets are parsed once the whole buffer is demultiplexed.
+        // The data popped from |ts_byte_queue_| stays valid until then.
+        it->second->QueueTsPacket(ts_packet.Pass());
+      } else if (!it->second->PushTsPacket(*ts_packet)) {
+        // The queued PES packets reference |ts_byte_queue_|, so they are
+        // parsed before it is modified.
+        if (es_parser_thread_pool_)
+          ParseQueuedTsPackets();
         return false;
+      }
     } else {
       DVLOG(LOG_LEVEL_TS) << "Ignoring TS packet for pid: " << ts_packet->pid();
     }
@@ -249,47 +343,121 @@ bool Mp2tMediaParser::Parse(const uint8_t* buf, int size) {
     ts_byte_queue_.Pop(TsPacket::kPacketSize);
   }
 
+  if (es_parser_thread_pool_ && !ParseQueuedTsPackets())
+    return false;
+
   // Emit the A/V buffers that kept accumulating during TS parsing.
   return EmitRemainingSamples();
 }
 
+void Mp2tMediaParser::SelectTracks(const std::set<uint32_t>& track_ids) {
+  DCHECK(is_initialized_);
+  tracks_selected_ = true;
+
+  // Only the PAT, the PMTs and the selected PES PIDs are needed from now on,
+  // e.g. only those of one program of a multi-program TS.
+  skipped_pids_.assign(kNumPids, true);
+  skipped_pids_[TsSection::kPidPat] = false;
+  for (PidMap::iterator it = pids_.begin(); it != pids_.end(); ++it) {
+    PidState* pid_state = it->second;
+    if (!pid_state->is_pes() || track_ids.count(it->first) > 0) {
+      skipped_pids_[it->first] = false;
+      continue;
+    }
+    DVLOG(1) << "Skipping unselected PES pid=" << it->first;
+    pid_state->Disable();
+    pid_state->sample_queue().clear();
+  }
+}
+
+int Mp2tMediaParser::CountSkippedTsPackets(const uint8_t* buf,
+                                           int size) const {
+  // The TS packets are strided, so only the first 3 bytes of each one are
+  // loaded: the syncword and the PID.
+  int num_packets = 0;
+  for (; size >= TsPacket::kPacketSize; size -= TsPacket::kPacketSize) {
+    const uint8_t* packet = buf + num_packets * TsPacket::kPacketSize;
+    const int pid = ((packet[1] & 0x1f) << 8) | packet[2];
+    if (packet[0] != kTsHeaderSyncword || !skipped_pids_[pid])
+      break;
+    ++num_packets;
+  }
+  return num_packets;
+}
+
+bool Mp2tMediaParser::ParseQueuedTsPackets() {
+  std::vector<PidState*> pid_states;
+  for (PidMap::const_iterator it = pids_.begin(); it != pids_.end(); ++it) {
+    if (it->second->has_queued_ts_packets())
+      pid_states.push_back(it->second);
+  }
+  if (pid_states.empty())
+    return true;
+
+  // The parsers only access the state of their own PID, and |pids_| is not
+  // modified until they have all completed.
+  std::vector<base::Closure> tasks;
+  for (PidState* pid_state : pid_states) {
+    tasks.push_back(base::Bind(&PidState::PushQueuedTsPackets,
+                               base::Unretained(pid_state)));
+  }
+  parsing_es_concurrently_ = true;
+  if (tasks.size() == 1)
+    tasks[0].Run();
+  else
+    es_parser_thread_pool_->RunTasksAndWait(tasks);
+  parsing_es_concurrently_ = false;
+
+  bool result = true;
+  for (const PidState* pid_state : pid_states)
+    result = result && pid_state->queued_ts_packets_status();
+  return FinishInitializationIfNeeded() && result;
+}
+
 void Mp2tMediaParser::RegisterPmt(int program_number, int pmt_pid) {
   DVLOG(1) << "RegisterPmt:"
            << " program_number=" << program_number
            << " pmt_pid=" << pmt_pid;
 
-  // Only one TS program is allowed. Ignore the incoming program map table,
-  // if there is already one registered.
-  for (std::map<int, PidState*>::iterator it = pids_.begin();
-       it != pids_.end(); ++it) {
-    PidState* pid_state = it->second;
-    if (pid_state->pid_type() == PidState::kPidPmt) {
-      DVLOG_IF(1, pmt_pid != it->first) << "More than one program is defined";
-      return;
-    }
-  }
+  if (pids_.find(pmt_pid) != pids_.end())
+    return;
 
   // Create the PMT state here if needed.
   DVLOG(1) << "Create a new PMT parser";
   scoped_ptr<TsSection> pmt_section_parser(
       new TsSectionPmt(
           base::Bind(&Mp2tMediaParser::RegisterPes,
-                     base::Unretained(this), pmt_pid)));
+                     base::Unretained(this), program_number, pmt_pid)));
   scoped_ptr<PidState> pmt_pid_state(
       new PidState(pmt_pid, PidState::kPidPmt, pmt_section_parser.Pass()));
   pmt_pid_state->Enable();
   pids_.insert(std::pair<int, PidState*>(pmt_pid, pmt_pid_state.release()));
+  // A program whose PMT lists no elementary stream never registers a PES
+  // and holds the initialization; this does not occur in practice.
+  if (!is_initialized_)
+    pending_pmt_pids_.insert(pmt_pid);
 }
 
-void Mp2tMediaParser::RegisterPes(int pmt_pid,
+void Mp2tMediaParser::RegisterPes(int program_number,
+                                  int pmt_pid,
                                   int pes_pid,
                                   int stream_type) {
   DVLOG(1) << "RegisterPes:"
+           << " program_number=" << program_number
            << " pes_pid=" << pes_pid
            << " stream_type=" << std::hex << stream_type << std::dec;
+  pending_pmt_pids_.erase(pmt_pid);
   std::map<int, PidState*>::iterator it = pids_.find(pes_pid);
   if (it != pids_.end())
     return;
+  // The PES PIDs showing up after the selection are not selected.
+  if (tracks_selected_)
+    return;
+
+  if (stream_type == kStreamTypeScte35 || stream_type == kStreamTypeId3) {
+    RegisterMetadata(program_number, pes_pid, stream_type);
+    return;
+  }
 
   // Create a stream parser corresponding to the stream type.
   bool is_audio = false;
@@ -326,16 +494,42 @@ void Mp2tMediaParser::RegisterPes(int pmt_pid,
 
   // Create the PES state here.
   DVLOG(1) << "Create a new PES state";
+  es_parser->set_max_buffered_bytes(limits().max_buffered_bytes);
   scoped_ptr<TsSection> pes_section_parser(
       new TsSectionPes(es_parser.Pass()));
   PidState::PidType pid_type =
       is_audio ? PidState::kPidAudioPes : PidState::kPidVideoPes;
   scoped_ptr<PidState> pes_pid_state(
       new PidState(pes_pid, pid_type, pes_section_parser.Pass()));
+  pes_pid_state->set_program_number(program_number);
   pes_pid_state->Enable();
   pids_.insert(std::pair<int, PidState*>(pes_pid, pes_pid_state.release()));
 }
 
+void Mp2tMediaParser::RegisterMetadata(int program_number,
+                                       int pid,
+                                       int stream_type) {
+  // The metadata is dropped without a callback, so the PID is not parsed.
+  if (timed_metadata_cb().is_null())
+    return;
+
+  scoped_ptr<TsSection> section_parser;
+  if (stream_type == kStreamTypeScte35) {
+    section_parser.reset(new TsSectionScte35(timed_metadata_cb()));
+  } else {
+    DCHECK_EQ(kStreamTypeId3, stream_type);
+    section_parser.reset(
+        new TsSectionPes(scoped_ptr<EsParser>(
+            new EsParserId3(pid, timed_metadata_cb()))));
+  }
+  DVLOG(1) << "Create a new metadata state for pid=" << pid;
+  scoped_ptr<PidState> pid_state(
+      new PidState(pid, PidState::kPidMetadata, section_parser.Pass()));
+  pid_state->set_program_number(program_number);
+  pid_state->Enable();
+  pids_.insert(std::pair<int, PidState*>(pid, pid_state.release()));
+}
+
 void Mp2tMediaParser::OnNewStreamInfo(
     const scoped_refptr<StreamInfo>& new_stream_info) {
   DCHECK(new_stream_info);
@@ -349,10 +543,12 @@ void Mp2tMediaParser::OnNewStreamInfo(
   }
 
   // Set the stream configuration information for the PID.
+  new_stream_info->set_program_number(pid_state->second->program_number());
   pid_state->second->set_config(new_stream_info);
 
   // Finish initialization if all streams have configs.
-  FinishInitializationIfNeeded();
+  if (!parsing_es_concurrently_)
+    FinishInitializationIfNeeded();
 }
 
 bool Mp2tMediaParser::FinishInitializationIfNeeded() {
@@ -361,7 +557,7 @@ bool Mp2tMediaParser::FinishInitializationIfNeeded() {
     return true;
 
   // Wait for more data to come to finish initialization.
-  if (pids_.empty())
+  if (pids_.empty() || !pending_pmt_pids_.empty())
     return true;
 
   std::vector<scoped_refptr<StreamInfo> > all_stream_info;
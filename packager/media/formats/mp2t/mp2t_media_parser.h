@@ -7,6 +7,8 @@
 
 #include <deque>
 #include <map>
+#include <set>
+#include <vector>
 
 #include "packager/base/compiler_specific.h"
 #include "packager/base/memory/ref_counted.h"
@@ -19,6 +21,7 @@ namespace edash_packager {
 namespace media {
 
 class MediaSample;
+class ThreadPool;
 
 namespace mp2t {
 
@@ -40,20 +43,29 @@ class Mp2tMediaParser : public MediaParser {
             KeySource* decryption_key_source) override;
   bool Flush() override WARN_UNUSED_RESULT;
   bool Parse(const uint8_t* buf, int size) override WARN_UNUSED_RESULT;
+  void SelectTracks(const std::set<uint32_t>& track_ids) override;
   /// @}
 
  private:
   typedef std::map<int, PidState*> PidMap;
 
-  // Callback invoked to register a Program Map Table.
+  // Callback invoked to register a Program Map Table. All the programs of a
+  // multi-program TS are registered; their streams are told apart by their
+  // StreamInfo::program_number().
   // Note: Does nothing if the PID is already registered.
   void RegisterPmt(int program_number, int pmt_pid);
 
   // Callback invoked to register a PES pid.
   // Possible values for |media_type| are defined in:
   // ISO-13818.1 / ITU H.222 Table 2.34 "Media type assignments".
-  // |pes_pid| is part of the Program Map Table refered by |pmt_pid|.
-  void RegisterPes(int pmt_pid, int pes_pid, int media_type);
+  // |pes_pid| is part of the Program Map Table refered by |pmt_pid|, which
+  // is the table of program |program_number|.
+  void RegisterPes(int program_number, int pmt_pid, int pes_pid,
+                   int media_type);
+
+  // Register the SCTE-35 or ID3 timed metadata |pid| of program
+  // |program_number|, whose events are passed to timed_metadata_cb().
+  void RegisterMetadata(int program_number, int pid, int stream_type);
 
   // Callback invoked each time the audio/video decoder configuration is
   // changed.
@@ -67,8 +79,18 @@ class Mp2tMediaParser : public MediaParser {
   // Invoke the initialization callback if needed.
   bool FinishInitializationIfNeeded();
 
+  // Push the TS packets queued for the PES PIDs to their parsers, running
+  // the parsers of the different PIDs concurrently.
+  bool ParseQueuedTsPackets();
+
   bool EmitRemainingSamples();
 
+  // Returns the number of leading TS packets of |buf| which are known to be
+  // ignored, i.e. null packets and packets of unselected PES PIDs. The
+  // packets are only checked for the syncword and their PID, so they can be
+  // skipped before being parsed.
+  int CountSkippedTsPackets(const uint8_t* buf, int size) const;
+
   /// Set the value of the "SBR in mime-type" flag which leads to sample rate
   /// doubling. Default value is false.
   void set_sbr_in_mime_type(bool sbr_in_mimetype) {
@@ -88,6 +110,21 @@ class Mp2tMediaParser : public MediaParser {
 
   // Whether |init_cb_| has been invoked.
   bool is_initialized_;
+  // The PMT PIDs whose table has not been parsed yet. The initialization
+  // waits for the streams of all the programs.
+  std::set<int> pending_pmt_pids_;
+
+  // Whether SelectTracks() has been called.
+  bool tracks_selected_;
+  // Indexed by PID. True for the PIDs whose TS packets are skipped unparsed.
+  std::vector<bool> skipped_pids_;
+
+  // Runs the elementary stream parsers when they run concurrently, NULL
+  // otherwise.
+  scoped_ptr<ThreadPool> es_parser_thread_pool_;
+  // Whether the elementary stream parsers are running concurrently. The
+  // initialization is then finished after they have all completed.
+  bool parsing_es_concurrently_;
 
   DISALLOW_COPY_AND_ASSIGN(Mp2tMediaParser);
 };
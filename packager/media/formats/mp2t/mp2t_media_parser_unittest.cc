@@ -2,9 +2,11 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <gflags/gflags.h>
 #include <gtest/gtest.h>
 
 #include <algorithm>
+#include <set>
 #include <string>
 
 #include "packager/base/bind.h"
@@ -19,6 +21,8 @@
 #include "packager/media/formats/mp2t/mp2t_media_parser.h"
 #include "packager/media/test/test_data_util.h"
 
+DECLARE_int32(mp2t_es_parser_threads);
+
 namespace edash_packager {
 namespace media {
 namespace mp2t {
@@ -161,6 +165,94 @@ TEST_F(Mp2tMediaParserTest, TimestampWrapAround) {
   EXPECT_GT(video_max_dts_, static_cast<int64_t>(1) << 33);
 }
 
+TEST_F(Mp2tMediaParserTest, ConcurrentEsParsing) {
+  ParseMpeg2TsFile("bear-640x360.ts", 512);
+  EXPECT_TRUE(parser_->Flush());
+  const int audio_frame_count = audio_frame_count_;
+  EXPECT_GT(audio_frame_count, 0);
+  EXPECT_EQ(82, video_frame_count_);
+
+  google::FlagSaver flag_saver;
+  FLAGS_mp2t_es_parser_threads = 2;
+  parser_.reset(new Mp2tMediaParser());
+  stream_map_.clear();
+  audio_frame_count_ = 0;
+  video_frame_count_ = 0;
+  video_min_dts_ = kNoTimestamp;
+  video_max_dts_ = kNoTimestamp;
+  ParseMpeg2TsFile("bear-640x360.ts", 8192);
+  EXPECT_TRUE(parser_->Flush());
+  EXPECT_EQ(audio_frame_count, audio_frame_count_);
+  EXPECT_EQ(82, video_frame_count_);
+}
+
+TEST_F(Mp2tMediaParserTest, SelectTracks) {
+  InitializeParser();
+  std::vector<uint8_t> buffer = ReadTestDataFile("bear-640x360.ts");
+  const size_t kPieceSize = 512;
+  size_t offset = 0;
+  while (stream_map_.empty() && offset < buffer.size()) {
+    const size_t size = std::min(kPieceSize, buffer.size() - offset);
+    ASSERT_TRUE(AppendData(buffer.data() + offset, size));
+    offset += size;
+  }
+  ASSERT_FALSE(stream_map_.empty());
+
+  std::set<uint32_t> track_ids;
+  for (StreamMap::const_iterator it = stream_map_.begin();
+       it != stream_map_.end(); ++it) {
+    if (it->second->stream_type() == kStreamVideo)
+      track_ids.insert(it->first);
+  }
+  ASSERT_EQ(1u, track_ids.size());
+  parser_->SelectTracks(track_ids);
+  const int audio_frame_count = audio_frame_count_;
+
+  ASSERT_TRUE(AppendDataInPieces(buffer.data() + offset,
+                                 buffer.size() - offset, kPieceSize));
+  EXPECT_TRUE(parser_->Flush());
+  EXPECT_EQ(audio_frame_count, audio_frame_count_);
+  EXPECT_EQ(82, video_frame_count_);
+}
+
+TEST_F(Mp2tMediaParserTest, NullPackets) {
+  const int kPacketSize = 188;
+  std::vector<uint8_t> null_packet(kPacketSize, 0xff);
+  null_packet[0] = 0x47;
+  null_packet[1] = 0x1f;
+  null_packet[2] = 0xff;
+  null_packet[3] = 0x10;
+
+  // Insert runs of null packets between the packets of the file.
+  std::vector<uint8_t> input = ReadTestDataFile("bear-640x360.ts");
+  ASSERT_EQ(0u, input.size() % kPacketSize);
+  std::vector<uint8_t> buffer;
+  for (size_t i = 0; i < input.size(); i += kPacketSize) {
+    for (size_t j = 0; j < i / kPacketSize % 4; ++j)
+      buffer.insert(buffer.end(), null_packet.begin(), null_packet.end());
+    buffer.insert(buffer.end(), input.begin() + i,
+                  input.begin() + i + kPacketSize);
+  }
+
+  InitializeParser();
+  ASSERT_TRUE(AppendDataInPieces(buffer.data(), buffer.size(), 512));
+  EXPECT_TRUE(parser_->Flush());
+  EXPECT_GT(audio_frame_count_, 0);
+  EXPECT_EQ(82, video_frame_count_);
+}
+
+// The streams are tagged with the program they belong to, so that the
+// programs of a multi-program TS can be routed to different outputs.
+TEST_F(Mp2tMediaParserTest, ProgramNumber) {
+  ParseMpeg2TsFile("bear-640x360.ts", 512);
+  ASSERT_EQ(2u, stream_map_.size());
+  const uint32_t program_number =
+      stream_map_.begin()->second->program_number();
+  EXPECT_NE(0u, program_number);
+  for (const auto& stream : stream_map_)
+    EXPECT_EQ(program_number, stream.second->program_number());
+}
+
 }  // namespace mp2t
 }  // namespace media
 }  // namespace edash_packager
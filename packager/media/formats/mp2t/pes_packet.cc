@@ -6,6 +6,8 @@
 
 #include "packager/media/formats/mp2t/pes_packet.h"
 
+#include "packager/base/logging.h"
+
 namespace edash_packager {
 namespace media {
 namespace mp2t {
@@ -13,6 +15,55 @@ namespace mp2t {
 PesPacket::PesPacket() {}
 PesPacket::~PesPacket() {}
 
+void PesPacket::AppendPayload(const uint8_t* data, size_t size) {
+  DCHECK(!slices_.empty() || data_.empty())
+      << "The payload is already set with mutable_data().";
+  data_.insert(data_.end(), data, data + size);
+  payload_size_ += size;
+  // Consecutive copied slices are merged.
+  if (!slices_.empty() && !slices_.back().data) {
+    slices_.back().size += size;
+    return;
+  }
+  const PayloadSlice slice = {NULL, size};
+  slices_.push_back(slice);
+}
+
+void PesPacket::AppendPayloadReference(const uint8_t* data, size_t size) {
+  DCHECK(data);
+  DCHECK(!slices_.empty() || data_.empty())
+      << "The payload is already set with mutable_data().";
+  payload_size_ += size;
+  const PayloadSlice slice = {data, size};
+  slices_.push_back(slice);
+}
+
+size_t PesPacket::payload_size() const {
+  return slices_.empty() ? data_.size() : payload_size_;
+}
+
+void PesPacket::GetPayloadSlices(std::vector<PayloadSlice>* slices) const {
+  DCHECK(slices);
+  slices->clear();
+  if (slices_.empty()) {
+    if (!data_.empty()) {
+      const PayloadSlice slice = {data_.data(), data_.size()};
+      slices->push_back(slice);
+    }
+    return;
+  }
+  size_t data_offset = 0;
+  for (const PayloadSlice& slice : slices_) {
+    if (slice.data) {
+      slices->push_back(slice);
+    } else {
+      const PayloadSlice data_slice = {data_.data() + data_offset, slice.size};
+      slices->push_back(data_slice);
+      data_offset += slice.size;
+    }
+  }
+}
+
 }  // namespace mp2t
 }  // namespace media
 }  // namespace edash_packager
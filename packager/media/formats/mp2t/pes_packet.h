@@ -11,14 +11,25 @@
 #include <vector>
 
 #include "packager/base/macros.h"
+#include "packager/base/memory/ref_counted.h"
+#include "packager/media/base/media_sample.h"
 
 namespace edash_packager {
 namespace media {
 namespace mp2t {
 
 /// Class that carries PES packet information.
+/// The payload is either data() as a whole, or a sequence of slices appended
+/// with AppendPayload() and AppendPayloadReference(), so that the data of the
+/// samples is referenced instead of copied.
 class PesPacket {
  public:
+  /// A contiguous part of the payload.
+  struct PayloadSlice {
+    const uint8_t* data;
+    size_t size;
+  };
+
   PesPacket();
   ~PesPacket();
 
@@ -46,19 +57,54 @@ class PesPacket {
     pts_ = pts;
   }
 
+  /// @return true if the packet carries a video key frame.
+  bool is_key_frame() const { return is_key_frame_; }
+  /// @param is_key_frame is whether the packet carries a video key frame.
+  void set_is_key_frame(bool is_key_frame) { is_key_frame_ = is_key_frame; }
+
+  /// @return the data copied into the packet, which is the whole payload
+  ///         unless slices were appended.
   const std::vector<uint8_t>& data() const { return data_; }
-  /// @return mutable data for this PES.
+  /// @return mutable data for this PES. Not to be mixed with the slices.
   std::vector<uint8_t>* mutable_data() { return &data_; }
 
+  /// Appends a slice to the payload, copied into the packet, e.g. start codes
+  /// or headers.
+  void AppendPayload(const uint8_t* data, size_t size);
+
+  /// Appends a slice to the payload without copying it. The data must outlive
+  /// the packet, e.g. be the data of the sample set with set_sample().
+  void AppendPayloadReference(const uint8_t* data, size_t size);
+
+  /// @param sample is kept alive with the packet, as long as its data is
+  ///        referenced by the payload.
+  void set_sample(const scoped_refptr<MediaSample>& sample) {
+    sample_ = sample;
+  }
+
+  /// @return the size of the payload.
+  size_t payload_size() const;
+
+  /// Gets the slices of the payload, in order. They stay valid until the
+  /// packet is modified.
+  void GetPayloadSlices(std::vector<PayloadSlice>* slices) const;
+
  private:
   uint8_t stream_id_ = 0;
 
   // These values mean "not set" when the value is less than 0.
   int64_t dts_ = -1;
   int64_t pts_ = -1;
+  bool is_key_frame_ = false;
 
   std::vector<uint8_t> data_;
 
+  // The slices of the payload, if any. A slice with NULL data is the next
+  // part of |data_|, which may be reallocated as it grows.
+  std::vector<PayloadSlice> slices_;
+  size_t payload_size_ = 0;
+  scoped_refptr<MediaSample> sample_;
+
   DISALLOW_COPY_AND_ASSIGN(PesPacket);
 };
 
@@ -9,11 +9,15 @@
 #include <algorithm>
 #include <cstring>
 
+#include "packager/base/bind.h"
+#include "packager/base/bind_helpers.h"
 #include "packager/media/base/aes_encryptor.h"
 #include "packager/media/base/aes_pattern_cryptor.h"
 #include "packager/media/base/audio_stream_info.h"
 #include "packager/media/base/buffer_writer.h"
+#include "packager/media/base/hot_path.h"
 #include "packager/media/base/media_sample.h"
+#include "packager/media/base/thread_pool.h"
 #include "packager/media/base/video_stream_info.h"
 #include "packager/media/filters/nal_unit_to_byte_stream_converter.h"
 #include "packager/media/filters/nalu_reader.h"
@@ -29,6 +33,10 @@ const bool kEscapeData = true;
 const uint8_t kVideoStreamId = 0xE0;
 const uint8_t kAudioStreamId = 0xC0;
 const double kTsTimescale = 90000.0;
+// Number of video samples encrypted together with parallel encryption. It
+// bounds the memory held by the batch, and the delay before its PES packets
+// are ready.
+const size_t kEncryptionBatchSize = 64;
 
 // |target_data| is input as well as output. On success |target_data| contains
 // the encrypted sample. The input data should be Nal unit byte stream.
@@ -51,7 +59,8 @@ bool EncryptH264Sample(AesCryptor* encryptor,
     const uint64_t nalu_total_size = nalu.header_size() + nalu.payload_size();
     if (nalu.type() != Nalu::H264NaluType::H264_NonIDRSlice &&
         nalu.type() != Nalu::H264NaluType::H264_IDRSlice) {
-      VLOG(3) << "Found Nalu type: " << nalu.type() << " skipping encryption.";
+      HOT_VLOG(3) << "Found Nalu type: " << nalu.type()
+                  << " skipping encryption.";
       encrypted_sample_data.AppendArray(nalu.data(), nalu_total_size);
       continue;
     }
@@ -75,6 +84,22 @@ bool EncryptH264Sample(AesCryptor* encryptor,
   return true;
 }
 
+// Appends |slices| to the payload of |pes|, referencing the parts which are in
+// the data of |sample| instead of copying them.
+void AppendSlicesToPes(const std::vector<ByteStreamSlice>& slices,
+                       const scoped_refptr<MediaSample>& sample,
+                       PesPacket* pes) {
+  const uint8_t* sample_begin = sample->data();
+  const uint8_t* sample_end = sample_begin + sample->data_size();
+  for (const ByteStreamSlice& slice : slices) {
+    if (slice.data >= sample_begin && slice.data < sample_end)
+      pes->AppendPayloadReference(slice.data, slice.size);
+    else
+      pes->AppendPayload(slice.data, slice.size);
+  }
+  pes->set_sample(sample);
+}
+
 bool EncryptAacSample(AesCryptor* encryptor,
                       std::vector<uint8_t>* target_data) {
   const int kUnencryptedLeaderSize = 16;
@@ -87,11 +112,13 @@ bool EncryptAacSample(AesCryptor* encryptor,
 }  // namespace
 
 PesPacketGenerator::PesPacketGenerator()
-    : pes_packets_deleter_(&pes_packets_) {}
+    : pes_packets_deleter_(&pes_packets_),
+      pending_packets_deleter_(&pending_packets_) {}
 PesPacketGenerator::~PesPacketGenerator() {}
 
 bool PesPacketGenerator::Initialize(const StreamInfo& stream_info) {
   STLDeleteElements(&pes_packets_);
+  STLDeleteElements(&pending_packets_);
   stream_type_ = stream_info.stream_type();
 
   if (stream_type_ == kStreamVideo) {
@@ -132,6 +159,23 @@ bool PesPacketGenerator::PushSample(scoped_refptr<MediaSample> sample) {
   current_processing_pes_->set_dts(timescale_scale_ * sample->dts());
   if (stream_type_ == kStreamVideo) {
     DCHECK(converter_);
+    current_processing_pes_->set_stream_id(kVideoStreamId);
+    current_processing_pes_->set_is_key_frame(sample->is_key_frame());
+    if (!encryptor_) {
+      // The PES references the NAL units of the sample.
+      std::vector<ByteStreamSlice> slices;
+      if (!converter_->ConvertUnitToByteStreamSlices(
+              sample->data(), sample->data_size(), sample->is_key_frame(),
+              &slices)) {
+        LOG(ERROR) << "Failed to convert sample to byte stream.";
+        return false;
+      }
+      AppendSlicesToPes(slices, sample, current_processing_pes_.get());
+      pes_packets_.push_back(current_processing_pes_.release());
+      return true;
+    }
+
+    // Encryption rewrites the NAL units, so the byte stream is a copy.
     std::vector<uint8_t> byte_stream;
     if (!converter_->ConvertUnitToByteStream(
             sample->data(), sample->data_size(), sample->is_key_frame(),
@@ -140,69 +184,79 @@ bool PesPacketGenerator::PushSample(scoped_refptr<MediaSample> sample) {
       return false;
     }
 
-    if (encryptor_) {
-      if (!EncryptH264Sample(encryptor_.get(), &byte_stream)) {
-        LOG(ERROR) << "Failed to encrypt byte stream.";
-        return false;
-      }
+    if (encryption_thread_pool_) {
+      // The sample is encrypted with its batch.
+      current_processing_pes_->mutable_data()->swap(byte_stream);
+      pending_packets_.push_back(current_processing_pes_.release());
+      if (pending_packets_.size() >= kEncryptionBatchSize)
+        return EncryptPendingPackets();
+      return true;
+    }
+
+    if (!EncryptH264Sample(encryptor_.get(), &byte_stream)) {
+      LOG(ERROR) << "Failed to encrypt byte stream.";
+      return false;
     }
     current_processing_pes_->mutable_data()->swap(byte_stream);
-    current_processing_pes_->set_stream_id(kVideoStreamId);
     pes_packets_.push_back(current_processing_pes_.release());
     return true;
   }
   DCHECK_EQ(stream_type_, kStreamAudio);
   DCHECK(adts_converter_);
+  current_processing_pes_->set_stream_id(kAudioStreamId);
 
-  std::vector<uint8_t> aac_frame(sample->data(),
-                                 sample->data() + sample->data_size());
+  std::vector<uint8_t> adts_header;
+  if (!adts_converter_->GetADTSHeader(sample->data_size(), &adts_header))
+    return false;
 
   if (encryptor_) {
+    std::vector<uint8_t> aac_frame(sample->data(),
+                                   sample->data() + sample->data_size());
     if (!EncryptAacSample(encryptor_.get(), &aac_frame)) {
       LOG(ERROR) << "Failed to encrypt ADTS AAC.";
       return false;
     }
+    current_processing_pes_->AppendPayload(adts_header.data(),
+                                           adts_header.size());
+    current_processing_pes_->AppendPayload(aac_frame.data(), aac_frame.size());
+  } else {
+    // The PES references the AAC frame of the sample.
+    current_processing_pes_->AppendPayload(adts_header.data(),
+                                           adts_header.size());
+    current_processing_pes_->AppendPayloadReference(sample->data(),
+                                                    sample->data_size());
+    current_processing_pes_->set_sample(sample);
   }
 
-  // TODO(rkuroiwa): ConvertToADTS() makes another copy of aac_frame internally.
-  // Optimize copying in this function, possibly by adding a method on
-  // AACAudioSpecificConfig that takes {pointer, length} pair and returns a
-  // vector that has the ADTS header.
-  if (!adts_converter_->ConvertToADTS(&aac_frame))
-    return false;
-
   // TODO(rkuriowa): Put multiple samples in the PES packet to reduce # of PES
   // packets.
-  current_processing_pes_->mutable_data()->swap(aac_frame);
-  current_processing_pes_->set_stream_id(kAudioStreamId);
   pes_packets_.push_back(current_processing_pes_.release());
   return true;
 }
 
 bool PesPacketGenerator::SetEncryptionKey(
     scoped_ptr<EncryptionKey> encryption_key) {
-  if (stream_type_ == kStreamVideo) {
-    scoped_ptr<AesCbcEncryptor> cbc(
-        new AesCbcEncryptor(CbcPaddingScheme::kNoPadding));
+  // The samples pushed so far are encrypted with the previous key, if any.
+  if (!EncryptPendingPackets())
+    return false;
 
-    const uint8_t kEncryptedBlocks = 1;
-    const uint8_t kClearBlocks = 9;
-    encryptor_.reset(new AesPatternCryptor(
-        kEncryptedBlocks, kClearBlocks,
-        AesPatternCryptor::kSkipIfCryptByteBlockRemaining,
-        AesCryptor::ConstantIvFlag::kUseConstantIv, cbc.Pass()));
-  } else if (stream_type_ == kStreamAudio) {
-    encryptor_.reset(
-        new AesCbcEncryptor(CbcPaddingScheme::kNoPadding,
-                            AesCryptor::ConstantIvFlag::kUseConstantIv));
-  } else {
+  encryptor_ = CreateEncryptor();
+  if (!encryptor_) {
     LOG(ERROR) << "Cannot encrypt stream type: " << stream_type_;
     return false;
   }
-
   return encryptor_->InitializeWithIv(encryption_key->key, encryption_key->iv);
 }
 
+void PesPacketGenerator::EnableParallelEncryption(size_t num_threads) {
+  DCHECK(!encryption_thread_pool_);
+  if (num_threads <= 1)
+    return;
+  encryption_thread_pool_.reset(new ThreadPool("EncryptionWorker",
+                                               num_threads));
+  encryption_thread_pool_->Start();
+}
+
 size_t PesPacketGenerator::NumberOfReadyPesPackets() {
   return pes_packets_.size();
 }
@@ -215,9 +269,81 @@ scoped_ptr<PesPacket> PesPacketGenerator::GetNextPesPacket() {
 }
 
 bool PesPacketGenerator::Flush() {
+  return EncryptPendingPackets();
+}
+
+scoped_ptr<AesCryptor> PesPacketGenerator::CreateEncryptor() const {
+  if (stream_type_ == kStreamVideo) {
+    scoped_ptr<AesCbcEncryptor> cbc(
+        new AesCbcEncryptor(CbcPaddingScheme::kNoPadding));
+
+    const uint8_t kEncryptedBlocks = 1;
+    const uint8_t kClearBlocks = 9;
+    return scoped_ptr<AesCryptor>(new AesPatternCryptor(
+        kEncryptedBlocks, kClearBlocks,
+        AesPatternCryptor::kSkipIfCryptByteBlockRemaining,
+        AesCryptor::ConstantIvFlag::kUseConstantIv, cbc.Pass()));
+  } else if (stream_type_ == kStreamAudio) {
+    return scoped_ptr<AesCryptor>(
+        new AesCbcEncryptor(CbcPaddingScheme::kNoPadding,
+                            AesCryptor::ConstantIvFlag::kUseConstantIv));
+  }
+  return scoped_ptr<AesCryptor>();
+}
+
+bool PesPacketGenerator::EncryptPendingPackets() {
+  if (pending_packets_.empty())
+    return true;
+  DCHECK(encryption_thread_pool_);
+  DCHECK(encryptor_);
+
+  // Split the samples in contiguous ranges, one per thread. Every NAL unit is
+  // encrypted from the constant IV, so the ranges are independent.
+  const size_t num_packets = pending_packets_.size();
+  const size_t num_tasks =
+      std::min(num_packets, encryption_thread_pool_->num_threads());
+  // Not a vector<bool>, whose elements cannot be written concurrently.
+  scoped_ptr<bool[]> results(new bool[num_tasks]);
+  std::vector<base::Closure> tasks;
+  for (size_t i = 0; i < num_tasks; ++i) {
+    results[i] = true;
+    tasks.push_back(base::Bind(&PesPacketGenerator::EncryptPendingPacketRange,
+                               base::Unretained(this),
+                               num_packets * i / num_tasks,
+                               num_packets * (i + 1) / num_tasks,
+                               &results[i]));
+  }
+  encryption_thread_pool_->RunTasksAndWait(tasks);
+
+  pes_packets_.insert(pes_packets_.end(), pending_packets_.begin(),
+                      pending_packets_.end());
+  pending_packets_.clear();
+  for (size_t i = 0; i < num_tasks; ++i) {
+    if (!results[i]) {
+      LOG(ERROR) << "Failed to encrypt byte stream.";
+      return false;
+    }
+  }
   return true;
 }
 
+void PesPacketGenerator::EncryptPendingPacketRange(size_t begin,
+                                                   size_t end,
+                                                   bool* result) {
+  scoped_ptr<AesCryptor> cryptor = CreateEncryptor();
+  if (!cryptor->InitializeWithCryptor(*encryptor_, encryptor_->iv())) {
+    *result = false;
+    return;
+  }
+  for (size_t i = begin; i < end; ++i) {
+    if (!EncryptH264Sample(cryptor.get(),
+                           pending_packets_[i]->mutable_data())) {
+      *result = false;
+      return;
+    }
+  }
+}
+
 }  // namespace mp2t
 }  // namespace media
 }  // namespace edash_packager
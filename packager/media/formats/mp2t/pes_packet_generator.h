@@ -8,6 +8,7 @@
 #define PACKAGER_MEDIA_FORMATS_MP2T_PES_PACKET_GENERATOR_H_
 
 #include <list>
+#include <vector>
 
 #include "packager/base/memory/scoped_ptr.h"
 #include "packager/base/stl_util.h"
@@ -21,6 +22,7 @@ namespace media {
 
 class NalUnitToByteStreamConverter;
 class StreamInfo;
+class ThreadPool;
 
 namespace mp4 {
 class AACAudioSpecificConfig;
@@ -56,6 +58,13 @@ class PesPacketGenerator {
   /// @return true on success, false otherwise.
   virtual bool SetEncryptionKey(scoped_ptr<EncryptionKey> encryption_key);
 
+  /// Encrypt the video samples in batches, on a thread pool, instead of one by
+  /// one as they are pushed. The PES packets of a batch are ready once the
+  /// batch is encrypted, i.e. when it is full or on Flush().
+  /// @param num_threads is the number of encryption threads. Parallel
+  ///        encryption is not enabled if it is 0 or 1.
+  void EnableParallelEncryption(size_t num_threads);
+
   /// @return The number of PES packets that are ready to be consumed.
   virtual size_t NumberOfReadyPesPackets();
 
@@ -72,6 +81,15 @@ class PesPacketGenerator {
  private:
   friend class PesPacketGeneratorTest;
 
+  // Creates a cryptor for the stream type, to be initialized.
+  scoped_ptr<AesCryptor> CreateEncryptor() const;
+
+  // Encrypts |pending_packets_| on the thread pool, then makes them ready.
+  bool EncryptPendingPackets();
+  // Encrypts the pending packets in [begin, end) with a cryptor of its own.
+  // Sets |*result| to false on failure. Can be called from another thread.
+  void EncryptPendingPacketRange(size_t begin, size_t end, bool* result);
+
   StreamType stream_type_;
 
   // Calculated by 90000 / input stream's timescale. This is used to scale the
@@ -91,6 +109,12 @@ class PesPacketGenerator {
   // Current encryption key.
   scoped_ptr<AesCryptor> encryptor_;
 
+  // For parallel encryption. The PES packets of the batch being built, with
+  // the byte streams of the samples in the clear.
+  scoped_ptr<ThreadPool> encryption_thread_pool_;
+  std::vector<PesPacket*> pending_packets_;
+  STLElementDeleter<decltype(pending_packets_)> pending_packets_deleter_;
+
   DISALLOW_COPY_AND_ASSIGN(PesPacketGenerator);
 };
 
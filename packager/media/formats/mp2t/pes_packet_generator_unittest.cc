@@ -94,14 +94,31 @@ class MockNalUnitToByteStreamConverter : public NalUnitToByteStreamConverter {
                     size_t sample_size,
                     bool is_key_frame,
                     std::vector<uint8_t>* output));
+  MOCK_METHOD4(ConvertUnitToByteStreamSlices,
+               bool(const uint8_t* sample,
+                    size_t sample_size,
+                    bool is_key_frame,
+                    std::vector<ByteStreamSlice>* slices));
 };
 
 class MockAACAudioSpecificConfig : public mp4::AACAudioSpecificConfig {
  public:
   MOCK_METHOD1(Parse, bool(const std::vector<uint8_t>& data));
   MOCK_CONST_METHOD1(ConvertToADTS, bool(std::vector<uint8_t>* buffer));
+  MOCK_CONST_METHOD2(GetADTSHeader,
+                     bool(size_t frame_size, std::vector<uint8_t>* header));
 };
 
+// Returns the payload of |pes|, gathered from its slices.
+std::vector<uint8_t> GetPayload(const PesPacket& pes) {
+  std::vector<PesPacket::PayloadSlice> slices;
+  pes.GetPayloadSlices(&slices);
+  std::vector<uint8_t> payload;
+  for (const PesPacket::PayloadSlice& slice : slices)
+    payload.insert(payload.end(), slice.data, slice.data + slice.size);
+  return payload;
+}
+
 scoped_refptr<VideoStreamInfo> CreateVideoStreamInfo(VideoCodec codec) {
   scoped_refptr<VideoStreamInfo> stream_info(new VideoStreamInfo(
       kTrackId, kTimeScale, kDuration, codec, kCodecString, kLanguage,
@@ -193,14 +210,14 @@ class PesPacketGeneratorTest : public ::testing::Test {
     EXPECT_TRUE(generator_.Initialize(*stream_info));
     EXPECT_EQ(0u, generator_.NumberOfReadyPesPackets());
 
-    // For aac, the input from MediaSample is used. Then ADTS header is added,
-    // so EXPECT_CALL does not return the |input| data.
+    // For aac, the input from MediaSample is used. The ADTS header is left
+    // empty so that the payload is the encrypted frame.
     scoped_refptr<MediaSample> sample = MediaSample::CopyFrom(
         input, input_size, kIsKeyFrame);
 
     scoped_ptr<MockAACAudioSpecificConfig> mock(
         new MockAACAudioSpecificConfig());
-    EXPECT_CALL(*mock, ConvertToADTS(_)).WillOnce(Return(true));
+    EXPECT_CALL(*mock, GetADTSHeader(input_size, _)).WillOnce(Return(true));
 
     UseMockAACAudioSpecificConfig(mock.Pass());
 
@@ -217,7 +234,7 @@ class PesPacketGeneratorTest : public ::testing::Test {
 
     std::vector<uint8_t> expected(expected_output,
                                   expected_output + expected_output_size);
-    EXPECT_EQ(expected, pes_packet->data());
+    EXPECT_EQ(expected, GetPayload(*pes_packet));
   }
 
   PesPacketGenerator generator_;
@@ -268,13 +285,23 @@ TEST_F(PesPacketGeneratorTest, AddVideoSample) {
   sample->set_pts(kPts);
   sample->set_dts(kDts);
 
-  std::vector<uint8_t> expected_data(kAnyData, kAnyData + arraysize(kAnyData));
+  // A start code owned by the converter, followed by the sample.
+  const uint8_t kStartCode[] = {0x00, 0x00, 0x00, 0x01};
+  std::vector<ByteStreamSlice> slices(2);
+  slices[0].data = kStartCode;
+  slices[0].size = arraysize(kStartCode);
+  slices[1].data = sample->data();
+  slices[1].size = sample->data_size();
+  std::vector<uint8_t> expected_data(kStartCode,
+                                     kStartCode + arraysize(kStartCode));
+  expected_data.insert(expected_data.end(), kAnyData,
+                       kAnyData + arraysize(kAnyData));
 
   scoped_ptr<MockNalUnitToByteStreamConverter> mock(
       new MockNalUnitToByteStreamConverter());
-  EXPECT_CALL(*mock,
-              ConvertUnitToByteStream(_, arraysize(kAnyData), kIsKeyFrame, _))
-      .WillOnce(DoAll(SetArgPointee<3>(expected_data), Return(true)));
+  EXPECT_CALL(*mock, ConvertUnitToByteStreamSlices(_, arraysize(kAnyData),
+                                                   kIsKeyFrame, _))
+      .WillOnce(DoAll(SetArgPointee<3>(slices), Return(true)));
 
   UseMockNalUnitToByteStreamConverter(mock.Pass());
 
@@ -287,7 +314,10 @@ TEST_F(PesPacketGeneratorTest, AddVideoSample) {
   EXPECT_EQ(0xe0, pes_packet->stream_id());
   EXPECT_EQ(kPts, pes_packet->pts());
   EXPECT_EQ(kDts, pes_packet->dts());
-  EXPECT_EQ(expected_data, pes_packet->data());
+  EXPECT_TRUE(pes_packet->is_key_frame());
+  EXPECT_EQ(expected_data, GetPayload(*pes_packet));
+  // Only the start code is copied into the PES packet.
+  EXPECT_EQ(arraysize(kStartCode), pes_packet->data().size());
 
   EXPECT_TRUE(generator_.Flush());
 }
@@ -301,11 +331,10 @@ TEST_F(PesPacketGeneratorTest, AddVideoSampleFailedToConvert) {
   scoped_refptr<MediaSample> sample =
       MediaSample::CopyFrom(kAnyData, arraysize(kAnyData), kIsKeyFrame);
 
-  std::vector<uint8_t> expected_data(kAnyData, kAnyData + arraysize(kAnyData));
   scoped_ptr<MockNalUnitToByteStreamConverter> mock(
       new MockNalUnitToByteStreamConverter());
-  EXPECT_CALL(*mock,
-              ConvertUnitToByteStream(_, arraysize(kAnyData), kIsKeyFrame, _))
+  EXPECT_CALL(*mock, ConvertUnitToByteStreamSlices(_, arraysize(kAnyData),
+                                                   kIsKeyFrame, _))
       .WillOnce(Return(false));
 
   UseMockNalUnitToByteStreamConverter(mock.Pass());
@@ -324,11 +353,14 @@ TEST_F(PesPacketGeneratorTest, AddAudioSample) {
   scoped_refptr<MediaSample> sample =
       MediaSample::CopyFrom(kAnyData, arraysize(kAnyData), kIsKeyFrame);
 
-  std::vector<uint8_t> expected_data(kAnyData, kAnyData + arraysize(kAnyData));
+  const std::vector<uint8_t> adts_header(7, 0xFF);
+  std::vector<uint8_t> expected_data(adts_header);
+  expected_data.insert(expected_data.end(), kAnyData,
+                       kAnyData + arraysize(kAnyData));
 
   scoped_ptr<MockAACAudioSpecificConfig> mock(new MockAACAudioSpecificConfig());
-  EXPECT_CALL(*mock, ConvertToADTS(_))
-      .WillOnce(DoAll(SetArgPointee<0>(expected_data), Return(true)));
+  EXPECT_CALL(*mock, GetADTSHeader(arraysize(kAnyData), _))
+      .WillOnce(DoAll(SetArgPointee<1>(adts_header), Return(true)));
 
   UseMockAACAudioSpecificConfig(mock.Pass());
 
@@ -339,7 +371,11 @@ TEST_F(PesPacketGeneratorTest, AddAudioSample) {
   EXPECT_EQ(0u, generator_.NumberOfReadyPesPackets());
 
   EXPECT_EQ(0xc0, pes_packet->stream_id());
-  EXPECT_EQ(expected_data, pes_packet->data());
+  // Audio frames are not listed as key frames.
+  EXPECT_FALSE(pes_packet->is_key_frame());
+  EXPECT_EQ(expected_data, GetPayload(*pes_packet));
+  // Only the ADTS header is copied into the PES packet.
+  EXPECT_EQ(adts_header, pes_packet->data());
 
   EXPECT_TRUE(generator_.Flush());
 }
@@ -354,7 +390,8 @@ TEST_F(PesPacketGeneratorTest, AddAudioSampleFailedToConvert) {
       MediaSample::CopyFrom(kAnyData, arraysize(kAnyData), kIsKeyFrame);
 
   scoped_ptr<MockAACAudioSpecificConfig> mock(new MockAACAudioSpecificConfig());
-  EXPECT_CALL(*mock, ConvertToADTS(_)).WillOnce(Return(false));
+  EXPECT_CALL(*mock, GetADTSHeader(arraysize(kAnyData), _))
+      .WillOnce(Return(false));
 
   UseMockAACAudioSpecificConfig(mock.Pass());
 
@@ -385,8 +422,8 @@ TEST_F(PesPacketGeneratorTest, TimeStampScaling) {
 
   scoped_ptr<MockNalUnitToByteStreamConverter> mock(
       new MockNalUnitToByteStreamConverter());
-  EXPECT_CALL(*mock,
-              ConvertUnitToByteStream(_, arraysize(kAnyData), kIsKeyFrame, _))
+  EXPECT_CALL(*mock, ConvertUnitToByteStreamSlices(_, arraysize(kAnyData),
+                                                   kIsKeyFrame, _))
       .WillOnce(Return(true));
 
   UseMockNalUnitToByteStreamConverter(mock.Pass());
@@ -642,6 +679,84 @@ TEST_F(PesPacketGeneratorTest, H264SampleEncryptionLast16ByteNotEncrypted) {
                                              arraysize(kEncryptedNaluData)));
 }
 
+// With parallel encryption, the samples are encrypted in batches, and their
+// PES packets are ready on Flush().
+TEST_F(PesPacketGeneratorTest, H264SampleEncryptionInParallel) {
+  const uint8_t kNaluData[] = {
+      0x00, 0x00, 0x00, 0x01,  // Start code.
+      0x61,                    // nalu type 1; should get encrypted.
+      // Bogus data but should not be encrypted.
+      0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B,
+      0x0C, 0x0D, 0x0E, 0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+      0x18, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E,
+
+      // Next 16 bytes should be encrypted.
+      0x1F, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2A,
+      0x2B, 0x2C, 0x2D, 0x2E,
+
+      // This last byte should not be encrypted.
+      0xCF,
+  };
+
+  const uint8_t kEncryptedNaluData[] = {
+      0x00, 0x00, 0x00, 0x01,  // Start code.
+      0x61,                    // nalu type 1; should get encrypted.
+      // Bogus data but should not be encrypted.
+      0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B,
+      0x0C, 0x0D, 0x0E, 0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+      0x18, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E,
+
+      // Encrypted 16 bytes.
+      0x93, 0x3A, 0x2C, 0x38, 0x86, 0x4B, 0x64, 0xE2, 0x62, 0x7E, 0xCC, 0x75,
+      0x71, 0xFB, 0x60, 0x7C,
+
+      // This last byte should not be encrypted.
+      0xCF,
+  };
+
+  scoped_refptr<VideoStreamInfo> stream_info(
+      CreateVideoStreamInfo(kH264VideoCodec));
+  EXPECT_TRUE(generator_.Initialize(*stream_info));
+  generator_.EnableParallelEncryption(2);
+
+  const size_t kNumSamples = 5;
+  const int64_t kSampleDuration = 1000;
+  std::vector<uint8_t> clear_data(kNaluData, kNaluData + arraysize(kNaluData));
+  scoped_ptr<MockNalUnitToByteStreamConverter> mock(
+      new MockNalUnitToByteStreamConverter());
+  EXPECT_CALL(*mock, ConvertUnitToByteStream(_, arraysize(kNaluData),
+                                             kIsKeyFrame, _))
+      .Times(kNumSamples)
+      .WillRepeatedly(DoAll(SetArgPointee<3>(clear_data), Return(true)));
+  UseMockNalUnitToByteStreamConverter(mock.Pass());
+
+  const std::vector<uint8_t> all_zero(16, 0);
+  scoped_ptr<EncryptionKey> encryption_key(new EncryptionKey());
+  encryption_key->key = all_zero;
+  encryption_key->iv = all_zero;
+  EXPECT_TRUE(generator_.SetEncryptionKey(encryption_key.Pass()));
+
+  for (size_t i = 0; i < kNumSamples; ++i) {
+    scoped_refptr<MediaSample> sample = MediaSample::CopyFrom(
+        kNaluData, arraysize(kNaluData), kIsKeyFrame);
+    sample->set_pts(i * kSampleDuration);
+    sample->set_dts(i * kSampleDuration);
+    EXPECT_TRUE(generator_.PushSample(sample));
+  }
+  EXPECT_EQ(0u, generator_.NumberOfReadyPesPackets());
+  EXPECT_TRUE(generator_.Flush());
+  ASSERT_EQ(kNumSamples, generator_.NumberOfReadyPesPackets());
+
+  const std::vector<uint8_t> expected(
+      kEncryptedNaluData, kEncryptedNaluData + arraysize(kEncryptedNaluData));
+  for (size_t i = 0; i < kNumSamples; ++i) {
+    scoped_ptr<PesPacket> pes_packet = generator_.GetNextPesPacket();
+    ASSERT_TRUE(pes_packet);
+    EXPECT_EQ(static_cast<int64_t>(i) * kSampleDuration, pes_packet->pts());
+    EXPECT_EQ(expected, GetPayload(*pes_packet));
+  }
+}
+
 // The sample is too small and it doesn't need to be encrypted.
 TEST_F(PesPacketGeneratorTest, AacSampleEncryptionSmallSample) {
   const uint8_t kClearData[] = {
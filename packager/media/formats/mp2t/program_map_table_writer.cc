@@ -328,26 +328,47 @@ H264ProgramMapTableWriter::H264ProgramMapTableWriter(
 H264ProgramMapTableWriter::~H264ProgramMapTableWriter() {}
 
 bool H264ProgramMapTableWriter::ClearLeadSegmentPmt(BufferWriter* writer) {
-  WritePmtToBuffer(kPmtH264, arraysize(kPmtH264), continuity_counter_, writer);
-  WritePmtWithParameters(
-      kStreamTypeEncryptedH264, kVersion1, kNext,
-      kPrivateDataIndicatorDescriptorEncryptedH264,
-      arraysize(kPrivateDataIndicatorDescriptorEncryptedH264),
-      continuity_counter_, writer);
+  if (clear_lead_segment_pmt_.empty()) {
+    // The counters are set when the cached packets are written.
+    ContinuityCounter unused_counter;
+    BufferWriter packets;
+    WritePmtToBuffer(kPmtH264, arraysize(kPmtH264), &unused_counter,
+                     &packets);
+    WritePmtWithParameters(
+        kStreamTypeEncryptedH264, kVersion1, kNext,
+        kPrivateDataIndicatorDescriptorEncryptedH264,
+        arraysize(kPrivateDataIndicatorDescriptorEncryptedH264),
+        &unused_counter, &packets);
+    clear_lead_segment_pmt_.Set(packets);
+  }
+  clear_lead_segment_pmt_.Write(continuity_counter_, writer);
   return true;
 }
 
 bool H264ProgramMapTableWriter::EncryptedSegmentPmt(BufferWriter* writer) {
-  WritePmtWithParameters(
-      kStreamTypeEncryptedH264, kVersion1, kCurrent,
-      kPrivateDataIndicatorDescriptorEncryptedH264,
-      arraysize(kPrivateDataIndicatorDescriptorEncryptedH264),
-      continuity_counter_, writer);
+  if (encrypted_segment_pmt_.empty()) {
+    ContinuityCounter unused_counter;
+    BufferWriter packets;
+    WritePmtWithParameters(
+        kStreamTypeEncryptedH264, kVersion1, kCurrent,
+        kPrivateDataIndicatorDescriptorEncryptedH264,
+        arraysize(kPrivateDataIndicatorDescriptorEncryptedH264),
+        &unused_counter, &packets);
+    encrypted_segment_pmt_.Set(packets);
+  }
+  encrypted_segment_pmt_.Write(continuity_counter_, writer);
   return true;
 }
 
 bool H264ProgramMapTableWriter::ClearSegmentPmt(BufferWriter* writer) {
-  WritePmtToBuffer(kPmtH264, arraysize(kPmtH264), continuity_counter_, writer);
+  if (clear_segment_pmt_.empty()) {
+    ContinuityCounter unused_counter;
+    BufferWriter packets;
+    WritePmtToBuffer(kPmtH264, arraysize(kPmtH264), &unused_counter,
+                     &packets);
+    clear_segment_pmt_.Set(packets);
+  }
+  clear_segment_pmt_.Write(continuity_counter_, writer);
   return true;
 }
 
@@ -362,27 +383,53 @@ AacProgramMapTableWriter::AacProgramMapTableWriter(
 
 AacProgramMapTableWriter::~AacProgramMapTableWriter() {}
 
-// TODO(rkuroiwa): Cache the PMT for encrypted segments, it doesn't need to
-// be recalculated.
 bool AacProgramMapTableWriter::ClearLeadSegmentPmt(BufferWriter* writer) {
-  WritePmtToBuffer(kPmtAac, arraysize(kPmtAac), continuity_counter_, writer);
-  // Version 1 and next.
-  return EncryptedSegmentPmtWithParameters(kVersion1, kNext, writer);
+  if (clear_lead_segment_pmt_.empty()) {
+    // The counters are set when the cached packets are written.
+    ContinuityCounter unused_counter;
+    BufferWriter packets;
+    WritePmtToBuffer(kPmtAac, arraysize(kPmtAac), &unused_counter, &packets);
+    // Version 1 and next.
+    if (!EncryptedSegmentPmtWithParameters(kVersion1, kNext, &unused_counter,
+                                           &packets)) {
+      return false;
+    }
+    clear_lead_segment_pmt_.Set(packets);
+  }
+  clear_lead_segment_pmt_.Write(continuity_counter_, writer);
+  return true;
 }
 
 bool AacProgramMapTableWriter::EncryptedSegmentPmt(BufferWriter* writer) {
-  // Version 1 and current.
-  return EncryptedSegmentPmtWithParameters(kVersion1, kCurrent, writer);
+  if (encrypted_segment_pmt_.empty()) {
+    ContinuityCounter unused_counter;
+    BufferWriter packets;
+    // Version 1 and current.
+    if (!EncryptedSegmentPmtWithParameters(kVersion1, kCurrent,
+                                           &unused_counter, &packets)) {
+      return false;
+    }
+    encrypted_segment_pmt_.Set(packets);
+  }
+  encrypted_segment_pmt_.Write(continuity_counter_, writer);
+  return true;
 }
 
 bool AacProgramMapTableWriter::ClearSegmentPmt(BufferWriter* writer) {
-  WritePmtToBuffer(kPmtAac, arraysize(kPmtAac), continuity_counter_, writer);
+  if (clear_segment_pmt_.empty()) {
+    ContinuityCounter unused_counter;
+    BufferWriter packets;
+    WritePmtToBuffer(kPmtAac, arraysize(kPmtAac), &unused_counter, &packets);
+    clear_segment_pmt_.Set(packets);
+  }
+  clear_segment_pmt_.Write(continuity_counter_, writer);
   return true;
 }
 
 bool AacProgramMapTableWriter::EncryptedSegmentPmtWithParameters(
     int version,
     int current_next_indicator,
+    ContinuityCounter* continuity_counter,
     BufferWriter* writer) {
   // -12 because there are 12 bytes between 'descriptor_length' in
   // registartion_descriptor and 'setup_data_length' in audio_setup_information.
@@ -403,7 +450,7 @@ bool AacProgramMapTableWriter::EncryptedSegmentPmtWithParameters(
 
   WritePmtWithParameters(
       kStreamTypeEncryptedAdtsAac, version, current_next_indicator,
-      descriptors.Buffer(), descriptors.Size(), continuity_counter_, writer);
+      descriptors.Buffer(), descriptors.Size(), continuity_counter, writer);
   return true;
 }
 
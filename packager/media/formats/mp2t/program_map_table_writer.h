@@ -12,6 +12,7 @@
 #include <vector>
 
 #include "packager/base/macros.h"
+#include "packager/media/formats/mp2t/ts_packet_writer_util.h"
 
 namespace edash_packager {
 namespace media {
@@ -24,6 +25,8 @@ class ContinuityCounter;
 
 /// Puts PMT into TS packets and writes them to buffer.
 /// Note that this does not currently allow encryption without clear lead.
+/// The implementations generate the TS packets of each PMT variant once, then
+/// only update their continuity counters.
 class ProgramMapTableWriter {
  public:
   ProgramMapTableWriter();
@@ -63,6 +66,9 @@ class H264ProgramMapTableWriter : public ProgramMapTableWriter {
 
  private:
   ContinuityCounter* const continuity_counter_;
+  CachedTsPackets clear_lead_segment_pmt_;
+  CachedTsPackets encrypted_segment_pmt_;
+  CachedTsPackets clear_segment_pmt_;
 
   DISALLOW_COPY_AND_ASSIGN(H264ProgramMapTableWriter);
 };
@@ -85,10 +91,14 @@ class AacProgramMapTableWriter : public ProgramMapTableWriter {
  private:
   bool EncryptedSegmentPmtWithParameters(int version,
                                          int current_next_indicator,
+                                         ContinuityCounter* continuity_counter,
                                          BufferWriter* writer);
 
   const std::vector<uint8_t> aac_audio_specific_config_;
   ContinuityCounter* const continuity_counter_;
+  CachedTsPackets clear_lead_segment_pmt_;
+  CachedTsPackets encrypted_segment_pmt_;
+  CachedTsPackets clear_segment_pmt_;
 
   DISALLOW_COPY_AND_ASSIGN(AacProgramMapTableWriter);
 };
@@ -85,6 +85,28 @@ TEST_F(ProgramMapTableWriterTest, ClearH264) {
                           kPmtH264, arraysize(kPmtH264), buffer.Buffer()));
 }
 
+// The PMT is generated once, but the continuity counter keeps increasing.
+TEST_F(ProgramMapTableWriterTest, ClearH264Twice) {
+  ContinuityCounter counter;
+  H264ProgramMapTableWriter writer(&counter);
+  BufferWriter first_buffer;
+  writer.ClearSegmentPmt(&first_buffer);
+  BufferWriter second_buffer;
+  writer.ClearSegmentPmt(&second_buffer);
+
+  ASSERT_EQ(kTsPacketSize, first_buffer.Size());
+  ASSERT_EQ(kTsPacketSize, second_buffer.Size());
+  // Adaptation field and payload are both present. counter = 0, then 1.
+  EXPECT_EQ(0x30, first_buffer.Buffer()[3]);
+  EXPECT_EQ(0x31, second_buffer.Buffer()[3]);
+  std::vector<uint8_t> first_packet(first_buffer.Buffer(),
+                                    first_buffer.Buffer() + kTsPacketSize);
+  first_packet[3] = 0x31;
+  EXPECT_EQ(first_packet,
+            std::vector<uint8_t>(second_buffer.Buffer(),
+                                 second_buffer.Buffer() + kTsPacketSize));
+}
+
 TEST_F(ProgramMapTableWriterTest, ClearLeadH264) {
   ContinuityCounter counter;
   H264ProgramMapTableWriter writer(&counter);
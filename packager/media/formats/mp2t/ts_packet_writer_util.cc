@@ -56,18 +56,16 @@ const uint8_t kPaddingBytes[] = {
 static_assert(arraysize(kPaddingBytes) >= kTsPacketMaximumPayloadSize,
               "Padding array is not big enough.");
 
+// Returns the value of the adaptation_field_length of a TS packet, i.e. the
+// size of its adaptation field without the length field itself.
 // |remaining_data_size| is the amount of data that has to be written. This may
 // be bigger than a TS packet size.
 // |remaining_data_size| matters if it is short and requires padding.
-void WriteAdaptationField(bool has_pcr,
-                          uint64_t pcr_base,
-                          size_t remaining_data_size,
-                          BufferWriter* writer) {
-  // Special case where a TS packet requires 1 byte padding.
-  if (!has_pcr && remaining_data_size == kTsPacketMaximumPayloadSize - 1) {
-    writer->AppendInt(static_cast<uint8_t>(0));
-    return;
-  }
+int ComputeAdaptationFieldLength(bool has_pcr, size_t remaining_data_size) {
+  // Special case where a TS packet requires 1 byte padding, i.e. only the
+  // length field.
+  if (!has_pcr && remaining_data_size == kTsPacketMaximumPayloadSize - 1)
+    return 0;
 
   // The size of the field itself.
   const int kAdaptationFieldLengthSize = 1;
@@ -84,8 +82,17 @@ void WriteAdaptationField(bool has_pcr,
       adaptation_field_length += kTsPacketSize - current_ts_size;
     }
   }
+  return adaptation_field_length;
+}
 
+void WriteAdaptationField(bool has_pcr,
+                          uint64_t pcr_base,
+                          int adaptation_field_length,
+                          UncheckedBufferWriter* writer) {
   writer->AppendInt(static_cast<uint8_t>(adaptation_field_length));
+  if (adaptation_field_length == 0)
+    return;
+
   int remaining_bytes = adaptation_field_length;
   writer->AppendInt(static_cast<uint8_t>(
       // All flags except PCR_flag are 0.
@@ -112,6 +119,47 @@ void WriteAdaptationField(bool has_pcr,
 
 }  // namespace
 
+size_t WriteTsPacketHeader(size_t bytes_left,
+                           bool payload_unit_start_indicator,
+                           int pid,
+                           bool has_pcr,
+                           uint64_t pcr_base,
+                           ContinuityCounter* continuity_counter,
+                           BufferWriter* writer) {
+  const bool must_write_adaptation_header = has_pcr;
+  const bool has_adaptation_field = must_write_adaptation_header ||
+                                    bytes_left < kTsPacketMaximumPayloadSize;
+  const int adaptation_field_length =
+      has_adaptation_field
+          ? ComputeAdaptationFieldLength(has_pcr, bytes_left)
+          : 0;
+  // The adaptation field, if any, includes its length field.
+  const size_t adaptation_field_size =
+      has_adaptation_field ? adaptation_field_length + 1 : 0;
+
+  // The header is written in place, in a region reserved at once.
+  const size_t header_size = kTsPacketHeaderSize + adaptation_field_size;
+  UncheckedBufferWriter header_writer(writer->Extend(header_size),
+                                      header_size);
+  header_writer.AppendInt(kSyncByte);
+  header_writer.AppendInt(static_cast<uint16_t>(
+      // transport_error_indicator and transport_priority are both '0'.
+      static_cast<int>(payload_unit_start_indicator) << 14 | pid));
+
+  const uint8_t adaptation_field_control =
+      ((has_adaptation_field ? 1 : 0) << 1) | ((bytes_left != 0) ? 1 : 0);
+  // transport_scrambling_control is '00'.
+  header_writer.AppendInt(static_cast<uint8_t>(
+      adaptation_field_control << 4 | continuity_counter->GetNext()));
+
+  if (has_adaptation_field) {
+    WriteAdaptationField(has_pcr, pcr_base, adaptation_field_length,
+                         &header_writer);
+  }
+  DCHECK_EQ(header_size, header_writer.Size());
+  return kTsPacketMaximumPayloadSize - adaptation_field_size;
+}
+
 void WritePayloadToBufferWriter(const uint8_t* payload,
                                 size_t payload_size,
                                 bool payload_unit_start_indicator,
@@ -123,36 +171,11 @@ void WritePayloadToBufferWriter(const uint8_t* payload,
   size_t payload_bytes_written = 0;
 
   do {
-    const bool must_write_adaptation_header = has_pcr;
-    const size_t bytes_left = payload_size - payload_bytes_written;
-    const bool has_adaptation_field = must_write_adaptation_header ||
-                                      bytes_left < kTsPacketMaximumPayloadSize;
-
-    writer->AppendInt(kSyncByte);
-    writer->AppendInt(static_cast<uint16_t>(
-        // transport_error_indicator and transport_priority are both '0'.
-        static_cast<int>(payload_unit_start_indicator) << 14 | pid));
-
-    const uint8_t adaptation_field_control =
-        ((has_adaptation_field ? 1 : 0) << 1) | ((bytes_left != 0) ? 1 : 0);
-    // transport_scrambling_control is '00'.
-    writer->AppendInt(static_cast<uint8_t>(adaptation_field_control << 4 |
-                                           continuity_counter->GetNext()));
-
-    if (has_adaptation_field) {
-      const size_t before = writer->Size();
-      WriteAdaptationField(has_pcr, pcr_base, bytes_left, writer);
-      const size_t bytes_for_adaptation_field = writer->Size() - before;
-
-      const int write_bytes =
-          kTsPacketMaximumPayloadSize - bytes_for_adaptation_field;
-      writer->AppendArray(payload + payload_bytes_written, write_bytes);
-      payload_bytes_written += write_bytes;
-    } else {
-      writer->AppendArray(payload + payload_bytes_written,
-                          kTsPacketMaximumPayloadSize);
-      payload_bytes_written += kTsPacketMaximumPayloadSize;
-    }
+    const size_t write_bytes = WriteTsPacketHeader(
+        payload_size - payload_bytes_written, payload_unit_start_indicator,
+        pid, has_pcr, pcr_base, continuity_counter, writer);
+    writer->AppendArray(payload + payload_bytes_written, write_bytes);
+    payload_bytes_written += write_bytes;
 
     // Once written, not needed for this payload.
     has_pcr = false;
@@ -160,6 +183,27 @@ void WritePayloadToBufferWriter(const uint8_t* payload,
   } while (payload_bytes_written < payload_size);
 }
 
+CachedTsPackets::CachedTsPackets() {}
+CachedTsPackets::~CachedTsPackets() {}
+
+void CachedTsPackets::Set(const BufferWriter& packets) {
+  DCHECK_EQ(0u, packets.Size() % kTsPacketSize);
+  packets_.assign(packets.Buffer(), packets.Buffer() + packets.Size());
+}
+
+void CachedTsPackets::Write(ContinuityCounter* continuity_counter,
+                            BufferWriter* output) {
+  DCHECK(continuity_counter);
+  // continuity_counter is the low 4 bits of the 4th byte of the packets.
+  const size_t kContinuityCounterOffset = 3;
+  for (size_t offset = kContinuityCounterOffset; offset < packets_.size();
+       offset += kTsPacketSize) {
+    packets_[offset] = (packets_[offset] & 0xF0) |
+                       static_cast<uint8_t>(continuity_counter->GetNext());
+  }
+  output->AppendVector(packets_);
+}
+
 }  // namespace mp2t
 }  // namespace media
 }  // namespace edash_packager
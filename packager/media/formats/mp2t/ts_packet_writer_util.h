@@ -12,6 +12,10 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <vector>
+
+#include "packager/base/macros.h"
+
 namespace edash_packager {
 namespace media {
 
@@ -40,6 +44,48 @@ void WritePayloadToBufferWriter(const uint8_t* payload,
                                 ContinuityCounter* continuity_counter,
                                 BufferWriter* output);
 
+/// Writes the header, and the adaptation field if needed, of the next TS
+/// packet of a payload. The caller appends the payload of the packet, so that
+/// the payload can be gathered from several buffers.
+/// @param bytes_left is the size of the rest of the payload.
+/// @param payload_unit_start_indicator, @a pid, @a has_pcr, @a pcr_base and
+///        @a continuity_counter are the same as in
+///        WritePayloadToBufferWriter().
+/// @param output is where the TS packet header gets written.
+/// @return the number of bytes of the payload that the packet carries.
+size_t WriteTsPacketHeader(size_t bytes_left,
+                           bool payload_unit_start_indicator,
+                           int pid,
+                           bool has_pcr,
+                           uint64_t pcr_base,
+                           ContinuityCounter* continuity_counter,
+                           BufferWriter* output);
+
+/// Keeps the TS packets of a constant payload, e.g. a PSI table, so they are
+/// generated only once. Writing them again only updates their
+/// continuity_counter fields.
+class CachedTsPackets {
+ public:
+  CachedTsPackets();
+  ~CachedTsPackets();
+
+  /// @return true if no packets have been set.
+  bool empty() const { return packets_.empty(); }
+
+  /// @param packets are whole TS packets of the same PID. The values of their
+  ///        continuity_counter fields do not matter.
+  void Set(const BufferWriter& packets);
+
+  /// Appends the packets to @a output.
+  /// @param continuity_counter is the counter of the PID of the packets.
+  void Write(ContinuityCounter* continuity_counter, BufferWriter* output);
+
+ private:
+  std::vector<uint8_t> packets_;
+
+  DISALLOW_COPY_AND_ASSIGN(CachedTsPackets);
+};
+
 }  // namespace mp2t
 }  // namespace media
 }  // namespace edash_packager
@@ -84,13 +84,6 @@ bool TsSectionPat::ParsePsiSection(BitReader* bit_reader) {
   if (version_number == version_number_)
     return true;
 
-  // Both the MSE and the HLS spec specifies that TS streams should convey
-  // exactly one program.
-  if (pmt_pid_count > 1) {
-    DVLOG(1) << "Multiple programs detected in the Mpeg2 TS stream";
-    return false;
-  }
-
   // Can now register the PMT.
 #if !defined(NDEBUG)
   int expected_version_number = version_number;
@@ -100,14 +93,13 @@ bool TsSectionPat::ParsePsiSection(BitReader* bit_reader) {
       << "Unexpected version number: "
       << version_number << " vs " << version_number_;
 #endif
+  // All the programs of a multi-program TS are registered, so that they are
+  // demultiplexed in a single pass. The outputs, e.g. HLS, still convey a
+  // single program each.
   for (int k = 0; k < pmt_pid_count; k++) {
-    if (program_number_array[k] != 0) {
-      // Program numbers different from 0 correspond to PMT.
+    // Program numbers different from 0 correspond to PMT.
+    if (program_number_array[k] != 0)
       register_pmt_cb_.Run(program_number_array[k], pmt_pid_array[k]);
-      // Even if there are multiple programs, only one can be supported now.
-      // HLS: "Transport Stream segments MUST contain a single MPEG-2 Program."
-      break;
-    }
   }
   version_number_ = version_number;
 
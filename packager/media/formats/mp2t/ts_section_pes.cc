@@ -13,52 +13,8 @@
 
 static const int kPesStartCode = 0x000001;
 
-// Given that |time| is coded using 33 bits,
-// UnrollTimestamp returns the corresponding unrolled timestamp.
-// The unrolled timestamp is defined by:
-// |time| + k * (2 ^ 33)
-// where k is estimated so that the unrolled timestamp
-// is as close as possible to |previous_unrolled_time|.
-static int64_t UnrollTimestamp(int64_t previous_unrolled_time, int64_t time) {
-  // Mpeg2 TS timestamps have an accuracy of 33 bits.
-  const int nbits = 33;
-
-  // |timestamp| has a precision of |nbits|
-  // so make sure the highest bits are set to 0.
-  DCHECK_EQ((time >> nbits), 0);
-
-  // Consider 3 possibilities to estimate the missing high bits of |time|.
-  int64_t previous_unrolled_time_high = (previous_unrolled_time >> nbits);
-  int64_t time0 = ((previous_unrolled_time_high - 1) << nbits) | time;
-  int64_t time1 = ((previous_unrolled_time_high + 0) << nbits) | time;
-  int64_t time2 = ((previous_unrolled_time_high + 1) << nbits) | time;
-
-  // Select the min absolute difference with the current time
-  // so as to ensure time continuity.
-  int64_t diff0 = time0 - previous_unrolled_time;
-  int64_t diff1 = time1 - previous_unrolled_time;
-  int64_t diff2 = time2 - previous_unrolled_time;
-  if (diff0 < 0)
-    diff0 = -diff0;
-  if (diff1 < 0)
-    diff1 = -diff1;
-  if (diff2 < 0)
-    diff2 = -diff2;
-
-  int64_t unrolled_time;
-  int64_t min_diff;
-  if (diff1 < diff0) {
-    unrolled_time = time1;
-    min_diff = diff1;
-  } else {
-    unrolled_time = time0;
-    min_diff = diff0;
-  }
-  if (diff2 < min_diff)
-    unrolled_time = time2;
-
-  return unrolled_time;
-}
+// Mpeg2 TS timestamps have an accuracy of 33 bits.
+static const int kTimestampBits = 33;
 
 static bool IsTimestampSectionValid(int64_t timestamp_section) {
   // |pts_section| has 40 bits:
@@ -85,10 +41,8 @@ namespace mp2t {
 TsSectionPes::TsSectionPes(scoped_ptr<EsParser> es_parser)
   : es_parser_(es_parser.release()),
     wait_for_pusi_(true),
-    previous_pts_valid_(false),
-    previous_pts_(0),
-    previous_dts_valid_(false),
-    previous_dts_(0) {
+    pts_unroller_(kTimestampBits),
+    dts_unroller_(kTimestampBits) {
   DCHECK(es_parser_);
 }
 
@@ -121,8 +75,19 @@ bool TsSectionPes::Parse(bool payload_unit_start_indicator,
   }
 
   // Add the data to the parser state.
-  if (size > 0)
+  if (size > 0) {
     pes_byte_queue_.Push(buf, size);
+    int raw_pes_size;
+    const uint8_t* raw_pes;
+    pes_byte_queue_.Peek(&raw_pes, &raw_pes_size);
+    const uint64_t max_buffered_bytes = es_parser_->max_buffered_bytes();
+    if (max_buffered_bytes > 0 &&
+        static_cast<uint64_t>(raw_pes_size) > max_buffered_bytes) {
+      LOG(ERROR) << "More than " << max_buffered_bytes
+                 << " bytes buffered for a PES packet.";
+      return false;
+    }
+  }
 
   // Try emitting the current PES packet.
   return (parse_result && Emit(false));
@@ -140,10 +105,8 @@ void TsSectionPes::Flush() {
 void TsSectionPes::Reset() {
   ResetPesState();
 
-  previous_pts_valid_ = false;
-  previous_pts_ = 0;
-  previous_dts_valid_ = false;
-  previous_dts_ = 0;
+  pts_unroller_.Reset();
+  dts_unroller_.Reset();
 
   es_parser_->Reset();
 }
@@ -270,20 +233,12 @@ bool TsSectionPes::ParseInternal(const uint8_t* raw_pes, int raw_pes_size) {
   int64_t media_pts(kNoTimestamp);
   int64_t media_dts(kNoTimestamp);
   if (is_pts_valid) {
-    int64_t pts = ConvertTimestampSectionToTimestamp(pts_section);
-    if (previous_pts_valid_)
-      pts = UnrollTimestamp(previous_pts_, pts);
-    previous_pts_ = pts;
-    previous_pts_valid_ = true;
-    media_pts = pts;
+    media_pts = pts_unroller_.Unroll(
+        ConvertTimestampSectionToTimestamp(pts_section));
   }
   if (is_dts_valid) {
-    int64_t dts = ConvertTimestampSectionToTimestamp(dts_section);
-    if (previous_dts_valid_)
-      dts = UnrollTimestamp(previous_dts_, dts);
-    previous_dts_ = dts;
-    previous_dts_valid_ = true;
-    media_dts = dts;
+    media_dts = dts_unroller_.Unroll(
+        ConvertTimestampSectionToTimestamp(dts_section));
   }
 
   // Discard the rest of the PES packet header.
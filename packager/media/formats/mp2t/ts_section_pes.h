@@ -10,6 +10,7 @@
 #include "packager/base/compiler_specific.h"
 #include "packager/base/memory/scoped_ptr.h"
 #include "packager/media/base/byte_queue.h"
+#include "packager/media/base/timestamp_unroller.h"
 #include "packager/media/formats/mp2t/ts_section.h"
 
 namespace edash_packager {
@@ -52,10 +53,8 @@ class TsSectionPes : public TsSection {
   bool wait_for_pusi_;
 
   // Used to unroll PTS and DTS.
-  bool previous_pts_valid_;
-  int64_t previous_pts_;
-  bool previous_dts_valid_;
-  int64_t previous_dts_;
+  TimestampUnroller pts_unroller_;
+  TimestampUnroller dts_unroller_;
 
   DISALLOW_COPY_AND_ASSIGN(TsSectionPes);
 };
@@ -0,0 +1,148 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/formats/mp2t/ts_section_scte35.h"
+
+#include <vector>
+
+#include "packager/base/logging.h"
+#include "packager/media/base/bit_reader.h"
+#include "packager/media/base/timed_metadata.h"
+#include "packager/media/formats/mp2t/mp2t_common.h"
+
+namespace edash_packager {
+namespace media {
+namespace mp2t {
+
+namespace {
+
+// SCTE 35, section 9.6 "Splice info section".
+const int kSpliceInfoTableId = 0xfc;
+const int kSpliceInsertCommand = 0x05;
+const int kTimeSignalCommand = 0x06;
+const uint32_t kMpeg2Timescale = 90000;
+const int64_t kTimeMask = (static_cast<int64_t>(1) << 33) - 1;
+
+// Reads a splice_time(). |pts_time| is left untouched if the time is not
+// specified.
+bool ReadSpliceTime(BitReader* bit_reader, bool* time_specified,
+                    int64_t* pts_time) {
+  RCHECK(bit_reader->ReadBits(1, time_specified));
+  if (!*time_specified)
+    return bit_reader->SkipBits(7);
+  RCHECK(bit_reader->SkipBits(6));
+  return bit_reader->ReadBits(33, pts_time);
+}
+
+}  // namespace
+
+TsSectionScte35::TsSectionScte35(
+    const MediaParser::TimedMetadataCB& event_cb)
+    : event_cb_(event_cb) {}
+
+TsSectionScte35::~TsSectionScte35() {}
+
+bool TsSectionScte35::ParsePsiSection(BitReader* bit_reader) {
+  // The whole section is the payload of the event, so it is copied first
+  // and parsed from the copy.
+  std::vector<uint8_t> section;
+  int byte;
+  while (bit_reader->bits_available() >= 8) {
+    RCHECK(bit_reader->ReadBits(8, &byte));
+    section.push_back(static_cast<uint8_t>(byte));
+  }
+  RCHECK(section.size() >= 3);
+  const size_t section_size =
+      3 + (((section[1] << 8) | section[2]) & 0xfff);
+  RCHECK(section_size <= section.size());
+  section.resize(section_size);
+
+  BitReader reader(section.data(), section.size());
+  int table_id;
+  int protocol_version;
+  bool encrypted_packet;
+  int64_t pts_adjustment;
+  int splice_command_type;
+  RCHECK(reader.ReadBits(8, &table_id));
+  RCHECK(table_id == kSpliceInfoTableId);
+  // section_syntax_indicator, private_indicator, reserved, section_length.
+  RCHECK(reader.SkipBits(16));
+  RCHECK(reader.ReadBits(8, &protocol_version));
+  RCHECK(reader.ReadBits(1, &encrypted_packet));
+  // encryption_algorithm.
+  RCHECK(reader.SkipBits(6));
+  RCHECK(reader.ReadBits(33, &pts_adjustment));
+  // cw_index, tier, splice_command_length.
+  RCHECK(reader.SkipBits(32));
+  RCHECK(reader.ReadBits(8, &splice_command_type));
+  if (protocol_version != 0 || encrypted_packet) {
+    DVLOG(1) << "Ignoring an SCTE-35 section of protocol version "
+             << protocol_version << (encrypted_packet ? ", encrypted" : "");
+    return true;
+  }
+
+  TimedMetadataEvent event;
+  event.scheme_id_uri = kScte35SchemeIdUri;
+  event.timescale = kMpeg2Timescale;
+  bool time_specified = false;
+  int64_t pts_time = 0;
+  if (splice_command_type == kSpliceInsertCommand) {
+    bool splice_event_cancel;
+    RCHECK(reader.ReadBits(32, &event.id));
+    RCHECK(reader.ReadBits(1, &splice_event_cancel));
+    RCHECK(reader.SkipBits(7));
+    // A cancellation is only meaningful to the downstream splicers, which
+    // have not seen the event yet if it is not passed through.
+    if (splice_event_cancel)
+      return true;
+    bool out_of_network;
+    bool program_splice;
+    bool duration_flag;
+    bool splice_immediate;
+    RCHECK(reader.ReadBits(1, &out_of_network));
+    RCHECK(reader.ReadBits(1, &program_splice));
+    RCHECK(reader.ReadBits(1, &duration_flag));
+    RCHECK(reader.ReadBits(1, &splice_immediate));
+    RCHECK(reader.SkipBits(4));
+    // The component splices are not supported: the event is only timed by
+    // a program splice.
+    if (!program_splice || splice_immediate) {
+      DVLOG(1) << "Ignoring an SCTE-35 splice_insert without a program "
+                  "splice time.";
+      return true;
+    }
+    RCHECK(ReadSpliceTime(&reader, &time_specified, &pts_time));
+    if (duration_flag) {
+      int64_t break_duration;
+      // auto_return, reserved.
+      RCHECK(reader.SkipBits(7));
+      RCHECK(reader.ReadBits(33, &break_duration));
+      if (out_of_network)
+        event.duration = break_duration;
+    }
+  } else if (splice_command_type == kTimeSignalCommand) {
+    RCHECK(ReadSpliceTime(&reader, &time_specified, &pts_time));
+  } else {
+    DVLOG(1) << "Ignoring SCTE-35 splice command " << splice_command_type;
+    return true;
+  }
+  if (!time_specified) {
+    DVLOG(1) << "Ignoring an SCTE-35 splice command without a time.";
+    return true;
+  }
+
+  event.presentation_time = (pts_time + pts_adjustment) & kTimeMask;
+  event.message_data.swap(section);
+  if (!event_cb_.is_null())
+    event_cb_.Run(event);
+  return true;
+}
+
+void TsSectionScte35::ResetPsiSection() {}
+
+}  // namespace mp2t
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,42 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_FORMATS_MP2T_TS_SECTION_SCTE35_H_
+#define MEDIA_FORMATS_MP2T_TS_SECTION_SCTE35_H_
+
+#include "packager/base/callback.h"
+#include "packager/base/compiler_specific.h"
+#include "packager/media/base/media_parser.h"
+#include "packager/media/formats/mp2t/ts_section_psi.h"
+
+namespace edash_packager {
+namespace media {
+namespace mp2t {
+
+/// Parser of the SCTE-35 splice information sections of a program, which
+/// emits the splice_insert and time_signal commands as timed metadata
+/// events. The events carry the whole section and are timed in 90 kHz
+/// units. The splice times are not unrolled: they wrap every 2^33 ticks.
+class TsSectionScte35 : public TsSectionPsi {
+ public:
+  explicit TsSectionScte35(const MediaParser::TimedMetadataCB& event_cb);
+  ~TsSectionScte35() override;
+
+  // TsSectionPsi implementation.
+  bool ParsePsiSection(BitReader* bit_reader) override;
+  void ResetPsiSection() override;
+
+ private:
+  MediaParser::TimedMetadataCB event_cb_;
+
+  DISALLOW_COPY_AND_ASSIGN(TsSectionScte35);
+};
+
+}  // namespace mp2t
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_FORMATS_MP2T_TS_SECTION_SCTE35_H_
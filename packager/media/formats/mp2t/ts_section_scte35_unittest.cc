@@ -0,0 +1,100 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "packager/base/bind.h"
+#include "packager/media/base/bit_reader.h"
+#include "packager/media/base/timed_metadata.h"
+#include "packager/media/formats/mp2t/ts_section_scte35.h"
+
+namespace edash_packager {
+namespace media {
+namespace mp2t {
+
+namespace {
+
+// A splice_insert of event 0x42 out of network at PTS 900000 for 2700000
+// ticks. The CRC is not checked by ParsePsiSection().
+const uint8_t kSpliceInsertSection[] = {
+    0xFC, 0x30, 0x25,                    // table_id, section_length.
+    0x00,                                // protocol_version.
+    0x00, 0x00, 0x00, 0x00, 0x00,        // pts_adjustment.
+    0xFF, 0xFF, 0xF0, 0x14,              // cw_index, tier, command length.
+    0x05,                                // splice_insert.
+    0x00, 0x00, 0x00, 0x42,              // splice_event_id.
+    0x7F,                                // Not cancelled.
+    0xEF,                                // Out of network, with duration.
+    0xFE, 0x00, 0x0D, 0xBB, 0xA0,        // splice_time.
+    0xFE, 0x00, 0x29, 0x32, 0xE0,        // break_duration.
+    0x00, 0x01, 0x00, 0x00,              // unique_program_id, avails.
+    0x00, 0x00,                          // descriptor_loop_length.
+    0x00, 0x00, 0x00, 0x00,              // CRC_32.
+};
+
+// Offsets in kSpliceInsertSection.
+const size_t kPtsAdjustmentOffset = 4;
+const size_t kSpliceEventCancelOffset = 18;
+
+void StoreEvent(std::vector<TimedMetadataEvent>* events,
+                const TimedMetadataEvent& event) {
+  events->push_back(event);
+}
+
+}  // namespace
+
+class TsSectionScte35Test : public testing::Test {
+ protected:
+  TsSectionScte35Test()
+      : section_(kSpliceInsertSection,
+                 kSpliceInsertSection + arraysize(kSpliceInsertSection)),
+        parser_(base::Bind(&StoreEvent, &events_)) {}
+
+  bool Parse() {
+    BitReader bit_reader(section_.data(), section_.size());
+    return parser_.ParsePsiSection(&bit_reader);
+  }
+
+  std::vector<uint8_t> section_;
+  std::vector<TimedMetadataEvent> events_;
+  TsSectionScte35 parser_;
+};
+
+TEST_F(TsSectionScte35Test, SpliceInsert) {
+  ASSERT_TRUE(Parse());
+  ASSERT_EQ(1u, events_.size());
+  const TimedMetadataEvent& event = events_[0];
+  EXPECT_EQ(kScte35SchemeIdUri, event.scheme_id_uri);
+  EXPECT_EQ(90000u, event.timescale);
+  EXPECT_EQ(900000, event.presentation_time);
+  EXPECT_EQ(2700000u, event.duration);
+  EXPECT_EQ(0x42u, event.id);
+  EXPECT_EQ(section_, event.message_data);
+}
+
+// The splice time wraps around at 2^33 once adjusted.
+TEST_F(TsSectionScte35Test, PtsAdjustment) {
+  // pts_adjustment = 2^33 - 100000.
+  const uint8_t kPtsAdjustment[] = {0x01, 0xFF, 0xFE, 0x79, 0x60};
+  std::copy(kPtsAdjustment, kPtsAdjustment + arraysize(kPtsAdjustment),
+            section_.begin() + kPtsAdjustmentOffset);
+  ASSERT_TRUE(Parse());
+  ASSERT_EQ(1u, events_.size());
+  EXPECT_EQ(800000, events_[0].presentation_time);
+}
+
+TEST_F(TsSectionScte35Test, CancellationIsIgnored) {
+  section_[kSpliceEventCancelOffset] = 0xFF;
+  ASSERT_TRUE(Parse());
+  EXPECT_TRUE(events_.empty());
+}
+
+}  // namespace mp2t
+}  // namespace media
+}  // namespace edash_packager
@@ -6,15 +6,18 @@
 
 #include "packager/media/formats/mp2t/ts_segmenter.h"
 
+#include <algorithm>
 #include <memory>
 
 #include "packager/media/base/aes_encryptor.h"
 #include "packager/media/base/key_source.h"
 #include "packager/media/base/muxer_util.h"
+#include "packager/media/base/pipeline_metrics.h"
 #include "packager/media/base/status.h"
 #include "packager/media/base/video_stream_info.h"
 #include "packager/media/event/muxer_listener.h"
 #include "packager/media/event/progress_listener.h"
+#include "packager/media/file/checksum_file.h"
 
 namespace edash_packager {
 namespace media {
@@ -27,6 +30,7 @@ const double kTsTimescale = 90000;
 TsSegmenter::TsSegmenter(const MuxerOptions& options, MuxerListener* listener)
     : muxer_options_(options),
       listener_(listener),
+      segment_name_template_(options.segment_template),
       ts_writer_(new TsWriter()),
       pes_packet_generator_(new PesPacketGenerator()) {}
 TsSegmenter::~TsSegmenter() {}
@@ -37,6 +41,7 @@ Status TsSegmenter::Initialize(const StreamInfo& stream_info,
                                double clear_lead_in_seconds) {
   if (muxer_options_.segment_template.empty())
     return Status(error::MUXER_FAILURE, "Segment template not specified.");
+  ts_writer_->set_segment_checksum(muxer_options_.segment_checksum);
   if (!ts_writer_->Initialize(stream_info, false))
     return Status(error::MUXER_FAILURE, "Failed to initialize TsWriter.");
   if (!pes_packet_generator_->Initialize(stream_info)) {
@@ -59,6 +64,8 @@ Status TsSegmenter::Initialize(const StreamInfo& stream_info,
       return status;
     encryption_key_ = encryption_key.Pass();
     clear_lead_in_seconds_ = clear_lead_in_seconds;
+    pes_packet_generator_->EnableParallelEncryption(
+        std::max(muxer_options_.num_encryption_threads, 0));
     status = NotifyEncrypted();
     if (!status.ok())
       return status;
@@ -69,6 +76,8 @@ Status TsSegmenter::Initialize(const StreamInfo& stream_info,
 }
 
 Status TsSegmenter::Finalize() {
+  // The segment opened ahead turns out not to exist.
+  ts_writer_->DiscardSegmentOpenedAhead();
   return Flush();
 }
 
@@ -115,13 +124,22 @@ void TsSegmenter::SetTsWriterFileOpenedForTesting(bool value) {
 Status TsSegmenter::OpenNewSegmentIfClosed(uint32_t next_pts) {
   if (ts_writer_file_opened_)
     return Status::OK;
-  const std::string segment_name =
-      GetSegmentName(muxer_options_.segment_template, next_pts,
-                     segment_number_++, muxer_options_.bandwidth);
-  if (!ts_writer_->NewSegment(segment_name))
+  segment_name_template_.Expand(next_pts, segment_number_++,
+                                muxer_options_.bandwidth,
+                                &current_segment_path_);
+  if (!ts_writer_->NewSegment(current_segment_path_))
     return Status(error::MUXER_FAILURE, "Failed to initilize TsPacketWriter.");
+  // The name of the next segment is known in advance only if it does not
+  // depend on its start time.
+  if (muxer_options_.open_segments_ahead &&
+      !segment_name_template_.has_time()) {
+    std::string next_segment_name;
+    segment_name_template_.Expand(0, segment_number_,
+                                  muxer_options_.bandwidth,
+                                  &next_segment_name);
+    ts_writer_->OpenSegmentAhead(next_segment_name);
+  }
   current_segment_start_time_ = next_pts;
-  current_segment_path_ = segment_name;
   ts_writer_file_opened_ = true;
   return Status::OK;
 }
@@ -131,12 +149,23 @@ Status TsSegmenter::WritePesPacketsToFile() {
     scoped_ptr<PesPacket> pes_packet =
         pes_packet_generator_->GetNextPesPacket();
 
+    const bool new_segment = !ts_writer_file_opened_;
     Status status = OpenNewSegmentIfClosed(pes_packet->pts());
     if (!status.ok())
       return status;
 
+    // The byte range of a key frame starting a segment includes the PSI
+    // before it, so that it can be decoded on its own.
+    const bool is_key_frame = pes_packet->is_key_frame();
+    const int64_t pts = pes_packet->pts();
+    const uint64_t start_byte_offset =
+        new_segment ? 0 : ts_writer_->segment_size();
     if (!ts_writer_->AddPesPacket(pes_packet.Pass()))
       return Status(error::MUXER_FAILURE, "Failed to add PES packet.");
+    if (listener_ && is_key_frame) {
+      listener_->OnKeyFrame(pts, start_byte_offset,
+                            ts_writer_->segment_size() - start_byte_offset);
+    }
   }
   return Status::OK;
 }
@@ -153,15 +182,26 @@ Status TsSegmenter::Flush() {
   // This method may be called from Finalize() so ts_writer_file_opened_ could
   // be false.
   if (ts_writer_file_opened_) {
+    ScopedStageTimer segment_write_timer(kSegmentWriteStage);
     if (!ts_writer_->FinalizeSegment()) {
       return Status(error::MUXER_FAILURE, "Failed to finalize TsWriter.");
     }
+    const std::string& checksum = ts_writer_->segment_checksum();
+    if (muxer_options_.write_segment_checksum_files && !checksum.empty() &&
+        !ChecksumFile::WriteSidecarFile(current_segment_path_,
+                                        muxer_options_.segment_checksum,
+                                        checksum)) {
+      return Status(error::FILE_FAILURE,
+                    "Cannot write the checksum file of " +
+                        current_segment_path_);
+    }
     if (listener_) {
       const int64_t file_size =
           File::GetFileSize(current_segment_path_.c_str());
       listener_->OnNewSegment(
           current_segment_path_, current_segment_start_time_,
-          current_segment_total_sample_duration_ * kTsTimescale, file_size);
+          current_segment_total_sample_duration_ * kTsTimescale, file_size,
+          checksum);
     }
     ts_writer_file_opened_ = false;
     total_duration_in_seconds_ += current_segment_total_sample_duration_;
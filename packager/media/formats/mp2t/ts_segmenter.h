@@ -9,6 +9,7 @@
 
 #include "packager/base/memory/scoped_ptr.h"
 #include "packager/media/base/media_stream.h"
+#include "packager/media/base/muxer_util.h"
 #include "packager/media/base/muxer_options.h"
 #include "packager/media/base/status.h"
 #include "packager/media/file/file.h"
@@ -92,6 +93,7 @@ class TsSegmenter {
   double current_segment_total_sample_duration_ = 0.0;
 
   // Used for segment template.
+  SegmentNameTemplate segment_name_template_;
   uint64_t segment_number_ = 0;
 
   scoped_ptr<TsWriter> ts_writer_;
@@ -212,7 +212,7 @@ TEST_F(TsSegmenterTest, PassedSegmentDuration) {
   // event. The length should be the same as the above sample that exceeds the
   // duration.
   EXPECT_CALL(mock_listener,
-              OnNewSegment("file1.ts", kFirstPts, kTimeScale * 11, _));
+              OnNewSegment("file1.ts", kFirstPts, kTimeScale * 11, _, ""));
 
   // Doesn't really matter how long this is.
   sample2->set_duration(kInputTimescale * 7);
@@ -8,6 +8,7 @@
 
 #include <algorithm>
 
+#include "packager/base/bind.h"
 #include "packager/base/logging.h"
 #include "packager/media/base/audio_stream_info.h"
 #include "packager/media/base/buffer_writer.h"
@@ -47,15 +48,14 @@ const uint8_t kPat[] = {
 const bool kHasPcr = true;
 const bool kPayloadUnitStartIndicator = true;
 
-// This is the size of the first few fields in a TS packet, i.e. TS packet size
-// without adaptation field or the payload.
-const int kTsPacketHeaderSize = 4;
 const int kTsPacketSize = 188;
-const int kTsPacketMaximumPayloadSize =
-    kTsPacketSize - kTsPacketHeaderSize;
 
 const size_t kMaxPesPacketLengthValue = 0xFFFF;
 
+// The segment buffer is written to file once it holds this many bytes, so the
+// writes are large and TS packet aligned.
+const size_t kSegmentBufferFlushSize = 5577 * kTsPacketSize;  // ~1MB.
+
 void WritePatToBuffer(const uint8_t* pat,
                       int pat_size,
                       ContinuityCounter* continuity_counter,
@@ -87,17 +87,9 @@ void WritePtsOrDts(uint8_t leading_bits,
   writer->AppendInt(fifth_byte);
 }
 
-bool WritePesToFile(const PesPacket& pes,
-                    ContinuityCounter* continuity_counter,
-                    File* file) {
-  // The size of the length field.
-  const int kAdaptationFieldLengthSize = 1;
-  // The size of the flags field.
-  const int kAdaptationFieldHeaderSize = 1;
-  const int kPcrFieldSize = 6;
-  const int kTsPacketMaxPayloadWithPcr =
-      kTsPacketMaximumPayloadSize - kAdaptationFieldLengthSize -
-      kAdaptationFieldHeaderSize - kPcrFieldSize;
+void WritePesToBuffer(const PesPacket& pes,
+                      ContinuityCounter* continuity_counter,
+                      BufferWriter* output_writer) {
   const uint64_t pcr_base = pes.has_dts() ? pes.dts() : pes.pts();
   const int pid = ProgramMapTableWriter::kElementaryPid;
 
@@ -125,41 +117,55 @@ bool WritePesToFile(const PesPacket& pes,
     WritePtsOrDts(0x02, pes.pts(), &pes_header_writer);
   }
 
-  // Put the first TS packet's payload into a buffer. This contains the PES
-  // packet's header.
-  BufferWriter first_ts_packet_buffer(kTsPacketSize);
-  first_ts_packet_buffer.AppendNBytes(static_cast<uint64_t>(0x000001), 3);
-  first_ts_packet_buffer.AppendInt(pes.stream_id());
-  const size_t pes_packet_length = pes.data().size() + pes_header_writer.Size();
-  first_ts_packet_buffer.AppendInt(static_cast<uint16_t>(
+  BufferWriter pes_start_writer(kTsPacketSize);
+  pes_start_writer.AppendNBytes(static_cast<uint64_t>(0x000001), 3);
+  pes_start_writer.AppendInt(pes.stream_id());
+  const size_t pes_packet_length =
+      pes.payload_size() + pes_header_writer.Size();
+  pes_start_writer.AppendInt(static_cast<uint16_t>(
       pes_packet_length > kMaxPesPacketLengthValue ? 0 : pes_packet_length));
-  first_ts_packet_buffer.AppendBuffer(pes_header_writer);
-
-  const int available_payload =
-      kTsPacketMaxPayloadWithPcr - first_ts_packet_buffer.Size();
-  const int bytes_consumed =
-      std::min(static_cast<int>(pes.data().size()), available_payload);
-  first_ts_packet_buffer.AppendArray(pes.data().data(), bytes_consumed);
-
-  BufferWriter output_writer;
-  WritePayloadToBufferWriter(first_ts_packet_buffer.Buffer(),
-                             first_ts_packet_buffer.Size(),
-                             kPayloadUnitStartIndicator, pid, kHasPcr, pcr_base,
-                             continuity_counter, &output_writer);
-
-  const size_t remaining_pes_data_size = pes.data().size() - bytes_consumed;
-  if (remaining_pes_data_size > 0) {
-    WritePayloadToBufferWriter(pes.data().data() + bytes_consumed,
-                               remaining_pes_data_size,
-                               !kPayloadUnitStartIndicator, pid, !kHasPcr, 0,
-                               continuity_counter, &output_writer);
-  }
-  return output_writer.WriteToFile(file).ok();
+  pes_start_writer.AppendBuffer(pes_header_writer);
+
+  // The TS packets carry the PES header followed by the slices of the payload,
+  // which are copied straight into |output_writer|.
+  std::vector<PesPacket::PayloadSlice> slices;
+  const PesPacket::PayloadSlice header_slice = {pes_start_writer.Buffer(),
+                                                pes_start_writer.Size()};
+  slices.push_back(header_slice);
+  std::vector<PesPacket::PayloadSlice> payload_slices;
+  pes.GetPayloadSlices(&payload_slices);
+  slices.insert(slices.end(), payload_slices.begin(), payload_slices.end());
+
+  size_t bytes_left = pes_start_writer.Size() + pes.payload_size();
+  size_t slice_index = 0;
+  size_t slice_offset = 0;
+  bool first_ts_packet = true;
+  do {
+    // Only the first TS packet starts the PES packet and carries the PCR.
+    size_t packet_bytes_left = WriteTsPacketHeader(
+        bytes_left, first_ts_packet, pid, first_ts_packet, pcr_base,
+        continuity_counter, output_writer);
+    bytes_left -= packet_bytes_left;
+    while (packet_bytes_left > 0) {
+      DCHECK_LT(slice_index, slices.size());
+      const PesPacket::PayloadSlice& slice = slices[slice_index];
+      const size_t bytes_to_write =
+          std::min(packet_bytes_left, slice.size - slice_offset);
+      output_writer->AppendArray(slice.data + slice_offset, bytes_to_write);
+      packet_bytes_left -= bytes_to_write;
+      slice_offset += bytes_to_write;
+      if (slice_offset == slice.size) {
+        ++slice_index;
+        slice_offset = 0;
+      }
+    }
+    first_ts_packet = false;
+  } while (bytes_left > 0);
 }
 
 }  // namespace
 
-TsWriter::TsWriter() {}
+TsWriter::TsWriter() : segment_buffer_(kSegmentBufferFlushSize) {}
 TsWriter::~TsWriter() {}
 
 bool TsWriter::Initialize(const StreamInfo& stream_info,
@@ -203,34 +209,57 @@ bool TsWriter::NewSegment(const std::string& file_name) {
     LOG(ERROR) << "File " << current_file_->file_name() << " still open.";
     return false;
   }
-  current_file_.reset(File::Open(file_name.c_str(), "w"));
+  current_file_.reset(
+      segment_open_ahead_
+          ? segment_open_ahead_->Open(file_name)
+          : ChecksumFile::OpenSegmentFile(segment_checksum_algorithm_,
+                                          file_name));
   if (!current_file_) {
     LOG(ERROR) << "Failed to open file " << file_name;
     return false;
   }
-
-  BufferWriter psi;
-  WritePatToBuffer(kPat, arraysize(kPat), &pat_continuity_counter_, &psi);
+  if (segment_checksum_algorithm_ != SegmentChecksum::kNone)
+    checksum_file_ = static_cast<ChecksumFile*>(current_file_.get());
+
+  // The PSI starts the segment buffer, it is written with the first PESs.
+  DCHECK_EQ(0u, segment_buffer_.Size());
+  segment_bytes_written_ = 0;
+  BufferWriter* psi = &segment_buffer_;
+  if (pat_.empty()) {
+    ContinuityCounter unused_counter;
+    BufferWriter packets;
+    WritePatToBuffer(kPat, arraysize(kPat), &unused_counter, &packets);
+    pat_.Set(packets);
+  }
+  pat_.Write(&pat_continuity_counter_, psi);
   if (will_be_encrypted_ && !encrypted_) {
-    if (!pmt_writer_->ClearLeadSegmentPmt(&psi)) {
+    if (!pmt_writer_->ClearLeadSegmentPmt(psi)) {
       return false;
     }
   } else if (encrypted_) {
-    if (!pmt_writer_->EncryptedSegmentPmt(&psi)) {
+    if (!pmt_writer_->EncryptedSegmentPmt(psi)) {
       return false;
     }
   } else {
-    if (!pmt_writer_->ClearSegmentPmt(&psi)) {
+    if (!pmt_writer_->ClearSegmentPmt(psi)) {
       return false;
     }
   }
 
-  if (!psi.WriteToFile(current_file_.get()).ok()) {
-    LOG(ERROR) << "Failed to write PSI to file.";
-    return false;
+  return true;
+}
+
+void TsWriter::OpenSegmentAhead(const std::string& file_name) {
+  if (!segment_open_ahead_) {
+    segment_open_ahead_.reset(new FileOpenAhead(base::Bind(
+        &ChecksumFile::OpenSegmentFile, segment_checksum_algorithm_)));
   }
+  segment_open_ahead_->Start(file_name);
+}
 
-  return true;
+void TsWriter::DiscardSegmentOpenedAhead() {
+  if (segment_open_ahead_)
+    segment_open_ahead_->Discard();
 }
 
 void TsWriter::SignalEncypted() {
@@ -238,18 +267,39 @@ void TsWriter::SignalEncypted() {
 }
 
 bool TsWriter::FinalizeSegment() {
-  return current_file_.release()->Close();
+  DCHECK(current_file_);
+  const bool write_succeeded = WriteSegmentBuffer();
+  segment_checksum_.clear();
+  if (checksum_file_) {
+    segment_checksum_ = checksum_file_->FinishChecksum();
+    checksum_file_ = NULL;
+  }
+  return current_file_.release()->Close() && write_succeeded;
 }
 
 bool TsWriter::AddPesPacket(scoped_ptr<PesPacket> pes_packet) {
   DCHECK(current_file_);
-  if (!WritePesToFile(*pes_packet, &elementary_stream_continuity_counter_,
-                      current_file_.get())) {
-    LOG(ERROR) << "Failed to write pes to file.";
+  WritePesToBuffer(*pes_packet, &elementary_stream_continuity_counter_,
+                   &segment_buffer_);
+  // No need to keep pes_packet around so not passing it anywhere.
+
+  if (segment_buffer_.Size() >= kSegmentBufferFlushSize)
+    return WriteSegmentBuffer();
+  return true;
+}
+
+bool TsWriter::WriteSegmentBuffer() {
+  if (segment_buffer_.Size() == 0)
+    return true;
+  DCHECK_EQ(0u, segment_buffer_.Size() % kTsPacketSize);
+  segment_bytes_written_ += segment_buffer_.Size();
+  if (!segment_buffer_.WriteToFile(current_file_.get()).ok()) {
+    LOG(ERROR) << "Failed to write TS packets to file "
+               << current_file_->file_name();
+    // Drop the data so the next segment starts clean.
+    segment_buffer_.Clear();
     return false;
   }
-
-  // No need to keep pes_packet around so not passing it anywhere.
   return true;
 }
 
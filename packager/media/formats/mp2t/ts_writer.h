@@ -9,15 +9,20 @@
 
 #include <list>
 #include <map>
+#include <string>
 #include <vector>
 
 #include "packager/base/memory/scoped_ptr.h"
+#include "packager/media/base/buffer_writer.h"
 #include "packager/media/base/media_stream.h"
+#include "packager/media/file/checksum_file.h"
 #include "packager/media/file/file.h"
 #include "packager/media/file/file_closer.h"
+#include "packager/media/file/file_open_ahead.h"
 #include "packager/media/formats/mp2t/continuity_counter.h"
 #include "packager/media/formats/mp2t/pes_packet.h"
 #include "packager/media/formats/mp2t/program_map_table_writer.h"
+#include "packager/media/formats/mp2t/ts_packet_writer_util.h"
 
 namespace edash_packager {
 namespace media {
@@ -25,6 +30,8 @@ namespace mp2t {
 
 /// This class takes PesPackets, encapsulates them into TS packets, and write
 /// the data to file. This also creates PSI from StreamInfo.
+/// The TS packets of a segment are assembled in a buffer, which is written to
+/// the file in large blocks of whole TS packets.
 class TsWriter {
  public:
   TsWriter();
@@ -60,11 +67,39 @@ class TsWriter {
   /// @return true on success, false otherwise.
   virtual bool AddPesPacket(scoped_ptr<PesPacket> pes_packet);
 
+  /// @return The size of the current segment so far, i.e. the offset of the
+  ///         next PesPacket added in the segment.
+  uint64_t segment_size() const {
+    return segment_bytes_written_ + segment_buffer_.Size();
+  }
+
+  /// Compute the checksum of the segments as they are written. Must be
+  /// called before NewSegment().
+  void set_segment_checksum(SegmentChecksum::Algorithm algorithm) {
+    segment_checksum_algorithm_ = algorithm;
+  }
+
+  /// @return The checksum of the last segment finalized, empty if the
+  ///         checksum is not computed.
+  const std::string& segment_checksum() const { return segment_checksum_; }
+
+  /// Starts opening the file of a later segment on a worker thread, see
+  /// FileOpenAhead. NewSegment() uses it if it is the file of the new
+  /// segment.
+  /// @param file_name is the file name of the segment.
+  void OpenSegmentAhead(const std::string& file_name);
+
+  /// Discards the file opened by OpenSegmentAhead() and not used, if any.
+  void DiscardSegmentOpenedAhead();
+
   /// Only for testing.
   void SetProgramMapTableWriterForTesting(
       scoped_ptr<ProgramMapTableWriter> table_writer);
 
  private:
+  // Writes |segment_buffer_| to |current_file_|.
+  bool WriteSegmentBuffer();
+
   // True if further segments generated by this instance should be encrypted.
   bool encrypted_ = false;
   // The stream will be encrypted some time later.
@@ -74,9 +109,24 @@ class TsWriter {
   ContinuityCounter pat_continuity_counter_;
   ContinuityCounter elementary_stream_continuity_counter_;
 
+  CachedTsPackets pat_;
+
   scoped_ptr<ProgramMapTableWriter> pmt_writer_;
 
   scoped_ptr<File, FileCloser> current_file_;
+  // |current_file_| if the checksum of the segments is computed, NULL
+  // otherwise.
+  ChecksumFile* checksum_file_ = NULL;
+  SegmentChecksum::Algorithm segment_checksum_algorithm_ =
+      SegmentChecksum::kNone;
+  std::string segment_checksum_;
+  // Created by the first call to OpenSegmentAhead().
+  scoped_ptr<FileOpenAhead> segment_open_ahead_;
+  // TS packets of the current segment not written to |current_file_| yet.
+  // It keeps its capacity across segments.
+  BufferWriter segment_buffer_;
+  // The bytes of the current segment written to |current_file_|.
+  uint64_t segment_bytes_written_ = 0;
 
   DISALLOW_COPY_AND_ASSIGN(TsWriter);
 };
@@ -478,7 +478,10 @@ TEST_F(TsWriterTest, BigPesPacket) {
   const std::vector<uint8_t> big_data(400, 0x23);
   *pes->mutable_data() = big_data;
 
+  // The segment starts with the PAT and the PMT.
+  EXPECT_EQ(2u * 188, ts_writer_.segment_size());
   EXPECT_TRUE(ts_writer_.AddPesPacket(pes.Pass()));
+  EXPECT_EQ(5u * 188, ts_writer_.segment_size());
   ASSERT_TRUE(ts_writer_.FinalizeSegment());
 
   std::vector<uint8_t> content;
@@ -497,6 +500,79 @@ TEST_F(TsWriterTest, BigPesPacket) {
   EXPECT_EQ(2, (content[4 * 188 + 3] & 0xF));
 }
 
+// Verify that the checksum of a segment is the checksum of its file.
+TEST_F(TsWriterTest, SegmentChecksum) {
+  scoped_refptr<VideoStreamInfo> stream_info(new VideoStreamInfo(
+      kTrackId, kTimeScale, kDuration, kH264VideoCodec, kCodecString, kLanguage,
+      kWidth, kHeight, kPixelWidth, kPixelHeight, kTrickPlayRate,
+      kNaluLengthSize, kExtraData, arraysize(kExtraData), kIsEncrypted));
+  EXPECT_TRUE(ts_writer_.Initialize(*stream_info, !kWillBeEncrypted));
+  ts_writer_.set_segment_checksum(SegmentChecksum::kSha256);
+  EXPECT_TRUE(ts_writer_.NewSegment(test_file_name_));
+
+  scoped_ptr<PesPacket> pes(new PesPacket());
+  pes->set_pts(0);
+  pes->set_dts(0);
+  *pes->mutable_data() = std::vector<uint8_t>(400, 0x23);
+  EXPECT_TRUE(ts_writer_.AddPesPacket(pes.Pass()));
+  ASSERT_TRUE(ts_writer_.FinalizeSegment());
+
+  std::vector<uint8_t> content;
+  ASSERT_TRUE(ReadFileToVector(test_file_path_, &content));
+  SegmentChecksum checksum(SegmentChecksum::kSha256);
+  checksum.Update(content.data(), content.size());
+  EXPECT_EQ(checksum.Finish(), ts_writer_.segment_checksum());
+}
+
+// Verify that the slices of a PES packet, copied or referenced, are written as
+// if the payload were contiguous.
+TEST_F(TsWriterTest, PesPacketWithSlices) {
+  scoped_refptr<VideoStreamInfo> stream_info(new VideoStreamInfo(
+      kTrackId, kTimeScale, kDuration, kH264VideoCodec, kCodecString, kLanguage,
+      kWidth, kHeight, kPixelWidth, kPixelHeight, kTrickPlayRate,
+      kNaluLengthSize, kExtraData, arraysize(kExtraData), kIsEncrypted));
+
+  // A little over 2 TS Packets, so that slices span TS packets.
+  std::vector<uint8_t> big_data(400);
+  for (size_t i = 0; i < big_data.size(); ++i)
+    big_data[i] = static_cast<uint8_t>(i);
+
+  EXPECT_TRUE(ts_writer_.Initialize(*stream_info, !kWillBeEncrypted));
+  EXPECT_TRUE(ts_writer_.NewSegment(test_file_name_));
+  scoped_ptr<PesPacket> pes(new PesPacket());
+  pes->set_pts(0);
+  pes->set_dts(0);
+  pes->AppendPayload(big_data.data(), 5);
+  pes->AppendPayloadReference(big_data.data() + 5, 200);
+  pes->AppendPayload(big_data.data() + 205, 4);
+  pes->AppendPayload(big_data.data() + 209, 1);
+  pes->AppendPayloadReference(big_data.data() + 210, 190);
+  EXPECT_EQ(big_data.size(), pes->payload_size());
+  EXPECT_TRUE(ts_writer_.AddPesPacket(pes.Pass()));
+  ASSERT_TRUE(ts_writer_.FinalizeSegment());
+
+  base::FilePath expected_file_path;
+  ASSERT_TRUE(base::CreateTemporaryFile(&expected_file_path));
+  TsWriter expected_ts_writer;
+  EXPECT_TRUE(expected_ts_writer.Initialize(*stream_info, !kWillBeEncrypted));
+  EXPECT_TRUE(expected_ts_writer.NewSegment(kLocalFilePrefix +
+                                            expected_file_path.value()));
+  pes.reset(new PesPacket());
+  pes->set_pts(0);
+  pes->set_dts(0);
+  *pes->mutable_data() = big_data;
+  EXPECT_TRUE(expected_ts_writer.AddPesPacket(pes.Pass()));
+  ASSERT_TRUE(expected_ts_writer.FinalizeSegment());
+
+  std::vector<uint8_t> content;
+  ASSERT_TRUE(ReadFileToVector(test_file_path_, &content));
+  std::vector<uint8_t> expected_content;
+  ASSERT_TRUE(ReadFileToVector(expected_file_path, &expected_content));
+  base::DeleteFile(expected_file_path, false);
+  EXPECT_EQ(5u * 188, content.size());
+  EXPECT_EQ(expected_content, content);
+}
+
 // Bug found in code review. It should check whether PTS is present not whether
 // PTS (implicilty) cast to bool is true.
 TEST_F(TsWriterTest, PesPtsZeroNoDts) {
@@ -128,7 +128,18 @@ bool AACAudioSpecificConfig::Parse(const std::vector<uint8_t>& data) {
 }
 
 bool AACAudioSpecificConfig::ConvertToADTS(std::vector<uint8_t>* buffer) const {
-  size_t size = buffer->size() + kADTSHeaderSize;
+  std::vector<uint8_t> header;
+  if (!GetADTSHeader(buffer->size(), &header))
+    return false;
+  buffer->insert(buffer->begin(), header.begin(), header.end());
+  return true;
+}
+
+bool AACAudioSpecificConfig::GetADTSHeader(
+    size_t frame_size,
+    std::vector<uint8_t>* header) const {
+  DCHECK(header);
+  size_t size = frame_size + kADTSHeaderSize;
 
   DCHECK(audio_object_type_ >= 1 && audio_object_type_ <= 4 &&
          frequency_index_ != 0xf && channel_config_ <= 7);
@@ -137,9 +148,9 @@ bool AACAudioSpecificConfig::ConvertToADTS(std::vector<uint8_t>* buffer) const {
   if (size >= (1 << 13))
     return false;
 
-  std::vector<uint8_t>& adts = *buffer;
+  std::vector<uint8_t>& adts = *header;
 
-  adts.insert(buffer->begin(), kADTSHeaderSize, 0);
+  adts.assign(kADTSHeaderSize, 0);
   adts[0] = 0xff;
   adts[1] = 0xf1;
   adts[2] = ((audio_object_type_ - 1) << 6) + (frequency_index_ << 2) +
@@ -42,6 +42,14 @@ class AACAudioSpecificConfig {
   /// @return true on success, false otherwise.
   virtual bool ConvertToADTS(std::vector<uint8_t>* buffer) const;
 
+  /// Generate the ADTS header of a raw AAC frame, so that the header can be
+  /// written before the frame without copying the frame.
+  /// @param frame_size is the size of the raw AAC frame.
+  /// @param[out] header receives the kADTSHeaderSize bytes of the header.
+  /// @return true on success, false otherwise.
+  virtual bool GetADTSHeader(size_t frame_size,
+                             std::vector<uint8_t>* header) const;
+
   /// @param sbr_in_mimetype indicates whether SBR mode is specified in the
   ///        mimetype, i.e. codecs parameter contains mp4a.40.5.
   /// @return Output sample rate for the AAC stream.
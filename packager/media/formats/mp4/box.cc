@@ -27,12 +27,18 @@ void Box::Write(BufferWriter* writer) {
   // Compute and update box size.
   uint32_t size = ComputeSize();
   DCHECK_EQ(size, box_size_);
+  WriteWithComputedSize(writer);
+}
+
+void Box::WriteWithComputedSize(BufferWriter* writer) {
+  DCHECK(writer);
+  DCHECK_EQ(ComputeSizeInternal(), box_size_) << FourCCToString(BoxType());
 
-  size_t buffer_size_before_write = writer->Size();
-  BoxBuffer buffer(writer);
+  // The box is serialized in place, in a region reserved at once.
+  UncheckedBufferWriter box_writer(writer->Extend(box_size_), box_size_);
+  BoxBuffer buffer(&box_writer);
   CHECK(ReadWriteInternal(&buffer));
-  DCHECK_EQ(box_size_, writer->Size() - buffer_size_before_write)
-      << FourCCToString(BoxType());
+  DCHECK_EQ(box_size_, box_writer.Size()) << FourCCToString(BoxType());
 }
 
 void Box::WriteHeader(BufferWriter* writer) {
@@ -41,10 +47,12 @@ void Box::WriteHeader(BufferWriter* writer) {
   uint32_t size = ComputeSize();
   DCHECK_EQ(size, box_size_);
 
-  size_t buffer_size_before_write = writer->Size();
-  BoxBuffer buffer(writer);
+  const uint32_t header_size = HeaderSize();
+  UncheckedBufferWriter header_writer(writer->Extend(header_size),
+                                      header_size);
+  BoxBuffer buffer(&header_writer);
   CHECK(ReadWriteHeaderInternal(&buffer));
-  DCHECK_EQ(HeaderSize(), writer->Size() - buffer_size_before_write);
+  DCHECK_EQ(header_size, header_writer.Size());
 }
 
 uint32_t Box::ComputeSize() {
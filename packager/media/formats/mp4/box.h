@@ -36,6 +36,12 @@ struct Box {
   /// @param writer points to a BufferWriter object which wraps the buffer for
   ///        writing.
   void Write(BufferWriter* writer);
+  /// Write the box to buffer with the box sizes computed by the last
+  /// ComputeSize call, which avoids computing them again. The box must not
+  /// have been modified in a way that changes its size since.
+  /// @param writer points to a BufferWriter object which wraps the buffer for
+  ///        writing.
+  void WriteWithComputedSize(BufferWriter* writer);
   /// Write the box header to buffer. This function calls ComputeSize internally
   /// to compute and update box size.
   /// @param writer points to a BufferWriter object which wraps the buffer for
@@ -11,6 +11,7 @@
 
 #include "packager/base/compiler_specific.h"
 #include "packager/media/base/buffer_writer.h"
+#include "packager/media/base/hot_path.h"
 #include "packager/media/formats/mp4/box.h"
 #include "packager/media/formats/mp4/box_reader.h"
 
@@ -31,7 +32,8 @@ class BoxBuffer {
   }
   /// Create a writer version of the BoxBuffer.
   /// @param writer should not be NULL.
-  explicit BoxBuffer(BufferWriter* writer) : reader_(NULL), writer_(writer) {
+  explicit BoxBuffer(UncheckedBufferWriter* writer)
+      : reader_(NULL), writer_(writer) {
     DCHECK(writer);
   }
   ~BoxBuffer() {}
@@ -129,7 +131,7 @@ class BoxBuffer {
   bool ReadWriteVector(std::vector<uint8_t>* vector, size_t count) {
     if (reader_)
       return reader_->ReadToVector(vector, count);
-    DCHECK_EQ(vector->size(), count);
+    HOT_DCHECK_EQ(vector->size(), count);
     writer_->AppendArray(vector->data(), count);
     return true;
   }
@@ -139,7 +141,7 @@ class BoxBuffer {
   bool ReadWriteString(std::string* str, size_t size) {
     if (reader_)
       return reader_->ReadToString(str, size);
-    DCHECK_EQ(str->size(), size);
+    HOT_DCHECK_EQ(str->size(), size);
     writer_->AppendArray(reinterpret_cast<const uint8_t*>(str->data()),
                          str->size());
     return true;
@@ -189,19 +191,18 @@ class BoxBuffer {
   bool IgnoreBytes(size_t num_bytes) {
     if (reader_)
       return reader_->SkipBytes(num_bytes);
-    std::vector<uint8_t> vector(num_bytes, 0);
-    writer_->AppendVector(vector);
+    writer_->Extend(num_bytes);
     return true;
   }
 
   /// @return A pointer to the inner reader object.
   BoxReader* reader() { return reader_; }
   /// @return A pointer to the inner writer object.
-  BufferWriter* writer() { return writer_; }
+  UncheckedBufferWriter* writer() { return writer_; }
 
  private:
   BoxReader* reader_;
-  BufferWriter* writer_;
+  UncheckedBufferWriter* writer_;
 
   DISALLOW_COPY_AND_ASSIGN(BoxBuffer);
 };
@@ -4,10 +4,12 @@
 
 #include "packager/media/formats/mp4/box_definitions.h"
 
+#include <algorithm>
 #include <limits>
 
 #include "packager/base/logging.h"
 #include "packager/media/base/bit_reader.h"
+#include "packager/media/base/buffer_writer.h"
 #include "packager/media/base/macros.h"
 #include "packager/media/base/rcheck.h"
 #include "packager/media/formats/mp4/box_buffer.h"
@@ -72,6 +74,23 @@ const uint32_t kID3v2HeaderSize = 10;
 const char kID3v2Identifier[] = "ID3";
 const uint16_t kID3v2Version = 0x0400;  // id3v2.4.0
 
+// Reads or writes a null-terminated string.
+bool ReadWriteCString(BoxBuffer* buffer, std::string* str) {
+  if (!buffer->Reading()) {
+    uint8_t terminator = 0;
+    return buffer->ReadWriteString(str, str->size()) &&
+           buffer->ReadWriteUInt8(&terminator);
+  }
+  str->clear();
+  uint8_t c;
+  while (true) {
+    RCHECK(buffer->ReadWriteUInt8(&c));
+    if (c == 0)
+      return true;
+    str->push_back(static_cast<char>(c));
+  }
+}
+
 // Utility functions to check if the 64bit integers can fit in 32bit integer.
 bool IsFitIn32Bits(uint64_t a) {
   return a <= std::numeric_limits<uint32_t>::max();
@@ -126,6 +145,56 @@ FourCC TrackTypeToFourCC(TrackType track_type) {
   }
 }
 
+// Store |value| in big endian at |out|, which is used to fill the sample
+// tables written in bulk.
+// @return The position following the stored value.
+uint8_t* StoreUInt16(uint16_t value, uint8_t* out) {
+  out[0] = value >> 8;
+  out[1] = value;
+  return out + sizeof(value);
+}
+
+uint8_t* StoreUInt32(uint32_t value, uint8_t* out) {
+  out[0] = value >> 24;
+  out[1] = value >> 16;
+  out[2] = value >> 8;
+  out[3] = value;
+  return out + sizeof(value);
+}
+
+// Write the entries of a 'senc' box in place instead of field by field: one
+// block for all the IVs without subsamples, or one block per entry otherwise.
+// @return true on success, false otherwise.
+bool WriteSampleEncryptionEntries(
+    const std::vector<SampleEncryptionEntry>& sample_encryption_entries,
+    size_t iv_size,
+    bool has_subsamples,
+    UncheckedBufferWriter* writer) {
+  if (!has_subsamples) {
+    uint8_t* out = writer->Extend(sample_encryption_entries.size() * iv_size);
+    for (const SampleEncryptionEntry& entry : sample_encryption_entries) {
+      DCHECK_EQ(iv_size, entry.initialization_vector.size());
+      out = std::copy(entry.initialization_vector.begin(),
+                      entry.initialization_vector.end(), out);
+    }
+    return true;
+  }
+
+  for (const SampleEncryptionEntry& entry : sample_encryption_entries) {
+    DCHECK_EQ(iv_size, entry.initialization_vector.size());
+    RCHECK(!entry.subsamples.empty());
+    uint8_t* out = writer->Extend(entry.ComputeSize());
+    out = std::copy(entry.initialization_vector.begin(),
+                    entry.initialization_vector.end(), out);
+    out = StoreUInt16(entry.subsamples.size(), out);
+    for (const SubsampleEntry& subsample : entry.subsamples) {
+      out = StoreUInt16(subsample.clear_bytes, out);
+      out = StoreUInt32(subsample.cipher_bytes, out);
+    }
+  }
+  return true;
+}
+
 }  // namespace
 
 FileType::FileType() : major_brand(FOURCC_NULL), minor_version(0) {}
@@ -323,6 +392,12 @@ bool SampleEncryption::ReadWriteInternal(BoxBuffer* buffer) {
   uint32_t sample_count = sample_encryption_entries.size();
   RCHECK(buffer->ReadWriteUInt32(&sample_count));
 
+  if (!buffer->Reading()) {
+    return WriteSampleEncryptionEntries(
+        sample_encryption_entries, iv_size,
+        (flags & kUseSubsampleEncryption) != 0, buffer->writer());
+  }
+
   sample_encryption_entries.resize(sample_count);
   for (auto& sample_encryption_entry : sample_encryption_entries) {
     RCHECK(sample_encryption_entry.ReadWrite(
@@ -617,6 +692,7 @@ bool SampleDescription::ReadWriteInternal(BoxBuffer* buffer) {
   if (buffer->Reading()) {
     BoxReader* reader = buffer->reader();
     DCHECK(reader);
+    serialized_entries_.clear();
     video_entries.clear();
     audio_entries.clear();
     // Note: this value is preset before scanning begins. See comments in the
@@ -631,6 +707,9 @@ bool SampleDescription::ReadWriteInternal(BoxBuffer* buffer) {
       RCHECK(reader->ReadAllChildren(&text_entries));
       RCHECK(text_entries.size() == count);
     }
+  } else if (!serialized_entries_.empty()) {
+    RCHECK(buffer->ReadWriteVector(&serialized_entries_,
+                                   serialized_entries_.size()));
   } else {
     DCHECK_LT(0u, count);
     if (type == kVideo) {
@@ -651,6 +730,8 @@ bool SampleDescription::ReadWriteInternal(BoxBuffer* buffer) {
 
 uint32_t SampleDescription::ComputeSizeInternal() {
   uint32_t box_size = HeaderSize() + sizeof(uint32_t);
+  if (!serialized_entries_.empty())
+    return box_size + serialized_entries_.size();
   if (type == kVideo) {
     for (uint32_t i = 0; i < video_entries.size(); ++i)
       box_size += video_entries[i].ComputeSize();
@@ -664,6 +745,22 @@ uint32_t SampleDescription::ComputeSizeInternal() {
   return box_size;
 }
 
+void SampleDescription::CacheSerializedEntries() {
+  serialized_entries_.clear();
+  BufferWriter writer;
+  if (type == kVideo) {
+    for (uint32_t i = 0; i < video_entries.size(); ++i)
+      video_entries[i].Write(&writer);
+  } else if (type == kAudio) {
+    for (uint32_t i = 0; i < audio_entries.size(); ++i)
+      audio_entries[i].Write(&writer);
+  } else if (type == kText) {
+    for (uint32_t i = 0; i < text_entries.size(); ++i)
+      text_entries[i].Write(&writer);
+  }
+  writer.SwapBuffer(&serialized_entries_);
+}
+
 DecodingTimeToSample::DecodingTimeToSample() {}
 DecodingTimeToSample::~DecodingTimeToSample() {}
 FourCC DecodingTimeToSample::BoxType() const { return FOURCC_stts; }
@@ -874,8 +971,8 @@ bool ChunkLargeOffset::ReadWriteInternal(BoxBuffer* buffer) {
     if (count == 0 || IsFitIn32Bits(offsets[count - 1])) {
       ChunkOffset stco;
       stco.offsets.swap(offsets);
-      DCHECK(buffer->writer());
-      stco.Write(buffer->writer());
+      stco.ComputeSize();
+      CHECK(buffer->ReadWriteChild(&stco));
       stco.offsets.swap(offsets);
       return true;
     }
@@ -1576,8 +1673,10 @@ bool ElementaryStreamDescriptor::ReadWriteInternal(BoxBuffer* buffer) {
           es_descriptor.decoder_specific_info()));
     }
   } else {
-    DCHECK(buffer->writer());
-    es_descriptor.Write(buffer->writer());
+    BufferWriter es_descriptor_writer(es_descriptor.ComputeSize());
+    es_descriptor.Write(&es_descriptor_writer);
+    buffer->writer()->AppendArray(es_descriptor_writer.Buffer(),
+                                  es_descriptor_writer.Size());
   }
   return true;
 }
@@ -2348,6 +2447,29 @@ bool TrackFragmentRun::ReadWriteInternal(BoxBuffer* buffer) {
       DCHECK(sample_composition_time_offsets.size() == sample_count);
   }
 
+  if (!buffer->Reading()) {
+    // Write the per-sample fields of all the samples in one block.
+    const size_t fields_size =
+        sizeof(uint32_t) *
+        (sample_duration_present + sample_size_present + sample_flags_present +
+         sample_composition_time_offsets_present);
+    uint8_t* out = buffer->writer()->Extend(fields_size * sample_count);
+    for (uint32_t i = 0; i < sample_count; ++i) {
+      if (sample_duration_present)
+        out = StoreUInt32(sample_durations[i], out);
+      if (sample_size_present)
+        out = StoreUInt32(sample_sizes[i], out);
+      if (sample_flags_present)
+        out = StoreUInt32(sample_flags[i], out);
+      // The signed offsets of version 1 have the same two's complement
+      // representation.
+      if (sample_composition_time_offsets_present)
+        out = StoreUInt32(
+            static_cast<uint32_t>(sample_composition_time_offsets[i]), out);
+    }
+    return true;
+  }
+
   for (uint32_t i = 0; i < sample_count; ++i) {
     if (sample_duration_present)
       RCHECK(buffer->ReadWriteUInt32(&sample_durations[i]));
@@ -2527,6 +2649,42 @@ uint32_t SegmentIndex::ComputeSizeInternal() {
          3 * sizeof(uint32_t) * references.size();
 }
 
+DASHEventMessageBox::DASHEventMessageBox()
+    : timescale(0), presentation_time(0), event_duration(0), id(0) {}
+DASHEventMessageBox::~DASHEventMessageBox() {}
+FourCC DASHEventMessageBox::BoxType() const { return FOURCC_emsg; }
+
+bool DASHEventMessageBox::ReadWriteInternal(BoxBuffer* buffer) {
+  RCHECK(ReadWriteHeaderInternal(buffer));
+  if (version == 1) {
+    RCHECK(buffer->ReadWriteUInt32(&timescale) &&
+           buffer->ReadWriteUInt64(&presentation_time) &&
+           buffer->ReadWriteUInt32(&event_duration) &&
+           buffer->ReadWriteUInt32(&id) &&
+           ReadWriteCString(buffer, &scheme_id_uri) &&
+           ReadWriteCString(buffer, &value));
+  } else {
+    RCHECK(ReadWriteCString(buffer, &scheme_id_uri) &&
+           ReadWriteCString(buffer, &value) &&
+           buffer->ReadWriteUInt32(&timescale) &&
+           buffer->ReadWriteUInt64NBytes(&presentation_time,
+                                         sizeof(uint32_t)) &&
+           buffer->ReadWriteUInt32(&event_duration) &&
+           buffer->ReadWriteUInt32(&id));
+  }
+  size_t message_data_size =
+      buffer->Reading() ? buffer->BytesLeft() : message_data.size();
+  return buffer->ReadWriteVector(&message_data, message_data_size);
+}
+
+uint32_t DASHEventMessageBox::ComputeSizeInternal() {
+  // The presentation time is always written, so version 1 is written.
+  version = 1;
+  return HeaderSize() + sizeof(timescale) + sizeof(presentation_time) +
+         sizeof(event_duration) + sizeof(id) + scheme_id_uri.size() + 1 +
+         value.size() + 1 + message_data.size();
+}
+
 MediaData::MediaData() : data_size(0) {}
 MediaData::~MediaData() {}
 FourCC MediaData::BoxType() const { return FOURCC_mdat; }
@@ -384,12 +384,22 @@ struct TextSampleEntry : Box {
 struct SampleDescription : FullBox {
   DECLARE_BOX_METHODS(SampleDescription);
 
+  /// Serialize the sample entries once, so that the next writes of the box
+  /// copy them instead of computing their sizes and serializing them again,
+  /// e.g. each time the init segment of a track is written. The entries must
+  /// not be modified afterwards, unless the box is parsed again.
+  void CacheSerializedEntries();
+
   TrackType type;
   // TODO(kqyang): Clean up the code to have one single member, e.g. by creating
   // SampleEntry struct, std::vector<SampleEntry> sample_entries.
   std::vector<VideoSampleEntry> video_entries;
   std::vector<AudioSampleEntry> audio_entries;
   std::vector<TextSampleEntry> text_entries;
+
+ private:
+  // The entries serialized by CacheSerializedEntries(), if called.
+  std::vector<uint8_t> serialized_entries_;
 };
 
 struct DecodingTime {
@@ -771,6 +781,20 @@ struct SegmentIndex : FullBox {
   std::vector<SegmentReference> references;
 };
 
+// ISO/IEC 23009-1 5.10.3.3 "Event message box". Version 1 carries the
+// presentation time of the event instead of its delta to the segment.
+struct DASHEventMessageBox : FullBox {
+  DECLARE_BOX_METHODS(DASHEventMessageBox);
+
+  std::string scheme_id_uri;
+  std::string value;
+  uint32_t timescale;
+  uint64_t presentation_time;
+  uint32_t event_duration;
+  uint32_t id;
+  std::vector<uint8_t> message_data;
+};
+
 // The actual data is parsed and written separately.
 struct MediaData : Box {
   DECLARE_BOX_METHODS(MediaData);
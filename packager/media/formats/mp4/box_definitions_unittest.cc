@@ -882,6 +882,23 @@ class BoxDefinitionsTestGeneral : public testing::Test {
     sidx->version = 1;
   }
 
+  void Fill(DASHEventMessageBox* emsg) {
+    emsg->scheme_id_uri = "urn:scte:scte35:2013:bin";
+    emsg->timescale = 90000;
+    emsg->presentation_time = 1234567;
+    emsg->event_duration = 2700000;
+    emsg->id = 42;
+    const uint8_t kMessageData[] = {0xfc, 0x30, 0x11, 0x00};
+    emsg->message_data.assign(kMessageData,
+                              kMessageData + arraysize(kMessageData));
+    emsg->version = 1;
+  }
+
+  void Modify(DASHEventMessageBox* emsg) {
+    emsg->value = "1";
+    emsg->presentation_time = 8589934592ULL;
+  }
+
   void Fill(CueSourceIDBox* vsid) {
     vsid->source_id = 5;
   }
@@ -1047,6 +1064,7 @@ typedef testing::Types<MediaHeader,
                        TrackFragment,
                        MovieFragment,
                        SegmentIndex,
+                       DASHEventMessageBox,
                        CueSourceIDBox,
                        CueTimeBox,
                        CueIDBox,
@@ -1299,6 +1317,53 @@ TEST_F(BoxDefinitionsTest, SampleEncryptionWithIvUnknownWhenReading) {
   ASSERT_EQ(senc.sample_encryption_entries, sample_encryption_entries);
 }
 
+TEST_F(BoxDefinitionsTest, WriteWithComputedSize) {
+  MovieFragment moof;
+  Fill(&moof.header);
+  moof.tracks.resize(1);
+  TrackFragment& traf = moof.tracks[0];
+  Fill(&traf.header);
+  traf.runs.resize(1);
+  Fill(&traf.runs[0]);
+  Fill(&traf.sample_encryption);
+  moof.ComputeSize();
+
+  // Update a field which does not change the size, as Segmenter does.
+  traf.runs[0].data_offset = 12345;
+  moof.WriteWithComputedSize(buffer_.get());
+  BufferWriter expected_buffer;
+  moof.Write(&expected_buffer);
+  ASSERT_EQ(expected_buffer.Size(), buffer_->Size());
+  EXPECT_EQ(0, memcmp(expected_buffer.Buffer(), buffer_->Buffer(),
+                      buffer_->Size()));
+
+  MovieFragment moof_readback;
+  ASSERT_TRUE(ReadBack(&moof_readback));
+  ASSERT_EQ(1u, moof_readback.tracks.size());
+  ASSERT_EQ(1u, moof_readback.tracks[0].runs.size());
+  EXPECT_EQ(12345u, moof_readback.tracks[0].runs[0].data_offset);
+  EXPECT_EQ(traf.runs[0], moof_readback.tracks[0].runs[0]);
+}
+
+TEST_F(BoxDefinitionsTest, SampleDescriptionCachedEntries) {
+  SampleDescription stsd;
+  Fill(&stsd);
+  BufferWriter expected_buffer;
+  stsd.Write(&expected_buffer);
+
+  stsd.CacheSerializedEntries();
+  const uint32_t cached_size = stsd.ComputeSize();
+  stsd.Write(buffer_.get());
+  ASSERT_EQ(expected_buffer.Size(), cached_size);
+  ASSERT_EQ(expected_buffer.Size(), buffer_->Size());
+  EXPECT_EQ(0, memcmp(expected_buffer.Buffer(), buffer_->Buffer(),
+                      buffer_->Size()));
+
+  SampleDescription stsd_readback;
+  ASSERT_TRUE(ReadBack(&stsd_readback));
+  ASSERT_EQ(stsd, stsd_readback);
+}
+
 }  // namespace mp4
 }  // namespace media
 }  // namespace edash_packager
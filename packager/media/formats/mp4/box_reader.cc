@@ -17,8 +17,20 @@ namespace edash_packager {
 namespace media {
 namespace mp4 {
 
+namespace {
+// Far deeper than the nesting of the boxes of valid files, but bounds the
+// recursion of the parsing.
+const int kMaxBoxDepth = 32;
+}  // namespace
+
 BoxReader::BoxReader(const uint8_t* buf, size_t size)
-    : BufferReader(buf, size), type_(FOURCC_NULL), scanned_(false) {
+    : BufferReader(buf, size),
+      type_(FOURCC_NULL),
+      root_(this),
+      depth_(0),
+      max_boxes_(0),
+      num_boxes_(0),
+      scanned_(false) {
   DCHECK(buf);
   DCHECK_LT(0u, size);
 }
@@ -111,6 +123,8 @@ bool BoxReader::ScanChildren() {
     if (!child->ReadHeader(&err))
       return false;
 
+    RCHECK(child->SetParent(this));
+
     FourCC box_type = child->type();
     size_t box_size = child->size();
     children_.insert(std::pair<FourCC, BoxReader*>(box_type, child.release()));
@@ -143,6 +157,23 @@ bool BoxReader::TryReadChild(Box* child) {
   return ReadChild(child);
 }
 
+bool BoxReader::SetParent(BoxReader* parent) {
+  root_ = parent->root_;
+  depth_ = parent->depth_ + 1;
+  if (depth_ > kMaxBoxDepth) {
+    LOG(ERROR) << "Box '" << FourCCToString(type_) << "' is nested deeper "
+               << "than " << kMaxBoxDepth << " levels.";
+    return false;
+  }
+  ++root_->num_boxes_;
+  if (root_->max_boxes_ > 0 && root_->num_boxes_ > root_->max_boxes_) {
+    LOG(ERROR) << "Box '" << FourCCToString(root_->type_) << "' has more "
+               << "than " << root_->max_boxes_ << " boxes.";
+    return false;
+  }
+  return true;
+}
+
 bool BoxReader::ReadHeader(bool* err) {
   uint64_t size = 0;
   *err = false;
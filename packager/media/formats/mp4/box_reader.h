@@ -60,6 +60,12 @@ class BoxReader : public BufferReader {
   /// This method is helpful for debugging misaligned appends.
   static bool IsValidTopLevelBox(const FourCC& type);
 
+  /// Limit the number of boxes nested in this top-level box, e.g. to guard
+  /// against pathological inputs. Must be called before its children are
+  /// read.
+  /// @param max_boxes is the maximum number of boxes, 0 for no limit.
+  void set_max_boxes(uint64_t max_boxes) { max_boxes_ = max_boxes; }
+
   /// Scan through all boxes within the current box, starting at the current
   /// buffer position. Must be called before any of the @b *Child functions
   /// work.
@@ -116,8 +122,23 @@ class BoxReader : public BufferReader {
   // true, the error is unrecoverable and the stream should be aborted.
   bool ReadHeader(bool* err);
 
+  // Must be called on the reader of a child box of |parent| after its header
+  // is read. Accounts the box in the limits of the top-level box. Returns
+  // false if the box is nested too deep or if the top-level box has too many
+  // boxes.
+  bool SetParent(BoxReader* parent);
+
   FourCC type_;
 
+  // The reader of the top-level box, this one for a top-level box, and the
+  // depth of the box, 0 for a top-level box.
+  BoxReader* root_;
+  int depth_;
+  // The limit and the number of the boxes nested in the top-level box. Only
+  // used in |root_|.
+  uint64_t max_boxes_;
+  uint64_t num_boxes_;
+
   typedef std::multimap<FourCC, BoxReader*> ChildMap;
 
   // The set of child box FourCCs and their corresponding buffer readers. Only
@@ -169,6 +190,7 @@ bool BoxReader::ReadAllChildren(std::vector<T>* children) {
     bool err;
     if (!child_reader.ReadHeader(&err))
       return false;
+    RCHECK(child_reader.SetParent(this));
 
     T child;
     RCHECK(child.Parse(&child_reader));
@@ -116,6 +116,24 @@ TEST_F(BoxReaderTest, ExpectedOperationTest) {
   EXPECT_EQ(buf.size(), static_cast<uint64_t>(reader->size() + 1));
 }
 
+TEST_F(BoxReaderTest, MaxBoxesTest) {
+  std::vector<uint8_t> buf = GetBuf();
+  bool err;
+  scoped_ptr<BoxReader> reader(
+      BoxReader::ReadTopLevelBox(&buf[0], buf.size(), &err));
+  ASSERT_TRUE(reader);
+  reader->set_max_boxes(3);
+  SkipBox box;
+  EXPECT_TRUE(box.Parse(reader.get()));
+
+  // One box too many.
+  reader.reset(BoxReader::ReadTopLevelBox(&buf[0], buf.size(), &err));
+  ASSERT_TRUE(reader);
+  reader->set_max_boxes(2);
+  SkipBox limited_box;
+  EXPECT_FALSE(limited_box.Parse(reader.get()));
+}
+
 TEST_F(BoxReaderTest, OuterTooShortTest) {
   std::vector<uint8_t> buf = GetBuf();
   bool err;
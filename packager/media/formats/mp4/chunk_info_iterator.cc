@@ -22,6 +22,18 @@ ChunkInfoIterator::ChunkInfoIterator(const SampleToChunk& sample_to_chunk)
       iterator_(chunk_info_table_.begin()) {
   if (iterator_ != chunk_info_table_.end())
     current_chunk_ = iterator_->first_chunk;
+
+  first_samples_.reserve(chunk_info_table_.size());
+  uint32_t first_sample = 1;
+  for (size_t i = 0; i < chunk_info_table_.size(); ++i) {
+    if (i > 0) {
+      const ChunkInfo& previous = chunk_info_table_[i - 1];
+      first_sample += (chunk_info_table_[i].first_chunk -
+                       previous.first_chunk) *
+                      previous.samples_per_chunk;
+    }
+    first_samples_.push_back(first_sample);
+  }
 }
 ChunkInfoIterator::~ChunkInfoIterator() {}
 
@@ -70,6 +82,28 @@ uint32_t ChunkInfoIterator::NumSamples(uint32_t start_chunk,
   return num_samples;
 }
 
+uint32_t ChunkInfoIterator::FindChunk(uint32_t sample,
+                                      uint32_t* first_sample_in_chunk) const {
+  DCHECK_GE(sample, 1u);
+  // The last entry starting at or before |sample|. The entries without
+  // samples start at the same sample as the next entry, so they are skipped.
+  std::vector<uint32_t>::const_iterator it =
+      std::upper_bound(first_samples_.begin(), first_samples_.end(), sample);
+  if (it == first_samples_.begin())
+    return 0;
+  const size_t entry = it - first_samples_.begin() - 1;
+  const ChunkInfo& chunk_info = chunk_info_table_[entry];
+  if (chunk_info.samples_per_chunk == 0)
+    return 0;
+  const uint32_t chunk_offset =
+      (sample - first_samples_[entry]) / chunk_info.samples_per_chunk;
+  if (first_sample_in_chunk) {
+    *first_sample_in_chunk = first_samples_[entry] +
+                             chunk_offset * chunk_info.samples_per_chunk;
+  }
+  return chunk_info.first_chunk + chunk_offset;
+}
+
 }  // namespace mp4
 }  // namespace media
 }  // namespace edash_packager
@@ -53,6 +53,14 @@ class ChunkInfoIterator {
   ///         inclusive.
   uint32_t NumSamples(uint32_t start_chunk, uint32_t end_chunk) const;
 
+  /// Find the chunk holding a sample. A binary search in the cumulative
+  /// sample counts of the entries of the table.
+  /// @param sample is the sample, 1-based.
+  /// @param[out] first_sample_in_chunk receives the first sample of the
+  ///             chunk, 1-based. Can be NULL.
+  /// @return The chunk, 1-based, or 0 if the table has no samples.
+  uint32_t FindChunk(uint32_t sample, uint32_t* first_sample_in_chunk) const;
+
   /// @return The last first_chunk in chunk_info_table.
   uint32_t LastFirstChunk() const {
     return chunk_info_table_.empty() ? 0
@@ -65,6 +73,9 @@ class ChunkInfoIterator {
   const std::vector<ChunkInfo>& chunk_info_table_;
   std::vector<ChunkInfo>::const_iterator iterator_;
 
+  // First sample, 1-based, of each entry of the table.
+  std::vector<uint32_t> first_samples_;
+
   DISALLOW_COPY_AND_ASSIGN(ChunkInfoIterator);
 };
 
@@ -109,6 +109,21 @@ TEST_F(ChunkInfoIteratorTest, AdvanceSample) {
   }
 }
 
+TEST_F(ChunkInfoIteratorTest, FindChunk) {
+  uint32_t sample = 1;
+  for (uint32_t chunk = 0; chunk < kNumChunks; ++chunk) {
+    const uint32_t first_sample = sample;
+    for (uint32_t i = 0; i < chunk_info_table_[chunk].samples_per_chunk;
+         ++i, ++sample) {
+      uint32_t first_sample_in_chunk = 0;
+      ASSERT_EQ(chunk + 1,
+                chunk_info_iterator_->FindChunk(sample,
+                                                &first_sample_in_chunk));
+      EXPECT_EQ(first_sample, first_sample_in_chunk);
+    }
+  }
+}
+
 }  // namespace mp4
 }  // namespace media
 }  // namespace edash_packager
@@ -6,6 +6,8 @@
 
 #include "packager/media/formats/mp4/composition_offset_iterator.h"
 
+#include <algorithm>
+
 #include "packager/base/logging.h"
 
 namespace edash_packager {
@@ -16,7 +18,14 @@ CompositionOffsetIterator::CompositionOffsetIterator(
     const CompositionTimeToSample& composition_time_to_sample)
     : sample_index_(0),
       composition_offset_table_(composition_time_to_sample.composition_offset),
-      iterator_(composition_offset_table_.begin()) {}
+      iterator_(composition_offset_table_.begin()),
+      num_samples_(0) {
+  first_samples_.reserve(composition_offset_table_.size());
+  for (const CompositionOffset& entry : composition_offset_table_) {
+    first_samples_.push_back(num_samples_ + 1);
+    num_samples_ += entry.sample_count;
+  }
+}
 CompositionOffsetIterator::~CompositionOffsetIterator() {}
 
 bool CompositionOffsetIterator::AdvanceSample() {
@@ -36,26 +45,16 @@ bool CompositionOffsetIterator::IsValid() const {
 }
 
 int64_t CompositionOffsetIterator::SampleOffset(uint32_t sample) const {
-  uint32_t current_sample = 0;
-  std::vector<CompositionOffset>::const_iterator it =
-      composition_offset_table_.begin();
-  for (; it != composition_offset_table_.end(); ++it) {
-    current_sample += it->sample_count;
-    if (current_sample >= sample)
-      return it->sample_offset;
-  }
-  DCHECK_LE(sample, current_sample) << " Sample is invalid";
-  return 0;
-}
-
-uint32_t CompositionOffsetIterator::NumSamples() const {
-  uint32_t num_samples = 0;
-  std::vector<CompositionOffset>::const_iterator it =
-      composition_offset_table_.begin();
-  for (; it != composition_offset_table_.end(); ++it) {
-    num_samples += it->sample_count;
+  if (sample == 0 || sample > num_samples_) {
+    NOTREACHED() << "Sample " << sample << " is invalid";
+    return 0;
   }
-  return num_samples;
+  // The last entry starting at or before |sample|. The entries without
+  // samples start at the same sample as the next entry, so they are skipped.
+  const size_t entry =
+      std::upper_bound(first_samples_.begin(), first_samples_.end(), sample) -
+      first_samples_.begin() - 1;
+  return composition_offset_table_[entry].sample_offset;
 }
 
 }  // namespace mp4
@@ -39,17 +39,22 @@ class CompositionOffsetIterator {
   /// @return Sample offset for current sample.
   int64_t sample_offset() const { return iterator_->sample_offset; }
 
-  /// @return Sample offset @a sample, 1-based.
+  /// @return Sample offset @a sample, 1-based. A binary search in the
+  ///         cumulative sample counts of the entries of the table.
   int64_t SampleOffset(uint32_t sample) const;
 
   /// @return Total number of samples.
-  uint32_t NumSamples() const;
+  uint32_t NumSamples() const { return num_samples_; }
 
  private:
   uint32_t sample_index_;
   const std::vector<CompositionOffset>& composition_offset_table_;
   std::vector<CompositionOffset>::const_iterator iterator_;
 
+  // First sample, 1-based, of each entry of the table.
+  std::vector<uint32_t> first_samples_;
+  uint32_t num_samples_;
+
   DISALLOW_COPY_AND_ASSIGN(CompositionOffsetIterator);
 };
 
@@ -18,7 +18,19 @@ DecodingTimeIterator::DecodingTimeIterator(
     const DecodingTimeToSample& decoding_time_to_sample)
     : sample_index_(0),
       decoding_time_table_(decoding_time_to_sample.decoding_time),
-      iterator_(decoding_time_table_.begin()) {}
+      iterator_(decoding_time_table_.begin()),
+      num_samples_(0),
+      total_duration_(0) {
+  first_samples_.reserve(decoding_time_table_.size());
+  first_decoding_times_.reserve(decoding_time_table_.size());
+  for (const DecodingTime& entry : decoding_time_table_) {
+    first_samples_.push_back(num_samples_ + 1);
+    first_decoding_times_.push_back(total_duration_);
+    num_samples_ += entry.sample_count;
+    total_duration_ +=
+        static_cast<uint64_t>(entry.sample_count) * entry.sample_delta;
+  }
+}
 DecodingTimeIterator::~DecodingTimeIterator() {}
 
 bool DecodingTimeIterator::AdvanceSample() {
@@ -40,31 +52,42 @@ bool DecodingTimeIterator::IsValid() const {
 uint64_t DecodingTimeIterator::Duration(uint32_t start_sample,
                                         uint32_t end_sample) const {
   DCHECK_LE(start_sample, end_sample);
-  uint32_t current_sample = 0;
-  uint32_t prev_sample = 0;
-  uint64_t duration = 0;
-  std::vector<DecodingTime>::const_iterator it = decoding_time_table_.begin();
-  for (; it != decoding_time_table_.end(); ++it) {
-    current_sample += it->sample_count;
-    if (current_sample >= start_sample) {
-      duration += (std::min(end_sample, current_sample) -
-                   std::max(start_sample, prev_sample + 1) + 1) *
-                  it->sample_delta;
-      if (current_sample >= end_sample)
-        break;
-    }
-    prev_sample = current_sample;
-  }
-  return duration;
+  // The samples past the end of the table have no duration.
+  start_sample = std::max(start_sample, 1u);
+  end_sample = std::min(end_sample, num_samples_);
+  if (start_sample > end_sample)
+    return 0;
+  return SampleDecodingTime(end_sample + 1) - SampleDecodingTime(start_sample);
 }
 
-uint32_t DecodingTimeIterator::NumSamples() const {
-  uint32_t num_samples = 0;
-  std::vector<DecodingTime>::const_iterator it = decoding_time_table_.begin();
-  for (; it != decoding_time_table_.end(); ++it) {
-    num_samples += it->sample_count;
-  }
-  return num_samples;
+uint64_t DecodingTimeIterator::SampleDecodingTime(uint32_t sample) const {
+  DCHECK_GE(sample, 1u);
+  DCHECK_LE(sample, num_samples_ + 1);
+  // The last entry starting at or before |sample|. The entries without
+  // samples start at the same sample as the next entry, so they are skipped.
+  std::vector<uint32_t>::const_iterator it =
+      std::upper_bound(first_samples_.begin(), first_samples_.end(), sample);
+  if (it == first_samples_.begin())
+    return 0;
+  const size_t entry = it - first_samples_.begin() - 1;
+  return first_decoding_times_[entry] +
+         static_cast<uint64_t>(sample - first_samples_[entry]) *
+             decoding_time_table_[entry].sample_delta;
+}
+
+uint32_t DecodingTimeIterator::FindSample(uint64_t decoding_time) const {
+  if (decoding_time >= total_duration_)
+    return 0;
+  // The last entry starting at or before |decoding_time|. The entries without
+  // duration start at the same time as the next entry, so they are skipped.
+  const size_t entry =
+      std::upper_bound(first_decoding_times_.begin(),
+                       first_decoding_times_.end(), decoding_time) -
+      first_decoding_times_.begin() - 1;
+  const uint32_t sample_delta = decoding_time_table_[entry].sample_delta;
+  DCHECK_GT(sample_delta, 0u);
+  return first_samples_[entry] +
+         (decoding_time - first_decoding_times_[entry]) / sample_delta;
 }
 
 }  // namespace mp4
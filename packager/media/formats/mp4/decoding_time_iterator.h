@@ -20,7 +20,10 @@ namespace mp4 {
 
 /// Decoding time to sample box (STTS) iterator used to iterate through the
 /// compressed table. This class also provides convenient functions to query
-/// total number of samples and the duration from start_sample to end_sample.
+/// total number of samples and the duration from start_sample to end_sample,
+/// and to look samples up by decoding time. The lookups are binary searches
+/// in the cumulative sample counts and durations of the entries of the
+/// table, computed on construction.
 class DecodingTimeIterator {
  public:
   /// Create DecodingTimeIterator from decoding time to sample box.
@@ -42,14 +45,30 @@ class DecodingTimeIterator {
   /// @return Duration from start_sample to end_sample, both 1-based, inclusive.
   uint64_t Duration(uint32_t start_sample, uint32_t end_sample) const;
 
+  /// @return Decoding time of @a sample, 1-based, i.e. the duration of the
+  ///         samples before it. @a sample can be one past the last sample,
+  ///         which gives the total duration.
+  uint64_t SampleDecodingTime(uint32_t sample) const;
+
+  /// @return The sample, 1-based, decoded at @a decoding_time, i.e. the last
+  ///         sample whose decoding time is not after @a decoding_time, or 0
+  ///         if @a decoding_time is past the end of the last sample.
+  uint32_t FindSample(uint64_t decoding_time) const;
+
   /// @return Total number of samples in the table.
-  uint32_t NumSamples() const;
+  uint32_t NumSamples() const { return num_samples_; }
 
  private:
   uint32_t sample_index_;
   const std::vector<DecodingTime>& decoding_time_table_;
   std::vector<DecodingTime>::const_iterator iterator_;
 
+  // First sample, 1-based, and decoding time of each entry of the table.
+  std::vector<uint32_t> first_samples_;
+  std::vector<uint64_t> first_decoding_times_;
+  uint32_t num_samples_;
+  uint64_t total_duration_;
+
   DISALLOW_COPY_AND_ASSIGN(DecodingTimeIterator);
 };
 
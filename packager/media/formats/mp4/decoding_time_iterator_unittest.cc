@@ -77,6 +77,25 @@ TEST_F(DecodingTimeIteratorTest, Duration) {
   }
 }
 
+TEST_F(DecodingTimeIteratorTest, SampleDecodingTime) {
+  EXPECT_EQ(0u, decoding_time_iterator_->SampleDecodingTime(1));
+  for (uint32_t i = 0; i < decoding_time_table_.size(); ++i) {
+    ASSERT_EQ(decoding_time_table_[i],
+              decoding_time_iterator_->SampleDecodingTime(i + 2));
+  }
+}
+
+TEST_F(DecodingTimeIteratorTest, FindSample) {
+  uint32_t sample = 1;
+  for (uint32_t time = 0; time < decoding_time_table_.back(); ++time) {
+    if (time >= decoding_time_table_[sample - 1])
+      ++sample;
+    ASSERT_EQ(sample, decoding_time_iterator_->FindSample(time));
+  }
+  EXPECT_EQ(0u,
+            decoding_time_iterator_->FindSample(decoding_time_table_.back()));
+}
+
 }  // namespace mp4
 }  // namespace media
 }  // namespace edash_packager
@@ -6,13 +6,22 @@
 
 #include "packager/media/formats/mp4/encrypting_fragmenter.h"
 
+#include <string.h>
+
+#include <algorithm>
 #include <limits>
 
-#include "packager/media/base/aes_encryptor.h"
-#include "packager/media/base/aes_pattern_cryptor.h"
+#include "packager/base/bind.h"
+#include "packager/media/base/aes_decryptor.h"
 #include "packager/media/base/buffer_reader.h"
+#include "packager/media/base/buffer_writer.h"
+#include "packager/media/base/crypto_context_cache.h"
+#include "packager/media/base/decrypt_config.h"
+#include "packager/media/base/decryptor_source.h"
 #include "packager/media/base/key_source.h"
 #include "packager/media/base/media_sample.h"
+#include "packager/media/base/pipeline_metrics.h"
+#include "packager/media/base/thread_pool.h"
 #include "packager/media/filters/nalu_reader.h"
 #include "packager/media/filters/vp8_parser.h"
 #include "packager/media/filters/vp9_parser.h"
@@ -24,6 +33,8 @@ namespace mp4 {
 
 namespace {
 const size_t kCencBlockSize = 16u;
+// Size of the keystream buffer used to re-key the data in a single pass.
+const size_t kRekeyChunkSize = 1024u;
 
 // Adds one or more subsamples to |*subsamples|.  This may add more than one
 // if one of the values overflows the integer in the subsample.
@@ -41,6 +52,26 @@ void AddSubsamples(uint64_t clear_bytes,
     subsamples->push_back(SubsampleEntry(clear_bytes, cipher_bytes));
 }
 
+// Re-keys |size| bytes of |data| in place, from the keystream of |decryptor| to
+// the keystream of |encryptor|. Both keystreams are XORed together in a small
+// buffer first, so |data| is read and written only once.
+void RekeyBytes(AesCryptor* decryptor,
+                AesCryptor* encryptor,
+                uint8_t* data,
+                size_t size) {
+  uint8_t keystream[kRekeyChunkSize];
+  while (size > 0) {
+    const size_t chunk_size = std::min(size, kRekeyChunkSize);
+    memset(keystream, 0, chunk_size);
+    CHECK(decryptor->Crypt(keystream, chunk_size, keystream));
+    CHECK(encryptor->Crypt(keystream, chunk_size, keystream));
+    for (size_t i = 0; i < chunk_size; ++i)
+      data[i] ^= keystream[i];
+    data += chunk_size;
+    size -= chunk_size;
+  }
+}
+
 VideoCodec GetVideoCodec(const StreamInfo& stream_info) {
   if (stream_info.stream_type() != kStreamVideo)
     return kUnknownVideoCodec;
@@ -66,7 +97,8 @@ EncryptingFragmenter::EncryptingFragmenter(
     int64_t clear_time,
     FourCC protection_scheme,
     uint8_t crypt_byte_block,
-    uint8_t skip_byte_block)
+    uint8_t skip_byte_block,
+    CryptoContextCache* crypto_context_cache)
     : Fragmenter(info, traf),
       info_(info),
       encryption_key_(encryption_key.Pass()),
@@ -75,8 +107,10 @@ EncryptingFragmenter::EncryptingFragmenter(
       clear_time_(clear_time),
       protection_scheme_(protection_scheme),
       crypt_byte_block_(crypt_byte_block),
-      skip_byte_block_(skip_byte_block) {
+      skip_byte_block_(skip_byte_block),
+      crypto_context_cache_(crypto_context_cache) {
   DCHECK(encryption_key_);
+  DCHECK(crypto_context_cache_);
   switch (video_codec_) {
     case kCodecVP8:
       vpx_parser_.reset(new VP8Parser);
@@ -102,6 +136,18 @@ EncryptingFragmenter::EncryptingFragmenter(
 
 EncryptingFragmenter::~EncryptingFragmenter() {}
 
+EncryptingFragmenter::PendingSample::PendingSample() : data(NULL) {}
+EncryptingFragmenter::PendingSample::~PendingSample() {}
+
+void EncryptingFragmenter::EnableParallelEncryption(size_t num_threads) {
+  DCHECK(!encryption_thread_pool_);
+  if (num_threads <= 1)
+    return;
+  encryption_thread_pool_.reset(new ThreadPool("EncryptionWorker",
+                                               num_threads));
+  encryption_thread_pool_->Start();
+}
+
 Status EncryptingFragmenter::AddSample(scoped_refptr<MediaSample> sample) {
   DCHECK(sample);
   if (!fragment_initialized()) {
@@ -110,6 +156,8 @@ Status EncryptingFragmenter::AddSample(scoped_refptr<MediaSample> sample) {
       return status;
   }
   if (encryptor_) {
+    ScopedStageTimer encrypt_timer(kEncryptStage);
+    encrypt_timer.AddBytes(sample->data_size());
     Status status = EncryptSample(sample);
     if (!status.ok())
       return status;
@@ -150,6 +198,10 @@ Status EncryptingFragmenter::InitializeFragment(int64_t first_sample_dts) {
 void EncryptingFragmenter::FinalizeFragment() {
   if (encryptor_) {
     DCHECK_LE(clear_time_, 0);
+    if (!pending_samples_.empty()) {
+      ScopedStageTimer encrypt_timer(kEncryptStage);
+      EncryptPendingSamples();
+    }
     FinalizeFragmentForEncryption();
   } else {
     DCHECK_GT(clear_time_, 0);
@@ -192,42 +244,29 @@ void EncryptingFragmenter::FinalizeFragmentForEncryption() {
 }
 
 Status EncryptingFragmenter::CreateEncryptor() {
-  DCHECK(encryption_key_);
   scoped_ptr<AesCryptor> encryptor;
-  switch (protection_scheme_) {
-    case FOURCC_cenc:
-      encryptor.reset(new AesCtrEncryptor);
-      break;
-    case FOURCC_cbc1:
-      encryptor.reset(new AesCbcEncryptor(kNoPadding));
-      break;
-    case FOURCC_cens:
-      encryptor.reset(new AesPatternCryptor(
-          crypt_byte_block(), skip_byte_block(),
-          AesPatternCryptor::kEncryptIfCryptByteBlockRemaining,
-          AesCryptor::kDontUseConstantIv,
-          scoped_ptr<AesCryptor>(new AesCtrEncryptor())));
-      break;
-    case FOURCC_cbcs:
-      encryptor.reset(new AesPatternCryptor(
-          crypt_byte_block(), skip_byte_block(),
-          AesPatternCryptor::kEncryptIfCryptByteBlockRemaining,
-          AesCryptor::kUseConstantIv,
-          scoped_ptr<AesCryptor>(new AesCbcEncryptor(kNoPadding))));
-      break;
-    default:
-      return Status(error::MUXER_FAILURE, "Unsupported protection scheme.");
-  }
-
-  DCHECK(!encryption_key_->iv.empty());
-  const bool initialized =
-      encryptor->InitializeWithIv(encryption_key_->key, encryption_key_->iv);
-  if (!initialized)
-    return Status(error::MUXER_FAILURE, "Failed to create the encryptor.");
+  Status status = CreateCryptor(&encryptor);
+  if (!status.ok())
+    return status;
   encryptor_ = encryptor.Pass();
   return Status::OK;
 }
 
+Status EncryptingFragmenter::CreateCryptor(
+    scoped_ptr<AesCryptor>* cryptor) const {
+  DCHECK(encryption_key_);
+  return CreateCryptorForKey(*encryption_key_, cryptor);
+}
+
+Status EncryptingFragmenter::CreateCryptorForKey(
+    const EncryptionKey& encryption_key,
+    scoped_ptr<AesCryptor>* cryptor) const {
+  DCHECK(cryptor);
+  return crypto_context_cache_->CreateEncryptor(
+      encryption_key, protection_scheme_, crypt_byte_block_, skip_byte_block_,
+      cryptor);
+}
+
 void EncryptingFragmenter::EncryptBytes(uint8_t* data, uint32_t size) {
   DCHECK(encryptor_);
   CHECK(encryptor_->Crypt(data, size, data));
@@ -240,110 +279,283 @@ Status EncryptingFragmenter::EncryptSample(scoped_refptr<MediaSample> sample) {
   // For 'cbcs' scheme, Constant IVs SHALL be used.
   if (protection_scheme_ != FOURCC_cbcs)
     sample_encryption_entry.initialization_vector = encryptor_->iv();
-  uint8_t* data = sample->writable_data();
+  // Ranges of the sample to be encrypted, relative to the start of the sample.
+  // The vector is kept across samples to reuse its storage.
+  std::vector<CryptRange>& crypt_ranges = crypt_ranges_;
+  crypt_ranges.clear();
+
+  // Data still encrypted with 'cenc' is re-keyed in a single pass if it is
+  // re-encrypted with 'cenc' in the same ranges. The layout is computed from
+  // the clear bytes of the encrypted data first, and computed again from the
+  // decrypted data if it does not match.
+  const DecryptConfig* decrypt_config = sample->pending_decrypt_config();
+  bool rekey = decrypt_config &&
+               decrypt_config->protection_scheme() == FOURCC_cenc &&
+               protection_scheme_ == FOURCC_cenc;
+  if (rekey) {
+    rekey = ComputeCryptLayout(*sample, &sample_encryption_entry.subsamples,
+                               &crypt_ranges).ok() &&
+            IsSameCryptLayout(*decrypt_config, sample->data_size(),
+                              crypt_ranges);
+    if (!rekey) {
+      sample_encryption_entry.subsamples.clear();
+      crypt_ranges.clear();
+    }
+  }
+  if (!rekey) {
+    if (decrypt_config && !DecryptorSource::DecryptPendingSample(sample.get()))
+      return Status(error::MUXER_FAILURE, "Failed to decrypt the sample.");
+    Status status = ComputeCryptLayout(
+        *sample, &sample_encryption_entry.subsamples, &crypt_ranges);
+    if (!status.ok())
+      return status;
+  }
+
   if (IsSubsampleEncryptionRequired()) {
-    if (vpx_parser_) {
-      std::vector<VPxFrameInfo> vpx_frames;
-      if (!vpx_parser_->Parse(sample->data(), sample->data_size(),
-                              &vpx_frames)) {
-        return Status(error::MUXER_FAILURE, "Failed to parse vpx frame.");
+    // The length of per-sample auxiliary datum, defined in CENC ch. 7.
+    traf()->auxiliary_size.sample_info_sizes.push_back(
+        sample_encryption_entry.ComputeSize());
+  }
+
+  if (encryption_thread_pool_) {
+    // The sample is encrypted in place when the fragment is finalized, and is
+    // kept alive by the fragment until then. Its data is made writable now,
+    // before it is handed to the encryption threads.
+    pending_samples_.resize(pending_samples_.size() + 1);
+    PendingSample& pending_sample = pending_samples_.back();
+    pending_sample.iv = encryptor_->iv();
+    pending_sample.data = sample->writable_data();
+    pending_sample.crypt_ranges.swap(crypt_ranges);
+    if (rekey) {
+      pending_sample.decryption_key = sample->pending_decryption_key();
+      pending_sample.decryption_iv = decrypt_config->iv();
+    }
+    for (const CryptRange& range : pending_sample.crypt_ranges)
+      encryptor_->AddNumCryptBytes(range.size);
+  } else if (rekey) {
+    AesCtrDecryptor decryptor;
+    if (!decryptor.InitializeWithIv(sample->pending_decryption_key(),
+                                    decrypt_config->iv())) {
+      return Status(error::MUXER_FAILURE, "Failed to create the decryptor.");
+    }
+    uint8_t* writable_data = sample->writable_data();
+    for (const CryptRange& range : crypt_ranges) {
+      RekeyBytes(&decryptor, encryptor_.get(), writable_data + range.offset,
+                 range.size);
+    }
+  } else {
+    uint8_t* writable_data = sample->writable_data();
+    for (const CryptRange& range : crypt_ranges)
+      EncryptBytes(writable_data + range.offset, range.size);
+  }
+  if (rekey)
+    sample->clear_pending_decryption();
+
+  // The entry is moved, not copied, into the fragment.
+  std::vector<SampleEncryptionEntry>& entries =
+      traf()->sample_encryption.sample_encryption_entries;
+  entries.resize(entries.size() + 1);
+  entries.back().initialization_vector.swap(
+      sample_encryption_entry.initialization_vector);
+  entries.back().subsamples.swap(sample_encryption_entry.subsamples);
+  encryptor_->UpdateIv();
+  return Status::OK;
+}
+
+Status EncryptingFragmenter::ComputeCryptLayout(
+    const MediaSample& sample,
+    std::vector<SubsampleEntry>* subsamples,
+    std::vector<CryptRange>* crypt_ranges) {
+  DCHECK(subsamples);
+  DCHECK(crypt_ranges);
+  if (!IsSubsampleEncryptionRequired()) {
+    crypt_ranges->push_back({0, sample.data_size()});
+    return Status::OK;
+  }
+
+  const uint8_t* sample_data = sample.data();
+  if (vpx_parser_) {
+    if (!vpx_parser_->Parse(sample_data, sample.data_size(), &vpx_frames_)) {
+      return Status(error::MUXER_FAILURE, "Failed to parse vpx frame.");
+    }
+
+    const bool is_superframe = vpx_frames_.size() > 1;
+    subsamples->reserve(subsamples->size() + vpx_frames_.size());
+    size_t frame_offset = 0;
+    for (const VPxFrameInfo& frame : vpx_frames_) {
+      SubsampleEntry subsample;
+      subsample.clear_bytes = frame.uncompressed_header_size;
+      subsample.cipher_bytes =
+          frame.frame_size - frame.uncompressed_header_size;
+
+      // "VP Codec ISO Media File Format Binding" document requires that the
+      // encrypted bytes of each frame within the superframe must be block
+      // aligned so that the counter state can be computed for each frame
+      // within the superframe.
+      // ISO/IEC 23001-7:2016 10.2 'cbc1' 10.3 'cens'
+      // The BytesOfProtectedData size SHALL be a multiple of 16 bytes to
+      // avoid partial blocks in Subsamples.
+      if (is_superframe || protection_scheme_ == FOURCC_cbc1 ||
+          protection_scheme_ == FOURCC_cens) {
+        const uint16_t misalign_bytes = subsample.cipher_bytes % kCencBlockSize;
+        subsample.clear_bytes += misalign_bytes;
+        subsample.cipher_bytes -= misalign_bytes;
       }
 
-      const bool is_superframe = vpx_frames.size() > 1;
-      for (const VPxFrameInfo& frame : vpx_frames) {
-        SubsampleEntry subsample;
-        subsample.clear_bytes = frame.uncompressed_header_size;
-        subsample.cipher_bytes =
-            frame.frame_size - frame.uncompressed_header_size;
-
-        // "VP Codec ISO Media File Format Binding" document requires that the
-        // encrypted bytes of each frame within the superframe must be block
-        // aligned so that the counter state can be computed for each frame
-        // within the superframe.
+      subsamples->push_back(subsample);
+      if (subsample.cipher_bytes > 0) {
+        crypt_ranges->push_back(
+            {frame_offset + subsample.clear_bytes, subsample.cipher_bytes});
+      }
+      frame_offset += frame.frame_size;
+    }
+  } else {
+    const Nalu::CodecType nalu_type =
+        (video_codec_ == kCodecHVC1 || video_codec_ == kCodecHEV1)
+            ? Nalu::kH265
+            : Nalu::kH264;
+    NaluReader reader(nalu_type, nalu_length_size_, sample_data,
+                      sample.data_size());
+
+    // Store the current length of clear data.  This is used to squash
+    // multiple unencrypted NAL units into fewer subsample entries.
+    uint64_t accumulated_clear_bytes = 0;
+
+    Nalu nalu;
+    NaluReader::Result result;
+    while ((result = reader.Advance(&nalu)) == NaluReader::kOk) {
+      if (nalu.is_video_slice()) {
+        // For video-slice NAL units, encrypt the video slice.  This skips
+        // the frame header.  If this is an unrecognized codec (e.g. H.265),
+        // the whole NAL unit will be encrypted.
+        const int64_t video_slice_header_size =
+            header_parser_ ? header_parser_->GetHeaderSize(nalu) : 0;
+        if (video_slice_header_size < 0)
+          return Status(error::MUXER_FAILURE, "Failed to read slice header.");
+
+        uint64_t current_clear_bytes =
+            nalu.header_size() + video_slice_header_size;
+        uint64_t cipher_bytes = nalu.payload_size() - video_slice_header_size;
+
         // ISO/IEC 23001-7:2016 10.2 'cbc1' 10.3 'cens'
         // The BytesOfProtectedData size SHALL be a multiple of 16 bytes to
         // avoid partial blocks in Subsamples.
-        if (is_superframe || protection_scheme_ == FOURCC_cbc1 ||
+        if (protection_scheme_ == FOURCC_cbc1 ||
             protection_scheme_ == FOURCC_cens) {
-          const uint16_t misalign_bytes =
-              subsample.cipher_bytes % kCencBlockSize;
-          subsample.clear_bytes += misalign_bytes;
-          subsample.cipher_bytes -= misalign_bytes;
+          const uint16_t misalign_bytes = cipher_bytes % kCencBlockSize;
+          current_clear_bytes += misalign_bytes;
+          cipher_bytes -= misalign_bytes;
         }
 
-        sample_encryption_entry.subsamples.push_back(subsample);
-        if (subsample.cipher_bytes > 0)
-          EncryptBytes(data + subsample.clear_bytes, subsample.cipher_bytes);
-        data += frame.frame_size;
-      }
-    } else {
-      const Nalu::CodecType nalu_type =
-          (video_codec_ == kCodecHVC1 || video_codec_ == kCodecHEV1)
-              ? Nalu::kH265
-              : Nalu::kH264;
-      NaluReader reader(nalu_type, nalu_length_size_, data,
-                        sample->data_size());
-
-      // Store the current length of clear data.  This is used to squash
-      // multiple unencrypted NAL units into fewer subsample entries.
-      uint64_t accumulated_clear_bytes = 0;
-
-      Nalu nalu;
-      NaluReader::Result result;
-      while ((result = reader.Advance(&nalu)) == NaluReader::kOk) {
-        if (nalu.is_video_slice()) {
-          // For video-slice NAL units, encrypt the video slice.  This skips
-          // the frame header.  If this is an unrecognized codec (e.g. H.265),
-          // the whole NAL unit will be encrypted.
-          const int64_t video_slice_header_size =
-              header_parser_ ? header_parser_->GetHeaderSize(nalu) : 0;
-          if (video_slice_header_size < 0)
-            return Status(error::MUXER_FAILURE, "Failed to read slice header.");
-
-          uint64_t current_clear_bytes =
-              nalu.header_size() + video_slice_header_size;
-          uint64_t cipher_bytes = nalu.payload_size() - video_slice_header_size;
-
-          // ISO/IEC 23001-7:2016 10.2 'cbc1' 10.3 'cens'
-          // The BytesOfProtectedData size SHALL be a multiple of 16 bytes to
-          // avoid partial blocks in Subsamples.
-          if (protection_scheme_ == FOURCC_cbc1 ||
-              protection_scheme_ == FOURCC_cens) {
-            const uint16_t misalign_bytes = cipher_bytes % kCencBlockSize;
-            current_clear_bytes += misalign_bytes;
-            cipher_bytes -= misalign_bytes;
-          }
-
-          const uint8_t* nalu_data = nalu.data() + current_clear_bytes;
-          EncryptBytes(const_cast<uint8_t*>(nalu_data), cipher_bytes);
-
-          AddSubsamples(
-              accumulated_clear_bytes + nalu_length_size_ + current_clear_bytes,
-              cipher_bytes, &sample_encryption_entry.subsamples);
-          accumulated_clear_bytes = 0;
-        } else {
-          // For non-video-slice NAL units, don't encrypt.
-          accumulated_clear_bytes +=
-              nalu_length_size_ + nalu.header_size() + nalu.payload_size();
-        }
+        const uint8_t* nalu_data = nalu.data() + current_clear_bytes;
+        crypt_ranges->push_back({static_cast<size_t>(nalu_data - sample_data),
+                                 static_cast<size_t>(cipher_bytes)});
+
+        AddSubsamples(
+            accumulated_clear_bytes + nalu_length_size_ + current_clear_bytes,
+            cipher_bytes, subsamples);
+        accumulated_clear_bytes = 0;
+      } else {
+        // For non-video-slice NAL units, don't encrypt.
+        accumulated_clear_bytes +=
+            nalu_length_size_ + nalu.header_size() + nalu.payload_size();
       }
-      if (result != NaluReader::kEOStream)
-        return Status(error::MUXER_FAILURE, "Failed to parse NAL units.");
-      AddSubsamples(accumulated_clear_bytes, 0,
-                    &sample_encryption_entry.subsamples);
     }
+    if (result != NaluReader::kEOStream)
+      return Status(error::MUXER_FAILURE, "Failed to parse NAL units.");
+    AddSubsamples(accumulated_clear_bytes, 0, subsamples);
+  }
 
-    // The length of per-sample auxiliary datum, defined in CENC ch. 7.
-    traf()->auxiliary_size.sample_info_sizes.push_back(
-        sample_encryption_entry.ComputeSize());
+  return Status::OK;
+}
+
+// static
+bool EncryptingFragmenter::IsSameCryptLayout(
+    const DecryptConfig& decrypt_config,
+    size_t sample_size,
+    const std::vector<CryptRange>& crypt_ranges) {
+  std::vector<CryptRange> decrypt_ranges;
+  if (decrypt_config.subsamples().empty()) {
+    decrypt_ranges.push_back({0, sample_size});
   } else {
-    EncryptBytes(data, sample->data_size());
+    size_t offset = 0;
+    for (const SubsampleEntry& subsample : decrypt_config.subsamples()) {
+      offset += subsample.clear_bytes;
+      if (subsample.cipher_bytes > 0)
+        decrypt_ranges.push_back({offset, subsample.cipher_bytes});
+      offset += subsample.cipher_bytes;
+    }
+  }
+  // The keystream only depends on the number of bytes crypted before, so
+  // adjacent ranges are equivalent to a single range.
+  std::vector<CryptRange> merged_ranges[2];
+  const std::vector<CryptRange>* ranges[] = {&decrypt_ranges, &crypt_ranges};
+  for (size_t i = 0; i < arraysize(ranges); ++i) {
+    for (const CryptRange& range : *ranges[i]) {
+      if (range.size == 0)
+        continue;
+      std::vector<CryptRange>& merged = merged_ranges[i];
+      if (!merged.empty() &&
+          merged.back().offset + merged.back().size == range.offset) {
+        merged.back().size += range.size;
+      } else {
+        merged.push_back(range);
+      }
+    }
   }
+  if (merged_ranges[0].size() != merged_ranges[1].size())
+    return false;
+  for (size_t i = 0; i < merged_ranges[0].size(); ++i) {
+    if (merged_ranges[0][i].offset != merged_ranges[1][i].offset ||
+        merged_ranges[0][i].size != merged_ranges[1][i].size) {
+      return false;
+    }
+  }
+  return true;
+}
 
-  traf()->sample_encryption.sample_encryption_entries.push_back(
-      sample_encryption_entry);
-  encryptor_->UpdateIv();
-  return Status::OK;
+void EncryptingFragmenter::EncryptPendingSamples() {
+  DCHECK(encryption_thread_pool_);
+  // Split the samples in contiguous ranges, one per thread. Every sample starts
+  // from its own IV, so the ranges are independent.
+  const size_t num_samples = pending_samples_.size();
+  const size_t num_tasks =
+      std::min(num_samples, encryption_thread_pool_->num_threads());
+  std::vector<base::Closure> tasks;
+  for (size_t i = 0; i < num_tasks; ++i) {
+    tasks.push_back(base::Bind(&EncryptingFragmenter::EncryptPendingSampleRange,
+                               base::Unretained(this),
+                               num_samples * i / num_tasks,
+                               num_samples * (i + 1) / num_tasks));
+  }
+  encryption_thread_pool_->RunTasksAndWait(tasks);
+  pending_samples_.clear();
+}
+
+void EncryptingFragmenter::EncryptPendingSampleRange(size_t begin,
+                                                     size_t end) {
+  scoped_ptr<AesCryptor> cryptor;
+  Status status = CreateCryptor(&cryptor);
+  CHECK(status.ok()) << status.ToString();
+
+  for (size_t i = begin; i < end; ++i) {
+    const PendingSample& pending_sample = pending_samples_[i];
+    CHECK(cryptor->SetIv(pending_sample.iv));
+    if (!pending_sample.decryption_key.empty()) {
+      AesCtrDecryptor decryptor;
+      CHECK(decryptor.InitializeWithIv(pending_sample.decryption_key,
+                                       pending_sample.decryption_iv));
+      for (const CryptRange& range : pending_sample.crypt_ranges) {
+        RekeyBytes(&decryptor, cryptor.get(),
+                   pending_sample.data + range.offset, range.size);
+      }
+      continue;
+    }
+    for (const CryptRange& range : pending_sample.crypt_ranges) {
+      uint8_t* range_data = pending_sample.data + range.offset;
+      CHECK(cryptor->Crypt(range_data, range.size, range_data));
+    }
+  }
 }
 
 bool EncryptingFragmenter::IsSubsampleEncryptionRequired() {
@@ -7,6 +7,8 @@
 #ifndef MEDIA_FORMATS_MP4_ENCRYPTING_FRAGMENTER_H_
 #define MEDIA_FORMATS_MP4_ENCRYPTING_FRAGMENTER_H_
 
+#include <vector>
+
 #include "packager/base/memory/ref_counted.h"
 #include "packager/base/memory/scoped_ptr.h"
 #include "packager/media/base/fourccs.h"
@@ -18,8 +20,12 @@ namespace edash_packager {
 namespace media {
 
 class AesCryptor;
+class CryptoContextCache;
+class DecryptConfig;
 class StreamInfo;
+class ThreadPool;
 struct EncryptionKey;
+struct SubsampleEntry;
 
 namespace mp4 {
 
@@ -37,13 +43,16 @@ class EncryptingFragmenter : public Fragmenter {
   ///        pattern based encryption.
   /// @param skip_byte_block indicates number of unencrypted blocks (16-byte)
   ///        in pattern based encryption.
+  /// @param crypto_context_cache creates the encryptors. It is not owned and
+  ///        should outlive the fragmenter.
   EncryptingFragmenter(scoped_refptr<StreamInfo> info,
                        TrackFragment* traf,
                        scoped_ptr<EncryptionKey> encryption_key,
                        int64_t clear_time,
                        FourCC protection_scheme,
                        uint8_t crypt_byte_block,
-                       uint8_t skip_byte_block);
+                       uint8_t skip_byte_block,
+                       CryptoContextCache* crypto_context_cache);
 
   ~EncryptingFragmenter() override;
 
@@ -54,6 +63,14 @@ class EncryptingFragmenter : public Fragmenter {
   void FinalizeFragment() override;
   /// @}
 
+  /// Encrypt the samples of every fragment in parallel when the fragment is
+  /// finalized, instead of encrypting the samples one by one as they are
+  /// added. The encryption layout and the IVs of the samples are still
+  /// determined as they are added.
+  /// @param num_threads is the number of encryption threads. Parallel
+  ///        encryption is enabled only if it is larger than 1.
+  void EnableParallelEncryption(size_t num_threads);
+
  protected:
   /// Prepare current fragment for encryption.
   /// @return OK on success, an error status otherwise.
@@ -66,6 +83,18 @@ class EncryptingFragmenter : public Fragmenter {
   /// @return OK on success, an error status otherwise.
   Status CreateEncryptor();
 
+  /// Create a new cryptor for the internal encryption key and protection
+  /// scheme.
+  /// @return OK on success, an error status otherwise.
+  Status CreateCryptor(scoped_ptr<AesCryptor>* cryptor) const;
+
+  /// Create a new cryptor for @a encryption_key and the protection scheme.
+  /// This does not access the state of the fragmenter other than its
+  /// constant parameters, so it can be called from another thread.
+  /// @return OK on success, an error status otherwise.
+  Status CreateCryptorForKey(const EncryptionKey& encryption_key,
+                             scoped_ptr<AesCryptor>* cryptor) const;
+
   const EncryptionKey* encryption_key() const { return encryption_key_.get(); }
   AesCryptor* encryptor() { return encryptor_.get(); }
   FourCC protection_scheme() const { return protection_scheme_; }
@@ -75,10 +104,47 @@ class EncryptingFragmenter : public Fragmenter {
   void set_encryption_key(scoped_ptr<EncryptionKey> encryption_key) {
     encryption_key_ = encryption_key.Pass();
   }
+  void set_encryptor(scoped_ptr<AesCryptor> encryptor) {
+    encryptor_ = encryptor.Pass();
+  }
 
  private:
+  // A range of bytes to be encrypted.
+  struct CryptRange {
+    size_t offset;
+    size_t size;
+  };
+  // A sample which is yet to be encrypted in parallel mode.
+  struct PendingSample {
+    PendingSample();
+    ~PendingSample();
+
+    std::vector<uint8_t> iv;
+    // The sample data, which is encrypted in place.
+    uint8_t* data;
+    std::vector<CryptRange> crypt_ranges;
+    // Set if the data is re-keyed from 'cenc' with this key and IV instead of
+    // being encrypted.
+    std::vector<uint8_t> decryption_key;
+    std::vector<uint8_t> decryption_iv;
+  };
+
   void EncryptBytes(uint8_t* data, uint32_t size);
   Status EncryptSample(scoped_refptr<MediaSample> sample);
+  // Compute the subsamples of |sample| and the ranges to be encrypted.
+  Status ComputeCryptLayout(const MediaSample& sample,
+                            std::vector<SubsampleEntry>* subsamples,
+                            std::vector<CryptRange>* crypt_ranges);
+  // Whether |crypt_ranges| cover the same bytes as the encrypted ranges of
+  // |decrypt_config|, so that the keystreams of both line up.
+  static bool IsSameCryptLayout(const DecryptConfig& decrypt_config,
+                                size_t sample_size,
+                                const std::vector<CryptRange>& crypt_ranges);
+
+  // Encrypt the pending samples of the current fragment on the thread pool.
+  void EncryptPendingSamples();
+  // Encrypt |pending_samples_| in [|begin|, |end|) with a new cryptor.
+  void EncryptPendingSampleRange(size_t begin, size_t end);
 
   // Should we enable subsample encryption?
   bool IsSubsampleEncryptionRequired();
@@ -95,9 +161,18 @@ class EncryptingFragmenter : public Fragmenter {
   const FourCC protection_scheme_;
   const uint8_t crypt_byte_block_;
   const uint8_t skip_byte_block_;
+  CryptoContextCache* const crypto_context_cache_;
 
   scoped_ptr<VPxParser> vpx_parser_;
   scoped_ptr<VideoSliceHeaderParser> header_parser_;
+  // The frames of the current VPx sample and the ranges of the current sample
+  // to encrypt. They are kept across samples to reuse their storage.
+  std::vector<VPxFrameInfo> vpx_frames_;
+  std::vector<CryptRange> crypt_ranges_;
+
+  // Used for parallel encryption only.
+  scoped_ptr<ThreadPool> encryption_thread_pool_;
+  std::vector<PendingSample> pending_samples_;
 
   DISALLOW_COPY_AND_ASSIGN(EncryptingFragmenter);
 };
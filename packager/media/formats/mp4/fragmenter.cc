@@ -8,8 +8,8 @@
 
 #include <limits>
 
-#include "packager/media/base/buffer_writer.h"
 #include "packager/media/base/audio_stream_info.h"
+#include "packager/media/base/decryptor_source.h"
 #include "packager/media/base/media_sample.h"
 #include "packager/media/formats/mp4/box_definitions.h"
 
@@ -26,6 +26,29 @@ uint64_t GetSeekPreroll(const StreamInfo& stream_info) {
       static_cast<const AudioStreamInfo&>(stream_info);
   return audio_stream_info.seek_preroll_ns();
 }
+
+// Append |value| to |entries|. |all_equal| is cleared if |value| differs from
+// the previous entry, so it tells whether all the entries are identical.
+template <typename T>
+void AppendSampleEntry(T value, std::vector<T>* entries, bool* all_equal) {
+  if (!entries->empty() && entries->back() != value)
+    *all_equal = false;
+  entries->push_back(value);
+}
+
+// Replace |entries| with |default_value| if all the entries are identical, as
+// tracked by AppendSampleEntry(). Return true if the table is optimized.
+template <typename T>
+bool UseDefaultSampleEntry(bool all_equal,
+                           std::vector<T>* entries,
+                           T* default_value) {
+  DCHECK(!entries->empty());
+  if (!all_equal)
+    return false;
+  *default_value = entries->front();
+  entries->clear();
+  return true;
+}
 }  // namespace
 
 Fragmenter::Fragmenter(scoped_refptr<StreamInfo> info, TrackFragment* traf)
@@ -36,7 +59,13 @@ Fragmenter::Fragmenter(scoped_refptr<StreamInfo> info, TrackFragment* traf)
       fragment_duration_(0),
       presentation_start_time_(kInvalidTime),
       earliest_presentation_time_(kInvalidTime),
-      first_sap_time_(kInvalidTime) {
+      first_sap_time_(kInvalidTime),
+      data_size_(0),
+      samples_memory_(kFragmenterMemory),
+      sample_durations_equal_(true),
+      sample_sizes_equal_(true),
+      sample_flags_equal_(true),
+      last_sample_count_(0) {
   DCHECK(traf);
 }
 
@@ -46,6 +75,12 @@ Status Fragmenter::AddSample(scoped_refptr<MediaSample> sample) {
   DCHECK(sample);
   CHECK_GT(sample->duration(), 0);
 
+  // EncryptingFragmenter re-keys the data pending decryption if it can.
+  if (sample->pending_decrypt_config() &&
+      !DecryptorSource::DecryptPendingSample(sample.get())) {
+    return Status(error::MUXER_FAILURE, "Failed to decrypt the sample.");
+  }
+
   if (!fragment_initialized_) {
     Status status = InitializeFragment(sample->dts());
     if (!status.ok())
@@ -56,12 +91,18 @@ Status Fragmenter::AddSample(scoped_refptr<MediaSample> sample) {
     LOG(WARNING) << "MP4 samples do not support side data. Side data ignored.";
 
   // Fill in sample parameters. It will be optimized later.
-  traf_->runs[0].sample_sizes.push_back(sample->data_size());
-  traf_->runs[0].sample_durations.push_back(sample->duration());
-  traf_->runs[0].sample_flags.push_back(
-      sample->is_key_frame() ? 0 : TrackFragmentHeader::kNonKeySampleMask);
-
-  data_->AppendArray(sample->data(), sample->data_size());
+  TrackFragmentRun& run = traf_->runs[0];
+  AppendSampleEntry<uint32_t>(sample->data_size(), &run.sample_sizes,
+                              &sample_sizes_equal_);
+  AppendSampleEntry<uint32_t>(sample->duration(), &run.sample_durations,
+                              &sample_durations_equal_);
+  AppendSampleEntry<uint32_t>(
+      sample->is_key_frame() ? 0 : TrackFragmentHeader::kNonKeySampleMask,
+      &run.sample_flags, &sample_flags_equal_);
+
+  samples_.push_back(sample);
+  data_size_ += sample->data_size();
+  samples_memory_.Set(data_size_);
   fragment_duration_ += sample->duration();
 
   int64_t pts = sample->pts();
@@ -71,9 +112,9 @@ Status Fragmenter::AddSample(scoped_refptr<MediaSample> sample) {
   if (earliest_presentation_time_ > pts)
     earliest_presentation_time_ = pts;
 
-  traf_->runs[0].sample_composition_time_offsets.push_back(pts - sample->dts());
+  run.sample_composition_time_offsets.push_back(pts - sample->dts());
   if (pts != sample->dts())
-    traf_->runs[0].flags |= TrackFragmentRun::kSampleCompTimeOffsetsPresentMask;
+    run.flags |= TrackFragmentRun::kSampleCompTimeOffsetsPresentMask;
 
   if (sample->is_key_frame()) {
     if (first_sap_time_ == kInvalidTime)
@@ -89,6 +130,19 @@ Status Fragmenter::InitializeFragment(int64_t first_sample_dts) {
   traf_->runs.clear();
   traf_->runs.resize(1);
   traf_->runs[0].flags = TrackFragmentRun::kDataOffsetPresentMask;
+  // Fragments usually have about the same number of samples, so the sample
+  // tables are sized after the previous fragment.
+  if (last_sample_count_ > 0) {
+    TrackFragmentRun& run = traf_->runs[0];
+    run.sample_sizes.reserve(last_sample_count_);
+    run.sample_durations.reserve(last_sample_count_);
+    run.sample_flags.reserve(last_sample_count_);
+    run.sample_composition_time_offsets.reserve(last_sample_count_);
+    samples_.reserve(last_sample_count_);
+  }
+  sample_durations_equal_ = true;
+  sample_sizes_equal_ = true;
+  sample_flags_equal_ = true;
   traf_->sample_group_descriptions.clear();
   traf_->sample_to_groups.clear();
   traf_->header.sample_description_index = 1;  // 1-based.
@@ -97,31 +151,36 @@ Status Fragmenter::InitializeFragment(int64_t first_sample_dts) {
   fragment_duration_ = 0;
   earliest_presentation_time_ = kInvalidTime;
   first_sap_time_ = kInvalidTime;
-  data_.reset(new BufferWriter());
+  samples_.clear();
+  data_size_ = 0;
+  samples_memory_.Set(0);
   return Status::OK;
 }
 
 void Fragmenter::FinalizeFragment() {
-  // Optimize trun box.
-  traf_->runs[0].sample_count = traf_->runs[0].sample_sizes.size();
-  if (OptimizeSampleEntries(&traf_->runs[0].sample_durations,
+  // Optimize trun box. Whether the entries of the tables are identical is
+  // tracked in AddSample(), so the tables are not scanned again.
+  TrackFragmentRun& run = traf_->runs[0];
+  run.sample_count = run.sample_sizes.size();
+  last_sample_count_ = run.sample_count;
+  if (UseDefaultSampleEntry(sample_durations_equal_, &run.sample_durations,
                             &traf_->header.default_sample_duration)) {
     traf_->header.flags |=
         TrackFragmentHeader::kDefaultSampleDurationPresentMask;
   } else {
-    traf_->runs[0].flags |= TrackFragmentRun::kSampleDurationPresentMask;
+    run.flags |= TrackFragmentRun::kSampleDurationPresentMask;
   }
-  if (OptimizeSampleEntries(&traf_->runs[0].sample_sizes,
+  if (UseDefaultSampleEntry(sample_sizes_equal_, &run.sample_sizes,
                             &traf_->header.default_sample_size)) {
     traf_->header.flags |= TrackFragmentHeader::kDefaultSampleSizePresentMask;
   } else {
-    traf_->runs[0].flags |= TrackFragmentRun::kSampleSizePresentMask;
+    run.flags |= TrackFragmentRun::kSampleSizePresentMask;
   }
-  if (OptimizeSampleEntries(&traf_->runs[0].sample_flags,
+  if (UseDefaultSampleEntry(sample_flags_equal_, &run.sample_flags,
                             &traf_->header.default_sample_flags)) {
     traf_->header.flags |= TrackFragmentHeader::kDefaultSampleFlagsPresentMask;
   } else {
-    traf_->runs[0].flags |= TrackFragmentRun::kSampleFlagsPresentMask;
+    run.flags |= TrackFragmentRun::kSampleFlagsPresentMask;
   }
 
   // Add SampleToGroup boxes. A SampleToGroup box with grouping type of 'roll'
@@ -12,12 +12,12 @@
 #include "packager/base/logging.h"
 #include "packager/base/memory/ref_counted.h"
 #include "packager/base/memory/scoped_ptr.h"
+#include "packager/media/base/memory_tracker.h"
 #include "packager/media/base/status.h"
 
 namespace edash_packager {
 namespace media {
 
-class BufferWriter;
 class MediaSample;
 class StreamInfo;
 
@@ -60,7 +60,13 @@ class Fragmenter {
   }
   bool fragment_initialized() const { return fragment_initialized_; }
   bool fragment_finalized() const { return fragment_finalized_; }
-  BufferWriter* data() { return data_.get(); }
+  /// @return The samples of the current fragment. Their data, in order, is
+  ///         the payload of the 'mdat' box of the fragment.
+  const std::vector<scoped_refptr<MediaSample> >& samples() const {
+    return samples_;
+  }
+  /// @return The size of the data of the samples of the current fragment.
+  uint64_t data_size() const { return data_size_; }
 
  protected:
   TrackFragment* traf() { return traf_; }
@@ -83,7 +89,19 @@ class Fragmenter {
   int64_t presentation_start_time_;
   int64_t earliest_presentation_time_;
   int64_t first_sap_time_;
-  scoped_ptr<BufferWriter> data_;
+  // The samples are referenced rather than copied to a fragment buffer, so
+  // their data is copied only when it is written out.
+  std::vector<scoped_refptr<MediaSample> > samples_;
+  uint64_t data_size_;
+  // Accounts the payloads of |samples_|.
+  TrackedMemory samples_memory_;
+  // Whether all the entries of the sample tables of the current fragment are
+  // identical, updated as samples are added.
+  bool sample_durations_equal_;
+  bool sample_sizes_equal_;
+  bool sample_flags_equal_;
+  // Number of samples of the previous fragment.
+  size_t last_sample_count_;
 
   DISALLOW_COPY_AND_ASSIGN(Fragmenter);
 };
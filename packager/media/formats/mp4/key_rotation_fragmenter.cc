@@ -7,6 +7,7 @@
 #include "packager/media/formats/mp4/key_rotation_fragmenter.h"
 
 #include "packager/media/base/aes_encryptor.h"
+#include "packager/media/base/key_rotation_schedule.h"
 #include "packager/media/formats/mp4/box_definitions.h"
 
 namespace edash_packager {
@@ -20,13 +21,16 @@ const bool kInitialEncryptionInfo = true;
 KeyRotationFragmenter::KeyRotationFragmenter(MovieFragment* moof,
                                              scoped_refptr<StreamInfo> info,
                                              TrackFragment* traf,
-                                             KeySource* encryption_key_source,
+                                             KeyRotationSchedule*
+                                                 key_rotation_schedule,
                                              KeySource::TrackType track_type,
                                              int64_t crypto_period_duration,
                                              int64_t clear_time,
                                              FourCC protection_scheme,
                                              uint8_t crypt_byte_block,
                                              uint8_t skip_byte_block,
+                                             CryptoContextCache*
+                                                 crypto_context_cache,
                                              MuxerListener* muxer_listener)
     : EncryptingFragmenter(info,
                            traf,
@@ -34,15 +38,16 @@ KeyRotationFragmenter::KeyRotationFragmenter(MovieFragment* moof,
                            clear_time,
                            protection_scheme,
                            crypt_byte_block,
-                           skip_byte_block),
+                           skip_byte_block,
+                           crypto_context_cache),
       moof_(moof),
-      encryption_key_source_(encryption_key_source),
+      key_rotation_schedule_(key_rotation_schedule),
       track_type_(track_type),
       crypto_period_duration_(crypto_period_duration),
       prev_crypto_period_index_(-1),
       muxer_listener_(muxer_listener) {
   DCHECK(moof);
-  DCHECK(encryption_key_source);
+  DCHECK(key_rotation_schedule);
 }
 
 KeyRotationFragmenter::~KeyRotationFragmenter() {}
@@ -55,10 +60,13 @@ Status KeyRotationFragmenter::PrepareFragmentForEncryption(
       traf()->decode_time.decode_time / crypto_period_duration_;
   if (current_crypto_period_index != prev_crypto_period_index_) {
     scoped_ptr<EncryptionKey> encryption_key(new EncryptionKey());
-    Status status = encryption_key_source_->GetCryptoPeriodKey(
-        current_crypto_period_index, track_type_, encryption_key.get());
+    Status status = key_rotation_schedule_->GetCryptoPeriodKey(
+        current_crypto_period_index, track_type_, encryption_key.get(),
+        &pssh_boxes_);
     if (!status.ok())
       return status;
+    // The renditions sharing the key use their own ivs: reusing an iv with
+    // the same key would reuse the keystream.
     if (encryption_key->iv.empty()) {
       if (!AesCryptor::GenerateRandomIv(protection_scheme(),
                                         &encryption_key->iv)) {
@@ -68,21 +76,19 @@ Status KeyRotationFragmenter::PrepareFragmentForEncryption(
     set_encryption_key(encryption_key.Pass());
     prev_crypto_period_index_ = current_crypto_period_index;
     need_to_refresh_encryptor = true;
-  }
 
-  DCHECK(encryption_key());
-  const std::vector<ProtectionSystemSpecificInfo>& system_info =
-      encryption_key()->key_system_info;
-  moof_->pssh.resize(system_info.size());
-  for (size_t i = 0; i < system_info.size(); i++) {
-    moof_->pssh[i].raw_box = system_info[i].CreateBox();
+    if (muxer_listener_) {
+      muxer_listener_->OnEncryptionInfoReady(
+          !kInitialEncryptionInfo, protection_scheme(),
+          encryption_key()->key_id, encryption_key()->iv,
+          encryption_key()->key_system_info);
+    }
   }
 
-  if (muxer_listener_) {
-    muxer_listener_->OnEncryptionInfoReady(
-        !kInitialEncryptionInfo, protection_scheme(), encryption_key()->key_id,
-        encryption_key()->iv, encryption_key()->key_system_info);
-  }
+  DCHECK(encryption_key());
+  moof_->pssh.resize(pssh_boxes_.size());
+  for (size_t i = 0; i < pssh_boxes_.size(); i++)
+    moof_->pssh[i].raw_box = pssh_boxes_[i];
 
   // Skip the following steps if the current fragment is not going to be
   // encrypted. 'pssh' box needs to be included in the fragment, which is
@@ -7,6 +7,8 @@
 #ifndef MEDIA_FORMATS_MP4_KEY_ROTATION_FRAGMENTER_H_
 #define MEDIA_FORMATS_MP4_KEY_ROTATION_FRAGMENTER_H_
 
+#include <vector>
+
 #include "packager/media/base/fourccs.h"
 #include "packager/media/base/key_source.h"
 #include "packager/media/event/muxer_listener.h"
@@ -14,19 +16,24 @@
 
 namespace edash_packager {
 namespace media {
+
+class KeyRotationSchedule;
+
 namespace mp4 {
 
 struct MovieFragment;
 
 /// KeyRotationFragmenter generates MP4 fragments with sample encrypted by
-/// rotation keys.
+/// rotation keys. The keys and the 'pssh' boxes of the crypto periods come
+/// from a KeyRotationSchedule, which fetches them once for all the renditions
+/// and prefetches the next period.
 class KeyRotationFragmenter : public EncryptingFragmenter {
  public:
   /// @param moof points to a MovieFragment box.
   /// @param info contains stream information.
   /// @param traf points to a TrackFragment box.
-  /// @param encryption_key_source points to the source which generates
-  ///        encryption keys.
+  /// @param key_rotation_schedule provides the keys of the crypto periods. It
+  ///        is not owned and should outlive the fragmenter.
   /// @param track_type indicates whether SD key or HD key should be used to
   ///        encrypt the video content.
   /// @param crypto_period_duration specifies crypto period duration in units
@@ -39,18 +46,21 @@ class KeyRotationFragmenter : public EncryptingFragmenter {
   ///        pattern based encryption.
   /// @param skip_byte_block indicates number of unencrypted blocks (16-byte)
   ///        in pattern based encryption.
+  /// @param crypto_context_cache creates the encryptors. It is not owned and
+  ///        should outlive the fragmenter.
   /// @param muxer_listener is a pointer to MuxerListener for notifying
   ///        muxer related events. This may be null.
   KeyRotationFragmenter(MovieFragment* moof,
                         scoped_refptr<StreamInfo> info,
                         TrackFragment* traf,
-                        KeySource* encryption_key_source,
+                        KeyRotationSchedule* key_rotation_schedule,
                         KeySource::TrackType track_type,
                         int64_t crypto_period_duration,
                         int64_t clear_time,
                         FourCC protection_scheme,
                         uint8_t crypt_byte_block,
                         uint8_t skip_byte_block,
+                        CryptoContextCache* crypto_context_cache,
                         MuxerListener* muxer_listener);
   ~KeyRotationFragmenter() override;
 
@@ -63,11 +73,14 @@ class KeyRotationFragmenter : public EncryptingFragmenter {
  private:
   MovieFragment* moof_;
 
-  KeySource* encryption_key_source_;
+  KeyRotationSchedule* key_rotation_schedule_;
   KeySource::TrackType track_type_;
   const int64_t crypto_period_duration_;
   size_t prev_crypto_period_index_;
 
+  // Serialized 'pssh' boxes of the current crypto period.
+  std::vector<std::vector<uint8_t> > pssh_boxes_;
+
   // For notifying new pssh boxes to the event handler.
   MuxerListener* const muxer_listener_;
 
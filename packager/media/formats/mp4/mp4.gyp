@@ -12,6 +12,7 @@
     {
       'target_name': 'mp4',
       'type': '<(component)',
+      'includes': ['../../../hot_code.gypi'],
       'sources': [
         'aac_audio_specific_config.cc',
         'aac_audio_specific_config.h',
@@ -42,6 +43,8 @@
         'mp4_muxer.h',
         'multi_segment_segmenter.cc',
         'multi_segment_segmenter.h',
+        'passthrough_encryption_fragmenter.cc',
+        'passthrough_encryption_fragmenter.h',
         'segmenter.cc',
         'segmenter.h',
         'single_segment_segmenter.cc',
@@ -58,6 +61,7 @@
         '../../base/media_base.gyp:media_base',
         '../../event/media_event.gyp:media_event',
         '../../filters/filters.gyp:filters',
+        '../../../third_party/gflags/gflags.gyp:gflags',
       ],
     },
     {
@@ -4,20 +4,29 @@
 
 #include "packager/media/formats/mp4/mp4_media_parser.h"
 
+#include <gflags/gflags.h>
+
+#include <algorithm>
 #include <limits>
 
+#include "packager/base/bind.h"
 #include "packager/base/callback.h"
 #include "packager/base/callback_helpers.h"
 #include "packager/base/logging.h"
 #include "packager/base/memory/ref_counted.h"
+#include "packager/base/stl_util.h"
 #include "packager/base/strings/string_number_conversions.h"
 #include "packager/media/base/audio_stream_info.h"
 #include "packager/media/base/buffer_reader.h"
+#include "packager/media/base/cancellation_token.h"
+#include "packager/media/base/closure_thread.h"
 #include "packager/media/base/decrypt_config.h"
+#include "packager/media/base/encryption_config.h"
 #include "packager/media/base/key_source.h"
 #include "packager/media/base/macros.h"
 #include "packager/media/base/media_sample.h"
 #include "packager/media/base/rcheck.h"
+#include "packager/media/base/shared_buffer.h"
 #include "packager/media/base/video_stream_info.h"
 #include "packager/media/file/file.h"
 #include "packager/media/file/file_closer.h"
@@ -29,11 +38,34 @@
 #include "packager/media/formats/mp4/es_descriptor.h"
 #include "packager/media/formats/mp4/track_run_iterator.h"
 
+DEFINE_int32(mp4_decryption_threads,
+             0,
+             "Number of threads decrypting the samples of encrypted MP4 "
+             "inputs. The samples of a fragment are decrypted in parallel "
+             "before being emitted. 0 or 1 decrypts them on the demuxer "
+             "thread.");
+DEFINE_bool(mp4_fused_rekey,
+            false,
+            "Leave the samples of encrypted MP4 inputs encrypted until they "
+            "are re-encrypted. Samples encrypted with 'cenc' and re-encrypted "
+            "with 'cenc' with the same subsample layout are then re-keyed in "
+            "a single pass, other samples are decrypted as usual.");
+DEFINE_bool(mp4_encryption_passthrough,
+            false,
+            "Remux the samples of encrypted MP4 inputs without decrypting "
+            "them: the Common Encryption parameters and the PSSH boxes of the "
+            "input are written unchanged, so no key is needed. Only supported "
+            "with MP4 outputs which are not encrypted again.");
+
 namespace edash_packager {
 namespace media {
 namespace mp4 {
 namespace {
 
+// Maximum number of samples decrypted together when decrypting in parallel.
+// Bounds the memory held when the fragments are large.
+const size_t kMaxPendingSamples = 256;
+
 uint64_t Rescale(uint64_t time_in_old_scale,
                  uint32_t old_scale,
                  uint32_t new_scale) {
@@ -82,19 +114,81 @@ AudioCodec FourCCToAudioCodec(FourCC fourcc) {
   }
 }
 
+// Sets the encryption of |stream|, protected with |sinf|, so that its
+// samples are passed through encrypted, with the PSSH boxes |pssh|.
+bool SetEncryptionConfig(
+    const ProtectionSchemeInfo& sinf,
+    const std::vector<ProtectionSystemSpecificHeader>& pssh,
+    StreamInfo* stream) {
+  const TrackEncryption& track_encryption = sinf.info.track_encryption;
+  EncryptionConfig encryption_config;
+  encryption_config.protection_scheme = sinf.type.type;
+  encryption_config.crypt_byte_block =
+      track_encryption.default_crypt_byte_block;
+  encryption_config.skip_byte_block = track_encryption.default_skip_byte_block;
+  encryption_config.per_sample_iv_size =
+      track_encryption.default_per_sample_iv_size;
+  encryption_config.constant_iv = track_encryption.default_constant_iv;
+  encryption_config.key_id = track_encryption.default_kid;
+  encryption_config.key_system_info.resize(pssh.size());
+  for (size_t i = 0; i < pssh.size(); ++i) {
+    if (!encryption_config.key_system_info[i].Parse(pssh[i].raw_box.data(),
+                                                    pssh[i].raw_box.size())) {
+      LOG(ERROR) << "Failed to parse the 'pssh' box to pass through.";
+      return false;
+    }
+  }
+  stream->set_encryption_config(encryption_config);
+  return true;
+}
+
 // Default DTS audio number of channels for 5.1 channel layout.
 const uint8_t kDtsAudioNumChannels = 6;
 const uint64_t kNanosecondsPerSecond = 1000000000ull;
 
+// Maximum size of a random access read. The samples of a chunk are read
+// together, up to this size.
+const int64_t kMaxRandomAccessReadSize = 0x100000;  // 1MB
+
 }  // namespace
 
+struct MP4MediaParser::RandomAccessTrack {
+  explicit RandomAccessTrack(const Movie* moov)
+      : runs(moov), data_offset(0), done(false) {}
+
+  TrackRunIterator runs;
+  // The sample data read ahead for |runs|, starting at file offset
+  // |data_offset|. Shared with the samples emitted from it.
+  scoped_refptr<SharedBuffer> data;
+  int64_t data_offset;
+  // Set when the end of the time range is reached.
+  bool done;
+};
+
 MP4MediaParser::MP4MediaParser()
     : state_(kWaitingForInit),
       decryption_key_source_(NULL),
       moof_head_(0),
-      mdat_tail_(0) {}
-
-MP4MediaParser::~MP4MediaParser() {}
+      mdat_tail_(0),
+      random_access_position_(0),
+      random_access_start_(0),
+      random_access_end_(0),
+      random_access_timescale_(0),
+      sample_buffer_pool_(new SampleBufferPool),
+      keys_fetched_(false) {}
+
+struct MP4MediaParser::PendingSample {
+  uint32_t track_id;
+  scoped_refptr<MediaSample> sample;
+  // NULL if the sample is not encrypted.
+  scoped_ptr<DecryptConfig> decrypt_config;
+};
+
+MP4MediaParser::~MP4MediaParser() {
+  WaitForKeys();
+  STLDeleteElements(&random_access_tracks_);
+  STLDeleteElements(&pending_samples_);
+}
 
 void MP4MediaParser::Init(const InitCB& init_cb,
                           const NewSampleCB& new_sample_cb,
@@ -108,8 +202,11 @@ void MP4MediaParser::Init(const InitCB& init_cb,
   init_cb_ = init_cb;
   new_sample_cb_ = new_sample_cb;
   decryption_key_source_ = decryption_key_source;
-  if (decryption_key_source)
+  if (decryption_key_source) {
     decryptor_source_.reset(new DecryptorSource(decryption_key_source));
+    decryptor_source_->EnableParallelDecryption(
+        std::max(FLAGS_mp4_decryption_threads, 0));
+  }
 }
 
 void MP4MediaParser::Reset() {
@@ -117,13 +214,22 @@ void MP4MediaParser::Reset() {
   runs_.reset();
   moof_head_ = 0;
   mdat_tail_ = 0;
+  random_access_file_.reset();
+  random_access_position_ = 0;
+  STLDeleteElements(&random_access_tracks_);
+  random_access_timescale_ = 0;
+  STLDeleteElements(&pending_samples_);
 }
 
 bool MP4MediaParser::Flush() {
   DCHECK_NE(state_, kWaitingForInit);
+  bool result = state_ == kError || EmitPendingSamples();
+  // Reports the failure to fetch keys no sample needed.
+  if (!WaitForKeys())
+    result = false;
   Reset();
   ChangeState(kParsingBoxes);
-  return true;
+  return result;
 }
 
 bool MP4MediaParser::Parse(const uint8_t* buf, int size) {
@@ -135,6 +241,7 @@ bool MP4MediaParser::Parse(const uint8_t* buf, int size) {
   queue_.Push(buf, size);
 
   bool result, err = false;
+  const uint64_t max_buffered_bytes = limits().max_buffered_bytes;
 
   do {
     if (state_ == kParsingBoxes) {
@@ -149,6 +256,16 @@ bool MP4MediaParser::Parse(const uint8_t* buf, int size) {
     }
   } while (result && !err);
 
+  // The data of the 'mdat' boxes is not buffered past the samples emitted,
+  // but the boxes parsed, e.g. the 'moov', are buffered whole.
+  if (!err && max_buffered_bytes > 0 &&
+      static_cast<uint64_t>(queue_.tail() - queue_.head()) >
+          max_buffered_bytes) {
+    LOG(ERROR) << "More than " << max_buffered_bytes
+               << " bytes buffered while parsing MP4.";
+    err = true;
+  }
+
   if (err) {
     DLOG(ERROR) << "Error while parsing MP4";
     moov_.reset();
@@ -160,6 +277,11 @@ bool MP4MediaParser::Parse(const uint8_t* buf, int size) {
   return true;
 }
 
+void MP4MediaParser::SetInputBuffer(
+    const scoped_refptr<SharedBuffer>& input_buffer) {
+  queue_.SetInputBuffer(input_buffer);
+}
+
 bool MP4MediaParser::LoadMoov(const std::string& file_path) {
   scoped_ptr<File, FileCloser> file(
       File::OpenWithNoBuffering(file_path.c_str(), "r"));
@@ -236,6 +358,328 @@ bool MP4MediaParser::LoadMoov(const std::string& file_path) {
   return true;
 }
 
+bool MP4MediaParser::LoadMoov(const SharedBuffer& input) {
+  const uint8_t* data = input.data();
+  const uint64_t size = input.size();
+  uint64_t position = 0;
+  bool mdat_seen = false;
+  while (position < size) {
+    const uint64_t kBoxHeaderReadSize(16);
+    const size_t header_size =
+        static_cast<size_t>(std::min(size - position, kBoxHeaderReadSize));
+    uint64_t box_size;
+    FourCC box_type;
+    bool err = false;
+    if (!BoxReader::StartTopLevelBox(data + position, header_size, &box_type,
+                                     &box_size, &err) ||
+        box_size == 0) {
+      LOG(ERROR) << "Could not start top level box at " << position;
+      return false;
+    }
+    if (box_type == FOURCC_mdat) {
+      mdat_seen = true;
+    } else if (box_type == FOURCC_moov) {
+      if (!mdat_seen) {
+        // 'moov' is before 'mdat'. Nothing to do.
+        return true;
+      }
+      // 'mdat' before 'moov'. Parse 'moov' in place.
+      if (box_size > size - position ||
+          box_size > static_cast<uint64_t>(std::numeric_limits<int>::max())) {
+        LOG(ERROR) << "Invalid 'moov' box size " << box_size;
+        return false;
+      }
+      scoped_ptr<BoxReader> reader(
+          BoxReader::ReadTopLevelBox(data + position, box_size, &err));
+      if (!reader || !ParseMoov(reader.get())) {
+        LOG(ERROR) << "Error parsing 'moov' box.";
+        ChangeState(kError);
+        return false;
+      }
+      mdat_tail_ = 0;  // So it will skip boxes until mdat.
+      return true;
+    }
+    position += box_size;
+  }
+  LOG(ERROR) << "Could not find 'moov' box.";
+  return false;
+}
+
+bool MP4MediaParser::InitRandomAccess(const std::string& file_path) {
+  return InitRandomAccess(file_path, NULL);
+}
+
+bool MP4MediaParser::InitRandomAccess(const std::string& file_path,
+                                      MoovBox* moov_box) {
+  DCHECK_EQ(state_, kParsingBoxes);
+  scoped_ptr<File, FileCloser> file(
+      File::OpenWithNoBuffering(file_path.c_str(), "r"));
+  if (!file) {
+    LOG(ERROR) << "Unable to open media file '" << file_path << "'";
+    return false;
+  }
+
+  MoovBox read_moov_box;
+  const bool moov_box_given = moov_box && !moov_box->data.empty();
+  if (!moov_box_given && !ReadMoovBox(file.get(), file_path, &read_moov_box))
+    return false;
+  const MoovBox& moov = moov_box_given ? *moov_box : read_moov_box;
+
+  bool err = false;
+  scoped_ptr<BoxReader> reader(
+      BoxReader::ReadTopLevelBox(moov.data.data(), moov.data.size(), &err));
+  if (!reader || !ParseMoov(reader.get())) {
+    LOG(ERROR) << "Error parsing mp4 file '" << file_path << "'";
+    ChangeState(kError);
+    return false;
+  }
+  random_access_position_ = moov.offset + moov.data.size();
+
+  mdat_tail_ = 0;  // So it will skip boxes until mdat if streamed.
+  if (!moov_->extends.tracks.empty()) {
+    // The samples are described in the fragments, which need to be streamed.
+    VLOG(1) << "Fragmented file '" << file_path << "' is streamed.";
+    return false;
+  }
+  if (moov_box && !moov_box_given) {
+    moov_box->offset = read_moov_box.offset;
+    moov_box->data.swap(read_moov_box.data);
+  }
+  random_access_file_ = file.Pass();
+  return true;
+}
+
+bool MP4MediaParser::ReadMoovBox(File* file,
+                                 const std::string& file_path,
+                                 MoovBox* moov_box) {
+  uint64_t file_position = 0;
+  while (true) {
+    if (!file->Seek(file_position)) {
+      LOG(WARNING) << "Filesystem does not support seeking on file '"
+                   << file_path << "'";
+      return false;
+    }
+    const uint32_t kBoxHeaderReadSize(16);
+    uint8_t header[kBoxHeaderReadSize];
+    int64_t bytes_read = file->Read(header, kBoxHeaderReadSize);
+    if (bytes_read <= 0) {
+      LOG(ERROR) << "Could not find 'moov' box in file '" << file_path << "'";
+      return false;
+    }
+    uint64_t box_size;
+    FourCC box_type;
+    bool err = false;
+    if (!BoxReader::StartTopLevelBox(header, bytes_read, &box_type, &box_size,
+                                     &err) ||
+        box_size == 0) {
+      LOG(ERROR) << "Could not start top level box from file '" << file_path
+                 << "'";
+      return false;
+    }
+    if (box_type != FOURCC_moov) {
+      file_position += box_size;
+      continue;
+    }
+
+    if (box_size > static_cast<uint64_t>(std::numeric_limits<int>::max())) {
+      LOG(ERROR) << "Invalid 'moov' box size " << box_size;
+      return false;
+    }
+    moov_box->offset = file_position;
+    moov_box->data.resize(box_size);
+    if (!file->Seek(file_position)) {
+      LOG(ERROR) << "Error seeking to 'moov' in file '" << file_path << "'";
+      return false;
+    }
+    for (uint64_t pos = 0; pos < box_size; pos += bytes_read) {
+      bytes_read = file->Read(&moov_box->data[pos], box_size - pos);
+      if (bytes_read <= 0) {
+        LOG(ERROR) << "Error reading 'moov' contents from file '" << file_path
+                   << "'";
+        return false;
+      }
+    }
+    return true;
+  }
+}
+
+bool MP4MediaParser::SelectRandomAccessTracks(
+    const std::set<uint32_t>& track_ids) {
+  DCHECK(random_access_file_);
+  DCHECK(moov_);
+  STLDeleteElements(&random_access_tracks_);
+  for (std::vector<Track>::const_iterator track = moov_->tracks.begin();
+       track != moov_->tracks.end(); ++track) {
+    if (track_ids.find(track->header.track_id) == track_ids.end())
+      continue;
+    random_access_tracks_.push_back(new RandomAccessTrack(moov_.get()));
+    RCHECK(random_access_tracks_.back()->runs.InitForTrack(
+        track->header.track_id));
+  }
+  return true;
+}
+
+bool MP4MediaParser::ReadRandomAccessSamples(size_t max_samples,
+                                             bool* end_of_stream) {
+  DCHECK(end_of_stream);
+  *end_of_stream = false;
+  if (state_ == kError || !random_access_file_)
+    return false;
+
+  for (size_t i = 0; i < max_samples; ++i) {
+    RandomAccessTrack* track = NextRandomAccessTrack();
+    if (!track) {
+      *end_of_stream = true;
+      return true;
+    }
+    if (!ReadRandomAccessSample(track)) {
+      ChangeState(kError);
+      return false;
+    }
+  }
+  return true;
+}
+
+MP4MediaParser::RandomAccessTrack* MP4MediaParser::NextRandomAccessTrack() {
+  RandomAccessTrack* next_track = NULL;
+  double next_dts_in_seconds = 0;
+  for (std::vector<RandomAccessTrack*>::iterator it =
+           random_access_tracks_.begin();
+       it != random_access_tracks_.end(); ++it) {
+    if ((*it)->done)
+      continue;
+    TrackRunIterator* runs = &(*it)->runs;
+    while (runs->IsRunValid()) {
+      if (!runs->IsSampleValid()) {
+        runs->AdvanceRun();
+        continue;
+      }
+      if (random_access_timescale_ == 0)
+        break;
+      // Compare the decoding time with the range in a common timescale.
+      const int64_t scaled_dts = runs->dts() * random_access_timescale_;
+      if (random_access_end_ != std::numeric_limits<int64_t>::max() &&
+          scaled_dts >= random_access_end_ * runs->timescale()) {
+        (*it)->done = true;
+        break;
+      }
+      if (scaled_dts >= random_access_start_ * runs->timescale())
+        break;
+      // Skip the sample without reading it.
+      runs->AdvanceSample();
+    }
+    if ((*it)->done || !runs->IsRunValid())
+      continue;
+    const double dts_in_seconds =
+        static_cast<double>(runs->dts()) / runs->timescale();
+    if (!next_track || dts_in_seconds < next_dts_in_seconds) {
+      next_track = *it;
+      next_dts_in_seconds = dts_in_seconds;
+    }
+  }
+  return next_track;
+}
+
+bool MP4MediaParser::ReadRandomAccessSample(RandomAccessTrack* track) {
+  TrackRunIterator* runs = &track->runs;
+  // Encrypted non-fragmented files are rejected by TrackRunIterator.
+  DCHECK(!runs->is_encrypted());
+
+  const int64_t sample_offset = runs->sample_offset();
+  const int sample_size = runs->sample_size();
+  RCHECK(sample_offset >= 0 && sample_size >= 0);
+
+  scoped_refptr<MediaSample> stream_sample;
+  if (sample_size == 0) {
+    const uint8_t kNoData = 0;
+    stream_sample = MediaSample::CopyFrom(&kNoData, 0, runs->is_keyframe());
+  } else {
+    if (!track->data || sample_offset < track->data_offset ||
+        sample_offset + sample_size >
+            track->data_offset + static_cast<int64_t>(track->data->size())) {
+      // Read the sample along with the following samples of the chunk, which
+      // are contiguous.
+      const int64_t read_size =
+          runs->GetRunDataSize(kMaxRandomAccessReadSize);
+      track->data = new SharedBuffer(read_size);
+      track->data_offset = sample_offset;
+      if (!ReadAt(sample_offset, track->data->data(), read_size))
+        return false;
+    }
+    stream_sample = MediaSample::CreateFromSharedBuffer(
+        track->data, track->data->data() + (sample_offset - track->data_offset),
+        sample_size, runs->is_keyframe());
+  }
+
+  stream_sample->set_dts(runs->dts());
+  stream_sample->set_pts(runs->cts());
+  stream_sample->set_duration(runs->duration());
+
+  DVLOG(3) << "Pushing frame read by random access: "
+           << ", key=" << runs->is_keyframe()
+           << ", dur=" << runs->duration()
+           << ", dts=" << runs->dts()
+           << ", cts=" << runs->cts()
+           << ", size=" << sample_size;
+
+  if (!new_sample_cb_.Run(runs->track_id(), stream_sample)) {
+    LOG(ERROR) << "Failed to process the sample.";
+    return false;
+  }
+  runs->AdvanceSample();
+  return true;
+}
+
+void MP4MediaParser::SetRandomAccessTimeRange(int64_t start,
+                                              int64_t end,
+                                              uint32_t timescale) {
+  DCHECK(random_access_file_);
+  DCHECK_LT(start, end);
+  DCHECK_NE(0u, timescale);
+  random_access_start_ = start;
+  random_access_end_ = end;
+  random_access_timescale_ = timescale;
+}
+
+bool MP4MediaParser::GetKeyFrameTimes(uint32_t track_id,
+                                      std::vector<int64_t>* key_frame_times) {
+  DCHECK(key_frame_times);
+  RCHECK(random_access_file_ && moov_);
+  TrackRunIterator runs(moov_.get());
+  RCHECK(runs.InitForTrack(track_id));
+  key_frame_times->clear();
+  for (; runs.IsRunValid(); runs.AdvanceRun()) {
+    for (; runs.IsSampleValid(); runs.AdvanceSample()) {
+      if (runs.is_keyframe())
+        key_frame_times->push_back(runs.dts());
+    }
+  }
+  // Runs are sorted by file offset, which may not follow decoding order.
+  std::sort(key_frame_times->begin(), key_frame_times->end());
+  return true;
+}
+
+bool MP4MediaParser::ReadAt(int64_t offset, uint8_t* data, int64_t size) {
+  if (offset != random_access_position_) {
+    if (!random_access_file_->Seek(offset)) {
+      LOG(ERROR) << "Cannot seek to sample data at " << offset;
+      return false;
+    }
+    random_access_position_ = offset;
+  }
+  while (size > 0) {
+    int64_t bytes_read = random_access_file_->Read(data, size);
+    if (bytes_read <= 0) {
+      LOG(ERROR) << "Cannot read sample data at " << random_access_position_;
+      return false;
+    }
+    data += bytes_read;
+    size -= bytes_read;
+    random_access_position_ += bytes_read;
+  }
+  return true;
+}
+
 bool MP4MediaParser::ParseBox(bool* err) {
   const uint8_t* buf;
   int size;
@@ -283,6 +727,7 @@ bool MP4MediaParser::ParseMoov(BoxReader* reader) {
     return true;  // Already parsed the 'moov' box.
 
   moov_.reset(new Movie);
+  reader->set_max_boxes(limits().max_boxes_per_moov);
   RCHECK(moov_->Parse(reader));
   runs_.reset();
 
@@ -488,6 +933,10 @@ bool MP4MediaParser::ParseMoov(BoxReader* reader) {
           extra_data.data(),
           extra_data.size(),
           is_encrypted));
+      if (is_encrypted && FLAGS_mp4_encryption_passthrough &&
+          !SetEncryptionConfig(entry.sinf, moov_->pssh, streams.back().get())) {
+        return false;
+      }
     }
 
     if (samp_descr.type == kVideo) {
@@ -584,12 +1033,18 @@ bool MP4MediaParser::ParseMoov(BoxReader* reader) {
           0,  // trick_play_rate
           nalu_length_size, entry.codec_config_record.data.data(),
           entry.codec_config_record.data.size(), is_encrypted));
+      if (is_encrypted && FLAGS_mp4_encryption_passthrough &&
+          !SetEncryptionConfig(entry.sinf, moov_->pssh, streams.back().get())) {
+        return false;
+      }
     }
   }
 
-  init_cb_.Run(streams);
-  if (!FetchKeysIfNecessary(moov_->pssh))
+  // The keys are fetched while the tracks are set up and the first samples
+  // are read.
+  if (!StartKeyFetch(moov_->pssh))
     return false;
+  init_cb_.Run(streams);
   runs_.reset(new TrackRunIterator(moov_.get()));
   RCHECK(runs_->Init());
   ChangeState(kEmittingSamples);
@@ -604,15 +1059,50 @@ bool MP4MediaParser::ParseMoof(BoxReader* reader) {
   if (!runs_)
     runs_.reset(new TrackRunIterator(moov_.get()));
   RCHECK(runs_->Init(moof));
-  if (!FetchKeysIfNecessary(moof.pssh))
+  if (!StartKeyFetch(moof.pssh))
     return false;
   ChangeState(kEmittingSamples);
   return true;
 }
 
-bool MP4MediaParser::FetchKeysIfNecessary(
+bool MP4MediaParser::StartKeyFetch(
     const std::vector<ProtectionSystemSpecificHeader>& headers) {
-  if (headers.empty())
+  if (headers.empty() || !decryption_key_source_)
+    return true;
+  // The fetches run one at a time, in order.
+  if (!WaitForKeys())
+    return false;
+
+  key_fetch_pssh_boxes_.clear();
+  for (size_t i = 0; i < headers.size(); ++i)
+    key_fetch_pssh_boxes_.push_back(headers[i].raw_box);
+  keys_fetched_ = false;
+  // The fetch is cancelled with the job parsing the input.
+  key_fetch_thread_.reset(new ClosureThread(
+      "KeyFetchThread",
+      base::Bind(&MP4MediaParser::FetchKeys, base::Unretained(this),
+                 make_scoped_refptr(CancellationToken::Current()))));
+  key_fetch_thread_->Start();
+  return true;
+}
+
+void MP4MediaParser::FetchKeys(
+    const scoped_refptr<CancellationToken>& cancellation_token) {
+  ScopedCancellationToken scoped_token(cancellation_token.get());
+  keys_fetched_ = FetchKeysIfNecessary(key_fetch_pssh_boxes_);
+}
+
+bool MP4MediaParser::WaitForKeys() {
+  if (!key_fetch_thread_)
+    return true;
+  key_fetch_thread_->Join();
+  key_fetch_thread_.reset();
+  return keys_fetched_;
+}
+
+bool MP4MediaParser::FetchKeysIfNecessary(
+    const std::vector<std::vector<uint8_t> >& pssh_boxes) {
+  if (pssh_boxes.empty())
     return true;
 
   // An error will be returned later if the samples need to be decrypted.
@@ -620,9 +1110,9 @@ bool MP4MediaParser::FetchKeysIfNecessary(
     return true;
 
   Status status;
-  for (std::vector<ProtectionSystemSpecificHeader>::const_iterator iter =
-           headers.begin(); iter != headers.end(); ++iter) {
-    status = decryption_key_source_->FetchKeys(iter->raw_box);
+  for (std::vector<std::vector<uint8_t> >::const_iterator iter =
+           pssh_boxes.begin(); iter != pssh_boxes.end(); ++iter) {
+    status = decryption_key_source_->FetchKeys(*iter);
     if (!status.ok()) {
       // If there is an error, try using the next PSSH box and report if none
       // work.
@@ -644,6 +1134,12 @@ bool MP4MediaParser::FetchKeysIfNecessary(
 
 bool MP4MediaParser::EnqueueSample(bool* err) {
   if (!runs_->IsRunValid()) {
+    // All the samples of the fragment have been read.
+    if (!EmitPendingSamples()) {
+      *err = true;
+      return false;
+    }
+
     // Remain in kEnqueueingSamples state, discarding data, until the end of
     // the current 'mdat' box has been appended to the queue.
     if (!queue_.Trim(mdat_tail_))
@@ -679,8 +1175,10 @@ bool MP4MediaParser::EnqueueSample(bool* err) {
   // portion of the total system memory.
   if (runs_->AuxInfoNeedsToBeCached()) {
     queue_.PeekAt(runs_->aux_info_offset() + moof_head_, &buf, &buf_size);
-    if (buf_size < runs_->aux_info_size())
+    if (buf_size < runs_->aux_info_size()) {
+      *err = !EmitPendingSamples();
       return false;
+    }
     *err = !runs_->CacheAuxInfo(buf, buf_size);
     return !*err;
   }
@@ -692,29 +1190,75 @@ bool MP4MediaParser::EnqueueSample(bool* err) {
       LOG(ERROR) << "Incorrect sample offset " << sample_offset
                  << " < " << queue_.head();
       *err = true;
+      return false;
     }
+    // The samples received are not held while waiting for the rest of the
+    // 'mdat', so that a large fragment does not delay them.
+    *err = !EmitPendingSamples();
     return false;
   }
 
-  scoped_refptr<MediaSample> stream_sample(MediaSample::CopyFrom(
-      buf, runs_->sample_size(), runs_->is_keyframe()));
-  if (runs_->is_encrypted()) {
+  // Clear samples, and encrypted samples passed through, reference the queue
+  // buffer directly instead of being copied out; encrypted samples are
+  // decrypted in place, so they need their own copy anyway.
+  const bool passthrough =
+      runs_->is_encrypted() && FLAGS_mp4_encryption_passthrough;
+  const bool decrypt = runs_->is_encrypted() && !passthrough;
+  scoped_refptr<MediaSample> stream_sample(
+      decrypt || runs_->sample_size() == 0
+          ? MediaSample::CopyFrom(buf, runs_->sample_size(), NULL, 0,
+                                  runs_->is_keyframe(),
+                                  sample_buffer_pool_.get())
+          : MediaSample::CreateFromSharedBuffer(queue_.shared_buffer(), buf,
+                                                runs_->sample_size(),
+                                                runs_->is_keyframe()));
+  scoped_ptr<DecryptConfig> decrypt_config;
+  if (passthrough) {
+    decrypt_config = runs_->GetDecryptConfig();
+    if (!decrypt_config) {
+      *err = true;
+      LOG(ERROR) << "Cannot pass encrypted samples through.";
+      return false;
+    }
+    stream_sample->set_passthrough_encryption(decrypt_config.Pass());
+  } else if (decrypt) {
     if (!decryptor_source_) {
       *err = true;
       LOG(ERROR) << "Encrypted media sample encountered, but decryption is not "
                     "enabled";
       return false;
     }
+    if (!WaitForKeys()) {
+      *err = true;
+      return false;
+    }
 
-    scoped_ptr<DecryptConfig> decrypt_config = runs_->GetDecryptConfig();
-    if (!decrypt_config ||
-        !decryptor_source_->DecryptSampleBuffer(decrypt_config.get(),
-                                                stream_sample->writable_data(),
-                                                stream_sample->data_size())) {
+    decrypt_config = runs_->GetDecryptConfig();
+    if (!decrypt_config) {
       *err = true;
       LOG(ERROR) << "Cannot decrypt samples.";
       return false;
     }
+    // With fused re-keying, the sample is decrypted by the muxer, if it is
+    // not re-keyed. With parallel decryption, the sample is decrypted with
+    // the other samples of the fragment in EmitPendingSamples().
+    if (FLAGS_mp4_fused_rekey) {
+      if (!decryptor_source_->DeferSampleDecryption(decrypt_config.Pass(),
+                                                    stream_sample.get())) {
+        *err = true;
+        LOG(ERROR) << "Cannot decrypt samples.";
+        return false;
+      }
+    } else if (!decryptor_source_->parallel_decryption_enabled()) {
+      if (!decryptor_source_->DecryptSampleBuffer(
+              decrypt_config.get(), stream_sample->writable_data(),
+              stream_sample->data_size())) {
+        *err = true;
+        LOG(ERROR) << "Cannot decrypt samples.";
+        return false;
+      }
+      decrypt_config.reset();
+    }
   }
 
   stream_sample->set_dts(runs_->dts());
@@ -728,7 +1272,19 @@ bool MP4MediaParser::EnqueueSample(bool* err) {
            << ", cts=" << runs_->cts()
            << ", size=" << runs_->sample_size();
 
-  if (!new_sample_cb_.Run(runs_->track_id(), stream_sample)) {
+  if (decrypt_config || !pending_samples_.empty()) {
+    // Queued behind the samples waiting for decryption to keep the order.
+    PendingSample* pending_sample = new PendingSample;
+    pending_sample->track_id = runs_->track_id();
+    pending_sample->sample = stream_sample;
+    pending_sample->decrypt_config = decrypt_config.Pass();
+    pending_samples_.push_back(pending_sample);
+    if (pending_samples_.size() >= kMaxPendingSamples &&
+        !EmitPendingSamples()) {
+      *err = true;
+      return false;
+    }
+  } else if (!new_sample_cb_.Run(runs_->track_id(), stream_sample)) {
     *err = true;
     LOG(ERROR) << "Failed to process the sample.";
     return false;
@@ -738,6 +1294,39 @@ bool MP4MediaParser::EnqueueSample(bool* err) {
   return true;
 }
 
+bool MP4MediaParser::EmitPendingSamples() {
+  if (pending_samples_.empty())
+    return true;
+
+  std::vector<DecryptorSource::EncryptedBuffer> buffers;
+  for (const PendingSample* pending_sample : pending_samples_) {
+    if (!pending_sample->decrypt_config)
+      continue;
+    const DecryptorSource::EncryptedBuffer buffer = {
+        pending_sample->decrypt_config.get(),
+        pending_sample->sample->writable_data(),
+        pending_sample->sample->data_size()};
+    buffers.push_back(buffer);
+  }
+  if (!decryptor_source_->DecryptSampleBuffers(buffers)) {
+    LOG(ERROR) << "Cannot decrypt samples.";
+    STLDeleteElements(&pending_samples_);
+    return false;
+  }
+
+  bool result = true;
+  for (const PendingSample* pending_sample : pending_samples_) {
+    if (!new_sample_cb_.Run(pending_sample->track_id,
+                            pending_sample->sample)) {
+      LOG(ERROR) << "Failed to process the sample.";
+      result = false;
+      break;
+    }
+  }
+  STLDeleteElements(&pending_samples_);
+  return result;
+}
+
 bool MP4MediaParser::ReadAndDiscardMDATsUntil(const int64_t offset) {
   bool err = false;
   while (mdat_tail_ < offset) {
@@ -10,6 +10,7 @@
 #include <stdint.h>
 
 #include <map>
+#include <set>
 #include <vector>
 
 #include "packager/base/callback_forward.h"
@@ -20,9 +21,15 @@
 #include "packager/media/base/decryptor_source.h"
 #include "packager/media/base/media_parser.h"
 #include "packager/media/base/offset_byte_queue.h"
+#include "packager/media/base/sample_buffer_pool.h"
+#include "packager/media/file/file_closer.h"
 
 namespace edash_packager {
 namespace media {
+
+class CancellationToken;
+class ClosureThread;
+
 namespace mp4 {
 
 class BoxReader;
@@ -42,6 +49,8 @@ class MP4MediaParser : public MediaParser {
             KeySource* decryption_key_source) override;
   bool Flush() override WARN_UNUSED_RESULT;
   bool Parse(const uint8_t* buf, int size) override WARN_UNUSED_RESULT;
+  void SetInputBuffer(
+      const scoped_refptr<SharedBuffer>& input_buffer) override;
   /// @}
 
   /// Handles ISO-BMFF containers which have the 'moov' box trailing the
@@ -52,7 +61,80 @@ class MP4MediaParser : public MediaParser {
   /// @return true if successful, false otherwise.
   bool LoadMoov(const std::string& file_path);
 
+  /// Same as above, but for an input held in memory, e.g. a memory mapped
+  /// file. The box headers are visited by random access and the 'moov' box is
+  /// parsed in place.
+  /// @param input holds the whole media file.
+  /// @return true if successful, false otherwise.
+  bool LoadMoov(const SharedBuffer& input);
+
+  /// Sets up random access parsing of a non-fragmented file. The 'moov' box
+  /// is located and parsed wherever it is in the file, and the samples are
+  /// then read by offset through ReadRandomAccessSamples(), using the sample
+  /// tables, instead of being streamed through Parse().
+  /// @param file_path is the path to the media file to be parsed. The file
+  ///        must be seekable.
+  /// @return true if the file can be parsed by random access. Otherwise the
+  ///         file should be streamed through Parse() as usual. This is the
+  ///         case for fragmented files, whose 'moov' box is parsed anyway.
+  bool InitRandomAccess(const std::string& file_path);
+
+  /// The 'moov' box of a file and its position in the file.
+  struct MoovBox {
+    MoovBox() : offset(0) {}
+
+    uint64_t offset;
+    std::vector<uint8_t> data;
+  };
+
+  /// Same as above, with the 'moov' box known in advance, e.g. from a
+  /// MediaIndexCache, which saves locating and reading it.
+  /// @param moov_box is the 'moov' box of the file. If it is empty, the box
+  ///        is read from the file, and is returned in it on success.
+  bool InitRandomAccess(const std::string& file_path, MoovBox* moov_box);
+
+  /// Selects the tracks to read by random access. The samples of the other
+  /// tracks are not read at all. Must be called after InitRandomAccess()
+  /// succeeded and before ReadRandomAccessSamples().
+  /// @param track_ids contains the ids of the tracks to read.
+  /// @return true on success, false otherwise.
+  bool SelectRandomAccessTracks(const std::set<uint32_t>& track_ids);
+
+  /// Reads the next samples of the selected tracks by offset, interleaving
+  /// the tracks by decoding time, and emits them through the NewSampleCB.
+  /// Samples read together from the same chunk share a single buffer.
+  /// @param max_samples is the maximum number of samples to read.
+  /// @param end_of_stream is set to true if all the samples have been read.
+  /// @return true on success, false otherwise.
+  bool ReadRandomAccessSamples(size_t max_samples, bool* end_of_stream);
+
+  /// Restricts random access parsing to the samples within a time range. The
+  /// samples outside of the range are not read. Must be called after
+  /// InitRandomAccess() succeeded and before ReadRandomAccessSamples().
+  /// @param start is the start of the range, inclusive.
+  /// @param end is the end of the range, exclusive, or
+  ///        std::numeric_limits<int64_t>::max() to read to the end.
+  /// @param timescale is the timescale of @a start and @a end. A sample is in
+  ///        the range if its decoding time is.
+  void SetRandomAccessTimeRange(int64_t start, int64_t end, uint32_t timescale);
+
+  /// Gets the decoding times of the key frames of a track from the sample
+  /// tables. Requires InitRandomAccess() to have succeeded.
+  /// @param track_id is the id of the track.
+  /// @param[out] key_frame_times receives the decoding times, in the
+  ///             timescale of the track.
+  /// @return true on success, false otherwise.
+  bool GetKeyFrameTimes(uint32_t track_id,
+                        std::vector<int64_t>* key_frame_times);
+
  private:
+  // Locates the 'moov' box of |file| and reads it in |moov_box|.
+  bool ReadMoovBox(File* file,
+                   const std::string& file_path,
+                   MoovBox* moov_box);
+  struct PendingSample;
+  struct RandomAccessTrack;
+
   enum State {
     kWaitingForInit,
     kParsingBoxes,
@@ -64,8 +146,17 @@ class MP4MediaParser : public MediaParser {
   bool ParseMoov(mp4::BoxReader* reader);
   bool ParseMoof(mp4::BoxReader* reader);
 
-  bool FetchKeysIfNecessary(
+  // Starts fetching the keys of |headers| in the background. Returns false
+  // if a previous fetch failed.
+  bool StartKeyFetch(
       const std::vector<ProtectionSystemSpecificHeader>& headers);
+  // Runs in |key_fetch_thread_|.
+  void FetchKeys(const scoped_refptr<CancellationToken>& cancellation_token);
+  // Waits for the fetch started by StartKeyFetch(), if any. Returns false if
+  // it failed.
+  bool WaitForKeys();
+  bool FetchKeysIfNecessary(
+      const std::vector<std::vector<uint8_t> >& pssh_boxes);
 
   // To retain proper framing, each 'mdat' box must be read; to limit memory
   // usage, the box's data needs to be discarded incrementally as frames are
@@ -80,6 +171,17 @@ class MP4MediaParser : public MediaParser {
   bool EmitConfigs();
 
   bool EnqueueSample(bool* err);
+  // Decrypts the samples queued by EnqueueSample() for parallel decryption
+  // and emits them in order.
+  bool EmitPendingSamples();
+
+  // Returns the selected track whose next sample has the smallest decoding
+  // time, or NULL if all the samples have been read.
+  RandomAccessTrack* NextRandomAccessTrack();
+  // Reads and emits the next sample of |track|.
+  bool ReadRandomAccessSample(RandomAccessTrack* track);
+  // Reads |size| bytes at |offset| of |random_access_file_| into |data|.
+  bool ReadAt(int64_t offset, uint8_t* data, int64_t size);
 
   void Reset();
 
@@ -103,6 +205,30 @@ class MP4MediaParser : public MediaParser {
 
   scoped_ptr<Movie> moov_;
   scoped_ptr<TrackRunIterator> runs_;
+  // Samples read from the current fragment waiting to be decrypted together,
+  // if parallel decryption is enabled.
+  std::vector<PendingSample*> pending_samples_;
+
+  // Random access parsing state, see InitRandomAccess().
+  scoped_ptr<File, FileCloser> random_access_file_;
+  // The current position in |random_access_file_|.
+  int64_t random_access_position_;
+  std::vector<RandomAccessTrack*> random_access_tracks_;
+  // Time range of the samples to read by random access, in
+  // |random_access_timescale_|. All the samples are read if the timescale is
+  // zero.
+  int64_t random_access_start_;
+  int64_t random_access_end_;
+  uint32_t random_access_timescale_;
+
+  // Recycles sample payload buffers across the samples emitted.
+  scoped_refptr<SampleBufferPool> sample_buffer_pool_;
+
+  // The keys of the 'pssh' boxes are fetched in |key_fetch_thread_| while
+  // parsing goes on, until the first encrypted sample needs them.
+  std::vector<std::vector<uint8_t> > key_fetch_pssh_boxes_;
+  bool keys_fetched_;
+  scoped_ptr<ClosureThread> key_fetch_thread_;
 
   DISALLOW_COPY_AND_ASSIGN(MP4MediaParser);
 };
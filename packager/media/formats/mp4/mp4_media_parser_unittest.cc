@@ -4,11 +4,16 @@
 // license that can be found in the LICENSE file or at
 // https://developers.google.com/open-source/licenses/bsd
 
+#include <gflags/gflags.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <limits>
+
 #include "packager/base/bind.h"
 #include "packager/base/logging.h"
+#include "packager/media/base/decrypt_config.h"
 #include "packager/media/base/fixed_key_source.h"
 #include "packager/media/base/media_sample.h"
 #include "packager/media/base/stream_info.h"
@@ -21,6 +26,9 @@ using ::testing::DoAll;
 using ::testing::Return;
 using ::testing::SetArgPointee;
 
+DECLARE_int32(mp4_decryption_threads);
+DECLARE_bool(mp4_encryption_passthrough);
+
 namespace edash_packager {
 namespace media {
 
@@ -41,7 +49,8 @@ namespace mp4 {
 
 class MP4MediaParserTest : public testing::Test {
  public:
-  MP4MediaParserTest() : num_streams_(0), num_samples_(0) {
+  MP4MediaParserTest()
+      : num_streams_(0), num_samples_(0), num_passthrough_samples_(0) {
     parser_.reset(new MP4MediaParser());
   }
 
@@ -51,6 +60,11 @@ class MP4MediaParserTest : public testing::Test {
   scoped_ptr<MP4MediaParser> parser_;
   size_t num_streams_;
   size_t num_samples_;
+  // Number of the samples passed through encrypted.
+  size_t num_passthrough_samples_;
+  std::map<uint32_t, size_t> num_samples_per_track_;
+  // Decoding times of the samples in seconds, in the order they are emitted.
+  std::vector<double> sample_dts_in_seconds_;
 
   bool AppendData(const uint8_t* data, size_t length) {
     return parser_->Parse(data, length);
@@ -87,6 +101,11 @@ class MP4MediaParserTest : public testing::Test {
     DVLOG(2) << "Track Id: " << track_id << " "
              << sample->ToString();
     ++num_samples_;
+    ++num_samples_per_track_[track_id];
+    if (sample->passthrough_decrypt_config())
+      ++num_passthrough_samples_;
+    sample_dts_in_seconds_.push_back(static_cast<double>(sample->dts()) /
+                                     stream_map_[track_id]->time_scale());
     return true;
   }
 
@@ -104,6 +123,33 @@ class MP4MediaParserTest : public testing::Test {
     std::vector<uint8_t> buffer = ReadTestDataFile(filename);
     return AppendDataInPieces(buffer.data(), buffer.size(), append_bytes);
   }
+
+  // Reads the tracks in |track_ids|, or all the tracks if it is empty.
+  bool ParseMP4FileByRandomAccess(const std::string& filename,
+                                  const std::set<uint32_t>& track_ids) {
+    InitializeParser(NULL);
+    if (!parser_->InitRandomAccess(GetTestDataFilePath(filename).value()) ||
+        !parser_->SelectRandomAccessTracks(track_ids.empty() ? AllTrackIds()
+                                                             : track_ids)) {
+      return false;
+    }
+    const size_t kMaxSamples = 10;
+    bool end_of_stream = false;
+    while (!end_of_stream) {
+      if (!parser_->ReadRandomAccessSamples(kMaxSamples, &end_of_stream))
+        return false;
+    }
+    return true;
+  }
+
+  std::set<uint32_t> AllTrackIds() const {
+    std::set<uint32_t> track_ids;
+    for (StreamMap::const_iterator it = stream_map_.begin();
+         it != stream_map_.end(); ++it) {
+      track_ids.insert(it->first);
+    }
+    return track_ids;
+  }
 };
 
 TEST_F(MP4MediaParserTest, UnalignedAppend) {
@@ -227,6 +273,93 @@ TEST_F(MP4MediaParserTest, NON_FRAGMENTED_MP4) {
   EXPECT_EQ(201u, num_samples_);
 }
 
+TEST_F(MP4MediaParserTest, RandomAccessAllTracks) {
+  EXPECT_TRUE(
+      ParseMP4FileByRandomAccess("bear-640x360.mp4", std::set<uint32_t>()));
+  EXPECT_EQ(2u, num_streams_);
+  EXPECT_EQ(201u, num_samples_);
+  // The tracks are interleaved by decoding time.
+  EXPECT_TRUE(std::is_sorted(sample_dts_in_seconds_.begin(),
+                             sample_dts_in_seconds_.end()));
+}
+
+TEST_F(MP4MediaParserTest, RandomAccessSingleTrack) {
+  EXPECT_TRUE(ParseMP4File("bear-640x360.mp4", 512));
+  const std::map<uint32_t, size_t> expected_samples_per_track =
+      num_samples_per_track_;
+  ASSERT_EQ(2u, expected_samples_per_track.size());
+  const uint32_t kTrackId = expected_samples_per_track.begin()->first;
+
+  parser_.reset(new MP4MediaParser());
+  num_samples_per_track_.clear();
+  std::set<uint32_t> track_ids;
+  track_ids.insert(kTrackId);
+  EXPECT_TRUE(ParseMP4FileByRandomAccess("bear-640x360.mp4", track_ids));
+  EXPECT_EQ(2u, num_streams_);
+  ASSERT_EQ(1u, num_samples_per_track_.size());
+  EXPECT_EQ(expected_samples_per_track.begin()->second,
+            num_samples_per_track_[kTrackId]);
+}
+
+TEST_F(MP4MediaParserTest, RandomAccessTrailingMoov) {
+  EXPECT_TRUE(ParseMP4FileByRandomAccess("bear-640x360-trailing-moov.mp4",
+                                         std::set<uint32_t>()));
+  EXPECT_EQ(2u, num_streams_);
+  EXPECT_EQ(201u, num_samples_);
+}
+
+TEST_F(MP4MediaParserTest, RandomAccessTimeRanges) {
+  InitializeParser(NULL);
+  const std::string file_path =
+      GetTestDataFilePath("bear-640x360.mp4").value();
+  ASSERT_TRUE(parser_->InitRandomAccess(file_path));
+  uint32_t video_track_id = 0;
+  for (StreamMap::const_iterator it = stream_map_.begin();
+       it != stream_map_.end(); ++it) {
+    if (it->second->stream_type() == kStreamVideo)
+      video_track_id = it->first;
+  }
+  ASSERT_NE(0u, video_track_id);
+  const uint32_t timescale = stream_map_[video_track_id]->time_scale();
+  std::vector<int64_t> key_frame_times;
+  ASSERT_TRUE(parser_->GetKeyFrameTimes(video_track_id, &key_frame_times));
+  ASSERT_LT(1u, key_frame_times.size());
+  EXPECT_TRUE(
+      std::is_sorted(key_frame_times.begin(), key_frame_times.end()));
+
+  // Split the file at the second key frame. The two ranges make up the file.
+  const int64_t kEnd = std::numeric_limits<int64_t>::max();
+  const int64_t split_time = key_frame_times[1];
+  const int64_t range_starts[] = {0, split_time};
+  const int64_t range_ends[] = {split_time, kEnd};
+  size_t total_samples = 0;
+  for (size_t i = 0; i < arraysize(range_starts); ++i) {
+    parser_.reset(new MP4MediaParser());
+    InitializeParser(NULL);
+    ASSERT_TRUE(parser_->InitRandomAccess(file_path));
+    ASSERT_TRUE(parser_->SelectRandomAccessTracks(AllTrackIds()));
+    parser_->SetRandomAccessTimeRange(range_starts[i], range_ends[i],
+                                      timescale);
+    bool end_of_stream = false;
+    while (!end_of_stream)
+      ASSERT_TRUE(parser_->ReadRandomAccessSamples(10, &end_of_stream));
+    EXPECT_LT(0u, num_samples_);
+    total_samples += num_samples_;
+  }
+  EXPECT_EQ(201u, total_samples);
+}
+
+TEST_F(MP4MediaParserTest, RandomAccessFragmentedFileIsStreamed) {
+  InitializeParser(NULL);
+  EXPECT_FALSE(parser_->InitRandomAccess(
+      GetTestDataFilePath("bear-640x360-av_frag.mp4").value()));
+  // The 'moov' box is parsed anyway; the fragments are streamed.
+  EXPECT_EQ(2u, num_streams_);
+  std::vector<uint8_t> buffer = ReadTestDataFile("bear-640x360-av_frag.mp4");
+  EXPECT_TRUE(AppendDataInPieces(buffer.data(), buffer.size(), 512));
+  EXPECT_EQ(201u, num_samples_);
+}
+
 TEST_F(MP4MediaParserTest, CencWithoutDecryptionSource) {
   // Parsing should fail but it will get the streams successfully.
   EXPECT_FALSE(ParseMP4File("bear-640x360-v_frag-cenc-aux.mp4", 512));
@@ -281,6 +414,74 @@ TEST_F(MP4MediaParserTest, CencWithDecryptionSourceAndSenc) {
   EXPECT_EQ(82u, num_samples_);
 }
 
+TEST_F(MP4MediaParserTest, CencPartialMdatWithParallelDecryption) {
+  google::FlagSaver flag_saver;
+  FLAGS_mp4_decryption_threads = 2;
+
+  MockKeySource mock_key_source;
+  EXPECT_CALL(mock_key_source, FetchKeys(_)).WillOnce(Return(Status::OK));
+
+  EncryptionKey encryption_key;
+  encryption_key.key.assign(kKey, kKey + strlen(kKey));
+  EXPECT_CALL(mock_key_source,
+              GetKey(std::vector<uint8_t>(kKeyId, kKeyId + strlen(kKeyId)), _))
+      .WillOnce(DoAll(SetArgPointee<1>(encryption_key), Return(Status::OK)));
+
+  InitializeParser(&mock_key_source);
+
+  // The samples received are emitted before the end of the first 'mdat',
+  // which spans [2838, 279399).
+  std::vector<uint8_t> buffer =
+      ReadTestDataFile("bear-640x360-v_frag-cenc-aux.mp4");
+  const int kMiddleOfFirstMdatOffset = 140000;
+  EXPECT_TRUE(
+      AppendDataInPieces(buffer.data(), kMiddleOfFirstMdatOffset, 512));
+  EXPECT_EQ(1u, num_streams_);
+  EXPECT_LT(0u, num_samples_);
+
+  EXPECT_TRUE(AppendDataInPieces(buffer.data() + kMiddleOfFirstMdatOffset,
+                                 buffer.size() - kMiddleOfFirstMdatOffset,
+                                 512));
+  EXPECT_EQ(82u, num_samples_);
+}
+
+TEST_F(MP4MediaParserTest, CencKeyFetchFailure) {
+  MockKeySource mock_key_source;
+  EXPECT_CALL(mock_key_source, FetchKeys(_))
+      .WillOnce(Return(Status(error::SERVER_ERROR, "")));
+
+  InitializeParser(&mock_key_source);
+
+  // The keys are fetched in the background: the tracks are set up, and the
+  // failure is only reported when the first sample needs to be decrypted.
+  std::vector<uint8_t> buffer =
+      ReadTestDataFile("bear-640x360-v_frag-cenc-senc.mp4");
+  EXPECT_FALSE(AppendDataInPieces(buffer.data(), buffer.size(), 512));
+  EXPECT_EQ(1u, num_streams_);
+  EXPECT_EQ(0u, num_samples_);
+}
+
+TEST_F(MP4MediaParserTest, CencEncryptionPassthrough) {
+  google::FlagSaver flag_saver;
+  FLAGS_mp4_encryption_passthrough = true;
+  // No decryption key source is needed.
+  InitializeParser(NULL);
+
+  std::vector<uint8_t> buffer =
+      ReadTestDataFile("bear-640x360-v_frag-cenc-aux.mp4");
+  EXPECT_TRUE(AppendDataInPieces(buffer.data(), buffer.size(), 512));
+  EXPECT_EQ(1u, num_streams_);
+  EXPECT_EQ(82u, num_samples_);
+  EXPECT_EQ(82u, num_passthrough_samples_);
+
+  ASSERT_EQ(1u, stream_map_.size());
+  const StreamInfo& stream_info = *stream_map_.begin()->second;
+  ASSERT_TRUE(stream_info.has_encryption_config());
+  EXPECT_EQ(FOURCC_cenc, stream_info.encryption_config().protection_scheme);
+  EXPECT_EQ(std::vector<uint8_t>(kKeyId, kKeyId + strlen(kKeyId)),
+            stream_info.encryption_config().key_id);
+}
+
 }  // namespace mp4
 }  // namespace media
 }  // namespace edash_packager
@@ -92,6 +92,13 @@ MP4Muxer::~MP4Muxer() {}
 Status MP4Muxer::Initialize() {
   DCHECK(!streams().empty());
 
+  if (options().streaming_output &&
+      (options().single_segment || !options().segment_template.empty())) {
+    return Status(error::INVALID_ARGUMENT,
+                  "Streaming output requires multi-segment output without "
+                  "segment template.");
+  }
+
   scoped_ptr<FileType> ftyp(new FileType);
   scoped_ptr<Movie> moov(new Movie);
 
@@ -152,7 +159,8 @@ Status MP4Muxer::Initialize() {
   const Status segmenter_initialized = segmenter_->Initialize(
       streams(), muxer_listener(), progress_listener(), encryption_key_source(),
       max_sd_pixels(), clear_lead_in_seconds(),
-      crypto_period_duration_in_seconds(), protection_scheme());
+      crypto_period_duration_in_seconds(), protection_scheme(),
+      crypto_context_cache(), key_rotation_schedule());
 
   if (!segmenter_initialized.ok())
     return segmenter_initialized;
@@ -179,6 +187,19 @@ Status MP4Muxer::DoAddSample(const MediaStream* stream,
   return segmenter_->AddSample(stream, sample);
 }
 
+void MP4Muxer::DoAddTimedMetadata(const TimedMetadataEvent& event) {
+  DCHECK(segmenter_);
+  segmenter_->AddTimedMetadata(event);
+}
+
+bool MP4Muxer::AcceptsPendingDecryption() const {
+  return true;
+}
+
+bool MP4Muxer::AcceptsEncryptionPassthrough() const {
+  return true;
+}
+
 void MP4Muxer::InitializeTrak(const StreamInfo* info, Track* trak) {
   int64_t now = IsoTimeNow();
   trak->header.creation_time = now;
@@ -383,9 +404,16 @@ void MP4Muxer::FireOnMediaEndEvent() {
 
   const float duration_seconds = static_cast<float>(segmenter_->GetDuration());
 
+  // The init segment may be written by another muxer packaging a different
+  // range of the same input, in which case it may not exist yet.
+  const bool has_init_segment =
+      options().single_segment || options().write_init_segment;
+  // The size of a streamed output, e.g. a pipe, is unknown.
+  const bool has_file_size = has_init_segment && !options().streaming_output;
   const int64_t file_size =
-      File::GetFileSize(options().output_file_name.c_str());
-  if (file_size <= 0) {
+      has_file_size ? File::GetFileSize(options().output_file_name.c_str())
+                    : 0;
+  if (has_file_size && file_size <= 0) {
     LOG(ERROR) << "Invalid file size: " << file_size;
     return;
   }
@@ -39,6 +39,11 @@ class MP4Muxer : public Muxer {
   Status Finalize() override;
   Status DoAddSample(const MediaStream* stream,
                      scoped_refptr<MediaSample> sample) override;
+  void DoAddTimedMetadata(const TimedMetadataEvent& event) override;
+  // The fragmenters re-key or decrypt the samples pending decryption.
+  bool AcceptsPendingDecryption() const override;
+  // The fragmenters write the encryption of the samples passed through.
+  bool AcceptsEncryptionPassthrough() const override;
 
   // Generate Audio/Video Track box.
   void InitializeTrak(const StreamInfo* info, Track* trak);
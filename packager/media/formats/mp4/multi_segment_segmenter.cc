@@ -6,14 +6,19 @@
 
 #include "packager/media/formats/mp4/multi_segment_segmenter.h"
 
+#include "packager/base/bind.h"
 #include "packager/base/strings/string_number_conversions.h"
 #include "packager/base/strings/string_util.h"
+#include "packager/media/base/buffer_chain.h"
 #include "packager/media/base/buffer_writer.h"
 #include "packager/media/base/media_stream.h"
 #include "packager/media/base/muxer_options.h"
 #include "packager/media/base/muxer_util.h"
+#include "packager/media/base/segment_checksum.h"
 #include "packager/media/event/muxer_listener.h"
+#include "packager/media/file/checksum_file.h"
 #include "packager/media/file/file.h"
+#include "packager/media/file/output_deduplicator.h"
 #include "packager/media/formats/mp4/box_definitions.h"
 
 namespace edash_packager {
@@ -25,13 +30,30 @@ MultiSegmentSegmenter::MultiSegmentSegmenter(const MuxerOptions& options,
                                              scoped_ptr<Movie> moov)
     : Segmenter(options, ftyp.Pass(), moov.Pass()),
       styp_(new SegmentType),
-      num_segments_(0) {
+      segment_name_template_(options.segment_template),
+      num_segments_(options.first_segment_index),
+      chunked_segment_file_(NULL),
+      chunked_segment_size_(0) {
   // Use the same brands for styp as ftyp.
   styp_->major_brand = Segmenter::ftyp()->major_brand;
   styp_->compatible_brands = Segmenter::ftyp()->compatible_brands;
+  // The name of the next segment is known in advance only if it does not
+  // depend on its start time. A segment opened ahead could not be linked to
+  // a duplicate.
+  if (options.open_segments_ahead && !options.deduplicate_output &&
+      !options.segment_template.empty() &&
+      !segment_name_template_.has_time()) {
+    segment_open_ahead_.reset(new FileOpenAhead(base::Bind(
+        &ChecksumFile::OpenSegmentFile, options.segment_checksum)));
+  }
 }
 
-MultiSegmentSegmenter::~MultiSegmentSegmenter() {}
+MultiSegmentSegmenter::~MultiSegmentSegmenter() {
+  if (chunked_segment_file_ && !chunked_segment_file_->Close()) {
+    LOG(WARNING) << "Failed to close the file properly: "
+                 << chunked_segment_name_;
+  }
+}
 
 bool MultiSegmentSegmenter::GetInitRange(size_t* offset, size_t* size) {
   DLOG(INFO) << "MultiSegmentSegmenter outputs init segment: "
@@ -47,30 +69,80 @@ bool MultiSegmentSegmenter::GetIndexRange(size_t* offset, size_t* size) {
 Status MultiSegmentSegmenter::DoInitialize() {
   DCHECK(ftyp());
   DCHECK(moov());
+  if (options().streaming_output)
+    return OpenStreamingOutput();
+  if (!options().write_init_segment)
+    return Status::OK;
+  scoped_ptr<BufferWriter> buffer(new BufferWriter);
+  ftyp()->Write(buffer.get());
+  moov()->Write(buffer.get());
+
+  std::string digest;
+  if (options().deduplicate_output) {
+    SegmentChecksum sha256(SegmentChecksum::kSha256);
+    sha256.Update(buffer->Buffer(), buffer->Size());
+    digest = sha256.Finish();
+    if (OutputDeduplicator::GetInstance()->LinkToDuplicate(
+            digest, options().output_file_name)) {
+      return Status::OK;
+    }
+  }
+
   // Generate the output file with init segment.
   File* file = File::Open(options().output_file_name.c_str(), "w");
   if (file == NULL) {
     return Status(error::FILE_FAILURE,
                   "Cannot open file for write " + options().output_file_name);
   }
-  scoped_ptr<BufferWriter> buffer(new BufferWriter);
-  ftyp()->Write(buffer.get());
-  moov()->Write(buffer.get());
   Status status = buffer->WriteToFile(file);
   if (!file->Close()) {
     LOG(WARNING) << "Failed to close the file properly: "
                  << options().output_file_name;
   }
+  if (status.ok() && !digest.empty())
+    OutputDeduplicator::GetInstance()->AddFile(digest,
+                                               options().output_file_name);
   return status;
 }
 
 Status MultiSegmentSegmenter::DoFinalize() {
+  // The segment opened ahead turns out not to exist.
+  if (segment_open_ahead_)
+    segment_open_ahead_->Discard();
+  if (output_file_ && !output_file_.release()->Close()) {
+    return Status(error::FILE_FAILURE,
+                  "Cannot close file " + options().output_file_name);
+  }
   SetComplete();
   return Status::OK;
 }
 
+Status MultiSegmentSegmenter::OpenStreamingOutput() {
+  DCHECK(options().segment_template.empty());
+  output_file_.reset(File::Open(options().output_file_name.c_str(), "w"));
+  if (!output_file_) {
+    return Status(error::FILE_FAILURE,
+                  "Cannot open file for write " + options().output_file_name);
+  }
+  if (!options().write_init_segment)
+    return Status::OK;
+
+  BufferWriter buffer;
+  ftyp()->Write(&buffer);
+  moov()->Write(&buffer);
+  Status status = buffer.WriteToFile(output_file_.get());
+  if (status.ok() && !output_file_->Flush()) {
+    status = Status(error::FILE_FAILURE,
+                    "Cannot flush file " + options().output_file_name);
+  }
+  return status;
+}
+
 Status MultiSegmentSegmenter::DoFinalizeSegment() {
   DCHECK(sidx());
+  if (options().low_latency_chunked_output)
+    return FinalizeChunkedSegment();
+
   // earliest_presentation_time is the earliest presentation time of any
   // access unit in the reference stream in the first subsegment.
   // It will be re-calculated later when subsegments are finalized.
@@ -130,52 +202,235 @@ Status MultiSegmentSegmenter::DoFinalizeSegment() {
   return WriteSegment();
 }
 
-Status MultiSegmentSegmenter::WriteSegment() {
+Status MultiSegmentSegmenter::DoFinalizeFragment() {
+  if (!options().low_latency_chunked_output)
+    return Status::OK;
   DCHECK(sidx());
+  DCHECK(!sidx()->references.empty());
   DCHECK(fragment_buffer());
-  DCHECK(styp_);
 
+  // Every fragment is a chunk, which is written to the segment right away so
+  // that it can be delivered before the segment is complete.
   scoped_ptr<BufferWriter> buffer(new BufferWriter());
-  File* file;
-  std::string file_name;
-  if (options().segment_template.empty()) {
+  if (!chunked_segment_file_) {
+    Status status =
+        OpenSegmentFile(sidx()->references[0].earliest_presentation_time,
+                        buffer.get(), &chunked_segment_file_,
+                        &chunked_segment_name_);
+    if (!status.ok())
+      return status;
+    chunked_segment_size_ = 0;
+  }
+
+  // The fragment follows the 'styp' box if it starts the segment.
+  const uint64_t fragment_offset = chunked_segment_size_ + buffer->Size();
+  const size_t chunk_size = buffer->Size() + fragment_buffer()->Size();
+  DCHECK_NE(chunk_size, 0u);
+
+  Status status;
+  if (buffer->Size() > 0)
+    status = buffer->WriteToFile(chunked_segment_file_);
+  if (status.ok())
+    status = fragment_buffer()->WriteToFile(chunked_segment_file_);
+  if (!status.ok())
+    return status;
+  if (!chunked_segment_file_->Flush()) {
+    return Status(error::FILE_FAILURE,
+                  "Cannot flush file " + chunked_segment_name_);
+  }
+  chunked_segment_size_ += chunk_size;
+
+  ReportKeyFrames(fragment_offset);
+  if (muxer_listener()) {
+    const SegmentReference& chunk = sidx()->references.back();
+    muxer_listener()->OnNewChunk(chunked_segment_name_,
+                                 chunk.earliest_presentation_time,
+                                 chunk.subsegment_duration, chunk_size);
+  }
+  return Status::OK;
+}
+
+Status MultiSegmentSegmenter::OpenSegmentFile(
+    uint64_t earliest_presentation_time,
+    BufferWriter* buffer,
+    File** file,
+    std::string* file_name) {
+  DCHECK(buffer);
+  DCHECK(file);
+  DCHECK(file_name);
+  DCHECK(styp_);
+
+  if (output_file_) {
+    // The segments follow each other in the output file, which stays open.
+    *file_name = options().output_file_name;
+    *file = output_file_.get();
+  } else if (options().segment_template.empty()) {
     // Append the segment to output file if segment template is not specified.
-    file_name = options().output_file_name.c_str();
-    file = File::Open(file_name.c_str(), "a");
-    if (file == NULL) {
+    *file_name = options().output_file_name;
+    *file = File::Open(file_name->c_str(), "a");
+    if (*file == NULL) {
       return Status(
           error::FILE_FAILURE,
           "Cannot open file for append " + options().output_file_name);
     }
   } else {
-    file_name = GetSegmentName(options().segment_template,
-                               sidx()->earliest_presentation_time,
-                               num_segments_++, options().bandwidth);
-    file = File::Open(file_name.c_str(), "w");
-    if (file == NULL) {
+    segment_name_template_.Expand(earliest_presentation_time,
+                                  num_segments_++, options().bandwidth,
+                                  file_name);
+    if (segment_open_ahead_) {
+      *file = segment_open_ahead_->Open(*file_name);
+    } else {
+      *file = ChecksumFile::OpenSegmentFile(options().segment_checksum,
+                                            *file_name);
+    }
+    if (*file == NULL) {
       return Status(error::FILE_FAILURE,
-                    "Cannot open file for write " + file_name);
+                    "Cannot open file for write " + *file_name);
     }
-    styp_->Write(buffer.get());
+    if (segment_open_ahead_) {
+      std::string next_file_name;
+      segment_name_template_.Expand(0, num_segments_, options().bandwidth,
+                                    &next_file_name);
+      segment_open_ahead_->Start(next_file_name);
+    }
+    styp_->Write(buffer);
   }
+  return Status::OK;
+}
+
+Status MultiSegmentSegmenter::CloseSegmentFile(File* file,
+                                               const std::string& file_name,
+                                               std::string* checksum) {
+  DCHECK(file);
+  DCHECK(checksum);
+
+  checksum->clear();
+  if (file == output_file_.get()) {
+    // The segment is sent on, but the output file stays open.
+    return file->Flush() ? Status::OK
+                         : Status(error::FILE_FAILURE,
+                                  "Cannot flush file " + file_name);
+  }
+  // Only the segments which have their own file are opened with a checksum.
+  if (options().segment_checksum != SegmentChecksum::kNone &&
+      !options().segment_template.empty()) {
+    *checksum = static_cast<ChecksumFile*>(file)->FinishChecksum();
+  }
+  if (!file->Close())
+    LOG(WARNING) << "Failed to close the file properly: " << file_name;
+
+  if (options().write_segment_checksum_files && !checksum->empty() &&
+      !ChecksumFile::WriteSidecarFile(file_name, options().segment_checksum,
+                                      *checksum)) {
+    return Status(error::FILE_FAILURE,
+                  "Cannot write the checksum file of " + file_name);
+  }
+  return Status::OK;
+}
+
+Status MultiSegmentSegmenter::WriteSegment() {
+  DCHECK(sidx());
+  DCHECK(fragment_buffer());
+  if (options().deduplicate_output && !options().segment_template.empty())
+    return WriteDeduplicatedSegment();
+
+  scoped_ptr<BufferWriter> buffer(new BufferWriter());
+  File* file;
+  std::string file_name;
+  Status status = OpenSegmentFile(sidx()->earliest_presentation_time,
+                                  buffer.get(), &file, &file_name);
+  if (!status.ok())
+    return status;
 
   // If num_subsegments_per_sidx is negative, no SIDX box is generated.
   if (options().num_subsegments_per_sidx >= 0)
     sidx()->Write(buffer.get());
 
+  // The fragments follow the 'styp' and 'sidx' boxes.
+  const uint64_t fragments_offset = buffer->Size();
   const size_t segment_size = buffer->Size() + fragment_buffer()->Size();
   DCHECK_NE(segment_size, 0u);
 
-  Status status = buffer->WriteToFile(file);
+  status = buffer->WriteToFile(file);
   if (status.ok())
     status = fragment_buffer()->WriteToFile(file);
 
-  if (!file->Close())
-    LOG(WARNING) << "Failed to close the file properly: " << file_name;
-
+  std::string checksum;
+  status.Update(CloseSegmentFile(file, file_name, &checksum));
   if (!status.ok())
     return status;
 
+  ReportSegment(file_name, fragments_offset, segment_size, checksum);
+  return Status::OK;
+}
+
+Status MultiSegmentSegmenter::WriteDeduplicatedSegment() {
+  DCHECK(sidx());
+  DCHECK(fragment_buffer());
+  DCHECK(!options().segment_template.empty());
+
+  // The whole segment is hashed before it is written, to find out whether an
+  // identical file exists.
+  scoped_ptr<BufferWriter> buffer(new BufferWriter());
+  styp_->Write(buffer.get());
+  if (options().num_subsegments_per_sidx >= 0)
+    sidx()->Write(buffer.get());
+  const uint64_t fragments_offset = buffer->Size();
+  const size_t segment_size = buffer->Size() + fragment_buffer()->Size();
+
+  SegmentChecksum sha256(SegmentChecksum::kSha256);
+  sha256.Update(buffer->Buffer(), buffer->Size());
+  fragment_buffer()->AddToChecksum(&sha256);
+  const std::string digest = sha256.Finish();
+
+  std::string checksum;
+  if (options().segment_checksum == SegmentChecksum::kSha256) {
+    checksum = digest;
+  } else if (options().segment_checksum != SegmentChecksum::kNone) {
+    SegmentChecksum segment_checksum(options().segment_checksum);
+    segment_checksum.Update(buffer->Buffer(), buffer->Size());
+    fragment_buffer()->AddToChecksum(&segment_checksum);
+    checksum = segment_checksum.Finish();
+  }
+
+  std::string file_name;
+  segment_name_template_.Expand(sidx()->earliest_presentation_time,
+                                num_segments_++, options().bandwidth,
+                                &file_name);
+  OutputDeduplicator* deduplicator = OutputDeduplicator::GetInstance();
+  if (deduplicator->LinkToDuplicate(digest, file_name)) {
+    fragment_buffer()->Clear();
+  } else {
+    File* file = File::Open(file_name.c_str(), "w");
+    if (file == NULL) {
+      return Status(error::FILE_FAILURE,
+                    "Cannot open file for write " + file_name);
+    }
+    Status status = buffer->WriteToFile(file);
+    if (status.ok())
+      status = fragment_buffer()->WriteToFile(file);
+    if (!file->Close())
+      LOG(WARNING) << "Failed to close the file properly: " << file_name;
+    if (!status.ok())
+      return status;
+    deduplicator->AddFile(digest, file_name);
+  }
+
+  if (options().write_segment_checksum_files && !checksum.empty() &&
+      !ChecksumFile::WriteSidecarFile(file_name, options().segment_checksum,
+                                      checksum)) {
+    return Status(error::FILE_FAILURE,
+                  "Cannot write the checksum file of " + file_name);
+  }
+
+  ReportSegment(file_name, fragments_offset, segment_size, checksum);
+  return Status::OK;
+}
+
+void MultiSegmentSegmenter::ReportSegment(const std::string& file_name,
+                                          uint64_t fragments_offset,
+                                          uint64_t segment_size,
+                                          const std::string& checksum) {
   uint64_t segment_duration = 0;
   // ISO/IEC 23009-1:2012: the value shall be identical to sum of the the
   // values of all Subsegment_duration fields in the first ‘sidx’ box.
@@ -183,13 +438,40 @@ Status MultiSegmentSegmenter::WriteSegment() {
     segment_duration += sidx()->references[i].subsegment_duration;
 
   UpdateProgress(segment_duration);
+  ReportKeyFrames(fragments_offset);
   if (muxer_listener()) {
     muxer_listener()->OnSampleDurationReady(sample_duration());
     muxer_listener()->OnNewSegment(file_name,
                                    sidx()->earliest_presentation_time,
-                                   segment_duration, segment_size);
+                                   segment_duration, segment_size, checksum);
   }
+}
+
+Status MultiSegmentSegmenter::FinalizeChunkedSegment() {
+  if (!chunked_segment_file_) {
+    // No fragment has been written to this segment.
+    return Status::OK;
+  }
+
+  File* file = chunked_segment_file_;
+  chunked_segment_file_ = NULL;
+  std::string checksum;
+  Status status = CloseSegmentFile(file, chunked_segment_name_, &checksum);
+  if (!status.ok())
+    return status;
+
+  uint64_t segment_duration = 0;
+  for (size_t i = 0; i < sidx()->references.size(); ++i)
+    segment_duration += sidx()->references[i].subsegment_duration;
 
+  UpdateProgress(segment_duration);
+  if (muxer_listener()) {
+    muxer_listener()->OnSampleDurationReady(sample_duration());
+    muxer_listener()->OnNewSegment(
+        chunked_segment_name_,
+        sidx()->references[0].earliest_presentation_time, segment_duration,
+        chunked_segment_size_, checksum);
+  }
   return Status::OK;
 }
 
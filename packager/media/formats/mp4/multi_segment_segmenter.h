@@ -7,6 +7,9 @@
 #ifndef MEDIA_FORMATS_MP4_MULTI_SEGMENT_SEGMENTER_H_
 #define MEDIA_FORMATS_MP4_MULTI_SEGMENT_SEGMENTER_H_
 
+#include "packager/media/base/muxer_util.h"
+#include "packager/media/file/file_closer.h"
+#include "packager/media/file/file_open_ahead.h"
 #include "packager/media/formats/mp4/segmenter.h"
 
 namespace edash_packager {
@@ -27,7 +30,11 @@ struct SegmentType;
 /// and yet meet SAP requirements. The generated segments are written to files
 /// defined by @b MuxerOptions.segment_template if specified; otherwise,
 /// the segments are appended to the main output file specified by @b
-/// MuxerOptions.output_file_name.
+/// MuxerOptions.output_file_name. If @b MuxerOptions.low_latency_chunked_output
+/// is set, every fragment is written to its segment as soon as it is
+/// complete, and no SIDX box is generated. If @b
+/// MuxerOptions.streaming_output is set, the main output file is kept open
+/// and written forward only.
 class MultiSegmentSegmenter : public Segmenter {
  public:
   MultiSegmentSegmenter(const MuxerOptions& options,
@@ -46,13 +53,60 @@ class MultiSegmentSegmenter : public Segmenter {
   Status DoInitialize() override;
   Status DoFinalize() override;
   Status DoFinalizeSegment() override;
+  Status DoFinalizeFragment() override;
+
+  // Open |output_file_| and write the init segment to it, for
+  // streaming_output.
+  Status OpenStreamingOutput();
+
+  // Open the file of the next segment, which starts at
+  // |earliest_presentation_time|. 'styp' is written to |buffer| if the
+  // segment has its own file.
+  Status OpenSegmentFile(uint64_t earliest_presentation_time,
+                         BufferWriter* buffer,
+                         File** file,
+                         std::string* file_name);
+
+  // Close |file|, opened by OpenSegmentFile() for segment |file_name|. Sets
+  // |checksum| to the checksum of the segment if it has one, which is also
+  // written to a sidecar file if write_segment_checksum_files is set.
+  Status CloseSegmentFile(File* file,
+                          const std::string& file_name,
+                          std::string* checksum);
 
   // Write segment to file.
   Status WriteSegment();
 
+  // Write the segment to its own file, or link the file to an identical one
+  // written before. Used if deduplicate_output is set.
+  Status WriteDeduplicatedSegment();
+
+  // Report the segment written to |file_name| to the muxer listener.
+  void ReportSegment(const std::string& file_name,
+                     uint64_t fragments_offset,
+                     uint64_t segment_size,
+                     const std::string& checksum);
+
+  // Close the segment whose fragments have been written as chunks.
+  Status FinalizeChunkedSegment();
+
   scoped_ptr<SegmentType> styp_;
+  // The segment template, parsed once.
+  SegmentNameTemplate segment_name_template_;
   uint32_t num_segments_;
 
+  // The main output file if streaming_output is set, open from the init
+  // segment to the last segment.
+  scoped_ptr<File, FileCloser> output_file_;
+
+  // The segment being written in chunks, if any.
+  File* chunked_segment_file_;
+  std::string chunked_segment_name_;
+  uint64_t chunked_segment_size_;
+
+  // Opens the file of the next segment ahead, if open_segments_ahead is set.
+  scoped_ptr<FileOpenAhead> segment_open_ahead_;
+
   DISALLOW_COPY_AND_ASSIGN(MultiSegmentSegmenter);
 };
 
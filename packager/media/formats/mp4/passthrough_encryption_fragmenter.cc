@@ -0,0 +1,152 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/formats/mp4/passthrough_encryption_fragmenter.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "packager/media/base/decrypt_config.h"
+#include "packager/media/base/media_sample.h"
+#include "packager/media/base/stream_info.h"
+#include "packager/media/formats/mp4/box_definitions.h"
+
+namespace edash_packager {
+namespace media {
+namespace mp4 {
+
+namespace {
+
+// At most two sample description entries, an encrypted entry and a clear
+// entry, are generated. The 1-based clear entry index is always 2.
+const uint32_t kClearSampleDescriptionIndex = 2;
+
+// Describes |size| clear bytes with subsamples, whose clear bytes are 16 bit.
+void AppendClearSubsamples(uint32_t size,
+                           std::vector<SubsampleEntry>* subsamples) {
+  do {
+    const uint16_t clear_bytes = std::min<uint32_t>(
+        size, std::numeric_limits<uint16_t>::max());
+    subsamples->push_back(SubsampleEntry(clear_bytes, 0));
+    size -= clear_bytes;
+  } while (size > 0);
+}
+
+}  // namespace
+
+PassthroughEncryptionFragmenter::PassthroughEncryptionFragmenter(
+    scoped_refptr<StreamInfo> info,
+    TrackFragment* traf)
+    : Fragmenter(info, traf),
+      per_sample_iv_size_(info->encryption_config().per_sample_iv_size),
+      key_id_(info->encryption_config().key_id),
+      has_encrypted_sample_(false) {
+  DCHECK(info->has_encryption_config());
+}
+
+PassthroughEncryptionFragmenter::~PassthroughEncryptionFragmenter() {}
+
+Status PassthroughEncryptionFragmenter::AddSample(
+    scoped_refptr<MediaSample> sample) {
+  DCHECK(sample);
+  if (!fragment_initialized()) {
+    Status status = InitializeFragment(sample->dts());
+    if (!status.ok())
+      return status;
+  }
+
+  SampleEncryptionEntry sample_encryption_entry;
+  const DecryptConfig* decrypt_config = sample->passthrough_decrypt_config();
+  if (decrypt_config) {
+    // The encryption parameters other than the per-sample ones are those of
+    // the sample entry.
+    if (decrypt_config->key_id() != key_id_) {
+      LOG(ERROR) << "Samples encrypted with a key other than the default "
+                    "key of the track cannot be passed through.";
+      return Status(error::UNIMPLEMENTED,
+                    "Key rotation is not supported with encryption "
+                    "pass-through.");
+    }
+    if (per_sample_iv_size_ > 0) {
+      if (decrypt_config->iv().size() != per_sample_iv_size_) {
+        LOG(ERROR) << "Unexpected IV size " << decrypt_config->iv().size()
+                   << ", expecting " << static_cast<int>(per_sample_iv_size_);
+        return Status(error::MUXER_FAILURE, "Unexpected IV size.");
+      }
+      sample_encryption_entry.initialization_vector = decrypt_config->iv();
+    }
+    sample_encryption_entry.subsamples = decrypt_config->subsamples();
+    has_encrypted_sample_ = true;
+  } else {
+    // A clear sample in a fragment with encrypted samples is described as
+    // clear subsamples.
+    sample_encryption_entry.initialization_vector.assign(per_sample_iv_size_,
+                                                         0);
+    AppendClearSubsamples(sample->data_size(),
+                          &sample_encryption_entry.subsamples);
+  }
+  traf()->sample_encryption.sample_encryption_entries.push_back(
+      sample_encryption_entry);
+  return Fragmenter::AddSample(sample);
+}
+
+Status PassthroughEncryptionFragmenter::InitializeFragment(
+    int64_t first_sample_dts) {
+  Status status = Fragmenter::InitializeFragment(first_sample_dts);
+  if (!status.ok())
+    return status;
+  traf()->auxiliary_size.sample_info_sizes.clear();
+  traf()->auxiliary_offset.offsets.clear();
+  traf()->sample_encryption.flags &= ~SampleEncryption::kUseSubsampleEncryption;
+  traf()->sample_encryption.sample_encryption_entries.clear();
+  has_encrypted_sample_ = false;
+  return Status::OK;
+}
+
+void PassthroughEncryptionFragmenter::FinalizeFragment() {
+  std::vector<SampleEncryptionEntry>& entries =
+      traf()->sample_encryption.sample_encryption_entries;
+  if (!has_encrypted_sample_) {
+    entries.clear();
+    traf()->header.sample_description_index = kClearSampleDescriptionIndex;
+    Fragmenter::FinalizeFragment();
+    return;
+  }
+
+  DCHECK_EQ(entries.size(), samples().size());
+  bool use_subsamples = false;
+  for (const SampleEncryptionEntry& entry : entries)
+    use_subsamples = use_subsamples || !entry.subsamples.empty();
+
+  SampleAuxiliaryInformationSize& saiz = traf()->auxiliary_size;
+  saiz.sample_count = entries.size();
+  if (use_subsamples) {
+    traf()->sample_encryption.flags |=
+        SampleEncryption::kUseSubsampleEncryption;
+    for (size_t i = 0; i < entries.size(); ++i) {
+      // A sample encrypted as a whole is a single encrypted subsample.
+      if (entries[i].subsamples.empty()) {
+        entries[i].subsamples.push_back(
+            SubsampleEntry(0, samples()[i]->data_size()));
+      }
+      saiz.sample_info_sizes.push_back(entries[i].ComputeSize());
+    }
+    if (!OptimizeSampleEntries(&saiz.sample_info_sizes,
+                               &saiz.default_sample_info_size)) {
+      saiz.default_sample_info_size = 0;
+    }
+  } else {
+    saiz.default_sample_info_size = per_sample_iv_size_;
+  }
+  traf()->sample_encryption.iv_size = per_sample_iv_size_;
+  // The offset will be adjusted in Segmenter after knowing moof size.
+  traf()->auxiliary_offset.offsets.push_back(0);
+  Fragmenter::FinalizeFragment();
+}
+
+}  // namespace mp4
+}  // namespace media
+}  // namespace edash_packager
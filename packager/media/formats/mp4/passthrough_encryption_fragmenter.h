@@ -0,0 +1,57 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_FORMATS_MP4_PASSTHROUGH_ENCRYPTION_FRAGMENTER_H_
+#define MEDIA_FORMATS_MP4_PASSTHROUGH_ENCRYPTION_FRAGMENTER_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "packager/media/formats/mp4/fragmenter.h"
+
+namespace edash_packager {
+namespace media {
+namespace mp4 {
+
+/// PassthroughEncryptionFragmenter generates MP4 fragments with the samples
+/// of a stream which is still encrypted, see
+/// StreamInfo::encryption_config(). The samples are written as they are,
+/// with their encryption parameters, without any crypto work, e.g. to
+/// re-fragment encrypted content. Fragments with encrypted samples are
+/// described by the first, encrypted, sample entry and get 'senc', 'saiz'
+/// and 'saio' boxes; fragments with clear samples only are described by the
+/// second, clear, sample entry.
+class PassthroughEncryptionFragmenter : public Fragmenter {
+ public:
+  /// @param info contains stream information. It must have an encryption
+  ///        config.
+  /// @param traf points to a TrackFragment box.
+  PassthroughEncryptionFragmenter(scoped_refptr<StreamInfo> info,
+                                  TrackFragment* traf);
+  ~PassthroughEncryptionFragmenter() override;
+
+  /// @name Fragmenter implementation overrides.
+  /// @{
+  Status AddSample(scoped_refptr<MediaSample> sample) override;
+  Status InitializeFragment(int64_t first_sample_dts) override;
+  void FinalizeFragment() override;
+  /// @}
+
+ private:
+  const uint8_t per_sample_iv_size_;
+  const std::vector<uint8_t> key_id_;
+  // Whether the current fragment has an encrypted sample.
+  bool has_encrypted_sample_;
+
+  DISALLOW_COPY_AND_ASSIGN(PassthroughEncryptionFragmenter);
+};
+
+}  // namespace mp4
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_FORMATS_MP4_PASSTHROUGH_ENCRYPTION_FRAGMENTER_H_
@@ -7,21 +7,29 @@
 #include "packager/media/formats/mp4/segmenter.h"
 
 #include <algorithm>
+#include <limits>
 
 #include "packager/base/logging.h"
 #include "packager/base/stl_util.h"
 #include "packager/media/base/aes_cryptor.h"
+#include "packager/media/base/buffer_chain.h"
 #include "packager/media/base/buffer_writer.h"
+#include "packager/media/base/crypto_context_cache.h"
+#include "packager/media/base/encryption_config.h"
+#include "packager/media/base/key_rotation_schedule.h"
 #include "packager/media/base/key_source.h"
 #include "packager/media/base/media_sample.h"
 #include "packager/media/base/media_stream.h"
 #include "packager/media/base/muxer_options.h"
 #include "packager/media/base/muxer_util.h"
+#include "packager/media/base/pipeline_metrics.h"
+#include "packager/media/base/timed_metadata.h"
 #include "packager/media/base/video_stream_info.h"
 #include "packager/media/event/muxer_listener.h"
 #include "packager/media/event/progress_listener.h"
 #include "packager/media/formats/mp4/box_definitions.h"
 #include "packager/media/formats/mp4/key_rotation_fragmenter.h"
+#include "packager/media/formats/mp4/passthrough_encryption_fragmenter.h"
 
 namespace edash_packager {
 namespace media {
@@ -37,6 +45,7 @@ const size_t kCencKeyIdSize = 16u;
 // The version of cenc implemented here. CENC 4.
 const int kCencSchemeVersion = 0x00010000;
 
+
 // The default KID for key rotation is all 0s.
 const uint8_t kKeyRotationDefaultKeyId[] = {
   0, 0, 0, 0, 0, 0, 0, 0,
@@ -46,6 +55,10 @@ const uint8_t kKeyRotationDefaultKeyId[] = {
 COMPILE_ASSERT(arraysize(kKeyRotationDefaultKeyId) == kCencKeyIdSize,
                cenc_key_id_must_be_size_16);
 
+// Maximum duration, in fragment durations, of the fragments merged together
+// while they are under the byte budget.
+const uint64_t kMaxMergedFragmentDurations = 4u;
+
 uint64_t Rescale(uint64_t time_in_old_scale,
                  uint32_t old_scale,
                  uint32_t new_scale) {
@@ -64,17 +77,9 @@ uint8_t GetSkipByteBlock(FourCC protection_scheme) {
              : 0;
 }
 
-void GenerateSinf(const EncryptionKey& encryption_key,
-                  FourCC old_type,
-                  FourCC protection_scheme,
-                  ProtectionSchemeInfo* sinf) {
-  sinf->format.format = old_type;
-
-  DCHECK_NE(protection_scheme, FOURCC_NULL);
-  sinf->type.type = protection_scheme;
-  sinf->type.version = kCencSchemeVersion;
-
-  auto& track_encryption = sinf->info.track_encryption;
+TrackEncryption MakeTrackEncryption(const EncryptionKey& encryption_key,
+                                    FourCC protection_scheme) {
+  TrackEncryption track_encryption;
   track_encryption.default_is_protected = 1;
   DCHECK(!encryption_key.iv.empty());
   if (protection_scheme == FOURCC_cbcs) {
@@ -90,10 +95,38 @@ void GenerateSinf(const EncryptionKey& encryption_key,
   track_encryption.default_skip_byte_block =
       GetSkipByteBlock(protection_scheme);
   track_encryption.default_kid = encryption_key.key_id;
+  return track_encryption;
+}
+
+// The track encryption of a stream passed through encrypted.
+TrackEncryption MakeTrackEncryption(
+    const EncryptionConfig& encryption_config) {
+  TrackEncryption track_encryption;
+  track_encryption.default_is_protected = 1;
+  track_encryption.default_per_sample_iv_size =
+      encryption_config.per_sample_iv_size;
+  track_encryption.default_constant_iv = encryption_config.constant_iv;
+  track_encryption.default_crypt_byte_block =
+      encryption_config.crypt_byte_block;
+  track_encryption.default_skip_byte_block = encryption_config.skip_byte_block;
+  track_encryption.default_kid = encryption_config.key_id;
+  return track_encryption;
+}
+
+void GenerateSinf(const TrackEncryption& track_encryption,
+                  FourCC old_type,
+                  FourCC protection_scheme,
+                  ProtectionSchemeInfo* sinf) {
+  sinf->format.format = old_type;
+
+  DCHECK_NE(protection_scheme, FOURCC_NULL);
+  sinf->type.type = protection_scheme;
+  sinf->type.version = kCencSchemeVersion;
+  sinf->info.track_encryption = track_encryption;
 }
 
-void GenerateEncryptedSampleEntry(const EncryptionKey& encryption_key,
-                                  double clear_lead_in_seconds,
+void GenerateEncryptedSampleEntry(const TrackEncryption& track_encryption,
+                                  bool add_clear_entry,
                                   FourCC protection_scheme,
                                   SampleDescription* description) {
   DCHECK(description);
@@ -101,24 +134,26 @@ void GenerateEncryptedSampleEntry(const EncryptionKey& encryption_key,
     DCHECK_EQ(1u, description->video_entries.size());
 
     // Add a second entry for clear content if needed.
-    if (clear_lead_in_seconds > 0)
+    if (add_clear_entry)
       description->video_entries.push_back(description->video_entries[0]);
 
     // Convert the first entry to an encrypted entry.
     VideoSampleEntry& entry = description->video_entries[0];
-    GenerateSinf(encryption_key, entry.format, protection_scheme, &entry.sinf);
+    GenerateSinf(track_encryption, entry.format, protection_scheme,
+                 &entry.sinf);
     entry.format = FOURCC_encv;
   } else {
     DCHECK_EQ(kAudio, description->type);
     DCHECK_EQ(1u, description->audio_entries.size());
 
     // Add a second entry for clear content if needed.
-    if (clear_lead_in_seconds > 0)
+    if (add_clear_entry)
       description->audio_entries.push_back(description->audio_entries[0]);
 
     // Convert the first entry to an encrypted entry.
     AudioSampleEntry& entry = description->audio_entries[0];
-    GenerateSinf(encryption_key, entry.format, protection_scheme, &entry.sinf);
+    GenerateSinf(track_encryption, entry.format, protection_scheme,
+                 &entry.sinf);
     entry.format = FOURCC_enca;
   }
 }
@@ -132,8 +167,9 @@ Segmenter::Segmenter(const MuxerOptions& options,
       ftyp_(ftyp.Pass()),
       moov_(moov.Pass()),
       moof_(new MovieFragment()),
-      fragment_buffer_(new BufferWriter()),
+      fragment_buffer_(new BufferChain()),
       sidx_(new SegmentIndex()),
+      report_key_frames_(false),
       muxer_listener_(NULL),
       progress_listener_(NULL),
       progress_target_(0),
@@ -149,7 +185,9 @@ Status Segmenter::Initialize(const std::vector<MediaStream*>& streams,
                              uint32_t max_sd_pixels,
                              double clear_lead_in_seconds,
                              double crypto_period_duration_in_seconds,
-                             FourCC protection_scheme) {
+                             FourCC protection_scheme,
+                             CryptoContextCache* crypto_context_cache,
+                             KeyRotationSchedule* key_rotation_schedule) {
   DCHECK_LT(0u, streams.size());
   muxer_listener_ = muxer_listener;
   progress_listener_ = progress_listener;
@@ -160,6 +198,18 @@ Status Segmenter::Initialize(const std::vector<MediaStream*>& streams,
   fragmenters_.resize(streams.size());
   const bool key_rotation_enabled = crypto_period_duration_in_seconds != 0;
   const bool kInitialEncryptionInfo = true;
+  const size_t num_encryption_threads =
+      std::max(options_.num_encryption_threads, 0);
+  if (encryption_key_source && !crypto_context_cache) {
+    own_crypto_context_cache_.reset(new CryptoContextCache);
+    crypto_context_cache = own_crypto_context_cache_.get();
+  }
+  if (encryption_key_source && key_rotation_enabled &&
+      !key_rotation_schedule) {
+    own_key_rotation_schedule_.reset(
+        new KeyRotationSchedule(encryption_key_source));
+    key_rotation_schedule = own_key_rotation_schedule_.get();
+  }
 
   for (uint32_t i = 0; i < streams.size(); ++i) {
     stream_map_[streams[i]] = i;
@@ -169,6 +219,13 @@ Status Segmenter::Initialize(const std::vector<MediaStream*>& streams,
       if (sidx_->reference_id == 0)
         sidx_->reference_id = i + 1;
     }
+    if (streams[i]->info()->has_encryption_config()) {
+      Status status = InitializePassthroughEncryption(
+          i, *streams[i], encryption_key_source != NULL);
+      if (!status.ok())
+        return status;
+      continue;
+    }
     if (!encryption_key_source) {
       fragmenters_[i] = new Fragmenter(streams[i]->info(), &moof_->tracks[i]);
       continue;
@@ -199,8 +256,9 @@ Status Segmenter::Initialize(const std::vector<MediaStream*>& streams,
                                         &encryption_key.iv)) {
         return Status(error::INTERNAL_ERROR, "Failed to generate random iv.");
       }
-      GenerateEncryptedSampleEntry(encryption_key, clear_lead_in_seconds,
-                                   local_protection_scheme, &description);
+      GenerateEncryptedSampleEntry(
+          MakeTrackEncryption(encryption_key, local_protection_scheme),
+          clear_lead_in_seconds > 0, local_protection_scheme, &description);
       if (muxer_listener_) {
         muxer_listener_->OnEncryptionInfoReady(
             kInitialEncryptionInfo, local_protection_scheme,
@@ -208,13 +266,16 @@ Status Segmenter::Initialize(const std::vector<MediaStream*>& streams,
             encryption_key.key_system_info);
       }
 
-      fragmenters_[i] = new KeyRotationFragmenter(
+      KeyRotationFragmenter* fragmenter = new KeyRotationFragmenter(
           moof_.get(), streams[i]->info(), &moof_->tracks[i],
-          encryption_key_source, track_type,
+          key_rotation_schedule, track_type,
           crypto_period_duration_in_seconds * streams[i]->info()->time_scale(),
           clear_lead_in_seconds * streams[i]->info()->time_scale(),
           local_protection_scheme, GetCryptByteBlock(local_protection_scheme),
-          GetSkipByteBlock(local_protection_scheme), muxer_listener_);
+          GetSkipByteBlock(local_protection_scheme), crypto_context_cache,
+          muxer_listener_);
+      fragmenter->EnableParallelEncryption(num_encryption_threads);
+      fragmenters_[i] = fragmenter;
       continue;
     }
 
@@ -230,8 +291,9 @@ Status Segmenter::Initialize(const std::vector<MediaStream*>& streams,
       }
     }
 
-    GenerateEncryptedSampleEntry(*encryption_key, clear_lead_in_seconds,
-                                 local_protection_scheme, &description);
+    GenerateEncryptedSampleEntry(
+        MakeTrackEncryption(*encryption_key, local_protection_scheme),
+        clear_lead_in_seconds > 0, local_protection_scheme, &description);
 
     if (moov_->pssh.empty()) {
       moov_->pssh.resize(encryption_key->key_system_info.size());
@@ -247,14 +309,18 @@ Status Segmenter::Initialize(const std::vector<MediaStream*>& streams,
       }
     }
 
-    fragmenters_[i] = new EncryptingFragmenter(
+    EncryptingFragmenter* fragmenter = new EncryptingFragmenter(
         streams[i]->info(), &moof_->tracks[i], encryption_key.Pass(),
         clear_lead_in_seconds * streams[i]->info()->time_scale(),
         local_protection_scheme, GetCryptByteBlock(local_protection_scheme),
-        GetSkipByteBlock(local_protection_scheme));
+        GetSkipByteBlock(local_protection_scheme), crypto_context_cache);
+    fragmenter->EnableParallelEncryption(num_encryption_threads);
+    fragmenters_[i] = fragmenter;
   }
 
-  // Choose the first stream if there is no VIDEO.
+  // Only video key frames are reported. Choose the first stream if there is
+  // no VIDEO.
+  report_key_frames_ = sidx_->reference_id != 0;
   if (sidx_->reference_id == 0)
     sidx_->reference_id = 1;
   sidx_->timescale = streams[GetReferenceStreamId()]->info()->time_scale();
@@ -272,18 +338,70 @@ Status Segmenter::Initialize(const std::vector<MediaStream*>& streams,
   moov_->metadata.id3v2.private_frame.owner =
       "https://github.com/google/edash-packager";
   moov_->metadata.id3v2.private_frame.value = options_.packager_version_string;
+
+  // The sample descriptions are final; they are serialized once for all the
+  // writes of the init segment.
+  for (Track& track : moov_->tracks)
+    track.media.information.sample_table.description.CacheSerializedEntries();
   return DoInitialize();
 }
 
-Status Segmenter::Finalize() {
-  for (std::vector<Fragmenter*>::iterator it = fragmenters_.begin();
-       it != fragmenters_.end();
-       ++it) {
-    Status status = FinalizeFragment(true, *it);
-    if (!status.ok())
-      return status;
+Status Segmenter::InitializePassthroughEncryption(uint32_t stream_id,
+                                                  const MediaStream& stream,
+                                                  bool encryption_enabled) {
+  if (encryption_enabled) {
+    LOG(ERROR) << "Streams passed through encrypted cannot be encrypted "
+                  "again.";
+    return Status(error::INVALID_ARGUMENT,
+                  "Encryption pass-through cannot be combined with "
+                  "encryption.");
+  }
+  const EncryptionConfig& encryption_config =
+      stream.info()->encryption_config();
+  SampleDescription& description =
+      moov_->tracks[stream_id].media.information.sample_table.description;
+  // Fragments with clear samples only, e.g. the clear lead of the input,
+  // are described by the clear entry.
+  const bool kAddClearEntry = true;
+  GenerateEncryptedSampleEntry(MakeTrackEncryption(encryption_config),
+                               kAddClearEntry,
+                               encryption_config.protection_scheme,
+                               &description);
+
+  // The PSSH boxes of the input, once each.
+  bool new_key_system_info = false;
+  for (const ProtectionSystemSpecificInfo& info :
+       encryption_config.key_system_info) {
+    ProtectionSystemSpecificHeader pssh;
+    pssh.raw_box = info.CreateBox();
+    bool found = false;
+    for (const ProtectionSystemSpecificHeader& moov_pssh : moov_->pssh)
+      found = found || moov_pssh.raw_box == pssh.raw_box;
+    if (!found) {
+      moov_->pssh.push_back(pssh);
+      new_key_system_info = true;
+    }
   }
 
+  if (muxer_listener_ &&
+      (new_key_system_info || encryption_config.key_system_info.empty())) {
+    const bool kInitialEncryptionInfo = true;
+    muxer_listener_->OnEncryptionInfoReady(
+        kInitialEncryptionInfo, encryption_config.protection_scheme,
+        encryption_config.key_id, encryption_config.constant_iv,
+        encryption_config.key_system_info);
+  }
+
+  fragmenters_[stream_id] = new PassthroughEncryptionFragmenter(
+      stream.info(), &moof_->tracks[stream_id]);
+  return Status::OK;
+}
+
+Status Segmenter::Finalize() {
+  Status status = FinalizeFragment(true);
+  if (!status.ok())
+    return status;
+
   // Set tracks and moov durations.
   // Note that the updated moov box will be written to output file for VOD case
   // only.
@@ -298,11 +416,13 @@ Status Segmenter::Finalize() {
   }
   moov_->extends.header.fragment_duration = moov_->header.duration;
 
+  ScopedStageTimer segment_write_timer(kSegmentWriteStage);
   return DoFinalize();
 }
 
 Status Segmenter::AddSample(const MediaStream* stream,
                             scoped_refptr<MediaSample> sample) {
+  ScopedStageTimer fragment_timer(kFragmentStage);
   // Find the fragmenter for this stream.
   DCHECK(stream);
   DCHECK(stream_map_.find(stream) != stream_map_.end());
@@ -315,30 +435,26 @@ Status Segmenter::AddSample(const MediaStream* stream,
         sample->duration();
   }
 
-  if (fragmenter->fragment_finalized()) {
-    return Status(error::FRAGMENT_FINALIZED,
-                  "Current fragment is finalized already.");
-  }
-
+  const uint32_t time_scale = moov_->tracks[stream_id].media.header.timescale;
   bool finalize_fragment = false;
-  if (fragmenter->fragment_duration() >=
-      options_.fragment_duration * stream->info()->time_scale()) {
-    if (sample->is_key_frame() || !options_.fragment_sap_aligned) {
-      finalize_fragment = true;
-    }
-  }
   bool finalize_segment = false;
-  if (segment_durations_[stream_id] >=
-      options_.segment_duration * stream->info()->time_scale()) {
-    if (sample->is_key_frame() || !options_.segment_sap_aligned) {
-      finalize_segment = true;
-      finalize_fragment = true;
+  if (stream_id == GetReferenceStreamId()) {
+    if (sample->is_key_frame() || !options_.fragment_sap_aligned)
+      finalize_fragment = IsFragmentComplete(*fragmenter, time_scale);
+    if (segment_durations_[stream_id] >=
+        options_.segment_duration * time_scale) {
+      if (sample->is_key_frame() || !options_.segment_sap_aligned) {
+        finalize_segment = true;
+        finalize_fragment = true;
+      }
     }
+  } else {
+    finalize_fragment = IsAheadOfReference(stream_id, time_scale);
   }
 
   Status status;
   if (finalize_fragment) {
-    status = FinalizeFragment(finalize_segment, fragmenter);
+    status = FinalizeFragment(finalize_segment);
     if (!status.ok())
       return status;
   }
@@ -384,13 +500,29 @@ void Segmenter::UpdateProgress(uint64_t progress) {
   }
 }
 
+void Segmenter::ReportKeyFrames(uint64_t fragment_buffer_offset) {
+  if (muxer_listener_) {
+    for (const KeyFrameInfo& key_frame : key_frame_infos_) {
+      muxer_listener_->OnKeyFrame(
+          key_frame.timestamp,
+          fragment_buffer_offset + key_frame.start_byte_offset,
+          key_frame.size);
+    }
+  }
+  key_frame_infos_.clear();
+}
+
 void Segmenter::SetComplete() {
   if (!progress_listener_) return;
   progress_listener_->OnProgress(1.0);
 }
 
 Status Segmenter::FinalizeSegment() {
-  Status status = DoFinalizeSegment();
+  Status status;
+  {
+    ScopedStageTimer segment_write_timer(kSegmentWriteStage);
+    status = DoFinalizeSegment();
+  }
 
   // Reset segment information to initial state.
   sidx_->references.clear();
@@ -406,26 +538,116 @@ uint32_t Segmenter::GetReferenceStreamId() {
   return sidx_->reference_id - 1;
 }
 
-Status Segmenter::FinalizeFragment(bool finalize_segment,
-                                   Fragmenter* fragmenter) {
-  fragmenter->FinalizeFragment();
+// Segments still end on segment_duration, so the byte budget only moves the
+// fragment boundaries within the segments, which stay aligned across the
+// renditions. Audio samples are all stream access points, so an audio
+// fragment over budget is split at the next sample.
+bool Segmenter::IsFragmentComplete(const Fragmenter& fragmenter,
+                                   uint32_t time_scale) const {
+  const uint64_t target_duration = options_.fragment_duration * time_scale;
+  const uint64_t max_bytes = options_.fragment_max_bytes;
+  if (max_bytes == 0)
+    return fragmenter.fragment_duration() >= target_duration;
+
+  if (fragmenter.data_size() >= max_bytes)
+    return true;
+  if (fragmenter.fragment_duration() < target_duration)
+    return false;
+  // Merge with the next fragment as long as a fragment of the same size
+  // still fits in the budget, for a bounded number of fragment durations.
+  return fragmenter.data_size() * 2 > max_bytes ||
+         fragmenter.fragment_duration() >=
+             kMaxMergedFragmentDurations * target_duration;
+}
+
+// A track a fragment duration ahead of the reference track, e.g. because of
+// the interleaving of the input or because the reference track ended, ends
+// the fragment without waiting for a key frame of the reference track, at the
+// cost of a fragment of the reference track which may not start with one.
+bool Segmenter::IsAheadOfReference(uint32_t stream_id,
+                                   uint32_t time_scale) const {
+  if (fragmenters_[stream_id]->fragment_duration() <
+      options_.fragment_duration * time_scale) {
+    return false;
+  }
+  const Track& reference_track = moov_->tracks[sidx_->reference_id - 1];
+  const double reference_duration =
+      static_cast<double>(reference_track.media.header.duration) /
+      reference_track.media.header.timescale;
+  const double duration =
+      static_cast<double>(moov_->tracks[stream_id].media.header.duration) /
+      time_scale;
+  return duration >= reference_duration + options_.fragment_duration;
+}
+
+void Segmenter::AddTimedMetadata(const TimedMetadataEvent& event) {
+  if (event.timescale == 0 || event.presentation_time < 0) {
+    LOG(WARNING) << "Dropping the timed metadata event " << event.id
+                 << " of " << event.scheme_id_uri << " without a valid time.";
+    return;
+  }
+  pending_timed_metadata_.push_back(event);
+}
+
+void Segmenter::WriteTimedMetadata(uint64_t end_time, BufferWriter* buffer) {
+  std::vector<TimedMetadataEvent>::iterator it =
+      pending_timed_metadata_.begin();
+  while (it != pending_timed_metadata_.end()) {
+    if (Rescale(it->presentation_time, it->timescale, sidx_->timescale) >=
+        end_time) {
+      ++it;
+      continue;
+    }
+    // The event keeps its own timescale and absolute time, so that it is
+    // not rounded.
+    DASHEventMessageBox emsg;
+    emsg.scheme_id_uri = it->scheme_id_uri;
+    emsg.value = it->value;
+    emsg.timescale = it->timescale;
+    emsg.presentation_time = it->presentation_time;
+    emsg.event_duration =
+        std::min<uint64_t>(it->duration, std::numeric_limits<uint32_t>::max());
+    emsg.id = it->id;
+    emsg.message_data = it->message_data;
+    emsg.Write(buffer);
+    if (muxer_listener_)
+      muxer_listener_->OnTimedMetadata(*it);
+    it = pending_timed_metadata_.erase(it);
+  }
+}
 
-  // Check if all tracks are ready for fragmentation.
-  for (std::vector<Fragmenter*>::iterator it = fragmenters_.begin();
-       it != fragmenters_.end();
-       ++it) {
-    if (!(*it)->fragment_finalized())
-      return Status::OK;
+Status Segmenter::FinalizeFragment(bool finalize_segment) {
+  std::vector<uint32_t> track_ids;
+  for (size_t i = 0; i < fragmenters_.size(); ++i) {
+    if (fragmenters_[i]->fragment_initialized()) {
+      fragmenters_[i]->FinalizeFragment();
+      track_ids.push_back(i);
+    }
+  }
+  if (track_ids.empty())
+    return Status::OK;
+
+  // The tracks without samples are left out of the fragment, which then has
+  // its own copy of the track fragments.
+  MovieFragment partial_moof;
+  MovieFragment* moof = moof_.get();
+  if (track_ids.size() < moof_->tracks.size()) {
+    partial_moof.header = moof_->header;
+    partial_moof.pssh = moof_->pssh;
+    for (uint32_t track_id : track_ids)
+      partial_moof.tracks.push_back(moof_->tracks[track_id]);
+    moof = &partial_moof;
   }
 
+  const size_t first_key_frame_info = key_frame_infos_.size();
   MediaData mdat;
   // Data offset relative to 'moof': moof size + mdat header size.
   // The code will also update box sizes for moof_ and its child boxes.
-  uint64_t data_offset = moof_->ComputeSize() + mdat.HeaderSize();
+  uint64_t data_offset = moof->ComputeSize() + mdat.HeaderSize();
   // 'traf' should follow 'mfhd' moof header box.
-  uint64_t next_traf_position = moof_->HeaderSize() + moof_->header.box_size();
-  for (size_t i = 0; i < moof_->tracks.size(); ++i) {
-    TrackFragment& traf = moof_->tracks[i];
+  uint64_t next_traf_position = moof->HeaderSize() + moof->header.box_size();
+  for (size_t i = 0; i < moof->tracks.size(); ++i) {
+    TrackFragment& traf = moof->tracks[i];
     if (traf.auxiliary_offset.offsets.size() > 0) {
       DCHECK_EQ(traf.auxiliary_offset.offsets.size(), 1u);
       DCHECK(!traf.sample_encryption.sample_encryption_entries.empty());
@@ -439,25 +661,80 @@ Status Segmenter::FinalizeFragment(bool finalize_segment,
           sizeof(uint32_t);  // for sample count field in 'senc'
     }
     traf.runs[0].data_offset = data_offset + mdat.data_size;
-    mdat.data_size += fragmenters_[i]->data()->Size();
+    mdat.data_size += fragmenters_[track_ids[i]]->data_size();
+
+    const std::vector<scoped_refptr<MediaSample> >& samples =
+        fragmenters_[track_ids[i]]->samples();
+    if (report_key_frames_ && track_ids[i] == GetReferenceStreamId() &&
+        !samples.empty() && samples.front()->is_key_frame()) {
+      KeyFrameInfo key_frame;
+      key_frame.timestamp = samples.front()->pts();
+      key_frame.start_byte_offset = fragment_buffer_->Size();
+      key_frame.size =
+          traf.runs[0].data_offset + samples.front()->data_size();
+      key_frame_infos_.push_back(key_frame);
+    }
   }
 
-  // Generate segment reference.
+  // Generate segment reference. The reference track is left out only if it
+  // has no samples, e.g. before it starts or once it ended, in which case the
+  // reference is generated from the first track, in the reference timescale.
   sidx_->references.resize(sidx_->references.size() + 1);
-  fragmenters_[GetReferenceStreamId()]->GenerateSegmentReference(
-      &sidx_->references[sidx_->references.size() - 1]);
-  sidx_->references[sidx_->references.size() - 1].referenced_size =
-      data_offset + mdat.data_size;
+  SegmentReference& reference = sidx_->references.back();
+  const uint32_t reference_id =
+      std::find(track_ids.begin(), track_ids.end(), GetReferenceStreamId()) !=
+              track_ids.end()
+          ? GetReferenceStreamId()
+          : track_ids[0];
+  fragmenters_[reference_id]->GenerateSegmentReference(&reference);
+  if (reference_id != GetReferenceStreamId()) {
+    const uint32_t time_scale =
+        moov_->tracks[reference_id].media.header.timescale;
+    reference.subsegment_duration = Rescale(reference.subsegment_duration,
+                                            time_scale, sidx_->timescale);
+    reference.sap_delta_time =
+        Rescale(reference.sap_delta_time, time_scale, sidx_->timescale);
+    reference.earliest_presentation_time = Rescale(
+        reference.earliest_presentation_time, time_scale, sidx_->timescale);
+  }
+  reference.referenced_size = data_offset + mdat.data_size;
+
+  // The events of the fragment precede it, so they are part of its reference
+  // and shift its key frame.
+  BufferWriter box_buffer;
+  if (!pending_timed_metadata_.empty()) {
+    WriteTimedMetadata(reference.earliest_presentation_time +
+                           reference.subsegment_duration,
+                       &box_buffer);
+    reference.referenced_size += box_buffer.Size();
+    for (size_t i = first_key_frame_info; i < key_frame_infos_.size(); ++i)
+      key_frame_infos_[i].start_byte_offset += box_buffer.Size();
+  }
 
-  // Write the fragment to buffer.
-  moof_->Write(fragment_buffer_.get());
-  mdat.WriteHeader(fragment_buffer_.get());
-  for (Fragmenter* fragmenter : fragmenters_)
-    fragment_buffer_->AppendBuffer(*fragmenter->data());
+  // Write the fragment to buffer. The box sizes computed above are still valid
+  // as only the offsets have been updated since. The sample data is not
+  // copied, but referenced until the buffer is written out.
+  moof->WriteWithComputedSize(&box_buffer);
+  mdat.WriteHeader(&box_buffer);
+  fragment_buffer_->AppendBuffer(box_buffer);
+  for (uint32_t track_id : track_ids) {
+    for (const scoped_refptr<MediaSample>& sample :
+         fragmenters_[track_id]->samples()) {
+      fragment_buffer_->AppendSample(sample);
+    }
+  }
 
   // Increase sequence_number for next fragment.
   ++moof_->header.sequence_number;
 
+  Status status;
+  {
+    ScopedStageTimer segment_write_timer(kSegmentWriteStage);
+    status = DoFinalizeFragment();
+  }
+  if (!status.ok())
+    return status;
+
   if (finalize_segment)
     return FinalizeSegment();
 
@@ -14,6 +14,7 @@
 #include "packager/base/memory/scoped_ptr.h"
 #include "packager/media/base/fourccs.h"
 #include "packager/media/base/status.h"
+#include "packager/media/base/timed_metadata.h"
 #include "packager/media/formats/mp4/box_definitions.h"
 
 namespace edash_packager {
@@ -21,7 +22,10 @@ namespace media {
 
 struct MuxerOptions;
 
+class BufferChain;
 class BufferWriter;
+class CryptoContextCache;
+class KeyRotationSchedule;
 class KeySource;
 class MediaSample;
 class MediaStream;
@@ -38,6 +42,12 @@ class Fragmenter;
 /// SingleSegmentSegmenter defines the Segmenter for DASH Video-On-Demand with
 /// a single segment for each media presentation while MultiSegmentSegmenter
 /// handles all other cases including DASH live profile.
+/// With several streams, the reference track decides the fragment and segment
+/// boundaries, and the fragments of all the tracks are finalized and written
+/// together, in a single 'moof', with the samples each track has then. The
+/// samples are written in the order they are added. A track running a
+/// fragment duration ahead of the reference track also ends the fragment, so
+/// the output latency does not depend on the skew between the tracks.
 class Segmenter {
  public:
   Segmenter(const MuxerOptions& options,
@@ -61,6 +71,11 @@ class Segmenter {
   /// @param crypto_period_duration specifies crypto period duration in seconds.
   /// @param protection_scheme specifies the protection scheme: 'cenc', 'cens',
   ///        'cbc1', 'cbcs'.
+  /// @param crypto_context_cache creates the encryptors. It can be NULL, in
+  ///        which case the segmenter creates its own.
+  /// @param key_rotation_schedule provides the keys of the crypto periods if
+  ///        key rotation is enabled. It can be NULL, in which case the
+  ///        segmenter creates its own.
   /// @return OK on success, an error status otherwise.
   Status Initialize(const std::vector<MediaStream*>& streams,
                     MuxerListener* muxer_listener,
@@ -69,7 +84,9 @@ class Segmenter {
                     uint32_t max_sd_pixels,
                     double clear_lead_in_seconds,
                     double crypto_period_duration_in_seconds,
-                    FourCC protection_scheme);
+                    FourCC protection_scheme,
+                    CryptoContextCache* crypto_context_cache,
+                    KeyRotationSchedule* key_rotation_schedule);
 
   /// Finalize the segmenter.
   /// @return OK on success, an error status otherwise.
@@ -83,6 +100,13 @@ class Segmenter {
   Status AddSample(const MediaStream* stream,
                    scoped_refptr<MediaSample> sample);
 
+  /// Add a timed metadata event. It is written as an 'emsg' box before the
+  /// first fragment which ends after it, and passed to the muxer listener
+  /// then.
+  /// @param event is the event, timed in its own timescale on the timeline
+  ///        of the samples.
+  void AddTimedMetadata(const TimedMetadataEvent& event);
+
   /// @return true if there is an initialization range, while setting @a offset
   ///         and @a size; or false if initialization range does not apply.
   virtual bool GetInitRange(size_t* offset, size_t* size) = 0;
@@ -109,7 +133,7 @@ class Segmenter {
   const MuxerOptions& options() const { return options_; }
   FileType* ftyp() { return ftyp_.get(); }
   Movie* moov() { return moov_.get(); }
-  BufferWriter* fragment_buffer() { return fragment_buffer_.get(); }
+  BufferChain* fragment_buffer() { return fragment_buffer_.get(); }
   SegmentIndex* sidx() { return sidx_.get(); }
   MuxerListener* muxer_listener() { return muxer_listener_; }
   uint64_t progress_target() { return progress_target_; }
@@ -118,26 +142,75 @@ class Segmenter {
     progress_target_ = progress_target;
   }
 
+  /// Reports the key frames of the fragments in |fragment_buffer_| to the
+  /// muxer listener, if any, then forgets them. The fragments starting with a
+  /// key frame of the reference stream are reported, if it is a video stream.
+  /// It is called before the segment is reported.
+  /// @param fragment_buffer_offset is the offset of |fragment_buffer_| in the
+  ///        segment.
+  void ReportKeyFrames(uint64_t fragment_buffer_offset);
+
  private:
+  // A fragment starting with a key frame. The key frame is the fragment
+  // headers and the first sample of the reference stream.
+  struct KeyFrameInfo {
+    uint64_t timestamp;
+    // Offset in |fragment_buffer_|.
+    uint64_t start_byte_offset;
+    uint64_t size;
+  };
+
   virtual Status DoInitialize() = 0;
   virtual Status DoFinalize() = 0;
   virtual Status DoFinalizeSegment() = 0;
+  // Called when a fragment has been written to |fragment_buffer_|, before the
+  // segment is finalized if the fragment ends it.
+  virtual Status DoFinalizeFragment() = 0;
 
   Status FinalizeSegment();
   uint32_t GetReferenceStreamId();
 
-  Status FinalizeFragment(bool finalize_segment, Fragmenter* fragment);
+  // Sets up the track |stream_id| of |stream|, which is passed through
+  // encrypted, see StreamInfo::encryption_config(). It cannot be encrypted
+  // again, i.e. |encryption_enabled| must be false.
+  Status InitializePassthroughEncryption(uint32_t stream_id,
+                                         const MediaStream& stream,
+                                         bool encryption_enabled);
+
+  // Returns whether the fragment of |fragmenter| is to be finalized before
+  // the next sample, if it may start a fragment, given the fragment duration
+  // and the byte budget of the fragments.
+  bool IsFragmentComplete(const Fragmenter& fragmenter,
+                          uint32_t time_scale) const;
+  // Returns whether the track |stream_id|, which is not the reference track,
+  // is a fragment duration ahead of the reference track and ends the fragment.
+  bool IsAheadOfReference(uint32_t stream_id, uint32_t time_scale) const;
+  // Finalizes the fragments of the tracks and writes them in a single 'moof'.
+  // The tracks without samples are left out of the fragment.
+  Status FinalizeFragment(bool finalize_segment);
+  // Writes the 'emsg' boxes of the pending timed metadata events which start
+  // before |end_time|, in the reference timescale, to |buffer| and reports
+  // the events to the muxer listener.
+  void WriteTimedMetadata(uint64_t end_time, BufferWriter* buffer);
 
   const MuxerOptions& options_;
   scoped_ptr<FileType> ftyp_;
   scoped_ptr<Movie> moov_;
   scoped_ptr<MovieFragment> moof_;
-  scoped_ptr<BufferWriter> fragment_buffer_;
+  scoped_ptr<BufferChain> fragment_buffer_;
   scoped_ptr<SegmentIndex> sidx_;
+  // Used if no cache is shared with other muxers.
+  scoped_ptr<CryptoContextCache> own_crypto_context_cache_;
+  scoped_ptr<KeyRotationSchedule> own_key_rotation_schedule_;
   std::vector<Fragmenter*> fragmenters_;
   std::vector<uint64_t> segment_durations_;
   std::map<const MediaStream*, uint32_t> stream_map_;
-  bool end_of_segment_;
+  // Whether the key frames of the reference stream are reported, and the key
+  // frames of the fragments in |fragment_buffer_|.
+  bool report_key_frames_;
+  std::vector<KeyFrameInfo> key_frame_infos_;
+  // The timed metadata events not written yet, in the order they were added.
+  std::vector<TimedMetadataEvent> pending_timed_metadata_;
   MuxerListener* muxer_listener_;
   ProgressListener* progress_listener_;
   uint64_t progress_target_;
@@ -14,6 +14,7 @@
 #include "packager/base/strings/stringprintf.h"
 #include "packager/base/threading/platform_thread.h"
 #include "packager/base/time/time.h"
+#include "packager/media/base/buffer_chain.h"
 #include "packager/media/base/buffer_writer.h"
 #include "packager/media/base/media_stream.h"
 #include "packager/media/base/muxer_options.h"
@@ -26,6 +27,29 @@ namespace edash_packager {
 namespace media {
 namespace mp4 {
 namespace {
+// Extra space reserved for moov, which grows when the durations are filled in
+// at the end, e.g. if 64-bit durations are needed.
+const uint64_t kMoovSizeMargin = 1024;
+// Extra space reserved for the 64-bit fields of sidx.
+const uint64_t kSidxSizeMargin = 8;
+// Size of a sidx reference.
+const uint64_t kSidxReferenceSize = 12;
+// Number of sidx references to reserve space for if the media duration is
+// unknown.
+const uint64_t kDefaultNumReservedReferences = 4096;
+// Number of sidx references to reserve in addition to the estimation.
+const uint64_t kExtraNumReservedReferences = 16;
+// Size of a 'free' box header.
+const uint64_t kFreeBoxHeaderSize = 8;
+
+// Append a 'free' box of |size| bytes to |buffer|.
+void WriteFreeBox(uint64_t size, BufferWriter* buffer) {
+  DCHECK_GE(size, kFreeBoxHeaderSize);
+  buffer->AppendInt(static_cast<uint32_t>(size));
+  buffer->AppendInt(static_cast<uint32_t>(FOURCC_free));
+  buffer->AppendVector(std::vector<uint8_t>(size - kFreeBoxHeaderSize, 0));
+}
+
 // Create a temp file name using process/thread id and current time.
 std::string TempFileName() {
   int32_t tid = static_cast<int32_t>(base::PlatformThread::CurrentId());
@@ -42,9 +66,15 @@ std::string TempFileName() {
 SingleSegmentSegmenter::SingleSegmentSegmenter(const MuxerOptions& options,
                                                scoped_ptr<FileType> ftyp,
                                                scoped_ptr<Movie> moov)
-    : Segmenter(options, ftyp.Pass(), moov.Pass()) {}
+    : Segmenter(options, ftyp.Pass(), moov.Pass()),
+      subsegment_ref_(),
+      subsegment_first_sap_time_(0),
+      num_subsegment_fragments_(0),
+      reserved_header_size_(0) {}
 
 SingleSegmentSegmenter::~SingleSegmentSegmenter() {
+  if (output_file_)
+    output_file_.release()->Close();
   if (temp_file_)
     temp_file_.release()->Close();
   if (!temp_file_name_.empty()) {
@@ -69,14 +99,39 @@ bool SingleSegmentSegmenter::GetIndexRange(size_t* offset, size_t* size) {
 }
 
 Status SingleSegmentSegmenter::DoInitialize() {
+  if (options().single_segment_in_place)
+    return OpenOutputFileInPlace();
+
   // Single segment segmentation involves two stages:
   //   Stage 1: Create media subsegments from media samples
   //   Stage 2: Update media header (moov) which involves copying of media
   //            subsegments
   // Assumes stage 2 takes similar amount of time as stage 1. The previous
   // progress_target was set for stage 1. Times two to account for stage 2.
+  const uint64_t expected_media_size = EstimateMediaSize();
   set_progress_target(progress_target() * 2);
+  return OpenTempFile(expected_media_size);
+}
 
+Status SingleSegmentSegmenter::DoFinalize() {
+  DCHECK(ftyp());
+  DCHECK(moov());
+  DCHECK(vod_sidx_);
+
+  if (output_file_) {
+    Status status = FinalizeInPlace();
+    // |output_file_| is closed on success, and left open if the reserved
+    // space turns out to be too small.
+    if (!status.ok() || !output_file_)
+      return status;
+    status = MoveSubsegmentsToTempFile();
+    if (!status.ok())
+      return status;
+  }
+  return FinalizeWithTempFile();
+}
+
+Status SingleSegmentSegmenter::OpenTempFile(uint64_t expected_size) {
   if (options().temp_dir.empty()) {
     base::FilePath temp_file_path;
     if (!base::CreateTemporaryFile(&temp_file_path)) {
@@ -88,18 +143,132 @@ Status SingleSegmentSegmenter::DoInitialize() {
     temp_file_name_ =
         base::FilePath(options().temp_dir).Append(TempFileName()).value();
   }
-  temp_file_.reset(File::Open(temp_file_name_.c_str(), "w"));
+  // The disk space of the file is preallocated if its size is known.
+  temp_file_.reset(
+      File::OpenWithExpectedSize(temp_file_name_.c_str(), "w", expected_size));
   return temp_file_
              ? Status::OK
              : Status(error::FILE_FAILURE,
                       "Cannot open file to write " + temp_file_name_);
 }
 
-Status SingleSegmentSegmenter::DoFinalize() {
+Status SingleSegmentSegmenter::OpenOutputFileInPlace() {
+  reserved_header_size_ = EstimateHeaderSize();
+  const uint64_t expected_media_size = EstimateMediaSize();
+  output_file_.reset(File::OpenWithExpectedSize(
+      options().output_file_name.c_str(), "w",
+      expected_media_size > 0 ? reserved_header_size_ + expected_media_size
+                              : 0));
+  if (!output_file_) {
+    return Status(error::FILE_FAILURE,
+                  "Cannot open file to write " + options().output_file_name);
+  }
+  // The reserved space is a 'free' box until the header is written.
+  BufferWriter buffer;
+  WriteFreeBox(reserved_header_size_, &buffer);
+  return buffer.WriteToFile(output_file_.get());
+}
+
+uint64_t SingleSegmentSegmenter::EstimateHeaderSize() {
+  uint64_t num_references = kDefaultNumReservedReferences;
+  const double duration_in_seconds =
+      static_cast<double>(progress_target()) / GetReferenceTimeScale();
+  if (duration_in_seconds > 0 && options().segment_duration > 0) {
+    // Subsegments are at least |segment_duration| long except the last one.
+    num_references = static_cast<uint64_t>(duration_in_seconds /
+                                           options().segment_duration) +
+                     kExtraNumReservedReferences;
+  }
+  SegmentIndex sidx;
+  return ftyp()->ComputeSize() + moov()->ComputeSize() + kMoovSizeMargin +
+         sidx.ComputeSize() + kSidxSizeMargin +
+         num_references * kSidxReferenceSize;
+}
+
+uint64_t SingleSegmentSegmenter::EstimateMediaSize() {
+  const double duration_in_seconds =
+      static_cast<double>(progress_target()) / GetReferenceTimeScale();
+  if (duration_in_seconds <= 0 || options().bandwidth == 0)
+    return 0;
+  return static_cast<uint64_t>(duration_in_seconds * options().bandwidth / 8);
+}
+
+Status SingleSegmentSegmenter::FinalizeInPlace() {
+  DCHECK(output_file_);
+
+  vod_sidx_->first_offset = 0;
+  const uint64_t header_size = ftyp()->ComputeSize() + moov()->ComputeSize() +
+                               vod_sidx_->ComputeSize();
+  const uint64_t free_size = reserved_header_size_ - header_size;
+  if (header_size > reserved_header_size_ ||
+      (free_size > 0 && free_size < kFreeBoxHeaderSize)) {
+    LOG(WARNING) << "Reserved " << reserved_header_size_
+                 << " bytes is not enough for the " << header_size
+                 << " bytes media header and segment index. Falling back to "
+                    "rewriting the file.";
+    return Status::OK;
+  }
+
+  LOG(INFO) << "Update media header (moov) in place in '"
+            << options().output_file_name << "'.";
+
+  // The subsegments start right after the 'free' box.
+  vod_sidx_->first_offset = free_size;
+  BufferWriter buffer;
+  // The sizes of ftyp and moov are computed above already.
+  ftyp()->WriteWithComputedSize(&buffer);
+  moov()->WriteWithComputedSize(&buffer);
+  vod_sidx_->Write(&buffer);
+  if (free_size > 0)
+    WriteFreeBox(free_size, &buffer);
+  DCHECK_EQ(reserved_header_size_, buffer.Size());
+
+  if (!output_file_->Seek(0)) {
+    return Status(error::FILE_FAILURE,
+                  "Cannot seek in file " + options().output_file_name);
+  }
+  Status status = buffer.WriteToFile(output_file_.get());
+  if (!status.ok())
+    return status;
+  if (!output_file_.release()->Close()) {
+    return Status(error::FILE_FAILURE,
+                  "Cannot close file " + options().output_file_name);
+  }
+  SetComplete();
+  return Status::OK;
+}
+
+Status SingleSegmentSegmenter::MoveSubsegmentsToTempFile() {
+  DCHECK(output_file_);
+  if (!output_file_.release()->Close()) {
+    return Status(error::FILE_FAILURE,
+                  "Cannot close file " + options().output_file_name);
+  }
+  const int64_t output_file_size =
+      File::GetFileSize(options().output_file_name.c_str());
+  Status status = OpenTempFile(
+      output_file_size > static_cast<int64_t>(reserved_header_size_)
+          ? output_file_size - reserved_header_size_
+          : 0);
+  if (!status.ok())
+    return status;
+
+  scoped_ptr<File, FileCloser> file(
+      File::Open(options().output_file_name.c_str(), "r"));
+  if (!file || !file->Seek(reserved_header_size_)) {
+    return Status(error::FILE_FAILURE,
+                  "Cannot read file " + options().output_file_name);
+  }
+  if (File::CopyFile(file.get(), temp_file_.get()) < 0) {
+    return Status(error::FILE_FAILURE,
+                  "Failed to copy subsegments to " + temp_file_name_);
+  }
+  vod_sidx_->first_offset = 0;
+  return Status::OK;
+}
+
+Status SingleSegmentSegmenter::FinalizeWithTempFile() {
   DCHECK(temp_file_);
-  DCHECK(ftyp());
-  DCHECK(moov());
-  DCHECK(vod_sidx_);
 
   // Close the temp file to prepare for reading later.
   if (!temp_file_.release()->Close()) {
@@ -107,8 +276,13 @@ Status SingleSegmentSegmenter::DoFinalize() {
                   "Cannot close the temp file " + temp_file_name_);
   }
 
-  scoped_ptr<File, FileCloser> file(
-      File::Open(options().output_file_name.c_str(), "w"));
+  // The size of the output file is known, so its disk space is preallocated.
+  const int64_t temp_file_size = File::GetFileSize(temp_file_name_.c_str());
+  const uint64_t header_size = ftyp()->ComputeSize() + moov()->ComputeSize() +
+                               vod_sidx_->ComputeSize();
+  scoped_ptr<File, FileCloser> file(File::OpenWithExpectedSize(
+      options().output_file_name.c_str(), "w",
+      temp_file_size > 0 ? header_size + temp_file_size : 0));
   if (file == NULL) {
     return Status(error::FILE_FAILURE,
                   "Cannot open file to write " + options().output_file_name);
@@ -119,9 +293,10 @@ Status SingleSegmentSegmenter::DoFinalize() {
 
   // Write ftyp, moov and sidx to output file.
   scoped_ptr<BufferWriter> buffer(new BufferWriter());
-  ftyp()->Write(buffer.get());
-  moov()->Write(buffer.get());
-  vod_sidx_->Write(buffer.get());
+  // The sizes of the boxes are computed above already.
+  ftyp()->WriteWithComputedSize(buffer.get());
+  moov()->WriteWithComputedSize(buffer.get());
+  vod_sidx_->WriteWithComputedSize(buffer.get());
   Status status = buffer->WriteToFile(file.get());
   if (!status.ok())
     return status;
@@ -159,36 +334,53 @@ Status SingleSegmentSegmenter::DoFinalize() {
   return Status::OK;
 }
 
+Status SingleSegmentSegmenter::DoFinalizeFragment() {
+  // The fragments are written with their subsegment. In VOD, a segment is
+  // converted into a subsegment, i.e. one reference, which contains all its
+  // fragments, so the reference of each fragment is merged into it right
+  // away.
+  DCHECK(sidx());
+  DCHECK_EQ(1u, sidx()->references.size());
+  AddFragmentToSubsegment(sidx()->references.back());
+  sidx()->references.clear();
+  return Status::OK;
+}
+
+void SingleSegmentSegmenter::AddFragmentToSubsegment(
+    const SegmentReference& fragment_ref) {
+  if (num_subsegment_fragments_++ == 0) {
+    subsegment_ref_ = fragment_ref;
+    subsegment_first_sap_time_ = fragment_ref.sap_delta_time +
+                                 fragment_ref.earliest_presentation_time;
+    return;
+  }
+  subsegment_ref_.referenced_size += fragment_ref.referenced_size;
+  // NOTE: We calculate subsegment duration based on the total duration of
+  // this subsegment instead of subtracting earliest_presentation_time as
+  // indicated in the spec.
+  subsegment_ref_.subsegment_duration += fragment_ref.subsegment_duration;
+  subsegment_ref_.earliest_presentation_time =
+      std::min(subsegment_ref_.earliest_presentation_time,
+               fragment_ref.earliest_presentation_time);
+
+  if (subsegment_ref_.sap_type == SegmentReference::TypeUnknown &&
+      fragment_ref.sap_type != SegmentReference::TypeUnknown) {
+    subsegment_ref_.sap_type = fragment_ref.sap_type;
+    subsegment_first_sap_time_ = fragment_ref.sap_delta_time +
+                                 fragment_ref.earliest_presentation_time;
+  }
+}
+
 Status SingleSegmentSegmenter::DoFinalizeSegment() {
   DCHECK(sidx());
   DCHECK(fragment_buffer());
-  // sidx() contains pre-generated segment references with one reference per
-  // fragment. In VOD, this segment is converted into a subsegment, i.e. one
-  // reference, which contains all the fragments in sidx().
-  std::vector<SegmentReference>& refs = sidx()->references;
-  SegmentReference& vod_ref = refs[0];
-  uint64_t first_sap_time =
-      refs[0].sap_delta_time + refs[0].earliest_presentation_time;
-  for (uint32_t i = 1; i < refs.size(); ++i) {
-    vod_ref.referenced_size += refs[i].referenced_size;
-    // NOTE: We calculate subsegment duration based on the total duration of
-    // this subsegment instead of subtracting earliest_presentation_time as
-    // indicated in the spec.
-    vod_ref.subsegment_duration += refs[i].subsegment_duration;
-    vod_ref.earliest_presentation_time = std::min(
-        vod_ref.earliest_presentation_time, refs[i].earliest_presentation_time);
-
-    if (vod_ref.sap_type == SegmentReference::TypeUnknown &&
-        refs[i].sap_type != SegmentReference::TypeUnknown) {
-      vod_ref.sap_type = refs[i].sap_type;
-      first_sap_time =
-          refs[i].sap_delta_time + refs[i].earliest_presentation_time;
-    }
-  }
+  DCHECK_GT(num_subsegment_fragments_, 0u);
+  SegmentReference vod_ref = subsegment_ref_;
+  num_subsegment_fragments_ = 0;
   // Calculate sap delta time w.r.t. earliest_presentation_time.
   if (vod_ref.sap_type != SegmentReference::TypeUnknown) {
     vod_ref.sap_delta_time =
-        first_sap_time - vod_ref.earliest_presentation_time;
+        subsegment_first_sap_time_ - vod_ref.earliest_presentation_time;
   }
 
   // Create segment if it does not exist yet.
@@ -218,17 +410,21 @@ Status SingleSegmentSegmenter::DoFinalizeSegment() {
   }
   vod_sidx_->references.push_back(vod_ref);
 
-  // Append fragment buffer to temp file.
+  // Append fragment buffer to the output file or the temp file.
   size_t segment_size = fragment_buffer()->Size();
-  Status status = fragment_buffer()->WriteToFile(temp_file_.get());
+  Status status = fragment_buffer()->WriteToFile(
+      output_file_ ? output_file_.get() : temp_file_.get());
   if (!status.ok()) return status;
 
   UpdateProgress(vod_ref.subsegment_duration);
+  // The offsets are relative to the subsegment.
+  ReportKeyFrames(0);
   if (muxer_listener()) {
     muxer_listener()->OnSampleDurationReady(sample_duration());
     muxer_listener()->OnNewSegment(options().output_file_name,
                                    vod_ref.earliest_presentation_time,
-                                   vod_ref.subsegment_duration, segment_size);
+                                   vod_ref.subsegment_duration, segment_size,
+                                   "");
   }
   return Status::OK;
 }
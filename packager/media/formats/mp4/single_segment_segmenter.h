@@ -25,6 +25,13 @@ namespace mp4 {
 /// overall subsegment/fragment duration not smaller than defined duration and
 /// yet meet SAP requirements. SingleSegmentSegmenter ignores @b
 /// MuxerOptions.num_subsegments_per_sidx.
+/// By default the subsegments are written to a temporary file, which is copied
+/// to the output file after the media header (moov) and the segment index
+/// (sidx). If @b MuxerOptions.single_segment_in_place is set, space for the
+/// header and the index is reserved at the start of the output file instead,
+/// the subsegments are written directly after it, and the header and the
+/// index are written in place in the end. The temporary file is used only if
+/// the reserved space turns out to be too small.
 class SingleSegmentSegmenter : public Segmenter {
  public:
   SingleSegmentSegmenter(const MuxerOptions& options,
@@ -43,10 +50,44 @@ class SingleSegmentSegmenter : public Segmenter {
   Status DoInitialize() override;
   Status DoFinalize() override;
   Status DoFinalizeSegment() override;
+  Status DoFinalizeFragment() override;
+
+  // Create and open the temporary file, which is expected to hold
+  // |expected_size| bytes, or an unknown size if 0.
+  Status OpenTempFile(uint64_t expected_size);
+  // Open the output file and reserve space for the header and the index.
+  Status OpenOutputFileInPlace();
+  // Estimate the space needed by ftyp, moov and sidx.
+  uint64_t EstimateHeaderSize();
+  // Estimate the size of the subsegments from the user-specified bandwidth,
+  // or return 0 if it is not specified.
+  uint64_t EstimateMediaSize();
+  // Write ftyp, moov and sidx followed by a 'free' box for the remaining
+  // reserved space at the start of the output file.
+  Status FinalizeInPlace();
+  // Move the subsegments written in place to the temporary file, to fall back
+  // to the temporary file path.
+  Status MoveSubsegmentsToTempFile();
+  // Write ftyp, moov and sidx to the output file, followed by the content of
+  // the temporary file.
+  Status FinalizeWithTempFile();
+
+  // Merge the reference of the fragment just written into
+  // |subsegment_ref_|.
+  void AddFragmentToSubsegment(const SegmentReference& fragment_ref);
 
   scoped_ptr<SegmentIndex> vod_sidx_;
+  // Reference of the subsegment being written, aggregated as its fragments
+  // complete so that the per-fragment references are not kept.
+  SegmentReference subsegment_ref_;
+  uint64_t subsegment_first_sap_time_;
+  uint32_t num_subsegment_fragments_;
   std::string temp_file_name_;
   scoped_ptr<File, FileCloser> temp_file_;
+  // Output file, when the subsegments are written in place.
+  scoped_ptr<File, FileCloser> output_file_;
+  // Space reserved for the header and the index in |output_file_|.
+  uint64_t reserved_header_size_;
 
   DISALLOW_COPY_AND_ASSIGN(SingleSegmentSegmenter);
 };
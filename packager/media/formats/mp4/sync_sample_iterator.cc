@@ -41,6 +41,15 @@ bool SyncSampleIterator::IsSyncSample(uint32_t sample) const {
       sync_sample_vector_.begin(), sync_sample_vector_.end(), sample);
 }
 
+uint32_t SyncSampleIterator::PreviousSyncSample(uint32_t sample) const {
+  // If the sync sample box is not present, every sample is a sync sample.
+  if (is_empty_)
+    return sample;
+  std::vector<uint32_t>::const_iterator it = std::upper_bound(
+      sync_sample_vector_.begin(), sync_sample_vector_.end(), sample);
+  return it == sync_sample_vector_.begin() ? 0 : *(it - 1);
+}
+
 }  // namespace mp4
 }  // namespace media
 }  // namespace edash_packager
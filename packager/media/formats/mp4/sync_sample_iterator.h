@@ -36,6 +36,10 @@ class SyncSampleIterator {
   /// @return true if @a sample (1-based) is a sync sample, false otherwise.
   bool IsSyncSample(uint32_t sample) const;
 
+  /// @return The last sync sample at or before @a sample, both 1-based, or 0
+  ///         if there is none.
+  uint32_t PreviousSyncSample(uint32_t sample) const;
+
  private:
   uint32_t sample_number_;
   const std::vector<uint32_t>& sync_sample_vector_;
@@ -56,6 +56,24 @@ TEST(SyncSampleIteratorTest, SyncSample) {
   }
 }
 
+TEST(SyncSampleIteratorTest, PreviousSyncSample) {
+  SyncSample sync_sample;
+  sync_sample.sample_number.assign(
+      kSyncSamples, kSyncSamples + sizeof(kSyncSamples) / sizeof(uint32_t));
+  SyncSampleIterator iterator(sync_sample);
+
+  uint32_t previous_sync_sample = 0;
+  for (uint32_t i = 1; i <= kNumSamples; ++i) {
+    if (InSyncSamples(i))
+      previous_sync_sample = i;
+    ASSERT_EQ(previous_sync_sample, iterator.PreviousSyncSample(i));
+  }
+
+  // Every sample is a sync sample without the sync sample box.
+  SyncSampleIterator empty_iterator((SyncSample()));
+  EXPECT_EQ(kNumSamples, empty_iterator.PreviousSyncSample(kNumSamples));
+}
+
 }  // namespace mp4
 }  // namespace media
 }  // namespace edash_packager
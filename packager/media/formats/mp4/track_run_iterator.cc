@@ -7,6 +7,7 @@
 #include <algorithm>
 #include <limits>
 
+#include "packager/base/stl_util.h"
 #include "packager/media/base/buffer_reader.h"
 #include "packager/media/base/fourccs.h"
 #include "packager/media/base/rcheck.h"
@@ -23,16 +24,54 @@ namespace edash_packager {
 namespace media {
 namespace mp4 {
 
-struct SampleInfo {
-  int64_t size;
-  int64_t duration;
-  int64_t cts_offset;
-  bool is_keyframe;
+// The properties of a sequence of samples, stored as parallel arrays so that
+// iterating the samples reads contiguous memory and a run of samples costs a
+// few allocations rather than one per sample.
+struct SampleInfoTable {
+  std::vector<uint32_t> sizes;
+  std::vector<uint32_t> durations;
+  std::vector<int64_t> cts_offsets;
+  std::vector<uint8_t> is_keyframe;
+
+  size_t size() const { return sizes.size(); }
+
+  // Keeps the capacity, so that the table is reused without reallocating.
+  void Clear() {
+    sizes.clear();
+    durations.clear();
+    cts_offsets.clear();
+    is_keyframe.clear();
+  }
+
+  void Reserve(size_t num_samples) {
+    sizes.reserve(num_samples);
+    durations.reserve(num_samples);
+    cts_offsets.reserve(num_samples);
+    is_keyframe.reserve(num_samples);
+  }
+
+  void Append(uint32_t size,
+              uint32_t duration,
+              int64_t cts_offset,
+              bool keyframe) {
+    sizes.push_back(size);
+    durations.push_back(duration);
+    cts_offsets.push_back(cts_offset);
+    is_keyframe.push_back(keyframe ? 1 : 0);
+  }
 };
 
 struct TrackRunInfo {
   uint32_t track_id;
-  std::vector<SampleInfo> samples;
+  uint32_t sample_count;
+  // Decodes the samples of the runs set up from moov when the run becomes
+  // current. NULL for the runs set up from moof, whose samples are decoded
+  // upfront.
+  SampleTableReader* sample_table_reader;
+  // Index of the first sample of the run in the sample table of the track for
+  // the runs set up from moov, or in the fragment samples of the iterator for
+  // the runs set up from moof.
+  uint32_t first_sample;
   int64_t timescale;
   int64_t start_dts;
   int64_t sample_start_offset;
@@ -41,12 +80,16 @@ struct TrackRunInfo {
   const AudioSampleEntry* audio_description;
   const VideoSampleEntry* video_description;
 
-  // Stores sample encryption entries, which is populated from 'senc' box if it
-  // is available, otherwise will try to load from cenc auxiliary information.
-  std::vector<SampleEncryptionEntry> sample_encryption_entries;
+  // The raw sample encryption entries of the samples, copied from the 'senc'
+  // box if it is available, otherwise from the cenc auxiliary information
+  // once cached, and the offset of the entry of each sample in it, followed
+  // by the end offset. An entry is only parsed by GetDecryptConfig(), when
+  // its sample is decrypted. |aux_info_offsets| is empty until available.
+  std::vector<uint8_t> aux_info;
+  std::vector<uint32_t> aux_info_offsets;
 
-  // These variables are useful to load |sample_encryption_entries| from cenc
-  // auxiliary information when 'senc' box is not available.
+  // These variables are useful to load |aux_info| from cenc auxiliary
+  // information when 'senc' box is not available.
   int64_t aux_info_start_offset;  // Only valid if aux_info_total_size > 0.
   int aux_info_default_size;
   std::vector<uint8_t> aux_info_sizes;  // Populated if default_size == 0.
@@ -58,6 +101,9 @@ struct TrackRunInfo {
 
 TrackRunInfo::TrackRunInfo()
     : track_id(0),
+      sample_count(0),
+      sample_table_reader(NULL),
+      first_sample(0),
       timescale(-1),
       start_dts(-1),
       sample_start_offset(-1),
@@ -69,39 +115,140 @@ TrackRunInfo::TrackRunInfo()
       aux_info_total_size(0) {}
 TrackRunInfo::~TrackRunInfo() {}
 
+// Decodes the samples of a track from its sample table on demand. The tables
+// are run-length coded, so they are iterated in order: seeking backward
+// starts over from the first sample.
+class SampleTableReader {
+ public:
+  explicit SampleTableReader(const SampleTable& sample_table)
+      : sample_table_(sample_table),
+        has_composition_offset_(
+            !sample_table.composition_time_to_sample.composition_offset
+                 .empty()) {
+    Reset();
+  }
+
+  // Decodes |num_samples| samples from the sample at |first_sample|, which
+  // must be in the table, and appends them to |samples|.
+  void ReadSamples(uint32_t first_sample,
+                   uint32_t num_samples,
+                   SampleInfoTable* samples) {
+    if (num_samples == 0)
+      return;
+    SeekSample(first_sample);
+    const SampleSize& sample_size = sample_table_.sample_size;
+    if (sample_size.sample_size != 0) {
+      samples->sizes.insert(samples->sizes.end(), num_samples,
+                            sample_size.sample_size);
+    } else {
+      DCHECK_LE(first_sample + num_samples, sample_size.sizes.size());
+      samples->sizes.insert(
+          samples->sizes.end(), sample_size.sizes.begin() + first_sample,
+          sample_size.sizes.begin() + first_sample + num_samples);
+    }
+    for (uint32_t i = 0; i < num_samples; ++i) {
+      if (i > 0)
+        AdvanceSample();
+      samples->durations.push_back(decoding_time_->sample_delta());
+      samples->cts_offsets.push_back(
+          has_composition_offset_ ? composition_offset_->sample_offset() : 0);
+      samples->is_keyframe.push_back(sync_sample_->IsSyncSample() ? 1 : 0);
+    }
+  }
+
+ private:
+  void Reset() {
+    sample_index_ = 0;
+    decoding_time_.reset(
+        new DecodingTimeIterator(sample_table_.decoding_time_to_sample));
+    composition_offset_.reset(new CompositionOffsetIterator(
+        sample_table_.composition_time_to_sample));
+    sync_sample_.reset(new SyncSampleIterator(sample_table_.sync_sample));
+  }
+
+  // Moves to the sample at |sample_index|.
+  void SeekSample(uint32_t sample_index) {
+    if (sample_index < sample_index_)
+      Reset();
+    while (sample_index_ < sample_index)
+      AdvanceSample();
+  }
+
+  void AdvanceSample() {
+    decoding_time_->AdvanceSample();
+    if (has_composition_offset_)
+      composition_offset_->AdvanceSample();
+    sync_sample_->AdvanceSample();
+    ++sample_index_;
+  }
+
+  const SampleTable& sample_table_;
+  const bool has_composition_offset_;
+  uint32_t sample_index_;
+  scoped_ptr<DecodingTimeIterator> decoding_time_;
+  scoped_ptr<CompositionOffsetIterator> composition_offset_;
+  scoped_ptr<SyncSampleIterator> sync_sample_;
+
+  DISALLOW_COPY_AND_ASSIGN(SampleTableReader);
+};
+
 TrackRunIterator::TrackRunIterator(const Movie* moov)
-    : moov_(moov), sample_dts_(0), sample_offset_(0) {
+    : moov_(moov),
+      fragment_samples_(new SampleInfoTable()),
+      moov_run_samples_(new SampleInfoTable()),
+      run_samples_(NULL),
+      run_first_sample_(0),
+      sample_index_(0),
+      sample_dts_(0),
+      sample_offset_(0) {
   CHECK(moov);
 }
 
-TrackRunIterator::~TrackRunIterator() {}
+TrackRunIterator::~TrackRunIterator() {
+  STLDeleteElements(&sample_table_readers_);
+}
+
+// Skips the sample encryption entry read by |reader|, without parsing its IV
+// and subsamples.
+static bool SkipSampleEncryptionEntry(uint8_t iv_size,
+                                      bool has_subsamples,
+                                      BufferReader* reader) {
+  const size_t kSubsampleEntrySize = sizeof(uint16_t) + sizeof(uint32_t);
+  RCHECK(reader->SkipBytes(iv_size));
+  if (!has_subsamples)
+    return true;
+  uint16_t subsample_count;
+  RCHECK(reader->Read2(&subsample_count) && subsample_count > 0);
+  return reader->SkipBytes(subsample_count * kSubsampleEntrySize);
+}
 
-static void PopulateSampleInfo(const TrackExtends& trex,
-                               const TrackFragmentHeader& tfhd,
-                               const TrackFragmentRun& trun,
-                               const uint32_t i,
-                               SampleInfo* sample_info) {
+// Appends sample |i| of |trun| to |samples|. Returns its duration.
+static uint32_t PopulateSampleInfo(const TrackExtends& trex,
+                                   const TrackFragmentHeader& tfhd,
+                                   const TrackFragmentRun& trun,
+                                   const uint32_t i,
+                                   SampleInfoTable* samples) {
+  uint32_t size;
   if (i < trun.sample_sizes.size()) {
-    sample_info->size = trun.sample_sizes[i];
+    size = trun.sample_sizes[i];
   } else if (tfhd.default_sample_size > 0) {
-    sample_info->size = tfhd.default_sample_size;
+    size = tfhd.default_sample_size;
   } else {
-    sample_info->size = trex.default_sample_size;
+    size = trex.default_sample_size;
   }
 
+  uint32_t duration;
   if (i < trun.sample_durations.size()) {
-    sample_info->duration = trun.sample_durations[i];
+    duration = trun.sample_durations[i];
   } else if (tfhd.default_sample_duration > 0) {
-    sample_info->duration = tfhd.default_sample_duration;
+    duration = tfhd.default_sample_duration;
   } else {
-    sample_info->duration = trex.default_sample_duration;
+    duration = trex.default_sample_duration;
   }
 
-  if (i < trun.sample_composition_time_offsets.size()) {
-    sample_info->cts_offset = trun.sample_composition_time_offsets[i];
-  } else {
-    sample_info->cts_offset = 0;
-  }
+  int64_t cts_offset = 0;
+  if (i < trun.sample_composition_time_offsets.size())
+    cts_offset = trun.sample_composition_time_offsets[i];
 
   uint32_t flags;
   if (i < trun.sample_flags.size()) {
@@ -111,7 +258,9 @@ static void PopulateSampleInfo(const TrackExtends& trex,
   } else {
     flags = trex.default_sample_flags;
   }
-  sample_info->is_keyframe = !(flags & TrackFragmentHeader::kNonKeySampleMask);
+  samples->Append(size, duration, cts_offset,
+                  !(flags & TrackFragmentHeader::kNonKeySampleMask));
+  return duration;
 }
 
 // In well-structured encrypted media, each track run will be immediately
@@ -143,10 +292,22 @@ class CompareMinTrackRunDataOffset {
 };
 
 bool TrackRunIterator::Init() {
+  return InitFromMoov(0);
+}
+
+bool TrackRunIterator::InitForTrack(uint32_t track_id) {
+  DCHECK_NE(0u, track_id);
+  return InitFromMoov(track_id);
+}
+
+bool TrackRunIterator::InitFromMoov(uint32_t track_id) {
   runs_.clear();
+  STLDeleteElements(&sample_table_readers_);
 
   for (std::vector<Track>::const_iterator trak = moov_->tracks.begin();
        trak != moov_->tracks.end(); ++trak) {
+    if (track_id != 0 && trak->header.track_id != track_id)
+      continue;
     const SampleDescription& stsd =
         trak->media.information.sample_table.description;
     if (stsd.type != kAudio && stsd.type != kVideo) {
@@ -174,8 +335,6 @@ bool TrackRunIterator::Init() {
     bool has_composition_offset = composition_offset.IsValid();
     ChunkInfoIterator chunk_info(
         trak->media.information.sample_table.sample_to_chunk);
-    SyncSampleIterator sync_sample(
-        trak->media.information.sample_table.sync_sample);
     // Skip processing saiz and saio boxes for non-fragmented mp4 as we
     // don't support encrypted non-fragmented mp4.
 
@@ -183,6 +342,9 @@ bool TrackRunIterator::Init() {
         trak->media.information.sample_table.sample_size;
     const std::vector<uint64_t>& chunk_offset_vector =
         trak->media.information.sample_table.chunk_large_offset.offsets;
+    SampleTableReader* sample_table_reader =
+        new SampleTableReader(trak->media.information.sample_table);
+    sample_table_readers_.push_back(sample_table_reader);
 
     int64_t run_start_dts = 0;
 
@@ -202,6 +364,8 @@ bool TrackRunIterator::Init() {
       RCHECK(decoding_time.IsValid());
       RCHECK(chunk_info.IsValid());
     }
+    RCHECK(sample_size.sample_size != 0 ||
+           sample_size.sizes.size() == num_samples);
 
     uint32_t sample_index = 0;
     for (uint32_t chunk_index = 0; chunk_index < num_chunks; ++chunk_index) {
@@ -212,6 +376,8 @@ bool TrackRunIterator::Init() {
       tri.timescale = trak->media.header.timescale;
       tri.start_dts = run_start_dts;
       tri.sample_start_offset = chunk_offset_vector[chunk_index];
+      tri.sample_table_reader = sample_table_reader;
+      tri.first_sample = sample_index;
 
       uint32_t desc_idx = chunk_info.sample_description_index();
       RCHECK(desc_idx > 0);  // Descriptions are one-indexed in the file.
@@ -236,23 +402,17 @@ bool TrackRunIterator::Init() {
                    .default_is_protected == 0);
       }
 
+      // The samples are only validated here, and decoded on demand by
+      // |sample_table_reader|.
       uint32_t samples_per_chunk = chunk_info.samples_per_chunk();
-      tri.samples.resize(samples_per_chunk);
+      tri.sample_count = samples_per_chunk;
       for (uint32_t k = 0; k < samples_per_chunk; ++k) {
-        SampleInfo& sample = tri.samples[k];
-        sample.size = sample_size.sample_size != 0
-                          ? sample_size.sample_size
-                          : sample_size.sizes[sample_index];
-        sample.duration = decoding_time.sample_delta();
-        sample.cts_offset =
-            has_composition_offset ? composition_offset.sample_offset() : 0;
-        sample.is_keyframe = sync_sample.IsSyncSample();
-
-        run_start_dts += sample.duration;
+        RCHECK(sample_index < num_samples);
+        run_start_dts += decoding_time.sample_delta();
 
         // Advance to next sample. Should success except for last sample.
         ++sample_index;
-        RCHECK(chunk_info.AdvanceSample() && sync_sample.AdvanceSample());
+        RCHECK(chunk_info.AdvanceSample());
         if (sample_index == num_samples) {
           // We should hit end of tables for decoding time and composition
           // offset.
@@ -278,6 +438,7 @@ bool TrackRunIterator::Init() {
 
 bool TrackRunIterator::Init(const MovieFragment& moof) {
   runs_.clear();
+  fragment_samples_->Clear();
 
   next_fragment_start_dts_.resize(moof.tracks.size(), 0);
   for (size_t i = 0; i < moof.tracks.size(); i++) {
@@ -330,19 +491,25 @@ bool TrackRunIterator::Init(const MovieFragment& moof) {
     }
 
     // SampleEncryptionEntries should not have been parsed, without having
-    // iv_size. Parse the box now.
-    DCHECK(traf.sample_encryption.sample_encryption_entries.empty());
-    std::vector<SampleEncryptionEntry> sample_encryption_entries;
-    if (!traf.sample_encryption.sample_encryption_data.empty()) {
+    // iv_size. Only the boundaries of the entries are found here; they are
+    // parsed when their samples are decrypted.
+    const SampleEncryption& sample_encryption = traf.sample_encryption;
+    DCHECK(sample_encryption.sample_encryption_entries.empty());
+    scoped_ptr<BufferReader> sample_encryption_reader;
+    uint32_t sample_encryption_count = 0;
+    uint8_t default_per_sample_iv_size = 0;
+    if (!sample_encryption.sample_encryption_data.empty()) {
       RCHECK(audio_sample_entry || video_sample_entry);
-      const uint8_t default_per_sample_iv_size =
+      default_per_sample_iv_size =
           audio_sample_entry
               ? audio_sample_entry->sinf.info.track_encryption
                     .default_per_sample_iv_size
               : video_sample_entry->sinf.info.track_encryption
                     .default_per_sample_iv_size;
-      RCHECK(traf.sample_encryption.ParseFromSampleEncryptionData(
-          default_per_sample_iv_size, &sample_encryption_entries));
+      sample_encryption_reader.reset(
+          new BufferReader(sample_encryption.sample_encryption_data.data(),
+                           sample_encryption.sample_encryption_data.size()));
+      RCHECK(sample_encryption_reader->Read4(&sample_encryption_count));
     }
 
     int64_t run_start_dts = traf.decode_time_absent
@@ -367,13 +534,25 @@ bool TrackRunIterator::Init(const MovieFragment& moof) {
       // Populate sample encryption entries from SampleEncryption 'senc' box if
       // it is available; otherwise initialize aux_info variables, which will
       // be used to populate sample encryption entries later in CacheAuxInfo.
-      if (!sample_encryption_entries.empty()) {
-        RCHECK(sample_encryption_entries.size() >=
+      if (sample_encryption_reader) {
+        RCHECK(sample_encryption_count >=
                sample_count_sum + trun.sample_count);
+        const bool has_subsamples =
+            (sample_encryption.flags &
+             SampleEncryption::kUseSubsampleEncryption) != 0;
+        const size_t begin = sample_encryption_reader->pos();
+        tri.aux_info_offsets.reserve(trun.sample_count + 1);
         for (size_t k = 0; k < trun.sample_count; ++k) {
-          tri.sample_encryption_entries.push_back(
-              sample_encryption_entries[sample_count_sum + k]);
+          tri.aux_info_offsets.push_back(sample_encryption_reader->pos() -
+                                         begin);
+          RCHECK(SkipSampleEncryptionEntry(default_per_sample_iv_size,
+                                           has_subsamples,
+                                           sample_encryption_reader.get()));
         }
+        const size_t end = sample_encryption_reader->pos();
+        tri.aux_info_offsets.push_back(end - begin);
+        tri.aux_info.assign(sample_encryption_reader->data() + begin,
+                            sample_encryption_reader->data() + end);
       } else if (traf.auxiliary_offset.offsets.size() > j) {
         // Collect information from the auxiliary_offset entry with the same
         // index in the 'saiz' container as the current run's index in the
@@ -408,10 +587,13 @@ bool TrackRunIterator::Init(const MovieFragment& moof) {
         }
       }
 
-      tri.samples.resize(trun.sample_count);
+      tri.first_sample = fragment_samples_->size();
+      tri.sample_count = trun.sample_count;
+      fragment_samples_->Reserve(fragment_samples_->size() +
+                                 trun.sample_count);
       for (size_t k = 0; k < trun.sample_count; k++) {
-        PopulateSampleInfo(*trex, traf.header, trun, k, &tri.samples[k]);
-        run_start_dts += tri.samples[k].duration;
+        run_start_dts += PopulateSampleInfo(*trex, traf.header, trun, k,
+                                            fragment_samples_.get());
       }
       runs_.push_back(tri);
       sample_count_sum += trun.sample_count;
@@ -435,14 +617,29 @@ void TrackRunIterator::ResetRun() {
     return;
   sample_dts_ = run_itr_->start_dts;
   sample_offset_ = run_itr_->sample_start_offset;
-  sample_itr_ = run_itr_->samples.begin();
+  sample_index_ = 0;
+  if (run_itr_->sample_table_reader) {
+    // Only the run ahead of the cursor is decoded, into a table reused
+    // across the runs.
+    moov_run_samples_->Clear();
+    run_itr_->sample_table_reader->ReadSamples(run_itr_->first_sample,
+                                               run_itr_->sample_count,
+                                               moov_run_samples_.get());
+    run_samples_ = moov_run_samples_.get();
+    run_first_sample_ = 0;
+  } else {
+    run_samples_ = fragment_samples_.get();
+    run_first_sample_ = run_itr_->first_sample;
+  }
+  DCHECK_LE(run_first_sample_ + run_itr_->sample_count, run_samples_->size());
 }
 
 void TrackRunIterator::AdvanceSample() {
   DCHECK(IsSampleValid());
-  sample_dts_ += sample_itr_->duration;
-  sample_offset_ += sample_itr_->size;
-  ++sample_itr_;
+  const size_t index = run_first_sample_ + sample_index_;
+  sample_dts_ += run_samples_->durations[index];
+  sample_offset_ += run_samples_->sizes[index];
+  ++sample_index_;
 }
 
 // This implementation only indicates a need for caching if CENC auxiliary
@@ -450,38 +647,31 @@ void TrackRunIterator::AdvanceSample() {
 bool TrackRunIterator::AuxInfoNeedsToBeCached() {
   DCHECK(IsRunValid());
   return is_encrypted() && aux_info_size() > 0 &&
-         run_itr_->sample_encryption_entries.size() == 0;
+         run_itr_->aux_info_offsets.empty();
 }
 
-// This implementation currently only caches CENC auxiliary info.
+// This implementation currently only caches CENC auxiliary info. It is kept
+// raw; the entry of a sample is parsed when the sample is decrypted.
 bool TrackRunIterator::CacheAuxInfo(const uint8_t* buf, int buf_size) {
   RCHECK(AuxInfoNeedsToBeCached() && buf_size >= aux_info_size());
 
-  std::vector<SampleEncryptionEntry>& sample_encryption_entries =
-      runs_[run_itr_ - runs_.begin()].sample_encryption_entries;
-  sample_encryption_entries.resize(run_itr_->samples.size());
-  int64_t pos = 0;
-  for (size_t i = 0; i < run_itr_->samples.size(); i++) {
-    int info_size = run_itr_->aux_info_default_size;
-    if (!info_size)
-      info_size = run_itr_->aux_info_sizes[i];
-
-    BufferReader reader(buf + pos, info_size);
-    const bool has_subsamples =
-        info_size > track_encryption().default_per_sample_iv_size;
-    RCHECK(sample_encryption_entries[i].ParseFromBuffer(
-        track_encryption().default_per_sample_iv_size, has_subsamples,
-        &reader));
-    pos += info_size;
+  TrackRunInfo& run = runs_[run_itr_ - runs_.begin()];
+  run.aux_info.assign(buf, buf + aux_info_size());
+  run.aux_info_offsets.resize(run.sample_count + 1);
+  uint32_t pos = 0;
+  for (size_t i = 0; i < run.sample_count; i++) {
+    run.aux_info_offsets[i] = pos;
+    pos += run.aux_info_default_size ? run.aux_info_default_size
+                                     : run.aux_info_sizes[i];
   }
-
+  run.aux_info_offsets[run.sample_count] = pos;
   return true;
 }
 
 bool TrackRunIterator::IsRunValid() const { return run_itr_ != runs_.end(); }
 
 bool TrackRunIterator::IsSampleValid() const {
-  return IsRunValid() && (sample_itr_ != run_itr_->samples.end());
+  return IsRunValid() && sample_index_ < run_itr_->sample_count;
 }
 
 // Because tracks are in sorted order and auxiliary information is cached when
@@ -511,11 +701,28 @@ int64_t TrackRunIterator::GetMaxClearOffset() {
   return offset;
 }
 
+int64_t TrackRunIterator::GetRunDataSize(int64_t max_size) const {
+  DCHECK(IsSampleValid());
+  const uint32_t* sizes = &run_samples_->sizes[run_first_sample_];
+  int64_t size = sizes[sample_index_];
+  for (uint32_t i = sample_index_ + 1; i < run_itr_->sample_count; ++i) {
+    if (size + sizes[i] > max_size)
+      break;
+    size += sizes[i];
+  }
+  return size;
+}
+
 uint32_t TrackRunIterator::track_id() const {
   DCHECK(IsRunValid());
   return run_itr_->track_id;
 }
 
+int64_t TrackRunIterator::timescale() const {
+  DCHECK(IsRunValid());
+  return run_itr_->timescale;
+}
+
 bool TrackRunIterator::is_encrypted() const {
   DCHECK(IsRunValid());
   return track_encryption().default_is_protected == 1;
@@ -558,7 +765,7 @@ int64_t TrackRunIterator::sample_offset() const {
 
 int TrackRunIterator::sample_size() const {
   DCHECK(IsSampleValid());
-  return sample_itr_->size;
+  return run_samples_->sizes[run_first_sample_ + sample_index_];
 }
 
 int64_t TrackRunIterator::dts() const {
@@ -568,17 +775,18 @@ int64_t TrackRunIterator::dts() const {
 
 int64_t TrackRunIterator::cts() const {
   DCHECK(IsSampleValid());
-  return sample_dts_ + sample_itr_->cts_offset;
+  return sample_dts_ +
+         run_samples_->cts_offsets[run_first_sample_ + sample_index_];
 }
 
 int64_t TrackRunIterator::duration() const {
   DCHECK(IsSampleValid());
-  return sample_itr_->duration;
+  return run_samples_->durations[run_first_sample_ + sample_index_];
 }
 
 bool TrackRunIterator::is_keyframe() const {
   DCHECK(IsSampleValid());
-  return sample_itr_->is_keyframe;
+  return run_samples_->is_keyframe[run_first_sample_ + sample_index_] != 0;
 }
 
 const TrackEncryption& TrackRunIterator::track_encryption() const {
@@ -589,12 +797,23 @@ const TrackEncryption& TrackRunIterator::track_encryption() const {
 }
 
 scoped_ptr<DecryptConfig> TrackRunIterator::GetDecryptConfig() {
-  size_t sample_idx = sample_itr_ - run_itr_->samples.begin();
-  DCHECK_LT(sample_idx, run_itr_->sample_encryption_entries.size());
-  const SampleEncryptionEntry& sample_encryption_entry =
-      run_itr_->sample_encryption_entries[sample_idx];
   DCHECK(is_encrypted());
   DCHECK(!AuxInfoNeedsToBeCached());
+  const std::vector<uint32_t>& offsets = run_itr_->aux_info_offsets;
+  if (sample_index_ + 1 >= offsets.size()) {
+    LOG(ERROR) << "Missing CENC auxiliary information.";
+    return scoped_ptr<DecryptConfig>();
+  }
+  const uint32_t entry_offset = offsets[sample_index_];
+  const uint32_t entry_size = offsets[sample_index_ + 1] - entry_offset;
+  BufferReader reader(run_itr_->aux_info.data() + entry_offset, entry_size);
+  const uint8_t iv_size = track_encryption().default_per_sample_iv_size;
+  SampleEncryptionEntry sample_encryption_entry;
+  if (!sample_encryption_entry.ParseFromBuffer(iv_size, entry_size > iv_size,
+                                               &reader)) {
+    LOG(ERROR) << "Invalid CENC auxiliary information.";
+    return scoped_ptr<DecryptConfig>();
+  }
 
   const size_t total_size_of_subsamples =
       sample_encryption_entry.GetTotalSizeOfSubsamples();
@@ -17,7 +17,8 @@ class DecryptConfig;
 
 namespace mp4 {
 
-struct SampleInfo;
+class SampleTableReader;
+struct SampleInfoTable;
 struct TrackRunInfo;
 
 class TrackRunIterator {
@@ -35,6 +36,12 @@ class TrackRunIterator {
   /// @return true on success, false otherwise.
   bool Init();
 
+  /// Same as Init(), but only sets up the chunks of one track of a
+  /// non-fragmented mp4, so the track can be iterated on its own.
+  /// @param track_id is the id of the track to iterate.
+  /// @return true on success, false otherwise.
+  bool InitForTrack(uint32_t track_id);
+
   /// Set up the iterator to handle all the runs from the current fragment.
   /// @return true on success, false otherwise.
   bool Init(const MovieFragment& moof);
@@ -71,9 +78,16 @@ class TrackRunIterator {
   ///         head of the MOOF box).
   int64_t GetMaxClearOffset();
 
+  /// @return the size of the data of the current sample and of the samples
+  ///         following it in the current run, which are contiguous, limited
+  ///         to the samples fitting within @a max_size. The current sample is
+  ///         always included. Only valid if IsSampleValid().
+  int64_t GetRunDataSize(int64_t max_size) const;
+
   /// @name Properties of the current run. Only valid if IsRunValid().
   /// @{
   uint32_t track_id() const;
+  int64_t timescale() const;
   int64_t aux_info_offset() const;
   int aux_info_size() const;
   bool is_encrypted() const;
@@ -101,6 +115,11 @@ class TrackRunIterator {
   scoped_ptr<DecryptConfig> GetDecryptConfig();
 
  private:
+  // Sets up the chunks of the track with |track_id|, or of all the tracks if
+  // |track_id| is zero, which is not a valid track id.
+  bool InitFromMoov(uint32_t track_id);
+  // Points the iterator to the first sample of the current run, decoding the
+  // samples of the run if it was set up from moov.
   void ResetRun();
   const TrackEncryption& track_encryption() const;
 
@@ -108,7 +127,20 @@ class TrackRunIterator {
 
   std::vector<TrackRunInfo> runs_;
   std::vector<TrackRunInfo>::const_iterator run_itr_;
-  std::vector<SampleInfo>::const_iterator sample_itr_;
+  // The samples of all the runs set up from moof.
+  scoped_ptr<SampleInfoTable> fragment_samples_;
+  // The samples of the current run if it was set up from moov, decoded when
+  // the run becomes current.
+  scoped_ptr<SampleInfoTable> moov_run_samples_;
+  // The table holding the samples of the current run, and the index of its
+  // first sample in it.
+  const SampleInfoTable* run_samples_;
+  uint32_t run_first_sample_;
+  // Index of the current sample in the current run.
+  uint32_t sample_index_;
+  // Decode the samples of the runs set up from moov, one per track, so that
+  // the samples are not materialized upfront.
+  std::vector<SampleTableReader*> sample_table_readers_;
 
   // Track the start dts of the next segment, only useful if decode_time box is
   // absent.
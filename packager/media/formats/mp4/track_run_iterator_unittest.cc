@@ -617,6 +617,28 @@ TEST_F(TrackRunIteratorTest, DecryptConfigTestWithAuxInfo) {
   EXPECT_EQ(config->subsamples()[1].cipher_bytes, 4u);
 }
 
+// The aux info is only parsed when the DecryptConfig of a sample is requested,
+// so an invalid entry only fails its own sample.
+TEST_F(TrackRunIteratorTest, DecryptConfigTestWithInvalidAuxInfo) {
+  AddEncryption(FOURCC_cenc, &moov_.tracks[1]);
+  iter_.reset(new TrackRunIterator(&moov_));
+
+  MovieFragment moof = CreateFragment();
+  AddAuxInfoHeaders(50, &moof.tracks[1]);
+
+  ASSERT_TRUE(iter_->Init(moof));
+  EXPECT_EQ(iter_->track_id(), 2u);
+  std::vector<uint8_t> aux_info(kAuxInfo, kAuxInfo + arraysize(kAuxInfo));
+  // Sample 2: one more subsample than the entry holds.
+  aux_info[17] = 0x03;
+  EXPECT_TRUE(iter_->CacheAuxInfo(aux_info.data(), aux_info.size()));
+  scoped_ptr<DecryptConfig> config = iter_->GetDecryptConfig();
+  ASSERT_TRUE(config);
+  EXPECT_EQ(std::vector<uint8_t>(kIv1, kIv1 + arraysize(kIv1)), config->iv());
+  iter_->AdvanceSample();
+  EXPECT_FALSE(iter_->GetDecryptConfig());
+}
+
 // It is legal for aux info blocks to be shared among multiple formats.
 TEST_F(TrackRunIteratorTest, SharedAuxInfoTest) {
   AddEncryption(FOURCC_cenc, &moov_.tracks[0]);
@@ -697,6 +719,92 @@ TEST_F(TrackRunIteratorTest, UnexpectedOrderingTest) {
   EXPECT_EQ(iter_->GetMaxClearOffset(), 10000);
 }
 
+// The samples of a non-fragmented track are decoded from its sample table,
+// here in the order of the chunk offsets rather than of the samples.
+TEST_F(TrackRunIteratorTest, SampleTableTest) {
+  Movie moov;
+  moov.tracks.resize(1);
+  Track& track = moov.tracks[0];
+  track.header.track_id = 1;
+  track.media.header.timescale = kVideoScale;
+  SampleTable& sample_table = track.media.information.sample_table;
+  sample_table.description.type = kVideo;
+  sample_table.description.video_entries.push_back(VideoSampleEntry());
+
+  const DecodingTime kDecodingTimes[] = {{3, 100}, {2, 200}};
+  sample_table.decoding_time_to_sample.decoding_time.assign(
+      kDecodingTimes, kDecodingTimes + arraysize(kDecodingTimes));
+  const CompositionOffset kCompositionOffsets[] = {{1, 200}, {1, 0}, {3, 100}};
+  sample_table.composition_time_to_sample.composition_offset.assign(
+      kCompositionOffsets,
+      kCompositionOffsets + arraysize(kCompositionOffsets));
+  const ChunkInfo kChunkInfos[] = {{1, 2, 1}, {3, 1, 1}};
+  sample_table.sample_to_chunk.chunk_info.assign(
+      kChunkInfos, kChunkInfos + arraysize(kChunkInfos));
+  const uint32_t kSampleSizes[] = {10, 20, 30, 40, 50};
+  sample_table.sample_size.sample_count = arraysize(kSampleSizes);
+  sample_table.sample_size.sizes.assign(
+      kSampleSizes, kSampleSizes + arraysize(kSampleSizes));
+  const uint64_t kChunkOffsets[] = {1000, 2000, 500};
+  sample_table.chunk_large_offset.offsets.assign(
+      kChunkOffsets, kChunkOffsets + arraysize(kChunkOffsets));
+  sample_table.sync_sample.sample_number.push_back(1);
+  sample_table.sync_sample.sample_number.push_back(4);
+
+  iter_.reset(new TrackRunIterator(&moov));
+  ASSERT_TRUE(iter_->Init());
+
+  // The last chunk comes first.
+  ASSERT_TRUE(iter_->IsSampleValid());
+  EXPECT_EQ(500, iter_->sample_offset());
+  EXPECT_EQ(50, iter_->sample_size());
+  EXPECT_EQ(500, iter_->dts());
+  EXPECT_EQ(600, iter_->cts());
+  EXPECT_EQ(200, iter_->duration());
+  EXPECT_FALSE(iter_->is_keyframe());
+  iter_->AdvanceSample();
+  EXPECT_FALSE(iter_->IsSampleValid());
+
+  // Then the first chunk, which decodes the table from its start again.
+  iter_->AdvanceRun();
+  ASSERT_TRUE(iter_->IsSampleValid());
+  EXPECT_EQ(30, iter_->GetRunDataSize(1000));
+  EXPECT_EQ(10, iter_->GetRunDataSize(15));
+  EXPECT_EQ(1000, iter_->sample_offset());
+  EXPECT_EQ(10, iter_->sample_size());
+  EXPECT_EQ(0, iter_->dts());
+  EXPECT_EQ(200, iter_->cts());
+  EXPECT_EQ(100, iter_->duration());
+  EXPECT_TRUE(iter_->is_keyframe());
+  iter_->AdvanceSample();
+  EXPECT_EQ(1010, iter_->sample_offset());
+  EXPECT_EQ(20, iter_->sample_size());
+  EXPECT_EQ(100, iter_->dts());
+  EXPECT_EQ(100, iter_->cts());
+  EXPECT_FALSE(iter_->is_keyframe());
+  iter_->AdvanceSample();
+  EXPECT_FALSE(iter_->IsSampleValid());
+
+  iter_->AdvanceRun();
+  ASSERT_TRUE(iter_->IsSampleValid());
+  EXPECT_EQ(2000, iter_->sample_offset());
+  EXPECT_EQ(30, iter_->sample_size());
+  EXPECT_EQ(200, iter_->dts());
+  EXPECT_EQ(300, iter_->cts());
+  EXPECT_FALSE(iter_->is_keyframe());
+  iter_->AdvanceSample();
+  EXPECT_EQ(2030, iter_->sample_offset());
+  EXPECT_EQ(40, iter_->sample_size());
+  EXPECT_EQ(300, iter_->dts());
+  EXPECT_EQ(400, iter_->cts());
+  EXPECT_EQ(200, iter_->duration());
+  EXPECT_TRUE(iter_->is_keyframe());
+  iter_->AdvanceSample();
+  EXPECT_FALSE(iter_->IsSampleValid());
+  iter_->AdvanceRun();
+  EXPECT_FALSE(iter_->IsRunValid());
+}
+
 }  // namespace mp4
 }  // namespace media
 }  // namespace edash_packager
@@ -48,11 +48,11 @@ bool H264VideoSliceHeaderParser::Initialize(
 
 int64_t H264VideoSliceHeaderParser::GetHeaderSize(const Nalu& nalu) {
   DCHECK(nalu.is_video_slice());
-  H264SliceHeader slice_header;
-  if (parser_.ParseSliceHeader(nalu, &slice_header) != H264Parser::kOk)
+  off_t header_bit_size;
+  if (parser_.ParseSliceHeaderSize(nalu, &header_bit_size) != H264Parser::kOk)
     return -1;
 
-  return NumBitsToNumBytes(slice_header.header_bit_size);
+  return NumBitsToNumBytes(header_bit_size);
 }
 
 H265VideoSliceHeaderParser::H265VideoSliceHeaderParser() {}
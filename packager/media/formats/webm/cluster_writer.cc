@@ -0,0 +1,261 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/formats/webm/cluster_writer.h"
+
+#include <string.h>
+
+#include "packager/base/logging.h"
+#include "packager/media/base/media_sample.h"
+#include "packager/media/formats/webm/mkv_writer.h"
+#include "packager/third_party/libwebm/src/mkvmuxerutil.hpp"
+#include "packager/third_party/libwebm/src/webmids.hpp"
+
+namespace edash_packager {
+namespace media {
+namespace webm {
+namespace {
+
+// The size of the Cluster size field. The size is unknown when the Cluster
+// header is written, so mkvmuxer reserves the largest size.
+const int kClusterSizeFieldSize = 8;
+// The size of the Block header following the Block size: the track number,
+// which takes one byte as in mkvmuxer, the relative timecode and the flags.
+const uint64_t kBlockHeaderSize = 4;
+const uint8_t kKeyFrameFlag = 0x80;
+// Same limits as mkvmuxer.
+const int64_t kMaxBlockTimecode = 0x7FFF;
+const uint64_t kMaxTrackNumber = 126;
+// Buffered data is written out once it reaches this size, which bounds the
+// memory used and the number of samples kept alive by the buffer.
+const uint64_t kMaxBufferedSize = 4 * 1024 * 1024;
+
+// An IMkvWriter serializing into a BufferWriter, so element headers are
+// encoded by the same code as in mkvmuxer.
+class BufferMkvWriter : public mkvmuxer::IMkvWriter {
+ public:
+  explicit BufferMkvWriter(BufferWriter* buffer) : buffer_(buffer) {}
+  ~BufferMkvWriter() override {}
+
+  mkvmuxer::int32 Write(const void* buf, mkvmuxer::uint32 len) override {
+    buffer_->AppendArray(static_cast<const uint8_t*>(buf), len);
+    return 0;
+  }
+  mkvmuxer::int64 Position() const override { return buffer_->Size(); }
+  mkvmuxer::int32 Position(mkvmuxer::int64 position) override { return -1; }
+  bool Seekable() const override { return false; }
+  void ElementStartNotify(mkvmuxer::uint64 element_id,
+                          mkvmuxer::int64 position) override {}
+
+ private:
+  BufferWriter* buffer_;
+
+  DISALLOW_COPY_AND_ASSIGN(BufferMkvWriter);
+};
+
+}  // namespace
+
+ClusterWriter::ClusterWriter(uint64_t timecode,
+                             uint64_t timecode_scale,
+                             MkvWriter* writer,
+                             bool progressive)
+    : timecode_(timecode),
+      timecode_scale_(timecode_scale),
+      writer_(writer),
+      progressive_(progressive),
+      size_position_(-1),
+      payload_size_(0),
+      header_written_(false),
+      finalized_(false) {
+  DCHECK(writer_);
+  DCHECK_GT(timecode_scale_, 0u);
+}
+
+ClusterWriter::~ClusterWriter() {}
+
+Status ClusterWriter::AddFrame(const scoped_refptr<MediaSample>& sample,
+                               uint64_t track_number,
+                               uint64_t timestamp_ns,
+                               uint64_t duration_ns,
+                               uint64_t reference_timestamp_ns) {
+  DCHECK(sample);
+  if (finalized_)
+    return Status(error::MUXER_FAILURE, "Cluster is already finalized.");
+  if (sample->data_size() == 0 || track_number == 0 ||
+      track_number > kMaxTrackNumber) {
+    return Status(error::MUXER_FAILURE, "Invalid frame.");
+  }
+  const int64_t relative_timecode =
+      GetRelativeTimecode(timestamp_ns / timecode_scale_);
+  if (relative_timecode < 0) {
+    return Status(error::MUXER_FAILURE,
+                  "Frame timecode is out of range of the cluster.");
+  }
+
+  if (!header_written_)
+    WriteClusterHeader();
+
+  BufferMkvWriter header_writer(&header_);
+  BufferMkvWriter trailer_writer(&trailer_);
+  const uint64_t block_payload_size = kBlockHeaderSize + sample->data_size();
+  bool ok = true;
+  uint8_t flags = 0;
+  if (sample->side_data_size() == 0 && duration_ns == 0) {
+    ok = mkvmuxer::WriteID(&header_writer, mkvmuxer::kMkvSimpleBlock) == 0 &&
+         mkvmuxer::WriteUInt(&header_writer, block_payload_size) == 0;
+    if (sample->is_key_frame())
+      flags |= kKeyFrameFlag;
+  } else {
+    // The elements following the Block are serialized first, as their size is
+    // part of the BlockGroup header. The order is the same as in mkvmuxer.
+    if (sample->side_data_size() > 0) {
+      uint64_t block_add_id;
+      // First 8 bytes of side_data is the BlockAddID element's value, which is
+      // done to mimic ffmpeg behavior. See webm_cluster_parser.cc for details.
+      CHECK_GT(sample->side_data_size(), sizeof(block_add_id));
+      memcpy(&block_add_id, sample->side_data(), sizeof(block_add_id));
+      const uint8_t* additional = sample->side_data() + sizeof(block_add_id);
+      const uint64_t additional_size =
+          sample->side_data_size() - sizeof(block_add_id);
+
+      const uint64_t block_more_payload_size =
+          mkvmuxer::EbmlElementSize(mkvmuxer::kMkvBlockAddID,
+                                    static_cast<mkvmuxer::uint64>(
+                                        block_add_id)) +
+          mkvmuxer::EbmlElementSize(mkvmuxer::kMkvBlockAdditional, additional,
+                                    additional_size);
+      const uint64_t block_additions_payload_size =
+          mkvmuxer::EbmlMasterElementSize(mkvmuxer::kMkvBlockMore,
+                                          block_more_payload_size) +
+          block_more_payload_size;
+      ok = mkvmuxer::WriteEbmlMasterElement(&trailer_writer,
+                                            mkvmuxer::kMkvBlockAdditions,
+                                            block_additions_payload_size) &&
+           mkvmuxer::WriteEbmlMasterElement(&trailer_writer,
+                                            mkvmuxer::kMkvBlockMore,
+                                            block_more_payload_size) &&
+           mkvmuxer::WriteEbmlElement(
+               &trailer_writer, mkvmuxer::kMkvBlockAddID,
+               static_cast<mkvmuxer::uint64>(block_add_id)) &&
+           mkvmuxer::WriteEbmlElement(&trailer_writer,
+                                      mkvmuxer::kMkvBlockAdditional,
+                                      additional, additional_size);
+    }
+    if (!sample->is_key_frame()) {
+      ok = ok && mkvmuxer::WriteEbmlElement(
+                     &trailer_writer, mkvmuxer::kMkvReferenceBlock,
+                     static_cast<mkvmuxer::uint64>(reference_timestamp_ns /
+                                                   timecode_scale_));
+    }
+    const uint64_t duration = duration_ns / timecode_scale_;
+    if (duration > 0) {
+      ok = ok && mkvmuxer::WriteEbmlElement(
+                     &trailer_writer, mkvmuxer::kMkvBlockDuration,
+                     static_cast<mkvmuxer::uint64>(duration));
+    }
+
+    const uint64_t block_size =
+        mkvmuxer::EbmlMasterElementSize(mkvmuxer::kMkvBlock,
+                                        block_payload_size) +
+        block_payload_size;
+    ok = ok &&
+         mkvmuxer::WriteEbmlMasterElement(&header_writer,
+                                          mkvmuxer::kMkvBlockGroup,
+                                          block_size + trailer_.Size()) &&
+         mkvmuxer::WriteEbmlMasterElement(&header_writer, mkvmuxer::kMkvBlock,
+                                          block_payload_size);
+  }
+  ok = ok &&
+       mkvmuxer::WriteUInt(&header_writer, track_number) == 0 &&
+       mkvmuxer::SerializeInt(&header_writer, relative_timecode, 2) == 0 &&
+       mkvmuxer::SerializeInt(&header_writer, flags, 1) == 0;
+  if (!ok) {
+    header_.Clear();
+    trailer_.Clear();
+    return Status(error::MUXER_FAILURE, "Failed to serialize block header.");
+  }
+
+  payload_size_ += header_.Size() + sample->data_size() + trailer_.Size();
+  buffered_data_.AppendBuffer(header_);
+  buffered_data_.AppendSample(sample);
+  buffered_data_.AppendBuffer(trailer_);
+  header_.Clear();
+  trailer_.Clear();
+
+  if (progressive_) {
+    Status status = Flush();
+    if (!status.ok())
+      return status;
+    return writer_->FlushFile();
+  }
+  if (buffered_data_.Size() >= kMaxBufferedSize)
+    return Flush();
+  return Status::OK;
+}
+
+bool ClusterWriter::Finalize() {
+  if (finalized_ || !header_written_)
+    return false;
+
+  Status status = Flush();
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to write cluster: " << status;
+    return false;
+  }
+  if (writer_->Seekable() && !progressive_) {
+    const int64_t position = writer_->Position();
+    if (writer_->Position(size_position_) != 0 ||
+        mkvmuxer::WriteUIntSize(writer_, payload_size_,
+                                kClusterSizeFieldSize) != 0 ||
+        writer_->Position(position) != 0) {
+      return false;
+    }
+  }
+  finalized_ = true;
+  return true;
+}
+
+uint64_t ClusterWriter::Size() const {
+  return mkvmuxer::EbmlMasterElementSize(mkvmuxer::kMkvCluster,
+                                         mkvmuxer::kEbmlUnknownValue) +
+         payload_size_;
+}
+
+int64_t ClusterWriter::GetRelativeTimecode(int64_t abs_timecode) const {
+  const int64_t relative_timecode =
+      abs_timecode - static_cast<int64_t>(timecode_);
+  if (relative_timecode < 0 || relative_timecode > kMaxBlockTimecode)
+    return -1;
+  return relative_timecode;
+}
+
+void ClusterWriter::WriteClusterHeader() {
+  DCHECK(!header_written_);
+  DCHECK_EQ(0u, header_.Size());
+
+  BufferMkvWriter header_writer(&header_);
+  mkvmuxer::WriteID(&header_writer, mkvmuxer::kMkvCluster);
+  size_position_ =
+      writer_->Position() + buffered_data_.Size() + header_.Size();
+  mkvmuxer::SerializeInt(&header_writer, mkvmuxer::kEbmlUnknownValue,
+                         kClusterSizeFieldSize);
+  const size_t timecode_element_start = header_.Size();
+  mkvmuxer::WriteEbmlElement(&header_writer, mkvmuxer::kMkvTimecode,
+                             static_cast<mkvmuxer::uint64>(timecode_));
+  payload_size_ += header_.Size() - timecode_element_start;
+
+  buffered_data_.AppendBuffer(header_);
+  header_.Clear();
+  header_written_ = true;
+}
+
+Status ClusterWriter::Flush() {
+  return writer_->WriteFromBufferChain(&buffered_data_);
+}
+
+}  // namespace webm
+}  // namespace media
+}  // namespace edash_packager
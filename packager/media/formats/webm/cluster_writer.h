@@ -0,0 +1,111 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_FORMATS_WEBM_CLUSTER_WRITER_H_
+#define MEDIA_FORMATS_WEBM_CLUSTER_WRITER_H_
+
+#include <stdint.h>
+
+#include "packager/base/memory/ref_counted.h"
+#include "packager/media/base/buffer_chain.h"
+#include "packager/media/base/buffer_writer.h"
+#include "packager/media/base/status.h"
+
+namespace edash_packager {
+namespace media {
+
+class MediaSample;
+class MkvWriter;
+
+namespace webm {
+
+/// Writes a Cluster element, producing the same bytes as mkvmuxer::Cluster,
+/// without copying the frames. mkvmuxer::Frame makes a copy of every frame and
+/// mkvmuxer::Cluster writes the element headers a few bytes at a time. Here the
+/// element headers are serialized into a buffer and the frame data is
+/// referenced, so the Cluster is written to the file with a few vectored
+/// writes, copying each frame only on its way to the file.
+class ClusterWriter {
+ public:
+  /// @param timecode is the timecode of the Cluster, in timecode scale.
+  /// @param timecode_scale is the timecode scale, in nanoseconds.
+  /// @param writer is the output. It should outlive this object.
+  /// @param progressive makes the Cluster readable while it is written, for
+  ///        live output: its size is left unknown, and every frame is written
+  ///        and flushed to the file as soon as it is added.
+  ClusterWriter(uint64_t timecode,
+                uint64_t timecode_scale,
+                MkvWriter* writer,
+                bool progressive);
+  ~ClusterWriter();
+
+  /// Add a frame to the Cluster. The frame is written as a SimpleBlock, or as
+  /// a BlockGroup if it has a duration or side data.
+  /// @param sample is the frame. Its data is referenced, not copied, so it
+  ///        should not be modified afterwards. The first 8 bytes of its side
+  ///        data, if any, are the BlockAddID of the BlockAdditional.
+  /// @param track_number is the track number of the frame.
+  /// @param timestamp_ns is the timestamp of the frame, in nanoseconds.
+  /// @param duration_ns is the duration of the frame, in nanoseconds, or 0 to
+  ///        omit it.
+  /// @param reference_timestamp_ns is the timestamp of the frame referenced by
+  ///        a non-keyframe BlockGroup, in nanoseconds.
+  /// @return OK on success, an error status otherwise.
+  Status AddFrame(const scoped_refptr<MediaSample>& sample,
+                  uint64_t track_number,
+                  uint64_t timestamp_ns,
+                  uint64_t duration_ns,
+                  uint64_t reference_timestamp_ns);
+
+  /// Write the buffered data and, if the output is seekable and the Cluster
+  /// is not progressive, the size of the Cluster. No frames can be added
+  /// afterwards.
+  /// @return true on success. Like mkvmuxer::Cluster, fails if no frame was
+  ///         added.
+  bool Finalize();
+
+  /// @return The size of the Cluster element, including its header.
+  uint64_t Size() const;
+
+  /// @return The timecode relative to the Cluster of @a abs_timecode, which is
+  ///         in timecode scale; or -1 if it does not fit in a block.
+  int64_t GetRelativeTimecode(int64_t abs_timecode) const;
+
+  uint64_t timecode() const { return timecode_; }
+  uint64_t timecode_scale() const { return timecode_scale_; }
+
+ private:
+  // Serializes the Cluster ID, the unknown size and the Timecode element.
+  void WriteClusterHeader();
+  // Writes the buffered data to |writer_|.
+  Status Flush();
+
+  const uint64_t timecode_;
+  const uint64_t timecode_scale_;
+  MkvWriter* writer_;
+  const bool progressive_;
+
+  // The element headers of the blocks being serialized.
+  BufferWriter header_;
+  // The elements which follow the frame data in a BlockGroup.
+  BufferWriter trailer_;
+  // The data not yet written to |writer_|.
+  BufferChain buffered_data_;
+
+  // The position in the output of the size of the Cluster.
+  int64_t size_position_;
+  uint64_t payload_size_;
+  bool header_written_;
+  bool finalized_;
+
+  DISALLOW_COPY_AND_ASSIGN(ClusterWriter);
+};
+
+}  // namespace webm
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_FORMATS_WEBM_CLUSTER_WRITER_H_
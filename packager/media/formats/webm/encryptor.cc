@@ -68,30 +68,25 @@ Status Encryptor::EncryptFrame(scoped_refptr<MediaSample> sample,
                                bool encrypt_frame) {
   DCHECK(encryptor_);
 
-  const size_t sample_size = sample->data_size();
   if (encrypt_frame) {
     // | 1 | iv | enc_data |
-    const size_t iv_size = encryptor_->iv().size();
-    sample->resize_data(sample_size + iv_size + 1);
-    uint8_t* sample_data = sample->writable_data();
-
     // Encrypt the data in-place.
-    if (!encryptor_->Crypt(sample_data, sample_size, sample_data)) {
+    uint8_t* sample_data = sample->writable_data();
+    if (!encryptor_->Crypt(sample_data, sample->data_size(), sample_data)) {
       return Status(error::MUXER_FAILURE, "Failed to encrypt the frame.");
     }
 
-    // First move the sample data to after the IV; then write the IV and signal
-    // byte.
-    memmove(sample_data + iv_size + 1, sample_data, sample_size);
+    // Then write the signal byte and the IV in front of it, in the headroom
+    // of the sample.
+    const size_t iv_size = encryptor_->iv().size();
+    sample_data = sample->PrependData(iv_size + 1);
     sample_data[0] = 0x01;
     memcpy(sample_data + 1, encryptor_->iv().data(), iv_size);
 
     encryptor_->UpdateIv();
   } else {
     // | 0 | data |
-    sample->resize_data(sample_size + 1);
-    uint8_t* sample_data = sample->writable_data();
-    memmove(sample_data + 1, sample_data, sample_size);
+    uint8_t* sample_data = sample->PrependData(1);
     sample_data[0] = 0x00;
   }
 
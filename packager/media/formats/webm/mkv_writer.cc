@@ -6,12 +6,29 @@
 
 #include "packager/media/formats/webm/mkv_writer.h"
 
-namespace edash_packager {
-namespace media {
+#include <string.h>
+
+#include <algorithm>
 
-MkvWriter::MkvWriter() : position_(0) {}
+#include "packager/base/logging.h"
+#include "packager/media/base/buffer_chain.h"
 
-MkvWriter::~MkvWriter() {}
+namespace edash_packager {
+namespace media {
+namespace {
+// Writes of at least this size bypass the write buffer, which is also flushed
+// once it reaches this size.
+const size_t kWriteBufferSize = 64 * 1024;
+}  // namespace
+
+MkvWriter::MkvWriter() : position_(0), buffer_position_(0), seekable_(false) {}
+
+MkvWriter::~MkvWriter() {
+  // The file is closed without Close() when the writer is reset, so make sure
+  // the buffered data is not lost.
+  if (file_ && !Flush())
+    LOG(ERROR) << "Failed to write buffered data to " << file_->file_name();
+}
 
 Status MkvWriter::Open(const std::string& name) {
   DCHECK(!file_);
@@ -23,12 +40,15 @@ Status MkvWriter::Open(const std::string& name) {
   // on File.
   seekable_ = file_->Seek(0);
   position_ = 0;
+  buffer_position_ = 0;
+  buffer_.clear();
   return Status::OK;
 }
 
 Status MkvWriter::Close() {
   const std::string file_name = file_->file_name();
-  if (!file_.release()->Close()) {
+  const bool flushed = Flush();
+  if (!file_.release()->Close() || !flushed) {
     return Status(error::FILE_FAILURE, "Cannot close file " + file_name);
   }
   return Status::OK;
@@ -37,19 +57,28 @@ Status MkvWriter::Close() {
 mkvmuxer::int32 MkvWriter::Write(const void* buf, mkvmuxer::uint32 len) {
   DCHECK(file_);
 
-  const char* data = reinterpret_cast<const char*>(buf);
-  int64_t total_bytes_written = 0;
-  while (total_bytes_written < len) {
-    const int64_t written =
-        file_->Write(data + total_bytes_written, len - total_bytes_written);
-    if (written < 0)
-      return written;
-
-    total_bytes_written += written;
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(buf);
+  if (len >= kWriteBufferSize) {
+    if (!Flush() || !WriteToFile(data, len))
+      return -1;
+    position_ += len;
+    buffer_position_ = position_;
+    return 0;
   }
 
-  DCHECK_EQ(total_bytes_written, len);
+  // |position_| is within or at the end of the buffer, see Position(int64).
+  // Overwrite the buffered data first, e.g. a size patched after a seek, then
+  // append the rest.
+  const size_t offset = position_ - buffer_position_;
+  DCHECK_LE(offset, buffer_.size());
+  const size_t overwrite_size = std::min<size_t>(len, buffer_.size() - offset);
+  if (overwrite_size > 0)
+    memcpy(&buffer_[offset], data, overwrite_size);
+  buffer_.insert(buffer_.end(), data + overwrite_size, data + len);
   position_ += len;
+
+  if (buffer_.size() >= kWriteBufferSize && !Flush())
+    return -1;
   return 0;
 }
 
@@ -59,15 +88,45 @@ int64_t MkvWriter::WriteFromFile(File* source) {
 
 int64_t MkvWriter::WriteFromFile(File* source, uint64_t max_copy) {
   DCHECK(file_);
+  if (!Flush())
+    return -1;
 
   const int64_t size = File::CopyFile(source, file_.get(), max_copy);
   if (size < 0)
     return size;
 
   position_ += size;
+  buffer_position_ = position_;
   return size;
 }
 
+Status MkvWriter::WriteFromBufferChain(BufferChain* chain) {
+  DCHECK(file_);
+  DCHECK(chain);
+
+  const uint64_t size = chain->Size();
+  if (size == 0)
+    return Status::OK;
+  if (!Flush())
+    return Status(error::FILE_FAILURE, "Failed to write buffered data.");
+  Status status = chain->WriteToFile(file_.get());
+  if (!status.ok())
+    return status;
+
+  position_ += size;
+  buffer_position_ = position_;
+  return Status::OK;
+}
+
+Status MkvWriter::FlushFile() {
+  DCHECK(file_);
+  if (!Flush() || !file_->Flush()) {
+    return Status(error::FILE_FAILURE,
+                  "Cannot flush file " + file_->file_name());
+  }
+  return Status::OK;
+}
+
 mkvmuxer::int64 MkvWriter::Position() const {
   return position_;
 }
@@ -75,12 +134,19 @@ mkvmuxer::int64 MkvWriter::Position() const {
 mkvmuxer::int32 MkvWriter::Position(mkvmuxer::int64 position) {
   DCHECK(file_);
 
-  if (file_->Seek(position)) {
+  // Seeks within the buffered data, e.g. to patch an element size written
+  // shortly before, are served by the buffer.
+  if (position >= buffer_position_ &&
+      position <= buffer_position_ + static_cast<int64_t>(buffer_.size())) {
     position_ = position;
     return 0;
-  } else {
-    return -1;
   }
+
+  if (!Flush() || !file_->Seek(position))
+    return -1;
+  position_ = position;
+  buffer_position_ = position;
+  return 0;
 }
 
 bool MkvWriter::Seekable() const {
@@ -90,5 +156,40 @@ bool MkvWriter::Seekable() const {
 void MkvWriter::ElementStartNotify(mkvmuxer::uint64 element_id,
                                    mkvmuxer::int64 position) {}
 
+File* MkvWriter::file() {
+  if (file_ && !Flush())
+    LOG(ERROR) << "Failed to write buffered data to " << file_->file_name();
+  return file_.get();
+}
+
+bool MkvWriter::Flush() {
+  DCHECK(file_);
+  if (buffer_.empty())
+    return true;
+
+  if (!WriteToFile(buffer_.data(), buffer_.size()))
+    return false;
+  const int64_t file_position =
+      buffer_position_ + static_cast<int64_t>(buffer_.size());
+  buffer_.clear();
+  // The position may be within the data just written after a seek.
+  if (position_ != file_position && !file_->Seek(position_))
+    return false;
+  buffer_position_ = position_;
+  return true;
+}
+
+bool MkvWriter::WriteToFile(const uint8_t* data, size_t size) {
+  size_t total_bytes_written = 0;
+  while (total_bytes_written < size) {
+    const int64_t written =
+        file_->Write(data + total_bytes_written, size - total_bytes_written);
+    if (written <= 0)
+      return false;
+    total_bytes_written += written;
+  }
+  return true;
+}
+
 }  // namespace media
 }  // namespace edash_packager
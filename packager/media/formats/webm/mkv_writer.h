@@ -7,7 +7,10 @@
 #ifndef MEDIA_FORMATS_WEBM_MKV_WRITER_H_
 #define MEDIA_FORMATS_WEBM_MKV_WRITER_H_
 
+#include <stdint.h>
+
 #include <string>
+#include <vector>
 
 #include "packager/base/memory/scoped_ptr.h"
 #include "packager/media/base/status.h"
@@ -17,7 +20,11 @@
 namespace edash_packager {
 namespace media {
 
-/// An implementation of IMkvWriter using our File type.
+class BufferChain;
+
+/// An implementation of IMkvWriter using our File type. libwebm writes EBML
+/// IDs and sizes a few bytes at a time, so small writes are combined in a
+/// buffer before being written to the file.
 class MkvWriter : public mkvmuxer::IMkvWriter {
  public:
   MkvWriter();
@@ -28,7 +35,8 @@ class MkvWriter : public mkvmuxer::IMkvWriter {
   /// @param name The path to the file to open.
   /// @return Whether the operation succeeded.
   Status Open(const std::string& name);
-  /// Closes the file.  MUST call Open before calling any other methods.
+  /// Writes the buffered data and closes the file.  MUST call Open before
+  /// calling any other methods.
   Status Close();
 
   /// Writes out @a len bytes of @a buf.
@@ -57,13 +65,33 @@ class MkvWriter : public mkvmuxer::IMkvWriter {
   /// number of bytes.  If @a max_copy is negative, will copy to EOF.
   /// @return The number of bytes written; or < 0 on error.
   int64_t WriteFromFile(File* source, uint64_t max_copy);
+  /// Writes the contents of @a chain to this file with a vectored write. The
+  /// chain is cleared afterwards.
+  /// @return OK on success.
+  Status WriteFromBufferChain(BufferChain* chain);
+  /// Writes the buffered data and flushes the file, so that the data written
+  /// so far can be read, e.g. served by an origin, before the file is closed.
+  /// @return OK on success.
+  Status FlushFile();
 
-  File* file() { return file_.get(); }
+  /// @return The output file, after writing the buffered data to it.
+  File* file();
 
  private:
+  // Writes the buffered data to |file_| and moves the file position to
+  // |position_|.
+  bool Flush();
+  // Writes @a size bytes of @a data to |file_|.
+  bool WriteToFile(const uint8_t* data, size_t size);
+
   scoped_ptr<File, FileCloser> file_;
   // Keep track of the position and whether we can seek.
   mkvmuxer::int64 position_;
+  // The position in the output of the start of |buffer_|, which is also the
+  // position of |file_|.
+  mkvmuxer::int64 buffer_position_;
+  // Written data not yet written to |file_|.
+  std::vector<uint8_t> buffer_;
   bool seekable_;
 
   DISALLOW_COPY_AND_ASSIGN(MkvWriter);
@@ -0,0 +1,79 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/formats/webm/mkv_writer.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "packager/media/base/test/status_test_util.h"
+#include "packager/media/file/file_test_util.h"
+#include "packager/media/file/memory_file.h"
+
+namespace edash_packager {
+namespace media {
+namespace {
+
+const char kOutputFileName[] = "memory://output-file.webm";
+const uint8_t kExpectedData[] = {0x01, 0xaa, 0xbb, 0x04, 0x05, 0x06, 0xcc};
+
+}  // namespace
+
+class MkvWriterTest : public ::testing::Test {
+ protected:
+  void TearDown() override { MemoryFile::DeleteAll(); }
+};
+
+TEST_F(MkvWriterTest, SeekWithinBufferedData) {
+  MkvWriter writer;
+  ASSERT_OK(writer.Open(kOutputFileName));
+  const uint8_t data[] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06};
+  ASSERT_EQ(0, writer.Write(data, sizeof(data)));
+
+  // Patch two bytes in the middle, then append at the end.
+  const uint8_t patch[] = {0xaa, 0xbb};
+  ASSERT_EQ(0, writer.Position(1));
+  ASSERT_EQ(0, writer.Write(patch, sizeof(patch)));
+  EXPECT_EQ(3, writer.Position());
+  ASSERT_EQ(0, writer.Position(sizeof(data)));
+  const uint8_t last = 0xcc;
+  ASSERT_EQ(0, writer.Write(&last, 1));
+  EXPECT_EQ(static_cast<int64_t>(sizeof(kExpectedData)), writer.Position());
+  ASSERT_OK(writer.Close());
+
+  ASSERT_FILE_EQ(kOutputFileName, kExpectedData);
+}
+
+TEST_F(MkvWriterTest, SeekBeforeBufferedData) {
+  MkvWriter writer;
+  ASSERT_OK(writer.Open(kOutputFileName));
+  // Large writes bypass the buffer.
+  std::vector<uint8_t> large_data(1024 * 1024, 0x01);
+  ASSERT_EQ(0, writer.Write(large_data.data(), large_data.size()));
+  const uint8_t data[] = {0x02, 0x03};
+  ASSERT_EQ(0, writer.Write(data, sizeof(data)));
+
+  const uint8_t patch = 0xaa;
+  ASSERT_EQ(0, writer.Position(0));
+  ASSERT_EQ(0, writer.Write(&patch, 1));
+  ASSERT_EQ(0, writer.Position(large_data.size() + sizeof(data)));
+  ASSERT_EQ(0, writer.Write(&patch, 1));
+  ASSERT_OK(writer.Close());
+
+  std::string contents;
+  ASSERT_TRUE(File::ReadFileToString(kOutputFileName, &contents));
+  ASSERT_EQ(large_data.size() + sizeof(data) + 1, contents.size());
+  EXPECT_EQ('\xaa', contents[0]);
+  EXPECT_EQ('\x01', contents[large_data.size() - 1]);
+  EXPECT_EQ('\x02', contents[large_data.size()]);
+  EXPECT_EQ('\x03', contents[large_data.size() + 1]);
+  EXPECT_EQ('\xaa', contents[large_data.size() + 2]);
+}
+
+}  // namespace media
+}  // namespace edash_packager
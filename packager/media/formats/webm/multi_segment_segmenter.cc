@@ -17,7 +17,9 @@ namespace edash_packager {
 namespace media {
 namespace webm {
 MultiSegmentSegmenter::MultiSegmentSegmenter(const MuxerOptions& options)
-    : Segmenter(options), num_segment_(0) {}
+    : Segmenter(options),
+      segment_name_template_(options.segment_template),
+      num_segment_(0) {}
 
 MultiSegmentSegmenter::~MultiSegmentSegmenter() {}
 
@@ -53,7 +55,7 @@ Status MultiSegmentSegmenter::FinalizeSegment() {
     const uint64_t length = static_cast<uint64_t>(
         cluster_length_sec() * info()->time_scale());
     muxer_listener()->OnNewSegment(writer_->file()->file_name(),
-                                   start_timescale, length, size);
+                                   start_timescale, length, size, "");
   }
 
   VLOG(1) << "WEBM file '" << writer_->file()->file_name() << "' finalized.";
@@ -65,7 +67,7 @@ Status MultiSegmentSegmenter::NewSubsegment(uint64_t start_timescale) {
     return Status(error::FILE_FAILURE, "Error finalizing segment.");
 
   uint64_t start_webm_timecode = FromBMFFTimescale(start_timescale);
-  return SetCluster(start_webm_timecode, 0, writer_.get());
+  return SetCluster(start_webm_timecode, writer_.get());
 }
 
 Status MultiSegmentSegmenter::NewSegment(uint64_t start_timescale) {
@@ -76,9 +78,9 @@ Status MultiSegmentSegmenter::NewSegment(uint64_t start_timescale) {
   }
 
   // Create a new file for the new segment.
-  std::string segment_name =
-      GetSegmentName(options().segment_template, start_timescale, num_segment_,
-                     options().bandwidth);
+  std::string segment_name;
+  segment_name_template_.Expand(start_timescale, num_segment_,
+                                options().bandwidth, &segment_name);
   writer_.reset(new MkvWriter);
   Status status = writer_->Open(segment_name);
   if (!status.ok())
@@ -86,7 +88,7 @@ Status MultiSegmentSegmenter::NewSegment(uint64_t start_timescale) {
   num_segment_++;
 
   uint64_t start_webm_timecode = FromBMFFTimescale(start_timescale);
-  return SetCluster(start_webm_timecode, 0, writer_.get());
+  return SetCluster(start_webm_timecode, writer_.get());
 }
 
 }  // namespace webm
@@ -10,6 +10,7 @@
 #include "packager/media/formats/webm/segmenter.h"
 
 #include "packager/base/memory/scoped_ptr.h"
+#include "packager/media/base/muxer_util.h"
 #include "packager/media/base/status.h"
 #include "packager/media/formats/webm/mkv_writer.h"
 
@@ -46,6 +47,8 @@ class MultiSegmentSegmenter : public Segmenter {
   Status FinalizeSegment();
 
   scoped_ptr<MkvWriter> writer_;
+  // The segment template, parsed once.
+  SegmentNameTemplate segment_name_template_;
   uint32_t num_segment_;
 
   DISALLOW_COPY_AND_ASSIGN(MultiSegmentSegmenter);
@@ -105,6 +105,14 @@ const uint8_t kBasicSupportDataSegment[] = {
       0x9b, 0x82, 0x03, 0xe8
 };
 
+// ID: Cluster, Payload Size: Unknown
+const uint8_t kUnknownSizeClusterHeader[] = {
+  0x1f, 0x43, 0xb6, 0x75, 0x01, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+};
+// The Cluster header, the Timecode and the four SimpleBlocks written before
+// the last frame is added.
+const size_t kFirstBlocksSize = 59;
+
 }  // namespace
 
 class MultiSegmentSegmenterTest : public SegmentTestBase {
@@ -244,6 +252,33 @@ TEST_F(MultiSegmentSegmenterTest, RespectsFragmentSAPAlign) {
   EXPECT_FALSE(File::Open(TemplateFileName(1).c_str(), "r"));
 }
 
+TEST_F(MultiSegmentSegmenterTest, LowLatencyChunkedOutput) {
+  MuxerOptions options = CreateMuxerOptions();
+  options.low_latency_chunked_output = true;
+  ASSERT_NO_FATAL_FAILURE(InitializeSegmenter(options));
+
+  // Same data as BasicSupport, except for the size of the Cluster.
+  std::string expected(reinterpret_cast<const char*>(kBasicSupportDataSegment),
+                       arraysize(kBasicSupportDataSegment));
+  expected.replace(0, arraysize(kUnknownSizeClusterHeader),
+                   reinterpret_cast<const char*>(kUnknownSizeClusterHeader),
+                   arraysize(kUnknownSizeClusterHeader));
+
+  for (int i = 0; i < 5; i++) {
+    scoped_refptr<MediaSample> sample =
+        CreateSample(kKeyFrame, kDuration, kNoSideData);
+    ASSERT_OK(segmenter_->AddSample(sample));
+  }
+  // The blocks are in the segment before it is finalized.
+  std::string contents;
+  ASSERT_TRUE(File::ReadFileToString(TemplateFileName(0).c_str(), &contents));
+  EXPECT_EQ(expected.substr(0, kFirstBlocksSize), contents);
+
+  ASSERT_OK(segmenter_->Finalize());
+  ASSERT_TRUE(File::ReadFileToString(TemplateFileName(0).c_str(), &contents));
+  EXPECT_EQ(expected, contents);
+}
+
 }  // namespace media
 }  // namespace edash_packager
 
@@ -12,6 +12,7 @@
 #include "packager/media/base/media_stream.h"
 #include "packager/media/base/muxer_options.h"
 #include "packager/media/base/muxer_util.h"
+#include "packager/media/base/pipeline_metrics.h"
 #include "packager/media/base/stream_info.h"
 #include "packager/media/base/video_stream_info.h"
 #include "packager/media/event/muxer_listener.h"
@@ -100,6 +101,7 @@ Status Segmenter::Initialize(scoped_ptr<MkvWriter> writer,
 }
 
 Status Segmenter::Finalize() {
+  ScopedStageTimer segment_write_timer(kSegmentWriteStage);
   Status status = WriteFrame(true /* write_duration */);
   if (!status.ok())
     return status;
@@ -128,29 +130,32 @@ Status Segmenter::AddSample(scoped_refptr<MediaSample> sample) {
 
   Status status;
   bool wrote_frame = false;
-  if (!cluster_) {
-    status = NewSegment(sample->pts());
-    // First frame, so no previous frame to write.
-    wrote_frame = true;
-  } else if (segment_length_sec_ >= options_.segment_duration) {
-    if (sample->is_key_frame() || !options_.segment_sap_aligned) {
-      status = WriteFrame(true /* write_duration */);
-      status.Update(NewSegment(sample->pts()));
-      segment_length_sec_ = 0;
-      cluster_length_sec_ = 0;
+  {
+    ScopedStageTimer segment_write_timer(kSegmentWriteStage);
+    if (!cluster_) {
+      status = NewSegment(sample->pts());
+      // First frame, so no previous frame to write.
       wrote_frame = true;
+    } else if (segment_length_sec_ >= options_.segment_duration) {
+      if (sample->is_key_frame() || !options_.segment_sap_aligned) {
+        status = WriteFrame(true /* write_duration */);
+        status.Update(NewSegment(sample->pts()));
+        segment_length_sec_ = 0;
+        cluster_length_sec_ = 0;
+        wrote_frame = true;
+      }
+    } else if (cluster_length_sec_ >= options_.fragment_duration) {
+      if (sample->is_key_frame() || !options_.fragment_sap_aligned) {
+        status = WriteFrame(true /* write_duration */);
+        status.Update(NewSubsegment(sample->pts()));
+        cluster_length_sec_ = 0;
+        wrote_frame = true;
+      }
     }
-  } else if (cluster_length_sec_ >= options_.fragment_duration) {
-    if (sample->is_key_frame() || !options_.fragment_sap_aligned) {
-      status = WriteFrame(true /* write_duration */);
-      status.Update(NewSubsegment(sample->pts()));
-      cluster_length_sec_ = 0;
-      wrote_frame = true;
+    if (!wrote_frame) {
+      status = WriteFrame(false /* write_duration */);
     }
   }
-  if (!wrote_frame) {
-    status = WriteFrame(false /* write_duration */);
-  }
   if (!status.ok())
     return status;
 
@@ -160,6 +165,8 @@ Status Segmenter::AddSample(scoped_refptr<MediaSample> sample) {
         static_cast<double>(sample->pts() - first_timestamp_) /
             info_->time_scale() >=
         clear_lead_;
+    ScopedStageTimer encrypt_timer(kEncryptStage);
+    encrypt_timer.AddBytes(sample->data_size());
     status = encryptor_->EncryptFrame(sample, encrypt_frame);
     if (!status.ok()) {
       LOG(ERROR) << "Error encrypting frame.";
@@ -237,11 +244,12 @@ Status Segmenter::WriteSegmentHeader(uint64_t file_size, MkvWriter* writer) {
 }
 
 Status Segmenter::SetCluster(uint64_t start_webm_timecode,
-                             uint64_t position,
                              MkvWriter* writer) {
   const uint64_t scale = segment_info_.timecode_scale();
-  cluster_.reset(new mkvmuxer::Cluster(start_webm_timecode, position, scale));
-  cluster_->Init(writer);
+  const bool progressive =
+      options().low_latency_chunked_output && !options().single_segment;
+  cluster_.reset(
+      new ClusterWriter(start_webm_timecode, scale, writer, progressive));
   return Status::OK;
 }
 
@@ -345,62 +353,35 @@ Status Segmenter::InitializeEncryptor(KeySource* key_source,
 }
 
 Status Segmenter::WriteFrame(bool write_duration) {
-  // Create a frame manually so we can create non-SimpleBlock frames.  This
-  // is required to allow the frame duration to be added.  If the duration
-  // is not set, then a SimpleBlock will still be written.
-  mkvmuxer::Frame frame;
-
-  if (!frame.Init(prev_sample_->data(), prev_sample_->data_size())) {
-    return Status(error::MUXER_FAILURE,
-                  "Error adding sample to segment: Frame::Init failed");
-  }
-
+  // The frame is written as a BlockGroup if it has a duration, so the duration
+  // can be added; otherwise a SimpleBlock is written unless it has side data.
+  uint64_t duration_ns = 0;
   if (write_duration) {
-    const uint64_t duration_ns =
+    duration_ns =
         prev_sample_->duration() * kSecondsToNs / info_->time_scale();
-    frame.set_duration(duration_ns);
-  }
-  frame.set_is_key(prev_sample_->is_key_frame());
-  frame.set_timestamp(prev_sample_->pts() * kSecondsToNs / info_->time_scale());
-  frame.set_track_number(track_id_);
-
-  if (prev_sample_->side_data_size() > 0) {
-    uint64_t block_add_id;
-    // First 8 bytes of side_data is the BlockAddID element's value, which is
-    // done to mimic ffmpeg behavior. See webm_cluster_parser.cc for details.
-    CHECK_GT(prev_sample_->side_data_size(), sizeof(block_add_id));
-    memcpy(&block_add_id, prev_sample_->side_data(), sizeof(block_add_id));
-    if (!frame.AddAdditionalData(
-            prev_sample_->side_data() + sizeof(block_add_id),
-            prev_sample_->side_data_size() - sizeof(block_add_id),
-            block_add_id)) {
-      return Status(
-          error::MUXER_FAILURE,
-          "Error adding sample to segment: Frame::AddAditionalData Failed");
-    }
-  }
-
-  if (!prev_sample_->is_key_frame() && !frame.CanBeSimpleBlock()) {
-    const int64_t timestamp_ns =
-        reference_frame_timestamp_ * kSecondsToNs / info_->time_scale();
-    frame.set_reference_block_timestamp(timestamp_ns);
   }
+  const uint64_t timestamp_ns =
+      prev_sample_->pts() * kSecondsToNs / info_->time_scale();
+  const uint64_t reference_timestamp_ns =
+      reference_frame_timestamp_ * kSecondsToNs / info_->time_scale();
 
   // GetRelativeTimecode will return -1 if the relative timecode is too large
   // to fit in the frame.
-  if (cluster_->GetRelativeTimecode(frame.timestamp() /
+  if (cluster_->GetRelativeTimecode(timestamp_ns /
                                     cluster_->timecode_scale()) < 0) {
     const double segment_duration =
-        static_cast<double>(frame.timestamp()) / kSecondsToNs;
+        static_cast<double>(timestamp_ns) / kSecondsToNs;
     LOG(ERROR) << "Error adding sample to segment: segment too large, "
                << segment_duration << " seconds.";
     return Status(error::MUXER_FAILURE,
                   "Error adding sample to segment: segment too large");
   }
 
-  if (!cluster_->AddFrame(&frame)) {
-    return Status(error::MUXER_FAILURE,
-                  "Error adding sample to segment: Cluster::AddFrame failed");
+  Status status = cluster_->AddFrame(prev_sample_, track_id_, timestamp_ns,
+                                     duration_ns, reference_timestamp_ns);
+  if (!status.ok()) {
+    LOG(ERROR) << "Error adding sample to segment: " << status;
+    return status;
   }
 
   // A reference frame is needed for non-keyframes.  Having a reference to the
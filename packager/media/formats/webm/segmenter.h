@@ -10,6 +10,7 @@
 #include "packager/base/memory/ref_counted.h"
 #include "packager/base/memory/scoped_ptr.h"
 #include "packager/media/base/status.h"
+#include "packager/media/formats/webm/cluster_writer.h"
 #include "packager/media/formats/webm/encryptor.h"
 #include "packager/media/formats/webm/mkv_writer.h"
 #include "packager/media/formats/webm/seek_head.h"
@@ -86,17 +87,15 @@ class Segmenter {
   uint64_t FromWebMTimecode(uint64_t time_webm_timecode);
   /// Writes the Segment header to @a writer.
   Status WriteSegmentHeader(uint64_t file_size, MkvWriter* writer);
-  /// Creates a Cluster object with the given parameters.
-  Status SetCluster(uint64_t start_webm_timecode,
-                    uint64_t position,
-                    MkvWriter* writer);
+  /// Creates a ClusterWriter with the given parameters.
+  Status SetCluster(uint64_t start_webm_timecode, MkvWriter* writer);
 
   /// Update segmentation progress using ProgressListener.
   void UpdateProgress(uint64_t progress);
   void set_progress_target(uint64_t target) { progress_target_ = target; }
 
   const MuxerOptions& options() const { return options_; }
-  mkvmuxer::Cluster* cluster() { return cluster_.get(); }
+  ClusterWriter* cluster() { return cluster_.get(); }
   mkvmuxer::Cues* cues() { return &cues_; }
   MuxerListener* muxer_listener() { return muxer_listener_; }
   StreamInfo* info() { return info_; }
@@ -136,7 +135,7 @@ class Segmenter {
   scoped_ptr<Encryptor> encryptor_;
   double clear_lead_;
 
-  scoped_ptr<mkvmuxer::Cluster> cluster_;
+  scoped_ptr<ClusterWriter> cluster_;
   mkvmuxer::Cues cues_;
   SeekHead seek_head_;
   mkvmuxer::SegmentInfo segment_info_;
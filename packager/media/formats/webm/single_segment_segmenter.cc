@@ -6,30 +6,84 @@
 
 #include "packager/media/formats/webm/single_segment_segmenter.h"
 
+#include "packager/base/logging.h"
 #include "packager/media/base/muxer_options.h"
+#include "packager/media/base/stream_info.h"
 #include "packager/third_party/libwebm/src/mkvmuxer.hpp"
+#include "packager/third_party/libwebm/src/mkvmuxerutil.hpp"
+#include "packager/third_party/libwebm/src/webmids.hpp"
 
 namespace edash_packager {
 namespace media {
 namespace webm {
+namespace {
+// Upper bound of the size of a CuePoint with a single CueTrackPositions:
+// CueTime and CueClusterPosition of up to 8 bytes each plus element headers.
+const uint64_t kMaxCuePointSize = 32;
+// Size of the Cues element header with an 8-byte size.
+const uint64_t kCuesHeaderSize = 12;
+// Number of extra CuePoints reserved on top of the estimate, to account for
+// segments cut short by SAP alignment.
+const uint64_t kExtraCuePoints = 16;
+// Number of CuePoints reserved if the stream duration is unknown.
+const uint64_t kDefaultNumCuePoints = 4096;
+
+// Returns true if a Void element of exactly |size| bytes can be written.
+bool CanWriteVoidElement(uint64_t size) {
+  if (size < 2)
+    return false;
+  const uint64_t payload_size =
+      size - 1 - mkvmuxer::GetCodedUIntSize(size - 1);
+  return mkvmuxer::EbmlMasterElementSize(mkvmuxer::kMkvVoid, payload_size) +
+             payload_size ==
+         size;
+}
+}  // namespace
 
 SingleSegmentSegmenter::SingleSegmentSegmenter(const MuxerOptions& options)
-    : Segmenter(options), init_end_(0), index_start_(0) {}
+    : Segmenter(options),
+      init_end_(0),
+      index_start_(0),
+      reserve_index_space_(options.single_segment_in_place),
+      reserved_index_size_(0) {}
 
 SingleSegmentSegmenter::~SingleSegmentSegmenter() {}
 
 Status SingleSegmentSegmenter::DoInitialize(scoped_ptr<MkvWriter> writer) {
   writer_ = writer.Pass();
   Status ret = WriteSegmentHeader(0, writer_.get());
+  if (!ret.ok())
+    return ret;
   init_end_ = writer_->Position() - 1;
-  seek_head()->set_cluster_pos(init_end_ + 1 - segment_payload_pos());
-  return ret;
+
+  if (reserve_index_space_) {
+    reserved_index_size_ = EstimateCuesSize();
+    while (!CanWriteVoidElement(reserved_index_size_))
+      ++reserved_index_size_;
+    if (!mkvmuxer::WriteVoidElement(writer_.get(), reserved_index_size_))
+      return Status(error::FILE_FAILURE, "Error reserving space for Cues.");
+  }
+
+  seek_head()->set_cluster_pos(writer_->Position() - segment_payload_pos());
+  return Status::OK;
 }
 
 Status SingleSegmentSegmenter::DoFinalize() {
   if (!cluster()->Finalize())
     return Status(error::FILE_FAILURE, "Error finalizing cluster.");
 
+  if (reserved_index_size_ > 0) {
+    const uint64_t cues_size = cues()->Size();
+    if (cues_size == reserved_index_size_ ||
+        CanWriteVoidElement(reserved_index_size_ - cues_size)) {
+      return FinalizeWithReservedCues();
+    }
+    // The reserved Void is left in place as padding.
+    LOG(INFO) << "Cues (" << cues_size << " bytes) do not fit in the reserved "
+              << reserved_index_size_ << " bytes; writing them to the end of "
+              << "the file.";
+  }
+
   // Write the Cues to the end of the file.
   index_start_ = writer_->Position();
   seek_head()->set_cues_pos(index_start_ - segment_payload_pos());
@@ -45,6 +99,47 @@ Status SingleSegmentSegmenter::DoFinalize() {
   return status;
 }
 
+uint64_t SingleSegmentSegmenter::EstimateCuesSize() {
+  uint64_t num_cue_points = kDefaultNumCuePoints;
+  if (info()->duration() > 0 && info()->time_scale() > 0 &&
+      options().segment_duration > 0) {
+    const double duration_in_seconds =
+        static_cast<double>(info()->duration()) / info()->time_scale();
+    num_cue_points = static_cast<uint64_t>(duration_in_seconds /
+                                           options().segment_duration) +
+                     kExtraCuePoints;
+  }
+  return kCuesHeaderSize + num_cue_points * kMaxCuePointSize;
+}
+
+Status SingleSegmentSegmenter::FinalizeWithReservedCues() {
+  const uint64_t file_size = writer_->Position();
+  const uint64_t cues_size = cues()->Size();
+  DCHECK_LE(cues_size, reserved_index_size_);
+
+  // The Cues are placed right after the header.
+  index_start_ = init_end_ + 1;
+  index_end_ = index_start_ + cues_size - 1;
+  if (writer_->Position(index_start_) != 0)
+    return Status(error::FILE_FAILURE, "Error seeking to the reserved Cues.");
+  seek_head()->set_cues_pos(index_start_ - segment_payload_pos());
+  if (!cues()->Write(writer_.get()))
+    return Status(error::FILE_FAILURE, "Error writing Cues data.");
+  DCHECK_EQ(index_end_ + 1, static_cast<uint64_t>(writer_->Position()));
+
+  const uint64_t padding_size = reserved_index_size_ - cues_size;
+  if (padding_size > 0 &&
+      !mkvmuxer::WriteVoidElement(writer_.get(), padding_size)) {
+    return Status(error::FILE_FAILURE, "Error writing Void element.");
+  }
+
+  if (writer_->Position(0) != 0)
+    return Status(error::FILE_FAILURE, "Error seeking to the header.");
+  Status status = WriteSegmentHeader(file_size, writer_.get());
+  status.Update(writer_->Close());
+  return status;
+}
+
 Status SingleSegmentSegmenter::NewSubsegment(uint64_t start_timescale) {
   return Status::OK;
 }
@@ -64,7 +159,7 @@ Status SingleSegmentSegmenter::NewSegment(uint64_t start_timescale) {
   if (!cues()->AddCue(cue_point))
     return Status(error::INTERNAL_ERROR, "Error adding CuePoint.");
 
-  return SetCluster(start_webm_timecode, position, writer_.get());
+  return SetCluster(start_webm_timecode, writer_.get());
 }
 
 bool SingleSegmentSegmenter::GetInitRangeStartAndEnd(uint64_t* start,
@@ -78,8 +173,8 @@ bool SingleSegmentSegmenter::GetInitRangeStartAndEnd(uint64_t* start,
 
 bool SingleSegmentSegmenter::GetIndexRangeStartAndEnd(uint64_t* start,
                                                       uint64_t* end) {
-  // The index is the Cues element, which is always placed at the end of the
-  // file.
+  // The index is the Cues element, which is placed either in the space
+  // reserved after the header or at the end of the file.
   *start = index_start_;
   *end = index_end_;
   return true;
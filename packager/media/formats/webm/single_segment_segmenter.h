@@ -23,6 +23,10 @@ namespace webm {
 /// An implementation of a Segmenter for a single-segment.  This assumes that
 /// the output file is seekable.  For non-seekable files, use
 /// TwoPassSingleSegmentSegmenter.
+/// If @b MuxerOptions.single_segment_in_place is set, a Void element sized
+/// for the estimated Cues is reserved after the header, and the Cues are
+/// written into it on Finalize so the index precedes the Clusters. If the
+/// Cues do not fit, they are written to the end of the file as usual.
 class SingleSegmentSegmenter : public Segmenter {
  public:
   explicit SingleSegmentSegmenter(const MuxerOptions& options);
@@ -40,6 +44,9 @@ class SingleSegmentSegmenter : public Segmenter {
   void set_index_start(uint64_t start) { index_start_ = start; }
   void set_index_end(uint64_t end) { index_end_ = end; }
   void set_writer(scoped_ptr<MkvWriter> writer) { writer_ = writer.Pass(); }
+  void set_reserve_index_space(bool reserve) {
+    reserve_index_space_ = reserve;
+  }
 
   // Segmenter implementation overrides.
   Status DoInitialize(scoped_ptr<MkvWriter> writer) override;
@@ -50,10 +57,19 @@ class SingleSegmentSegmenter : public Segmenter {
   Status NewSubsegment(uint64_t start_timescale) override;
   Status NewSegment(uint64_t start_timescale) override;
 
+  // Estimates the size of the Cues element from the stream duration.
+  uint64_t EstimateCuesSize();
+  // Writes the Cues into the space reserved in DoInitialize and rewrites the
+  // header. Must only be called if the Cues fit.
+  Status FinalizeWithReservedCues();
+
   scoped_ptr<MkvWriter> writer_;
   uint64_t init_end_;
   uint64_t index_start_;
   uint64_t index_end_;
+  bool reserve_index_space_;
+  // Size of the Void element reserved for the Cues; 0 if none.
+  uint64_t reserved_index_size_;
 
   DISALLOW_COPY_AND_ASSIGN(SingleSegmentSegmenter);
 };
@@ -258,6 +258,40 @@ TEST_P(SingleSegmentSegmenterTest, RespectsSAPAlign) {
   EXPECT_EQ(4, parser.GetFrameCountForCluster(1));
 }
 
+TEST_P(SingleSegmentSegmenterTest, ReservesIndexSpaceInPlace) {
+  MuxerOptions options = CreateMuxerOptions();
+  options.segment_duration = 4.5;  // seconds
+  options.single_segment_in_place = true;
+  ASSERT_NO_FATAL_FAILURE(InitializeSegmenter(options));
+
+  // Write the samples to the Segmenter.
+  for (int i = 0; i < 8; i++) {
+    scoped_refptr<MediaSample> sample =
+        CreateSample(kKeyFrame, kDuration, kNoSideData);
+    ASSERT_OK(segmenter_->AddSample(sample));
+  }
+  ASSERT_OK(segmenter_->Finalize());
+
+  // Verify the resulting data.
+  ClusterParser parser;
+  ASSERT_NO_FATAL_FAILURE(parser.PopulateFromSegment(OutputFileName()));
+  ASSERT_EQ(2, parser.cluster_count());
+  EXPECT_EQ(5, parser.GetFrameCountForCluster(0));
+  EXPECT_EQ(3, parser.GetFrameCountForCluster(1));
+
+  uint64_t init_start, init_end, index_start, index_end;
+  ASSERT_TRUE(segmenter_->GetInitRangeStartAndEnd(&init_start, &init_end));
+  ASSERT_TRUE(segmenter_->GetIndexRangeStartAndEnd(&index_start, &index_end));
+  if (!GetParam()) {
+    // The Cues directly follow the header.
+    EXPECT_EQ(init_end + 1, index_start);
+  } else {
+    // TwoPassSingleSegmentSegmenter always writes the Cues at the end.
+    int64_t file_size = File::GetFileSize(OutputFileName().c_str());
+    EXPECT_EQ(static_cast<uint64_t>(file_size - 1), index_end);
+  }
+}
+
 INSTANTIATE_TEST_CASE_P(TrueIsTwoPass,
                         SingleSegmentSegmenterTest,
                         ::testing::Bool());
@@ -67,7 +67,11 @@ bool ReadSkip(File* file, int64_t byte_count) {
 
 TwoPassSingleSegmentSegmenter::TwoPassSingleSegmentSegmenter(
     const MuxerOptions& options)
-    : SingleSegmentSegmenter(options) {}
+    : SingleSegmentSegmenter(options) {
+  // The temp file is copied over assuming the Clusters follow the header, so
+  // there cannot be any space reserved for the Cues in between.
+  set_reserve_index_space(false);
+}
 
 TwoPassSingleSegmentSegmenter::~TwoPassSingleSegmentSegmenter() {}
 
@@ -13,6 +13,8 @@
       'target_name': 'webm',
       'type': '<(component)',
       'sources': [
+        'cluster_writer.cc',
+        'cluster_writer.h',
         'encryptor.cc',
         'encryptor.h',
         'mkv_writer.cc',
@@ -39,6 +41,8 @@
         'webm_content_encodings_client.h',
         'webm_crypto_helpers.cc',
         'webm_crypto_helpers.h',
+        'webm_cues_parser.cc',
+        'webm_cues_parser.h',
         'webm_info_parser.cc',
         'webm_info_parser.h',
         'webm_parser.cc',
@@ -47,6 +51,8 @@
         'webm_media_parser.h',
         'webm_muxer.cc',
         'webm_muxer.h',
+        'webm_seek_head_parser.cc',
+        'webm_seek_head_parser.h',
         'webm_tracks_parser.cc',
         'webm_tracks_parser.h',
         'webm_video_client.cc',
@@ -68,6 +74,7 @@
         'cluster_builder.cc',
         'cluster_builder.h',
         'encrypted_segmenter_unittest.cc',
+        'mkv_writer_unittest.cc',
         'multi_segment_segmenter_unittest.cc',
         'segmenter_test_base.cc',
         'segmenter_test_base.h',
@@ -76,6 +83,7 @@
         'tracks_builder.h',
         'webm_cluster_parser_unittest.cc',
         'webm_content_encodings_client_unittest.cc',
+        'webm_cues_parser_unittest.cc',
         'webm_parser_unittest.cc',
         'webm_tracks_parser_unittest.cc',
         'webm_webvtt_parser_unittest.cc',
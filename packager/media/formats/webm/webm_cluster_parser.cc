@@ -79,7 +79,8 @@ WebMClusterParser::WebMClusterParser(
       video_(video_stream_info ? video_stream_info->track_id() : -1,
              true,
              video_default_duration,
-             new_sample_cb) {
+             new_sample_cb),
+      sample_buffer_pool_(new SampleBufferPool) {
   if (decryption_key_source)
     decryptor_source_.reset(new DecryptorSource(decryption_key_source));
   for (WebMTracksParser::TextTracks::const_iterator it = text_tracks.begin();
@@ -98,6 +99,9 @@ void WebMClusterParser::Reset() {
   cluster_start_time_ = kNoTimestamp;
   cluster_ended_ = false;
   parser_.Reset();
+  block_data_ = NULL;
+  block_data_size_ = -1;
+  block_data_buffer_ = NULL;
   audio_.Reset();
   video_.Reset();
   ResetTextTracks();
@@ -111,6 +115,19 @@ bool WebMClusterParser::Flush() {
   return audio_result && video_result;
 }
 
+int WebMClusterParser::Parse(const uint8_t* buf,
+                             int size,
+                             const scoped_refptr<SharedBuffer>& input_buffer) {
+  DCHECK(input_buffer);
+  DCHECK(input_buffer->Contains(buf, size));
+  // Only a raw pointer is kept, so that |input_buffer| is referenced only by
+  // the samples and BlockGroups which need it after parsing.
+  input_buffer_ = input_buffer.get();
+  const int result = Parse(buf, size);
+  input_buffer_ = NULL;
+  return result;
+}
+
 int WebMClusterParser::Parse(const uint8_t* buf, int size) {
   int result = parser_.Parse(buf, size);
 
@@ -149,15 +166,15 @@ WebMParserClient* WebMClusterParser::OnListStart(int id) {
     cluster_timecode_ = -1;
     cluster_start_time_ = kNoTimestamp;
   } else if (id == kWebMIdBlockGroup) {
-    block_data_.reset();
+    block_data_ = NULL;
     block_data_size_ = -1;
+    block_data_buffer_ = NULL;
     block_duration_ = -1;
     discard_padding_ = -1;
     discard_padding_set_ = false;
   } else if (id == kWebMIdBlockAdditions) {
     block_add_id_ = -1;
-    block_additional_data_.reset();
-    block_additional_data_size_ = 0;
+    block_additional_data_.clear();
   }
 
   return this;
@@ -173,16 +190,17 @@ bool WebMClusterParser::OnListEnd(int id) {
     return false;
   }
 
-  bool result = ParseBlock(false, block_data_.get(), block_data_size_,
-                           block_additional_data_.get(),
-                           block_additional_data_size_, block_duration_,
-                           discard_padding_set_ ? discard_padding_ : 0);
-  block_data_.reset();
+  bool result = ParseBlock(
+      false, block_data_buffer_.get(), block_data_, block_data_size_,
+      block_additional_data_.empty() ? NULL : &block_additional_data_[0],
+      block_additional_data_.size(), block_duration_,
+      discard_padding_set_ ? discard_padding_ : 0);
+  block_data_ = NULL;
   block_data_size_ = -1;
+  block_data_buffer_ = NULL;
   block_duration_ = -1;
   block_add_id_ = -1;
-  block_additional_data_.reset();
-  block_additional_data_size_ = 0;
+  block_additional_data_.clear();
   discard_padding_ = -1;
   discard_padding_set_ = false;
   return result;
@@ -210,6 +228,7 @@ bool WebMClusterParser::OnUInt(int id, int64_t val) {
 }
 
 bool WebMClusterParser::ParseBlock(bool is_simple_block,
+                                   SharedBuffer* source,
                                    const uint8_t* buf,
                                    int size,
                                    const uint8_t* additional,
@@ -242,7 +261,7 @@ bool WebMClusterParser::ParseBlock(bool is_simple_block,
 
   const uint8_t* frame_data = buf + 4;
   int frame_size = size - (frame_data - buf);
-  return OnBlock(is_simple_block, track_num, timecode, duration, flags,
+  return OnBlock(is_simple_block, source, track_num, timecode, duration, flags,
                  frame_data, frame_size, additional, additional_size,
                  discard_padding);
 }
@@ -250,22 +269,29 @@ bool WebMClusterParser::ParseBlock(bool is_simple_block,
 bool WebMClusterParser::OnBinary(int id, const uint8_t* data, int size) {
   switch (id) {
     case kWebMIdSimpleBlock:
-      return ParseBlock(true, data, size, NULL, 0, -1, 0);
+      return ParseBlock(true, input_buffer_, data, size, NULL, 0, -1, 0);
 
     case kWebMIdBlock:
-      if (block_data_) {
+      if (block_data_size_ != -1) {
         LOG(ERROR) << "More than 1 Block in a BlockGroup is not "
                       "supported.";
         return false;
       }
-      block_data_.reset(new uint8_t[size]);
-      memcpy(block_data_.get(), data, size);
+      // The Block is parsed at the end of the BlockGroup, possibly in a later
+      // Parse() call, so the data must be kept alive until then.
+      if (input_buffer_) {
+        block_data_buffer_ = input_buffer_;
+        block_data_ = data;
+      } else {
+        block_data_copy_.assign(data, data + size);
+        block_data_ = block_data_copy_.empty() ? NULL : &block_data_copy_[0];
+      }
       block_data_size_ = size;
       return true;
 
     case kWebMIdBlockAdditional: {
       uint64_t block_add_id = base::HostToNet64(block_add_id_);
-      if (block_additional_data_) {
+      if (!block_additional_data_.empty()) {
         // TODO: Technically, more than 1 BlockAdditional is allowed as per
         // matroska spec. But for now we don't have a use case to support
         // parsing of such files. Take a look at this again when such a case
@@ -277,11 +303,12 @@ bool WebMClusterParser::OnBinary(int id, const uint8_t* data, int size) {
       // First 8 bytes of side_data in DecoderBuffer is the BlockAddID
       // element's value in Big Endian format. This is done to mimic ffmpeg
       // demuxer's behavior.
-      block_additional_data_size_ = size + sizeof(block_add_id);
-      block_additional_data_.reset(new uint8_t[block_additional_data_size_]);
-      memcpy(block_additional_data_.get(), &block_add_id,
-             sizeof(block_add_id));
-      memcpy(block_additional_data_.get() + 8, data, size);
+      const uint8_t* block_add_id_bytes =
+          reinterpret_cast<const uint8_t*>(&block_add_id);
+      block_additional_data_.assign(block_add_id_bytes,
+                                    block_add_id_bytes + sizeof(block_add_id));
+      block_additional_data_.insert(block_additional_data_.end(), data,
+                                    data + size);
       return true;
     }
     case kWebMIdDiscardPadding: {
@@ -302,6 +329,7 @@ bool WebMClusterParser::OnBinary(int id, const uint8_t* data, int size) {
 }
 
 bool WebMClusterParser::OnBlock(bool is_simple_block,
+                                SharedBuffer* source,
                                 int track_num,
                                 int timecode,
                                 int block_duration,
@@ -387,11 +415,25 @@ bool WebMClusterParser::OnBlock(bool is_simple_block,
       return false;
     }
 
-    buffer = MediaSample::CopyFrom(data + data_offset, size - data_offset,
-                                   additional, additional_size, is_keyframe);
-
     // An empty iv indicates that this sample is not encrypted.
-    if (decrypt_config && !decrypt_config->iv().empty()) {
+    const bool is_encrypted = decrypt_config && !decrypt_config->iv().empty();
+    const uint8_t* frame_data = data + data_offset;
+    const int frame_size = size - data_offset;
+    // Clear frames reference the input buffer directly instead of being copied
+    // out; encrypted frames are decrypted in place, so they need their own
+    // copy anyway.
+    if (source && !is_encrypted && frame_size > 0) {
+      buffer = MediaSample::CreateFromSharedBuffer(
+          make_scoped_refptr(source), frame_data, frame_size, is_keyframe);
+      if (additional_size > 0)
+        buffer->set_side_data(additional, additional_size);
+    } else {
+      buffer = MediaSample::CopyFrom(frame_data, frame_size, additional,
+                                     additional_size, is_keyframe,
+                                     sample_buffer_pool_.get());
+    }
+
+    if (is_encrypted) {
       if (!decryptor_source_) {
         LOG(ERROR) << "Encrypted media sample encountered, but decryption is "
                       "not enabled";
@@ -5,16 +5,18 @@
 #ifndef MEDIA_FORMATS_WEBM_WEBM_CLUSTER_PARSER_H_
 #define MEDIA_FORMATS_WEBM_WEBM_CLUSTER_PARSER_H_
 
-#include <deque>
 #include <map>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "packager/base/compiler_specific.h"
 #include "packager/base/memory/scoped_ptr.h"
 #include "packager/media/base/decryptor_source.h"
 #include "packager/media/base/media_parser.h"
 #include "packager/media/base/media_sample.h"
+#include "packager/media/base/sample_buffer_pool.h"
+#include "packager/media/base/shared_buffer.h"
 #include "packager/media/formats/webm/webm_parser.h"
 #include "packager/media/formats/webm/webm_tracks_parser.h"
 
@@ -145,6 +147,13 @@ class WebMClusterParser : public WebMParserClient {
   /// @return The number of bytes parsed on success.
   int Parse(const uint8_t* buf, int size);
 
+  /// Same as above, with @a buf lying within @a input_buffer. The emitted
+  /// samples reference the block data in @a input_buffer instead of copying
+  /// it, unless the data needs to be decrypted.
+  int Parse(const uint8_t* buf,
+            int size,
+            const scoped_refptr<SharedBuffer>& input_buffer);
+
   int64_t cluster_start_time() const { return cluster_start_time_; }
 
   /// @return true if the last Parse() call stopped at the end of a cluster.
@@ -157,7 +166,10 @@ class WebMClusterParser : public WebMParserClient {
   bool OnUInt(int id, int64_t val) override;
   bool OnBinary(int id, const uint8_t* data, int size) override;
 
+  // |source| is the buffer holding |buf|, or NULL if |buf| is not in a
+  // SharedBuffer.
   bool ParseBlock(bool is_simple_block,
+                  SharedBuffer* source,
                   const uint8_t* buf,
                   int size,
                   const uint8_t* additional,
@@ -165,6 +177,7 @@ class WebMClusterParser : public WebMParserClient {
                   int duration,
                   int64_t discard_padding);
   bool OnBlock(bool is_simple_block,
+               SharedBuffer* source,
                int track_num,
                int timecode,
                int duration,
@@ -201,16 +214,24 @@ class WebMClusterParser : public WebMParserClient {
   bool initialized_;
   MediaParser::InitCB init_cb_;
 
+  // The buffer holding the data being parsed, if any. Only set within
+  // Parse().
+  SharedBuffer* input_buffer_ = NULL;
+
   int64_t last_block_timecode_ = -1;
-  scoped_ptr<uint8_t[]> block_data_;
+  // The Block of the current BlockGroup. |block_data_| points into
+  // |block_data_buffer_| if the Block is in |input_buffer_|; otherwise into
+  // |block_data_copy_|, which is reused across BlockGroups.
+  const uint8_t* block_data_ = NULL;
   int block_data_size_ = -1;
+  scoped_refptr<SharedBuffer> block_data_buffer_;
+  std::vector<uint8_t> block_data_copy_;
   int64_t block_duration_ = -1;
   int64_t block_add_id_ = -1;
 
-  scoped_ptr<uint8_t[]> block_additional_data_;
-  // Must be 0 if |block_additional_data_| is null. Must be > 0 if
-  // |block_additional_data_| is NOT null.
-  int block_additional_data_size_ = 0;
+  // The BlockAddID, in big endian, followed by the BlockAdditional data, or
+  // empty if there is no BlockAdditional. Reused across BlockGroups.
+  std::vector<uint8_t> block_additional_data_;
 
   int64_t discard_padding_ = -1;
   bool discard_padding_set_ = false;
@@ -223,6 +244,9 @@ class WebMClusterParser : public WebMParserClient {
   Track video_;
   TextTrackMap text_track_map_;
 
+  // Recycles sample payload buffers across the samples emitted.
+  scoped_refptr<SampleBufferPool> sample_buffer_pool_;
+
   DISALLOW_COPY_AND_ASSIGN(WebMClusterParser);
 };
 
@@ -674,6 +674,34 @@ TEST_F(WebMClusterParserTest, ParseSimpleBlockAndBlockGroupMixture) {
   ASSERT_TRUE(VerifyBuffers(kBlockInfo, block_count));
 }
 
+TEST_F(WebMClusterParserTest, ParseFromSharedBuffer) {
+  const BlockInfo kBlockInfo[] = {
+      {kAudioTrackNum, 0, 23, true, NULL, 0},
+      {kAudioTrackNum, 23, 23, false, NULL, 0},
+      {kVideoTrackNum, 33, 34, true, NULL, 0},
+      {kAudioTrackNum, 46, 23, false, NULL, 0},
+      {kVideoTrackNum, 67, 33, false, NULL, 0},
+  };
+  int block_count = arraysize(kBlockInfo);
+  scoped_ptr<Cluster> cluster(CreateCluster(0, kBlockInfo, block_count));
+  scoped_refptr<SharedBuffer> input(new SharedBuffer(cluster->size()));
+  memcpy(input->data(), cluster->data(), cluster->size());
+
+  int result = parser_->Parse(input->data(), input->size(), input);
+  EXPECT_EQ(cluster->size(), result);
+  ASSERT_TRUE(VerifyBuffers(kBlockInfo, block_count));
+
+  // Both SimpleBlocks and Blocks in BlockGroups reference the input.
+  ASSERT_FALSE(audio_buffers_.empty());
+  ASSERT_FALSE(video_buffers_.empty());
+  for (const scoped_refptr<MediaSample>& sample : audio_buffers_) {
+    EXPECT_TRUE(sample->is_shared());
+    EXPECT_TRUE(input->Contains(sample->data(), sample->data_size()));
+  }
+  for (const scoped_refptr<MediaSample>& sample : video_buffers_)
+    EXPECT_TRUE(sample->is_shared());
+}
+
 TEST_F(WebMClusterParserTest, IgnoredTracks) {
   std::set<int64_t> ignored_tracks;
   ignored_tracks.insert(kTextTrackNum);
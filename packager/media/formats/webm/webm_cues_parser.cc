@@ -0,0 +1,82 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/formats/webm/webm_cues_parser.h"
+
+#include "packager/base/logging.h"
+#include "packager/media/formats/webm/webm_constants.h"
+
+namespace edash_packager {
+namespace media {
+
+WebMCuesParser::WebMCuesParser()
+    : cue_time_(-1), cue_track_(-1), cue_cluster_position_(-1) {}
+
+WebMCuesParser::~WebMCuesParser() {}
+
+int WebMCuesParser::Parse(const uint8_t* buf, int size) {
+  cue_points_.clear();
+
+  WebMListParser parser(kWebMIdCues, this);
+  int result = parser.Parse(buf, size);
+
+  if (result <= 0)
+    return result;
+
+  // For now we do all or nothing parsing.
+  return parser.IsParsingComplete() ? result : 0;
+}
+
+WebMParserClient* WebMCuesParser::OnListStart(int id) {
+  if (id == kWebMIdCuePoint) {
+    cue_time_ = -1;
+  } else if (id == kWebMIdCueTrackPositions) {
+    cue_track_ = -1;
+    cue_cluster_position_ = -1;
+  }
+  return this;
+}
+
+bool WebMCuesParser::OnListEnd(int id) {
+  if (id != kWebMIdCueTrackPositions)
+    return true;
+
+  // CueTime precedes the CueTrackPositions in the CuePoint.
+  if (cue_time_ == -1 || cue_track_ == -1 || cue_cluster_position_ == -1) {
+    LOG(ERROR) << "Incomplete CuePoint element.";
+    return false;
+  }
+  CuePoint cue_point;
+  cue_point.time = cue_time_;
+  cue_point.track = cue_track_;
+  cue_point.cluster_position = cue_cluster_position_;
+  cue_points_.push_back(cue_point);
+  return true;
+}
+
+bool WebMCuesParser::OnUInt(int id, int64_t val) {
+  int64_t* dst;
+  switch (id) {
+    case kWebMIdCueTime:
+      dst = &cue_time_;
+      break;
+    case kWebMIdCueTrack:
+      dst = &cue_track_;
+      break;
+    case kWebMIdCueClusterPosition:
+      dst = &cue_cluster_position_;
+      break;
+    default:
+      return true;
+  }
+  if (*dst != -1)
+    return false;
+  *dst = val;
+  return true;
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,65 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_FORMATS_WEBM_WEBM_CUES_PARSER_H_
+#define MEDIA_FORMATS_WEBM_WEBM_CUES_PARSER_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "packager/base/compiler_specific.h"
+#include "packager/media/formats/webm/webm_parser.h"
+
+namespace edash_packager {
+namespace media {
+
+/// Parser for WebM Cues element.
+class WebMCuesParser : public WebMParserClient {
+ public:
+  /// A position of a track in the Cues.
+  struct CuePoint {
+    /// The time of the cue, in timecode scale.
+    int64_t time;
+    int64_t track;
+    /// The position of the Cluster, relative to the start of the Segment
+    /// payload.
+    int64_t cluster_position;
+  };
+
+  WebMCuesParser();
+  ~WebMCuesParser() override;
+
+  /// Parses a WebM Cues element in |buf|.
+  /// @return -1 if the parse fails.
+  /// @return 0 if more data is needed.
+  /// @return The number of bytes parsed on success.
+  int Parse(const uint8_t* buf, int size);
+
+  /// @return The cue points, in the order of the Cues, which is increasing
+  ///         time.
+  const std::vector<CuePoint>& cue_points() const { return cue_points_; }
+
+ private:
+  // WebMParserClient methods
+  WebMParserClient* OnListStart(int id) override;
+  bool OnListEnd(int id) override;
+  bool OnUInt(int id, int64_t val) override;
+
+  // The fields of the CuePoint and CueTrackPositions being parsed.
+  int64_t cue_time_;
+  int64_t cue_track_;
+  int64_t cue_cluster_position_;
+
+  std::vector<CuePoint> cue_points_;
+
+  DISALLOW_COPY_AND_ASSIGN(WebMCuesParser);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_FORMATS_WEBM_WEBM_CUES_PARSER_H_
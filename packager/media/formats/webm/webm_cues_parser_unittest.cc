@@ -0,0 +1,69 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/formats/webm/webm_cues_parser.h"
+
+#include <gtest/gtest.h>
+
+#include "packager/media/formats/webm/webm_constants.h"
+#include "packager/media/formats/webm/webm_seek_head_parser.h"
+
+namespace edash_packager {
+namespace media {
+namespace {
+
+const uint8_t kCues[] = {
+    0x1C, 0x53, 0xBB, 0x6B, 0x9C,  // Cues (size = 28)
+    0xBB, 0x8B,                    // CuePoint (size = 11)
+    0xB3, 0x81, 0x00,              // CueTime (0)
+    0xB7, 0x86,                    // CueTrackPositions (size = 6)
+    0xF7, 0x81, 0x01,              // CueTrack (1)
+    0xF1, 0x81, 0x10,              // CueClusterPosition (0x10)
+    0xBB, 0x8D,                    // CuePoint (size = 13)
+    0xB3, 0x82, 0x03, 0xE8,        // CueTime (1000)
+    0xB7, 0x87,                    // CueTrackPositions (size = 7)
+    0xF7, 0x81, 0x01,              // CueTrack (1)
+    0xF1, 0x82, 0x12, 0x34,        // CueClusterPosition (0x1234)
+};
+
+const uint8_t kSeekHead[] = {
+    0x11, 0x4D, 0x9B, 0x74, 0x8F,  // SeekHead (size = 15)
+    0x4D, 0xBB, 0x8C,              // Seek (size = 12)
+    0x53, 0xAB, 0x84,              // SeekID (size = 4)
+    0x1C, 0x53, 0xBB, 0x6B,        // Cues
+    0x53, 0xAC, 0x82, 0x01, 0x00,  // SeekPosition (0x100)
+};
+
+}  // namespace
+
+TEST(WebMCuesParserTest, ParseCuePoints) {
+  WebMCuesParser parser;
+  EXPECT_EQ(static_cast<int>(sizeof(kCues)),
+            parser.Parse(kCues, sizeof(kCues)));
+  ASSERT_EQ(2u, parser.cue_points().size());
+  EXPECT_EQ(0, parser.cue_points()[0].time);
+  EXPECT_EQ(1, parser.cue_points()[0].track);
+  EXPECT_EQ(0x10, parser.cue_points()[0].cluster_position);
+  EXPECT_EQ(1000, parser.cue_points()[1].time);
+  EXPECT_EQ(1, parser.cue_points()[1].track);
+  EXPECT_EQ(0x1234, parser.cue_points()[1].cluster_position);
+}
+
+TEST(WebMCuesParserTest, NeedsWholeElement) {
+  WebMCuesParser parser;
+  EXPECT_EQ(0, parser.Parse(kCues, sizeof(kCues) - 1));
+}
+
+TEST(WebMCuesParserTest, ParseSeekHead) {
+  WebMSeekHeadParser parser;
+  EXPECT_EQ(static_cast<int>(sizeof(kSeekHead)),
+            parser.Parse(kSeekHead, sizeof(kSeekHead)));
+  EXPECT_EQ(0x100, parser.GetPosition(kWebMIdCues));
+  EXPECT_EQ(-1, parser.GetPosition(kWebMIdCluster));
+}
+
+}  // namespace media
+}  // namespace edash_packager
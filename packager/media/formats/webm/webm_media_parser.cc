@@ -4,24 +4,68 @@
 
 #include "packager/media/formats/webm/webm_media_parser.h"
 
+#include <algorithm>
+#include <limits>
 #include <string>
 
+#include "packager/base/bind.h"
 #include "packager/base/callback.h"
 #include "packager/base/callback_helpers.h"
 #include "packager/base/logging.h"
 #include "packager/media/base/buffer_writer.h"
+#include "packager/media/base/media_sample.h"
 #include "packager/media/base/timestamp.h"
 #include "packager/media/formats/webm/webm_cluster_parser.h"
 #include "packager/media/formats/webm/webm_constants.h"
 #include "packager/media/formats/webm/webm_content_encodings.h"
 #include "packager/media/formats/webm/webm_info_parser.h"
+#include "packager/media/formats/webm/webm_seek_head_parser.h"
 #include "packager/media/formats/webm/webm_tracks_parser.h"
 
 namespace edash_packager {
 namespace media {
+namespace {
+
+// The size of the chunks of Clusters read by random access.
+const int64_t kRandomAccessReadSize = 1024 * 1024;
+// The maximum size of an element header: a 4-byte ID and an 8-byte size.
+const int kMaxElementHeaderSize = 12;
+const int64_t kMicrosecondsPerSecond = 1000000;
+
+// Converts |time| in |timescale| to microseconds. The maximum value, which
+// means the end of the stream, is kept as is.
+int64_t ToMicroseconds(int64_t time, uint32_t timescale) {
+  if (time == std::numeric_limits<int64_t>::max())
+    return time;
+  return time * kMicrosecondsPerSecond / timescale;
+}
+
+bool CuePointTimeLess(const WebMCuesParser::CuePoint& lhs,
+                      const WebMCuesParser::CuePoint& rhs) {
+  return lhs.time < rhs.time;
+}
+
+bool TimeLessThanCuePoint(int64_t time,
+                          const WebMCuesParser::CuePoint& cue_point) {
+  return time < cue_point.time;
+}
+
+}  // namespace
 
 WebMMediaParser::WebMMediaParser()
-    : state_(kWaitingForInit), unknown_segment_size_(false) {}
+    : state_(kWaitingForInit),
+      unknown_segment_size_(false),
+      timecode_scale_(0),
+      video_track_number_(-1),
+      num_streams_(0),
+      probing_(false),
+      initialized_(false),
+      segment_payload_position_(-1),
+      cues_position_(-1),
+      first_cluster_position_(-1),
+      random_access_started_(false),
+      random_access_start_(0),
+      random_access_end_(std::numeric_limits<int64_t>::max()) {}
 
 WebMMediaParser::~WebMMediaParser() {}
 
@@ -98,6 +142,16 @@ bool WebMMediaParser::Parse(const uint8_t* buf, int size) {
   }
 
   byte_queue_.Pop(bytes_parsed);
+
+  const uint64_t max_buffered_bytes = limits().max_buffered_bytes;
+  byte_queue_.Peek(&cur, &cur_size);
+  if (max_buffered_bytes > 0 &&
+      static_cast<uint64_t>(cur_size) > max_buffered_bytes) {
+    LOG(ERROR) << "More than " << max_buffered_bytes
+               << " bytes buffered while parsing WebM.";
+    ChangeState(kError);
+    return false;
+  }
   return true;
 }
 
@@ -181,6 +235,8 @@ int WebMMediaParser::ParseInfoAndTracks(const uint8_t* data, int size) {
 
   bytes_parsed += result;
 
+  timecode_scale_ = info_parser.timecode_scale();
+  video_track_number_ = tracks_parser.video_track_num();
   double timecode_scale_in_us = info_parser.timecode_scale() / 1000.0;
   int64_t duration_in_us = info_parser.duration() * timecode_scale_in_us;
 
@@ -211,7 +267,9 @@ int WebMMediaParser::ParseInfoAndTracks(const uint8_t* data, int size) {
       tracks_parser.GetVideoDefaultDuration(timecode_scale_in_us),
       tracks_parser.text_tracks(), tracks_parser.ignored_tracks(),
       tracks_parser.audio_encryption_key_id(),
-      tracks_parser.video_encryption_key_id(), new_sample_cb_, init_cb_,
+      tracks_parser.video_encryption_key_id(),
+      base::Bind(&WebMMediaParser::OnNewSample, base::Unretained(this)),
+      base::Bind(&WebMMediaParser::OnInit, base::Unretained(this)),
       decryption_key_source_));
 
   return bytes_parsed;
@@ -221,7 +279,8 @@ int WebMMediaParser::ParseCluster(const uint8_t* data, int size) {
   if (!cluster_parser_)
     return -1;
 
-  int bytes_parsed = cluster_parser_->Parse(data, size);
+  int bytes_parsed =
+      cluster_parser_->Parse(data, size, byte_queue_.shared_buffer());
   if (bytes_parsed < 0)
     return bytes_parsed;
 
@@ -260,5 +319,175 @@ bool WebMMediaParser::FetchKeysIfNecessary(
   return true;
 }
 
+void WebMMediaParser::OnInit(
+    const std::vector<scoped_refptr<StreamInfo> >& stream_info) {
+  initialized_ = true;
+  num_streams_ = stream_info.size();
+  init_cb_.Run(stream_info);
+}
+
+bool WebMMediaParser::OnNewSample(uint32_t track_id,
+                                  const scoped_refptr<MediaSample>& sample) {
+  if (probing_)
+    return true;
+  if (random_access_file_) {
+    if (sample->dts() >= random_access_end_) {
+      // The samples of the tracks are interleaved, so the Clusters are read
+      // until every track reached the end.
+      ended_track_ids_.insert(track_id);
+      return true;
+    }
+    if (sample->dts() < random_access_start_)
+      return true;
+  }
+  return new_sample_cb_.Run(track_id, sample);
+}
+
+bool WebMMediaParser::ScanRandomAccessLayout() {
+  // Walk the top level elements, descending into the Segment, until the first
+  // Cluster. The Cues position is found in the SeekHead, or the Cues are
+  // before the Clusters.
+  int64_t position = 0;
+  uint8_t header[kMaxElementHeaderSize];
+  while (true) {
+    const int64_t header_bytes = ReadAt(position, header, sizeof(header));
+    if (header_bytes <= 0)
+      return false;
+    int id;
+    int64_t element_size;
+    const int header_size =
+        WebMParseElementHeader(header, header_bytes, &id, &element_size);
+    if (header_size <= 0)
+      return false;
+
+    if (id == kWebMIdSegment) {
+      segment_payload_position_ = position + header_size;
+      position += header_size;
+      continue;
+    }
+    if (id == kWebMIdCluster) {
+      first_cluster_position_ = position;
+      break;
+    }
+    if (id == kWebMIdSeekHead && segment_payload_position_ >= 0 &&
+        cues_position_ < 0) {
+      std::vector<uint8_t> element;
+      WebMSeekHeadParser seek_head_parser;
+      if (!ReadElementAt(position, &element) ||
+          seek_head_parser.Parse(element.data(), element.size()) <= 0) {
+        LOG(ERROR) << "Cannot parse SeekHead.";
+        return false;
+      }
+      const int64_t cues_position = seek_head_parser.GetPosition(kWebMIdCues);
+      if (cues_position >= 0)
+        cues_position_ = segment_payload_position_ + cues_position;
+    } else if (id == kWebMIdCues) {
+      cues_position_ = position;
+    }
+    if (element_size == kWebMUnknownSize)
+      return false;
+    position += header_size + element_size;
+  }
+  return segment_payload_position_ >= 0 && cues_position_ >= 0;
+}
+
+bool WebMMediaParser::SeekToRandomAccessStart() {
+  int64_t position = first_cluster_position_;
+  if (random_access_start_ > 0) {
+    // The Cues are only needed to seek, so they are loaded lazily.
+    std::vector<uint8_t> element;
+    WebMCuesParser cues_parser;
+    if (!ReadElementAt(cues_position_, &element) ||
+        cues_parser.Parse(element.data(), element.size()) <= 0) {
+      LOG(ERROR) << "Cannot parse Cues.";
+      return false;
+    }
+    // Prefer the cue points of the video track, which point at key frames.
+    const std::vector<WebMCuesParser::CuePoint>& all_cue_points =
+        cues_parser.cue_points();
+    int64_t track_number = -1;
+    for (const WebMCuesParser::CuePoint& cue_point : all_cue_points) {
+      if (cue_point.track == video_track_number_) {
+        track_number = video_track_number_;
+        break;
+      }
+    }
+    std::vector<WebMCuesParser::CuePoint> cue_points;
+    for (WebMCuesParser::CuePoint cue_point : all_cue_points) {
+      if (track_number >= 0 && cue_point.track != track_number)
+        continue;
+      cue_point.time = cue_point.time * timecode_scale_ / 1000;
+      cue_points.push_back(cue_point);
+    }
+    std::stable_sort(cue_points.begin(), cue_points.end(), CuePointTimeLess);
+
+    // The reading starts at the Cluster of the last cue point at or before
+    // the start of the range, and so does the range.
+    std::vector<WebMCuesParser::CuePoint>::const_iterator it =
+        std::upper_bound(cue_points.begin(), cue_points.end(),
+                         random_access_start_, TimeLessThanCuePoint);
+    if (it != cue_points.begin()) {
+      --it;
+      position = segment_payload_position_ + it->cluster_position;
+      random_access_start_ = it->time;
+    }
+  }
+
+  if (!random_access_file_->Seek(position)) {
+    LOG(ERROR) << "Cannot seek to Cluster at " << position;
+    return false;
+  }
+  ResetForRandomAccess();
+  return true;
+}
+
+bool WebMMediaParser::ReadElementAt(int64_t position,
+                                    std::vector<uint8_t>* element) {
+  uint8_t header[kMaxElementHeaderSize];
+  const int64_t header_bytes = ReadAt(position, header, sizeof(header));
+  if (header_bytes <= 0)
+    return false;
+  int id;
+  int64_t element_size;
+  const int header_size =
+      WebMParseElementHeader(header, header_bytes, &id, &element_size);
+  if (header_size <= 0 || element_size == kWebMUnknownSize ||
+      element_size > std::numeric_limits<int>::max() - header_size) {
+    return false;
+  }
+  const int64_t size = header_size + element_size;
+  element->resize(size);
+  return ReadAt(position, element->data(), size) == size;
+}
+
+int64_t WebMMediaParser::ReadAt(int64_t position,
+                                uint8_t* data,
+                                int64_t size) {
+  if (!random_access_file_->Seek(position)) {
+    LOG(ERROR) << "Cannot seek to " << position;
+    return -1;
+  }
+  int64_t total_bytes_read = 0;
+  while (total_bytes_read < size) {
+    const int64_t bytes_read = random_access_file_->Read(
+        data + total_bytes_read, size - total_bytes_read);
+    if (bytes_read < 0) {
+      LOG(ERROR) << "Cannot read at " << position + total_bytes_read;
+      return -1;
+    }
+    if (bytes_read == 0)
+      break;
+    total_bytes_read += bytes_read;
+  }
+  return total_bytes_read;
+}
+
+void WebMMediaParser::ResetForRandomAccess() {
+  byte_queue_.Reset();
+  if (cluster_parser_)
+    cluster_parser_->Reset();
+  ChangeState(kParsingHeaders);
+}
+
 }  // namespace media
 }  // namespace edash_packager
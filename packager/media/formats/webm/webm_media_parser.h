@@ -5,11 +5,18 @@
 #ifndef MEDIA_FORMATS_WEBM_WEBM_MEDIA_PARSER_H_
 #define MEDIA_FORMATS_WEBM_WEBM_MEDIA_PARSER_H_
 
+#include <set>
+#include <string>
+#include <vector>
+
 #include "packager/base/callback_forward.h"
 #include "packager/base/compiler_specific.h"
 #include "packager/base/memory/ref_counted.h"
+#include "packager/base/memory/scoped_ptr.h"
 #include "packager/media/base/byte_queue.h"
 #include "packager/media/base/media_parser.h"
+#include "packager/media/file/file_closer.h"
+#include "packager/media/formats/webm/webm_cues_parser.h"
 
 namespace edash_packager {
 namespace media {
@@ -30,6 +37,38 @@ class WebMMediaParser : public MediaParser {
   bool Parse(const uint8_t* buf, int size) override WARN_UNUSED_RESULT;
   /// @}
 
+  /// Sets up random access parsing of a file. The headers are parsed to
+  /// initialize the streams, then the Clusters are read from the file through
+  /// ReadRandomAccessSamples() instead of being streamed through Parse(), so
+  /// that a time range (see SetRandomAccessTimeRange()) is read starting at
+  /// the Cluster which contains its start, found in the Cues.
+  /// @param file_path is the path to the media file to be parsed. The file
+  ///        must be seekable.
+  /// @return true if the file can be parsed by random access. Otherwise the
+  ///         file should be streamed through Parse() as usual. This is the
+  ///         case for files without Cues, e.g. live streams.
+  bool InitRandomAccess(const std::string& file_path);
+
+  /// Restricts random access parsing to the samples within a time range. The
+  /// Clusters before the one containing @a start are not read, nor the
+  /// Clusters after the samples of every track reached @a end. Must be called
+  /// after InitRandomAccess() succeeded and before ReadRandomAccessSamples().
+  /// @param start is the start of the range, inclusive. The range is extended
+  ///        back to the time of the cue point at or before @a start, so that
+  ///        it starts with a sync sample.
+  /// @param end is the end of the range, exclusive, or
+  ///        std::numeric_limits<int64_t>::max() to read to the end.
+  /// @param timescale is the timescale of @a start and @a end. A sample is in
+  ///        the range if its decoding time is.
+  void SetRandomAccessTimeRange(int64_t start, int64_t end, uint32_t timescale);
+
+  /// Reads and parses the next chunk of Clusters, emitting the samples within
+  /// the time range through the NewSampleCB. The Cues are loaded on the first
+  /// call, to seek to the start of the time range.
+  /// @param end_of_stream is set to true if all the samples have been read.
+  /// @return true on success, false otherwise.
+  bool ReadRandomAccessSamples(bool* end_of_stream);
+
  private:
   enum State {
     kWaitingForInit,
@@ -63,6 +102,26 @@ class WebMMediaParser : public MediaParser {
   bool FetchKeysIfNecessary(const std::string& audio_encryption_key_id,
                             const std::string& video_encryption_key_id);
 
+  // Wrap |init_cb_| and |new_sample_cb_| for random access parsing, which
+  // probes the streams and filters the samples by time range.
+  void OnInit(const std::vector<scoped_refptr<StreamInfo> >& stream_info);
+  bool OnNewSample(uint32_t track_id, const scoped_refptr<MediaSample>& sample);
+
+  // Finds the positions of the Segment payload, of the Cues and of the first
+  // Cluster by reading the top level element headers of |random_access_file_|.
+  bool ScanRandomAccessLayout();
+  // Loads the Cues and seeks |random_access_file_| to the Cluster to start
+  // reading from.
+  bool SeekToRandomAccessStart();
+  // Reads the element at |position| of |random_access_file_|, header included,
+  // into |element|.
+  bool ReadElementAt(int64_t position, std::vector<uint8_t>* element);
+  // Reads up to |size| bytes at |position|. Returns the number of bytes read,
+  // which is less than |size| only at the end of the file, or -1 on error.
+  int64_t ReadAt(int64_t position, uint8_t* data, int64_t size);
+  // Resets the parsing state to start parsing at a Cluster.
+  void ResetForRandomAccess();
+
   State state_;
   InitCB init_cb_;
   NewSampleCB new_sample_cb_;
@@ -74,6 +133,28 @@ class WebMMediaParser : public MediaParser {
   scoped_ptr<WebMClusterParser> cluster_parser_;
   ByteQueue byte_queue_;
 
+  // The timecode scale of the Segment, in nanoseconds.
+  int64_t timecode_scale_;
+  // The track number of the video track, or -1 if there is none.
+  int64_t video_track_number_;
+  size_t num_streams_;
+
+  // Random access parsing state, see InitRandomAccess().
+  scoped_ptr<File, FileCloser> random_access_file_;
+  // Set while the headers are probed, to drop the samples parsed meanwhile.
+  bool probing_;
+  bool initialized_;
+  int64_t segment_payload_position_;
+  int64_t cues_position_;
+  int64_t first_cluster_position_;
+  bool random_access_started_;
+  // Time range of the samples to read by random access, in microseconds.
+  int64_t random_access_start_;
+  int64_t random_access_end_;
+  // The tracks whose samples reached |random_access_end_|.
+  std::set<uint32_t> ended_track_ids_;
+  std::vector<uint8_t> random_access_buffer_;
+
   DISALLOW_COPY_AND_ASSIGN(WebMMediaParser);
 };
 
@@ -48,6 +48,8 @@ Status WebMMuxer::Initialize() {
   } else if (writer->Seekable()) {
     segmenter_.reset(new SingleSegmentSegmenter(options()));
   } else {
+    LOG_IF(WARNING, options().single_segment_in_place)
+        << "Output is not seekable; ignoring single_segment_in_place.";
     segmenter_.reset(new TwoPassSingleSegmentSegmenter(options()));
   }
 
@@ -0,0 +1,86 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/formats/webm/webm_seek_head_parser.h"
+
+#include "packager/base/logging.h"
+#include "packager/media/formats/webm/webm_constants.h"
+
+namespace edash_packager {
+namespace media {
+
+WebMSeekHeadParser::WebMSeekHeadParser() : seek_id_(-1), seek_position_(-1) {}
+
+WebMSeekHeadParser::~WebMSeekHeadParser() {}
+
+int WebMSeekHeadParser::Parse(const uint8_t* buf, int size) {
+  positions_.clear();
+
+  WebMListParser parser(kWebMIdSeekHead, this);
+  int result = parser.Parse(buf, size);
+
+  if (result <= 0)
+    return result;
+
+  // For now we do all or nothing parsing.
+  return parser.IsParsingComplete() ? result : 0;
+}
+
+int64_t WebMSeekHeadParser::GetPosition(int id) const {
+  std::map<int, int64_t>::const_iterator it = positions_.find(id);
+  return it == positions_.end() ? -1 : it->second;
+}
+
+WebMParserClient* WebMSeekHeadParser::OnListStart(int id) {
+  if (id == kWebMIdSeek) {
+    seek_id_ = -1;
+    seek_position_ = -1;
+  }
+  return this;
+}
+
+bool WebMSeekHeadParser::OnListEnd(int id) {
+  if (id != kWebMIdSeek)
+    return true;
+
+  if (seek_id_ == -1 || seek_position_ == -1) {
+    LOG(ERROR) << "Incomplete Seek element.";
+    return false;
+  }
+  // Keep the first entry, in case an element is indexed more than once.
+  positions_.insert(std::make_pair(seek_id_, seek_position_));
+  return true;
+}
+
+bool WebMSeekHeadParser::OnUInt(int id, int64_t val) {
+  if (id != kWebMIdSeekPosition)
+    return true;
+
+  if (seek_position_ != -1) {
+    DVLOG(1) << "Multiple values for id " << std::hex << id << " specified";
+    return false;
+  }
+  seek_position_ = val;
+  return true;
+}
+
+bool WebMSeekHeadParser::OnBinary(int id, const uint8_t* data, int size) {
+  if (id != kWebMIdSeekID)
+    return true;
+
+  // The SeekID is the element ID, including its length marker bits.
+  if (seek_id_ != -1 || size <= 0 || size > 4) {
+    LOG(ERROR) << "Invalid SeekID element.";
+    return false;
+  }
+  seek_id_ = 0;
+  for (int i = 0; i < size; ++i)
+    seek_id_ = (seek_id_ << 8) | data[i];
+  return true;
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,55 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_FORMATS_WEBM_WEBM_SEEK_HEAD_PARSER_H_
+#define MEDIA_FORMATS_WEBM_WEBM_SEEK_HEAD_PARSER_H_
+
+#include <stdint.h>
+
+#include <map>
+
+#include "packager/base/compiler_specific.h"
+#include "packager/media/formats/webm/webm_parser.h"
+
+namespace edash_packager {
+namespace media {
+
+/// Parser for WebM SeekHead element, the reading counterpart of SeekHead.
+class WebMSeekHeadParser : public WebMParserClient {
+ public:
+  WebMSeekHeadParser();
+  ~WebMSeekHeadParser() override;
+
+  /// Parses a WebM SeekHead element in |buf|.
+  /// @return -1 if the parse fails.
+  /// @return 0 if more data is needed.
+  /// @return The number of bytes parsed on success.
+  int Parse(const uint8_t* buf, int size);
+
+  /// @return The position of the first element with ID @a id, relative to the
+  ///         start of the Segment payload, or -1 if it is not indexed.
+  int64_t GetPosition(int id) const;
+
+ private:
+  // WebMParserClient methods
+  WebMParserClient* OnListStart(int id) override;
+  bool OnListEnd(int id) override;
+  bool OnUInt(int id, int64_t val) override;
+  bool OnBinary(int id, const uint8_t* data, int size) override;
+
+  // The fields of the Seek element being parsed.
+  int seek_id_;
+  int64_t seek_position_;
+
+  std::map<int, int64_t> positions_;
+
+  DISALLOW_COPY_AND_ASSIGN(WebMSeekHeadParser);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // MEDIA_FORMATS_WEBM_WEBM_SEEK_HEAD_PARSER_H_
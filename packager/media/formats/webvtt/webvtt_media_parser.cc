@@ -28,45 +28,41 @@ const int kTrackId = 0;
 const char kCR = 0x0D;
 const char kLF = 0x0A;
 
-// Reads the first line from |data| and removes the line. Returns false if there
-// isn't a line break. Sets |line| with the content of the first line without
-// the line break.
-bool ReadLine(std::string* data, std::string* line) {
-  if (data->size() == 0) {
+// Reads the line of |data| starting at |*position|, and moves |*position| past
+// the line break. Returns false if there isn't a complete line, including a
+// line ending with a CR which may be followed by a LF not received yet. Sets
+// |line| with the content of the line without the line break. |line| points
+// into |data|.
+bool ReadLine(const base::StringPiece& data,
+              size_t* position,
+              base::StringPiece* line) {
+  const char kLineBreaks[] = {kCR, kLF, '\0'};
+  const size_t line_break = data.find_first_of(kLineBreaks, *position);
+  if (line_break == base::StringPiece::npos)
     return false;
-  }
-  size_t string_position = 0;
-  // Length of the line break mark. 1 for LF and CR, 2 for CRLF.
-  int line_break_length = 1;
-  bool found_line_break = false;
-  while (string_position < data->size()) {
-    if (data->at(string_position) == kLF) {
-      found_line_break = true;
-      break;
-    }
-
-    if (data->at(string_position) == kCR) {
-      found_line_break = true;
-      if (string_position + 1 >= data->size())
-        break;
-
-      if (data->at(string_position + 1) == kLF)
-        line_break_length = 2;
-      break;
-    }
 
-    ++string_position;
+  // Length of the line break mark. 1 for LF and CR, 2 for CRLF.
+  size_t line_break_length = 1;
+  if (data[line_break] == kCR) {
+    if (line_break + 1 >= data.size())
+      return false;
+    if (data[line_break + 1] == kLF)
+      line_break_length = 2;
   }
 
-  if (!found_line_break)
-    return false;
-
-  *line = data->substr(0, string_position);
-  data->erase(0, string_position + line_break_length);
+  *line = data.substr(*position, line_break - *position);
+  *position = line_break + line_break_length;
   return true;
 }
 
-bool TimestampToMilliseconds(const std::string& original_str,
+// Appends |line| to the multiline |text|.
+void AppendLine(const base::StringPiece& line, std::string* text) {
+  if (!text->empty())
+    text->push_back('\n');
+  line.AppendToString(text);
+}
+
+bool TimestampToMilliseconds(const base::StringPiece& str,
                              uint64_t* time_ms) {
   const size_t kMinimalHoursLength = 2;
   const size_t kMinutesLength = 2;
@@ -78,7 +74,6 @@ bool TimestampToMilliseconds(const std::string& original_str,
   const size_t kMinimalLength =
       kMinutesLength + kSecondsLength + kMillisecondsLength + 2;
 
-  base::StringPiece str(original_str);
   if (str.size() < kMinimalLength)
     return false;
 
@@ -144,14 +139,14 @@ bool TimestampToMilliseconds(const std::string& original_str,
 
 // Clears |settings| and 0s |start_time| and |duration| regardless of the
 // parsing result.
-bool ParseTimingAndSettingsLine(const std::string& line,
+bool ParseTimingAndSettingsLine(const base::StringPiece& line,
                                 uint64_t* start_time,
                                 uint64_t* duration,
                                 std::string* settings) {
   *start_time = 0;
   *duration = 0;
   settings->clear();
-  std::vector<std::string> entries = base::SplitString(
+  std::vector<base::StringPiece> entries = base::SplitStringPiece(
       line, " ", base::TRIM_WHITESPACE, base::SPLIT_WANT_NONEMPTY);
   if (entries.size() < 3) {
     // The timing is time1 --> time3 so if there aren't 3 entries, this is parse
@@ -165,13 +160,13 @@ bool ParseTimingAndSettingsLine(const std::string& line,
     return false;
   }
 
-  const std::string& start_time_str = entries[0];
+  const base::StringPiece& start_time_str = entries[0];
   if (!TimestampToMilliseconds(start_time_str, start_time)) {
     LOG(ERROR) << "Failed to parse " << start_time_str << " in " << line;
     return false;
   }
 
-  const std::string& end_time_str = entries[2];
+  const base::StringPiece& end_time_str = entries[2];
   uint64_t end_time = 0;
   if (!TimestampToMilliseconds(end_time_str, &end_time)) {
     LOG(ERROR) << "Failed to parse " << end_time_str << " in " << line;
@@ -179,8 +174,11 @@ bool ParseTimingAndSettingsLine(const std::string& line,
   }
   *duration = end_time - *start_time;
 
-  entries.erase(entries.begin(), entries.begin() + 3);
-  *settings = base::JoinString(entries, " ");
+  for (size_t i = 3; i < entries.size(); ++i) {
+    if (i > 3)
+      settings->push_back(' ');
+    entries[i].AppendToString(settings);
+  }
   return true;
 }
 
@@ -191,15 +189,14 @@ bool ParseTimingAndSettingsLine(const std::string& line,
 scoped_refptr<MediaSample> CueToMediaSample(const Cue& cue) {
   const bool kKeyFrame = true;
   if (!cue.comment.empty()) {
-    const std::string comment = base::JoinString(cue.comment, "\n");
     return MediaSample::FromMetadata(
-        reinterpret_cast<const uint8_t*>(comment.data()), comment.size());
+        reinterpret_cast<const uint8_t*>(cue.comment.data()),
+        cue.comment.size());
   }
 
-  const std::string payload = base::JoinString(cue.payload, "\n");
   scoped_refptr<MediaSample> media_sample = MediaSample::CopyFrom(
-      reinterpret_cast<const uint8_t*>(payload.data()),
-      payload.size(),
+      reinterpret_cast<const uint8_t*>(cue.payload.data()),
+      cue.payload.size(),
       reinterpret_cast<const uint8_t*>(cue.settings.data()),
       cue.settings.size(),
       !kKeyFrame);
@@ -215,6 +212,15 @@ scoped_refptr<MediaSample> CueToMediaSample(const Cue& cue) {
 Cue::Cue() : start_time(0), duration(0) {}
 Cue::~Cue() {}
 
+void Cue::Clear() {
+  identifier.clear();
+  start_time = 0;
+  duration = 0;
+  settings.clear();
+  payload.clear();
+  comment.clear();
+}
+
 WebVttMediaParser::WebVttMediaParser() : state_(kHeader) {}
 WebVttMediaParser::~WebVttMediaParser() {}
 
@@ -233,16 +239,16 @@ bool WebVttMediaParser::Flush() {
   if (!data_.empty()) {
     // If it was in the middle of the payload and the stream finished, then this
     // is an end of the payload. The rest of the data is part of the payload.
-    if (state_ == kCuePayload) {
-      current_cue_.payload.push_back(data_);
-    } else {
-      current_cue_.comment.push_back(data_);
-    }
+    base::StringPiece line(data_);
+    if (line.ends_with(base::StringPiece(&kCR, 1)))
+      line.remove_suffix(1);
+    AppendLine(line, state_ == kCuePayload ? &current_cue_.payload
+                                           : &current_cue_.comment);
     data_.clear();
   }
 
   bool result = new_sample_cb_.Run(kTrackId, CueToMediaSample(current_cue_));
-  current_cue_ = Cue();
+  current_cue_.Clear();
   state_ = kCueIdentifierOrTimingOrComment;
   return result;
 }
@@ -253,136 +259,160 @@ bool WebVttMediaParser::Parse(const uint8_t* buf, int size) {
     return false;
   }
 
-  data_.insert(data_.end(), buf, buf + size);
+  // The lines are parsed in place, in |buf| unless there is an incomplete line
+  // left from the previous calls to complete. Only the incomplete last line is
+  // kept.
+  const bool parse_in_place = data_.empty();
+  if (!parse_in_place)
+    data_.append(reinterpret_cast<const char*>(buf), size);
+  const base::StringPiece input =
+      parse_in_place
+          ? base::StringPiece(reinterpret_cast<const char*>(buf), size)
+          : base::StringPiece(data_);
+
+  size_t position = 0;
+  base::StringPiece line;
+  while (ReadLine(input, &position, &line)) {
+    if (!ParseLine(line)) {
+      DCHECK_EQ(kParseError, state_);
+      data_.clear();
+      return false;
+    }
+  }
 
-  std::string line;
-  while (ReadLine(&data_, &line)) {
-    // Only kCueIdentifierOrTimingOrComment and kCueTiming states accept -->.
-    // Error otherwise.
-    const bool has_arrow = line.find("-->") != std::string::npos;
-    if (state_ == kCueTiming) {
-      if (!has_arrow) {
-        LOG(ERROR) << "Expected --> in: " << line;
-        state_ = kParseError;
-        return false;
-      }
-    } else if (state_ != kCueIdentifierOrTimingOrComment) {
-      if (has_arrow) {
-        LOG(ERROR) << "Unexpected --> in " << line;
-        state_ = kParseError;
-        return false;
-      }
+  if (parse_in_place)
+    input.substr(position).CopyToString(&data_);
+  else
+    data_.erase(0, position);
+  return true;
+}
+
+bool WebVttMediaParser::ParseLine(const base::StringPiece& line) {
+  // Only kCueIdentifierOrTimingOrComment and kCueTiming states accept -->.
+  // Error otherwise.
+  const bool has_arrow = line.find("-->") != base::StringPiece::npos;
+  if (state_ == kCueTiming) {
+    if (!has_arrow) {
+      LOG(ERROR) << "Expected --> in: " << line;
+      state_ = kParseError;
+      return false;
+    }
+  } else if (state_ != kCueIdentifierOrTimingOrComment) {
+    if (has_arrow) {
+      LOG(ERROR) << "Unexpected --> in " << line;
+      state_ = kParseError;
+      return false;
     }
+  }
 
-    switch (state_) {
-      case kHeader:
-        // No check. This should be WEBVTT when this object was created.
-        header_.push_back(line);
-        state_ = kMetadata;
+  switch (state_) {
+    case kHeader:
+      // No check. This should be WEBVTT when this object was created.
+      header_.push_back(line.as_string());
+      state_ = kMetadata;
+      break;
+    case kMetadata: {
+      if (line.empty()) {
+        std::vector<scoped_refptr<StreamInfo> > streams;
+        // The resolution of timings are in milliseconds.
+        const int kTimescale = 1000;
+
+        // The duration passed here is not very important. Also the whole file
+        // must be read before determining the real duration which doesn't
+        // work nicely with the current demuxer.
+        const int kDuration = 0;
+
+        // There is no one metadata to determine what the language is. Parts
+        // of the text may be annotated as some specific language.
+        const char kLanguage[] = "";
+        streams.push_back(new TextStreamInfo(
+            kTrackId,
+            kTimescale,
+            kDuration,
+            "wvtt",
+            kLanguage,
+            base::JoinString(header_, "\n"),
+            0,         // Not necessary.
+            0));       // Not necessary.
+
+        init_cb_.Run(streams);
+        state_ = kCueIdentifierOrTimingOrComment;
+        break;
+      }
+
+      header_.push_back(line.as_string());
+      break;
+    }
+    case kCueIdentifierOrTimingOrComment: {
+      // Note that there can be one or more line breaks before a cue starts;
+      // skip this line.
+      // Or the file could end without a new cue.
+      if (line.empty())
         break;
-      case kMetadata: {
-        if (line.empty()) {
-          std::vector<scoped_refptr<StreamInfo> > streams;
-          // The resolution of timings are in milliseconds.
-          const int kTimescale = 1000;
-
-          // The duration passed here is not very important. Also the whole file
-          // must be read before determining the real duration which doesn't
-          // work nicely with the current demuxer.
-          const int kDuration = 0;
-
-          // There is no one metadata to determine what the language is. Parts
-          // of the text may be annotated as some specific language.
-          const char kLanguage[] = "";
-          streams.push_back(new TextStreamInfo(
-              kTrackId,
-              kTimescale,
-              kDuration,
-              "wvtt",
-              kLanguage,
-              base::JoinString(header_, "\n"),
-              0,         // Not necessary.
-              0));       // Not necessary.
-
-          init_cb_.Run(streams);
-          state_ = kCueIdentifierOrTimingOrComment;
-          break;
-        }
 
-        header_.push_back(line);
+      if (!has_arrow) {
+        if (base::StartsWith(line, "NOTE",
+                             base::CompareCase::INSENSITIVE_ASCII)) {
+          state_ = kComment;
+          AppendLine(line, &current_cue_.comment);
+        } else {
+          // A cue can start from a cue identifier.
+          // https://w3c.github.io/webvtt/#webvtt-cue-identifier
+          line.CopyToString(&current_cue_.identifier);
+          // The next line must be a timing.
+          state_ = kCueTiming;
+        }
         break;
       }
-      case kCueIdentifierOrTimingOrComment: {
-        // Note that there can be one or more line breaks before a cue starts;
-        // skip this line.
-        // Or the file could end without a new cue.
-        if (line.empty())
-          break;
-
-        if (!has_arrow) {
-          if (base::StartsWith(line, "NOTE",
-                                      base::CompareCase::INSENSITIVE_ASCII)) {
-            state_ = kComment;
-            current_cue_.comment.push_back(line);
-          } else {
-            // A cue can start from a cue identifier.
-            // https://w3c.github.io/webvtt/#webvtt-cue-identifier
-            current_cue_.identifier = line;
-            // The next line must be a timing.
-            state_ = kCueTiming;
-          }
-          break;
-        }
 
-        // No break statement if the line has an arrow; it should be a WebVTT
-        // timing, so fall thru. Setting state_ to kCueTiming so that the state
-        // always matches the case.
-        state_ = kCueTiming;
-        FALLTHROUGH_INTENDED;
+      // No break statement if the line has an arrow; it should be a WebVTT
+      // timing, so fall thru. Setting state_ to kCueTiming so that the state
+      // always matches the case.
+      state_ = kCueTiming;
+      FALLTHROUGH_INTENDED;
+    }
+    case kCueTiming: {
+      DCHECK(has_arrow);
+      if (!ParseTimingAndSettingsLine(line, &current_cue_.start_time,
+                                      &current_cue_.duration,
+                                      &current_cue_.settings)) {
+        state_ = kParseError;
+        return false;
       }
-      case kCueTiming: {
-        DCHECK(has_arrow);
-        if (!ParseTimingAndSettingsLine(line, &current_cue_.start_time,
-                                        &current_cue_.duration,
-                                        &current_cue_.settings)) {
+      state_ = kCuePayload;
+      break;
+    }
+    case kCuePayload: {
+      if (line.empty()) {
+        state_ = kCueIdentifierOrTimingOrComment;
+        if (!new_sample_cb_.Run(kTrackId, CueToMediaSample(current_cue_))) {
           state_ = kParseError;
           return false;
         }
-        state_ = kCuePayload;
+        current_cue_.Clear();
         break;
       }
-      case kCuePayload: {
-        if (line.empty()) {
-          state_ = kCueIdentifierOrTimingOrComment;
-          if (!new_sample_cb_.Run(kTrackId, CueToMediaSample(current_cue_))) {
-            state_ = kParseError;
-            return false;
-          }
-          current_cue_ = Cue();
-          break;
-        }
 
-        current_cue_.payload.push_back(line);
-        break;
-      }
-      case kComment: {
-        if (line.empty()) {
-          state_ = kCueIdentifierOrTimingOrComment;
-          if (!new_sample_cb_.Run(kTrackId, CueToMediaSample(current_cue_))) {
-            state_ = kParseError;
-            return false;
-          }
-          current_cue_ = Cue();
-          break;
+      AppendLine(line, &current_cue_.payload);
+      break;
+    }
+    case kComment: {
+      if (line.empty()) {
+        state_ = kCueIdentifierOrTimingOrComment;
+        if (!new_sample_cb_.Run(kTrackId, CueToMediaSample(current_cue_))) {
+          state_ = kParseError;
+          return false;
         }
-
-        current_cue_.comment.push_back(line);
+        current_cue_.Clear();
         break;
       }
-      case kParseError:
-        NOTREACHED();
-        return false;
+
+      AppendLine(line, &current_cue_.comment);
+      break;
     }
+    case kParseError:
+      NOTREACHED();
+      return false;
   }
 
   return true;
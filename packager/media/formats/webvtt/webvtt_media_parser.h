@@ -12,6 +12,7 @@
 #include <vector>
 
 #include "packager/base/compiler_specific.h"
+#include "packager/base/strings/string_piece.h"
 #include "packager/media/base/media_parser.h"
 
 namespace edash_packager {
@@ -19,17 +20,20 @@ namespace media {
 
 // If comment is not empty, then this is metadata and other fields must
 // be empty.
-// Data that can be multiline are vector of strings.
+// Data that can be multiline hold the lines separated with '\n'.
 struct Cue {
   Cue();
   ~Cue();
 
+  // Resets the cue, keeping the memory of the strings for the next cue.
+  void Clear();
+
   std::string identifier;
   uint64_t start_time;
   uint64_t duration;
   std::string settings;
-  std::vector<std::string> payload;
-  std::vector<std::string> comment;
+  std::string payload;
+  std::string comment;
 };
 
 // WebVTT parser.
@@ -59,10 +63,15 @@ class WebVttMediaParser : public MediaParser {
     kParseError,
   };
 
+  // Parses a complete line, without its line break.
+  bool ParseLine(const base::StringPiece& line);
+
   InitCB init_cb_;
   NewSampleCB new_sample_cb_;
 
-  // All the unprocessed data passed to this parser.
+  // The unprocessed data passed to this parser, i.e. the last line if it is
+  // not complete yet. The lines are parsed in place, so the memory held does
+  // not depend on the length of the input.
   std::string data_;
 
   // The WEBVTT text + metadata header (global settings) for this webvtt.
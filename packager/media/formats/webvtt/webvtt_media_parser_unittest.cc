@@ -216,6 +216,39 @@ TEST_F(WebVttMediaParserTest, PartialParse) {
   EXPECT_TRUE(parser_.Flush());
 }
 
+// Verify that the input can be split anywhere, including between the CR and
+// the LF of a line break, and that multiline payloads are kept.
+TEST_F(WebVttMediaParserTest, ParseByteByByte) {
+  const char kExpectedPayload[] = "subtitle\nsecond line";
+  const std::vector<uint8_t> expected_payload(
+      kExpectedPayload, kExpectedPayload + arraysize(kExpectedPayload) - 1);
+
+  InSequence s;
+  EXPECT_CALL(init_callback_, Call(_));
+  EXPECT_CALL(new_sample_callback_, Call(_, MatchesPayload(expected_payload)))
+      .Times(2)
+      .WillRepeatedly(Return(true));
+
+  const char kWebVtt[] =
+      "WEBVTT\r\n"
+      "\r\n"
+      "00:01:01.004 --> 00:01:22.088\r\n"
+      "subtitle\r\n"
+      "second line\r\n"
+      "\r\n"
+      "02:06:00.000 --> 02:30:02.006\r\n"
+      "subtitle\r\n"
+      "second line\r\n";
+
+  InitializeParser();
+  for (size_t i = 0; i < arraysize(kWebVtt) - 1; ++i) {
+    EXPECT_TRUE(
+        parser_.Parse(reinterpret_cast<const uint8_t*>(kWebVtt) + i, 1));
+  }
+
+  EXPECT_TRUE(parser_.Flush());
+}
+
 // Verify that metadata header with --> is rejected.
 TEST_F(WebVttMediaParserTest, BadMetadataHeader) {
   EXPECT_CALL(init_callback_, Call(_)).Times(0);
@@ -22,6 +22,7 @@
         '../../formats/mp2t/mp2t.gyp:mp2t',
         '../../formats/mp4/mp4.gyp:mp4',
         '../mpeg/mpeg.gyp:mpeg',
+        '../../../third_party/gflags/gflags.gyp:gflags',
       ],
     },
     {
@@ -33,6 +34,7 @@
       'dependencies': [
         '../../../testing/gtest.gyp:gtest',
         '../../../testing/gmock.gyp:gmock',
+        '../../../third_party/gflags/gflags.gyp:gflags',
         '../../test/media_test.gyp:media_test_support',
         'wvm',
       ]
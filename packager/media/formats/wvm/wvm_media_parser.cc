@@ -4,28 +4,42 @@
 
 #include "packager/media/formats/wvm/wvm_media_parser.h"
 
+#include <gflags/gflags.h>
+#include <string.h>
+
+#include <algorithm>
 #include <map>
 #include <sstream>
 #include <vector>
 
+#include "packager/base/bind.h"
 #include "packager/base/strings/string_number_conversions.h"
 #include "packager/media/base/aes_decryptor.h"
 #include "packager/media/base/audio_stream_info.h"
 #include "packager/media/base/key_source.h"
 #include "packager/media/base/media_sample.h"
 #include "packager/media/base/status.h"
+#include "packager/media/base/thread_pool.h"
 #include "packager/media/base/video_stream_info.h"
 #include "packager/media/filters/avc_decoder_configuration.h"
 #include "packager/media/formats/mp2t/adts_header.h"
 #include "packager/media/formats/mp4/aac_audio_specific_config.h"
 #include "packager/media/formats/mp4/es_descriptor.h"
 
+DEFINE_int32(wvm_decryption_threads,
+             0,
+             "Number of threads decrypting the samples of WVM inputs, while "
+             "the PES packets are demultiplexed on the demuxer thread. 0 or 1 "
+             "decrypts them on the demuxer thread.");
+
 #define HAS_HEADER_EXTENSION(x) ((x != 0xBC) && (x != 0xBE) && (x != 0xBF) \
          && (x != 0xF0) && (x != 0xF2) && (x != 0xF8) \
          && (x != 0xFF))
 
 namespace {
 const uint32_t kMpeg2ClockRate = 90000;
+// The PES timestamps are coded on 33 bits.
+const int kPesTimestampBits = 33;
 const uint32_t kPesOptPts = 0x80;
 const uint32_t kPesOptDts = 0x40;
 const uint32_t kPesOptAlign = 0x04;
@@ -68,6 +82,20 @@ const uint32_t kAssetKeySizeBytes = 16;
 // Default audio and video PES stream IDs.
 const uint8_t kDefaultAudioStreamId = kPesStreamIdAudio;
 const uint8_t kDefaultVideoStreamId = kPesStreamIdVideo;
+// The size of the pack header following the start code.
+const int kPackHeaderSize = 10;
+// The size of a PTS or DTS field.
+const int kTimestampSize = 5;
+
+// Reads the 33-bit PTS or DTS field at |data|.
+uint64_t ReadTimestamp(const uint8_t* data) {
+  uint64_t timestamp = data[0] & 0x0E;
+  timestamp = (timestamp << 7) | data[1];
+  timestamp = (timestamp << 7) | (data[2] >> 1);
+  timestamp = (timestamp << 8) | data[3];
+  timestamp = (timestamp << 7) | (data[4] >> 1);
+  return timestamp;
+}
 
 enum Type {
   Type_void = 0,
@@ -105,11 +133,18 @@ WvmMediaParser::WvmMediaParser()
       timestamp_(0),
       pts_(0),
       dts_(0),
+      pts_unroller_(kPesTimestampBits),
+      dts_unroller_(kPesTimestampBits),
       index_program_id_(0),
       media_sample_(NULL),
       crypto_unit_start_pos_(0),
       stream_id_count_(0),
       decryption_key_source_(NULL) {
+  if (FLAGS_wvm_decryption_threads > 1) {
+    decryption_thread_pool_.reset(
+        new ThreadPool("WvmDecryption", FLAGS_wvm_decryption_threads));
+    decryption_thread_pool_->Start();
+  }
 }
 
 WvmMediaParser::~WvmMediaParser() {}
@@ -133,11 +168,24 @@ bool WvmMediaParser::Parse(const uint8_t* buf, int size) {
 
   while (read_ptr < end) {
     switch (parse_state_) {
-      case StartCode1:
-        if (*read_ptr == kStartCode1) {
-          parse_state_ = StartCode2;
+      case StartCode1: {
+        // Look for the start code in bulk rather than one state per byte.
+        const uint8_t* start_code = static_cast<const uint8_t*>(
+            memchr(read_ptr, kStartCode1, end - read_ptr));
+        if (!start_code) {
+          read_ptr = end;
+          continue;
+        }
+        read_ptr = start_code;
+        if (end - read_ptr >= 3 && read_ptr[1] == kStartCode2 &&
+            read_ptr[2] == kStartCode3) {
+          read_ptr += 3;
+          parse_state_ = StartCode4;
+          continue;
         }
+        parse_state_ = StartCode2;
         break;
+      }
       case StartCode2:
         if (*read_ptr == kStartCode2) {
           parse_state_ = StartCode3;
@@ -169,6 +217,12 @@ bool WvmMediaParser::Parse(const uint8_t* buf, int size) {
         }
         break;
       case PackHeader1:
+        if (end - read_ptr >= kPackHeaderSize) {
+          skip_bytes_ = read_ptr[kPackHeaderSize - 1] & 0x07;
+          read_ptr += kPackHeaderSize;
+          parse_state_ = PackHeaderStuffingSkip;
+          continue;
+        }
         parse_state_ = PackHeader2;
         break;
       case PackHeader2:
@@ -277,6 +331,19 @@ bool WvmMediaParser::Parse(const uint8_t* buf, int size) {
         }
         break;
       case Pts1:
+        if (end - read_ptr >= kTimestampSize) {
+          timestamp_ = pts_ = ReadTimestamp(read_ptr);
+          pes_header_data_bytes_ -= kTimestampSize;
+          pes_packet_bytes_ -= kTimestampSize;
+          read_ptr += kTimestampSize;
+          if (pes_flags_2_ & kPesOptDts) {
+            parse_state_ = Dts1;
+          } else {
+            dts_ = pts_;
+            parse_state_ = PesHeaderData;
+          }
+          continue;
+        }
         timestamp_ = (*read_ptr & 0x0E);
         --pes_header_data_bytes_;
         --pes_packet_bytes_;
@@ -317,6 +384,14 @@ bool WvmMediaParser::Parse(const uint8_t* buf, int size) {
         }
         break;
       case Dts1:
+        if (end - read_ptr >= kTimestampSize) {
+          timestamp_ = dts_ = ReadTimestamp(read_ptr);
+          pes_header_data_bytes_ -= kTimestampSize;
+          pes_packet_bytes_ -= kTimestampSize;
+          read_ptr += kTimestampSize;
+          parse_state_ = PesHeaderData;
+          continue;
+        }
         timestamp_ = (*read_ptr & 0x0E);
         --pes_header_data_bytes_;
         --pes_packet_bytes_;
@@ -473,6 +548,8 @@ bool WvmMediaParser::Parse(const uint8_t* buf, int size) {
         }
         // Reset.
         dts_ = pts_ = 0;
+        pts_unroller_.Reset();
+        dts_unroller_.Reset();
         parse_state_ = StartCode1;
         prev_media_sample_data_.Reset();
         current_program_id_++;
@@ -485,7 +562,7 @@ bool WvmMediaParser::Parse(const uint8_t* buf, int size) {
     }
     ++read_ptr;
   }
-  return true;
+  return OutputPendingSamples();
 }
 
 bool WvmMediaParser::EmitLastSample(uint32_t stream_id,
@@ -517,6 +594,8 @@ bool WvmMediaParser::EmitPendingSamples() {
 }
 
 bool WvmMediaParser::Flush() {
+  if (!OutputPendingSamples())
+    return false;
   // Flush the last audio and video sample for current program.
   // Reset the streamID when successfully emitted.
   if (prev_media_sample_data_.audio_sample != NULL) {
@@ -779,6 +858,11 @@ bool WvmMediaParser::DemuxNextPes(bool is_program_end) {
     // Decrypt crypto unit.
     if (!content_decryptor_) {
       output_encrypted_sample = true;
+    } else if (decryption_thread_pool_) {
+      // Decrypted with the other pending samples.
+      crypto_units_.push_back(
+          std::make_pair(static_cast<size_t>(crypto_unit_start_pos_),
+                         sample_data_.size() - crypto_unit_start_pos_));
     } else {
       content_decryptor_->Crypt(&sample_data_[crypto_unit_start_pos_],
                                 sample_data_.size() - crypto_unit_start_pos_,
@@ -789,7 +873,9 @@ bool WvmMediaParser::DemuxNextPes(bool is_program_end) {
   // continuation PES.
   if ((pes_flags_2_ & kPesOptPts) || is_program_end) {
     if (!sample_data_.empty()) {
-      if (!Output(output_encrypted_sample)) {
+      if (decryption_thread_pool_) {
+        QueuePendingSample(output_encrypted_sample);
+      } else if (!Output(output_encrypted_sample)) {
         return false;
       }
     }
@@ -803,11 +889,13 @@ bool WvmMediaParser::DemuxNextPes(bool is_program_end) {
 void WvmMediaParser::StartMediaSampleDemux() {
   bool is_key_frame = ((pes_flags_1_ & kPesOptAlign) != 0);
   media_sample_ = MediaSample::CreateEmptyMediaSample();
-  media_sample_->set_dts(dts_);
-  media_sample_->set_pts(pts_);
+  // Unroll the timestamps, which wrap around in long programs.
+  media_sample_->set_dts(dts_unroller_.Unroll(dts_));
+  media_sample_->set_pts(pts_unroller_.Unroll(pts_));
   media_sample_->set_is_key_frame(is_key_frame);
 
   sample_data_.clear();
+  crypto_units_.clear();
 }
 
 bool WvmMediaParser::Output(bool output_encrypted_sample) {
@@ -1074,7 +1162,99 @@ bool WvmMediaParser::GetAssetKey(const uint32_t asset_id,
   return true;
 }
 
+void WvmMediaParser::QueuePendingSample(bool output_encrypted) {
+  pending_samples_.push_back(PendingSample());
+  PendingSample& pending_sample = pending_samples_.back();
+  pending_sample.media_sample = media_sample_;
+  pending_sample.pes_stream_id = prev_pes_stream_id_;
+  pending_sample.data.swap(sample_data_);
+  pending_sample.crypto_units.swap(crypto_units_);
+  pending_sample.output_encrypted = output_encrypted;
+}
+
+bool WvmMediaParser::OutputPendingSamples() {
+  if (pending_samples_.empty())
+    return true;
+
+  // Every crypto unit is decrypted from the constant IV, so the samples are
+  // decrypted independently, in contiguous ranges, one per thread.
+  const size_t num_samples = pending_samples_.size();
+  const size_t num_tasks =
+      std::min(num_samples, decryption_thread_pool_->num_threads());
+  scoped_ptr<bool[]> success(new bool[num_tasks]);
+  std::vector<base::Closure> tasks;
+  for (size_t i = 0; i < num_tasks; ++i) {
+    tasks.push_back(base::Bind(&WvmMediaParser::DecryptPendingSamples,
+                               base::Unretained(this),
+                               num_samples * i / num_tasks,
+                               num_samples * (i + 1) / num_tasks,
+                               &success[i]));
+  }
+  if (tasks.size() == 1)
+    tasks[0].Run();
+  else
+    decryption_thread_pool_->RunTasksAndWait(tasks);
+  if (std::find(success.get(), success.get() + num_tasks, false) !=
+      success.get() + num_tasks) {
+    LOG(ERROR) << "Failed to decrypt samples.";
+    pending_samples_.clear();
+    return false;
+  }
+
+  // Output() works on the current sample, which is set aside meanwhile.
+  scoped_refptr<MediaSample> current_sample = media_sample_;
+  const uint32_t current_pes_stream_id = prev_pes_stream_id_;
+  std::vector<uint8_t> current_sample_data;
+  current_sample_data.swap(sample_data_);
+  bool result = true;
+  for (PendingSample& pending_sample : pending_samples_) {
+    media_sample_ = pending_sample.media_sample;
+    prev_pes_stream_id_ = pending_sample.pes_stream_id;
+    sample_data_.swap(pending_sample.data);
+    result = Output(pending_sample.output_encrypted);
+    if (!result)
+      break;
+  }
+  pending_samples_.clear();
+  media_sample_ = current_sample;
+  prev_pes_stream_id_ = current_pes_stream_id;
+  sample_data_.swap(current_sample_data);
+  return result;
+}
+
+void WvmMediaParser::DecryptPendingSamples(size_t begin,
+                                           size_t end,
+                                           bool* success) {
+  *success = true;
+  // The decryptor keeps the IV state, so every thread uses its own.
+  scoped_ptr<AesCbcDecryptor> decryptor;
+  for (size_t i = begin; i < end; ++i) {
+    PendingSample& pending_sample = pending_samples_[i];
+    for (const std::pair<size_t, size_t>& crypto_unit :
+         pending_sample.crypto_units) {
+      if (!decryptor) {
+        decryptor.reset(
+            new AesCbcDecryptor(kCtsPadding, AesCryptor::kUseConstantIv));
+        const std::vector<uint8_t> zero_iv(kInitializationVectorSizeBytes, 0);
+        if (!decryptor->InitializeWithIv(content_key_, zero_iv)) {
+          *success = false;
+          return;
+        }
+      }
+      uint8_t* data = &pending_sample.data[crypto_unit.first];
+      if (!decryptor->Crypt(data, crypto_unit.second, data)) {
+        *success = false;
+        return;
+      }
+    }
+  }
+}
+
 bool WvmMediaParser::ProcessEcm() {
+  // The pending samples are decrypted with the current content key.
+  if (!OutputPendingSamples())
+    return false;
+
   // An error will be returned later if the samples need to be decrypted.
   if (!decryption_key_source_)
     return true;
@@ -1141,9 +1321,15 @@ bool WvmMediaParser::ProcessEcm() {
   }
 
   content_decryptor_ = content_decryptor.Pass();
+  content_key_ = decrypted_content_key_vec;
   return true;
 }
 
+WvmMediaParser::PendingSample::PendingSample()
+    : pes_stream_id(0), output_encrypted(false) {}
+
+WvmMediaParser::PendingSample::~PendingSample() {}
+
 DemuxStreamIdMediaSample::DemuxStreamIdMediaSample() :
   demux_stream_id(0),
   parsed_audio_or_video_stream_id(0) {}
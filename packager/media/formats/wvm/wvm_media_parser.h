@@ -9,12 +9,14 @@
 #include <deque>
 #include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "packager/base/compiler_specific.h"
 #include "packager/base/memory/scoped_ptr.h"
 #include "packager/media/base/media_parser.h"
 #include "packager/media/base/network_util.h"
+#include "packager/media/base/timestamp_unroller.h"
 #include "packager/media/filters/h264_byte_to_unit_stream_converter.h"
 
 namespace edash_packager {
@@ -22,6 +24,7 @@ namespace media {
 
 class AesCbcDecryptor;
 class KeySource;
+class ThreadPool;
 struct EncryptionKey;
 
 namespace wvm {
@@ -160,6 +163,20 @@ class WvmMediaParser : public MediaParser {
     ProgramEnd
   };
 
+  // A demuxed sample whose crypto units are decrypted on
+  // |decryption_thread_pool_| before the sample is output.
+  struct PendingSample {
+    PendingSample();
+    ~PendingSample();
+
+    scoped_refptr<MediaSample> media_sample;
+    uint32_t pes_stream_id;
+    std::vector<uint8_t> data;
+    // The offset and size of the encrypted crypto units in |data|.
+    std::vector<std::pair<size_t, size_t> > crypto_units;
+    bool output_encrypted;
+  };
+
   bool ProcessEcm();
 
   // Index denotes 'search index' in the WVM content.
@@ -214,6 +231,16 @@ class WvmMediaParser : public MediaParser {
   bool EmitLastSample(uint32_t stream_id,
                       scoped_refptr<MediaSample>& new_sample);
 
+  // Queues the current sample, with its crypto units still encrypted, to be
+  // output by OutputPendingSamples().
+  void QueuePendingSample(bool output_encrypted);
+  // Decrypts the pending samples on |decryption_thread_pool_|, then outputs
+  // them in order on the calling thread.
+  bool OutputPendingSamples();
+  // Decrypts the crypto units of the samples of |pending_samples_| in
+  // [|begin|, |end|). Run on the decryption threads.
+  void DecryptPendingSamples(size_t begin, size_t end, bool* success);
+
   // List of callbacks.t
   InitCB init_cb_;
   NewSampleCB new_sample_cb_;
@@ -237,6 +264,8 @@ class WvmMediaParser : public MediaParser {
   uint64_t timestamp_;
   uint64_t pts_;
   uint64_t dts_;
+  TimestampUnroller pts_unroller_;
+  TimestampUnroller dts_unroller_;
   uint8_t index_program_id_;
   scoped_refptr<MediaSample> media_sample_;
   uint32_t crypto_unit_start_pos_;
@@ -253,6 +282,14 @@ class WvmMediaParser : public MediaParser {
   std::vector<uint8_t> sample_data_;
   KeySource* decryption_key_source_;
   scoped_ptr<AesCbcDecryptor> content_decryptor_;
+  // The key of |content_decryptor_|, for the decryption threads.
+  std::vector<uint8_t> content_key_;
+
+  // The crypto units of |sample_data_| left encrypted, when decrypting on
+  // |decryption_thread_pool_|.
+  std::vector<std::pair<size_t, size_t> > crypto_units_;
+  std::deque<PendingSample> pending_samples_;
+  scoped_ptr<ThreadPool> decryption_thread_pool_;
 
   DISALLOW_COPY_AND_ASSIGN(WvmMediaParser);
 };
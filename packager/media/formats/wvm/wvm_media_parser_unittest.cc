@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <gflags/gflags.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
@@ -22,6 +23,8 @@
 #include "packager/media/formats/wvm/wvm_media_parser.h"
 #include "packager/media/test/test_data_util.h"
 
+DECLARE_int32(wvm_decryption_threads);
+
 namespace {
 const int64_t kNoTimestamp = std::numeric_limits<int64_t>::min();
 const char kWvmFile[] = "bear-640x360.wvm";
@@ -198,6 +201,20 @@ TEST_F(WvmMediaParserTest, ParseWvm) {
   EXPECT_EQ(0, encrypted_sample_count_);
 }
 
+TEST_F(WvmMediaParserTest, ParseWvmWithDecryptionThreads) {
+  google::FlagSaver flag_saver;
+  FLAGS_wvm_decryption_threads = 2;
+  parser_.reset(new WvmMediaParser());
+  EXPECT_CALL(*key_source_, FetchKeys(_)).WillOnce(Return(Status::OK));
+  EXPECT_CALL(*key_source_, GetKey(_, _))
+      .WillOnce(DoAll(SetArgPointee<1>(encryption_key_), Return(Status::OK)));
+  Parse(kWvmFile);
+  EXPECT_EQ(kExpectedStreams, stream_map_.size());
+  EXPECT_EQ(kExpectedVideoFrameCount, video_frame_count_);
+  EXPECT_EQ(kExpectedAudioFrameCount, audio_frame_count_);
+  EXPECT_EQ(0, encrypted_sample_count_);
+}
+
 TEST_F(WvmMediaParserTest, ParseWvmWith64ByteAssetKey) {
   EXPECT_CALL(*key_source_, FetchKeys(_)).WillOnce(Return(Status::OK));
   // WVM uses only the first 16 bytes of the asset key.
@@ -0,0 +1,271 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+// Manifest generation benchmarks. Each scenario drives a live MPD or HLS
+// notifier with a synthetic ladder of representations, adding a segment to
+// each representation then flushing the manifests, as the muxers do, and
+// reports, as the ladder and the number of segments grow, the latency of the
+// flushes, the memory accounted for the segments and the size of the output.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/strings/stringprintf.h"
+#include "packager/base/time/time.h"
+#include "packager/hls/base/simple_hls_notifier.h"
+#include "packager/media/base/memory_tracker.h"
+#include "packager/media/file/file.h"
+#include "packager/media/file/memory_file.h"
+#include "packager/mpd/base/dash_iop_mpd_notifier.h"
+#include "packager/mpd/base/media_info.pb.h"
+#include "packager/mpd/base/mpd_options.h"
+#include "packager/mpd/base/simple_mpd_notifier.h"
+#include "packager/testing/perf/perf_test.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+const int kNumRepresentations[] = {4, 16, 64};
+const int kNumSegments[] = {100, 1000};
+
+const uint32_t kTimeScale = 90000;
+const uint64_t kSegmentDuration = 2 * kTimeScale;
+// The live window, in segments. Only the MPDs have one: the live HLS
+// playlists keep all their segments.
+const int kWindowSegments = 300;
+
+const char kMpdPath[] = "memory://manifest_perf/manifest.mpd";
+const char kHlsOutputDir[] = "memory://manifest_perf/";
+const char kMasterPlaylistName[] = "master.m3u8";
+
+enum ManifestType {
+  kSimpleMpd,
+  kDashIopMpd,
+  kHls,
+};
+
+const char* GetManifestTypeName(ManifestType type) {
+  switch (type) {
+    case kSimpleMpd:
+      return "simple_mpd";
+    case kDashIopMpd:
+      return "dash_iop_mpd";
+    case kHls:
+      return "hls";
+  }
+  return "";
+}
+
+// Returns the MediaInfo of the |index|th representation of a video ladder.
+MediaInfo CreateMediaInfo(int index) {
+  MediaInfo media_info;
+  media_info.set_bandwidth(300000 * (index + 1));
+  MediaInfo::VideoInfo* video_info = media_info.mutable_video_info();
+  video_info->set_codec("avc1.64001f");
+  video_info->set_width(256 * (index % 8 + 1));
+  video_info->set_height(144 * (index % 8 + 1));
+  video_info->set_time_scale(kTimeScale);
+  video_info->set_frame_duration(kTimeScale / 30);
+  video_info->set_pixel_width(1);
+  video_info->set_pixel_height(1);
+  media_info.set_reference_time_scale(kTimeScale);
+  media_info.set_container_type(MediaInfo::CONTAINER_MP4);
+  media_info.set_init_segment_name(base::StringPrintf("init_%d.mp4", index));
+  media_info.set_segment_template(
+      base::StringPrintf("segment_%d_$Number$.m4s", index));
+  return media_info;
+}
+
+uint64_t GetSegmentSize(const MediaInfo& media_info) {
+  return media_info.bandwidth() / 8 * kSegmentDuration / kTimeScale;
+}
+
+int64_t GetOutputSize(const std::string& file_name) {
+  std::string content;
+  return File::ReadFileToString(file_name.c_str(), &content) ? content.size()
+                                                             : 0;
+}
+
+// Drives the notifier of a scenario.
+class ManifestDriver {
+ public:
+  virtual ~ManifestDriver() {}
+
+  virtual bool AddRepresentation(const MediaInfo& media_info, uint32_t* id) = 0;
+  virtual bool AddSegment(uint32_t id,
+                          int segment_index,
+                          uint64_t start_time,
+                          uint64_t size) = 0;
+  virtual bool Flush() = 0;
+  // Returns the memory accounted for the segments of the manifests.
+  virtual uint64_t GetTrackedMemory() = 0;
+  // Returns the size of the manifests written.
+  virtual int64_t GetOutputSize() = 0;
+};
+
+class MpdDriver : public ManifestDriver {
+ public:
+  explicit MpdDriver(ManifestType type) {
+    MpdOptions mpd_options;
+    mpd_options.minimum_update_period = 2;
+    mpd_options.time_shift_buffer_depth =
+        kWindowSegments * kSegmentDuration / kTimeScale;
+    const std::vector<std::string> base_urls;
+    if (type == kSimpleMpd) {
+      notifier_.reset(new SimpleMpdNotifier(kLiveProfile, mpd_options,
+                                            base_urls, kMpdPath));
+    } else {
+      notifier_.reset(new DashIopMpdNotifier(kLiveProfile, mpd_options,
+                                             base_urls, kMpdPath));
+    }
+    CHECK(notifier_->Init());
+  }
+
+  bool AddRepresentation(const MediaInfo& media_info, uint32_t* id) override {
+    return notifier_->NotifyNewContainer(media_info, id);
+  }
+  bool AddSegment(uint32_t id,
+                  int segment_index,
+                  uint64_t start_time,
+                  uint64_t size) override {
+    return notifier_->NotifyNewSegment(id, start_time, kSegmentDuration, size);
+  }
+  bool Flush() override { return notifier_->Flush(); }
+  uint64_t GetTrackedMemory() override {
+    return MemoryTracker::GetUsage(kMpdSegmentInfoMemory);
+  }
+  int64_t GetOutputSize() override { return media::GetOutputSize(kMpdPath); }
+
+ private:
+  scoped_ptr<MpdNotifier> notifier_;
+};
+
+class HlsDriver : public ManifestDriver {
+ public:
+  HlsDriver()
+      : notifier_(hls::HlsNotifier::HlsProfile::kLiveProfile, "",
+                  kHlsOutputDir, kMasterPlaylistName) {
+    CHECK(notifier_.Init());
+  }
+
+  bool AddRepresentation(const MediaInfo& media_info, uint32_t* id) override {
+    const std::string name =
+        base::StringPrintf("stream_%d", static_cast<int>(playlists_.size()));
+    playlists_.push_back(name + ".m3u8");
+    return notifier_.NotifyNewStream(media_info, playlists_.back(), name, "",
+                                     id);
+  }
+  bool AddSegment(uint32_t id,
+                  int segment_index,
+                  uint64_t start_time,
+                  uint64_t size) override {
+    return notifier_.NotifyNewSegment(
+        id, base::StringPrintf("segment_%u_%d.m4s", id, segment_index),
+        start_time, kSegmentDuration, 0, size);
+  }
+  bool Flush() override { return notifier_.Flush(); }
+  uint64_t GetTrackedMemory() override {
+    return MemoryTracker::GetUsage(kHlsEntryMemory);
+  }
+  int64_t GetOutputSize() override {
+    int64_t size = media::GetOutputSize(std::string(kHlsOutputDir) +
+                                        kMasterPlaylistName);
+    for (const std::string& playlist : playlists_)
+      size += media::GetOutputSize(kHlsOutputDir + playlist);
+    return size;
+  }
+
+ private:
+  hls::SimpleHlsNotifier notifier_;
+  std::vector<std::string> playlists_;
+};
+
+}  // namespace
+
+class ManifestPerfTest : public ::testing::TestWithParam<ManifestType> {
+ public:
+  void TearDown() override { MemoryFile::DeleteAll(); }
+
+ protected:
+  void RunScenario(int num_representations, int num_segments) {
+    const ManifestType type = GetParam();
+    scoped_ptr<ManifestDriver> driver;
+    if (type == kHls)
+      driver.reset(new HlsDriver);
+    else
+      driver.reset(new MpdDriver(type));
+
+    std::vector<uint32_t> ids(num_representations);
+    std::vector<uint64_t> segment_sizes(num_representations);
+    for (int i = 0; i < num_representations; ++i) {
+      const MediaInfo media_info = CreateMediaInfo(i);
+      ASSERT_TRUE(driver->AddRepresentation(media_info, &ids[i]));
+      segment_sizes[i] = GetSegmentSize(media_info);
+    }
+
+    std::vector<base::TimeDelta> flush_latencies;
+    for (int segment = 0; segment < num_segments; ++segment) {
+      for (int i = 0; i < num_representations; ++i) {
+        ASSERT_TRUE(driver->AddSegment(
+            ids[i], segment, segment * kSegmentDuration, segment_sizes[i]));
+      }
+      const base::TimeTicks start = base::TimeTicks::Now();
+      ASSERT_TRUE(driver->Flush());
+      flush_latencies.push_back(base::TimeTicks::Now() - start);
+    }
+
+    // The last flushes tell the cost of the flushes once the window is full.
+    base::TimeDelta total_latency;
+    base::TimeDelta last_latency;
+    const size_t num_last = std::max<size_t>(flush_latencies.size() / 10, 1);
+    for (size_t i = 0; i < flush_latencies.size(); ++i) {
+      total_latency += flush_latencies[i];
+      if (i >= flush_latencies.size() - num_last)
+        last_latency += flush_latencies[i];
+    }
+    const base::TimeDelta max_latency =
+        *std::max_element(flush_latencies.begin(), flush_latencies.end());
+
+    const std::string trace =
+        base::StringPrintf("%s_%dx%d", GetManifestTypeName(type),
+                           num_representations, num_segments);
+    perf_test::PrintResult(
+        "manifest_flush_latency", "", trace,
+        total_latency.InMicrosecondsF() / flush_latencies.size(), "us", true);
+    perf_test::PrintResult("manifest_last_flush_latency", "", trace,
+                           last_latency.InMicrosecondsF() / num_last, "us",
+                           true);
+    perf_test::PrintResult("manifest_max_flush_latency", "", trace,
+                           max_latency.InMicrosecondsF(), "us", false);
+    perf_test::PrintResult("manifest_tracked_memory", "", trace,
+                           static_cast<size_t>(driver->GetTrackedMemory()),
+                           "bytes", true);
+    perf_test::PrintResult("manifest_size", "", trace,
+                           static_cast<size_t>(driver->GetOutputSize()),
+                           "bytes", true);
+  }
+};
+
+TEST_P(ManifestPerfTest, LiveLadders) {
+  for (int num_representations : kNumRepresentations) {
+    for (int num_segments : kNumSegments) {
+      RunScenario(num_representations, num_segments);
+      MemoryFile::DeleteAll();
+    }
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(Notifiers,
+                        ManifestPerfTest,
+                        ::testing::Values(kSimpleMpd, kDashIopMpd, kHls));
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,134 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+// Parser benchmarks. The test files are fed to each MediaParser from memory
+// in chunks of various sizes, so parsing is measured apart from file I/O and
+// muxing.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "packager/base/bind.h"
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/strings/string_number_conversions.h"
+#include "packager/base/time/time.h"
+#include "packager/media/base/media_parser.h"
+#include "packager/media/base/media_sample.h"
+#include "packager/media/base/stream_info.h"
+#include "packager/media/formats/mp2t/mp2t_media_parser.h"
+#include "packager/media/formats/mp4/mp4_media_parser.h"
+#include "packager/media/formats/webm/webm_media_parser.h"
+#include "packager/media/formats/webvtt/webvtt_media_parser.h"
+#include "packager/media/formats/wvm/wvm_media_parser.h"
+#include "packager/media/test/test_data_util.h"
+#include "packager/testing/perf/perf_test.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+// Number of bytes parsed for each measurement.
+const size_t kBytesPerRun = 64 * 1024 * 1024;
+
+// Sizes of the chunks passed to Parse(). 2MB is Demuxer's read size. 0 parses
+// the whole file at once.
+const size_t kChunkSizes[] = {4 * 1024, 64 * 1024, 2 * 1024 * 1024, 0};
+
+typedef MediaParser* (*CreateParserFunction)();
+
+template <class Parser>
+MediaParser* CreateParser() {
+  return new Parser;
+}
+
+void OnInit(const std::vector<scoped_refptr<StreamInfo> >& stream_infos) {}
+
+bool OnNewSample(size_t* num_samples,
+                 uint32_t track_id,
+                 const scoped_refptr<MediaSample>& sample) {
+  ++*num_samples;
+  return true;
+}
+
+// Reports the throughput of parsing the test file |file_name| with the
+// parsers created by |create_parser|, for each of kChunkSizes.
+void MeasureParserThroughput(const std::string& parser_name,
+                             CreateParserFunction create_parser,
+                             const std::string& file_name) {
+  const std::vector<uint8_t> data = ReadTestDataFile(file_name);
+  ASSERT_FALSE(data.empty());
+
+  const size_t num_runs = kBytesPerRun / data.size() + 1;
+  for (size_t chunk_size : kChunkSizes) {
+    if (chunk_size == 0 || chunk_size > data.size())
+      chunk_size = data.size();
+
+    size_t num_samples = 0;
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (size_t i = 0; i < num_runs; ++i) {
+      scoped_ptr<MediaParser> parser(create_parser());
+      parser->Init(base::Bind(&OnInit),
+                   base::Bind(&OnNewSample, &num_samples), NULL);
+      for (size_t offset = 0; offset < data.size(); offset += chunk_size) {
+        const size_t size = std::min(chunk_size, data.size() - offset);
+        ASSERT_TRUE(parser->Parse(data.data() + offset, size));
+      }
+      ASSERT_TRUE(parser->Flush());
+    }
+    const double seconds = (base::TimeTicks::Now() - start).InSecondsF();
+    ASSERT_GT(num_samples, 0u);
+
+    const std::string trace =
+        file_name + "_chunk_" + base::SizeTToString(chunk_size);
+    perf_test::PrintResult(parser_name, "", trace,
+                           num_runs * data.size() / seconds / (1024 * 1024),
+                           "MB/s", true);
+    perf_test::PrintResult(parser_name, "_samples", trace,
+                           num_samples / seconds, "samples/s", true);
+  }
+}
+
+}  // namespace
+
+TEST(MediaParserPerfTest, MP4) {
+  MeasureParserThroughput("mp4_media_parser",
+                          &CreateParser<mp4::MP4MediaParser>,
+                          "bear-640x360.mp4");
+  MeasureParserThroughput("mp4_media_parser",
+                          &CreateParser<mp4::MP4MediaParser>,
+                          "bear-640x360-av_frag.mp4");
+}
+
+TEST(MediaParserPerfTest, Mp2t) {
+  MeasureParserThroughput("mp2t_media_parser",
+                          &CreateParser<mp2t::Mp2tMediaParser>,
+                          "bear-640x360.ts");
+}
+
+TEST(MediaParserPerfTest, WebM) {
+  MeasureParserThroughput("webm_media_parser",
+                          &CreateParser<WebMMediaParser>,
+                          "bear-640x360.webm");
+}
+
+TEST(MediaParserPerfTest, Wvm) {
+  // Without a key source, the samples are output encrypted.
+  MeasureParserThroughput("wvm_media_parser",
+                          &CreateParser<wvm::WvmMediaParser>,
+                          "bear-640x360.wvm");
+}
+
+TEST(MediaParserPerfTest, WebVtt) {
+  MeasureParserThroughput("webvtt_media_parser",
+                          &CreateParser<WebVttMediaParser>,
+                          "subtitle-english.vtt");
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,348 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+// End-to-end packaging benchmarks. Each scenario packages a test file
+// repeatedly until a fixed amount of input has been processed, and reports
+// the throughput, the CPU time split between demuxing and muxing, and the
+// peak memory usage.
+
+#include <gtest/gtest.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "packager/base/files/file_util.h"
+#include "packager/base/memory/scoped_vector.h"
+#include "packager/base/strings/stringprintf.h"
+#include "packager/base/time/clock.h"
+#include "packager/base/time/time.h"
+#include "packager/media/base/demuxer.h"
+#include "packager/media/base/fixed_key_source.h"
+#include "packager/media/base/fourccs.h"
+#include "packager/media/base/media_stream.h"
+#include "packager/media/base/muxer.h"
+#include "packager/media/base/test/status_test_util.h"
+#include "packager/media/event/mpd_notify_muxer_listener.h"
+#include "packager/media/formats/mp2t/ts_muxer.h"
+#include "packager/media/formats/mp4/mp4_muxer.h"
+#include "packager/media/formats/webm/webm_muxer.h"
+#include "packager/media/test/test_data_util.h"
+#include "packager/mpd/base/mpd_options.h"
+#include "packager/mpd/base/simple_mpd_notifier.h"
+#include "packager/testing/perf/perf_test.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+// Amount of input packaged by each scenario. The test files are small, so
+// they are packaged many times over.
+const int64_t kBytesPerScenario = 64 * 1024 * 1024;
+
+// Muxer options.
+const double kSegmentDurationInSeconds = 1.0;
+const double kFragmentDurationInSeconds = 0.1;
+const int kNumSubsegmentsPerSidx = 2;
+
+// Encryption constants.
+const char kKeyIdHex[] = "e5007e6e9dcd5ac095202ed3758382cd";
+const char kKeyHex[] = "6fc96fe628a265b13aeddec0bc421f4d";
+const uint32_t kMaxSdPixels = 768 * 576;
+const double kClearLeadInSeconds = 0;
+const double kCryptoDurationInSeconds = 0;  // Key rotation is disabled.
+
+enum OutputFormat {
+  kMp4Output,
+  kTsOutput,
+  kWebMOutput,
+};
+
+struct Scenario {
+  // Name used as the trace of the results.
+  const char* name;
+  OutputFormat output_format;
+  // FOURCC_NULL for clear output.
+  FourCC protection_scheme;
+  // Decrypt the input, which is encrypted with kKeyHex.
+  bool decrypt_input;
+  // Output live profile segments and update a live MPD after each segment.
+  bool live_mpd;
+};
+
+const double kBytesPerMB = 1024 * 1024;
+
+// Returns the CPU time, user and system, consumed by the process so far.
+double GetCpuSeconds() {
+  struct rusage usage;
+  CHECK_EQ(0, getrusage(RUSAGE_SELF, &usage));
+  return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+         usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+// Returns the peak resident set size of the process so far, in MB.
+double GetPeakRssMB() {
+  struct rusage usage;
+  CHECK_EQ(0, getrusage(RUSAGE_SELF, &usage));
+#if defined(OS_MACOSX)
+  return usage.ru_maxrss / kBytesPerMB;
+#else
+  return usage.ru_maxrss / 1024.0;
+#endif
+}
+
+class FakeClock : public base::Clock {
+ public:
+  // Fake the clock to return NULL time.
+  base::Time Now() override { return base::Time(); }
+};
+
+// A Muxer which only counts the samples it receives, so that demuxing can be
+// measured on its own.
+class CountingMuxer : public Muxer {
+ public:
+  explicit CountingMuxer(uint64_t* num_samples)
+      : Muxer(MuxerOptions()), num_samples_(num_samples) {}
+  ~CountingMuxer() override {}
+
+ private:
+  // Muxer implementation overrides.
+  Status Initialize() override { return Status::OK; }
+  Status Finalize() override { return Status::OK; }
+  Status DoAddSample(const MediaStream* stream,
+                     scoped_refptr<MediaSample> sample) override {
+    ++*num_samples_;
+    return Status::OK;
+  }
+
+  uint64_t* num_samples_;
+
+  DISALLOW_COPY_AND_ASSIGN(CountingMuxer);
+};
+
+}  // namespace
+
+class PackagerPerfTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    ASSERT_TRUE(base::CreateNewTempDirectory("packager_perf_",
+                                             &test_directory_));
+  }
+
+  void TearDown() override { base::DeleteFile(test_directory_, true); }
+
+ protected:
+  std::string GetFullPath(const std::string& file_name) {
+    return test_directory_.AppendASCII(file_name).value();
+  }
+
+  // Packages |input_file| once with |scenario|. Only demuxes it if
+  // |demux_only| is true, counting the samples in |num_samples|.
+  void Package(const Scenario& scenario,
+               const std::string& input_file,
+               bool demux_only,
+               uint64_t* num_samples);
+
+  // Packages |input_file| with |scenario| until kBytesPerScenario of input
+  // have been processed, and reports the results.
+  void Measure(const Scenario& scenario, const std::string& input_file);
+
+  // Encrypts the first stream of the test file |file_name| with 'cenc' for
+  // the decryption scenarios.
+  // @return the path of the encrypted file.
+  std::string PrepareEncryptedInput(const std::string& file_name);
+
+ private:
+  MuxerOptions SetupOptions(const Scenario& scenario, size_t stream_index);
+
+  base::FilePath test_directory_;
+  FakeClock fake_clock_;
+};
+
+MuxerOptions PackagerPerfTest::SetupOptions(const Scenario& scenario,
+                                            size_t stream_index) {
+  std::string extension = "mp4";
+  std::string segment_extension = "m4s";
+  if (scenario.output_format == kTsOutput)
+    extension = segment_extension = "ts";
+  else if (scenario.output_format == kWebMOutput)
+    extension = segment_extension = "webm";
+
+  MuxerOptions options;
+  // TS output is always segmented.
+  options.single_segment =
+      !scenario.live_mpd && scenario.output_format != kTsOutput;
+  options.segment_duration = kSegmentDurationInSeconds;
+  options.fragment_duration = kFragmentDurationInSeconds;
+  options.segment_sap_aligned = true;
+  options.fragment_sap_aligned = true;
+  options.num_subsegments_per_sidx = kNumSubsegmentsPerSidx;
+  options.output_file_name = GetFullPath(base::StringPrintf(
+      "stream%d.%s", static_cast<int>(stream_index), extension.c_str()));
+  if (!options.single_segment) {
+    options.segment_template = GetFullPath(
+        base::StringPrintf("stream%d-$Number$.%s",
+                           static_cast<int>(stream_index),
+                           segment_extension.c_str()));
+  }
+  options.temp_dir = test_directory_.value();
+  return options;
+}
+
+void PackagerPerfTest::Package(const Scenario& scenario,
+                               const std::string& input_file,
+                               bool demux_only,
+                               uint64_t* num_samples) {
+  Demuxer demuxer(input_file);
+  if (scenario.decrypt_input) {
+    scoped_ptr<KeySource> decryption_key_source(
+        FixedKeySource::CreateFromHexStrings(kKeyIdHex, kKeyHex, "", ""));
+    ASSERT_TRUE(decryption_key_source);
+    demuxer.SetKeySource(decryption_key_source.Pass());
+  }
+  ASSERT_OK(demuxer.Initialize());
+
+  scoped_ptr<KeySource> encryption_key_source(
+      FixedKeySource::CreateFromHexStrings(kKeyIdHex, kKeyHex, "", ""));
+  ASSERT_TRUE(encryption_key_source);
+
+  scoped_ptr<MpdNotifier> mpd_notifier;
+  if (scenario.live_mpd && !demux_only) {
+    MpdOptions mpd_options;
+    mpd_notifier.reset(new SimpleMpdNotifier(kLiveProfile, mpd_options,
+                                             std::vector<std::string>(),
+                                             GetFullPath("output.mpd")));
+    ASSERT_TRUE(mpd_notifier->Init());
+  }
+
+  ScopedVector<Muxer> muxers;
+  const std::vector<MediaStream*>& streams = demuxer.streams();
+  for (size_t i = 0; i < streams.size(); ++i) {
+    scoped_ptr<Muxer> muxer;
+    if (demux_only) {
+      muxer.reset(new CountingMuxer(num_samples));
+    } else if (scenario.output_format == kTsOutput) {
+      muxer.reset(new mp2t::TsMuxer(SetupOptions(scenario, i)));
+    } else if (scenario.output_format == kWebMOutput) {
+      muxer.reset(new webm::WebMMuxer(SetupOptions(scenario, i)));
+    } else {
+      muxer.reset(new mp4::MP4Muxer(SetupOptions(scenario, i)));
+    }
+    muxer->set_clock(&fake_clock_);
+    muxer->AddStream(streams[i]);
+    if (!demux_only && scenario.protection_scheme != FOURCC_NULL) {
+      muxer->SetKeySource(encryption_key_source.get(), kMaxSdPixels,
+                          kClearLeadInSeconds, kCryptoDurationInSeconds,
+                          scenario.protection_scheme);
+    }
+    if (mpd_notifier) {
+      muxer->SetMuxerListener(scoped_ptr<MuxerListener>(
+          new MpdNotifyMuxerListener(mpd_notifier.get())));
+    }
+    muxers.push_back(muxer.release());
+  }
+
+  ASSERT_OK(demuxer.Run());
+}
+
+void PackagerPerfTest::Measure(const Scenario& scenario,
+                               const std::string& input_file) {
+  int64_t input_size = 0;
+  ASSERT_TRUE(base::GetFileSize(base::FilePath(input_file), &input_size));
+  ASSERT_GT(input_size, 0);
+  const int64_t num_runs = kBytesPerScenario / input_size + 1;
+
+  // Demuxing on its own, to split the CPU time between the stages.
+  uint64_t num_samples = 0;
+  double start_cpu_seconds = GetCpuSeconds();
+  for (int64_t i = 0; i < num_runs; ++i) {
+    ASSERT_NO_FATAL_FAILURE(
+        Package(scenario, input_file, true, &num_samples));
+  }
+  const double demux_cpu_seconds = GetCpuSeconds() - start_cpu_seconds;
+  ASSERT_GT(num_samples, 0u);
+
+  start_cpu_seconds = GetCpuSeconds();
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int64_t i = 0; i < num_runs; ++i)
+    ASSERT_NO_FATAL_FAILURE(Package(scenario, input_file, false, NULL));
+  const double seconds = (base::TimeTicks::Now() - start).InSecondsF();
+  const double cpu_seconds = GetCpuSeconds() - start_cpu_seconds;
+
+  perf_test::PrintResult("packager_throughput", "", scenario.name,
+                         num_runs * input_size / seconds / kBytesPerMB,
+                         "MB/s", true);
+  perf_test::PrintResult("packager_samples", "", scenario.name,
+                         num_samples / seconds, "samples/s", true);
+  perf_test::PrintResult("packager_cpu", "_demux", scenario.name,
+                         demux_cpu_seconds, "s", false);
+  perf_test::PrintResult("packager_cpu", "_mux", scenario.name,
+                         std::max(0.0, cpu_seconds - demux_cpu_seconds), "s",
+                         false);
+  // The peak is the high-water mark of the whole process, i.e. of the most
+  // demanding scenario run so far.
+  perf_test::PrintResult("packager_peak_rss", "", scenario.name,
+                         GetPeakRssMB(), "MB", false);
+}
+
+std::string PackagerPerfTest::PrepareEncryptedInput(
+    const std::string& file_name) {
+  const Scenario kEncrypt = {"prepare", kMp4Output, FOURCC_cenc, false, false};
+  Package(kEncrypt, GetTestDataFilePath(file_name).value(), false, NULL);
+  // Move the output out of the way of the measured scenario.
+  const base::FilePath encrypted_file = test_directory_.AppendASCII("input");
+  EXPECT_TRUE(
+      base::Move(base::FilePath(GetFullPath("stream0.mp4")), encrypted_file));
+  return encrypted_file.value();
+}
+
+TEST_F(PackagerPerfTest, Mp4ToFragmentedMp4) {
+  const Scenario kScenario = {"mp4_to_fmp4", kMp4Output, FOURCC_NULL, false,
+                              false};
+  Measure(kScenario, GetTestDataFilePath("bear-640x360.mp4").value());
+}
+
+TEST_F(PackagerPerfTest, TsToHlsTs) {
+  const Scenario kScenario = {"ts_to_hls_ts", kTsOutput, FOURCC_NULL, false,
+                              false};
+  Measure(kScenario, GetTestDataFilePath("bear-640x360.ts").value());
+}
+
+TEST_F(PackagerPerfTest, WebMToWebM) {
+  const Scenario kScenario = {"webm_to_webm", kWebMOutput, FOURCC_NULL, false,
+                              false};
+  Measure(kScenario, GetTestDataFilePath("bear-640x360.webm").value());
+}
+
+TEST_F(PackagerPerfTest, EncryptCenc) {
+  const Scenario kScenario = {"encrypt_cenc", kMp4Output, FOURCC_cenc, false,
+                              false};
+  Measure(kScenario, GetTestDataFilePath("bear-640x360.mp4").value());
+}
+
+TEST_F(PackagerPerfTest, EncryptCbcs) {
+  const Scenario kScenario = {"encrypt_cbcs", kMp4Output, FOURCC_cbcs, false,
+                              false};
+  Measure(kScenario, GetTestDataFilePath("bear-640x360.mp4").value());
+}
+
+TEST_F(PackagerPerfTest, Decrypt) {
+  const std::string input_file = PrepareEncryptedInput("bear-640x360.mp4");
+  ASSERT_FALSE(HasFailure());
+  const Scenario kScenario = {"decrypt", kMp4Output, FOURCC_NULL, true,
+                              false};
+  Measure(kScenario, input_file);
+}
+
+TEST_F(PackagerPerfTest, LiveMpdUpdates) {
+  const Scenario kScenario = {"live_mpd", kMp4Output, FOURCC_NULL, false,
+                              true};
+  Measure(kScenario, GetTestDataFilePath("bear-640x360.mp4").value());
+}
+
+}  // namespace media
+}  // namespace edash_packager
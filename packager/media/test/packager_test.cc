@@ -6,7 +6,9 @@
 
 #include <gtest/gtest.h>
 
+#include "packager/app/packager_util.h"
 #include "packager/base/files/file_util.h"
+#include "packager/base/stl_util.h"
 #include "packager/base/strings/string_number_conversions.h"
 #include "packager/base/strings/stringprintf.h"
 #include "packager/base/time/clock.h"
@@ -17,6 +19,7 @@
 #include "packager/media/base/muxer.h"
 #include "packager/media/base/stream_info.h"
 #include "packager/media/base/test/status_test_util.h"
+#include "packager/media/event/muxer_listener.h"
 #include "packager/media/formats/mp4/mp4_muxer.h"
 #include "packager/media/test/test_data_util.h"
 
@@ -40,6 +43,7 @@ const char kOutputVideo[] = "output_video";
 const char kOutputVideo2[] = "output_video_2";
 const char kOutputAudio[] = "output_audio";
 const char kOutputAudio2[] = "output_audio_2";
+const char kOutputAudioVideo[] = "output_audio_video";
 const char kOutputNone[] = "";
 
 const char kSegmentTemplate[] = "template$Number$.m4s";
@@ -73,6 +77,126 @@ MediaStream* FindFirstAudioStream(const std::vector<MediaStream*>& streams) {
   return FindFirstStreamOfType(streams, kStreamAudio);
 }
 
+// Records the chunks and the segments reported by a muxer.
+class ChunkRecordingMuxerListener : public MuxerListener {
+ public:
+  struct Chunk {
+    std::string segment_name;
+    uint64_t start_time;
+    uint64_t duration;
+    uint64_t size;
+  };
+  struct Segment {
+    std::string name;
+    uint64_t start_time;
+    uint64_t duration;
+    uint64_t file_size;
+    // The chunks of the segment, reported before it.
+    std::vector<Chunk> chunks;
+  };
+
+  ChunkRecordingMuxerListener() {}
+  ~ChunkRecordingMuxerListener() override {}
+
+  void OnEncryptionInfoReady(
+      bool is_initial_encryption_info,
+      FourCC protection_scheme,
+      const std::vector<uint8_t>& key_id,
+      const std::vector<uint8_t>& iv,
+      const std::vector<ProtectionSystemSpecificInfo>& key_system_info)
+      override {}
+  void OnMediaStart(const MuxerOptions& muxer_options,
+                    const StreamInfo& stream_info,
+                    uint32_t time_scale,
+                    ContainerType container_type) override {}
+  void OnSampleDurationReady(uint32_t sample_duration) override {}
+  void OnMediaEnd(bool has_init_range,
+                  uint64_t init_range_start,
+                  uint64_t init_range_end,
+                  bool has_index_range,
+                  uint64_t index_range_start,
+                  uint64_t index_range_end,
+                  float duration_seconds,
+                  uint64_t file_size) override {}
+  void OnNewSegment(const std::string& segment_name,
+                    uint64_t start_time,
+                    uint64_t duration,
+                    uint64_t segment_file_size,
+                    const std::string& checksum) override {
+    Segment segment;
+    segment.name = segment_name;
+    segment.start_time = start_time;
+    segment.duration = duration;
+    segment.file_size = segment_file_size;
+    segment.chunks.swap(pending_chunks_);
+    segments_.push_back(segment);
+  }
+  void OnNewChunk(const std::string& segment_name,
+                  uint64_t start_time,
+                  uint64_t duration,
+                  uint64_t chunk_size) override {
+    Chunk chunk = {segment_name, start_time, duration, chunk_size};
+    pending_chunks_.push_back(chunk);
+  }
+  void OnKeyFrame(uint64_t timestamp,
+                  uint64_t start_byte_offset,
+                  uint64_t size) override {}
+
+  const std::vector<Segment>& segments() const { return segments_; }
+  // Chunks not followed by their segment.
+  const std::vector<Chunk>& pending_chunks() const { return pending_chunks_; }
+
+ private:
+  std::vector<Segment> segments_;
+  std::vector<Chunk> pending_chunks_;
+
+  DISALLOW_COPY_AND_ASSIGN(ChunkRecordingMuxerListener);
+};
+
+// Checks that the segments, numbered from 1, have a contiguous timeline, and
+// that their chunks each start with a 'moof' and tile them.
+void CheckChunkedSegments(
+    const std::vector<ChunkRecordingMuxerListener::Segment>& segments) {
+  for (size_t i = 0; i < segments.size(); ++i) {
+    const ChunkRecordingMuxerListener::Segment& segment = segments[i];
+    SCOPED_TRACE(segment.name);
+    // The segment timeline has no gaps or overlaps.
+    if (i > 0) {
+      EXPECT_EQ(segments[i - 1].start_time + segments[i - 1].duration,
+                segment.start_time);
+    }
+    EXPECT_EQ(base::StringPrintf(kSegmentTemplateOutputPattern,
+                                 static_cast<int>(i + 1)),
+              base::FilePath(segment.name).BaseName().value());
+
+    std::string contents;
+    ASSERT_TRUE(base::ReadFileToString(base::FilePath(segment.name),
+                                       &contents));
+    EXPECT_EQ(segment.file_size, contents.size());
+
+    ASSERT_FALSE(segment.chunks.empty());
+
+    uint64_t chunk_time = segment.start_time;
+    uint64_t chunk_offset = 0;
+    for (const ChunkRecordingMuxerListener::Chunk& chunk : segment.chunks) {
+      EXPECT_EQ(segment.name, chunk.segment_name);
+      EXPECT_EQ(chunk_time, chunk.start_time);
+      ASSERT_GT(chunk.size, 8u);
+      ASSERT_LE(chunk_offset + chunk.size, contents.size());
+      // The first chunk may start with the styp box of the segment.
+      const std::string box_type = contents.substr(chunk_offset + 4, 4);
+      if (chunk_offset == 0)
+        EXPECT_TRUE(box_type == "styp" || box_type == "moof") << box_type;
+      else
+        EXPECT_EQ("moof", box_type);
+      chunk_time += chunk.duration;
+      chunk_offset += chunk.size;
+    }
+    EXPECT_EQ(segment.start_time + segment.duration, chunk_time);
+    EXPECT_EQ(segment.file_size, chunk_offset);
+  }
+}
+
 }  // namespace
 
 class FakeClock : public base::Clock {
@@ -83,7 +207,7 @@ class FakeClock : public base::Clock {
 
 class PackagerTestBasic : public ::testing::TestWithParam<const char*> {
  public:
-  PackagerTestBasic() {}
+  PackagerTestBasic() : single_segment_in_place_(false) {}
 
   void SetUp() override {
     // Create a test directory for testing, will be deleted after test.
@@ -112,9 +236,14 @@ class PackagerTestBasic : public ::testing::TestWithParam<const char*> {
                const std::string& video_output,
                const std::string& audio_output);
 
+  // Remuxes the video of an input split in chunks, whose file names are
+  // full paths.
+  void RemuxChunks(const std::string& input, const std::string& video_output);
+
  protected:
   base::FilePath test_directory_;
   FakeClock fake_clock_;
+  bool single_segment_in_place_;
 };
 
 std::string PackagerTestBasic::GetFullPath(const std::string& file_name) {
@@ -141,6 +270,7 @@ MuxerOptions PackagerTestBasic::SetupOptions(const std::string& output,
   options.output_file_name = GetFullPath(output);
   options.segment_template = GetFullPath(kSegmentTemplate);
   options.temp_dir = test_directory_.value();
+  options.single_segment_in_place = single_segment_in_place_;
   return options;
 }
 
@@ -236,6 +366,21 @@ void PackagerTestBasic::Decrypt(const std::string& input,
   ASSERT_OK(demuxer.Run());
 }
 
+void PackagerTestBasic::RemuxChunks(const std::string& input,
+                                    const std::string& video_output) {
+  Demuxer demuxer(input);
+  ASSERT_OK(demuxer.Initialize());
+
+  scoped_ptr<Muxer> muxer(
+      new mp4::MP4Muxer(SetupOptions(video_output, kSingleSegment)));
+  muxer->set_clock(&fake_clock_);
+  MediaStream* stream = FindFirstVideoStream(demuxer.streams());
+  ASSERT_TRUE(stream != NULL);
+  muxer->AddStream(stream);
+
+  ASSERT_OK(demuxer.Run());
+}
+
 TEST_P(PackagerTestBasic, MP4MuxerSingleSegmentUnencryptedVideo) {
   ASSERT_NO_FATAL_FAILURE(Remux(GetParam(),
                                 kOutputVideo,
@@ -280,6 +425,25 @@ TEST_P(PackagerTestBasic, MP4MuxerSingleSegmentEncryptedAudio) {
                                   kOutputAudio2));
 }
 
+TEST_P(PackagerTestBasic, MP4MuxerSingleSegmentInPlace) {
+  single_segment_in_place_ = true;
+  ASSERT_NO_FATAL_FAILURE(Remux(GetParam(),
+                                kOutputVideo,
+                                kOutputNone,
+                                kSingleSegment,
+                                kEnableEncryption,
+                                kNoLanguageOverride));
+
+  Demuxer demuxer(GetFullPath(kOutputVideo));
+  ASSERT_OK(demuxer.Initialize());
+  ASSERT_TRUE(FindFirstVideoStream(demuxer.streams()) != NULL);
+
+  single_segment_in_place_ = false;
+  ASSERT_NO_FATAL_FAILURE(Decrypt(kOutputVideo,
+                                  kOutputVideo2,
+                                  kOutputNone));
+}
+
 TEST_P(PackagerTestBasic, MP4MuxerLanguageWithoutSubtag) {
   ASSERT_NO_FATAL_FAILURE(Remux(GetParam(),
                                 kOutputNone,
@@ -310,6 +474,101 @@ TEST_P(PackagerTestBasic, MP4MuxerLanguageWithSubtag) {
   ASSERT_EQ("por", stream->info()->language());
 }
 
+// Two stream descriptors, with different lang= overrides, on the same input
+// track, plus a third one without override. The descriptors after the first
+// one are fed by fan-out streams.
+TEST_P(PackagerTestBasic, MP4MuxerFanOutLanguageOverrides) {
+  const char kOutputAudio3[] = "output_audio_3";
+
+  Demuxer demuxer(GetFullPath(GetParam()));
+  ASSERT_OK(demuxer.Initialize());
+  MediaStream* input_stream = FindFirstAudioStream(demuxer.streams());
+  ASSERT_TRUE(input_stream != NULL);
+  const std::string input_language = input_stream->info()->language();
+
+  const char* kOutputs[] = {kOutputAudio, kOutputAudio2, kOutputAudio3};
+  const char* kLanguages[] = {"por", "fre", ""};
+  std::vector<Muxer*> muxers;
+  STLElementDeleter<std::vector<Muxer*> > muxers_deleter(&muxers);
+  for (size_t i = 0; i < arraysize(kOutputs); ++i) {
+    muxers.push_back(
+        new mp4::MP4Muxer(SetupOptions(kOutputs[i], kSingleSegment)));
+    muxers.back()->set_clock(&fake_clock_);
+    ASSERT_TRUE(AddStreamToMuxer(demuxer.streams(), "audio", kLanguages[i],
+                                 muxers.back()));
+  }
+  EXPECT_EQ("por", muxers[0]->streams()[0]->info()->language());
+  EXPECT_EQ("fre", muxers[1]->streams()[0]->info()->language());
+  EXPECT_EQ(input_language, muxers[2]->streams()[0]->info()->language());
+  EXPECT_EQ(input_language, input_stream->demuxed_info()->language());
+  ASSERT_OK(demuxer.Run());
+
+  // The language of the output without override is written as "und" if the
+  // input has none, so only the overridden ones are checked.
+  const char* kExpectedLanguages[] = {"por", "fre"};
+  for (size_t i = 0; i < arraysize(kExpectedLanguages); ++i) {
+    Demuxer output_demuxer(GetFullPath(kOutputs[i]));
+    ASSERT_OK(output_demuxer.Initialize());
+    MediaStream* stream = FindFirstAudioStream(output_demuxer.streams());
+    ASSERT_TRUE(stream != NULL);
+    EXPECT_EQ(kExpectedLanguages[i], stream->info()->language()) << i;
+  }
+}
+
+// Every fragment is written as a chunk of its segment. The chunks must tile
+// their segment, in time and in bytes, and each one must start with a box
+// a player can start parsing at.
+TEST_P(PackagerTestBasic, MP4MuxerLowLatencyChunkedOutput) {
+  Demuxer demuxer(GetFullPath(GetParam()));
+  ASSERT_OK(demuxer.Initialize());
+
+  MuxerOptions options = SetupOptions(kOutputAudio, kMultipleSegments);
+  options.low_latency_chunked_output = true;
+  scoped_ptr<Muxer> muxer(new mp4::MP4Muxer(options));
+  muxer->set_clock(&fake_clock_);
+  ChunkRecordingMuxerListener* listener = new ChunkRecordingMuxerListener;
+  muxer->SetMuxerListener(scoped_ptr<MuxerListener>(listener));
+  MediaStream* stream = FindFirstAudioStream(demuxer.streams());
+  ASSERT_TRUE(stream != NULL);
+  muxer->AddStream(stream);
+  ASSERT_OK(demuxer.Run());
+
+  const std::vector<ChunkRecordingMuxerListener::Segment>& segments =
+      listener->segments();
+  ASSERT_GT(segments.size(), 1u);
+  EXPECT_TRUE(listener->pending_chunks().empty());
+
+  ASSERT_NO_FATAL_FAILURE(CheckChunkedSegments(segments));
+  // Fragments of 0.1 second in segments of 1 second.
+  for (size_t i = 0; i + 1 < segments.size(); ++i)
+    EXPECT_GT(segments[i].chunks.size(), 1u) << segments[i].name;
+}
+
+// The audio and the video in a single output have a single timeline, the one
+// of the video, which leads the fragments of both tracks.
+TEST_P(PackagerTestBasic, MP4MuxerLowLatencyChunkedAudioVideo) {
+  Demuxer demuxer(GetFullPath(GetParam()));
+  ASSERT_OK(demuxer.Initialize());
+
+  MuxerOptions options = SetupOptions(kOutputAudioVideo, kMultipleSegments);
+  options.low_latency_chunked_output = true;
+  scoped_ptr<Muxer> muxer(new mp4::MP4Muxer(options));
+  muxer->set_clock(&fake_clock_);
+  ChunkRecordingMuxerListener* listener = new ChunkRecordingMuxerListener;
+  muxer->SetMuxerListener(scoped_ptr<MuxerListener>(listener));
+  MediaStream* video_stream = FindFirstVideoStream(demuxer.streams());
+  MediaStream* audio_stream = FindFirstAudioStream(demuxer.streams());
+  ASSERT_TRUE(video_stream != NULL);
+  ASSERT_TRUE(audio_stream != NULL);
+  muxer->AddStream(video_stream);
+  muxer->AddStream(audio_stream);
+  ASSERT_OK(demuxer.Run());
+
+  ASSERT_GT(listener->segments().size(), 1u);
+  EXPECT_TRUE(listener->pending_chunks().empty());
+  ASSERT_NO_FATAL_FAILURE(CheckChunkedSegments(listener->segments()));
+}
+
 class PackagerTest : public PackagerTestBasic {
  public:
   void SetUp() override {
@@ -368,6 +627,35 @@ TEST_P(PackagerTest, MP4MuxerSingleSegmentUnencryptedSeparateAudioVideo) {
   EXPECT_TRUE(ContentsEqual(kOutputAudio, kOutputAudio2));
 }
 
+TEST_P(PackagerTest, MP4MuxerSingleSegmentUnencryptedAudioVideo) {
+  // Mux the audio and the video into a single output.
+  {
+    Demuxer demuxer(GetFullPath(GetParam()));
+    ASSERT_OK(demuxer.Initialize());
+    scoped_ptr<Muxer> muxer(
+        new mp4::MP4Muxer(SetupOptions(kOutputAudioVideo, kSingleSegment)));
+    muxer->set_clock(&fake_clock_);
+    MediaStream* video_stream = FindFirstVideoStream(demuxer.streams());
+    MediaStream* audio_stream = FindFirstAudioStream(demuxer.streams());
+    ASSERT_TRUE(video_stream != NULL);
+    ASSERT_TRUE(audio_stream != NULL);
+    muxer->AddStream(video_stream);
+    muxer->AddStream(audio_stream);
+    ASSERT_OK(demuxer.Run());
+  }
+
+  // Each track has all its samples, in order, with their timing: split back,
+  // the tracks match the outputs of the tracks muxed on their own.
+  ASSERT_NO_FATAL_FAILURE(Remux(kOutputAudioVideo,
+                                kOutputVideo2,
+                                kOutputAudio2,
+                                kSingleSegment,
+                                kDisableEncryption,
+                                kNoLanguageOverride));
+  EXPECT_TRUE(ContentsEqual(kOutputVideo, kOutputVideo2));
+  EXPECT_TRUE(ContentsEqual(kOutputAudio, kOutputAudio2));
+}
+
 TEST_P(PackagerTest, MP4MuxerMultiSegmentsUnencryptedVideo) {
   ASSERT_NO_FATAL_FAILURE(Remux(GetParam(),
                                 kOutputVideo2,
@@ -413,6 +701,64 @@ TEST_P(PackagerTest, MP4MuxerMultiSegmentsUnencryptedVideo) {
   EXPECT_TRUE(ContentsEqual(kOutputVideo, kOutputVideo2));
 }
 
+TEST_P(PackagerTest, MP4MuxerChunkedInput) {
+  // The chunks restart at the same timestamps, so the second one is shifted
+  // to the end of the first one.
+  const std::string input = GetFullPath(kOutputVideo) + kInputChunkSeparator +
+                            GetFullPath(kOutputVideo);
+  ASSERT_NO_FATAL_FAILURE(RemuxChunks(input, kOutputVideo2));
+
+  Demuxer demuxer(GetFullPath(kOutputVideo));
+  ASSERT_OK(demuxer.Initialize());
+  Demuxer chunked_demuxer(GetFullPath(kOutputVideo2));
+  ASSERT_OK(chunked_demuxer.Initialize());
+  const MediaStream* stream = FindFirstVideoStream(demuxer.streams());
+  const MediaStream* chunked_stream =
+      FindFirstVideoStream(chunked_demuxer.streams());
+  EXPECT_EQ(2 * stream->info()->duration(), chunked_stream->info()->duration());
+}
+
+TEST_P(PackagerTest, MP4MuxerChunkedInputPattern) {
+  // The chunks end at the first missing chunk.
+  ASSERT_TRUE(base::CopyFile(test_directory_.AppendASCII(kOutputVideo),
+                             test_directory_.AppendASCII("chunk1")));
+  ASSERT_TRUE(base::CopyFile(test_directory_.AppendASCII(kOutputVideo),
+                             test_directory_.AppendASCII("chunk2")));
+  ASSERT_NO_FATAL_FAILURE(
+      RemuxChunks(GetFullPath("chunk$Number$"), kOutputVideo2));
+
+  const std::string input = GetFullPath(kOutputVideo) + kInputChunkSeparator +
+                            GetFullPath(kOutputVideo);
+  const char kOutputVideo3[] = "output_video_3";
+  ASSERT_NO_FATAL_FAILURE(RemuxChunks(input, kOutputVideo3));
+  EXPECT_TRUE(ContentsEqual(kOutputVideo2, kOutputVideo3));
+}
+
+TEST_P(PackagerTest, MP4MuxerResetDemuxer) {
+  // A demuxer reset after demuxing an input demuxes the next input as a new
+  // demuxer would.
+  Demuxer demuxer(GetFullPath(GetParam()));
+  ASSERT_OK(demuxer.Initialize());
+  {
+    scoped_ptr<Muxer> muxer(
+        new mp4::MP4Muxer(SetupOptions(kOutputVideo2, kSingleSegment)));
+    muxer->set_clock(&fake_clock_);
+    muxer->AddStream(FindFirstVideoStream(demuxer.streams()));
+    ASSERT_OK(demuxer.Run());
+  }
+
+  demuxer.Reset(GetFullPath(kOutputVideo));
+  ASSERT_OK(demuxer.Initialize());
+  scoped_ptr<Muxer> muxer(
+      new mp4::MP4Muxer(SetupOptions(kOutputVideo2, kSingleSegment)));
+  muxer->set_clock(&fake_clock_);
+  MediaStream* stream = FindFirstVideoStream(demuxer.streams());
+  ASSERT_TRUE(stream != NULL);
+  muxer->AddStream(stream);
+  ASSERT_OK(demuxer.Run());
+  EXPECT_TRUE(ContentsEqual(kOutputVideo, kOutputVideo2));
+}
+
 INSTANTIATE_TEST_CASE_P(PackagerEndToEnd,
                         PackagerTestBasic,
                         ValuesIn(kMediaFiles));
@@ -14,15 +14,33 @@
 const int BandwidthEstimator::kUseAllBlocks = 0;
 
 BandwidthEstimator::BandwidthEstimator(int num_blocks)
+    : BandwidthEstimator(num_blocks, kUseAllBlocks) {}
+
+BandwidthEstimator::BandwidthEstimator(int num_blocks, size_t num_max_blocks)
     : num_blocks_for_estimation_(num_blocks),
       harmonic_mean_denominator_(0.0),
-      num_blocks_added_(0) {}
+      num_blocks_added_(0),
+      num_max_blocks_(num_max_blocks),
+      block_index_(0) {}
 BandwidthEstimator::~BandwidthEstimator() {}
 
 void BandwidthEstimator::AddBlock(uint64_t size, double duration) {
   DCHECK_GT(duration, 0.0);
   DCHECK_GT(size, 0u);
 
+  const int kBitsInByte = 8;
+  const double bits_per_second = kBitsInByte * size / duration;
+  while (!max_candidates_.empty() &&
+         max_candidates_.back().second <= bits_per_second) {
+    max_candidates_.pop_back();
+  }
+  max_candidates_.push_back(std::make_pair(block_index_, bits_per_second));
+  ++block_index_;
+  if (num_max_blocks_ != 0 &&
+      max_candidates_.front().first + num_max_blocks_ < block_index_) {
+    max_candidates_.pop_front();
+  }
+
   if (num_blocks_for_estimation_ < 0 &&
       static_cast<int>(history_.size()) >= -1 * num_blocks_for_estimation_) {
     // Short circuiting the case where |num_blocks_for_estimation_| number of
@@ -30,7 +48,6 @@ void BandwidthEstimator::AddBlock(uint64_t size, double duration) {
     return;
   }
 
-  const int kBitsInByte = 8;
   const double bits_per_second_reciprocal = duration / (kBitsInByte * size);
   harmonic_mean_denominator_ += bits_per_second_reciprocal;
   if (num_blocks_for_estimation_ == kUseAllBlocks) {
@@ -61,3 +78,9 @@ uint64_t BandwidthEstimator::Estimate() const {
                                   : history_.size();
   return static_cast<uint64_t>(ceil(num_blocks / harmonic_mean_denominator_));
 }
+
+uint64_t BandwidthEstimator::Max() const {
+  if (max_candidates_.empty())
+    return 0;
+  return static_cast<uint64_t>(ceil(max_candidates_.front().second));
+}
@@ -10,13 +10,19 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <deque>
 #include <list>
+#include <utility>
 
 class BandwidthEstimator {
  public:
   /// @param num_blocks is the number of latest blocks to use. Negative values
   ///        use first N blocks. 0 uses all.
   explicit BandwidthEstimator(int num_blocks);
+  /// @param num_blocks is as above.
+  /// @param num_max_blocks is the number of latest blocks used by Max(). 0
+  ///        uses all.
+  BandwidthEstimator(int num_blocks, size_t num_max_blocks);
   ~BandwidthEstimator();
 
   // @param size is the size of the block in bytes. Should be positive.
@@ -28,6 +34,12 @@ class BandwidthEstimator {
   //         rounded up to the nearest integer.
   uint64_t Estimate() const;
 
+  // @return The highest bandwidth of a block, in bits per second, among the
+  //         number of latest blocks specified in the constructor. The value
+  //         is rounded up to the nearest integer. This is updated in
+  //         amortized constant time and memory bounded by the window.
+  uint64_t Max() const;
+
   static const int kUseAllBlocks;
 
  private:
@@ -38,6 +50,15 @@ class BandwidthEstimator {
   // always be 0 if num_blocks_for_estimation_ != 0.
   size_t num_blocks_added_;
   std::list<double> history_;
+
+  const size_t num_max_blocks_;
+  // Total number of blocks added, used to index the blocks for Max().
+  uint64_t block_index_;
+  // Candidates for the max of the window, as (block index, bits per second)
+  // pairs. The bits per second are decreasing, so the front is the max. A
+  // block is dropped once a later block has a higher bandwidth, as it cannot
+  // be the max of any window thereafter.
+  std::deque<std::pair<uint64_t, double> > max_candidates_;
 };
 
 #endif  // MPD_BASE_BANDWIDTH_ESTIMATOR_H_
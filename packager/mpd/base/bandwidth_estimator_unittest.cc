@@ -93,4 +93,35 @@ TEST(BandwidthEstimatorTest, FirstOneBlock) {
   EXPECT_EQ(kExptectedEstimate, be.Estimate());
 }
 
+// The max is taken over the latest blocks only.
+TEST(BandwidthEstimatorTest, MaxOfLatestBlocks) {
+  const size_t kNumMaxBlocks = 3;
+  BandwidthEstimator be(BandwidthEstimator::kUseAllBlocks, kNumMaxBlocks);
+  EXPECT_EQ(0u, be.Max());
+
+  const double kDuration = 1.0;
+  // Block sizes in bytes, and the expected max in bits per second after each
+  // block is added.
+  const uint64_t kBlockSizes[] = {5, 3, 4, 1, 2, 1, 6, 1};
+  const uint64_t kExpectedMax[] = {40, 40, 40, 32, 32, 16, 48, 48};
+  COMPILE_ASSERT(arraysize(kBlockSizes) == arraysize(kExpectedMax),
+                 incorrect_number_of_expectations);
+  for (size_t i = 0; i < arraysize(kBlockSizes); ++i) {
+    be.AddBlock(kBlockSizes[i], kDuration);
+    EXPECT_EQ(kExpectedMax[i], be.Max()) << "block " << i;
+  }
+}
+
+// The max is taken over all the blocks by default.
+TEST(BandwidthEstimatorTest, MaxOfAllBlocks) {
+  BandwidthEstimator be(kFirstOneBlockForEstimate);
+  be.AddBlock(1, 1.0);
+  be.AddBlock(1000, 10.0);
+  for (int i = 0; i < 1000; ++i)
+    be.AddBlock(1, 1.0);
+  EXPECT_EQ(800u, be.Max());
+  // The estimate is not affected.
+  EXPECT_EQ(8u, be.Estimate());
+}
+
 } // edash_packager
@@ -6,6 +6,10 @@
 
 #include "packager/mpd/base/dash_iop_mpd_notifier.h"
 
+#include "packager/base/bind.h"
+#include "packager/base/time/time.h"
+#include "packager/media/base/coalescing_writer.h"
+#include "packager/media/base/pipeline_metrics.h"
 #include "packager/mpd/base/media_info.pb.h"
 #include "packager/mpd/base/mpd_notifier_util.h"
 #include "packager/mpd/base/mpd_utils.h"
@@ -16,16 +20,23 @@ namespace {
 
 const int kStartingGroupId = 1;
 
-// The easiest way to check whether two protobufs are equal, is to compare the
-// serialized version.
-bool ProtectedContentEq(
-    const MediaInfo::ProtectedContent& content_protection1,
-    const MediaInfo::ProtectedContent& content_protection2) {
-  return content_protection1.SerializeAsString() ==
-         content_protection2.SerializeAsString();
+// Returns the key of the AdaptationSet of |media_info| in
+// |adaptation_set_index_|: |key| and the protected content, which must be
+// equal for Representations to share an AdaptationSet. The easiest way to
+// check whether two protobufs are equal is to compare the serialized
+// version.
+std::string GetAdaptationSetIndexKey(const std::string& key,
+                                     const MediaInfo& media_info) {
+  if (!media_info.has_protected_content())
+    return key;
+  return key + "\n" + media_info.protected_content().SerializeAsString();
 }
 
-std::set<std::string> GetUUIDs(
+// Returns the key of the AdaptationSets with |key| and the UUIDs of
+// |protected_content| in |group_index_|. AdaptationSets with the same UUIDs
+// can be in the same group.
+std::string GetGroupIndexKey(
+    const std::string& key,
     const MediaInfo::ProtectedContent& protected_content) {
   std::set<std::string> uuids;
   for (int i = 0; i < protected_content.content_protection_entry().size();
@@ -34,7 +45,12 @@ std::set<std::string> GetUUIDs(
         protected_content.content_protection_entry(i);
     uuids.insert(entry.uuid());
   }
-  return uuids;
+  std::string group_key = key;
+  for (const std::string& uuid : uuids) {
+    group_key += '\n';
+    group_key += uuid;
+  }
+  return group_key;
 }
 
 }  // namespace
@@ -50,13 +66,24 @@ DashIopMpdNotifier::DashIopMpdNotifier(
                                       ? MpdBuilder::kDynamic
                                       : MpdBuilder::kStatic,
                                   mpd_options)),
+      mpd_version_(0),
       next_group_id_(kStartingGroupId) {
   DCHECK(dash_profile == kLiveProfile || dash_profile == kOnDemandProfile);
   for (size_t i = 0; i < base_urls.size(); ++i)
     mpd_builder_->AddBaseUrl(base_urls[i]);
+  if (mpd_options.mpd_write_coalescing_window > 0) {
+    mpd_writer_.reset(new media::CoalescingWriter(
+        base::Bind(&DashIopMpdNotifier::WriteMpd, base::Unretained(this)),
+        base::TimeDelta::FromMicroseconds(static_cast<int64_t>(
+            mpd_options.mpd_write_coalescing_window *
+            base::Time::kMicrosecondsPerSecond))));
+  }
 }
 
-DashIopMpdNotifier::~DashIopMpdNotifier() {}
+DashIopMpdNotifier::~DashIopMpdNotifier() {
+  // Writes the pending updates, if any.
+  mpd_writer_.reset();
+}
 
 bool DashIopMpdNotifier::Init() {
   return true;
@@ -124,6 +151,24 @@ bool DashIopMpdNotifier::NotifyNewSegment(uint32_t container_id,
   return true;
 }
 
+bool DashIopMpdNotifier::NotifyNewSegments(
+    const std::vector<SegmentNotification>& segments) {
+  base::AutoLock auto_lock(lock_);
+  bool result = true;
+  for (const SegmentNotification& segment : segments) {
+    RepresentationMap::iterator it =
+        representation_map_.find(segment.container_id);
+    if (it == representation_map_.end()) {
+      LOG(ERROR) << "Unexpected container_id: " << segment.container_id;
+      result = false;
+      continue;
+    }
+    it->second->AddNewSegment(segment.start_time, segment.duration,
+                              segment.size);
+  }
+  return result;
+}
+
 bool DashIopMpdNotifier::NotifyEncryptionUpdate(
     uint32_t container_id,
     const std::string& drm_uuid,
@@ -154,49 +199,56 @@ bool DashIopMpdNotifier::AddContentProtectionElement(
 }
 
 bool DashIopMpdNotifier::Flush() {
+  if (mpd_writer_) {
+    mpd_writer_->RequestWrite();
+    return true;
+  }
+  // Published under |lock_|, so that concurrent flushes publish the
+  // versions in order.
   base::AutoLock auto_lock(lock_);
-  return WriteMpdToFile(output_path_, mpd_builder_.get());
+  media::ScopedStageTimer manifest_write_timer(media::kManifestWriteStage);
+  std::string mpd;
+  if (!mpd_builder_->ToString(&mpd)) {
+    LOG(ERROR) << "Failed to write MPD to string.";
+    return false;
+  }
+  return file_sink_.Publish(output_path_, mpd, ++mpd_version_);
+}
+
+bool DashIopMpdNotifier::WriteMpd() {
+  media::ScopedStageTimer manifest_write_timer(media::kManifestWriteStage);
+  std::string mpd;
+  uint64_t mpd_version;
+  {
+    base::AutoLock auto_lock(lock_);
+    if (!mpd_builder_->ToString(&mpd)) {
+      LOG(ERROR) << "Failed to write MPD to string.";
+      return false;
+    }
+    mpd_version = ++mpd_version_;
+  }
+  return file_sink_.Publish(output_path_, mpd, mpd_version);
 }
 
 AdaptationSet* DashIopMpdNotifier::GetAdaptationSetForMediaInfo(
     const std::string& key,
     const MediaInfo& media_info) {
-  std::list<AdaptationSet*>& adaptation_sets = adaptation_set_list_map_[key];
-  if (adaptation_sets.empty())
-    return NewAdaptationSet(media_info, &adaptation_sets);
-
-  const bool has_protected_content = media_info.has_protected_content();
-
-  for (std::list<AdaptationSet*>::const_iterator adaptation_set_it =
-           adaptation_sets.begin();
-       adaptation_set_it != adaptation_sets.end(); ++adaptation_set_it) {
-    ProtectedContentMap::const_iterator protected_content_it =
-        protected_content_map_.find((*adaptation_set_it)->id());
-
-    // If the AdaptationSet ID is not registered in the map, then it is clear
-    // content (or encrypted but doesn't need <ContentProtection> element
-    // possibly because the player knows how to handle it).
-    if (protected_content_it == protected_content_map_.end()) {
-      // Can reuse the AdaptationSet without content protection.
-      if (!has_protected_content)
-        return *adaptation_set_it;
-      continue;
-    }
-
-    if (ProtectedContentEq(protected_content_it->second,
-                           media_info.protected_content())) {
-      // Content protection info matches. Reuse the AdaptationSet.
-      return *adaptation_set_it;
-    }
-  }
+  const std::string index_key = GetAdaptationSetIndexKey(key, media_info);
+  AdaptationSetIndex::const_iterator iter =
+      adaptation_set_index_.find(index_key);
+  if (iter != adaptation_set_index_.end())
+    return iter->second;
 
   // None of the adaptation sets match with the new content protection.
   // Need a new one.
-  return NewAdaptationSet(media_info, &adaptation_sets);
+  AdaptationSet* adaptation_set =
+      NewAdaptationSet(media_info, &adaptation_set_list_map_[key]);
+  adaptation_set_index_[index_key] = adaptation_set;
+  return adaptation_set;
 }
 
-// Get all the UUIDs of the AdaptationSet. If another AdaptationSet has the
-// same UUIDs then those should be groupable.
+// Groups the AdaptationSet with the first AdaptationSet of the same type with
+// the same UUIDs.
 void DashIopMpdNotifier::SetGroupId(const std::string& key,
                                     AdaptationSet* adaptation_set) {
   if (adaptation_set->Group() >= 0)  // @group already assigned.
@@ -212,46 +264,22 @@ void DashIopMpdNotifier::SetGroupId(const std::string& key,
     return;
   }
 
-  // Get all the UUIDs of the ContentProtections in AdaptationSet.
-  std::set<std::string> adaptation_set_uuids =
-      GetUUIDs(protected_content_it->second);
-
-  std::list<AdaptationSet*>& same_type_adapatation_sets =
-      adaptation_set_list_map_[key];
-  DCHECK(!same_type_adapatation_sets.empty())
-      << "same_type_adapatation_sets should not be null, it should at least "
-         "contain adaptation_set";
-
-  for (std::list<AdaptationSet*>::iterator adaptation_set_it =
-           same_type_adapatation_sets.begin();
-       adaptation_set_it != same_type_adapatation_sets.end();
-       ++adaptation_set_it) {
-    const uint32_t loop_adaptation_set_id = (*adaptation_set_it)->id();
-    if (loop_adaptation_set_id == adaptation_set->id() ||
-        !ContainsKey(protected_content_map_, loop_adaptation_set_id)) {
-      continue;
-    }
-
-    const MediaInfo::ProtectedContent& loop_protected_content =
-        protected_content_map_[loop_adaptation_set_id];
-    if (static_cast<int>(adaptation_set_uuids.size()) !=
-        loop_protected_content.content_protection_entry().size()) {
-      // Different number of UUIDs, cannot be grouped.
-      continue;
-    }
+  AdaptationSet*& uuid_match_adaptation_set =
+      group_index_[GetGroupIndexKey(key, protected_content_it->second)];
+  if (!uuid_match_adaptation_set) {
+    // The first AdaptationSet with these UUIDs, grouped with the next one.
+    uuid_match_adaptation_set = adaptation_set;
+    return;
+  }
+  if (uuid_match_adaptation_set == adaptation_set)
+    return;
 
-    if (adaptation_set_uuids == GetUUIDs(loop_protected_content)) {
-      AdaptationSet& uuid_match_adaptation_set = **adaptation_set_it;
-      // They match. These AdaptationSets can be in the same group. Break out.
-      if (uuid_match_adaptation_set.Group() >= 0) {
-        adaptation_set->SetGroup(uuid_match_adaptation_set.Group());
-      } else {
-        const int group_id = next_group_id_++;
-        uuid_match_adaptation_set.SetGroup(group_id);
-        adaptation_set->SetGroup(group_id);
-      }
-      break;
-    }
+  if (uuid_match_adaptation_set->Group() >= 0) {
+    adaptation_set->SetGroup(uuid_match_adaptation_set->Group());
+  } else {
+    const int group_id = next_group_id_++;
+    uuid_match_adaptation_set->SetGroup(group_id);
+    adaptation_set->SetGroup(group_id);
   }
 }
 
@@ -268,6 +296,23 @@ AdaptationSet* DashIopMpdNotifier::NewAdaptationSet(
   }
   adaptation_sets->push_back(new_adaptation_set);
 
+  // Refer the trick play AdaptationSets to the main ones, which may be added
+  // in either order.
+  const std::string key = GetAdaptationSetKey(media_info);
+  const std::string main_key = GetTrickPlayMainAdaptationSetKey(key);
+  const bool trick_play = !main_key.empty();
+  AdaptationSetListMap::const_iterator counterpart_iter =
+      adaptation_set_list_map_.find(
+          trick_play ? main_key : GetTrickPlayAdaptationSetKey(key));
+  if (counterpart_iter != adaptation_set_list_map_.end()) {
+    for (AdaptationSet* counterpart : counterpart_iter->second) {
+      if (trick_play)
+        new_adaptation_set->AddTrickPlayReferenceId(counterpart->id());
+      else
+        counterpart->AddTrickPlayReferenceId(new_adaptation_set->id());
+    }
+  }
+
   if (media_info.has_video_info()) {
     // Because 'lang' is ignored for videos, |adaptation_sets| must have
     // all the video AdaptationSets.
@@ -14,13 +14,19 @@
 #include <string>
 #include <vector>
 
+#include "packager/base/containers/hash_tables.h"
 #include "packager/base/synchronization/lock.h"
+#include "packager/media/file/manifest_sink.h"
 #include "packager/mpd/base/mpd_builder.h"
 #include "packager/mpd/base/mpd_notifier_util.h"
 #include "packager/mpd/base/mpd_options.h"
 
 namespace edash_packager {
 
+namespace media {
+class CoalescingWriter;
+}  // namespace media
+
 /// This class is an MpdNotifier which will try its best to generate a
 /// DASH IF IOPv3 compliant MPD.
 /// e.g.
@@ -46,6 +52,8 @@ class DashIopMpdNotifier : public MpdNotifier {
                         uint64_t start_time,
                         uint64_t duration,
                         uint64_t size) override;
+  bool NotifyNewSegments(
+      const std::vector<SegmentNotification>& segments) override;
   bool NotifyEncryptionUpdate(uint32_t container_id,
                               const std::string& drm_uuid,
                               const std::vector<uint8_t>& new_key_id,
@@ -65,11 +73,16 @@ class DashIopMpdNotifier : public MpdNotifier {
   // Maps AdaptationSet ID to ProtectedContent.
   typedef std::map<uint32_t, MediaInfo::ProtectedContent> ProtectedContentMap;
 
+  // Maps the key of an AdaptationSet and its protected content or UUIDs to
+  // the AdaptationSet.
+  typedef base::hash_map<std::string, AdaptationSet*> AdaptationSetIndex;
+
   // Checks the protected_content field of media_info and returns a non-null
   // AdaptationSet* for a new Representation.
   // This does not necessarily return a new AdaptationSet. If
   // media_info.protected_content completely matches with an existing
-  // AdaptationSet, then it will return the pointer.
+  // AdaptationSet, then it will return the pointer. Looked up in
+  // |adaptation_set_index_|.
   AdaptationSet* GetAdaptationSetForMediaInfo(const std::string& key,
                                               const MediaInfo& media_info);
 
@@ -83,6 +96,10 @@ class DashIopMpdNotifier : public MpdNotifier {
   AdaptationSet* NewAdaptationSet(const MediaInfo& media_info,
                                   std::list<AdaptationSet*>* adaptation_sets);
 
+  // Serializes the MPD under |lock_| and publishes it to |output_path_|
+  // outside of it. Runs on the thread of |mpd_writer_|.
+  bool WriteMpd();
+
   // Testing only method. Returns a pointer to MpdBuilder.
   MpdBuilder* MpdBuilderForTesting() const {
     return mpd_builder_.get();
@@ -93,22 +110,38 @@ class DashIopMpdNotifier : public MpdNotifier {
     mpd_builder_ = mpd_builder.Pass();
   }
 
-  std::map<std::string, std::list<AdaptationSet*>> adaptation_set_list_map_;
+  typedef std::map<std::string, std::list<AdaptationSet*>>
+      AdaptationSetListMap;
+  AdaptationSetListMap adaptation_set_list_map_;
   RepresentationMap representation_map_;
 
   // Used to check whether a Representation should be added to an AdaptationSet.
   ProtectedContentMap protected_content_map_;
+  // Indexes the AdaptationSets by key and protected content, so that the
+  // AdaptationSet of a new Representation is found without comparing it to
+  // the other AdaptationSets of the same key.
+  AdaptationSetIndex adaptation_set_index_;
+  // Indexes the first encrypted AdaptationSet of each key and UUIDs, which
+  // the next ones are grouped with.
+  AdaptationSetIndex group_index_;
 
   // MPD output path.
   std::string output_path_;
   scoped_ptr<MpdBuilder> mpd_builder_;
   base::Lock lock_;
+  media::FileManifestSink file_sink_;
+  // The version of the last MPD published. Guarded by |lock_|.
+  uint64_t mpd_version_;
 
   // Next group ID to use for AdapationSets that can be grouped.
   int next_group_id_;
 
   // Maps Representation ID to AdaptationSet. This is for updating the PSSH.
   std::map<uint32_t, AdaptationSet*> representation_id_to_adaptation_set_;
+
+  // Writes the MPD in the background if write coalescing is enabled. Declared
+  // last so that it is stopped before the other members are destroyed.
+  scoped_ptr<media::CoalescingWriter> mpd_writer_;
 };
 
 }  // namespace edash_packager
@@ -25,6 +25,7 @@ class MockMpdBuilder : public MpdBuilder {
 
   MOCK_METHOD1(AddAdaptationSet, AdaptationSet*(const std::string& lang));
   MOCK_METHOD1(ToString, bool(std::string* output));
+  MOCK_METHOD2(ToStringWithPatch, bool(std::string* mpd, std::string* patch));
 };
 
 class MockAdaptationSet : public AdaptationSet {
@@ -39,6 +40,7 @@ class MockAdaptationSet : public AdaptationSet {
   MOCK_METHOD2(UpdateContentProtectionPssh,
                void(const std::string& drm_uuid, const std::string& pssh));
   MOCK_METHOD1(AddRole, void(AdaptationSet::Role role));
+  MOCK_METHOD1(AddTrickPlayReferenceId, void(uint32_t adaptation_set_id));
   MOCK_METHOD1(ForceSetSegmentAlignment, void(bool segment_alignment));
 
   MOCK_METHOD1(SetGroup, void(int group_number));
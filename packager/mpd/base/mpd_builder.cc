@@ -9,10 +9,14 @@
 #include <libxml/tree.h>
 #include <libxml/xmlstring.h>
 
+#include <algorithm>
 #include <cmath>
 #include <iterator>
+#include <deque>
 #include <list>
+#include <map>
 #include <string>
+#include <vector>
 
 #include "packager/base/base64.h"
 #include "packager/base/bind.h"
@@ -24,11 +28,13 @@
 #include "packager/base/synchronization/lock.h"
 #include "packager/base/time/default_clock.h"
 #include "packager/base/time/time.h"
+#include "packager/media/base/thread_pool.h"
 #include "packager/media/file/file.h"
 #include "packager/mpd/base/content_protection_element.h"
 #include "packager/mpd/base/language_utils.h"
 #include "packager/mpd/base/mpd_utils.h"
 #include "packager/mpd/base/xml/xml_node.h"
+#include "packager/mpd/base/xml/xml_string_writer.h"
 
 namespace edash_packager {
 
@@ -36,11 +42,17 @@ using base::FilePath;
 using xml::XmlNode;
 using xml::RepresentationXmlNode;
 using xml::AdaptationSetXmlNode;
+using xml::XmlStringWriter;
 
 namespace {
 
 const int kAdaptationSetGroupNotSet = -1;
 
+// Estimated memory of a SegmentInfo of a Representation, with its serialized
+// <S> element of about 32 characters.
+const size_t kEstimatedSegmentInfoSize =
+    sizeof(SegmentInfo) + sizeof(std::string) + 32;
+
 AdaptationSet::Role MediaInfoTextTypeToRole(
     MediaInfo::TextInfo::TextType type) {
   switch (type) {
@@ -77,7 +89,8 @@ std::string GetMimeType(const std::string& prefix,
   return std::string();
 }
 
-void AddMpdNameSpaceInfo(XmlNode* mpd) {
+template <typename XmlElement>
+void AddMpdNameSpaceInfo(XmlElement* mpd) {
   DCHECK(mpd);
 
   static const char kXmlNamespace[] = "urn:mpeg:dash:schema:mpd:2011";
@@ -137,7 +150,8 @@ std::string XmlDateTimeNowWithOffset(
                             time_exploded.second);
 }
 
-void SetIfPositive(const char* attr_name, double value, XmlNode* mpd) {
+template <typename XmlElement>
+void SetIfPositive(const char* attr_name, double value, XmlElement* mpd) {
   if (Positive(value)) {
     mpd->SetStringAttribute(attr_name, SecondsToXmlDuration(value));
   }
@@ -170,7 +184,7 @@ uint64_t LastSegmentEndTime(const SegmentInfo& segment_info) {
          segment_info.duration * (segment_info.repeat + 1);
 }
 
-uint64_t LatestSegmentStartTime(const std::list<SegmentInfo>& segments) {
+uint64_t LatestSegmentStartTime(const std::deque<SegmentInfo>& segments) {
   DCHECK(!segments.empty());
   const SegmentInfo& latest_segment = segments.back();
   return LastSegmentStartTime(latest_segment);
@@ -190,26 +204,121 @@ int SearchTimedOutRepeatIndex(uint64_t timeshift_limit,
 // Overload this function to support different types of |output|.
 // Note that this could be done by call MpdBuilder::ToString() and use the
 // result to write to a file, it requires an extra copy.
-bool WriteXmlCharArrayToOutput(xmlChar* doc,
-                               int doc_size,
-                               std::string* output) {
-  DCHECK(doc);
+bool WriteMpdStringToOutput(std::string* mpd, std::string* output) {
+  DCHECK(mpd);
   DCHECK(output);
-  output->assign(doc, doc + doc_size);
+  output->swap(*mpd);
   return true;
 }
 
-bool WriteXmlCharArrayToOutput(xmlChar* doc,
-                               int doc_size,
-                               media::File* output) {
-  DCHECK(doc);
+bool WriteMpdStringToOutput(std::string* mpd, media::File* output) {
+  DCHECK(mpd);
   DCHECK(output);
-  if (output->Write(doc, doc_size) < doc_size)
+  const int64_t size = mpd->size();
+  if (output->Write(mpd->data(), mpd->size()) < size)
     return false;
 
   return output->Flush();
 }
 
+// Content of the SegmentTimeline element of a Representation in the
+// generated XML document, replaced by the serialized <S> elements.
+const char kSegmentTimelinePlaceholderPrefix[] = "$SegmentTimeline:";
+const char kSegmentTimelinePlaceholderSuffix[] = "$";
+
+// MPD@id, which MPD Patches refer to. A builder generates a single MPD.
+const char kPatchableMpdId[] = "0";
+const char kMpdPatchNamespace[] = "urn:mpeg:dash:schema:mpd-patch:2020";
+
+const char kTrickModeSchemeIdUri[] = "http://dashif.org/guidelines/trickmode";
+
+// Returns the value of the trick mode EssentialProperty, i.e. the whitespace
+// separated list of the AdaptationSets which |ids| refer to.
+std::string TrickPlayReferenceIdsToText(const std::set<uint32_t>& ids) {
+  std::string text;
+  for (uint32_t id : ids) {
+    if (!text.empty())
+      text += " ";
+    text += base::UintToString(id);
+  }
+  return text;
+}
+
+// Starts an RFC 5261 patch operation element, e.g. 'replace', on the nodes
+// selected by |selector|. The caller adds its content and ends it.
+void StartPatchOperation(const char* operation,
+                         const std::string& selector,
+                         XmlStringWriter* writer) {
+  writer->StartElement(operation);
+  writer->SetStringAttribute("sel", selector);
+}
+
+std::string SegmentTimelinePlaceholder(uint32_t representation_id) {
+  return kSegmentTimelinePlaceholderPrefix +
+         base::UintToString(representation_id) +
+         kSegmentTimelinePlaceholderSuffix;
+}
+
+// Returns the <S> element for |segment_info|. Must match what
+// RepresentationXmlNode::AddLiveOnlyInfo() generates.
+std::string SegmentInfoToSElement(const SegmentInfo& segment_info) {
+  std::string s_element =
+      "<S t=\"" + base::Uint64ToString(segment_info.start_time) + "\" d=\"" +
+      base::Uint64ToString(segment_info.duration) + "\"";
+  if (segment_info.repeat > 0)
+    s_element += " r=\"" + base::Uint64ToString(segment_info.repeat) + "\"";
+  s_element += "/>";
+  return s_element;
+}
+
+// Same as RepresentationBaseXmlNode::AddContentProtectionElements().
+void WriteContentProtectionElements(
+    const std::list<ContentProtectionElement>& content_protection_elements,
+    XmlStringWriter* writer) {
+  for (const ContentProtectionElement& element : content_protection_elements) {
+    writer->StartElement("ContentProtection");
+    // @value is an optional attribute.
+    if (!element.value.empty())
+      writer->SetStringAttribute("value", element.value);
+    writer->SetStringAttribute("schemeIdUri", element.scheme_id_uri);
+    for (const std::pair<const std::string, std::string>& attribute :
+         element.additional_attributes) {
+      writer->SetStringAttribute(attribute.first.c_str(), attribute.second);
+    }
+
+    for (const Element& subelement : element.subelements) {
+      writer->StartElement(subelement.name.c_str());
+      for (const std::pair<const std::string, std::string>& attribute :
+           subelement.attributes) {
+        writer->SetStringAttribute(attribute.first.c_str(), attribute.second);
+      }
+      // XmlNode::AddElements() sets the content after adding the nested
+      // subelements, which replaces them. Do the same.
+      writer->SetContent(subelement.content);
+      writer->EndElement();
+    }
+    writer->EndElement();
+  }
+}
+
+// Writes |content_protection_elements| with their serialization in
+// |cached_xml|, which is serialized again only if |cached_level|, the level
+// it was serialized for, is not the current level, e.g. 0 after the elements
+// changed.
+void WriteCachedContentProtectionElements(
+    const std::list<ContentProtectionElement>& content_protection_elements,
+    std::string* cached_xml,
+    size_t* cached_level,
+    XmlStringWriter* writer) {
+  if (*cached_level != writer->depth()) {
+    XmlStringWriter fragment_writer(cached_xml, writer->depth());
+    WriteContentProtectionElements(content_protection_elements,
+                                   &fragment_writer);
+    *cached_level = writer->depth();
+  }
+  writer->AddSerializedChildren(*cached_xml);
+}
+
 std::string MakePathRelative(const std::string& path,
                              const std::string& mpd_dir) {
   return (path.find(mpd_dir) == 0) ? path.substr(mpd_dir.size()) : path;
@@ -402,6 +511,7 @@ MpdBuilder::MpdBuilder(MpdType type, const MpdOptions& mpd_options)
     : type_(type),
       mpd_options_(mpd_options),
       adaptation_sets_deleter_(&adaptation_sets_),
+      mpd_size_hint_(0),
       clock_(new base::DefaultClock()) {}
 
 MpdBuilder::~MpdBuilder() {}
@@ -429,10 +539,54 @@ bool MpdBuilder::ToString(std::string* output) {
   DCHECK(output);
   return WriteMpdToOutput(output);
 }
+
+bool MpdBuilder::ToStringWithPatch(std::string* mpd, std::string* patch) {
+  DCHECK(mpd);
+  DCHECK(patch);
+  DCHECK_EQ(kDynamic, type_);
+  DCHECK(!mpd_options_.mpd_patch_location.empty());
+
+  const bool kSkipPatchedFields = true;
+  mpd->reserve(mpd_size_hint_);
+  if (!WriteMpdToString(mpd, !kSkipPatchedFields))
+    return false;
+  mpd_size_hint_ = mpd->size();
+  std::string patch_base_mpd;
+  if (!WriteMpdToString(&patch_base_mpd, kSkipPatchedFields))
+    return false;
+
+  // |patch_base_mpd_| is empty before the first MPD, so there is no patch.
+  patch->clear();
+  if (patch_base_mpd == patch_base_mpd_) {
+    WritePatch(patch);
+  } else if (!patch_base_mpd_.empty()) {
+    VLOG(1) << "The MPD changed beyond what an MPD Patch updates.";
+  }
+
+  for (AdaptationSet* adaptation_set : adaptation_sets_) {
+    for (Representation* representation : adaptation_set->representations_)
+      representation->ResetPatchBase();
+  }
+  patch_base_mpd_.swap(patch_base_mpd);
+  patch_publish_time_ = publish_time_;
+  return true;
+}
+
 template <typename OutputType>
 bool MpdBuilder::WriteMpdToOutput(OutputType* output) {
   static LibXmlInitializer lib_xml_initializer;
 
+  std::string mpd;
+  if (mpd_options_.use_streaming_mpd_writer) {
+    // The MPD only grows a little between updates, so the previous size
+    // avoids most of the reallocations.
+    mpd.reserve(mpd_size_hint_);
+    if (!WriteMpdToString(&mpd, false))
+      return false;
+    mpd_size_hint_ = mpd.size();
+    return WriteMpdStringToOutput(&mpd, output);
+  }
+
   xml::scoped_xml_ptr<xmlDoc> doc(GenerateMpd());
   if (!doc.get())
     return false;
@@ -442,13 +596,15 @@ bool MpdBuilder::WriteMpdToOutput(OutputType* output) {
   xmlChar* doc_str = NULL;
   xmlDocDumpFormatMemoryEnc(doc.get(), &doc_str, &doc_str_size, "UTF-8",
                             kNiceFormat);
-
-  bool result = WriteXmlCharArrayToOutput(doc_str, doc_str_size, output);
+  const std::string doc_string(doc_str, doc_str + doc_str_size);
   xmlFree(doc_str);
 
   // Cleanup, free the doc.
   doc.reset();
-  return result;
+
+  if (!InsertSegmentTimelines(doc_string, &mpd))
+    return false;
+  return WriteMpdStringToOutput(&mpd, output);
 }
 
 xmlDocPtr MpdBuilder::GenerateMpd() {
@@ -467,7 +623,9 @@ xmlDocPtr MpdBuilder::GenerateMpd() {
   std::list<AdaptationSet*>::iterator adaptation_sets_it =
       adaptation_sets_.begin();
   for (; adaptation_sets_it != adaptation_sets_.end(); ++adaptation_sets_it) {
-    xml::scoped_xml_ptr<xmlNode> child((*adaptation_sets_it)->GetXml());
+    const bool kSegmentTimelinePlaceholders = true;
+    xml::scoped_xml_ptr<xmlNode> child(
+        (*adaptation_sets_it)->GetXmlInternal(kSegmentTimelinePlaceholders));
     if (!child.get() || !period.AddChild(child.Pass()))
       return NULL;
   }
@@ -482,6 +640,13 @@ xmlDocPtr MpdBuilder::GenerateMpd() {
       return NULL;
   }
 
+  if (type_ == kDynamic && !mpd_options_.mpd_patch_location.empty()) {
+    XmlNode patch_location("PatchLocation");
+    patch_location.SetContent(mpd_options_.mpd_patch_location);
+    if (!mpd.AddChild(patch_location.PassScopedPtr()))
+      return NULL;
+  }
+
   if (type_ == kDynamic) {
     // This is the only Period and it is a regular period.
     period.SetStringAttribute("start", "PT0S");
@@ -494,10 +659,10 @@ xmlDocPtr MpdBuilder::GenerateMpd() {
   AddCommonMpdInfo(&mpd);
   switch (type_) {
     case kStatic:
-      AddStaticMpdInfo(&mpd);
+      AddStaticMpdInfo(&mpd, GetStaticMpdDuration(&mpd));
       break;
     case kDynamic:
-      AddDynamicMpdInfo(&mpd);
+      AddDynamicMpdInfo(&mpd, false);
       break;
     default:
       NOTREACHED() << "Unknown MPD type: " << type_;
@@ -515,7 +680,142 @@ xmlDocPtr MpdBuilder::GenerateMpd() {
   return doc.release();
 }
 
-void MpdBuilder::AddCommonMpdInfo(XmlNode* mpd_node) {
+bool MpdBuilder::InsertSegmentTimelines(const std::string& mpd,
+                                        std::string* output) {
+  DCHECK(output);
+  static const char kSegmentTimelineStartTag[] = "<SegmentTimeline>";
+  const std::string segment_timeline_end_tag = "</SegmentTimeline>";
+  const std::string placeholder_start =
+      std::string(kSegmentTimelineStartTag) + kSegmentTimelinePlaceholderPrefix;
+
+  std::map<uint32_t, const Representation*> representations;
+  for (const AdaptationSet* adaptation_set : adaptation_sets_) {
+    for (const Representation* representation :
+         adaptation_set->representations_) {
+      representations[representation->id()] = representation;
+    }
+  }
+
+  output->clear();
+  output->reserve(mpd.size());
+  size_t pos = 0;
+  while (true) {
+    const size_t element_pos = mpd.find(placeholder_start, pos);
+    if (element_pos == std::string::npos)
+      break;
+    const size_t id_pos = element_pos + placeholder_start.size();
+    const size_t id_end = mpd.find(kSegmentTimelinePlaceholderSuffix, id_pos);
+    unsigned representation_id = 0;
+    if (id_end == std::string::npos ||
+        !base::StringToUint(mpd.substr(id_pos, id_end - id_pos),
+                            &representation_id) ||
+        representations.find(representation_id) == representations.end() ||
+        mpd.compare(id_end + 1, segment_timeline_end_tag.size(),
+                    segment_timeline_end_tag) != 0) {
+      LOG(ERROR) << "Invalid SegmentTimeline placeholder in MPD.";
+      return false;
+    }
+
+    // Keep the element at the indentation libxml has given it.
+    const size_t line_pos = mpd.rfind('\n', element_pos);
+    const size_t line_start = line_pos == std::string::npos ? 0 : line_pos + 1;
+    const std::string indent(element_pos - line_start, ' ');
+
+    output->append(mpd, pos, element_pos - pos);
+    representations[representation_id]->AppendSegmentTimeline(indent, output);
+    pos = id_end + 1 + segment_timeline_end_tag.size();
+  }
+  output->append(mpd, pos, std::string::npos);
+  return true;
+}
+
+bool MpdBuilder::WriteMpdToString(std::string* output,
+                                  bool skip_patched_fields) {
+  DCHECK(output);
+  XmlStringWriter writer(output);
+  writer.WriteXmlDeclaration();
+  writer.WriteComment(
+      "Generated with https://github.com/google/edash-packager version " +
+      mpd_options_.packager_version_string);
+
+  // The attributes and the children are in the same order as GenerateMpd().
+  writer.StartElement("MPD");
+  AddMpdNameSpaceInfo(&writer);
+  AddCommonMpdInfo(&writer);
+  switch (type_) {
+    case kStatic:
+      AddStaticMpdInfo(&writer, GetStaticMpdDuration());
+      break;
+    case kDynamic:
+      AddDynamicMpdInfo(&writer, skip_patched_fields);
+      break;
+    default:
+      NOTREACHED() << "Unknown MPD type: " << type_;
+      break;
+  }
+
+  for (const std::string& base_url : base_urls_) {
+    writer.StartElement("BaseURL");
+    writer.SetContent(base_url);
+    writer.EndElement();
+  }
+  if (type_ == kDynamic && !mpd_options_.mpd_patch_location.empty()) {
+    writer.StartElement("PatchLocation");
+    writer.SetContent(mpd_options_.mpd_patch_location);
+    writer.EndElement();
+  }
+
+  writer.StartElement("Period");
+  writer.SetId(0);
+  if (type_ == kDynamic)
+    writer.SetStringAttribute("start", "PT0S");
+  if (mpd_options_.num_xml_threads > 1 && !xml_thread_pool_) {
+    xml_thread_pool_.reset(
+        new media::ThreadPool("MpdXml", mpd_options_.num_xml_threads));
+    xml_thread_pool_->Start();
+  }
+  for (AdaptationSet* adaptation_set : adaptation_sets_) {
+    if (!adaptation_set->WriteXml(&writer, skip_patched_fields,
+                                  xml_thread_pool_.get())) {
+      return false;
+    }
+  }
+  writer.EndElement();
+
+  writer.EndElement();
+  return true;
+}
+
+void MpdBuilder::WritePatch(std::string* output) {
+  DCHECK(output);
+  XmlStringWriter writer(output);
+  writer.WriteXmlDeclaration();
+  writer.StartElement("Patch");
+  writer.SetStringAttribute("xmlns", kMpdPatchNamespace);
+  writer.SetStringAttribute("mpdId", kPatchableMpdId);
+  writer.SetStringAttribute("originalPublishTime", patch_publish_time_);
+  writer.SetStringAttribute("publishTime", publish_time_);
+
+  StartPatchOperation("replace", "/MPD/@publishTime", &writer);
+  writer.SetContent(publish_time_);
+  writer.EndElement();
+
+  for (AdaptationSet* adaptation_set : adaptation_sets_) {
+    const std::string adaptation_set_path =
+        "/MPD/Period[@id='0']/AdaptationSet[@id='" +
+        base::UintToString(adaptation_set->id()) + "']";
+    for (Representation* representation : adaptation_set->representations_) {
+      representation->WritePatch(adaptation_set_path + "/Representation[@id='" +
+                                     base::UintToString(representation->id()) +
+                                     "']",
+                                 &writer);
+    }
+  }
+  writer.EndElement();
+}
+
+template <typename XmlElement>
+void MpdBuilder::AddCommonMpdInfo(XmlElement* mpd_node) {
   if (Positive(mpd_options_.min_buffer_time)) {
     mpd_node->SetStringAttribute(
         "minBufferTime", SecondsToXmlDuration(mpd_options_.min_buffer_time));
@@ -525,7 +825,8 @@ void MpdBuilder::AddCommonMpdInfo(XmlNode* mpd_node) {
   }
 }
 
-void MpdBuilder::AddStaticMpdInfo(XmlNode* mpd_node) {
+template <typename XmlElement>
+void MpdBuilder::AddStaticMpdInfo(XmlElement* mpd_node, float duration) {
   DCHECK(mpd_node);
   DCHECK_EQ(MpdBuilder::kStatic, type_);
 
@@ -534,24 +835,29 @@ void MpdBuilder::AddStaticMpdInfo(XmlNode* mpd_node) {
       "urn:mpeg:dash:profile:isoff-on-demand:2011";
   mpd_node->SetStringAttribute("type", kStaticMpdType);
   mpd_node->SetStringAttribute("profiles", kStaticMpdProfile);
-  mpd_node->SetStringAttribute(
-      "mediaPresentationDuration",
-      SecondsToXmlDuration(GetStaticMpdDuration(mpd_node)));
+  mpd_node->SetStringAttribute("mediaPresentationDuration",
+                               SecondsToXmlDuration(duration));
 }
 
-void MpdBuilder::AddDynamicMpdInfo(XmlNode* mpd_node) {
+template <typename XmlElement>
+void MpdBuilder::AddDynamicMpdInfo(XmlElement* mpd_node,
+                                   bool skip_patched_fields) {
   DCHECK(mpd_node);
   DCHECK_EQ(MpdBuilder::kDynamic, type_);
 
   static const char kDynamicMpdType[] = "dynamic";
   static const char kDynamicMpdProfile[] =
       "urn:mpeg:dash:profile:isoff-live:2011";
+  if (!mpd_options_.mpd_patch_location.empty())
+    mpd_node->SetStringAttribute("id", kPatchableMpdId);
   mpd_node->SetStringAttribute("type", kDynamicMpdType);
   mpd_node->SetStringAttribute("profiles", kDynamicMpdProfile);
 
-  // No offset from NOW.
-  mpd_node->SetStringAttribute("publishTime",
-                               XmlDateTimeNowWithOffset(0, clock_.get()));
+  if (!skip_patched_fields) {
+    // No offset from NOW.
+    publish_time_ = XmlDateTimeNowWithOffset(0, clock_.get());
+    mpd_node->SetStringAttribute("publishTime", publish_time_);
+  }
 
   // 'availabilityStartTime' is required for dynamic profile. Calculate if
   // not already calculated.
@@ -618,6 +924,28 @@ float MpdBuilder::GetStaticMpdDuration(XmlNode* mpd_node) {
   return max_duration;
 }
 
+float MpdBuilder::GetStaticMpdDuration() {
+  DCHECK_EQ(MpdBuilder::kStatic, type_);
+
+  // Same as the 'duration' attributes that GetStaticMpdDuration(XmlNode*)
+  // looks at.
+  float max_duration = 0.0f;
+  for (const AdaptationSet* adaptation_set : adaptation_sets_) {
+    for (const Representation* representation :
+         adaptation_set->representations_) {
+      const MediaInfo& media_info = representation->media_info_;
+      if (!HasVODOnlyFields(media_info) ||
+          !media_info.has_media_duration_seconds()) {
+        continue;
+      }
+      const float duration =
+          static_cast<float>(media_info.media_duration_seconds());
+      max_duration = max_duration > duration ? max_duration : duration;
+    }
+  }
+  return max_duration;
+}
+
 bool MpdBuilder::GetEarliestTimestamp(double* timestamp_seconds) {
   DCHECK(timestamp_seconds);
 
@@ -671,10 +999,14 @@ AdaptationSet::AdaptationSet(uint32_t adaptation_set_id,
                              const MpdOptions& mpd_options,
                              MpdBuilder::MpdType mpd_type,
                              base::AtomicSequenceNumber* counter)
-    : representations_deleter_(&representations_),
+    : content_protection_xml_level_(0),
+      representations_deleter_(&representations_),
       representation_counter_(counter),
       id_(adaptation_set_id),
       lang_(lang),
+      lang_attribute_(lang.empty() || lang == "und"
+                          ? std::string()
+                          : LanguageToShortestForm(lang)),
       mpd_options_(mpd_options),
       mpd_type_(mpd_type),
       group_(kAdaptationSetGroupNotSet),
@@ -733,18 +1065,25 @@ void AdaptationSet::AddContentProtectionElement(
     const ContentProtectionElement& content_protection_element) {
   content_protection_elements_.push_back(content_protection_element);
   RemoveDuplicateAttributes(&content_protection_elements_.back());
+  content_protection_xml_level_ = 0;
 }
 
 void AdaptationSet::UpdateContentProtectionPssh(const std::string& drm_uuid,
                                                 const std::string& pssh) {
-  UpdateContentProtectionPsshHelper(drm_uuid, pssh,
-                                    &content_protection_elements_);
+  if (UpdateContentProtectionPsshHelper(drm_uuid, pssh,
+                                        &content_protection_elements_)) {
+    content_protection_xml_level_ = 0;
+  }
 }
 
 void AdaptationSet::AddRole(Role role) {
   roles_.insert(role);
 }
 
+void AdaptationSet::AddTrickPlayReferenceId(uint32_t adaptation_set_id) {
+  trick_play_reference_ids_.insert(adaptation_set_id);
+}
+
 // Creates a copy of <AdaptationSet> xml element, iterate thru all the
 // <Representation> (child) elements and add them to the copy.
 // Set all the attributes first and then add the children elements so that flags
@@ -752,39 +1091,128 @@ void AdaptationSet::AddRole(Role role) {
 // example, if AdaptationSet@width is set, then Representation@width is
 // redundant and should not be set.
 xml::scoped_xml_ptr<xmlNode> AdaptationSet::GetXml() {
+  const bool kSegmentTimelinePlaceholders = true;
+  return GetXmlInternal(!kSegmentTimelinePlaceholders);
+}
+
+xml::scoped_xml_ptr<xmlNode> AdaptationSet::GetXmlInternal(
+    bool segment_timeline_placeholders) {
   AdaptationSetXmlNode adaptation_set;
+  const int suppression_flags = SetXmlAttributes(&adaptation_set);
+
+  if (!adaptation_set.AddContentProtectionElements(
+          content_protection_elements_)) {
+    return xml::scoped_xml_ptr<xmlNode>();
+  }
+  if (!trick_play_reference_ids_.empty()) {
+    adaptation_set.AddEssentialProperty(
+        kTrickModeSchemeIdUri,
+        TrickPlayReferenceIdsToText(trick_play_reference_ids_));
+  }
+  for (AdaptationSet::Role role : roles_)
+    adaptation_set.AddRoleElement("urn:mpeg:dash:role:2011", RoleToText(role));
+
+  for (Representation* representation : representations_) {
+    representation->output_suppression_flags_ |= suppression_flags;
+    xml::scoped_xml_ptr<xmlNode> child(
+        representation->GetXmlInternal(segment_timeline_placeholders));
+    if (!child || !adaptation_set.AddChild(child.Pass()))
+      return xml::scoped_xml_ptr<xmlNode>();
+  }
 
-  bool suppress_representation_width = false;
-  bool suppress_representation_height = false;
-  bool suppress_representation_frame_rate = false;
+  return adaptation_set.PassScopedPtr();
+}
 
-  adaptation_set.SetId(id_);
-  adaptation_set.SetStringAttribute("contentType", content_type_);
-  if (!lang_.empty() && lang_ != "und") {
-    adaptation_set.SetStringAttribute("lang", LanguageToShortestForm(lang_));
+bool AdaptationSet::WriteXml(XmlStringWriter* writer,
+                             bool skip_patched_fields,
+                             media::ThreadPool* thread_pool) {
+  DCHECK(writer);
+  writer->StartElement("AdaptationSet");
+  const int suppression_flags = SetXmlAttributes(writer);
+
+  WriteCachedContentProtectionElements(content_protection_elements_,
+                                       &content_protection_xml_,
+                                       &content_protection_xml_level_, writer);
+  if (!trick_play_reference_ids_.empty()) {
+    writer->StartElement("EssentialProperty");
+    writer->SetStringAttribute("schemeIdUri", kTrickModeSchemeIdUri);
+    writer->SetStringAttribute(
+        "value", TrickPlayReferenceIdsToText(trick_play_reference_ids_));
+    writer->EndElement();
+  }
+  for (AdaptationSet::Role role : roles_) {
+    writer->StartElement("Role");
+    writer->SetStringAttribute("schemeIdUri", "urn:mpeg:dash:role:2011");
+    writer->SetStringAttribute("value", RoleToText(role));
+    writer->EndElement();
+  }
+
+  const bool include_duration = mpd_type_ == MpdBuilder::kDynamic;
+  if (thread_pool && representations_.size() > 1) {
+    // Each Representation writes its own fragment, which are then added in
+    // order, so the output does not depend on which finishes first.
+    const size_t num_representations = representations_.size();
+    std::vector<std::string> fragments(num_representations);
+    scoped_ptr<bool[]> results(new bool[num_representations]);
+    std::vector<base::Closure> tasks;
+    size_t i = 0;
+    for (Representation* representation : representations_) {
+      representation->output_suppression_flags_ |= suppression_flags;
+      tasks.push_back(base::Bind(
+          &Representation::WriteXmlFragment, base::Unretained(representation),
+          writer->depth(), include_duration, skip_patched_fields,
+          &fragments[i], &results[i]));
+      ++i;
+    }
+    thread_pool->RunTasksAndWait(tasks);
+    for (i = 0; i < num_representations; ++i) {
+      if (!results[i])
+        return false;
+      writer->AddSerializedChildren(fragments[i]);
+    }
+  } else {
+    for (Representation* representation : representations_) {
+      representation->output_suppression_flags_ |= suppression_flags;
+      if (!representation->WriteXml(writer, include_duration,
+                                    skip_patched_fields)) {
+        return false;
+      }
+    }
   }
+  writer->EndElement();
+  return true;
+}
+
+template <typename XmlElement>
+int AdaptationSet::SetXmlAttributes(XmlElement* adaptation_set) {
+  int suppression_flags = 0;
+
+  adaptation_set->SetId(id_);
+  adaptation_set->SetStringAttribute("contentType", content_type_);
+  if (!lang_attribute_.empty())
+    adaptation_set->SetStringAttribute("lang", lang_attribute_);
 
   // Note that std::{set,map} are ordered, so the last element is the max value.
   if (video_widths_.size() == 1) {
-    suppress_representation_width = true;
-    adaptation_set.SetIntegerAttribute("width", *video_widths_.begin());
+    suppression_flags |= Representation::kSuppressWidth;
+    adaptation_set->SetIntegerAttribute("width", *video_widths_.begin());
   } else if (video_widths_.size() > 1) {
-    adaptation_set.SetIntegerAttribute("maxWidth", *video_widths_.rbegin());
+    adaptation_set->SetIntegerAttribute("maxWidth", *video_widths_.rbegin());
   }
   if (video_heights_.size() == 1) {
-    suppress_representation_height = true;
-    adaptation_set.SetIntegerAttribute("height", *video_heights_.begin());
+    suppression_flags |= Representation::kSuppressHeight;
+    adaptation_set->SetIntegerAttribute("height", *video_heights_.begin());
   } else if (video_heights_.size() > 1) {
-    adaptation_set.SetIntegerAttribute("maxHeight", *video_heights_.rbegin());
+    adaptation_set->SetIntegerAttribute("maxHeight", *video_heights_.rbegin());
   }
 
   if (video_frame_rates_.size() == 1) {
-    suppress_representation_frame_rate = true;
-    adaptation_set.SetStringAttribute("frameRate",
-                                      video_frame_rates_.begin()->second);
+    suppression_flags |= Representation::kSuppressFrameRate;
+    adaptation_set->SetStringAttribute("frameRate",
+                                       video_frame_rates_.begin()->second);
   } else if (video_frame_rates_.size() > 1) {
-    adaptation_set.SetStringAttribute("maxFrameRate",
-                                      video_frame_rates_.rbegin()->second);
+    adaptation_set->SetStringAttribute("maxFrameRate",
+                                       video_frame_rates_.rbegin()->second);
   }
 
   // Note: must be checked before checking segments_aligned_ (below). So that
@@ -794,38 +1222,19 @@ xml::scoped_xml_ptr<xmlNode> AdaptationSet::GetXml() {
   }
 
   if (segments_aligned_ == kSegmentAlignmentTrue) {
-    adaptation_set.SetStringAttribute(mpd_type_ == MpdBuilder::kStatic
-                                          ? "subsegmentAlignment"
-                                          : "segmentAlignment",
-                                      "true");
+    adaptation_set->SetStringAttribute(mpd_type_ == MpdBuilder::kStatic
+                                           ? "subsegmentAlignment"
+                                           : "segmentAlignment",
+                                       "true");
   }
 
   if (picture_aspect_ratio_.size() == 1)
-    adaptation_set.SetStringAttribute("par", *picture_aspect_ratio_.begin());
+    adaptation_set->SetStringAttribute("par", *picture_aspect_ratio_.begin());
 
   if (group_ >= 0)
-    adaptation_set.SetIntegerAttribute("group", group_);
+    adaptation_set->SetIntegerAttribute("group", group_);
 
-  if (!adaptation_set.AddContentProtectionElements(
-          content_protection_elements_)) {
-    return xml::scoped_xml_ptr<xmlNode>();
-  }
-  for (AdaptationSet::Role role : roles_)
-    adaptation_set.AddRoleElement("urn:mpeg:dash:role:2011", RoleToText(role));
-
-  for (Representation* representation : representations_) {
-    if (suppress_representation_width)
-      representation->SuppressOnce(Representation::kSuppressWidth);
-    if (suppress_representation_height)
-      representation->SuppressOnce(Representation::kSuppressHeight);
-    if (suppress_representation_frame_rate)
-      representation->SuppressOnce(Representation::kSuppressFrameRate);
-    xml::scoped_xml_ptr<xmlNode> child(representation->GetXml());
-    if (!child || !adaptation_set.AddChild(child.Pass()))
-      return xml::scoped_xml_ptr<xmlNode>();
-  }
-
-  return adaptation_set.PassScopedPtr();
+  return suppression_flags;
 }
 
 void AdaptationSet::ForceSetSegmentAlignment(bool segment_alignment) {
@@ -1033,10 +1442,22 @@ Representation::Representation(
     uint32_t id,
     scoped_ptr<RepresentationStateChangeListener> state_change_listener)
     : media_info_(media_info),
+      content_protection_xml_level_(0),
+      segment_infos_memory_(media::kMpdSegmentInfoMemory),
       id_(id),
-      bandwidth_estimator_(BandwidthEstimator::kUseAllBlocks),
+      bandwidth_estimator_(BandwidthEstimator::kUseAllBlocks,
+                           std::max(mpd_options.peak_bandwidth_window, 0)),
       mpd_options_(mpd_options),
       start_number_(1),
+      constant_segment_duration_(0),
+      num_segments_added_(0),
+      segments_at_nominal_times_(true),
+      patch_entries_removed_(0),
+      patch_entries_left_(0),
+      patch_first_entry_updated_(false),
+      patch_last_entry_updated_(false),
+      patch_bandwidth_(0),
+      patch_start_number_(1),
       state_change_listener_(state_change_listener.Pass()),
       output_suppression_flags_(0) {}
 
@@ -1067,12 +1488,21 @@ bool Representation::Init() {
 
   if (media_info_.has_video_info()) {
     mime_type_ = GetVideoMimeType();
-    if (!HasRequiredVideoFields(media_info_.video_info())) {
+    const MediaInfo::VideoInfo& video_info = media_info_.video_info();
+    if (!HasRequiredVideoFields(video_info)) {
       LOG(ERROR) << "Missing required fields to create a video Representation.";
       return false;
     }
+    if (video_info.has_pixel_width() && video_info.has_pixel_height()) {
+      sar_ = base::IntToString(video_info.pixel_width()) + ":" +
+             base::IntToString(video_info.pixel_height());
+    }
+    UpdateFrameRate();
   } else if (media_info_.has_audio_info()) {
     mime_type_ = GetAudioMimeType();
+    GetAudioChannelConfiguration(media_info_.audio_info(),
+                                 &audio_channel_scheme_id_uri_,
+                                 &audio_channel_value_);
   } else if (media_info_.has_text_info()) {
     mime_type_ = GetTextMimeType();
   }
@@ -1088,12 +1518,15 @@ void Representation::AddContentProtectionElement(
     const ContentProtectionElement& content_protection_element) {
   content_protection_elements_.push_back(content_protection_element);
   RemoveDuplicateAttributes(&content_protection_elements_.back());
+  content_protection_xml_level_ = 0;
 }
 
 void Representation::UpdateContentProtectionPssh(const std::string& drm_uuid,
                                                  const std::string& pssh) {
-  UpdateContentProtectionPsshHelper(drm_uuid, pssh,
-                                    &content_protection_elements_);
+  if (UpdateContentProtectionPsshHelper(drm_uuid, pssh,
+                                        &content_protection_elements_)) {
+    content_protection_xml_level_ = 0;
+  }
 }
 
 void Representation::AddNewSegment(uint64_t start_time,
@@ -1106,11 +1539,18 @@ void Representation::AddNewSegment(uint64_t start_time,
 
   if (state_change_listener_)
     state_change_listener_->OnNewSegmentForRepresentation(start_time, duration);
+  if (mpd_options_.segment_template_constant_duration)
+    CheckConstantSegmentDuration(start_time, duration);
   if (IsContiguous(start_time, duration, size)) {
     ++segment_infos_.back().repeat;
+    segment_timeline_entries_.back() =
+        SegmentInfoToSElement(segment_infos_.back());
+    if (segment_timeline_entries_.size() == patch_entries_left_)
+      patch_last_entry_updated_ = true;
   } else {
     SegmentInfo s = {start_time, duration, /* Not repeat. */ 0};
     segment_infos_.push_back(s);
+    segment_timeline_entries_.push_back(SegmentInfoToSElement(s));
   }
 
   bandwidth_estimator_.AddBlock(
@@ -1118,11 +1558,14 @@ void Representation::AddNewSegment(uint64_t start_time,
 
   SlideWindow();
   DCHECK_GE(segment_infos_.size(), 1u);
+  DCHECK_EQ(segment_infos_.size(), segment_timeline_entries_.size());
+  segment_infos_memory_.Set(segment_infos_.size() * kEstimatedSegmentInfoSize);
 }
 
 void Representation::SetSampleDuration(uint32_t sample_duration) {
   if (media_info_.has_video_info()) {
     media_info_.mutable_video_info()->set_frame_duration(sample_duration);
+    UpdateFrameRate();
     if (state_change_listener_) {
       state_change_listener_->OnSetFrameRateForRepresentation(
           sample_duration, media_info_.video_info().time_scale());
@@ -1137,6 +1580,12 @@ void Representation::SetSampleDuration(uint32_t sample_duration) {
 // AudioChannelConfig elements), AddContentProtectionElements*(), and
 // AddVODOnlyInfo() (Adds segment info).
 xml::scoped_xml_ptr<xmlNode> Representation::GetXml() {
+  const bool kSegmentTimelinePlaceholder = true;
+  return GetXmlInternal(!kSegmentTimelinePlaceholder);
+}
+
+xml::scoped_xml_ptr<xmlNode> Representation::GetXmlInternal(
+    bool segment_timeline_placeholder) {
   if (!HasRequiredMediaInfoFields()) {
     LOG(ERROR) << "MediaInfo missing required fields.";
     return xml::scoped_xml_ptr<xmlNode>();
@@ -1144,7 +1593,7 @@ xml::scoped_xml_ptr<xmlNode> Representation::GetXml() {
 
   const uint64_t bandwidth = media_info_.has_bandwidth()
                                  ? media_info_.bandwidth()
-                                 : bandwidth_estimator_.Estimate();
+                                 : EstimateBandwidth();
 
   DCHECK(!(HasVODOnlyFields(media_info_) && HasLiveOnlyFields(media_info_)));
 
@@ -1186,11 +1635,22 @@ xml::scoped_xml_ptr<xmlNode> Representation::GetXml() {
     return xml::scoped_xml_ptr<xmlNode>();
   }
 
-  if (HasLiveOnlyFields(media_info_) &&
-      !representation.AddLiveOnlyInfo(media_info_, segment_infos_,
-                                      start_number_)) {
-    LOG(ERROR) << "Failed to add Live info.";
-    return xml::scoped_xml_ptr<xmlNode>();
+  if (HasLiveOnlyFields(media_info_)) {
+    bool success;
+    if (UseConstantSegmentDuration()) {
+      success = representation.AddConstantDurationLiveOnlyInfo(
+          media_info_, constant_segment_duration_);
+    } else if (segment_timeline_placeholder) {
+      success = representation.AddLiveOnlyInfo(
+          media_info_, SegmentTimelinePlaceholder(id_), start_number_);
+    } else {
+      success = representation.AddLiveOnlyInfo(media_info_, segment_infos_,
+                                               start_number_);
+    }
+    if (!success) {
+      LOG(ERROR) << "Failed to add Live info.";
+      return xml::scoped_xml_ptr<xmlNode>();
+    }
   }
   // TODO(rkuroiwa): It is likely that all representations have the exact same
   // SegmentTemplate. Optimize and propagate the tag up to AdaptationSet level.
@@ -1199,10 +1659,261 @@ xml::scoped_xml_ptr<xmlNode> Representation::GetXml() {
   return representation.PassScopedPtr();
 }
 
+// Same as GetXmlInternal(), see the comments on the attribute and element
+// order there and in RepresentationXmlNode.
+bool Representation::WriteXml(XmlStringWriter* writer,
+                              bool include_duration,
+                              bool skip_patched_fields) {
+  DCHECK(writer);
+  if (!HasRequiredMediaInfoFields()) {
+    LOG(ERROR) << "MediaInfo missing required fields.";
+    return false;
+  }
+
+  DCHECK(!(HasVODOnlyFields(media_info_) && HasLiveOnlyFields(media_info_)));
+
+  writer->StartElement("Representation");
+  // Mandatory fields for Representation.
+  writer->SetId(id_);
+  if (!skip_patched_fields)
+    writer->SetIntegerAttribute("bandwidth", GetBandwidth());
+  if (!codecs_.empty())
+    writer->SetStringAttribute("codecs", codecs_);
+  writer->SetStringAttribute("mimeType", mime_type_);
+
+  if (media_info_.has_video_info()) {
+    const MediaInfo::VideoInfo& video_info = media_info_.video_info();
+    if (!video_info.has_width() || !video_info.has_height()) {
+      LOG(ERROR) << "Missing width or height for adding a video info.";
+      return false;
+    }
+    if (!sar_.empty())
+      writer->SetStringAttribute("sar", sar_);
+    if (!(output_suppression_flags_ & kSuppressWidth))
+      writer->SetIntegerAttribute("width", video_info.width());
+    if (!(output_suppression_flags_ & kSuppressHeight))
+      writer->SetIntegerAttribute("height", video_info.height());
+    if (!(output_suppression_flags_ & kSuppressFrameRate))
+      writer->SetStringAttribute("frameRate", frame_rate_);
+    if (video_info.has_trick_play_factor()) {
+      writer->SetIntegerAttribute("maxPlayoutRate",
+                                  video_info.trick_play_factor());
+      writer->SetStringAttribute("codingDependency", "false");
+    }
+  }
+
+  if (media_info_.has_audio_info() &&
+      media_info_.audio_info().has_sampling_frequency()) {
+    writer->SetIntegerAttribute("audioSamplingRate",
+                                media_info_.audio_info().sampling_frequency());
+  }
+
+  const bool has_vod_only_fields = HasVODOnlyFields(media_info_);
+  if (include_duration && has_vod_only_fields &&
+      media_info_.has_media_duration_seconds()) {
+    writer->SetFloatingPointAttribute("duration",
+                                      media_info_.media_duration_seconds());
+  }
+
+  if (media_info_.has_audio_info()) {
+    writer->StartElement("AudioChannelConfiguration");
+    writer->SetStringAttribute("schemeIdUri", audio_channel_scheme_id_uri_);
+    writer->SetStringAttribute("value", audio_channel_value_);
+    writer->EndElement();
+  }
+
+  WriteCachedContentProtectionElements(content_protection_elements_,
+                                       &content_protection_xml_,
+                                       &content_protection_xml_level_, writer);
+
+  if (has_vod_only_fields) {
+    if (media_info_.has_media_file_name()) {
+      writer->StartElement("BaseURL");
+      writer->SetContent(media_info_.media_file_name());
+      writer->EndElement();
+    }
+
+    if (media_info_.has_index_range() || media_info_.has_init_range() ||
+        media_info_.has_reference_time_scale()) {
+      writer->StartElement("SegmentBase");
+      if (media_info_.has_index_range()) {
+        const Range& index_range = media_info_.index_range();
+        writer->SetStringAttribute(
+            "indexRange", base::Uint64ToString(index_range.begin()) + "-" +
+                              base::Uint64ToString(index_range.end()));
+      }
+      if (media_info_.has_reference_time_scale()) {
+        writer->SetIntegerAttribute("timescale",
+                                    media_info_.reference_time_scale());
+      }
+      if (media_info_.has_init_range()) {
+        const Range& init_range = media_info_.init_range();
+        writer->StartElement("Initialization");
+        writer->SetStringAttribute(
+            "range", base::Uint64ToString(init_range.begin()) + "-" +
+                         base::Uint64ToString(init_range.end()));
+        writer->EndElement();
+      }
+      writer->EndElement();
+    }
+  }
+
+  if (HasLiveOnlyFields(media_info_)) {
+    writer->StartElement("SegmentTemplate");
+    if (media_info_.has_reference_time_scale()) {
+      writer->SetIntegerAttribute("timescale",
+                                  media_info_.reference_time_scale());
+    }
+    if (media_info_.has_availability_time_offset_seconds()) {
+      writer->SetFloatingPointAttribute(
+          "availabilityTimeOffset",
+          media_info_.availability_time_offset_seconds());
+    }
+    if (media_info_.has_init_segment_name()) {
+      const std::string& init_segment_name = media_info_.init_segment_name();
+      if (init_segment_name.find("$Number$") != std::string::npos ||
+          init_segment_name.find("$Time$") != std::string::npos) {
+        LOG(ERROR) << "$Number$ and $Time$ cannot be used for "
+                      "SegmentTemplate@initialization";
+        return false;
+      }
+      writer->SetStringAttribute("initialization", init_segment_name);
+    }
+    if (media_info_.has_segment_template()) {
+      writer->SetStringAttribute("media", media_info_.segment_template());
+      if (UseConstantSegmentDuration()) {
+        // The segments are numbered from 1 whatever the window, so there is
+        // nothing to patch.
+        writer->SetIntegerAttribute("duration", constant_segment_duration_);
+        writer->SetIntegerAttribute("startNumber", 1);
+      } else if (media_info_.segment_template().find("$Number") !=
+                 std::string::npos) {
+        DCHECK_GE(start_number_, 1u);
+        if (!skip_patched_fields)
+          writer->SetIntegerAttribute("startNumber", start_number_);
+      }
+    }
+
+    if (!UseConstantSegmentDuration()) {
+      writer->StartElement("SegmentTimeline");
+      if (!skip_patched_fields) {
+        for (const std::string& entry : segment_timeline_entries_)
+          writer->AddSerializedElement(entry);
+      }
+      writer->EndElement();
+    }
+    writer->EndElement();
+  }
+
+  writer->EndElement();
+  output_suppression_flags_ = 0;
+  return true;
+}
+
+void Representation::WriteXmlFragment(size_t level,
+                                      bool include_duration,
+                                      bool skip_patched_fields,
+                                      std::string* output,
+                                      bool* result) {
+  DCHECK(output);
+  DCHECK(result);
+  XmlStringWriter writer(output, level);
+  *result = WriteXml(&writer, include_duration, skip_patched_fields);
+}
+
+void Representation::WritePatch(const std::string& path,
+                                XmlStringWriter* writer) const {
+  DCHECK(writer);
+  const uint64_t bandwidth = GetBandwidth();
+  if (bandwidth != patch_bandwidth_) {
+    StartPatchOperation("replace", path + "/@bandwidth", writer);
+    writer->SetContent(base::Uint64ToString(bandwidth));
+    writer->EndElement();
+  }
+  if (!HasLiveOnlyFields(media_info_) || UseConstantSegmentDuration())
+    return;
+
+  const std::string segment_template_path = path + "/SegmentTemplate";
+  if (start_number_ != patch_start_number_ &&
+      media_info_.has_segment_template() &&
+      media_info_.segment_template().find("$Number") != std::string::npos) {
+    StartPatchOperation("replace", segment_template_path + "/@startNumber",
+                        writer);
+    writer->SetContent(base::UintToString(start_number_));
+    writer->EndElement();
+  }
+
+  // The operations are applied in order, so the entries are always removed
+  // from the front, and the indices of the updated entries are the ones after
+  // the removals.
+  const std::string segment_timeline_path =
+      segment_template_path + "/SegmentTimeline";
+  for (size_t i = 0; i < patch_entries_removed_; ++i) {
+    StartPatchOperation("remove", segment_timeline_path + "/S[1]", writer);
+    writer->EndElement();
+  }
+  if (patch_first_entry_updated_) {
+    StartPatchOperation("replace", segment_timeline_path + "/S[1]", writer);
+    writer->AddSerializedElement(segment_timeline_entries_.front());
+    writer->EndElement();
+  }
+  if (patch_last_entry_updated_ &&
+      !(patch_first_entry_updated_ && patch_entries_left_ == 1)) {
+    StartPatchOperation("replace",
+                        segment_timeline_path + "/S[" +
+                            base::SizeTToString(patch_entries_left_) + "]",
+                        writer);
+    writer->AddSerializedElement(
+        segment_timeline_entries_[patch_entries_left_ - 1]);
+    writer->EndElement();
+  }
+  if (segment_timeline_entries_.size() > patch_entries_left_) {
+    StartPatchOperation("add", segment_timeline_path, writer);
+    for (size_t i = patch_entries_left_; i < segment_timeline_entries_.size();
+         ++i) {
+      writer->AddSerializedElement(segment_timeline_entries_[i]);
+    }
+    writer->EndElement();
+  }
+}
+
+void Representation::ResetPatchBase() {
+  patch_entries_removed_ = 0;
+  patch_entries_left_ = segment_timeline_entries_.size();
+  patch_first_entry_updated_ = false;
+  patch_last_entry_updated_ = false;
+  patch_bandwidth_ = GetBandwidth();
+  patch_start_number_ = start_number_;
+}
+
+void Representation::UpdateFrameRate() {
+  const MediaInfo::VideoInfo& video_info = media_info_.video_info();
+  frame_rate_ = base::IntToString(video_info.time_scale()) + "/" +
+                base::IntToString(video_info.frame_duration());
+}
+
 void Representation::SuppressOnce(SuppressFlag flag) {
   output_suppression_flags_ |= flag;
 }
 
+void Representation::AppendSegmentTimeline(const std::string& indent,
+                                           std::string* output) const {
+  DCHECK(output);
+  if (segment_timeline_entries_.empty()) {
+    output->append("<SegmentTimeline/>");
+    return;
+  }
+  output->append("<SegmentTimeline>\n");
+  for (const std::string& entry : segment_timeline_entries_) {
+    output->append(indent);
+    output->append("  ");
+    output->append(entry);
+    output->append("\n");
+  }
+  output->append(indent);
+  output->append("</SegmentTimeline>");
+}
+
 bool Representation::HasRequiredMediaInfoFields() {
   if (HasVODOnlyFields(media_info_) && HasLiveOnlyFields(media_info_)) {
     LOG(ERROR) << "MediaInfo cannot have both VOD and Live fields.";
@@ -1278,6 +1989,50 @@ bool Representation::IsContiguous(uint64_t start_time,
   return false;
 }
 
+uint64_t Representation::EstimateBandwidth() const {
+  if (mpd_options_.peak_bandwidth_window > 0)
+    return bandwidth_estimator_.Max();
+  return bandwidth_estimator_.Estimate();
+}
+
+void Representation::CheckConstantSegmentDuration(uint64_t start_time,
+                                                  uint64_t duration) {
+  if (num_segments_added_ == 0)
+    constant_segment_duration_ = duration;
+  const uint64_t nominal_start_time =
+      num_segments_added_ * constant_segment_duration_;
+  ++num_segments_added_;
+  if (!segments_at_nominal_times_)
+    return;
+
+  // Players locate segment N at (N - 1) * @duration, so allow the same drift
+  // as DASH-IF IOP: half a segment.
+  const uint64_t drift = start_time > nominal_start_time
+                             ? start_time - nominal_start_time
+                             : nominal_start_time - start_time;
+  if (constant_segment_duration_ == 0 ||
+      drift > constant_segment_duration_ / 2) {
+    LOG(WARNING) << "Segment " << num_segments_added_ << " of Representation "
+                 << id_ << " starts at " << start_time << " instead of "
+                 << nominal_start_time
+                 << ". Using SegmentTimeline instead of "
+                    "SegmentTemplate@duration.";
+    segments_at_nominal_times_ = false;
+  }
+}
+
+bool Representation::UseConstantSegmentDuration() const {
+  return mpd_options_.segment_template_constant_duration &&
+         segments_at_nominal_times_ && constant_segment_duration_ > 0 &&
+         media_info_.has_segment_template() &&
+         media_info_.segment_template().find("$Number") != std::string::npos;
+}
+
+uint64_t Representation::GetBandwidth() const {
+  return media_info_.has_bandwidth() ? media_info_.bandwidth()
+                                     : EstimateBandwidth();
+}
+
 void Representation::SlideWindow() {
   DCHECK(!segment_infos_.empty());
   if (mpd_options_.time_shift_buffer_depth <= 0.0)
@@ -1298,17 +2053,22 @@ void Representation::SlideWindow() {
   const uint64_t timeshift_limit = current_play_time - time_shift_buffer_depth;
 
   // First remove all the SegmentInfos that are completely out of range, by
-  // looking at the very last segment's end time.
-  std::list<SegmentInfo>::iterator first = segment_infos_.begin();
-  std::list<SegmentInfo>::iterator last = first;
+  // looking at the very last segment's end time. Each entry is removed once,
+  // so this is amortized constant time per added segment.
   size_t num_segments_removed = 0;
-  for (; last != segment_infos_.end(); ++last) {
-    const uint64_t last_segment_end_time = LastSegmentEndTime(*last);
-    if (timeshift_limit < last_segment_end_time)
-      break;
-    num_segments_removed += last->repeat + 1;
+  while (!segment_infos_.empty() &&
+         LastSegmentEndTime(segment_infos_.front()) <= timeshift_limit) {
+    num_segments_removed += segment_infos_.front().repeat + 1;
+    segment_infos_.pop_front();
+    segment_timeline_entries_.pop_front();
+    if (patch_entries_left_ > 0) {
+      ++patch_entries_removed_;
+      --patch_entries_left_;
+      patch_first_entry_updated_ = false;
+      if (patch_entries_left_ == 0)
+        patch_last_entry_updated_ = false;
+    }
   }
-  segment_infos_.erase(first, last);
   start_number_ += num_segments_removed;
 
   // Now some segment in the first SegmentInfo should be left in the list.
@@ -1326,6 +2086,10 @@ void Representation::SlideWindow() {
                                    first_segment_info->duration * repeat_index;
 
   first_segment_info->repeat = first_segment_info->repeat - repeat_index;
+  segment_timeline_entries_.front() =
+      SegmentInfoToSElement(*first_segment_info);
+  if (patch_entries_left_ > 0)
+    patch_first_entry_updated_ = true;
   start_number_ += repeat_index;
 }
 
@@ -17,6 +17,7 @@
 
 #include <stdint.h>
 
+#include <deque>
 #include <list>
 #include <map>
 #include <set>
@@ -28,6 +29,7 @@
 #include "packager/base/stl_util.h"
 #include "packager/base/time/clock.h"
 #include "packager/base/time/time.h"
+#include "packager/media/base/memory_tracker.h"
 #include "packager/mpd/base/bandwidth_estimator.h"
 #include "packager/mpd/base/content_protection_element.h"
 #include "packager/mpd/base/media_info.pb.h"
@@ -42,6 +44,7 @@ namespace edash_packager {
 
 namespace media {
 class File;
+class ThreadPool;
 }  // namespace media
 
 class AdaptationSet;
@@ -50,6 +53,7 @@ class Representation;
 namespace xml {
 
 class XmlNode;
+class XmlStringWriter;
 class RepresentationXmlNode;
 
 }  // namespace xml
@@ -89,9 +93,35 @@ class MpdBuilder {
   /// @return true on success, false otherwise.
   virtual bool ToString(std::string* output);
 
+  /// Writes the MPD, and the MPD Patch document which updates the MPD written
+  /// by the previous call to this one. This is only for 'dynamic' MPDs with
+  /// MpdOptions::mpd_patch_location set. The patch is built from the changes
+  /// of the segment timelines, so its size does not depend on the size of the
+  /// time shift buffer.
+  /// @param[out] mpd is where the MPD gets written.
+  /// @param[out] patch is where the MPD Patch gets written. It is empty on the
+  ///             first call, or if the MPD changed beyond what a patch
+  ///             updates, e.g. a Representation was added. Players then fetch
+  ///             the full MPD.
+  /// @return true on success, false otherwise.
+  virtual bool ToStringWithPatch(std::string* mpd, std::string* patch);
+
   /// @return The mpd type.
   MpdType type() const { return type_; }
 
+  /// @return The availabilityStartTime of a 'dynamic' MPD. It is empty until
+  ///         the first segment is written.
+  const std::string& availability_start_time() const {
+    return availability_start_time_;
+  }
+
+  /// Sets the availabilityStartTime of a 'dynamic' MPD, e.g. to the one of
+  /// the MPD generated before the packager restarted, instead of computing it
+  /// from the current time.
+  void set_availability_start_time(const std::string& availability_start_time) {
+    availability_start_time_ = availability_start_time;
+  }
+
   /// Adjusts the fields of MediaInfo so that paths are relative to the
   /// specified MPD path.
   /// @param mpd_path is the file path of the MPD file.
@@ -110,6 +140,8 @@ class MpdBuilder {
   // DynamicMpdBuilderTest needs to set availabilityStartTime so that the test
   // doesn't need to depend on current time.
   friend class DynamicMpdBuilderTest;
+  template <MpdType type>
+  friend class MpdBuilderTest;
 
   bool ToStringImpl(std::string* output);
 
@@ -120,22 +152,54 @@ class MpdBuilder {
 
   // Returns the document pointer to the MPD. This must be freed by the caller
   // using appropriate xmlDocPtr freeing function.
+  // The SegmentTimeline elements only contain placeholders, which are replaced
+  // by InsertSegmentTimelines() once the document is serialized.
   // On failure, this returns NULL.
   xmlDocPtr GenerateMpd();
 
+  // Copies |mpd| to |output|, replacing the SegmentTimeline placeholders with
+  // the <S> elements serialized by the Representations. This avoids building
+  // and serializing the XML nodes of every segment on each update.
+  // Returns true on success, false otherwise.
+  bool InsertSegmentTimelines(const std::string& mpd, std::string* output);
+
+  // Writes the MPD to |output| with an xml::XmlStringWriter, which gives the
+  // same document as GenerateMpd() without building the XML tree.
+  // If |skip_patched_fields| is true, the fields which an MPD Patch updates,
+  // i.e. publishTime, Representation@bandwidth, SegmentTemplate@startNumber
+  // and the SegmentTimeline entries, are left out. Two such documents are the
+  // same iff an MPD Patch can update one MPD to the other.
+  // Returns true on success, false otherwise.
+  bool WriteMpdToString(std::string* output, bool skip_patched_fields);
+
+  // Writes the MPD Patch document which updates the MPD published at
+  // |patch_publish_time_| to the one published at |publish_time_|.
+  void WritePatch(std::string* output);
+
   // Set MPD attributes common to all profiles. Uses non-zero |mpd_options_| to
   // set attributes for the MPD.
-  void AddCommonMpdInfo(xml::XmlNode* mpd_node);
-
-  // Adds 'static' MPD attributes and elements to |mpd_node|. This assumes that
-  // the first child element is a Period element.
-  void AddStaticMpdInfo(xml::XmlNode* mpd_node);
-
-  // Same as AddStaticMpdInfo() but for 'dynamic' MPDs.
-  void AddDynamicMpdInfo(xml::XmlNode* mpd_node);
-
+  // |XmlElement| is xml::XmlNode or xml::XmlStringWriter.
+  template <typename XmlElement>
+  void AddCommonMpdInfo(XmlElement* mpd_node);
+
+  // Adds 'static' MPD attributes to |mpd_node|. |duration| is the
+  // mediaPresentationDuration in seconds.
+  template <typename XmlElement>
+  void AddStaticMpdInfo(XmlElement* mpd_node, float duration);
+
+  // Same as AddStaticMpdInfo() but for 'dynamic' MPDs. publishTime is left
+  // out if |skip_patched_fields| is true.
+  template <typename XmlElement>
+  void AddDynamicMpdInfo(XmlElement* mpd_node, bool skip_patched_fields);
+
+  // Returns the longest duration of the Representations and removes their
+  // 'duration' attributes. This assumes that the first child element of
+  // |mpd_node| is a Period element.
   float GetStaticMpdDuration(xml::XmlNode* mpd_node);
 
+  // Same as above, but computed from the MediaInfo of the Representations.
+  float GetStaticMpdDuration();
+
   // Set MPD attributes for dynamic profile MPD. Uses non-zero |mpd_options_| as
   // well as various calculations to set attributes for the MPD.
   void SetDynamicMpdAttributes(xml::XmlNode* mpd_node);
@@ -151,6 +215,22 @@ class MpdBuilder {
 
   std::list<std::string> base_urls_;
   std::string availability_start_time_;
+  // publishTime of the last MPD generated.
+  std::string publish_time_;
+
+  // The MPD written by the last call to ToStringWithPatch(), which the next
+  // MPD Patch updates: its publishTime, and the same MPD written without the
+  // fields updated by the patch.
+  std::string patch_publish_time_;
+  std::string patch_base_mpd_;
+
+  // Size of the last MPD written with the streaming writer, used to pre-size
+  // the next one.
+  size_t mpd_size_hint_;
+
+  // The threads serializing the Representations in parallel, created on the
+  // first MPD written with MpdOptions::num_xml_threads greater than 1.
+  scoped_ptr<media::ThreadPool> xml_thread_pool_;
 
   base::AtomicSequenceNumber adaptation_set_counter_;
   base::AtomicSequenceNumber representation_counter_;
@@ -221,6 +301,13 @@ class AdaptationSet {
   /// @param role of this AdaptationSet.
   virtual void AddRole(Role role);
 
+  /// Marks this AdaptationSet as the trick play version of another one, with
+  /// an EssentialProperty element of scheme
+  /// 'http://dashif.org/guidelines/trickmode'. See DASH-IF IOP 3.2.9.
+  /// @param adaptation_set_id is the id of the AdaptationSet of the main
+  ///        stream.
+  virtual void AddTrickPlayReferenceId(uint32_t adaptation_set_id);
+
   /// Makes a copy of AdaptationSet xml element with its child Representation
   /// and ContentProtection elements.
   /// @return On success returns a non-NULL scoped_xml_ptr. Otherwise returns a
@@ -297,6 +384,28 @@ class AdaptationSet {
   template <MpdBuilder::MpdType type>
   friend class MpdBuilderTest;
 
+  // Same as GetXml(). If |segment_timeline_placeholders| is true, the
+  // SegmentTimeline elements of the Representations only contain a
+  // placeholder, see MpdBuilder::InsertSegmentTimelines().
+  xml::scoped_xml_ptr<xmlNode> GetXmlInternal(
+      bool segment_timeline_placeholders);
+
+  // Writes the AdaptationSet element with its children to |writer|. The
+  // output is the same as GetXml().
+  // Returns true on success, false otherwise.
+  // |skip_patched_fields| is the same as in MpdBuilder::WriteMpdToString().
+  // The Representations are serialized on |thread_pool|, if not NULL.
+  bool WriteXml(xml::XmlStringWriter* writer,
+                bool skip_patched_fields,
+                media::ThreadPool* thread_pool);
+
+  // Sets the attributes of the AdaptationSet element to |adaptation_set|,
+  // which is xml::AdaptationSetXmlNode or xml::XmlStringWriter.
+  // Returns the Representation::SuppressFlag bits for the attributes that
+  // are redundant in the Representations.
+  template <typename XmlElement>
+  int SetXmlAttributes(XmlElement* adaptation_set);
+
   // kSegmentAlignmentUnknown means that it is uncertain if the
   // (sub)segments are aligned or not.
   // kSegmentAlignmentTrue means that it is certain that the all the (current)
@@ -341,6 +450,10 @@ class AdaptationSet {
   void RecordFrameRate(uint32_t frame_duration, uint32_t timescale);
 
   std::list<ContentProtectionElement> content_protection_elements_;
+  // |content_protection_elements_| serialized for WriteXml(), indented for
+  // |content_protection_xml_level_|, 0 once they have changed.
+  std::string content_protection_xml_;
+  size_t content_protection_xml_level_;
   std::list<Representation*> representations_;
   STLElementDeleter<std::list<Representation*> > representations_deleter_;
 
@@ -348,6 +461,8 @@ class AdaptationSet {
 
   const uint32_t id_;
   const std::string lang_;
+  // The 'lang' attribute, computed once from |lang_|. Empty if not written.
+  const std::string lang_attribute_;
   const MpdOptions& mpd_options_;
   const MpdBuilder::MpdType mpd_type_;
 
@@ -387,6 +502,9 @@ class AdaptationSet {
   // The roles of this AdaptationSet.
   std::set<Role> roles_;
 
+  // The ids of the AdaptationSets this is the trick play version of.
+  std::set<uint32_t> trick_play_reference_ids_;
+
   // True iff all the segments are aligned.
   SegmentAligmentStatus segments_aligned_;
   bool force_set_segment_alignment_;
@@ -519,9 +637,46 @@ class Representation {
 
  private:
   friend class AdaptationSet;
+  friend class MpdBuilder;
   template <MpdBuilder::MpdType type>
   friend class MpdBuilderTest;
 
+  // Same as GetXml(). If |segment_timeline_placeholder| is true, the
+  // SegmentTimeline element only contains a placeholder.
+  xml::scoped_xml_ptr<xmlNode> GetXmlInternal(
+      bool segment_timeline_placeholder);
+
+  // Writes the Representation element with its children to |writer|. The
+  // output is the same as GetXml(), except that the 'duration' attribute is
+  // only written if |include_duration| is true. |skip_patched_fields| is the
+  // same as in MpdBuilder::WriteMpdToString().
+  // Returns true on success, false otherwise.
+  bool WriteXml(xml::XmlStringWriter* writer,
+                bool include_duration,
+                bool skip_patched_fields);
+
+  // Same as WriteXml(), but writes a fragment for the children at |level| to
+  // |output|, and sets |result| to the return value. Runs on the threads
+  // serializing the Representations in parallel.
+  void WriteXmlFragment(size_t level,
+                        bool include_duration,
+                        bool skip_patched_fields,
+                        std::string* output,
+                        bool* result);
+
+  // Writes the MPD Patch operations which update this Representation, as it
+  // was in the MPD the patch applies to, to its current state. |path| selects
+  // the Representation element.
+  void WritePatch(const std::string& path, xml::XmlStringWriter* writer) const;
+
+  // Makes the current state the base of the next MPD Patch.
+  void ResetPatchBase();
+
+  // Appends the SegmentTimeline element, with |segment_timeline_entries_| as
+  // children, to |output|. |indent| is the indentation of the element.
+  void AppendSegmentTimeline(const std::string& indent,
+                             std::string* output) const;
+
   bool AddLiveInfo(xml::RepresentationXmlNode* representation);
 
   // Returns true if |media_info_| has required fields to generate a valid
@@ -539,6 +694,26 @@ class Representation {
   // |start_number_| by the number of segments removed.
   void SlideWindow();
 
+  // Checks whether the segment added, the |num_segments_added_|th, starts where
+  // SegmentTemplate@duration puts it. Otherwise falls back to SegmentTimeline
+  // for good.
+  void CheckConstantSegmentDuration(uint64_t start_time, uint64_t duration);
+
+  // Returns true if the segments are addressed with SegmentTemplate@duration,
+  // as configured by mpd_options_.segment_template_constant_duration.
+  bool UseConstantSegmentDuration() const;
+
+  // Return the bandwidth computed from the segments, as configured by
+  // mpd_options_.peak_bandwidth_window.
+  uint64_t EstimateBandwidth() const;
+
+  // Returns the 'bandwidth' attribute, from |media_info_| if set, otherwise
+  // estimated.
+  uint64_t GetBandwidth() const;
+
+  // Sets |frame_rate_| from the video info of |media_info_|.
+  void UpdateFrameRate();
+
   // Note: Because 'mimeType' is a required field for a valid MPD, these return
   // strings.
   std::string GetVideoMimeType() const;
@@ -553,11 +728,32 @@ class Representation {
   // any logic using this can assume only one set.
   MediaInfo media_info_;
   std::list<ContentProtectionElement> content_protection_elements_;
-  std::list<SegmentInfo> segment_infos_;
+  // Same as AdaptationSet::content_protection_xml_.
+  std::string content_protection_xml_;
+  size_t content_protection_xml_level_;
+  // Run-length encoded segments, i.e. one entry per <S> element. Segments are
+  // only appended at the back and removed from the front, so a deque keeps
+  // the entries in a few contiguous blocks instead of a node per entry.
+  std::deque<SegmentInfo> segment_infos_;
+  // Serialized <S> element of each SegmentInfo in |segment_infos_|. They are
+  // updated as segments are added or removed, so only the changed ones are
+  // serialized again.
+  std::deque<std::string> segment_timeline_entries_;
+  // Accounts the estimated size of |segment_infos_| and
+  // |segment_timeline_entries_|.
+  media::TrackedMemory segment_infos_memory_;
 
   const uint32_t id_;
+  // The attributes which only depend on |media_info_| are computed once, in
+  // Init(), instead of each time the MPD is generated.
   std::string mime_type_;
   std::string codecs_;
+  // 'sar' and 'frameRate' attributes, for video.
+  std::string sar_;
+  std::string frame_rate_;
+  // AudioChannelConfiguration element, for audio.
+  std::string audio_channel_scheme_id_uri_;
+  std::string audio_channel_value_;
   BandwidthEstimator bandwidth_estimator_;
   const MpdOptions& mpd_options_;
 
@@ -565,6 +761,25 @@ class Representation {
   // Starts from 1.
   uint32_t start_number_;
 
+  // SegmentTemplate@duration, i.e. the duration of the first segment, the
+  // number of segments added and whether they all started close enough to
+  // their nominal time for it.
+  uint64_t constant_segment_duration_;
+  uint64_t num_segments_added_;
+  bool segments_at_nominal_times_;
+
+  // Changes since the base of the next MPD Patch: the number of <S> entries of
+  // the base removed from the front of the timeline, the number of those left,
+  // which come before the entries added since, and whether the first and the
+  // last of those left were updated.
+  size_t patch_entries_removed_;
+  size_t patch_entries_left_;
+  bool patch_first_entry_updated_;
+  bool patch_last_entry_updated_;
+  // 'bandwidth' and 'startNumber' attributes in the base.
+  uint64_t patch_bandwidth_;
+  uint32_t patch_start_number_;
+
   // If this is not null, then Representation is responsible for calling the
   // right methods at right timings.
   scoped_ptr<RepresentationStateChangeListener> state_change_listener_;
@@ -111,13 +111,28 @@ class MpdBuilderTest : public ::testing::Test {
 
   void CheckMpd(const std::string& expected_output_file) {
     std::string mpd_doc;
-    ASSERT_TRUE(mpd_.ToString(&mpd_doc));
+    ASSERT_NO_FATAL_FAILURE(MpdToString(&mpd_doc));
     ASSERT_TRUE(ValidateMpdSchema(mpd_doc));
 
     ASSERT_NO_FATAL_FAILURE(
         ExpectMpdToEqualExpectedOutputFile(mpd_doc, expected_output_file));
   }
 
+  // Writes the MPD to |mpd_doc| with the libxml2 tree, and checks that the
+  // streaming writer generates exactly the same document.
+  void MpdToString(std::string* mpd_doc) {
+    const bool use_streaming_mpd_writer =
+        mpd_.mpd_options_.use_streaming_mpd_writer;
+    mpd_.mpd_options_.use_streaming_mpd_writer = false;
+    ASSERT_TRUE(mpd_.ToString(mpd_doc));
+
+    std::string streaming_mpd_doc;
+    mpd_.mpd_options_.use_streaming_mpd_writer = true;
+    ASSERT_TRUE(mpd_.ToString(&streaming_mpd_doc));
+    mpd_.mpd_options_.use_streaming_mpd_writer = use_streaming_mpd_writer;
+    EXPECT_EQ(*mpd_doc, streaming_mpd_doc);
+  }
+
  protected:
   // Creates a new AdaptationSet and adds a Representation element using
   // |media_info|.
@@ -307,7 +322,7 @@ class SegmentTemplateTest : public DynamicMpdBuilderTest {
 
   void CheckMpdAgainstExpectedResult() {
     std::string mpd_doc;
-    ASSERT_TRUE(mpd_.ToString(&mpd_doc));
+    ASSERT_NO_FATAL_FAILURE(MpdToString(&mpd_doc));
     ASSERT_TRUE(ValidateMpdSchema(mpd_doc));
     const std::string& expected_output =
         TemplateOutputInsertValues(expected_s_elements_,
@@ -396,7 +411,7 @@ class TimeShiftBufferDepthTest : public SegmentTemplateTest {
                            expected_s_element.c_str());
 
     std::string mpd_doc;
-    ASSERT_TRUE(mpd_.ToString(&mpd_doc));
+    ASSERT_NO_FATAL_FAILURE(MpdToString(&mpd_doc));
     ASSERT_TRUE(ValidateMpdSchema(mpd_doc));
     ASSERT_TRUE(XmlEqual(expected_out, mpd_doc))
         << "Expected " << expected_out << std::endl << "Actual: " << mpd_doc;
@@ -422,6 +437,40 @@ TEST_F(CommonMpdBuilderTest, SetAdaptationSetGroup) {
       ExpectAttributeNotSet("group", xml_without_group.get()));
 }
 
+// Verify that the bandwidth is the peak bitrate of the latest segments if
+// MpdOptions::peak_bandwidth_window is set.
+TEST_F(CommonMpdBuilderTest, PeakBandwidthOfLatestSegments) {
+  const char kTestMediaInfo[] =
+      "video_info {\n"
+      "  codec: 'avc1'\n"
+      "  width: 720\n"
+      "  height: 480\n"
+      "  time_scale: 10\n"
+      "  frame_duration: 10\n"
+      "  pixel_width: 1\n"
+      "  pixel_height: 1\n"
+      "}\n"
+      "reference_time_scale: 10\n"
+      "container_type: 1\n";
+  MpdOptions mpd_options;
+  mpd_options.peak_bandwidth_window = 2;
+  auto representation =
+      CreateRepresentation(ConvertToMediaInfo(kTestMediaInfo), mpd_options,
+                           kAnyRepresentationId, NoListener());
+  EXPECT_TRUE(representation->Init());
+
+  // One second segments of 800, 2400, 1600 and 800 bits per second.
+  const uint64_t kDuration = 10;
+  representation->AddNewSegment(0, kDuration, 100);
+  representation->AddNewSegment(10, kDuration, 300);
+  representation->AddNewSegment(20, kDuration, 200);
+  representation->AddNewSegment(30, kDuration, 100);
+
+  xml::scoped_xml_ptr<xmlNode> node_xml(representation->GetXml());
+  EXPECT_NO_FATAL_FAILURE(
+      ExpectAttributeEqString("bandwidth", "1600", node_xml.get()));
+}
+
 // Verify that Representation::Init() works with all "required" fields of
 // MedieInfo proto.
 TEST_F(CommonMpdBuilderTest, ValidMediaInfo) {
@@ -1581,6 +1630,55 @@ TEST_F(StaticMpdBuilderTest, AdapatationSetWidthAndHeight) {
       ExpectAttributeNotSet("maxHeight", adaptation_set_xml.get()));
 }
 
+// Verify that a trick play AdaptationSet refers to the main one, and that its
+// Representations are marked as such.
+TEST_F(StaticMpdBuilderTest, TrickPlay) {
+  const char kVideoMediaInfo[] =
+      "video_info {\n"
+      "  codec: \"avc1\"\n"
+      "  width: 1280\n"
+      "  height: 720\n"
+      "  time_scale: 3000\n"
+      "  frame_duration: 100\n"
+      "}\n"
+      "container_type: 1\n";
+  const char kTrickPlayVideoMediaInfo[] =
+      "video_info {\n"
+      "  codec: \"avc1\"\n"
+      "  width: 1280\n"
+      "  height: 720\n"
+      "  time_scale: 3000\n"
+      "  frame_duration: 100\n"
+      "  trick_play_factor: 4\n"
+      "}\n"
+      "container_type: 1\n";
+  AdaptationSet* video_adaptation_set = mpd_.AddAdaptationSet("");
+  ASSERT_TRUE(video_adaptation_set);
+  ASSERT_TRUE(video_adaptation_set->AddRepresentation(
+      ConvertToMediaInfo(kVideoMediaInfo)));
+  AdaptationSet* trick_play_adaptation_set = mpd_.AddAdaptationSet("");
+  ASSERT_TRUE(trick_play_adaptation_set);
+  ASSERT_TRUE(trick_play_adaptation_set->AddRepresentation(
+      ConvertToMediaInfo(kTrickPlayVideoMediaInfo)));
+  trick_play_adaptation_set->AddTrickPlayReferenceId(
+      video_adaptation_set->id());
+
+  std::string mpd_doc;
+  ASSERT_NO_FATAL_FAILURE(MpdToString(&mpd_doc));
+  ASSERT_TRUE(ValidateMpdSchema(mpd_doc));
+  EXPECT_NE(std::string::npos,
+            mpd_doc.find("<EssentialProperty "
+                         "schemeIdUri=\"http://dashif.org/guidelines/"
+                         "trickmode\" value=\"0\"/>"))
+      << mpd_doc;
+  // Only the trick play AdaptationSet has one.
+  EXPECT_EQ(mpd_doc.find("<EssentialProperty"),
+            mpd_doc.rfind("<EssentialProperty"));
+  EXPECT_NE(std::string::npos,
+            mpd_doc.find("maxPlayoutRate=\"4\" codingDependency=\"false\""))
+      << mpd_doc;
+}
+
 // Verify that the maxWidth and maxHeight attribute are set if there are
 // multiple video resolutions.
 TEST_F(StaticMpdBuilderTest, AdapatationSetMaxWidthAndMaxHeight) {
@@ -1665,6 +1763,45 @@ TEST_F(CommonMpdBuilderTest, SetSampleDuration) {
       ExpectAttributeEqString("frameRate", "3000/2", adaptation_set_xml.get()));
 }
 
+// Verify that the Representation@frameRate written in the MPD follows
+// Representation::SetSampleDuration().
+TEST_F(StaticMpdBuilderTest, RepresentationFrameRateFollowsSampleDuration) {
+  const char k1080pMediaInfo[] =
+      "video_info {\n"
+      "  codec: 'avc1'\n"
+      "  width: 1920\n"
+      "  height: 1080\n"
+      "  time_scale: 3000\n"
+      "  frame_duration: 100\n"
+      "}\n"
+      "container_type: 1\n";
+  const char k720pMediaInfo[] =
+      "video_info {\n"
+      "  codec: 'avc1'\n"
+      "  width: 1280\n"
+      "  height: 720\n"
+      "  time_scale: 3000\n"
+      "  frame_duration: 200\n"
+      "}\n"
+      "container_type: 1\n";
+
+  AdaptationSet* adaptation_set = mpd_.AddAdaptationSet("");
+  Representation* representation_1080p =
+      adaptation_set->AddRepresentation(ConvertToMediaInfo(k1080pMediaInfo));
+  ASSERT_TRUE(representation_1080p);
+  ASSERT_TRUE(
+      adaptation_set->AddRepresentation(ConvertToMediaInfo(k720pMediaInfo)));
+
+  std::string mpd_output;
+  ASSERT_TRUE(mpd_.ToString(&mpd_output));
+  EXPECT_NE(std::string::npos, mpd_output.find("frameRate=\"3000/100\""));
+
+  representation_1080p->SetSampleDuration(50u);
+  ASSERT_TRUE(mpd_.ToString(&mpd_output));
+  EXPECT_EQ(std::string::npos, mpd_output.find("frameRate=\"3000/100\""));
+  EXPECT_NE(std::string::npos, mpd_output.find("frameRate=\"3000/50\""));
+}
+
 // Verify that AdaptationSet::AddContentProtection() and
 // UpdateContentProtectionPssh() works.
 TEST_F(CommonMpdBuilderTest, AdaptationSetAddContentProtectionAndUpdate) {
@@ -1854,6 +1991,20 @@ TEST_F(StaticMpdBuilderTest, TwoVideosWithDifferentResolutions) {
   EXPECT_NO_FATAL_FAILURE(CheckMpd(kFileNameExpectedMpdOutputVideo1And2));
 }
 
+// The Representations serialized in parallel are added in order.
+TEST_F(StaticMpdBuilderTest, ParallelXmlWriter) {
+  mpd_.mpd_options_.num_xml_threads = 4;
+  AdaptationSet* adaptation_set = mpd_.AddAdaptationSet("");
+
+  MediaInfo media_info1 = GetTestMediaInfo(kFileNameVideoMediaInfo1);
+  ASSERT_TRUE(adaptation_set->AddRepresentation(media_info1));
+
+  MediaInfo media_info2 = GetTestMediaInfo(kFileNameVideoMediaInfo2);
+  ASSERT_TRUE(adaptation_set->AddRepresentation(media_info2));
+
+  EXPECT_NO_FATAL_FAILURE(CheckMpd(kFileNameExpectedMpdOutputVideo1And2));
+}
+
 // Add both video and audio and check the output.
 TEST_F(StaticMpdBuilderTest, VideoAndAudio) {
   MediaInfo video_media_info = GetTestMediaInfo(kFileNameVideoMediaInfo1);
@@ -2190,6 +2341,47 @@ TEST_F(SegmentTemplateTest, OverlappingSegmentsWithinErrorRange) {
   ASSERT_NO_FATAL_FAILURE(CheckMpdAgainstExpectedResult());
 }
 
+// The serialized <S> elements are spliced into the MPD. Verify that the result
+// is identical to what libxml generates for the whole SegmentTimeline, as the
+// SegmentTimeline is updated between the MPD updates.
+TEST_F(SegmentTemplateTest, SegmentTimelineSameAsXmlOutput) {
+  const uint64_t kDuration = 1000;
+  const uint64_t kSize = 123456;
+  uint64_t start_time = 0;
+  for (int i = 0; i < 5; ++i) {
+    // Alternate between repeated segments and new S elements.
+    const uint64_t kRepeat = i % 2;
+    AddSegments(start_time, kDuration + i, kSize, kRepeat);
+    start_time += (kDuration + i) * (kRepeat + 1);
+
+    std::string mpd_doc;
+    ASSERT_TRUE(mpd_.ToString(&mpd_doc));
+
+    xml::scoped_xml_ptr<xmlNode> representation_xml(
+        representation_->GetXml());
+    ASSERT_TRUE(representation_xml);
+    xmlNodePtr segment_template =
+        xmlFirstElementChild(representation_xml.get());
+    ASSERT_TRUE(segment_template);
+    xmlNodePtr segment_timeline = xmlFirstElementChild(segment_template);
+    ASSERT_TRUE(segment_timeline);
+
+    // SegmentTimeline is at depth 5 in the MPD.
+    const int kSegmentTimelineLevel = 5;
+    const int kFormat = 1;
+    xml::scoped_xml_ptr<xmlBuffer> buffer(xmlBufferCreate());
+    xmlNodeDump(buffer.get(), NULL, segment_timeline, kSegmentTimelineLevel,
+                kFormat);
+    const std::string expected_segment_timeline =
+        std::string(2 * kSegmentTimelineLevel, ' ') +
+        reinterpret_cast<const char*>(xmlBufferContent(buffer.get())) + "\n";
+    EXPECT_NE(std::string::npos, mpd_doc.find(expected_segment_timeline))
+        << "Expected SegmentTimeline " << expected_segment_timeline
+        << " in " << mpd_doc;
+  }
+  ASSERT_NO_FATAL_FAILURE(CheckMpdAgainstExpectedResult());
+}
+
 // All segments have the same duration and size.
 TEST_F(TimeShiftBufferDepthTest, Normal) {
   const int kTimeShiftBufferDepth = 10;  // 10 sec.
@@ -2471,6 +2663,114 @@ TEST_F(TimeShiftBufferDepthTest, ManySegments) {
       kDefaultStartNumber + kExpectedRemovedSegments));
 }
 
+// The MPD Patches carry the changes of the segment timeline since the
+// previous MPD, and there is none when the MPD changes otherwise.
+TEST_F(TimeShiftBufferDepthTest, MpdPatch) {
+  const int kTimeShiftBufferDepth = 2;
+  mutable_mpd_options()->time_shift_buffer_depth = kTimeShiftBufferDepth;
+  mutable_mpd_options()->mpd_patch_location = "patch.mpp";
+
+  const uint64_t kDuration = DefaultTimeScale();
+  const uint64_t kSize = 10000;
+  AddSegments(0, kDuration, kSize, 2);
+
+  std::string mpd_doc;
+  std::string patch;
+  ASSERT_TRUE(mpd_.ToStringWithPatch(&mpd_doc, &patch));
+  EXPECT_EQ(std::string(), patch);
+  EXPECT_NE(std::string::npos, mpd_doc.find("<MPD id=\"0\""));
+  EXPECT_NE(std::string::npos,
+            mpd_doc.find("<PatchLocation>patch.mpp</PatchLocation>"));
+
+  const char kPatchTemplate[] =
+      "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+      "<Patch xmlns=\"urn:mpeg:dash:schema:mpd-patch:2020\" mpdId=\"0\" "
+      " originalPublishTime=\"2016-01-11T15:10:24Z\" "
+      " publishTime=\"2016-01-11T15:10:24Z\">\n"
+      "  <replace sel=\"/MPD/@publishTime\">2016-01-11T15:10:24Z</replace>\n"
+      "  <replace sel=\"/MPD/Period[@id='0']/AdaptationSet[@id='0']/"
+      "Representation[@id='0']/SegmentTemplate/@startNumber\">%d</replace>\n"
+      "  <replace sel=\"/MPD/Period[@id='0']/AdaptationSet[@id='0']/"
+      "Representation[@id='0']/SegmentTemplate/SegmentTimeline/S[1]\">\n"
+      "    %s\n"
+      "  </replace>\n"
+      "%s"
+      "</Patch>\n";
+
+  // The first segment leaves the window, so the first <S> is updated.
+  AddSegments(3 * kDuration, kDuration, kSize, 0);
+  ASSERT_TRUE(mpd_.ToStringWithPatch(&mpd_doc, &patch));
+  std::string expected_patch = base::StringPrintf(
+      kPatchTemplate, 2,
+      base::StringPrintf(kSElementTemplate, kDuration, kDuration,
+                         static_cast<uint64_t>(2)).c_str(),
+      "");
+  EXPECT_TRUE(XmlEqual(expected_patch, patch))
+      << "Expected " << expected_patch << std::endl << "Actual: " << patch;
+
+  // After a gap, a new <S> is added.
+  AddSegments(5 * kDuration, kDuration, kSize, 0);
+  ASSERT_TRUE(mpd_.ToStringWithPatch(&mpd_doc, &patch));
+  const std::string added_s_element =
+      "  <add sel=\"/MPD/Period[@id='0']/AdaptationSet[@id='0']/"
+      "Representation[@id='0']/SegmentTemplate/SegmentTimeline\">\n    " +
+      base::StringPrintf(kSElementTemplateWithoutR, 5 * kDuration, kDuration) +
+      "\n  </add>\n";
+  expected_patch = base::StringPrintf(
+      kPatchTemplate, 4,
+      base::StringPrintf(kSElementTemplateWithoutR, 3 * kDuration, kDuration)
+          .c_str(),
+      added_s_element.c_str());
+  EXPECT_TRUE(XmlEqual(expected_patch, patch))
+      << "Expected " << expected_patch << std::endl << "Actual: " << patch;
+
+  // The MPD written with the patch is the same as ToString() writes.
+  std::string expected_mpd_doc;
+  ASSERT_NO_FATAL_FAILURE(MpdToString(&expected_mpd_doc));
+  EXPECT_EQ(expected_mpd_doc, mpd_doc);
+
+  // A new Representation cannot be added by a patch.
+  ASSERT_NO_FATAL_FAILURE(
+      AddRepresentation(ConvertToMediaInfo(GetDefaultMediaInfo())));
+  ASSERT_TRUE(mpd_.ToStringWithPatch(&mpd_doc, &patch));
+  EXPECT_EQ(std::string(), patch);
+}
+
+// With segment_template_constant_duration, SegmentTemplate@duration replaces
+// the SegmentTimeline until a segment is not where @duration puts it.
+TEST_F(TimeShiftBufferDepthTest, ConstantSegmentDuration) {
+  const int kTimeShiftBufferDepth = 2;
+  mutable_mpd_options()->time_shift_buffer_depth = kTimeShiftBufferDepth;
+  mutable_mpd_options()->segment_template_constant_duration = true;
+
+  const uint64_t kDuration = DefaultTimeScale();
+  const uint64_t kSize = 10000;
+  const uint64_t kSlightDrift = kDuration / 10;
+  AddSegments(0, kDuration, kSize, 3);
+  AddSegments(4 * kDuration + kSlightDrift, kDuration - kSlightDrift, kSize, 0);
+
+  std::string mpd_doc;
+  ASSERT_NO_FATAL_FAILURE(MpdToString(&mpd_doc));
+  ASSERT_TRUE(ValidateMpdSchema(mpd_doc));
+  EXPECT_NE(std::string::npos,
+            mpd_doc.find("media=\"$Number$.mp4\" duration=\"1000\" "
+                         "startNumber=\"1\"/>"))
+      << mpd_doc;
+  EXPECT_EQ(std::string::npos, mpd_doc.find("SegmentTimeline"));
+
+  // The next segment is more than half a segment late, so the segments are
+  // listed again, from the ones left in the window.
+  AddSegments(6 * kDuration, kDuration, kSize, 0);
+  const std::string expected_s_elements =
+      base::StringPrintf(kSElementTemplateWithoutR,
+                         4 * kDuration + kSlightDrift,
+                         kDuration - kSlightDrift) +
+      base::StringPrintf(kSElementTemplateWithoutR, 6 * kDuration, kDuration);
+  const int kExpectedStartNumber = 5;
+  CheckTimeShiftBufferDepthResult(expected_s_elements, kTimeShiftBufferDepth,
+                                  kExpectedStartNumber);
+}
+
 TEST(RelativePaths, PathsModified) {
   const std::string kCommonPath(FilePath("foo").Append("bar").value());
   const std::string kMediaFileBase("media.mp4");
@@ -0,0 +1,168 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/mpd/base/mpd_notification_receiver.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "packager/base/bind.h"
+#include "packager/base/logging.h"
+#include "packager/base/posix/eintr_wrapper.h"
+#include "packager/base/stl_util.h"
+#include "packager/base/strings/string_number_conversions.h"
+#include "packager/media/base/closure_thread.h"
+#include "packager/mpd/base/media_info.pb.h"
+#include "packager/mpd/base/mpd_notification.pb.h"
+#include "packager/mpd/base/mpd_notification_stream.h"
+#include "packager/mpd/base/mpd_notifier.h"
+
+namespace edash_packager {
+namespace {
+
+// How often the accept thread checks whether it should stop.
+const int kAcceptTimeoutInMs = 100;
+
+}  // namespace
+
+MpdNotificationReceiver::MpdNotificationReceiver(MpdNotifier* notifier)
+    : notifier_(notifier),
+      listen_socket_(kInvalidMpdNotificationSocket),
+      port_(0),
+      stopped_(false) {
+  DCHECK(notifier_);
+}
+
+MpdNotificationReceiver::~MpdNotificationReceiver() {
+  Stop();
+}
+
+bool MpdNotificationReceiver::Start(uint16_t port) {
+  DCHECK_EQ(listen_socket_, kInvalidMpdNotificationSocket);
+  listen_socket_ = ListenForMpdNotifications(port, &port_);
+  if (listen_socket_ == kInvalidMpdNotificationSocket)
+    return false;
+  accept_thread_.reset(new media::ClosureThread(
+      "MpdNotificationAccept",
+      base::Bind(&MpdNotificationReceiver::AcceptConnections,
+                 base::Unretained(this))));
+  accept_thread_->Start();
+  return true;
+}
+
+void MpdNotificationReceiver::Stop() {
+  {
+    base::AutoLock auto_lock(lock_);
+    if (stopped_)
+      return;
+    stopped_ = true;
+  }
+  if (accept_thread_)
+    accept_thread_->Join();
+  if (listen_socket_ != kInvalidMpdNotificationSocket)
+    close(listen_socket_);
+  // No connection is added once the accept thread is done.
+  for (media::ClosureThread* connection_thread : connection_threads_)
+    connection_thread->Join();
+  STLDeleteElements(&connection_threads_);
+}
+
+void MpdNotificationReceiver::AcceptConnections() {
+  while (true) {
+    {
+      base::AutoLock auto_lock(lock_);
+      if (stopped_)
+        return;
+    }
+    struct pollfd poll_fd;
+    poll_fd.fd = listen_socket_;
+    poll_fd.events = POLLIN;
+    poll_fd.revents = 0;
+    const int result = HANDLE_EINTR(poll(&poll_fd, 1, kAcceptTimeoutInMs));
+    if (result < 0) {
+      PLOG(ERROR) << "Failed to wait for MPD notification connections";
+      return;
+    }
+    if (result == 0)
+      continue;
+
+    const int socket = HANDLE_EINTR(accept(listen_socket_, NULL, NULL));
+    if (socket < 0) {
+      PLOG(WARNING) << "Failed to accept MPD notification connection";
+      continue;
+    }
+    base::AutoLock auto_lock(lock_);
+    connection_threads_.push_back(new media::ClosureThread(
+        "MpdNotificationConnection" +
+            base::SizeTToString(connection_threads_.size()),
+        base::Bind(&MpdNotificationReceiver::ReceiveNotifications,
+                   base::Unretained(this), socket)));
+    connection_threads_.back()->Start();
+  }
+}
+
+void MpdNotificationReceiver::ReceiveNotifications(int socket) {
+  ContainerIdMap container_ids;
+  MpdNotificationBatch batch;
+  bool end_of_stream = false;
+  while (ReadMpdNotificationBatch(socket, &batch, &end_of_stream)) {
+    for (int i = 0; i < batch.notifications_size(); ++i) {
+      if (!ForwardNotification(batch.notifications(i), &container_ids))
+        LOG(WARNING) << "Failed to process MPD notification.";
+    }
+  }
+  LOG_IF(ERROR, !end_of_stream) << "MPD notification connection failed.";
+  close(socket);
+}
+
+bool MpdNotificationReceiver::ForwardNotification(
+    const MpdNotification& notification,
+    ContainerIdMap* container_ids) {
+  if (notification.type() == MpdNotification::FLUSH)
+    return notifier_->Flush();
+
+  if (notification.type() == MpdNotification::NEW_CONTAINER) {
+    MediaInfo media_info;
+    if (!media_info.ParseFromString(notification.media_info())) {
+      LOG(ERROR) << "Failed to parse MediaInfo.";
+      return false;
+    }
+    uint32_t container_id = 0;
+    if (!notifier_->NotifyNewContainer(media_info, &container_id))
+      return false;
+    (*container_ids)[notification.container_id()] = container_id;
+    return true;
+  }
+
+  ContainerIdMap::const_iterator container_id =
+      container_ids->find(notification.container_id());
+  if (container_id == container_ids->end()) {
+    LOG(ERROR) << "Unknown container id " << notification.container_id();
+    return false;
+  }
+  switch (notification.type()) {
+    case MpdNotification::SAMPLE_DURATION:
+      return notifier_->NotifySampleDuration(container_id->second,
+                                             notification.sample_duration());
+    case MpdNotification::NEW_SEGMENT:
+      return notifier_->NotifyNewSegment(
+          container_id->second, notification.start_time(),
+          notification.duration(), notification.size());
+    case MpdNotification::ENCRYPTION_UPDATE:
+      return notifier_->NotifyEncryptionUpdate(
+          container_id->second, notification.drm_uuid(),
+          std::vector<uint8_t>(notification.key_id().begin(),
+                               notification.key_id().end()),
+          std::vector<uint8_t>(notification.pssh().begin(),
+                               notification.pssh().end()));
+    default:
+      LOG(ERROR) << "Unknown MPD notification type " << notification.type();
+      return false;
+  }
+}
+
+}  // namespace edash_packager
@@ -0,0 +1,77 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MPD_BASE_MPD_NOTIFICATION_RECEIVER_H_
+#define MPD_BASE_MPD_NOTIFICATION_RECEIVER_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <vector>
+
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/synchronization/lock.h"
+
+namespace edash_packager {
+
+namespace media {
+class ClosureThread;
+}  // namespace media
+
+class MpdNotification;
+class MpdNotifier;
+
+/// Receives the notifications of RemoteMpdNotifier instances and forwards
+/// them to a MpdNotifier, which owns the MPD. Each connection is served by
+/// its own thread, and the container ids of each connection are mapped to the
+/// container ids of the notifier.
+class MpdNotificationReceiver {
+ public:
+  /// @param notifier receives the notifications. It is not owned, should
+  ///        outlive the receiver and should be thread safe.
+  explicit MpdNotificationReceiver(MpdNotifier* notifier);
+  /// Calls Stop().
+  ~MpdNotificationReceiver();
+
+  /// Start accepting connections.
+  /// @param port is the TCP port to listen on. Zero picks an unused port.
+  /// @return true on success, false otherwise.
+  bool Start(uint16_t port);
+
+  /// Stop accepting connections, and wait for the connected notifiers to
+  /// close their connections, i.e. to be deleted.
+  void Stop();
+
+  /// @return The port listened on, once started.
+  uint16_t port() const { return port_; }
+
+ private:
+  typedef std::map<uint32_t, uint32_t> ContainerIdMap;
+
+  // Body of the thread accepting the connections.
+  void AcceptConnections();
+  // Body of the thread of a connection.
+  void ReceiveNotifications(int socket);
+  // Forward |notification| to |notifier_|. |container_ids| maps the container
+  // ids of the connection to the container ids of |notifier_|.
+  bool ForwardNotification(const MpdNotification& notification,
+                           ContainerIdMap* container_ids);
+
+  MpdNotifier* const notifier_;
+  int listen_socket_;
+  uint16_t port_;
+  scoped_ptr<media::ClosureThread> accept_thread_;
+
+  base::Lock lock_;  // Lock protecting the variables below.
+  bool stopped_;
+  std::vector<media::ClosureThread*> connection_threads_;
+
+  DISALLOW_COPY_AND_ASSIGN(MpdNotificationReceiver);
+};
+
+}  // namespace edash_packager
+
+#endif  // MPD_BASE_MPD_NOTIFICATION_RECEIVER_H_
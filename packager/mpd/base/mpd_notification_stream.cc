@@ -0,0 +1,206 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/mpd/base/mpd_notification_stream.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "packager/base/logging.h"
+#include "packager/base/posix/eintr_wrapper.h"
+#include "packager/mpd/base/mpd_notification.pb.h"
+
+namespace edash_packager {
+namespace {
+
+const size_t kSizeFieldSize = 4;
+// Protects the receiver from corrupt streams.
+const uint32_t kMaxBatchSize = 64 * 1024 * 1024;
+const int kListenBacklog = 64;
+// Report a closed connection as an error rather than with SIGPIPE.
+#if defined(MSG_NOSIGNAL)
+const int kSendFlags = MSG_NOSIGNAL;
+#else
+const int kSendFlags = 0;
+#endif
+
+bool WriteAll(int socket, const uint8_t* data, size_t size) {
+  while (size > 0) {
+    const ssize_t written =
+        HANDLE_EINTR(send(socket, data, size, kSendFlags));
+    if (written <= 0) {
+      PLOG(ERROR) << "Failed to send MPD notifications";
+      return false;
+    }
+    data += written;
+    size -= written;
+  }
+  return true;
+}
+
+// Returns the number of bytes read, which is less than |size| only at the
+// end of the stream, or -1 on error.
+ssize_t ReadAll(int socket, uint8_t* data, size_t size) {
+  size_t total = 0;
+  while (total < size) {
+    const ssize_t bytes_read =
+        HANDLE_EINTR(recv(socket, data + total, size - total, 0));
+    if (bytes_read < 0) {
+      PLOG(ERROR) << "Failed to receive MPD notifications";
+      return -1;
+    }
+    if (bytes_read == 0)
+      break;
+    total += bytes_read;
+  }
+  return total;
+}
+
+}  // namespace
+
+int ConnectToMpdNotificationReceiver(const std::string& address) {
+  const size_t colon = address.rfind(':');
+  if (colon == std::string::npos || colon == 0) {
+    LOG(ERROR) << "Expecting <host>:<port>, got " << address;
+    return kInvalidMpdNotificationSocket;
+  }
+  const std::string host = address.substr(0, colon);
+  const std::string port = address.substr(colon + 1);
+
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo* addresses = NULL;
+  const int error =
+      getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses);
+  if (error != 0) {
+    LOG(ERROR) << "Cannot resolve " << address << ": " << gai_strerror(error);
+    return kInvalidMpdNotificationSocket;
+  }
+
+  int connected_socket = kInvalidMpdNotificationSocket;
+  for (struct addrinfo* it = addresses; it; it = it->ai_next) {
+    const int new_socket =
+        socket(it->ai_family, it->ai_socktype, it->ai_protocol);
+    if (new_socket < 0)
+      continue;
+    if (HANDLE_EINTR(connect(new_socket, it->ai_addr, it->ai_addrlen)) == 0) {
+      connected_socket = new_socket;
+      break;
+    }
+    close(new_socket);
+  }
+  freeaddrinfo(addresses);
+  if (connected_socket == kInvalidMpdNotificationSocket) {
+    LOG(ERROR) << "Cannot connect to MPD notification receiver " << address;
+    return kInvalidMpdNotificationSocket;
+  }
+
+  // The batches are small and already coalesced by the sender.
+  const int enable = 1;
+  setsockopt(connected_socket, IPPROTO_TCP, TCP_NODELAY, &enable,
+             sizeof(enable));
+  return connected_socket;
+}
+
+int ListenForMpdNotifications(uint16_t port, uint16_t* bound_port) {
+  DCHECK(bound_port);
+  const int listen_socket = socket(AF_INET6, SOCK_STREAM, 0);
+  if (listen_socket < 0) {
+    PLOG(ERROR) << "Cannot create MPD notification socket";
+    return kInvalidMpdNotificationSocket;
+  }
+  const int enable = 1;
+  setsockopt(listen_socket, SOL_SOCKET, SO_REUSEADDR, &enable,
+             sizeof(enable));
+  // Accept IPv4 connections too.
+  const int disable = 0;
+  setsockopt(listen_socket, IPPROTO_IPV6, IPV6_V6ONLY, &disable,
+             sizeof(disable));
+
+  struct sockaddr_in6 address;
+  memset(&address, 0, sizeof(address));
+  address.sin6_family = AF_INET6;
+  address.sin6_addr = in6addr_any;
+  address.sin6_port = htons(port);
+  socklen_t address_size = sizeof(address);
+  if (bind(listen_socket, reinterpret_cast<struct sockaddr*>(&address),
+           sizeof(address)) < 0 ||
+      listen(listen_socket, kListenBacklog) < 0 ||
+      getsockname(listen_socket, reinterpret_cast<struct sockaddr*>(&address),
+                  &address_size) < 0) {
+    PLOG(ERROR) << "Cannot listen for MPD notifications on port " << port;
+    close(listen_socket);
+    return kInvalidMpdNotificationSocket;
+  }
+  *bound_port = ntohs(address.sin6_port);
+  return listen_socket;
+}
+
+bool WriteMpdNotificationBatch(int socket, const MpdNotificationBatch& batch) {
+  std::string data;
+  if (!batch.SerializeToString(&data)) {
+    LOG(ERROR) << "Failed to serialize MPD notifications.";
+    return false;
+  }
+  if (data.size() > kMaxBatchSize) {
+    LOG(ERROR) << "MPD notification batch too large: " << data.size();
+    return false;
+  }
+  const uint32_t size = data.size();
+  const uint8_t size_field[kSizeFieldSize] = {
+      static_cast<uint8_t>(size >> 24), static_cast<uint8_t>(size >> 16),
+      static_cast<uint8_t>(size >> 8), static_cast<uint8_t>(size)};
+  return WriteAll(socket, size_field, kSizeFieldSize) &&
+         WriteAll(socket, reinterpret_cast<const uint8_t*>(data.data()),
+                  data.size());
+}
+
+bool ReadMpdNotificationBatch(int socket,
+                              MpdNotificationBatch* batch,
+                              bool* end_of_stream) {
+  DCHECK(batch);
+  DCHECK(end_of_stream);
+  *end_of_stream = false;
+  uint8_t size_field[kSizeFieldSize];
+  const ssize_t bytes_read = ReadAll(socket, size_field, kSizeFieldSize);
+  if (bytes_read == 0) {
+    *end_of_stream = true;
+    return false;
+  }
+  if (bytes_read != static_cast<ssize_t>(kSizeFieldSize)) {
+    LOG_IF(ERROR, bytes_read > 0) << "Truncated MPD notification batch.";
+    return false;
+  }
+  const uint32_t size = (size_field[0] << 24) | (size_field[1] << 16) |
+                        (size_field[2] << 8) | size_field[3];
+  if (size > kMaxBatchSize) {
+    LOG(ERROR) << "MPD notification batch too large: " << size;
+    return false;
+  }
+  std::string data(size, '\0');
+  if (size > 0 &&
+      ReadAll(socket, reinterpret_cast<uint8_t*>(&data[0]), size) !=
+          static_cast<ssize_t>(size)) {
+    LOG(ERROR) << "Truncated MPD notification batch.";
+    return false;
+  }
+  if (!batch->ParseFromString(data)) {
+    LOG(ERROR) << "Failed to parse MPD notification batch.";
+    return false;
+  }
+  return true;
+}
+
+}  // namespace edash_packager
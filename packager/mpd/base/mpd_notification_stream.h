@@ -0,0 +1,49 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+//
+// Transport of the MpdNotificationBatch messages over TCP. Each batch is sent
+// as its serialized size, as a 32-bit big-endian integer, followed by the
+// serialized batch.
+
+#ifndef MPD_BASE_MPD_NOTIFICATION_STREAM_H_
+#define MPD_BASE_MPD_NOTIFICATION_STREAM_H_
+
+#include <stdint.h>
+
+#include <string>
+
+namespace edash_packager {
+
+class MpdNotificationBatch;
+
+const int kInvalidMpdNotificationSocket = -1;
+
+/// Connect to a MpdNotificationReceiver.
+/// @param address is of the form "<host>:<port>".
+/// @return The connected socket, or kInvalidMpdNotificationSocket on failure.
+int ConnectToMpdNotificationReceiver(const std::string& address);
+
+/// Listen for notification streams.
+/// @param port is the TCP port to listen on. Zero picks an unused port.
+/// @param[out] bound_port receives the port listened on.
+/// @return The listening socket, or kInvalidMpdNotificationSocket on failure.
+int ListenForMpdNotifications(uint16_t port, uint16_t* bound_port);
+
+/// Write @a batch on @a socket.
+/// @return true on success, false otherwise.
+bool WriteMpdNotificationBatch(int socket, const MpdNotificationBatch& batch);
+
+/// Read the next batch from @a socket.
+/// @param[out] end_of_stream is set to true if the stream was closed before
+///             the batch started.
+/// @return true on success, false on error or at the end of the stream.
+bool ReadMpdNotificationBatch(int socket,
+                              MpdNotificationBatch* batch,
+                              bool* end_of_stream);
+
+}  // namespace edash_packager
+
+#endif  // MPD_BASE_MPD_NOTIFICATION_STREAM_H_
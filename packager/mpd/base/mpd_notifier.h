@@ -21,6 +21,14 @@ namespace edash_packager {
 class MediaInfo;
 struct ContentProtectionElement;
 
+/// A segment notified with MpdNotifier::NotifyNewSegments().
+struct SegmentNotification {
+  uint32_t container_id;
+  uint64_t start_time;
+  uint64_t duration;
+  uint64_t size;
+};
+
 enum DashProfile {
   kUnknownProfile,
   kOnDemandProfile,
@@ -75,6 +83,30 @@ class MpdNotifier {
                                 uint64_t duration,
                                 uint64_t size) = 0;
 
+  /// Notifies MpdBuilder of several new segments at once, e.g. the segments
+  /// with the same index of all the Representations. Same as calling
+  /// NotifyNewSegment() for each of @a segments, in order, but implementations
+  /// may update the MPD in one go.
+  /// @return true on success, false if any of the segments failed.
+  virtual bool NotifyNewSegments(
+      const std::vector<SegmentNotification>& segments) {
+    bool result = true;
+    for (const SegmentNotification& segment : segments) {
+      if (!NotifyNewSegment(segment.container_id, segment.start_time,
+                            segment.duration, segment.size)) {
+        result = false;
+      }
+    }
+    return result;
+  }
+
+  /// Notifies that the container has no more segments, e.g. for live, the
+  /// end of the stream.
+  /// @param container_id Container ID obtained from calling
+  ///        NotifyNewContainer().
+  /// @return true on success, false otherwise.
+  virtual bool NotifyContainerEnd(uint32_t container_id) { return true; }
+
   /// Notifiers MpdBuilder that there is a new PSSH for the container.
   /// This may be called whenever the key has to change, e.g. key rotation.
   /// @param container_id Container ID obtained from calling
@@ -22,7 +22,13 @@ struct MpdOptions {
         min_buffer_time(2.0),
         time_shift_buffer_depth(0),
         suggested_presentation_delay(0),
-        packager_version_string(kPackagerVersion) {}
+        packager_version_string(kPackagerVersion),
+        use_streaming_mpd_writer(false),
+        num_xml_threads(0),
+        mpd_write_coalescing_window(0),
+        peak_bandwidth_window(0),
+        segment_template_constant_duration(false),
+        batch_segment_notifications(false) {}
 
   ~MpdOptions() {};
 
@@ -32,6 +38,40 @@ struct MpdOptions {
   double time_shift_buffer_depth;
   double suggested_presentation_delay;
   std::string packager_version_string;
+  /// If true, the MPD is written straight into a string instead of being
+  /// built as a libxml2 tree and serialized. The output is the same.
+  bool use_streaming_mpd_writer;
+  /// If greater than 1, the streaming writer serializes the Representations
+  /// of each AdaptationSet in parallel on this many threads, into separate
+  /// buffers which are concatenated in order. The output is the same. Ignored
+  /// if use_streaming_mpd_writer is false.
+  int num_xml_threads;
+  /// If positive, the MPD is written on a separate thread and the updates
+  /// received within this many seconds are coalesced into a single write.
+  /// If 0, the MPD is written synchronously on every flush.
+  double mpd_write_coalescing_window;
+  /// If positive, the Representation@bandwidth computed from the segments is
+  /// the highest segment bitrate among this many latest segments, instead of
+  /// the harmonic mean of the bitrates of all the segments.
+  int peak_bandwidth_window;
+  /// If not empty, 'dynamic' MPDs have an id and a PatchLocation element with
+  /// this URL, where the MPD Patch documents which update each MPD to the
+  /// next are published. See MpdBuilder::ToStringWithPatch().
+  std::string mpd_patch_location;
+  /// If true, live Representations with a $Number$ SegmentTemplate use
+  /// SegmentTemplate@duration instead of a SegmentTimeline, as long as their
+  /// segments start within half a segment of their nominal time. The MPD then
+  /// does not grow with the number of segments.
+  bool segment_template_constant_duration;
+  /// If not empty, for live, the updates of the MPD are appended to this
+  /// file, and the MPD state saved in it is restored on start, so that the
+  /// MPD carries on across restarts of the packager. See SimpleMpdNotifier.
+  std::string mpd_state_log;
+  /// If true, for live, the Nth segments of all the Representations are
+  /// added to the MPD together, once the last of them is complete, so that
+  /// the MPD is updated once per segment rather than once per Representation.
+  /// See SegmentBatchingMpdNotifier.
+  bool batch_segment_notifications;
 };
 
 }  // namespace edash_packager
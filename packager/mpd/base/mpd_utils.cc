@@ -10,11 +10,15 @@
 
 #include "packager/base/logging.h"
 #include "packager/base/strings/string_number_conversions.h"
+#include "packager/base/sys_byteorder.h"
 #include "packager/mpd/base/xml/scoped_xml_ptr.h"
 
 namespace edash_packager {
 namespace {
 
+const char kEC3Codec[] = "ec-3";
+const char kTrickPlayKeySuffix[] = ":trick_play";
+
 std::string TextCodecString(
     const edash_packager::MediaInfo& media_info) {
   CHECK(media_info.has_text_info());
@@ -134,9 +138,44 @@ std::string GetAdaptationSetKey(const MediaInfo& media_info) {
   key.append(":");
   key.append(GetLanguage(media_info));
 
+  if (media_info.video_info().trick_play_factor() > 0)
+    return GetTrickPlayAdaptationSetKey(key);
   return key;
 }
 
+std::string GetTrickPlayAdaptationSetKey(const std::string& main_key) {
+  return main_key + kTrickPlayKeySuffix;
+}
+
+std::string GetTrickPlayMainAdaptationSetKey(const std::string& key) {
+  const size_t suffix_size = sizeof(kTrickPlayKeySuffix) - 1;
+  if (key.size() < suffix_size ||
+      key.compare(key.size() - suffix_size, suffix_size,
+                  kTrickPlayKeySuffix) != 0) {
+    return std::string();
+  }
+  return key.substr(0, key.size() - suffix_size);
+}
+
+void GetAudioChannelConfiguration(const MediaInfo::AudioInfo& audio_info,
+                                  std::string* scheme_id_uri,
+                                  std::string* value) {
+  DCHECK(scheme_id_uri);
+  DCHECK(value);
+  if (audio_info.codec() == kEC3Codec) {
+    // Convert EC3 channel map into string of hexadecimal digits. Spec: DASH-IF
+    // Interoperability Points v3.0 9.2.1.2.
+    const uint16_t ec3_channel_map =
+        base::HostToNet16(audio_info.codec_specific_data().ec3_channel_map());
+    *value = base::HexEncode(&ec3_channel_map, sizeof(ec3_channel_map));
+    *scheme_id_uri =
+        "tag:dolby.com,2014:dash:audio_channel_configuration:2011";
+  } else {
+    *value = base::UintToString(audio_info.num_channels());
+    *scheme_id_uri = "urn:mpeg:dash:23003:3:audio_channel_configuration:2011";
+  }
+}
+
 std::string SecondsToXmlDuration(double seconds) {
   return "PT" + base::DoubleToString(seconds) + "S";
 }
@@ -210,7 +249,7 @@ bool HexToUUID(const std::string& data, std::string* uuid_format) {
   return true;
 }
 
-void UpdateContentProtectionPsshHelper(
+bool UpdateContentProtectionPsshHelper(
     const std::string& drm_uuid,
     const std::string& pssh,
     std::list<ContentProtectionElement>* content_protection_elements) {
@@ -233,7 +272,7 @@ void UpdateContentProtectionPsshHelper(
         // TODO(rkuroiwa): Uncomment this and remove the line above when
         // shaka-player supports updating PSSH.
         // subelement->content = pssh;
-        return;
+        return true;
       }
     }
 
@@ -244,7 +283,7 @@ void UpdateContentProtectionPsshHelper(
     // cenc_pssh.name = kPsshElementName;
     // cenc_pssh.content = pssh;
     // protection->subelements.push_back(cenc_pssh);
-    return;
+    return false;
   }
 
   // Reaching here means that ContentProtection for the DRM does not exist.
@@ -257,7 +296,7 @@ void UpdateContentProtectionPsshHelper(
   // cenc_pssh.content = pssh;
   // content_protection.subelements.push_back(cenc_pssh);
   content_protection_elements->push_back(content_protection);
-  return;
+  return true;
 }
 
 namespace {
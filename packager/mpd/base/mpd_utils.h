@@ -51,8 +51,24 @@ std::string GetCodecs(const MediaInfo& media_info);
 std::string GetBaseCodec(const MediaInfo& media_info);
 
 // Returns a key made from the characteristics that separate AdaptationSets.
+// Trick play streams have AdaptationSets of their own, whose key is
+// GetTrickPlayAdaptationSetKey() of the key of their main stream.
 std::string GetAdaptationSetKey(const MediaInfo& media_info);
 
+// Returns the AdaptationSet key of the trick play streams of the main streams
+// whose key is |main_key|.
+std::string GetTrickPlayAdaptationSetKey(const std::string& main_key);
+
+// Returns the AdaptationSet key of the main streams of the trick play streams
+// whose key is |key|, or an empty string if |key| is not a trick play key.
+std::string GetTrickPlayMainAdaptationSetKey(const std::string& key);
+
+// Sets the schemeIdUri and the value of the AudioChannelConfiguration element
+// for |audio_info|.
+void GetAudioChannelConfiguration(const MediaInfo::AudioInfo& audio_info,
+                                  std::string* scheme_id_uri,
+                                  std::string* value);
+
 std::string SecondsToXmlDuration(double seconds);
 
 // Tries to get "duration" attribute from |node|. On success |duration| is set.
@@ -69,7 +85,8 @@ bool HexToUUID(const std::string& data, std::string* uuid_format);
 
 // Update the <cenc:pssh> element for |drm_uuid| ContentProtection element.
 // If the element does not exist, this will add one.
-void UpdateContentProtectionPsshHelper(
+// Returns true if |content_protection_elements| was modified.
+bool UpdateContentProtectionPsshHelper(
     const std::string& drm_uuid,
     const std::string& pssh,
     std::list<ContentProtectionElement>* content_protection_elements);
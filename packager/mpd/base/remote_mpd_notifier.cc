@@ -0,0 +1,207 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/mpd/base/remote_mpd_notifier.h"
+
+#include <unistd.h>
+
+#include "packager/base/bind.h"
+#include "packager/base/logging.h"
+#include "packager/media/base/closure_thread.h"
+#include "packager/mpd/base/media_info.pb.h"
+#include "packager/mpd/base/mpd_notification_stream.h"
+
+namespace edash_packager {
+namespace {
+
+// A batch is sent once it holds this many notifications, or once its oldest
+// notification is this old. A few renditions reporting their segments at
+// about the same time end up in the same batch.
+const int kMaxNotificationsPerBatch = 256;
+const int64_t kMaxBatchDelayInMs = 100;
+
+}  // namespace
+
+RemoteMpdNotifier::RemoteMpdNotifier(DashProfile dash_profile,
+                                     const std::string& receiver_address)
+    : MpdNotifier(dash_profile),
+      receiver_address_(receiver_address),
+      socket_(kInvalidMpdNotificationSocket),
+      flush_pending_(false),
+      closed_(false),
+      failed_(false),
+      next_container_id_(0),
+      num_queued_(0),
+      num_sent_(0),
+      batch_ready_cv_(&lock_),
+      batch_sent_cv_(&lock_) {}
+
+RemoteMpdNotifier::~RemoteMpdNotifier() {
+  {
+    base::AutoLock auto_lock(lock_);
+    closed_ = true;
+    batch_ready_cv_.Signal();
+  }
+  if (sender_thread_)
+    sender_thread_->Join();
+  if (socket_ != kInvalidMpdNotificationSocket)
+    close(socket_);
+}
+
+bool RemoteMpdNotifier::Init() {
+  DCHECK_EQ(socket_, kInvalidMpdNotificationSocket);
+  socket_ = ConnectToMpdNotificationReceiver(receiver_address_);
+  if (socket_ == kInvalidMpdNotificationSocket)
+    return false;
+  sender_thread_.reset(new media::ClosureThread(
+      "RemoteMpdNotifier", base::Bind(&RemoteMpdNotifier::SendBatches,
+                                      base::Unretained(this))));
+  sender_thread_->Start();
+  return true;
+}
+
+bool RemoteMpdNotifier::NotifyNewContainer(const MediaInfo& media_info,
+                                           uint32_t* container_id) {
+  DCHECK(container_id);
+  MpdNotification notification;
+  notification.set_type(MpdNotification::NEW_CONTAINER);
+  if (!media_info.SerializeToString(notification.mutable_media_info())) {
+    LOG(ERROR) << "Failed to serialize MediaInfo.";
+    return false;
+  }
+  base::AutoLock auto_lock(lock_);
+  notification.set_container_id(next_container_id_);
+  if (!QueueNotificationWithLock(&notification))
+    return false;
+  *container_id = next_container_id_++;
+  return true;
+}
+
+bool RemoteMpdNotifier::NotifySampleDuration(uint32_t container_id,
+                                             uint32_t sample_duration) {
+  MpdNotification notification;
+  notification.set_type(MpdNotification::SAMPLE_DURATION);
+  notification.set_container_id(container_id);
+  notification.set_sample_duration(sample_duration);
+  return QueueNotification(&notification);
+}
+
+bool RemoteMpdNotifier::NotifyNewSegment(uint32_t container_id,
+                                         uint64_t start_time,
+                                         uint64_t duration,
+                                         uint64_t size) {
+  MpdNotification notification;
+  notification.set_type(MpdNotification::NEW_SEGMENT);
+  notification.set_container_id(container_id);
+  notification.set_start_time(start_time);
+  notification.set_duration(duration);
+  notification.set_size(size);
+  return QueueNotification(&notification);
+}
+
+bool RemoteMpdNotifier::NotifyEncryptionUpdate(
+    uint32_t container_id,
+    const std::string& drm_uuid,
+    const std::vector<uint8_t>& new_key_id,
+    const std::vector<uint8_t>& new_pssh) {
+  MpdNotification notification;
+  notification.set_type(MpdNotification::ENCRYPTION_UPDATE);
+  notification.set_container_id(container_id);
+  notification.set_drm_uuid(drm_uuid);
+  notification.set_key_id(new_key_id.data(), new_key_id.size());
+  notification.set_pssh(new_pssh.data(), new_pssh.size());
+  return QueueNotification(&notification);
+}
+
+bool RemoteMpdNotifier::AddContentProtectionElement(
+    uint32_t id,
+    const ContentProtectionElement& content_protection_element) {
+  NOTIMPLEMENTED() << "ContentProtection elements are not sent remotely.";
+  return false;
+}
+
+bool RemoteMpdNotifier::Flush() {
+  MpdNotification notification;
+  notification.set_type(MpdNotification::FLUSH);
+  base::AutoLock auto_lock(lock_);
+  if (!QueueNotificationWithLock(&notification))
+    return false;
+  flush_pending_ = true;
+  batch_ready_cv_.Signal();
+  const uint64_t num_to_send = num_queued_;
+  while (num_sent_ < num_to_send && !failed_)
+    batch_sent_cv_.Wait();
+  return !failed_;
+}
+
+bool RemoteMpdNotifier::QueueNotification(MpdNotification* notification) {
+  base::AutoLock auto_lock(lock_);
+  return QueueNotificationWithLock(notification);
+}
+
+bool RemoteMpdNotifier::QueueNotificationWithLock(
+    MpdNotification* notification) {
+  lock_.AssertAcquired();
+  if (socket_ == kInvalidMpdNotificationSocket || failed_)
+    return false;
+  if (pending_batch_.notifications_size() == 0)
+    oldest_pending_time_ = base::TimeTicks::Now();
+  pending_batch_.add_notifications()->Swap(notification);
+  ++num_queued_;
+  if (pending_batch_.notifications_size() >= kMaxNotificationsPerBatch)
+    batch_ready_cv_.Signal();
+  return true;
+}
+
+bool RemoteMpdNotifier::IsBatchReady() const {
+  lock_.AssertAcquired();
+  if (pending_batch_.notifications_size() == 0)
+    return false;
+  return flush_pending_ ||
+         pending_batch_.notifications_size() >= kMaxNotificationsPerBatch ||
+         base::TimeTicks::Now() - oldest_pending_time_ >=
+             base::TimeDelta::FromMilliseconds(kMaxBatchDelayInMs);
+}
+
+void RemoteMpdNotifier::SendBatches() {
+  while (true) {
+    MpdNotificationBatch batch;
+    uint64_t num_sent = 0;
+    {
+      base::AutoLock auto_lock(lock_);
+      while (!closed_ && !IsBatchReady()) {
+        if (pending_batch_.notifications_size() == 0) {
+          batch_ready_cv_.Wait();
+        } else {
+          batch_ready_cv_.TimedWait(
+              oldest_pending_time_ +
+              base::TimeDelta::FromMilliseconds(kMaxBatchDelayInMs) -
+              base::TimeTicks::Now());
+        }
+      }
+      if (pending_batch_.notifications_size() == 0)
+        return;
+      batch.Swap(&pending_batch_);
+      flush_pending_ = false;
+      num_sent = num_queued_;
+    }
+
+    const bool sent = WriteMpdNotificationBatch(socket_, batch);
+    base::AutoLock auto_lock(lock_);
+    if (sent) {
+      num_sent_ = num_sent;
+    } else {
+      LOG(ERROR) << "Lost the connection to the MPD notification receiver "
+                 << receiver_address_;
+      failed_ = true;
+    }
+    batch_sent_cv_.Broadcast();
+    if (!sent)
+      return;
+  }
+}
+
+}  // namespace edash_packager
@@ -0,0 +1,110 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MPD_BASE_REMOTE_MPD_NOTIFIER_H_
+#define MPD_BASE_REMOTE_MPD_NOTIFIER_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/synchronization/condition_variable.h"
+#include "packager/base/synchronization/lock.h"
+#include "packager/base/time/time.h"
+#include "packager/mpd/base/mpd_notification.pb.h"
+#include "packager/mpd/base/mpd_notifier.h"
+
+namespace edash_packager {
+
+namespace media {
+class ClosureThread;
+}  // namespace media
+
+/// A MpdNotifier which forwards the notifications to a MpdNotificationReceiver
+/// in another process, typically on another host, which owns the MPD. This
+/// lets the renditions of a live channel be packaged by several packagers,
+/// while a single MPD lists them all.
+/// The notifications are sent in batches from a dedicated thread. A batch is
+/// sent when it is full, when its oldest notification has waited for long
+/// enough, or on Flush().
+/// Thread Safety: RemoteMpdNotifier is thread safe.
+class RemoteMpdNotifier : public MpdNotifier {
+ public:
+  /// @param dash_profile is the profile of the MPD, which should be the one of
+  ///        the notifier of the receiver.
+  /// @param receiver_address is the address of the receiver, of the form
+  ///        "<host>:<port>".
+  RemoteMpdNotifier(DashProfile dash_profile,
+                    const std::string& receiver_address);
+  /// Sends the pending notifications and closes the connection.
+  ~RemoteMpdNotifier() override;
+
+  /// @name MpdNotifier implementation overrides.
+  /// The notifications return true once they are queued. They fail if the
+  /// connection to the receiver failed.
+  /// @{
+  /// Connects to the receiver.
+  bool Init() override;
+  bool NotifyNewContainer(const MediaInfo& media_info,
+                          uint32_t* id) override;
+  bool NotifySampleDuration(uint32_t container_id,
+                            uint32_t sample_duration) override;
+  bool NotifyNewSegment(uint32_t container_id,
+                        uint64_t start_time,
+                        uint64_t duration,
+                        uint64_t size) override;
+  bool NotifyEncryptionUpdate(uint32_t container_id,
+                              const std::string& drm_uuid,
+                              const std::vector<uint8_t>& new_key_id,
+                              const std::vector<uint8_t>& new_pssh) override;
+  /// Not supported remotely.
+  bool AddContentProtectionElement(
+      uint32_t id,
+      const ContentProtectionElement& content_protection_element) override;
+  /// Sends the pending notifications and a flush of the MPD to the receiver,
+  /// and waits for them to be sent.
+  bool Flush() override;
+  /// @}
+
+ private:
+  // Queues |notification| to be sent, leaving it empty. Returns false if the
+  // connection failed.
+  bool QueueNotification(MpdNotification* notification);
+  // Same as QueueNotification(), with |lock_| held.
+  bool QueueNotificationWithLock(MpdNotification* notification);
+  // Whether the pending notifications should be sent now. |lock_| must be
+  // held.
+  bool IsBatchReady() const;
+  // Body of the sender thread.
+  void SendBatches();
+
+  const std::string receiver_address_;
+  int socket_;
+  scoped_ptr<media::ClosureThread> sender_thread_;
+
+  mutable base::Lock lock_;  // Lock protecting the variables below.
+  MpdNotificationBatch pending_batch_;
+  base::TimeTicks oldest_pending_time_;
+  // Whether a flush is pending, in which case the batch is sent right away.
+  bool flush_pending_;
+  bool closed_;
+  bool failed_;
+  uint32_t next_container_id_;
+  // Number of notifications queued and sent, so that Flush() can wait for
+  // the notifications queued before it.
+  uint64_t num_queued_;
+  uint64_t num_sent_;
+  base::ConditionVariable batch_ready_cv_;
+  base::ConditionVariable batch_sent_cv_;
+
+  DISALLOW_COPY_AND_ASSIGN(RemoteMpdNotifier);
+};
+
+}  // namespace edash_packager
+
+#endif  // MPD_BASE_REMOTE_MPD_NOTIFIER_H_
@@ -0,0 +1,132 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "packager/base/strings/string_number_conversions.h"
+#include "packager/mpd/base/media_info.pb.h"
+#include "packager/mpd/base/mock_mpd_notifier.h"
+#include "packager/mpd/base/mpd_notification_receiver.h"
+#include "packager/mpd/base/remote_mpd_notifier.h"
+
+using ::testing::_;
+using ::testing::DoAll;
+using ::testing::InSequence;
+using ::testing::Return;
+using ::testing::SetArgPointee;
+
+namespace edash_packager {
+namespace {
+
+const uint32_t kReceiverContainerId = 7;
+const uint8_t kKeyId[] = {0x01, 0x02, 0x03};
+const uint8_t kPssh[] = {0x04, 0x05};
+
+MATCHER_P(MediaInfoEq, bandwidth, "") {
+  return arg.bandwidth() == bandwidth;
+}
+
+}  // namespace
+
+class RemoteMpdNotifierTest : public ::testing::Test {
+ protected:
+  RemoteMpdNotifierTest()
+      : notifier_(kLiveProfile), receiver_(&notifier_) {}
+
+  void SetUp() override { ASSERT_TRUE(receiver_.Start(0)); }
+
+  std::string receiver_address() const {
+    return "localhost:" + base::UintToString(receiver_.port());
+  }
+
+  MockMpdNotifier notifier_;
+  MpdNotificationReceiver receiver_;
+};
+
+TEST_F(RemoteMpdNotifierTest, ForwardsNotifications) {
+  MediaInfo media_info;
+  media_info.set_bandwidth(12345);
+  {
+    InSequence in_sequence;
+    EXPECT_CALL(notifier_, NotifyNewContainer(MediaInfoEq(12345u), _))
+        .WillOnce(DoAll(SetArgPointee<1>(kReceiverContainerId), Return(true)));
+    EXPECT_CALL(notifier_, NotifySampleDuration(kReceiverContainerId, 3000))
+        .WillOnce(Return(true));
+    EXPECT_CALL(notifier_, NotifyNewSegment(kReceiverContainerId, 0, 900, 10))
+        .WillOnce(Return(true));
+    EXPECT_CALL(notifier_,
+                NotifyEncryptionUpdate(
+                    kReceiverContainerId, "uuid",
+                    std::vector<uint8_t>(kKeyId, kKeyId + arraysize(kKeyId)),
+                    std::vector<uint8_t>(kPssh, kPssh + arraysize(kPssh))))
+        .WillOnce(Return(true));
+    EXPECT_CALL(notifier_, NotifyNewSegment(kReceiverContainerId, 900, 900, 20))
+        .WillOnce(Return(true));
+    EXPECT_CALL(notifier_, Flush()).WillOnce(Return(true));
+  }
+
+  {
+    RemoteMpdNotifier remote_notifier(kLiveProfile, receiver_address());
+    ASSERT_TRUE(remote_notifier.Init());
+    uint32_t container_id = 0;
+    ASSERT_TRUE(remote_notifier.NotifyNewContainer(media_info, &container_id));
+    EXPECT_TRUE(remote_notifier.NotifySampleDuration(container_id, 3000));
+    EXPECT_TRUE(remote_notifier.NotifyNewSegment(container_id, 0, 900, 10));
+    EXPECT_TRUE(remote_notifier.NotifyEncryptionUpdate(
+        container_id, "uuid",
+        std::vector<uint8_t>(kKeyId, kKeyId + arraysize(kKeyId)),
+        std::vector<uint8_t>(kPssh, kPssh + arraysize(kPssh))));
+    EXPECT_TRUE(remote_notifier.Flush());
+    // Sent when the notifier is deleted.
+    EXPECT_TRUE(remote_notifier.NotifyNewSegment(container_id, 900, 900, 20));
+  }
+  // Waits for the notifications to be forwarded.
+  receiver_.Stop();
+}
+
+TEST_F(RemoteMpdNotifierTest, ContainerIdsOfEachConnection) {
+  // The connections are served concurrently, so the containers are told
+  // apart by their bandwidths.
+  MediaInfo media_info1;
+  media_info1.set_bandwidth(1);
+  MediaInfo media_info2;
+  media_info2.set_bandwidth(2);
+  EXPECT_CALL(notifier_, NotifyNewContainer(MediaInfoEq(1u), _))
+      .WillOnce(DoAll(SetArgPointee<1>(1), Return(true)));
+  EXPECT_CALL(notifier_, NotifyNewContainer(MediaInfoEq(2u), _))
+      .WillOnce(DoAll(SetArgPointee<1>(2), Return(true)));
+  EXPECT_CALL(notifier_, NotifyNewSegment(1, 0, 10, 100))
+      .WillOnce(Return(true));
+  EXPECT_CALL(notifier_, NotifyNewSegment(2, 0, 10, 200))
+      .WillOnce(Return(true));
+  EXPECT_CALL(notifier_, Flush()).Times(2).WillRepeatedly(Return(true));
+
+  RemoteMpdNotifier remote_notifier1(kLiveProfile, receiver_address());
+  RemoteMpdNotifier remote_notifier2(kLiveProfile, receiver_address());
+  ASSERT_TRUE(remote_notifier1.Init());
+  ASSERT_TRUE(remote_notifier2.Init());
+  uint32_t container_id1 = 0;
+  uint32_t container_id2 = 0;
+  ASSERT_TRUE(remote_notifier1.NotifyNewContainer(media_info1, &container_id1));
+  ASSERT_TRUE(remote_notifier1.NotifyNewSegment(container_id1, 0, 10, 100));
+  ASSERT_TRUE(remote_notifier1.Flush());
+  ASSERT_TRUE(remote_notifier2.NotifyNewContainer(media_info2, &container_id2));
+  // Both senders use their own container ids.
+  EXPECT_EQ(container_id1, container_id2);
+  ASSERT_TRUE(remote_notifier2.NotifyNewSegment(container_id2, 0, 10, 200));
+  ASSERT_TRUE(remote_notifier2.Flush());
+}
+
+TEST(RemoteMpdNotifierConnectionTest, FailsWithoutReceiver) {
+  RemoteMpdNotifier remote_notifier(kLiveProfile, "invalid_address");
+  EXPECT_FALSE(remote_notifier.Init());
+  uint32_t container_id = 0;
+  EXPECT_FALSE(remote_notifier.NotifyNewContainer(MediaInfo(), &container_id));
+  EXPECT_FALSE(remote_notifier.Flush());
+}
+
+}  // namespace edash_packager
@@ -0,0 +1,173 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/mpd/base/segment_batching_mpd_notifier.h"
+
+#include "packager/base/logging.h"
+
+namespace edash_packager {
+
+namespace {
+
+// Number of pending segments of a container past which the segments of the
+// other containers are not waited for.
+const size_t kMaxPendingSegments = 2;
+
+}  // namespace
+
+SegmentBatchingMpdNotifier::SegmentBatchingMpdNotifier(
+    scoped_ptr<MpdNotifier> mpd_notifier)
+    : MpdNotifier(mpd_notifier->dash_profile()),
+      mpd_notifier_(mpd_notifier.Pass()),
+      updated_(false) {}
+
+SegmentBatchingMpdNotifier::~SegmentBatchingMpdNotifier() {
+  {
+    base::AutoLock auto_lock(lock_);
+    LOG_IF(WARNING, !PassOnSegments(true)) << "Failed to add new segments.";
+  }
+  Flush();
+}
+
+bool SegmentBatchingMpdNotifier::Init() {
+  return mpd_notifier_->Init();
+}
+
+bool SegmentBatchingMpdNotifier::NotifyNewContainer(const MediaInfo& media_info,
+                                                    uint32_t* container_id) {
+  base::AutoLock auto_lock(lock_);
+  if (!mpd_notifier_->NotifyNewContainer(media_info, container_id))
+    return false;
+  updated_ = true;
+  if (dash_profile() == kLiveProfile)
+    pending_segments_[*container_id].clear();
+  return true;
+}
+
+bool SegmentBatchingMpdNotifier::NotifySampleDuration(
+    uint32_t container_id,
+    uint32_t sample_duration) {
+  base::AutoLock auto_lock(lock_);
+  return SetUpdated(
+      mpd_notifier_->NotifySampleDuration(container_id, sample_duration));
+}
+
+bool SegmentBatchingMpdNotifier::NotifyNewSegment(uint32_t container_id,
+                                                  uint64_t start_time,
+                                                  uint64_t duration,
+                                                  uint64_t size) {
+  base::AutoLock auto_lock(lock_);
+  std::map<uint32_t, std::deque<SegmentNotification> >::iterator iter =
+      pending_segments_.find(container_id);
+  if (iter == pending_segments_.end()) {
+    // Not batched, e.g. VOD or after the end of the container.
+    return SetUpdated(mpd_notifier_->NotifyNewSegment(container_id, start_time,
+                                                      duration, size));
+  }
+  const SegmentNotification segment = {container_id, start_time, duration,
+                                       size};
+  iter->second.push_back(segment);
+  return PassOnSegments(false);
+}
+
+bool SegmentBatchingMpdNotifier::NotifyContainerEnd(uint32_t container_id) {
+  bool result = true;
+  {
+    base::AutoLock auto_lock(lock_);
+    std::map<uint32_t, std::deque<SegmentNotification> >::iterator iter =
+        pending_segments_.find(container_id);
+    if (iter != pending_segments_.end()) {
+      std::vector<SegmentNotification> segments(iter->second.begin(),
+                                                iter->second.end());
+      pending_segments_.erase(iter);
+      if (!segments.empty()) {
+        updated_ = true;
+        result = mpd_notifier_->NotifyNewSegments(segments);
+      }
+      // The segments the container was waited for are complete.
+      if (!PassOnSegments(false))
+        result = false;
+    }
+    if (!mpd_notifier_->NotifyContainerEnd(container_id))
+      result = false;
+  }
+  // Nothing may flush after the last container ends.
+  return Flush() && result;
+}
+
+bool SegmentBatchingMpdNotifier::NotifyEncryptionUpdate(
+    uint32_t container_id,
+    const std::string& drm_uuid,
+    const std::vector<uint8_t>& new_key_id,
+    const std::vector<uint8_t>& new_pssh) {
+  base::AutoLock auto_lock(lock_);
+  return SetUpdated(mpd_notifier_->NotifyEncryptionUpdate(
+      container_id, drm_uuid, new_key_id, new_pssh));
+}
+
+bool SegmentBatchingMpdNotifier::AddContentProtectionElement(
+    uint32_t container_id,
+    const ContentProtectionElement& content_protection_element) {
+  base::AutoLock auto_lock(lock_);
+  return SetUpdated(mpd_notifier_->AddContentProtectionElement(
+      container_id, content_protection_element));
+}
+
+bool SegmentBatchingMpdNotifier::Flush() {
+  {
+    base::AutoLock auto_lock(lock_);
+    if (!updated_)
+      return true;
+    updated_ = false;
+  }
+  return mpd_notifier_->Flush();
+}
+
+bool SegmentBatchingMpdNotifier::PassOnSegments(bool all) {
+  lock_.AssertAcquired();
+  if (pending_segments_.empty())
+    return true;
+
+  for (const auto& entry : pending_segments_) {
+    if (entry.second.size() > kMaxPendingSegments)
+      all = true;
+  }
+
+  // The segments of the same index of the containers are passed on together,
+  // so the segments of each container stay in order.
+  std::vector<SegmentNotification> segments;
+  while (true) {
+    bool any_left = false;
+    bool all_left = true;
+    for (const auto& entry : pending_segments_) {
+      if (entry.second.empty())
+        all_left = false;
+      else
+        any_left = true;
+    }
+    if (all ? !any_left : !all_left)
+      break;
+    for (auto& entry : pending_segments_) {
+      if (entry.second.empty())
+        continue;
+      segments.push_back(entry.second.front());
+      entry.second.pop_front();
+    }
+  }
+  if (segments.empty())
+    return true;
+  // Even on failure, some of the segments may have been added.
+  updated_ = true;
+  return mpd_notifier_->NotifyNewSegments(segments);
+}
+
+bool SegmentBatchingMpdNotifier::SetUpdated(bool result) {
+  if (result)
+    updated_ = true;
+  return result;
+}
+
+}  // namespace edash_packager
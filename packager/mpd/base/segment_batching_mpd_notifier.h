@@ -0,0 +1,81 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MPD_BASE_SEGMENT_BATCHING_MPD_NOTIFIER_H_
+#define MPD_BASE_SEGMENT_BATCHING_MPD_NOTIFIER_H_
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/synchronization/lock.h"
+#include "packager/mpd/base/mpd_notifier.h"
+
+namespace edash_packager {
+
+/// An MpdNotifier which batches the segments of live containers, e.g. the
+/// renditions of a live stream, before passing them on to another notifier.
+/// The Nth segments of all the containers are passed on together, with a
+/// single NotifyNewSegments() call, once the last of them is notified, and
+/// Flush() only flushes the other notifier when it has been updated, so the
+/// MPD is updated once per segment boundary rather than once per container.
+/// A container which falls behind by more than a couple of segments does not
+/// hold the others back: all the pending segments are then passed on.
+/// NotifyContainerEnd() stops waiting for the segments of a container.
+/// This is thread safe.
+class SegmentBatchingMpdNotifier : public MpdNotifier {
+ public:
+  /// @param mpd_notifier is the notifier the notifications are passed on to.
+  explicit SegmentBatchingMpdNotifier(scoped_ptr<MpdNotifier> mpd_notifier);
+  /// Passes the pending segments on, and flushes if needed.
+  ~SegmentBatchingMpdNotifier() override;
+
+  /// @name MpdNotifier implemetation overrides.
+  /// @{
+  bool Init() override;
+  bool NotifyNewContainer(const MediaInfo& media_info,
+                          uint32_t* container_id) override;
+  bool NotifySampleDuration(uint32_t container_id,
+                            uint32_t sample_duration) override;
+  bool NotifyNewSegment(uint32_t container_id,
+                        uint64_t start_time,
+                        uint64_t duration,
+                        uint64_t size) override;
+  bool NotifyContainerEnd(uint32_t container_id) override;
+  bool NotifyEncryptionUpdate(uint32_t container_id,
+                              const std::string& drm_uuid,
+                              const std::vector<uint8_t>& new_key_id,
+                              const std::vector<uint8_t>& new_pssh) override;
+  bool AddContentProtectionElement(
+      uint32_t container_id,
+      const ContentProtectionElement& content_protection_element) override;
+  bool Flush() override;
+  /// @}
+
+ private:
+  // Passes the complete batches of |pending_segments_| on, or all the
+  // pending segments if |all| is true or a container is too far ahead.
+  // Called with |lock_| held, so that the batches are passed on in order.
+  bool PassOnSegments(bool all);
+  // Marks |mpd_notifier_| as updated if |result| is true.
+  bool SetUpdated(bool result);
+
+  scoped_ptr<MpdNotifier> mpd_notifier_;
+
+  base::Lock lock_;
+  // The segments not passed on yet of the containers which have not ended.
+  std::map<uint32_t, std::deque<SegmentNotification> > pending_segments_;
+  // Set if |mpd_notifier_| was updated since the last flush.
+  bool updated_;
+
+  DISALLOW_COPY_AND_ASSIGN(SegmentBatchingMpdNotifier);
+};
+
+}  // namespace edash_packager
+
+#endif  // MPD_BASE_SEGMENT_BATCHING_MPD_NOTIFIER_H_
@@ -0,0 +1,154 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "packager/mpd/base/media_info.pb.h"
+#include "packager/mpd/base/mock_mpd_notifier.h"
+#include "packager/mpd/base/segment_batching_mpd_notifier.h"
+
+using ::testing::_;
+using ::testing::DoAll;
+using ::testing::InSequence;
+using ::testing::Return;
+using ::testing::SetArgPointee;
+using ::testing::StrictMock;
+
+namespace edash_packager {
+namespace {
+
+const uint32_t kVideoContainerId = 1;
+const uint32_t kAudioContainerId = 2;
+const uint64_t kDuration = 1000;
+const uint64_t kSize = 100;
+
+}  // namespace
+
+class SegmentBatchingMpdNotifierTest : public ::testing::Test {
+ protected:
+  void CreateNotifier(DashProfile profile) {
+    mock_notifier_ = new StrictMock<MockMpdNotifier>(profile);
+    notifier_.reset(new SegmentBatchingMpdNotifier(
+        scoped_ptr<MpdNotifier>(mock_notifier_)));
+  }
+
+  // Adds the video and audio containers.
+  void AddContainers() {
+    EXPECT_CALL(*mock_notifier_, NotifyNewContainer(_, _))
+        .WillOnce(DoAll(SetArgPointee<1>(kVideoContainerId), Return(true)))
+        .WillOnce(DoAll(SetArgPointee<1>(kAudioContainerId), Return(true)));
+    EXPECT_CALL(*mock_notifier_, Flush()).WillOnce(Return(true));
+    uint32_t container_id;
+    ASSERT_TRUE(notifier_->NotifyNewContainer(MediaInfo(), &container_id));
+    ASSERT_TRUE(notifier_->NotifyNewContainer(MediaInfo(), &container_id));
+    ASSERT_TRUE(notifier_->Flush());
+    ::testing::Mock::VerifyAndClearExpectations(mock_notifier_);
+  }
+
+  // Owned by |notifier_|.
+  StrictMock<MockMpdNotifier>* mock_notifier_;
+  scoped_ptr<SegmentBatchingMpdNotifier> notifier_;
+};
+
+TEST_F(SegmentBatchingMpdNotifierTest, BatchesSegmentsOfSameIndex) {
+  CreateNotifier(kLiveProfile);
+  AddContainers();
+
+  // Nothing is passed on until the audio segment is notified.
+  EXPECT_TRUE(notifier_->NotifyNewSegment(kVideoContainerId, 0, kDuration,
+                                          kSize));
+  EXPECT_TRUE(notifier_->Flush());
+  ::testing::Mock::VerifyAndClearExpectations(mock_notifier_);
+
+  {
+    InSequence in_sequence;
+    EXPECT_CALL(*mock_notifier_,
+                NotifyNewSegment(kVideoContainerId, 0, kDuration, kSize))
+        .WillOnce(Return(true));
+    EXPECT_CALL(*mock_notifier_,
+                NotifyNewSegment(kAudioContainerId, 0, kDuration, kSize))
+        .WillOnce(Return(true));
+    EXPECT_CALL(*mock_notifier_, Flush()).WillOnce(Return(true));
+  }
+  EXPECT_TRUE(notifier_->NotifyNewSegment(kAudioContainerId, 0, kDuration,
+                                          kSize));
+  EXPECT_TRUE(notifier_->Flush());
+  // Flushing again without any update does nothing.
+  EXPECT_TRUE(notifier_->Flush());
+}
+
+TEST_F(SegmentBatchingMpdNotifierTest, DoesNotWaitForContainerFallingBehind) {
+  CreateNotifier(kLiveProfile);
+  AddContainers();
+
+  EXPECT_TRUE(notifier_->NotifyNewSegment(kVideoContainerId, 0, kDuration,
+                                          kSize));
+  EXPECT_TRUE(notifier_->NotifyNewSegment(kVideoContainerId, kDuration,
+                                          kDuration, kSize));
+  ::testing::Mock::VerifyAndClearExpectations(mock_notifier_);
+
+  {
+    InSequence in_sequence;
+    for (uint64_t i = 0; i < 3; ++i) {
+      EXPECT_CALL(*mock_notifier_, NotifyNewSegment(kVideoContainerId,
+                                                    i * kDuration, kDuration,
+                                                    kSize))
+          .WillOnce(Return(true));
+    }
+  }
+  EXPECT_TRUE(notifier_->NotifyNewSegment(kVideoContainerId, 2 * kDuration,
+                                          kDuration, kSize));
+  ::testing::Mock::VerifyAndClearExpectations(mock_notifier_);
+
+  EXPECT_CALL(*mock_notifier_, Flush()).WillOnce(Return(true));
+  notifier_.reset();
+}
+
+TEST_F(SegmentBatchingMpdNotifierTest, ContainerEnd) {
+  CreateNotifier(kLiveProfile);
+  AddContainers();
+
+  EXPECT_TRUE(notifier_->NotifyNewSegment(kVideoContainerId, 0, kDuration,
+                                          kSize));
+  ::testing::Mock::VerifyAndClearExpectations(mock_notifier_);
+
+  // The audio segments are no longer waited for.
+  {
+    InSequence in_sequence;
+    EXPECT_CALL(*mock_notifier_,
+                NotifyNewSegment(kVideoContainerId, 0, kDuration, kSize))
+        .WillOnce(Return(true));
+    EXPECT_CALL(*mock_notifier_, Flush()).WillOnce(Return(true));
+  }
+  EXPECT_TRUE(notifier_->NotifyContainerEnd(kAudioContainerId));
+  ::testing::Mock::VerifyAndClearExpectations(mock_notifier_);
+
+  EXPECT_CALL(*mock_notifier_, NotifyNewSegment(kVideoContainerId, kDuration,
+                                                kDuration, kSize))
+      .WillOnce(Return(true));
+  EXPECT_TRUE(notifier_->NotifyNewSegment(kVideoContainerId, kDuration,
+                                          kDuration, kSize));
+  ::testing::Mock::VerifyAndClearExpectations(mock_notifier_);
+
+  EXPECT_CALL(*mock_notifier_, Flush()).WillOnce(Return(true));
+  notifier_.reset();
+}
+
+TEST_F(SegmentBatchingMpdNotifierTest, VodSegmentsAreNotBatched) {
+  CreateNotifier(kOnDemandProfile);
+  AddContainers();
+
+  EXPECT_CALL(*mock_notifier_,
+              NotifyNewSegment(kVideoContainerId, 0, kDuration, kSize))
+      .WillOnce(Return(true));
+  EXPECT_CALL(*mock_notifier_, Flush()).WillOnce(Return(true));
+  EXPECT_TRUE(notifier_->NotifyNewSegment(kVideoContainerId, 0, kDuration,
+                                          kSize));
+  EXPECT_TRUE(notifier_->Flush());
+}
+
+}  // namespace edash_packager
@@ -6,13 +6,36 @@
 
 #include "packager/mpd/base/simple_mpd_notifier.h"
 
+#include <algorithm>
+
+#include "packager/base/bind.h"
+#include "packager/base/files/file_path.h"
 #include "packager/base/logging.h"
+#include "packager/base/time/time.h"
+#include "packager/media/base/coalescing_writer.h"
+#include "packager/media/base/pipeline_metrics.h"
+#include "packager/media/file/record_log.h"
 #include "packager/mpd/base/mpd_builder.h"
+#include "packager/mpd/base/mpd_notification.pb.h"
 #include "packager/mpd/base/mpd_notifier_util.h"
 #include "packager/mpd/base/mpd_utils.h"
 
 namespace edash_packager {
 
+using base::FilePath;
+
+namespace {
+
+// Identifies the container of |media_info| across restarts. Live containers
+// have a segment template, which is unique to them.
+std::string GetStateLogKey(const MediaInfo& media_info) {
+  return media_info.has_segment_template()
+             ? media_info.segment_template()
+             : media_info.SerializeAsString();
+}
+
+}  // namespace
+
 SimpleMpdNotifier::SimpleMpdNotifier(DashProfile dash_profile,
                                      const MpdOptions& mpd_options,
                                      const std::vector<std::string>& base_urls,
@@ -22,23 +45,85 @@ SimpleMpdNotifier::SimpleMpdNotifier(DashProfile dash_profile,
       mpd_builder_(new MpdBuilder(dash_profile == kLiveProfile
                                       ? MpdBuilder::kDynamic
                                       : MpdBuilder::kStatic,
-                                  mpd_options)) {
+                                  mpd_options)),
+      adaptation_set_locks_deleter_(&adaptation_set_locks_),
+      state_log_path_(dash_profile == kLiveProfile ? mpd_options.mpd_state_log
+                                                   : std::string()),
+      next_log_id_(0),
+      availability_start_time_logged_(false),
+      manifest_sink_(&file_sink_),
+      mpd_version_(0) {
   DCHECK(dash_profile == kLiveProfile || dash_profile == kOnDemandProfile);
   for (size_t i = 0; i < base_urls.size(); ++i)
     mpd_builder_->AddBaseUrl(base_urls[i]);
+  if (dash_profile == kLiveProfile &&
+      !mpd_options.mpd_patch_location.empty()) {
+    // Players resolve PatchLocation against the URL of the MPD.
+    patch_output_path_ = FilePath(output_path_)
+                             .DirName()
+                             .Append(mpd_options.mpd_patch_location)
+                             .value();
+  }
+  if (mpd_options.mpd_write_coalescing_window > 0) {
+    mpd_writer_.reset(new media::CoalescingWriter(
+        base::Bind(&SimpleMpdNotifier::WriteMpd, base::Unretained(this)),
+        base::TimeDelta::FromMicroseconds(static_cast<int64_t>(
+            mpd_options.mpd_write_coalescing_window *
+            base::Time::kMicrosecondsPerSecond))));
+  }
 }
 
 SimpleMpdNotifier::~SimpleMpdNotifier() {
+  // Writes the pending updates, if any.
+  mpd_writer_.reset();
 }
 
 bool SimpleMpdNotifier::Init() {
+  if (state_log_path_.empty())
+    return true;
+  scoped_ptr<media::RecordLog> state_log(
+      new media::RecordLog(state_log_path_));
+  std::vector<std::string> records;
+  if (!state_log->Open(&records) || !ReplayStateLog(records))
+    return false;
+  if (!records.empty()) {
+    LOG(INFO) << "Restored the MPD from " << records.size()
+              << " records of " << state_log_path_;
+  }
+  state_log_ = state_log.Pass();
   return true;
 }
 
 bool SimpleMpdNotifier::NotifyNewContainer(const MediaInfo& media_info,
                                            uint32_t* container_id) {
   DCHECK(container_id);
+  if (!state_log_)
+    return AddContainer(media_info, 0, container_id);
+
+  uint32_t log_id;
+  {
+    base::AutoLock auto_lock(lock_);
+    std::map<std::string, uint32_t>::iterator restored_container =
+        restored_containers_.find(GetStateLogKey(media_info));
+    if (restored_container != restored_containers_.end()) {
+      *container_id = restored_container->second;
+      restored_containers_.erase(restored_container);
+      return true;
+    }
+    log_id = next_log_id_++;
+  }
+  if (!AddContainer(media_info, log_id, container_id))
+    return false;
+  MpdNotification notification;
+  notification.set_type(MpdNotification::NEW_CONTAINER);
+  notification.set_container_id(log_id);
+  notification.set_media_info(media_info.SerializeAsString());
+  return AppendToStateLog(notification);
+}
 
+bool SimpleMpdNotifier::AddContainer(const MediaInfo& media_info,
+                                     uint32_t log_id,
+                                     uint32_t* container_id) {
   ContentType content_type = GetContentType(media_info);
   if (content_type == kContentTypeUnknown)
     return false;
@@ -50,10 +135,17 @@ bool SimpleMpdNotifier::NotifyNewContainer(const MediaInfo& media_info,
   std::string key = GetAdaptationSetKey(media_info);
   std::string lang = GetLanguage(media_info);
   AdaptationSet** adaptation_set = &adaptation_set_map_[key];
-  if (*adaptation_set == NULL)
+  if (*adaptation_set == NULL) {
     *adaptation_set = mpd_builder_->AddAdaptationSet(lang);
+    LinkTrickPlayAdaptationSets(key, *adaptation_set);
+  }
 
   DCHECK(*adaptation_set);
+  base::Lock** adaptation_set_lock = &adaptation_set_locks_[*adaptation_set];
+  if (*adaptation_set_lock == NULL)
+    *adaptation_set_lock = new base::Lock;
+  base::AutoLock adaptation_set_auto_lock(**adaptation_set_lock);
+
   MediaInfo adjusted_media_info(media_info);
   MpdBuilder::MakePathsRelativeToMpd(output_path_, &adjusted_media_info);
   Representation* representation =
@@ -66,34 +158,91 @@ bool SimpleMpdNotifier::NotifyNewContainer(const MediaInfo& media_info,
   AddContentProtectionElements(media_info, representation);
   *container_id = representation->id();
   DCHECK(!ContainsKey(representation_map_, representation->id()));
-  representation_map_[representation->id()] = representation;
+  RepresentationEntry& entry = representation_map_[representation->id()];
+  entry.representation = representation;
+  entry.lock = *adaptation_set_lock;
+  entry.log_id = log_id;
   return true;
 }
 
 bool SimpleMpdNotifier::NotifySampleDuration(uint32_t container_id,
                                              uint32_t sample_duration) {
-  base::AutoLock auto_lock(lock_);
-  RepresentationMap::iterator it = representation_map_.find(container_id);
-  if (it == representation_map_.end()) {
-    LOG(ERROR) << "Unexpected container_id: " << container_id;
+  RepresentationEntry entry;
+  if (!FindRepresentation(container_id, &entry))
     return false;
-  }
-  it->second->SetSampleDuration(sample_duration);
-  return true;
+  base::AutoLock auto_lock(*entry.lock);
+  entry.representation->SetSampleDuration(sample_duration);
+  if (!state_log_)
+    return true;
+  MpdNotification notification;
+  notification.set_type(MpdNotification::SAMPLE_DURATION);
+  notification.set_container_id(entry.log_id);
+  notification.set_sample_duration(sample_duration);
+  return AppendToStateLog(notification);
 }
 
 bool SimpleMpdNotifier::NotifyNewSegment(uint32_t container_id,
                                          uint64_t start_time,
                                          uint64_t duration,
                                          uint64_t size) {
-  base::AutoLock auto_lock(lock_);
-  RepresentationMap::iterator it = representation_map_.find(container_id);
-  if (it == representation_map_.end()) {
-    LOG(ERROR) << "Unexpected container_id: " << container_id;
+  RepresentationEntry entry;
+  if (!FindRepresentation(container_id, &entry))
     return false;
+  base::AutoLock auto_lock(*entry.lock);
+  entry.representation->AddNewSegment(start_time, duration, size);
+  if (!state_log_)
+    return true;
+  MpdNotification notification;
+  notification.set_type(MpdNotification::NEW_SEGMENT);
+  notification.set_container_id(entry.log_id);
+  notification.set_start_time(start_time);
+  notification.set_duration(duration);
+  notification.set_size(size);
+  return AppendToStateLog(notification);
+}
+
+bool SimpleMpdNotifier::NotifyNewSegments(
+    const std::vector<SegmentNotification>& segments) {
+  // The Representations are looked up under a single acquisition of |lock_|,
+  // and the segments logged under a single acquisition of
+  // |state_log_lock_|.
+  bool result = true;
+  std::vector<const SegmentNotification*> found_segments;
+  std::vector<RepresentationEntry> entries;
+  {
+    base::AutoLock auto_lock(lock_);
+    for (const SegmentNotification& segment : segments) {
+      RepresentationMap::const_iterator it =
+          representation_map_.find(segment.container_id);
+      if (it == representation_map_.end()) {
+        LOG(ERROR) << "Unexpected container_id: " << segment.container_id;
+        result = false;
+        continue;
+      }
+      found_segments.push_back(&segment);
+      entries.push_back(it->second);
+    }
   }
-  it->second->AddNewSegment(start_time, duration, size);
-  return true;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    base::AutoLock auto_lock(*entries[i].lock);
+    entries[i].representation->AddNewSegment(found_segments[i]->start_time,
+                                             found_segments[i]->duration,
+                                             found_segments[i]->size);
+  }
+  if (!state_log_)
+    return result;
+  base::AutoLock auto_lock(state_log_lock_);
+  for (size_t i = 0; i < entries.size(); ++i) {
+    MpdNotification notification;
+    notification.set_type(MpdNotification::NEW_SEGMENT);
+    notification.set_container_id(entries[i].log_id);
+    notification.set_start_time(found_segments[i]->start_time);
+    notification.set_duration(found_segments[i]->duration);
+    notification.set_size(found_segments[i]->size);
+    if (!state_log_->Append(notification.SerializeAsString()))
+      result = false;
+  }
+  return result;
 }
 
 bool SimpleMpdNotifier::NotifyEncryptionUpdate(
@@ -101,33 +250,195 @@ bool SimpleMpdNotifier::NotifyEncryptionUpdate(
     const std::string& drm_uuid,
     const std::vector<uint8_t>& new_key_id,
     const std::vector<uint8_t>& new_pssh) {
-  base::AutoLock auto_lock(lock_);
-  RepresentationMap::iterator it = representation_map_.find(container_id);
-  if (it == representation_map_.end()) {
-    LOG(ERROR) << "Unexpected container_id: " << container_id;
+  RepresentationEntry entry;
+  if (!FindRepresentation(container_id, &entry))
     return false;
-  }
-  it->second->UpdateContentProtectionPssh(drm_uuid,
-                                          Uint8VectorToBase64(new_pssh));
-  return true;
+  base::AutoLock auto_lock(*entry.lock);
+  entry.representation->UpdateContentProtectionPssh(
+      drm_uuid, Uint8VectorToBase64(new_pssh));
+  if (!state_log_)
+    return true;
+  MpdNotification notification;
+  notification.set_type(MpdNotification::ENCRYPTION_UPDATE);
+  notification.set_container_id(entry.log_id);
+  notification.set_drm_uuid(drm_uuid);
+  notification.set_key_id(new_key_id.data(), new_key_id.size());
+  notification.set_pssh(new_pssh.data(), new_pssh.size());
+  return AppendToStateLog(notification);
 }
 
 bool SimpleMpdNotifier::AddContentProtectionElement(
     uint32_t container_id,
     const ContentProtectionElement& content_protection_element) {
+  RepresentationEntry entry;
+  if (!FindRepresentation(container_id, &entry))
+    return false;
+  base::AutoLock auto_lock(*entry.lock);
+  entry.representation->AddContentProtectionElement(
+      content_protection_element);
+  return true;
+}
+
+bool SimpleMpdNotifier::Flush() {
+  if (mpd_writer_) {
+    mpd_writer_->RequestWrite();
+    return true;
+  }
+  return WriteMpd();
+}
+
+bool SimpleMpdNotifier::FindRepresentation(uint32_t container_id,
+                                           RepresentationEntry* entry) {
   base::AutoLock auto_lock(lock_);
-  RepresentationMap::iterator it = representation_map_.find(container_id);
+  RepresentationMap::const_iterator it = representation_map_.find(container_id);
   if (it == representation_map_.end()) {
     LOG(ERROR) << "Unexpected container_id: " << container_id;
     return false;
   }
-  it->second->AddContentProtectionElement(content_protection_element);
+  *entry = it->second;
   return true;
 }
 
-bool SimpleMpdNotifier::Flush() {
-  base::AutoLock auto_lock(lock_);
-  return WriteMpdToFile(output_path_, mpd_builder_.get());
+bool SimpleMpdNotifier::ReplayStateLog(
+    const std::vector<std::string>& records) {
+  DCHECK(!state_log_);
+  // Maps the container ids of the log to the ids of the containers restored.
+  std::map<uint32_t, uint32_t> container_ids;
+  for (const std::string& record : records) {
+    MpdNotification notification;
+    if (!notification.ParseFromString(record)) {
+      LOG(ERROR) << "Failed to parse a record of " << state_log_path_;
+      return false;
+    }
+    if (notification.type() == MpdNotification::AVAILABILITY_START_TIME) {
+      mpd_builder_->set_availability_start_time(
+          notification.availability_start_time());
+      availability_start_time_logged_ = true;
+      continue;
+    }
+    if (notification.type() == MpdNotification::NEW_CONTAINER) {
+      MediaInfo media_info;
+      uint32_t container_id;
+      if (!media_info.ParseFromString(notification.media_info()) ||
+          !AddContainer(media_info, notification.container_id(),
+                        &container_id)) {
+        LOG(ERROR) << "Failed to restore a container of " << state_log_path_;
+        return false;
+      }
+      container_ids[notification.container_id()] = container_id;
+      restored_containers_[GetStateLogKey(media_info)] = container_id;
+      next_log_id_ = std::max(next_log_id_, notification.container_id() + 1);
+      continue;
+    }
+
+    std::map<uint32_t, uint32_t>::const_iterator container_id =
+        container_ids.find(notification.container_id());
+    if (container_id == container_ids.end()) {
+      LOG(ERROR) << "Unexpected container id " << notification.container_id()
+                 << " in " << state_log_path_;
+      return false;
+    }
+    bool result = true;
+    switch (notification.type()) {
+      case MpdNotification::SAMPLE_DURATION:
+        result = NotifySampleDuration(container_id->second,
+                                      notification.sample_duration());
+        break;
+      case MpdNotification::NEW_SEGMENT:
+        result = NotifyNewSegment(container_id->second,
+                                  notification.start_time(),
+                                  notification.duration(), notification.size());
+        break;
+      case MpdNotification::ENCRYPTION_UPDATE:
+        result = NotifyEncryptionUpdate(
+            container_id->second, notification.drm_uuid(),
+            std::vector<uint8_t>(notification.key_id().begin(),
+                                 notification.key_id().end()),
+            std::vector<uint8_t>(notification.pssh().begin(),
+                                 notification.pssh().end()));
+        break;
+      default:
+        LOG(ERROR) << "Unexpected record type " << notification.type()
+                   << " in " << state_log_path_;
+        return false;
+    }
+    if (!result)
+      return false;
+  }
+  return true;
+}
+
+bool SimpleMpdNotifier::AppendToStateLog(const MpdNotification& notification) {
+  DCHECK(state_log_);
+  base::AutoLock auto_lock(state_log_lock_);
+  return state_log_->Append(notification.SerializeAsString());
+}
+
+void SimpleMpdNotifier::LinkTrickPlayAdaptationSets(
+    const std::string& key,
+    AdaptationSet* adaptation_set) {
+  // The main and the trick play AdaptationSets may be added in either order.
+  const std::string main_key = GetTrickPlayMainAdaptationSetKey(key);
+  if (!main_key.empty()) {
+    AdaptationSetMap::const_iterator main_iter =
+        adaptation_set_map_.find(main_key);
+    if (main_iter != adaptation_set_map_.end())
+      adaptation_set->AddTrickPlayReferenceId(main_iter->second->id());
+    return;
+  }
+  AdaptationSetMap::const_iterator trick_play_iter =
+      adaptation_set_map_.find(GetTrickPlayAdaptationSetKey(key));
+  if (trick_play_iter != adaptation_set_map_.end())
+    trick_play_iter->second->AddTrickPlayReferenceId(adaptation_set->id());
+}
+
+void SimpleMpdNotifier::AcquireAllLocks() {
+  lock_.Acquire();
+  for (const auto& adaptation_set_lock : adaptation_set_locks_)
+    adaptation_set_lock.second->Acquire();
+}
+
+void SimpleMpdNotifier::ReleaseAllLocks() {
+  for (const auto& adaptation_set_lock : adaptation_set_locks_)
+    adaptation_set_lock.second->Release();
+  lock_.Release();
+}
+
+bool SimpleMpdNotifier::WriteMpd() {
+  media::ScopedStageTimer manifest_write_timer(media::kManifestWriteStage);
+  CHECK(!output_path_.empty());
+  base::AutoLock publish_auto_lock(publish_lock_);
+  std::string mpd;
+  std::string patch;
+  AcquireAllLocks();
+  const bool result = patch_output_path_.empty()
+                          ? mpd_builder_->ToString(&mpd)
+                          : mpd_builder_->ToStringWithPatch(&mpd, &patch);
+  const std::string availability_start_time =
+      mpd_builder_->availability_start_time();
+  ReleaseAllLocks();
+  if (!result) {
+    LOG(ERROR) << "Failed to write MPD to string.";
+    return false;
+  }
+  if (state_log_ && !availability_start_time_logged_ &&
+      !availability_start_time.empty()) {
+    // The segment times are relative to it, so it must not change across
+    // restarts.
+    MpdNotification notification;
+    notification.set_type(MpdNotification::AVAILABILITY_START_TIME);
+    notification.set_availability_start_time(availability_start_time);
+    if (!AppendToStateLog(notification))
+      return false;
+    availability_start_time_logged_ = true;
+  }
+  ++mpd_version_;
+  if (!manifest_sink_->Publish(output_path_, mpd, mpd_version_))
+    return false;
+  // Without a patch, the previous one does not apply to this MPD, so players
+  // fall back to fetching the full MPD.
+  return patch.empty() ||
+         manifest_sink_->Publish(patch_output_path_, patch, mpd_version_);
 }
 
 }  // namespace edash_packager
@@ -13,14 +13,22 @@
 
 #include "packager/base/gtest_prod_util.h"
 #include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/stl_util.h"
 #include "packager/base/synchronization/lock.h"
+#include "packager/media/file/manifest_sink.h"
 #include "packager/mpd/base/mpd_notifier.h"
 #include "packager/mpd/base/mpd_notifier_util.h"
 
 namespace edash_packager {
 
+namespace media {
+class CoalescingWriter;
+class RecordLog;
+}  // namespace media
+
 class AdaptationSet;
 class MpdBuilder;
+class MpdNotification;
 class Representation;
 class SimpleMpdNotifierTest;
 
@@ -28,6 +36,14 @@ struct MpdOptions;
 
 /// A simple MpdNotifier implementation which receives muxer listener event and
 /// generates an Mpd file.
+/// This is thread safe. The updates of the Representations of different
+/// AdaptationSets do not contend with each other; only the creation of new
+/// containers and the generation of the MPD lock the whole notifier.
+/// If MpdOptions::mpd_state_log is set, the notifications are also appended to
+/// that log, and Init() replays the log left by a previous run. The containers
+/// of the previous run are then resumed by the NotifyNewContainer() calls with
+/// the same segment template, so that a restart of a live packager does not
+/// reset the MPD.
 class SimpleMpdNotifier : public MpdNotifier {
  public:
   SimpleMpdNotifier(DashProfile dash_profile,
@@ -37,7 +53,9 @@ class SimpleMpdNotifier : public MpdNotifier {
   ~SimpleMpdNotifier() override;
 
   /// @name MpdNotifier implemetation overrides.
+  /// AddContentProtectionElement() is not recorded in the MPD state log.
   /// @{
+  /// Restores the MPD from the MPD state log, if enabled.
   bool Init() override;
   bool NotifyNewContainer(const MediaInfo& media_info, uint32_t* id) override;
   bool NotifySampleDuration(uint32_t container_id,
@@ -46,6 +64,8 @@ class SimpleMpdNotifier : public MpdNotifier {
                         uint64_t start_time,
                         uint64_t duration,
                         uint64_t size) override;
+  bool NotifyNewSegments(
+      const std::vector<SegmentNotification>& segments) override;
   bool NotifyEncryptionUpdate(uint32_t container_id,
                               const std::string& drm_uuid,
                               const std::vector<uint8_t>& new_key_id,
@@ -56,9 +76,60 @@ class SimpleMpdNotifier : public MpdNotifier {
   bool Flush() override;
   /// @}
 
+  /// Sets where the MPD is published, instead of being written to the output
+  /// path. The output path still names the MPD, and the media paths are still
+  /// made relative to it.
+  /// @param manifest_sink is not owned and should outlive the notifier. It
+  ///        should be set before the first update.
+  void set_manifest_sink(media::ManifestSink* manifest_sink) {
+    DCHECK(manifest_sink);
+    manifest_sink_ = manifest_sink;
+  }
+
  private:
   friend class SimpleMpdNotifierTest;
 
+  struct RepresentationEntry {
+    Representation* representation;
+    // Lock of the AdaptationSet of |representation|.
+    base::Lock* lock;
+    // Container id of |representation| in the MPD state log, which is stable
+    // across restarts.
+    uint32_t log_id;
+  };
+
+  // Adds the Representation of |media_info|, with |log_id| as its container id
+  // in the MPD state log.
+  bool AddContainer(const MediaInfo& media_info,
+                    uint32_t log_id,
+                    uint32_t* container_id);
+
+  // Applies the notifications of the MPD state log to the MPD.
+  bool ReplayStateLog(const std::vector<std::string>& records);
+
+  // Appends |notification| to the MPD state log.
+  bool AppendToStateLog(const MpdNotification& notification);
+
+  // Looks up the Representation of |container_id|. Returns false if there is
+  // none.
+  bool FindRepresentation(uint32_t container_id, RepresentationEntry* entry);
+
+  // Refers the trick play AdaptationSet to the main one, if both |key| and
+  // its counterpart have one. |adaptation_set| is the new AdaptationSet of
+  // |key|.
+  void LinkTrickPlayAdaptationSets(const std::string& key,
+                                   AdaptationSet* adaptation_set);
+
+  // Acquires |lock_| and the locks of all the AdaptationSets, in this order,
+  // so that the MPD can be generated from a consistent snapshot.
+  void AcquireAllLocks();
+  void ReleaseAllLocks();
+
+  // Serializes the MPD, and the MPD Patch if enabled, under all the locks and
+  // publishes them to |manifest_sink_| outside of them. Runs on the thread of
+  // |mpd_writer_| if write coalescing is enabled.
+  bool WriteMpd();
+
   // Testing only method. Returns a pointer to MpdBuilder.
   MpdBuilder* MpdBuilderForTesting() const {
     return mpd_builder_.get();
@@ -71,15 +142,56 @@ class SimpleMpdNotifier : public MpdNotifier {
 
   // MPD output path.
   std::string output_path_;
+  // Where the MPD Patches are published, i.e. MpdOptions::mpd_patch_location
+  // resolved against |output_path_|. Empty if there are no MPD Patches.
+  std::string patch_output_path_;
   scoped_ptr<MpdBuilder> mpd_builder_;
+  // Protects |mpd_builder_| and the maps below. The Representations and the
+  // AdaptationSets are protected by the lock of their AdaptationSet, in
+  // |adaptation_set_locks_|, instead. Updates take only the latter, after
+  // |lock_| has been released.
   base::Lock lock_;
 
   typedef std::map<std::string, AdaptationSet*> AdaptationSetMap;
   AdaptationSetMap adaptation_set_map_;
 
-  typedef std::map<uint32_t, Representation*> RepresentationMap;
+  // The Representations of an AdaptationSet share state through it, e.g. for
+  // segment alignment, so they are updated under the same lock.
+  typedef std::map<const AdaptationSet*, base::Lock*> AdaptationSetLockMap;
+  AdaptationSetLockMap adaptation_set_locks_;
+  STLValueDeleter<AdaptationSetLockMap> adaptation_set_locks_deleter_;
+
+  typedef std::map<uint32_t, RepresentationEntry> RepresentationMap;
   RepresentationMap representation_map_;
 
+  // MPD state log. Set in Init() if enabled, so that the notifications
+  // replayed from it are not logged again.
+  const std::string state_log_path_;
+  scoped_ptr<media::RecordLog> state_log_;
+  // Serializes the appends to |state_log_|. Acquired last.
+  base::Lock state_log_lock_;
+  // The containers restored from |state_log_| which have not been resumed
+  // yet, by segment template. Protected by |lock_|.
+  std::map<std::string, uint32_t> restored_containers_;
+  // Container id in |state_log_| of the next new container. Protected by
+  // |lock_|.
+  uint32_t next_log_id_;
+  // Whether |state_log_| has the availabilityStartTime. Protected by
+  // |publish_lock_|.
+  bool availability_start_time_logged_;
+
+  media::FileManifestSink file_sink_;
+  media::ManifestSink* manifest_sink_;
+  // Serializes the publication of the MPD versions, so that they reach
+  // |manifest_sink_| in order. Acquired before |lock_|.
+  base::Lock publish_lock_;
+  // Version of the last MPD published. Protected by |publish_lock_|.
+  uint64_t mpd_version_;
+
+  // Writes the MPD in the background if write coalescing is enabled. Declared
+  // last so that it is stopped before the other members are destroyed.
+  scoped_ptr<media::CoalescingWriter> mpd_writer_;
+
   DISALLOW_COPY_AND_ASSIGN(SimpleMpdNotifier);
 };
 
@@ -8,6 +8,8 @@
 
 #include "packager/base/files/file_path.h"
 #include "packager/base/files/file_util.h"
+#include "packager/media/file/manifest_sink.h"
+#include "packager/media/file/memory_file.h"
 #include "packager/mpd/base/mock_mpd_builder.h"
 #include "packager/mpd/base/mpd_builder.h"
 #include "packager/mpd/base/mpd_options.h"
@@ -32,7 +34,59 @@ const char kValidMediaInfo[] =
     "  pixel_height: 1\n"
     "}\n"
     "container_type: 1\n";
+const char kLiveMediaInfo[] =
+    "video_info {\n"
+    "  codec: 'avc1'\n"
+    "  width: 1280\n"
+    "  height: 720\n"
+    "  time_scale: 10\n"
+    "  frame_duration: 10\n"
+    "  pixel_width: 1\n"
+    "  pixel_height: 1\n"
+    "}\n"
+    "reference_time_scale: 10\n"
+    "container_type: 1\n"
+    "init_segment_name: 'init.mp4'\n"
+    "segment_template: '$Number$.m4s'\n";
 const uint32_t kDefaultAdaptationSetId = 0u;
+const char kStateLogFile[] = "memory://mpd_state_log";
+
+// Keeps the manifests published, in memory.
+class RecordingManifestSink : public media::ManifestSink {
+ public:
+  RecordingManifestSink() : version_(0) {}
+  ~RecordingManifestSink() override {}
+
+  bool Publish(const std::string& name,
+               const std::string& content,
+               uint64_t version) override {
+    name_ = name;
+    content_ = content;
+    version_ = version;
+    return true;
+  }
+
+  const std::string& name() const { return name_; }
+  const std::string& content() const { return content_; }
+  uint64_t version() const { return version_; }
+
+ private:
+  std::string name_;
+  std::string content_;
+  uint64_t version_;
+
+  DISALLOW_COPY_AND_ASSIGN(RecordingManifestSink);
+};
+
+// Returns the value of |attribute| in |mpd|.
+std::string GetAttribute(const std::string& mpd, const std::string& attribute) {
+  const std::string prefix = " " + attribute + "=\"";
+  const size_t start = mpd.find(prefix);
+  if (start == std::string::npos)
+    return "";
+  const size_t end = mpd.find('"', start + prefix.size());
+  return mpd.substr(start + prefix.size(), end - start - prefix.size());
+}
 }  // namespace
 
 class SimpleMpdNotifierTest
@@ -196,6 +250,47 @@ TEST_F(SimpleMpdNotifierTest, NotifyNewContainerAndSampleDurationNoMock) {
   EXPECT_TRUE(notifier.Flush());
 }
 
+// Verify that the MPD is written on destruction when the writes are coalesced.
+TEST_F(SimpleMpdNotifierTest, CoalescedWrites) {
+  MpdOptions mpd_options;
+  // Long enough that the flushes below are coalesced.
+  mpd_options.mpd_write_coalescing_window = 3600;
+  {
+    SimpleMpdNotifier notifier(kLiveProfile, mpd_options, empty_base_urls_,
+                               output_path_);
+    uint32_t container_id;
+    EXPECT_TRUE(notifier.NotifyNewContainer(
+        ConvertToMediaInfo(kValidMediaInfo), &container_id));
+    for (int i = 0; i < 10; ++i)
+      EXPECT_TRUE(notifier.Flush());
+  }
+
+  std::string mpd;
+  ASSERT_TRUE(base::ReadFileToString(temp_file_path_, &mpd));
+  EXPECT_NE(std::string::npos, mpd.find("<Representation"));
+}
+
+// Verify that the MPD is published to the manifest sink, with increasing
+// versions, and not written to the output path.
+TEST_F(SimpleMpdNotifierTest, PublishesToManifestSink) {
+  ASSERT_TRUE(base::DeleteFile(temp_file_path_, false));
+  RecordingManifestSink sink;
+  SimpleMpdNotifier notifier(kLiveProfile, empty_mpd_option_, empty_base_urls_,
+                             output_path_);
+  notifier.set_manifest_sink(&sink);
+  uint32_t container_id;
+  EXPECT_TRUE(notifier.NotifyNewContainer(ConvertToMediaInfo(kValidMediaInfo),
+                                          &container_id));
+  EXPECT_TRUE(notifier.Flush());
+  EXPECT_EQ(output_path_, sink.name());
+  EXPECT_EQ(1u, sink.version());
+  EXPECT_NE(std::string::npos, sink.content().find("<Representation"));
+
+  EXPECT_TRUE(notifier.Flush());
+  EXPECT_EQ(2u, sink.version());
+  EXPECT_FALSE(base::PathExists(temp_file_path_));
+}
+
 // Verify that NotifyNewSegment() for live works.
 TEST_F(SimpleMpdNotifierTest, LiveNotifyNewSegment) {
   SimpleMpdNotifier notifier(kLiveProfile, empty_mpd_option_, empty_base_urls_,
@@ -227,6 +322,54 @@ TEST_F(SimpleMpdNotifierTest, LiveNotifyNewSegment) {
                                         kSegmentDuration, kSegmentSize));
 }
 
+// Verify that a restarted notifier resumes the MPD saved in its state log.
+TEST_F(SimpleMpdNotifierTest, RestoresMpdFromStateLog) {
+  MpdOptions mpd_options;
+  mpd_options.mpd_state_log = kStateLogFile;
+  const MediaInfo media_info = ConvertToMediaInfo(kLiveMediaInfo);
+  const uint64_t kSegmentDuration = 20u;
+  const uint64_t kSegmentSize = 1000u;
+
+  std::string availability_start_time;
+  {
+    RecordingManifestSink sink;
+    SimpleMpdNotifier notifier(kLiveProfile, mpd_options, empty_base_urls_,
+                               output_path_);
+    notifier.set_manifest_sink(&sink);
+    ASSERT_TRUE(notifier.Init());
+    uint32_t container_id;
+    ASSERT_TRUE(notifier.NotifyNewContainer(media_info, &container_id));
+    for (uint64_t i = 0; i < 3; ++i) {
+      ASSERT_TRUE(notifier.NotifyNewSegment(container_id, i * kSegmentDuration,
+                                            kSegmentDuration, kSegmentSize));
+    }
+    ASSERT_TRUE(notifier.Flush());
+    availability_start_time =
+        GetAttribute(sink.content(), "availabilityStartTime");
+    ASSERT_FALSE(availability_start_time.empty());
+  }
+
+  RecordingManifestSink sink;
+  SimpleMpdNotifier notifier(kLiveProfile, mpd_options, empty_base_urls_,
+                             output_path_);
+  notifier.set_manifest_sink(&sink);
+  ASSERT_TRUE(notifier.Init());
+  uint32_t container_id;
+  ASSERT_TRUE(notifier.NotifyNewContainer(media_info, &container_id));
+  ASSERT_TRUE(notifier.NotifyNewSegment(container_id, 3 * kSegmentDuration,
+                                        kSegmentDuration, kSegmentSize));
+  ASSERT_TRUE(notifier.Flush());
+  // The segments of both runs are in the same Representation.
+  const size_t representation = sink.content().find("<Representation");
+  ASSERT_NE(std::string::npos, representation);
+  EXPECT_EQ(std::string::npos,
+            sink.content().find("<Representation", representation + 1));
+  EXPECT_NE(std::string::npos, sink.content().find("r=\"3\""));
+  EXPECT_EQ(availability_start_time,
+            GetAttribute(sink.content(), "availabilityStartTime"));
+  media::MemoryFile::DeleteAll();
+}
+
 // Verify AddContentProtectionElement() works. Profile doesn't matter.
 TEST_F(SimpleMpdNotifierTest, AddContentProtectionElement) {
   SimpleMpdNotifier notifier(kOnDemandProfile, empty_mpd_option_,
@@ -32,6 +32,7 @@ struct XmlDeleter {
   inline void operator()(xmlNodePtr ptr) const { xmlFreeNode(ptr); }
   inline void operator()(xmlDocPtr ptr) const { xmlFreeDoc(ptr); }
   inline void operator()(xmlChar* ptr) const { xmlFree(ptr); }
+  inline void operator()(xmlBufferPtr ptr) const { xmlBufferFree(ptr); }
 };
 
 template <typename XmlType>
@@ -12,9 +12,9 @@
 #include "packager/base/logging.h"
 #include "packager/base/macros.h"
 #include "packager/base/stl_util.h"
-#include "packager/base/sys_byteorder.h"
 #include "packager/base/strings/string_number_conversions.h"
 #include "packager/mpd/base/media_info.pb.h"
+#include "packager/mpd/base/mpd_utils.h"
 #include "packager/mpd/base/segment_info.h"
 
 using edash_packager::xml::XmlNode;
@@ -28,16 +28,15 @@ typedef ContentProtectionXml::AttributeNameValuePair AttributeNameValuePair;
 namespace edash_packager {
 
 namespace {
-const char kEC3Codec[] = "ec-3";
 
 std::string RangeToString(const Range& range) {
   return base::Uint64ToString(range.begin()) + "-" +
          base::Uint64ToString(range.end());
 }
 
-bool PopulateSegmentTimeline(const std::list<SegmentInfo>& segment_infos,
+bool PopulateSegmentTimeline(const std::deque<SegmentInfo>& segment_infos,
                              XmlNode* segment_timeline) {
-  for (std::list<SegmentInfo>::const_iterator it = segment_infos.begin();
+  for (std::deque<SegmentInfo>::const_iterator it = segment_infos.begin();
        it != segment_infos.end();
        ++it) {
     XmlNode s_element("S");
@@ -213,6 +212,15 @@ void AdaptationSetXmlNode::AddRoleElement(const std::string& scheme_id_uri,
   AddChild(role.PassScopedPtr());
 }
 
+void AdaptationSetXmlNode::AddEssentialProperty(
+    const std::string& scheme_id_uri,
+    const std::string& value) {
+  XmlNode essential_property("EssentialProperty");
+  essential_property.SetStringAttribute("schemeIdUri", scheme_id_uri);
+  essential_property.SetStringAttribute("value", value);
+  AddChild(essential_property.PassScopedPtr());
+}
+
 RepresentationXmlNode::RepresentationXmlNode()
     : RepresentationBaseXmlNode("Representation") {}
 RepresentationXmlNode::~RepresentationXmlNode() {}
@@ -241,6 +249,10 @@ bool RepresentationXmlNode::AddVideoInfo(const VideoInfo& video_info,
                        base::IntToString(video_info.time_scale()) + "/" +
                            base::IntToString(video_info.frame_duration()));
   }
+  if (video_info.has_trick_play_factor()) {
+    SetIntegerAttribute("maxPlayoutRate", video_info.trick_play_factor());
+    SetStringAttribute("codingDependency", "false");
+  }
   return true;
 }
 
@@ -301,13 +313,49 @@ bool RepresentationXmlNode::AddVODOnlyInfo(const MediaInfo& media_info) {
 
 bool RepresentationXmlNode::AddLiveOnlyInfo(
     const MediaInfo& media_info,
-    const std::list<SegmentInfo>& segment_infos,
+    const std::deque<SegmentInfo>& segment_infos,
     uint32_t start_number) {
+  // TODO(rkuroiwa): Find out when a live MPD doesn't require SegmentTimeline.
+  XmlNode segment_timeline("SegmentTimeline");
+  return PopulateSegmentTimeline(segment_infos, &segment_timeline) &&
+         AddSegmentTemplate(media_info, start_number, 0,
+                            segment_timeline.PassScopedPtr());
+}
+
+bool RepresentationXmlNode::AddLiveOnlyInfo(
+    const MediaInfo& media_info,
+    const std::string& segment_timeline_content,
+    uint32_t start_number) {
+  XmlNode segment_timeline("SegmentTimeline");
+  segment_timeline.SetContent(segment_timeline_content);
+  return AddSegmentTemplate(media_info, start_number, 0,
+                            segment_timeline.PassScopedPtr());
+}
+
+bool RepresentationXmlNode::AddConstantDurationLiveOnlyInfo(
+    const MediaInfo& media_info,
+    uint64_t segment_duration) {
+  DCHECK_GT(segment_duration, 0u);
+  const uint32_t kFirstSegmentNumber = 1;
+  return AddSegmentTemplate(media_info, kFirstSegmentNumber, segment_duration,
+                            scoped_xml_ptr<xmlNode>());
+}
+
+bool RepresentationXmlNode::AddSegmentTemplate(
+    const MediaInfo& media_info,
+    uint32_t start_number,
+    uint64_t segment_duration,
+    scoped_xml_ptr<xmlNode> segment_timeline) {
   XmlNode segment_template("SegmentTemplate");
   if (media_info.has_reference_time_scale()) {
     segment_template.SetIntegerAttribute("timescale",
                                          media_info.reference_time_scale());
   }
+  if (media_info.has_availability_time_offset_seconds()) {
+    segment_template.SetFloatingPointAttribute(
+        "availabilityTimeOffset",
+        media_info.availability_time_offset_seconds());
+  }
 
   if (media_info.has_init_segment_name()) {
     // The spec does not allow '$Number$' and '$Time$' in initialization
@@ -331,37 +379,23 @@ bool RepresentationXmlNode::AddLiveOnlyInfo(
     // TODO(rkuroiwa): Need a better check. $$Number is legitimate but not a
     // template.
     if (media_info.segment_template().find("$Number") != std::string::npos) {
+      if (segment_duration > 0)
+        segment_template.SetIntegerAttribute("duration", segment_duration);
       DCHECK_GE(start_number, 1u);
       segment_template.SetIntegerAttribute("startNumber", start_number);
     }
   }
 
-  // TODO(rkuroiwa): Find out when a live MPD doesn't require SegmentTimeline.
-  XmlNode segment_timeline("SegmentTimeline");
-
-  return PopulateSegmentTimeline(segment_infos, &segment_timeline) &&
-         segment_template.AddChild(segment_timeline.PassScopedPtr()) &&
-         AddChild(segment_template.PassScopedPtr());
+  if (segment_timeline && !segment_template.AddChild(segment_timeline.Pass()))
+    return false;
+  return AddChild(segment_template.PassScopedPtr());
 }
 
 bool RepresentationXmlNode::AddAudioChannelInfo(const AudioInfo& audio_info) {
   std::string audio_channel_config_scheme;
   std::string audio_channel_config_value;
-
-  if (audio_info.codec() == kEC3Codec) {
-    // Convert EC3 channel map into string of hexadecimal digits. Spec: DASH-IF
-    // Interoperability Points v3.0 9.2.1.2.
-    const uint16_t ec3_channel_map =
-        base::HostToNet16(audio_info.codec_specific_data().ec3_channel_map());
-    audio_channel_config_value =
-        base::HexEncode(&ec3_channel_map, sizeof(ec3_channel_map));
-    audio_channel_config_scheme =
-        "tag:dolby.com,2014:dash:audio_channel_configuration:2011";
-  } else {
-    audio_channel_config_value = base::UintToString(audio_info.num_channels());
-    audio_channel_config_scheme =
-        "urn:mpeg:dash:23003:3:audio_channel_configuration:2011";
-  }
+  GetAudioChannelConfiguration(audio_info, &audio_channel_config_scheme,
+                               &audio_channel_config_value);
 
   XmlNode audio_channel_config("AudioChannelConfiguration");
   audio_channel_config.SetStringAttribute("schemeIdUri",
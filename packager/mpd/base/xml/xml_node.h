@@ -13,7 +13,9 @@
 #include <libxml/tree.h>
 #include <stdint.h>
 
+#include <deque>
 #include <list>
+#include <string>
 
 #include "packager/mpd/base/content_protection_element.h"
 #include "packager/mpd/base/media_info.pb.h"
@@ -120,6 +122,11 @@ class AdaptationSetXmlNode : public RepresentationBaseXmlNode {
   void AddRoleElement(const std::string& scheme_id_uri,
                       const std::string& value);
 
+  /// @param scheme_id_uri is content of the schemeIdUri attribute.
+  /// @param value is the content of value attribute.
+  void AddEssentialProperty(const std::string& scheme_id_uri,
+                            const std::string& value);
+
  private:
   DISALLOW_COPY_AND_ASSIGN(AdaptationSetXmlNode);
 };
@@ -157,10 +164,32 @@ class RepresentationXmlNode : public RepresentationBaseXmlNode {
   /// @param segment_infos is a set of SegmentInfos. This method assumes that
   ///        SegmentInfos are sorted by its start time.
   bool AddLiveOnlyInfo(const MediaInfo& media_info,
-                       const std::list<SegmentInfo>& segment_infos,
+                       const std::deque<SegmentInfo>& segment_infos,
+                       uint32_t start_number);
+
+  /// Same as above, except that the SegmentTimeline element only contains
+  /// the text @a segment_timeline_content instead of the <S> elements. This
+  /// lets the caller splice in <S> elements serialized separately.
+  bool AddLiveOnlyInfo(const MediaInfo& media_info,
+                       const std::string& segment_timeline_content,
                        uint32_t start_number);
 
+  /// Same as above, except that the segments are addressed with
+  /// SegmentTemplate@duration, numbered from 1, instead of a SegmentTimeline.
+  /// @param segment_duration is the duration of every segment, in the
+  ///        timescale of the SegmentTemplate.
+  bool AddConstantDurationLiveOnlyInfo(const MediaInfo& media_info,
+                                       uint64_t segment_duration);
+
  private:
+  // Add SegmentTemplate element with |segment_timeline| as its child. If
+  // |segment_duration| is not 0, it is the 'duration' attribute and there is
+  // no |segment_timeline|.
+  bool AddSegmentTemplate(const MediaInfo& media_info,
+                          uint32_t start_number,
+                          uint64_t segment_duration,
+                          scoped_xml_ptr<xmlNode> segment_timeline);
+
   // Add AudioChannelConfiguration element. Note that it is a required element
   // for audio Representations.
   bool AddAudioChannelInfo(const MediaInfo::AudioInfo& audio_info);
@@ -7,6 +7,7 @@
 #include <gtest/gtest.h>
 #include <libxml/tree.h>
 
+#include <deque>
 #include <list>
 
 #include "packager/base/logging.h"
@@ -78,7 +79,7 @@ class RepresentationTest : public ::testing::Test {
 
  protected:
   RepresentationXmlNode representation_;
-  std::list<SegmentInfo> segment_infos_;
+  std::deque<SegmentInfo> segment_infos_;
 };
 
 // Make sure XmlEqual() is functioning correctly.
@@ -256,5 +257,31 @@ TEST_F(RepresentationTest, InvalidLiveInitSegmentName) {
       media_info, segment_infos_, kDefaultStartNumber));
 }
 
+// Low latency chunked output makes segments available ahead of time.
+TEST_F(RepresentationTest, AddAvailabilityTimeOffset) {
+  MediaInfo media_info;
+  const uint32_t kDefaultStartNumber = 1;
+  media_info.set_reference_time_scale(1000);
+  media_info.set_availability_time_offset_seconds(1.5);
+  media_info.set_init_segment_name("init.mp4");
+  media_info.set_segment_template("$Time$.mp4");
+  SegmentInfo segment_info = {0, 2000, 0};
+  segment_infos_.push_back(segment_info);
+  ASSERT_TRUE(representation_.AddLiveOnlyInfo(
+      media_info, segment_infos_, kDefaultStartNumber));
+  scoped_xml_ptr<xmlDoc> doc(MakeDoc(representation_.PassScopedPtr()));
+
+  ASSERT_TRUE(XmlEqual(
+      "<Representation>\n"
+      "  <SegmentTemplate timescale=\"1000\" availabilityTimeOffset=\"1.5\"\n"
+      "   initialization=\"init.mp4\" media=\"$Time$.mp4\">\n"
+      "    <SegmentTimeline>\n"
+      "      <S t=\"0\" d=\"2000\"/>\n"
+      "    </SegmentTimeline>\n"
+      "  </SegmentTemplate>\n"
+      "</Representation>\n",
+      doc.get()));
+}
+
 }  // namespace xml
 }  // namespace edash_packager
@@ -0,0 +1,239 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/mpd/base/xml/xml_string_writer.h"
+
+#include <algorithm>
+
+#include "packager/base/logging.h"
+#include "packager/base/strings/string_number_conversions.h"
+
+namespace edash_packager {
+namespace xml {
+
+namespace {
+
+// libxml2 indents by two spaces per level, up to 60 spaces.
+const size_t kIndentSize = 2;
+const size_t kMaxIndentLevel = 30;
+
+// Same as xmlBufAttrSerializeTxtContent() for UTF-8 documents.
+void AppendEscapedAttribute(const std::string& attribute,
+                            std::string* output) {
+  for (const char c : attribute) {
+    switch (c) {
+      case '\n':
+        output->append("&#10;");
+        break;
+      case '\r':
+        output->append("&#13;");
+        break;
+      case '\t':
+        output->append("&#9;");
+        break;
+      case '"':
+        output->append("&quot;");
+        break;
+      case '<':
+        output->append("&lt;");
+        break;
+      case '>':
+        output->append("&gt;");
+        break;
+      case '&':
+        output->append("&amp;");
+        break;
+      default:
+        output->push_back(c);
+        break;
+    }
+  }
+}
+
+// Same as xmlEscapeContent(), which escapes text content.
+void AppendEscapedContent(const std::string& content, std::string* output) {
+  for (const char c : content) {
+    switch (c) {
+      case '<':
+        output->append("&lt;");
+        break;
+      case '>':
+        output->append("&gt;");
+        break;
+      case '&':
+        output->append("&amp;");
+        break;
+      case '\r':
+        output->append("&#13;");
+        break;
+      default:
+        output->push_back(c);
+        break;
+    }
+  }
+}
+
+}  // namespace
+
+XmlStringWriter::XmlStringWriter(std::string* output)
+    : output_(output), base_level_(0), start_tag_pending_(false) {
+  DCHECK(output_);
+  output_->clear();
+}
+
+XmlStringWriter::XmlStringWriter(std::string* output, size_t level)
+    : output_(output), base_level_(level), start_tag_pending_(false) {
+  DCHECK(output_);
+  DCHECK_GT(level, 0u);
+  output_->clear();
+}
+
+XmlStringWriter::~XmlStringWriter() {}
+
+void XmlStringWriter::WriteXmlDeclaration() {
+  DCHECK(output_->empty());
+  output_->append("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+}
+
+void XmlStringWriter::WriteComment(const std::string& comment) {
+  DCHECK(open_elements_.empty());
+  output_->append("<!--");
+  output_->append(comment);
+  output_->append("-->");
+  EndChild();
+}
+
+void XmlStringWriter::StartElement(const char* name) {
+  DCHECK(name);
+  StartChild();
+  OpenElement element = {name, false, false};
+  open_elements_.push_back(element);
+  attributes_.clear();
+  start_tag_pending_ = true;
+}
+
+void XmlStringWriter::EndElement() {
+  DCHECK(!open_elements_.empty());
+  const OpenElement& element = open_elements_.back();
+  if (start_tag_pending_) {
+    WriteStartTag();
+    output_->append("/>");
+  } else {
+    if (element.has_children)
+      WriteIndent(open_elements_.size() - 1);
+    output_->append("</");
+    output_->append(element.name);
+    output_->push_back('>');
+  }
+  open_elements_.pop_back();
+  start_tag_pending_ = false;
+  EndChild();
+}
+
+void XmlStringWriter::SetStringAttribute(const char* attribute_name,
+                                         const std::string& attribute) {
+  DCHECK(attribute_name);
+  DCHECK(start_tag_pending_)
+      << "Attributes must be set before the content or the children.";
+  for (std::pair<std::string, std::string>& existing : attributes_) {
+    if (existing.first == attribute_name) {
+      existing.second = attribute;
+      return;
+    }
+  }
+  attributes_.push_back(std::make_pair(attribute_name, attribute));
+}
+
+void XmlStringWriter::SetIntegerAttribute(const char* attribute_name,
+                                          uint64_t number) {
+  SetStringAttribute(attribute_name, base::Uint64ToString(number));
+}
+
+void XmlStringWriter::SetFloatingPointAttribute(const char* attribute_name,
+                                                double number) {
+  SetStringAttribute(attribute_name, base::DoubleToString(number));
+}
+
+void XmlStringWriter::SetId(uint32_t id) {
+  SetIntegerAttribute("id", id);
+}
+
+void XmlStringWriter::SetContent(const std::string& content) {
+  DCHECK(!open_elements_.empty());
+  DCHECK(start_tag_pending_)
+      << "The content must be set once, on an element without children.";
+  if (content.empty())
+    return;
+  WriteStartTag();
+  output_->push_back('>');
+  start_tag_pending_ = false;
+  open_elements_.back().has_content = true;
+  AppendEscapedContent(content, output_);
+}
+
+void XmlStringWriter::AddSerializedElement(const std::string& element) {
+  DCHECK(!open_elements_.empty());
+  StartChild();
+  output_->append(element);
+  EndChild();
+}
+
+void XmlStringWriter::AddSerializedChildren(const std::string& children) {
+  DCHECK(!open_elements_.empty());
+  if (children.empty())
+    return;
+  OpenChildren();
+  output_->append(children);
+}
+
+void XmlStringWriter::StartChild() {
+  if (open_elements_.empty()) {
+    // The top level elements of a fragment are indented.
+    WriteIndent(0);
+    return;
+  }
+  OpenChildren();
+  WriteIndent(open_elements_.size());
+}
+
+void XmlStringWriter::OpenChildren() {
+  OpenElement* parent = &open_elements_.back();
+  // libxml2 does not format mixed content. It is never generated.
+  DCHECK(!parent->has_content) << "Element " << parent->name
+                               << " cannot have both content and children.";
+  if (start_tag_pending_) {
+    WriteStartTag();
+    output_->append(">\n");
+    start_tag_pending_ = false;
+  }
+  parent->has_children = true;
+}
+
+void XmlStringWriter::EndChild() {
+  output_->push_back('\n');
+}
+
+void XmlStringWriter::WriteStartTag() {
+  DCHECK(start_tag_pending_);
+  output_->push_back('<');
+  output_->append(open_elements_.back().name);
+  for (const std::pair<std::string, std::string>& attribute : attributes_) {
+    output_->push_back(' ');
+    output_->append(attribute.first);
+    output_->append("=\"");
+    AppendEscapedAttribute(attribute.second, output_);
+    output_->push_back('"');
+  }
+  attributes_.clear();
+}
+
+void XmlStringWriter::WriteIndent(size_t level) {
+  output_->append(kIndentSize * std::min(base_level_ + level, kMaxIndentLevel),
+                 ' ');
+}
+
+}  // namespace xml
+}  // namespace edash_packager
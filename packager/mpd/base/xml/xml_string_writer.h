@@ -0,0 +1,125 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MPD_BASE_XML_XML_STRING_WRITER_H_
+#define MPD_BASE_XML_XML_STRING_WRITER_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "packager/base/macros.h"
+
+namespace edash_packager {
+namespace xml {
+
+/// Writes an XML document straight into a string, without building a tree.
+/// The output is formatted and escaped the same way as libxml2's
+/// xmlDocDumpFormatMemoryEnc() with UTF-8 encoding and formatting enabled, so
+/// it is identical to dumping the equivalent tree of XmlNodes.
+/// Elements are written in document order: StartElement(), then the
+/// attributes, then the content or the child elements, then EndElement().
+/// The attributes of an element can be set until its content or its first
+/// child is added. The set methods have the same semantics as XmlNode's.
+/// The document is incomplete until all the elements are ended.
+class XmlStringWriter {
+ public:
+  /// @param output is where the document gets written. It is cleared, but
+  ///        keeps its capacity, so it can be pre-sized by the caller.
+  explicit XmlStringWriter(std::string* output);
+  /// Writes a fragment of a document instead: the children of an element,
+  /// indented for @a level, to be added with AddSerializedChildren().
+  /// @param output is where the fragment gets written. It is cleared.
+  /// @param level is the level of the children, i.e. the depth() of the
+  ///        writer of the document they will be added to.
+  XmlStringWriter(std::string* output, size_t level);
+  ~XmlStringWriter();
+
+  /// Writes the XML declaration. Must be called first, if at all.
+  void WriteXmlDeclaration();
+
+  /// Writes a comment at the top level of the document.
+  /// @param comment is the text of the comment, which is not escaped.
+  void WriteComment(const std::string& comment);
+
+  /// Starts an element. It is a child of the current element, if any.
+  /// @param name is the name of the element, which should not be NULL.
+  void StartElement(const char* name);
+
+  /// Ends the current element.
+  void EndElement();
+
+  /// @name Attribute methods. Setting an attribute again replaces its value,
+  ///       but keeps its position.
+  /// @{
+  void SetStringAttribute(const char* attribute_name,
+                          const std::string& attribute);
+  void SetIntegerAttribute(const char* attribute_name, uint64_t number);
+  void SetFloatingPointAttribute(const char* attribute_name, double number);
+  void SetId(uint32_t id);
+  /// @}
+
+  /// Sets the text of the current element, which must not have children.
+  /// Unlike XmlNode::SetContent(), entity references in @a content are not
+  /// interpreted, i.e. it is always escaped.
+  /// @param content is the text of the element. Nothing is written if it is
+  ///        empty.
+  void SetContent(const std::string& content);
+
+  /// Adds a child element which has already been serialized, e.g. cached
+  /// from an earlier document. It is indented like any other child.
+  /// @param element is the serialized element, without leading indentation
+  ///        or trailing new line.
+  void AddSerializedElement(const std::string& element);
+
+  /// Adds children which have already been serialized by a fragment writer
+  /// at depth(), e.g. cached from an earlier document.
+  /// @param children is the output of the fragment writer. Nothing is
+  ///        written if it is empty.
+  void AddSerializedChildren(const std::string& children);
+
+  /// @return The number of elements started and not ended yet, plus the
+  ///         level of a fragment, i.e. the level of the children of the
+  ///         current element.
+  size_t depth() const { return base_level_ + open_elements_.size(); }
+
+ private:
+  struct OpenElement {
+    std::string name;
+    bool has_children;
+    bool has_content;
+  };
+
+  // Prepares for a new child of the current element: closes the start tag of
+  // the current element if needed, and indents.
+  void StartChild();
+  // Closes the start tag of the current element if needed, and marks it as
+  // having children.
+  void OpenChildren();
+  // Terminates a child of the current element, or a top level node.
+  void EndChild();
+  // Writes '<', the name and the attributes of the current element.
+  void WriteStartTag();
+  void WriteIndent(size_t level);
+
+  std::string* const output_;
+  // The level of the top level elements, non-zero for a fragment.
+  const size_t base_level_;
+  std::vector<OpenElement> open_elements_;
+  // Attributes of the current element, if its start tag has not been written
+  // yet.
+  std::vector<std::pair<std::string, std::string> > attributes_;
+  bool start_tag_pending_;
+
+  DISALLOW_COPY_AND_ASSIGN(XmlStringWriter);
+};
+
+}  // namespace xml
+}  // namespace edash_packager
+
+#endif  // MPD_BASE_XML_XML_STRING_WRITER_H_
@@ -0,0 +1,237 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+#include <libxml/tree.h>
+
+#include <string>
+
+#include "packager/mpd/base/xml/scoped_xml_ptr.h"
+#include "packager/mpd/base/xml/xml_node.h"
+#include "packager/mpd/base/xml/xml_string_writer.h"
+
+namespace edash_packager {
+namespace xml {
+
+namespace {
+
+// Dumps |root| the way MpdBuilder does, with |comment| before it.
+std::string DumpWithLibXml(const std::string& comment, XmlNode* root) {
+  scoped_xml_ptr<xmlDoc> doc(xmlNewDoc(BAD_CAST "1.0"));
+  scoped_xml_ptr<xmlNode> comment_node(
+      xmlNewDocComment(doc.get(), BAD_CAST comment.c_str()));
+  xmlDocSetRootElement(doc.get(), comment_node.get());
+  xmlAddSibling(comment_node.release(), root->Release());
+
+  static const int kNiceFormat = 1;
+  int doc_str_size = 0;
+  xmlChar* doc_str = NULL;
+  xmlDocDumpFormatMemoryEnc(doc.get(), &doc_str, &doc_str_size, "UTF-8",
+                            kNiceFormat);
+  std::string output(doc_str, doc_str + doc_str_size);
+  xmlFree(doc_str);
+  return output;
+}
+
+}  // namespace
+
+TEST(XmlStringWriterTest, EmptyElement) {
+  XmlNode root("Root");
+  root.SetStringAttribute("a", "1");
+
+  std::string output;
+  XmlStringWriter writer(&output);
+  writer.WriteXmlDeclaration();
+  writer.WriteComment("comment");
+  writer.StartElement("Root");
+  writer.SetStringAttribute("a", "1");
+  writer.EndElement();
+
+  EXPECT_EQ(DumpWithLibXml("comment", &root), output);
+}
+
+TEST(XmlStringWriterTest, NestedElements) {
+  XmlNode root("Root");
+  root.SetId(3);
+  XmlNode child1("Child");
+  child1.SetIntegerAttribute("number", 12345678901234ULL);
+  child1.SetFloatingPointAttribute("float", 10.5);
+  XmlNode grandchild("GrandChild");
+  grandchild.SetContent("text");
+  ASSERT_TRUE(child1.AddChild(grandchild.PassScopedPtr()));
+  XmlNode empty_grandchild("EmptyGrandChild");
+  ASSERT_TRUE(child1.AddChild(empty_grandchild.PassScopedPtr()));
+  ASSERT_TRUE(root.AddChild(child1.PassScopedPtr()));
+  XmlNode child2("Child");
+  // Empty content does not add a text node.
+  child2.SetContent("");
+  ASSERT_TRUE(root.AddChild(child2.PassScopedPtr()));
+
+  std::string output;
+  XmlStringWriter writer(&output);
+  writer.WriteXmlDeclaration();
+  writer.WriteComment("comment");
+  writer.StartElement("Root");
+  writer.SetId(3);
+  writer.StartElement("Child");
+  writer.SetIntegerAttribute("number", 12345678901234ULL);
+  writer.SetFloatingPointAttribute("float", 10.5);
+  writer.StartElement("GrandChild");
+  writer.SetContent("text");
+  writer.EndElement();
+  writer.StartElement("EmptyGrandChild");
+  writer.EndElement();
+  writer.EndElement();
+  writer.StartElement("Child");
+  writer.SetContent("");
+  writer.EndElement();
+  writer.EndElement();
+
+  EXPECT_EQ(DumpWithLibXml("comment", &root), output);
+}
+
+TEST(XmlStringWriterTest, Escaping) {
+  const std::string kAttribute = "<a> & \"b\"\n\t\r 'c' \xc3\xa9";
+  const std::string kContent = "<a> & \"b\"\n\t\r 'c' \xc3\xa9";
+
+  XmlNode root("Root");
+  root.SetStringAttribute("attribute", kAttribute);
+  XmlNode child("Child");
+  child.SetStringAttribute("attribute", kAttribute);
+  // XmlNode::SetContent() expects escaped entities.
+  child.SetContent("&lt;a&gt; &amp; \"b\"\n\t\r 'c' \xc3\xa9");
+  ASSERT_TRUE(root.AddChild(child.PassScopedPtr()));
+
+  std::string output;
+  XmlStringWriter writer(&output);
+  writer.WriteXmlDeclaration();
+  writer.WriteComment("comment");
+  writer.StartElement("Root");
+  writer.SetStringAttribute("attribute", kAttribute);
+  writer.StartElement("Child");
+  writer.SetStringAttribute("attribute", kAttribute);
+  writer.SetContent(kContent);
+  writer.EndElement();
+  writer.EndElement();
+
+  EXPECT_EQ(DumpWithLibXml("comment", &root), output);
+}
+
+TEST(XmlStringWriterTest, ReplaceAttribute) {
+  XmlNode root("Root");
+  root.SetStringAttribute("a", "1");
+  root.SetStringAttribute("b", "2");
+  root.SetStringAttribute("a", "3");
+
+  std::string output;
+  XmlStringWriter writer(&output);
+  writer.WriteXmlDeclaration();
+  writer.WriteComment("comment");
+  writer.StartElement("Root");
+  writer.SetStringAttribute("a", "1");
+  writer.SetStringAttribute("b", "2");
+  writer.SetStringAttribute("a", "3");
+  writer.EndElement();
+
+  EXPECT_EQ(DumpWithLibXml("comment", &root), output);
+}
+
+TEST(XmlStringWriterTest, SerializedElement) {
+  XmlNode root("Root");
+  XmlNode child("Child");
+  XmlNode grandchild("S");
+  grandchild.SetIntegerAttribute("t", 0);
+  ASSERT_TRUE(child.AddChild(grandchild.PassScopedPtr()));
+  ASSERT_TRUE(root.AddChild(child.PassScopedPtr()));
+
+  std::string output;
+  XmlStringWriter writer(&output);
+  writer.WriteXmlDeclaration();
+  writer.WriteComment("comment");
+  writer.StartElement("Root");
+  writer.StartElement("Child");
+  writer.AddSerializedElement("<S t=\"0\"/>");
+  writer.EndElement();
+  writer.EndElement();
+
+  EXPECT_EQ(DumpWithLibXml("comment", &root), output);
+}
+
+TEST(XmlStringWriterTest, SerializedChildren) {
+  XmlNode root("Root");
+  XmlNode child("Child");
+  XmlNode grandchild("Grandchild");
+  grandchild.SetStringAttribute("value", "a");
+  XmlNode leaf("Leaf");
+  leaf.SetContent("content");
+  ASSERT_TRUE(grandchild.AddChild(leaf.PassScopedPtr()));
+  ASSERT_TRUE(child.AddChild(grandchild.PassScopedPtr()));
+  XmlNode other_grandchild("Other");
+  ASSERT_TRUE(child.AddChild(other_grandchild.PassScopedPtr()));
+  ASSERT_TRUE(root.AddChild(child.PassScopedPtr()));
+
+  std::string output;
+  XmlStringWriter writer(&output);
+  writer.WriteXmlDeclaration();
+  writer.WriteComment("comment");
+  writer.StartElement("Root");
+  writer.StartElement("Child");
+
+  std::string children;
+  XmlStringWriter fragment_writer(&children, writer.depth());
+  fragment_writer.StartElement("Grandchild");
+  fragment_writer.SetStringAttribute("value", "a");
+  // Fragments nest at the depth() of the fragment writer.
+  EXPECT_EQ(3u, fragment_writer.depth());
+  std::string grandchildren;
+  XmlStringWriter nested_fragment_writer(&grandchildren,
+                                         fragment_writer.depth());
+  nested_fragment_writer.StartElement("Leaf");
+  nested_fragment_writer.SetContent("content");
+  nested_fragment_writer.EndElement();
+  fragment_writer.AddSerializedChildren(grandchildren);
+  fragment_writer.EndElement();
+  writer.AddSerializedChildren(children);
+
+  writer.StartElement("Other");
+  writer.EndElement();
+  writer.EndElement();
+  writer.EndElement();
+
+  EXPECT_EQ(DumpWithLibXml("comment", &root), output);
+}
+
+TEST(XmlStringWriterTest, DeepNesting) {
+  // libxml2 caps the indentation at 60 spaces.
+  const int kDepth = 40;
+  scoped_xml_ptr<xmlNode> node;
+  for (int i = kDepth - 1; i >= 0; --i) {
+    XmlNode element("E");
+    element.SetIntegerAttribute("depth", i);
+    if (node)
+      ASSERT_TRUE(element.AddChild(node.Pass()));
+    node = element.PassScopedPtr();
+  }
+  XmlNode root("Root");
+  ASSERT_TRUE(root.AddChild(node.Pass()));
+
+  std::string output;
+  XmlStringWriter writer(&output);
+  writer.WriteXmlDeclaration();
+  writer.WriteComment("comment");
+  writer.StartElement("Root");
+  for (int i = 0; i < kDepth; ++i) {
+    writer.StartElement("E");
+    writer.SetIntegerAttribute("depth", i);
+  }
+  for (int i = 0; i < kDepth + 1; ++i)
+    writer.EndElement();
+
+  EXPECT_EQ(DumpWithLibXml("comment", &root), output);
+}
+
+}  // namespace xml
+}  // namespace edash_packager
@@ -16,6 +16,7 @@
       'type': 'static_library',
       'sources': [
         'base/media_info.proto',
+        'base/mpd_notification.proto',
       ],
       'variables': {
         'proto_in_dir': 'base',
@@ -30,11 +31,21 @@
       ],
     },
     {
-      'target_name': 'mpd_builder',
+      # Manifest code shared by the DASH and HLS builders.
+      'target_name': 'manifest_base',
       'type': 'static_library',
       'sources': [
         'base/bandwidth_estimator.cc',
         'base/bandwidth_estimator.h',
+      ],
+      'dependencies': [
+        '../base/base.gyp:base',
+      ],
+    },
+    {
+      'target_name': 'mpd_builder',
+      'type': 'static_library',
+      'sources': [
         'base/content_protection_element.cc',
         'base/content_protection_element.h',
         'base/dash_iop_mpd_notifier.cc',
@@ -45,22 +56,34 @@
         'base/mpd_builder.h',
         'base/mpd_notifier_util.cc',
         'base/mpd_notifier_util.h',
+        'base/mpd_notification_receiver.cc',
+        'base/mpd_notification_receiver.h',
+        'base/mpd_notification_stream.cc',
+        'base/mpd_notification_stream.h',
         'base/mpd_notifier.h',
         'base/mpd_options.h',
         'base/mpd_utils.cc',
         'base/mpd_utils.h',
+        'base/remote_mpd_notifier.cc',
+        'base/remote_mpd_notifier.h',
+        'base/segment_batching_mpd_notifier.cc',
+        'base/segment_batching_mpd_notifier.h',
         'base/segment_info.h',
         'base/simple_mpd_notifier.cc',
         'base/simple_mpd_notifier.h',
         'base/xml/scoped_xml_ptr.h',
         'base/xml/xml_node.cc',
         'base/xml/xml_node.h',
+        'base/xml/xml_string_writer.cc',
+        'base/xml/xml_string_writer.h',
       ],
       'dependencies': [
         '../base/base.gyp:base',
+        '../media/base/media_base.gyp:media_base',
         '../media/file/file.gyp:file',
         '../third_party/libxml/libxml.gyp:libxml',
         '../version/version.gyp:version',
+        'manifest_base',
         'media_info_proto',
       ],
       'export_dependent_settings': [
@@ -89,8 +112,11 @@
         'base/bandwidth_estimator_unittest.cc',
         'base/dash_iop_mpd_notifier_unittest.cc',
         'base/mpd_builder_unittest.cc',
+        'base/remote_mpd_notifier_unittest.cc',
+        'base/segment_batching_mpd_notifier_unittest.cc',
         'base/simple_mpd_notifier_unittest.cc',
         'base/xml/xml_node_unittest.cc',
+        'base/xml/xml_string_writer_unittest.cc',
         'test/mpd_builder_test_helper.cc',
         'test/mpd_builder_test_helper.h',
         'test/xml_compare.cc',
@@ -103,6 +129,7 @@
         '../media/test/media_test.gyp:run_tests_with_atexit_manager',
         '../testing/gmock.gyp:gmock',
         '../testing/gtest.gyp:gtest',
+        '../third_party/gflags/gflags.gyp:gflags',
         'mpd_builder',
         'mpd_mocks',
         'mpd_util',
@@ -116,6 +143,7 @@
         'util/mpd_writer.h',
       ],
       'dependencies': [
+        '../media/base/media_base.gyp:media_base',
         '../media/file/file.gyp:file',
         '../third_party/gflags/gflags.gyp:gflags',
         'mpd_builder',
@@ -7,11 +7,16 @@
 #include "packager/mpd/util/mpd_writer.h"
 
 #include <gflags/gflags.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
 #include <google/protobuf/text_format.h>
 #include <stdint.h>
 
 #include "packager/base/files/file_path.h"
+#include "packager/base/bind.h"
 #include "packager/base/files/file_util.h"
+#include "packager/base/strings/stringprintf.h"
+#include "packager/media/base/shared_buffer.h"
+#include "packager/media/base/thread_pool.h"
 #include "packager/media/file/file.h"
 #include "packager/mpd/base/dash_iop_mpd_notifier.h"
 #include "packager/mpd/base/mpd_builder.h"
@@ -24,6 +29,20 @@ DEFINE_bool(generate_dash_if_iop_compliant_mpd,
             "Try to generate DASH-IF IOPv3 compliant MPD. This is best effort "
             "and does not guarantee compliance. Off by default until players "
             "support IOP MPDs.");
+DEFINE_int32(num_mpd_xml_threads,
+             0,
+             "If greater than 1, the Representations of each AdaptationSet "
+             "are serialized in parallel on this many threads. The output is "
+             "the same.");
+DEFINE_bool(use_streaming_mpd_writer,
+            false,
+            "Write the MPD straight into a string instead of building and "
+            "serializing a libxml2 tree. The output is the same, but it is "
+            "cheaper, e.g. to regenerate the MPDs of a catalog.");
+DEFINE_bool(mmap_media_info,
+            false,
+            "Map the local MediaInfo files in memory and parse them in "
+            "place, instead of copying them into a buffer first.");
 
 using edash_packager::media::File;
 
@@ -61,6 +80,95 @@ class SimpleMpdNotifierFactory : public MpdNotifierFactory {
   }
 };
 
+// Keeps the first text parsing error, instead of logging all of them. Text
+// parsing errors are expected on binary MediaInfo, which is parsed as binary
+// after the text parsing fails.
+class FirstErrorCollector : public ::google::protobuf::io::ErrorCollector {
+ public:
+  FirstErrorCollector() {}
+  ~FirstErrorCollector() override {}
+
+  void AddError(int line, int column, const std::string& message) override {
+    if (first_error_.empty()) {
+      first_error_ = base::StringPrintf("line %d, column %d: %s", line + 1,
+                                        column + 1, message.c_str());
+    }
+  }
+
+  const std::string& first_error() const { return first_error_; }
+
+ private:
+  std::string first_error_;
+
+  DISALLOW_COPY_AND_ASSIGN(FirstErrorCollector);
+};
+
+struct ParsedMediaInfo {
+  ParsedMediaInfo() : success(false) {}
+
+  MediaInfo media_info;
+  bool success;
+};
+
+// Parses the contents of |media_info_path|, in text or binary format, to
+// |media_info|.
+bool ParseMediaInfo(const std::string& media_info_path,
+                    const uint8_t* data,
+                    size_t size,
+                    MediaInfo* media_info) {
+  // Text parsing of binary MediaInfo fails early, on the first field tag.
+  FirstErrorCollector error_collector;
+  ::google::protobuf::TextFormat::Parser text_parser;
+  text_parser.RecordErrorsTo(&error_collector);
+  ::google::protobuf::io::ArrayInputStream text_input(data,
+                                                      static_cast<int>(size));
+  if (!text_parser.Parse(&text_input, media_info) &&
+      !media_info->ParseFromArray(data, static_cast<int>(size))) {
+    LOG(ERROR) << "Failed to parse " << media_info_path
+               << " to MediaInfo, in binary or in text format ("
+               << error_collector.first_error() << ").";
+    return false;
+  }
+  return true;
+}
+
+// Reads |media_info_path|, in text or binary format, to |parsed|.
+void ReadMediaInfo(const std::string& media_info_path,
+                   const std::string& mpd_path,
+                   ParsedMediaInfo* parsed) {
+  std::string local_path;
+  scoped_refptr<media::SharedBuffer> mapped_file;
+  if (FLAGS_mmap_media_info &&
+      media::File::GetLocalFilePath(media_info_path, &local_path)) {
+    const bool kSequentialAccess = true;
+    mapped_file = media::SharedBuffer::MapFile(local_path, kSequentialAccess);
+  }
+
+  if (mapped_file) {
+    if (!ParseMediaInfo(media_info_path, mapped_file->data(),
+                        mapped_file->size(), &parsed->media_info)) {
+      return;
+    }
+  } else {
+    // Not mapped, or failed to, e.g. the file is not local or is empty.
+    std::string file_content;
+    if (!media::File::ReadFileToString(media_info_path.c_str(),
+                                       &file_content)) {
+      LOG(ERROR) << "Failed to read " << media_info_path << " to string.";
+      return;
+    }
+    if (!ParseMediaInfo(
+            media_info_path,
+            reinterpret_cast<const uint8_t*>(file_content.data()),
+            file_content.size(), &parsed->media_info)) {
+      return;
+    }
+  }
+
+  MpdBuilder::MakePathsRelativeToMpd(mpd_path, &parsed->media_info);
+  parsed->success = true;
+}
+
 }  // namespace
 
 MpdWriter::MpdWriter()
@@ -73,23 +181,41 @@ MpdWriter::~MpdWriter() {}
 
 bool MpdWriter::AddFile(const std::string& media_info_path,
                         const std::string& mpd_path) {
-  std::string file_content;
-  if (!media::File::ReadFileToString(media_info_path.c_str(),
-                                     &file_content)) {
-    LOG(ERROR) << "Failed to read " << media_info_path << " to string.";
+  ParsedMediaInfo parsed;
+  ReadMediaInfo(media_info_path, mpd_path, &parsed);
+  if (!parsed.success)
     return false;
-  }
+  media_infos_.push_back(parsed.media_info);
+  return true;
+}
 
-  MediaInfo media_info;
-  if (!::google::protobuf::TextFormat::ParseFromString(file_content,
-                                                       &media_info)) {
-    LOG(ERROR) << "Failed to parse " << file_content << " to MediaInfo.";
-    return false;
+bool MpdWriter::AddFiles(const std::vector<std::string>& media_info_paths,
+                         const std::string& mpd_path,
+                         media::ThreadPool* thread_pool) {
+  std::vector<ParsedMediaInfo> parsed(media_info_paths.size());
+  std::vector<base::Closure> tasks;
+  tasks.reserve(media_info_paths.size());
+  for (size_t i = 0; i < media_info_paths.size(); ++i) {
+    tasks.push_back(base::Bind(&ReadMediaInfo, media_info_paths[i], mpd_path,
+                               &parsed[i]));
+  }
+  if (thread_pool) {
+    thread_pool->RunTasksAndWait(tasks);
+  } else {
+    for (const base::Closure& task : tasks)
+      task.Run();
   }
 
-  MpdBuilder::MakePathsRelativeToMpd(mpd_path, &media_info);
-  media_infos_.push_back(media_info);
-  return true;
+  bool all_added = true;
+  for (size_t i = 0; i < parsed.size(); ++i) {
+    if (!parsed[i].success) {
+      all_added = false;
+      continue;
+    }
+    media_infos_.push_back(MediaInfo());
+    media_infos_.back().Swap(&parsed[i].media_info);
+  }
+  return all_added;
 }
 
 void MpdWriter::AddBaseUrl(const std::string& base_url) {
@@ -98,8 +224,15 @@ void MpdWriter::AddBaseUrl(const std::string& base_url) {
 
 bool MpdWriter::WriteMpdToFile(const char* file_name) {
   CHECK(file_name);
+  MpdOptions mpd_options;
+  mpd_options.use_streaming_mpd_writer = FLAGS_use_streaming_mpd_writer;
+  if (FLAGS_num_mpd_xml_threads > 1) {
+    // Only the streaming writer serializes in parallel.
+    mpd_options.use_streaming_mpd_writer = true;
+    mpd_options.num_xml_threads = FLAGS_num_mpd_xml_threads;
+  }
   scoped_ptr<MpdNotifier> notifier = notifier_factory_->Create(
-      kOnDemandProfile, MpdOptions(), base_urls_, file_name);
+      kOnDemandProfile, mpd_options, base_urls_, file_name);
   if (!notifier->Init()) {
     LOG(ERROR) << "failed to initialize MpdNotifier.";
     return false;
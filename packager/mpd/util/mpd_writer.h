@@ -21,6 +21,7 @@
 namespace edash_packager {
 namespace media {
 class File;
+class ThreadPool;
 }  // namespace media
 }  // namespace edash_packager
 
@@ -58,11 +59,21 @@ class MpdWriter {
   // Add |media_info_path| for MPD generation.
   // The content of |media_info_path| should be a string representation of
   // MediaInfo, i.e. the content should be a result of using
-  // google::protobuf::TestFormat::Print*() methods.
+  // google::protobuf::TestFormat::Print*() methods, or MediaInfo serialized
+  // in the binary protobuf format.
   // If necessary, this method can be called after WriteMpd*() methods.
   bool AddFile(const std::string& media_info_path,
                const std::string& mpd_path);
 
+  // Same as AddFile() for each of |media_info_paths|, but the files are read
+  // and parsed concurrently on |thread_pool|. |thread_pool| can be NULL to
+  // parse them on the calling thread. The MediaInfo are added in the order of
+  // |media_info_paths|, skipping the files which cannot be parsed.
+  // Returns true if all the files have been added.
+  bool AddFiles(const std::vector<std::string>& media_info_paths,
+                const std::string& mpd_path,
+                media::ThreadPool* thread_pool);
+
   // |base_url| will be used for <BaseURL> element for the MPD. The BaseURL
   // element will be a direct child element of the <MPD> element.
   void AddBaseUrl(const std::string& base_url);
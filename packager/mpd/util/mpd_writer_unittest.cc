@@ -4,17 +4,23 @@
 // license that can be found in the LICENSE file or at
 // https://developers.google.com/open-source/licenses/bsd
 
+#include <gflags/gflags.h>
 #include <gmock/gmock.h>
+#include <google/protobuf/text_format.h>
 #include <gtest/gtest.h>
 
 #include "packager/base/files/file_util.h"
 #include "packager/base/path_service.h"
+#include "packager/media/base/thread_pool.h"
 #include "packager/mpd/base/dash_iop_mpd_notifier.h"
+#include "packager/mpd/base/media_info.pb.h"
 #include "packager/mpd/base/mock_mpd_notifier.h"
 #include "packager/mpd/base/mpd_options.h"
 #include "packager/mpd/test/mpd_builder_test_helper.h"
 #include "packager/mpd/util/mpd_writer.h"
 
+DECLARE_bool(mmap_media_info);
+
 namespace edash_packager {
 
 using ::testing::_;
@@ -102,4 +108,72 @@ TEST_F(MpdWriterTest, WriteMpdToFile) {
   EXPECT_TRUE(mpd_writer_.WriteMpdToFile(mpd_file_path.value().c_str()));
 }
 
+// Verify that the files are added by AddFiles(), in text or binary format.
+TEST_F(MpdWriterTest, AddFilesInParallel) {
+  std::string text_media_info;
+  ASSERT_TRUE(base::ReadFileToString(
+      GetTestDataFilePath(kFileNameVideoMediaInfo2), &text_media_info));
+  MediaInfo media_info;
+  ASSERT_TRUE(::google::protobuf::TextFormat::ParseFromString(
+      text_media_info, &media_info));
+  std::string binary_media_info;
+  ASSERT_TRUE(media_info.SerializeToString(&binary_media_info));
+  base::FilePath binary_media_info_path;
+  ASSERT_TRUE(base::CreateTemporaryFile(&binary_media_info_path));
+  ASSERT_EQ(static_cast<int>(binary_media_info.size()),
+            base::WriteFile(binary_media_info_path, binary_media_info.data(),
+                            binary_media_info.size()));
+
+  std::vector<std::string> media_info_paths;
+  media_info_paths.push_back(
+      GetTestDataFilePath(kFileNameVideoMediaInfo1).value());
+  media_info_paths.push_back(binary_media_info_path.value());
+
+  media::ThreadPool thread_pool("MpdWriterTest", 2);
+  thread_pool.Start();
+  SetMpdNotifierFactoryForTest();
+  EXPECT_TRUE(mpd_writer_.AddFiles(media_info_paths, "", &thread_pool));
+  thread_pool.Shutdown();
+
+  base::FilePath mpd_file_path;
+  ASSERT_TRUE(base::CreateTemporaryFile(&mpd_file_path));
+  EXPECT_TRUE(mpd_writer_.WriteMpdToFile(mpd_file_path.value().c_str()));
+}
+
+// Verify that AddFiles() skips the files which cannot be read.
+TEST_F(MpdWriterTest, AddFilesSkipsMissingFiles) {
+  std::vector<std::string> media_info_paths;
+  media_info_paths.push_back(
+      GetTestDataFilePath(kFileNameVideoMediaInfo1).value());
+  media_info_paths.push_back("/non/existing/file.media_info");
+  media_info_paths.push_back(
+      GetTestDataFilePath(kFileNameVideoMediaInfo2).value());
+
+  SetMpdNotifierFactoryForTest();
+  EXPECT_FALSE(mpd_writer_.AddFiles(media_info_paths, "", NULL));
+
+  base::FilePath mpd_file_path;
+  ASSERT_TRUE(base::CreateTemporaryFile(&mpd_file_path));
+  EXPECT_TRUE(mpd_writer_.WriteMpdToFile(mpd_file_path.value().c_str()));
+}
+
+// Verify that the local files are parsed in place when mapped in memory.
+TEST_F(MpdWriterTest, AddMappedFiles) {
+  google::FlagSaver flag_saver;
+  FLAGS_mmap_media_info = true;
+
+  std::vector<std::string> media_info_paths;
+  media_info_paths.push_back(
+      GetTestDataFilePath(kFileNameVideoMediaInfo1).value());
+  media_info_paths.push_back(
+      "file://" + GetTestDataFilePath(kFileNameVideoMediaInfo2).value());
+
+  SetMpdNotifierFactoryForTest();
+  EXPECT_TRUE(mpd_writer_.AddFiles(media_info_paths, "", NULL));
+
+  base::FilePath mpd_file_path;
+  ASSERT_TRUE(base::CreateTemporaryFile(&mpd_file_path));
+  EXPECT_TRUE(mpd_writer_.WriteMpdToFile(mpd_file_path.value().c_str()));
+}
+
 }  // namespace edash_packager
@@ -0,0 +1,1259 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/packager.h"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <set>
+
+#include "packager/app/packager_util.h"
+#include "packager/base/bind.h"
+#include "packager/base/logging.h"
+#include "packager/base/stl_util.h"
+#include "packager/base/synchronization/lock.h"
+#include "packager/base/synchronization/waitable_event.h"
+#include "packager/media/base/cancellation_token.h"
+#include "packager/media/base/container_names.h"
+#include "packager/media/base/cpu_affinity.h"
+#include "packager/media/base/crypto_context_cache.h"
+#include "packager/media/base/delayed_task_queue.h"
+#include "packager/media/base/demuxer.h"
+#include "packager/media/base/demuxer_pool.h"
+#include "packager/media/base/job_resource_usage.h"
+#include "packager/media/base/key_rotation_schedule.h"
+#include "packager/media/base/key_source.h"
+#include "packager/media/base/media_stream.h"
+#include "packager/media/base/muxer_util.h"
+#include "packager/media/base/shared_demuxer.h"
+#include "packager/media/base/stream_info.h"
+#include "packager/media/base/thread_pool.h"
+#include "packager/media/event/merging_muxer_listener.h"
+#include "packager/media/event/mpd_notify_muxer_listener.h"
+#include "packager/media/event/packaging_checkpoint.h"
+#include "packager/media/event/vod_media_info_dump_muxer_listener.h"
+#include "packager/media/file/file.h"
+#include "packager/media/formats/mp2t/ts_muxer.h"
+#include "packager/media/formats/mp4/mp4_muxer.h"
+#include "packager/media/formats/webm/webm_muxer.h"
+#include "packager/mpd/base/dash_iop_mpd_notifier.h"
+#include "packager/mpd/base/media_info.pb.h"
+#include "packager/mpd/base/mpd_builder.h"
+#include "packager/mpd/base/mpd_notification_receiver.h"
+#include "packager/mpd/base/remote_mpd_notifier.h"
+#include "packager/mpd/base/segment_batching_mpd_notifier.h"
+#include "packager/mpd/base/simple_mpd_notifier.h"
+
+namespace edash_packager {
+namespace media {
+
+namespace {
+
+const char kMediaInfoSuffix[] = ".media_info";
+const char kMediaInfoSegmentLogSuffix[] = ".media_info_log";
+
+// TODO(rkuroiwa): Write TTML and WebVTT parser (demuxing) for a better check
+// and for supporting live/segmenting (muxing).  With a demuxer and a muxer,
+// CreateRemuxJobs() shouldn't treat text as a special case.
+std::string DetermineTextFileFormat(const std::string& file,
+                                    MediaContainerName input_format) {
+  MediaContainerName container_name = input_format;
+  if (container_name == CONTAINER_UNKNOWN) {
+    std::string content;
+    if (!File::ReadFileToString(file.c_str(), &content)) {
+      LOG(ERROR) << "Failed to open file " << file
+                 << " to determine file format.";
+      return "";
+    }
+    container_name = DetermineContainer(
+        reinterpret_cast<const uint8_t*>(content.data()), content.size());
+  }
+  if (container_name == CONTAINER_WEBVTT) {
+    return "vtt";
+  } else if (container_name == CONTAINER_TTML) {
+    return "ttml";
+  }
+
+  return "";
+}
+
+typedef std::map<std::string, MpdNotifier*> MpdNotifierMap;
+
+// Creates and initializes the notifier of the local MPD |mpd_output|.
+// Returns NULL on failure.
+scoped_ptr<MpdNotifier> CreateLocalMpdNotifier(const PackagingParams& params,
+                                               DashProfile profile,
+                                               const std::string& mpd_output) {
+  scoped_ptr<MpdNotifier> mpd_notifier;
+  if (params.generate_dash_if_iop_compliant_mpd) {
+    mpd_notifier.reset(new DashIopMpdNotifier(
+        profile, params.mpd_options, params.base_urls, mpd_output));
+  } else {
+    mpd_notifier.reset(new SimpleMpdNotifier(
+        profile, params.mpd_options, params.base_urls, mpd_output));
+  }
+  if (profile == kLiveProfile &&
+      params.mpd_options.batch_segment_notifications) {
+    mpd_notifier.reset(new SegmentBatchingMpdNotifier(mpd_notifier.Pass()));
+  }
+  if (!mpd_notifier->Init())
+    return scoped_ptr<MpdNotifier>();
+  return mpd_notifier.Pass();
+}
+
+// Runs |task| of a job on |cpus|, e.g. the CPUs of the NUMA node of the job,
+// if not empty, with |cancellation_token|, |io_throttle| and |resource_usage|
+// of the job as the current token, throttle and usage. The thread pools are
+// shared by the jobs, so a worker is only pinned, and only has the token,
+// while it runs a task of the job.
+void RunJobTask(const std::vector<int>& cpus,
+                const scoped_refptr<CancellationToken>& cancellation_token,
+                const scoped_refptr<IoThrottle>& io_throttle,
+                const scoped_refptr<JobResourceUsage>& resource_usage,
+                const base::Closure& task) {
+  ScopedThreadAffinity affinity(cpus);
+  ScopedCancellationToken scoped_token(cancellation_token.get());
+  ScopedIoThrottle scoped_throttle(io_throttle.get());
+  ScopedJobResourceUsage scoped_usage(resource_usage.get());
+  task.Run();
+}
+
+// Writes the resource report of a job to a file when it goes out of scope,
+// however the job ends.
+class ScopedResourceReport {
+ public:
+  // |file_name| can be empty for no report.
+  ScopedResourceReport(const std::string& file_name, JobResourceUsage* usage)
+      : file_name_(file_name), usage_(usage) {}
+
+  ~ScopedResourceReport() {
+    if (file_name_.empty())
+      return;
+    if (!File::WriteFileAtomically(file_name_.c_str(),
+                                   usage_->ToJson() + "\n")) {
+      LOG(ERROR) << "Failed to write the resource report " << file_name_;
+    }
+  }
+
+ private:
+  const std::string file_name_;
+  scoped_refptr<JobResourceUsage> usage_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedResourceReport);
+};
+
+// Demux and Mux(es) used to remux a source file/stream. The job is run as a
+// task in the worker thread pool, unless it joins the demuxer of another job,
+// see StartLate().
+class RemuxJob {
+ public:
+  // |demuxer| is released to |demuxer_pool| once the job, and the jobs which
+  // joined it, are deleted.
+  RemuxJob(scoped_ptr<Demuxer> demuxer, DemuxerPool* demuxer_pool)
+      : shared_demuxer_(new SharedDemuxer(demuxer.Pass(), demuxer_pool)),
+        late_(false),
+        started_(false) {}
+
+  // Creates a job joining |shared_demuxer|, which is run by another job, with
+  // late streams reserved already.
+  explicit RemuxJob(const scoped_refptr<SharedDemuxer>& shared_demuxer)
+      : shared_demuxer_(shared_demuxer), late_(true), started_(false) {}
+
+  ~RemuxJob() {
+    if (late_) {
+      if (!started_)
+        demuxer()->CancelLateStreamsReservation();
+    } else {
+      shared_demuxer_->StopSharing();
+      // The jobs which joined the demuxer fail if it is not run.
+      demuxer()->CloseLateStreams(
+          Status(error::CANCELLED, "The job demuxing the input did not run."));
+    }
+    // The muxers refer to the streams of the demuxer.
+    STLDeleteElements(&muxers_);
+  }
+
+  void AddMuxer(scoped_ptr<Muxer> mux) {
+    muxers_.push_back(mux.release());
+  }
+
+  /// Set a callback run once the job completes successfully.
+  void set_completion_callback(const base::Closure& completion_callback) {
+    completion_callback_ = completion_callback;
+  }
+
+  /// Run the job to completion. The resulting status is available from
+  /// status() afterwards.
+  void Run() {
+    DCHECK(!late_);
+    OnRunDone(demuxer()->Run());
+  }
+
+  /// Run a slice of the job, see Demuxer::RunSlice().
+  /// @param[out] wait is the time to wait before the next slice.
+  /// @return true if the job should be run again, false once it is
+  ///         complete. The resulting status is available from status() then.
+  bool RunSlice(base::TimeDelta* wait) {
+    DCHECK(!late_);
+    if (!started_) {
+      started_ = true;
+      Status status = demuxer()->StartRun();
+      if (!status.ok()) {
+        OnRunDone(status);
+        return false;
+      }
+    }
+    if (demuxer()->RunSlice(wait))
+      return true;
+    OnRunDone(demuxer()->FinishRun());
+    return false;
+  }
+
+  /// Start the late streams of a job joining the demuxer of another job.
+  /// |done_callback| is run once they have ended, on the thread running the
+  /// demuxer. The resulting status is available from status() then.
+  void StartLate(const base::Closure& done_callback) {
+    DCHECK(late_);
+    DCHECK(!started_);
+    std::vector<MediaStream*> streams;
+    for (Muxer* muxer : muxers_)
+      streams.insert(streams.end(), muxer->streams().begin(),
+                     muxer->streams().end());
+    started_ = true;
+    demuxer()->StartLateStreams(
+        streams, base::Bind(&RemuxJob::OnLateStreamsDone,
+                            base::Unretained(this), done_callback));
+  }
+
+  Demuxer* demuxer() { return shared_demuxer_->demuxer(); }
+  SharedDemuxer* shared_demuxer() { return shared_demuxer_.get(); }
+  bool late() const { return late_; }
+  Status status() { return status_; }
+
+ private:
+  void OnRunDone(Status status) {
+    status_ = status;
+    // No more jobs can join.
+    shared_demuxer_->StopSharing();
+    if (status_.ok() && !completion_callback_.is_null())
+      completion_callback_.Run();
+  }
+
+  void OnLateStreamsDone(const base::Closure& done_callback, Status status) {
+    status_ = status;
+    if (status_.ok() && !completion_callback_.is_null())
+      completion_callback_.Run();
+    done_callback.Run();
+  }
+
+  scoped_refptr<SharedDemuxer> shared_demuxer_;
+  // True if the job joins the demuxer of another job.
+  const bool late_;
+  // True once the slices of the job, or its late streams, have started.
+  bool started_;
+  std::vector<Muxer*> muxers_;
+  base::Closure completion_callback_;
+  Status status_;
+
+  DISALLOW_COPY_AND_ASSIGN(RemuxJob);
+};
+
+// Tracks the completion of a set of RemuxJobs running in a ThreadPool, which
+// can be shared with other sets of jobs.
+class RemuxJobTracker {
+ public:
+  RemuxJobTracker(const std::vector<RemuxJob*>& remux_jobs,
+                  CancellationToken* cancellation_token)
+      : cancellation_token_(cancellation_token),
+        num_jobs_remaining_(remux_jobs.size()),
+        done_event_(true, remux_jobs.empty()) {}
+
+  // Run |remux_job| and record its completion. Called in a worker thread.
+  void RunJob(RemuxJob* remux_job) {
+    remux_job->Run();
+    OnJobDone(remux_job);
+  }
+
+  // Run a slice of |remux_job|, and post |slice_task|, which runs the next
+  // one, to |slice_queue| or record the completion of the job. Called in a
+  // worker thread.
+  void RunJobSlice(RemuxJob* remux_job,
+                   DelayedTaskQueue* slice_queue,
+                   const base::Closure* slice_task) {
+    base::TimeDelta wait;
+    if (remux_job->RunSlice(&wait))
+      slice_queue->PostDelayedTask(*slice_task, wait);
+    else
+      OnJobDone(remux_job);
+  }
+
+  // Record the completion of |remux_job|, which was run or started late.
+  void OnJobDone(RemuxJob* remux_job) {
+    base::AutoLock l(lock_);
+    if (!remux_job->status().ok() && status_.ok()) {
+      status_ = remux_job->status();
+      // No point continuing the other jobs; cancel them so the remaining
+      // workers, including those blocked on I/O, are released.
+      cancellation_token_->Cancel();
+    }
+    if (--num_jobs_remaining_ == 0)
+      done_event_.Signal();
+  }
+
+  // Wait until all jobs complete. The jobs still running when any of the jobs
+  // fails are cancelled, so they complete early.
+  Status Wait() {
+    done_event_.Wait();
+    base::AutoLock l(lock_);
+    return status_;
+  }
+
+ private:
+  CancellationToken* const cancellation_token_;
+  base::Lock lock_;
+  size_t num_jobs_remaining_;
+  Status status_;
+  base::WaitableEvent done_event_;
+
+  DISALLOW_COPY_AND_ASSIGN(RemuxJobTracker);
+};
+
+bool StreamInfoToTextMediaInfo(const StreamDescriptor& stream_descriptor,
+                               const MuxerOptions& stream_muxer_options,
+                               MediaInfo* text_media_info) {
+  const std::string& language = stream_descriptor.language;
+  std::string format = DetermineTextFileFormat(stream_descriptor.input,
+                                               stream_descriptor.input_format);
+  if (format.empty()) {
+    LOG(ERROR) << "Failed to determine the text file format for "
+               << stream_descriptor.input;
+    return false;
+  }
+
+  if (!File::Copy(stream_descriptor.input.c_str(),
+                  stream_muxer_options.output_file_name.c_str())) {
+    LOG(ERROR) << "Failed to copy the input file (" << stream_descriptor.input
+               << ") to output file (" << stream_muxer_options.output_file_name
+               << ").";
+    return false;
+  }
+
+  text_media_info->set_media_file_name(stream_muxer_options.output_file_name);
+  text_media_info->set_container_type(MediaInfo::CONTAINER_TEXT);
+
+  if (stream_muxer_options.bandwidth != 0) {
+    text_media_info->set_bandwidth(stream_muxer_options.bandwidth);
+  } else {
+    // Text files are usually small and since the input is one file; there's no
+    // way for the player to do ranged requests. So set this value to something
+    // reasonable.
+    text_media_info->set_bandwidth(256);
+  }
+
+  MediaInfo::TextInfo* text_info = text_media_info->mutable_text_info();
+  text_info->set_format(format);
+  if (!language.empty())
+    text_info->set_language(language);
+
+  return true;
+}
+
+scoped_ptr<Muxer> CreateOutputMuxer(const MuxerOptions& options,
+                                    MediaContainerName container) {
+  if (container == CONTAINER_WEBM) {
+    return scoped_ptr<Muxer>(new webm::WebMMuxer(options));
+  } else if (container == CONTAINER_MPEG2TS) {
+    return scoped_ptr<Muxer>(new mp2t::TsMuxer(options));
+  } else {
+    DCHECK_EQ(container, CONTAINER_MOV);
+    return scoped_ptr<Muxer>(new mp4::MP4Muxer(options));
+  }
+}
+
+scoped_ptr<MuxerListener> CreateMuxerListener(
+    const PackagingParams& params,
+    const MuxerOptions& stream_muxer_options,
+    MpdNotifier* mpd_notifier) {
+  scoped_ptr<MuxerListener> muxer_listener;
+  DCHECK(!(params.output_media_info && mpd_notifier));
+  if (params.output_media_info) {
+    const std::string output_media_info_file_name =
+        stream_muxer_options.output_file_name + kMediaInfoSuffix;
+    scoped_ptr<VodMediaInfoDumpMuxerListener>
+        vod_media_info_dump_muxer_listener(
+            new VodMediaInfoDumpMuxerListener(output_media_info_file_name));
+    vod_media_info_dump_muxer_listener->set_binary_format(
+        params.binary_media_info);
+    if (params.incremental_media_info) {
+      vod_media_info_dump_muxer_listener->set_segment_log_path(
+          stream_muxer_options.output_file_name + kMediaInfoSegmentLogSuffix);
+    }
+    muxer_listener = vod_media_info_dump_muxer_listener.Pass();
+  }
+  if (mpd_notifier) {
+    scoped_ptr<MpdNotifyMuxerListener> mpd_notify_muxer_listener(
+        new MpdNotifyMuxerListener(mpd_notifier));
+    muxer_listener = mpd_notify_muxer_listener.Pass();
+  }
+  return muxer_listener.Pass();
+}
+
+// Splits the stream with |key_frame_times| into at most |num_parts| ranges of
+// whole segments, cutting the segments where a single muxer would with
+// segment_sap_aligned set. Outputs the start time and the index of the first
+// segment of each range.
+void SplitAtSegmentBoundaries(const std::vector<int64_t>& key_frame_times,
+                              int64_t segment_duration,
+                              size_t num_parts,
+                              std::vector<int64_t>* part_start_times,
+                              std::vector<uint32_t>* part_first_segments) {
+  std::vector<int64_t> segment_start_times;
+  for (int64_t key_frame_time : key_frame_times) {
+    if (segment_start_times.empty() ||
+        key_frame_time - segment_start_times.back() >= segment_duration) {
+      segment_start_times.push_back(key_frame_time);
+    }
+  }
+
+  num_parts = std::min(num_parts, segment_start_times.size());
+  for (size_t i = 0; i < num_parts; ++i) {
+    const size_t segment_index = i * segment_start_times.size() / num_parts;
+    // The first range also takes the samples before the first key frame.
+    part_start_times->push_back(i == 0 ? 0
+                                       : segment_start_times[segment_index]);
+    part_first_segments->push_back(segment_index);
+  }
+}
+
+// Returns true if only a range of the input of |stream_descriptor| is
+// packaged.
+bool IsClipped(const StreamDescriptor& stream_descriptor) {
+  return stream_descriptor.start_time > 0 || stream_descriptor.end_time > 0;
+}
+
+// Restricts |demuxer| to the range of the input of |stream_descriptor|, if
+// any.
+Status SetClipRange(const StreamDescriptor& stream_descriptor,
+                    Demuxer* demuxer) {
+  if (!IsClipped(stream_descriptor))
+    return Status::OK;
+  const uint32_t kClipTimescale = 1000;
+  const int64_t start =
+      static_cast<int64_t>(stream_descriptor.start_time * kClipTimescale);
+  const int64_t end =
+      stream_descriptor.end_time > 0
+          ? static_cast<int64_t>(stream_descriptor.end_time * kClipTimescale)
+          : std::numeric_limits<int64_t>::max();
+  return demuxer->SetClipRange(start, end, kClipTimescale);
+}
+
+// Creates the demuxer of one range of a split input.
+scoped_ptr<Demuxer> CreateRangeDemuxer(const PackagingParams& params,
+                                       const std::string& input,
+                                       DemuxerPool* demuxer_pool) {
+  scoped_ptr<Demuxer> demuxer = demuxer_pool->Acquire(input);
+  demuxer->set_random_access_input(true);
+  demuxer->set_media_index_cache_dir(params.media_index_cache_dir);
+  Status status = demuxer->Initialize();
+  if (!status.ok()) {
+    LOG(ERROR) << "Demuxer failed to initialize: " << status.ToString();
+    return scoped_ptr<Demuxer>();
+  }
+  if (params.sample_channel_capacity > 0) {
+    for (size_t i = 0; i < demuxer->streams().size(); ++i) {
+      demuxer->streams()[i]->set_sample_channel_capacity(
+          params.sample_channel_capacity);
+    }
+  }
+  return demuxer.Pass();
+}
+
+// Records range |part_index| of the stream |segment_template|, split at
+// |part_start_times|, in |checkpoint|. Called once the job of the range
+// completes.
+void SaveCompletedPart(PackagingCheckpoint* checkpoint,
+                       const std::string& segment_template,
+                       const std::vector<int64_t>& part_start_times,
+                       MergingMuxerListener* merging_listener,
+                       size_t part_index) {
+  PackagingCheckpointData::Part part;
+  if (merging_listener)
+    merging_listener->SavePart(part_index, &part);
+  else
+    part.set_part_index(part_index);
+  if (!checkpoint->AddCompletedPart(segment_template, part_start_times,
+                                    part)) {
+    LOG(WARNING) << "Failed to save the checkpoint of " << segment_template
+                 << "; the job continues.";
+  }
+}
+
+// Packages the stream of |stream_descriptor| in up to vod_parallel_splits
+// parallel jobs, one per range of segments. Sets |split| to false if the
+// stream cannot be split, in which case no job is created. The ranges
+// recorded in |checkpoint|, if not NULL, are skipped, and the other ranges
+// are recorded in it as they complete.
+bool CreateSplitRemuxJobs(const PackagingParams& params,
+                          const StreamDescriptor& stream_descriptor,
+                          const MuxerOptions& stream_muxer_options,
+                          MediaContainerName output_format,
+                          MpdNotifier* mpd_notifier,
+                          PackagingCheckpoint* checkpoint,
+                          DemuxerPool* demuxer_pool,
+                          std::vector<RemuxJob*>* remux_jobs,
+                          std::vector<MergingMuxerListener*>* merging_listeners,
+                          bool* split) {
+  *split = false;
+  if (params.dump_stream_info || stream_muxer_options.single_segment ||
+      stream_muxer_options.segment_template.empty() ||
+      !stream_muxer_options.segment_sap_aligned ||
+      output_format != CONTAINER_MOV || IsClipped(stream_descriptor) ||
+      stream_muxer_options.trick_play_factor > 0) {
+    return true;
+  }
+
+  scoped_ptr<Demuxer> demuxer =
+      CreateRangeDemuxer(params, stream_descriptor.input, demuxer_pool);
+  if (!demuxer)
+    return false;
+  MediaStream* stream =
+      SelectStream(demuxer->streams(), stream_descriptor.stream_selector);
+  if (!stream)
+    return false;
+  const uint32_t track_id = stream->info()->track_id();
+  const uint32_t time_scale = stream->info()->time_scale();
+  std::vector<int64_t> key_frame_times;
+  if (!demuxer->GetKeyFrameTimes(track_id, &key_frame_times).ok()) {
+    VLOG(1) << "Cannot split " << stream_descriptor.input
+            << "; it is packaged in a single job.";
+    return true;
+  }
+
+  std::vector<int64_t> part_start_times;
+  std::vector<uint32_t> part_first_segments;
+  SplitAtSegmentBoundaries(
+      key_frame_times,
+      static_cast<int64_t>(stream_muxer_options.segment_duration * time_scale),
+      params.vod_parallel_splits, &part_start_times, &part_first_segments);
+  if (part_start_times.size() <= 1)
+    return true;
+  const size_t num_parts = part_start_times.size();
+  VLOG(1) << "Packaging " << stream_descriptor.input << " in " << num_parts
+          << " parallel ranges.";
+
+  scoped_ptr<MuxerListener> muxer_listener =
+      CreateMuxerListener(params, stream_muxer_options, mpd_notifier);
+  MergingMuxerListener* merging_listener = NULL;
+  if (muxer_listener) {
+    merging_listener =
+        new MergingMuxerListener(muxer_listener.Pass(), num_parts);
+    merging_listeners->push_back(merging_listener);
+  }
+
+  const std::string& segment_template = stream_muxer_options.segment_template;
+  for (size_t i = 0; i < num_parts; ++i) {
+    // The first range is always packaged: it writes the init segment and
+    // starts the media for the listener of the stream.
+    const PackagingCheckpointData::Part* completed_part =
+        checkpoint && i > 0 ? checkpoint->GetCompletedPart(
+                                  segment_template, part_start_times, i)
+                            : NULL;
+    if (completed_part) {
+      VLOG(1) << "Range " << i << " of " << stream_descriptor.input
+              << " is complete in the checkpoint.";
+      if (merging_listener)
+        merging_listener->RestorePart(*completed_part);
+      continue;
+    }
+    if (i > 0) {
+      demuxer =
+          CreateRangeDemuxer(params, stream_descriptor.input, demuxer_pool);
+      if (!demuxer)
+        return false;
+    }
+    const int64_t end_time = i + 1 < num_parts
+                                 ? part_start_times[i + 1]
+                                 : std::numeric_limits<int64_t>::max();
+    Status status =
+        demuxer->SetTimeRange(part_start_times[i], end_time, time_scale);
+    if (!status.ok()) {
+      LOG(ERROR) << "Failed to split " << stream_descriptor.input << ": "
+                 << status.ToString();
+      return false;
+    }
+
+    MuxerOptions part_muxer_options(stream_muxer_options);
+    part_muxer_options.first_segment_index = part_first_segments[i];
+    part_muxer_options.write_init_segment = i == 0;
+    // The segment after the last one of a range belongs to the next range.
+    part_muxer_options.open_segments_ahead = false;
+    scoped_ptr<Muxer> muxer(
+        CreateOutputMuxer(part_muxer_options, output_format));
+    if (params.clock)
+      muxer->set_clock(params.clock);
+    if (merging_listener)
+      muxer->SetMuxerListener(merging_listener->CreatePartListener(i));
+    if (!AddStreamToMuxer(demuxer->streams(),
+                          stream_descriptor.stream_selector,
+                          stream_descriptor.language,
+                          muxer.get()))
+      return false;
+
+    remux_jobs->push_back(new RemuxJob(demuxer.Pass(), demuxer_pool));
+    remux_jobs->back()->AddMuxer(muxer.Pass());
+    if (checkpoint && i > 0) {
+      remux_jobs->back()->set_completion_callback(
+          base::Bind(&SaveCompletedPart, checkpoint, segment_template,
+                     part_start_times, merging_listener, i));
+    }
+  }
+  *split = true;
+  return true;
+}
+
+// Maximum number of demuxers initialized concurrently. The initialization is
+// mostly waiting on opens and reads, so it does not need to be bound by the
+// number of cores.
+const size_t kMaxDemuxerInitThreads = 16;
+
+// Maximum number of demuxers kept for the next jobs, with 2MB read buffers
+// each, i.e. enough for the inputs initialized concurrently.
+const size_t kMaxIdleDemuxers = kMaxDemuxerInitThreads;
+
+// A demuxer initialized on a thread pool while the remux jobs are created.
+struct PendingDemuxer {
+  PendingDemuxer() : posted(false), initialized(true, false) {}
+  // The thread pool is shared, so the initialization is waited for
+  // explicitly in case the remux jobs are not created.
+  ~PendingDemuxer() {
+    if (posted)
+      initialized.Wait();
+  }
+
+  scoped_ptr<Demuxer> demuxer;
+  Status status;
+  // Set if the initialization has been posted to a thread pool.
+  bool posted;
+  base::WaitableEvent initialized;
+};
+
+void InitializePendingDemuxer(PendingDemuxer* pending_demuxer) {
+  pending_demuxer->status = pending_demuxer->demuxer->Initialize();
+  pending_demuxer->initialized.Signal();
+}
+
+// Creates the demuxer of |stream_descriptor|, not yet initialized. Returns
+// NULL on failure.
+scoped_ptr<Demuxer> CreateDemuxer(const PackagingParams& params,
+                                  const StreamDescriptor& stream_descriptor,
+                                  DemuxerPool* demuxer_pool) {
+  scoped_ptr<Demuxer> demuxer =
+      demuxer_pool->Acquire(stream_descriptor.input);
+  // Clipped inputs are read by random access to skip the data before the
+  // range.
+  const bool clipped = IsClipped(stream_descriptor);
+  demuxer->set_memory_mapped_input(params.mmap_input && !clipped);
+  demuxer->set_random_access_input(params.random_access_input || clipped);
+  demuxer->set_media_index_cache_dir(params.media_index_cache_dir);
+  demuxer->set_follow_input(params.follow_input);
+  demuxer->set_cooperative(params.cooperative_remux_jobs);
+  demuxer->set_parser_limits(params.parser_limits);
+  demuxer->set_input_format(stream_descriptor.input_format);
+  demuxer->SetSampleSpillOptions(params.sample_queue_memory_budget,
+                                 params.muxer_options.temp_dir);
+  if (!params.decryption_key_source_factory.is_null()) {
+    scoped_ptr<KeySource> key_source =
+        params.decryption_key_source_factory.Run();
+    if (!key_source)
+      return scoped_ptr<Demuxer>();
+    demuxer->SetKeySource(key_source.Pass());
+  }
+  return demuxer.Pass();
+}
+
+// Returns true if the demuxer of |input| can be shared with the other jobs,
+// i.e. if the streams of |input| in |stream_descriptors| are demuxed the same
+// way whichever job demuxes it.
+bool CanShareInput(const PackagingParams& params,
+                   const StreamDescriptorList& stream_descriptors,
+                   const std::string& input) {
+  if (params.shared_input_replay_buffer_size == 0 || params.dump_stream_info)
+    return false;
+  for (const StreamDescriptor& stream_descriptor : stream_descriptors) {
+    if (stream_descriptor.input != input)
+      continue;
+    // Clips change the samples demuxed, and language overrides change the
+    // stream info, which is shared.
+    if (stream_descriptor.stream_selector == "text" ||
+        IsClipped(stream_descriptor) || !stream_descriptor.language.empty()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Reserves the late streams of |input| in |stream_descriptors| on the demuxer
+// of |input| run by another job, if any. Returns NULL if there is none, or if
+// it cannot be joined anymore.
+scoped_refptr<SharedDemuxer> JoinSharedDemuxer(
+    const StreamDescriptorList& stream_descriptors,
+    const std::string& input,
+    SharedDemuxerRegistry* shared_demuxer_registry) {
+  scoped_refptr<SharedDemuxer> shared_demuxer = shared_demuxer_registry->Find(
+      SharedDemuxerRegistry::GetInputKey(input));
+  if (!shared_demuxer.get())
+    return NULL;
+  std::set<uint32_t> track_ids;
+  for (const StreamDescriptor& stream_descriptor : stream_descriptors) {
+    if (stream_descriptor.input != input)
+      continue;
+    MediaStream* stream = SelectStream(shared_demuxer->demuxer()->streams(),
+                                       stream_descriptor.stream_selector);
+    if (!stream)
+      return NULL;
+    track_ids.insert(stream->info()->track_id());
+  }
+  if (!shared_demuxer->demuxer()->ReserveLateStreams(track_ids)) {
+    VLOG(1) << "Too late to join the demuxer of " << input
+            << "; it is read again.";
+    return NULL;
+  }
+  VLOG(1) << "Joining the demuxer of " << input << " run by another job.";
+  return shared_demuxer;
+}
+
+// Connects |muxer| to a late stream of the stream of |demuxer| selected by
+// |stream_selector|, see Demuxer::CreateLateStream().
+bool AddLateStreamToMuxer(Demuxer* demuxer,
+                          const std::string& stream_selector,
+                          Muxer* muxer) {
+  MediaStream* stream = SelectStream(demuxer->streams(), stream_selector);
+  if (!stream)
+    return false;
+  muxer->AddStream(demuxer->CreateLateStream(stream));
+  return true;
+}
+
+bool CreateRemuxJobs(const PackagingParams& params,
+                     const StreamDescriptorList& stream_descriptors,
+                     ThreadPool* init_thread_pool,
+                     MpdNotifier* mpd_notifier,
+                     const MpdNotifierMap& stream_mpd_notifiers,
+                     CryptoContextCache* crypto_context_cache,
+                     KeyRotationSchedule* key_rotation_schedule,
+                     PackagingCheckpoint* checkpoint,
+                     DemuxerPool* demuxer_pool,
+                     SharedDemuxerRegistry* shared_demuxer_registry,
+                     std::vector<RemuxJob*>* remux_jobs,
+                     std::vector<MergingMuxerListener*>* merging_listeners) {
+  DCHECK(init_thread_pool);
+  DCHECK(demuxer_pool);
+  DCHECK(shared_demuxer_registry);
+  DCHECK(remux_jobs);
+  DCHECK(merging_listeners);
+  const MuxerOptions& muxer_options = params.muxer_options;
+  KeySource* key_source = params.encryption_key_source;
+
+  // Encryption and decryption are not split: each range would start a new
+  // random IV sequence or license request.
+  const bool may_split = params.vod_parallel_splits > 1 && !key_source &&
+                         params.decryption_key_source_factory.is_null();
+
+  // Initialize the demuxers of all the inputs concurrently, so that startup
+  // takes about the time of the slowest input instead of the sum. The muxers
+  // are set up while the demuxers are initialized. Split inputs create their
+  // demuxers in CreateSplitRemuxJobs() instead.
+  typedef std::map<std::string, PendingDemuxer*> PendingDemuxerMap;
+  PendingDemuxerMap pending_demuxers;
+  STLValueDeleter<PendingDemuxerMap> pending_demuxers_deleter(
+      &pending_demuxers);
+  // The jobs joining the demuxers of the inputs demuxed by other jobs, which
+  // need no demuxer of their own.
+  typedef std::map<std::string, RemuxJob*> LateRemuxJobMap;
+  LateRemuxJobMap late_remux_jobs;
+  STLValueDeleter<LateRemuxJobMap> late_remux_jobs_deleter(&late_remux_jobs);
+  bool init_posted = false;
+  if (!may_split) {
+    for (const StreamDescriptor& stream_descriptor : stream_descriptors) {
+      if (stream_descriptor.stream_selector == "text" ||
+          pending_demuxers.find(stream_descriptor.input) !=
+              pending_demuxers.end() ||
+          late_remux_jobs.find(stream_descriptor.input) !=
+              late_remux_jobs.end()) {
+        continue;
+      }
+      if (CanShareInput(params, stream_descriptors, stream_descriptor.input)) {
+        scoped_refptr<SharedDemuxer> shared_demuxer = JoinSharedDemuxer(
+            stream_descriptors, stream_descriptor.input,
+            shared_demuxer_registry);
+        if (shared_demuxer.get()) {
+          late_remux_jobs[stream_descriptor.input] =
+              new RemuxJob(shared_demuxer);
+          continue;
+        }
+      }
+      scoped_ptr<Demuxer> demuxer =
+          CreateDemuxer(params, stream_descriptor, demuxer_pool);
+      if (!demuxer)
+        return false;
+      PendingDemuxer* pending_demuxer = new PendingDemuxer;
+      pending_demuxer->demuxer = demuxer.Pass();
+      pending_demuxers[stream_descriptor.input] = pending_demuxer;
+    }
+    if (pending_demuxers.size() > 1) {
+      for (const auto& pending_demuxer : pending_demuxers) {
+        pending_demuxer.second->posted = true;
+        init_thread_pool->PostTask(base::Bind(
+            &RunJobTask, params.cpu_set,
+            make_scoped_refptr(CancellationToken::Current()),
+            make_scoped_refptr(IoThrottle::Current()),
+            make_scoped_refptr(JobResourceUsage::Current()),
+            base::Bind(&InitializePendingDemuxer, pending_demuxer.second)));
+      }
+      init_posted = true;
+    }
+  }
+
+  std::string previous_input;
+  for (StreamDescriptorList::const_iterator stream_iter =
+           stream_descriptors.begin();
+       stream_iter != stream_descriptors.end();
+       ++stream_iter) {
+    // Process stream descriptor.
+    MuxerOptions stream_muxer_options(muxer_options);
+    stream_muxer_options.output_file_name = stream_iter->output;
+    if (!stream_iter->segment_template.empty()) {
+      if (!ValidateSegmentTemplate(stream_iter->segment_template)) {
+        LOG(ERROR) << "ERROR: segment template with '"
+                   << stream_iter->segment_template << "' is invalid.";
+        return false;
+      }
+      stream_muxer_options.segment_template = stream_iter->segment_template;
+    }
+    stream_muxer_options.bandwidth = stream_iter->bandwidth;
+    stream_muxer_options.trick_play_factor = stream_iter->trick_play_factor;
+    MpdNotifier* stream_mpd_notifier = mpd_notifier;
+    if (!stream_iter->mpd_output.empty()) {
+      DCHECK(stream_mpd_notifiers.count(stream_iter->mpd_output));
+      stream_mpd_notifier =
+          stream_mpd_notifiers.find(stream_iter->mpd_output)->second;
+    }
+
+    // Handle text input.
+    if (stream_iter->stream_selector == "text") {
+      MediaInfo text_media_info;
+      if (!StreamInfoToTextMediaInfo(*stream_iter, stream_muxer_options,
+                                     &text_media_info)) {
+        return false;
+      }
+
+      if (stream_mpd_notifier) {
+        uint32 unused;
+        if (!stream_mpd_notifier->NotifyNewContainer(text_media_info,
+                                                     &unused)) {
+          LOG(ERROR) << "Failed to process text file " << stream_iter->input;
+        } else {
+          stream_mpd_notifier->Flush();
+        }
+      } else if (params.output_media_info) {
+        VodMediaInfoDumpMuxerListener::WriteMediaInfoToFile(
+            text_media_info,
+            stream_muxer_options.output_file_name + kMediaInfoSuffix,
+            params.binary_media_info);
+      } else {
+        NOTIMPLEMENTED()
+            << "--mpd_output or --output_media_info flags are "
+               "required for text output. Skipping manifest related output for "
+            << stream_iter->input;
+      }
+      continue;
+    }
+
+    if (may_split) {
+      MediaContainerName output_format = stream_iter->output_format;
+      if (output_format == CONTAINER_UNKNOWN) {
+        output_format = DetermineContainerFromFileName(
+            stream_muxer_options.output_file_name);
+      }
+      bool split = false;
+      if (!CreateSplitRemuxJobs(params, *stream_iter, stream_muxer_options,
+                                output_format, stream_mpd_notifier,
+                                checkpoint, demuxer_pool, remux_jobs,
+                                merging_listeners, &split)) {
+        return false;
+      }
+      if (split) {
+        // The next stream of this input needs a demuxer of its own.
+        previous_input.clear();
+        continue;
+      }
+    }
+
+    LateRemuxJobMap::iterator late_iter =
+        late_remux_jobs.find(stream_iter->input);
+    if (stream_iter->input != previous_input &&
+        late_iter != late_remux_jobs.end()) {
+      remux_jobs->push_back(late_iter->second);
+      late_remux_jobs.erase(late_iter);
+      previous_input = stream_iter->input;
+    } else if (stream_iter->input != previous_input) {
+      // New remux job needed. Create demux and job thread.
+      scoped_ptr<Demuxer> demuxer;
+      Status status;
+      PendingDemuxerMap::iterator pending_iter =
+          pending_demuxers.find(stream_iter->input);
+      if (pending_iter != pending_demuxers.end()) {
+        PendingDemuxer* pending_demuxer = pending_iter->second;
+        if (init_posted)
+          pending_demuxer->initialized.Wait();
+        else
+          InitializePendingDemuxer(pending_demuxer);
+        demuxer = pending_demuxer->demuxer.Pass();
+        status = pending_demuxer->status;
+      } else {
+        demuxer = CreateDemuxer(params, *stream_iter, demuxer_pool);
+        if (!demuxer)
+          return false;
+        status = demuxer->Initialize();
+      }
+      if (!status.ok()) {
+        LOG(ERROR) << "Demuxer failed to initialize: " << status.ToString();
+        return false;
+      }
+      status = SetClipRange(*stream_iter, demuxer.get());
+      if (!status.ok()) {
+        LOG(ERROR) << "Failed to clip " << stream_iter->input << ": "
+                   << status.ToString();
+        return false;
+      }
+      if (params.sample_channel_capacity > 0) {
+        for (size_t i = 0; i < demuxer->streams().size(); ++i) {
+          demuxer->streams()[i]->set_sample_channel_capacity(
+              params.sample_channel_capacity);
+        }
+      }
+      if (params.dump_stream_info) {
+        printf("\nFile \"%s\":\n", stream_iter->input.c_str());
+        DumpStreamInfo(demuxer->streams());
+        if (stream_iter->output.empty())
+          continue;  // just need stream info.
+      }
+      remux_jobs->push_back(new RemuxJob(demuxer.Pass(), demuxer_pool));
+      if (CanShareInput(params, stream_descriptors, stream_iter->input)) {
+        // Let the jobs packaging the input concurrently join the demuxer.
+        remux_jobs->back()->demuxer()->EnableLateStreams(
+            params.shared_input_replay_buffer_size);
+        remux_jobs->back()->shared_demuxer()->Share(
+            shared_demuxer_registry,
+            SharedDemuxerRegistry::GetInputKey(stream_iter->input));
+      }
+      previous_input = stream_iter->input;
+    }
+    DCHECK(!remux_jobs->empty());
+
+    MediaContainerName output_format = stream_iter->output_format;
+    if (output_format == CONTAINER_UNKNOWN) {
+      output_format =
+          DetermineContainerFromFileName(stream_muxer_options.output_file_name);
+
+      if (output_format == CONTAINER_UNKNOWN) {
+        LOG(ERROR) << "Unable to determine output format for file "
+                   << stream_muxer_options.output_file_name;
+        return false;
+      }
+    }
+
+    scoped_ptr<Muxer> muxer(
+        CreateOutputMuxer(stream_muxer_options, output_format));
+    if (params.clock)
+      muxer->set_clock(params.clock);
+
+    if (key_source) {
+      muxer->SetKeySource(key_source,
+                          params.max_sd_pixels,
+                          params.clear_lead_in_seconds,
+                          params.crypto_period_duration_in_seconds,
+                          params.protection_scheme);
+      muxer->set_crypto_context_cache(crypto_context_cache);
+      muxer->set_key_rotation_schedule(key_rotation_schedule);
+    }
+
+    scoped_ptr<MuxerListener> muxer_listener =
+        CreateMuxerListener(params, stream_muxer_options, stream_mpd_notifier);
+    if (muxer_listener)
+      muxer->SetMuxerListener(muxer_listener.Pass());
+
+    RemuxJob* remux_job = remux_jobs->back();
+    if (remux_job->late()) {
+      if (!AddLateStreamToMuxer(remux_job->demuxer(),
+                                stream_iter->stream_selector, muxer.get())) {
+        return false;
+      }
+    } else if (!AddStreamToMuxer(remux_job->demuxer()->streams(),
+                                 stream_iter->stream_selector,
+                                 stream_iter->language,
+                                 muxer.get())) {
+      return false;
+    }
+    remux_job->AddMuxer(muxer.Pass());
+  }
+
+  return true;
+}
+
+// Runs |remux_jobs| on |thread_pool|, on |cpus| if not empty, and waits until
+// they complete. The jobs stop early once |cancellation_token| is cancelled.
+// Their I/O is throttled by |io_throttle|, NULL if unlimited, and their
+// resources are accounted in |resource_usage|.
+Status RunRemuxJobs(const std::vector<RemuxJob*>& remux_jobs,
+                    const std::vector<int>& cpus,
+                    const scoped_refptr<CancellationToken>& cancellation_token,
+                    const scoped_refptr<IoThrottle>& io_throttle,
+                    const scoped_refptr<JobResourceUsage>& resource_usage,
+                    bool cooperative,
+                    ThreadPool* thread_pool,
+                    DelayedTaskQueue* slice_queue) {
+  RemuxJobTracker tracker(remux_jobs, cancellation_token.get());
+  // The tasks running the slices of the cooperative jobs, which post
+  // themselves again until the jobs complete.
+  std::vector<base::Closure> slice_tasks(remux_jobs.size());
+  for (std::vector<RemuxJob*>::const_iterator job_iter = remux_jobs.begin();
+       job_iter != remux_jobs.end();
+       ++job_iter) {
+    if ((*job_iter)->late()) {
+      // The job runs on the thread of the job whose demuxer it joins, with
+      // the token, throttle and usage of this thread.
+      (*job_iter)->StartLate(base::Bind(&RemuxJobTracker::OnJobDone,
+                                        base::Unretained(&tracker),
+                                        *job_iter));
+      continue;
+    }
+    if (cooperative) {
+      base::Closure* slice_task = &slice_tasks[job_iter - remux_jobs.begin()];
+      *slice_task = base::Bind(
+          &RunJobTask, cpus, cancellation_token, io_throttle, resource_usage,
+          base::Bind(&RemuxJobTracker::RunJobSlice,
+                     base::Unretained(&tracker), *job_iter, slice_queue,
+                     slice_task));
+      thread_pool->PostTask(*slice_task);
+      continue;
+    }
+    thread_pool->PostTask(base::Bind(
+        &RunJobTask, cpus, cancellation_token, io_throttle, resource_usage,
+        base::Bind(&RemuxJobTracker::RunJob, base::Unretained(&tracker),
+                   *job_iter)));
+  }
+  return tracker.Wait();
+}
+
+}  // namespace
+
+PackagingParams::PackagingParams()
+    : mpd_notification_port(0),
+      generate_dash_if_iop_compliant_mpd(false),
+      output_media_info(false),
+      binary_media_info(false),
+      incremental_media_info(false),
+      dump_stream_info(false),
+      encryption_key_source(NULL),
+      max_sd_pixels(0),
+      clear_lead_in_seconds(0),
+      crypto_period_duration_in_seconds(0),
+      protection_scheme(FOURCC_cenc),
+      mmap_input(false),
+      random_access_input(false),
+      follow_input(false),
+      sample_channel_capacity(0),
+      vod_parallel_splits(1),
+      sample_queue_memory_budget(0),
+      shared_input_replay_buffer_size(0),
+      cooperative_remux_jobs(false),
+      io_priority(kLiveIoPriority),
+      io_bytes_per_second(0),
+      clock(NULL) {}
+
+PackagingParams::~PackagingParams() {}
+
+Packager::Packager(size_t num_worker_threads)
+    : remux_thread_pool_(new ThreadPool("RemuxWorker", num_worker_threads)),
+      demuxer_init_thread_pool_(
+          new ThreadPool("DemuxerInit", kMaxDemuxerInitThreads)),
+      demuxer_pool_(new DemuxerPool(kMaxIdleDemuxers)),
+      shared_demuxer_registry_(new SharedDemuxerRegistry) {
+  remux_thread_pool_->Start();
+  demuxer_init_thread_pool_->Start();
+  remux_slice_queue_.reset(new DelayedTaskQueue(remux_thread_pool_.get()));
+}
+
+Packager::~Packager() {
+  remux_slice_queue_.reset();
+  remux_thread_pool_->Shutdown();
+  demuxer_init_thread_pool_->Shutdown();
+}
+
+Status Packager::Run(const PackagingParams& params,
+                     const StreamDescriptorList& stream_descriptors) {
+  // The threads created by the job, e.g. those of the MPD, inherit the CPUs
+  // of this one.
+  ScopedThreadAffinity affinity(params.cpu_set);
+  // The key fetches and the file operations of the job, in this thread and
+  // in the tasks of the job, are cancelled with it.
+  scoped_refptr<CancellationToken> cancellation_token =
+      params.cancellation_token;
+  if (!cancellation_token.get())
+    cancellation_token = new CancellationToken;
+  ScopedCancellationToken scoped_token(cancellation_token.get());
+  // Likewise, the I/O of the job is throttled with it.
+  scoped_refptr<IoThrottle> io_throttle =
+      new IoThrottle(params.io_priority, params.io_bytes_per_second);
+  ScopedIoThrottle scoped_throttle(io_throttle.get());
+  // Likewise, the resources used by the job are accounted in its usage,
+  // reported once everything the job created is released.
+  scoped_refptr<JobResourceUsage> resource_usage = new JobResourceUsage;
+  ScopedResourceReport resource_report(params.resource_report_file,
+                                       resource_usage.get());
+  ScopedJobResourceUsage scoped_usage(resource_usage.get());
+  const bool remote_mpd = !params.mpd_notification_receiver.empty();
+  if (params.output_media_info && (!params.mpd_output.empty() || remote_mpd)) {
+    return Status(error::UNIMPLEMENTED,
+                  "Media info output and MPD output do not work together.");
+  }
+  if (remote_mpd && !params.mpd_output.empty()) {
+    return Status(error::INVALID_ARGUMENT,
+                  "The MPD is generated either locally or remotely.");
+  }
+  if (params.mpd_notification_port != 0 && params.mpd_output.empty()) {
+    return Status(error::INVALID_ARGUMENT,
+                  "Receiving MPD notifications requires an MPD output.");
+  }
+  if (!params.mpd_options.mpd_state_log.empty()) {
+    if (params.mpd_output.empty()) {
+      return Status(error::INVALID_ARGUMENT,
+                    "The MPD state log requires an MPD output.");
+    }
+    if (params.generate_dash_if_iop_compliant_mpd) {
+      return Status(error::UNIMPLEMENTED,
+                    "The MPD state log is not supported for DASH-IF IOP "
+                    "compliant MPDs.");
+    }
+  }
+  if (params.output_media_info && !params.muxer_options.single_segment) {
+    // TODO(rkuroiwa, kqyang): Support partial media info dump for live.
+    return Status(error::UNIMPLEMENTED,
+                  "Media info output is only supported for single segment "
+                  "outputs.");
+  }
+  if (params.incremental_media_info && !params.output_media_info) {
+    return Status(error::INVALID_ARGUMENT,
+                  "Incremental media info requires media info output.");
+  }
+
+  scoped_ptr<MpdNotifier> mpd_notifier;
+  const DashProfile profile =
+      params.muxer_options.single_segment ? kOnDemandProfile : kLiveProfile;
+  if (remote_mpd) {
+    mpd_notifier.reset(
+        new RemoteMpdNotifier(profile, params.mpd_notification_receiver));
+    if (!mpd_notifier->Init())
+      return Status(error::MUXER_FAILURE, "MpdNotifier failed to initialize.");
+  } else if (!params.mpd_output.empty()) {
+    mpd_notifier = CreateLocalMpdNotifier(params, profile, params.mpd_output);
+    if (!mpd_notifier)
+      return Status(error::MUXER_FAILURE, "MpdNotifier failed to initialize.");
+  }
+  // The streams listed in an MPD of their own, e.g. the programs of a
+  // multi-program TS.
+  MpdNotifierMap stream_mpd_notifiers;
+  STLValueDeleter<MpdNotifierMap> scoped_notifiers_deleter(
+      &stream_mpd_notifiers);
+  for (const StreamDescriptor& stream_descriptor : stream_descriptors) {
+    const std::string& stream_mpd_output = stream_descriptor.mpd_output;
+    if (stream_mpd_output.empty() ||
+        stream_mpd_notifiers.count(stream_mpd_output) > 0) {
+      continue;
+    }
+    if (params.output_media_info || remote_mpd) {
+      return Status(error::UNIMPLEMENTED,
+                    "Per stream MPD outputs only work with local MPDs.");
+    }
+    if (stream_mpd_output == params.mpd_output) {
+      return Status(error::INVALID_ARGUMENT,
+                    "The MPD of a stream should not be --mpd_output.");
+    }
+    scoped_ptr<MpdNotifier> stream_mpd_notifier =
+        CreateLocalMpdNotifier(params, profile, stream_mpd_output);
+    if (!stream_mpd_notifier)
+      return Status(error::MUXER_FAILURE, "MpdNotifier failed to initialize.");
+    stream_mpd_notifiers[stream_mpd_output] = stream_mpd_notifier.release();
+  }
+  scoped_ptr<MpdNotificationReceiver> mpd_notification_receiver;
+  if (params.mpd_notification_port != 0) {
+    mpd_notification_receiver.reset(
+        new MpdNotificationReceiver(mpd_notifier.get()));
+    if (!mpd_notification_receiver->Start(params.mpd_notification_port)) {
+      return Status(error::MUXER_FAILURE,
+                    "Failed to receive MPD notifications.");
+    }
+  }
+
+  scoped_ptr<PackagingCheckpoint> checkpoint;
+  if (!params.checkpoint_file.empty()) {
+    checkpoint.reset(new PackagingCheckpoint(params.checkpoint_file));
+    if (!checkpoint->Load()) {
+      return Status(error::INVALID_ARGUMENT,
+                    "Failed to load checkpoint " + params.checkpoint_file);
+    }
+  }
+
+  // Declared before the jobs, so the muxers using them are deleted first.
+  // The renditions encrypted with the same key share its key schedule, and
+  // on key rotation, the keys of the crypto periods.
+  CryptoContextCache crypto_context_cache;
+  scoped_ptr<KeyRotationSchedule> key_rotation_schedule;
+  if (params.encryption_key_source &&
+      params.crypto_period_duration_in_seconds != 0) {
+    key_rotation_schedule.reset(
+        new KeyRotationSchedule(params.encryption_key_source));
+  }
+  std::vector<MergingMuxerListener*> merging_listeners;
+  STLElementDeleter<std::vector<MergingMuxerListener*> >
+      scoped_listeners_deleter(&merging_listeners);
+  std::vector<RemuxJob*> remux_jobs;
+  STLElementDeleter<std::vector<RemuxJob*> > scoped_jobs_deleter(&remux_jobs);
+  if (!CreateRemuxJobs(params, stream_descriptors,
+                       demuxer_init_thread_pool_.get(), mpd_notifier.get(),
+                       stream_mpd_notifiers,
+                       &crypto_context_cache, key_rotation_schedule.get(),
+                       checkpoint.get(), demuxer_pool_.get(),
+                       shared_demuxer_registry_.get(), &remux_jobs,
+                       &merging_listeners)) {
+    return Status(error::INVALID_ARGUMENT,
+                  "Failed to set up the streams to package.");
+  }
+
+  Status status = RunRemuxJobs(
+      remux_jobs, params.cpu_set, cancellation_token, io_throttle,
+      resource_usage, params.cooperative_remux_jobs, remux_thread_pool_.get(),
+      remux_slice_queue_.get());
+  if (!status.ok())
+    return status;
+  for (size_t i = 0; i < merging_listeners.size(); ++i)
+    merging_listeners[i]->Flush();
+  if (mpd_notification_receiver) {
+    // The MPD lists the remote streams until they end too.
+    mpd_notification_receiver->Stop();
+    if (!mpd_notifier->Flush())
+      return Status(error::MUXER_FAILURE, "Failed to write the MPD.");
+  }
+  if (checkpoint && !checkpoint->Delete()) {
+    LOG(WARNING) << "Failed to delete checkpoint " << params.checkpoint_file;
+  }
+  return Status::OK;
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -10,28 +10,29 @@
   ],
   'targets': [
     {
-      'target_name': 'packager',
-      'type': 'executable',
+      'target_name': 'libpackager',
+      'type': 'static_library',
       'sources': [
         'app/fixed_key_encryption_flags.cc',
         'app/fixed_key_encryption_flags.h',
+        'app/job_scheduler.cc',
+        'app/job_scheduler.h',
         'app/libcrypto_threading.cc',
         'app/libcrypto_threading.h',
         'app/mpd_flags.cc',
         'app/mpd_flags.h',
         'app/muxer_flags.cc',
         'app/muxer_flags.h',
-        'app/packager_main.cc',
         'app/packager_util.cc',
         'app/packager_util.h',
         'app/stream_descriptor.cc',
         'app/stream_descriptor.h',
         'app/validate_flag.cc',
         'app/validate_flag.h',
-        'app/vlog_flags.cc',
-        'app/vlog_flags.h',
         'app/widevine_encryption_flags.cc',
         'app/widevine_encryption_flags.h',
+        'packager.cc',
+        'packager.h',
       ],
       'dependencies': [
         'hls/hls.gyp:hls_builder',
@@ -48,6 +49,19 @@
         'third_party/boringssl/boringssl.gyp:boringssl',
         'third_party/gflags/gflags.gyp:gflags',
       ],
+    },
+    {
+      'target_name': 'packager',
+      'type': 'executable',
+      'sources': [
+        'app/packager_main.cc',
+        'app/vlog_flags.cc',
+        'app/vlog_flags.h',
+      ],
+      'dependencies': [
+        'libpackager',
+        'third_party/gflags/gflags.gyp:gflags',
+      ],
       'conditions': [
         ['profiling==1', {
           'dependencies': [
@@ -56,6 +70,19 @@
         }],
       ],
     },
+    {
+      'target_name': 'packager_server',
+      'type': 'executable',
+      'sources': [
+        'app/packager_server.cc',
+        'app/vlog_flags.cc',
+        'app/vlog_flags.h',
+      ],
+      'dependencies': [
+        'libpackager',
+        'third_party/gflags/gflags.gyp:gflags',
+      ],
+    },
     {
       'target_name': 'mpd_generator',
       'type': 'executable',
@@ -67,6 +94,8 @@
       ],
       'dependencies': [
         'base/base.gyp:base',
+        'media/base/media_base.gyp:media_base',
+        'media/file/file.gyp:file',
         'mpd/mpd.gyp:mpd_util',
         'third_party/gflags/gflags.gyp:gflags',
       ],
@@ -75,9 +104,36 @@
       'target_name': 'packager_test',
       'type': '<(gtest_target_type)',
       'sources': [
+        'app/job_scheduler_unittest.cc',
         'media/test/packager_test.cc',
+        'packager_unittest.cc',
+      ],
+      'dependencies': [
+        'libpackager',
+        'media/file/file.gyp:file',
+        'media/filters/filters.gyp:filters',
+        'media/formats/mp2t/mp2t.gyp:mp2t',
+        'media/formats/mp4/mp4.gyp:mp4',
+        'media/formats/mpeg/mpeg.gyp:mpeg',
+        'media/formats/webm/webm.gyp:webm',
+        'media/formats/webvtt/webvtt.gyp:webvtt',
+        'media/formats/wvm/wvm.gyp:wvm',
+        'media/test/media_test.gyp:media_test_support',
+        'mpd/mpd.gyp:mpd_builder',
+        'testing/gtest.gyp:gtest',
+      ],
+    },
+    {
+      'target_name': 'packager_perftest',
+      'type': '<(gtest_target_type)',
+      'sources': [
+        'media/test/manifest_perftest.cc',
+        'media/test/media_parser_perftest.cc',
+        'media/test/packager_perftest.cc',
       ],
       'dependencies': [
+        'hls/hls.gyp:hls_builder',
+        'media/event/media_event.gyp:media_event',
         'media/file/file.gyp:file',
         'media/filters/filters.gyp:filters',
         'media/formats/mp2t/mp2t.gyp:mp2t',
@@ -87,7 +143,9 @@
         'media/formats/webvtt/webvtt.gyp:webvtt',
         'media/formats/wvm/wvm.gyp:wvm',
         'media/test/media_test.gyp:media_test_support',
+        'mpd/mpd.gyp:mpd_builder',
         'testing/gtest.gyp:gtest',
+        'testing/perf/perf_test.gyp:perf_test',
       ],
     },
     {
@@ -0,0 +1,214 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef PACKAGER_PACKAGER_H_
+#define PACKAGER_PACKAGER_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "packager/app/libcrypto_threading.h"
+#include "packager/app/stream_descriptor.h"
+#include "packager/base/callback.h"
+#include "packager/base/memory/ref_counted.h"
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/media/base/cancellation_token.h"
+#include "packager/media/base/fourccs.h"
+#include "packager/media/base/io_throttle.h"
+#include "packager/media/base/media_parser.h"
+#include "packager/media/base/muxer_options.h"
+#include "packager/media/base/status.h"
+#include "packager/mpd/base/mpd_options.h"
+
+namespace base {
+class Clock;
+}  // namespace base
+
+namespace edash_packager {
+namespace media {
+
+class DelayedTaskQueue;
+class DemuxerPool;
+class KeySource;
+class SharedDemuxerRegistry;
+class ThreadPool;
+
+/// Creates the key source to decrypt an input with.
+typedef base::Callback<scoped_ptr<KeySource>(void)> KeySourceFactory;
+
+/// Parameters of a packaging job, besides the streams to package.
+struct PackagingParams {
+  PackagingParams();
+  ~PackagingParams();
+
+  /// Options of the muxers. The output file name and the segment template
+  /// are set per stream from the stream descriptors.
+  MuxerOptions muxer_options;
+
+  /// @name MPD generation.
+  /// @{
+  /// Path of the MPD to generate. No MPD is generated if empty.
+  std::string mpd_output;
+  /// Address, as "<host>:<port>", of the MpdNotificationReceiver of the
+  /// packager generating the MPD. If set, the MPD updates are sent to it
+  /// instead of generating @a mpd_output.
+  std::string mpd_notification_receiver;
+  /// If not zero, the MPD updates of remote packagers are received on this
+  /// TCP port and added to @a mpd_output. The job then waits for the remote
+  /// packagers to disconnect before completing.
+  uint16_t mpd_notification_port;
+  MpdOptions mpd_options;
+  std::vector<std::string> base_urls;
+  bool generate_dash_if_iop_compliant_mpd;
+  /// @}
+
+  /// Write the media info of each output next to it, for mpd_generator.
+  /// Requires single segment outputs and no @a mpd_output.
+  bool output_media_info;
+  /// Write the media info in the binary protobuf format instead of text.
+  bool binary_media_info;
+  /// Also write the media info and the subsegments of each output to a
+  /// segment log next to it, suffixed with '.media_info_log', as they
+  /// complete. See VodMediaInfoDumpMuxerListener::set_segment_log_path().
+  /// Requires @a output_media_info.
+  bool incremental_media_info;
+  /// Print the stream info of the inputs to standard output.
+  bool dump_stream_info;
+
+  /// @name Encryption.
+  /// @{
+  /// Key source to encrypt the outputs with, or NULL to leave the outputs
+  /// clear. Not owned. It must outlive the job, and can be shared by jobs
+  /// running concurrently, e.g. to package several renditions of a content
+  /// with the same keys.
+  KeySource* encryption_key_source;
+  uint32_t max_sd_pixels;
+  double clear_lead_in_seconds;
+  double crypto_period_duration_in_seconds;
+  FourCC protection_scheme;
+  /// @}
+
+  /// Creates the key source of each encrypted input. Null if the inputs are
+  /// not to be decrypted.
+  KeySourceFactory decryption_key_source_factory;
+
+  /// @name Input and pipeline options, see the packager flags of the same
+  /// names.
+  /// @{
+  bool mmap_input;
+  bool random_access_input;
+  std::string media_index_cache_dir;
+  bool follow_input;
+  int sample_channel_capacity;
+  int vod_parallel_splits;
+  /// Memory budget of the sample data queued for each stream, in bytes,
+  /// past which the samples are spilled to a temporary file in
+  /// muxer_options.temp_dir. 0 for unlimited.
+  uint64_t sample_queue_memory_budget;
+  /// Budgets of the parsing of each input, guarding the workers against
+  /// malformed or adversarial inputs.
+  MediaParserLimits parser_limits;
+  /// If not zero, the inputs are demuxed once for all the jobs packaging
+  /// them concurrently through the same Packager, e.g. a DASH and an HLS
+  /// job of a source: a job starting while another job demuxes one of its
+  /// inputs joins that demuxer, and gets the samples demuxed so far from a
+  /// replay buffer of at most this many bytes. Once the buffer overflows, the
+  /// jobs starting read the input themselves. Clipped inputs, inputs with a
+  /// language override and inputs split in parallel ranges are not shared.
+  uint64_t shared_input_replay_buffer_size;
+  /// If true, the remux jobs run in slices on the worker threads instead of
+  /// holding a worker each until they complete, and yield while their input
+  /// has no data available, so that many live inputs of low bitrate, e.g.
+  /// radio channels, share a few workers. Best with sample_channel_capacity
+  /// 0, which muxes in the slices too. See Demuxer::set_cooperative().
+  bool cooperative_remux_jobs;
+  /// @}
+
+  /// Path of the checkpoint of the job. If set, the ranges of the streams
+  /// packaged in parallel, see @a vod_parallel_splits, are recorded in it as
+  /// they complete, and a job restarted with the same parameters skips the
+  /// ranges recorded by the previous run. The first range of every stream is
+  /// always packaged again. The checkpoint is deleted once the job completes.
+  std::string checkpoint_file;
+
+  /// CPUs the job runs on, e.g. those of a NUMA node, see ParseCpuSet(). The
+  /// workers shared by the jobs are pinned to them while they run the tasks
+  /// of the job, so that the buffers of the job, which Linux allocates on the
+  /// node of the thread touching them first, stay on the node the job runs
+  /// on. Empty to run on any CPU.
+  std::vector<int> cpu_set;
+
+  /// Cancels the job when cancelled, e.g. from another thread: the blocking
+  /// waits of the job return within milliseconds, except for a key fetch in
+  /// progress, which is aborted within a second, and Run() returns a
+  /// CANCELLED status. The job cancels it too when one of its streams fails,
+  /// to stop the others. NULL if the job cannot be cancelled by the caller.
+  scoped_refptr<CancellationToken> cancellation_token;
+
+  /// I/O priority class of the job, see IoPriority: the reads and writes of
+  /// the batch jobs, e.g. VOD, use the host bandwidth, see
+  /// IoThrottle::SetHostBandwidth(), left over by the live jobs.
+  IoPriority io_priority;
+  /// I/O bandwidth budget of the job, in bytes per second, shared by all its
+  /// inputs and outputs. 0 for unlimited.
+  uint64_t io_bytes_per_second;
+
+  /// File the resource report of the job is written to when the job ends,
+  /// successfully or not: a JSON object with the CPU time of the threads
+  /// running the job, the runs, time and bytes of its pipeline stages,
+  /// including the bytes encrypted, and the bytes read and written per file.
+  /// Empty for no report.
+  std::string resource_report_file;
+
+  /// Clock of the muxers, e.g. a fake clock for tests. Not owned. NULL to
+  /// use the system clock.
+  base::Clock* clock;
+};
+
+/// Packages media in process. A Packager is meant to be long-lived: it sets
+/// up libcrypto once and owns the worker threads, which are shared by all the
+/// jobs run through it. Connections to the key servers are shared process
+/// wide by HttpKeyFetcher, so they are reused across jobs as well. The
+/// demuxers of the completed jobs, and their read buffers, are reused by the
+/// next jobs, which saves setting them up for each input, and the demuxers of
+/// the running jobs can be shared, see
+/// PackagingParams::shared_input_replay_buffer_size.
+/// Thread Safety: Run() can be called from several threads concurrently.
+/// There should be only one Packager per process.
+class Packager {
+ public:
+  /// @param num_worker_threads is the number of threads running the remux
+  ///        jobs of all the calls to Run(). Zero means one per processor.
+  explicit Packager(size_t num_worker_threads);
+  ~Packager();
+
+  /// Package @a stream_descriptors and wait for the job to complete.
+  /// @param params contains the parameters of the job.
+  /// @param stream_descriptors contains the streams to package.
+  /// @return OK on success, an error status otherwise.
+  Status Run(const PackagingParams& params,
+             const StreamDescriptorList& stream_descriptors);
+
+ private:
+  LibcryptoThreading libcrypto_threading_;
+  scoped_ptr<ThreadPool> remux_thread_pool_;
+  scoped_ptr<ThreadPool> demuxer_init_thread_pool_;
+  // Resumes the slices of the cooperative remux jobs on the workers.
+  scoped_ptr<DelayedTaskQueue> remux_slice_queue_;
+  // The demuxers of the completed jobs, reused by the next ones.
+  scoped_ptr<DemuxerPool> demuxer_pool_;
+  // The demuxers of the running jobs, which the next jobs can join.
+  scoped_ptr<SharedDemuxerRegistry> shared_demuxer_registry_;
+
+  DISALLOW_COPY_AND_ASSIGN(Packager);
+};
+
+}  // namespace media
+}  // namespace edash_packager
+
+#endif  // PACKAGER_PACKAGER_H_
@@ -0,0 +1,166 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/packager.h"
+
+#include <gtest/gtest.h>
+
+#include "packager/base/bind.h"
+#include "packager/base/files/file_util.h"
+#include "packager/base/strings/stringprintf.h"
+#include "packager/base/time/clock.h"
+#include "packager/media/base/closure_thread.h"
+#include "packager/media/base/demuxer.h"
+#include "packager/media/base/media_stream.h"
+#include "packager/media/base/stream_info.h"
+#include "packager/media/base/test/status_test_util.h"
+#include "packager/media/test/test_data_util.h"
+
+namespace edash_packager {
+namespace media {
+namespace {
+
+const char kInput[] = "bear-640x360.mp4";
+const size_t kNumWorkerThreads = 4;
+
+class FakeClock : public base::Clock {
+ public:
+  // Fake the clock to return NULL time, so that the outputs of identical
+  // jobs are identical.
+  base::Time Now() override { return base::Time(); }
+};
+
+void RunPackager(Packager* packager,
+                 const PackagingParams* params,
+                 const StreamDescriptorList* stream_descriptors,
+                 Status* status) {
+  *status = packager->Run(*params, *stream_descriptors);
+}
+
+}  // namespace
+
+class PackagerTest : public ::testing::Test {
+ public:
+  PackagerTest() : packager_(kNumWorkerThreads) {}
+
+  void SetUp() override {
+    ASSERT_TRUE(base::CreateNewTempDirectory("packager_", &test_directory_));
+    ASSERT_TRUE(base::CopyFile(GetTestDataFilePath(kInput),
+                               test_directory_.AppendASCII(kInput)));
+  }
+
+  void TearDown() override { base::DeleteFile(test_directory_, true); }
+
+ protected:
+  std::string GetFullPath(const std::string& file_name) {
+    return test_directory_.AppendASCII(file_name).value();
+  }
+
+  // Parameters of a VOD job writing its MPD to |mpd_output|.
+  PackagingParams CreateParams(const std::string& mpd_output) {
+    PackagingParams params;
+    params.muxer_options.single_segment = true;
+    params.muxer_options.segment_duration = 1.0;
+    params.muxer_options.fragment_duration = 0.1;
+    params.muxer_options.segment_sap_aligned = true;
+    params.muxer_options.fragment_sap_aligned = true;
+    params.muxer_options.num_subsegments_per_sidx = 2;
+    params.muxer_options.temp_dir = test_directory_.value();
+    params.mpd_output = GetFullPath(mpd_output);
+    params.clock = &fake_clock_;
+    return params;
+  }
+
+  // Descriptors of the audio and the video of the input, written to
+  // |output_prefix| suffixed with "_audio.mp4" and "_video.mp4".
+  StreamDescriptorList CreateStreamDescriptors(
+      const std::string& output_prefix) {
+    StreamDescriptorList stream_descriptors;
+    const char* kStreams[] = {"audio", "video"};
+    for (size_t i = 0; i < arraysize(kStreams); ++i) {
+      const std::string descriptor = base::StringPrintf(
+          "input=%s,stream=%s,output=%s_%s.mp4", GetFullPath(kInput).c_str(),
+          kStreams[i], GetFullPath(output_prefix).c_str(), kStreams[i]);
+      EXPECT_TRUE(InsertStreamDescriptor(descriptor, &stream_descriptors));
+    }
+    return stream_descriptors;
+  }
+
+  // Checks that |output| holds a single stream of |stream_type|.
+  void CheckOutput(const std::string& output, StreamType stream_type) {
+    Demuxer demuxer(GetFullPath(output));
+    ASSERT_OK(demuxer.Initialize());
+    ASSERT_EQ(1u, demuxer.streams().size());
+    EXPECT_EQ(stream_type, demuxer.streams()[0]->info()->stream_type());
+  }
+
+  bool ContentsEqual(const std::string& file1, const std::string& file2) {
+    return base::ContentsEqual(test_directory_.AppendASCII(file1),
+                               test_directory_.AppendASCII(file2));
+  }
+
+  base::FilePath test_directory_;
+  FakeClock fake_clock_;
+  Packager packager_;
+};
+
+TEST_F(PackagerTest, Run) {
+  ASSERT_OK(packager_.Run(CreateParams("output.mpd"),
+                          CreateStreamDescriptors("output")));
+
+  ASSERT_NO_FATAL_FAILURE(CheckOutput("output_audio.mp4", kStreamAudio));
+  ASSERT_NO_FATAL_FAILURE(CheckOutput("output_video.mp4", kStreamVideo));
+  std::string mpd;
+  ASSERT_TRUE(base::ReadFileToString(
+      test_directory_.AppendASCII("output.mpd"), &mpd));
+  EXPECT_NE(std::string::npos, mpd.find("output_audio.mp4"));
+  EXPECT_NE(std::string::npos, mpd.find("output_video.mp4"));
+}
+
+TEST_F(PackagerTest, InvalidParams) {
+  PackagingParams params = CreateParams("output.mpd");
+  // The media info is written instead of an MPD.
+  params.output_media_info = true;
+  EXPECT_EQ(error::UNIMPLEMENTED,
+            packager_.Run(params, CreateStreamDescriptors("output"))
+                .error_code());
+}
+
+// Two jobs run concurrently through the same Packager, sharing its workers
+// and its demuxer pool, and package the same input as a single job would.
+TEST_F(PackagerTest, ConcurrentRuns) {
+  const PackagingParams params1 = CreateParams("output1.mpd");
+  const PackagingParams params2 = CreateParams("output2.mpd");
+  const StreamDescriptorList stream_descriptors1 =
+      CreateStreamDescriptors("output1");
+  const StreamDescriptorList stream_descriptors2 =
+      CreateStreamDescriptors("output2");
+
+  Status status1(error::UNKNOWN, "Not run.");
+  Status status2(error::UNKNOWN, "Not run.");
+  ClosureThread thread1(
+      "PackagerTest1", base::Bind(&RunPackager, &packager_, &params1,
+                                  &stream_descriptors1, &status1));
+  ClosureThread thread2(
+      "PackagerTest2", base::Bind(&RunPackager, &packager_, &params2,
+                                  &stream_descriptors2, &status2));
+  thread1.Start();
+  thread2.Start();
+  thread1.Join();
+  thread2.Join();
+  ASSERT_OK(status1);
+  ASSERT_OK(status2);
+
+  ASSERT_OK(packager_.Run(CreateParams("output.mpd"),
+                          CreateStreamDescriptors("output")));
+  EXPECT_TRUE(ContentsEqual("output_audio.mp4", "output1_audio.mp4"));
+  EXPECT_TRUE(ContentsEqual("output_video.mp4", "output1_video.mp4"));
+  EXPECT_TRUE(ContentsEqual("output_audio.mp4", "output2_audio.mp4"));
+  EXPECT_TRUE(ContentsEqual("output_video.mp4", "output2_video.mp4"));
+}
+
+}  // namespace media
+}  // namespace edash_packager
@@ -0,0 +1,241 @@
+#!/usr/bin/python
+# Copyright 2016 Google Inc. All rights reserved.
+#
+# Use of this source code is governed by a BSD-style
+# license that can be found in the LICENSE file or at
+# https://developers.google.com/open-source/licenses/bsd
+
+"""Saves the results of the perftests as a baseline and compares runs to it.
+
+The perftests print their results with perf_test::PrintResult():
+
+  <*>RESULT <measurement>: <trace>= <value> <units>
+
+where the value can also be {<mean>, <std deviation>} or [<value>,...,].
+The results of several runs of the same build make a baseline, saved as JSON,
+which keeps every value so that the noise of each result is known. A run is
+compared to the baseline result by result: a change is only reported if it
+is larger than both a minimum threshold and the noise of the baseline.
+"""
+
+from __future__ import print_function
+
+import argparse
+import json
+import math
+import re
+import sys
+
+_RESULT_RE = re.compile(
+    r'^(\*?)RESULT ([^:]+): ([^=]*)= (\{[^}]*\}|\[[^\]]*\]|\S+) (\S*)\s*$')
+
+# Units of the results which are better when higher. The results in the other
+# units, e.g. latencies, sizes or counts, are better when lower.
+_HIGHER_IS_BETTER_UNITS = frozenset(['MB/s', 'GB/s', 'fps', 'samples/s'])
+
+
+class Result(object):
+  """The values of a result, from one or more runs."""
+
+  def __init__(self, units, important):
+    self.units = units
+    self.important = important
+    self.values = []
+
+  def mean(self):
+    return sum(self.values) / len(self.values)
+
+  def stddev(self):
+    """Returns the sample standard deviation, 0 with a single value."""
+    if len(self.values) < 2:
+      return 0.0
+    mean = self.mean()
+    variance = sum((v - mean) ** 2 for v in self.values) / (
+        len(self.values) - 1)
+    return math.sqrt(variance)
+
+  def to_json(self):
+    return {'units': self.units, 'important': self.important,
+            'values': self.values}
+
+  @staticmethod
+  def from_json(data):
+    result = Result(data['units'], data['important'])
+    result.values = [float(v) for v in data['values']]
+    return result
+
+
+def _parse_values(value):
+  """Returns the values of a RESULT line."""
+  if value.startswith('{'):
+    # {mean, std deviation}: only the mean is a value of the result.
+    return [float(value[1:-1].split(',')[0])]
+  if value.startswith('['):
+    return [float(v) for v in value[1:-1].split(',') if v.strip()]
+  return [float(value)]
+
+
+def parse_results(lines, results):
+  """Adds the results of the RESULT lines of |lines| to |results|."""
+  for line in lines:
+    match = _RESULT_RE.match(line.strip())
+    if not match:
+      continue
+    important, measurement, trace, value, units = match.groups()
+    key = '%s/%s' % (measurement.strip(), trace.strip())
+    try:
+      values = _parse_values(value)
+    except ValueError:
+      print('Ignoring malformed result: %s' % line.strip(), file=sys.stderr)
+      continue
+    if key not in results:
+      results[key] = Result(units, bool(important))
+    results[key].values.extend(values)
+
+
+def load_results(file_names):
+  """Loads the results of perftest logs and of saved JSON results."""
+  results = {}
+  for file_name in file_names:
+    with open(file_name) as f:
+      content = f.read()
+    if content.lstrip().startswith('{'):
+      for key, data in json.loads(content)['results'].items():
+        if key not in results:
+          results[key] = Result(data['units'], data['important'])
+        results[key].values.extend(Result.from_json(data).values)
+    else:
+      parse_results(content.splitlines(), results)
+  return results
+
+
+def save_baseline(results, file_name):
+  with open(file_name, 'w') as f:
+    json.dump({'results': dict((key, result.to_json())
+                               for key, result in results.items())},
+              f, indent=2, sort_keys=True)
+
+
+def compare(baseline, current, min_threshold, noise_factor):
+  """Compares |current| to |baseline|.
+
+  Returns:
+    A list of (key, status, baseline mean, current mean, change, threshold)
+    tuples, sorted by key. The change and the threshold are relative to the
+    baseline mean; the change is positive for improvements. The status is
+    'ok', 'improved', 'regressed', 'new' or 'missing'.
+  """
+  report = []
+  for key in sorted(set(baseline) | set(current)):
+    if key not in current:
+      report.append((key, 'missing', baseline[key].mean(), None, None, None))
+      continue
+    if key not in baseline:
+      report.append((key, 'new', None, current[key].mean(), None, None))
+      continue
+    base = baseline[key]
+    base_mean = base.mean()
+    current_mean = current[key].mean()
+    if base_mean == 0:
+      change = 0.0 if current_mean == 0 else float('inf')
+    else:
+      change = (current_mean - base_mean) / abs(base_mean)
+    if base.units not in _HIGHER_IS_BETTER_UNITS:
+      change = -change
+    # The noise of a single run: the standard deviation of the baseline runs.
+    noise = base.stddev() / abs(base_mean) if base_mean else 0.0
+    threshold = max(min_threshold, noise_factor * noise)
+    if change > threshold:
+      status = 'improved'
+    elif change < -threshold:
+      status = 'regressed'
+    else:
+      status = 'ok'
+    report.append((key, status, base_mean, current_mean, change, threshold))
+  return report
+
+
+def _format_number(value):
+  return '-' if value is None else '%.4g' % value
+
+
+def _format_percent(value):
+  return '-' if value is None else '%+.1f%%' % (value * 100)
+
+
+def print_report(report, baseline, current, out):
+  """Prints |report| as a table, the regressions first."""
+  order = {'regressed': 0, 'missing': 1, 'improved': 2, 'new': 3, 'ok': 4}
+  rows = [('status', 'result', 'baseline', 'current', 'change', 'threshold')]
+  for key, status, base_mean, current_mean, change, threshold in sorted(
+      report, key=lambda entry: (order[entry[1]], entry[0])):
+    result = baseline.get(key) or current[key]
+    units = result.units
+    important = result.important
+    rows.append((status, ('*' if important else ' ') + key,
+                 _format_number(base_mean), _format_number(current_mean) +
+                 ' ' + units, _format_percent(change),
+                 '-' if threshold is None else '%.1f%%' % (threshold * 100)))
+  widths = [max(len(row[i]) for row in rows) for i in range(len(rows[0]))]
+  for row in rows:
+    out.write('  '.join(cell.ljust(width)
+                        for cell, width in zip(row, widths)).rstrip() + '\n')
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__,
+                                   formatter_class=
+                                   argparse.RawDescriptionHelpFormatter)
+  subparsers = parser.add_subparsers(dest='command')
+
+  save_parser = subparsers.add_parser(
+      'save', help='Saves the results of perftest runs as a baseline.')
+  save_parser.add_argument('--output', required=True,
+                           help='The baseline JSON file to write.')
+  save_parser.add_argument('inputs', nargs='+',
+                           help='perftest logs or saved JSON results, '
+                           'preferably of several runs.')
+
+  compare_parser = subparsers.add_parser(
+      'compare', help='Compares perftest runs to a baseline.')
+  compare_parser.add_argument('--baseline', required=True,
+                              help='The baseline JSON file.')
+  compare_parser.add_argument('--min_threshold', type=float, default=5.0,
+                              help='The smallest change reported, in percent '
+                              'of the baseline. Default: %(default)s.')
+  compare_parser.add_argument('--noise_factor', type=float, default=3.0,
+                              help='The smallest change reported, in '
+                              'standard deviations of the baseline runs. '
+                              'Default: %(default)s.')
+  compare_parser.add_argument('--all', action='store_true',
+                              help='Fail on the regression of any result, '
+                              'not only of the important (*) ones.')
+  compare_parser.add_argument('inputs', nargs='+',
+                              help='perftest logs or saved JSON results of '
+                              'the build to compare.')
+
+  args = parser.parse_args()
+  if args.command == 'save':
+    results = load_results(args.inputs)
+    if not results:
+      print('No results found.', file=sys.stderr)
+      return 1
+    save_baseline(results, args.output)
+    print('Saved %d results to %s.' % (len(results), args.output))
+    return 0
+
+  baseline = load_results([args.baseline])
+  current = load_results(args.inputs)
+  report = compare(baseline, current, args.min_threshold / 100.0,
+                   args.noise_factor)
+  print_report(report, baseline, current, sys.stdout)
+  regressions = [entry for entry in report if entry[1] == 'regressed' and
+                 (args.all or baseline[entry[0]].important)]
+  if regressions:
+    print('%d results regressed.' % len(regressions))
+    return 1
+  return 0
+
+
+if __name__ == '__main__':
+  sys.exit(main())